@@ -0,0 +1,205 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "cdc.h"
+
+#include <glog/logging.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <csignal>
+
+#include "io_util.h"
+#include "server/redis_reply.h"
+#include "server/server.h"
+#include "storage/batch_extractor.h"
+#include "thread_util.h"
+
+CDCFeedThread::CDCFeedThread(Server *srv, Redis::Connection *conn, CDCOptions options)
+    : srv_(srv),
+      backlog_(srv->GetReplBacklog()),
+      conn_(conn),
+      options_(std::move(options)),
+      next_seq_(options_.next_seq) {}
+
+Status CDCFeedThread::Start() {
+  try {
+    t_ = std::thread([this]() {
+      Util::ThreadSetName("feed-cdc");
+      if (auto s = Util::ThreadSetAffinity(srv_->GetConfig()->background_cpus); !s.IsOK()) {
+        LOG(WARNING) << "Failed to set the cpu affinity of cdc thread, err: " << s.Msg();
+      }
+      sigset_t mask, omask;
+      sigemptyset(&mask);
+      sigemptyset(&omask);
+      sigaddset(&mask, SIGCHLD);
+      sigaddset(&mask, SIGHUP);
+      sigaddset(&mask, SIGPIPE);
+      pthread_sigmask(SIG_BLOCK, &mask, &omask);
+      if (!send(Redis::SimpleString("OK")).IsOK()) {
+        Stop();
+        return;
+      }
+      this->loop();
+    });
+  } catch (const std::system_error &e) {
+    conn_ = nullptr;  // prevent connection was freed when failed to start the thread
+    return {Status::NotOK, e.what()};
+  }
+  return Status::OK();
+}
+
+void CDCFeedThread::Stop() {
+  if (stop_.exchange(true)) return;
+  LOG(INFO) << "CDC thread was terminated, would stop feeding the subscriber: " << conn_->GetAddr();
+}
+
+void CDCFeedThread::Join() {
+  if (t_.joinable()) t_.join();
+}
+
+Status CDCFeedThread::send(const std::string &data) {
+  sent_bytes_.fetch_add(data.size(), std::memory_order_relaxed);
+  return Util::SockSend(conn_->GetFD(), data);
+}
+
+bool CDCFeedThread::isSubscriberClosed() {
+  char buf[1024];
+  int fd = conn_->GetFD();
+  while (true) {
+    pollfd pfd{fd, POLLIN, 0};
+    int n = poll(&pfd, 1, 0);
+    if (n == 0 || (n < 0 && errno == EINTR)) return false;
+    if (n < 0) return true;
+    // Discard what the subscriber sent, it's ignored while streaming
+    auto nread = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (nread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return false;
+    if (nread <= 0) return true;
+  }
+}
+
+Status CDCFeedThread::extractChanges(rocksdb::SequenceNumber last_seq, const std::string &batch_data,
+                                     std::string *output) {
+  rocksdb::WriteBatch batch(batch_data);
+  WriteBatchExtractor extractor(srv_->storage_->IsSlotIdEncoded(), -1, false);
+  auto s = batch.Iterate(&extractor);
+  if (!s.ok()) return {Status::NotOK, s.ToString()};
+
+  auto type = extractor.GetRedisType();
+  if (type != kRedisNone && !options_.types.empty() && options_.types.count(type) == 0) return Status::OK();
+
+  auto resp_commands = extractor.GetRESPCommands();
+  if (options_.format == CDCFormat::kBinary) {
+    // The batch is streamed as a whole if any of its changes pass the filters
+    bool matched = options_.ns.empty() ? !resp_commands->empty() : resp_commands->count(options_.ns) > 0;
+    if (!matched) return Status::OK();
+    *output += Redis::MultiLen(3) + Redis::BulkString("cdc") + Redis::Integer(static_cast<int64_t>(last_seq)) +
+               Redis::BulkString(batch_data);
+    return Status::OK();
+  }
+
+  for (const auto &[ns, commands] : *resp_commands) {
+    if (commands.empty() || (!options_.ns.empty() && ns != options_.ns)) continue;
+    *output += Redis::MultiLen(4) + Redis::BulkString("cdc") + Redis::Integer(static_cast<int64_t>(last_seq)) +
+               Redis::BulkString(ns) + Redis::MultiLen(static_cast<int64_t>(commands.size()));
+    for (const auto &command : commands) *output += command;
+  }
+  return Status::OK();
+}
+
+void CDCFeedThread::loop() {
+  uint32_t yield_microseconds = 2 * 1000;
+  std::string output;
+  ReplBacklog::Batch backlog_batch;
+  rocksdb::BatchResult wal_batch;
+  // The pending changes are sent before waiting for the new batches, so they're never delayed
+  auto flush = [this, &output]() {
+    if (output.empty()) return true;
+    if (auto s = send(output); !s.IsOK()) {
+      LOG(WARNING) << "[cdc] Failed to send the changes to the subscriber " << conn_->GetAddr() << ", err: " << s.Msg();
+      Stop();
+      return false;
+    }
+    output.clear();
+    if (output.capacity() > kMaxDelayBytes * 2) output.shrink_to_fit();
+    return true;
+  };
+  while (!IsStopped()) {
+    if (isSubscriberClosed()) {
+      Stop();
+      return;
+    }
+    // Pack the changes of the batches into one write unless the subscriber catches up
+    if (srv_->storage_->LatestSeq() < next_seq_ && !flush()) return;
+    auto result = ReplBacklog::ReadResult::kOutOfRange;
+    if (backlog_) result = backlog_->Get(next_seq_, kWALWaitMicroseconds, &backlog_batch);
+    if (result == ReplBacklog::ReadResult::kNotYet) continue;
+
+    rocksdb::SequenceNumber batch_seq = 0;
+    uint32_t batch_count = 0;
+    const std::string *batch_data = nullptr;
+    if (result == ReplBacklog::ReadResult::kOK) {
+      iter_ = nullptr;
+      batch_seq = backlog_batch.seq;
+      batch_count = backlog_batch.count;
+      batch_data = &backlog_batch.data;
+    } else {
+      if (!iter_ || !iter_->Valid()) {
+        if (!srv_->storage_->WaitForWALData(next_seq_, kWALWaitMicroseconds)) {
+          iter_ = nullptr;
+          continue;
+        }
+        if (!srv_->storage_->GetWALIter(next_seq_, &iter_).IsOK()) {
+          iter_ = nullptr;
+          usleep(yield_microseconds);
+          continue;
+        }
+      }
+      wal_batch = iter_->GetBatch();
+      batch_seq = wal_batch.sequence;
+      batch_count = wal_batch.writeBatchPtr->Count();
+      batch_data = &wal_batch.writeBatchPtr->Data();
+    }
+    if (batch_seq != next_seq_) {
+      LOG(ERROR) << "[cdc] WAL iterator is discrete, sequence " << next_seq_ << " expected, but got " << batch_seq;
+      send(Redis::Error("ERR some sequences were lost in the WAL, please resubscribe"));
+      Stop();
+      return;
+    }
+
+    auto last_seq = batch_seq + batch_count - 1;
+    if (auto s = extractChanges(last_seq, *batch_data, &output); !s.IsOK()) {
+      LOG(WARNING) << "[cdc] Failed to extract the changes of the batch " << batch_seq << ", err: " << s.Msg();
+    }
+    if (output.size() >= kMaxDelayBytes && !flush()) return;
+    next_seq_ = last_seq + 1;
+    if (result == ReplBacklog::ReadResult::kOK) continue;
+    // Switch to the backlog once the subscriber catches up with it
+    if (backlog_ && backlog_->Contains(next_seq_)) {
+      iter_ = nullptr;
+      continue;
+    }
+    if (srv_->storage_->LatestSeq() < next_seq_ && !flush()) return;
+    while (!IsStopped() && !srv_->storage_->WaitForWALData(next_seq_, kWALWaitMicroseconds)) {
+      if (isSubscriberClosed()) Stop();
+    }
+    iter_->Next();
+  }
+}
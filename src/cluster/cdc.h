@@ -0,0 +1,89 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "cluster/replication.h"
+#include "server/redis_connection.h"
+#include "status.h"
+#include "storage/redis_metadata.h"
+
+class Server;
+
+enum class CDCFormat {
+  kRESP,    // the changes are the redis commands of every namespace
+  kBinary,  // the changes are the raw write batches
+};
+
+struct CDCOptions {
+  // The sequence number of the first batch to stream
+  rocksdb::SequenceNumber next_seq = 0;
+  // Only stream the changes of the namespace if it isn't empty
+  std::string ns;
+  // Only stream the changes of these types if it isn't empty, the key-level changes which don't
+  // know the type of the key, e.g. DEL and EXPIRE, are always streamed
+  std::set<RedisType> types;
+  CDCFormat format = CDCFormat::kRESP;
+};
+
+// Stream the changes in the WAL to the subscriber of CDC SUBSCRIBE, the batches are read from the shared
+// replication backlog if they're there, otherwise from the WAL, like feeding the replicas. Every change is
+// sent as an array, the first two elements are "cdc" and the last sequence number of the batch, so the
+// subscriber resumes from the next sequence number after reconnecting:
+//   RESP format:   cdc <seq> <namespace> <array of the commands>
+//   binary format: cdc <seq> <raw write batch>
+class CDCFeedThread {
+ public:
+  explicit CDCFeedThread(Server *srv, Redis::Connection *conn, CDCOptions options);
+  ~CDCFeedThread() = default;
+
+  Status Start();
+  void Stop();
+  void Join();
+  bool IsStopped() const { return stop_; }
+  Redis::Connection *GetConn() { return conn_.get(); }
+  rocksdb::SequenceNumber GetCurrentSeq() const { return next_seq_ == 0 ? 0 : next_seq_ - 1; }
+  uint64_t GetSentBytes() const { return sent_bytes_; }
+
+ private:
+  std::atomic<bool> stop_ = false;
+  Server *srv_ = nullptr;
+  ReplBacklog *backlog_ = nullptr;
+  std::unique_ptr<Redis::Connection> conn_ = nullptr;
+  CDCOptions options_;
+  std::atomic<rocksdb::SequenceNumber> next_seq_ = 0;
+  std::thread t_;
+  std::unique_ptr<rocksdb::TransactionLogIterator> iter_ = nullptr;
+  std::atomic<uint64_t> sent_bytes_ = 0;
+  const size_t kMaxDelayBytes = 16 * 1024;
+
+  void loop();
+  // Append the changes of the batch which pass the filters into the output
+  Status extractChanges(rocksdb::SequenceNumber last_seq, const std::string &batch_data, std::string *output);
+  // The subscriber never sends anything after subscribing, so the readable socket means it's closed
+  bool isSubscriberClosed();
+  Status send(const std::string &data);
+};
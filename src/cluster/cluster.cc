@@ -52,25 +52,55 @@ ClusterNode::ClusterNode(std::string id, std::string host, int port, int role, s
       master_id_(std::move(master_id)),
       slots_(slots) {}
 
+// The epochs of the published topologies are unique among all clusters, so the thread
+// local cache of the topology only needs to compare the epoch
+static std::atomic<uint64_t> next_topology_epoch{1};
+
 Cluster::Cluster(Server *svr, std::vector<std::string> binds, int port)
-    : svr_(svr), binds_(std::move(binds)), port_(port), size_(0), version_(-1), myself_(nullptr) {
-  for (auto &slots_node : slots_nodes_) {
-    slots_node = nullptr;
+    : svr_(svr), binds_(std::move(binds)), port_(port) {
+  std::lock_guard<std::mutex> guard(update_mu_);
+  publish(std::make_shared<ClusterTopology>());
+}
+
+const ClusterTopology &Cluster::topology() const {
+  thread_local struct {
+    uint64_t epoch = 0;
+    std::shared_ptr<const ClusterTopology> topology;
+  } cache;
+
+  if (cache.epoch != epoch_.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> guard(publish_mu_);
+    cache.epoch = epoch_.load(std::memory_order_relaxed);
+    cache.topology = topology_;
+  }
+  return *cache.topology;
+}
+
+void Cluster::publish(std::shared_ptr<const ClusterTopology> topology) {
+  std::lock_guard<std::mutex> guard(publish_mu_);
+  topology_ = std::move(topology);
+  epoch_.store(next_topology_epoch.fetch_add(1, std::memory_order_relaxed), std::memory_order_release);
+}
+
+// Replace the node in the copied topology, since the nodes of the published topology are immutable
+void Cluster::replaceNode(ClusterTopology *topology, const std::shared_ptr<ClusterNode> &old_node,
+                          const std::shared_ptr<ClusterNode> &new_node) {
+  topology->nodes[new_node->id_] = new_node;
+  for (auto &slots_node : topology->slots_nodes) {
+    if (slots_node == old_node) slots_node = new_node;
   }
+  if (topology->myself == old_node) topology->myself = new_node;
 }
 
-// We access cluster without lock, actually we guarantee data-safe by work threads
-// ReadWriteLockGuard, CLUSTER command doesn't have 'exclusive' attribute, i.e.
-// CLUSTER command can be executed concurrently, but some subcommand may change
-// cluster data, so these commands should be executed exclusively, and ReadWriteLock
-// also can guarantee accessing data is safe.
+// The commands only read the published topology, and the topology updates publish the new
+// topology that is serialized by 'update_mu_', so they needn't be executed exclusively.
+// But some subcommands may change the replication relationship like SLAVEOF command, or
+// the state of the importing connection, these commands should be executed exclusively.
 bool Cluster::SubCommandIsExecExclusive(const std::string &subcommand) {
   if (strcasecmp("setnodes", subcommand.c_str()) == 0) {
     return true;
   } else if (strcasecmp("setnodeid", subcommand.c_str()) == 0) {
     return true;
-  } else if (strcasecmp("setslot", subcommand.c_str()) == 0) {
-    return true;
   } else if (strcasecmp("import", subcommand.c_str()) == 0) {
     return true;
   }
@@ -82,16 +112,21 @@ Status Cluster::SetNodeId(const std::string &node_id) {
     return Status(Status::ClusterInvalidInfo, errInvalidNodeID);
   }
 
-  myid_ = node_id;
+  std::lock_guard<std::mutex> guard(update_mu_);
+  auto topology = std::make_shared<ClusterTopology>(*topology_);
+  topology->myid = node_id;
   // Already has cluster topology
-  if (version_ >= 0 && nodes_.find(node_id) != nodes_.end()) {
-    myself_ = nodes_[myid_];
+  auto iter = topology->nodes.find(node_id);
+  if (topology->version >= 0 && iter != topology->nodes.end()) {
+    topology->myself = iter->second;
   } else {
-    myself_ = nullptr;
+    topology->myself = nullptr;
   }
+  bool has_myself = topology->myself != nullptr;
+  publish(std::move(topology));
 
   // Set replication relationship
-  if (myself_ != nullptr) SetMasterSlaveRepl();
+  if (has_myself) SetMasterSlaveRepl();
 
   return Status::OK();
 }
@@ -107,12 +142,16 @@ Status Cluster::SetNodeId(const std::string &node_id) {
 // This is different with CLUSTERX SETNODES commands because it uses new version
 // topology to cover current version, it allows kvrocks nodes lost some topology
 // updates since of network failure, it is state instead of operation.
-Status Cluster::SetSlot(int slot, const std::string &node_id, int64_t new_version) {
+//
+// The continuous slots can be set together, e.g. after they are migrated by one job,
+// and the topology is published only once for all of them.
+Status Cluster::SetSlot(const SlotRange &slots, const std::string &node_id, int64_t new_version) {
+  std::lock_guard<std::mutex> guard(update_mu_);
   // Parameters check
-  if (new_version <= 0 || new_version != version_ + 1) {
+  if (new_version <= 0 || new_version != topology_->version + 1) {
     return Status(Status::NotOK, errInvalidClusterVersion);
   }
-  if (!IsValidSlot(slot)) {
+  if (!slots.IsValid()) {
     return Status(Status::NotOK, errInvalidSlotID);
   }
   if (node_id.size() != kClusterNodeIdLen) {
@@ -120,40 +159,56 @@ Status Cluster::SetSlot(int slot, const std::string &node_id, int64_t new_versio
   }
 
   // Get the node which we want to assign a slot into it
-  std::shared_ptr<ClusterNode> to_assign_node = nodes_[node_id];
-  if (to_assign_node == nullptr) {
+  auto iter = topology_->nodes.find(node_id);
+  if (iter == topology_->nodes.end() || iter->second == nullptr) {
     return Status(Status::NotOK, "No this node in the cluster");
   }
+  std::shared_ptr<ClusterNode> to_assign_node = iter->second;
   if (to_assign_node->role_ != kClusterMaster) {
     return Status(Status::NotOK, errNoMasterNode);
   }
 
   // Update version
-  version_ = new_version;
+  auto topology = std::make_shared<ClusterTopology>(*topology_);
+  topology->version = new_version;
 
   // Update topology
   //  1. Remove the slot from old node if existing
   //  2. Add the slot into to-assign node
   //  3. Update the map of slots to nodes.
-  std::shared_ptr<ClusterNode> old_node = slots_nodes_[slot];
-  if (old_node != nullptr) {
-    old_node->slots_[slot] = false;
-  }
-  to_assign_node->slots_[slot] = true;
-  slots_nodes_[slot] = to_assign_node;
-
-  // Clear data of migrated slot or record of imported slot
-  if (old_node == myself_ && old_node != to_assign_node) {
-    // If slot is migrated from this node
-    if (migrated_slots_.count(slot)) {
-      svr_->slot_migrate_->ClearKeysOfSlot(kDefaultNamespace, slot);
-      migrated_slots_.erase(slot);
+  // Every changed node is copied only once, no matter how many slots it loses.
+  auto new_to_assign_node = std::make_shared<ClusterNode>(*to_assign_node);
+  replaceNode(topology.get(), to_assign_node, new_to_assign_node);
+  std::set<ClusterNode *> copied_nodes = {new_to_assign_node.get()};
+  std::vector<int> migrated_slots;
+  for (int slot = slots.start; slot <= slots.end; slot++) {
+    std::shared_ptr<ClusterNode> old_node = topology->slots_nodes[slot];
+    if (old_node != nullptr && old_node != new_to_assign_node) {
+      if (copied_nodes.count(old_node.get()) == 0) {
+        auto new_old_node = std::make_shared<ClusterNode>(*old_node);
+        replaceNode(topology.get(), old_node, new_old_node);
+        copied_nodes.insert(new_old_node.get());
+        old_node = std::move(new_old_node);
+      }
+      old_node->slots_[slot] = false;
     }
-    // If slot is imported into this node
-    if (imported_slots_.count(slot)) {
-      imported_slots_.erase(slot);
+    new_to_assign_node->slots_[slot] = true;
+    topology->slots_nodes[slot] = new_to_assign_node;
+
+    // Clear data of migrated slot or record of imported slot
+    if (topology_->slots_nodes[slot] == topology_->myself && to_assign_node != topology_->myself) {
+      // If slot is migrated from this node
+      if (topology->migrated_slots.erase(slot) > 0) migrated_slots.push_back(slot);
+      // If slot is imported into this node
+      topology->imported_slots.erase(slot);
     }
   }
+  publish(std::move(topology));
+
+  // The requests of the slots have been moved to the new node after publishing the topology
+  for (int slot : migrated_slots) {
+    svr_->slot_migrate_->ClearKeysOfSlot(kDefaultNamespace, slot);
+  }
 
   return Status::OK();
 }
@@ -163,70 +218,69 @@ Status Cluster::SetSlot(int slot, const std::string &node_id, int64_t new_versio
 Status Cluster::SetClusterNodes(const std::string &nodes_str, int64_t version, bool force) {
   if (version < 0) return Status(Status::NotOK, errInvalidClusterVersion);
 
+  std::lock_guard<std::mutex> guard(update_mu_);
   if (force == false) {
     // Low version wants to reset current version
-    if (version_ > version) {
+    if (topology_->version > version) {
       return Status(Status::NotOK, errInvalidClusterVersion);
     }
     // The same version, it is not needed to update
-    if (version_ == version) return Status::OK();
+    if (topology_->version == version) return Status::OK();
   }
 
-  ClusterNodes nodes;
+  // Update version and cluster topology, the migrated and imported slot info are cleared
+  auto topology = std::make_shared<ClusterTopology>();
   std::unordered_map<int, std::string> slots_nodes;
-  Status s = ParseClusterNodes(nodes_str, &nodes, &slots_nodes);
+  Status s = ParseClusterNodes(nodes_str, &topology->nodes, &slots_nodes);
   if (!s.IsOK()) return s;
 
-  // Update version and cluster topology
-  version_ = version;
-  nodes_ = nodes;
-  size_ = 0;
+  topology->version = version;
+  topology->myid = topology_->myid;
+  ClusterNodes &nodes = topology->nodes;
 
   // Update slots to nodes
   for (const auto &n : slots_nodes) {
-    slots_nodes_[n.first] = nodes_[n.second];
+    topology->slots_nodes[n.first] = nodes[n.second];
   }
 
   // Update replicas info and size
-  for (auto &n : nodes_) {
+  for (auto &n : nodes) {
     if (n.second->role_ == kClusterSlave) {
-      if (nodes_.find(n.second->master_id_) != nodes_.end()) {
-        nodes_[n.second->master_id_]->replicas.push_back(n.first);
+      if (nodes.find(n.second->master_id_) != nodes.end()) {
+        nodes[n.second->master_id_]->replicas.push_back(n.first);
       }
     }
     if (n.second->role_ == kClusterMaster && n.second->slots_.count() > 0) {
-      size_++;
+      topology->size++;
     }
   }
 
   // Find myself
-  if (myid_.empty() || force) {
-    for (auto &n : nodes_) {
+  if (topology->myid.empty() || force) {
+    for (auto &n : nodes) {
       if (n.second->port_ == port_ && std::find(binds_.begin(), binds_.end(), n.second->host_) != binds_.end()) {
-        myid_ = n.first;
+        topology->myid = n.first;
         break;
       }
     }
   }
-  myself_ = nullptr;
-  if (!myid_.empty() && nodes_.find(myid_) != nodes_.end()) {
-    myself_ = nodes_[myid_];
+  if (!topology->myid.empty() && nodes.find(topology->myid) != nodes.end()) {
+    topology->myself = nodes[topology->myid];
   }
 
+  std::shared_ptr<const ClusterTopology> old_topology = topology_;
+  std::shared_ptr<const ClusterTopology> new_topology = std::move(topology);
+  publish(new_topology);
+
   // Set replication relationship
-  if (myself_ != nullptr) SetMasterSlaveRepl();
+  if (new_topology->myself != nullptr) SetMasterSlaveRepl();
 
   // Clear data of migrated slots
-  if (!migrated_slots_.empty()) {
-    for (auto &it : migrated_slots_) {
-      if (slots_nodes_[it.first] != myself_) {
-        svr_->slot_migrate_->ClearKeysOfSlot(kDefaultNamespace, it.first);
-      }
+  for (const auto &it : old_topology->migrated_slots) {
+    if (new_topology->slots_nodes[it.first] != new_topology->myself) {
+      svr_->slot_migrate_->ClearKeysOfSlot(kDefaultNamespace, it.first);
     }
   }
-  // Clear migrated and imported slot info
-  migrated_slots_.clear();
-  imported_slots_.clear();
 
   return Status::OK();
 }
@@ -234,15 +288,17 @@ Status Cluster::SetClusterNodes(const std::string &nodes_str, int64_t version, b
 // Set replication relationship by cluster topology setting
 void Cluster::SetMasterSlaveRepl() {
   if (svr_ == nullptr) return;
-  if (myself_ == nullptr) return;
+  const auto &topology = this->topology();
+  const auto &myself = topology.myself;
+  if (myself == nullptr) return;
 
-  if (myself_->role_ == kClusterMaster) {
+  if (myself->role_ == kClusterMaster) {
     // Master mode
     svr_->RemoveMaster();
     LOG(INFO) << "MASTER MODE enabled by cluster topology setting";
-  } else if (nodes_.find(myself_->master_id_) != nodes_.end()) {
+  } else if (auto iter = topology.nodes.find(myself->master_id_); iter != topology.nodes.end()) {
     // Slave mode and master node is existing
-    std::shared_ptr<ClusterNode> master = nodes_[myself_->master_id_];
+    std::shared_ptr<ClusterNode> master = iter->second;
     Status s = svr_->AddMaster(master->host_, master->port_, false);
     if (s.IsOK()) {
       LOG(INFO) << "SLAVE OF " << master->host_ << ":" << master->port_ << " enabled by cluster topology setting";
@@ -253,93 +309,115 @@ void Cluster::SetMasterSlaveRepl() {
   }
 }
 
-bool Cluster::IsNotMaster() { return myself_ == nullptr || myself_->role_ != kClusterMaster || svr_->IsSlave(); }
+bool Cluster::IsNotMaster() { return isNotMaster(topology()); }
+
+bool Cluster::isNotMaster(const ClusterTopology &topology) {
+  return topology.myself == nullptr || topology.myself->role_ != kClusterMaster || svr_->IsSlave();
+}
 
-Status Cluster::SetSlotMigrated(int slot, const std::string &ip_port) {
-  if (!IsValidSlot(slot)) {
+Status Cluster::SetSlotMigrated(const SlotRange &slots, const std::string &ip_port) {
+  if (!slots.IsValid()) {
     return Status(Status::NotOK, errSlotOutOfRange);
   }
-  // It is called by slot-migrating thread which is an asynchronous thread.
-  // Therefore, it should be locked when a record is added to 'migrated_slots_'
-  // which will be accessed when executing commands.
-  auto exclusivity = svr_->WorkExclusivityGuard();
-  migrated_slots_[slot] = ip_port;
+  // It is called by slot-migrating thread which is an asynchronous thread, the writes
+  // of the slot have been forbidden, so the commands needn't be blocked while the record
+  // is added to the migrated slots
+  std::lock_guard<std::mutex> guard(update_mu_);
+  auto topology = std::make_shared<ClusterTopology>(*topology_);
+  for (int slot = slots.start; slot <= slots.end; slot++) {
+    topology->migrated_slots[slot] = ip_port;
+  }
+  publish(std::move(topology));
   return Status::OK();
 }
 
-Status Cluster::SetSlotImported(int slot) {
-  if (!IsValidSlot(slot)) {
+Status Cluster::SetSlotImported(const SlotRange &slots) {
+  if (!slots.IsValid()) {
     return Status(Status::NotOK, errSlotOutOfRange);
   }
-  // It is called by command 'cluster import'. When executing the command, the
-  // exclusive lock has been locked. Therefore, it can't be locked again.
-  imported_slots_.insert(slot);
+  // It is called by command 'cluster import'
+  std::lock_guard<std::mutex> guard(update_mu_);
+  auto topology = std::make_shared<ClusterTopology>(*topology_);
+  for (int slot = slots.start; slot <= slots.end; slot++) {
+    topology->imported_slots.insert(slot);
+  }
+  publish(std::move(topology));
   return Status::OK();
 }
 
-Status Cluster::MigrateSlot(int slot, const std::string &dst_node_id) {
-  if (nodes_.find(dst_node_id) == nodes_.end()) {
+Status Cluster::MigrateSlot(const SlotRange &slots, const std::string &dst_node_id) {
+  const auto &topology = this->topology();
+  auto iter = topology.nodes.find(dst_node_id);
+  if (iter == topology.nodes.end()) {
     return Status(Status::NotOK, "Can't find the destination node id");
   }
-  if (!IsValidSlot(slot)) {
+  if (!slots.IsValid()) {
     return Status(Status::NotOK, errSlotOutOfRange);
   }
-  if (slots_nodes_[slot] != myself_) {
-    return Status(Status::NotOK, "Can't migrate slot which doesn't belong to me");
+  for (int slot = slots.start; slot <= slots.end; slot++) {
+    if (topology.slots_nodes[slot] != topology.myself) {
+      return Status(Status::NotOK, "Can't migrate slot which doesn't belong to me");
+    }
   }
-  if (IsNotMaster()) {
+  if (isNotMaster(topology)) {
     return Status(Status::NotOK, "Slave can't migrate slot");
   }
-  if (nodes_[dst_node_id]->role_ != kClusterMaster) {
+  if (iter->second->role_ != kClusterMaster) {
     return Status(Status::NotOK, "Can't migrate slot to a slave");
   }
-  if (nodes_[dst_node_id] == myself_) {
+  if (iter->second == topology.myself) {
     return Status(Status::NotOK, "Can't migrate slot to myself");
   }
 
-  const auto dst = nodes_[dst_node_id];
-  Status s = svr_->slot_migrate_->MigrateStart(svr_, dst_node_id, dst->host_, dst->port_, slot,
+  const auto dst = iter->second;
+  Status s = svr_->slot_migrate_->MigrateStart(svr_, dst_node_id, dst->host_, dst->port_, slots,
                                                svr_->GetConfig()->migrate_speed, svr_->GetConfig()->pipeline_size,
                                                svr_->GetConfig()->sequence_gap);
   return s;
 }
 
-Status Cluster::ImportSlot(Redis::Connection *conn, int slot, int state) {
+Status Cluster::ImportSlot(Redis::Connection *conn, const SlotRange &slots, int state) {
   if (IsNotMaster()) {
     return Status(Status::NotOK, "Slave can't import slot");
   }
-  if (!IsValidSlot(slot)) {
+  if (!slots.IsValid()) {
     return Status(Status::NotOK, errSlotOutOfRange);
   }
 
+  std::string slot = slots.String();
   switch (state) {
     case kImportStart:
-      if (!svr_->slot_import_->Start(conn->GetFD(), slot)) {
+      if (!svr_->slot_import_->Start(conn->GetFD(), slots)) {
         return {Status::NotOK, fmt::format("Can't start importing slot {}", slot)};
       }
       // Set link importing
       conn->SetImporting();
-      myself_->importing_slot_ = slot;
+      {
+        std::lock_guard<std::mutex> guard(update_mu_);
+        auto topology = std::make_shared<ClusterTopology>(*topology_);
+        topology->importing_slots = slots;
+        publish(std::move(topology));
+      }
       // Set link error callback
       conn->close_cb_ = [object_ptr = svr_->slot_import_, capture_fd = conn->GetFD()](int fd) {
         object_ptr->StopForLinkError(capture_fd);
       };
       // Stop forbidding writing slot to accept write commands
-      if (slot == svr_->slot_migrate_->GetForbiddenSlot()) svr_->slot_migrate_->ReleaseForbiddenSlot();
+      if (slots.Overlaps(svr_->slot_migrate_->GetForbiddenSlots())) svr_->slot_migrate_->ReleaseForbiddenSlots();
       LOG(INFO) << "[import] Start importing slot " << slot;
       break;
     case kImportSuccess:
-      if (!svr_->slot_import_->Success(slot)) {
+      if (!svr_->slot_import_->Success(slots)) {
         LOG(ERROR) << "[import] Failed to set slot importing success, maybe slot is wrong"
-                   << ", received slot: " << slot << ", current slot: " << svr_->slot_import_->GetSlot();
+                   << ", received slot: " << slot << ", current slot: " << svr_->slot_import_->GetSlots().String();
         return {Status::NotOK, fmt::format("Failed to set slot {} importing success", slot)};
       }
       LOG(INFO) << "[import] Succeed to import slot " << slot;
       break;
     case kImportFailed:
-      if (!svr_->slot_import_->Fail(slot)) {
+      if (!svr_->slot_import_->Fail(slots)) {
         LOG(ERROR) << "[import] Failed to set slot importing error, maybe slot is wrong"
-                   << ", received slot: " << slot << ", current slot: " << svr_->slot_import_->GetSlot();
+                   << ", received slot: " << slot << ", current slot: " << svr_->slot_import_->GetSlots().String();
         return {Status::NotOK, fmt::format("Failed to set slot {} importing error", slot)};
       }
       LOG(INFO) << "[import] Failed to import slot " << slot;
@@ -351,13 +429,14 @@ Status Cluster::ImportSlot(Redis::Connection *conn, int slot, int state) {
 }
 
 Status Cluster::GetClusterInfo(std::string *cluster_infos) {
-  if (version_ < 0) {
+  const auto &topology = this->topology();
+  if (topology.version < 0) {
     return Status(Status::ClusterDown, errClusterNoInitialized);
   }
   cluster_infos->clear();
 
   int ok_slot = 0;
-  for (auto &slots_node : slots_nodes_) {
+  for (auto &slots_node : topology.slots_nodes) {
     if (slots_node != nullptr) ok_slot++;
   }
 
@@ -372,18 +451,18 @@ Status Cluster::GetClusterInfo(std::string *cluster_infos) {
       "cluster_slots_pfail:0\r\n"
       "cluster_slots_fail:0\r\n"
       "cluster_known_nodes:" +
-      std::to_string(nodes_.size()) +
+      std::to_string(topology.nodes.size()) +
       "\r\n"
       "cluster_size:" +
-      std::to_string(size_) +
+      std::to_string(topology.size) +
       "\r\n"
       "cluster_current_epoch:" +
-      std::to_string(version_) +
+      std::to_string(topology.version) +
       "\r\n"
       "cluster_my_epoch:" +
-      std::to_string(version_) + "\r\n";
+      std::to_string(topology.version) + "\r\n";
 
-  if (myself_ != nullptr && myself_->role_ == kClusterMaster && !svr_->IsSlave()) {
+  if (topology.myself != nullptr && topology.myself->role_ == kClusterMaster && !svr_->IsSlave()) {
     // Get migrating status
     std::string migrate_infos;
     svr_->slot_migrate_->GetMigrateInfo(&migrate_infos);
@@ -408,7 +487,9 @@ Status Cluster::GetClusterInfo(std::string *cluster_infos) {
 //               3) node ID
 //          ... continued until done
 Status Cluster::GetSlotsInfo(std::vector<SlotInfo> *slots_infos) {
-  if (version_ < 0) {
+  const auto &topology = this->topology();
+  const auto &slots_nodes = topology.slots_nodes;
+  if (topology.version < 0) {
     return Status(Status::ClusterDown, errClusterNoInitialized);
   }
   slots_infos->clear();
@@ -419,28 +500,30 @@ Status Cluster::GetSlotsInfo(std::vector<SlotInfo> *slots_infos) {
     // Find start node and slot id
     if (n == nullptr) {
       if (i == kClusterSlots) break;
-      n = slots_nodes_[i];
+      n = slots_nodes[i];
       start = i;
       continue;
     }
     // Generate slots info when occur different node with start or end of slot
-    if (i == kClusterSlots || n != slots_nodes_[i]) {
-      slots_infos->emplace_back(GenSlotNodeInfo(start, i - 1, n));
+    if (i == kClusterSlots || n != slots_nodes[i]) {
+      slots_infos->emplace_back(GenSlotNodeInfo(topology, start, i - 1, n));
       if (i == kClusterSlots) break;
-      n = slots_nodes_[i];
+      n = slots_nodes[i];
       start = i;
     }
   }
   return Status::OK();
 }
 
-SlotInfo Cluster::GenSlotNodeInfo(int start, int end, const std::shared_ptr<ClusterNode> &n) {
+SlotInfo Cluster::GenSlotNodeInfo(const ClusterTopology &topology, int start, int end,
+                                  const std::shared_ptr<ClusterNode> &n) {
   std::vector<SlotInfo::NodeInfo> vn;
   vn.push_back({n->host_, n->port_, n->id_});  // itself
 
   for (const auto &id : n->replicas) {  // replicas
-    if (nodes_.find(id) == nodes_.end()) continue;
-    vn.push_back({nodes_[id]->host_, nodes_[id]->port_, nodes_[id]->id_});
+    auto iter = topology.nodes.find(id);
+    if (iter == topology.nodes.end()) continue;
+    vn.push_back({iter->second->host_, iter->second->port_, iter->second->id_});
   }
   return {start, end, vn};
 }
@@ -448,41 +531,44 @@ SlotInfo Cluster::GenSlotNodeInfo(int start, int end, const std::shared_ptr<Clus
 // $node $host:$port@$cport $role $master_id/$- $ping_sent $ping_received
 // $version $connected $slot_range
 Status Cluster::GetClusterNodes(std::string *nodes_str) {
-  if (version_ < 0) {
+  const auto &topology = this->topology();
+  if (topology.version < 0) {
     return Status(Status::ClusterDown, errClusterNoInitialized);
   }
 
-  *nodes_str = GenNodesDescription();
+  *nodes_str = GenNodesDescription(topology);
   return Status::OK();
 }
 
-std::string Cluster::GenNodesDescription() {
-  // Generate slots info firstly
+std::string Cluster::GenNodesDescription(const ClusterTopology &topology) {
+  // Generate slots info firstly, the published nodes are immutable, so collect them by node id
+  const auto &slots_nodes = topology.slots_nodes;
+  std::unordered_map<std::string, std::string> slots_infos;
   int start = -1;
   std::shared_ptr<ClusterNode> n = nullptr;
   for (int i = 0; i <= kClusterSlots; i++) {
     // Find start node and slot id
     if (n == nullptr) {
       if (i == kClusterSlots) break;
-      n = slots_nodes_[i];
+      n = slots_nodes[i];
       start = i;
       continue;
     }
     // Generate slots info when occur different node with start or end of slot
-    if (i == kClusterSlots || n != slots_nodes_[i]) {
+    if (i == kClusterSlots || n != slots_nodes[i]) {
       if (start == i - 1) {
-        n->slots_info_ += fmt::format("{} ", start);
+        slots_infos[n->id_] += fmt::format("{} ", start);
       } else {
-        n->slots_info_ += fmt::format("{}-{} ", start, i - 1);
+        slots_infos[n->id_] += fmt::format("{}-{} ", start, i - 1);
       }
       if (i == kClusterSlots) break;
-      n = slots_nodes_[i];
+      n = slots_nodes[i];
       start = i;
     }
   }
 
   std::string nodes_desc;
-  for (const auto &item : nodes_) {
+  for (const auto &item : topology.nodes) {
     const std::shared_ptr<ClusterNode> n = item.second;
 
     std::string node_str;
@@ -491,7 +577,7 @@ std::string Cluster::GenNodesDescription() {
     node_str.append(fmt::format("{}:{}@{} ", n->host_, n->port_, n->port_ + kClusterPortIncr));
 
     // Flags
-    if (n->id_ == myid_) node_str.append("myself,");
+    if (n->id_ == topology.myid) node_str.append("myself,");
     if (n->role_ == kClusterMaster) {
       node_str.append("master - ");
     } else {
@@ -500,14 +586,14 @@ std::string Cluster::GenNodesDescription() {
 
     // Ping sent, pong received, config epoch, link status
     auto now = Util::GetTimeStampMS();
-    node_str.append(fmt::format("{} {} {} connected", now - 1, now, version_));
+    node_str.append(fmt::format("{} {} {} connected", now - 1, now, topology.version));
 
     // Slots
-    if (n->slots_info_.size() > 0) n->slots_info_.pop_back();  // Trim space
-    if (n->role_ == kClusterMaster && n->slots_info_.size() > 0) {
-      node_str.append(" " + n->slots_info_);
+    std::string &slots_info = slots_infos[n->id_];
+    if (slots_info.size() > 0) slots_info.pop_back();  // Trim space
+    if (n->role_ == kClusterMaster && slots_info.size() > 0) {
+      node_str.append(" " + slots_info);
     }
-    n->slots_info_.clear();  // Reset
 
     nodes_desc.append(node_str + "\n");
   }
@@ -622,10 +708,20 @@ Status Cluster::ParseClusterNodes(const std::string &nodes_str, ClusterNodes *no
 }
 
 bool Cluster::IsWriteForbiddenSlot(int slot) {
-  if (svr_->slot_migrate_->GetForbiddenSlot() == slot) {
-    return true;
-  }
-  return false;
+  return svr_->slot_migrate_->IsForbiddenSlot(slot);
+}
+
+bool Cluster::IsImportingSlot(int slot) {
+  const auto &topology = this->topology();
+  return topology.importing_slots.Contains(slot) && topology.myself &&
+         topology.slots_nodes[slot] != topology.myself && topology.imported_slots.count(slot) == 0;
+}
+
+// Whether the master of the node is the given node
+static bool isMasterOf(const ClusterTopology &topology, const std::shared_ptr<ClusterNode> &node,
+                       const std::shared_ptr<ClusterNode> &master) {
+  auto iter = topology.nodes.find(node->master_id_);
+  return iter != topology.nodes.end() && iter->second == master;
 }
 
 Status Cluster::CanExecByMySelf(const Redis::CommandAttributes *attributes, const std::vector<std::string> &cmd_tokens,
@@ -636,25 +732,45 @@ Status Cluster::CanExecByMySelf(const Redis::CommandAttributes *attributes, cons
   if (!s.IsOK()) return Status::OK();
   if (keys_indexes.size() == 0) return Status::OK();
 
-  int slot = -1;
+  // The keys may hash to different slots only if all slots are served by myself
+  bool allow_cross_slot = svr_ && svr_->GetConfig()->cluster_allow_local_cross_slot;
+  std::vector<int> slots;
   for (auto i : keys_indexes) {
     if (i >= static_cast<int>(cmd_tokens.size())) break;
     int cur_slot = GetSlotNumFromKey(cmd_tokens[i]);
-    if (slot == -1) slot = cur_slot;
-    if (slot != cur_slot) {
+    if (slots.empty() || (slots.back() != cur_slot && allow_cross_slot)) {
+      slots.push_back(cur_slot);
+    } else if (slots.back() != cur_slot) {
       return {Status::RedisExecErr, "CROSSSLOT Attempted to access keys that don't hash to the same slot"};
     }
   }
-  if (slot == -1) return Status::OK();
+  if (slots.empty()) return Status::OK();
+  if (slots.size() > 1) {
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+  }
+
+  const auto &topology = this->topology();
+  for (int slot : slots) {
+    s = canExecOnSlot(topology, attributes, slot, conn);
+    if (!s.IsOK()) return s;
+  }
+  return Status::OK();
+}
 
-  if (slots_nodes_[slot] == nullptr) {
+Status Cluster::canExecOnSlot(const ClusterTopology &topology, const Redis::CommandAttributes *attributes,
+                              int slot, Redis::Connection *conn) {
+  const auto &myself = topology.myself;
+  const auto &slots_nodes = topology.slots_nodes;
+  if (slots_nodes[slot] == nullptr) {
     return {Status::ClusterDown, "CLUSTERDOWN Hash slot not served"};
-  } else if (myself_ && myself_ == slots_nodes_[slot]) {
+  } else if (myself && myself == slots_nodes[slot]) {
     // We use central controller to manage the topology of the cluster.
     // Server can't change the topology directly, so we record the migrated slots
     // to move the requests of the migrated slots to the destination node.
-    if (migrated_slots_.count(slot)) {  // I'm not serving the migrated slot
-      return {Status::RedisExecErr, fmt::format("MOVED {} {}", slot, migrated_slots_[slot])};
+    if (auto iter = topology.migrated_slots.find(slot);
+        iter != topology.migrated_slots.end()) {  // I'm not serving the migrated slot
+      return {Status::RedisExecErr, fmt::format("MOVED {} {}", slot, iter->second)};
     }
     // To keep data consistency, slot will be forbidden write while sending the last incremental data.
     // During this phase, the requests of the migrating slot has to be rejected.
@@ -662,22 +778,22 @@ Status Cluster::CanExecByMySelf(const Redis::CommandAttributes *attributes, cons
       return {Status::RedisExecErr, "Can't write to slot being migrated which is in write forbidden phase"};
     }
     return Status::OK();  // I'm serving this slot
-  } else if (myself_ && myself_->importing_slot_ == slot && conn->IsImporting()) {
+  } else if (myself && topology.importing_slots.Contains(slot) && conn->IsImporting()) {
     // While data migrating, the topology of the destination node has not been changed.
     // The destination node has to serve the requests from the migrating slot,
     // although the slot is not belong to itself. Therefore, we record the importing slot
     // and mark the importing connection to accept the importing data.
     return Status::OK();  // I'm serving the importing connection
-  } else if (myself_ && imported_slots_.count(slot)) {
+  } else if (myself && topology.imported_slots.count(slot)) {
     // After the slot is migrated, new requests of the migrated slot will be moved to
     // the destination server. Before the central controller change the topology, the destination
     // server should record the imported slots to accept new data of the imported slots.
     return Status::OK();  // I'm serving the imported slot
-  } else if (myself_ && myself_->role_ == kClusterSlave && attributes->is_write() == false &&
-             nodes_.find(myself_->master_id_) != nodes_.end() && nodes_[myself_->master_id_] == slots_nodes_[slot]) {
+  } else if (myself && myself->role_ == kClusterSlave && attributes->is_write() == false &&
+             isMasterOf(topology, myself, slots_nodes[slot])) {
     return Status::OK();  // My mater is serving this slot
   } else {
     return {Status::RedisExecErr,
-            fmt::format("MOVED {} {}:{}", slot, slots_nodes_[slot]->host_, slots_nodes_[slot]->port_)};
+            fmt::format("MOVED {} {}:{}", slot, slots_nodes[slot]->host_, slots_nodes[slot]->port_)};
   }
 }
@@ -23,7 +23,9 @@
 #include <algorithm>
 #include <bitset>
 #include <map>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -52,10 +54,8 @@ class ClusterNode {
   int port_;
   int role_;
   std::string master_id_;
-  std::string slots_info_;
   std::bitset<kClusterSlots> slots_;
   std::vector<std::string> replicas;
-  int importing_slot_ = -1;
 };
 
 struct SlotInfo {
@@ -71,6 +71,21 @@ struct SlotInfo {
 
 using ClusterNodes = std::unordered_map<std::string, std::shared_ptr<ClusterNode>>;
 
+// The snapshot of the cluster topology, it's immutable after being published, including the
+// nodes it points to. The topology updates copy the current snapshot, change the copy and
+// publish it, so the commands can route the keys without any lock.
+struct ClusterTopology {
+  int64_t version = -1;
+  int size = 0;
+  std::string myid;
+  std::shared_ptr<ClusterNode> myself;
+  ClusterNodes nodes;
+  std::shared_ptr<ClusterNode> slots_nodes[kClusterSlots];
+  std::map<int, std::string> migrated_slots;
+  std::set<int> imported_slots;
+  SlotRange importing_slots;
+};
+
 class Server;
 
 class Cluster {
@@ -79,39 +94,50 @@ class Cluster {
   Status SetClusterNodes(const std::string &nodes_str, int64_t version, bool force);
   Status GetClusterNodes(std::string *nodes_str);
   Status SetNodeId(const std::string &node_id);
-  Status SetSlot(int slot, const std::string &node_id, int64_t version);
-  Status SetSlotMigrated(int slot, const std::string &ip_port);
-  Status SetSlotImported(int slot);
+  Status SetSlot(const SlotRange &slots, const std::string &node_id, int64_t version);
+  Status SetSlotMigrated(const SlotRange &slots, const std::string &ip_port);
+  Status SetSlotImported(const SlotRange &slots);
   Status GetSlotsInfo(std::vector<SlotInfo> *slot_infos);
   Status GetClusterInfo(std::string *cluster_infos);
-  int64_t GetVersion() const { return version_; }
+  int64_t GetVersion() const { return topology().version; }
   static bool IsValidSlot(int slot) { return slot >= 0 && slot < kClusterSlots; }
   bool IsNotMaster();
   bool IsWriteForbiddenSlot(int slot);
+  // Whether the slot is being imported and not served by myself, so only the importing connection writes it
+  bool IsImportingSlot(int slot);
   Status CanExecByMySelf(const Redis::CommandAttributes *attributes, const std::vector<std::string> &cmd_tokens,
                          Redis::Connection *conn);
   void SetMasterSlaveRepl();
-  Status MigrateSlot(int slot, const std::string &dst_node_id);
-  Status ImportSlot(Redis::Connection *conn, int slot, int state);
-  std::string GetMyId() const { return myid_; }
+  Status MigrateSlot(const SlotRange &slots, const std::string &dst_node_id);
+  Status ImportSlot(Redis::Connection *conn, const SlotRange &slots, int state);
+  std::string GetMyId() const { return topology().myid; }
 
   static bool SubCommandIsExecExclusive(const std::string &subcommand);
 
  private:
-  std::string GenNodesDescription();
-  SlotInfo GenSlotNodeInfo(int start, int end, const std::shared_ptr<ClusterNode> &n);
+  // Return the current topology, which is cached by the calling thread and stays valid until
+  // this thread calls it again, it only takes the lock when the topology has been changed.
+  const ClusterTopology &topology() const;
+  // Publish the new topology, should be called with update_mu_ locked
+  void publish(std::shared_ptr<const ClusterTopology> topology);
+  bool isNotMaster(const ClusterTopology &topology);
+  Status canExecOnSlot(const ClusterTopology &topology, const Redis::CommandAttributes *attributes, int slot,
+                       Redis::Connection *conn);
+  static void replaceNode(ClusterTopology *topology, const std::shared_ptr<ClusterNode> &old_node,
+                          const std::shared_ptr<ClusterNode> &new_node);
+  std::string GenNodesDescription(const ClusterTopology &topology);
+  static SlotInfo GenSlotNodeInfo(const ClusterTopology &topology, int start, int end,
+                                  const std::shared_ptr<ClusterNode> &n);
   Status ParseClusterNodes(const std::string &nodes_str, ClusterNodes *nodes,
                            std::unordered_map<int, std::string> *slots_nodes);
   Server *svr_;
   std::vector<std::string> binds_;
   int port_;
-  int size_;
-  int64_t version_;
-  std::string myid_;
-  std::shared_ptr<ClusterNode> myself_;
-  ClusterNodes nodes_;
-  std::shared_ptr<ClusterNode> slots_nodes_[kClusterSlots];
 
-  std::map<int, std::string> migrated_slots_;
-  std::set<int> imported_slots_;
+  // The topology updates are serialized by update_mu_, and publish_mu_ only protects topology_
+  // and epoch_ while publishing or fetching the topology
+  std::mutex update_mu_;
+  mutable std::mutex publish_mu_;
+  std::shared_ptr<const ClusterTopology> topology_;
+  std::atomic<uint64_t> epoch_{0};
 };
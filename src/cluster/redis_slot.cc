@@ -26,6 +26,8 @@
 #include <cstdlib>
 #include <string>
 
+#include "parse_util.h"
+
 static const uint16_t crc16tab[256] = {
     0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7, 0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad,
     0xe1ce, 0xf1ef, 0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6, 0x9339, 0x8318, 0xb37b, 0xa35a,
@@ -47,6 +49,26 @@ static const uint16_t crc16tab[256] = {
     0x1ce0, 0x0cc1, 0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8, 0x6e17, 0x7e36, 0x4e55, 0x5e74,
     0x2e93, 0x3eb2, 0x0ed1, 0x1ef0};
 
+std::string SlotRange::String() const {
+  if (start == end) return std::to_string(start);
+  return std::to_string(start) + "-" + std::to_string(end);
+}
+
+bool SlotRange::Parse(const std::string &str, SlotRange *range) {
+  auto valid_range = NumericRange<int>{0, HASH_SLOTS_SIZE - 1};
+  auto pos = str.find('-');
+  auto start = ParseInt<int>(str.substr(0, pos), valid_range, 10);
+  if (!start) return false;
+  if (pos == std::string::npos) {
+    *range = SlotRange(*start);
+    return true;
+  }
+  auto end = ParseInt<int>(str.substr(pos + 1), valid_range, 10);
+  if (!end || *end < *start) return false;
+  *range = SlotRange(*start, *end);
+  return true;
+}
+
 uint16_t crc16(const char *buf, int len) {
   int i = 0;
   uint16_t crc = 0;
@@ -26,6 +26,28 @@ constexpr const uint16_t HASH_SLOTS_MASK = 0x3fff;
 constexpr const uint16_t HASH_SLOTS_SIZE = HASH_SLOTS_MASK + 1;  // 16384
 constexpr const uint16_t HASH_SLOTS_MAX_ITERATIONS = 50;
 
+// The continuous slots [start, end], it's formatted as 'start-end', or 'start' if it has only one slot
+struct SlotRange {
+  int start = -1;
+  int end = -1;
+
+  SlotRange() = default;
+  SlotRange(int start, int end) : start(start), end(end) {}
+  explicit SlotRange(int slot) : start(slot), end(slot) {}
+
+  bool IsValid() const { return start >= 0 && start <= end && end < HASH_SLOTS_SIZE; }
+  bool Contains(int slot) const { return IsValid() && slot >= start && slot <= end; }
+  bool Overlaps(const SlotRange &other) const {
+    return IsValid() && other.IsValid() && start <= other.end && other.start <= end;
+  }
+  int Count() const { return IsValid() ? end - start + 1 : 0; }
+  bool operator==(const SlotRange &other) const { return start == other.start && end == other.end; }
+  bool operator!=(const SlotRange &other) const { return !(*this == other); }
+  std::string String() const;
+  // Parse the valid slot range from the string, return false if it's invalid
+  static bool Parse(const std::string &str, SlotRange *range);
+};
+
 uint16_t crc16(const char *buf, int len);
 uint16_t GetSlotNumFromKey(const std::string &key);
 std::string GetTagFromKey(const std::string &key);
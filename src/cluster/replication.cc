@@ -21,6 +21,7 @@
 #include "replication.h"
 
 #include <arpa/inet.h>
+#include <sys/socket.h>
 #include <event2/buffer.h>
 #include <event2/bufferevent.h>
 #include <event2/event.h>
@@ -28,38 +29,219 @@
 
 #include <algorithm>
 #include <csignal>
+#include <cstdlib>
 #include <future>
+#include <limits>
 #include <string>
 #include <thread>
+#include <unistd.h>
 
 #include "event_util.h"
 #include "fd_util.h"
+#include "encoding.h"
 #include "fmt/format.h"
 #include "io_util.h"
+#include "jemalloc_util.h"
+#include "parse_util.h"
 #include "rocksdb_crc32c.h"
 #include "server/redis_reply.h"
 #include "server/server.h"
 #include "status.h"
 #include "storage/batch_debugger.h"
+#include "string_util.h"
 #include "thread_util.h"
+#include "time_util.h"
+
+Status SendFileCompressed(int out_fd, int in_fd, size_t size, off_t offset) {
+  Util::ZstdStreamCompressor compressor;
+  std::vector<char> data(1024 * 1024);
+  std::string compressed;
+  while (size != 0) {
+    ssize_t n = pread(in_fd, data.data(), std::min(size, data.size()), offset);
+    if (n == -1 && errno == EINTR) continue;
+    if (n <= 0) return {Status::NotOK, n == 0 ? "unexpected end of file" : strerror(errno)};
+    size -= n;
+    offset += n;
+
+    compressed.clear();
+    auto s = compressor.Compress(data.data(), n, &compressed);
+    if (!s.IsOK()) return s;
+    s = Util::SockSend(out_fd, Redis::BulkString(compressed));
+    if (!s.IsOK()) return s;
+  }
+  return Status::OK();
+}
 
-Status FeedSlaveThread::Start() {
+Status CalculateFileCRC(int fd, size_t size, uint32_t *crc) {
+  std::vector<char> data(1024 * 1024);
+  uint32_t tmp_crc = 0;
+  off_t offset = 0;
+  while (size != 0) {
+    ssize_t n = pread(fd, data.data(), std::min(size, data.size()), offset);
+    if (n == -1 && errno == EINTR) continue;
+    if (n <= 0) return {Status::NotOK, n == 0 ? "unexpected end of file" : strerror(errno)};
+    tmp_crc = rocksdb::crc32c::Extend(tmp_crc, data.data(), n);
+    size -= n;
+    offset += n;
+  }
+  *crc = tmp_crc;
+  return Status::OK();
+}
+
+Status ReplBacklog::Start() {
+  reset(storage_->LatestSeq() + 1);
   try {
     t_ = std::thread([this]() {
-      Util::ThreadSetName("feed-replica");
-      sigset_t mask, omask;
-      sigemptyset(&mask);
-      sigemptyset(&omask);
-      sigaddset(&mask, SIGCHLD);
-      sigaddset(&mask, SIGHUP);
-      sigaddset(&mask, SIGPIPE);
-      pthread_sigmask(SIG_BLOCK, &mask, &omask);
-      Util::SockSend(conn_->GetFD(), "+OK\r\n");
+      Util::ThreadSetName("repl-backlog");
       this->loop();
     });
   } catch (const std::system_error &e) {
-    conn_ = nullptr;  // prevent connection was freed when failed to start the thread
-    return Status(Status::NotOK, e.what());
+    return {Status::NotOK, e.what()};
+  }
+  return Status::OK();
+}
+
+void ReplBacklog::Stop() {
+  stop_ = true;
+  if (t_.joinable()) t_.join();
+}
+
+void ReplBacklog::loop() {
+  uint32_t yield_microseconds = 2 * 1000;
+  std::unique_ptr<rocksdb::TransactionLogIterator> iter;
+  rocksdb::SequenceNumber next_seq = FirstSeq();
+  while (!stop_) {
+    if (!iter || !iter->Valid()) {
+      if (!storage_->WaitForWALData(next_seq, kWALWaitMicroseconds)) continue;
+      if (!storage_->GetWALIter(next_seq, &iter).IsOK()) {
+        iter = nullptr;
+        usleep(yield_microseconds);
+        continue;
+      }
+    }
+    auto batch = iter->GetBatch();
+    if (batch.sequence != next_seq) {
+      // The replicas would fall back to read the WAL, and find the lost sequence by themselves
+      LOG(WARNING) << "[replication] WAL iterator of the backlog is discrete, sequence " << next_seq
+                   << " expected, but got " << batch.sequence << ", reset the backlog";
+      next_seq = storage_->LatestSeq() + 1;
+      reset(next_seq);
+      iter = nullptr;
+      continue;
+    }
+    next_seq = batch.sequence + batch.writeBatchPtr->Count();
+    append(batch.sequence, batch.writeBatchPtr->Count(), batch.writeBatchPtr->Data());
+    // The writers wake up the thread once the WAL has new data
+    while (!stop_ && !storage_->WaitForWALData(next_seq, kWALWaitMicroseconds)) continue;
+    iter->Next();
+  }
+}
+
+void ReplBacklog::append(rocksdb::SequenceNumber seq, uint32_t count, std::string data) {
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    bytes_ += data.size();
+    batches_.push_back({seq, count, std::move(data)});
+    next_seq_ = seq + count;
+    // Keep the last batch even if it's larger than the backlog
+    while (bytes_ > max_bytes_ && batches_.size() > 1) {
+      bytes_ -= batches_.front().data.size();
+      batches_.pop_front();
+    }
+  }
+  cond_.notify_all();
+  wakeup();
+}
+
+void ReplBacklog::wakeup() {
+  if (int fd = wakeup_fd_ == -1 ? -1 : wakeup_fd_.exchange(-1); fd != -1) {
+    [[maybe_unused]] ssize_t n = write(fd, "", 1);
+  }
+}
+
+void ReplBacklog::reset(rocksdb::SequenceNumber next_seq) {
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    batches_.clear();
+    bytes_ = 0;
+    next_seq_ = next_seq;
+  }
+  wakeup();
+}
+
+bool ReplBacklog::containsLocked(rocksdb::SequenceNumber seq) const {
+  auto first_seq = batches_.empty() ? next_seq_ : batches_.front().seq;
+  return seq >= first_seq && seq <= next_seq_;
+}
+
+ReplBacklog::ReadResult ReplBacklog::Get(rocksdb::SequenceNumber seq, int64_t timeout_us, Batch *batch) {
+  std::unique_lock<std::mutex> lock(mu_);
+  if (!containsLocked(seq)) return ReadResult::kOutOfRange;
+  if (seq == next_seq_) {
+    cond_.wait_for(lock, std::chrono::microseconds(timeout_us), [this, seq] { return seq != next_seq_; });
+    // The backlog may be reset while waiting
+    if (!containsLocked(seq)) return ReadResult::kOutOfRange;
+    if (seq == next_seq_) return ReadResult::kNotYet;
+  }
+
+  // The batches are continuous, so find the batch by the binary search
+  auto iter = std::lower_bound(batches_.begin(), batches_.end(), seq,
+                               [](const Batch &b, rocksdb::SequenceNumber s) { return b.seq < s; });
+  if (iter == batches_.end() || iter->seq != seq) return ReadResult::kOutOfRange;
+  *batch = *iter;
+  return ReadResult::kOK;
+}
+
+bool ReplBacklog::ArmWakeup(int fd, rocksdb::SequenceNumber seq) {
+  // The batch is appended while holding the lock, so either it sees the armed fd or the armed
+  // fd sees the batch
+  wakeup_fd_ = fd;
+  std::lock_guard<std::mutex> guard(mu_);
+  if (seq == next_seq_ && containsLocked(seq)) return true;
+  wakeup_fd_.compare_exchange_strong(fd, -1);
+  return false;
+}
+
+bool ReplBacklog::Contains(rocksdb::SequenceNumber seq) {
+  std::lock_guard<std::mutex> guard(mu_);
+  return containsLocked(seq);
+}
+
+rocksdb::SequenceNumber ReplBacklog::FirstSeq() {
+  std::lock_guard<std::mutex> guard(mu_);
+  return batches_.empty() ? next_seq_ : batches_.front().seq;
+}
+
+size_t ReplBacklog::Batches() {
+  std::lock_guard<std::mutex> guard(mu_);
+  return batches_.size();
+}
+
+size_t ReplBacklog::Bytes() {
+  std::lock_guard<std::mutex> guard(mu_);
+  return bytes_;
+}
+
+FeedSlaveThread::FeedSlaveThread(Server *srv, Redis::Connection *conn, rocksdb::SequenceNumber next_repl_seq)
+    : srv_(srv), backlog_(srv->GetReplBacklog()), conn_(conn), next_repl_seq_(next_repl_seq) {
+  if (conn->GetReplCompression() == kReplCompressionZstd) {
+    compressor_ = std::make_unique<Util::ZstdStreamCompressor>();
+  }
+}
+
+Status FeedSlaveThread::Start() {
+  feeder_ = srv_->GetReplFeeder();
+  Status s = feeder_ ? Status::OK() : Status(Status::NotOK, "the replication feeder isn't running");
+  if (s.IsOK()) {
+    // The replica starts to parse the stream after it
+    evbuffer_add(output_.get(), "+OK\r\n", 5);
+    output_bytes_ = evbuffer_get_length(output_.get());
+    s = feeder_->Attach(this);
+  }
+  if (!s.IsOK()) {
+    // The connection is still used to reply the error
+    [[maybe_unused]] auto conn = conn_.release();
+    return s;
   }
   return Status::OK();
 }
@@ -70,48 +252,153 @@ void FeedSlaveThread::Stop() {
 }
 
 void FeedSlaveThread::Join() {
-  if (t_.joinable()) t_.join();
+  if (feeder_) feeder_->Detach(this);
+}
+
+// Read the acknowledgements "replconf ack <seq>" of the replica, and wake up the clients
+// waiting for the replicas to apply their writes
+void FeedSlaveThread::onAckRead(evutil_socket_t fd, int16_t, void *ctx) {
+  auto slave = static_cast<FeedSlaveThread *>(ctx);
+  char data[1024];
+  auto nread = recv(fd, data, sizeof(data), MSG_DONTWAIT);
+  if (nread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+  if (nread <= 0) {
+    // The feeder would find the broken connection while sending
+    event_del(slave->ack_event_);
+    return;
+  }
+  auto &buf = slave->ack_buf_;
+  buf.append(data, nread);
+
+  rocksdb::SequenceNumber ack_seq = 0;
+  size_t pos = 0;
+  for (auto end = buf.find(CRLF); end != std::string::npos; end = buf.find(CRLF, pos)) {
+    auto tokens = Util::Split(buf.substr(pos, end - pos), " ");
+    pos = end + 2;
+    if (tokens.size() == 3 && Util::ToLower(tokens[0]) == "replconf" && Util::ToLower(tokens[1]) == "ack") {
+      if (auto seq = ParseInt<uint64_t>(tokens[2], 10); seq) ack_seq = std::max(ack_seq, *seq);
+    }
+  }
+  buf.erase(0, pos);
+  if (ack_seq > slave->ack_seq_) {
+    slave->ack_seq_ = ack_seq;
+    slave->srv_->WakeupReplAckWaiters();
+  }
+}
+
+// Queue the bulks of the replication stream, they're compressed into a bulk if the compression
+// is negotiated, and the replica decompresses the bulk and then parses the original bulks in it
+Status FeedSlaveThread::send(const std::string &data) {
+  raw_bytes_.fetch_add(data.size(), std::memory_order_relaxed);
+  if (!compressor_) {
+    sent_bytes_.fetch_add(data.size(), std::memory_order_relaxed);
+    evbuffer_add(output_.get(), data.data(), data.size());
+  } else {
+    std::string compressed;
+    auto s = compressor_->Compress(data, &compressed);
+    if (!s.IsOK()) return s;
+    auto bulk = Redis::BulkString(compressed);
+    sent_bytes_.fetch_add(bulk.size(), std::memory_order_relaxed);
+    evbuffer_add(output_.get(), bulk.data(), bulk.size());
+  }
+  output_bytes_ = evbuffer_get_length(output_.get());
+  return Status::OK();
+}
+
+Status FeedSlaveThread::flush() {
+  while (evbuffer_get_length(output_.get()) > 0) {
+    auto n = evbuffer_write(output_.get(), conn_->GetFD());
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    if (n <= 0) return Status::FromErrno();
+  }
+  output_bytes_ = evbuffer_get_length(output_.get());
+  return Status::OK();
+}
+
+void FeedSlaveThread::sendHeartbeatIfNeed() {
+  if (!conn_->IsReplHeartbeatEnabled()) return;
+  auto now = Util::GetTimeStampMS();
+  if (now - last_heartbeat_time_ < kReplHeartbeatIntervalMS) return;
+  last_heartbeat_time_ = now;
+  // The batches before the latest sequence number may be sent after the heartbeat, the replica
+  // waits until it applied them
+  auto s = send(Redis::BulkString("heartbeat " + std::to_string(srv_->storage_->LatestSeq())));
+  if (!s.IsOK()) {
+    LOG(ERROR) << "Send heartbeat to slave[" << conn_->GetAddr() << "] err: " << s.Msg() << ", would stop feeding";
+    Stop();
+  }
 }
 
 void FeedSlaveThread::checkLivenessIfNeed() {
-  if (++interval % 1000) return;
+  sendHeartbeatIfNeed();
+  auto now = Util::GetTimeStampMS();
+  if (now - last_ping_time_ < kPingIntervalMS) return;
+  last_ping_time_ = now;
   const auto ping_command = Redis::BulkString("ping");
-  auto s = Util::SockSend(conn_->GetFD(), ping_command);
+  auto s = send(ping_command);
   if (!s.IsOK()) {
-    LOG(ERROR) << "Ping slave[" << conn_->GetAddr() << "] err: " << s.Msg() << ", would stop the thread";
+    LOG(ERROR) << "Ping slave[" << conn_->GetAddr() << "] err: " << s.Msg() << ", would stop feeding";
     Stop();
   }
 }
 
-void FeedSlaveThread::loop() {
-  // is_first_repl_batch was used to fix that replication may be stuck in a dead loop
-  // when some seqs might be lost in the middle of the WAL log, so forced to replicate
-  // first batch here to work around this issue instead of waiting for enough batch size.
-  bool is_first_repl_batch = true;
-  uint32_t yield_microseconds = 2 * 1000;
-  std::string batches_bulk;
-  size_t updates_in_batches = 0;
+FeedSlaveThread::FeedResult FeedSlaveThread::feed() {
+  size_t fed_bytes = 0;
+  ReplBacklog::Batch backlog_batch;
+  rocksdb::BatchResult wal_batch;
   while (!IsStopped()) {
-    if (!iter_ || !iter_->Valid()) {
-      if (iter_) LOG(INFO) << "WAL was rotated, would reopen again";
-      if (!srv_->storage_->WALHasNewData(next_repl_seq_) ||
-          !srv_->storage_->GetWALIter(next_repl_seq_, &iter_).IsOK()) {
+    if (evbuffer_get_length(output_.get()) > 0) return FeedResult::kBlocked;
+    if (fed_bytes >= kMaxFeedBytesPerTurn) return FeedResult::kMore;
+    // Read the batch from the shared backlog if it's there, otherwise from the WAL
+    auto result = ReplBacklog::ReadResult::kOutOfRange;
+    if (backlog_) result = backlog_->Get(next_repl_seq_, 0, &backlog_batch);
+    if (result == ReplBacklog::ReadResult::kNotYet) {
+      wait_backlog_ = true;
+      return FeedResult::kIdle;
+    }
+
+    rocksdb::SequenceNumber batch_seq = 0;
+    uint32_t batch_count = 0;
+    const std::string *batch_data = nullptr;
+    if (result == ReplBacklog::ReadResult::kOK) {
+      iter_ = nullptr;
+      iter_fed_ = false;
+      batch_seq = backlog_batch.seq;
+      batch_count = backlog_batch.count;
+      batch_data = &backlog_batch.data;
+    } else {
+      // The writers wake up the feeder once the WAL has new data
+      wait_backlog_ = false;
+      if (iter_ && iter_fed_) {
+        if (!srv_->storage_->WALHasNewData(next_repl_seq_)) return FeedResult::kIdle;
+        iter_->Next();
+        iter_fed_ = false;
+      }
+      if (!iter_ || !iter_->Valid()) {
+        if (iter_) LOG(INFO) << "WAL was rotated, would reopen again";
         iter_ = nullptr;
-        usleep(yield_microseconds);
-        checkLivenessIfNeed();
-        continue;
+        if (!srv_->storage_->WALHasNewData(next_repl_seq_)) return FeedResult::kIdle;
+        if (!srv_->storage_->GetWALIter(next_repl_seq_, &iter_).IsOK()) {
+          iter_ = nullptr;
+          return FeedResult::kRetry;
+        }
       }
+      // iter_ would be always valid here
+      wal_batch = iter_->GetBatch();
+      batch_seq = wal_batch.sequence;
+      batch_count = wal_batch.writeBatchPtr->Count();
+      batch_data = &wal_batch.writeBatchPtr->Data();
     }
-    // iter_ would be always valid here
-    auto batch = iter_->GetBatch();
-    if (batch.sequence != next_repl_seq_) {
+    if (batch_seq != next_repl_seq_) {
       LOG(ERROR) << "Fatal error encountered, WAL iterator is discrete, some seq might be lost"
-                 << ", sequence " << next_repl_seq_ << " expectd, but got " << batch.sequence;
+                 << ", sequence " << next_repl_seq_ << " expectd, but got " << batch_seq;
       Stop();
-      return;
+      break;
     }
-    updates_in_batches += batch.writeBatchPtr->Count();
-    batches_bulk += Redis::BulkString(batch.writeBatchPtr->Data());
+    updates_in_batches_ += batch_count;
+    batches_bulk_ += Redis::BulkString(*batch_data);
+    fed_bytes += batch_data->size();
     // 1. We must send the first replication batch, as said above.
     // 2. To avoid frequently calling 'write' system call to send replication stream,
     //    we pack multiple batches into one big bulk if possible, and only send once.
@@ -121,28 +408,276 @@ void FeedSlaveThread::loop() {
     // 3. To avoid master don't send replication stream to slave since of packing
     //    batches strategy, we still send batches if current batch sequence is less
     //    kMaxDelayUpdates than latest sequence.
-    if (is_first_repl_batch || batches_bulk.size() >= kMaxDelayBytes || updates_in_batches >= kMaxDelayUpdates ||
-        srv_->storage_->LatestSeq() - batch.sequence <= kMaxDelayUpdates) {
+    if (is_first_repl_batch_ || batches_bulk_.size() >= kMaxDelayBytes || updates_in_batches_ >= kMaxDelayUpdates ||
+        srv_->storage_->LatestSeq() - batch_seq <= kMaxDelayUpdates) {
       // Send entire bulk which contain multiple batches
-      auto s = Util::SockSend(conn_->GetFD(), batches_bulk);
+      auto s = send(batches_bulk_);
+      if (s.IsOK()) s = flush();
       if (!s.IsOK()) {
         LOG(ERROR) << "Write error while sending batch to slave: " << s.Msg() << ". batches: 0x"
-                   << Util::StringToHex(batches_bulk);
+                   << Util::StringToHex(batches_bulk_);
         Stop();
-        return;
+        break;
       }
-      is_first_repl_batch = false;
-      batches_bulk.clear();
-      if (batches_bulk.capacity() > kMaxDelayBytes * 2) batches_bulk.shrink_to_fit();
-      updates_in_batches = 0;
+      is_first_repl_batch_ = false;
+      batches_bulk_.clear();
+      if (batches_bulk_.capacity() > kMaxDelayBytes * 2) batches_bulk_.shrink_to_fit();
+      updates_in_batches_ = 0;
     }
-    next_repl_seq_ = batch.sequence + batch.writeBatchPtr->Count();
-    while (!IsStopped() && !srv_->storage_->WALHasNewData(next_repl_seq_)) {
-      usleep(yield_microseconds);
-      checkLivenessIfNeed();
+    next_repl_seq_ = batch_seq + batch_count;
+    if (result == ReplBacklog::ReadResult::kOK) continue;
+    // Switch to the backlog once the replica catches up with it
+    if (backlog_ && backlog_->Contains(next_repl_seq_)) {
+      iter_ = nullptr;
+      continue;
     }
-    iter_->Next();
+    iter_fed_ = true;
   }
+  return FeedResult::kIdle;
+}
+
+Status ReplFeeder::Start() {
+  int pipe_fds[2];
+  if (pipe(pipe_fds) == -1) return Status::FromErrno();
+  wakeup_read_fd_.Reset(pipe_fds[0]);
+  wakeup_write_fd_.Reset(pipe_fds[1]);
+  // The writers mustn't be blocked by the full pipe, the loop is woken up anyway
+  evutil_make_socket_nonblocking(*wakeup_read_fd_);
+  evutil_make_socket_nonblocking(*wakeup_write_fd_);
+
+  base_ = event_base_new();
+  if (!base_) return {Status::NotOK, "failed to create the event base"};
+  wakeup_event_ = event_new(base_, *wakeup_read_fd_, EV_READ | EV_PERSIST, onWakeup, this);
+  event_add(wakeup_event_, nullptr);
+  feed_event_ = evtimer_new(base_, onFeed, this);
+  // The heartbeats are sent at kReplHeartbeatIntervalMS, so check them twice in the interval
+  timer_ = event_new(base_, -1, EV_PERSIST, onTimer, this);
+  timeval tmo{0, static_cast<suseconds_t>(kReplHeartbeatIntervalMS * 1000 / 2)};
+  evtimer_add(timer_, &tmo);
+
+  try {
+    t_ = std::thread([this]() {
+      Util::ThreadSetName("feed-replica");
+      if (auto s = Util::ThreadSetAffinity(srv_->GetConfig()->background_cpus); !s.IsOK()) {
+        LOG(WARNING) << "Failed to set the cpu affinity of replication thread, err: " << s.Msg();
+      }
+      if (srv_->GetConfig()->jemalloc_dedicated_arenas) {
+        if (auto s = Util::ThreadSetSharedArena("replication", true); !s.IsOK()) {
+          LOG(WARNING) << "Failed to set the jemalloc arena of replication thread, err: " << s.Msg();
+        }
+      }
+      sigset_t mask, omask;
+      sigemptyset(&mask);
+      sigemptyset(&omask);
+      sigaddset(&mask, SIGCHLD);
+      sigaddset(&mask, SIGHUP);
+      sigaddset(&mask, SIGPIPE);
+      pthread_sigmask(SIG_BLOCK, &mask, &omask);
+      this->loop();
+    });
+  } catch (const std::system_error &e) {
+    return {Status::NotOK, e.what()};
+  }
+  return Status::OK();
+}
+
+void ReplFeeder::Stop() {
+  if (!base_) return;
+  stop_ = true;
+  wakeup();
+  if (t_.joinable()) t_.join();
+  srv_->storage_->DisarmWALWakeup(*wakeup_write_fd_);
+  event_free(timer_);
+  event_free(feed_event_);
+  event_free(wakeup_event_);
+  event_base_free(base_);
+  base_ = nullptr;
+}
+
+Status ReplFeeder::Attach(FeedSlaveThread *slave) {
+  std::lock_guard<std::mutex> guard(mu_);
+  if (stop_) return {Status::NotOK, "the replication feeder was stopped"};
+  slave->attached_ = true;
+  attaching_.emplace_back(slave);
+  wakeup();
+  return Status::OK();
+}
+
+void ReplFeeder::Detach(FeedSlaveThread *slave) {
+  slave->stop_ = true;
+  std::unique_lock<std::mutex> lock(mu_);
+  if (auto iter = std::find(attaching_.begin(), attaching_.end(), slave); iter != attaching_.end()) {
+    attaching_.erase(iter);
+    slave->attached_ = false;
+    return;
+  }
+  wakeup();
+  cond_.wait(lock, [slave] { return !slave->attached_; });
+}
+
+void ReplFeeder::loop() {
+  event_base_dispatch(base_);
+
+  // The feeders are deleted by their owners after they were released
+  std::lock_guard<std::mutex> guard(mu_);
+  for (auto slave : slaves_) {
+    releaseSlave(slave);
+    slave->attached_ = false;
+  }
+  slaves_.clear();
+  for (auto slave : attaching_) slave->attached_ = false;
+  attaching_.clear();
+  cond_.notify_all();
+}
+
+void ReplFeeder::wakeup() {
+  // The loop drains the pipe, and it also wakes up by the timer if the write failed
+  [[maybe_unused]] ssize_t n = write(*wakeup_write_fd_, "", 1);
+}
+
+void ReplFeeder::updateSlaves() {
+  std::vector<FeedSlaveThread *> attaching;
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    attaching.swap(attaching_);
+  }
+  for (auto slave : attaching) {
+    if (auto s = attachSlave(slave); !s.IsOK()) {
+      LOG(ERROR) << "Failed to feed the slave: " << slave->conn_->GetAddr() << ", err: " << s.Msg();
+      slave->Stop();
+    }
+    slaves_.emplace_back(slave);
+  }
+
+  std::vector<FeedSlaveThread *> stopped;
+  for (auto iter = slaves_.begin(); iter != slaves_.end();) {
+    if (!(*iter)->IsStopped()) {
+      ++iter;
+      continue;
+    }
+    releaseSlave(*iter);
+    stopped.emplace_back(*iter);
+    iter = slaves_.erase(iter);
+  }
+  if (stopped.empty()) return;
+  std::lock_guard<std::mutex> guard(mu_);
+  for (auto slave : stopped) slave->attached_ = false;
+  cond_.notify_all();
+}
+
+void ReplFeeder::feedAll() {
+  bool more = false, retry = false;
+  // The caught up replicas wait for the batches after their sequence numbers
+  rocksdb::SequenceNumber wal_seq = std::numeric_limits<rocksdb::SequenceNumber>::max();
+  rocksdb::SequenceNumber backlog_seq = wal_seq;
+  ReplBacklog *backlog = nullptr;
+  for (auto slave : slaves_) {
+    if (slave->IsStopped() || event_pending(slave->write_event_, EV_WRITE, nullptr)) continue;
+    auto result = slave->feed();
+    if (slave->IsStopped()) continue;
+    switch (result) {
+      case FeedSlaveThread::FeedResult::kIdle:
+        if (slave->wait_backlog_) {
+          backlog = slave->backlog_;
+          backlog_seq = std::min(backlog_seq, slave->next_repl_seq_);
+        } else {
+          wal_seq = std::min(wal_seq, slave->next_repl_seq_);
+        }
+        break;
+      case FeedSlaveThread::FeedResult::kMore:
+        more = true;
+        break;
+      case FeedSlaveThread::FeedResult::kBlocked:
+        event_add(slave->write_event_, nullptr);
+        break;
+      case FeedSlaveThread::FeedResult::kRetry:
+        retry = true;
+        break;
+    }
+  }
+
+  // The wakeups are armed after feeding, so the batches written meanwhile aren't missed
+  if (wal_seq != std::numeric_limits<rocksdb::SequenceNumber>::max() &&
+      !srv_->storage_->ArmWALWakeup(*wakeup_write_fd_, wal_seq)) {
+    more = true;
+  }
+  if (backlog && !backlog->ArmWakeup(*wakeup_write_fd_, backlog_seq)) more = true;
+  if (more) {
+    event_active(feed_event_, EV_TIMEOUT, 0);
+  } else if (retry && !evtimer_pending(feed_event_, nullptr)) {
+    timeval tmo{0, 2000};
+    evtimer_add(feed_event_, &tmo);
+  }
+}
+
+Status ReplFeeder::attachSlave(FeedSlaveThread *slave) {
+  int fd = slave->conn_->GetFD();
+  // The stream is written without blocking, so a slow replica doesn't stall the others
+  auto s = Util::SockSetBlocking(fd, 0);
+  if (!s.IsOK()) return s;
+  slave->write_event_ = event_new(base_, fd, EV_WRITE, onSlaveWrite, slave);
+  if (slave->conn_->IsReplAckEnabled()) {
+    slave->ack_event_ = event_new(base_, fd, EV_READ | EV_PERSIST, FeedSlaveThread::onAckRead, slave);
+    event_add(slave->ack_event_, nullptr);
+  }
+  flushSlave(slave);
+  return Status::OK();
+}
+
+void ReplFeeder::releaseSlave(FeedSlaveThread *slave) {
+  if (slave->write_event_) event_free(slave->write_event_);
+  if (slave->ack_event_) event_free(slave->ack_event_);
+  slave->write_event_ = nullptr;
+  slave->ack_event_ = nullptr;
+}
+
+bool ReplFeeder::flushSlave(FeedSlaveThread *slave) {
+  if (auto s = slave->flush(); !s.IsOK()) {
+    LOG(ERROR) << "Write error while sending the replication stream to slave[" << slave->conn_->GetAddr()
+               << "]: " << s.Msg();
+    slave->Stop();
+    return false;
+  }
+  if (slave->GetOutputBytes() == 0) return true;
+  event_add(slave->write_event_, nullptr);
+  return false;
+}
+
+void ReplFeeder::onSlaveWrite(evutil_socket_t, int16_t, void *ctx) {
+  auto slave = static_cast<FeedSlaveThread *>(ctx);
+  if (slave->IsStopped()) return;
+  if (slave->feeder_->flushSlave(slave)) slave->feeder_->feedAll();
+}
+
+void ReplFeeder::onWakeup(evutil_socket_t fd, int16_t, void *ctx) {
+  auto self = static_cast<ReplFeeder *>(ctx);
+  char buf[64];
+  while (read(fd, buf, sizeof(buf)) > 0) continue;
+  if (self->stop_) {
+    event_base_loopbreak(self->base_);
+    return;
+  }
+  self->updateSlaves();
+  self->feedAll();
+}
+
+void ReplFeeder::onFeed(evutil_socket_t, int16_t, void *ctx) { static_cast<ReplFeeder *>(ctx)->feedAll(); }
+
+void ReplFeeder::onTimer(evutil_socket_t, int16_t, void *ctx) {
+  auto self = static_cast<ReplFeeder *>(ctx);
+  if (self->stop_) {
+    event_base_loopbreak(self->base_);
+    return;
+  }
+  self->updateSlaves();
+  for (auto slave : self->slaves_) {
+    // The replica whose socket is full isn't pinged, the pending stream would find the broken connection
+    if (slave->IsStopped() || slave->GetOutputBytes() > 0) continue;
+    slave->checkLivenessIfNeed();
+    self->flushSlave(slave);
+  }
+  // The wakeups may be missed for the writes which don't go through the storage
+  self->feedAll();
 }
 
 void send_string(bufferevent *bev, const std::string &data) {
@@ -272,9 +807,10 @@ void ReplicationThread::CallbacksStateMachine::Stop() {
   }
 }
 
-ReplicationThread::ReplicationThread(std::string host, uint32_t port, Server *srv)
+ReplicationThread::ReplicationThread(std::string host, uint32_t port, Server *srv, std::string backup_dir)
     : host_(std::move(host)),
       port_(port),
+      backup_dir_(std::move(backup_dir)),
       srv_(srv),
       storage_(srv->storage_),
       repl_state_(kReplConnecting),
@@ -306,12 +842,25 @@ Status ReplicationThread::Start(std::function<void()> &&pre_fullsync_cb, std::fu
     LOG(WARNING) << "Clean old synced checkpoint successfully";
   }
 
-  // cleanup the old backups, so we can start replication in a clean state
-  storage_->PurgeOldBackups(0, 0);
+  // cleanup the old backups, so we can start replication in a clean state, but the local
+  // backup to bootstrap from may be the one of this server, it's purged after being restored
+  if (backup_dir_.empty()) storage_->PurgeOldBackups(0, 0);
 
   try {
+    applier_ = std::thread([this]() {
+      Util::ThreadSetName("repl-applier");
+      this->applyLoop();
+    });
     t_ = std::thread([this]() {
       Util::ThreadSetName("master-repl");
+      if (auto s = Util::ThreadSetAffinity(srv_->GetConfig()->background_cpus); !s.IsOK()) {
+        LOG(WARNING) << "Failed to set the cpu affinity of replication thread, err: " << s.Msg();
+      }
+      if (srv_->GetConfig()->jemalloc_dedicated_arenas) {
+        if (auto s = Util::ThreadSetSharedArena("replication", true); !s.IsOK()) {
+          LOG(WARNING) << "Failed to set the jemalloc arena of replication thread, err: " << s.Msg();
+        }
+      }
       this->run();
       assert(stop_flag_);
     });
@@ -327,9 +876,121 @@ void ReplicationThread::Stop() {
   stop_flag_ = true;  // Stopping procedure is asynchronous,
                       // handled by timer
   t_.join();
+  {
+    std::lock_guard<std::mutex> guard(apply_mu_);
+    applier_stop_ = true;
+  }
+  apply_cv_.notify_all();
+  applier_.join();
   LOG(INFO) << "[replication] Stopped";
 }
 
+size_t ReplicationThread::PendingApplyBatches() {
+  std::lock_guard<std::mutex> guard(apply_mu_);
+  return pending_batches_.size() + (applying_ ? 1 : 0);
+}
+
+size_t ReplicationThread::PendingApplyBytes() {
+  std::lock_guard<std::mutex> guard(apply_mu_);
+  return pending_bytes_;
+}
+
+// The applier applies the received batches in order until it's stopped, the batches which
+// were already received are applied before it stops
+void ReplicationThread::applyLoop() {
+  std::unique_lock<std::mutex> lock(apply_mu_);
+  while (true) {
+    apply_cv_.wait(lock, [this] { return applier_stop_ || !pending_batches_.empty(); });
+    if (pending_batches_.empty()) break;
+
+    auto batch = std::move(pending_batches_.front());
+    pending_batches_.pop_front();
+    applying_ = true;
+    lock.unlock();
+    auto s = applyBatch(batch);
+    if (!s.IsOK()) {
+      LOG(ERROR) << "[replication] CRITICAL - Failed to write batch to local, " << s.Msg() << ". batch: 0x"
+                 << Util::StringToHex(batch);
+    }
+    lock.lock();
+    applying_ = false;
+    pending_bytes_ -= batch.size();
+    // The event coalesces the acknowledgements of the batches applied in one loop of the event base
+    if (s.IsOK() && ack_event_) event_active(ack_event_, EV_TIMEOUT, 0);
+    if (s.IsOK()) updateFreshness();
+    if (!s.IsOK()) {
+      // The following batches can't be applied and would be received again after restarting
+      apply_status_ = s;
+      pending_batches_.clear();
+      pending_bytes_ = 0;
+    }
+    apply_cv_.notify_all();
+  }
+}
+
+Status ReplicationThread::queueBatch(std::string &&batch) {
+  // master would send the ping heartbeat packet to check whether the slave was alive or not,
+  // don't write ping to db here.
+  if (batch == "ping") return Status::OK();
+  if (batch.compare(0, 10, "heartbeat ") == 0) {
+    auto seq = ParseInt<uint64_t>(batch.substr(10), 10);
+    if (!seq) return {Status::NotOK, "invalid heartbeat"};
+    std::lock_guard<std::mutex> lock(apply_mu_);
+    pending_heartbeats_.emplace_back(*seq, Util::GetTimeStampMS());
+    // Only lose the precision of the lag if the replica lags too much
+    if (pending_heartbeats_.size() > kMaxPendingHeartbeats) pending_heartbeats_.pop_front();
+    updateFreshness();
+    return Status::OK();
+  }
+  if (batch.size() >= 12) received_seq_ = DecodeFixed64(batch.data()) + DecodeFixed32(batch.data() + 8);
+
+  std::unique_lock<std::mutex> lock(apply_mu_);
+  // Stop receiving the stream if the applier can't catch up
+  apply_cv_.wait(lock, [this] { return !apply_status_.IsOK() || pending_bytes_ < kMaxPendingApplyBytes; });
+  if (!apply_status_.IsOK()) return apply_status_;
+  pending_bytes_ += batch.size();
+  pending_batches_.emplace_back(std::move(batch));
+  apply_cv_.notify_all();
+  return Status::OK();
+}
+
+// The replica applied all writes of the master before the heartbeat was received once it applied the
+// sequence number in the heartbeat, apply_mu_ should be held
+void ReplicationThread::updateFreshness() {
+  auto applied_seq = storage_->LatestSeq();
+  while (!pending_heartbeats_.empty() && pending_heartbeats_.front().first <= applied_seq) {
+    fresh_time_ms_ = pending_heartbeats_.front().second;
+    pending_heartbeats_.pop_front();
+  }
+}
+
+int64_t ReplicationThread::LagMS() {
+  uint64_t fresh_time = fresh_time_ms_;
+  if (fresh_time == 0) return -1;
+  auto now = Util::GetTimeStampMS();
+  return now > fresh_time ? static_cast<int64_t>(now - fresh_time) : 0;
+}
+
+void ReplicationThread::publishLagIfChanged() {
+  auto lag = LagMS();
+  if (lag < 0) return;
+  auto applied_seq = storage_->LatestSeq();
+  if (applied_seq == lag_published_seq_ && std::abs(lag - lag_published_ms_) < kReplLagPublishStepMS) return;
+  lag_published_seq_ = applied_seq;
+  lag_published_ms_ = lag;
+  srv_->PublishMessage(kReplicaLagChannel, std::to_string(applied_seq) + " " + std::to_string(lag));
+}
+
+// Wait until all received batches were applied, and return the error of the applier if any,
+// the error is cleared since the replication would restart from the latest sequence number
+Status ReplicationThread::waitForBatchesApplied() {
+  std::unique_lock<std::mutex> lock(apply_mu_);
+  apply_cv_.wait(lock, [this] { return pending_batches_.empty() && !applying_; });
+  Status s = apply_status_;
+  apply_status_ = Status::OK();
+  return s;
+}
+
 /*
  * Run connect to master, and start the following steps
  * asynchronously
@@ -344,6 +1005,8 @@ void ReplicationThread::run() {
     LOG(ERROR) << "[replication] Failed to create new ev base";
     return;
   }
+  ack_event_ = event_new(base_, -1, 0, AckEventCB, this);
+  if (!backup_dir_.empty()) restoreFromLocalBackup();
   psync_steps_.Start();
 
   auto timer = event_new(base_, -1, EV_PERSIST, EventTimerCB, this);
@@ -352,9 +1015,30 @@ void ReplicationThread::run() {
 
   event_base_dispatch(base_);
   event_free(timer);
+  {
+    std::lock_guard<std::mutex> guard(apply_mu_);
+    event_free(ack_event_);
+    ack_event_ = nullptr;
+  }
   event_base_free(base_);
 }
 
+void ReplicationThread::restoreFromLocalBackup() {
+  LOG(INFO) << "[replication] Restoring the local backup " << backup_dir_ << " before PSYNC";
+  auto start_ms = Util::GetTimeStampMS();
+  pre_fullsync_cb_();
+  auto s = storage_->RestoreFromLocalBackup(backup_dir_);
+  post_fullsync_cb_();
+  // The replica resumes from its own data if the backup couldn't be restored, the master decides
+  // whether it needs the fullsync by PSYNC either way
+  if (!s.IsOK()) {
+    LOG(ERROR) << "[replication] Failed to restore the local backup " << backup_dir_ << ", err: " << s.Msg();
+    return;
+  }
+  LOG(INFO) << "[replication] Succeeded restoring the local backup in " << Util::GetTimeStampMS() - start_ms
+            << " ms, the latest sequence: " << storage_->LatestSeq();
+}
+
 ReplicationThread::CBState ReplicationThread::authWriteCB(bufferevent *bev, void *ctx) {
   auto self = static_cast<ReplicationThread *>(ctx);
   send_string(bev, Redis::MultiBulkString({"AUTH", self->srv_->GetConfig()->masterauth}));
@@ -410,14 +1094,27 @@ ReplicationThread::CBState ReplicationThread::checkDBNameReadCB(bufferevent *bev
 
 ReplicationThread::CBState ReplicationThread::replConfWriteCB(bufferevent *bev, void *ctx) {
   auto self = static_cast<ReplicationThread *>(ctx);
-  send_string(bev,
-              Redis::MultiBulkString({"replconf", "listening-port", std::to_string(self->srv_->GetConfig()->port)}));
+  std::vector<std::string> args = {"replconf", "listening-port", std::to_string(self->srv_->GetConfig()->port)};
+  // The old master doesn't know the compression and ack options, so retry without them if they're rejected
+  self->repl_compression_ = kReplCompressionNone;
+  self->ack_enabled_ = false;
+  if (!self->next_try_basic_replconf_) {
+    if (self->srv_->GetConfig()->replication_compression == kReplCompressionZstd) {
+      args.insert(args.end(), {"compression", "zstd"});
+      self->repl_compression_ = kReplCompressionZstd;
+    }
+    args.insert(args.end(), {"capa", "ack", "capa", "heartbeat"});
+    self->ack_enabled_ = true;
+  }
+  self->next_try_basic_replconf_ = false;
+  send_string(bev, Redis::MultiBulkString(args));
   self->repl_state_ = kReplReplConf;
   LOG(INFO) << "[replication] replconf request was sent, waiting for response";
   return CBState::NEXT;
 }
 
 ReplicationThread::CBState ReplicationThread::replConfReadCB(bufferevent *bev, void *ctx) {
+  auto self = static_cast<ReplicationThread *>(ctx);
   auto input = bufferevent_get_input(bev);
   UniqueEvbufReadln line(input, EVBUFFER_EOL_CRLF_STRICT);
   if (!line) return CBState::AGAIN;
@@ -428,16 +1125,37 @@ ReplicationThread::CBState ReplicationThread::replConfReadCB(bufferevent *bev, v
   }
   if (strncmp(line.get(), "+OK", 3) != 0) {
     LOG(WARNING) << "[replication] Failed to replconf: " << line.get() + 1;
+    if (self->ack_enabled_) {
+      LOG(WARNING) << "[replication] The master may not support the compression or ack, try replconf without them";
+      self->next_try_basic_replconf_ = true;
+      return CBState::PREV;
+    }
     //  backward compatible with old version that doesn't support replconf cmd
     return CBState::NEXT;
   } else {
-    LOG(INFO) << "[replication] replconf is ok, start psync";
+    if (self->repl_compression_ != kReplCompressionNone) {
+      self->incr_decompressor_ = std::make_unique<Util::ZstdStreamDecompressor>();
+      self->incr_decompressed_.clear();
+      LOG(INFO) << "[replication] replconf is ok, the replication stream is compressed, start psync";
+    } else {
+      LOG(INFO) << "[replication] replconf is ok, start psync";
+    }
     return CBState::NEXT;
   }
 }
 
 ReplicationThread::CBState ReplicationThread::tryPSyncWriteCB(bufferevent *bev, void *ctx) {
   auto self = static_cast<ReplicationThread *>(ctx);
+  // The received batches must be applied before continuing from the latest sequence number
+  if (auto s = self->waitForBatchesApplied(); !s.IsOK()) {
+    LOG(WARNING) << "[replication] Failed to apply the received batches: " << s.Msg();
+  }
+  // The data isn't a prefix of the replication stream if some batches applied without the WAL were lost
+  if (self->storage_->ReplicaWritesLost()) {
+    self->fullsync_steps_.Start();
+    LOG(INFO) << "[replication] The batches applied without the WAL were lost, switch to fullsync";
+    return CBState::QUIT;
+  }
   auto cur_seq = self->storage_->LatestSeq();
   auto next_seq = cur_seq + 1;
   std::string replid;
@@ -529,16 +1247,18 @@ ReplicationThread::CBState ReplicationThread::incrementBatchLoopCB(bufferevent *
         if (self->incr_bulk_len_ + 2 <= evbuffer_get_length(input)) {  // We got enough data
           bulk_data = reinterpret_cast<char *>(evbuffer_pullup(input, static_cast<ssize_t>(self->incr_bulk_len_ + 2)));
           std::string bulk_string = std::string(bulk_data, self->incr_bulk_len_);
-          // master would send the ping heartbeat packet to check whether the slave was alive or not,
-          // don't write ping to db here.
-          if (bulk_string != "ping") {
-            auto s = self->storage_->ReplicaApplyWriteBatch(std::string(bulk_data, self->incr_bulk_len_));
-            if (!s.IsOK()) {
-              LOG(ERROR) << "[replication] CRITICAL - Failed to write batch to local, " << s.Msg() << ". batch: 0x"
-                         << Util::StringToHex(bulk_string);
-              return CBState::RESTART;
-            }
-            self->ParseWriteBatch(bulk_string);
+          Status s;
+          if (self->repl_compression_ != kReplCompressionNone) {
+            // The bulk is the compressed bulks of the batches
+            s = self->incr_decompressor_->Decompress(bulk_string.data(), bulk_string.size(),
+                                                     &self->incr_decompressed_);
+            if (s.IsOK()) s = self->queueDecompressedBatches();
+          } else {
+            s = self->queueBatch(std::move(bulk_string));
+          }
+          if (!s.IsOK()) {
+            LOG(ERROR) << "[replication] Failed to apply the replication stream, " << s.Msg() << ", restart";
+            return CBState::RESTART;
           }
           evbuffer_drain(input, self->incr_bulk_len_ + 2);
           self->incr_state_ = Incr_batch_size;
@@ -550,10 +1270,36 @@ ReplicationThread::CBState ReplicationThread::incrementBatchLoopCB(bufferevent *
   }
 }
 
+Status ReplicationThread::applyBatch(const std::string &batch) {
+  auto s = storage_->ReplicaApplyWriteBatch(std::string(batch));
+  if (!s.IsOK()) return s;
+  ParseWriteBatch(batch);
+  return Status::OK();
+}
+
+// Queue the complete bulks in the decompressed data, the rest is kept until more data comes
+Status ReplicationThread::queueDecompressedBatches() {
+  size_t pos = 0;
+  while (pos < incr_decompressed_.size()) {
+    auto crlf = incr_decompressed_.find("\r\n", pos);
+    if (crlf == std::string::npos) break;
+    if (incr_decompressed_[pos] != '$') return {Status::NotOK, "invalid bulk in compressed stream"};
+    auto len = std::strtoull(incr_decompressed_.c_str() + pos + 1, nullptr, 10);
+    if (crlf + 2 + len + 2 > incr_decompressed_.size()) break;
+
+    auto s = queueBatch(incr_decompressed_.substr(crlf + 2, len));
+    if (!s.IsOK()) return s;
+    pos = crlf + 2 + len + 2;
+  }
+  incr_decompressed_.erase(0, pos);
+  return Status::OK();
+}
+
 ReplicationThread::CBState ReplicationThread::fullSyncWriteCB(bufferevent *bev, void *ctx) {
   send_string(bev, Redis::MultiBulkString({"_fetch_meta"}));
   auto self = static_cast<ReplicationThread *>(ctx);
   self->repl_state_ = kReplFetchMeta;
+  self->fullsync_start_ms_ = Util::GetTimeStampMS();
   LOG(INFO) << "[replication] Start syncing data with fullsync";
   return CBState::NEXT;
 }
@@ -627,6 +1373,10 @@ ReplicationThread::CBState ReplicationThread::fullSyncReadCB(bufferevent *bev, v
         // file doesn't have number.
         auto iter = std::find(need_files.begin(), need_files.end(), "CURRENT");
         if (iter != need_files.end()) need_files.erase(iter);
+        // Keep the partial files of the needed files to resume fetching them
+        for (size_t i = 0, n = need_files.size(); i < n; i++) {
+          need_files.emplace_back(need_files[i] + ".tmp");
+        }
         auto s = Engine::Storage::ReplDataManager::CleanInvalidFiles(self->storage_, target_dir, need_files);
         if (!s.IsOK()) {
           LOG(WARNING) << "[replication] Failed to clean up invalid files of the old checkpoint,"
@@ -672,6 +1422,7 @@ ReplicationThread::CBState ReplicationThread::fullSyncReadCB(bufferevent *bev, v
         return CBState::RESTART;
       }
       LOG(INFO) << "[replication] Succeeded restoring the backup, fullsync was finish";
+      self->storage_->GetLatencyMonitor()->Record("fullsync", Util::GetTimeStampMS() - self->fullsync_start_ms_);
       self->post_fullsync_cb_();
 
       // Switch to psync state machine again
@@ -791,8 +1542,9 @@ Status ReplicationThread::sendAuth(int sock_fd) {
 }
 
 Status ReplicationThread::fetchFile(int sock_fd, evbuffer *evbuf, const std::string &dir, const std::string &file,
-                                    uint32_t crc, const fetch_file_callback &fn) {
-  size_t file_size = 0;
+                                    uint32_t crc, uint64_t resume_offset, uint32_t resume_crc,
+                                    const fetch_file_callback &fn) {
+  size_t file_size = 0, offset = 0;
 
   // Read file size line
   while (true) {
@@ -807,18 +1559,62 @@ Status ReplicationThread::fetchFile(int sock_fd, evbuffer *evbuf, const std::str
       std::string msg(line.get());
       return {Status::NotOK, msg};
     }
-    file_size = line.length > 0 ? std::strtoull(line.get(), nullptr, 10) : 0;
+    // The offset follows the file size if the file is requested to be resumed
+    char *end = nullptr;
+    file_size = line.length > 0 ? std::strtoull(line.get(), &end, 10) : 0;
+    if (end && *end == ' ') offset = std::strtoull(end + 1, nullptr, 10);
     break;
   }
+  if (offset != 0 && (offset != resume_offset || offset > file_size)) {
+    return {Status::NotOK, fmt::format("unexpected offset {} to resume the file", offset)};
+  }
 
-  // Write to tmp file
-  auto tmp_file = Engine::Storage::ReplDataManager::NewTmpFile(storage_, dir, file);
+  // Write to tmp file, append to the partial one if the master agreed to resume it
+  std::unique_ptr<rocksdb::WritableFile> tmp_file;
+  uint32_t tmp_crc = 0;
+  if (offset != 0) {
+    tmp_file = Engine::Storage::ReplDataManager::ReopenTmpFile(storage_, dir, file);
+    tmp_crc = resume_crc;
+    LOG(INFO) << "[fetch] Resume fetching file " << file << " from offset " << offset;
+  } else {
+    tmp_file = Engine::Storage::ReplDataManager::NewTmpFile(storage_, dir, file);
+  }
   if (!tmp_file) {
     return {Status::NotOK, "unable to create tmp file"};
   }
 
-  size_t remain = file_size;
-  uint32_t tmp_crc = 0;
+  size_t remain = file_size - offset;
+  if (repl_compression_ != kReplCompressionNone) {
+    // The file is sent as the bulks of the compressed chunks
+    Util::ZstdStreamDecompressor decompressor;
+    std::string decompressed;
+    while (remain != 0) {
+      UniqueEvbufReadln line(evbuf, EVBUFFER_EOL_CRLF_STRICT);
+      if (!line) {
+        if (evbuffer_read(evbuf, sock_fd, -1) <= 0) {
+          return {Status::NotOK, fmt::format("read sst file: {}", strerror(errno))};
+        }
+        continue;
+      }
+      if (line[0] != '$') return {Status::NotOK, "invalid compressed chunk of sst file"};
+      size_t chunk_len = std::strtoull(line.get() + 1, nullptr, 10);
+      while (evbuffer_get_length(evbuf) < chunk_len + 2) {
+        if (evbuffer_read(evbuf, sock_fd, -1) <= 0) {
+          return {Status::NotOK, fmt::format("read sst file: {}", strerror(errno))};
+        }
+      }
+      decompressed.clear();
+      auto s = decompressor.Decompress(reinterpret_cast<const char *>(evbuffer_pullup(evbuf, chunk_len)), chunk_len,
+                                       &decompressed);
+      evbuffer_drain(evbuf, chunk_len + 2);
+      if (!s.IsOK()) return s;
+      if (decompressed.size() > remain) return {Status::NotOK, "sst file data exceeds the file size"};
+
+      if (!tmp_file->Append(rocksdb::Slice(decompressed)).ok()) return {Status::NotOK, "unable to write tmp file"};
+      tmp_crc = rocksdb::crc32c::Extend(tmp_crc, decompressed.data(), decompressed.size());
+      remain -= decompressed.size();
+    }
+  }
   char data[16 * 1024];
   while (remain != 0) {
     if (evbuffer_get_length(evbuf) > 0) {
@@ -827,7 +1623,7 @@ Status ReplicationThread::fetchFile(int sock_fd, evbuffer *evbuf, const std::str
       if (data_len < 0) {
         return {Status::NotOK, "read sst file data error"};
       }
-      tmp_file->Append(rocksdb::Slice(data, data_len));
+      if (!tmp_file->Append(rocksdb::Slice(data, data_len)).ok()) return {Status::NotOK, "unable to write tmp file"};
       tmp_crc = rocksdb::crc32c::Extend(tmp_crc, data, data_len);
       remain -= data_len;
     } else {
@@ -838,6 +1634,8 @@ Status ReplicationThread::fetchFile(int sock_fd, evbuffer *evbuf, const std::str
   }
   // Verify file crc checksum if crc is not 0
   if (crc && crc != tmp_crc) {
+    // Don't resume the corrupted file
+    Engine::Storage::ReplDataManager::RemoveTmpFile(storage_, dir, file);
     return {Status::NotOK, fmt::format("CRC mismatched, {} was expected but got {}", crc, tmp_crc)};
   }
   // File is OK, rename to formal name
@@ -858,15 +1656,44 @@ Status ReplicationThread::fetchFiles(int sock_fd, const std::string &dir, const
   }
   files_str.pop_back();
 
-  const auto fetch_command = Redis::MultiBulkString({"_fetch_file", files_str});
+  std::vector<std::string> fetch_args = {"_fetch_file", files_str};
+  if (repl_compression_ == kReplCompressionZstd) fetch_args.emplace_back("zstd");
+
+  // Request to resume the partial files which were left by the interrupted fetching, the master
+  // verifies the checksums of their prefixes, so we can continue from where they were broken.
+  // The master of old version uses the rocksdb backup, whose files are never resumed.
+  std::vector<uint64_t> resume_offsets(files.size(), 0);
+  std::vector<uint32_t> resume_crcs(files.size(), 0);
+  bool resumable = false;
+  if (!srv_->GetConfig()->master_use_repl_port) {
+    std::string offsets_str;
+    for (unsigned i = 0; i < files.size(); i++) {
+      auto s = Engine::Storage::ReplDataManager::GetTmpFileInfo(storage_, dir, files[i], &resume_offsets[i],
+                                                               &resume_crcs[i]);
+      if (!s.IsOK()) resume_offsets[i] = resume_crcs[i] = 0;
+      if (resume_offsets[i] > 0) resumable = true;
+      offsets_str += fmt::format("{}:{},", resume_offsets[i], resume_crcs[i]);
+    }
+    if (resumable) {
+      offsets_str.pop_back();
+      fetch_args.emplace_back("offsets");
+      fetch_args.emplace_back(offsets_str);
+    }
+  }
+  const auto fetch_command = Redis::MultiBulkString(fetch_args);
   auto s = Util::SockSend(sock_fd, fetch_command);
   if (!s.IsOK()) return Status(Status::NotOK, "send fetch file command: " + s.Msg());
 
   UniqueEvbuf evbuf;
   for (unsigned i = 0; i < files.size(); i++) {
     DLOG(INFO) << "[fetch] Start to fetch file " << files[i];
-    s = fetchFile(sock_fd, evbuf.get(), dir, files[i], crcs[i], fn);
+    s = fetchFile(sock_fd, evbuf.get(), dir, files[i], crcs[i], resume_offsets[i], resume_crcs[i], fn);
     if (!s.IsOK()) {
+      // The master which doesn't support resuming rejects the request, so remove the partial
+      // files to fetch them from the beginning next time
+      if (resumable && i == 0 && s.Msg()[0] == '-') {
+        for (const auto &file : files) Engine::Storage::ReplDataManager::RemoveTmpFile(storage_, dir, file);
+      }
       s = Status(Status::NotOK, "fetch file err: " + s.Msg());
       LOG(WARNING) << "[fetch] Fail to fetch file " << files[i] << ", err: " << s.Msg();
       break;
@@ -890,7 +1717,31 @@ void ReplicationThread::EventTimerCB(int, int16_t, void *ctx) {
     event_base_loopbreak(self->base_);
     self->psync_steps_.Stop();
     self->fullsync_steps_.Stop();
+    return;
   }
+  // The SST files bulk loaded by the master and the changed column families aren't in the WAL,
+  // so resynchronize fully
+  if (self->resync_required_ && self->repl_state_ == kReplConnected) {
+    self->resync_required_ = false;
+    LOG(INFO) << "[replication] The master changed the data outside the WAL, switch to fullsync";
+    if (auto s = self->waitForBatchesApplied(); !s.IsOK()) {
+      LOG(WARNING) << "[replication] Failed to apply the received batches: " << s.Msg();
+    }
+    self->psync_steps_.Stop();
+    self->fullsync_steps_.Start();
+    return;
+  }
+  // Acknowledge periodically even if there's no new batch, e.g. just after the psync
+  AckEventCB(0, 0, ctx);
+  self->publishLagIfChanged();
+}
+
+void ReplicationThread::AckEventCB(int, int16_t, void *ctx) {
+  auto self = static_cast<ReplicationThread *>(ctx);
+  auto bev = self->psync_steps_.GetBufferEvent();
+  if (!self->ack_enabled_ || self->repl_state_ != kReplConnected || !bev) return;
+  // The inline command is simple to parse by the replica feeder of the master
+  send_string(bev, "replconf ack " + std::to_string(self->storage_->LatestSeq()) + CRLF);
 }
 
 rocksdb::Status ReplicationThread::ParseWriteBatch(const std::string &batch_string) {
@@ -900,9 +1751,19 @@ rocksdb::Status ReplicationThread::ParseWriteBatch(const std::string &batch_stri
 
   status = write_batch.Iterate(&write_batch_handler);
   if (!status.ok()) return status;
+  // Inherit the replication id of the master, then our replicas can check the replication
+  // history by the batches in our WAL just like the batches in the WAL of the master
+  if (auto replid = write_batch_handler.ReplId(); replid.length() == kReplIdLength && replid != storage_->GetReplId()) {
+    LOG(INFO) << "[replication] The replication id of the master: " << replid;
+    storage_->SetReplId(replid);
+  }
   switch (write_batch_handler.Type()) {
     case kBatchTypePublish:
-      srv_->PublishMessage(write_batch_handler.Key(), write_batch_handler.Value());
+      if (write_batch_handler.IsShardPublish()) {
+        srv_->PublishShardMessage(write_batch_handler.Key(), write_batch_handler.Value());
+      } else {
+        srv_->PublishMessage(write_batch_handler.Key(), write_batch_handler.Value());
+      }
       break;
     case kBatchTypePropagate:
       if (write_batch_handler.Key() == Engine::kPropagateScriptCommand) {
@@ -910,6 +1771,9 @@ rocksdb::Status ReplicationThread::ParseWriteBatch(const std::string &batch_stri
         if (!tokens.empty()) {
           srv_->ExecPropagatedCommand(tokens);
         }
+      } else if (write_batch_handler.Key() == Engine::kPropagateBulkLoad ||
+                 write_batch_handler.Key() == Engine::kPropagateNamespaceColumnFamilies) {
+        resync_required_ = true;
       }
       break;
     case kBatchTypeStream: {
@@ -917,8 +1781,8 @@ rocksdb::Status ReplicationThread::ParseWriteBatch(const std::string &batch_stri
       InternalKey ikey(key, storage_->IsSlotIdEncoded());
       Slice entry_id = ikey.GetSubKey();
       Redis::StreamEntryID id;
-      GetFixed64(&entry_id, &id.ms);
-      GetFixed64(&entry_id, &id.seq);
+      // the consumer groups are also stored in the stream column family, but their subkeys are longer than IDs
+      if (!GetFixed64(&entry_id, &id.ms) || !GetFixed64(&entry_id, &id.seq) || !entry_id.empty()) break;
       srv_->OnEntryAddedToStream(ikey.GetNamespace().ToString(), ikey.GetKey().ToString(), id);
       break;
     }
@@ -953,3 +1817,15 @@ rocksdb::Status WriteBatchHandler::PutCF(uint32_t column_family_id, const rocksd
   }
   return rocksdb::Status::OK();
 }
+
+void WriteBatchHandler::LogData(const rocksdb::Slice &blob) {
+  // The master puts the log data of its replication id at the end of the batch
+  if (ServerLogData::IsServerLogData(blob.data())) {
+    ServerLogData serverlog;
+    if (serverlog.Decode(blob).IsOK() && serverlog.GetType() == kReplIdLog) {
+      replid_ = serverlog.GetContent();
+    } else if (serverlog.GetType() == kShardPubSubLog) {
+      shard_publish_ = true;
+    }
+  }
+}
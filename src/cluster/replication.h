@@ -21,15 +21,22 @@
 #pragma once
 
 #include <event2/bufferevent.h>
+#include <event2/event.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <tuple>
 #include <utility>
 #include <vector>
 
+#include "compression_util.h"
+#include "event_util.h"
+#include "fd_util.h"
 #include "server/redis_connection.h"
 #include "status.h"
 #include "storage/storage.h"
@@ -57,41 +64,227 @@ enum WriteBatchType {
 
 using fetch_file_callback = std::function<void(const std::string, const uint32_t)>;
 
+// The master sends the heartbeat "heartbeat <latest seq>" at this interval to the replicas which
+// track their lags by the heartbeats, so the lag is precise to about this interval
+constexpr uint64_t kReplHeartbeatIntervalMS = 100;
+// The replica publishes "<applied seq> <lag ms>" into the channel when its applied sequence number
+// changed, or its lag changed by at least kReplLagPublishStepMS
+constexpr const char *kReplicaLagChannel = "__kvrocks_replica_lag__";
+constexpr int64_t kReplLagPublishStepMS = 100;
+
+// The max time to wait for the new data of the WAL before checking the states, e.g. stopped
+constexpr int64_t kWALWaitMicroseconds = 100 * 1000;
+
+// Send the size bytes starting from the offset of the file to the replica as the compressed
+// chunks, every chunk is a bulk string
+Status SendFileCompressed(int out_fd, int in_fd, size_t size, off_t offset = 0);
+// Calculate the crc32c checksum of the first size bytes of the file
+Status CalculateFileCRC(int fd, size_t size, uint32_t *crc);
+
+// The backlog of the recent batches in the WAL, it's filled by one WAL reader and shared by all
+// replicas, so the replicas which keep up with the master don't read the WAL files by themselves.
+// The replica which lags beyond the backlog falls back to read the WAL.
+class ReplBacklog {
+ public:
+  struct Batch {
+    rocksdb::SequenceNumber seq = 0;
+    uint32_t count = 0;
+    std::string data;
+  };
+
+  enum class ReadResult {
+    kOK,
+    kNotYet,      // the batch isn't written yet
+    kOutOfRange,  // the batch was evicted from the backlog or before the start of the backlog
+  };
+
+  ReplBacklog(Engine::Storage *storage, size_t max_bytes) : storage_(storage), max_bytes_(max_bytes) {}
+  ~ReplBacklog() { Stop(); }
+  ReplBacklog(const ReplBacklog &) = delete;
+  ReplBacklog &operator=(const ReplBacklog &) = delete;
+
+  Status Start();
+  void Stop();
+  // Get the batch starting at the sequence number, wait at most timeout_us if it isn't written yet
+  ReadResult Get(rocksdb::SequenceNumber seq, int64_t timeout_us, Batch *batch);
+  // Whether the batch starting at the sequence number is in the backlog or would be appended next
+  bool Contains(rocksdb::SequenceNumber seq);
+  // Write a byte to the fd once the batch starting at the sequence number was appended, just like
+  // Storage::ArmWALWakeup. Return false without arming the wakeup if it needn't wait for the batch.
+  bool ArmWakeup(int fd, rocksdb::SequenceNumber seq);
+  rocksdb::SequenceNumber FirstSeq();
+  size_t Batches();
+  size_t Bytes();
+
+ private:
+  Engine::Storage *storage_ = nullptr;
+  size_t max_bytes_;
+  std::thread t_;
+  std::atomic<bool> stop_ = false;
+  std::mutex mu_;
+  std::condition_variable cond_;
+  std::deque<Batch> batches_;
+  size_t bytes_ = 0;
+  // The sequence number of the next batch to append
+  rocksdb::SequenceNumber next_seq_ = 0;
+  // The fd armed by ArmWakeup, or -1
+  std::atomic<int> wakeup_fd_{-1};
+
+  void loop();
+  void append(rocksdb::SequenceNumber seq, uint32_t count, std::string data);
+  void reset(rocksdb::SequenceNumber next_seq);
+  void wakeup();
+  bool containsLocked(rocksdb::SequenceNumber seq) const;
+};
+
+class ReplFeeder;
+
+// The feeder of the replication stream of a replica, it doesn't have its own thread, all feeders
+// are run by the event loop of ReplFeeder
 class FeedSlaveThread {
  public:
-  explicit FeedSlaveThread(Server *srv, Redis::Connection *conn, rocksdb::SequenceNumber next_repl_seq)
-      : srv_(srv), conn_(conn), next_repl_seq_(next_repl_seq) {}
+  explicit FeedSlaveThread(Server *srv, Redis::Connection *conn, rocksdb::SequenceNumber next_repl_seq);
   ~FeedSlaveThread() = default;
 
   Status Start();
   void Stop();
+  // Wait until the event loop released the feeder, it should be stopped before
   void Join();
   bool IsStopped() { return stop_; }
   Redis::Connection *GetConn() { return conn_.get(); }
   rocksdb::SequenceNumber GetCurrentReplSeq() { return next_repl_seq_ == 0 ? 0 : next_repl_seq_ - 1; }
+  bool IsCompressed() const { return compressor_ != nullptr; }
+  // The bytes of the replication stream before and after the compression
+  uint64_t GetRawBytes() const { return raw_bytes_; }
+  uint64_t GetSentBytes() const { return sent_bytes_; }
+  // The latest sequence number applied by the replica, it's 0 if the replica doesn't acknowledge
+  rocksdb::SequenceNumber GetAckSeq() const { return ack_seq_; }
+  // The bytes of the stream which the socket couldn't take yet
+  size_t GetOutputBytes() const { return output_bytes_; }
 
  private:
-  uint64_t interval = 0;
-  bool stop_ = false;
+  friend class ReplFeeder;
+
+  enum class FeedResult {
+    kIdle,     // the replica caught up, wait for the wakeup of the WAL or the backlog
+    kMore,     // the budget of the turn was used up
+    kBlocked,  // wait until the socket is writable
+    kRetry,    // failed to read the WAL, retry after a while
+  };
+
+  uint64_t last_ping_time_ = 0;
+  const uint64_t kPingIntervalMS = 2000;
+  uint64_t last_heartbeat_time_ = 0;
+  std::atomic<bool> stop_ = false;
   Server *srv_ = nullptr;
+  ReplBacklog *backlog_ = nullptr;
   std::unique_ptr<Redis::Connection> conn_ = nullptr;
   rocksdb::SequenceNumber next_repl_seq_ = 0;
-  std::thread t_;
+  ReplFeeder *feeder_ = nullptr;
+  // Whether the event loop uses the feeder, it's guarded by the mutex of the feeder
+  bool attached_ = false;
+  event *write_event_ = nullptr;
+  // It reads the acknowledgements of the replica
+  event *ack_event_ = nullptr;
+  std::string ack_buf_;
+  std::atomic<rocksdb::SequenceNumber> ack_seq_ = 0;
   std::unique_ptr<rocksdb::TransactionLogIterator> iter_ = nullptr;
+  // The batch of the iterator was fed, move the iterator once the WAL has the next one
+  bool iter_fed_ = false;
+  // Whether the caught up replica waits for the backlog rather than the WAL
+  bool wait_backlog_ = false;
+  // It was used to fix that replication may be stuck in a dead loop when some seqs might be lost
+  // in the middle of the WAL log, so forced to replicate first batch here to work around this issue
+  // instead of waiting for enough batch size.
+  bool is_first_repl_batch_ = true;
+  std::string batches_bulk_;
+  size_t updates_in_batches_ = 0;
   const size_t kMaxDelayUpdates = 16;
   const size_t kMaxDelayBytes = 16 * 1024;
+  // The bytes of the batches fed in one turn, so a lagging replica doesn't starve the others
+  const size_t kMaxFeedBytesPerTurn = 256 * 1024;
+  UniqueEvbuf output_;
+  std::atomic<size_t> output_bytes_ = 0;
+  std::unique_ptr<Util::ZstdStreamCompressor> compressor_ = nullptr;
+  std::atomic<uint64_t> raw_bytes_ = 0;
+  std::atomic<uint64_t> sent_bytes_ = 0;
 
-  void loop();
+  // Feed the batches until the replica caught up, the socket is full or the budget was used up
+  FeedResult feed();
+  static void onAckRead(evutil_socket_t fd, int16_t events, void *ctx);
   void checkLivenessIfNeed();
+  void sendHeartbeatIfNeed();
+  Status send(const std::string &data);
+  // Write the pending stream to the socket without blocking
+  Status flush();
+};
+
+// The event loop which feeds the replication stream to all replicas in one thread. It's woken up
+// by the writers once the WAL or the backlog has the batches waited by the caught up replicas,
+// and the replicas whose sockets are full are fed again once they're writable.
+class ReplFeeder {
+ public:
+  explicit ReplFeeder(Server *srv) : srv_(srv) {}
+  ~ReplFeeder() { Stop(); }
+  ReplFeeder(const ReplFeeder &) = delete;
+  ReplFeeder &operator=(const ReplFeeder &) = delete;
+
+  Status Start();
+  void Stop();
+  Status Attach(FeedSlaveThread *slave);
+  // Stop the feeder and wait until the event loop released it
+  void Detach(FeedSlaveThread *slave);
+
+ private:
+  Server *srv_ = nullptr;
+  event_base *base_ = nullptr;
+  UniqueFD wakeup_read_fd_;
+  UniqueFD wakeup_write_fd_;
+  event *wakeup_event_ = nullptr;
+  // It's activated to feed in the next turn of the loop, or added to retry after a while
+  event *feed_event_ = nullptr;
+  event *timer_ = nullptr;
+  std::thread t_;
+  std::atomic<bool> stop_ = false;
+  std::mutex mu_;
+  std::condition_variable cond_;
+  std::vector<FeedSlaveThread *> attaching_;
+  // The attached feeders, they're only used by the thread of the loop
+  std::vector<FeedSlaveThread *> slaves_;
+
+  void loop();
+  void wakeup();
+  // Attach the new feeders and release the stopped ones
+  void updateSlaves();
+  void feedAll();
+  Status attachSlave(FeedSlaveThread *slave);
+  void releaseSlave(FeedSlaveThread *slave);
+  // Return true if the pending stream of the feeder was written entirely
+  bool flushSlave(FeedSlaveThread *slave);
+  static void onSlaveWrite(evutil_socket_t fd, int16_t events, void *ctx);
+  static void onWakeup(evutil_socket_t fd, int16_t events, void *ctx);
+  static void onFeed(evutil_socket_t fd, int16_t events, void *ctx);
+  static void onTimer(evutil_socket_t fd, int16_t events, void *ctx);
 };
 
 class ReplicationThread {
  public:
-  explicit ReplicationThread(std::string host, uint32_t port, Server *srv);
+  // The replica is bootstrapped from the local backup before PSYNC if the backup dir is set,
+  // the master only sends the WAL after the backup if it's still in its replication history
+  explicit ReplicationThread(std::string host, uint32_t port, Server *srv, std::string backup_dir = "");
   Status Start(std::function<void()> &&pre_fullsync_cb, std::function<void()> &&post_fullsync_cb);
   void Stop();
   ReplState State() { return repl_state_; }
   time_t LastIOTime() { return last_io_time_; }
+  // The batches which were received from the master but not applied yet
+  size_t PendingApplyBatches();
+  size_t PendingApplyBytes();
+  // The sequence number after the last received batch, the replica lags the master by at
+  // least the difference between it and the latest sequence number
+  rocksdb::SequenceNumber ReceivedSeq() { return received_seq_; }
+  // The milliseconds since the latest time when the replica applied all writes of the master,
+  // it's -1 if unknown, e.g. the master doesn't send the heartbeats
+  int64_t LagMS();
 
  protected:
   event_base *base_ = nullptr;
@@ -117,6 +310,7 @@ class ReplicationThread {
 
     void Start();
     void Stop();
+    bufferevent *GetBufferEvent() { return bev_; }
     static void EvCallback(bufferevent *bev, void *ctx);
     static void ConnEventCB(bufferevent *bev, int16_t events, void *state_machine_ptr);
     static void SetReadCB(bufferevent *bev, bufferevent_data_cb cb, void *state_machine_ptr);
@@ -140,11 +334,20 @@ class ReplicationThread {
   bool stop_flag_ = false;
   std::string host_;
   uint32_t port_;
+  std::string backup_dir_;
   Server *srv_ = nullptr;
   Engine::Storage *storage_ = nullptr;
   ReplState repl_state_;
   time_t last_io_time_ = 0;
   bool next_try_old_psync_ = false;
+  // Try the replconf without the options which the old master doesn't know
+  bool next_try_basic_replconf_ = false;
+  // The compression of the replication stream if the master accepts it, see ReplCompression
+  int repl_compression_ = 0;
+  // Whether to acknowledge the applied sequence number to the master by "replconf ack"
+  bool ack_enabled_ = false;
+  // Activated by the applier to send the acknowledgement in the event loop
+  event *ack_event_ = nullptr;
 
   std::function<void()> pre_fullsync_cb_;
   std::function<void()> post_fullsync_cb_;
@@ -157,6 +360,7 @@ class ReplicationThread {
   } fullsync_state_ = kFetchMetaID;
   rocksdb::BackupID fullsync_meta_id_ = 0;
   size_t fullsync_filesize_ = 0;
+  uint64_t fullsync_start_ms_ = 0;
 
   // Internal states managed by IncrementBatchLoop procedure
   enum IncrementBatchLoopState {
@@ -165,12 +369,38 @@ class ReplicationThread {
   } incr_state_ = Incr_batch_size;
 
   size_t incr_bulk_len_ = 0;
+  // The decompressed but not applied data of the compressed stream
+  std::unique_ptr<Util::ZstdStreamDecompressor> incr_decompressor_ = nullptr;
+  std::string incr_decompressed_;
+
+  // The received batches are applied by the applier thread in order, so receiving, decompressing and
+  // parsing the stream in the event loop overlaps applying the batches
+  static constexpr size_t kMaxPendingApplyBytes = 64 * 1024 * 1024;
+  std::thread applier_;
+  std::mutex apply_mu_;
+  std::condition_variable apply_cv_;
+  std::deque<std::string> pending_batches_;
+  size_t pending_bytes_ = 0;
+  bool applying_ = false;
+  bool applier_stop_ = false;
+  Status apply_status_;
+  std::atomic<rocksdb::SequenceNumber> received_seq_ = 0;
+  // Set by the applier once it applied the marker of the bulk loading or the changed column families
+  std::atomic<bool> resync_required_ = false;
+  // The latest sequence numbers of the master in the heartbeats and the times when they were received,
+  // the replica is fresh as of the time once it applied the sequence number. They're guarded by apply_mu_.
+  static constexpr size_t kMaxPendingHeartbeats = 1024;
+  std::deque<std::pair<rocksdb::SequenceNumber, uint64_t>> pending_heartbeats_;
+  std::atomic<uint64_t> fresh_time_ms_ = 0;
+  rocksdb::SequenceNumber lag_published_seq_ = 0;
+  int64_t lag_published_ms_ = -1;
 
   using CBState = CallbacksStateMachine::State;
   CallbacksStateMachine psync_steps_;
   CallbacksStateMachine fullsync_steps_;
 
   void run();
+  void restoreFromLocalBackup();
 
   static CBState authWriteCB(bufferevent *bev, void *ctx);
   static CBState authReadCB(bufferevent *bev, void *ctx);
@@ -187,14 +417,22 @@ class ReplicationThread {
   // Synchronized-Blocking ops
   Status sendAuth(int sock_fd);
   Status fetchFile(int sock_fd, evbuffer *evbuf, const std::string &dir, const std::string &file, uint32_t crc,
-                   const fetch_file_callback &fn);
+                   uint64_t resume_offset, uint32_t resume_crc, const fetch_file_callback &fn);
   Status fetchFiles(int sock_fd, const std::string &dir, const std::vector<std::string> &files,
                     const std::vector<uint32_t> &crcs, const fetch_file_callback &fn);
   Status parallelFetchFile(const std::string &dir, const std::vector<std::pair<std::string, uint32_t>> &files);
+  void applyLoop();
+  void updateFreshness();
+  void publishLagIfChanged();
+  Status applyBatch(const std::string &batch);
+  Status queueBatch(std::string &&batch);
+  Status waitForBatchesApplied();
+  Status queueDecompressedBatches();
   static bool isRestoringError(const char *err);
   static bool isWrongPsyncNum(const char *err);
 
   static void EventTimerCB(int, int16_t, void *ctx);
+  static void AckEventCB(int, int16_t, void *ctx);
 
   rocksdb::Status ParseWriteBatch(const std::string &batch_string);
 };
@@ -212,11 +450,19 @@ class WriteBatchHandler : public rocksdb::WriteBatch::Handler {
                                 const rocksdb::Slice &end_key) override {
     return rocksdb::Status::OK();
   }
+  rocksdb::Status MergeCF(uint32_t column_family_id, const rocksdb::Slice &key, const rocksdb::Slice &value) override {
+    return rocksdb::Status::OK();
+  }
+  void LogData(const rocksdb::Slice &blob) override;
   WriteBatchType Type() { return type_; }
   std::string Key() const { return kv_.first; }
   std::string Value() const { return kv_.second; }
+  std::string ReplId() const { return replid_; }
+  bool IsShardPublish() const { return shard_publish_; }
 
  private:
   std::pair<std::string, std::string> kv_;
   WriteBatchType type_ = kBatchTypeNone;
+  std::string replid_;
+  bool shard_publish_ = false;
 };
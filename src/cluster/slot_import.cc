@@ -20,6 +20,11 @@
 
 #include "slot_import.h"
 
+#include <rocksdb/env.h>
+#include <rocksdb/sst_file_reader.h>
+
+#include "scope_exit.h"
+
 SlotImport::SlotImport(Server *svr) : Database(svr->storage_, kDefaultNamespace), svr_(svr) {
   std::lock_guard<std::mutex> guard(mutex_);
   // Let db_ and metadata_cf_handle_ be nullptr, then get them in real time while use them.
@@ -28,40 +33,41 @@ SlotImport::SlotImport(Server *svr) : Database(svr->storage_, kDefaultNamespace)
   metadata_cf_handle_ = nullptr;
 
   import_fd_ = -1;
-  import_slot_ = -1;
+  import_slots_ = SlotRange();
   import_status_ = kImportNone;
 }
 
-bool SlotImport::Start(int fd, int slot) {
+bool SlotImport::Start(int fd, const SlotRange &slots) {
   std::lock_guard<std::mutex> guard(mutex_);
   if (import_status_ == kImportStart) {
     LOG(ERROR) << "[import] Only one slot importing is allowed"
-               << ", current slot is " << import_slot_ << ", cannot import slot " << slot;
+               << ", current slot is " << import_slots_.String() << ", cannot import slot " << slots.String();
     return false;
   }
 
   // Clean slot data first
-  auto s = ClearKeysOfSlot(namespace_, slot);
+  auto s = ClearKeysOfSlot(namespace_, slots);
   if (!s.ok()) {
-    LOG(INFO) << "[import] Failed to clear keys of slot " << slot << "current status is importing 'START'"
+    LOG(INFO) << "[import] Failed to clear keys of slot " << slots.String() << "current status is importing 'START'"
               << ", Err: " << s.ToString();
     return false;
   }
 
   import_status_ = kImportStart;
-  import_slot_ = slot;
+  import_slots_ = slots;
   import_fd_ = fd;
   return true;
 }
 
-bool SlotImport::Success(int slot) {
+bool SlotImport::Success(const SlotRange &slots) {
   std::lock_guard<std::mutex> guard(mutex_);
-  if (import_slot_ != slot) {
-    LOG(ERROR) << "[import] Wrong slot, importing slot: " << import_slot_ << ", but got slot: " << slot;
+  if (import_slots_ != slots) {
+    LOG(ERROR) << "[import] Wrong slot, importing slot: " << import_slots_.String()
+               << ", but got slot: " << slots.String();
     return false;
   }
 
-  Status s = svr_->cluster_->SetSlotImported(import_slot_);
+  Status s = svr_->cluster_->SetSlotImported(import_slots_);
   if (!s.IsOK()) {
     LOG(ERROR) << "[import] Failed to set slot, Err: " << s.Msg();
     return false;
@@ -72,17 +78,19 @@ bool SlotImport::Success(int slot) {
   return true;
 }
 
-bool SlotImport::Fail(int slot) {
+bool SlotImport::Fail(const SlotRange &slots) {
   std::lock_guard<std::mutex> guard(mutex_);
-  if (import_slot_ != slot) {
-    LOG(ERROR) << "[import] Wrong slot, importing slot: " << import_slot_ << ", but got slot: " << slot;
+  if (import_slots_ != slots) {
+    LOG(ERROR) << "[import] Wrong slot, importing slot: " << import_slots_.String()
+               << ", but got slot: " << slots.String();
     return false;
   }
 
   // Clean imported slot data
-  auto s = ClearKeysOfSlot(namespace_, slot);
+  auto s = ClearKeysOfSlot(namespace_, slots);
   if (!s.ok()) {
-    LOG(INFO) << "[import] Failed to clear keys of slot " << slot << ", current importing status is importing 'FAIL'"
+    LOG(INFO) << "[import] Failed to clear keys of slot " << slots.String()
+              << ", current importing status is importing 'FAIL'"
               << ", Err: " << s.ToString();
   }
 
@@ -91,6 +99,64 @@ bool SlotImport::Fail(int slot) {
   return true;
 }
 
+// The key-values are written by the write batches rather than ingesting the file, so the
+// writes are in WAL and can be replicated to the replicas, the TTL index and the key counter
+// are also maintained while writing the metadata.
+Status SlotImport::ImportSst(const SlotRange &slots, const std::string &data) {
+  // Hold the lock while writing, so the slot can't be cleared by the failure in the meantime
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (import_status_ != kImportStart || import_slots_ != slots) {
+    return {Status::NotOK, fmt::format("Slot {} isn't being imported", slots.String())};
+  }
+
+  std::string path = svr_->GetConfig()->dir + "/import_slot_" + slots.String() + ".sst";
+  auto s = rocksdb::WriteStringToFile(rocksdb::Env::Default(), data, path);
+  auto exit = MakeScopeExit([&path] { rocksdb::Env::Default()->DeleteFile(path); });
+  if (!s.ok()) return {Status::NotOK, s.ToString()};
+
+  rocksdb::SstFileReader reader(storage_->GetDB()->GetOptions());
+  s = reader.Open(path);
+  if (s.ok()) s = reader.VerifyChecksum();
+  if (!s.ok()) return {Status::NotOK, s.ToString()};
+
+  // Only the column families of the keys are accepted
+  const std::string &cf_name = reader.GetTableProperties()->column_family_name;
+  if (cf_name != Engine::kMetadataColumnFamilyName && cf_name != Engine::kSubkeyColumnFamilyName &&
+      cf_name != Engine::kZSetScoreColumnFamilyName && cf_name != Engine::kZSetRankColumnFamilyName &&
+      cf_name != Engine::kStreamColumnFamilyName) {
+    return {Status::NotOK, "Invalid column family of SST file: " + cf_name};
+  }
+  rocksdb::ColumnFamilyHandle *cf_handle = storage_->GetCFHandle(cf_name);
+
+  std::string prefix, prefix_end;
+  ComposeSlotKeyPrefix(namespace_, slots.start, &prefix);
+  ComposeSlotKeyPrefix(namespace_, slots.end + 1, &prefix_end);
+  uint64_t entries = 0;
+  rocksdb::WriteBatch batch;
+  std::unique_ptr<rocksdb::Iterator> iter(reader.NewIterator(rocksdb::ReadOptions()));
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    if (iter->key().compare(prefix) < 0 || iter->key().compare(prefix_end) >= 0) {
+      return {Status::NotOK, fmt::format("The key of SST file doesn't belong to slot {}", slots.String())};
+    }
+    batch.Put(cf_handle, iter->key(), iter->value());
+    entries++;
+    if (batch.GetDataSize() >= kImportBatchSize) {
+      s = storage_->Write(storage_->DefaultWriteOptions(), &batch);
+      if (!s.ok()) return {Status::NotOK, s.ToString()};
+      batch.Clear();
+    }
+  }
+  if (!iter->status().ok()) return {Status::NotOK, iter->status().ToString()};
+  if (batch.Count() > 0) {
+    s = storage_->Write(storage_->DefaultWriteOptions(), &batch);
+    if (!s.ok()) return {Status::NotOK, s.ToString()};
+  }
+
+  LOG(INFO) << "[import] Succeed to import SST file of column family " << cf_name << ", slot: " << slots.String()
+            << ", entries: " << entries;
+  return Status::OK();
+}
+
 void SlotImport::StopForLinkError(int fd) {
   std::lock_guard<std::mutex> guard(mutex_);
   if (import_status_ != kImportStart) return;
@@ -106,21 +172,22 @@ void SlotImport::StopForLinkError(int fd) {
   //    from new master.
   if (!svr_->IsSlave()) {
     // Clean imported slot data
-    auto s = ClearKeysOfSlot(namespace_, import_slot_);
+    auto s = ClearKeysOfSlot(namespace_, import_slots_);
     if (!s.ok()) {
-      LOG(WARNING) << "[import] Failed to clear keys of slot " << import_slot_ << " Current status is link error"
+      LOG(WARNING) << "[import] Failed to clear keys of slot " << import_slots_.String()
+                   << " Current status is link error"
                    << ", Err: " << s.ToString();
     }
   }
 
-  LOG(INFO) << "[import] Stop importing for link error, slot: " << import_slot_;
+  LOG(INFO) << "[import] Stop importing for link error, slot: " << import_slots_.String();
   import_status_ = kImportFailed;
   import_fd_ = -1;
 }
 
-int SlotImport::GetSlot() {
+SlotRange SlotImport::GetSlots() {
   std::lock_guard<std::mutex> guard(mutex_);
-  return import_slot_;
+  return import_slots_;
 }
 
 int SlotImport::GetStatus() {
@@ -131,7 +198,7 @@ int SlotImport::GetStatus() {
 void SlotImport::GetImportInfo(std::string *info) {
   std::lock_guard<std::mutex> guard(mutex_);
   info->clear();
-  if (import_slot_ < 0) {
+  if (!import_slots_.IsValid()) {
     return;
   }
 
@@ -153,5 +220,5 @@ void SlotImport::GetImportInfo(std::string *info) {
       break;
   }
 
-  *info = fmt::format("importing_slot: {}\r\nimport_state: {}\r\n", import_slot_, import_stat);
+  *info = fmt::format("importing_slot: {}\r\nimport_state: {}\r\n", import_slots_.String(), import_stat);
 }
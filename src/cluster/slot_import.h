@@ -27,6 +27,7 @@
 #include <vector>
 
 #include "config/config.h"
+#include "status.h"
 #include "server/server.h"
 #include "storage/redis_db.h"
 
@@ -41,18 +42,22 @@ class SlotImport : public Redis::Database {
  public:
   explicit SlotImport(Server *svr);
   ~SlotImport() = default;
-  bool Start(int fd, int slot);
-  bool Success(int slot);
-  bool Fail(int slot);
+  bool Start(int fd, const SlotRange &slots);
+  bool Success(const SlotRange &slots);
+  bool Fail(const SlotRange &slots);
+  // Write the key-values in the SST file sent by the source into DB, while importing the slots
+  Status ImportSst(const SlotRange &slots, const std::string &data);
   void StopForLinkError(int fd);
-  int GetSlot();
+  SlotRange GetSlots();
   int GetStatus();
   void GetImportInfo(std::string *info);
 
  private:
+  static const size_t kImportBatchSize = 4 * 1024 * 1024;
+
   Server *svr_ = nullptr;
   std::mutex mutex_;
-  int import_slot_;
+  SlotRange import_slots_;
   int import_status_;
   int import_fd_;
 };
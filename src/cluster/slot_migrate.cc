@@ -20,6 +20,7 @@
 
 #include "slot_migrate.h"
 
+#include <algorithm>
 #include <memory>
 #include <utility>
 
@@ -29,6 +30,8 @@
 #include "storage/batch_extractor.h"
 #include "thread_util.h"
 #include "time_util.h"
+#include "types/redis_bitmap.h"
+#include "types/redis_sortedint.h"
 
 static std::map<RedisType, std::string> type_to_cmd = {
     {kRedisString, "set"}, {kRedisList, "rpush"},    {kRedisHash, "hmset"},      {kRedisSet, "sadd"},
@@ -74,9 +77,9 @@ SlotMigrate::SlotMigrate(Server *svr, int speed, int pipeline_size, int seq_gap)
   }
 
   dst_port_ = -1;
-  forbidden_slot_ = -1;
-  migrate_slot_ = -1;
-  migrate_failed_slot_ = -1;
+  forbidden_slots_ = SlotRange();
+  migrate_slots_ = SlotRange();
+  migrate_failed_slots_ = SlotRange();
   migrate_state_ = kMigrateNone;
   stop_migrate_ = false;
   slot_snapshot_ = nullptr;
@@ -87,15 +90,15 @@ SlotMigrate::SlotMigrate(Server *svr, int speed, int pipeline_size, int seq_gap)
 }
 
 Status SlotMigrate::MigrateStart(Server *svr, const std::string &node_id, const std::string &dst_ip, int dst_port,
-                                 int slot, int speed, int pipeline_size, int seq_gap) {
-  // Only one slot migration job at the same time
-  int16_t no_slot = -1;
-  if (migrate_slot_.compare_exchange_strong(no_slot, (int16_t)slot) == false) {
+                                 const SlotRange &slots, int speed, int pipeline_size, int seq_gap) {
+  // Only one slot migration job at the same time, but it can migrate a range of slots
+  SlotRange no_slots;
+  if (migrate_slots_.compare_exchange_strong(no_slots, slots) == false) {
     return Status(Status::NotOK, "There is already a migrating slot");
   }
-  if (forbidden_slot_ == slot) {
+  if (forbidden_slots_.load().Overlaps(slots)) {
     // Have to release migrate slot set above
-    migrate_slot_ = -1;
+    migrate_slots_ = SlotRange();
     return Status(Status::NotOK, "Can't migrate slot which has been migrated");
   }
 
@@ -112,13 +115,15 @@ Status SlotMigrate::MigrateStart(Server *svr, const std::string &node_id, const
   dst_node_ = node_id;
 
   // Create migration job
-  auto job = std::make_unique<SlotMigrateJob>(slot, dst_ip, dst_port, speed, pipeline_size, seq_gap);
+  auto job = std::make_unique<SlotMigrateJob>(slots, dst_ip, dst_port, speed, pipeline_size, seq_gap);
+  job->migrate_type_ = svr->GetConfig()->migrate_type;
+  ack_latency_target_ = svr->GetConfig()->migrate_ack_latency_target;
   {
     std::lock_guard<std::mutex> guard(job_mutex_);
     slot_job_ = std::move(job);
     job_cv_.notify_one();
   }
-  LOG(INFO) << "[migrate] Start migrating slot " << slot << " to " << dst_ip << ":" << dst_port;
+  LOG(INFO) << "[migrate] Start migrating slot " << slots.String() << " to " << dst_ip << ":" << dst_port;
   return Status::OK();
 }
 
@@ -156,7 +161,7 @@ void SlotMigrate::Loop() {
       return;
     }
 
-    LOG(INFO) << "[migrate] migrate_slot: " << slot_job_->migrate_slot_ << ", dst_ip: " << slot_job_->dst_ip_
+    LOG(INFO) << "[migrate] migrate_slot: " << slot_job_->migrate_slots_.String() << ", dst_ip: " << slot_job_->dst_ip_
               << ", dst_port: " << slot_job_->dst_port_ << ", speed_limit: " << slot_job_->speed_limit_
               << ", pipeline_size_limit: " << slot_job_->pipeline_size_;
 
@@ -164,6 +169,8 @@ void SlotMigrate::Loop() {
     dst_port_ = slot_job_->dst_port_;
     migrate_speed_ = slot_job_->speed_limit_;
     pipeline_size_limit_ = slot_job_->pipeline_size_;
+    pipeline_window_ = pipeline_size_limit_;
+    ack_latency_ = 0;
     seq_gap_limit_ = slot_job_->seq_gap_;
 
     StateMachine();
@@ -215,7 +222,7 @@ void SlotMigrate::StateMachine() {
       case kSlotMigrateSuccess: {
         auto s = Success();
         if (s.IsOK()) {
-          LOG(INFO) << "[migrate] Succeed to migrate slot " << migrate_slot_;
+          LOG(INFO) << "[migrate] Succeed to migrate slot " << migrate_slots_.load().String();
           state_machine_ = kSlotMigrateClean;
           migrate_state_ = kMigrateSuccess;
         } else {
@@ -225,7 +232,7 @@ void SlotMigrate::StateMachine() {
       }
       case kSlotMigrateFailed:
         Fail();
-        LOG(INFO) << "[migrate] Failed to migrate slot" << migrate_slot_;
+        LOG(INFO) << "[migrate] Failed to migrate slot" << migrate_slots_.load().String();
         migrate_state_ = kMigrateFailed;
         state_machine_ = kSlotMigrateClean;
         break;
@@ -275,28 +282,36 @@ Status SlotMigrate::Start() {
     return Status(Status::NotOK);
   }
 
-  LOG(INFO) << "[migrate] Start migrating slot " << migrate_slot_ << ", connect destination fd " << slot_job_->slot_fd_;
+  LOG(INFO) << "[migrate] Start migrating slot " << migrate_slots_.load().String() << ", connect destination fd "
+            << slot_job_->slot_fd_;
   return Status::OK();
 }
 
 Status SlotMigrate::SendSnapshot() {
+  if (slot_job_->migrate_type_ == kMigrateTypeSst) return SendSnapshotBySst();
+
   // Create DB iter of snapshot
   uint64_t migratedkey_cnt = 0, expiredkey_cnt = 0, emptykey_cnt = 0;
   std::string restore_cmds;
-  int16_t slot = migrate_slot_;
-  LOG(INFO) << "[migrate] Start migrating snapshot of slot " << slot;
+  SlotRange slots = migrate_slots_;
+  LOG(INFO) << "[migrate] Start migrating snapshot of slot " << slots.String();
+
+  // Construct key prefix to iterate the keys belong to the target slots, the keys of the
+  // continuous slots are continuous too
+  std::string prefix, prefix_end;
+  ComposeSlotKeyPrefix(namespace_, slots.start, &prefix);
+  ComposeSlotKeyPrefix(namespace_, slots.end + 1, &prefix_end);
+  rocksdb::Slice upper_bound(prefix_end);
+  LOG(INFO) << "[migrate] Iterate keys of slot, key's prefix: " << prefix;
 
   rocksdb::ReadOptions read_options;
+  storage_->SetLongScanReadOptions(&read_options);
   read_options.snapshot = slot_snapshot_;
   read_options.fill_cache = false;
+  read_options.iterate_upper_bound = &upper_bound;
   rocksdb::ColumnFamilyHandle *cf_handle = storage_->GetCFHandle("metadata");
   std::unique_ptr<rocksdb::Iterator> iter(storage_->GetDB()->NewIterator(read_options, cf_handle));
 
-  // Construct key prefix to iterate the keys belong to the target slot
-  std::string prefix;
-  ComposeSlotKeyPrefix(namespace_, slot, &prefix);
-  LOG(INFO) << "[migrate] Iterate keys of slot, key's prefix: " << prefix;
-
   // Seek to the beginning of keys start with 'prefix' and iterate all these keys
   for (iter->Seek(prefix); iter->Valid(); iter->Next()) {
     // The migrating task has to be stopped, if server role is changed from master to slave
@@ -306,11 +321,6 @@ Status SlotMigrate::SendSnapshot() {
       return Status(Status::NotOK);
     }
 
-    // Iteration is out of range
-    if (!iter->key().starts_with(prefix)) {
-      break;
-    }
-
     // Get user key
     std::string ns, user_key;
     ExtractNamespaceKey(iter->key(), &ns, &user_key, true);
@@ -337,8 +347,116 @@ Status SlotMigrate::SendSnapshot() {
     return Status(Status::NotOK);
   }
 
-  LOG(INFO) << "[migrate] Succeed to migrate slot snapshot, slot: " << slot << ", Migrated keys: " << migratedkey_cnt
-            << ", Expired keys: " << expiredkey_cnt << ", Emtpy keys: " << emptykey_cnt;
+  LOG(INFO) << "[migrate] Succeed to migrate slot snapshot, slot: " << slots.String()
+            << ", Migrated keys: " << migratedkey_cnt << ", Expired keys: " << expiredkey_cnt
+            << ", Emtpy keys: " << emptykey_cnt;
+  return Status::OK();
+}
+
+// Write the key-values of the slot in the snapshot into the SST files and send them to the
+// destination, which writes them into its DB directly instead of replaying the commands.
+// The column families are written one by one, and the SST file is sent once it's big enough.
+Status SlotMigrate::SendSnapshotBySst() {
+  SlotRange slots = migrate_slots_;
+  LOG(INFO) << "[migrate] Start migrating snapshot of slot " << slots.String() << " by SST files";
+
+  // All column families of the keys, their keys are prefixed by the slot. The TTL index is
+  // built by the destination while writing the metadata.
+  static const std::vector<std::string> cf_names = {
+      Engine::kMetadataColumnFamilyName, Engine::kSubkeyColumnFamilyName, Engine::kZSetScoreColumnFamilyName,
+      Engine::kZSetRankColumnFamilyName, Engine::kStreamColumnFamilyName};
+  std::string prefix, prefix_end;
+  ComposeSlotKeyPrefix(namespace_, slots.start, &prefix);
+  ComposeSlotKeyPrefix(namespace_, slots.end + 1, &prefix_end);
+  rocksdb::Slice upper_bound(prefix_end);
+  std::string path = svr_->GetConfig()->dir + "/migrate_slot_" + slots.String() + ".sst";
+
+  uint64_t migratedkey_cnt = 0, entries_cnt = 0, files_cnt = 0;
+  for (const auto &cf_name : cf_names) {
+    rocksdb::ReadOptions read_options;
+    storage_->SetLongScanReadOptions(&read_options);
+    read_options.snapshot = slot_snapshot_;
+    read_options.fill_cache = false;
+    read_options.iterate_upper_bound = &upper_bound;
+    rocksdb::ColumnFamilyHandle *cf_handle = storage_->GetCFHandle(cf_name);
+    std::unique_ptr<rocksdb::Iterator> iter(storage_->GetDB()->NewIterator(read_options, cf_handle));
+
+    std::unique_ptr<rocksdb::SstFileWriter> writer;
+    uint64_t entries = 0;
+    for (iter->Seek(prefix); iter->Valid(); iter->Next()) {
+      // The migrating task has to be stopped, if server role is changed from master to slave
+      // or flush command (flushdb or flushall) is executed
+      if (stop_migrate_) {
+        LOG(ERROR) << "[migrate] Stop migrating snapshot due to the thread stopped";
+        return Status(Status::NotOK);
+      }
+
+      rocksdb::Status s;
+      if (!writer) {
+        writer = std::make_unique<rocksdb::SstFileWriter>(rocksdb::EnvOptions(),
+                                                          storage_->GetDB()->GetOptions(cf_handle), cf_handle);
+        s = writer->Open(path);
+      }
+      if (s.ok()) s = writer->Put(iter->key(), iter->value());
+      if (!s.ok()) {
+        LOG(ERROR) << "[migrate] Failed to write SST file " << path << ", Err: " << s.ToString();
+        return Status(Status::NotOK);
+      }
+      entries++;
+      if (cf_name == Engine::kMetadataColumnFamilyName) migratedkey_cnt++;
+
+      if (writer->FileSize() >= kMigrateSstFileSize) {
+        auto st = SendSstFile(writer.get(), path, entries);
+        if (!st.IsOK()) return st;
+        writer = nullptr;
+        entries_cnt += entries;
+        files_cnt++;
+        entries = 0;
+      }
+    }
+    if (!iter->status().ok()) {
+      LOG(ERROR) << "[migrate] Failed to iterate the slot, Err: " << iter->status().ToString();
+      return Status(Status::NotOK);
+    }
+    if (writer) {
+      auto st = SendSstFile(writer.get(), path, entries);
+      if (!st.IsOK()) return st;
+      entries_cnt += entries;
+      files_cnt++;
+    }
+  }
+
+  LOG(INFO) << "[migrate] Succeed to migrate slot snapshot by SST files, slot: " << slots.String()
+            << ", Migrated keys: " << migratedkey_cnt << ", Entries: " << entries_cnt << ", Files: " << files_cnt;
+  return Status::OK();
+}
+
+Status SlotMigrate::SendSstFile(rocksdb::SstFileWriter *writer, const std::string &path, uint64_t entries) {
+  std::string data;
+  auto s = writer->Finish();
+  if (s.ok()) s = rocksdb::ReadFileToString(rocksdb::Env::Default(), path, &data);
+  rocksdb::Env::Default()->DeleteFile(path);
+  if (!s.ok()) {
+    LOG(ERROR) << "[migrate] Failed to finish SST file " << path << ", Err: " << s.ToString();
+    return Status(Status::NotOK);
+  }
+
+  // The SST file is limited as the commands of its entries
+  MigrateSpeedLimit(std::max<uint64_t>(1, entries / kMaxItemsInCommand));
+
+  std::string slot = migrate_slots_.load().String();
+  auto st = Util::SockSend(slot_job_->slot_fd_, Redis::MultiBulkString({"cluster", "importsst", slot, data}, false));
+  if (!st.IsOK()) {
+    LOG(ERROR) << "[migrate] Failed to send SST file, Err: " << st.Msg();
+    return Status(Status::NotOK);
+  }
+  last_send_time_ = Util::GetTimeStampUS();
+
+  // The destination has to write the whole file before responding
+  if (!CheckResponseWithCounts(slot_job_->slot_fd_, 1, kSstResponseTimeout)) {
+    LOG(ERROR) << "[migrate] Wrong response of importing SST file";
+    return Status(Status::NotOK);
+  }
   return Status::OK();
 }
 
@@ -361,7 +479,7 @@ Status SlotMigrate::SyncWal() {
 
 Status SlotMigrate::Success() {
   if (stop_migrate_) {
-    LOG(ERROR) << "[migrate] Stop migrating slot " << migrate_slot_;
+    LOG(ERROR) << "[migrate] Stop migrating slot " << migrate_slots_.load().String();
     return Status(Status::NotOK);
   }
   // Set destination status SUCCESS
@@ -370,12 +488,14 @@ Status SlotMigrate::Success() {
     return Status(Status::NotOK);
   }
   std::string dst_ip_port = dst_ip_ + ":" + std::to_string(dst_port_);
-  Status st = svr_->cluster_->SetSlotMigrated(migrate_slot_, dst_ip_port);
+  Status st = svr_->cluster_->SetSlotMigrated(migrate_slots_, dst_ip_port);
   if (!st.IsOK()) {
     LOG(ERROR) << "[migrate] Failed to set slot, Err:" << st.Msg();
     return Status(Status::NotOK);
   }
-  migrate_failed_slot_ = -1;
+  // The requests of the slots are moved to the destination from now on
+  RecordForbiddenTime();
+  migrate_failed_slots_ = SlotRange();
   return Status::OK();
 }
 
@@ -385,13 +505,14 @@ Status SlotMigrate::Fail() {
     LOG(INFO) << "[migrate] Failed to notify the destination that data migration failed";
   }
   // Stop slot will forbid writing
-  migrate_failed_slot_ = migrate_slot_;
-  forbidden_slot_ = -1;
+  migrate_failed_slots_ = migrate_slots_.load();
+  forbidden_slots_ = SlotRange();
+  RecordForbiddenTime();
   return Status::OK();
 }
 
 Status SlotMigrate::Clean() {
-  LOG(INFO) << "[migrate] Clean resources of migrating slot " << migrate_slot_;
+  LOG(INFO) << "[migrate] Clean resources of migrating slot " << migrate_slots_.load().String();
   if (slot_snapshot_) {
     storage_->GetDB()->ReleaseSnapshot(slot_snapshot_);
     slot_snapshot_ = nullptr;
@@ -401,9 +522,11 @@ Status SlotMigrate::Clean() {
   current_pipeline_size_ = 0;
   wal_begin_seq_ = 0;
   wal_increment_seq_ = 0;
+  sent_bytes_ = 0;
+  forbidden_start_time_ = 0;
   std::lock_guard<std::mutex> guard(job_mutex_);
   slot_job_ = nullptr;
-  migrate_slot_ = -1;
+  migrate_slots_ = SlotRange();
   SetMigrateStopFlag(false);
   return Status::OK();
 }
@@ -412,14 +535,14 @@ bool SlotMigrate::AuthDstServer(int sock_fd, const std::string &password) {
   std::string cmd = Redis::MultiBulkString({"auth", password}, false);
   auto s = Util::SockSend(sock_fd, cmd);
   if (!s.IsOK()) {
-    LOG(ERROR) << "[migrate] Failed to send auth command to destination, slot: " << migrate_slot_
+    LOG(ERROR) << "[migrate] Failed to send auth command to destination, slot: " << migrate_slots_.load().String()
                << ", error: " << s.Msg();
     return false;
   }
 
   if (!CheckResponseOnce(sock_fd)) {
     LOG(ERROR) << "[migrate] Failed to auth destination server with '" << password << "', stop migrating slot "
-               << migrate_slot_;
+               << migrate_slots_.load().String();
     return false;
   }
   return true;
@@ -428,8 +551,8 @@ bool SlotMigrate::AuthDstServer(int sock_fd, const std::string &password) {
 bool SlotMigrate::SetDstImportStatus(int sock_fd, int status) {
   if (sock_fd <= 0) return false;
 
-  int slot = migrate_slot_;
-  std::string cmd = Redis::MultiBulkString({"cluster", "import", std::to_string(slot), std::to_string(status)});
+  std::string slot = migrate_slots_.load().String();
+  std::string cmd = Redis::MultiBulkString({"cluster", "import", slot, std::to_string(status)});
   auto s = Util::SockSend(sock_fd, cmd);
   if (!s.IsOK()) {
     LOG(ERROR) << "[migrate] Failed to send import command to destination, slot: " << slot << ", error: " << s.Msg();
@@ -465,7 +588,7 @@ bool SlotMigrate::CheckResponseOnce(int sock_fd) { return CheckResponseWithCount
 // lrem         Redis::Integer
 // sirem        Redis::Integer
 // del          Redis::Integer
-bool SlotMigrate::CheckResponseWithCounts(int sock_fd, int total) {
+bool SlotMigrate::CheckResponseWithCounts(int sock_fd, int total, int timeout_sec) {
   if (sock_fd < 0 || total <= 0) {
     LOG(INFO) << "[migrate] Invalid args, sock_fd: " << sock_fd << ", count: " << total;
     return false;
@@ -473,7 +596,7 @@ bool SlotMigrate::CheckResponseWithCounts(int sock_fd, int total) {
 
   // Set socket receive timeout first
   struct timeval tv;
-  tv.tv_sec = 1;
+  tv.tv_sec = timeout_sec;
   tv.tv_usec = 0;
   setsockopt(sock_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 
@@ -569,10 +692,29 @@ Status SlotMigrate::MigrateOneKey(const rocksdb::Slice &key, const rocksdb::Slic
     return Status(Status::cOK, "expired");
   }
 
+  if (slot_job_->migrate_type_ == kMigrateTypeDump) {
+    if (!MigrateDumpKey(key, metadata, restore_cmds)) {
+      LOG(ERROR) << "[migrate] Failed to migrate key by dump: " << key.ToString();
+      return Status(Status::NotOK);
+    }
+    return Status::OK();
+  }
+
+  // The elements of the inline key are stored in its metadata value
+  std::vector<std::string> elements;
+  if (DecodeInlineElements(bytes, &elements)) {
+    if (!MigrateInlineKey(key, metadata, elements, restore_cmds)) {
+      LOG(ERROR) << "[migrate] Failed to migrate inline key: " << key.ToString();
+      return Status(Status::NotOK);
+    }
+    return Status::OK();
+  }
+
   // Construct command according to type of the key
   switch (metadata.Type()) {
     case kRedisString: {
-      bool s = MigrateSimpleKey(key, metadata, bytes, restore_cmds);
+      bool s = metadata.IsChunkedString() ? MigrateChunkedStringKey(key, metadata, restore_cmds)
+                                          : MigrateSimpleKey(key, metadata, bytes, restore_cmds);
       if (!s) {
         LOG(ERROR) << "[migrate] Failed to migrate simple key: " << key.ToString();
         return Status(Status::NotOK);
@@ -585,7 +727,7 @@ Status SlotMigrate::MigrateOneKey(const rocksdb::Slice &key, const rocksdb::Slic
     case kRedisHash:
     case kRedisSet:
     case kRedisSortedint: {
-      bool s = MigrateComplexKey(key, metadata, restore_cmds);
+      bool s = MigrateComplexKey(key, metadata, bytes, restore_cmds);
       if (!s) {
         LOG(ERROR) << "[migrate] Failed to migrate complex key: " << key.ToString();
         return Status(Status::NotOK);
@@ -617,13 +759,95 @@ bool SlotMigrate::MigrateSimpleKey(const rocksdb::Slice &key, const Metadata &me
   return true;
 }
 
-bool SlotMigrate::MigrateComplexKey(const rocksdb::Slice &key, const Metadata &metadata, std::string *restore_cmds) {
+// Every key is restored by a single RESTORE command whatever its type and size is,
+// the payload is dumped from the snapshot of the slot
+bool SlotMigrate::MigrateDumpKey(const rocksdb::Slice &key, const Metadata &metadata, std::string *restore_cmds) {
+  std::string payload;
+  auto s = DumpKey(key, &payload, slot_snapshot_);
+  if (!s.ok()) {
+    LOG(ERROR) << "[migrate] Failed to dump key: " << s.ToString();
+    return false;
+  }
+
+  std::string ttl_ms = std::to_string(static_cast<uint64_t>(metadata.expire) * 1000);
+  *restore_cmds += Redis::MultiBulkString({"restore", key.ToString(), ttl_ms, payload, "REPLACE", "ABSTTL"}, false);
+  current_pipeline_size_++;
+
+  if (!SendCmdsPipelineIfNeed(restore_cmds, false)) {
+    LOG(ERROR) << "[migrate] Failed to send dumped key";
+    return false;
+  }
+  return true;
+}
+
+// The chunked string is restored by writing its chunks into an empty string with SETRANGE
+bool SlotMigrate::MigrateChunkedStringKey(const rocksdb::Slice &key, const Metadata &metadata,
+                                          std::string *restore_cmds) {
+  *restore_cmds += Redis::MultiBulkString({"set", key.ToString(), ""}, false);
+  current_pipeline_size_++;
+
+  rocksdb::ReadOptions read_options;
+  storage_->SetLongScanReadOptions(&read_options);
+  read_options.snapshot = slot_snapshot_;
+  read_options.fill_cache = false;
+  std::unique_ptr<rocksdb::Iterator> iter(storage_->GetDB()->NewIterator(read_options));
+  std::string slot_key, prefix_subkey;
+  AppendNamespacePrefix(key, &slot_key);
+  InternalKey(slot_key, "", metadata.version, true).Encode(&prefix_subkey);
+  for (iter->Seek(prefix_subkey); iter->Valid() && iter->key().starts_with(prefix_subkey); iter->Next()) {
+    if (stop_migrate_) {
+      LOG(ERROR) << "[migrate] Stop migrating chunked string due to task stopped";
+      return false;
+    }
+    InternalKey inkey(iter->key(), true);
+    *restore_cmds += Redis::MultiBulkString(
+        {"setrange", key.ToString(), inkey.GetSubKey().ToString(), iter->value().ToString()}, false);
+    current_pipeline_size_++;
+    if (!SendCmdsPipelineIfNeed(restore_cmds, false)) {
+      LOG(ERROR) << "[migrate] Failed to send chunked string part";
+      return false;
+    }
+  }
+
+  if (metadata.expire > 0) {
+    *restore_cmds += Redis::MultiBulkString({"EXPIREAT", key.ToString(), std::to_string(metadata.expire)}, false);
+    current_pipeline_size_++;
+  }
+  if (!SendCmdsPipelineIfNeed(restore_cmds, false)) {
+    LOG(ERROR) << "[migrate] Failed to send chunked string";
+    return false;
+  }
+  return true;
+}
+
+bool SlotMigrate::MigrateInlineKey(const rocksdb::Slice &key, const Metadata &metadata,
+                                   const std::vector<std::string> &items, std::string *restore_cmds) {
+  std::vector<std::string> command = {type_to_cmd[metadata.Type()], key.ToString()};
+  command.insert(command.end(), items.begin(), items.end());
+  *restore_cmds += Redis::MultiBulkString(command, false);
+  current_pipeline_size_++;
+
+  if (metadata.expire > 0) {
+    *restore_cmds += Redis::MultiBulkString({"EXPIREAT", key.ToString(), std::to_string(metadata.expire)}, false);
+    current_pipeline_size_++;
+  }
+
+  if (!SendCmdsPipelineIfNeed(restore_cmds, false)) {
+    LOG(ERROR) << "[migrate] Failed to send inline key";
+    return false;
+  }
+  return true;
+}
+
+bool SlotMigrate::MigrateComplexKey(const rocksdb::Slice &key, const Metadata &metadata, const std::string &bytes,
+                                    std::string *restore_cmds) {
   std::string cmd;
   cmd = type_to_cmd[metadata.Type()];
 
   // Construct key prefix to iterate values of the complex type user key
   std::vector<std::string> user_cmd = {cmd, key.ToString()};
   rocksdb::ReadOptions read_options;
+  storage_->SetLongScanReadOptions(&read_options);
   read_options.snapshot = slot_snapshot_;
   read_options.fill_cache = false;
   std::unique_ptr<rocksdb::Iterator> iter(storage_->GetDB()->NewIterator(read_options));
@@ -631,6 +855,13 @@ bool SlotMigrate::MigrateComplexKey(const rocksdb::Slice &key, const Metadata &m
   std::string slot_key, prefix_subkey;
   AppendNamespacePrefix(key, &slot_key);
   InternalKey(slot_key, "", metadata.version, true).Encode(&prefix_subkey);
+  // The segments of the bitmap might be stored as the containers, and the ids of the sortedint
+  // might be packed into the blocks
+  BitmapMetadata bitmap_metadata(false);
+  if (metadata.Type() == kRedisBitmap) bitmap_metadata.Decode(bytes);
+  SortedintMetadata sortedint_metadata(false);
+  if (metadata.Type() == kRedisSortedint) sortedint_metadata.Decode(bytes);
+  std::vector<uint64_t> block_ids;
   int item_count = 0;
   for (iter->Seek(prefix_subkey); iter->Valid(); iter->Next()) {
     if (stop_migrate_) {
@@ -653,7 +884,15 @@ bool SlotMigrate::MigrateComplexKey(const rocksdb::Slice &key, const Metadata &m
       }
       case kRedisSortedint: {
         auto id = DecodeFixed64(inkey.GetSubKey().ToString().data());
-        user_cmd.emplace_back(std::to_string(id));
+        if (!sortedint_metadata.blocks) {
+          user_cmd.emplace_back(std::to_string(id));
+          break;
+        }
+        if (!Redis::Sortedint::DecodeBlock(id, iter->value(), &block_ids)) {
+          LOG(ERROR) << "[migrate] Invalid sortedint block of key: " << key.ToString();
+          return false;
+        }
+        for (const auto block_id : block_ids) user_cmd.emplace_back(std::to_string(block_id));
         break;
       }
       case kRedisZSet: {
@@ -663,7 +902,7 @@ bool SlotMigrate::MigrateComplexKey(const rocksdb::Slice &key, const Metadata &m
         break;
       }
       case kRedisBitmap: {
-        if (!MigrateBitmapKey(inkey, &iter, &user_cmd, restore_cmds)) return false;
+        if (!MigrateBitmapKey(inkey, bitmap_metadata.containers, &iter, &user_cmd, restore_cmds)) return false;
         break;
       }
       case kRedisHash: {
@@ -719,11 +958,12 @@ bool SlotMigrate::MigrateComplexKey(const rocksdb::Slice &key, const Metadata &m
   return true;
 }
 
-bool SlotMigrate::MigrateBitmapKey(const InternalKey &inkey, std::unique_ptr<rocksdb::Iterator> *iter,
+bool SlotMigrate::MigrateBitmapKey(const InternalKey &inkey, bool containers, std::unique_ptr<rocksdb::Iterator> *iter,
                                    std::vector<std::string> *user_cmd, std::string *restore_cmds) {
   uint32_t index = 0, offset = 0;
   std::string index_str = inkey.GetSubKey().ToString();
-  std::string fragment = (*iter)->value().ToString();
+  std::string buffer;
+  std::string fragment = Redis::Bitmap::DecodeSegment(containers, (*iter)->value(), &buffer).ToString();
   auto parse_result = ParseInt<int>(index_str, 10);
   if (!parse_result) {
     LOG(ERROR) << "[migrate] Parse bitmap index error, Err: " << strerror(errno);
@@ -759,12 +999,14 @@ bool SlotMigrate::SendCmdsPipelineIfNeed(std::string *commands, bool need) {
   // Stop migrating or not
   if (stop_migrate_) {
     LOG(ERROR) << "[migrate] Stop sending data due to migrating thread stopped"
-               << ", current migrating slot: " << migrate_slot_;
+               << ", current migrating slot: " << migrate_slots_.load().String();
     return false;
   }
 
   // Check pipeline
-  if (need == false && current_pipeline_size_ < pipeline_size_limit_) {
+  int pipeline_size = pipeline_size_limit_;
+  if (ack_latency_target_ > 0) pipeline_size = std::min(pipeline_size, pipeline_window_.load());
+  if (need == false && current_pipeline_size_ < pipeline_size) {
     return true;
   }
   if (current_pipeline_size_ == 0) {
@@ -773,7 +1015,7 @@ bool SlotMigrate::SendCmdsPipelineIfNeed(std::string *commands, bool need) {
   }
 
   // Migrate speed limit
-  MigrateSpeedLimit();
+  MigrateSpeedLimit(pipeline_size);
 
   // Send pipeline
   auto s = Util::SockSend(slot_job_->slot_fd_, *commands);
@@ -782,6 +1024,7 @@ bool SlotMigrate::SendCmdsPipelineIfNeed(std::string *commands, bool need) {
     return false;
   }
   last_send_time_ = Util::GetTimeStampUS();
+  sent_bytes_ += commands->size();
 
   // Check response
   bool st = CheckResponseWithCounts(slot_job_->slot_fd_, current_pipeline_size_);
@@ -789,6 +1032,7 @@ bool SlotMigrate::SendCmdsPipelineIfNeed(std::string *commands, bool need) {
     LOG(ERROR) << "[migrate] Wrong response";
     return false;
   }
+  AdjustPipelineWindow(Util::GetTimeStampUS() - last_send_time_);
 
   // Clear commands and running pipeline
   commands->clear();
@@ -796,20 +1040,31 @@ bool SlotMigrate::SendCmdsPipelineIfNeed(std::string *commands, bool need) {
   return true;
 }
 
-void SlotMigrate::SetForbiddenSlot(int16_t slot) {
-  LOG(INFO) << "[migrate] Set forbidden slot " << slot;
-  forbidden_slot_ = slot;
+void SlotMigrate::SetForbiddenSlots(const SlotRange &slots) {
+  LOG(INFO) << "[migrate] Set forbidden slot " << slots.String();
+  forbidden_slots_ = slots;
 }
 
-void SlotMigrate::ReleaseForbiddenSlot() {
-  LOG(INFO) << "[migrate] Release forbidden slot " << forbidden_slot_;
-  forbidden_slot_ = -1;
+// Record the time of forbidding the writes of the migrating slots, it ends when the requests
+// are moved to the destination or the migration fails
+void SlotMigrate::RecordForbiddenTime() {
+  if (forbidden_start_time_ == 0) return;
+  uint64_t forbidden_time = Util::GetTimeStampUS() - forbidden_start_time_;
+  forbidden_start_time_ = 0;
+  svr_->stats_.IncrMigrateForbiddenTime(migrate_slots_.load().Count(), forbidden_time);
+  LOG(INFO) << "[migrate] The writes of slot " << migrate_slots_.load().String() << " were forbidden for "
+            << forbidden_time << "us";
 }
 
-void SlotMigrate::MigrateSpeedLimit() {
+void SlotMigrate::ReleaseForbiddenSlots() {
+  LOG(INFO) << "[migrate] Release forbidden slot " << forbidden_slots_.load().String();
+  forbidden_slots_ = SlotRange();
+}
+
+void SlotMigrate::MigrateSpeedLimit(uint64_t requests) {
   if (migrate_speed_ > 0) {
     uint64_t current_time = Util::GetTimeStampUS();
-    uint64_t per_request_time = 1000000 * pipeline_size_limit_ / migrate_speed_;
+    uint64_t per_request_time = 1000000 * requests / migrate_speed_;
     if (per_request_time == 0) {
       per_request_time = 1;
     }
@@ -821,9 +1076,27 @@ void SlotMigrate::MigrateSpeedLimit() {
   }
 }
 
+// Adapt the pipeline size by AIMD: grow it by one if the destination acknowledges the pipeline
+// in the target latency, and halve it once the acknowledgement is slower. The destination which
+// is busy or stalled by the compactions acknowledges slowly, so the source backs off quickly and
+// probes the capacity again slowly, the migrating speed is still the upper limit.
+void SlotMigrate::AdjustPipelineWindow(uint64_t ack_latency) {
+  ack_latency_ = ack_latency;
+  int target = ack_latency_target_;
+  if (target <= 0) return;
+
+  int window = std::min(pipeline_window_.load(), pipeline_size_limit_);
+  if (ack_latency > static_cast<uint64_t>(target) * 1000) {
+    window = std::max(1, window / 2);
+  } else if (window < pipeline_size_limit_) {
+    window++;
+  }
+  pipeline_window_ = window;
+}
+
 Status SlotMigrate::GenerateCmdsFromBatch(rocksdb::BatchResult *batch, std::string *commands) {
   // Iterate batch to get keys and construct commands for keys
-  WriteBatchExtractor write_batch_extractor(storage_->IsSlotIdEncoded(), migrate_slot_, false);
+  WriteBatchExtractor write_batch_extractor(storage_->IsSlotIdEncoded(), migrate_slots_, false);
   rocksdb::Status status = batch->writeBatchPtr->Iterate(&write_batch_extractor);
   if (!status.ok()) {
     LOG(ERROR) << "[migrate] Failed to parse write batch, Err: " << status.ToString();
@@ -895,8 +1168,12 @@ Status SlotMigrate::MigrateIncrementData(std::unique_ptr<rocksdb::TransactionLog
   return Status::OK();
 }
 
+// Sync WAL round by round until the rest is small enough to be sent in the forbidden phase.
+// The sequence gap counts the writes of all slots, so the bytes sent for the migrating slots
+// and the time of the last round are also checked, they're what the forbidden phase has to wait.
 Status SlotMigrate::SyncWalBeforeForbidSlot() {
   uint32_t count = 0;
+  uint64_t round_bytes = 0, round_time = 0;
   while (count < kMaxLoopTimes) {
     wal_increment_seq_ = storage_->GetDB()->GetLatestSequenceNumber();
     uint64_t gap = wal_increment_seq_ - wal_begin_seq_;
@@ -905,6 +1182,12 @@ Status SlotMigrate::SyncWalBeforeForbidSlot() {
                 << ", go to set forbidden slot";
       break;
     }
+    if (count > 0 && round_bytes <= kForbidSlotMaxBytes && round_time <= kForbidSlotMaxTime) {
+      LOG(INFO) << "[migrate] Last round of incremental data is " << round_bytes << " bytes in " << round_time
+                << "us, go to set forbidden slot";
+      break;
+    }
+    uint64_t round_start_bytes = sent_bytes_, round_start_time = Util::GetTimeStampUS();
 
     std::unique_ptr<rocksdb::TransactionLogIterator> iter = nullptr;
     auto s = storage_->GetWALIter(wal_begin_seq_ + 1, &iter);
@@ -922,6 +1205,8 @@ Status SlotMigrate::SyncWalBeforeForbidSlot() {
     }
 
     wal_begin_seq_ = wal_increment_seq_;
+    round_bytes = sent_bytes_ - round_start_bytes;
+    round_time = Util::GetTimeStampUS() - round_start_time;
     count++;
   }
   LOG(INFO) << "[migrate] Succeed to migrate incremental data before setting forbidden slot, end epoch: " << count;
@@ -933,7 +1218,8 @@ Status SlotMigrate::SyncWalAfterForbidSlot() {
   uint64_t during = Util::GetTimeStampUS();
   {
     auto exclusivity = svr_->WorkExclusivityGuard();
-    SetForbiddenSlot(migrate_slot_);
+    SetForbiddenSlots(migrate_slots_);
+    forbidden_start_time_ = Util::GetTimeStampUS();
   }
   wal_increment_seq_ = storage_->GetDB()->GetLatestSequenceNumber();
   during = Util::GetTimeStampUS() - during;
@@ -962,11 +1248,11 @@ Status SlotMigrate::SyncWalAfterForbidSlot() {
 
 void SlotMigrate::GetMigrateInfo(std::string *info) {
   info->clear();
-  if (migrate_slot_ < 0 && forbidden_slot_ < 0 && migrate_failed_slot_ < 0) {
+  if (!migrate_slots_.load().IsValid() && !forbidden_slots_.load().IsValid() && !migrate_failed_slots_.IsValid()) {
     return;
   }
 
-  int16_t slot = -1;
+  SlotRange slots;
   std::string task_state;
   switch (migrate_state_.load()) {
     case kMigrateNone:
@@ -974,20 +1260,23 @@ void SlotMigrate::GetMigrateInfo(std::string *info) {
       break;
     case kMigrateStart:
       task_state = "start";
-      slot = migrate_slot_;
+      slots = migrate_slots_;
       break;
     case kMigrateSuccess:
       task_state = "success";
-      slot = forbidden_slot_;
+      slots = forbidden_slots_;
       break;
     case kMigrateFailed:
       task_state = "fail";
-      slot = migrate_failed_slot_;
+      slots = migrate_failed_slots_;
       break;
     default:
       break;
   }
 
-  *info =
-      fmt::format("migrating_slot: {}\r\ndestination_node: {}\r\nmigrating_state: {}\r\n", slot, dst_node_, task_state);
+  *info = fmt::format("migrating_slot: {}\r\ndestination_node: {}\r\nmigrating_state: {}\r\n", slots.String(),
+                      dst_node_, task_state);
+  int pipeline_size = ack_latency_target_ > 0 ? pipeline_window_.load() : pipeline_size_limit_;
+  *info += fmt::format("migrating_pipeline_size: {}\r\nmigrating_ack_latency_us: {}\r\n", pipeline_size,
+                       ack_latency_.load());
 }
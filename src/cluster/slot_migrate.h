@@ -22,6 +22,7 @@
 
 #include <glog/logging.h>
 #include <rocksdb/db.h>
+#include <rocksdb/sst_file_writer.h>
 #include <rocksdb/status.h>
 #include <rocksdb/transaction_log.h>
 #include <rocksdb/write_batch.h>
@@ -58,8 +59,8 @@ enum MigrateStateMachine {
 };
 
 struct SlotMigrateJob {
-  SlotMigrateJob(int slot, std::string dst_ip, int port, int speed, int pipeline_size, int seq_gap)
-      : migrate_slot_(slot),
+  SlotMigrateJob(const SlotRange &slots, std::string dst_ip, int port, int speed, int pipeline_size, int seq_gap)
+      : migrate_slots_(slots),
         dst_ip_(dst_ip),
         dst_port_(port),
         speed_limit_(speed),
@@ -67,12 +68,13 @@ struct SlotMigrateJob {
         seq_gap_(seq_gap) {}
   ~SlotMigrateJob() { close(slot_fd_); }
   int slot_fd_ = -1;  // fd to send data to dst during migrate job
-  int migrate_slot_;
+  SlotRange migrate_slots_;
   std::string dst_ip_;
   int dst_port_;
   int speed_limit_;
   int pipeline_size_;
   int seq_gap_;
+  int migrate_type_ = kMigrateTypeRedisCommand;
 };
 
 class SlotMigrate : public Redis::Database {
@@ -83,23 +85,28 @@ class SlotMigrate : public Redis::Database {
 
   Status CreateMigrateHandleThread(void);
   void Loop();
-  Status MigrateStart(Server *svr, const std::string &node_id, const std::string &dst_ip, int dst_port, int slot,
-                      int speed, int pipeline_size, int seq_gap);
-  void ReleaseForbiddenSlot();
+  // Migrate the continuous slots in one job, they share the snapshot, the WAL syncing and the forbidden window
+  Status MigrateStart(Server *svr, const std::string &node_id, const std::string &dst_ip, int dst_port,
+                      const SlotRange &slots, int speed, int pipeline_size, int seq_gap);
+  void ReleaseForbiddenSlots();
   void SetMigrateSpeedLimit(int speed) {
     if (speed >= 0) migrate_speed_ = speed;
   }
   void SetPipelineSize(uint32_t size) {
     if (size > 0) pipeline_size_limit_ = size;
   }
+  void SetAckLatencyTarget(int target_ms) {
+    if (target_ms >= 0) ack_latency_target_ = target_ms;
+  }
   void SetSequenceGapSize(int size) {
     if (size > 0) seq_gap_limit_ = size;
   }
   void SetMigrateStopFlag(bool state) { stop_migrate_ = state; }
   int16_t GetMigrateState() { return migrate_state_; }
   int16_t GetMigrateStateMachine() { return state_machine_; }
-  int16_t GetForbiddenSlot(void) { return forbidden_slot_; }
-  int16_t GetMigratingSlot(void) { return migrate_slot_; }
+  SlotRange GetForbiddenSlots(void) { return forbidden_slots_; }
+  bool IsForbiddenSlot(int slot) { return forbidden_slots_.load().Contains(slot); }
+  SlotRange GetMigratingSlots(void) { return migrate_slots_; }
   void GetMigrateInfo(std::string *info);
   bool IsTerminated() { return thread_state_ == ThreadState::Terminated; }
 
@@ -107,6 +114,8 @@ class SlotMigrate : public Redis::Database {
   void StateMachine(void);
   Status Start(void);
   Status SendSnapshot(void);
+  Status SendSnapshotBySst(void);
+  Status SendSstFile(rocksdb::SstFileWriter *writer, const std::string &path, uint64_t entries);
   Status SyncWal(void);
   Status Success(void);
   Status Fail(void);
@@ -115,22 +124,29 @@ class SlotMigrate : public Redis::Database {
   bool AuthDstServer(int sock_fd, const std::string &password);
   bool SetDstImportStatus(int sock_fd, int status);
   bool CheckResponseOnce(int sock_fd);
-  bool CheckResponseWithCounts(int sock_fd, int total);
+  bool CheckResponseWithCounts(int sock_fd, int total, int timeout_sec = 1);
 
   Status MigrateOneKey(const rocksdb::Slice &key, const rocksdb::Slice &value, std::string *restore_cmds);
   bool MigrateSimpleKey(const rocksdb::Slice &key, const Metadata &metadata, const std::string &bytes,
                         std::string *restore_cmds);
-  bool MigrateComplexKey(const rocksdb::Slice &key, const Metadata &metadata, std::string *restore_cmds);
-  bool MigrateBitmapKey(const InternalKey &inkey, std::unique_ptr<rocksdb::Iterator> *iter,
+  bool MigrateChunkedStringKey(const rocksdb::Slice &key, const Metadata &metadata, std::string *restore_cmds);
+  bool MigrateInlineKey(const rocksdb::Slice &key, const Metadata &metadata, const std::vector<std::string> &items,
+                        std::string *restore_cmds);
+  bool MigrateComplexKey(const rocksdb::Slice &key, const Metadata &metadata, const std::string &bytes,
+                         std::string *restore_cmds);
+  bool MigrateDumpKey(const rocksdb::Slice &key, const Metadata &metadata, std::string *restore_cmds);
+  bool MigrateBitmapKey(const InternalKey &inkey, bool containers, std::unique_ptr<rocksdb::Iterator> *iter,
                         std::vector<std::string> *user_cmd, std::string *restore_cmds);
   bool SendCmdsPipelineIfNeed(std::string *commands, bool need);
-  void MigrateSpeedLimit(void);
+  void MigrateSpeedLimit(uint64_t requests);
+  void AdjustPipelineWindow(uint64_t ack_latency);
   Status GenerateCmdsFromBatch(rocksdb::BatchResult *batch, std::string *commands);
   Status MigrateIncrementData(std::unique_ptr<rocksdb::TransactionLogIterator> *iter, uint64_t endseq);
   Status SyncWalBeforeForbidSlot(void);
   Status SyncWalAfterForbidSlot(void);
   void MigrateWaitCmmdsFinish(void);
-  void SetForbiddenSlot(int16_t slot);
+  void SetForbiddenSlots(const SlotRange &slots);
+  void RecordForbiddenTime();
 
  private:
   Server *svr_;
@@ -151,6 +167,12 @@ class SlotMigrate : public Redis::Database {
   static const int kMaxItemsInCommand = 16;  // Iterms in every write commmand of complex keys
   static const int kSeqGapLimit = 10000;
   static const int kMaxLoopTimes = 10;
+  // The slot is forbidden once a round of syncing WAL sends at most the bytes in the time,
+  // then the last round sent in the forbidden phase is expected to be as small and short
+  static const uint64_t kForbidSlotMaxBytes = 256 * 1024L;
+  static const uint64_t kForbidSlotMaxTime = 20 * 1000L;  // in microseconds
+  static const uint64_t kMigrateSstFileSize = 32 * 1024L * 1024L;
+  static const int kSstResponseTimeout = 60;
 
   int current_pipeline_size_;
   int migrate_speed_ = kMigrateSpeed;
@@ -163,9 +185,9 @@ class SlotMigrate : public Redis::Database {
   std::string dst_node_;
   std::string dst_ip_;
   int dst_port_;
-  std::atomic<int16_t> forbidden_slot_;
-  std::atomic<int16_t> migrate_slot_;
-  int16_t migrate_failed_slot_;
+  std::atomic<SlotRange> forbidden_slots_;
+  std::atomic<SlotRange> migrate_slots_;
+  SlotRange migrate_failed_slots_;
   std::atomic<MigrateTaskState> migrate_state_;
   std::atomic<bool> stop_migrate_;  // stop_migrate_ is true will stop migrate but the migration thread won't destroy.
   std::string current_migrate_key_;
@@ -173,7 +195,14 @@ class SlotMigrate : public Redis::Database {
   const rocksdb::Snapshot *slot_snapshot_;
   uint64_t wal_begin_seq_;
   uint64_t wal_increment_seq_;
+  uint64_t sent_bytes_ = 0;
+  uint64_t forbidden_start_time_ = 0;
 
   int pipeline_size_limit_ = kPipelineSize;
+  // The adaptive pipeline size and the latency of the last acknowledgement in microseconds,
+  // see AdjustPipelineWindow
+  std::atomic<int> ack_latency_target_ = 0;
+  std::atomic<int> pipeline_window_ = kPipelineSize;
+  std::atomic<uint64_t> ack_latency_ = 0;
   int seq_gap_limit_ = kSeqGapLimit;
 };
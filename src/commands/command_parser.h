@@ -106,6 +106,18 @@ struct CommandParser {
     return res;
   }
 
+  StatusOr<double> TakeFloat() {
+    if (!Good()) return {Status::RedisParseErr, "no more item to parse"};
+
+    auto res = ParseFloat(RawPeek());
+
+    if (res) {
+      RawNext();
+    }
+
+    return res;
+  }
+
   static Status InvalidSyntax() { return {Status::RedisParseErr, "syntax error"}; }
 
  private:
@@ -23,11 +23,15 @@
 #include <fcntl.h>
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <climits>
 #include <cmath>
 #include <limits>
+#include <numeric>
 #include <optional>
+#include <set>
 #include <thread>
 #include <unordered_map>
 #include <utility>
@@ -39,7 +43,9 @@
 #include "command_parser.h"
 #include "fd_util.h"
 #include "io_util.h"
+#include "jemalloc_util.h"
 #include "parse_util.h"
+#include "scope_exit.h"
 #include "server/redis_connection.h"
 #include "server/redis_reply.h"
 #include "server/server.h"
@@ -53,8 +59,10 @@
 #include "thread_util.h"
 #include "time_util.h"
 #include "types/redis_bitmap.h"
+#include "types/redis_bloom_filter.h"
 #include "types/redis_geo.h"
 #include "types/redis_hash.h"
+#include "types/redis_hyperloglog.h"
 #include "types/redis_list.h"
 #include "types/redis_set.h"
 #include "types/redis_sortedint.h"
@@ -65,8 +73,11 @@
 namespace Redis {
 
 const char *kCursorPrefix = "_";
+// The cursor of a partition of SCAN PARALLEL, which carries the remaining key range of the partition
+const char *kParallelCursorPrefix = "#";
 
 const char *errInvalidSyntax = "syntax error";
+const char *errInvalidSampleRatio = "the sample ratio should be in the range (0, 1]";
 const char *errInvalidExpireTime = "invalid expire time";
 const char *errWrongNumOfArguments = "wrong number of arguments";
 const char *errValueNotInteger = "value is not an integer or out of range";
@@ -76,11 +87,64 @@ const char *errNoSuchKey = "no such key";
 const char *errUnbalancedStreamList =
     "Unbalanced XREAD list of streams: for each stream key an ID or '$' must be specified.";
 const char *errTimeoutIsNegative = "timeout is negative";
+const char *errXGroupKeyNotExist =
+    "The XGROUP subcommand requires the key to exist. "
+    "Note that for CREATE you may want to use the MKSTREAM option to create an empty stream automatically.";
 const char *errLimitOptionNotAllowed = "syntax error, LIMIT cannot be used without the special ~ option";
 const char *errZSetLTGTNX = "GT, LT, and/or NX options at the same time are not compatible";
 const char *errScoreIsNotValidFloat = "score is not a valid float";
 const char *errValueIsNotFloat = "value is not a valid float";
 const char *errNoMatchingScript = "NOSCRIPT No matching script. Please use EVAL";
+const char *errBloomFilterFull = "ERR non scaling filter is full";
+
+// The number of elements which are fetched from the storage and
+// serialized into the output buffer at a time by the streaming replies.
+const size_t kReplyChunkSize = 1024;
+// Try to write the output buffer into the socket once it grows beyond this size.
+const size_t kReplyFlushThreshold = 64 * 1024;
+
+// ChunkedArrayReply streams an array reply whose elements are fed in chunks, so only
+// one chunk of the collection is held in memory. The array length is sent along with
+// the first chunk, and nils would be padded if fewer elements than announced were fed.
+class ChunkedArrayReply {
+ public:
+  explicit ChunkedArrayReply(Connection *conn, bool output_nil_for_empty_string, uint64_t multiplier = 1)
+      : conn_(conn), output_nil_for_empty_string_(output_nil_for_empty_string), multiplier_(multiplier) {}
+
+  void Begin(uint64_t total) {
+    if (begun_) return;
+    begun_ = true;
+    total_ = total * multiplier_;
+    conn_->ReplyMultiLen(static_cast<int64_t>(total_));
+  }
+
+  void Add(const std::string &elem) {
+    if (replied_ >= total_) return;
+    if (elem.empty() && output_nil_for_empty_string_) {
+      conn_->ReplyNilString();
+    } else {
+      conn_->ReplyBulkString(elem);
+    }
+    replied_++;
+  }
+
+  void EndChunk() { conn_->FlushReply(kReplyFlushThreshold); }
+
+  void Finish() {
+    if (!begun_) Begin(0);
+    for (; replied_ < total_; replied_++) {
+      conn_->ReplyNilString();
+    }
+  }
+
+ private:
+  Connection *conn_;
+  bool output_nil_for_empty_string_;
+  uint64_t multiplier_;
+  bool begun_ = false;
+  uint64_t total_ = 0;
+  uint64_t replied_ = 0;
+};
 
 enum class AuthResult {
   OK,
@@ -219,26 +283,35 @@ class CommandNamespace : public Commander {
 class CommandKeys : public Commander {
  public:
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
-    std::string prefix = args_[1];
+    Util::GlobPattern pattern(args_[1]);
     std::vector<std::string> keys;
     Redis::Database redis(svr->storage_, conn->GetNamespace());
-    if (prefix == "*") {
-      redis.Keys(std::string(), &keys);
+    // Only the keys with the literal prefix are iterated, and the rest of the pattern is matched on them
+    auto matcher = pattern.MatchesAllWithPrefix() ? nullptr : &pattern;
+    if (auto runner = svr->GetScanRunner()) {
+      redis.ParallelKeys(pattern.LiteralPrefix(), &keys, matcher, runner, svr->GetConfig()->scan_parallel_threads);
     } else {
-      if (prefix[prefix.size() - 1] != '*') {
-        *output = Redis::Error("ERR only keys prefix match was supported");
-        return Status::OK();
-      }
-
-      redis.Keys(prefix.substr(0, prefix.size() - 1), &keys);
+      redis.Keys(pattern.LiteralPrefix(), &keys, nullptr, matcher);
     }
     *output = Redis::MultiBulkString(keys);
     return Status::OK();
   }
 };
 
+// Parse the optional [ASYNC|SYNC] of FLUSHDB and FLUSHALL, the data is dropped by the range
+// tombstone at once either way, and the dropped key range is compacted in background if ASYNC
+Status ParseFlushMode(const std::vector<std::string> &args, bool *async) {
+  if (args.size() == 1) return Status::OK();
+  auto mode = Util::ToLower(args[1]);
+  if (args.size() > 2 || (mode != "async" && mode != "sync")) return {Status::RedisParseErr, errInvalidSyntax};
+  *async = mode == "async";
+  return Status::OK();
+}
+
 class CommandFlushDB : public Commander {
  public:
+  Status Parse(const std::vector<std::string> &args) override { return ParseFlushMode(args, &async_); }
+
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
     if (svr->GetConfig()->cluster_enabled) {
       if (svr->slot_migrate_->GetMigrateState() == kMigrateStart) {
@@ -250,16 +323,30 @@ class CommandFlushDB : public Commander {
     auto s = redis.FlushDB();
     LOG(WARNING) << "DB keys in namespace: " << conn->GetNamespace() << " was flushed, addr: " << conn->GetAddr();
     if (s.ok()) {
+      if (async_) {
+        // All column families of the keys are prefixed by the namespace
+        std::string prefix;
+        ComposeNamespaceKey(conn->GetNamespace(), "", &prefix, false);
+        std::string prefix_end = prefix;
+        prefix_end.back()++;
+        auto st = svr->AsyncReclaimFlushedRange(prefix, prefix_end);
+        if (!st.IsOK()) LOG(WARNING) << "Failed to reclaim the flushed keys, err: " << st.Msg();
+      }
       *output = Redis::SimpleString("OK");
       return Status::OK();
     }
 
     return {Status::RedisExecErr, s.ToString()};
   }
+
+ private:
+  bool async_ = false;
 };
 
 class CommandFlushAll : public Commander {
  public:
+  Status Parse(const std::vector<std::string> &args) override { return ParseFlushMode(args, &async_); }
+
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
     if (!conn->IsAdmin()) {
       *output = Redis::Error(errAdministorPermissionRequired);
@@ -277,12 +364,19 @@ class CommandFlushAll : public Commander {
     auto s = redis.FlushAll();
     if (s.ok()) {
       LOG(WARNING) << "All DB keys was flushed, addr: " << conn->GetAddr();
+      if (async_) {
+        auto st = svr->AsyncReclaimFlushedRange("", "");
+        if (!st.IsOK()) LOG(WARNING) << "Failed to reclaim the flushed keys, err: " << st.Msg();
+      }
       *output = Redis::SimpleString("OK");
       return Status::OK();
     }
 
     return {Status::RedisExecErr, s.ToString()};
   }
+
+ private:
+  bool async_ = false;
 };
 
 class CommandPing : public Commander {
@@ -350,7 +444,8 @@ class CommandConfig : public Commander {
 class CommandGet : public Commander {
  public:
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
-    std::string value;
+    // The value is replied from the block cache directly while it's pinned
+    rocksdb::PinnableSlice value;
     Redis::String string_db(svr->storage_, conn->GetNamespace());
     auto s = string_db.Get(args_[1], &value);
     // The IsInvalidArgument error means the key type maybe a bitmap
@@ -360,13 +455,19 @@ class CommandGet : public Commander {
       Config *config = svr->GetConfig();
       uint32_t max_btos_size = static_cast<uint32_t>(config->max_bitmap_to_string_mb) * MiB;
       Redis::Bitmap bitmap_db(svr->storage_, conn->GetNamespace());
-      s = bitmap_db.GetString(args_[1], max_btos_size, &value);
+      value.Reset();
+      s = bitmap_db.GetString(args_[1], max_btos_size, value.GetSelf());
+      if (s.ok()) value.PinSelf();
     }
     if (!s.ok() && !s.IsNotFound()) {
       return {Status::RedisExecErr, s.ToString()};
     }
 
-    *output = s.IsNotFound() ? Redis::NilString() : Redis::BulkString(value);
+    if (s.IsNotFound()) {
+      conn->ReplyNilString();
+    } else {
+      conn->ReplyBulkString(value);
+    }
     return Status::OK();
   }
 };
@@ -489,24 +590,15 @@ class CommandGetRange : public Commander {
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
     std::string value;
     Redis::String string_db(svr->storage_, conn->GetNamespace());
-    auto s = string_db.Get(args_[1], &value);
+    auto s = string_db.GetRange(args_[1], start_, stop_, &value);
     if (!s.ok() && !s.IsNotFound()) {
       return {Status::RedisExecErr, s.ToString()};
     }
 
     if (s.IsNotFound()) {
       *output = Redis::NilString();
-      return Status::OK();
-    }
-
-    if (start_ < 0) start_ = static_cast<int>(value.size()) + start_;
-    if (stop_ < 0) stop_ = static_cast<int>(value.size()) + stop_;
-    if (start_ < 0) start_ = 0;
-    if (stop_ > static_cast<int>(value.size())) stop_ = static_cast<int>(value.size());
-    if (start_ > stop_) {
-      *output = Redis::NilString();
     } else {
-      *output = Redis::BulkString(value.substr(start_, stop_ - start_ + 1));
+      *output = Redis::BulkString(value);
     }
     return Status::OK();
   }
@@ -555,7 +647,7 @@ class CommandMGet : public Commander {
     std::vector<std::string> values;
     // always return OK
     auto statuses = string_db.MGet(keys, &values);
-    *output = Redis::MultiBulkString(values, statuses);
+    conn->ReplyMultiBulkString(values, statuses);
     return Status::OK();
   }
 };
@@ -765,7 +857,7 @@ class CommandIncr : public Commander {
     auto s = string_db.IncrBy(args_[1], 1, &ret);
     if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
 
-    *output = Redis::Integer(ret);
+    conn->ReplyInteger(ret);
     return Status::OK();
   }
 };
@@ -792,12 +884,25 @@ class CommandIncrBy : public Commander {
     }
 
     increment_ = *parse_result;
+    if (args.size() > 4 || (args.size() == 4 && !Util::EqualICase(args[3], "NOREPLY"))) {
+      return {Status::RedisParseErr, errInvalidSyntax};
+    }
+    no_reply_ = args.size() == 4;
     return Commander::Parse(args);
   }
 
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
     int64_t ret = 0;
     Redis::String string_db(svr->storage_, conn->GetNamespace());
+    if (no_reply_) {
+      // Skip reading the old value, and the failed increment is dropped silently
+      auto s = string_db.MergeIncrBy(args_[1], increment_);
+      if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
+
+      *output = Redis::SimpleString("OK");
+      return Status::OK();
+    }
+
     auto s = string_db.IncrBy(args_[1], increment_, &ret);
     if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
 
@@ -807,16 +912,17 @@ class CommandIncrBy : public Commander {
 
  private:
   int64_t increment_ = 0;
+  bool no_reply_ = false;
 };
 
 class CommandIncrByFloat : public Commander {
  public:
   Status Parse(const std::vector<std::string> &args) override {
-    try {
-      increment_ = std::stod(args[2]);
-    } catch (std::exception &e) {
+    auto increment = ParseFloat(args[2]);
+    if (!increment) {
       return {Status::RedisParseErr, errValueNotInteger};
     }
+    increment_ = *increment;
 
     return Commander::Parse(args);
   }
@@ -844,12 +950,25 @@ class CommandDecrBy : public Commander {
     }
 
     increment_ = *parse_result;
+    if (args.size() > 4 || (args.size() == 4 && !Util::EqualICase(args[3], "NOREPLY"))) {
+      return {Status::RedisParseErr, errInvalidSyntax};
+    }
+    no_reply_ = args.size() == 4;
     return Commander::Parse(args);
   }
 
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
     int64_t ret = 0;
     Redis::String string_db(svr->storage_, conn->GetNamespace());
+    if (no_reply_) {
+      // Skip reading the old value, and the failed increment is dropped silently
+      auto s = string_db.MergeIncrBy(args_[1], -1 * increment_);
+      if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
+
+      *output = Redis::SimpleString("OK");
+      return Status::OK();
+    }
+
     auto s = string_db.IncrBy(args_[1], -1 * increment_, &ret);
     if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
 
@@ -859,6 +978,7 @@ class CommandDecrBy : public Commander {
 
  private:
   int64_t increment_ = 0;
+  bool no_reply_ = false;
 };
 
 class CommandCAS : public Commander {
@@ -912,12 +1032,12 @@ class CommandCAD : public Commander {
 class CommandDel : public Commander {
  public:
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
-    int cnt = 0;
+    std::vector<Slice> keys(args_.begin() + 1, args_.end());
+    uint64_t cnt = 0;
     Redis::Database redis(svr->storage_, conn->GetNamespace());
-    for (size_t i = 1; i < args_.size(); i++) {
-      auto s = redis.Del(args_[i]);
-      if (s.ok()) cnt++;
-    }
+    auto s = redis.MDel(keys, &cnt);
+    if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
+
     *output = Redis::Integer(cnt);
     return Status::OK();
   }
@@ -1118,6 +1238,114 @@ class CommandBitOp : public Commander {
   BitOpFlags op_flag_;
 };
 
+class CommandBitfield : public Commander {
+ public:
+  explicit CommandBitfield(bool read_only = false) : read_only_(read_only) {}
+
+  Status Parse(const std::vector<std::string> &args) override {
+    Redis::BitfieldOverflow overflow = Redis::BitfieldOverflow::kWrap;
+    for (size_t i = 2; i < args.size();) {
+      std::string sub_command = Util::ToLower(args[i]);
+      if (sub_command == "overflow") {
+        if (i + 1 >= args.size()) return {Status::RedisParseErr, errInvalidSyntax};
+        std::string type = Util::ToLower(args[i + 1]);
+        if (type == "wrap") {
+          overflow = Redis::BitfieldOverflow::kWrap;
+        } else if (type == "sat") {
+          overflow = Redis::BitfieldOverflow::kSat;
+        } else if (type == "fail") {
+          overflow = Redis::BitfieldOverflow::kFail;
+        } else {
+          return {Status::RedisParseErr, "Invalid OVERFLOW type specified"};
+        }
+        i += 2;
+        continue;
+      }
+
+      Redis::BitfieldOperation op;
+      size_t num_args = 3;
+      if (sub_command == "get") {
+        op.type = Redis::BitfieldOpType::kGet;
+        num_args = 2;
+      } else if (sub_command == "set") {
+        op.type = Redis::BitfieldOpType::kSet;
+      } else if (sub_command == "incrby") {
+        op.type = Redis::BitfieldOpType::kIncrBy;
+      } else {
+        return {Status::RedisParseErr, errInvalidSyntax};
+      }
+      if (i + num_args >= args.size()) return {Status::RedisParseErr, errInvalidSyntax};
+      if (read_only_ && op.type != Redis::BitfieldOpType::kGet) {
+        return {Status::RedisParseErr, "BITFIELD_RO only supports the GET subcommand"};
+      }
+
+      auto s = parseType(args[i + 1], &op);
+      if (!s.IsOK()) return s;
+      s = parseOffset(args[i + 2], &op);
+      if (!s.IsOK()) return s;
+      if (op.type != Redis::BitfieldOpType::kGet) {
+        auto parse_value = ParseInt<int64_t>(args[i + 3], 10);
+        if (!parse_value) return {Status::RedisParseErr, errValueNotInteger};
+        op.value = *parse_value;
+      }
+      op.overflow = overflow;
+      ops_.emplace_back(op);
+      i += num_args + 1;
+    }
+
+    return Commander::Parse(args);
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    std::vector<std::optional<int64_t>> rets;
+    Redis::Bitmap bitmap_db(svr->storage_, conn->GetNamespace());
+    auto s = bitmap_db.Bitfield(args_[1], ops_, &rets);
+    if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
+
+    *output = Redis::MultiLen(static_cast<int64_t>(rets.size()));
+    for (const auto &ret : rets) {
+      *output += ret ? Redis::Integer(*ret) : Redis::NilString();
+    }
+    return Status::OK();
+  }
+
+ private:
+  // The type is like i16 or u8, the signed field is at most 64 bits and the unsigned one is at most 63 bits
+  static Status parseType(const std::string &arg, Redis::BitfieldOperation *op) {
+    bool is_signed = !arg.empty() && (arg[0] == 'i' || arg[0] == 'I');
+    bool is_unsigned = !arg.empty() && (arg[0] == 'u' || arg[0] == 'U');
+    auto parse_bits = ParseInt<int>(arg.empty() ? arg : arg.substr(1), 10);
+    if ((!is_signed && !is_unsigned) || !parse_bits || *parse_bits < 1 || *parse_bits > (is_signed ? 64 : 63)) {
+      return {Status::RedisParseErr,
+              "Invalid bitfield type. Use something like i16 u8. Note that u64 is not supported but i64 is."};
+    }
+    op->is_signed = is_signed;
+    op->bits = static_cast<uint8_t>(*parse_bits);
+    return Status::OK();
+  }
+
+  // The offset prefixed with # is multiplied by the width of the field
+  static Status parseOffset(const std::string &arg, Redis::BitfieldOperation *op) {
+    bool multiply = !arg.empty() && arg[0] == '#';
+    auto parse_offset = ParseInt<uint64_t>(multiply ? arg.substr(1) : arg, 10);
+    if (!parse_offset) return {Status::RedisParseErr, "bit offset is not an integer or out of range"};
+    uint64_t offset = multiply ? *parse_offset * op->bits : *parse_offset;
+    if ((multiply && *parse_offset > UINT32_MAX) || offset + op->bits - 1 > UINT32_MAX) {
+      return {Status::RedisParseErr, "bit offset is not an integer or out of range"};
+    }
+    op->offset = static_cast<uint32_t>(offset);
+    return Status::OK();
+  }
+
+  bool read_only_ = false;
+  std::vector<Redis::BitfieldOperation> ops_;
+};
+
+class CommandBitfieldRO : public CommandBitfield {
+ public:
+  CommandBitfieldRO() : CommandBitfield(true) {}
+};
+
 class CommandType : public Commander {
  public:
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
@@ -1343,17 +1571,109 @@ class CommandPersist : public Commander {
   }
 };
 
+class CommandDump : public Commander {
+ public:
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    Redis::Database redis(svr->storage_, conn->GetNamespace());
+    std::string payload;
+    auto s = redis.DumpKey(args_[1], &payload);
+    if (!s.ok() && !s.IsNotFound()) return {Status::RedisExecErr, s.ToString()};
+
+    *output = s.IsNotFound() ? Redis::NilString() : Redis::BulkString(payload);
+    return Status::OK();
+  }
+};
+
+class CommandRestore : public Commander {
+ public:
+  // RESTORE key ttl serialized-value [REPLACE] [ABSTTL] [IDLETIME seconds] [FREQ frequency]
+  Status Parse(const std::vector<std::string> &args) override {
+    auto parse_result = ParseInt<int64_t>(args[2], 10);
+    if (!parse_result) return {Status::RedisParseErr, errValueNotInteger};
+    if (*parse_result < 0) return {Status::RedisParseErr, "Invalid TTL value, must be >= 0"};
+    ttl_ms_ = *parse_result;
+
+    CommandParser parser(args, 4);
+    while (parser.Good()) {
+      if (parser.EatEqICase("replace")) {
+        replace_ = true;
+      } else if (parser.EatEqICase("absttl")) {
+        abs_ttl_ = true;
+      } else if (parser.EatEqICase("idletime") || parser.EatEqICase("freq")) {
+        // There is no LRU or LFU eviction, so the access hints are ignored
+        GET_OR_RET(parser.TakeInt<int64_t>());
+      } else {
+        return {Status::RedisParseErr, errInvalidSyntax};
+      }
+    }
+    return Commander::Parse(args);
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    auto now_ms = static_cast<int64_t>(Util::GetTimeStampMS());
+    int64_t expire_ms = 0;
+    if (ttl_ms_ > 0) expire_ms = abs_ttl_ ? ttl_ms_ : now_ms + ttl_ms_;
+    if (expire_ms / 1000 >= INT32_MAX) return {Status::RedisExecErr, "the expire time was overflow"};
+
+    Redis::Database redis(svr->storage_, conn->GetNamespace());
+    rocksdb::Status s;
+    // The keys of the importing slots are batched, the others are restored under their locks after the
+    // batched ones were written
+    auto restore_batch = conn->GetRestoreBatch();
+    bool batched = restore_batch && svr->GetConfig()->cluster_enabled &&
+                   svr->cluster_->IsImportingSlot(GetSlotNumFromKey(args_[1]));
+    if (restore_batch && !batched) {
+      s = redis.WriteRestoreBatch(restore_batch);
+      if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
+    }
+    if (expire_ms > 0 && expire_ms <= now_ms) {
+      if (batched) {
+        s = redis.WriteRestoreBatch(restore_batch);
+        if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
+      }
+      // The key would have been expired, only the replaced key is deleted
+      s = replace_ ? redis.Del(args_[1]) : rocksdb::Status::OK();
+      if (!s.ok() && !s.IsNotFound()) return {Status::RedisExecErr, s.ToString()};
+      *output = Redis::SimpleString("OK");
+      return Status::OK();
+    }
+
+    // The expire is in seconds, so it's rounded up to not expire the key earlier than requested
+    int expire = static_cast<int>((expire_ms + 999) / 1000);
+    s = batched ? redis.RestoreKey(args_[1], args_[3], expire, replace_, restore_batch)
+                : redis.RestoreKey(args_[1], args_[3], expire, replace_);
+    if (s.IsBusy()) {
+      *output = Redis::Error("BUSYKEY Target key name already exists.");
+      return Status::OK();
+    }
+    if (s.IsCorruption()) return {Status::RedisExecErr, "DUMP payload version or checksum are wrong"};
+    if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
+
+    *output = Redis::SimpleString("OK");
+    return Status::OK();
+  }
+
+ private:
+  int64_t ttl_ms_ = 0;
+  bool replace_ = false;
+  bool abs_ttl_ = false;
+};
+
 class CommandHGet : public Commander {
  public:
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
     Redis::Hash hash_db(svr->storage_, conn->GetNamespace());
-    std::string value;
+    rocksdb::PinnableSlice value;
     auto s = hash_db.Get(args_[1], args_[2], &value);
     if (!s.ok() && !s.IsNotFound()) {
       return {Status::RedisExecErr, s.ToString()};
     }
 
-    *output = s.IsNotFound() ? Redis::NilString() : Redis::BulkString(value);
+    if (s.IsNotFound()) {
+      conn->ReplyNilString();
+    } else {
+      conn->ReplyBulkString(value);
+    }
     return Status::OK();
   }
 };
@@ -1469,11 +1789,11 @@ class CommandHIncrBy : public Commander {
 class CommandHIncrByFloat : public Commander {
  public:
   Status Parse(const std::vector<std::string> &args) override {
-    try {
-      increment_ = std::stod(args[3]);
-    } catch (std::exception &e) {
+    auto increment = ParseFloat(args[3]);
+    if (!increment) {
       return {Status::RedisParseErr, errValueNotInteger};
     }
+    increment_ = *increment;
     return Commander::Parse(args);
   }
 
@@ -1511,9 +1831,9 @@ class CommandHMGet : public Commander {
 
     if (s.IsNotFound()) {
       values.resize(fields.size(), "");
-      *output = Redis::MultiBulkString(values);
+      conn->ReplyMultiBulkString(values);
     } else {
-      *output = Redis::MultiBulkString(values, statuses);
+      conn->ReplyMultiBulkString(values, statuses);
     }
     return Status::OK();
   }
@@ -1554,18 +1874,17 @@ class CommandHKeys : public Commander {
  public:
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
     Redis::Hash hash_db(svr->storage_, conn->GetNamespace());
-    std::vector<FieldValue> field_values;
-    auto s = hash_db.GetAll(args_[1], &field_values, HashFetchType::kOnlyKey);
+    ChunkedArrayReply reply(conn, true);
+    auto s = hash_db.GetAll(args_[1], HashFetchType::kOnlyKey, kReplyChunkSize,
+                            [&reply](uint64_t total, std::vector<FieldValue> *chunk) {
+                              reply.Begin(total);
+                              for (const auto &fv : *chunk) reply.Add(fv.field);
+                              reply.EndChunk();
+                            });
     if (!s.ok()) {
       return {Status::RedisExecErr, s.ToString()};
     }
-
-    std::vector<std::string> keys;
-    keys.reserve(field_values.size());
-    for (const auto &fv : field_values) {
-      keys.emplace_back(fv.field);
-    }
-    *output = Redis::MultiBulkString(keys);
+    reply.Finish();
 
     return Status::OK();
   }
@@ -1575,18 +1894,17 @@ class CommandHVals : public Commander {
  public:
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
     Redis::Hash hash_db(svr->storage_, conn->GetNamespace());
-    std::vector<FieldValue> field_values;
-    auto s = hash_db.GetAll(args_[1], &field_values, HashFetchType::kOnlyValue);
+    ChunkedArrayReply reply(conn, true);
+    auto s = hash_db.GetAll(args_[1], HashFetchType::kOnlyValue, kReplyChunkSize,
+                            [&reply](uint64_t total, std::vector<FieldValue> *chunk) {
+                              reply.Begin(total);
+                              for (const auto &p : *chunk) reply.Add(p.value);
+                              reply.EndChunk();
+                            });
     if (!s.ok()) {
       return {Status::RedisExecErr, s.ToString()};
     }
-
-    std::vector<std::string> values;
-    values.reserve(field_values.size());
-    for (const auto &p : field_values) {
-      values.emplace_back(p.value);
-    }
-    *output = MultiBulkString(values);
+    reply.Finish();
 
     return Status::OK();
   }
@@ -1596,22 +1914,66 @@ class CommandHGetAll : public Commander {
  public:
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
     Redis::Hash hash_db(svr->storage_, conn->GetNamespace());
-    std::vector<FieldValue> field_values;
-    auto s = hash_db.GetAll(args_[1], &field_values);
+    ChunkedArrayReply reply(conn, true, 2);
+    auto s = hash_db.GetAll(args_[1], HashFetchType::kAll, kReplyChunkSize,
+                            [&reply](uint64_t total, std::vector<FieldValue> *chunk) {
+                              reply.Begin(total);
+                              for (const auto &p : *chunk) {
+                                reply.Add(p.field);
+                                reply.Add(p.value);
+                              }
+                              reply.EndChunk();
+                            });
     if (!s.ok()) {
       return {Status::RedisExecErr, s.ToString()};
     }
+    reply.Finish();
 
-    std::vector<std::string> kv_pairs;
-    kv_pairs.reserve(field_values.size());
-    for (const auto &p : field_values) {
-      kv_pairs.emplace_back(p.field);
-      kv_pairs.emplace_back(p.value);
+    return Status::OK();
+  }
+};
+
+// HRANDFIELD key [count [WITHVALUES]]
+class CommandHRandField : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    if (args.size() > 4) return {Status::RedisParseErr, errInvalidSyntax};
+    if (args.size() >= 3) {
+      auto parse_result = ParseInt<int64_t>(args[2], {-INT32_MAX, INT32_MAX}, 10);
+      if (!parse_result) return {Status::RedisParseErr, errValueNotInteger};
+      count_ = *parse_result;
+      with_count_ = true;
     }
-    *output = MultiBulkString(kv_pairs);
+    if (args.size() == 4) {
+      if (Util::ToLower(args[3]) != "withvalues") return {Status::RedisParseErr, errInvalidSyntax};
+      with_values_ = true;
+    }
+    return Commander::Parse(args);
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    Redis::Hash hash_db(svr->storage_, conn->GetNamespace());
+    std::vector<FieldValue> field_values;
+    auto s = hash_db.RandField(args_[1], count_, &field_values);
+    if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
 
+    if (!with_count_) {
+      *output = field_values.empty() ? Redis::NilString() : Redis::BulkString(field_values.front().field);
+      return Status::OK();
+    }
+    std::vector<std::string> values;
+    for (auto &fv : field_values) {
+      values.emplace_back(std::move(fv.field));
+      if (with_values_) values.emplace_back(std::move(fv.value));
+    }
+    *output = Redis::MultiBulkString(values, false);
     return Status::OK();
   }
+
+ private:
+  int64_t count_ = 1;
+  bool with_count_ = false;
+  bool with_values_ = false;
 };
 
 class CommandHRange : public Commander {
@@ -1642,12 +2004,13 @@ class CommandHRange : public Commander {
       return {Status::RedisExecErr, s.ToString()};
     }
 
-    std::vector<std::string> kv_pairs;
+    ChunkedArrayReply reply(conn, true, 2);
+    reply.Begin(field_values.size());
     for (const auto &p : field_values) {
-      kv_pairs.emplace_back(p.field);
-      kv_pairs.emplace_back(p.value);
+      reply.Add(p.field);
+      reply.Add(p.value);
     }
-    *output = MultiBulkString(kv_pairs);
+    reply.Finish();
 
     return Status::OK();
   }
@@ -1783,6 +2146,86 @@ class CommandRPop : public CommandPop {
   CommandRPop() : CommandPop(false) {}
 };
 
+// Parse the arguments of the multi-key pops from the numkeys, which are `numkeys key [key ...]
+// <direction> [COUNT count]`. The direction is one of the two names, and it's true if it's the first one.
+static Status ParseMPopArgs(const std::vector<std::string> &args, size_t numkeys_index, const std::string &first,
+                            const std::string &second, std::vector<std::string> *keys, bool *is_first,
+                            uint32_t *count) {
+  auto numkeys = ParseInt<int>(args[numkeys_index], 10);
+  if (!numkeys) {
+    return {Status::RedisParseErr, errValueNotInteger};
+  }
+  if (*numkeys <= 0) {
+    return {Status::RedisParseErr, "numkeys should be greater than 0"};
+  }
+
+  size_t direction_index = numkeys_index + 1 + *numkeys;
+  if (direction_index >= args.size()) {
+    return {Status::RedisParseErr, errInvalidSyntax};
+  }
+  keys->assign(args.begin() + static_cast<int64_t>(numkeys_index) + 1,
+               args.begin() + static_cast<int64_t>(direction_index));
+
+  auto direction = Util::ToLower(args[direction_index]);
+  if (direction != first && direction != second) {
+    return {Status::RedisParseErr, errInvalidSyntax};
+  }
+  *is_first = direction == first;
+
+  size_t i = direction_index + 1;
+  if (i == args.size()) return Status::OK();
+  if (Util::ToLower(args[i]) != "count" || i + 2 != args.size()) {
+    return {Status::RedisParseErr, errInvalidSyntax};
+  }
+  auto parse_count = ParseInt<int>(args[i + 1], 10);
+  if (!parse_count) {
+    return {Status::RedisParseErr, errValueNotInteger};
+  }
+  if (*parse_count <= 0) {
+    return {Status::RedisParseErr, "count should be greater than 0"};
+  }
+  *count = *parse_count;
+  return Status::OK();
+}
+
+// Pop the elements from the first non-empty list of the keys, and reply the key with the elements
+static rocksdb::Status PopFromLists(Server *svr, Connection *conn, const std::vector<std::string> &keys, bool left,
+                                    uint32_t count, std::string *reply) {
+  Redis::List list_db(svr->storage_, conn->GetNamespace());
+  std::vector<Slice> key_slices(keys.begin(), keys.end());
+  std::string popped_key;
+  std::vector<std::string> elems;
+  auto s = list_db.MPop(key_slices, left, count, &popped_key, &elems);
+  if (!s.ok()) return s;
+
+  *reply = Redis::MultiLen(2) + Redis::BulkString(popped_key) + Redis::MultiBulkString(elems);
+  return rocksdb::Status::OK();
+}
+
+class CommandLMPop : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    return ParseMPopArgs(args, 1, "left", "right", &keys_, &left_, &count_);
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    auto s = PopFromLists(svr, conn, keys_, left_, count_, output);
+    if (s.IsNotFound()) {
+      *output = Redis::MultiLen(-1);
+      return Status::OK();
+    }
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+    return Status::OK();
+  }
+
+ private:
+  std::vector<std::string> keys_;
+  bool left_ = true;
+  uint32_t count_ = 1;
+};
+
 class CommandBPop : public Commander {
  public:
   explicit CommandBPop(bool left) : left_(left) {}
@@ -1798,16 +2241,8 @@ class CommandBPop : public Commander {
   }
 
   Status Parse(const std::vector<std::string> &args) override {
-    auto parse_result = ParseInt<int>(args[args.size() - 1], 10);
-    if (!parse_result) {
-      return {Status::RedisParseErr, "timeout is not an integer or out of range"};
-    }
-
-    if (*parse_result < 0) {
-      return {Status::RedisParseErr, "timeout should not be negative"};
-    }
-
-    timeout_ = *parse_result;
+    auto s = parseTimeout(args[args.size() - 1]);
+    if (!s.IsOK()) return s;
 
     keys_ = std::vector<std::string>(args.begin() + 1, args.end() - 1);
     return Commander::Parse(args);
@@ -1818,9 +2253,9 @@ class CommandBPop : public Commander {
     conn_ = conn;
 
     auto bev = conn->GetBufferEvent();
-    auto s = TryPopFromList();
+    auto s = TryPopAndReply();
     if (s.ok() || !s.IsNotFound()) {
-      return Status::OK();  // error has already output in TryPopFromList
+      return Status::OK();  // error has already output in TryPopAndReply
     }
 
     if (conn->IsInExec()) {
@@ -1843,25 +2278,11 @@ class CommandBPop : public Commander {
     return {Status::BlockingCmd};
   }
 
-  rocksdb::Status TryPopFromList() {
-    Redis::List list_db(svr_->storage_, conn_->GetNamespace());
-    std::string elem;
-    const std::string *last_key_ptr = nullptr;
-    rocksdb::Status s;
-    for (const auto &key : keys_) {
-      last_key_ptr = &key;
-      s = list_db.Pop(key, left_, &elem);
-      if (s.ok() || !s.IsNotFound()) {
-        break;
-      }
-    }
-
+  rocksdb::Status TryPopAndReply() {
+    std::string reply;
+    auto s = tryPop(&reply);
     if (s.ok()) {
-      if (!last_key_ptr) {
-        conn_->Reply(Redis::MultiBulkString({"", std::move(elem)}));
-      } else {
-        conn_->Reply(Redis::MultiBulkString({*last_key_ptr, std::move(elem)}));
-      }
+      conn_->Reply(reply);
     } else if (!s.IsNotFound()) {
       conn_->Reply(Redis::Error("ERR " + s.ToString()));
       LOG(ERROR) << "Failed to execute redis command: " << conn_->current_cmd_->GetAttributes()->name
@@ -1873,7 +2294,7 @@ class CommandBPop : public Commander {
 
   static void WriteCB(bufferevent *bev, void *ctx) {
     auto self = reinterpret_cast<CommandBPop *>(ctx);
-    auto s = self->TryPopFromList();
+    auto s = self->TryPopAndReply();
     if (s.IsNotFound()) {
       // The connection may be waked up but can't pop from list. For example,
       // connection A is blocking on list and connection B push a new element
@@ -1912,7 +2333,7 @@ class CommandBPop : public Commander {
 
   static void TimerCB(int, int16_t events, void *ctx) {
     auto self = reinterpret_cast<CommandBPop *>(ctx);
-    self->conn_->Reply(Redis::NilString());
+    self->conn_->Reply(self->timeoutReply());
     event_free(self->timer_);
     self->timer_ = nullptr;
     self->unBlockingAll();
@@ -1922,7 +2343,7 @@ class CommandBPop : public Commander {
     bufferevent_enable(bev, EV_READ);
   }
 
- private:
+ protected:
   bool left_ = false;
   int timeout_ = 0;  // seconds
   std::vector<std::string> keys_;
@@ -1930,12 +2351,44 @@ class CommandBPop : public Commander {
   Connection *conn_ = nullptr;
   event *timer_ = nullptr;
 
-  void unBlockingAll() {
+  // Pop from the first non-empty key of the keys and make the reply, or return NotFound if all are empty
+  virtual rocksdb::Status tryPop(std::string *reply) {
+    Redis::List list_db(svr_->storage_, conn_->GetNamespace());
+    std::string elem;
     for (const auto &key : keys_) {
-      svr_->UnBlockingKey(key, conn_);
+      auto s = list_db.Pop(key, left_, &elem);
+      if (s.IsNotFound()) continue;
+      if (!s.ok()) return s;
+
+      *reply = Redis::MultiBulkString({key, std::move(elem)});
+      return rocksdb::Status::OK();
     }
+    return rocksdb::Status::NotFound();
   }
-};
+
+  virtual std::string timeoutReply() const { return Redis::NilString(); }
+
+  Status parseTimeout(const std::string &arg) {
+    auto parse_result = ParseInt<int>(arg, 10);
+    if (!parse_result) {
+      return {Status::RedisParseErr, "timeout is not an integer or out of range"};
+    }
+
+    if (*parse_result < 0) {
+      return {Status::RedisParseErr, "timeout should not be negative"};
+    }
+
+    timeout_ = *parse_result;
+    return Status::OK();
+  }
+
+ private:
+  void unBlockingAll() {
+    for (const auto &key : keys_) {
+      svr_->UnBlockingKey(key, conn_);
+    }
+  }
+};
 
 class CommandBLPop : public CommandBPop {
  public:
@@ -1947,6 +2400,29 @@ class CommandBRPop : public CommandBPop {
   CommandBRPop() : CommandBPop(false) {}
 };
 
+// The blocking multi-key pops are blocked on the keys and woken up like BLPOP
+class CommandBLMPop : public CommandBPop {
+ public:
+  CommandBLMPop() : CommandBPop(true) {}
+
+  Status Parse(const std::vector<std::string> &args) override {
+    auto s = parseTimeout(args[1]);
+    if (!s.IsOK()) return s;
+
+    return ParseMPopArgs(args, 2, "left", "right", &keys_, &left_, &count_);
+  }
+
+ protected:
+  rocksdb::Status tryPop(std::string *reply) override {
+    return PopFromLists(svr_, conn_, keys_, left_, count_, reply);
+  }
+
+  std::string timeoutReply() const override { return Redis::MultiLen(-1); }
+
+ private:
+  uint32_t count_ = 1;
+};
+
 class CommandLRem : public Commander {
  public:
   Status Parse(const std::vector<std::string> &args) override {
@@ -2020,13 +2496,17 @@ class CommandLRange : public Commander {
 
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
     Redis::List list_db(svr->storage_, conn->GetNamespace());
-    std::vector<std::string> elems;
-    auto s = list_db.Range(args_[1], start_, stop_, &elems);
+    ChunkedArrayReply reply(conn, false);
+    auto s = list_db.Range(args_[1], start_, stop_, kReplyChunkSize,
+                           [&reply](uint64_t total, std::vector<std::string> *chunk) {
+                             reply.Begin(total);
+                             for (const auto &elem : *chunk) reply.Add(elem);
+                             reply.EndChunk();
+                           });
     if (!s.ok() && !s.IsNotFound()) {
       return {Status::RedisExecErr, s.ToString()};
     }
-
-    *output = Redis::MultiBulkString(elems, false);
+    reply.Finish();
     return Status::OK();
   }
 
@@ -2248,13 +2728,16 @@ class CommandSMembers : public Commander {
  public:
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
     Redis::Set set_db(svr->storage_, conn->GetNamespace());
-    std::vector<std::string> members;
-    auto s = set_db.Members(args_[1], &members);
+    ChunkedArrayReply reply(conn, false);
+    auto s = set_db.Members(args_[1], kReplyChunkSize, [&reply](uint64_t total, std::vector<std::string> *chunk) {
+      reply.Begin(total);
+      for (const auto &member : *chunk) reply.Add(member);
+      reply.EndChunk();
+    });
     if (!s.ok()) {
       return {Status::RedisExecErr, s.ToString()};
     }
-
-    *output = Redis::MultiBulkString(members, false);
+    reply.Finish();
     return Status::OK();
   }
 };
@@ -2446,6 +2929,60 @@ class CommandSInter : public Commander {
   }
 };
 
+class CommandSInterCard : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    auto parse_numkeys = ParseInt<int>(args[1], 10);
+    if (!parse_numkeys) {
+      return {Status::RedisParseErr, errValueNotInteger};
+    }
+    if (*parse_numkeys <= 0) {
+      return {Status::RedisParseErr, "numkeys should be greater than 0"};
+    }
+    numkeys_ = *parse_numkeys;
+    if (numkeys_ > args.size() - 2) {
+      return {Status::RedisParseErr, "Number of keys can't be greater than number of args"};
+    }
+
+    size_t i = 2 + numkeys_;
+    if (i < args.size()) {
+      if (Util::ToLower(args[i]) != "limit" || i + 2 != args.size()) {
+        return {Status::RedisParseErr, errInvalidSyntax};
+      }
+      auto parse_limit = ParseInt<int64_t>(args[i + 1], 10);
+      if (!parse_limit) {
+        return {Status::RedisParseErr, errValueNotInteger};
+      }
+      if (*parse_limit < 0) {
+        return {Status::RedisParseErr, "LIMIT can't be negative"};
+      }
+      limit_ = *parse_limit;
+    }
+    return Commander::Parse(args);
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    std::vector<Slice> keys;
+    for (size_t i = 2; i < 2 + numkeys_; i++) {
+      keys.emplace_back(args_[i]);
+    }
+
+    uint64_t ret = 0;
+    Redis::Set set_db(svr->storage_, conn->GetNamespace());
+    auto s = set_db.InterCard(keys, limit_, &ret);
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    *output = Redis::Integer(ret);
+    return Status::OK();
+  }
+
+ private:
+  size_t numkeys_ = 0;
+  uint64_t limit_ = 0;
+};
+
 class CommandSDiffStore : public Commander {
  public:
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
@@ -2525,17 +3062,16 @@ class CommandZAdd : public Commander {
       }
     }
 
-    try {
-      for (size_t i = index; i < args.size(); i += 2) {
-        double score = std::stod(args[i]);
-        if (std::isnan(score)) {
-          return {Status::RedisParseErr, errScoreIsNotValidFloat};
-        }
-
-        member_scores_.emplace_back(MemberScore{args[i + 1], score});
+    for (size_t i = index; i < args.size(); i += 2) {
+      auto score = ParseFloat(args[i]);
+      if (!score) {
+        return {Status::RedisParseErr, errValueIsNotFloat};
       }
-    } catch (const std::exception &e) {
-      return {Status::RedisParseErr, errValueIsNotFloat};
+      if (std::isnan(*score)) {
+        return {Status::RedisParseErr, errScoreIsNotValidFloat};
+      }
+
+      member_scores_.emplace_back(MemberScore{args[i + 1], *score});
     }
 
     return Commander::Parse(args);
@@ -2550,6 +3086,8 @@ class CommandZAdd : public Commander {
       return {Status::RedisExecErr, s.ToString()};
     }
 
+    svr->WakeupBlockingConns(args_[1], member_scores_.size());
+
     if (flags_.HasIncr()) {
       auto new_score = member_scores_[0].score;
       if ((flags_.HasNX() || flags_.HasXX() || flags_.HasLT() || flags_.HasGT()) && old_score == new_score &&
@@ -2647,11 +3185,11 @@ class CommandZCard : public Commander {
 class CommandZIncrBy : public Commander {
  public:
   Status Parse(const std::vector<std::string> &args) override {
-    try {
-      incr_ = std::stod(args[2]);
-    } catch (const std::exception &e) {
+    auto incr = ParseFloat(args[2]);
+    if (!incr) {
       return {Status::RedisParseErr, "value is not an double or out of range"};
     }
+    incr_ = *incr;
     return Commander::Parse(args);
   }
 
@@ -2663,6 +3201,8 @@ class CommandZIncrBy : public Commander {
       return {Status::RedisExecErr, s.ToString()};
     }
 
+    svr->WakeupBlockingConns(args_[1], 1);
+
     *output = Redis::BulkString(Util::Float2String(score));
     return Status::OK();
   }
@@ -2746,6 +3286,71 @@ class CommandZPopMax : public CommandZPop {
   CommandZPopMax() : CommandZPop(false) {}
 };
 
+// Pop the members from the first non-empty sorted set of the keys, and reply the key with the members and scores
+static rocksdb::Status PopFromZSets(Server *svr, Connection *conn, const std::vector<std::string> &keys, bool min,
+                                    uint32_t count, std::string *reply) {
+  Redis::ZSet zset_db(svr->storage_, conn->GetNamespace());
+  std::vector<Slice> key_slices(keys.begin(), keys.end());
+  std::string popped_key;
+  std::vector<MemberScore> member_scores;
+  auto s = zset_db.MPop(key_slices, static_cast<int>(count), min, &popped_key, &member_scores);
+  if (!s.ok()) return s;
+
+  *reply = Redis::MultiLen(2) + Redis::BulkString(popped_key) + Redis::MultiLen(member_scores.size());
+  for (const auto &ms : member_scores) {
+    reply->append(Redis::MultiLen(2));
+    reply->append(Redis::BulkString(ms.member));
+    reply->append(Redis::BulkString(Util::Float2String(ms.score)));
+  }
+  return rocksdb::Status::OK();
+}
+
+class CommandZMPop : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    return ParseMPopArgs(args, 1, "min", "max", &keys_, &min_, &count_);
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    auto s = PopFromZSets(svr, conn, keys_, min_, count_, output);
+    if (s.IsNotFound()) {
+      *output = Redis::MultiLen(-1);
+      return Status::OK();
+    }
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+    return Status::OK();
+  }
+
+ private:
+  std::vector<std::string> keys_;
+  bool min_ = true;
+  uint32_t count_ = 1;
+};
+
+// The sorted sets are blocked on and woken up by ZADD and ZINCRBY in the same way as the lists
+class CommandBZMPop : public CommandBPop {
+ public:
+  CommandBZMPop() : CommandBPop(true) {}
+
+  Status Parse(const std::vector<std::string> &args) override {
+    auto s = parseTimeout(args[1]);
+    if (!s.IsOK()) return s;
+
+    return ParseMPopArgs(args, 2, "min", "max", &keys_, &min_, &count_);
+  }
+
+ protected:
+  rocksdb::Status tryPop(std::string *reply) override { return PopFromZSets(svr_, conn_, keys_, min_, count_, reply); }
+
+  std::string timeoutReply() const override { return Redis::MultiLen(-1); }
+
+ private:
+  bool min_ = true;
+  uint32_t count_ = 1;
+};
+
 class CommandZRange : public Commander {
  public:
   explicit CommandZRange(bool reversed = false) : reversed_(reversed) {}
@@ -2776,14 +3381,14 @@ class CommandZRange : public Commander {
     }
 
     if (!with_scores_) {
-      output->append(Redis::MultiLen(member_scores.size()));
+      conn->ReplyMultiLen(static_cast<int64_t>(member_scores.size()));
     } else {
-      output->append(Redis::MultiLen(member_scores.size() * 2));
+      conn->ReplyMultiLen(static_cast<int64_t>(member_scores.size() * 2));
     }
 
     for (const auto &ms : member_scores) {
-      output->append(Redis::BulkString(ms.member));
-      if (with_scores_) output->append(Redis::BulkString(Util::Float2String(ms.score)));
+      conn->ReplyBulkString(ms.member);
+      if (with_scores_) conn->ReplyBulkString(Util::Float2String(ms.score));
     }
 
     return Status::OK();
@@ -2894,14 +3499,14 @@ class CommandZRangeByScore : public Commander {
     }
 
     if (!with_scores_) {
-      output->append(Redis::MultiLen(member_scores.size()));
+      conn->ReplyMultiLen(static_cast<int64_t>(member_scores.size()));
     } else {
-      output->append(Redis::MultiLen(member_scores.size() * 2));
+      conn->ReplyMultiLen(static_cast<int64_t>(member_scores.size() * 2));
     }
 
     for (const auto &ms : member_scores) {
-      output->append(Redis::BulkString(ms.member));
-      if (with_scores_) output->append(Redis::BulkString(Util::Float2String(ms.score)));
+      conn->ReplyBulkString(ms.member);
+      if (with_scores_) conn->ReplyBulkString(Util::Float2String(ms.score));
     }
 
     return Status::OK();
@@ -3105,28 +3710,81 @@ class CommandZMScore : public Commander {
   }
 };
 
+// ZRANDMEMBER key [count [WITHSCORES]]
+class CommandZRandMember : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    if (args.size() > 4) return {Status::RedisParseErr, errInvalidSyntax};
+    if (args.size() >= 3) {
+      auto parse_result = ParseInt<int64_t>(args[2], {-INT32_MAX, INT32_MAX}, 10);
+      if (!parse_result) return {Status::RedisParseErr, errValueNotInteger};
+      count_ = *parse_result;
+      with_count_ = true;
+    }
+    if (args.size() == 4) {
+      if (Util::ToLower(args[3]) != "withscores") return {Status::RedisParseErr, errInvalidSyntax};
+      with_scores_ = true;
+    }
+    return Commander::Parse(args);
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    Redis::ZSet zset_db(svr->storage_, conn->GetNamespace());
+    std::vector<MemberScore> mscores;
+    auto s = zset_db.RandMember(args_[1], count_, &mscores);
+    if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
+
+    if (!with_count_) {
+      *output = mscores.empty() ? Redis::NilString() : Redis::BulkString(mscores.front().member);
+      return Status::OK();
+    }
+    std::vector<std::string> values;
+    for (auto &ms : mscores) {
+      values.emplace_back(std::move(ms.member));
+      if (with_scores_) values.emplace_back(Util::Float2String(ms.score));
+    }
+    *output = Redis::MultiBulkString(values, false);
+    return Status::OK();
+  }
+
+ private:
+  int64_t count_ = 1;
+  bool with_count_ = false;
+  bool with_scores_ = false;
+};
+
 class CommandZUnionStore : public Commander {
  public:
+  // The variants without the destination reply the result, their numkeys is the first argument
+  explicit CommandZUnionStore(bool store = true) : store_(store) {}
+
   Status Parse(const std::vector<std::string> &args) override {
-    auto parse_result = ParseInt<int>(args[2], 10);
+    size_t first_key = store_ ? 3 : 2;
+    auto parse_result = ParseInt<int>(args[first_key - 1], 10);
     if (!parse_result) {
       return {Status::RedisParseErr, errValueNotInteger};
     }
+    if (!store_ && *parse_result <= 0) {
+      return {Status::RedisParseErr, "at least 1 input key is needed"};
+    }
 
     numkeys_ = *parse_result;
-    if (numkeys_ > args.size() - 3) {
+    if (numkeys_ > args.size() - first_key) {
       return {Status::RedisParseErr, errInvalidSyntax};
     }
 
     size_t j = 0;
     while (j < numkeys_) {
-      keys_weights_.emplace_back(KeyWeight{args[j + 3], 1});
+      keys_weights_.emplace_back(KeyWeight{args[j + first_key], 1});
       j++;
     }
 
-    size_t i = 3 + numkeys_;
+    size_t i = first_key + numkeys_;
     while (i < args.size()) {
-      if (Util::ToLower(args[i]) == "aggregate" && i + 1 < args.size()) {
+      if (!store_ && Util::ToLower(args[i]) == "withscores") {
+        with_scores_ = true;
+        i++;
+      } else if (Util::ToLower(args[i]) == "aggregate" && i + 1 < args.size()) {
         if (Util::ToLower(args[i + 1]) == "sum") {
           aggregate_method_ = kAggregateSum;
         } else if (Util::ToLower(args[i + 1]) == "min") {
@@ -3140,14 +3798,11 @@ class CommandZUnionStore : public Commander {
       } else if (Util::ToLower(args[i]) == "weights" && i + numkeys_ < args.size()) {
         size_t k = 0;
         while (k < numkeys_) {
-          try {
-            keys_weights_[k].weight = std::stod(args[i + k + 1]);
-          } catch (const std::exception &e) {
-            return {Status::RedisParseErr, "weight is not an double or out of range"};
-          }
-          if (std::isnan(keys_weights_[k].weight)) {
+          auto weight = ParseFloat(args[i + k + 1]);
+          if (!weight || std::isnan(*weight)) {
             return {Status::RedisParseErr, "weight is not an double or out of range"};
           }
+          keys_weights_[k].weight = *weight;
           k++;
         }
         i += numkeys_ + 1;
@@ -3171,6 +3826,16 @@ class CommandZUnionStore : public Commander {
   }
 
  protected:
+  void replyMembers(Connection *conn, const std::vector<MemberScore> &mscores) const {
+    conn->ReplyMultiLen(static_cast<int64_t>(with_scores_ ? mscores.size() * 2 : mscores.size()));
+    for (const auto &ms : mscores) {
+      conn->ReplyBulkString(ms.member);
+      if (with_scores_) conn->ReplyBulkString(Util::Float2String(ms.score));
+    }
+  }
+
+  bool store_;
+  bool with_scores_ = false;
   size_t numkeys_ = 0;
   std::vector<KeyWeight> keys_weights_;
   AggregateMethod aggregate_method_ = kAggregateSum;
@@ -3193,6 +3858,90 @@ class CommandZInterStore : public CommandZUnionStore {
   }
 };
 
+class CommandZUnion : public CommandZUnionStore {
+ public:
+  CommandZUnion() : CommandZUnionStore(false) {}
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    std::vector<MemberScore> mscores;
+    Redis::ZSet zset_db(svr->storage_, conn->GetNamespace());
+    auto s = zset_db.Union(keys_weights_, aggregate_method_, &mscores);
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    replyMembers(conn, mscores);
+    return Status::OK();
+  }
+};
+
+class CommandZInter : public CommandZUnionStore {
+ public:
+  CommandZInter() : CommandZUnionStore(false) {}
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    std::vector<MemberScore> mscores;
+    Redis::ZSet zset_db(svr->storage_, conn->GetNamespace());
+    auto s = zset_db.Inter(keys_weights_, aggregate_method_, &mscores);
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    replyMembers(conn, mscores);
+    return Status::OK();
+  }
+};
+
+class CommandZInterCard : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    auto parse_numkeys = ParseInt<int>(args[1], 10);
+    if (!parse_numkeys) {
+      return {Status::RedisParseErr, errValueNotInteger};
+    }
+    if (*parse_numkeys <= 0) {
+      return {Status::RedisParseErr, "numkeys should be greater than 0"};
+    }
+    numkeys_ = *parse_numkeys;
+    if (numkeys_ > args.size() - 2) {
+      return {Status::RedisParseErr, "Number of keys can't be greater than number of args"};
+    }
+
+    size_t i = 2 + numkeys_;
+    if (i < args.size()) {
+      if (Util::ToLower(args[i]) != "limit" || i + 2 != args.size()) {
+        return {Status::RedisParseErr, errInvalidSyntax};
+      }
+      auto parse_limit = ParseInt<int64_t>(args[i + 1], 10);
+      if (!parse_limit) {
+        return {Status::RedisParseErr, errValueNotInteger};
+      }
+      if (*parse_limit < 0) {
+        return {Status::RedisParseErr, "LIMIT can't be negative"};
+      }
+      limit_ = *parse_limit;
+    }
+    return Commander::Parse(args);
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    std::vector<std::string> keys(args_.begin() + 2, args_.begin() + 2 + static_cast<int64_t>(numkeys_));
+    uint64_t ret = 0;
+    Redis::ZSet zset_db(svr->storage_, conn->GetNamespace());
+    auto s = zset_db.InterCard(keys, limit_, &ret);
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    *output = Redis::Integer(ret);
+    return Status::OK();
+  }
+
+ private:
+  size_t numkeys_ = 0;
+  uint64_t limit_ = 0;
+};
+
 class CommandGeoBase : public Commander {
  public:
   Status ParseDistanceUnit(const std::string &param) {
@@ -3212,12 +3961,13 @@ class CommandGeoBase : public Commander {
 
   Status ParseLongLat(const std::string &longitude_para, const std::string &latitude_para, double *longitude,
                       double *latitude) {
-    try {
-      *longitude = std::stod(longitude_para);
-      *latitude = std::stod(latitude_para);
-    } catch (const std::exception &e) {
+    auto longitude_res = ParseFloat(longitude_para);
+    auto latitude_res = ParseFloat(latitude_para);
+    if (!longitude_res || !latitude_res) {
       return {Status::RedisParseErr, errValueIsNotFloat};
     }
+    *longitude = *longitude_res;
+    *latitude = *latitude_res;
 
     if (*longitude < GEO_LONG_MIN || *longitude > GEO_LONG_MAX || *latitude < GEO_LAT_MIN || *latitude > GEO_LAT_MAX) {
       return {Status::RedisParseErr, "invalid longitude,latitude pair " + longitude_para + "," + latitude_para};
@@ -3385,11 +4135,11 @@ class CommandGeoRadius : public CommandGeoBase {
     auto s = ParseLongLat(args[2], args[3], &longitude_, &latitude_);
     if (!s.IsOK()) return s;
 
-    try {
-      radius_ = std::stod(args[4]);
-    } catch (const std::exception &e) {
+    auto radius = ParseFloat(args[4]);
+    if (!radius) {
       return {Status::RedisParseErr, errValueIsNotFloat};
     }
+    radius_ = *radius;
 
     s = ParseDistanceUnit(args[5]);
     if (!s.IsOK()) return s;
@@ -3516,11 +4266,11 @@ class CommandGeoRadiusByMember : public CommandGeoRadius {
   CommandGeoRadiusByMember() : CommandGeoRadius() {}
 
   Status Parse(const std::vector<std::string> &args) override {
-    try {
-      radius_ = std::stod(args[3]);
-    } catch (const std::exception &e) {
+    auto radius = ParseFloat(args[3]);
+    if (!radius) {
       return {Status::RedisParseErr, errValueIsNotFloat};
     }
+    radius_ = *radius;
 
     auto s = ParseDistanceUnit(args[4]);
     if (!s.IsOK()) return s;
@@ -3545,48 +4295,358 @@ class CommandGeoRadiusByMember : public CommandGeoRadius {
   }
 };
 
-class CommandGeoRadiusReadonly : public CommandGeoRadius {
- public:
-  CommandGeoRadiusReadonly() : CommandGeoRadius() {}
-};
-
-class CommandGeoRadiusByMemberReadonly : public CommandGeoRadiusByMember {
+class CommandGeoSearch : public CommandGeoRadius {
  public:
-  CommandGeoRadiusByMemberReadonly() : CommandGeoRadiusByMember() {}
-};
+  CommandGeoSearch() : CommandGeoRadius() {}
 
-class CommandSortedintAdd : public Commander {
- public:
   Status Parse(const std::vector<std::string> &args) override {
-    for (size_t i = 2; i < args.size(); i++) {
-      auto parse_result = ParseInt<uint64_t>(args[i], 10);
-      if (!parse_result) {
-        return {Status::RedisParseErr, errValueNotInteger};
-      }
-
-      ids_.emplace_back(*parse_result);
-    }
-    return Commander::Parse(args);
-  }
-
-  Status Execute(Server *svr, Connection *conn, std::string *output) override {
-    Redis::Sortedint sortedint_db(svr->storage_, conn->GetNamespace());
-    int ret = 0;
-    auto s = sortedint_db.Add(args_[1], ids_, &ret);
-    if (!s.ok()) {
-      return {Status::RedisExecErr, s.ToString()};
-    }
-
-    *output = Redis::Integer(ret);
-    return Status::OK();
-  }
-
- private:
-  std::vector<uint64_t> ids_;
-};
-
-class CommandSortedintRem : public Commander {
- public:
+    bool from_member = false, from_lonlat = false, by_radius = false, by_box = false, any = false;
+    for (size_t i = 2; i < args.size();) {
+      auto option = Util::ToLower(args[i]);
+      if (option == "frommember" && i + 1 < args.size()) {
+        member_ = args[i + 1];
+        from_member = true;
+        i += 2;
+      } else if (option == "fromlonlat" && i + 2 < args.size()) {
+        auto s = ParseLongLat(args[i + 1], args[i + 2], &shape_.xy[0], &shape_.xy[1]);
+        if (!s.IsOK()) return s;
+        from_lonlat = true;
+        i += 3;
+      } else if (option == "byradius" && i + 2 < args.size()) {
+        auto radius = ParseFloat(args[i + 1]);
+        if (!radius) {
+          return {Status::RedisParseErr, errValueIsNotFloat};
+        }
+        radius_ = *radius;
+        auto s = ParseDistanceUnit(args[i + 2]);
+        if (!s.IsOK()) return s;
+        shape_.type = kGeoShapeCircle;
+        shape_.radius = GetRadiusMeters(radius_);
+        by_radius = true;
+        i += 3;
+      } else if (option == "bybox" && i + 3 < args.size()) {
+        auto width = ParseFloat(args[i + 1]);
+        auto height = ParseFloat(args[i + 2]);
+        if (!width || !height) {
+          return {Status::RedisParseErr, errValueIsNotFloat};
+        }
+        auto s = ParseDistanceUnit(args[i + 3]);
+        if (!s.IsOK()) return s;
+        shape_.type = kGeoShapeRectangle;
+        shape_.width = GetRadiusMeters(*width);
+        shape_.height = GetRadiusMeters(*height);
+        by_box = true;
+        i += 4;
+      } else if (option == "withcoord") {
+        with_coord_ = true;
+        i++;
+      } else if (option == "withdist") {
+        with_dist_ = true;
+        i++;
+      } else if (option == "withhash") {
+        with_hash_ = true;
+        i++;
+      } else if (option == "asc") {
+        sort_ = kSortASC;
+        i++;
+      } else if (option == "desc") {
+        sort_ = kSortDESC;
+        i++;
+      } else if (option == "count" && i + 1 < args.size()) {
+        auto parse_result = ParseInt<int>(args[i + 1], 10);
+        if (!parse_result) {
+          return {Status::RedisParseErr, errValueNotInteger};
+        }
+        if (*parse_result <= 0) {
+          return {Status::RedisParseErr, "COUNT must be > 0"};
+        }
+        count_ = *parse_result;
+        i += 2;
+        if (i < args.size() && Util::ToLower(args[i]) == "any") {
+          any = true;
+          i++;
+        }
+      } else {
+        return {Status::RedisParseErr, errInvalidSyntax};
+      }
+    }
+
+    if (from_member == from_lonlat) {
+      return {Status::RedisParseErr, "exactly one of FROMMEMBER or FROMLONLAT can be specified for GEOSEARCH"};
+    }
+    if (by_radius == by_box) {
+      return {Status::RedisParseErr, "exactly one of BYRADIUS and BYBOX can be specified for GEOSEARCH"};
+    }
+    any_ = any;
+    from_member_ = from_member;
+    /* COUNT without ordering does not make much sense, force ASC
+     * ordering if COUNT was specified but no sorting was requested,
+     * unless any points are acceptable. */
+    if (count_ != 0 && sort_ == kSortNone && !any_) {
+      sort_ = kSortASC;
+    }
+    return Commander::Parse(args);
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    std::vector<GeoPoint> geo_points;
+    Redis::Geo geo_db(svr->storage_, conn->GetNamespace());
+    auto s = from_member_ ? geo_db.SearchByMember(args_[1], member_, shape_, sort_, count_, any_, &geo_points)
+                          : geo_db.Search(args_[1], shape_, sort_, count_, any_, &geo_points);
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    *output = GenerateOutput(geo_points);
+    return Status::OK();
+  }
+
+ private:
+  GeoShape shape_;
+  std::string member_;
+  bool from_member_ = false;
+  bool any_ = false;
+};
+
+class CommandGeoRadiusReadonly : public CommandGeoRadius {
+ public:
+  CommandGeoRadiusReadonly() : CommandGeoRadius() {}
+};
+
+class CommandGeoRadiusByMemberReadonly : public CommandGeoRadiusByMember {
+ public:
+  CommandGeoRadiusByMemberReadonly() : CommandGeoRadiusByMember() {}
+};
+
+class CommandPFAdd : public Commander {
+ public:
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    std::vector<Slice> elements;
+    for (size_t i = 2; i < args_.size(); i++) {
+      elements.emplace_back(args_[i]);
+    }
+
+    int ret = 0;
+    Redis::HyperLogLog hll_db(svr->storage_, conn->GetNamespace());
+    auto s = hll_db.Add(args_[1], elements, &ret);
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    *output = Redis::Integer(ret);
+    return Status::OK();
+  }
+};
+
+class CommandPFCount : public Commander {
+ public:
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    std::vector<Slice> keys;
+    for (size_t i = 1; i < args_.size(); i++) {
+      keys.emplace_back(args_[i]);
+    }
+
+    uint64_t card = 0;
+    Redis::HyperLogLog hll_db(svr->storage_, conn->GetNamespace());
+    // The slave can't write the cached cardinality, it would diverge from the master
+    auto s = hll_db.Count(keys, !svr->IsSlave(), &card);
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    *output = Redis::Integer(card);
+    return Status::OK();
+  }
+};
+
+class CommandPFMerge : public Commander {
+ public:
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    std::vector<Slice> source_keys;
+    for (size_t i = 2; i < args_.size(); i++) {
+      source_keys.emplace_back(args_[i]);
+    }
+
+    Redis::HyperLogLog hll_db(svr->storage_, conn->GetNamespace());
+    auto s = hll_db.Merge(args_[1], source_keys);
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    *output = Redis::SimpleString("OK");
+    return Status::OK();
+  }
+};
+
+class CommandBFReserve : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    auto error_rate = ParseFloat(args[2]);
+    if (!error_rate) {
+      return {Status::RedisParseErr, errValueIsNotFloat};
+    }
+    error_rate_ = *error_rate;
+    if (error_rate_ <= 0 || error_rate_ >= 1) {
+      return {Status::RedisParseErr, "error rate should be between 0 and 1"};
+    }
+    auto parse_result = ParseInt<uint64_t>(args[3], NumericRange<uint64_t>{1, kBloomFilterMaxCapacity}, 10);
+    if (!parse_result) {
+      return {Status::RedisParseErr, "capacity should be a positive integer up to " +
+                                         std::to_string(kBloomFilterMaxCapacity)};
+    }
+    capacity_ = *parse_result;
+    // The filter never scales, so NONSCALING is accepted for the compatibility
+    if (args.size() > 5 || (args.size() == 5 && Util::ToLower(args[4]) != "nonscaling")) {
+      return {Status::RedisParseErr, errInvalidSyntax};
+    }
+    return Commander::Parse(args);
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    Redis::BloomFilter bloom_db(svr->storage_, conn->GetNamespace());
+    auto s = bloom_db.Reserve(args_[1], error_rate_, capacity_);
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    *output = Redis::SimpleString("OK");
+    return Status::OK();
+  }
+
+ private:
+  double error_rate_ = 0;
+  uint64_t capacity_ = 0;
+};
+
+class CommandBFAdd : public Commander {
+ public:
+  explicit CommandBFAdd(bool multi = false) : multi_(multi) {}
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    std::vector<Slice> items;
+    for (size_t i = 2; i < args_.size(); i++) {
+      items.emplace_back(args_[i]);
+    }
+
+    std::vector<int> rets;
+    Redis::BloomFilter bloom_db(svr->storage_, conn->GetNamespace());
+    auto s = bloom_db.MAdd(args_[1], items, &rets);
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    if (!multi_) {
+      *output = rets[0] < 0 ? Redis::Error(errBloomFilterFull) : Redis::Integer(rets[0]);
+      return Status::OK();
+    }
+    *output = Redis::MultiLen(rets.size());
+    for (const auto ret : rets) {
+      *output += ret < 0 ? Redis::Error(errBloomFilterFull) : Redis::Integer(ret);
+    }
+    return Status::OK();
+  }
+
+ private:
+  bool multi_;
+};
+
+class CommandBFMAdd : public CommandBFAdd {
+ public:
+  CommandBFMAdd() : CommandBFAdd(true) {}
+};
+
+class CommandBFExists : public Commander {
+ public:
+  explicit CommandBFExists(bool multi = false) : multi_(multi) {}
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    std::vector<Slice> items;
+    for (size_t i = 2; i < args_.size(); i++) {
+      items.emplace_back(args_[i]);
+    }
+
+    std::vector<int> rets;
+    Redis::BloomFilter bloom_db(svr->storage_, conn->GetNamespace());
+    auto s = bloom_db.MExists(args_[1], items, &rets);
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    if (!multi_) {
+      *output = Redis::Integer(rets[0]);
+      return Status::OK();
+    }
+    *output = Redis::MultiLen(rets.size());
+    for (const auto ret : rets) {
+      *output += Redis::Integer(ret);
+    }
+    return Status::OK();
+  }
+
+ private:
+  bool multi_;
+};
+
+class CommandBFMExists : public CommandBFExists {
+ public:
+  CommandBFMExists() : CommandBFExists(true) {}
+};
+
+class CommandBFInfo : public Commander {
+ public:
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    BloomFilterMetadata metadata(false);
+    Redis::BloomFilter bloom_db(svr->storage_, conn->GetNamespace());
+    auto s = bloom_db.Info(args_[1], &metadata);
+    if (s.IsNotFound()) {
+      return {Status::RedisExecErr, "not found"};
+    }
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    *output = Redis::MultiLen(10);
+    *output += Redis::SimpleString("Capacity") + Redis::Integer(static_cast<int64_t>(metadata.capacity));
+    *output += Redis::SimpleString("Size") + Redis::Integer(static_cast<int64_t>(metadata.bits / 8));
+    *output += Redis::SimpleString("Number of filters") + Redis::Integer(1);
+    *output += Redis::SimpleString("Number of items inserted") + Redis::Integer(metadata.size);
+    *output += Redis::SimpleString("Expansion rate") + Redis::NilString();
+    return Status::OK();
+  }
+};
+
+class CommandSortedintAdd : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    for (size_t i = 2; i < args.size(); i++) {
+      auto parse_result = ParseInt<uint64_t>(args[i], 10);
+      if (!parse_result) {
+        return {Status::RedisParseErr, errValueNotInteger};
+      }
+
+      ids_.emplace_back(*parse_result);
+    }
+    return Commander::Parse(args);
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    Redis::Sortedint sortedint_db(svr->storage_, conn->GetNamespace());
+    int ret = 0;
+    auto s = sortedint_db.Add(args_[1], ids_, &ret);
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    *output = Redis::Integer(ret);
+    return Status::OK();
+  }
+
+ private:
+  std::vector<uint64_t> ids_;
+};
+
+class CommandSortedintRem : public Commander {
+ public:
   Status Parse(const std::vector<std::string> &args) override {
     for (size_t i = 2; i < args.size(); i++) {
       auto parse_result = ParseInt<uint64_t>(args[i], 10);
@@ -3848,6 +4908,7 @@ class CommandDiscard : public Commander {
     }
 
     conn->ResetMultiExec();
+    svr->ResetWatchedKeys(conn);
     *output = Redis::SimpleString("OK");
 
     return Status::OK();
@@ -3862,18 +4923,79 @@ class CommandExec : public Commander {
       return Status::OK();
     }
 
+    auto reset_watch = MakeScopeExit([svr, conn] { svr->ResetWatchedKeys(conn); });
     if (conn->IsMultiError()) {
       conn->ResetMultiExec();
       *output = Redis::Error("EXECABORT Transaction discarded");
       return Status::OK();
     }
 
+    // The transaction runs under the locks of the keys of the queued commands if possible,
+    // otherwise it has acquired the exclusivity, see Connection::ExecuteCommands. The writes
+    // of the commands are buffered and applied at once in the former case.
+    std::vector<std::string> lock_keys;
+    std::unique_ptr<ReentrantMultiLockGuard> key_guard;
+    bool in_txn = false;
+    if (conn->GetMultiExecKeys(&lock_keys)) {
+      key_guard = std::make_unique<ReentrantMultiLockGuard>(svr->storage_->GetLockManager(), lock_keys);
+      in_txn = svr->storage_->BeginTxn();
+    }
+    // The watching connections are marked before the writes, so the mark is checked under the locks
+    if (conn->IsWatchedKeysModified()) {
+      conn->ResetMultiExec();
+      *output = Redis::MultiLen(-1);
+      return Status::OK();
+    }
+
+    size_t output_len = evbuffer_get_length(conn->Output());
     // Reply multi length first
     conn->Reply(Redis::MultiLen(conn->GetMultiExecCommands()->size()));
     // Execute multi-exec commands
     conn->SetInExec();
     conn->ExecuteCommands(conn->GetMultiExecCommands());
     conn->ResetMultiExec();
+    if (in_txn) {
+      auto s = svr->storage_->CommitTxn();
+      if (!s.ok()) {
+        // None of the writes was applied, so the replies of the commands must not be sent,
+        // they're held in the output buffer until the commit, see Connection::FlushReply
+        evbuffer_drain(conn->Output(), evbuffer_get_length(conn->Output()) - output_len);
+        *output = Redis::Error("EXECABORT Transaction discarded: " + s.ToString());
+      }
+    }
+    return Status::OK();
+  }
+};
+
+class CommandWatch : public Commander {
+ public:
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    if (conn->IsFlagEnabled(Connection::kMultiExec)) {
+      *output = Redis::Error("ERR WATCH inside MULTI is not allowed");
+      return Status::OK();
+    }
+
+    // No need to watch the keys if the transaction would be aborted anyway
+    if (!conn->IsWatchedKeysModified()) {
+      std::vector<std::string> ns_keys;
+      ns_keys.reserve(args_.size() - 1);
+      for (size_t i = 1; i < args_.size(); i++) {
+        std::string ns_key;
+        ComposeNamespaceKey(conn->GetNamespace(), args_[i], &ns_key, svr->storage_->IsSlotIdEncoded());
+        ns_keys.emplace_back(std::move(ns_key));
+      }
+      svr->WatchKeys(conn, ns_keys);
+    }
+    *output = Redis::SimpleString("OK");
+    return Status::OK();
+  }
+};
+
+class CommandUnwatch : public Commander {
+ public:
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    svr->ResetWatchedKeys(conn);
+    *output = Redis::SimpleString("OK");
     return Status::OK();
   }
 };
@@ -3943,14 +5065,57 @@ class CommandFlushBackup : public Commander {
   }
 };
 
-class CommandDBSize : public Commander {
+// BULKLOAD INGEST <dir> [MOVE] ingests the SST files in the directory of the server, e.g. those
+// built by kvrocks-bulkload offline, and replies the number of the ingested files. The files are
+// moved into the DB rather than copied if MOVE is given.
+class CommandBulkLoad : public Commander {
  public:
-  Status Execute(Server *svr, Connection *conn, std::string *output) override {
-    std::string ns = conn->GetNamespace();
-    if (args_.size() == 1) {
-      KeyNumStats stats;
-      svr->GetLastestKeyNumStats(ns, &stats);
-      *output = Redis::Integer(stats.n_key);
+  Status Parse(const std::vector<std::string> &args) override {
+    if (Util::ToLower(args[1]) != "ingest") {
+      return {Status::RedisParseErr, "BULKLOAD subcommand only supports INGEST"};
+    }
+    dir_ = args[2];
+    if (args.size() == 4 && Util::ToLower(args[3]) == "move") {
+      move_files_ = true;
+    } else if (args.size() > 3) {
+      return {Status::RedisParseErr, errInvalidSyntax};
+    }
+    return Commander::Parse(args);
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    if (!conn->IsAdmin()) {
+      *output = Redis::Error(errAdministorPermissionRequired);
+      return Status::OK();
+    }
+
+    uint64_t num_files = 0;
+    auto s = svr->storage_->IngestSSTFiles(dir_, move_files_, &num_files);
+    if (!s.IsOK()) return {Status::RedisExecErr, s.Msg()};
+
+    *output = Redis::Integer(num_files);
+    LOG(INFO) << "Bulk loaded " << num_files << " SST files in " << dir_;
+    return Status::OK();
+  }
+
+ private:
+  std::string dir_;
+  bool move_files_ = false;
+};
+
+class CommandDBSize : public Commander {
+ public:
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    std::string ns = conn->GetNamespace();
+    if (args_.size() == 1) {
+      auto key_counter = svr->storage_->GetKeyCounter();
+      if (svr->GetConfig()->key_count_tracking && key_counter->Ready()) {
+        *output = Redis::Integer(key_counter->GetKeys(ns));
+        return Status::OK();
+      }
+      KeyNumStats stats;
+      svr->GetLastestKeyNumStats(ns, &stats);
+      *output = Redis::Integer(stats.n_key);
     } else if (args_.size() == 2 && args_[1] == "scan") {
       Status s = svr->AsyncScanDBSize(ns);
       if (s.IsOK()) {
@@ -3985,6 +5150,27 @@ class CommandPublish : public Commander {
   }
 };
 
+class CommandSPublish : public Commander {
+ public:
+  // The shard channel is hashed to the slot like a key, so the message is only delivered on the
+  // nodes of the shard which serves the slot, and replicated to the replicas of this shard
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    // The message is dropped by the replicas which aren't connected like Redis, so it isn't
+    // written into the WAL if there isn't any replica
+    if (!svr->IsSlave() && svr->HasSlaves()) {
+      Redis::PubSub pubsub_db(svr->storage_);
+      auto s = pubsub_db.PublishShard(args_[1], args_[2]);
+      if (!s.ok()) {
+        return {Status::RedisExecErr, s.ToString()};
+      }
+    }
+
+    int receivers = svr->PublishShardMessage(args_[1], args_[2]);
+    *output = Redis::Integer(receivers);
+    return Status::OK();
+  }
+};
+
 void SubscribeCommandReply(std::string *output, const std::string &name, const std::string &sub_name, int num) {
   output->append(Redis::MultiLen(3));
   output->append(Redis::BulkString(name));
@@ -4050,6 +5236,34 @@ class CommandPUnSubscribe : public Commander {
   }
 };
 
+class CommandSSubscribe : public Commander {
+ public:
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    for (size_t i = 1; i < args_.size(); i++) {
+      conn->SSubscribeChannel(args_[i]);
+      SubscribeCommandReply(output, "ssubscribe", args_[i], conn->SSubscriptionsCount());
+    }
+    return Status::OK();
+  }
+};
+
+class CommandSUnSubscribe : public Commander {
+ public:
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    if (args_.size() == 1) {
+      conn->SUnSubscribeAll([output](const std::string &sub_name, int num) {
+        SubscribeCommandReply(output, "sunsubscribe", sub_name, num);
+      });
+    } else {
+      for (size_t i = 1; i < args_.size(); i++) {
+        conn->SUnSubscribeChannel(args_[i]);
+        SubscribeCommandReply(output, "sunsubscribe", args_[i], conn->SSubscriptionsCount());
+      }
+    }
+    return Status::OK();
+  }
+};
+
 class CommandPubSub : public Commander {
  public:
   Status Parse(const std::vector<std::string> &args) override {
@@ -4058,14 +5272,14 @@ class CommandPubSub : public Commander {
       return Status::OK();
     }
 
-    if ((subcommand_ == "numsub") && args.size() >= 2) {
+    if ((subcommand_ == "numsub" || subcommand_ == "shardnumsub") && args.size() >= 2) {
       if (args.size() > 2) {
         channels_ = std::vector<std::string>(args.begin() + 2, args.end());
       }
       return Status::OK();
     }
 
-    if ((subcommand_ == "channels") && args.size() <= 3) {
+    if ((subcommand_ == "channels" || subcommand_ == "shardchannels") && args.size() <= 3) {
       if (args.size() == 3) {
         pattern_ = args[2];
       }
@@ -4081,9 +5295,9 @@ class CommandPubSub : public Commander {
       return Status::OK();
     }
 
-    if (subcommand_ == "numsub") {
+    if (subcommand_ == "numsub" || subcommand_ == "shardnumsub") {
       std::vector<ChannelSubscribeNum> channel_subscribe_nums;
-      srv->ListChannelSubscribeNum(channels_, &channel_subscribe_nums);
+      srv->ListChannelSubscribeNum(channels_, &channel_subscribe_nums, subcommand_ == "shardnumsub");
 
       output->append(Redis::MultiLen(channel_subscribe_nums.size() * 2));
       for (const auto &chan_subscribe_num : channel_subscribe_nums) {
@@ -4094,9 +5308,9 @@ class CommandPubSub : public Commander {
       return Status::OK();
     }
 
-    if (subcommand_ == "channels") {
+    if (subcommand_ == "channels" || subcommand_ == "shardchannels") {
       std::vector<std::string> channels;
-      srv->GetChannelsByPattern(pattern_, &channels);
+      srv->GetChannelsByPattern(pattern_, &channels, subcommand_ == "shardchannels");
       *output = Redis::MultiBulkString(channels);
       return Status::OK();
     }
@@ -4115,7 +5329,14 @@ class CommandSlaveOf : public Commander {
   Status Parse(const std::vector<std::string> &args) override {
     host_ = args[1];
     const auto &port = args[2];
+    // SLAVEOF host port FROM-BACKUP dir bootstraps the replica from the local backup before PSYNC
+    if (args.size() == 5 && Util::ToLower(args[3]) == "from-backup") {
+      backup_dir_ = args[4];
+    } else if (args.size() != 3) {
+      return {Status::RedisParseErr, errInvalidSyntax};
+    }
     if (Util::ToLower(host_) == "no" && Util::ToLower(port) == "one") {
+      if (!backup_dir_.empty()) return {Status::RedisParseErr, errInvalidSyntax};
       host_.clear();
       return Status::OK();
     }
@@ -4143,6 +5364,10 @@ class CommandSlaveOf : public Commander {
       return Status::OK();
     }
 
+    if (!backup_dir_.empty() && !rocksdb::Env::Default()->FileExists(backup_dir_).ok()) {
+      return {Status::RedisExecErr, "the backup dir doesn't exist"};
+    }
+
     Status s;
     if (host_.empty()) {
       s = svr->RemoveMaster();
@@ -4155,11 +5380,11 @@ class CommandSlaveOf : public Commander {
         }
       }
     } else {
-      s = svr->AddMaster(host_, port_, false);
+      s = svr->AddMaster(host_, port_, false, backup_dir_);
       if (s.IsOK()) {
         *output = Redis::SimpleString("OK");
         LOG(WARNING) << "SLAVE OF " << host_ << ":" << port_ << " enabled (user request from '" << conn->GetAddr()
-                     << "')";
+                     << "')" << (backup_dir_.empty() ? "" : ", bootstrapped from the backup " + backup_dir_);
         if (svr->GetConfig()->cluster_enabled) {
           svr->slot_migrate_->SetMigrateStopFlag(true);
           LOG(INFO) << "Change server role to slave, stop migration task";
@@ -4175,6 +5400,7 @@ class CommandSlaveOf : public Commander {
  private:
   std::string host_;
   uint32_t port_ = 0;
+  std::string backup_dir_;
 };
 
 class CommandStats : public Commander {
@@ -4186,6 +5412,34 @@ class CommandStats : public Commander {
   }
 };
 
+// Return OK if the seq is in the range of the current WAL
+static Status checkWALBoundary(Engine::Storage *storage, rocksdb::SequenceNumber seq) {
+  if (seq == storage->LatestSeq() + 1) {
+    return Status::OK();
+  }
+
+  // Upper bound
+  if (seq > storage->LatestSeq() + 1) {
+    return {Status::NotOK};
+  }
+
+  // Lower bound
+  std::unique_ptr<rocksdb::TransactionLogIterator> iter;
+  auto s = storage->GetWALIter(seq, &iter);
+  if (s.IsOK() && iter->Valid()) {
+    auto batch = iter->GetBatch();
+    if (seq != batch.sequence) {
+      if (seq > batch.sequence) {
+        LOG(ERROR) << "checkWALBoundary with sequence: " << seq
+                   << ", but GetWALIter return older sequence: " << batch.sequence;
+      }
+      return {Status::NotOK};
+    }
+    return Status::OK();
+  }
+  return {Status::NotOK};
+}
+
 class CommandPSync : public Commander {
  public:
   Status Parse(const std::vector<std::string> &args) override {
@@ -4234,6 +5488,12 @@ class CommandPSync : public Commander {
       }
     }
 
+    // The bulk loaded data or the changed column families aren't in the WAL
+    if (!need_full_sync && next_repl_seq <= svr->storage_->GetResyncSeq()) {
+      *output = "the data was changed outside the WAL after the sequence, please use fullsync";
+      need_full_sync = true;
+    }
+
     // Check Log sequence
     if (!need_full_sync && !checkWALBoundary(svr->storage_, next_repl_seq).IsOK()) {
       *output = "sequence out of range, please use fullsync";
@@ -4268,33 +5528,91 @@ class CommandPSync : public Commander {
   rocksdb::SequenceNumber next_repl_seq = 0;
   bool new_psync = false;
   std::string replica_replid;
+};
 
-  // Return OK if the seq is in the range of the current WAL
-  Status checkWALBoundary(Engine::Storage *storage, rocksdb::SequenceNumber seq) {
-    if (seq == storage->LatestSeq() + 1) {
-      return Status::OK();
+class CommandCDC : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    if (Util::ToLower(args[1]) != "subscribe") {
+      return {Status::RedisParseErr, "CDC subcommand must be SUBSCRIBE"};
     }
 
-    // Upper bound
-    if (seq > storage->LatestSeq() + 1) {
-      return {Status::NotOK};
+    for (size_t i = 2; i < args.size(); i++) {
+      auto option = Util::ToLower(args[i]);
+      if (option == "from" && i + 1 < args.size()) {
+        auto parse_result = ParseInt<uint64_t>(args[++i], 10);
+        if (!parse_result) {
+          return {Status::RedisParseErr, "value is not an unsigned long long or out of range"};
+        }
+        from_seq_ = *parse_result;
+      } else if (option == "ns" && i + 1 < args.size()) {
+        options_.ns = args[++i];
+      } else if (option == "types" && i + 1 < args.size()) {
+        // The types are followed by the next option or the end
+        while (i + 1 < args.size() && !isOption(args[i + 1])) {
+          auto iter = std::find(RedisTypeNames.begin(), RedisTypeNames.end(), Util::ToLower(args[++i]));
+          if (iter == RedisTypeNames.end() || iter == RedisTypeNames.begin()) {
+            return {Status::RedisParseErr, "unknown type: " + args[i]};
+          }
+          options_.types.emplace(static_cast<RedisType>(iter - RedisTypeNames.begin()));
+        }
+        if (options_.types.empty()) return {Status::RedisParseErr, errInvalidSyntax};
+      } else if (option == "format" && i + 1 < args.size()) {
+        auto format = Util::ToLower(args[++i]);
+        if (format == "resp") {
+          options_.format = CDCFormat::kRESP;
+        } else if (format == "binary") {
+          options_.format = CDCFormat::kBinary;
+        } else {
+          return {Status::RedisParseErr, "FORMAT must be RESP or BINARY"};
+        }
+      } else {
+        return {Status::RedisParseErr, errInvalidSyntax};
+      }
     }
+    return Commander::Parse(args);
+  }
 
-    // Lower bound
-    std::unique_ptr<rocksdb::TransactionLogIterator> iter;
-    auto s = storage->GetWALIter(seq, &iter);
-    if (s.IsOK() && iter->Valid()) {
-      auto batch = iter->GetBatch();
-      if (seq != batch.sequence) {
-        if (seq > batch.sequence) {
-          LOG(ERROR) << "checkWALBoundary with sequence: " << seq
-                     << ", but GetWALIter return older sequence: " << batch.sequence;
-        }
-        return {Status::NotOK};
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    // The namespace users only subscribe the changes of their own namespace
+    if (!conn->IsAdmin()) {
+      if (!options_.ns.empty() && options_.ns != conn->GetNamespace()) {
+        return {Status::RedisExecErr, errAdministorPermissionRequired};
       }
-      return Status::OK();
+      options_.ns = conn->GetNamespace();
     }
-    return {Status::NotOK};
+
+    options_.next_seq = from_seq_ ? *from_seq_ : svr->storage_->LatestSeq() + 1;
+    if (options_.next_seq <= svr->storage_->GetResyncSeq()) {
+      return {Status::RedisExecErr, "the data was changed outside the WAL after the sequence"};
+    }
+    if (!checkWALBoundary(svr->storage_, options_.next_seq).IsOK()) {
+      return {Status::RedisExecErr, "sequence out of range"};
+    }
+
+    // The connection is taken over by the feed thread like the replicas
+    conn->Detach();
+    Util::SockSetBlocking(conn->GetFD(), 1);
+
+    auto s = svr->AddCDCSubscriber(conn, std::move(options_));
+    if (!s.IsOK()) {
+      std::string err = "-ERR " + s.Msg() + "\r\n";
+      Util::SockSend(conn->GetFD(), err);
+      conn->EnableFlag(Redis::Connection::kCloseAsync);
+      LOG(WARNING) << "Failed to add the cdc subscriber: " << conn->GetAddr() << ", err: " << s.Msg();
+    } else {
+      LOG(INFO) << "New cdc subscriber: " << conn->GetAddr() << " was added";
+    }
+    return Status::OK();
+  }
+
+ private:
+  std::optional<rocksdb::SequenceNumber> from_seq_;
+  CDCOptions options_;
+
+  static bool isOption(const std::string &arg) {
+    auto option = Util::ToLower(arg);
+    return option == "from" || option == "ns" || option == "types" || option == "format";
   }
 };
 
@@ -4349,7 +5667,12 @@ class CommandSlowlog : public Commander {
         cnt_ = 0;
       } else {
         Status s = Util::DecimalStringToNum(args[2], &cnt_);
-        return s;
+        if (!s.IsOK()) return s;
+      }
+      if (args.size() == 4 && Util::ToLower(args[3]) == "withtrace") {
+        with_trace_ = true;
+      } else if (args.size() > 3) {
+        return {Status::RedisParseErr, errInvalidSyntax};
       }
     }
 
@@ -4366,7 +5689,11 @@ class CommandSlowlog : public Commander {
       *output = Redis::Integer(static_cast<int64_t>(slowlog->Size()));
       return Status::OK();
     } else if (subcommand_ == "get") {
-      *output = slowlog->GetLatestEntries(cnt_);
+      if (with_trace_) {
+        *output = slowlog->GetLatestEntries(cnt_, [](SlowEntry *entry) { return entry->ToRedisStringWithTrace(); });
+      } else {
+        *output = slowlog->GetLatestEntries(cnt_);
+      }
       return Status::OK();
     }
     return {Status::NotOK, "SLOWLOG subcommand must be one of RESET, LEN, GET"};
@@ -4375,14 +5702,249 @@ class CommandSlowlog : public Commander {
  private:
   std::string subcommand_;
   int64_t cnt_ = 10;
+  bool with_trace_ = false;
+};
+
+class CommandHotKeys : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    CommandParser parser(args, 1);
+    while (parser.Good()) {
+      if (parser.EatEqICase("COUNT")) {
+        auto count = GET_OR_RET(parser.TakeInt<int64_t>());
+        if (count <= 0) return {Status::RedisParseErr, errValueMustBePositive};
+        count_ = static_cast<size_t>(count);
+      } else if (parser.EatEqICase("NS")) {
+        ns_ = GET_OR_RET(parser.TakeStr());
+      } else {
+        return parser.InvalidSyntax();
+      }
+    }
+    return Status::OK();
+  }
+
+  Status Execute(Server *srv, Connection *conn, std::string *output) override {
+    if (!srv->GetConfig()->hotkeys_sample_interval) {
+      return {Status::RedisExecErr, "hot keys tracking is disabled, set hotkeys-sample-interval to enable it"};
+    }
+    // Only the admin can see the hot keys of the other namespaces
+    if (ns_ && !conn->IsAdmin()) {
+      *output = Redis::Error(errAdministorPermissionRequired);
+      return Status::OK();
+    }
+
+    std::vector<HotKey> hot_keys;
+    srv->GetHotKeys(ns_ ? *ns_ : conn->GetNamespace(), count_, &hot_keys);
+    output->append(Redis::MultiLen(static_cast<int64_t>(hot_keys.size())));
+    for (const auto &hot_key : hot_keys) {
+      output->append(Redis::MultiLen(3));
+      output->append(Redis::BulkString(hot_key.key));
+      output->append(Redis::Integer(static_cast<int64_t>(hot_key.reads)));
+      output->append(Redis::Integer(static_cast<int64_t>(hot_key.writes)));
+    }
+    return Status::OK();
+  }
+
+ private:
+  size_t count_ = 10;
+  std::optional<std::string> ns_;
+};
+
+class CommandBigKeys : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    CommandParser parser(args, 1);
+    while (parser.Good()) {
+      if (parser.EatEqICase("TYPE")) {
+        auto type_name = Util::ToLower(GET_OR_RET(parser.TakeStr()));
+        auto iter = std::find_if(RedisTypeNames.begin() + 1, RedisTypeNames.end(),
+                                 [&type_name](const std::string &name) { return Util::ToLower(name) == type_name; });
+        if (iter == RedisTypeNames.end()) {
+          return {Status::RedisParseErr, "unknown type name"};
+        }
+        type_ = static_cast<RedisType>(iter - RedisTypeNames.begin());
+      } else if (parser.EatEqICase("COUNT")) {
+        auto count = GET_OR_RET(parser.TakeInt<int64_t>());
+        if (count <= 0) return {Status::RedisParseErr, errValueMustBePositive};
+        count_ = static_cast<size_t>(count);
+      } else if (parser.EatEqICase("NS")) {
+        ns_ = GET_OR_RET(parser.TakeStr());
+      } else {
+        return parser.InvalidSyntax();
+      }
+    }
+    return Status::OK();
+  }
+
+  Status Execute(Server *srv, Connection *conn, std::string *output) override {
+    if (srv->GetConfig()->bigkeys_scan_rate <= 0) {
+      return {Status::RedisExecErr, "big keys tracking is disabled, set bigkeys-scan-rate to enable it"};
+    }
+    // Only the admin can see the big keys of the other namespaces
+    if (ns_ && !conn->IsAdmin()) {
+      *output = Redis::Error(errAdministorPermissionRequired);
+      return Status::OK();
+    }
+
+    auto big_keys = srv->storage_->GetBigKeys()->GetKeys(ns_ ? *ns_ : conn->GetNamespace(), type_, count_);
+    output->append(Redis::MultiLen(static_cast<int64_t>(big_keys.size())));
+    for (const auto &big_key : big_keys) {
+      output->append(Redis::MultiLen(4));
+      output->append(Redis::BulkString(big_key.key));
+      output->append(Redis::BulkString(RedisTypeNames[big_key.type]));
+      output->append(Redis::Integer(static_cast<int64_t>(big_key.size)));
+      output->append(Redis::Integer(static_cast<int64_t>(big_key.disk_bytes)));
+    }
+    return Status::OK();
+  }
+
+ private:
+  RedisType type_ = kRedisNone;
+  size_t count_ = 10;
+  std::optional<std::string> ns_;
+};
+
+class CommandLatency : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    subcommand_ = Util::ToLower(args[1]);
+    if (subcommand_ == "latest" && args.size() == 2) return Status::OK();
+    if (subcommand_ == "history" && args.size() == 3) return Status::OK();
+    if (subcommand_ == "reset") return Status::OK();
+    return {Status::RedisParseErr, "LATENCY subcommand must be one of LATEST, HISTORY <event>, RESET [event ...]"};
+  }
+
+  Status Execute(Server *srv, Connection *conn, std::string *output) override {
+    auto latency_monitor = srv->storage_->GetLatencyMonitor();
+    if (subcommand_ == "latest") {
+      auto latest = latency_monitor->Latest();
+      output->append(Redis::MultiLen(static_cast<int64_t>(latest.size())));
+      for (const auto &stats : latest) {
+        output->append(Redis::MultiLen(4));
+        output->append(Redis::BulkString(stats.event));
+        output->append(Redis::Integer(stats.latest.time));
+        output->append(Redis::Integer(static_cast<int64_t>(stats.latest.latency_ms)));
+        output->append(Redis::Integer(static_cast<int64_t>(stats.max_latency_ms)));
+      }
+    } else if (subcommand_ == "history") {
+      auto samples = latency_monitor->History(args_[2]);
+      output->append(Redis::MultiLen(static_cast<int64_t>(samples.size())));
+      for (const auto &sample : samples) {
+        output->append(Redis::MultiLen(2));
+        output->append(Redis::Integer(sample.time));
+        output->append(Redis::Integer(static_cast<int64_t>(sample.latency_ms)));
+      }
+    } else {
+      std::vector<std::string> events(args_.begin() + 2, args_.end());
+      *output = Redis::Integer(static_cast<int64_t>(latency_monitor->Reset(events)));
+    }
+    return Status::OK();
+  }
+
+ private:
+  std::string subcommand_;
+};
+
+class CommandMemory : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    subcommand_ = Util::ToLower(args[1]);
+    if (subcommand_ == "stats" && args.size() == 2) return Status::OK();
+    // MEMORY PROFILE ON|OFF|DUMP [path]
+    if (subcommand_ == "profile" && args.size() >= 3) {
+      profile_action_ = Util::ToLower(args[2]);
+      if ((profile_action_ == "on" || profile_action_ == "off") && args.size() == 3) return Status::OK();
+      if (profile_action_ == "dump" && args.size() <= 4) {
+        if (args.size() == 4) profile_path_ = args[3];
+        return Status::OK();
+      }
+      return {Status::RedisParseErr, errInvalidSyntax};
+    }
+    return {Status::RedisParseErr, "MEMORY subcommand must be STATS or PROFILE"};
+  }
+
+  Status Execute(Server *srv, Connection *conn, std::string *output) override {
+    if (subcommand_ == "profile") {
+      if (!conn->IsAdmin()) {
+        *output = Redis::Error(errAdministorPermissionRequired);
+        return Status::OK();
+      }
+      if (profile_action_ == "dump") {
+        // The profile is dumped into the directory of the server by default
+        if (profile_path_.empty()) {
+          profile_path_ = srv->GetConfig()->dir + "/jeprof." + std::to_string(getpid()) + "." +
+                          std::to_string(Util::GetTimeStampMS()) + ".heap";
+        }
+        auto s = Util::DumpHeapProfile(profile_path_);
+        if (!s.IsOK()) return {Status::RedisExecErr, s.Msg()};
+        *output = Redis::BulkString(profile_path_);
+        return Status::OK();
+      }
+      auto s = Util::SetHeapProfileActive(profile_action_ == "on");
+      if (!s.IsOK()) return {Status::RedisExecErr, s.Msg()};
+      *output = Redis::SimpleString("OK");
+      return Status::OK();
+    }
+
+    std::vector<MemoryStat> stats;
+    srv->GetMemoryStats(&stats);
+    output->append(Redis::MultiLen(static_cast<int64_t>(stats.size() * 2)));
+    for (const auto &stat : stats) {
+      output->append(Redis::BulkString(stat.name));
+      if (auto value = std::get_if<uint64_t>(&stat.value)) {
+        output->append(Redis::Integer(static_cast<int64_t>(*value)));
+      } else {
+        output->append(Redis::BulkString(Util::Float2String(std::get<double>(stat.value))));
+      }
+    }
+    return Status::OK();
+  }
+
+ private:
+  std::string subcommand_;
+  std::string profile_action_;
+  std::string profile_path_;
 };
 
 class CommandClient : public Commander {
  public:
   Status Parse(const std::vector<std::string> &args) override {
     subcommand_ = Util::ToLower(args[1]);
-    // subcommand: getname id kill list setname
-    if ((subcommand_ == "id" || subcommand_ == "getname" || subcommand_ == "list") && args.size() == 2) {
+    // subcommand: getname getredir id kill list setname tracking
+    if ((subcommand_ == "id" || subcommand_ == "getname" || subcommand_ == "list" || subcommand_ == "getredir") &&
+        args.size() == 2) {
+      return Status::OK();
+    }
+
+    // CLIENT TRACKING ON|OFF [REDIRECT id] [BCAST] [PREFIX prefix]... [NOLOOP]
+    if (subcommand_ == "tracking" && args.size() >= 3) {
+      CommandParser parser(args, 2);
+      if (parser.EatEqICase("on")) {
+        tracking_on_ = true;
+      } else if (!parser.EatEqICase("off")) {
+        return {Status::RedisParseErr, errInvalidSyntax};
+      }
+      while (parser.Good()) {
+        if (parser.EatEqICase("redirect")) {
+          tracking_options_.redirect = GET_OR_RET(parser.TakeInt<uint64_t>());
+        } else if (parser.EatEqICase("bcast")) {
+          tracking_options_.bcast = true;
+        } else if (parser.EatEqICase("prefix")) {
+          tracking_options_.prefixes.emplace_back(GET_OR_RET(parser.TakeStr()));
+        } else if (parser.EatEqICase("noloop")) {
+          tracking_options_.noloop = true;
+        } else {
+          return {Status::RedisParseErr, errInvalidSyntax};
+        }
+      }
+      if (!tracking_options_.prefixes.empty() && !tracking_options_.bcast) {
+        return {Status::RedisParseErr, "PREFIX option requires BCAST mode to be enabled"};
+      }
+      // Only RESP2 is supported, so the invalidations can't be pushed to the tracking client itself
+      if (tracking_on_ && tracking_options_.redirect == 0) {
+        return {Status::RedisParseErr, "CLIENT TRACKING requires REDIRECT to the client subscribing to " +
+                                           std::string(kTrackingChannel)};
+      }
       return Status::OK();
     }
 
@@ -4452,7 +6014,7 @@ class CommandClient : public Commander {
       }
       return Status::OK();
     }
-    return {Status::RedisInvalidCmd, "Syntax error, try CLIENT LIST|KILL ip:port|GETNAME|SETNAME"};
+    return {Status::RedisInvalidCmd, "Syntax error, try CLIENT LIST|KILL ip:port|GETNAME|SETNAME|TRACKING|GETREDIR"};
   }
 
   Status Execute(Server *srv, Connection *conn, std::string *output) override {
@@ -4470,6 +6032,20 @@ class CommandClient : public Commander {
     } else if (subcommand_ == "id") {
       *output = Redis::Integer(conn->GetID());
       return Status::OK();
+    } else if (subcommand_ == "getredir") {
+      *output = Redis::Integer(srv->GetClientTracking()->GetRedirect(conn->GetID()));
+      return Status::OK();
+    } else if (subcommand_ == "tracking") {
+      if (!tracking_on_) {
+        srv->GetClientTracking()->Disable(conn->GetID());
+        conn->DisableFlag(Connection::kTracking);
+      } else {
+        auto s = srv->EnableClientTracking(conn, tracking_options_);
+        if (!s.IsOK()) return s;
+        conn->EnableFlag(Connection::kTracking);
+      }
+      *output = Redis::SimpleString("OK");
+      return Status::OK();
     } else if (subcommand_ == "kill") {
       int64_t killed = 0;
       srv->KillClient(&killed, addr_, id_, kill_type_, skipme_, conn);
@@ -4484,7 +6060,7 @@ class CommandClient : public Commander {
       return Status::OK();
     }
 
-    return {Status::RedisInvalidCmd, "Syntax error, try CLIENT LIST|KILL ip:port|GETNAME|SETNAME"};
+    return {Status::RedisInvalidCmd, "Syntax error, try CLIENT LIST|KILL ip:port|GETNAME|SETNAME|TRACKING|GETREDIR"};
   }
 
  private:
@@ -4495,15 +6071,41 @@ class CommandClient : public Commander {
   int64_t kill_type_ = 0;
   uint64_t id_ = 0;
   bool new_format_ = true;
+  bool tracking_on_ = false;
+  TrackingOptions tracking_options_;
 };
 
 class CommandMonitor : public Commander {
  public:
+  // MONITOR [SAMPLE ratio] [COMMAND name]... [PREFIX prefix]...
+  Status Parse(const std::vector<std::string> &args) override {
+    CommandParser parser(args, 1);
+    while (parser.Good()) {
+      if (parser.EatEqICase("sample")) {
+        auto parse_result = parser.TakeFloat();
+        if (!parse_result) return {Status::RedisParseErr, errInvalidSampleRatio};
+        double ratio = *parse_result;
+        if (!(ratio > 0 && ratio <= 1)) return {Status::RedisParseErr, errInvalidSampleRatio};
+        filter_.sample_ratio = ratio;
+      } else if (parser.EatEqICase("command")) {
+        filter_.commands.emplace(Util::ToLower(GET_OR_RET(parser.TakeStr())));
+      } else if (parser.EatEqICase("prefix")) {
+        filter_.prefixes.emplace_back(GET_OR_RET(parser.TakeStr()));
+      } else {
+        return {Status::RedisParseErr, errInvalidSyntax};
+      }
+    }
+    return Commander::Parse(args);
+  }
+
   Status Execute(Server *srv, Connection *conn, std::string *output) override {
-    conn->Owner()->BecomeMonitorConn(conn);
+    conn->Owner()->BecomeMonitorConn(conn, filter_);
     *output = Redis::SimpleString("OK");
     return Status::OK();
   }
+
+ private:
+  MonitorFilter filter_;
 };
 
 class CommandShutdown : public Commander {
@@ -4536,22 +6138,76 @@ class CommandDebug : public Commander {
   Status Parse(const std::vector<std::string> &args) override {
     subcommand_ = Util::ToLower(args[1]);
     if ((subcommand_ == "sleep") && args.size() == 3) {
-      double second = 0.0;
-      try {
-        second = std::stod(args[2]);
-      } catch (const std::exception &e) {
+      auto second = ParseFloat(args[2]);
+      if (!second) {
         return {Status::RedisParseErr, "invalid debug sleep time"};
       }
 
-      microsecond_ = static_cast<uint64_t>(second * 1000 * 1000);
+      microsecond_ = static_cast<uint64_t>(*second * 1000 * 1000);
       return Status::OK();
     }
-    return {Status::RedisInvalidCmd, "Syntax error, DEBUG SLEEP <seconds>"};
-  }
-
-  Status Execute(Server *srv, Connection *conn, std::string *output) override {
-    if (subcommand_ == "sleep") {
-      usleep(microsecond_);
+    if ((subcommand_ == "lockstats") && args.size() <= 3) {
+      if (args.size() == 3 && Util::ToLower(args[2]) == "reset") {
+        reset_ = true;
+      } else if (args.size() == 3) {
+        auto count = ParseInt<int>(args[2], {1, 1000}, 10);
+        if (!count) {
+          return {Status::RedisParseErr, "invalid debug lockstats count"};
+        }
+        count_ = *count;
+      }
+      return Status::OK();
+    }
+    // Fail the commits of the next transactions, which tests how EXEC discards their replies
+    if ((subcommand_ == "fail-txn-commit") && args.size() == 3) {
+      auto count = ParseInt<int>(args[2], {0, 1000}, 10);
+      if (!count) {
+        return {Status::RedisParseErr, "invalid debug fail-txn-commit count"};
+      }
+      count_ = *count;
+      return Status::OK();
+    }
+    return {Status::RedisInvalidCmd,
+            "Syntax error, DEBUG SLEEP <seconds>, DEBUG LOCKSTATS [<count>|RESET] or DEBUG FAIL-TXN-COMMIT <count>"};
+  }
+
+  Status Execute(Server *srv, Connection *conn, std::string *output) override {
+    if (subcommand_ == "lockstats") {
+      auto lock_mgr = srv->storage_->GetLockManager();
+      if (reset_) {
+        lock_mgr->ResetStats();
+        *output = Redis::SimpleString("OK");
+        return Status::OK();
+      }
+      // Each lock is replied as its index, the waits, the wait time and the sampled keys
+      auto slots = lock_mgr->GetContendedSlots(count_);
+      *output = Redis::MultiLen(static_cast<int64_t>(slots.size()));
+      for (const auto &slot : slots) {
+        std::vector<std::string> keys;
+        keys.reserve(slot.keys.size());
+        for (const auto &ns_key : slot.keys) {
+          // The key locked by the storage itself may not be in a namespace
+          if (ns_key.empty() || static_cast<uint8_t>(ns_key[0]) >= ns_key.size()) {
+            keys.emplace_back(ns_key);
+            continue;
+          }
+          std::string ns, user_key;
+          ExtractNamespaceKey(ns_key, &ns, &user_key, srv->storage_->IsSlotIdEncoded());
+          keys.emplace_back(std::move(user_key));
+        }
+        *output += Redis::MultiLen(4);
+        *output += Redis::Integer(slot.index);
+        *output += Redis::Integer(static_cast<int64_t>(slot.waits));
+        *output += Redis::Integer(static_cast<int64_t>(slot.wait_us));
+        *output += Redis::MultiBulkString(keys, false);
+      }
+      return Status::OK();
+    }
+    if (subcommand_ == "sleep") {
+      usleep(microsecond_);
+    }
+    if (subcommand_ == "fail-txn-commit") {
+      srv->storage_->FailTxnCommits(static_cast<int>(count_));
     }
     *output = Redis::SimpleString("OK");
     return Status::OK();
@@ -4560,6 +6216,8 @@ class CommandDebug : public Commander {
  private:
   std::string subcommand_;
   uint64_t microsecond_ = 0;
+  size_t count_ = 10;
+  bool reset_ = false;
 };
 
 class CommandCommand : public Commander {
@@ -4682,13 +6340,10 @@ class CommandScanBase : public Commander {
  public:
   Status ParseMatchAndCountParam(const std::string &type, std::string value) {
     if (type == "match") {
-      prefix = std::move(value);
-      if (!prefix.empty() && prefix[prefix.size() - 1] == '*') {
-        prefix = prefix.substr(0, prefix.size() - 1);
-        return Status::OK();
-      }
-
-      return {Status::RedisParseErr, "only keys prefix match was supported"};
+      pattern = std::make_unique<Util::GlobPattern>(value);
+      prefix = pattern->LiteralPrefix();
+      if (pattern->MatchesAllWithPrefix()) pattern = nullptr;
+      return Status::OK();
     } else if (type == "count") {
       auto parse_result = ParseInt<int>(value, 10);
       if (!parse_result) {
@@ -4729,6 +6384,8 @@ class CommandScanBase : public Commander {
  protected:
   std::string cursor;
   std::string prefix;
+  // The pattern is null if all the keys with the prefix are matched
+  std::unique_ptr<Util::GlobPattern> pattern;
   int limit = 20;
 };
 
@@ -4756,6 +6413,9 @@ class CommandSubkeyScanBase : public CommandScanBase {
         return s;
       }
     }
+    if (pattern) {
+      return {Status::RedisParseErr, "only keys prefix match was supported"};
+    }
     return Commander::Parse(args);
   }
 
@@ -4792,15 +6452,31 @@ class CommandScan : public CommandScanBase {
     }
 
     ParseCursor(args[1]);
-    if (args.size() >= 4) {
-      Status s = ParseMatchAndCountParam(Util::ToLower(args[2]), args_[3]);
-      if (!s.IsOK()) {
-        return s;
+    is_range_cursor_ = decodeRangeCursor(args[1], &range_begin_, &range_end_);
+    for (size_t i = 2; i + 1 < args.size(); i += 2) {
+      std::string option = Util::ToLower(args[i]);
+      if (option == "parallel") {
+        auto parse_result = ParseInt<int>(args[i + 1], NumericRange<int>{1, kMaxParallelCursors}, 10);
+        if (!parse_result) {
+          return {Status::RedisParseErr, "parallel param should be an integer between 1 and 1024"};
+        }
+        if (args[1] != "0") {
+          return {Status::RedisParseErr, "parallel param requires the cursor 0"};
+        }
+        parallel_ = *parse_result;
+        continue;
       }
-    }
-
-    if (args.size() >= 6) {
-      Status s = ParseMatchAndCountParam(Util::ToLower(args[4]), args_[5]);
+      if (option == "type") {
+        auto type_name = Util::ToLower(args[i + 1]);
+        auto iter = std::find_if(RedisTypeNames.begin() + 1, RedisTypeNames.end(),
+                                 [&type_name](const std::string &name) { return Util::ToLower(name) == type_name; });
+        if (iter == RedisTypeNames.end()) {
+          return {Status::RedisParseErr, "unknown type name"};
+        }
+        type_ = static_cast<RedisType>(iter - RedisTypeNames.begin());
+        continue;
+      }
+      Status s = ParseMatchAndCountParam(option, args_[i + 1]);
       if (!s.IsOK()) {
         return s;
       }
@@ -4824,9 +6500,45 @@ class CommandScan : public CommandScanBase {
 
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
     Redis::Database redis_db(svr->storage_, conn->GetNamespace());
+    if (parallel_ > 0) {
+      // The cursors of the partitions split at the SST files, which can be scanned by the clients independently
+      std::string begin, end;
+      redis_db.KeyRange(prefix, &begin, &end);
+      auto boundaries = redis_db.PartitionKeyRange(begin, end, parallel_);
+      boundaries.insert(boundaries.begin(), begin);
+      boundaries.emplace_back(end);
+      std::vector<std::string> cursors;
+      for (size_t i = 0; i + 1 < boundaries.size(); i++) {
+        cursors.emplace_back(encodeRangeCursor(boundaries[i], boundaries[i + 1]));
+      }
+      *output = Redis::MultiBulkString(cursors);
+      return Status::OK();
+    }
+
     std::vector<std::string> keys;
+    if (is_range_cursor_) {
+      // The range is clamped to the namespace, so a forged cursor can't reach the keys of others
+      std::string begin, end, next;
+      redis_db.KeyRange(prefix, &begin, &end);
+      range_begin_ = std::max(range_begin_, begin);
+      if (range_end_.empty() || (!end.empty() && range_end_ > end)) range_end_ = end;
+      if (!range_end_.empty() && range_begin_ >= range_end_) {
+        *output = GenerateOutput(keys, "");
+        return Status::OK();
+      }
+      auto s = redis_db.ScanKeyRange(range_begin_, range_end_, limit, prefix, pattern.get(), type_, &keys, &next);
+      if (!s.ok()) {
+        return {Status::RedisExecErr, s.ToString()};
+      }
+      std::vector<std::string> list;
+      list.emplace_back(Redis::BulkString(next.empty() ? "0" : encodeRangeCursor(next, range_end_)));
+      list.emplace_back(Redis::MultiBulkString(keys));
+      *output = Redis::Array(list);
+      return Status::OK();
+    }
+
     std::string end_cursor;
-    auto s = redis_db.Scan(cursor, limit, prefix, &keys, &end_cursor);
+    auto s = redis_db.Scan(cursor, limit, prefix, &keys, &end_cursor, pattern.get(), type_);
     if (!s.ok()) {
       return {Status::RedisExecErr, s.ToString()};
     }
@@ -4834,6 +6546,35 @@ class CommandScan : public CommandScanBase {
     *output = GenerateOutput(keys, end_cursor);
     return Status::OK();
   }
+
+ private:
+  static constexpr int kMaxParallelCursors = 1024;
+
+  static std::string encodeRangeCursor(const std::string &begin, const std::string &end) {
+    std::string range;
+    PutFixed32(&range, static_cast<uint32_t>(begin.size()));
+    range.append(begin).append(end);
+    return kParallelCursorPrefix + Util::StringToHex(range);
+  }
+
+  // The cursor which isn't a valid range cursor is taken as a key, like the cursors of the plain SCAN
+  static bool decodeRangeCursor(const std::string &cursor, std::string *begin, std::string *end) {
+    if (cursor.find(kParallelCursorPrefix) != 0) return false;
+    std::string range;
+    if (!Util::HexToString(cursor.substr(strlen(kParallelCursorPrefix)), &range)) return false;
+    rocksdb::Slice input(range);
+    uint32_t begin_size = 0;
+    if (!GetFixed32(&input, &begin_size) || begin_size > input.size()) return false;
+    *begin = std::string(input.data(), begin_size);
+    *end = std::string(input.data() + begin_size, input.size() - begin_size);
+    return true;
+  }
+
+  RedisType type_ = kRedisNone;
+  int parallel_ = 0;
+  bool is_range_cursor_ = false;
+  std::string range_begin_;
+  std::string range_end_;
 };
 
 class CommandHScan : public CommandSubkeyScanBase {
@@ -4905,22 +6646,149 @@ class CommandRandomKey : public Commander {
   }
 };
 
-class CommandReplConf : public Commander {
+class CommandWait : public Commander {
  public:
+  CommandWait() = default;
+  CommandWait(const CommandWait &) = delete;
+  CommandWait &operator=(const CommandWait &) = delete;
+
+  ~CommandWait() override {
+    if (timer_) {
+      event_free(timer_);
+      timer_ = nullptr;
+    }
+  }
+
   Status Parse(const std::vector<std::string> &args) override {
-    if (args.size() % 2 == 0) {
-      return {Status::RedisParseErr, errWrongNumOfArguments};
+    auto num_replicas = ParseInt<int>(args[1], {0, INT_MAX}, 10);
+    if (!num_replicas) return {Status::RedisParseErr, errValueNotInteger};
+    num_replicas_ = *num_replicas;
+
+    auto timeout = ParseInt<int64_t>(args[2], 10);
+    if (!timeout) return {Status::RedisParseErr, errValueNotInteger};
+    if (*timeout < 0) return {Status::RedisParseErr, "timeout is negative"};
+    timeout_ = *timeout;
+    return Status::OK();
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    if (svr->IsSlave()) return {Status::RedisExecErr, "WAIT cannot be used with replica instances"};
+
+    svr_ = svr;
+    conn_ = conn;
+    // Wait for all writes before, including the writes of the other connections
+    seq_ = svr->storage_->LatestSeq();
+    int acked = svr->CountReplicasAcked(seq_);
+    if (acked >= num_replicas_ || conn->IsInExec()) {
+      *output = Redis::Integer(acked);
+      return Status::OK();
     }
 
-    if (args.size() >= 3) {
-      Status s = ParseParam(Util::ToLower(args[1]), args_[2]);
-      if (!s.IsOK()) {
-        return s;
+    auto bev = conn->GetBufferEvent();
+    bufferevent_setcb(bev, nullptr, WriteCB, EventCB, this);
+    if (timeout_ > 0) {
+      timer_ = evtimer_new(bufferevent_get_base(bev), TimerCB, this);
+      timeval tm = {timeout_ / 1000, static_cast<int>(timeout_ % 1000) * 1000};
+      evtimer_add(timer_, &tm);
+    }
+    svr->AddReplAckWaiter(conn, seq_, num_replicas_);
+    return {Status::BlockingCmd};
+  }
+
+  static void WriteCB(bufferevent *bev, void *ctx) {
+    auto self = static_cast<CommandWait *>(ctx);
+    // The write event may be triggered by the replies before, or the replica was disconnected
+    // after the wakeup, so wait for the wakeup again
+    if (self->svr_->CountReplicasAcked(self->seq_) < self->num_replicas_) {
+      bufferevent_disable(bev, EV_WRITE);
+      self->svr_->RemoveReplAckWaiter(self->conn_);
+      self->svr_->AddReplAckWaiter(self->conn_, self->seq_, self->num_replicas_);
+      return;
+    }
+    self->unblock();
+  }
+
+  static void TimerCB(int, int16_t events, void *ctx) { static_cast<CommandWait *>(ctx)->unblock(); }
+
+  static void EventCB(bufferevent *bev, int16_t events, void *ctx) {
+    auto self = static_cast<CommandWait *>(ctx);
+    if (events & (BEV_EVENT_EOF | BEV_EVENT_ERROR)) {
+      if (self->timer_) {
+        event_free(self->timer_);
+        self->timer_ = nullptr;
       }
+      self->svr_->RemoveReplAckWaiter(self->conn_);
     }
+    Redis::Connection::OnEvent(bev, events, self->conn_);
+  }
 
-    if (args.size() >= 5) {
-      Status s = ParseParam(Util::ToLower(args[3]), args_[4]);
+ private:
+  int num_replicas_ = 0;
+  int64_t timeout_ = 0;  // milliseconds
+  rocksdb::SequenceNumber seq_ = 0;
+  Server *svr_ = nullptr;
+  Connection *conn_ = nullptr;
+  event *timer_ = nullptr;
+
+  // Reply the number of the replicas acknowledged the writes when enough replicas did or timed out
+  void unblock() {
+    if (timer_) {
+      event_free(timer_);
+      timer_ = nullptr;
+    }
+    svr_->RemoveReplAckWaiter(conn_);
+    conn_->Reply(Redis::Integer(svr_->CountReplicasAcked(seq_)));
+
+    auto bev = conn_->GetBufferEvent();
+    bufferevent_setcb(bev, Redis::Connection::OnRead, Redis::Connection::OnWrite, Redis::Connection::OnEvent, conn_);
+    bufferevent_enable(bev, EV_READ);
+    // Process the commands received while blocking, see CommandBPop::WriteCB
+    bufferevent_trigger(bev, EV_READ, BEV_TRIG_IGNORE_WATERMARKS);
+  }
+};
+
+// READONLY [MAXLAG milliseconds], the reads of the connection are rejected on the replica which
+// lags behind the master more than the milliseconds, so the clients can route the reads to the
+// fresher replicas. The lag of the replica can be followed by subscribing __kvrocks_replica_lag__.
+class CommandReadOnly : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    if (args.size() == 1) return Status::OK();
+    if (args.size() != 3 || Util::ToLower(args[1]) != "maxlag") return {Status::RedisParseErr, errInvalidSyntax};
+    auto max_lag = ParseInt<int64_t>(args[2], {0, INT64_MAX}, 10);
+    if (!max_lag) return {Status::RedisParseErr, errValueNotInteger};
+    max_lag_ms_ = *max_lag;
+    return Status::OK();
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    conn->SetMaxReadLag(max_lag_ms_);
+    *output = Redis::SimpleString("OK");
+    return Status::OK();
+  }
+
+ private:
+  int64_t max_lag_ms_ = -1;
+};
+
+class CommandReadWrite : public Commander {
+ public:
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    conn->SetMaxReadLag(-1);
+    *output = Redis::SimpleString("OK");
+    return Status::OK();
+  }
+};
+
+class CommandReplConf : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    if (args.size() % 2 == 0) {
+      return {Status::RedisParseErr, errWrongNumOfArguments};
+    }
+
+    for (size_t i = 1; i + 1 < args.size(); i += 2) {
+      Status s = ParseParam(Util::ToLower(args[i]), args_[i + 1]);
       if (!s.IsOK()) {
         return s;
       }
@@ -4937,6 +6805,20 @@ class CommandReplConf : public Commander {
       }
 
       port_ = *parse_result;
+    } else if (option == "compression") {
+      auto compression = Util::ToLower(value);
+      if (compression == "zstd") {
+        compression_ = kReplCompressionZstd;
+      } else if (compression == "no") {
+        compression_ = kReplCompressionNone;
+      } else {
+        return {Status::RedisParseErr, "unsupported compression"};
+      }
+    } else if (option == "capa") {
+      // Ignore the unknown capabilities like Redis
+      auto capa = Util::ToLower(value);
+      if (capa == "ack") ack_enabled_ = true;
+      if (capa == "heartbeat") heartbeat_enabled_ = true;
     } else {
       return {Status::RedisParseErr, "unknown option"};
     }
@@ -4948,12 +6830,24 @@ class CommandReplConf : public Commander {
     if (port_ != 0) {
       conn->SetListeningPort(port_);
     }
+    if (compression_ >= 0) {
+      conn->SetReplCompression(compression_);
+    }
+    if (ack_enabled_) {
+      conn->SetReplAckEnabled(true);
+    }
+    if (heartbeat_enabled_) {
+      conn->SetReplHeartbeatEnabled(true);
+    }
     *output = Redis::SimpleString("OK");
     return Status::OK();
   }
 
  private:
   int port_ = 0;
+  int compression_ = -1;
+  bool ack_enabled_ = false;
+  bool heartbeat_enabled_ = false;
 };
 
 class CommandFetchMeta : public Commander {
@@ -5001,11 +6895,37 @@ class CommandFetchFile : public Commander {
  public:
   Status Parse(const std::vector<std::string> &args) override {
     files_str_ = args[1];
+    for (size_t i = 2; i < args.size(); i++) {
+      auto option = Util::ToLower(args[i]);
+      if (option == "zstd") {
+        compressed_ = true;
+      } else if (option == "offsets" && i + 1 < args.size()) {
+        // The replica resumes the partial files by the offsets and the checksums of their
+        // fetched prefixes, e.g. "offsets 1024:3870937290,0:0"
+        for (const auto &offset_str : Util::Split(args[++i], ",")) {
+          auto pos = offset_str.find(':');
+          if (pos == std::string::npos) return {Status::RedisParseErr, "invalid offset"};
+          auto offset = ParseInt<uint64_t>(offset_str.substr(0, pos), 10);
+          auto crc = ParseInt<uint32_t>(offset_str.substr(pos + 1), 10);
+          if (!offset || !crc) return {Status::RedisParseErr, "invalid offset"};
+          offsets_.emplace_back(*offset, *crc);
+        }
+        resumable_ = true;
+      } else {
+        return {Status::RedisParseErr, "unsupported option: " + args[i]};
+      }
+    }
     return Status::OK();
   }
 
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
     std::vector<std::string> files = Util::Split(files_str_, ",");
+    bool compressed = compressed_;
+    bool resumable = resumable_;
+    if (resumable && offsets_.size() != files.size()) {
+      return {Status::RedisExecErr, "the number of offsets doesn't match the number of files"};
+    }
+    auto offsets = offsets_;
 
     int repl_fd = conn->GetFD();
     std::string ip = conn->GetIP();
@@ -5014,12 +6934,13 @@ class CommandFetchFile : public Commander {
     conn->NeedNotClose();  // Feed-replica-file thread will close the replica fd
     conn->EnableFlag(Redis::Connection::kCloseAsync);
 
-    std::thread t = std::thread([svr, repl_fd, ip, files]() {
+    std::thread t = std::thread([svr, repl_fd, ip, files, compressed, resumable, offsets]() {
       Util::ThreadSetName("feed-repl-file");
       UniqueFD unique_fd{repl_fd};
       svr->IncrFetchFileThread();
 
-      for (const auto &file : files) {
+      for (size_t i = 0; i < files.size(); i++) {
+        const auto &file = files[i];
         if (svr->IsStopped()) break;
 
         uint64_t file_size = 0, max_replication_bytes = 0;
@@ -5030,10 +6951,27 @@ class CommandFetchFile : public Commander {
         auto fd = UniqueFD(Engine::Storage::ReplDataManager::OpenDataFile(svr->storage_, file, &file_size));
         if (!fd) break;
 
-        // Send file size and content
-        if (Util::SockSend(repl_fd, std::to_string(file_size) + CRLF).IsOK() &&
-            Util::SockSendFile(repl_fd, *fd, file_size).IsOK()) {
-          LOG(INFO) << "[replication] Succeed sending file " << file << " to " << ip;
+        // The partial file is resumed only if its prefix is the same as that of our file,
+        // otherwise the replica should fetch it from the beginning
+        uint64_t offset = 0;
+        std::string size_line = std::to_string(file_size);
+        if (resumable) {
+          auto [resume_offset, resume_crc] = offsets[i];
+          uint32_t crc = 0;
+          if (resume_offset > 0 && resume_offset <= file_size && CalculateFileCRC(*fd, resume_offset, &crc).IsOK() &&
+              crc == resume_crc) {
+            offset = resume_offset;
+          }
+          size_line += " " + std::to_string(offset);
+        }
+
+        // Send file size and content, the content is sent as the compressed chunks if required
+        uint64_t send_size = file_size - offset;
+        if (Util::SockSend(repl_fd, size_line + CRLF).IsOK() &&
+            (compressed ? SendFileCompressed(repl_fd, *fd, send_size, static_cast<off_t>(offset))
+                        : Util::SockSendFile(repl_fd, *fd, send_size, static_cast<off_t>(offset)))
+                .IsOK()) {
+          LOG(INFO) << "[replication] Succeed sending file " << file << " to " << ip << " from offset " << offset;
         } else {
           LOG(WARNING) << "[replication] Fail to send file " << file << " to " << ip << ", error: " << strerror(errno);
           break;
@@ -5043,7 +6981,7 @@ class CommandFetchFile : public Commander {
         // Sleep if the speed of sending file is more than replication speed limit
         auto end = std::chrono::high_resolution_clock::now();
         uint64_t duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
-        auto shortest = static_cast<uint64_t>(static_cast<double>(file_size) / max_replication_bytes * (1000 * 1000));
+        auto shortest = static_cast<uint64_t>(static_cast<double>(send_size) / max_replication_bytes * (1000 * 1000));
         if (max_replication_bytes > 0 && duration < shortest) {
           LOG(INFO) << "[replication] Need to sleep " << (shortest - duration) / 1000
                     << " ms since of sending files too quickly";
@@ -5061,6 +6999,9 @@ class CommandFetchFile : public Commander {
 
  private:
   std::string files_str_;
+  bool compressed_ = false;
+  bool resumable_ = false;
+  std::vector<std::pair<uint64_t, uint32_t>> offsets_;
 };
 
 class CommandDBName : public Commander {
@@ -5083,13 +7024,37 @@ class CommandCluster : public Commander {
 
     if (subcommand_ == "keyslot" && args_.size() == 3) return Status::OK();
 
+    if (subcommand_ == "countkeysinslot" && args.size() == 3) {
+      auto s = Util::DecimalStringToNum(args[2], &slot_, static_cast<int64_t>(0),
+                                        static_cast<int64_t>(HASH_SLOTS_SIZE - 1));
+      if (!s.IsOK()) return {Status::RedisParseErr, "Invalid slot"};
+      return Status::OK();
+    }
+
+    if (subcommand_ == "slot-stats" && args.size() >= 4 && Util::ToLower(args[2]) == "orderby") {
+      return parseSlotStatsOrderBy(args);
+    }
+
+    if (subcommand_ == "slot-stats") {
+      if (args.size() != 5 || Util::ToLower(args[2]) != "slotsrange") {
+        return {Status::RedisParseErr,
+                "CLUSTER SLOT-STATS SLOTSRANGE start-slot end-slot | ORDERBY metric [LIMIT limit] [ASC|DESC]"};
+      }
+      auto max_slot = static_cast<int64_t>(HASH_SLOTS_SIZE - 1);
+      auto s = Util::DecimalStringToNum(args[3], &slot_, static_cast<int64_t>(0), max_slot);
+      if (!s.IsOK()) return {Status::RedisParseErr, "Invalid slot"};
+      s = Util::DecimalStringToNum(args[4], &end_slot_, slot_, max_slot);
+      if (!s.IsOK()) return {Status::RedisParseErr, "Invalid slot range"};
+      return Status::OK();
+    }
+
+    // CLUSTER IMPORT $SLOT|$START_SLOT-$END_SLOT $STATE
     if (subcommand_ == "import") {
       if (args.size() != 4) return {Status::RedisParseErr, errWrongNumOfArguments};
-      auto s = Util::DecimalStringToNum(args[2], &slot_);
-      if (!s.IsOK()) return s;
+      if (!SlotRange::Parse(args[2], &slots_)) return {Status::RedisParseErr, "Slot is out of range"};
 
       int64_t state = 0;
-      s = Util::DecimalStringToNum(args[3], &state, static_cast<int64_t>(kImportStart),
+      auto s = Util::DecimalStringToNum(args[3], &state, static_cast<int64_t>(kImportStart),
                                    static_cast<int64_t>(kImportNone));
       if (!s.IsOK()) return {Status::NotOK, "Invalid import state"};
 
@@ -5097,7 +7062,13 @@ class CommandCluster : public Commander {
       return Status::OK();
     }
 
-    return {Status::RedisParseErr, "CLUSTER command, CLUSTER INFO|NODES|SLOTS|KEYSLOT"};
+    if (subcommand_ == "importsst") {
+      if (args.size() != 4) return {Status::RedisParseErr, errWrongNumOfArguments};
+      if (!SlotRange::Parse(args[2], &slots_)) return {Status::RedisParseErr, "Invalid slot"};
+      return Status::OK();
+    }
+
+    return {Status::RedisParseErr, "CLUSTER command, CLUSTER INFO|NODES|SLOTS|KEYSLOT|COUNTKEYSINSLOT|SLOT-STATS"};
   }
 
   Status Execute(Server *svr, Connection *conn, std::string *output) override {
@@ -5149,8 +7120,96 @@ class CommandCluster : public Commander {
       } else {
         *output = Redis::Error(s.Msg());
       }
+    } else if (subcommand_ == "countkeysinslot") {
+      auto key_counter = svr->storage_->GetKeyCounter();
+      if (svr->GetConfig()->key_count_tracking && key_counter->Ready()) {
+        *output = Redis::Integer(key_counter->GetSlotKeys(conn->GetNamespace(), static_cast<int>(slot_)));
+        return Status::OK();
+      }
+      // Count the keys of the slot by scanning if the key counter isn't ready
+      std::map<int, uint64_t> slots_keys;
+      Redis::Database db(svr->storage_, conn->GetNamespace());
+      auto s = db.GetSlotKeysInfo(static_cast<int>(slot_), &slots_keys, nullptr, 0);
+      if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
+      *output = Redis::Integer(slots_keys[static_cast<int>(slot_)]);
+    } else if (subcommand_ == "slot-stats") {
+      // All the slots are ranked by the metric, the slots which aren't served by myself have no traffic
+      // and no keys, so they're ranked after the others in the descending order
+      auto start_slot = order_by_.empty() ? static_cast<int>(slot_) : 0;
+      auto end_slot = order_by_.empty() ? static_cast<int>(end_slot_) : HASH_SLOTS_SIZE - 1;
+      std::vector<uint64_t> slot_sizes;
+      Redis::Disk disk_db(svr->storage_, conn->GetNamespace());
+      auto s = disk_db.GetSlotSizes(start_slot, end_slot, &slot_sizes);
+      if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
+
+      std::vector<uint64_t> slot_keys(slot_sizes.size());
+      auto key_counter = svr->storage_->GetKeyCounter();
+      if (svr->GetConfig()->key_count_tracking && key_counter->Ready()) {
+        for (int slot = start_slot; slot <= end_slot; slot++) {
+          slot_keys[slot - start_slot] = key_counter->GetSlotKeys(conn->GetNamespace(), slot);
+        }
+      } else {
+        // Scan all slots once if the key counter isn't ready, it's slow on the large DB
+        std::map<int, uint64_t> slots_keys;
+        s = disk_db.GetSlotKeysInfo(-1, &slots_keys, nullptr, 0);
+        if (!s.ok()) return {Status::RedisExecErr, s.ToString()};
+        for (int slot = start_slot; slot <= end_slot; slot++) {
+          slot_keys[slot - start_slot] = slots_keys[slot];
+        }
+      }
+
+      std::vector<SlotStat> slot_traffic;
+      svr->stats_.GetSlotStats(start_slot, end_slot, &slot_traffic);
+
+      std::vector<size_t> indexes(slot_sizes.size());
+      std::iota(indexes.begin(), indexes.end(), 0);
+      if (!order_by_.empty()) {
+        auto metric = [&](size_t i) -> uint64_t {
+          if (order_by_ == "key-count") return slot_keys[i];
+          if (order_by_ == "approximate-size") return slot_sizes[i];
+          if (order_by_ == "calls") return slot_traffic[i].calls;
+          if (order_by_ == "read-bytes") return slot_traffic[i].read_bytes;
+          return slot_traffic[i].write_bytes;
+        };
+        std::vector<uint64_t> values(indexes.size());
+        for (size_t i = 0; i < indexes.size(); i++) values[i] = metric(i);
+        // The slots with the same value are ordered by the slot, so the result is stable
+        std::stable_sort(indexes.begin(), indexes.end(), [&](size_t a, size_t b) {
+          return desc_ ? values[a] > values[b] : values[a] < values[b];
+        });
+        indexes.resize(std::min(indexes.size(), static_cast<size_t>(limit_)));
+      }
+
+      output->append(Redis::MultiLen(indexes.size()));
+      for (auto i : indexes) {
+        output->append(Redis::MultiLen(2));
+        output->append(Redis::Integer(start_slot + static_cast<int>(i)));
+        output->append(Redis::MultiLen(10));
+        output->append(Redis::BulkString("key-count"));
+        output->append(Redis::Integer(slot_keys[i]));
+        output->append(Redis::BulkString("approximate-size"));
+        output->append(Redis::Integer(slot_sizes[i]));
+        output->append(Redis::BulkString("calls"));
+        output->append(Redis::Integer(slot_traffic[i].calls));
+        output->append(Redis::BulkString("read-bytes"));
+        output->append(Redis::Integer(slot_traffic[i].read_bytes));
+        output->append(Redis::BulkString("write-bytes"));
+        output->append(Redis::Integer(slot_traffic[i].write_bytes));
+      }
     } else if (subcommand_ == "import") {
-      Status s = svr->cluster_->ImportSlot(conn, static_cast<int>(slot_), state_);
+      Status s = svr->cluster_->ImportSlot(conn, slots_, state_);
+      if (s.IsOK()) {
+        *output = Redis::SimpleString("OK");
+      } else {
+        *output = Redis::Error(s.Msg());
+      }
+    } else if (subcommand_ == "importsst") {
+      // Only the importing link of the source node can send the SST files
+      if (!conn->IsImporting()) {
+        *output = Redis::Error("The connection isn't importing");
+        return Status::OK();
+      }
+      Status s = svr->slot_import_->ImportSst(slots_, args_[3]);
       if (s.IsOK()) {
         *output = Redis::SimpleString("OK");
       } else {
@@ -5163,9 +7222,35 @@ class CommandCluster : public Commander {
   }
 
  private:
+  // CLUSTER SLOT-STATS ORDERBY metric [LIMIT limit] [ASC|DESC]
+  Status parseSlotStatsOrderBy(const std::vector<std::string> &args) {
+    static const std::set<std::string> metrics = {"key-count", "approximate-size", "calls", "read-bytes",
+                                                  "write-bytes"};
+    order_by_ = Util::ToLower(args[3]);
+    if (metrics.count(order_by_) == 0) return {Status::RedisParseErr, "Unknown metric of ORDERBY"};
+    for (size_t i = 4; i < args.size(); i++) {
+      auto option = Util::ToLower(args[i]);
+      if (option == "asc" || option == "desc") {
+        desc_ = option == "desc";
+      } else if (option == "limit" && i + 1 < args.size()) {
+        auto s = Util::DecimalStringToNum(args[++i], &limit_, static_cast<int64_t>(1),
+                                          static_cast<int64_t>(HASH_SLOTS_SIZE));
+        if (!s.IsOK()) return {Status::RedisParseErr, "Limit must be between 1 and 16384"};
+      } else {
+        return {Status::RedisParseErr, errInvalidSyntax};
+      }
+    }
+    return Status::OK();
+  }
+
   std::string subcommand_;
   int64_t slot_ = -1;
+  int64_t end_slot_ = -1;
+  SlotRange slots_;
   ImportStatus state_ = kImportNone;
+  std::string order_by_;
+  int64_t limit_ = 16;
+  bool desc_ = true;
 };
 
 class CommandClusterX : public Commander {
@@ -5177,11 +7262,11 @@ class CommandClusterX : public Commander {
 
     if (subcommand_ == "setnodeid" && args_.size() == 3 && args_[2].size() == kClusterNodeIdLen) return Status::OK();
 
+    // CLUSTERX MIGRATE $SLOT|$START_SLOT-$END_SLOT $DST_NODE_ID
     if (subcommand_ == "migrate") {
       if (args.size() != 4) return {Status::RedisParseErr, errWrongNumOfArguments};
 
-      auto s = Util::DecimalStringToNum(args[2], &slot_);
-      if (!s.IsOK()) return s;
+      if (!SlotRange::Parse(args[2], &slots_)) return {Status::RedisParseErr, "Slot is out of range"};
 
       dst_node_id_ = args[3];
       return Status::OK();
@@ -5207,16 +7292,9 @@ class CommandClusterX : public Commander {
       return {Status::RedisParseErr, "Invalid setnodes options"};
     }
 
-    // CLUSTERX SETSLOT $SLOT_ID NODE $NODE_ID $VERSION
+    // CLUSTERX SETSLOT $SLOT_ID|$START_SLOT-$END_SLOT NODE $NODE_ID $VERSION
     if (subcommand_ == "setslot" && args_.size() == 6) {
-      auto parse_id = ParseInt<int>(args[2].c_str(), 10);
-      if (!parse_id) {
-        return {Status::RedisParseErr, errValueNotInteger};
-      }
-
-      slot_id_ = *parse_id;
-
-      if (!Cluster::IsValidSlot(slot_id_)) {
+      if (!SlotRange::Parse(args[2], &slots_)) {
         return {Status::RedisParseErr, "Invalid slot id"};
       }
 
@@ -5269,7 +7347,7 @@ class CommandClusterX : public Commander {
         *output = Redis::Error(s.Msg());
       }
     } else if (subcommand_ == "setslot") {
-      Status s = svr->cluster_->SetSlot(slot_id_, args_[4], set_version_);
+      Status s = svr->cluster_->SetSlot(slots_, args_[4], set_version_);
       if (s.IsOK()) {
         *output = Redis::SimpleString("OK");
       } else {
@@ -5279,7 +7357,7 @@ class CommandClusterX : public Commander {
       int64_t v = svr->cluster_->GetVersion();
       *output = Redis::BulkString(std::to_string(v));
     } else if (subcommand_ == "migrate") {
-      Status s = svr->cluster_->MigrateSlot(static_cast<int>(slot_), dst_node_id_);
+      Status s = svr->cluster_->MigrateSlot(slots_, dst_node_id_);
       if (s.IsOK()) {
         *output = Redis::SimpleString("OK");
       } else {
@@ -5295,10 +7373,9 @@ class CommandClusterX : public Commander {
   std::string subcommand_;
   std::string nodes_str_;
   int64_t set_version_ = 0;
-  int slot_id_ = -1;
+  SlotRange slots_;
   bool force_ = false;
   std::string dst_node_id_;
-  int64_t slot_ = -1;
 };
 
 class CommandEval : public Commander {
@@ -5369,7 +7446,7 @@ class CommandScript : public Commander {
       }
     } else if (args_.size() == 3 && subcommand_ == "load") {
       std::string sha;
-      auto s = Lua::createFunction(svr, args_[2], &sha, svr->Lua());
+      auto s = svr->ScriptLoad(args_[2], &sha);
       if (!s.IsOK()) {
         return s;
       }
@@ -5400,6 +7477,22 @@ class CommandXAdd : public Commander {
         continue;
       }
 
+      if (val == "retention" && !entry_id_found) {
+        if (i + 1 >= args.size()) {
+          return {Status::RedisParseErr, errInvalidSyntax};
+        }
+
+        auto parse_result = ParseInt<uint64_t>(args[i + 1], 10);
+        if (!parse_result) {
+          return {Status::RedisParseErr, errValueNotInteger};
+        }
+
+        retention_ms_ = *parse_result;
+        with_retention_ = true;
+        i += 2;
+        continue;
+      }
+
       if (val == "maxlen" && !entry_id_found) {
         if (i + 1 >= args.size()) {
           return {Status::RedisParseErr, errInvalidSyntax};
@@ -5506,6 +7599,8 @@ class CommandXAdd : public Commander {
       options.with_entry_id = true;
       options.entry_id = entry_id_;
     }
+    options.with_retention = with_retention_;
+    options.retention_ms = retention_ms_;
 
     Redis::Stream stream_db(svr->storage_, conn->GetNamespace());
     StreamEntryID entry_id;
@@ -5529,6 +7624,7 @@ class CommandXAdd : public Commander {
  private:
   std::string stream_name_;
   uint64_t max_len_ = 0;
+  uint64_t retention_ms_ = 0;
   Redis::StreamEntryID min_id_;
   Redis::NewStreamEntryID entry_id_;
   std::vector<std::string> name_value_pairs_;
@@ -5536,6 +7632,7 @@ class CommandXAdd : public Commander {
   bool with_max_len_ = false;
   bool with_min_id_ = false;
   bool with_entry_id_ = false;
+  bool with_retention_ = false;
 };
 
 class CommandXDel : public Commander {
@@ -5605,6 +7702,12 @@ class CommandXInfo : public Commander {
 
         count_ = *parse_result;
       }
+    } else if (val == "groups") {
+      if (args.size() != 3) return {Status::RedisParseErr, errWrongNumOfArguments};
+      groups_ = true;
+    } else if (val == "consumers") {
+      if (args.size() != 4) return {Status::RedisParseErr, errWrongNumOfArguments};
+      consumers_ = true;
     }
     return Status::OK();
   }
@@ -5613,6 +7716,12 @@ class CommandXInfo : public Commander {
     if (stream_) {
       return getStreamInfo(svr, conn, output);
     }
+    if (groups_) {
+      return getGroupsInfo(svr, conn, output);
+    }
+    if (consumers_) {
+      return getConsumersInfo(svr, conn, output);
+    }
     return Status::OK();
   }
 
@@ -5620,6 +7729,60 @@ class CommandXInfo : public Commander {
   uint64_t count_ = 10;  // default Redis value
   bool stream_ = false;
   bool full_ = false;
+  bool groups_ = false;
+  bool consumers_ = false;
+
+  Status getGroupsInfo(Server *svr, Connection *conn, std::string *output) {
+    Redis::Stream stream_db(svr->storage_, conn->GetNamespace());
+    std::vector<std::pair<std::string, Redis::StreamGroupMetadata>> groups;
+    auto s = stream_db.GetGroups(args_[2], &groups);
+    if (s.IsNotFound()) {
+      return {Status::RedisExecErr, errNoSuchKey};
+    }
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    output->append(Redis::MultiLen(groups.size()));
+    for (const auto &group : groups) {
+      output->append(Redis::MultiLen(8));
+      output->append(Redis::BulkString("name"));
+      output->append(Redis::BulkString(group.first));
+      output->append(Redis::BulkString("consumers"));
+      output->append(Redis::Integer(group.second.consumers));
+      output->append(Redis::BulkString("pending"));
+      output->append(Redis::Integer(group.second.pending));
+      output->append(Redis::BulkString("last-delivered-id"));
+      output->append(Redis::BulkString(group.second.last_delivered_id.ToString()));
+    }
+    return Status::OK();
+  }
+
+  Status getConsumersInfo(Server *svr, Connection *conn, std::string *output) {
+    Redis::Stream stream_db(svr->storage_, conn->GetNamespace());
+    std::vector<std::pair<std::string, Redis::StreamConsumerMetadata>> consumers;
+    auto s = stream_db.GetConsumers(args_[2], args_[3], &consumers);
+    if (s.IsNotFound()) {
+      return {Status::RedisExecErr,
+              "NOGROUP No such consumer group '" + args_[3] + "' for key name '" + args_[2] + "'"};
+    }
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    uint64_t now = Util::GetTimeStampMS();
+    output->append(Redis::MultiLen(consumers.size()));
+    for (const auto &consumer : consumers) {
+      output->append(Redis::MultiLen(6));
+      output->append(Redis::BulkString("name"));
+      output->append(Redis::BulkString(consumer.first));
+      output->append(Redis::BulkString("pending"));
+      output->append(Redis::Integer(consumer.second.pending));
+      output->append(Redis::BulkString("idle"));
+      output->append(Redis::Integer(now > consumer.second.seen_time ? now - consumer.second.seen_time : 0));
+    }
+    return Status::OK();
+  }
 
   Status getStreamInfo(Server *svr, Connection *conn, std::string *output) {
     Redis::Stream stream_db(svr->storage_, conn->GetNamespace());
@@ -5972,90 +8135,671 @@ class CommandXRead : public Commander {
         return {Status::RedisExecErr, s.ToString()};
       }
 
-      if (result.size() > 0) {
-        results.emplace_back(streams_[i], result);
+      if (result.size() > 0) {
+        results.emplace_back(streams_[i], result);
+      }
+    }
+
+    if (block_ && results.empty()) {
+      if (conn->IsInExec()) {
+        *output = Redis::MultiLen(-1);
+        return Status::OK();  // No blocking in multi-exec
+      }
+
+      return blockingRead(svr, conn, &stream_db);
+    }
+
+    if (!block_ && results.empty()) {
+      *output = Redis::MultiLen(-1);
+      return Status::OK();
+    }
+
+    return sendResults(output, results);
+  }
+
+  Status sendResults(std::string *output, const std::vector<StreamReadResult> &results) {
+    output->append(Redis::MultiLen(results.size()));
+
+    for (const auto &result : results) {
+      output->append(Redis::MultiLen(2));
+      output->append(Redis::BulkString(result.name));
+      output->append(Redis::MultiLen(result.entries.size()));
+      for (const auto &entry : result.entries) {
+        output->append(Redis::MultiLen(2));
+        output->append(Redis::BulkString(entry.key));
+        output->append(Redis::MultiBulkString(entry.values));
+      }
+    }
+
+    return Status::OK();
+  }
+
+  Status blockingRead(Server *svr, Connection *conn, Redis::Stream *stream_db) {
+    if (!with_count_) {
+      with_count_ = true;
+      count_ = blocked_default_count_;
+    }
+
+    for (size_t i = 0; i < streams_.size(); ++i) {
+      if (latest_marks_[i]) {
+        StreamEntryID last_generated_id;
+        auto s = stream_db->GetLastGeneratedID(streams_[i], &last_generated_id);
+        if (!s.ok()) {
+          return {Status::RedisExecErr, s.ToString()};
+        }
+
+        ids_[i] = last_generated_id;
+      }
+    }
+
+    svr_ = svr;
+    conn_ = conn;
+
+    svr_->BlockOnStreams(streams_, ids_, conn_);
+
+    auto bev = conn->GetBufferEvent();
+    bufferevent_setcb(bev, nullptr, WriteCB, EventCB, this);
+
+    if (block_timeout_ > 0) {
+      timer_ = evtimer_new(bufferevent_get_base(bev), TimerCB, this);
+      timeval tm;
+      if (block_timeout_ > 1000) {
+        tm.tv_sec = block_timeout_ / 1000;
+        tm.tv_usec = (block_timeout_ % 1000) * 1000;
+      } else {
+        tm.tv_sec = 0;
+        tm.tv_usec = block_timeout_ * 1000;
+      }
+
+      evtimer_add(timer_, &tm);
+    }
+
+    return Status::OK();
+  }
+
+  static void WriteCB(bufferevent *bev, void *ctx) {
+    auto command = reinterpret_cast<CommandXRead *>(ctx);
+
+    if (command->timer_ != nullptr) {
+      event_free(command->timer_);
+      command->timer_ = nullptr;
+    }
+
+    command->unblockAll();
+    bufferevent_setcb(bev, Redis::Connection::OnRead, Redis::Connection::OnWrite, Redis::Connection::OnEvent,
+                      command->conn_);
+    bufferevent_enable(bev, EV_READ);
+
+    Redis::Stream stream_db(command->svr_->storage_, command->conn_->GetNamespace());
+
+    std::vector<StreamReadResult> results;
+
+    for (size_t i = 0; i < command->streams_.size(); ++i) {
+      Redis::StreamRangeOptions options;
+      options.reverse = false;
+      options.start = command->ids_[i];
+      options.end = StreamEntryID{UINT64_MAX, UINT64_MAX};
+      options.with_count = command->with_count_;
+      options.count = command->count_;
+      options.exclude_start = true;
+      options.exclude_end = false;
+
+      std::vector<StreamEntry> result;
+      auto s = stream_db.Range(command->streams_[i], options, &result);
+      if (!s.ok()) {
+        command->conn_->Reply(Redis::MultiLen(-1));
+        LOG(ERROR) << "ERR executing XRANGE for stream " << command->streams_[i] << " from "
+                   << command->ids_[i].ToString() << " to " << options.end.ToString() << " with count "
+                   << command->count_ << ": " << s.ToString();
+      }
+
+      if (result.size() > 0) {
+        results.emplace_back(command->streams_[i], result);
+      }
+    }
+
+    if (results.empty()) {
+      command->conn_->Reply(Redis::MultiLen(-1));
+    }
+
+    command->sendReply(results);
+  }
+
+  void sendReply(const std::vector<StreamReadResult> &results) {
+    std::string output;
+
+    output.append(Redis::MultiLen(results.size()));
+
+    for (const auto &result : results) {
+      output.append(Redis::MultiLen(2));
+      output.append(Redis::BulkString(result.name));
+      output.append(Redis::MultiLen(result.entries.size()));
+      for (const auto &entry : result.entries) {
+        output.append(Redis::MultiLen(2));
+        output.append(Redis::BulkString(entry.key));
+        output.append(Redis::MultiBulkString(entry.values));
+      }
+    }
+
+    conn_->Reply(output);
+  }
+
+  static void EventCB(bufferevent *bev, int16_t events, void *ctx) {
+    auto command = static_cast<CommandXRead *>(ctx);
+
+    if (events & (BEV_EVENT_EOF | BEV_EVENT_ERROR)) {
+      if (command->timer_ != nullptr) {
+        event_free(command->timer_);
+        command->timer_ = nullptr;
+      }
+      command->unblockAll();
+    }
+    Redis::Connection::OnEvent(bev, events, command->conn_);
+  }
+
+  static void TimerCB(int, int16_t events, void *ctx) {
+    auto command = reinterpret_cast<CommandXRead *>(ctx);
+
+    command->conn_->Reply(Redis::NilString());
+
+    event_free(command->timer_);
+    command->timer_ = nullptr;
+
+    command->unblockAll();
+
+    auto bev = command->conn_->GetBufferEvent();
+    bufferevent_setcb(bev, Redis::Connection::OnRead, Redis::Connection::OnWrite, Redis::Connection::OnEvent,
+                      command->conn_);
+    bufferevent_enable(bev, EV_READ);
+  }
+
+ private:
+  std::vector<std::string> streams_;
+  std::vector<StreamEntryID> ids_;
+  std::vector<bool> latest_marks_;
+  Server *svr_ = nullptr;
+  Connection *conn_ = nullptr;
+  event *timer_ = nullptr;
+  uint64_t count_ = 0;
+  int64_t block_timeout_ = 0;
+  int blocked_default_count_ = 1000;
+  bool with_count_ = false;
+  bool block_ = false;
+
+  void unblockAll() { svr_->UnblockOnStreams(streams_, conn_); }
+};
+
+class CommandXAck : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    for (size_t i = 3; i < args.size(); ++i) {
+      StreamEntryID id;
+      auto s = ParseStreamEntryID(args[i], &id);
+      if (!s.IsOK()) return s;
+      ids_.push_back(id);
+    }
+    return Status::OK();
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    Redis::Stream stream_db(svr->storage_, conn->GetNamespace());
+    uint64_t acknowledged = 0;
+    auto s = stream_db.Ack(args_[1], args_[2], ids_, &acknowledged);
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    *output = Redis::Integer(acknowledged);
+    return Status::OK();
+  }
+
+ private:
+  std::vector<StreamEntryID> ids_;
+};
+
+class CommandXAutoClaim : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    auto parse_idle = ParseInt<uint64_t>(args[4], 10);
+    if (!parse_idle) {
+      return {Status::RedisParseErr, "Invalid min-idle-time argument for XAUTOCLAIM"};
+    }
+    options_.min_idle_time = *parse_idle;
+
+    if (args[5] == "-") {
+      options_.start = StreamEntryID::Minimum();
+    } else {
+      auto s = ParseRangeStart(args[5], &options_.start);
+      if (!s.IsOK()) return s;
+    }
+
+    for (size_t i = 6; i < args.size(); ++i) {
+      auto arg = Util::ToLower(args[i]);
+      if (arg == "count" && i + 1 < args.size()) {
+        auto parse_count = ParseInt<uint64_t>(args[++i], 10);
+        if (!parse_count || *parse_count == 0) {
+          return {Status::RedisParseErr, "COUNT must be > 0"};
+        }
+        options_.count = *parse_count;
+      } else if (arg == "justid") {
+        options_.just_id = true;
+      } else {
+        return {Status::RedisParseErr, errInvalidSyntax};
+      }
+    }
+    return Status::OK();
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    Redis::Stream stream_db(svr->storage_, conn->GetNamespace());
+    StreamAutoClaimResult result;
+    auto s = stream_db.AutoClaim(args_[1], args_[2], args_[3], options_, &result);
+    if (s.IsNotFound()) {
+      return {Status::RedisExecErr, "NOGROUP No such key '" + args_[1] + "' or consumer group '" + args_[2] + "'"};
+    }
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    output->append(Redis::MultiLen(3));
+    output->append(Redis::BulkString(result.next_start.ToString()));
+    output->append(Redis::MultiLen(result.entries.size()));
+    for (const auto &entry : result.entries) {
+      if (options_.just_id) {
+        output->append(Redis::BulkString(entry.key));
+        continue;
+      }
+      output->append(Redis::MultiLen(2));
+      output->append(Redis::BulkString(entry.key));
+      output->append(Redis::MultiBulkString(entry.values));
+    }
+    output->append(Redis::MultiBulkString(result.deleted_ids));
+    return Status::OK();
+  }
+
+ private:
+  StreamAutoClaimOptions options_;
+};
+
+class CommandXClaim : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    auto parse_idle = ParseInt<uint64_t>(args[4], 10);
+    if (!parse_idle) {
+      return {Status::RedisParseErr, "Invalid min-idle-time argument for XCLAIM"};
+    }
+    options_.min_idle_time = *parse_idle;
+
+    size_t i = 5;
+    for (; i < args.size(); ++i) {
+      StreamEntryID id;
+      if (!ParseStreamEntryID(args[i], &id).IsOK()) break;
+      ids_.push_back(id);
+    }
+    if (ids_.empty()) {
+      return {Status::RedisParseErr, "Invalid stream ID specified as stream command argument"};
+    }
+
+    for (; i < args.size(); ++i) {
+      auto arg = Util::ToLower(args[i]);
+      bool has_value = i + 1 < args.size();
+      if ((arg == "idle" || arg == "time" || arg == "retrycount") && has_value) {
+        auto parse_result = ParseInt<uint64_t>(args[++i], 10);
+        if (!parse_result) {
+          return {Status::RedisParseErr, "Invalid " + arg + " option argument for XCLAIM"};
+        }
+        if (arg == "retrycount") {
+          options_.with_retry_count = true;
+          options_.retry_count = *parse_result;
+        } else {
+          with_idle_ = arg == "idle";
+          options_.with_delivery_time = true;
+          options_.delivery_time = *parse_result;
+        }
+      } else if (arg == "force") {
+        options_.force = true;
+      } else if (arg == "justid") {
+        options_.just_id = true;
+      } else if (arg == "lastid" && has_value) {
+        auto s = ParseStreamEntryID(args[++i], &options_.last_id);
+        if (!s.IsOK()) return s;
+        options_.with_last_id = true;
+      } else {
+        return {Status::RedisParseErr, "Unrecognized XCLAIM option '" + args[i] + "'"};
+      }
+    }
+    return Status::OK();
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    if (options_.with_delivery_time) {
+      uint64_t now = Util::GetTimeStampMS();
+      uint64_t delivery_time = options_.delivery_time;
+      if (with_idle_) delivery_time = delivery_time < now ? now - delivery_time : 0;
+      // the delivery time in the future makes no sense, so it's the same as now
+      options_.delivery_time = delivery_time > now ? now : delivery_time;
+    }
+
+    Redis::Stream stream_db(svr->storage_, conn->GetNamespace());
+    std::vector<StreamEntry> entries;
+    auto s = stream_db.Claim(args_[1], args_[2], args_[3], options_, ids_, &entries);
+    if (s.IsNotFound()) {
+      return {Status::RedisExecErr, "NOGROUP No such key '" + args_[1] + "' or consumer group '" + args_[2] + "'"};
+    }
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    output->append(Redis::MultiLen(entries.size()));
+    for (const auto &entry : entries) {
+      if (options_.just_id) {
+        output->append(Redis::BulkString(entry.key));
+        continue;
+      }
+      output->append(Redis::MultiLen(2));
+      output->append(Redis::BulkString(entry.key));
+      output->append(Redis::MultiBulkString(entry.values));
+    }
+    return Status::OK();
+  }
+
+ private:
+  StreamClaimOptions options_;
+  std::vector<StreamEntryID> ids_;
+  bool with_idle_ = false;
+};
+
+class CommandXGroup : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    subcommand_ = Util::ToLower(args[1]);
+    if (subcommand_ == "create") {
+      if (args.size() < 5 || args.size() > 6) return {Status::RedisParseErr, errWrongNumOfArguments};
+      if (args.size() == 6) {
+        if (Util::ToLower(args[5]) != "mkstream") return {Status::RedisParseErr, errInvalidSyntax};
+        create_options_.mkstream = true;
+      }
+      return parseLastID(args[4]);
+    }
+
+    if (subcommand_ == "setid") {
+      if (args.size() != 5) return {Status::RedisParseErr, errWrongNumOfArguments};
+      return parseLastID(args[4]);
+    }
+
+    if (subcommand_ == "destroy") {
+      if (args.size() != 4) return {Status::RedisParseErr, errWrongNumOfArguments};
+      return Status::OK();
+    }
+
+    if (subcommand_ == "createconsumer" || subcommand_ == "delconsumer") {
+      if (args.size() != 5) return {Status::RedisParseErr, errWrongNumOfArguments};
+      return Status::OK();
+    }
+
+    return {Status::RedisParseErr, "unknown subcommand '" + args[1] + "'"};
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    Redis::Stream stream_db(svr->storage_, conn->GetNamespace());
+    const auto &stream_name = args_[2];
+    const auto &group_name = args_[3];
+
+    rocksdb::Status s;
+    uint64_t ret = 0;
+    if (subcommand_ == "create") {
+      s = stream_db.CreateGroup(stream_name, group_name, create_options_);
+    } else if (subcommand_ == "setid") {
+      s = stream_db.SetGroupID(stream_name, group_name, create_options_.last_id, create_options_.latest);
+    } else if (subcommand_ == "destroy") {
+      s = stream_db.DestroyGroup(stream_name, group_name, &ret);
+    } else if (subcommand_ == "createconsumer") {
+      s = stream_db.CreateConsumer(stream_name, group_name, args_[4], &ret);
+    } else {
+      s = stream_db.DeleteConsumer(stream_name, group_name, args_[4], &ret);
+    }
+
+    if (s.IsNotFound()) {
+      RedisType type = kRedisNone;
+      if (subcommand_ == "create" || !stream_db.Type(stream_name, &type).ok() || type == kRedisNone) {
+        return {Status::RedisExecErr, errXGroupKeyNotExist};
+      }
+      return {Status::RedisExecErr, "NOGROUP No such consumer group '" + group_name + "' for key name '" +
+                                        stream_name + "'"};
+    }
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    if (subcommand_ == "create" || subcommand_ == "setid") {
+      *output = Redis::SimpleString("OK");
+    } else {
+      *output = Redis::Integer(ret);
+    }
+    return Status::OK();
+  }
+
+ private:
+  std::string subcommand_;
+  StreamCreateGroupOptions create_options_;
+
+  Status parseLastID(const std::string &input) {
+    if (input == "$") {
+      create_options_.latest = true;
+      return Status::OK();
+    }
+    return ParseStreamEntryID(input, &create_options_.last_id);
+  }
+};
+
+class CommandXPending : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    if (args.size() == 3) return Status::OK();
+
+    size_t i = 3;
+    if (Util::ToLower(args[i]) == "idle") {
+      if (i + 1 >= args.size()) return {Status::RedisParseErr, errInvalidSyntax};
+      auto parse_idle = ParseInt<uint64_t>(args[i + 1], 10);
+      if (!parse_idle) return {Status::RedisParseErr, errValueNotInteger};
+      options_.min_idle_time = *parse_idle;
+      i += 2;
+    }
+    if (args.size() != i + 3 && args.size() != i + 4) {
+      return {Status::RedisParseErr, errInvalidSyntax};
+    }
+
+    if (args[i] == "-") {
+      options_.start = StreamEntryID::Minimum();
+    } else {
+      auto s = ParseRangeStart(args[i], &options_.start);
+      if (!s.IsOK()) return s;
+    }
+    if (args[i + 1] == "+") {
+      options_.end = StreamEntryID::Maximum();
+    } else {
+      auto s = ParseRangeEnd(args[i + 1], &options_.end);
+      if (!s.IsOK()) return s;
+    }
+    auto parse_count = ParseInt<uint64_t>(args[i + 2], 10);
+    if (!parse_count) return {Status::RedisParseErr, errValueNotInteger};
+    options_.count = *parse_count;
+
+    if (args.size() == i + 4) {
+      options_.with_consumer = true;
+      options_.consumer = args[i + 3];
+    }
+    extended_ = true;
+    return Status::OK();
+  }
+
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
+    Redis::Stream stream_db(svr->storage_, conn->GetNamespace());
+    if (!extended_) {
+      StreamPendingSummary summary;
+      auto s = stream_db.GetPendingSummary(args_[1], args_[2], &summary);
+      if (s.IsNotFound()) {
+        return {Status::RedisExecErr, "NOGROUP No such key '" + args_[1] + "' or consumer group '" + args_[2] + "'"};
+      }
+      if (!s.ok()) {
+        return {Status::RedisExecErr, s.ToString()};
+      }
+
+      output->append(Redis::MultiLen(4));
+      output->append(Redis::Integer(summary.pending));
+      if (summary.pending == 0) {
+        output->append(Redis::NilString());
+        output->append(Redis::NilString());
+        output->append(Redis::MultiLen(-1));
+        return Status::OK();
+      }
+      output->append(Redis::BulkString(summary.first_id.ToString()));
+      output->append(Redis::BulkString(summary.last_id.ToString()));
+      output->append(Redis::MultiLen(summary.consumers.size()));
+      for (const auto &consumer : summary.consumers) {
+        output->append(Redis::MultiBulkString({consumer.first, std::to_string(consumer.second)}));
+      }
+      return Status::OK();
+    }
+
+    std::vector<StreamPendingEntry> entries;
+    auto s = stream_db.GetPendingEntries(args_[1], args_[2], options_, &entries);
+    if (s.IsNotFound()) {
+      return {Status::RedisExecErr, "NOGROUP No such key '" + args_[1] + "' or consumer group '" + args_[2] + "'"};
+    }
+    if (!s.ok()) {
+      return {Status::RedisExecErr, s.ToString()};
+    }
+
+    uint64_t now = Util::GetTimeStampMS();
+    output->append(Redis::MultiLen(entries.size()));
+    for (const auto &entry : entries) {
+      output->append(Redis::MultiLen(4));
+      output->append(Redis::BulkString(entry.id.ToString()));
+      output->append(Redis::BulkString(entry.consumer));
+      output->append(Redis::Integer(now > entry.delivery_time ? now - entry.delivery_time : 0));
+      output->append(Redis::Integer(entry.delivery_count));
+    }
+    return Status::OK();
+  }
+
+ private:
+  StreamPendingOptions options_;
+  bool extended_ = false;
+};
+
+class CommandXReadGroup : public Commander {
+ public:
+  Status Parse(const std::vector<std::string> &args) override {
+    if (Util::ToLower(args[1]) != "group") {
+      return {Status::RedisParseErr, errInvalidSyntax};
+    }
+    group_ = args[2];
+    consumer_ = args[3];
+
+    size_t streams_word_idx = 0;
+    for (size_t i = 4; i < args.size();) {
+      auto arg = Util::ToLower(args[i]);
+
+      if (arg == "streams") {
+        streams_word_idx = i;
+        break;
+      }
+
+      if (arg == "noack") {
+        noack_ = true;
+        ++i;
+        continue;
       }
-    }
 
-    if (block_ && results.empty()) {
-      if (conn->IsInExec()) {
-        *output = Redis::MultiLen(-1);
-        return Status::OK();  // No blocking in multi-exec
+      if (arg == "count" || arg == "block") {
+        if (i + 1 >= args.size()) {
+          return {Status::RedisParseErr, errInvalidSyntax};
+        }
+
+        auto parse_result = ParseInt<int64_t>(args[i + 1], 10);
+        if (!parse_result) {
+          return {Status::RedisParseErr, errValueNotInteger};
+        }
+
+        if (arg == "count") {
+          with_count_ = true;
+          count_ = *parse_result < 0 ? 0 : *parse_result;
+        } else {
+          if (*parse_result < 0) {
+            return {Status::RedisParseErr, errTimeoutIsNegative};
+          }
+          block_ = true;
+          block_timeout_ = *parse_result;
+        }
+        i += 2;
+        continue;
       }
 
-      return blockingRead(svr, conn, &stream_db);
+      return {Status::RedisParseErr, errInvalidSyntax};
     }
 
-    if (!block_ && results.empty()) {
-      *output = Redis::MultiLen(-1);
-      return Status::OK();
+    if (streams_word_idx == 0) {
+      return {Status::RedisParseErr, errInvalidSyntax};
     }
 
-    return sendResults(output, results);
-  }
-
-  Status sendResults(std::string *output, const std::vector<StreamReadResult> &results) {
-    output->append(Redis::MultiLen(results.size()));
+    if ((args.size() - streams_word_idx - 1) % 2 != 0 || args.size() == streams_word_idx + 1) {
+      return {Status::RedisParseErr, errUnbalancedStreamList};
+    }
 
-    for (const auto &result : results) {
-      output->append(Redis::MultiLen(2));
-      output->append(Redis::BulkString(result.name));
-      output->append(Redis::MultiLen(result.entries.size()));
-      for (const auto &entry : result.entries) {
-        output->append(Redis::MultiLen(2));
-        output->append(Redis::BulkString(entry.key));
-        output->append(Redis::MultiBulkString(entry.values));
+    size_t number_of_streams = (args.size() - streams_word_idx - 1) / 2;
+    for (size_t i = streams_word_idx + 1; i <= streams_word_idx + number_of_streams; ++i) {
+      streams_.push_back(args[i]);
+      const auto &id_str = args[i + number_of_streams];
+      bool new_entries = id_str == ">";
+      new_entries_marks_.push_back(new_entries);
+      StreamEntryID id;
+      if (!new_entries) {
+        auto s = ParseStreamEntryID(id_str, &id);
+        if (!s.IsOK()) return s;
       }
+      ids_.push_back(id);
     }
 
     return Status::OK();
   }
 
-  Status blockingRead(Server *svr, Connection *conn, Redis::Stream *stream_db) {
-    if (!with_count_) {
-      with_count_ = true;
-      count_ = blocked_default_count_;
-    }
-
-    for (size_t i = 0; i < streams_.size(); ++i) {
-      if (latest_marks_[i]) {
-        StreamEntryID last_generated_id;
-        auto s = stream_db->GetLastGeneratedID(streams_[i], &last_generated_id);
-        if (!s.ok()) {
-          return {Status::RedisExecErr, s.ToString()};
-        }
-
-        ids_[i] = last_generated_id;
-      }
-    }
-
+  Status Execute(Server *svr, Connection *conn, std::string *output) override {
     svr_ = svr;
     conn_ = conn;
 
-    svr_->BlockOnStreams(streams_, ids_, conn_);
-
-    auto bev = conn->GetBufferEvent();
-    bufferevent_setcb(bev, nullptr, WriteCB, EventCB, this);
+    std::vector<StreamReadResult> results;
+    auto s = readGroup(&results);
+    if (!s.IsOK()) return s;
 
-    if (block_timeout_ > 0) {
-      timer_ = evtimer_new(bufferevent_get_base(bev), TimerCB, this);
-      timeval tm;
-      if (block_timeout_ > 1000) {
-        tm.tv_sec = block_timeout_ / 1000;
-        tm.tv_usec = (block_timeout_ % 1000) * 1000;
-      } else {
-        tm.tv_sec = 0;
-        tm.tv_usec = block_timeout_ * 1000;
+    if (results.empty() && block_) {
+      if (conn->IsInExec()) {
+        *output = Redis::MultiLen(-1);
+        return Status::OK();  // No blocking in multi-exec
       }
 
-      evtimer_add(timer_, &tm);
+      return blockingRead();
     }
 
+    *output = resultsReply(results);
     return Status::OK();
   }
 
   static void WriteCB(bufferevent *bev, void *ctx) {
-    auto command = reinterpret_cast<CommandXRead *>(ctx);
+    auto command = reinterpret_cast<CommandXReadGroup *>(ctx);
+
+    std::vector<StreamReadResult> results;
+    auto s = command->readGroup(&results);
+    if (s.IsOK() && results.empty()) {
+      // The new entries may be delivered to another consumer in the same group before
+      // this one was waked up, so block again to wait for the next entries.
+      command->unblockAll();
+      s = command->blockOnStreams();
+      if (s.IsOK()) {
+        bufferevent_disable(bev, EV_WRITE);
+        return;
+      }
+    }
 
     if (command->timer_ != nullptr) {
       event_free(command->timer_);
@@ -6063,66 +8807,20 @@ class CommandXRead : public Commander {
     }
 
     command->unblockAll();
+    if (s.IsOK()) {
+      command->conn_->Reply(command->resultsReply(results));
+    } else {
+      command->conn_->Reply(Redis::Error("ERR " + s.Msg()));
+    }
+
     bufferevent_setcb(bev, Redis::Connection::OnRead, Redis::Connection::OnWrite, Redis::Connection::OnEvent,
                       command->conn_);
     bufferevent_enable(bev, EV_READ);
-
-    Redis::Stream stream_db(command->svr_->storage_, command->conn_->GetNamespace());
-
-    std::vector<StreamReadResult> results;
-
-    for (size_t i = 0; i < command->streams_.size(); ++i) {
-      Redis::StreamRangeOptions options;
-      options.reverse = false;
-      options.start = command->ids_[i];
-      options.end = StreamEntryID{UINT64_MAX, UINT64_MAX};
-      options.with_count = command->with_count_;
-      options.count = command->count_;
-      options.exclude_start = true;
-      options.exclude_end = false;
-
-      std::vector<StreamEntry> result;
-      auto s = stream_db.Range(command->streams_[i], options, &result);
-      if (!s.ok()) {
-        command->conn_->Reply(Redis::MultiLen(-1));
-        LOG(ERROR) << "ERR executing XRANGE for stream " << command->streams_[i] << " from "
-                   << command->ids_[i].ToString() << " to " << options.end.ToString() << " with count "
-                   << command->count_ << ": " << s.ToString();
-      }
-
-      if (result.size() > 0) {
-        results.emplace_back(command->streams_[i], result);
-      }
-    }
-
-    if (results.empty()) {
-      command->conn_->Reply(Redis::MultiLen(-1));
-    }
-
-    command->sendReply(results);
-  }
-
-  void sendReply(const std::vector<StreamReadResult> &results) {
-    std::string output;
-
-    output.append(Redis::MultiLen(results.size()));
-
-    for (const auto &result : results) {
-      output.append(Redis::MultiLen(2));
-      output.append(Redis::BulkString(result.name));
-      output.append(Redis::MultiLen(result.entries.size()));
-      for (const auto &entry : result.entries) {
-        output.append(Redis::MultiLen(2));
-        output.append(Redis::BulkString(entry.key));
-        output.append(Redis::MultiBulkString(entry.values));
-      }
-    }
-
-    conn_->Reply(output);
+    bufferevent_trigger(bev, EV_READ, BEV_TRIG_IGNORE_WATERMARKS);
   }
 
   static void EventCB(bufferevent *bev, int16_t events, void *ctx) {
-    auto command = static_cast<CommandXRead *>(ctx);
+    auto command = static_cast<CommandXReadGroup *>(ctx);
 
     if (events & (BEV_EVENT_EOF | BEV_EVENT_ERROR)) {
       if (command->timer_ != nullptr) {
@@ -6135,9 +8833,9 @@ class CommandXRead : public Commander {
   }
 
   static void TimerCB(int, int16_t events, void *ctx) {
-    auto command = reinterpret_cast<CommandXRead *>(ctx);
+    auto command = reinterpret_cast<CommandXReadGroup *>(ctx);
 
-    command->conn_->Reply(Redis::NilString());
+    command->conn_->Reply(Redis::MultiLen(-1));
 
     event_free(command->timer_);
     command->timer_ = nullptr;
@@ -6151,19 +8849,110 @@ class CommandXRead : public Commander {
   }
 
  private:
+  std::string group_;
+  std::string consumer_;
   std::vector<std::string> streams_;
   std::vector<StreamEntryID> ids_;
-  std::vector<bool> latest_marks_;
+  std::vector<bool> new_entries_marks_;
   Server *svr_ = nullptr;
   Connection *conn_ = nullptr;
   event *timer_ = nullptr;
   uint64_t count_ = 0;
   int64_t block_timeout_ = 0;
-  int blocked_default_count_ = 1000;
   bool with_count_ = false;
   bool block_ = false;
+  bool noack_ = false;
+  bool blocked_ = false;
 
-  void unblockAll() { svr_->UnblockOnStreams(streams_, conn_); }
+  Status readGroup(std::vector<StreamReadResult> *results) {
+    Redis::Stream stream_db(svr_->storage_, conn_->GetNamespace());
+
+    for (size_t i = 0; i < streams_.size(); ++i) {
+      Redis::StreamReadGroupOptions options;
+      options.group = group_;
+      options.consumer = consumer_;
+      options.new_entries = new_entries_marks_[i];
+      options.start = ids_[i];
+      options.with_count = with_count_;
+      options.count = count_;
+      options.noack = noack_;
+
+      std::vector<StreamEntry> entries;
+      auto s = stream_db.ReadGroup(streams_[i], options, &entries);
+      if (s.IsNotFound()) {
+        return {Status::RedisExecErr, "NOGROUP No such key '" + streams_[i] + "' or consumer group '" + group_ +
+                                          "' in XREADGROUP with GROUP option"};
+      }
+      if (!s.ok()) {
+        return {Status::RedisExecErr, s.ToString()};
+      }
+
+      // the history of the consumer is always replied even if it's empty
+      if (!entries.empty() || !new_entries_marks_[i]) {
+        results->emplace_back(streams_[i], std::move(entries));
+      }
+    }
+    return Status::OK();
+  }
+
+  std::string resultsReply(const std::vector<StreamReadResult> &results) const {
+    if (results.empty()) return Redis::MultiLen(-1);
+
+    std::string output = Redis::MultiLen(results.size());
+    for (const auto &result : results) {
+      output.append(Redis::MultiLen(2));
+      output.append(Redis::BulkString(result.name));
+      output.append(Redis::MultiLen(result.entries.size()));
+      for (const auto &entry : result.entries) {
+        output.append(Redis::MultiLen(2));
+        output.append(Redis::BulkString(entry.key));
+        // the pending entry which was deleted from the stream has no values
+        output.append(entry.values.empty() ? Redis::MultiLen(-1) : Redis::MultiBulkString(entry.values));
+      }
+    }
+    return output;
+  }
+
+  Status blockOnStreams() {
+    Redis::Stream stream_db(svr_->storage_, conn_->GetNamespace());
+
+    // any entry added after the last generated ID is the new one for the group
+    std::vector<StreamEntryID> last_ids(streams_.size());
+    for (size_t i = 0; i < streams_.size(); ++i) {
+      auto s = stream_db.GetLastGeneratedID(streams_[i], &last_ids[i]);
+      if (!s.ok()) {
+        return {Status::RedisExecErr, s.ToString()};
+      }
+    }
+
+    svr_->BlockOnStreams(streams_, last_ids, conn_);
+    blocked_ = true;
+    return Status::OK();
+  }
+
+  Status blockingRead() {
+    auto s = blockOnStreams();
+    if (!s.IsOK()) return s;
+
+    auto bev = conn_->GetBufferEvent();
+    bufferevent_setcb(bev, nullptr, WriteCB, EventCB, this);
+
+    if (block_timeout_ > 0) {
+      timer_ = evtimer_new(bufferevent_get_base(bev), TimerCB, this);
+      timeval tm;
+      tm.tv_sec = block_timeout_ / 1000;
+      tm.tv_usec = (block_timeout_ % 1000) * 1000;
+      evtimer_add(timer_, &tm);
+    }
+
+    return {Status::BlockingCmd};
+  }
+
+  void unblockAll() {
+    if (!blocked_) return;
+    svr_->UnblockOnStreams(streams_, conn_);
+    blocked_ = false;
+  }
 };
 
 class CommandXTrim : public Commander {
@@ -6267,14 +9056,18 @@ REDIS_REGISTER_COMMANDS(
     MakeCmdAttr<CommandRole>("role", 1, "read-only ok-loading", 0, 0, 0),
     MakeCmdAttr<CommandConfig>("config", -2, "read-only", 0, 0, 0),
     MakeCmdAttr<CommandNamespace>("namespace", -3, "read-only", 0, 0, 0),
-    MakeCmdAttr<CommandKeys>("keys", 2, "read-only", 0, 0, 0),
-    MakeCmdAttr<CommandFlushDB>("flushdb", 1, "write", 0, 0, 0),
-    MakeCmdAttr<CommandFlushAll>("flushall", 1, "write", 0, 0, 0),
+    MakeCmdAttr<CommandKeys>("keys", 2, "read-only slow", 0, 0, 0),
+    MakeCmdAttr<CommandFlushDB>("flushdb", -1, "write", 0, 0, 0),
+    MakeCmdAttr<CommandFlushAll>("flushall", -1, "write", 0, 0, 0),
     MakeCmdAttr<CommandDBSize>("dbsize", -1, "read-only", 0, 0, 0),
     MakeCmdAttr<CommandSlowlog>("slowlog", -2, "read-only", 0, 0, 0),
+    MakeCmdAttr<CommandHotKeys>("hotkeys", -1, "read-only", 0, 0, 0),
+    MakeCmdAttr<CommandBigKeys>("bigkeys", -1, "read-only", 0, 0, 0),
+    MakeCmdAttr<CommandLatency>("latency", -2, "read-only", 0, 0, 0),
+    MakeCmdAttr<CommandMemory>("memory", -2, "read-only", 0, 0, 0),
     MakeCmdAttr<CommandPerfLog>("perflog", -2, "read-only", 0, 0, 0),
     MakeCmdAttr<CommandClient>("client", -2, "read-only", 0, 0, 0),
-    MakeCmdAttr<CommandMonitor>("monitor", 1, "read-only no-multi", 0, 0, 0),
+    MakeCmdAttr<CommandMonitor>("monitor", -1, "read-only no-multi", 0, 0, 0),
     MakeCmdAttr<CommandShutdown>("shutdown", 1, "read-only", 0, 0, 0),
     MakeCmdAttr<CommandQuit>("quit", 1, "read-only", 0, 0, 0),
     MakeCmdAttr<CommandScan>("scan", -2, "read-only", 0, 0, 0),
@@ -6295,6 +9088,8 @@ REDIS_REGISTER_COMMANDS(
     MakeCmdAttr<CommandExpireAt>("expireat", 3, "write", 1, 1, 1),
     MakeCmdAttr<CommandPExpireAt>("pexpireat", 3, "write", 1, 1, 1),
     MakeCmdAttr<CommandDel>("del", -2, "write", 1, -1, 1), MakeCmdAttr<CommandDel>("unlink", -2, "write", 1, -1, 1),
+    MakeCmdAttr<CommandDump>("dump", 2, "read-only", 1, 1, 1),
+    MakeCmdAttr<CommandRestore>("restore", -4, "write", 1, 1, 1),
 
     MakeCmdAttr<CommandGet>("get", 2, "read-only", 1, 1, 1), MakeCmdAttr<CommandGetEx>("getex", -2, "write", 1, 1, 1),
     MakeCmdAttr<CommandStrlen>("strlen", 2, "read-only", 1, 1, 1),
@@ -6307,9 +9102,9 @@ REDIS_REGISTER_COMMANDS(
     MakeCmdAttr<CommandSetEX>("setex", 4, "write", 1, 1, 1), MakeCmdAttr<CommandPSetEX>("psetex", 4, "write", 1, 1, 1),
     MakeCmdAttr<CommandSetNX>("setnx", 3, "write", 1, 1, 1),
     MakeCmdAttr<CommandMSetNX>("msetnx", -3, "write exclusive", 1, -1, 2),
-    MakeCmdAttr<CommandMSet>("mset", -3, "write", 1, -1, 2), MakeCmdAttr<CommandIncrBy>("incrby", 3, "write", 1, 1, 1),
+    MakeCmdAttr<CommandMSet>("mset", -3, "write", 1, -1, 2), MakeCmdAttr<CommandIncrBy>("incrby", -3, "write", 1, 1, 1),
     MakeCmdAttr<CommandIncrByFloat>("incrbyfloat", 3, "write", 1, 1, 1),
-    MakeCmdAttr<CommandIncr>("incr", 2, "write", 1, 1, 1), MakeCmdAttr<CommandDecrBy>("decrby", 3, "write", 1, 1, 1),
+    MakeCmdAttr<CommandIncr>("incr", 2, "write", 1, 1, 1), MakeCmdAttr<CommandDecrBy>("decrby", -3, "write", 1, 1, 1),
     MakeCmdAttr<CommandDecr>("decr", 2, "write", 1, 1, 1), MakeCmdAttr<CommandCAS>("cas", -4, "write", 1, 1, 1),
     MakeCmdAttr<CommandCAD>("cad", 3, "write", 1, 1, 1),
 
@@ -6318,6 +9113,8 @@ REDIS_REGISTER_COMMANDS(
     MakeCmdAttr<CommandBitCount>("bitcount", -2, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandBitPos>("bitpos", -3, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandBitOp>("bitop", -4, "write", 2, -1, 1),
+    MakeCmdAttr<CommandBitfield>("bitfield", -2, "write", 1, 1, 1),
+    MakeCmdAttr<CommandBitfieldRO>("bitfield_ro", -2, "read-only", 1, 1, 1),
 
     MakeCmdAttr<CommandHGet>("hget", 3, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandHIncrBy>("hincrby", 4, "write", 1, 1, 1),
@@ -6329,11 +9126,12 @@ REDIS_REGISTER_COMMANDS(
     MakeCmdAttr<CommandHLen>("hlen", 2, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandHMGet>("hmget", -3, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandHMSet>("hmset", -4, "write", 1, 1, 1),
-    MakeCmdAttr<CommandHKeys>("hkeys", 2, "read-only", 1, 1, 1),
-    MakeCmdAttr<CommandHVals>("hvals", 2, "read-only", 1, 1, 1),
-    MakeCmdAttr<CommandHGetAll>("hgetall", 2, "read-only", 1, 1, 1),
+    MakeCmdAttr<CommandHKeys>("hkeys", 2, "read-only slow", 1, 1, 1),
+    MakeCmdAttr<CommandHVals>("hvals", 2, "read-only slow", 1, 1, 1),
+    MakeCmdAttr<CommandHGetAll>("hgetall", 2, "read-only slow", 1, 1, 1),
     MakeCmdAttr<CommandHScan>("hscan", -3, "read-only", 1, 1, 1),
-    MakeCmdAttr<CommandHRange>("hrange", -4, "read-only", 1, 1, 1),
+    MakeCmdAttr<CommandHRandField>("hrandfield", -2, "read-only", 1, 1, 1),
+    MakeCmdAttr<CommandHRange>("hrange", -4, "read-only slow", 1, 1, 1),
 
     MakeCmdAttr<CommandLPush>("lpush", -3, "write", 1, 1, 1), MakeCmdAttr<CommandRPush>("rpush", -3, "write", 1, 1, 1),
     MakeCmdAttr<CommandLPushX>("lpushx", -3, "write", 1, 1, 1),
@@ -6341,8 +9139,10 @@ REDIS_REGISTER_COMMANDS(
     MakeCmdAttr<CommandRPop>("rpop", -2, "write", 1, 1, 1),
     MakeCmdAttr<CommandBLPop>("blpop", -3, "write no-script", 1, -2, 1),
     MakeCmdAttr<CommandBRPop>("brpop", -3, "write no-script", 1, -2, 1),
+    MakeCmdAttr<CommandLMPop>("lmpop", -4, "write", 2, 2, 1),
+    MakeCmdAttr<CommandBLMPop>("blmpop", -5, "write no-script", 3, 3, 1),
     MakeCmdAttr<CommandLRem>("lrem", 4, "write", 1, 1, 1), MakeCmdAttr<CommandLInsert>("linsert", 5, "write", 1, 1, 1),
-    MakeCmdAttr<CommandLRange>("lrange", 4, "read-only", 1, 1, 1),
+    MakeCmdAttr<CommandLRange>("lrange", 4, "read-only slow", 1, 1, 1),
     MakeCmdAttr<CommandLIndex>("lindex", 3, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandLTrim>("ltrim", 4, "write", 1, 1, 1), MakeCmdAttr<CommandLLen>("llen", 2, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandLSet>("lset", 4, "write", 1, 1, 1),
@@ -6351,15 +9151,16 @@ REDIS_REGISTER_COMMANDS(
 
     MakeCmdAttr<CommandSAdd>("sadd", -3, "write", 1, 1, 1), MakeCmdAttr<CommandSRem>("srem", -3, "write", 1, 1, 1),
     MakeCmdAttr<CommandSCard>("scard", 2, "read-only", 1, 1, 1),
-    MakeCmdAttr<CommandSMembers>("smembers", 2, "read-only", 1, 1, 1),
+    MakeCmdAttr<CommandSMembers>("smembers", 2, "read-only slow", 1, 1, 1),
     MakeCmdAttr<CommandSIsMember>("sismember", 3, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandSMIsMember>("smismember", -3, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandSPop>("spop", -2, "write", 1, 1, 1),
     MakeCmdAttr<CommandSRandMember>("srandmember", -2, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandSMove>("smove", 4, "write", 1, 2, 1),
-    MakeCmdAttr<CommandSDiff>("sdiff", -2, "read-only", 1, -1, 1),
-    MakeCmdAttr<CommandSUnion>("sunion", -2, "read-only", 1, -1, 1),
-    MakeCmdAttr<CommandSInter>("sinter", -2, "read-only", 1, -1, 1),
+    MakeCmdAttr<CommandSDiff>("sdiff", -2, "read-only slow", 1, -1, 1),
+    MakeCmdAttr<CommandSUnion>("sunion", -2, "read-only slow", 1, -1, 1),
+    MakeCmdAttr<CommandSInter>("sinter", -2, "read-only slow", 1, -1, 1),
+    MakeCmdAttr<CommandSInterCard>("sintercard", -3, "read-only slow", 2, 2, 1),
     MakeCmdAttr<CommandSDiffStore>("sdiffstore", -3, "write", 1, -1, 1),
     MakeCmdAttr<CommandSUnionStore>("sunionstore", -3, "write", 1, -1, 1),
     MakeCmdAttr<CommandSInterStore>("sinterstore", -3, "write", 1, -1, 1),
@@ -6369,24 +9170,30 @@ REDIS_REGISTER_COMMANDS(
     MakeCmdAttr<CommandZCount>("zcount", 4, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandZIncrBy>("zincrby", 4, "write", 1, 1, 1),
     MakeCmdAttr<CommandZInterStore>("zinterstore", -4, "write", 1, 1, 1),
+    MakeCmdAttr<CommandZInter>("zinter", -3, "read-only slow", 2, 2, 1),
+    MakeCmdAttr<CommandZInterCard>("zintercard", -3, "read-only slow", 2, 2, 1),
     MakeCmdAttr<CommandZLexCount>("zlexcount", 4, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandZPopMax>("zpopmax", -2, "write", 1, 1, 1),
     MakeCmdAttr<CommandZPopMin>("zpopmin", -2, "write", 1, 1, 1),
-    MakeCmdAttr<CommandZRange>("zrange", -4, "read-only", 1, 1, 1),
-    MakeCmdAttr<CommandZRevRange>("zrevrange", -4, "read-only", 1, 1, 1),
-    MakeCmdAttr<CommandZRangeByLex>("zrangebylex", -4, "read-only", 1, 1, 1),
-    MakeCmdAttr<CommandZRevRangeByLex>("zrevrangebylex", -4, "read-only", 1, 1, 1),
-    MakeCmdAttr<CommandZRangeByScore>("zrangebyscore", -4, "read-only", 1, 1, 1),
+    MakeCmdAttr<CommandZMPop>("zmpop", -4, "write", 2, 2, 1),
+    MakeCmdAttr<CommandBZMPop>("bzmpop", -5, "write no-script", 3, 3, 1),
+    MakeCmdAttr<CommandZRange>("zrange", -4, "read-only slow", 1, 1, 1),
+    MakeCmdAttr<CommandZRevRange>("zrevrange", -4, "read-only slow", 1, 1, 1),
+    MakeCmdAttr<CommandZRangeByLex>("zrangebylex", -4, "read-only slow", 1, 1, 1),
+    MakeCmdAttr<CommandZRevRangeByLex>("zrevrangebylex", -4, "read-only slow", 1, 1, 1),
+    MakeCmdAttr<CommandZRangeByScore>("zrangebyscore", -4, "read-only slow", 1, 1, 1),
     MakeCmdAttr<CommandZRank>("zrank", 3, "read-only", 1, 1, 1), MakeCmdAttr<CommandZRem>("zrem", -3, "write", 1, 1, 1),
     MakeCmdAttr<CommandZRemRangeByRank>("zremrangebyrank", 4, "write", 1, 1, 1),
     MakeCmdAttr<CommandZRemRangeByScore>("zremrangebyscore", -4, "write", 1, 1, 1),
     MakeCmdAttr<CommandZRemRangeByLex>("zremrangebylex", 4, "write", 1, 1, 1),
-    MakeCmdAttr<CommandZRevRangeByScore>("zrevrangebyscore", -4, "read-only", 1, 1, 1),
+    MakeCmdAttr<CommandZRevRangeByScore>("zrevrangebyscore", -4, "read-only slow", 1, 1, 1),
     MakeCmdAttr<CommandZRevRank>("zrevrank", 3, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandZScore>("zscore", 3, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandZMScore>("zmscore", -3, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandZScan>("zscan", -3, "read-only", 1, 1, 1),
+    MakeCmdAttr<CommandZRandMember>("zrandmember", -2, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandZUnionStore>("zunionstore", -4, "write", 1, 1, 1),
+    MakeCmdAttr<CommandZUnion>("zunion", -3, "read-only slow", 2, 2, 1),
 
     MakeCmdAttr<CommandGeoAdd>("geoadd", -5, "write", 1, 1, 1),
     MakeCmdAttr<CommandGeoDist>("geodist", -4, "read-only", 1, 1, 1),
@@ -6396,6 +9203,18 @@ REDIS_REGISTER_COMMANDS(
     MakeCmdAttr<CommandGeoRadiusByMember>("georadiusbymember", -5, "write", 1, 1, 1),
     MakeCmdAttr<CommandGeoRadiusReadonly>("georadius_ro", -6, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandGeoRadiusByMemberReadonly>("georadiusbymember_ro", -5, "read-only", 1, 1, 1),
+    MakeCmdAttr<CommandGeoSearch>("geosearch", -7, "read-only", 1, 1, 1),
+
+    MakeCmdAttr<CommandPFAdd>("pfadd", -2, "write", 1, 1, 1),
+    MakeCmdAttr<CommandPFCount>("pfcount", -2, "read-only", 1, -1, 1),
+    MakeCmdAttr<CommandPFMerge>("pfmerge", -2, "write", 1, -1, 1),
+
+    MakeCmdAttr<CommandBFReserve>("bf.reserve", -4, "write", 1, 1, 1),
+    MakeCmdAttr<CommandBFAdd>("bf.add", 3, "write", 1, 1, 1),
+    MakeCmdAttr<CommandBFMAdd>("bf.madd", -3, "write", 1, 1, 1),
+    MakeCmdAttr<CommandBFExists>("bf.exists", 3, "read-only", 1, 1, 1),
+    MakeCmdAttr<CommandBFMExists>("bf.mexists", -3, "read-only", 1, 1, 1),
+    MakeCmdAttr<CommandBFInfo>("bf.info", 2, "read-only", 1, 1, 1),
 
     MakeCmdAttr<CommandPublish>("publish", 3, "read-only pub-sub", 0, 0, 0),
     MakeCmdAttr<CommandSubscribe>("subscribe", -2, "read-only pub-sub no-multi no-script", 0, 0, 0),
@@ -6403,9 +9222,14 @@ REDIS_REGISTER_COMMANDS(
     MakeCmdAttr<CommandPSubscribe>("psubscribe", -2, "read-only pub-sub no-multi no-script", 0, 0, 0),
     MakeCmdAttr<CommandPUnSubscribe>("punsubscribe", -1, "read-only pub-sub no-multi no-script", 0, 0, 0),
     MakeCmdAttr<CommandPubSub>("pubsub", -2, "read-only pub-sub no-script", 0, 0, 0),
+    MakeCmdAttr<CommandSPublish>("spublish", 3, "read-only pub-sub", 1, 1, 1),
+    MakeCmdAttr<CommandSSubscribe>("ssubscribe", -2, "read-only pub-sub no-multi no-script", 1, -1, 1),
+    MakeCmdAttr<CommandSUnSubscribe>("sunsubscribe", -1, "read-only pub-sub no-multi no-script", 1, -1, 1),
 
     MakeCmdAttr<CommandMulti>("multi", 1, "multi", 0, 0, 0),
     MakeCmdAttr<CommandDiscard>("discard", 1, "multi", 0, 0, 0),
+    MakeCmdAttr<CommandWatch>("watch", -2, "multi", 1, -1, 1),
+    MakeCmdAttr<CommandUnwatch>("unwatch", 1, "multi", 0, 0, 0),
     MakeCmdAttr<CommandExec>("exec", 1, "exclusive multi", 0, 0, 0),
 
     MakeCmdAttr<CommandSortedintAdd>("siadd", -3, "write", 1, 1, 1),
@@ -6429,29 +9253,140 @@ REDIS_REGISTER_COMMANDS(
     MakeCmdAttr<CommandCompact>("compact", 1, "read-only no-script", 0, 0, 0),
     MakeCmdAttr<CommandBGSave>("bgsave", 1, "read-only no-script", 0, 0, 0),
     MakeCmdAttr<CommandFlushBackup>("flushbackup", 1, "read-only no-script", 0, 0, 0),
-    MakeCmdAttr<CommandSlaveOf>("slaveof", 3, "read-only exclusive no-script", 0, 0, 0),
+    MakeCmdAttr<CommandBulkLoad>("bulkload", -3, "write exclusive no-multi no-script", 0, 0, 0),
+    MakeCmdAttr<CommandSlaveOf>("slaveof", -3, "read-only exclusive no-script", 0, 0, 0),
     MakeCmdAttr<CommandStats>("stats", 1, "read-only", 0, 0, 0),
 
+    MakeCmdAttr<CommandWait>("wait", 3, "read-only no-script", 0, 0, 0),
+    MakeCmdAttr<CommandReadOnly>("readonly", -1, "read-only ok-loading", 0, 0, 0),
+    MakeCmdAttr<CommandReadWrite>("readwrite", 1, "read-only ok-loading", 0, 0, 0),
     MakeCmdAttr<CommandReplConf>("replconf", -3, "read-only replication no-script", 0, 0, 0),
     MakeCmdAttr<CommandPSync>("psync", -2, "read-only replication no-multi no-script", 0, 0, 0),
+    MakeCmdAttr<CommandCDC>("cdc", -2, "read-only no-multi no-script", 0, 0, 0),
     MakeCmdAttr<CommandFetchMeta>("_fetch_meta", 1, "read-only replication no-multi no-script", 0, 0, 0),
-    MakeCmdAttr<CommandFetchFile>("_fetch_file", 2, "read-only replication no-multi no-script", 0, 0, 0),
+    MakeCmdAttr<CommandFetchFile>("_fetch_file", -2, "read-only replication no-multi no-script", 0, 0, 0),
     MakeCmdAttr<CommandDBName>("_db_name", 1, "read-only replication no-multi", 0, 0, 0),
 
-    MakeCmdAttr<CommandXAdd>("xadd", -5, "write", 1, 1, 1), MakeCmdAttr<CommandXDel>("xdel", -3, "write", 1, 1, 1),
+    MakeCmdAttr<CommandXAck>("xack", -4, "write", 1, 1, 1),
+    MakeCmdAttr<CommandXAdd>("xadd", -5, "write", 1, 1, 1),
+    MakeCmdAttr<CommandXAutoClaim>("xautoclaim", -6, "write", 1, 1, 1),
+    MakeCmdAttr<CommandXClaim>("xclaim", -6, "write", 1, 1, 1),
+    MakeCmdAttr<CommandXDel>("xdel", -3, "write", 1, 1, 1),
+    MakeCmdAttr<CommandXGroup>("xgroup", -4, "write", 2, 2, 1),
     MakeCmdAttr<CommandXLen>("xlen", 2, "read-only", 1, 1, 1),
+    MakeCmdAttr<CommandXPending>("xpending", -3, "read-only", 1, 1, 1),
     MakeCmdAttr<CommandXInfo>("xinfo", -2, "read-only", 0, 0, 0),
-    MakeCmdAttr<CommandXRange>("xrange", -4, "read-only", 1, 1, 1),
-    MakeCmdAttr<CommandXRevRange>("xrevrange", -2, "read-only", 0, 0, 0),
+    MakeCmdAttr<CommandXRange>("xrange", -4, "read-only slow", 1, 1, 1),
+    MakeCmdAttr<CommandXRevRange>("xrevrange", -2, "read-only slow", 0, 0, 0),
     MakeCmdAttr<CommandXRead>("xread", -4, "read-only", 0, 0, 0),
+    MakeCmdAttr<CommandXReadGroup>("xreadgroup", -7, "write", 0, 0, 0),
     MakeCmdAttr<CommandXTrim>("xtrim", -4, "write", 1, 1, 1));
 
+namespace {
+
+// Commanders are created and destroyed for every command, so their memory is
+// recycled by the thread local free lists, which are grouped by the size of commanders.
+class CommanderFreeList {
+ public:
+  static constexpr size_t kSizeAlignment = 16;
+  static constexpr size_t kMaxPooledSize = 1024;
+  static constexpr size_t kMaxPooledPerSize = 64;
+
+  CommanderFreeList() = default;
+  ~CommanderFreeList() {
+    destroyed = true;
+    for (auto &list : lists_) {
+      for (auto ptr : list) ::operator delete(ptr);
+    }
+  }
+
+  CommanderFreeList(const CommanderFreeList &) = delete;
+  CommanderFreeList &operator=(const CommanderFreeList &) = delete;
+
+  void *Allocate(size_t size) {
+    if (size == 0 || size > kMaxPooledSize) return ::operator new(size);
+    auto &list = lists_[(size - 1) / kSizeAlignment];
+    if (list.empty()) return ::operator new(alignedSize(size));
+    auto ptr = list.back();
+    list.pop_back();
+    return ptr;
+  }
+
+  void Free(void *ptr, size_t size) {
+    if (size == 0 || size > kMaxPooledSize) return ::operator delete(ptr);
+    auto &list = lists_[(size - 1) / kSizeAlignment];
+    if (list.size() >= kMaxPooledPerSize) return ::operator delete(ptr);
+    list.emplace_back(ptr);
+  }
+
+  // the commanders may be freed after the free list was destroyed while the thread is exiting
+  static thread_local bool destroyed;
+
+ private:
+  static size_t alignedSize(size_t size) { return (size + kSizeAlignment - 1) / kSizeAlignment * kSizeAlignment; }
+
+  std::array<std::vector<void *>, kMaxPooledSize / kSizeAlignment> lists_;
+};
+
+thread_local bool CommanderFreeList::destroyed = false;
+thread_local CommanderFreeList commander_free_list;
+
+}  // namespace
+
+void *Commander::operator new(size_t size) { return commander_free_list.Allocate(size); }
+
+void Commander::operator delete(void *ptr, size_t size) {
+  if (CommanderFreeList::destroyed) return ::operator delete(ptr);
+  commander_free_list.Free(ptr, size);
+}
+
 RegisterToCommandTable::RegisterToCommandTable(std::initializer_list<CommandAttributes> list) {
   for (const auto &attr : list) {
     command_details::redis_command_table.emplace_back(attr);
+    command_details::redis_command_table.back().id = command_details::redis_command_table.size() - 1;
     command_details::original_commands[attr.name] = &command_details::redis_command_table.back();
     command_details::commands[attr.name] = &command_details::redis_command_table.back();
   }
+  RefreshCommandLookup();
+}
+
+static char toLowerASCII(char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c | 0x20) : c; }
+
+uint64_t CommandLookupTable::hash(std::string_view name) {
+  // FNV-1a over the lowercased bytes
+  uint64_t h = 14695981039346656037ULL;
+  for (char c : name) {
+    h ^= static_cast<uint8_t>(toLowerASCII(c));
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+void CommandLookupTable::Build(const CommandMap &commands) {
+  // Keep the load factor under 1/4, so the probe sequences are short
+  uint64_t size = 16;
+  while (size < commands.size() * 4) size <<= 1;
+  slots_.assign(size, Slot{});
+  mask_ = size - 1;
+  for (const auto &[name, attributes] : commands) {
+    uint64_t h = hash(name);
+    uint64_t i = h & mask_;
+    while (slots_[i].attributes) i = (i + 1) & mask_;
+    slots_[i] = Slot{h, Util::ToLower(name), attributes};
+  }
+}
+
+const CommandAttributes *CommandLookupTable::Find(std::string_view name) const {
+  if (slots_.empty()) return nullptr;
+  uint64_t h = hash(name);
+  for (uint64_t i = h & mask_; slots_[i].attributes; i = (i + 1) & mask_) {
+    const auto &slot = slots_[i];
+    if (slot.hash != h || slot.name.size() != name.size()) continue;
+    bool equal = true;
+    for (size_t j = 0; j < name.size() && equal; j++) equal = slot.name[j] == toLowerASCII(name[j]);
+    if (equal) return slot.attributes;
+  }
+  return nullptr;
 }
 
 int GetCommandNum() { return (int)command_details::redis_command_table.size(); }
@@ -6460,7 +9395,21 @@ const CommandMap *GetOriginalCommands() { return &command_details::original_comm
 
 CommandMap *GetCommands() { return &command_details::commands; }
 
-void ResetCommands() { command_details::commands = command_details::original_commands; }
+void ResetCommands() {
+  command_details::commands = command_details::original_commands;
+  RefreshCommandLookup();
+}
+
+void RefreshCommandLookup() {
+  command_details::original_lookup_table.Build(command_details::original_commands);
+  command_details::lookup_table.Build(command_details::commands);
+}
+
+const CommandAttributes *LookupCommand(std::string_view name) { return command_details::lookup_table.Find(name); }
+
+const CommandAttributes *LookupOriginalCommand(std::string_view name) {
+  return command_details::original_lookup_table.Find(name);
+}
 
 std::string GetCommandInfo(const CommandAttributes *command_attributes) {
   std::string command, command_flags;
@@ -6488,11 +9437,10 @@ void GetAllCommandsInfo(std::string *info) {
 void GetCommandsInfo(std::string *info, const std::vector<std::string> &cmd_names) {
   info->append(Redis::MultiLen(cmd_names.size()));
   for (const auto &cmd_name : cmd_names) {
-    auto cmd_iter = command_details::original_commands.find(Util::ToLower(cmd_name));
-    if (cmd_iter == command_details::original_commands.end()) {
+    auto command_attribute = LookupOriginalCommand(cmd_name);
+    if (!command_attribute) {
       info->append(Redis::NilString());
     } else {
-      auto command_attribute = cmd_iter->second;
       auto command_info = GetCommandInfo(command_attribute);
       info->append(command_info);
     }
@@ -6500,12 +9448,11 @@ void GetCommandsInfo(std::string *info, const std::vector<std::string> &cmd_name
 }
 
 Status GetKeysFromCommand(const std::string &cmd_name, int argc, std::vector<int> *keys_indexes) {
-  auto cmd_iter = command_details::original_commands.find(Util::ToLower(cmd_name));
-  if (cmd_iter == command_details::original_commands.end()) {
+  auto command_attribute = LookupOriginalCommand(cmd_name);
+  if (!command_attribute) {
     return {Status::RedisUnknownCmd, "Invalid command specified"};
   }
 
-  auto command_attribute = cmd_iter->second;
   if (command_attribute->first_key == 0) {
     return {Status::NotOK, "The command has no key arguments"};
   }
@@ -6524,8 +9471,6 @@ Status GetKeysFromCommand(const std::string &cmd_name, int argc, std::vector<int
   return Status::OK();
 }
 
-bool IsCommandExists(const std::string &name) {
-  return command_details::original_commands.find(Util::ToLower(name)) != command_details::original_commands.end();
-}
+bool IsCommandExists(const std::string &name) { return LookupOriginalCommand(name) != nullptr; }
 
 }  // namespace Redis
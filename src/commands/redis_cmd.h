@@ -32,6 +32,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <utility>
 #include <vector>
@@ -58,6 +59,7 @@ enum CommandFlags {
   kCmdExclusive = (1ULL << 7),    // "exclusive" flag
   kCmdNoMulti = (1ULL << 8),      // "no-multi" flag
   kCmdNoScript = (1ULL << 9),     // "noscript" flag
+  kCmdSlow = (1ULL << 10),        // "slow" flag
 };
 
 class Commander {
@@ -65,6 +67,8 @@ class Commander {
   void SetAttributes(const CommandAttributes *attributes) { attributes_ = attributes; }
   const CommandAttributes *GetAttributes() { return attributes_; }
   void SetArgs(const std::vector<std::string> &args) { args_ = args; }
+  void SetArgs(std::vector<std::string> &&args) { args_ = std::move(args); }
+  const std::vector<std::string> &Args() const { return args_; }
   virtual Status Parse() { return Parse(args_); }
   virtual Status Parse(const std::vector<std::string> &args) { return Status::OK(); }
   virtual Status Execute(Server *svr, Connection *conn, std::string *output) {
@@ -73,6 +77,10 @@ class Commander {
 
   virtual ~Commander() = default;
 
+  // All commanders are allocated from the thread local free lists, see redis_cmd.cc
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr, size_t size);
+
  protected:
   std::vector<std::string> args_;
   const CommandAttributes *attributes_ = nullptr;
@@ -95,16 +103,41 @@ struct CommandAttributes {
   int last_key;
   int key_step;
   CommanderFactory factory;
+  // the index in the command table, which is assigned at the registration
+  size_t id = 0;
 
   bool is_write() const { return (flags & kCmdWrite) != 0; }
+  bool is_replication() const { return (flags & kCmdReplication) != 0; }
   bool is_ok_loading() const { return (flags & kCmdLoading) != 0; }
   bool is_exclusive() const { return (flags & kCmdExclusive) != 0; }
   bool is_multi() const { return (flags & kCmdMulti) != 0; }
   bool is_no_multi() const { return (flags & kCmdNoMulti) != 0; }
+  bool is_slow() const { return (flags & kCmdSlow) != 0; }
 };
 
 using CommandMap = std::map<std::string, const CommandAttributes *>;
 
+// The flat hash table of the commands for the dispatch, it looks up the names case-insensitively
+// without lowercasing them into the new strings. The slots are sparse and keep the hashes of the
+// names, so a lookup usually probes one slot and compares the name once.
+class CommandLookupTable {
+ public:
+  void Build(const CommandMap &commands);
+  const CommandAttributes *Find(std::string_view name) const;
+
+ private:
+  struct Slot {
+    uint64_t hash = 0;
+    std::string name;
+    const CommandAttributes *attributes = nullptr;
+  };
+
+  static uint64_t hash(std::string_view name);
+
+  std::vector<Slot> slots_;
+  uint64_t mask_ = 0;
+};
+
 template <typename T>
 auto MakeCmdAttr(const std::string &name, int arity, const std::string &description, int first_key, int last_key,
                  int key_step) {
@@ -124,6 +157,7 @@ auto MakeCmdAttr(const std::string &name, int arity, const std::string &descript
     if (flag == "multi") attr.flags |= kCmdMulti;
     if (flag == "no-multi") attr.flags |= kCmdNoMulti;
     if (flag == "no-script") attr.flags |= kCmdNoScript;
+    if (flag == "slow") attr.flags |= kCmdSlow;
   }
 
   return attr;
@@ -142,6 +176,10 @@ inline CommandMap original_commands;
 
 // Command table after rename-command directive
 inline CommandMap commands;
+
+// The lookup tables of the above, which are rebuilt by RefreshCommandLookup
+inline CommandLookupTable original_lookup_table;
+inline CommandLookupTable lookup_table;
 }  // namespace command_details
 
 #define KVROCKS_CONCAT(a, b) a##b                   // NOLINT
@@ -154,6 +192,12 @@ inline CommandMap commands;
 int GetCommandNum();
 CommandMap *GetCommands();
 void ResetCommands();
+// Rebuild the lookup tables after the commands were changed, e.g. renamed
+void RefreshCommandLookup();
+// Find the command by the case-insensitive name after the renaming, or nullptr if it doesn't exist
+const CommandAttributes *LookupCommand(std::string_view name);
+// Find the command by its original name before the renaming
+const CommandAttributes *LookupOriginalCommand(std::string_view name);
 const CommandMap *GetOriginalCommands();
 void GetAllCommandsInfo(std::string *info);
 void GetCommandsInfo(std::string *info, const std::vector<std::string> &cmd_names);
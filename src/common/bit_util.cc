@@ -0,0 +1,109 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "bit_util.h"
+
+#include <cstring>
+
+namespace Util {
+
+namespace {
+
+inline uint64_t loadWord(const unsigned char *p, bool big_endian) {
+  uint64_t word = 0;
+  memcpy(&word, p, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return big_endian ? __builtin_bswap64(word) : word;
+#else
+  return big_endian ? word : __builtin_bswap64(word);
+#endif
+}
+
+template <typename PopCountWord>
+inline uint64_t popCountWords(const unsigned char *p, size_t count, PopCountWord popcount_word) {
+  uint64_t bits = 0;
+  uint64_t word = 0;
+  // Four independent words per round keep the popcount units busy
+  for (; count >= 4 * sizeof(word); count -= 4 * sizeof(word), p += 4 * sizeof(word)) {
+    bits += popcount_word(loadWord(p, false)) + popcount_word(loadWord(p + 8, false)) +
+            popcount_word(loadWord(p + 16, false)) + popcount_word(loadWord(p + 24, false));
+  }
+  for (; count >= sizeof(word); count -= sizeof(word), p += sizeof(word)) {
+    bits += popcount_word(loadWord(p, false));
+  }
+  for (; count > 0; count--, p++) {
+    bits += popcount_word(*p);
+  }
+  return bits;
+}
+
+uint64_t popCountGeneric(const unsigned char *p, size_t count) {
+  return popCountWords(p, count, [](uint64_t word) -> uint64_t {
+    word = word - ((word >> 1) & 0x5555555555555555ULL);
+    word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (word * 0x0101010101010101ULL) >> 56;
+  });
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+__attribute__((target("popcnt"))) uint64_t popCountHardware(const unsigned char *p, size_t count) {
+  return popCountWords(p, count, [](uint64_t word) -> uint64_t { return __builtin_popcountll(word); });
+}
+
+using PopCountFunc = uint64_t (*)(const unsigned char *, size_t);
+PopCountFunc choosePopCount() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("popcnt") ? popCountHardware : popCountGeneric;
+}
+#endif
+
+}  // namespace
+
+uint64_t PopCount(const unsigned char *p, size_t count) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  static const PopCountFunc popcount_func = choosePopCount();
+  return popcount_func(p, count);
+#elif defined(__aarch64__)
+  // The NEON CNT instruction is always available on aarch64
+  return popCountWords(p, count, [](uint64_t word) -> uint64_t { return __builtin_popcountll(word); });
+#else
+  return popCountGeneric(p, count);
+#endif
+}
+
+int64_t FindFirstBit(const unsigned char *p, size_t count, bool bit, bool msb_first) {
+  // Flip the words if looking for the zero bit, so the search is always for the first one bit
+  const uint64_t flip = bit ? 0 : UINT64_MAX;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= count; i += sizeof(uint64_t)) {
+    uint64_t word = loadWord(p + i, msb_first) ^ flip;
+    if (word == 0) continue;
+    return static_cast<int64_t>(i * 8 + (msb_first ? __builtin_clzll(word) : __builtin_ctzll(word)));
+  }
+  for (; i < count; i++) {
+    auto byte = static_cast<uint32_t>(static_cast<uint8_t>(p[i] ^ flip));
+    if (byte == 0) continue;
+    return static_cast<int64_t>(i * 8 + (msb_first ? __builtin_clz(byte) - 24 : __builtin_ctz(byte)));
+  }
+  return -1;
+}
+
+}  // namespace Util
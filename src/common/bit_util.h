@@ -0,0 +1,38 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Util {
+
+// Count the bits set to one in the 'count' bytes starting at 'p'. It processes a 64-bit word
+// at a time, and uses the POPCNT instruction when the CPU supports it.
+uint64_t PopCount(const unsigned char *p, size_t count);
+
+// Return the position of the first bit which equals to 'bit' in the 'count' bytes starting
+// at 'p', or -1 if there's no such bit. The bits in a byte are numbered from the least
+// significant one if 'msb_first' is false, which is the layout of the bitmap segments,
+// or from the most significant one otherwise, which is the layout of the redis strings.
+int64_t FindFirstBit(const unsigned char *p, size_t count, bool bit, bool msb_first);
+
+}  // namespace Util
@@ -0,0 +1,60 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "compression_util.h"
+
+namespace Util {
+
+ZstdStreamCompressor::ZstdStreamCompressor(int level) : ctx_(ZSTD_createCCtx()) {
+  ZSTD_CCtx_setParameter(ctx_, ZSTD_c_compressionLevel, level);
+}
+
+Status ZstdStreamCompressor::Compress(const char *data, size_t len, std::string *output) {
+  ZSTD_inBuffer input = {data, len, 0};
+  size_t remaining = 0;
+  do {
+    size_t pos = output->size(), out_size = ZSTD_CStreamOutSize();
+    output->resize(pos + out_size);
+    ZSTD_outBuffer out = {output->data() + pos, out_size, 0};
+    // It returns 0 once all input is consumed and all compressed data is flushed
+    remaining = ZSTD_compressStream2(ctx_, &out, &input, ZSTD_e_flush);
+    output->resize(pos + out.pos);
+    if (ZSTD_isError(remaining)) return {Status::NotOK, ZSTD_getErrorName(remaining)};
+  } while (remaining != 0);
+  return Status::OK();
+}
+
+Status ZstdStreamDecompressor::Decompress(const char *data, size_t len, std::string *output) {
+  ZSTD_inBuffer input = {data, len, 0};
+  bool output_full = false;
+  while (input.pos < input.size || output_full) {
+    size_t pos = output->size(), out_size = ZSTD_DStreamOutSize();
+    output->resize(pos + out_size);
+    ZSTD_outBuffer out = {output->data() + pos, out_size, 0};
+    size_t ret = ZSTD_decompressStream(ctx_, &out, &input);
+    output->resize(pos + out.pos);
+    if (ZSTD_isError(ret)) return {Status::NotOK, ZSTD_getErrorName(ret)};
+    // The decompressor may hold more data if the output buffer is full
+    output_full = out.pos == out_size;
+  }
+  return Status::OK();
+}
+
+}  // namespace Util
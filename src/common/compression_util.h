@@ -0,0 +1,65 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <zstd.h>
+
+#include <string>
+
+#include "status.h"
+
+namespace Util {
+
+// The streaming compressor of zstd, every call of Compress flushes its data, so the receiver can
+// decompress it at once, but the window of the previous data is kept as the dictionary of the
+// following data, which makes the small and similar pieces (e.g. write batches) compress well.
+class ZstdStreamCompressor {
+ public:
+  explicit ZstdStreamCompressor(int level = 1);
+  ~ZstdStreamCompressor() { ZSTD_freeCCtx(ctx_); }
+  ZstdStreamCompressor(const ZstdStreamCompressor &) = delete;
+  ZstdStreamCompressor &operator=(const ZstdStreamCompressor &) = delete;
+
+  // Append the compressed data to the output
+  Status Compress(const char *data, size_t len, std::string *output);
+  Status Compress(const std::string &data, std::string *output) { return Compress(data.data(), data.size(), output); }
+
+ private:
+  ZSTD_CCtx *ctx_;
+};
+
+// The streaming decompressor of the data compressed by ZstdStreamCompressor, the pieces must be
+// decompressed in the order they were compressed.
+class ZstdStreamDecompressor {
+ public:
+  ZstdStreamDecompressor() : ctx_(ZSTD_createDCtx()) {}
+  ~ZstdStreamDecompressor() { ZSTD_freeDCtx(ctx_); }
+  ZstdStreamDecompressor(const ZstdStreamDecompressor &) = delete;
+  ZstdStreamDecompressor &operator=(const ZstdStreamDecompressor &) = delete;
+
+  // Append the decompressed data to the output
+  Status Decompress(const char *data, size_t len, std::string *output);
+
+ private:
+  ZSTD_DCtx *ctx_;
+};
+
+}  // namespace Util
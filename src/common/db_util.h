@@ -32,8 +32,17 @@ struct UniqueIterator : std::unique_ptr<rocksdb::Iterator> {
 
   explicit UniqueIterator(rocksdb::Iterator* iter) : base_type(iter) {}
   UniqueIterator(rocksdb::DB* db, const rocksdb::ReadOptions& options, rocksdb::ColumnFamilyHandle* column_family)
-      : base_type(db->NewIterator(options, column_family)) {}
-  UniqueIterator(rocksdb::DB* db, const rocksdb::ReadOptions& options) : base_type(db->NewIterator(options)) {}
+      : base_type(db->NewIterator(PrefixAwareOptions(options), column_family)) {}
+  UniqueIterator(rocksdb::DB* db, const rocksdb::ReadOptions& options)
+      : base_type(db->NewIterator(PrefixAwareOptions(options))) {}
+
+  // The subkey column families have the prefix extractor, let RocksDB use the prefix filters only
+  // if the iterate_upper_bound is in the same prefix as the seek key, so that the iterators
+  // crossing the prefixes still see all keys in total order.
+  static rocksdb::ReadOptions PrefixAwareOptions(rocksdb::ReadOptions options) {
+    if (!options.total_order_seek) options.auto_prefix_mode = true;
+    return options;
+  }
 };
 
 }  // namespace DBUtil
@@ -23,8 +23,14 @@
 #include <rocksdb/slice.h>
 #include <unistd.h>
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 
+#if !defined(__BYTE_ORDER__) || (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__ && __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__)
+#error "Undefined or invalid __BYTE_ORDER__"
+#endif
+
 bool GetFixed8(rocksdb::Slice *input, uint8_t *value);
 bool GetFixed16(rocksdb::Slice *input, uint16_t *value);
 bool GetFixed32(rocksdb::Slice *input, uint32_t *value);
@@ -36,16 +42,71 @@ void PutFixed32(std::string *dst, uint32_t value);
 void PutFixed64(std::string *dst, uint64_t value);
 void PutDouble(std::string *dst, double value);
 
-void EncodeFixed8(char *buf, uint8_t value);
-void EncodeFixed16(char *buf, uint16_t value);
-void EncodeFixed32(char *buf, uint32_t value);
-void EncodeFixed64(char *buf, uint64_t value);
-uint16_t DecodeFixed16(const char *ptr);
-uint32_t DecodeFixed32(const char *ptr);
-uint64_t DecodeFixed64(const char *ptr);
-double DecodeDouble(const char *ptr);
+// The fixed-width integers are encoded in big endian so that they're ordered bytewise, the codecs
+// are inlined since they're called for every key of the scans, and the byte swaps are compiled
+// to the single instructions like bswap and movbe.
+constexpr bool kLittleEndian = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+inline void EncodeFixed8(char *buf, uint8_t value) { buf[0] = static_cast<char>(value); }
+
+inline void EncodeFixed16(char *buf, uint16_t value) {
+  if (kLittleEndian) value = __builtin_bswap16(value);
+  memcpy(buf, &value, sizeof(value));
+}
+
+inline void EncodeFixed32(char *buf, uint32_t value) {
+  if (kLittleEndian) value = __builtin_bswap32(value);
+  memcpy(buf, &value, sizeof(value));
+}
+
+inline void EncodeFixed64(char *buf, uint64_t value) {
+  if (kLittleEndian) value = __builtin_bswap64(value);
+  memcpy(buf, &value, sizeof(value));
+}
+
+inline uint16_t DecodeFixed16(const char *ptr) {
+  uint16_t value = 0;
+  memcpy(&value, ptr, sizeof(value));
+  return kLittleEndian ? __builtin_bswap16(value) : value;
+}
+
+inline uint32_t DecodeFixed32(const char *ptr) {
+  uint32_t value = 0;
+  memcpy(&value, ptr, sizeof(value));
+  return kLittleEndian ? __builtin_bswap32(value) : value;
+}
+
+inline uint64_t DecodeFixed64(const char *ptr) {
+  uint64_t value = 0;
+  memcpy(&value, ptr, sizeof(value));
+  return kLittleEndian ? __builtin_bswap64(value) : value;
+}
+
+// The doubles are encoded to be ordered bytewise as their values: the sign bit of the positive
+// ones is flipped, and all bits of the negative ones are flipped.
+inline void EncodeDouble(char *buf, double value) {
+  uint64_t u64 = 0;
+  memcpy(&u64, &value, sizeof(value));
+  u64 ^= (u64 >> 63) == 1 ? 0xffffffffffffffff : 0x8000000000000000;
+  EncodeFixed64(buf, u64);
+}
+
+inline double DecodeDouble(const char *ptr) {
+  uint64_t decoded = DecodeFixed64(ptr);
+  decoded ^= (decoded >> 63) == 0 ? 0xffffffffffffffff : 0x8000000000000000;
+  double value = 0;
+  memcpy(&value, &decoded, sizeof(value));
+  return value;
+}
+
+// Decode the n contiguous fixed64 or double values
+void DecodeFixed64Array(const char *ptr, size_t n, uint64_t *values);
+void DecodeDoubleArray(const char *ptr, size_t n, double *values);
+void EncodeFixed64Array(char *buf, const uint64_t *values, size_t n);
 char *EncodeVarint32(char *dst, uint32_t v);
 void PutVarint32(std::string *dst, uint32_t v);
 const char *GetVarint32PtrFallback(const char *p, const char *limit, uint32_t *value);
 const char *GetVarint32Ptr(const char *p, const char *limit, uint32_t *value);
 bool GetVarint32(rocksdb::Slice *input, uint32_t *value);
+void PutVarint64(std::string *dst, uint64_t v);
+bool GetVarint64(rocksdb::Slice *input, uint64_t *value);
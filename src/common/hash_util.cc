@@ -0,0 +1,53 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "hash_util.h"
+
+namespace Util {
+
+uint64_t MurmurHash64A(const rocksdb::Slice &key, uint32_t seed) {
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const int r = 47;
+  const auto *data = reinterpret_cast<const uint8_t *>(key.data());
+  size_t len = key.size();
+  uint64_t h = seed ^ (len * m);
+
+  const uint8_t *end = data + (len - (len & 7));
+  for (; data != end; data += 8) {
+    uint64_t k = 0;
+    for (int i = 7; i >= 0; i--) k = (k << 8) | data[i];
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  size_t rest = len & 7;
+  if (rest > 0) {
+    for (size_t i = rest; i > 0; i--) h ^= static_cast<uint64_t>(data[i - 1]) << (8 * (i - 1));
+    h *= m;
+  }
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+}  // namespace Util
@@ -31,6 +31,13 @@
 #include <sys/sendfile.h>
 #endif
 
+#ifdef ENABLE_IO_URING
+#include <liburing.h>
+
+#include <algorithm>
+#include <array>
+#endif
+
 #include "event_util.h"
 #include "fd_util.h"
 #include "scope_exit.h"
@@ -215,13 +222,120 @@ ssize_t SockSendFileCore(int out_fd, int in_fd, off_t offset, size_t count) {
   return -1;
 }
 
+#ifdef ENABLE_IO_URING
+// The file is spliced into the socket through a pipe, every chunk needs a pair of
+// linked splices, and a batch of chunks is submitted by a single syscall.
+constexpr unsigned kIOUringSpliceBatch = 16;
+
+// Return false if io_uring or its splice isn't supported by the kernel,
+// otherwise the result of sending would be set into the status.
+static bool sockSendFileByIOUring(int out_fd, int in_fd, off_t offset, size_t size, Status *s) {
+  io_uring ring;
+  if (io_uring_queue_init(kIOUringSpliceBatch * 2, &ring, 0) < 0) return false;
+  auto exit = MakeScopeExit([&ring] { io_uring_queue_exit(&ring); });
+
+  io_uring_probe *probe = io_uring_get_probe_ring(&ring);
+  bool splice_supported = probe && io_uring_opcode_supported(probe, IORING_OP_SPLICE);
+  if (probe) io_uring_free_probe(probe);
+  if (!splice_supported) return false;
+
+  int pipe_fds[2];
+  if (pipe(pipe_fds) == -1) {
+    *s = Status::FromErrno();
+    return true;
+  }
+  UniqueFD pipe_out(pipe_fds[0]), pipe_in(pipe_fds[1]);
+  // A chunk mustn't exceed the capacity of the pipe, or the splice into the pipe
+  // would be blocked forever since the linked splice out of the pipe can't start
+  fcntl(*pipe_in, F_SETPIPE_SZ, 1024 * 1024);
+  int pipe_size = fcntl(*pipe_in, F_GETPIPE_SZ);
+  if (pipe_size <= 0) {
+    *s = Status::FromErrno();
+    return true;
+  }
+
+  size_t end = static_cast<size_t>(offset) + size;
+  std::array<int, kIOUringSpliceBatch * 2> results{};
+  while (static_cast<size_t>(offset) < end) {
+    unsigned chunks = 0;
+    io_uring_sqe *sqe = nullptr;
+    for (off_t chunk_offset = offset; chunks < kIOUringSpliceBatch && static_cast<size_t>(chunk_offset) < end;
+         chunks++) {
+      auto len = static_cast<unsigned>(std::min(static_cast<size_t>(pipe_size), end - chunk_offset));
+      sqe = io_uring_get_sqe(&ring);
+      io_uring_prep_splice(sqe, in_fd, chunk_offset, *pipe_in, -1, len, 0);
+      sqe->flags |= IOSQE_IO_LINK;
+      sqe->user_data = chunks * 2;
+      sqe = io_uring_get_sqe(&ring);
+      io_uring_prep_splice(sqe, *pipe_out, -1, out_fd, -1, len, 0);
+      sqe->flags |= IOSQE_IO_LINK;
+      sqe->user_data = chunks * 2 + 1;
+      chunk_offset += len;
+    }
+    sqe->flags &= ~IOSQE_IO_LINK;
+
+    int ret = io_uring_submit_and_wait(&ring, chunks * 2);
+    if (ret < 0) {
+      *s = {Status::NotOK, strerror(-ret)};
+      return true;
+    }
+    for (unsigned i = 0; i < chunks * 2; i++) {
+      io_uring_cqe *cqe = nullptr;
+      if (ret = io_uring_wait_cqe(&ring, &cqe); ret < 0) {
+        *s = {Status::NotOK, strerror(-ret)};
+        return true;
+      }
+      results[cqe->user_data] = cqe->res;
+      io_uring_cqe_seen(&ring, cqe);
+    }
+
+    // The chain is broken by the first short or failed splice, the rest of the
+    // batch was canceled, so flush the data left in the pipe and continue from there
+    size_t in_pipe = 0;
+    for (unsigned i = 0; i < chunks; i++) {
+      int nread = results[i * 2], nwritten = results[i * 2 + 1];
+      if (nread == -ECANCELED) break;
+      if (nread <= 0) {
+        *s = {Status::NotOK, nread == 0 ? "unexpected end of file" : strerror(-nread)};
+        return true;
+      }
+      offset += nread;
+      in_pipe += nread;
+      if (nwritten == -ECANCELED) break;
+      if (nwritten <= 0) {
+        *s = {Status::NotOK, nwritten == 0 ? "connection was closed" : strerror(-nwritten)};
+        return true;
+      }
+      in_pipe -= nwritten;
+      if (nwritten != nread) break;
+    }
+    while (in_pipe > 0) {
+      ssize_t n = splice(*pipe_out, nullptr, out_fd, nullptr, in_pipe, SPLICE_F_MOVE);
+      if (n == -1 && errno == EINTR) continue;
+      if (n <= 0) {
+        *s = {Status::NotOK, n == 0 ? "connection was closed" : strerror(errno)};
+        return true;
+      }
+      in_pipe -= n;
+    }
+  }
+  *s = Status::OK();
+  return true;
+}
+#endif
+
 // Send file by sendfile actually according to different operation systems,
-// please note that, the out socket fd should be in blocking mode.
-Status SockSendFile(int out_fd, int in_fd, size_t size) {
+// please note that, the out socket fd should be in blocking mode. The size bytes
+// starting from the offset of the file are sent.
+Status SockSendFile(int out_fd, int in_fd, size_t size, off_t offset) {
+#ifdef ENABLE_IO_URING
+  // Fall back to sendfile if io_uring isn't supported by the kernel
+  if (Status s; sockSendFileByIOUring(out_fd, in_fd, offset, size, &s)) return s;
+#endif
   ssize_t nwritten = 0;
-  off_t offset = 0;
   while (size != 0) {
-    size_t n = size <= 16 * 1024 ? size : 16 * 1024;
+    // The socket is blocking, so a larger chunk means fewer syscalls
+    size_t n = size <= 1024 * 1024 ? size : 1024 * 1024;
     nwritten = SockSendFileCore(out_fd, in_fd, offset, n);
     if (nwritten == -1) {
       if (errno == EINTR)
@@ -21,6 +21,7 @@
 #pragma once
 
 #include <netinet/in.h>
+#include <sys/types.h>
 
 #include "status.h"
 
@@ -33,7 +34,7 @@ Status SockSetTcpNoDelay(int fd, int val);
 Status SockSetTcpKeepalive(int fd, int interval);
 Status SockSend(int fd, const std::string &data);
 Status SockReadLine(int fd, std::string *data);
-Status SockSendFile(int out_fd, int in_fd, size_t size);
+Status SockSendFile(int out_fd, int in_fd, size_t size, off_t offset = 0);
 Status SockSetBlocking(int fd, int blocking);
 int GetPeerAddr(int fd, std::string *addr, uint32_t *port);
 int GetLocalPort(int fd);
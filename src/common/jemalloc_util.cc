@@ -0,0 +1,152 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "jemalloc_util.h"
+
+#ifdef ENABLE_JEMALLOC
+#include <jemalloc/jemalloc.h>
+#endif
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace Util {
+
+#ifdef ENABLE_JEMALLOC
+
+namespace {
+
+std::mutex arenas_mu;
+// The dedicated arenas of the exited threads, the arenas can't be destroyed since their memory
+// may still be used by the other threads
+std::vector<unsigned> free_arenas;
+std::map<std::string, unsigned> shared_arenas;
+
+Status CreateArena(unsigned *arena) {
+  size_t size = sizeof(*arena);
+  if (int err = mallctl("arenas.create", arena, &size, nullptr, 0); err != 0) {
+    return {Status::NotOK, "failed to create the jemalloc arena, err: " + std::string(strerror(err))};
+  }
+  return Status::OK();
+}
+
+Status BindArena(unsigned arena) {
+  if (int err = mallctl("thread.arena", nullptr, nullptr, &arena, sizeof(arena)); err != 0) {
+    return {Status::NotOK, "failed to bind the jemalloc arena, err: " + std::string(strerror(err))};
+  }
+  return Status::OK();
+}
+
+// Release the dedicated arena of the thread when it exits
+struct DedicatedArena {
+  ~DedicatedArena() {
+    if (!acquired) return;
+    std::lock_guard<std::mutex> guard(arenas_mu);
+    free_arenas.emplace_back(arena);
+  }
+
+  bool acquired = false;
+  unsigned arena = 0;
+};
+
+thread_local DedicatedArena dedicated_arena;
+
+}  // namespace
+
+Status ThreadSetDedicatedArena() {
+  if (dedicated_arena.acquired) return Status::OK();
+  unsigned arena = 0;
+  {
+    std::lock_guard<std::mutex> guard(arenas_mu);
+    if (!free_arenas.empty()) {
+      arena = free_arenas.back();
+      free_arenas.pop_back();
+    } else {
+      auto s = CreateArena(&arena);
+      if (!s.IsOK()) return s;
+    }
+  }
+  auto s = BindArena(arena);
+  if (!s.IsOK()) {
+    std::lock_guard<std::mutex> guard(arenas_mu);
+    free_arenas.emplace_back(arena);
+    return s;
+  }
+  dedicated_arena.acquired = true;
+  dedicated_arena.arena = arena;
+  return Status::OK();
+}
+
+Status ThreadSetSharedArena(const std::string &name, bool thread_cache) {
+  unsigned arena = 0;
+  {
+    std::lock_guard<std::mutex> guard(arenas_mu);
+    auto iter = shared_arenas.find(name);
+    if (iter != shared_arenas.end()) {
+      arena = iter->second;
+    } else {
+      auto s = CreateArena(&arena);
+      if (!s.IsOK()) return s;
+      shared_arenas.emplace(name, arena);
+    }
+  }
+  auto s = BindArena(arena);
+  if (!s.IsOK()) return s;
+  bool enabled = thread_cache;
+  if (int err = mallctl("thread.tcache.enabled", nullptr, nullptr, &enabled, sizeof(enabled)); err != 0) {
+    return {Status::NotOK, "failed to set the jemalloc thread cache, err: " + std::string(strerror(err))};
+  }
+  return Status::OK();
+}
+
+Status SetHeapProfileActive(bool active) {
+  if (int err = mallctl("prof.active", nullptr, nullptr, &active, sizeof(active)); err != 0) {
+    return {Status::NotOK, "failed to set the heap profiling, err: " + std::string(strerror(err)) +
+                               ", jemalloc should be started with MALLOC_CONF=\"prof:true\""};
+  }
+  return Status::OK();
+}
+
+Status DumpHeapProfile(const std::string &path) {
+  const char *filename = path.c_str();
+  if (int err = mallctl("prof.dump", nullptr, nullptr, &filename, sizeof(filename)); err != 0) {
+    return {Status::NotOK, "failed to dump the heap profile, err: " + std::string(strerror(err)) +
+                               ", jemalloc should be started with MALLOC_CONF=\"prof:true\""};
+  }
+  return Status::OK();
+}
+
+#else
+
+Status ThreadSetDedicatedArena() { return {Status::NotOK, "kvrocks isn't built with jemalloc"}; }
+
+Status ThreadSetSharedArena(const std::string &name, bool thread_cache) {
+  return {Status::NotOK, "kvrocks isn't built with jemalloc"};
+}
+
+Status SetHeapProfileActive(bool active) { return {Status::NotOK, "kvrocks isn't built with jemalloc"}; }
+
+Status DumpHeapProfile(const std::string &path) { return {Status::NotOK, "kvrocks isn't built with jemalloc"}; }
+
+#endif
+
+}  // namespace Util
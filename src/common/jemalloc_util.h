@@ -0,0 +1,43 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <string>
+
+#include "status.h"
+
+namespace Util {
+
+// The jemalloc arenas of the threads, so that the allocations of the workers and the background
+// threads, e.g. the compactions, don't contend for the locks of the same arenas or fragment the
+// pages of each other. They fail if kvrocks isn't built with jemalloc.
+
+// Bind the current thread to a dedicated arena, which is reused by the other threads after it exited
+Status ThreadSetDedicatedArena();
+// Bind the current thread to the arena shared by the threads of the name, with or without the thread cache
+Status ThreadSetSharedArena(const std::string &name, bool thread_cache);
+
+// The heap profiling requires jemalloc to be started with MALLOC_CONF="prof:true", it can be activated
+// and deactivated at runtime then
+Status SetHeapProfileActive(bool active);
+Status DumpHeapProfile(const std::string &path);
+
+}  // namespace Util
@@ -20,10 +20,16 @@
 
 #pragma once
 
+#include <cctype>
+#include <cerrno>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <limits>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <type_traits>
 
 #include "status.h"
 
@@ -72,6 +78,62 @@ struct ParseIntFunc<unsigned long long> {  // NOLINT
   constexpr static const auto value = std::strtoull;
 };
 
+// CStrBuffer copies a view to a nul-terminated string for strto*,
+// short views are copied to the stack, only the longer ones (e.g. padded
+// with lots of spaces) need a heap allocated copy
+class CStrBuffer {
+ public:
+  explicit CStrBuffer(std::string_view v) {
+    if (v.size() < sizeof(buf_)) {
+      std::memcpy(buf_, v.data(), v.size());
+      buf_[v.size()] = '\0';
+      ptr_ = buf_;
+    } else {
+      holder_.assign(v.data(), v.size());
+      ptr_ = holder_.c_str();
+    }
+  }
+
+  CStrBuffer(const CStrBuffer &) = delete;
+  CStrBuffer &operator=(const CStrBuffer &) = delete;
+
+  const char *Get() const { return ptr_; }
+
+ private:
+  char buf_[64];
+  std::string holder_;
+  const char *ptr_;
+};
+
+// ParseDecimal parses the whole view as a plain decimal integer (an optional '-'
+// followed by digits) in place, the view doesn't need to be nul-terminated.
+// It returns NotFound if the view is not in the plain form (e.g. leading spaces
+// or '+'), the caller should then fall back to strto* to keep their semantics.
+template <typename T>
+Status ParseDecimal(std::string_view v, T *out) {
+  using U = std::make_unsigned_t<T>;
+
+  size_t i = 0;
+  bool negative = false;
+  if (std::is_signed_v<T> && !v.empty() && v[0] == '-') {
+    negative = true;
+    i = 1;
+  }
+  if (i >= v.size() || v[i] < '0' || v[i] > '9') return {Status::NotFound};
+
+  U limit = negative ? U(std::numeric_limits<T>::max()) + 1 : U(std::numeric_limits<T>::max());
+  U value = 0;
+  for (; i < v.size(); i++) {
+    if (v[i] < '0' || v[i] > '9') return {Status::NotOK, "encounter non-integer characters"};
+    U digit = v[i] - '0';
+    if (value > (limit - digit) / 10) return {Status::NotOK, "out of range of integer type"};
+    value = value * 10 + digit;
+  }
+
+  *out = negative ? T(U(0) - value) : T(value);
+  return Status::OK();
+}
+
 }  // namespace details
 
 template <typename T>
@@ -109,9 +171,24 @@ StatusOr<ParseResultAndPos<T>> TryParseInt(const char *v, int base = 0) {
 // ParseInt parses a string to a integer,
 // not like TryParseInt, the whole string need to be parsed as an integer,
 // e.g. ParseInt("100MB") -> error status
+// plain decimal strings are parsed in place, so it is allocation-free for the
+// tokens of requests and the view doesn't need to be nul-terminated
 template <typename T = long long>  // NOLINT
-StatusOr<T> ParseInt(const std::string &v, int base = 0) {
-  const char *begin = v.c_str();
+StatusOr<T> ParseInt(std::string_view v, int base = 0) {
+  // the base 0 treats a leading '0' as the octal or hex prefix
+  size_t first_digit = !v.empty() && v[0] == '-' ? 1 : 0;
+  bool decimal = base == 10 || (base == 0 && !(v.size() > first_digit + 1 && v[first_digit] == '0'));
+  if (decimal) {
+    T value;
+    Status s = details::ParseDecimal<T>(v, &value);
+    if (s.IsOK()) return value;
+    if (!s.Is<Status::NotFound>()) return s;
+  }
+
+  // strto* requires a nul-terminated string
+  details::CStrBuffer buf(v);
+  const char *begin = buf.Get();
+
   auto res = TryParseInt<T>(begin, base);
 
   if (!res) return res;
@@ -129,7 +206,7 @@ using NumericRange = std::tuple<T, T>;
 // this overload accepts a range {min, max},
 // integer out of the range will trigger an error status
 template <typename T = long long>  // NOLINT
-StatusOr<T> ParseInt(const std::string &v, NumericRange<T> range, int base = 0) {
+StatusOr<T> ParseInt(std::string_view v, NumericRange<T> range, int base = 0) {
   auto res = ParseInt<T>(v, base);
 
   if (!res) return res;
@@ -140,3 +217,35 @@ StatusOr<T> ParseInt(const std::string &v, NumericRange<T> range, int base = 0)
 
   return *res;
 }
+
+// ParseFloat parses the whole string to a double like strtod,
+// leading spaces, trailing characters and overflow will trigger an error status,
+// e.g. ParseFloat("1.5") -> 1.5, ParseFloat("1.5x") -> error status
+// the caller should check NaN by itself if it isn't acceptable
+inline StatusOr<double> ParseFloat(std::string_view v) {
+  if (v.empty() || std::isspace(static_cast<unsigned char>(v[0]))) {
+    return {Status::NotOK, "not started as a number"};
+  }
+
+  // strtod requires a nul-terminated string
+  details::CStrBuffer buf(v);
+  const char *begin = buf.Get();
+
+  char *end;
+  errno = 0;
+  double res = std::strtod(begin, &end);
+
+  if (end == begin) {
+    return {Status::NotOK, "not started as a number"};
+  }
+
+  if (end != begin + v.size()) {
+    return {Status::NotOK, "encounter non-numeric characters"};
+  }
+
+  if (errno == ERANGE && (res == HUGE_VAL || res == -HUGE_VAL || res == 0)) {
+    return {Status::NotOK, "out of range of float type"};
+  }
+
+  return res;
+}
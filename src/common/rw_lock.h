@@ -24,7 +24,10 @@
 // A implementation of RAII write-first read-write lock using C++11.
 
 #pragma once
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <mutex>
 
 namespace RWLock {
@@ -57,6 +60,14 @@ class ReadWriteLock {
     ++read_count_;
   }
 
+  // Acquire the read lock only if no writer is waiting or writing
+  bool TryLockRead() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (write_count_ > 0) return false;
+    ++read_count_;
+    return true;
+  }
+
   void UnLockRead() {
     std::lock_guard<std::mutex> guard(lock_);
     if (--read_count_ == 0 && write_count_ > 0) {
@@ -86,6 +97,8 @@ class WriteLock {
 class ReadLock {
  public:
   explicit ReadLock(ReadWriteLock& rlock) : rlock_(rlock) { rlock_.LockRead(); }
+  // Take over the read lock which was acquired by TryLockRead
+  ReadLock(ReadWriteLock& rlock, std::adopt_lock_t) : rlock_(rlock) {}
 
   virtual ~ReadLock() { rlock_.UnLockRead(); }
 
@@ -93,4 +106,99 @@ class ReadLock {
   ReadWriteLock& rlock_;
 };
 
+// A write-first read-write lock whose readers are counted in the sharded counters, each reader
+// only touches the counter of its own shard and the writer flag which is rarely written, so the
+// readers from different threads don't bounce the same cache line. The writer announces itself
+// first, then waits for all shards to be quiesced, the readers that come in while any writer is
+// waiting or writing back off until the writers are done.
+class ShardedReadWriteLock {
+ public:
+  static constexpr size_t kShards = 64;
+
+  ShardedReadWriteLock() = default;
+  ShardedReadWriteLock(const ShardedReadWriteLock &) = delete;
+  ShardedReadWriteLock &operator=(const ShardedReadWriteLock &) = delete;
+
+  void LockWrite() {
+    writers_.fetch_add(1, std::memory_order_seq_cst);
+    write_lock_.lock();
+    std::unique_lock<std::mutex> guard(wait_lock_);
+    condition_.wait(guard, [this] { return quiesced(); });
+  }
+
+  void UnLockWrite() {
+    write_lock_.unlock();
+    if (writers_.fetch_sub(1, std::memory_order_seq_cst) == 1) {
+      std::lock_guard<std::mutex> guard(wait_lock_);
+      condition_.notify_all();
+    }
+  }
+
+  // Return the shard of the reader, which should be passed to UnLockRead
+  size_t LockRead() {
+    size_t shard = shardOfThisThread();
+    auto &readers = shards_[shard].readers;
+    while (true) {
+      readers.fetch_add(1, std::memory_order_seq_cst);
+      if (writers_.load(std::memory_order_seq_cst) == 0) return shard;
+
+      // Back off, the writer may be waiting for this shard
+      UnLockRead(shard);
+      std::unique_lock<std::mutex> guard(wait_lock_);
+      condition_.wait(guard, [this] { return writers_.load(std::memory_order_seq_cst) == 0; });
+    }
+  }
+
+  void UnLockRead(size_t shard) {
+    if (shards_[shard].readers.fetch_sub(1, std::memory_order_seq_cst) == 1 &&
+        writers_.load(std::memory_order_seq_cst) > 0) {
+      std::lock_guard<std::mutex> guard(wait_lock_);
+      condition_.notify_all();
+    }
+  }
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<int64_t> readers{0};
+  };
+
+  static size_t shardOfThisThread() {
+    static std::atomic<size_t> next_shard{0};
+    thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return shard;
+  }
+
+  bool quiesced() const {
+    for (const auto &shard : shards_) {
+      if (shard.readers.load(std::memory_order_seq_cst) != 0) return false;
+    }
+    return true;
+  }
+
+  Shard shards_[kShards];
+  alignas(64) std::atomic<int> writers_{0};
+  std::mutex write_lock_;
+  std::mutex wait_lock_;
+  std::condition_variable condition_;
+};
+
+class ShardedWriteLock {
+ public:
+  explicit ShardedWriteLock(ShardedReadWriteLock &wlock) : wlock_(wlock) { wlock_.LockWrite(); }
+  ~ShardedWriteLock() { wlock_.UnLockWrite(); }
+
+ private:
+  ShardedReadWriteLock &wlock_;
+};
+
+class ShardedReadLock {
+ public:
+  explicit ShardedReadLock(ShardedReadWriteLock &rlock) : rlock_(rlock), shard_(rlock_.LockRead()) {}
+  ~ShardedReadLock() { rlock_.UnLockRead(shard_); }
+
+ private:
+  ShardedReadWriteLock &rlock_;
+  size_t shard_;
+};
+
 }  // namespace RWLock
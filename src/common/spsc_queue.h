@@ -0,0 +1,72 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+// SPSCQueue is a bounded lock-free queue of one producer thread and one consumer thread,
+// the capacity is rounded up to the power of two, and TryPush fails when the queue is full
+template <typename T>
+class SPSCQueue {
+ public:
+  explicit SPSCQueue(size_t capacity) : capacity_(roundUpPowerOfTwo(capacity)), slots_(new T[capacity_]) {}
+
+  SPSCQueue(const SPSCQueue &) = delete;
+  SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+  // Called by the producer thread only
+  bool TryPush(T &&item) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == capacity_) return false;
+    slots_[tail & (capacity_ - 1)] = std::move(item);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Called by the consumer thread only
+  std::optional<T> TryPop() {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return std::nullopt;
+    std::optional<T> item(std::move(slots_[head & (capacity_ - 1)]));
+    head_.store(head + 1, std::memory_order_release);
+    return item;
+  }
+
+  size_t Size() const { return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire); }
+  size_t Capacity() const { return capacity_; }
+
+ private:
+  static size_t roundUpPowerOfTwo(size_t n) {
+    size_t capacity = 1;
+    while (capacity < n) capacity <<= 1;
+    return capacity;
+  }
+
+  const size_t capacity_;
+  std::unique_ptr<T[]> slots_;
+  // The head and the tail are in different cache lines to avoid the false sharing
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
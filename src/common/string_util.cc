@@ -22,6 +22,8 @@
 
 #include <fmt/format.h>
 
+#include <utility>
+
 #include "parse_util.h"
 
 namespace Util {
@@ -227,6 +229,124 @@ int StringMatchLen(const char *pattern, int patternLen, const char *string, int
   return 0;
 }
 
+GlobPattern::GlobPattern(std::string_view pattern, bool nocase) : nocase_(nocase) {
+  auto add_literal = [this](char c) {
+    if (nocase_) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    if (tokens_.empty() || tokens_.back().kind != Token::kLiteral) tokens_.push_back({Token::kLiteral, "", {}});
+    tokens_.back().literal.push_back(c);
+  };
+
+  size_t i = 0, n = pattern.size();
+  for (; i < n; i++) {
+    switch (pattern[i]) {
+      case '*':
+        if (tokens_.empty() || tokens_.back().kind != Token::kAnyString) tokens_.push_back({Token::kAnyString, "", {}});
+        break;
+      case '?':
+        tokens_.push_back({Token::kAnyChar, "", {}});
+        break;
+      case '[': {
+        // The same as StringMatchLen, the unclosed set ends with the pattern
+        Token token{Token::kCharSet, "", {}};
+        bool not_symbol = i + 1 < n && pattern[i + 1] == '^';
+        for (i += not_symbol ? 2 : 1; i < n && pattern[i] != ']'; i++) {
+          if (pattern[i] == '\\' && i + 1 < n) {
+            token.chars.set(static_cast<unsigned char>(pattern[++i]));
+          } else if (i + 2 < n && pattern[i + 1] == '-') {
+            int start = static_cast<unsigned char>(pattern[i]), end = static_cast<unsigned char>(pattern[i + 2]);
+            if (start > end) std::swap(start, end);
+            if (nocase_) {
+              start = tolower(start);
+              end = tolower(end);
+            }
+            for (int c = 0; c < 256; c++) {
+              int lc = nocase_ ? tolower(c) : c;
+              if (lc >= start && lc <= end) token.chars.set(c);
+            }
+            i += 2;
+          } else {
+            int ch = static_cast<unsigned char>(pattern[i]);
+            for (int c = 0; c < 256; c++) {
+              if (c == ch || (nocase_ && tolower(c) == tolower(ch))) token.chars.set(c);
+            }
+          }
+        }
+        if (not_symbol) token.chars.flip();
+        tokens_.emplace_back(std::move(token));
+        break;
+      }
+      case '\\':
+        add_literal(i + 1 < n ? pattern[++i] : pattern[i]);
+        break;
+      default:
+        add_literal(pattern[i]);
+        break;
+    }
+  }
+
+  size_t literal_tokens = 0;
+  if (!nocase_ && !tokens_.empty() && tokens_[0].kind == Token::kLiteral) {
+    prefix_ = tokens_[0].literal;
+    literal_tokens = 1;
+  }
+  all_with_prefix_ = tokens_.size() == literal_tokens + 1 && tokens_.back().kind == Token::kAnyString;
+}
+
+bool GlobPattern::matchToken(const Token &token, std::string_view in, size_t pos, size_t *len) const {
+  switch (token.kind) {
+    case Token::kLiteral:
+      if (in.size() - pos < token.literal.size()) return false;
+      *len = token.literal.size();
+      if (!nocase_) return in.compare(pos, *len, token.literal) == 0;
+      for (size_t i = 0; i < *len; i++) {
+        if (tolower(static_cast<unsigned char>(in[pos + i])) != token.literal[i]) return false;
+      }
+      return true;
+    case Token::kAnyChar:
+      *len = 1;
+      return pos < in.size();
+    case Token::kCharSet:
+      *len = 1;
+      return pos < in.size() && token.chars.test(static_cast<unsigned char>(in[pos]));
+    default:
+      return false;
+  }
+}
+
+bool GlobPattern::Match(std::string_view in) const {
+  // Backtracking to the last `*` is enough, since the segment after it could match anywhere later
+  size_t ti = 0, pos = 0, star_ti = tokens_.size(), star_pos = 0;
+  while (true) {
+    if (ti < tokens_.size()) {
+      const auto &token = tokens_[ti];
+      if (token.kind == Token::kAnyString) {
+        if (ti + 1 == tokens_.size()) return true;
+        star_ti = ti++;
+        star_pos = pos;
+        continue;
+      }
+      size_t len = 0;
+      if (matchToken(token, in, pos, &len)) {
+        ti++;
+        pos += len;
+        continue;
+      }
+    } else if (pos == in.size()) {
+      return true;
+    }
+
+    if (star_ti == tokens_.size() || star_pos >= in.size()) return false;
+    star_pos++;
+    const auto &next = tokens_[star_ti + 1];
+    if (next.kind == Token::kLiteral && !nocase_) {
+      star_pos = in.find(next.literal, star_pos);
+      if (star_pos == std::string_view::npos) return false;
+    }
+    ti = star_ti + 1;
+    pos = star_pos;
+  }
+}
+
 std::string StringToHex(const std::string &input) {
   static const char hex_digits[] = "0123456789ABCDEF";
   std::string output;
@@ -238,6 +358,24 @@ std::string StringToHex(const std::string &input) {
   return output;
 }
 
+bool HexToString(const std::string &input, std::string *output) {
+  if (input.size() % 2 != 0) return false;
+  auto digit = [](char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+  };
+  output->clear();
+  output->reserve(input.size() / 2);
+  for (size_t i = 0; i < input.size(); i += 2) {
+    int high = digit(input[i]), low = digit(input[i + 1]);
+    if (high < 0 || low < 0) return false;
+    output->push_back(static_cast<char>(high << 4 | low));
+  }
+  return true;
+}
+
 constexpr unsigned long long expTo1024(unsigned n) { return 1ULL << (n * 10); }
 
 void BytesToHuman(char *buf, size_t size, uint64_t n) {
@@ -20,6 +20,9 @@
 
 #pragma once
 
+#include <bitset>
+#include <string_view>
+
 #include "status.h"
 
 namespace Util {
@@ -37,6 +40,36 @@ bool HasPrefix(const std::string &str, const std::string &prefix);
 int StringMatch(const std::string &pattern, const std::string &in, int nocase);
 int StringMatchLen(const char *p, int plen, const char *s, int slen, int nocase);
 std::string StringToHex(const std::string &input);
+// Return false if the input isn't the hex string of even length
+bool HexToString(const std::string &input, std::string *output);
 std::vector<std::string> TokenizeRedisProtocol(const std::string &value);
 
+// GlobPattern is the glob-style pattern of StringMatch compiled once, so matching many strings like
+// the keys of SCAN or the channels of PSUBSCRIBE doesn't interpret the pattern again and again.
+// The literal segments after `*` are located by searching rather than backtracking char by char.
+class GlobPattern {
+ public:
+  explicit GlobPattern(std::string_view pattern, bool nocase = false);
+
+  bool Match(std::string_view in) const;
+  // All the matched strings begin with the literal prefix, so it could be used as the seek key
+  const std::string &LiteralPrefix() const { return prefix_; }
+  // Whether the pattern is `prefix*`, so every string with the literal prefix is matched
+  bool MatchesAllWithPrefix() const { return all_with_prefix_; }
+
+ private:
+  struct Token {
+    enum Kind { kLiteral, kAnyChar, kAnyString, kCharSet } kind;
+    std::string literal;
+    std::bitset<256> chars;
+  };
+
+  bool matchToken(const Token &token, std::string_view in, size_t pos, size_t *len) const;
+
+  std::vector<Token> tokens_;
+  std::string prefix_;
+  bool all_with_prefix_ = false;
+  bool nocase_ = false;
+};
+
 }  // namespace Util
@@ -20,29 +20,57 @@
 
 #include "task_runner.h"
 
+#include <glog/logging.h>
+
+#include <algorithm>
 #include <thread>
 
 #include "thread_util.h"
+#include "time_util.h"
 
-Status TaskRunner::Publish(const Task &task) {
-  std::lock_guard<std::mutex> guard(mu_);
+bool TaskHandle::Cancel() {
+  if (!state_) return false;
+  int expected = kPending;
+  return state_->compare_exchange_strong(expected, kCancelled) || expected == kCancelled;
+}
+
+TaskRunner::TaskRunner(int n_thread, uint32_t max_queue_size) : max_queue_size_(max_queue_size), n_thread_(n_thread) {
+  for (int i = 0; i < std::max(n_thread, 1); i++) {
+    queues_.emplace_back(std::make_unique<ThreadQueue>());
+  }
+}
+
+Status TaskRunner::Publish(const Task &task, TaskPriority priority, const std::string &type, TaskHandle *handle) {
   if (stop_) {
     return Status(Status::NotOK, "the runner was stopped");
   }
-  if (task_queue_.size() >= max_queue_size_) {
+  if (pending_.fetch_add(1) >= max_queue_size_) {
+    pending_--;
     return Status(Status::NotOK, "the task queue was reached max length");
   }
-  task_queue_.emplace_back(task);
-  cond_.notify_all();
+  auto state = std::make_shared<std::atomic<int>>(TaskHandle::kPending);
+  if (handle) handle->state_ = state;
+  auto &queue = queues_[next_queue_.fetch_add(1) % queues_.size()];
+  {
+    std::lock_guard<std::mutex> guard(queue->mu);
+    queue->items[static_cast<size_t>(priority)].push_back(Item{task, type, std::move(state), Util::GetTimeStampUS()});
+  }
+  // Lock to avoid losing the notification between the check and the wait of the threads
+  std::lock_guard<std::mutex> guard(mu_);
+  cond_.notify_one();
   return Status::OK();
 }
 
 void TaskRunner::Start() {
   stop_ = false;
   for (int i = 0; i < n_thread_; i++) {
-    threads_.emplace_back(std::thread([this]() {
+    threads_.emplace_back(std::thread([this, i]() {
       Util::ThreadSetName("task-runner");
-      this->run();
+      if (auto s = Util::ThreadSetAffinity(cpus_); !s.IsOK()) {
+        LOG(WARNING) << "Failed to set the cpu affinity of task runner, err: " << s.Msg();
+      }
+      if (thread_initializer_) thread_initializer_();
+      this->run(i);
     }));
   }
 }
@@ -60,25 +88,75 @@ void TaskRunner::Join() {
 }
 
 void TaskRunner::Purge() {
-  std::lock_guard<std::mutex> guard(mu_);
   threads_.clear();
-  task_queue_.clear();
+  clear();
+}
+
+std::map<std::string, TaskStats> TaskRunner::GetStats() {
+  std::lock_guard<std::mutex> guard(stats_mu_);
+  return stats_;
+}
+
+void TaskRunner::clear() {
+  for (auto &queue : queues_) {
+    std::lock_guard<std::mutex> guard(queue->mu);
+    for (auto &items : queue->items) {
+      pending_ -= items.size();
+      items.clear();
+    }
+  }
+}
+
+// Take the task of the highest priority, from the own deque first, then steal from the others
+bool TaskRunner::take(size_t index, Item *item) {
+  for (size_t priority = 0; priority < kPriorities; priority++) {
+    for (size_t i = 0; i < queues_.size(); i++) {
+      auto &queue = queues_[(index + i) % queues_.size()];
+      std::lock_guard<std::mutex> guard(queue->mu);
+      auto &items = queue->items[priority];
+      if (items.empty()) continue;
+      *item = std::move(items.front());
+      items.pop_front();
+      pending_--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void TaskRunner::execute(Item *item) {
+  int expected = TaskHandle::kPending;
+  bool cancelled = !item->state->compare_exchange_strong(expected, TaskHandle::kRunning);
+  uint64_t start_us = Util::GetTimeStampUS();
+  if (!cancelled && item->task) item->task();
+  uint64_t end_us = Util::GetTimeStampUS();
+
+  uint64_t wait_us = start_us > item->publish_us ? start_us - item->publish_us : 0;
+  uint64_t run_us = end_us > start_us ? end_us - start_us : 0;
+  std::lock_guard<std::mutex> guard(stats_mu_);
+  auto &stats = stats_[item->type.empty() ? "unknown" : item->type];
+  if (cancelled) {
+    stats.cancelled++;
+    return;
+  }
+  stats.calls++;
+  stats.wait_us += wait_us;
+  stats.max_wait_us = std::max(stats.max_wait_us, wait_us);
+  stats.run_us += run_us;
+  stats.max_run_us = std::max(stats.max_run_us, run_us);
 }
 
-void TaskRunner::run() {
-  Task task;
-  std::unique_lock<std::mutex> lock(mu_);
+void TaskRunner::run(size_t index) {
+  Item item;
   while (!stop_) {
-    cond_.wait(lock, [this]() -> bool { return stop_ || !task_queue_.empty(); });
-    while (!stop_ && !task_queue_.empty()) {
-      task = task_queue_.front();
-      task_queue_.pop_front();
-      lock.unlock();
-      if (task) task();
-      lock.lock();
+    if (take(index % queues_.size(), &item)) {
+      execute(&item);
+      item = Item{};
+      continue;
     }
+    std::unique_lock<std::mutex> lock(mu_);
+    cond_.wait(lock, [this]() -> bool { return stop_ || pending_ > 0; });
   }
-  task_queue_.clear();
-  lock.unlock();
   // CAUTION: drop the rest of tasks, don't use task runner if the task can't be drop
+  clear();
 }
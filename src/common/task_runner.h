@@ -20,37 +20,102 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <functional>
-#include <list>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include "status.h"
 
 using Task = std::function<void()>;
 
+// The tasks of the higher priority are always taken before the lower ones
+enum class TaskPriority { kUrgent = 0, kNormal = 1, kBackground = 2 };
+
+// TaskHandle cancels the published task if it hasn't started
+class TaskHandle {
+ public:
+  TaskHandle() = default;
+  // Return true if the task would never run
+  bool Cancel();
+  bool IsCancelled() const { return state_ && state_->load() == kCancelled; }
+
+ private:
+  friend class TaskRunner;
+  enum State { kPending = 0, kRunning = 1, kCancelled = 2 };
+  std::shared_ptr<std::atomic<int>> state_;
+};
+
+// The stats of the tasks of the same type
+struct TaskStats {
+  uint64_t calls = 0;
+  uint64_t cancelled = 0;
+  uint64_t wait_us = 0;
+  uint64_t max_wait_us = 0;
+  uint64_t run_us = 0;
+  uint64_t max_run_us = 0;
+};
+
+// TaskRunner runs the tasks in the threads, every thread owns a deque per priority. The tasks
+// are published to the threads in turn, and the idle thread steals the tasks from the others
+// before waiting, so a long task only delays the tasks queued in the same deque until stolen.
 class TaskRunner {
  public:
-  explicit TaskRunner(int n_thread = 1, uint32_t max_queue_size = 10240)
-      : max_queue_size_(max_queue_size), n_thread_(n_thread) {}
+  explicit TaskRunner(int n_thread = 1, uint32_t max_queue_size = 10240);
   ~TaskRunner() = default;
-  Status Publish(const Task &task);
-  size_t QueueSize() { return task_queue_.size(); }
+  Status Publish(const Task &task) { return Publish(task, TaskPriority::kNormal); }
+  // The type of the task is used to aggregate the stats, and the handle can cancel the task
+  Status Publish(const Task &task, TaskPriority priority, const std::string &type = "", TaskHandle *handle = nullptr);
+  size_t QueueSize() { return pending_.load(); }
+  // The threads would be bound to the CPUs when started
+  void SetCPUAffinity(std::vector<int> cpus) { cpus_ = std::move(cpus); }
+  // The initializer would be invoked by every thread before running any task
+  void SetThreadInitializer(Task initializer) { thread_initializer_ = std::move(initializer); }
   void Start();
   void Stop();
   void Join();
   void Purge();
+  std::map<std::string, TaskStats> GetStats();
 
  private:
-  void run();
-  bool stop_ = false;
+  struct Item {
+    Task task;
+    std::string type;
+    std::shared_ptr<std::atomic<int>> state;
+    uint64_t publish_us = 0;
+  };
+  static constexpr size_t kPriorities = 3;
+  struct ThreadQueue {
+    std::mutex mu;
+    std::array<std::deque<Item>, kPriorities> items;
+  };
+
+  void run(size_t index);
+  bool take(size_t index, Item *item);
+  void execute(Item *item);
+  void clear();
+
+  std::atomic<bool> stop_ = false;
   uint32_t max_queue_size_;
-  std::list<Task> task_queue_;
+  std::atomic<size_t> pending_ = 0;
+  std::atomic<size_t> next_queue_ = 0;
+  std::vector<std::unique_ptr<ThreadQueue>> queues_;
+  // Only for the threads to wait for the tasks
   std::mutex mu_;
   std::condition_variable cond_;
   int n_thread_;
+  std::vector<int> cpus_;
+  Task thread_initializer_;
   std::vector<std::thread> threads_;
+  std::mutex stats_mu_;
+  std::map<std::string, TaskStats> stats_;
 };
@@ -21,9 +21,23 @@
 #include "thread_util.h"
 
 #include <pthread.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include <cstring>
+
+#include "parse_util.h"
+#include "string_util.h"
 
 namespace Util {
 
+#ifdef __linux__
+constexpr int kMaxCPUs = CPU_SETSIZE;
+#else
+constexpr int kMaxCPUs = 1024;
+#endif
+
 void ThreadSetName(const char *name) {
 #ifdef __APPLE__
   pthread_setname_np(name);
@@ -32,4 +46,50 @@ void ThreadSetName(const char *name) {
 #endif
 }
 
+StatusOr<std::vector<int>> ParseCPUList(const std::string &cpu_list) {
+  std::vector<int> cpus;
+  for (const auto &item : Split(cpu_list, ",")) {
+    auto range = Split(item, "-");
+    if (range.empty() || range.size() > 2) {
+      return {Status::NotOK, "invalid cpu range: " + item};
+    }
+    auto first = ParseInt<int>(range[0], {0, kMaxCPUs - 1}, 10);
+    if (!first) {
+      return {Status::NotOK, "invalid cpu id: " + range[0]};
+    }
+    int last = *first;
+    if (range.size() == 2) {
+      auto parse_result = ParseInt<int>(range[1], {0, kMaxCPUs - 1}, 10);
+      if (!parse_result) {
+        return {Status::NotOK, "invalid cpu id: " + range[1]};
+      }
+      last = *parse_result;
+      if (last < *first) {
+        return {Status::NotOK, "invalid cpu range: " + item};
+      }
+    }
+    for (int cpu = *first; cpu <= last; cpu++) {
+      cpus.emplace_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+Status ThreadSetAffinity(const std::vector<int> &cpus) {
+  if (cpus.empty()) return Status::OK();
+#ifdef __linux__
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (auto cpu : cpus) {
+    CPU_SET(cpu, &cpu_set);
+  }
+  if (int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set); err != 0) {
+    return {Status::NotOK, strerror(err)};
+  }
+  return Status::OK();
+#else
+  return {Status::NotOK, "the cpu affinity isn't supported on this platform"};
+#endif
+}
+
 }  // namespace Util
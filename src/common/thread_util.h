@@ -20,8 +20,17 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
+#include "status.h"
+
 namespace Util {
 
 void ThreadSetName(const char *name);
+// Parse the CPU list like "0-3,8,10-11" into the CPU ids
+StatusOr<std::vector<int>> ParseCPUList(const std::string &cpu_list);
+// Bind the current thread to the CPUs, do nothing if the CPUs are empty
+Status ThreadSetAffinity(const std::vector<int> &cpus);
 
 }  // namespace Util
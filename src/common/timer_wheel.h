@@ -0,0 +1,102 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// TimerWheel is a hierarchical timing wheel of the integer ticks, every level has kSlots slots,
+// and a slot of the level n spans kSlots^n ticks. The timers far from the current tick are kept
+// in the upper levels, and cascaded into the lower levels when the wheel reaches them, so that
+// advancing the wheel only touches the timers which are due or cascaded.
+template <typename T>
+class TimerWheel {
+ public:
+  static constexpr int kSlotBits = 6;
+  static constexpr uint64_t kSlots = 1 << kSlotBits;
+  static constexpr int kLevels = 4;
+  // The deadlines beyond the range are clamped, the callers should check if the timers are really due
+  static constexpr uint64_t kMaxDelay = (uint64_t(1) << (kSlotBits * kLevels)) - 1;
+
+  explicit TimerWheel(uint64_t now) : current_(now) {}
+
+  void Add(T item, uint64_t deadline) {
+    if (deadline < current_) deadline = current_;
+    if (deadline - current_ > kMaxDelay) deadline = current_ + kMaxDelay;
+    place(std::move(item), deadline);
+    size_++;
+  }
+
+  // Advance the wheel to now, the callback is invoked with every item whose deadline <= now
+  template <typename F>
+  void Advance(uint64_t now, F &&callback) {
+    // The due timers of the current tick may be added after the last advance
+    fire(callback);
+    while (current_ < now) {
+      current_++;
+      cascade();
+      fire(callback);
+    }
+  }
+
+  size_t Size() const { return size_; }
+  uint64_t Current() const { return current_; }
+
+ private:
+  using Timer = std::pair<uint64_t, T>;
+
+  void place(T &&item, uint64_t deadline) {
+    uint64_t delay = deadline - current_;
+    int level = 0;
+    while (level < kLevels - 1 && delay >= (uint64_t(1) << (kSlotBits * (level + 1)))) level++;
+    size_t slot = (deadline >> (kSlotBits * level)) & (kSlots - 1);
+    wheels_[level][slot].emplace_back(deadline, std::move(item));
+  }
+
+  // Move the timers of the upper levels which the current tick enters into the lower levels
+  void cascade() {
+    for (int level = 1; level < kLevels; level++) {
+      if ((current_ & ((uint64_t(1) << (kSlotBits * level)) - 1)) != 0) break;
+      auto &bucket = wheels_[level][(current_ >> (kSlotBits * level)) & (kSlots - 1)];
+      std::vector<Timer> timers;
+      timers.swap(bucket);
+      for (auto &timer : timers) place(std::move(timer.second), timer.first);
+    }
+  }
+
+  template <typename F>
+  void fire(F &callback) {
+    auto &bucket = wheels_[0][current_ & (kSlots - 1)];
+    if (bucket.empty()) return;
+    std::vector<Timer> timers;
+    timers.swap(bucket);
+    size_ -= timers.size();
+    // The callback may add the timers again
+    for (auto &timer : timers) callback(std::move(timer.second));
+  }
+
+  uint64_t current_;
+  size_t size_ = 0;
+  std::array<std::array<std::vector<Timer>, kSlots>, kLevels> wheels_;
+};
@@ -43,6 +43,7 @@
 #include "server/server.h"
 #include "server/tls_util.h"
 #include "status.h"
+#include "thread_util.h"
 
 const char *kDefaultNamespace = "__namespace";
 
@@ -58,6 +59,18 @@ configEnum compression_type_enum[] = {
     {"lz4", rocksdb::CompressionType::kLZ4Compression},   {"zstd", rocksdb::CompressionType::kZSTD},
     {"zlib", rocksdb::CompressionType::kZlibCompression}, {nullptr, 0}};
 
+configEnum migrate_type_enum[] = {
+    {"redis-command", kMigrateTypeRedisCommand}, {"sst", kMigrateTypeSst}, {"dump", kMigrateTypeDump}, {nullptr, 0}};
+
+configEnum filter_type_enum[] = {{"bloom", kFilterTypeBloom}, {"ribbon", kFilterTypeRibbon}, {nullptr, 0}};
+
+configEnum memtable_type_enum[] = {
+    {"skiplist", kMemtableTypeSkipList}, {"hash_skiplist", kMemtableTypeHashSkipList}, {nullptr, 0}};
+
+configEnum block_cache_type_enum[] = {{"lru", kBlockCacheTypeLRU}, {"hcc", kBlockCacheTypeHCC}, {nullptr, 0}};
+
+configEnum repl_compression_enum[] = {{"no", kReplCompressionNone}, {"zstd", kReplCompressionZstd}, {nullptr, 0}};
+
 configEnum supervised_mode_enum[] = {{"no", kSupervisedNone},
                                      {"auto", kSupervisedAutoDetect},
                                      {"upstart", kSupervisedUpStart},
@@ -69,6 +82,44 @@ std::string trimRocksDBPrefix(std::string s) {
   return s.substr(8, s.size() - 8);
 }
 
+// The zset column families share the options of the subkey column family, so do their blob thresholds
+std::vector<std::string> subkeyBlobColumnFamilies() {
+  return {Engine::kSubkeyColumnFamilyName, Engine::kZSetScoreColumnFamilyName, Engine::kZSetRankColumnFamilyName};
+}
+
+Status setMinBlobSize(Server *srv, const std::vector<std::string> &cf_names, int min_blob_size) {
+  for (const auto &cf_name : cf_names) {
+    auto s = srv->storage_->SetColumnFamilyOption("min_blob_size", std::to_string(min_blob_size), cf_name);
+    if (!s.IsOK()) return s;
+  }
+  return Status::OK();
+}
+
+// Parse the memory size like "1024", "64k", "64kb", "32mb" or "1gb",
+// the units follow redis: "k" means 1000 bytes and "kb" means 1024 bytes.
+StatusOr<uint64_t> parseMemorySize(const std::string &v) {
+  auto parse_result = TryParseInt<unsigned long long>(v.c_str(), 10);  // NOLINT
+  if (!parse_result) {
+    return {Status::NotOK, "invalid memory size: " + v};
+  }
+  auto [size, end] = *parse_result;
+  static const std::map<std::string, uint64_t> units = {
+      {"", 1},
+      {"b", 1},
+      {"k", 1000},
+      {"kb", 1024},
+      {"m", 1000 * 1000},
+      {"mb", 1024 * 1024},
+      {"g", 1000 * 1000 * 1000},
+      {"gb", 1024 * 1024 * 1024},
+  };
+  auto iter = units.find(Util::ToLower(end));
+  if (iter == units.end() || size > std::numeric_limits<uint64_t>::max() / iter->second) {
+    return {Status::NotOK, "invalid memory size: " + v};
+  }
+  return static_cast<uint64_t>(size) * iter->second;
+}
+
 int configEnumGetValue(configEnum *ce, const char *name) {
   while (ce->name != nullptr) {
     if (!strcasecmp(ce->name, name)) return ce->val;
@@ -98,6 +149,7 @@ Config::Config() {
       {"daemonize", true, new YesNoField(&daemonize, false)},
       {"bind", true, new StringField(&binds_, "")},
       {"port", true, new IntField(&port, kDefaultPort, 1, PORT_LIMIT)},
+      {"metrics-port", true, new IntField(&metrics_port, 0, 0, PORT_LIMIT)},
 #ifdef ENABLE_OPENSSL
       {"tls-port", true, new IntField(&tls_port, 0, 0, PORT_LIMIT)},
       {"tls-cert-file", false, new StringField(&tls_cert_file, "")},
@@ -113,34 +165,112 @@ Config::Config() {
       {"tls-session-caching", false, new YesNoField(&tls_session_caching, true)},
       {"tls-session-cache-size", false, new IntField(&tls_session_cache_size, 1024 * 20, 0, INT_MAX)},
       {"tls-session-cache-timeout", false, new IntField(&tls_session_cache_timeout, 300, 0, INT_MAX)},
+      {"tls-session-tickets", false, new YesNoField(&tls_session_tickets, true)},
+      {"tls-session-ticket-key-rotation", false, new IntField(&tls_session_ticket_key_rotation, 3600, 0, INT_MAX)},
+      {"tls-ktls", false, new YesNoField(&tls_ktls, false)},
+      {"tls-handshake-threads", true, new IntField(&tls_handshake_threads, 0, 0, 256)},
+      {"tls-handshake-timeout", false, new IntField(&tls_handshake_timeout, 10, 1, INT_MAX)},
 #endif
-      {"workers", true, new IntField(&workers, 8, 1, 256)},
+      {"workers", false, new IntField(&workers, 8, 1, 256)},
+      {"worker-offload-threads", true, new IntField(&worker_offload_threads, 0, 0, 256)},
+      {"worker-offload-cache-missed-reads", false, new YesNoField(&worker_offload_cache_missed_reads, false)},
+      {"lua-readonly-script-threads", true, new IntField(&lua_readonly_script_threads, 0, 0, 256)},
+      {"scan-parallel-threads", true, new IntField(&scan_parallel_threads, 0, 0, 256)},
+      {"worker-cpu-list", true, new StringField(&worker_cpu_list_, "")},
+      {"background-cpu-list", true, new StringField(&background_cpu_list_, "")},
+      {"jemalloc-dedicated-arenas", true, new YesNoField(&jemalloc_dedicated_arenas, false)},
       {"timeout", false, new IntField(&timeout, 0, 0, INT_MAX)},
       {"tcp-backlog", true, new IntField(&backlog, 511, 0, INT_MAX)},
       {"maxclients", false, new IntField(&maxclients, 10240, 0, INT_MAX)},
-      {"max-backup-to-keep", false, new IntField(&max_backup_to_keep, 1, 0, 1)},
+      {"max-backup-to-keep", false, new IntField(&max_backup_to_keep, 1, 0, INT_MAX)},
       {"max-backup-keep-hours", false, new IntField(&max_backup_keep_hours, 0, 0, INT_MAX)},
+      {"backup-incremental", false, new YesNoField(&backup_incremental, false)},
+      {"backup-max-io-mb", false, new IntField(&backup_max_io_mb, 0, 0, INT_MAX)},
+      {"backup-threads", false, new IntField(&backup_threads, 1, 1, 16)},
+      {"backup-upload-command", true, new StringField(&backup_upload_command, "")},
       {"master-use-repl-port", false, new YesNoField(&master_use_repl_port, false)},
       {"requirepass", false, new StringField(&requirepass, "")},
       {"masterauth", false, new StringField(&masterauth, "")},
       {"slaveof", true, new StringField(&slaveof_, "")},
       {"compact-cron", false, new StringField(&compact_cron_, "")},
+      {"compact-cron-parallelism", false, new IntField(&compact_cron_parallelism, 1, 1, 16)},
+      {"compact-cron-max-io-mb", false, new IntField(&compact_cron_max_io_mb, 0, 0, INT_MAX)},
+      {"compact-cron-window-minutes", false, new IntField(&compact_cron_window_minutes, 0, 0, 24 * 60)},
       {"bgsave-cron", false, new StringField(&bgsave_cron_, "")},
       {"compaction-checker-range", false, new StringField(&compaction_checker_range_, "")},
+      {"compaction-checker-tombstone-threshold", false,
+       new IntField(&compaction_checker_tombstone_threshold, 100000, 0, INT_MAX)},
+      {"namespace-column-families", true, new StringField(&namespace_column_families_, "")},
+      {"namespace-max-ops-per-sec", false, new IntField(&namespace_max_ops_per_sec, 0, 0, INT_MAX)},
+      {"namespace-max-bytes-per-sec", false, new IntField(&namespace_max_bytes_per_sec, 0, 0, INT_MAX)},
+      {"namespace-qos", false, new StringField(&namespace_qos_, "")},
+      {"namespace-pipeline-quantum", false, new IntField(&namespace_pipeline_quantum, 0, 0, INT_MAX)},
+      {"namespace-max-disk-size", false, new IntField(&namespace_max_disk_size, 0, 0, INT_MAX)},
+      {"namespace-disk-quota", false, new StringField(&namespace_disk_quota_, "")},
       {"db-name", true, new StringField(&db_name, "change.me.db")},
       {"dir", true, new StringField(&dir, "/tmp/kvrocks")},
       {"backup-dir", false, new StringField(&backup_dir, "")},
       {"log-dir", true, new StringField(&log_dir, "")},
       {"pidfile", true, new StringField(&pidfile, "")},
       {"max-io-mb", false, new IntField(&max_io_mb, 500, 0, INT_MAX)},
+      {"max-io-mb-auto-tune", false, new YesNoField(&max_io_mb_auto_tune, false)},
+      {"max-io-mb-auto-tune-read-latency-us", false,
+       new IntField(&max_io_mb_auto_tune_read_latency_us, 2000, 1, INT_MAX)},
+      {"workload-auto-tune", false, new YesNoField(&workload_auto_tune, false)},
+      {"workload-auto-tune-interval", false, new IntField(&workload_auto_tune_interval, 60, 10, 86400)},
+      {"workload-auto-tune-min-cache-ratio", false, new IntField(&workload_auto_tune_min_cache_ratio, 20, 5, 50)},
+      {"workload-auto-tune-max-background-compactions", false,
+       new IntField(&workload_auto_tune_max_background_compactions, 8, 1, 32)},
+      {"workload-auto-tune-max-write-buffer-size", false,
+       new IntField(&workload_auto_tune_max_write_buffer_size, 256, 1, 4096)},
       {"max-bitmap-to-string-mb", false, new IntField(&max_bitmap_to_string_mb, 16, 0, INT_MAX)},
+      {"write-batch-chunk-mb", false, new IntField(&write_batch_chunk_mb, 16, 0, 1024)},
       {"max-db-size", false, new IntField(&max_db_size, 0, 0, INT_MAX)},
+      {"metadata-cache-size", false, new IntField(&metadata_cache_size, 0, 0, INT_MAX)},
+      {"cache-warmup-keys", true, new IntField(&cache_warmup_keys, 0, 0, INT_MAX)},
+      {"cache-warmup-keys-per-sec", false, new IntField(&cache_warmup_keys_per_sec, 10000, 1, INT_MAX)},
+      {"scan-iterator-cache-size", false, new IntField(&scan_iterator_cache_size, 0, 0, 65536)},
+      {"scan-iterator-idle-timeout", false, new IntField(&scan_iterator_idle_timeout, 10, 1, 3600)},
+      {"lock-table-hash-power", true, new IntField(&lock_table_hash_power, 16, 10, 24)},
+      {"lazy-reclaim-min-elements", false, new IntField(&lazy_reclaim_min_elements, 1000, 0, INT_MAX)},
+      {"lazy-reclaim-max-keys-per-sec", false, new IntField(&lazy_reclaim_max_keys_per_sec, 100, 1, INT_MAX)},
+      {"lazy-expire-max-keys-per-sec", false, new IntField(&lazy_expire_max_keys_per_sec, 1000, 0, INT_MAX)},
+      {"range-delete-min-elements", false, new IntField(&range_delete_min_elements, 1000, 0, INT_MAX)},
+      {"active-expire-enabled", false, new YesNoField(&active_expire_enabled, false)},
+      {"active-expire-keys-per-cycle", false, new IntField(&active_expire_keys_per_cycle, 200, 1, INT_MAX)},
+      {"key-count-tracking", false, new YesNoField(&key_count_tracking, false)},
+      {"bigkeys-scan-rate", false, new IntField(&bigkeys_scan_rate, 0, 0, INT_MAX)},
+      {"zset-rank-index-min-size", false, new IntField(&zset_rank_index_min_size, 0, 0, INT_MAX)},
+      {"list-chunked-encoding", false, new YesNoField(&list_chunked_encoding, false)},
+      {"hash-inline-max-entries", false, new IntField(&hash_inline_max_entries, 0, 0, 512)},
+      {"hash-inline-max-bytes", false, new IntField(&hash_inline_max_bytes, 1024, 0, 64 * 1024)},
+      {"set-inline-max-entries", false, new IntField(&set_inline_max_entries, 0, 0, 512)},
+      {"set-inline-max-bytes", false, new IntField(&set_inline_max_bytes, 1024, 0, 64 * 1024)},
+      {"zset-inline-max-entries", false, new IntField(&zset_inline_max_entries, 0, 0, 512)},
+      {"zset-inline-max-bytes", false, new IntField(&zset_inline_max_bytes, 1024, 0, 64 * 1024)},
+      {"stream-entry-max-schemas", false, new IntField(&stream_entry_max_schemas, 0, 0, 64)},
+      {"bitmap-segment-containers", false, new YesNoField(&bitmap_segment_containers, false)},
+      {"sortedint-block-encoding", false, new YesNoField(&sortedint_block_encoding, false)},
+      {"string-chunked-min-bytes", false, new IntField(&string_chunked_min_bytes, 0, 0, INT_MAX)},
+      {"metadata-compact-encoding", false, new YesNoField(&metadata_compact_encoding, false)},
       {"max-replication-mb", false, new IntField(&max_replication_mb, 0, 0, INT_MAX)},
+      {"replication-compression", false,
+       new EnumField(&replication_compression, repl_compression_enum, kReplCompressionNone)},
+      {"repl-backlog-mb", true, new IntField(&repl_backlog_mb, 16, 0, 1024)},
+      {"repl-diskless-sync", false, new YesNoField(&repl_diskless_sync, false)},
+      {"wal-retention-by-replicas", true, new YesNoField(&wal_retention_by_replicas, false)},
+      {"wal-retention-replica-timeout", false,
+       new IntField(&wal_retention_replica_timeout, 3600, 1, INT_MAX)},
+      {"replica-disable-wal", false, new YesNoField(&replica_disable_wal, false)},
+      {"replica-flush-interval-sec", false, new IntField(&replica_flush_interval_sec, 60, 1, INT_MAX)},
+      {"min-replicas-to-ack", false, new IntField(&min_replicas_to_ack, 0, 0, INT_MAX)},
+      {"min-replicas-ack-timeout", false, new IntField(&min_replicas_ack_timeout, 1000, 1, INT_MAX)},
       {"supervised", true, new EnumField(&supervised_mode, supervised_mode_enum, kSupervisedNone)},
       {"slave-serve-stale-data", false, new YesNoField(&slave_serve_stale_data, true)},
       {"slave-empty-db-before-fullsync", false, new YesNoField(&slave_empty_db_before_fullsync, false)},
       {"slave-priority", false, new IntField(&slave_priority, 100, 0, INT_MAX)},
       {"slave-read-only", false, new YesNoField(&slave_readonly, true)},
+      {"write-stall-timeout-ms", false, new IntField(&write_stall_timeout_ms, 0, 0, INT_MAX)},
       {"use-rsid-psync", true, new YesNoField(&use_rsid_psync, false)},
       {"profiling-sample-ratio", false, new IntField(&profiling_sample_ratio, 0, 0, 100)},
       {"profiling-sample-record-max-len", false, new IntField(&profiling_sample_record_max_len, 256, 0, INT_MAX)},
@@ -148,24 +278,56 @@ Config::Config() {
        new IntField(&profiling_sample_record_threshold_ms, 100, 0, INT_MAX)},
       {"slowlog-log-slower-than", false, new IntField(&slowlog_log_slower_than, 200000, -1, INT_MAX)},
       {"profiling-sample-commands", false, new StringField(&profiling_sample_commands_, "")},
+      {"perf-stats-sample-interval", false, new IntField(&perf_stats_sample_interval, 1000, 0, INT_MAX)},
+      {"request-trace-sample-interval", false, new IntField(&request_trace_sample_interval, 0, 0, INT_MAX)},
       {"slowlog-max-len", false, new IntField(&slowlog_max_len, 128, 0, INT_MAX)},
+      {"hotkeys-sample-interval", false, new IntField(&hotkeys_sample_interval, 100, 0, INT_MAX)},
+      {"tracking-table-max-keys", false, new IntField(&tracking_table_max_keys, 1000000, 0, INT_MAX)},
+      {"latency-monitor-threshold", false, new IntField(&latency_monitor_threshold, 0, 0, INT_MAX)},
+      {"info-rocksdb-refresh-ms", false, new IntField(&info_rocksdb_refresh_ms, 0, 0, 3600000)},
       {"purge-backup-on-fullsync", false, new YesNoField(&purge_backup_on_fullsync, false)},
       {"rename-command", true, new MultiStringField(&rename_command_, std::vector<std::string>{})},
       {"auto-resize-block-and-sst", false, new YesNoField(&auto_resize_block_and_sst, true)},
+      {"pipeline-group-commit", false, new YesNoField(&pipeline_group_commit, false)},
+      {"pipeline-read-prefetch", false, new YesNoField(&pipeline_read_prefetch, false)},
+      {"read-coalesce-window-ms", false, new IntField(&read_coalesce_window_ms, 0, 0, 10000)},
+      {"lua-strict-key-accessing", false, new YesNoField(&lua_strict_key_accessing, false)},
+      {"lua-script-cache-size", false, new IntField(&lua_script_cache_size, 10000, 0, INT_MAX)},
+      {"client-output-buffer-limit", false,
+       new StringField(&client_output_buffer_limit_, "normal 0 0 0 pubsub 32mb 8mb 60")},
+      {"client-output-buffer-pause-mb", false, new IntField(&client_output_buffer_pause_mb, 0, 0, INT_MAX)},
+      {"pipeline-reply-cork", false, new YesNoField(&pipeline_reply_cork, true)},
+      {"client-buffer-shrink-idle", false, new IntField(&client_buffer_shrink_idle, 2, 0, INT_MAX)},
       {"fullsync-recv-file-delay", false, new IntField(&fullsync_recv_file_delay, 0, 0, INT_MAX)},
       {"cluster-enabled", true, new YesNoField(&cluster_enabled, false)},
+      {"cluster-allow-local-cross-slot", false, new YesNoField(&cluster_allow_local_cross_slot, false)},
       {"migrate-speed", false, new IntField(&migrate_speed, 4096, 0, INT_MAX)},
+      {"migrate-type", false, new EnumField(&migrate_type, migrate_type_enum, kMigrateTypeRedisCommand)},
       {"migrate-pipeline-size", false, new IntField(&pipeline_size, 16, 1, INT_MAX)},
+      {"migrate-ack-latency-target", false, new IntField(&migrate_ack_latency_target, 0, 0, INT_MAX)},
       {"migrate-sequence-gap", false, new IntField(&sequence_gap, 10000, 1, INT_MAX)},
       {"unixsocket", true, new StringField(&unixsocket, "")},
       {"unixsocketperm", true, new OctalField(&unixsocketperm, 0777, 1, INT_MAX)},
 
       /* rocksdb options */
       {"rocksdb.compression", false, new EnumField(&RocksDB.compression, compression_type_enum, 0)},
+      {"rocksdb.compression_start_level", true, new IntField(&RocksDB.compression_start_level, 2, 0, 7)},
+      {"rocksdb.metadata_compression_start_level", true,
+       new IntField(&RocksDB.metadata_compression_start_level, 2, 0, 7)},
+      {"rocksdb.subkey_compression_max_dict_bytes", true,
+       new IntField(&RocksDB.subkey_compression_max_dict_bytes, 0, 0, INT_MAX)},
+      {"rocksdb.subkey_zstd_max_train_bytes", true,
+       new IntField(&RocksDB.subkey_zstd_max_train_bytes, 0, 0, INT_MAX)},
       {"rocksdb.block_size", true, new IntField(&RocksDB.block_size, 4096, 0, INT_MAX)},
       {"rocksdb.max_open_files", false, new IntField(&RocksDB.max_open_files, 4096, -1, INT_MAX)},
+      {"rocksdb.max_file_opening_threads", true, new IntField(&RocksDB.max_file_opening_threads, 16, 1, 256)},
+      {"rocksdb.wal_sync_interval_ms", false, new IntField(&RocksDB.wal_sync_interval_ms, 0, 0, INT_MAX)},
+      {"rocksdb.manual_wal_flush", true, new YesNoField(&RocksDB.manual_wal_flush, false)},
       {"rocksdb.write_buffer_size", false, new IntField(&RocksDB.write_buffer_size, 64, 0, 4096)},
       {"rocksdb.max_write_buffer_number", false, new IntField(&RocksDB.max_write_buffer_number, 4, 0, 256)},
+      {"rocksdb.memtable_total_budget", true, new IntField(&RocksDB.memtable_total_budget, 0, 0, INT_MAX)},
+      {"rocksdb.memtable_budget_cost_to_cache", true, new YesNoField(&RocksDB.memtable_budget_cost_to_cache, false)},
+      {"rocksdb.memtable_budget_allow_stall", true, new YesNoField(&RocksDB.memtable_budget_allow_stall, false)},
       {"rocksdb.target_file_size_base", false, new IntField(&RocksDB.target_file_size_base, 128, 1, 1024)},
       {"rocksdb.max_background_compactions", false, new IntField(&RocksDB.max_background_compactions, 2, 0, 32)},
       {"rocksdb.max_background_flushes", true, new IntField(&RocksDB.max_background_flushes, 2, 0, 32)},
@@ -176,12 +338,31 @@ Config::Config() {
       {"rocksdb.max_total_wal_size", false, new IntField(&RocksDB.max_total_wal_size, 64 * 4 * 2, 0, INT_MAX)},
       {"rocksdb.disable_auto_compactions", false, new YesNoField(&RocksDB.disable_auto_compactions, false)},
       {"rocksdb.enable_pipelined_write", true, new YesNoField(&RocksDB.enable_pipelined_write, false)},
+      {"rocksdb.scan_async_io", false, new YesNoField(&RocksDB.scan_async_io, false)},
       {"rocksdb.stats_dump_period_sec", false, new IntField(&RocksDB.stats_dump_period_sec, 0, 0, INT_MAX)},
       {"rocksdb.cache_index_and_filter_blocks", true, new YesNoField(&RocksDB.cache_index_and_filter_blocks, false)},
       {"rocksdb.subkey_block_cache_size", true, new IntField(&RocksDB.subkey_block_cache_size, 2048, 0, INT_MAX)},
       {"rocksdb.metadata_block_cache_size", true, new IntField(&RocksDB.metadata_block_cache_size, 2048, 0, INT_MAX)},
+      {"rocksdb.namespace_block_cache_size", true, new IntField(&RocksDB.namespace_block_cache_size, 0, 0, INT_MAX)},
+      {"rocksdb.namespace_write_buffer_size", true, new IntField(&RocksDB.namespace_write_buffer_size, 0, 0, 4096)},
+      {"rocksdb.subkey_cold_dir", true, new StringField(&RocksDB.subkey_cold_dir, "")},
+      {"rocksdb.subkey_hot_target_size", true, new IntField(&RocksDB.subkey_hot_target_size, 102400, 1, INT_MAX)},
       {"rocksdb.share_metadata_and_subkey_block_cache", true,
        new YesNoField(&RocksDB.share_metadata_and_subkey_block_cache, true)},
+      {"rocksdb.partition_sst_by_slot", true, new YesNoField(&RocksDB.partition_sst_by_slot, false)},
+      {"rocksdb.block_cache_type", true, new EnumField(&RocksDB.block_cache_type, block_cache_type_enum, 0)},
+      {"rocksdb.compressed_secondary_cache_size", true,
+       new IntField(&RocksDB.compressed_secondary_cache_size, 0, 0, INT_MAX)},
+      {"rocksdb.block_cache_huge_pages", true, new YesNoField(&RocksDB.block_cache_huge_pages, false)},
+      {"rocksdb.memtable_huge_pages", true, new YesNoField(&RocksDB.memtable_huge_pages, false)},
+      {"rocksdb.filter_type", true, new EnumField(&RocksDB.filter_type, filter_type_enum, kFilterTypeBloom)},
+      {"rocksdb.metadata_filter_bits_per_key", true, new IntField(&RocksDB.metadata_filter_bits_per_key, 10, 1, 64)},
+      {"rocksdb.subkey_filter_bits_per_key", true, new IntField(&RocksDB.subkey_filter_bits_per_key, 10, 1, 64)},
+      {"rocksdb.subkey_optimize_filters_for_hits", true,
+       new YesNoField(&RocksDB.subkey_optimize_filters_for_hits, false)},
+      {"rocksdb.subkey_memtable_type", true,
+       new EnumField(&RocksDB.subkey_memtable_type, memtable_type_enum, kMemtableTypeSkipList)},
+      {"rocksdb.memtable_bloom_size_ratio", true, new IntField(&RocksDB.memtable_bloom_size_ratio, 10, 0, 25)},
       {"rocksdb.row_cache_size", true, new IntField(&RocksDB.row_cache_size, 0, 0, INT_MAX)},
       {"rocksdb.compaction_readahead_size", false,
        new IntField(&RocksDB.compaction_readahead_size, 2 * MiB, 0, 64 * MiB)},
@@ -196,6 +377,10 @@ Config::Config() {
       {"rocksdb.enable_blob_garbage_collection", false, new YesNoField(&RocksDB.enable_blob_garbage_collection, true)},
       {"rocksdb.blob_garbage_collection_age_cutoff", false,
        new IntField(&RocksDB.blob_garbage_collection_age_cutoff, 25, 0, 100)},
+      {"rocksdb.metadata_min_blob_size", false, new IntField(&RocksDB.metadata_min_blob_size, -1, -1, INT_MAX)},
+      {"rocksdb.subkey_min_blob_size", false, new IntField(&RocksDB.subkey_min_blob_size, -1, -1, INT_MAX)},
+      {"rocksdb.stream_min_blob_size", false, new IntField(&RocksDB.stream_min_blob_size, -1, -1, INT_MAX)},
+      {"rocksdb.blob_cache_size", true, new IntField(&RocksDB.blob_cache_size, 0, 0, INT_MAX)},
       {"rocksdb.max_bytes_for_level_base", false,
        new IntField(&RocksDB.max_bytes_for_level_base, 268435456, 0, INT_MAX)},
       {"rocksdb.max_bytes_for_level_multiplier", false,
@@ -241,6 +426,13 @@ void Config::initFieldValidator() {
          }
          return Status::OK();
        }},
+      {"rocksdb.wal_sync_interval_ms",
+       [this](const std::string &k, const std::string &v) -> Status {
+         if (RocksDB.manual_wal_flush && v == "0") {
+           return Status(Status::NotOK, "rocksdb.wal_sync_interval_ms can't be 0 if rocksdb.manual_wal_flush is yes");
+         }
+         return Status::OK();
+       }},
       {"compact-cron",
        [this](const std::string &k, const std::string &v) -> Status {
          std::vector<std::string> args = Util::Split(v, " \t");
@@ -272,6 +464,49 @@ void Config::initFieldValidator() {
          compaction_checker_range.Stop = stop;
          return Status::OK();
        }},
+      {"worker-cpu-list",
+       [this](const std::string &k, const std::string &v) -> Status {
+         auto cpus = Util::ParseCPUList(v);
+         if (!cpus) return cpus.ToStatus();
+         worker_cpus = std::move(*cpus);
+         return Status::OK();
+       }},
+      {"background-cpu-list",
+       [this](const std::string &k, const std::string &v) -> Status {
+         auto cpus = Util::ParseCPUList(v);
+         if (!cpus) return cpus.ToStatus();
+         background_cpus = std::move(*cpus);
+         return Status::OK();
+       }},
+      {"client-output-buffer-limit",
+       [this](const std::string &k, const std::string &v) -> Status {
+         std::vector<std::string> args = Util::Split(v, " \t");
+         if (args.size() % 4 != 0) {
+           return {Status::NotOK, "the limit should be in the format: <class> <hard limit> <soft limit> <soft seconds>"};
+         }
+         auto normal_limit = normal_output_buffer_limit, pubsub_limit = pubsub_output_buffer_limit;
+         for (size_t i = 0; i < args.size(); i += 4) {
+           OutputBufferLimit *limit = nullptr;
+           auto client_class = Util::ToLower(args[i]);
+           if (client_class == "normal") {
+             limit = &normal_limit;
+           } else if (client_class == "pubsub") {
+             limit = &pubsub_limit;
+           } else {
+             return {Status::NotOK, "invalid client class: " + args[i] + ", it should be normal or pubsub"};
+           }
+           auto hard_limit = parseMemorySize(args[i + 1]);
+           if (!hard_limit) return hard_limit.ToStatus();
+           auto soft_limit = parseMemorySize(args[i + 2]);
+           if (!soft_limit) return soft_limit.ToStatus();
+           auto soft_seconds = ParseInt<int>(args[i + 3], {0, INT_MAX}, 10);
+           if (!soft_seconds) return {Status::NotOK, "invalid soft seconds: " + args[i + 3]};
+           *limit = {*hard_limit, *soft_limit, *soft_seconds};
+         }
+         normal_output_buffer_limit = normal_limit;
+         pubsub_output_buffer_limit = pubsub_limit;
+         return Status::OK();
+       }},
       {"rename-command",
        [](const std::string &k, const std::string &v) -> Status {
          std::vector<std::string> all_args = Util::Split(v, "\n");
@@ -294,6 +529,7 @@ void Config::initFieldValidator() {
            }
            commands->erase(cmd_iter);
          }
+         Redis::RefreshCommandLookup();
          return Status::OK();
        }},
   };
@@ -373,6 +609,11 @@ void Config::initFieldCallback() {
          binds = std::move(args);
          return Status::OK();
        }},
+      {"workers",
+       [this](Server *srv, const std::string &k, const std::string &v) -> Status {
+         if (!srv) return Status::OK();
+         return srv->ResizeWorkers(workers);
+       }},
       {"maxclients",
        [](Server *srv, const std::string &k, const std::string &v) -> Status {
          if (!srv) return Status::OK();
@@ -396,6 +637,57 @@ void Config::initFieldCallback() {
          }
          return Status::OK();
        }},
+      {"namespace-column-families",
+       [this](Server *srv, const std::string &k, const std::string &v) -> Status {
+         namespace_column_families.clear();
+         for (const auto &ns : Util::Split(v, ",")) {
+           if (ns.size() > UINT8_MAX) return {Status::NotOK, "the namespace is too long: " + ns};
+           namespace_column_families.emplace_back(ns);
+         }
+         return Status::OK();
+       }},
+      {"namespace-qos",
+       [this](Server *srv, const std::string &k, const std::string &v) -> Status {
+         // The QoS of each namespace is <namespace>:<max ops/s>:<max bytes/s>[:<weight>]
+         std::map<std::string, NamespaceQoSSpec> qos;
+         for (const auto &entry : Util::Split(v, ",")) {
+           auto fields = Util::Split(entry, ":");
+           if (fields.size() != 3 && fields.size() != 4) return {Status::NotOK, "invalid namespace QoS: " + entry};
+           auto ops = ParseInt<int>(fields[1], NumericRange<int>{0, INT_MAX}, 10);
+           auto bytes = ParseInt<int>(fields[2], NumericRange<int>{0, INT_MAX}, 10);
+           if (!ops || !bytes) return {Status::NotOK, "invalid namespace QoS: " + entry};
+           int weight = 1;
+           if (fields.size() == 4) {
+             auto parse_weight = ParseInt<int>(fields[3], NumericRange<int>{1, 1000}, 10);
+             if (!parse_weight) return {Status::NotOK, "invalid namespace QoS: " + entry};
+             weight = *parse_weight;
+           }
+           qos[fields[0]] = {static_cast<uint64_t>(*ops), static_cast<uint64_t>(*bytes), weight};
+         }
+         namespace_qos = std::move(qos);
+         return Status::OK();
+       }},
+      {"namespace-max-disk-size",
+       [](Server *srv, const std::string &k, const std::string &v) -> Status {
+         if (!srv) return Status::OK();
+         srv->ReconcileNamespaceSizes();
+         return Status::OK();
+       }},
+      {"namespace-disk-quota",
+       [this](Server *srv, const std::string &k, const std::string &v) -> Status {
+         // The disk quota of each namespace is <namespace>:<max disk size in MB>
+         std::map<std::string, uint64_t> quota;
+         for (const auto &entry : Util::Split(v, ",")) {
+           auto fields = Util::Split(entry, ":");
+           if (fields.size() != 2) return {Status::NotOK, "invalid namespace disk quota: " + entry};
+           auto size = ParseInt<int>(fields[1], NumericRange<int>{0, INT_MAX}, 10);
+           if (!size) return {Status::NotOK, "invalid namespace disk quota: " + entry};
+           quota[fields[0]] = static_cast<uint64_t>(*size);
+         }
+         namespace_disk_quota = std::move(quota);
+         if (srv) srv->ReconcileNamespaceSizes();
+         return Status::OK();
+       }},
       {"profiling-sample-commands",
        [this](Server *srv, const std::string &k, const std::string &v) -> Status {
          std::vector<std::string> cmds = Util::Split(v, ",");
@@ -427,12 +719,55 @@ void Config::initFieldCallback() {
          srv->storage_->CheckDBSizeLimit();
          return Status::OK();
        }},
+      {"metadata-cache-size",
+       [this](Server *srv, const std::string &k, const std::string &v) -> Status {
+         if (!srv) return Status::OK();
+         srv->storage_->GetMetadataCache()->SetCapacity(static_cast<size_t>(metadata_cache_size) * MiB);
+         return Status::OK();
+       }},
+      {"key-count-tracking",
+       [](Server *srv, const std::string &k, const std::string &v) -> Status {
+         if (!srv) return Status::OK();
+         // The counter would be rebuilt by the server cron if the tracking is enabled
+         srv->storage_->GetKeyCounter()->Clear();
+         return Status::OK();
+       }},
+      {"latency-monitor-threshold",
+       [this](Server *srv, const std::string &k, const std::string &v) -> Status {
+         if (!srv) return Status::OK();
+         srv->storage_->GetLatencyMonitor()->SetThreshold(latency_monitor_threshold);
+         return Status::OK();
+       }},
+      {"bigkeys-scan-rate",
+       [this](Server *srv, const std::string &k, const std::string &v) -> Status {
+         if (!srv) return Status::OK();
+         srv->storage_->GetBigKeys()->SetEnabled(bigkeys_scan_rate > 0);
+         return Status::OK();
+       }},
       {"max-io-mb",
        [this](Server *srv, const std::string &k, const std::string &v) -> Status {
          if (!srv) return Status::OK();
          srv->storage_->SetIORateLimit(static_cast<uint64_t>(max_io_mb));
          return Status::OK();
        }},
+      {"replica-disable-wal",
+       [this](Server *srv, const std::string &k, const std::string &v) -> Status {
+         if (!srv || replica_disable_wal) return Status::OK();
+         // The batches applied without the WAL are persisted before the WAL is written again
+         return srv->storage_->FlushReplicaWrites();
+       }},
+      {"metadata-compact-encoding",
+       [this](Server *srv, const std::string &k, const std::string &v) -> Status {
+         Metadata::SetCompactEncoding(metadata_compact_encoding);
+         return Status::OK();
+       }},
+      {"max-io-mb-auto-tune",
+       [this](Server *srv, const std::string &k, const std::string &v) -> Status {
+         if (!srv) return Status::OK();
+         // Restore the static limit, the tuned one would start from it as well
+         srv->storage_->SetIORateLimit(static_cast<uint64_t>(max_io_mb));
+         return Status::OK();
+       }},
       {"profiling-sample-record-max-len",
        [this](Server *srv, const std::string &k, const std::string &v) -> Status {
          if (!srv) return Status::OK();
@@ -451,6 +786,12 @@ void Config::initFieldCallback() {
          if (cluster_enabled) srv->slot_migrate_->SetPipelineSize(pipeline_size);
          return Status::OK();
        }},
+      {"migrate-ack-latency-target",
+       [this](Server *srv, const std::string &k, const std::string &v) -> Status {
+         if (!srv) return Status::OK();
+         if (cluster_enabled) srv->slot_migrate_->SetAckLatencyTarget(migrate_ack_latency_target);
+         return Status::OK();
+       }},
       {"migrate-sequence-gap",
        [this](Server *srv, const std::string &k, const std::string &v) -> Status {
          if (!srv) return Status::OK();
@@ -492,7 +833,45 @@ void Config::initFieldCallback() {
          if (!RocksDB.enable_blob_files) {
            return Status(Status::NotOK, errNotEnableBlobDB);
          }
-         return srv->storage_->SetColumnFamilyOption(trimRocksDBPrefix(k), v);
+         auto s = srv->storage_->SetColumnFamilyOption(trimRocksDBPrefix(k), v);
+         if (!s.IsOK()) return s;
+         // The column families with their own thresholds keep them
+         if (RocksDB.metadata_min_blob_size >= 0) {
+           s = setMinBlobSize(srv, {Engine::kMetadataColumnFamilyName}, RocksDB.metadata_min_blob_size);
+           if (!s.IsOK()) return s;
+         }
+         if (RocksDB.subkey_min_blob_size >= 0) {
+           s = setMinBlobSize(srv, subkeyBlobColumnFamilies(), RocksDB.subkey_min_blob_size);
+           if (!s.IsOK()) return s;
+         }
+         if (RocksDB.stream_min_blob_size >= 0) {
+           return setMinBlobSize(srv, {Engine::kStreamColumnFamilyName}, RocksDB.stream_min_blob_size);
+         }
+         return Status::OK();
+       }},
+      {"rocksdb.metadata_min_blob_size",
+       [this](Server *srv, const std::string &k, const std::string &v) -> Status {
+         if (!srv) return Status::OK();
+         if (!RocksDB.enable_blob_files) {
+           return Status(Status::NotOK, errNotEnableBlobDB);
+         }
+         return setMinBlobSize(srv, {Engine::kMetadataColumnFamilyName}, RocksDB.MetadataMinBlobSize());
+       }},
+      {"rocksdb.subkey_min_blob_size",
+       [this](Server *srv, const std::string &k, const std::string &v) -> Status {
+         if (!srv) return Status::OK();
+         if (!RocksDB.enable_blob_files) {
+           return Status(Status::NotOK, errNotEnableBlobDB);
+         }
+         return setMinBlobSize(srv, subkeyBlobColumnFamilies(), RocksDB.SubkeyMinBlobSize());
+       }},
+      {"rocksdb.stream_min_blob_size",
+       [this](Server *srv, const std::string &k, const std::string &v) -> Status {
+         if (!srv) return Status::OK();
+         if (!RocksDB.enable_blob_files) {
+           return Status(Status::NotOK, errNotEnableBlobDB);
+         }
+         return setMinBlobSize(srv, {Engine::kStreamColumnFamilyName}, RocksDB.StreamMinBlobSize());
        }},
       {"rocksdb.blob_file_size",
        [this](Server *srv, const std::string &k, const std::string &v) -> Status {
@@ -578,6 +957,9 @@ void Config::initFieldCallback() {
       {"tls-session-caching", set_tls_option},
       {"tls-session-cache-size", set_tls_option},
       {"tls-session-cache-timeout", set_tls_option},
+      {"tls-session-tickets", set_tls_option},
+      {"tls-session-ticket-key-rotation", set_tls_option},
+      {"tls-ktls", set_tls_option},
 #endif
   };
   for (const auto &iter : callbacks) {
@@ -643,6 +1025,22 @@ Status Config::finish() {
   if ((cluster_enabled) && !tokens.empty()) {
     return Status(Status::NotOK, "enabled cluster mode wasn't allowed while the namespace exists");
   }
+  // The slot migration only knows the shared column families
+  if (cluster_enabled && !namespace_column_families.empty()) {
+    return Status(Status::NotOK, "namespace-column-families isn't allowed in cluster mode");
+  }
+  if (RocksDB.manual_wal_flush && RocksDB.wal_sync_interval_ms == 0) {
+    return Status(Status::NotOK, "rocksdb.manual_wal_flush requires a non-zero rocksdb.wal_sync_interval_ms");
+  }
+  if (RocksDB.block_cache_type != kBlockCacheTypeLRU && RocksDB.compressed_secondary_cache_size > 0) {
+    return Status(Status::NotOK, "rocksdb.compressed_secondary_cache_size is only supported by the lru block cache");
+  }
+  if (RocksDB.subkey_zstd_max_train_bytes > 0 &&
+      (RocksDB.compression != rocksdb::CompressionType::kZSTD || RocksDB.subkey_compression_max_dict_bytes == 0)) {
+    return Status(Status::NotOK,
+                  "rocksdb.subkey_zstd_max_train_bytes requires the zstd compression and "
+                  "rocksdb.subkey_compression_max_dict_bytes");
+  }
   if (unixsocket.empty() && binds.size() == 0) {
     binds.emplace_back(kDefaultBindAddress);
   }
@@ -658,6 +1056,9 @@ Status Config::finish() {
   if (backup_dir.empty()) backup_dir = dir + "/backup";
   if (log_dir.empty()) log_dir = dir;
   if (pidfile.empty()) pidfile = dir + "/kvrocks.pid";
+  if (!RocksDB.subkey_cold_dir.empty() && RocksDB.subkey_cold_dir == db_dir) {
+    return Status(Status::NotOK, "rocksdb.subkey_cold_dir should be different from the db dir");
+  }
   std::vector<std::string> createDirs = {dir};
   for (const auto &name : createDirs) {
     auto s = rocksdb::Env::Default()->CreateDirIfMissing(name);
@@ -835,6 +1236,22 @@ Status Config::GetNamespace(const std::string &ns, std::string *token) {
   return Status(Status::NotFound);
 }
 
+NamespaceQoSSpec Config::GetNamespaceQoS(const std::string &ns) const {
+  auto iter = namespace_qos.find(ns);
+  if (iter != namespace_qos.end()) return iter->second;
+  // The default namespace is used by the admin, it isn't limited unless it's in namespace-qos
+  if (ns == kDefaultNamespace) return {};
+  return {static_cast<uint64_t>(namespace_max_ops_per_sec), static_cast<uint64_t>(namespace_max_bytes_per_sec), 1};
+}
+
+uint64_t Config::GetNamespaceDiskQuota(const std::string &ns) const {
+  // The default namespace is limited by max-db-size with the others together
+  if (ns == kDefaultNamespace) return 0;
+  auto iter = namespace_disk_quota.find(ns);
+  if (iter != namespace_disk_quota.end()) return iter->second * MiB;
+  return static_cast<uint64_t>(namespace_max_disk_size) * MiB;
+}
+
 Status Config::SetNamespace(const std::string &ns, const std::string &token) {
   if (ns == kDefaultNamespace) {
     return Status(Status::NotOK, "forbidden to update the default namespace");
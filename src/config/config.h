@@ -43,6 +43,16 @@ constexpr const uint16_t PORT_LIMIT = 65535;
 
 enum SupervisedMode { kSupervisedNone = 0, kSupervisedAutoDetect, kSupervisedSystemd, kSupervisedUpStart };
 
+enum MigrateType { kMigrateTypeRedisCommand = 0, kMigrateTypeSst, kMigrateTypeDump };
+
+enum BlockCacheType { kBlockCacheTypeLRU = 0, kBlockCacheTypeHCC };
+
+enum FilterType { kFilterTypeBloom = 0, kFilterTypeRibbon };
+
+enum MemtableType { kMemtableTypeSkipList = 0, kMemtableTypeHashSkipList };
+
+enum ReplCompression { kReplCompressionNone = 0, kReplCompressionZstd };
+
 constexpr const char *TLS_AUTH_CLIENTS_NO = "no";
 constexpr const char *TLS_AUTH_CLIENTS_OPTIONAL = "optional";
 
@@ -52,6 +62,7 @@ constexpr const size_t GiB = 1024L * MiB;
 constexpr const int kDefaultPort = 6666;
 
 extern const char *kDefaultNamespace;
+extern configEnum compression_type_enum[];
 
 struct CompactionCheckerRange {
  public:
@@ -61,6 +72,22 @@ struct CompactionCheckerRange {
   bool Enabled() { return Start != -1 || Stop != -1; }
 };
 
+// The QoS of a namespace, the limits are 0 if unlimited, and the weight is the share of the worker
+// when its pipelines are scheduled with the others
+struct NamespaceQoSSpec {
+  uint64_t max_ops_per_sec = 0;
+  uint64_t max_bytes_per_sec = 0;
+  int weight = 1;
+};
+
+struct OutputBufferLimit {
+  uint64_t hard_limit = 0;
+  uint64_t soft_limit = 0;
+  int soft_seconds = 0;
+
+  bool Enabled() const { return hard_limit != 0 || soft_limit != 0; }
+};
+
 struct CLIOptions {
   std::string conf_file;
   std::vector<std::pair<std::string, std::string>> cli_options;
@@ -75,6 +102,7 @@ struct Config {
   ~Config() = default;
   int port = 0;
   int tls_port = 0;
+  int metrics_port = 0;
   std::string tls_cert_file;
   std::string tls_key_file;
   std::string tls_key_file_pass;
@@ -88,15 +116,35 @@ struct Config {
   bool tls_session_caching = true;
   int tls_session_cache_size = 1024 * 20;
   int tls_session_cache_timeout = 300;
+  bool tls_session_tickets = true;
+  int tls_session_ticket_key_rotation = 3600;
+  bool tls_ktls = false;
+  int tls_handshake_threads = 0;
+  int tls_handshake_timeout = 10;
   int workers = 0;
+  int worker_offload_threads = 0;
+  bool worker_offload_cache_missed_reads = false;
+  int lua_readonly_script_threads = 0;
+  int scan_parallel_threads = 0;
+  std::vector<int> worker_cpus;
+  std::vector<int> background_cpus;
+  bool jemalloc_dedicated_arenas = false;
   int timeout = 0;
   int loglevel = 0;
   int backlog = 511;
   int maxclients = 10000;
   int max_backup_to_keep = 1;
   int max_backup_keep_hours = 24;
+  bool backup_incremental = false;
+  int backup_max_io_mb = 0;
+  int backup_threads = 1;
+  std::string backup_upload_command;
   int slowlog_log_slower_than = 100000;
   int slowlog_max_len = 128;
+  int hotkeys_sample_interval = 100;
+  int tracking_table_max_keys = 1000000;
+  int latency_monitor_threshold = 0;
+  int info_rocksdb_refresh_ms = 0;
   bool daemonize = false;
   int supervised_mode = kSupervisedNone;
   bool slave_readonly = true;
@@ -104,12 +152,67 @@ struct Config {
   bool slave_empty_db_before_fullsync = false;
   int slave_priority = 100;
   int max_db_size = 0;
+  int write_stall_timeout_ms = 0;
   int max_replication_mb = 0;
+  int replication_compression = kReplCompressionNone;
+  int repl_backlog_mb = 16;
+  bool repl_diskless_sync = false;
+  bool wal_retention_by_replicas = false;
+  int wal_retention_replica_timeout = 3600;
+  bool replica_disable_wal = false;
+  int replica_flush_interval_sec = 60;
+  int min_replicas_to_ack = 0;
+  int min_replicas_ack_timeout = 1000;
   int max_io_mb = 0;
+  bool max_io_mb_auto_tune = false;
+  int max_io_mb_auto_tune_read_latency_us = 2000;
+  bool workload_auto_tune = false;
+  int workload_auto_tune_interval = 60;
+  int workload_auto_tune_min_cache_ratio = 20;
+  int workload_auto_tune_max_background_compactions = 8;
+  int workload_auto_tune_max_write_buffer_size = 256;
   int max_bitmap_to_string_mb = 16;
+  int write_batch_chunk_mb = 16;
+  int metadata_cache_size = 0;
+  int cache_warmup_keys = 0;
+  int cache_warmup_keys_per_sec = 10000;
+  int scan_iterator_cache_size = 0;
+  int scan_iterator_idle_timeout = 10;
+  int lock_table_hash_power = 16;
+  int lazy_reclaim_min_elements = 1000;
+  int lazy_reclaim_max_keys_per_sec = 100;
+  int lazy_expire_max_keys_per_sec = 1000;
+  int range_delete_min_elements = 1000;
+  bool active_expire_enabled = false;
+  int active_expire_keys_per_cycle = 200;
+  bool key_count_tracking = false;
+  int bigkeys_scan_rate = 0;
+  int zset_rank_index_min_size = 0;
+  bool list_chunked_encoding = false;
+  int hash_inline_max_entries = 0;
+  int hash_inline_max_bytes = 1024;
+  int set_inline_max_entries = 0;
+  int set_inline_max_bytes = 1024;
+  int zset_inline_max_entries = 0;
+  int zset_inline_max_bytes = 1024;
+  int stream_entry_max_schemas = 0;
+  bool bitmap_segment_containers = false;
+  bool sortedint_block_encoding = false;
+  int string_chunked_min_bytes = 0;
+  bool metadata_compact_encoding = false;
   bool master_use_repl_port = false;
   bool purge_backup_on_fullsync = false;
   bool auto_resize_block_and_sst = true;
+  bool pipeline_group_commit = false;
+  bool pipeline_read_prefetch = false;
+  int read_coalesce_window_ms = 0;
+  bool lua_strict_key_accessing = false;
+  int lua_script_cache_size = 0;
+  OutputBufferLimit normal_output_buffer_limit;
+  OutputBufferLimit pubsub_output_buffer_limit{32 * MiB, 8 * MiB, 60};
+  int client_output_buffer_pause_mb = 0;
+  bool pipeline_reply_cork = true;
+  int client_buffer_shrink_idle = 2;
   int fullsync_recv_file_delay = 0;
   bool use_rsid_psync = false;
   std::vector<std::string> binds;
@@ -129,14 +232,29 @@ struct Config {
   int unixsocketperm = 0777;
   int master_port = 0;
   Cron compact_cron;
+  int compact_cron_parallelism = 1;
+  int compact_cron_max_io_mb = 0;
+  int compact_cron_window_minutes = 0;
   Cron bgsave_cron;
   CompactionCheckerRange compaction_checker_range{-1, -1};
+  int compaction_checker_tombstone_threshold = 0;
   std::map<std::string, std::string> tokens;
+  std::vector<std::string> namespace_column_families;
+  int namespace_max_ops_per_sec = 0;
+  int namespace_max_bytes_per_sec = 0;
+  int namespace_pipeline_quantum = 0;
+  std::map<std::string, NamespaceQoSSpec> namespace_qos;
+  int namespace_max_disk_size = 0;
+  // The disk quotas in MB of the given namespaces instead of namespace_max_disk_size
+  std::map<std::string, uint64_t> namespace_disk_quota;
 
   bool slot_id_encoded = false;
   bool cluster_enabled = false;
+  bool cluster_allow_local_cross_slot = false;
   int migrate_speed;
+  int migrate_type = kMigrateTypeRedisCommand;
   int pipeline_size;
+  int migrate_ack_latency_target;
   int sequence_gap;
 
   // profiling
@@ -145,22 +263,46 @@ struct Config {
   int profiling_sample_record_max_len = 128;
   std::set<std::string> profiling_sample_commands;
   bool profiling_sample_all_commands = false;
+  int perf_stats_sample_interval = 1000;
+  int request_trace_sample_interval = 0;
 
   struct RocksDB {
     int block_size;
+    int filter_type;
+    int metadata_filter_bits_per_key;
+    int subkey_filter_bits_per_key;
+    bool subkey_optimize_filters_for_hits;
+    int subkey_memtable_type;
+    int memtable_bloom_size_ratio;
     bool cache_index_and_filter_blocks;
     int metadata_block_cache_size;
     int subkey_block_cache_size;
+    int namespace_block_cache_size;
+    int namespace_write_buffer_size;
+    std::string subkey_cold_dir;
+    int subkey_hot_target_size;
     bool share_metadata_and_subkey_block_cache;
+    bool partition_sst_by_slot;
+    int block_cache_type;
+    int compressed_secondary_cache_size;
+    bool block_cache_huge_pages;
+    bool memtable_huge_pages;
     int row_cache_size;
     int max_open_files;
+    int max_file_opening_threads;
+    int wal_sync_interval_ms;
+    bool manual_wal_flush;
     int write_buffer_size;
+    int memtable_total_budget;
+    bool memtable_budget_cost_to_cache;
+    bool memtable_budget_allow_stall;
     int max_write_buffer_number;
     int max_background_compactions;
     int max_background_flushes;
     int max_sub_compactions;
     int stats_dump_period_sec;
     bool enable_pipelined_write;
+    bool scan_async_io;
     int64_t delayed_write_rate;
     int compaction_readahead_size;
     int target_file_size_base;
@@ -171,12 +313,25 @@ struct Config {
     int level0_stop_writes_trigger;
     int level0_file_num_compaction_trigger;
     int compression;
+    int compression_start_level;
+    int metadata_compression_start_level;
+    int subkey_compression_max_dict_bytes;
+    int subkey_zstd_max_train_bytes;
     bool disable_auto_compactions;
     bool enable_blob_files;
     int min_blob_size;
     int blob_file_size;
     bool enable_blob_garbage_collection;
     int blob_garbage_collection_age_cutoff;
+    // The thresholds of the column families, which follow min_blob_size if they're negative
+    int metadata_min_blob_size;
+    int subkey_min_blob_size;
+    int stream_min_blob_size;
+    int blob_cache_size;
+
+    int MetadataMinBlobSize() const { return metadata_min_blob_size >= 0 ? metadata_min_blob_size : min_blob_size; }
+    int SubkeyMinBlobSize() const { return subkey_min_blob_size >= 0 ? subkey_min_blob_size : min_blob_size; }
+    int StreamMinBlobSize() const { return stream_min_blob_size >= 0 ? stream_min_blob_size : min_blob_size; }
     int max_bytes_for_level_base;
     int max_bytes_for_level_multiplier;
     bool level_compaction_dynamic_level_bytes;
@@ -203,6 +358,9 @@ struct Config {
   Status AddNamespace(const std::string &ns, const std::string &token);
   Status SetNamespace(const std::string &ns, const std::string &token);
   Status DelNamespace(const std::string &ns);
+  NamespaceQoSSpec GetNamespaceQoS(const std::string &ns) const;
+  // The disk quota of the namespace in bytes, or 0 if unlimited
+  uint64_t GetNamespaceDiskQuota(const std::string &ns) const;
 
  private:
   std::string path_;
@@ -211,7 +369,13 @@ struct Config {
   std::string compact_cron_;
   std::string bgsave_cron_;
   std::string compaction_checker_range_;
+  std::string worker_cpu_list_;
+  std::string background_cpu_list_;
+  std::string client_output_buffer_limit_;
   std::string profiling_sample_commands_;
+  std::string namespace_column_families_;
+  std::string namespace_qos_;
+  std::string namespace_disk_quota_;
   std::map<std::string, std::unique_ptr<ConfigField>> fields_;
   std::vector<std::string> rename_command_;
 
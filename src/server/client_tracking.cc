@@ -0,0 +1,183 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "client_tracking.h"
+
+#include "string_util.h"
+
+void ClientTracking::Enable(uint64_t client_id, const std::string &ns, const TrackingTarget &target,
+                            const TrackingOptions &options) {
+  std::lock_guard<std::mutex> guard(mu_);
+  auto iter = clients_.find(client_id);
+  if (iter != clients_.end()) removePrefixes(client_id, iter->second);
+
+  Client client{ns, target, options};
+  // Broadcast the writes of all keys if no prefix is given
+  if (client.options.bcast && client.options.prefixes.empty()) client.options.prefixes.emplace_back();
+  if (client.options.bcast) {
+    auto &prefixes = tables_[ns].prefixes;
+    for (const auto &prefix : client.options.prefixes) prefixes[prefix].emplace(client_id);
+  }
+  clients_[client_id] = std::move(client);
+  clients_num_ = clients_.size();
+}
+
+void ClientTracking::Disable(uint64_t client_id) {
+  std::lock_guard<std::mutex> guard(mu_);
+  auto iter = clients_.find(client_id);
+  if (iter == clients_.end()) return;
+  removePrefixes(client_id, iter->second);
+  clients_.erase(iter);
+  clients_num_ = clients_.size();
+}
+
+bool ClientTracking::IsEnabled(uint64_t client_id) {
+  std::lock_guard<std::mutex> guard(mu_);
+  return clients_.count(client_id) > 0;
+}
+
+int64_t ClientTracking::GetRedirect(uint64_t client_id) {
+  std::lock_guard<std::mutex> guard(mu_);
+  auto iter = clients_.find(client_id);
+  if (iter == clients_.end()) return -1;
+  return static_cast<int64_t>(iter->second.options.redirect);
+}
+
+void ClientTracking::RememberKeys(uint64_t client_id, const std::string &ns, const std::vector<std::string> &keys,
+                                  size_t max_keys, InvalidationBatches *batches) {
+  std::lock_guard<std::mutex> guard(mu_);
+  auto iter = clients_.find(client_id);
+  // The broadcasting clients are notified by the prefixes, so their reads needn't be remembered
+  if (iter == clients_.end() || iter->second.options.bcast || iter->second.ns != ns) return;
+  auto &table = tables_[ns];
+  for (const auto &key : keys) {
+    auto [key_iter, inserted] = table.keys.try_emplace(key);
+    if (inserted) keys_num_++;
+    key_iter->second.emplace(client_id);
+  }
+  if (max_keys > 0 && keys_num_ > max_keys) evictKeys(max_keys, batches);
+}
+
+void ClientTracking::InvalidateKeys(uint64_t writer_id, const std::string &ns, const std::vector<std::string> &keys,
+                                    InvalidationBatches *batches) {
+  std::lock_guard<std::mutex> guard(mu_);
+  auto table_iter = tables_.find(ns);
+  if (table_iter == tables_.end()) return;
+  auto &table = table_iter->second;
+  for (const auto &key : keys) {
+    auto key_iter = table.keys.find(key);
+    if (key_iter != table.keys.end()) {
+      for (auto id : key_iter->second) {
+        auto client_iter = clients_.find(id);
+        if (client_iter == clients_.end() || client_iter->second.ns != ns) continue;
+        if (client_iter->second.options.noloop && id == writer_id) continue;
+        addInvalidation(client_iter->second, key, batches);
+      }
+      // The key would be remembered again once it's read by the clients
+      table.keys.erase(key_iter);
+      keys_num_--;
+    }
+
+    for (const auto &[prefix, ids] : table.prefixes) {
+      if (!Util::HasPrefix(key, prefix)) continue;
+      for (auto id : ids) {
+        auto client_iter = clients_.find(id);
+        if (client_iter == clients_.end()) continue;
+        if (client_iter->second.options.noloop && id == writer_id) continue;
+        addInvalidation(client_iter->second, key, batches);
+      }
+    }
+  }
+  if (table.keys.empty() && table.prefixes.empty()) tables_.erase(table_iter);
+}
+
+void ClientTracking::InvalidateAll(const std::string &ns, InvalidationBatches *batches) {
+  std::lock_guard<std::mutex> guard(mu_);
+  for (const auto &[id, client] : clients_) {
+    if (!ns.empty() && client.ns != ns) continue;
+    auto &invalidation = (*batches)[client.target.owner][client.target.id];
+    invalidation.fd = client.target.fd;
+    invalidation.id = client.target.id;
+    invalidation.flush = true;
+    invalidation.keys.clear();
+  }
+  for (auto iter = tables_.begin(); iter != tables_.end();) {
+    if (!ns.empty() && iter->first != ns) {
+      ++iter;
+      continue;
+    }
+    keys_num_ -= iter->second.keys.size();
+    iter->second.keys.clear();
+    if (iter->second.prefixes.empty()) {
+      iter = tables_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+}
+
+size_t ClientTracking::KeysNum() {
+  std::lock_guard<std::mutex> guard(mu_);
+  return keys_num_;
+}
+
+void ClientTracking::removePrefixes(uint64_t client_id, const Client &client) {
+  if (!client.options.bcast) return;
+  auto table_iter = tables_.find(client.ns);
+  if (table_iter == tables_.end()) return;
+  auto &prefixes = table_iter->second.prefixes;
+  for (const auto &prefix : client.options.prefixes) {
+    auto prefix_iter = prefixes.find(prefix);
+    if (prefix_iter == prefixes.end()) continue;
+    prefix_iter->second.erase(client_id);
+    if (prefix_iter->second.empty()) prefixes.erase(prefix_iter);
+  }
+  if (table_iter->second.keys.empty() && prefixes.empty()) tables_.erase(table_iter);
+}
+
+void ClientTracking::addInvalidation(const Client &client, const std::string &key, InvalidationBatches *batches) {
+  auto &invalidation = (*batches)[client.target.owner][client.target.id];
+  invalidation.fd = client.target.fd;
+  invalidation.id = client.target.id;
+  // The flush invalidates all keys of the target already
+  if (!invalidation.flush) invalidation.keys.emplace(key);
+}
+
+void ClientTracking::evictKeys(size_t max_keys, InvalidationBatches *batches) {
+  for (auto table_iter = tables_.begin(); table_iter != tables_.end() && keys_num_ > max_keys;) {
+    auto &keys = table_iter->second.keys;
+    while (!keys.empty() && keys_num_ > max_keys) {
+      auto key_iter = keys.begin();
+      for (auto id : key_iter->second) {
+        auto client_iter = clients_.find(id);
+        if (client_iter == clients_.end() || client_iter->second.ns != table_iter->first) continue;
+        addInvalidation(client_iter->second, key_iter->first, batches);
+      }
+      keys.erase(key_iter);
+      keys_num_--;
+      evicted_keys_++;
+    }
+    if (keys.empty() && table_iter->second.prefixes.empty()) {
+      table_iter = tables_.erase(table_iter);
+    } else {
+      ++table_iter;
+    }
+  }
+}
@@ -0,0 +1,125 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Worker;
+
+constexpr const char *kTrackingChannel = "__redis__:invalidate";
+
+// The connection receiving the invalidations of a tracking client, it's looked up by its worker
+// with the fd and checked by the id, since the fd may be reused by another connection
+struct TrackingTarget {
+  Worker *owner = nullptr;
+  int fd = -1;
+  uint64_t id = 0;
+};
+
+struct TrackingOptions {
+  uint64_t redirect = 0;
+  // The broadcasting clients are notified of the writes of all keys matching their prefixes,
+  // instead of the keys they have read
+  bool bcast = false;
+  std::vector<std::string> prefixes;
+  // Don't notify the client of the keys written by itself
+  bool noloop = false;
+};
+
+// The invalidated keys of one target, the whole namespace is invalidated if flush is set
+struct Invalidation {
+  int fd = -1;
+  uint64_t id = 0;
+  bool flush = false;
+  std::set<std::string> keys;
+};
+
+// The invalidations are grouped by the workers of the targets, so each worker is visited once
+// to deliver the invalidations of a batch of writes
+using InvalidationBatches = std::map<Worker *, std::map<uint64_t, Invalidation>>;
+
+// ClientTracking implements the server side of the client side caching. The keys read by
+// the tracking clients are remembered in the tracking table, and the clients are notified once
+// a remembered key is written, after which the key is forgotten until it's read again. The
+// broadcasting clients are notified of the written keys by the prefixes instead. The table holds
+// at most max_keys keys (0 means no limit), the clients of the evicted keys are notified as if
+// the keys were written, so no client would cache a key which isn't tracked anymore.
+//
+// The clients are forgotten lazily in the table, the keys remembered before a client disabled
+// the tracking are simply skipped when they're invalidated.
+class ClientTracking {
+ public:
+  ClientTracking() = default;
+  ClientTracking(const ClientTracking &) = delete;
+  ClientTracking &operator=(const ClientTracking &) = delete;
+
+  void Enable(uint64_t client_id, const std::string &ns, const TrackingTarget &target, const TrackingOptions &options);
+  void Disable(uint64_t client_id);
+  bool IsEnabled(uint64_t client_id);
+  // Return the id of the connection receiving the invalidations, or -1 if the tracking is disabled
+  int64_t GetRedirect(uint64_t client_id);
+  // Whether there is any tracking client, it's checked before collecting the keys of the commands
+  bool HasClients() const { return clients_num_.load(std::memory_order_relaxed) > 0; }
+
+  // Remember the keys read by the client, the invalidations of the evicted keys are added to the batches
+  void RememberKeys(uint64_t client_id, const std::string &ns, const std::vector<std::string> &keys, size_t max_keys,
+                    InvalidationBatches *batches);
+  // Collect the invalidations of the keys written by the writer
+  void InvalidateKeys(uint64_t writer_id, const std::string &ns, const std::vector<std::string> &keys,
+                      InvalidationBatches *batches);
+  // Collect the invalidations of all keys of the namespace, or of all namespaces if ns is empty
+  void InvalidateAll(const std::string &ns, InvalidationBatches *batches);
+
+  size_t KeysNum();
+  size_t ClientsNum() const { return clients_num_.load(std::memory_order_relaxed); }
+  uint64_t EvictedKeys() const { return evicted_keys_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Client {
+    std::string ns;
+    TrackingTarget target;
+    TrackingOptions options;
+  };
+  struct NamespaceTable {
+    // The keys to the ids of the clients which have read them
+    std::unordered_map<std::string, std::set<uint64_t>> keys;
+    // The prefixes to the ids of the broadcasting clients
+    std::map<std::string, std::set<uint64_t>> prefixes;
+  };
+
+  void removePrefixes(uint64_t client_id, const Client &client);
+  void addInvalidation(const Client &client, const std::string &key, InvalidationBatches *batches);
+  void evictKeys(size_t max_keys, InvalidationBatches *batches);
+
+  std::mutex mu_;
+  std::map<uint64_t, Client> clients_;
+  std::map<std::string, NamespaceTable> tables_;
+  size_t keys_num_ = 0;
+  std::atomic<size_t> clients_num_ = 0;
+  std::atomic<uint64_t> evicted_keys_ = 0;
+};
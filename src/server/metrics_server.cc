@@ -0,0 +1,93 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "metrics_server.h"
+
+#include <event2/buffer.h>
+#include <glog/logging.h>
+
+#include <cstring>
+#include <string>
+#include <system_error>
+
+#include "server.h"
+#include "stats/prometheus.h"
+#include "thread_util.h"
+
+MetricsServer::~MetricsServer() {
+  if (http_) evhttp_free(http_);
+  if (base_) event_base_free(base_);
+}
+
+Status MetricsServer::Listen(const std::vector<std::string> &binds, int port) {
+  if (binds.empty()) return {Status::NotOK, "metrics-port requires the bind addresses"};
+
+  base_ = event_base_new();
+  if (!base_) return {Status::NotOK, "failed to create the event base"};
+  http_ = evhttp_new(base_);
+  if (!http_) return {Status::NotOK, "failed to create the http server"};
+  evhttp_set_allowed_methods(http_, EVHTTP_REQ_GET | EVHTTP_REQ_HEAD);
+  evhttp_set_timeout(http_, 30);
+  evhttp_set_cb(http_, "/metrics", requestCB, this);
+
+  for (const auto &bind : binds) {
+    if (!evhttp_bind_socket_with_handle(http_, bind.c_str(), static_cast<uint16_t>(port))) {
+      return {Status::NotOK, "failed to listen on " + bind + ":" + std::to_string(port)};
+    }
+    LOG(INFO) << "[metrics] Listening on: " << bind << ":" << port;
+  }
+  return Status::OK();
+}
+
+Status MetricsServer::Start() {
+  try {
+    t_ = std::thread([this]() {
+      Util::ThreadSetName("metrics");
+      if (event_base_dispatch(base_) != 0) {
+        LOG(ERROR) << "[metrics] Failed to run the event loop, err: " << strerror(errno);
+      }
+    });
+  } catch (const std::system_error &e) {
+    return {Status::NotOK, std::string("failed to start the metrics thread, err: ") + e.what()};
+  }
+  return Status::OK();
+}
+
+void MetricsServer::Stop() {
+  if (base_) event_base_loopbreak(base_);
+}
+
+void MetricsServer::Join() {
+  if (t_.joinable()) t_.join();
+}
+
+void MetricsServer::requestCB(evhttp_request *req, void *ctx) {
+  auto self = static_cast<MetricsServer *>(ctx);
+  auto body = self->svr_->GetPrometheusMetrics();
+
+  evhttp_add_header(evhttp_request_get_output_headers(req), "Content-Type", PrometheusWriter::kContentType);
+  evbuffer *buf = evbuffer_new();
+  if (!buf) {
+    evhttp_send_error(req, HTTP_INTERNAL, nullptr);
+    return;
+  }
+  evbuffer_add(buf, body.data(), body.size());
+  evhttp_send_reply(req, HTTP_OK, "OK", buf);
+  evbuffer_free(buf);
+}
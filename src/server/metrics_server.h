@@ -0,0 +1,56 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#pragma once
+
+#include <event2/event.h>
+#include <event2/http.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "status.h"
+
+class Server;
+
+// MetricsServer is the HTTP listener of metrics-port which serves the metrics of the server in
+// the Prometheus format at /metrics. It runs its own event loop on a separate thread, and the
+// metrics are read from the atomic counters and RocksDB directly, so a scrape neither occupies
+// a worker nor takes the locks of the workers, see Server::GetPrometheusMetrics.
+class MetricsServer {
+ public:
+  explicit MetricsServer(Server *svr) : svr_(svr) {}
+  ~MetricsServer();
+  MetricsServer(const MetricsServer &) = delete;
+  MetricsServer &operator=(const MetricsServer &) = delete;
+
+  Status Listen(const std::vector<std::string> &binds, int port);
+  Status Start();
+  void Stop();
+  void Join();
+
+ private:
+  static void requestCB(evhttp_request *req, void *ctx);
+
+  Server *svr_;
+  event_base *base_ = nullptr;
+  evhttp *http_ = nullptr;
+  std::thread t_;
+};
@@ -0,0 +1,64 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "namespace_qos.h"
+
+#include <algorithm>
+#include <cmath>
+
+uint64_t NamespaceQoS::Acquire(const std::string &ns, const Limits &limits, uint64_t bytes, uint64_t now_us) {
+  std::lock_guard<std::mutex> guard(mu_);
+  auto [iter, inserted] = buckets_.try_emplace(ns);
+  auto &bucket = iter->second;
+  if (inserted) {
+    bucket.ops = static_cast<double>(limits.ops_per_sec);
+    bucket.bytes = static_cast<double>(limits.bytes_per_sec);
+    bucket.last_us = now_us;
+  }
+
+  // Refill the tokens since the last time, the limits may be changed in the meantime
+  double elapsed = now_us > bucket.last_us ? static_cast<double>(now_us - bucket.last_us) / 1e6 : 0;
+  bucket.last_us = std::max(bucket.last_us, now_us);
+  auto ops_rate = static_cast<double>(limits.ops_per_sec), bytes_rate = static_cast<double>(limits.bytes_per_sec);
+  bucket.ops = std::min(bucket.ops + elapsed * ops_rate, ops_rate);
+  bucket.bytes = std::min(bucket.bytes + elapsed * bytes_rate, bytes_rate);
+
+  double wait_us = 0;
+  if (limits.ops_per_sec != 0 && bucket.ops < 1) wait_us = (1 - bucket.ops) * 1e6 / ops_rate;
+  if (limits.bytes_per_sec != 0 && bucket.bytes < 0) wait_us = std::max(wait_us, -bucket.bytes * 1e6 / bytes_rate);
+  if (wait_us > 0) {
+    bucket.stats.throttled_cmds++;
+    return std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(wait_us)));
+  }
+
+  if (limits.ops_per_sec != 0) bucket.ops -= 1;
+  if (limits.bytes_per_sec != 0) bucket.bytes -= static_cast<double>(bytes);
+  bucket.stats.allowed_cmds++;
+  return 0;
+}
+
+std::map<std::string, NamespaceQoS::Stats> NamespaceQoS::GetStats() {
+  std::lock_guard<std::mutex> guard(mu_);
+  std::map<std::string, Stats> stats;
+  for (const auto &[ns, bucket] : buckets_) {
+    stats.emplace(ns, bucket.stats);
+  }
+  return stats;
+}
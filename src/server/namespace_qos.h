@@ -0,0 +1,63 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// NamespaceQoS limits the commands and the request bytes per second of each namespace by the token
+// buckets, which are shared by all workers. A bucket holds the tokens of one second at most. The
+// bytes of a request are taken after it was allowed, so a large request may leave a debt which
+// delays the following requests of the namespace.
+class NamespaceQoS {
+ public:
+  // The limits of a namespace, 0 is unlimited
+  struct Limits {
+    uint64_t ops_per_sec = 0;
+    uint64_t bytes_per_sec = 0;
+
+    bool Enabled() const { return ops_per_sec != 0 || bytes_per_sec != 0; }
+  };
+
+  struct Stats {
+    uint64_t allowed_cmds = 0;
+    uint64_t throttled_cmds = 0;
+  };
+
+  // Take the tokens of a command of the namespace, return 0 if it's allowed, otherwise the
+  // microseconds to wait before trying again, and the tokens aren't taken.
+  uint64_t Acquire(const std::string &ns, const Limits &limits, uint64_t bytes, uint64_t now_us);
+  std::map<std::string, Stats> GetStats();
+
+ private:
+  struct Bucket {
+    double ops = 0;
+    double bytes = 0;
+    uint64_t last_us = 0;
+    Stats stats;
+  };
+
+  std::mutex mu_;
+  std::unordered_map<std::string, Bucket> buckets_;
+};
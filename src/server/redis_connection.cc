@@ -18,10 +18,15 @@
  *
  */
 
+#include <event2/bufferevent.h>
+#include <event2/bufferevent_struct.h>
 #include <glog/logging.h>
 #include <rocksdb/iostats_context.h>
 #include <rocksdb/perf_context.h>
 
+#include <algorithm>
+#include <map>
+
 #include "fmt/format.h"
 #ifdef ENABLE_OPENSSL
 #include <event2/bufferevent_ssl.h>
@@ -29,6 +34,9 @@
 
 #include "redis_connection.h"
 #include "server.h"
+#include "storage/redis_db.h"
+#include "storage/scripting.h"
+#include "time_util.h"
 #include "tls_util.h"
 #include "worker.h"
 
@@ -52,12 +60,44 @@ Connection::~Connection() {
   // unsubscribe all channels and patterns if exists
   UnSubscribeAll();
   PUnSubscribeAll();
+  SUnSubscribeAll();
+  if (!watched_keys_.empty()) svr_->ResetWatchedKeys(this);
+  if (IsFlagEnabled(kTracking)) svr_->GetClientTracking()->Disable(id_);
+  if (repl_ack_timer_) {
+    event_free(repl_ack_timer_);
+    svr_->RemoveReplAckWaiter(this);
+  }
+  if (throttle_timer_) event_free(throttle_timer_);
 }
 
 std::string Connection::ToString() {
-  return fmt::format("id={} addr={} fd={} name={} age={} idle={} flags={} namespace={} qbuf={} obuf={} cmd={}\n", id_,
-                     addr_, bufferevent_getfd(bev_), name_, GetAge(), GetIdleTime(), GetFlags(), ns_,
-                     evbuffer_get_length(Input()), evbuffer_get_length(Output()), last_cmd_);
+  size_t qbuf = evbuffer_get_length(Input()), obuf = evbuffer_get_length(Output());
+  // The requests are owned by the worker thread, their memory is sampled by it
+  size_t argv_mem = argv_mem_.load(std::memory_order_relaxed), multi_mem = multi_mem_.load(std::memory_order_relaxed);
+  return fmt::format(
+      "id={} addr={} fd={} name={} age={} idle={} flags={} namespace={} qbuf={} obuf={} argv-mem={} multi-mem={} "
+      "tot-mem={} cmd={}\n",
+      id_, addr_, bufferevent_getfd(bev_), name_, GetAge(), GetIdleTime(), GetFlags(), ns_, qbuf, obuf, argv_mem,
+      multi_mem, qbuf + obuf + argv_mem + multi_mem, last_cmd_);
+}
+
+void Connection::ShrinkBuffers() {
+  // The offloaded command and the rest of the pipeline are still using the requests
+  if (IsOffloading() || !req_.GetCommands()->empty()) return;
+  // Shrink once in every idle period
+  if (shrunk_interaction_ == last_interaction_) return;
+  shrunk_interaction_ = last_interaction_;
+
+  req_.ShrinkBuffers();
+  argv_mem_.store(req_.GetMemoryUsage(), std::memory_order_relaxed);
+  // The chain drained partially is kept by the evbuffer at its size, e.g. the tail of a large request
+  // left in the chain of megabytes, the few pending bytes are copied into the chain fitting them
+  static constexpr size_t kMaxCopyBytes = 16 * 1024;
+  if (size_t len = evbuffer_get_length(Input()); len > 0 && len <= kMaxCopyBytes) {
+    std::string pending(len, '\0');
+    evbuffer_remove(Input(), pending.data(), len);
+    evbuffer_add(Input(), pending.data(), len);
+  }
 }
 
 void Connection::Close() {
@@ -67,11 +107,49 @@ void Connection::Close() {
 
 void Connection::Detach() { owner_->DetachConnection(this); }
 
+bool Connection::IsMigratable() {
+  if (IsOffloading() || read_paused_ || repl_ack_timer_ || close_cb_ || throttled_) return false;
+  // The rest of the pipeline which yielded to the other connections is executed by the trigger of this worker
+  if (!req_.GetCommands()->empty()) return false;
+  // The invalidations of the tracking client are delivered by the worker and the fd of its target
+  if (IsFlagEnabled(kSlave) || IsFlagEnabled(kMonitor) || IsFlagEnabled(kCloseAfterReply) ||
+      IsFlagEnabled(kCloseAsync) || IsFlagEnabled(kTracking)) {
+    return false;
+  }
+  // The publishers reply to the subscribers by the worker and the fd in their contexts
+  if (SubscriptionsCount() + PSubscriptionsCount() + SSubscriptionsCount() > 0) return false;
+#ifdef ENABLE_OPENSSL
+  if (bufferevent_openssl_get_ssl(bev_)) return false;
+#endif
+  // The blocking commands replace the callbacks until they're woken up
+  bufferevent_data_cb read_cb = nullptr;
+  bufferevent_getcb(bev_, &read_cb, nullptr, nullptr, nullptr);
+  return read_cb == OnRead;
+}
+
+void Connection::MoveTo(Worker *owner, bufferevent *bev) {
+  bufferevent_disable(bev_, EV_READ | EV_WRITE);
+  evbuffer_add_buffer(bufferevent_get_input(bev), Input());
+  evbuffer_add_buffer(bufferevent_get_output(bev), Output());
+  // The fd isn't closed since the bufferevent doesn't own it
+  bufferevent_free(bev_);
+  bev_ = bev;
+  owner_ = owner;
+  bufferevent_setcb(bev_, OnRead, OnWrite, OnEvent, this);
+}
+
+void Connection::ResumeAfterMove() {
+  bufferevent_enable(bev_, EV_READ);
+  // Process the requests which were read but not executed yet
+  if (evbuffer_get_length(Input()) > 0) bufferevent_trigger(bev_, EV_READ, BEV_TRIG_IGNORE_WATERMARKS);
+}
+
 void Connection::OnRead(struct bufferevent *bev, void *ctx) {
   DLOG(INFO) << "[connection] on read: " << bufferevent_getfd(bev);
   auto conn = static_cast<Connection *>(ctx);
 
   conn->SetLastInteraction();
+  conn->read_us_ = conn->svr_->GetConfig()->request_trace_sample_interval > 0 ? Util::GetTimeStampUS() : 0;
   auto s = conn->req_.Tokenize(conn->Input());
   if (!s.IsOK()) {
     conn->EnableFlag(Redis::Connection::kCloseAfterReply);
@@ -79,16 +157,99 @@ void Connection::OnRead(struct bufferevent *bev, void *ctx) {
     LOG(INFO) << "Failed to tokenize the request, encounter error: " << s.Msg();
     return;
   }
+  size_t output_len = evbuffer_get_length(conn->Output());
+  conn->flushed_reply_bytes_ = 0;
+  conn->corkReplies();
   conn->ExecuteCommands(conn->req_.GetCommands());
-  if (conn->IsFlagEnabled(kCloseAsync)) {
+  // The memory held by the incomplete command and the rest of the pipeline after executing
+  conn->argv_mem_.store(conn->req_.GetMemoryUsage(), std::memory_order_relaxed);
+  if (conn->IsFlagEnabled(kCloseAsync) && !conn->IsOffloading()) {
     conn->Close();
+    return;
+  }
+  if (conn->has_unacked_writes_) {
+    conn->has_unacked_writes_ = false;
+    // The replies flushed before the first write were removed from the head of the output buffer
+    size_t held_offset = output_len - std::min(output_len, conn->flushed_reply_bytes_);
+    if (conn->waitForReplicaAcks(held_offset)) {
+      conn->corked_ = false;  // the write event is enabled by the wakeup of the acknowledgement
+      return;
+    }
   }
+  conn->uncorkReplies();
+  conn->pauseReadIfNeeded();
+}
+
+// Hold the replies of the writes until enough replicas acknowledged them if min-replicas-to-ack
+// is set, the replies before the writes are kept in the output buffer while waiting
+bool Connection::waitForReplicaAcks(size_t output_len) {
+  int num_replicas = svr_->GetConfig()->min_replicas_to_ack;
+  if (num_replicas <= 0 || svr_->IsSlave()) return false;
+  // The connection was suspended by the blocking or offloaded command
+  bufferevent_data_cb read_cb = nullptr;
+  bufferevent_getcb(bev_, &read_cb, nullptr, nullptr, nullptr);
+  if (read_cb != OnRead || IsFlagEnabled(kCloseAfterReply)) return false;
+
+  repl_ack_seq_ = svr_->storage_->LatestSeq();
+  if (svr_->CountReplicasAcked(repl_ack_seq_) >= num_replicas) return false;
+
+  repl_ack_output_len_ = output_len;
+  bufferevent_disable(bev_, EV_READ | EV_WRITE);
+  bufferevent_setcb(bev_, nullptr, onReplicaAckWrite, onReplicaAckEvent, this);
+  repl_ack_timer_ = evtimer_new(bufferevent_get_base(bev_), onReplicaAckTimeout, this);
+  int timeout_ms = svr_->GetConfig()->min_replicas_ack_timeout;
+  timeval tm = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+  evtimer_add(repl_ack_timer_, &tm);
+  svr_->AddReplAckWaiter(this, repl_ack_seq_, num_replicas);
+  return true;
+}
+
+void Connection::finishReplicaAcks() {
+  if (repl_ack_timer_) {
+    event_free(repl_ack_timer_);
+    repl_ack_timer_ = nullptr;
+  }
+  svr_->RemoveReplAckWaiter(this);
+  bufferevent_setcb(bev_, OnRead, OnWrite, OnEvent, this);
+}
+
+void Connection::onReplicaAckWrite(bufferevent *bev, void *ctx) {
+  // The replies were sent since the write event was enabled by the wakeup
+  auto conn = static_cast<Connection *>(ctx);
+  conn->finishReplicaAcks();
+  bufferevent_enable(bev, EV_READ);
+  // Process the commands received while waiting, see CommandBPop::WriteCB
+  bufferevent_trigger(bev, EV_READ, BEV_TRIG_IGNORE_WATERMARKS);
+}
+
+void Connection::onReplicaAckTimeout(int, int16_t, void *ctx) {
+  auto conn = static_cast<Connection *>(ctx);
+  conn->finishReplicaAcks();
+  // Drop the held replies, the client can't tell the writes were acknowledged from the others,
+  // so it's closed after the error is sent
+  UniqueEvbuf sent_replies;
+  evbuffer_remove_buffer(conn->Output(), sent_replies.get(), conn->repl_ack_output_len_);
+  evbuffer_drain(conn->Output(), evbuffer_get_length(conn->Output()));
+  evbuffer_add_buffer(conn->Output(), sent_replies.get());
+  conn->EnableFlag(kCloseAfterReply);
+  conn->Reply(Redis::Error("NOREPLICAS Not enough replicas acknowledged the writes in time"));
+  bufferevent_enable(conn->bev_, EV_WRITE);
+}
+
+void Connection::onReplicaAckEvent(bufferevent *bev, int16_t events, void *ctx) {
+  auto conn = static_cast<Connection *>(ctx);
+  if (events & (BEV_EVENT_EOF | BEV_EVENT_ERROR)) conn->finishReplicaAcks();
+  OnEvent(bev, events, ctx);
 }
 
 void Connection::OnWrite(struct bufferevent *bev, void *ctx) {
   auto conn = static_cast<Connection *>(ctx);
   if (conn->IsFlagEnabled(kCloseAfterReply) || conn->IsFlagEnabled(kCloseAsync)) {
     conn->Close();
+    return;
+  }
+  if (conn->read_paused_) {
+    conn->resumeRead();
   }
 }
 
@@ -115,9 +276,220 @@ void Connection::OnEvent(bufferevent *bev, int16_t events, void *ctx) {
   }
 }
 
-void Connection::Reply(const std::string &msg) {
+void Connection::Reply(const std::string &msg) { reply(msg, outputBufferLimit()); }
+
+void Connection::ReplyMessage(const std::string &msg) { reply(msg, svr_->GetConfig()->pubsub_output_buffer_limit); }
+
+void Connection::Reply(std::string &&msg) {
+  if (obuf_limit_reached_) return;
+  owner_->svr_->stats_.IncrOutbondBytes(msg.size());
+  Redis::Reply(Output(), std::move(msg));
+  checkOutputBufferLimit(outputBufferLimit());
+}
+
+void Connection::reply(const std::string &msg, const OutputBufferLimit &limit) {
+  if (obuf_limit_reached_) return;
   owner_->svr_->stats_.IncrOutbondBytes(msg.size());
   Redis::Reply(bufferevent_get_output(bev_), msg);
+  checkOutputBufferLimit(limit);
+}
+
+void Connection::ReplyInteger(int64_t data) {
+  if (reply_sink_) {
+    reply_sink_->Integer(data);
+    return;
+  }
+  if (obuf_limit_reached_) return;
+  owner_->svr_->stats_.IncrOutbondBytes(Redis::Integer(Output(), data));
+  checkOutputBufferLimit(outputBufferLimit());
+}
+
+void Connection::ReplyBulkString(const rocksdb::Slice &data) {
+  if (reply_sink_) {
+    reply_sink_->BulkString(data);
+    return;
+  }
+  if (obuf_limit_reached_) return;
+  owner_->svr_->stats_.IncrOutbondBytes(Redis::BulkString(Output(), data));
+  checkOutputBufferLimit(outputBufferLimit());
+}
+
+void Connection::ReplyNilString() {
+  if (reply_sink_) {
+    reply_sink_->NilString();
+    return;
+  }
+  if (obuf_limit_reached_) return;
+  owner_->svr_->stats_.IncrOutbondBytes(Redis::NilString(Output()));
+  checkOutputBufferLimit(outputBufferLimit());
+}
+
+void Connection::ReplyMultiLen(int64_t len) {
+  if (reply_sink_) {
+    reply_sink_->MultiLen(len);
+    return;
+  }
+  if (obuf_limit_reached_) return;
+  owner_->svr_->stats_.IncrOutbondBytes(Redis::MultiLen(Output(), len));
+  checkOutputBufferLimit(outputBufferLimit());
+}
+
+void Connection::ReplyMultiBulkString(const std::vector<std::string> &values, bool output_nil_for_empty_string) {
+  if (reply_sink_) {
+    reply_sink_->MultiBulkString(values, output_nil_for_empty_string);
+    return;
+  }
+  if (obuf_limit_reached_) return;
+  owner_->svr_->stats_.IncrOutbondBytes(Redis::MultiBulkString(Output(), values, output_nil_for_empty_string));
+  checkOutputBufferLimit(outputBufferLimit());
+}
+
+void Connection::ReplyMultiBulkString(const std::vector<std::string> &values,
+                                      const std::vector<rocksdb::Status> &statuses) {
+  if (reply_sink_) {
+    reply_sink_->MultiBulkString(values, statuses);
+    return;
+  }
+  if (obuf_limit_reached_) return;
+  owner_->svr_->stats_.IncrOutbondBytes(Redis::MultiBulkString(Output(), values, statuses));
+  checkOutputBufferLimit(outputBufferLimit());
+}
+
+// The monitor clients are limited as the pubsub clients since both of them are fed by other clients
+const OutputBufferLimit &Connection::outputBufferLimit() {
+  auto config = svr_->GetConfig();
+  if (IsFlagEnabled(kMonitor) || GetClientType() == kTypePubsub) {
+    return config->pubsub_output_buffer_limit;
+  }
+  return config->normal_output_buffer_limit;
+}
+
+void Connection::checkOutputBufferLimit(const OutputBufferLimit &limit) {
+  // The replicas are fed by the replication thread rather than the output buffer
+  if (!limit.Enabled() || IsFlagEnabled(kSlave)) return;
+
+  uint64_t size = evbuffer_get_length(Output());
+  bool exceeded = limit.hard_limit != 0 && size >= limit.hard_limit;
+  if (!exceeded && limit.soft_limit != 0 && size >= limit.soft_limit) {
+    int64_t now = Server::GetUnixTime();
+    int64_t reached_time = 0;
+    if (!obuf_soft_limit_reached_time_.compare_exchange_strong(reached_time, now)) {
+      exceeded = now - reached_time >= limit.soft_seconds;
+    }
+  } else if (!exceeded) {
+    obuf_soft_limit_reached_time_ = 0;
+  }
+  if (!exceeded || obuf_limit_reached_.exchange(true)) return;
+
+  LOG(WARNING) << "[connection] Going to close the client: " << GetAddr()
+               << ", since its output buffer exceeded the limit, size: " << size;
+  // Free the pending replies right now, and close the client in its worker
+  evbuffer_drain(Output(), size);
+  EnableFlag(kCloseAsync);
+  bufferevent_trigger(bev_, EV_WRITE, 0);
+}
+
+// Stop reading from the client until most of its pending replies were sent,
+// so that the output buffer of a pipelining client wouldn't grow without bound.
+void Connection::pauseReadIfNeeded() {
+  size_t threshold = static_cast<size_t>(svr_->GetConfig()->client_output_buffer_pause_mb) * MiB;
+  if (threshold == 0 || evbuffer_get_length(Output()) < threshold) return;
+
+  // Don't touch the connection which was blocking or offloading
+  bufferevent_data_cb read_cb = nullptr;
+  bufferevent_getcb(bev_, &read_cb, nullptr, nullptr, nullptr);
+  if (read_cb != OnRead) return;
+
+  bufferevent_disable(bev_, EV_READ);
+  // The write callback would be invoked once the output buffer was drained below the low watermark
+  bufferevent_setwatermark(bev_, EV_WRITE, threshold / 2, 0);
+  read_paused_ = true;
+}
+
+// Every reply would add the write event and each of them costs an epoll_ctl, the replies of
+// the pipeline are sent by one writev after executing it instead
+void Connection::corkReplies() {
+  if (!svr_->GetConfig()->pipeline_reply_cork || evbuffer_get_length(Output()) > 0) return;
+  // The write event may be added by the wakeup of other threads, it mustn't be dropped
+  if (event_pending(&bev_->ev_write, EV_WRITE, nullptr)) return;
+  // The bufferevent accounts the writes of rate limited and TLS connections itself
+  if (owner_->IsRateLimited()) return;
+#ifdef ENABLE_OPENSSL
+  if (bufferevent_openssl_get_ssl(bev_)) return;
+#endif
+  bufferevent_disable(bev_, EV_WRITE);
+  corked_ = true;
+}
+
+void Connection::uncorkReplies() {
+  if (!corked_) return;
+  corked_ = false;
+
+  bufferevent_data_cb read_cb = nullptr;
+  bufferevent_getcb(bev_, &read_cb, nullptr, nullptr, nullptr);
+  // The blocking or offloaded command and closing after the reply need the write callback
+  bool direct = read_cb == OnRead && !IsFlagEnabled(kCloseAfterReply);
+  // The replies mustn't be sent before the WAL of pipelined writes was synced
+  if (direct && !svr_->storage_->IsDeferringSync() && evbuffer_get_length(Output()) > 0) {
+    // It's fine to fail with EAGAIN, the rest would be written by the bufferevent.
+    evbuffer_write(Output(), GetFD());
+  }
+  bufferevent_lock(bev_);
+  if (direct && evbuffer_get_length(Output()) == 0) {
+    // Mark the write as enabled without adding the event, it's added once the output isn't empty again
+    bev_->enabled |= EV_WRITE;
+  } else {
+    bufferevent_enable(bev_, EV_WRITE);
+  }
+  bufferevent_unlock(bev_);
+}
+
+void Connection::resumeRead() {
+  read_paused_ = false;
+  bufferevent_setwatermark(bev_, EV_WRITE, 0, 0);
+  if (throttled_) return;  // the reads are resumed by the throttle timer
+  bufferevent_enable(bev_, EV_READ);
+  // The rest of the pipeline may be left by the rate limits or the quantum of the namespace
+  if (!req_.GetCommands()->empty()) bufferevent_trigger(bev_, EV_READ, BEV_TRIG_IGNORE_WATERMARKS);
+}
+
+void Connection::throttle(uint64_t wait_us) {
+  throttled_ = true;
+  bufferevent_disable(bev_, EV_READ);
+  throttle_timer_ = evtimer_new(bufferevent_get_base(bev_), onThrottleTimeout, this);
+  timeval tm = {static_cast<time_t>(wait_us / 1000000), static_cast<suseconds_t>(wait_us % 1000000)};
+  evtimer_add(throttle_timer_, &tm);
+}
+
+void Connection::onThrottleTimeout(int, int16_t, void *ctx) {
+  auto conn = static_cast<Connection *>(ctx);
+  conn->throttled_ = false;
+  // The timer belongs to the event base of the worker, so it isn't kept for the connection may be migrated
+  event_free(conn->throttle_timer_);
+  conn->throttle_timer_ = nullptr;
+  // The reads are resumed by the others if the connection is paused or waiting for the replicas
+  bufferevent_data_cb read_cb = nullptr;
+  bufferevent_getcb(conn->bev_, &read_cb, nullptr, nullptr, nullptr);
+  if (conn->read_paused_ || read_cb != OnRead) return;
+  bufferevent_enable(conn->bev_, EV_READ);
+  bufferevent_trigger(conn->bev_, EV_READ, BEV_TRIG_IGNORE_WATERMARKS);
+}
+
+void Connection::FlushReply(size_t threshold) {
+  if (reply_sink_ || evbuffer_get_length(Output()) < threshold) return;
+  // The replies mustn't be sent before the WAL of pipelined writes was synced
+  if (svr_->storage_->IsDeferringSync()) return;
+  // The replies of the transaction are dropped if it fails to commit, see CommandExec
+  if (svr_->storage_->InTxn()) return;
+  // The replies after the writes are held until the replicas acknowledged them, see waitForReplicaAcks
+  if (has_unacked_writes_ && svr_->GetConfig()->min_replicas_to_ack > 0) return;
+#ifdef ENABLE_OPENSSL
+  // TLS connections must be written through the bufferevent
+  if (bufferevent_openssl_get_ssl(bev_)) return;
+#endif
+  // It's fine to fail with EAGAIN, the rest would be written by the bufferevent.
+  int written = evbuffer_write(Output(), GetFD());
+  if (written > 0) flushed_reply_bytes_ += static_cast<size_t>(written);
 }
 
 void Connection::SendFile(int fd) {
@@ -155,7 +527,9 @@ uint64_t Connection::GetIdleTime() {
 //  kTypePubsub -> Client subscribed to Pub/Sub channels
 uint64_t Connection::GetClientType() {
   if (IsFlagEnabled(kSlave)) return kTypeSlave;
-  if (!subscribe_channels_.empty() || !subcribe_patterns_.empty()) return kTypePubsub;
+  if (!subscribe_channels_.empty() || !subcribe_patterns_.empty() || !subscribe_shard_channels_.empty()) {
+    return kTypePubsub;
+  }
   return kTypeNormal;
 }
 
@@ -164,7 +538,8 @@ std::string Connection::GetFlags() {
   if (IsFlagEnabled(kSlave)) flags.append("S");
   if (IsFlagEnabled(kCloseAfterReply)) flags.append("c");
   if (IsFlagEnabled(kMonitor)) flags.append("M");
-  if (!subscribe_channels_.empty() || !subcribe_patterns_.empty()) flags.append("P");
+  if (IsFlagEnabled(kTracking)) flags.append("t");
+  if (GetClientType() == kTypePubsub) flags.append("P");
   if (flags.empty()) flags = "N";
   return flags;
 }
@@ -250,6 +625,38 @@ void Connection::PUnSubscribeAll(const unsubscribe_callback &reply) {
 
 int Connection::PSubscriptionsCount() { return static_cast<int>(subcribe_patterns_.size()); }
 
+void Connection::SSubscribeChannel(const std::string &channel) {
+  for (const auto &chan : subscribe_shard_channels_) {
+    if (channel == chan) return;
+  }
+  subscribe_shard_channels_.emplace_back(channel);
+  owner_->svr_->SubscribeChannel(channel, this, true);
+}
+
+void Connection::SUnSubscribeChannel(const std::string &channel) {
+  auto iter = std::find(subscribe_shard_channels_.begin(), subscribe_shard_channels_.end(), channel);
+  if (iter == subscribe_shard_channels_.end()) return;
+  subscribe_shard_channels_.erase(iter);
+  owner_->svr_->UnSubscribeChannel(channel, this, true);
+}
+
+// The shard channels are counted apart from the channels and patterns like Redis
+void Connection::SUnSubscribeAll(const unsubscribe_callback &reply) {
+  if (subscribe_shard_channels_.empty()) {
+    if (reply != nullptr) reply("", 0);
+    return;
+  }
+  int removed = 0;
+  for (const auto &chan : subscribe_shard_channels_) {
+    owner_->svr_->UnSubscribeChannel(chan, this, true);
+    removed++;
+    if (reply != nullptr) reply(chan, static_cast<int>(subscribe_shard_channels_.size() - removed));
+  }
+  subscribe_shard_channels_.clear();
+}
+
+int Connection::SSubscriptionsCount() { return static_cast<int>(subscribe_shard_channels_.size()); }
+
 bool Connection::isProfilingEnabled(const std::string &cmd) {
   auto config = svr_->GetConfig();
   if (config->profiling_sample_ratio == 0) return false;
@@ -285,14 +692,230 @@ void Connection::recordProfilingSampleIfNeed(const std::string &cmd, uint64_t du
   svr_->GetPerfLog()->PushEntry(entry);
 }
 
+bool Connection::isPerfStatsSampling(bool is_profiling) {
+  // Count the commands per thread, so the sampling needn't be synchronized between the workers
+  thread_local uint64_t commands_since_sample = 0;
+  int interval = svr_->GetConfig()->perf_stats_sample_interval;
+  if (interval <= 0 || ++commands_since_sample < static_cast<uint64_t>(interval)) return false;
+  commands_since_sample = 0;
+  if (!is_profiling) {
+    rocksdb::SetPerfLevel(rocksdb::PerfLevel::kEnableTimeExceptForMutex);
+    rocksdb::get_perf_context()->Reset();
+    rocksdb::get_iostats_context()->Reset();
+  }
+  return true;
+}
+
+void Connection::recordPerfStatsSample(const CommandAttributes &attributes, bool is_profiling) {
+  auto perf_context = rocksdb::get_perf_context();
+  PerfSample sample;
+  sample[PERF_BLOCK_CACHE_HITS] = perf_context->block_cache_hit_count;
+  sample[PERF_BLOCK_READS] = perf_context->block_read_count;
+  sample[PERF_BLOCK_READ_BYTES] = perf_context->block_read_byte;
+  sample[PERF_BYTES_READ] = rocksdb::get_iostats_context()->bytes_read;
+  sample[PERF_SEEKS] = perf_context->iter_seek_count;
+  sample[PERF_GET_FROM_MEMTABLE_NANOS] = perf_context->get_from_memtable_time;
+  sample[PERF_WRITE_WAL_NANOS] = perf_context->write_wal_time;
+  // The profiling sample is recorded and disables the perf context afterwards
+  if (!is_profiling) rocksdb::SetPerfLevel(rocksdb::PerfLevel::kDisable);
+  svr_->stats_.RecordPerfSample(attributes.id, sample);
+}
+
+bool Connection::beginTracedExecution() {
+  if (!trace_ || rocksdb::GetPerfLevel() != rocksdb::PerfLevel::kDisable) return false;
+  rocksdb::SetPerfLevel(rocksdb::PerfLevel::kEnableTimeExceptForMutex);
+  rocksdb::get_perf_context()->Reset();
+  return true;
+}
+
+void Connection::endTracedExecution(uint64_t begin_us, bool enabled_perf) {
+  trace_->Record(TRACE_STAGE_EXECUTE, begin_us, Util::GetTimeStampUS());
+  // The storage stages are spread over the execution, so they're placed at its start
+  auto perf_context = rocksdb::get_perf_context();
+  uint64_t read_nanos = perf_context->get_from_memtable_time + perf_context->get_from_output_files_time +
+                        perf_context->seek_internal_seek_time + perf_context->find_next_user_entry_time;
+  if (read_nanos > 0) trace_->Record(TRACE_STAGE_STORAGE_READ, begin_us, begin_us + read_nanos / 1000);
+  if (perf_context->write_wal_time > 0) {
+    trace_->Record(TRACE_STAGE_WAL_WRITE, begin_us, begin_us + perf_context->write_wal_time / 1000);
+  }
+  if (enabled_perf) rocksdb::SetPerfLevel(rocksdb::PerfLevel::kDisable);
+}
+
+void Connection::recordHotKeys(const CommandAttributes &attributes, const std::vector<std::string> &cmd_args) {
+  // Only count the first keys of the commands with many keys to bound the cost of the sample
+  constexpr int kMaxSampledKeys = 16;
+
+  int argc = static_cast<int>(cmd_args.size());
+  int last_key = attributes.last_key < 0 ? argc + attributes.last_key : attributes.last_key;
+  int step = attributes.key_step > 0 ? attributes.key_step : argc;
+  auto hot_keys = owner_->GetHotKeys();
+  auto now_ms = Util::GetTimeStampMS();
+  int sampled = 0;
+  for (int i = attributes.first_key; i <= last_key && i < argc && sampled < kMaxSampledKeys; i += step, sampled++) {
+    hot_keys->Record(ns_, cmd_args[i], attributes.is_write(), now_ms);
+  }
+}
+
+int Connection::trafficSlot(const CommandAttributes &attributes, const std::vector<std::string> &cmd_args) const {
+  // The keys of a command are in the same slot unless the local cross-slot commands are allowed,
+  // then the traffic is recorded in the slot of the first key
+  if (!svr_->GetConfig()->cluster_enabled || attributes.first_key <= 0) return -1;
+  if (attributes.first_key >= static_cast<int>(cmd_args.size())) return -1;
+  return GetSlotNumFromKey(cmd_args[attributes.first_key]);
+}
+
 void Connection::ExecuteCommands(std::deque<CommandTokens> *to_process_cmds) {
+  Config *config = svr_->GetConfig();
+  // Share one WAL sync among the writes of the pipeline, the replies are only
+  // sent after the event loop regains control, which is after the sync.
+  bool group_commit = config->pipeline_group_commit && config->RocksDB.write_options.sync &&
+                      to_process_cmds->size() > 1 && svr_->storage_->BeginDeferredSync();
+  size_t output_len = evbuffer_get_length(Output());
+  if (config->pipeline_read_prefetch && to_process_cmds->size() > 1 && !IsFlagEnabled(Connection::kMultiExec)) {
+    prefetchReads(*to_process_cmds);
+  }
+  bool import_batching = IsImporting() && !IsFlagEnabled(Connection::kMultiExec);
+  if (group_commit) {
+    import_batching ? executeImportCommands(to_process_cmds) : executeCommands(to_process_cmds);
+    auto s = svr_->storage_->EndDeferredSync();
+    if (!s.ok()) {
+      // The replies of the pipeline must not be sent since the writes may be lost
+      LOG(ERROR) << "[connection] Failed to sync the WAL of pipelined writes: " << s.ToString();
+      evbuffer_drain(Output(), evbuffer_get_length(Output()) - output_len);
+      EnableFlag(kCloseAfterReply);
+      Reply(Redis::Error("ERR failed to sync the WAL: " + s.ToString()));
+    }
+  } else {
+    import_batching ? executeImportCommands(to_process_cmds) : executeCommands(to_process_cmds);
+  }
+  // The writes of the transaction are committed after its commands were executed
+  if (!in_exec_ && !pending_invalidations_.empty()) {
+    svr_->SendInvalidations(pending_invalidations_);
+    pending_invalidations_.clear();
+  }
+}
+
+void Connection::executeImportCommands(std::deque<CommandTokens> *to_process_cmds) {
+  auto is_restore = [](const CommandTokens &cmd_tokens) {
+    const auto attributes = LookupCommand(cmd_tokens.front());
+    return attributes && attributes->name == "restore";
+  };
+
+  while (!to_process_cmds->empty()) {
+    // Split the commands into the runs of RESTOREs and the others, the replies keep the order
+    std::deque<CommandTokens> cmds;
+    bool restores = is_restore(to_process_cmds->front());
+    while (!to_process_cmds->empty() && is_restore(to_process_cmds->front()) == restores) {
+      cmds.emplace_back(std::move(to_process_cmds->front()));
+      to_process_cmds->pop_front();
+    }
+    if (!restores || cmds.size() < 2 || GetNamespace().empty()) {
+      executeCommands(&cmds);
+      continue;
+    }
+
+    size_t output_len = evbuffer_get_length(Output());
+    size_t num_restores = cmds.size();
+    RestoreBatch restore_batch;
+    restore_batch_ = &restore_batch;
+    executeCommands(&cmds);
+    restore_batch_ = nullptr;
+    Redis::Database db(svr_->storage_, GetNamespace());
+    auto s = db.WriteRestoreBatch(&restore_batch);
+    if (!restore_batch.write_status.ok()) s = restore_batch.write_status;
+    if (!s.ok()) {
+      // The replies of the lost keys must not be sent, the source would retry the migration
+      LOG(ERROR) << "[connection] Failed to write the batch of the restored keys: " << s.ToString();
+      evbuffer_drain(Output(), evbuffer_get_length(Output()) - output_len);
+      EnableFlag(kCloseAfterReply);
+      Reply(Redis::Error("ERR failed to write the restored keys: " + s.ToString()));
+      return;
+    }
+    svr_->stats_.import_batched_restores.fetch_add(num_restores, std::memory_order_relaxed);
+  }
+}
+
+// The single-key read commands whose reads are prefetched, it's the type of the key and the
+// arguments of the sub keys, e.g. HGET key field reads the field of the hash. The commands
+// of the other types (kRedisNone) only read the metadata.
+struct PrefetchSpec {
+  RedisType type;
+  size_t first_sub_key;  // 0 if it doesn't read the sub keys
+  bool multi_sub_keys;   // all arguments from the first sub key are sub keys
+};
+
+static const std::map<std::string, PrefetchSpec, std::less<>> kPrefetchSpecs = {
+    {"get", {kRedisString, 0, false}},        {"strlen", {kRedisString, 0, false}},
+    {"exists", {kRedisNone, 0, false}},       {"type", {kRedisNone, 0, false}},
+    {"ttl", {kRedisNone, 0, false}},          {"pttl", {kRedisNone, 0, false}},
+    {"hget", {kRedisHash, 2, false}},         {"hexists", {kRedisHash, 2, false}},
+    {"hmget", {kRedisHash, 2, true}},         {"hlen", {kRedisHash, 0, false}},
+    {"sismember", {kRedisSet, 2, false}},     {"smismember", {kRedisSet, 2, true}},
+    {"scard", {kRedisSet, 0, false}},         {"zscore", {kRedisZSet, 2, false}},
+    {"zmscore", {kRedisZSet, 2, true}},       {"zcard", {kRedisZSet, 0, false}},
+    {"llen", {kRedisList, 0, false}},
+};
+
+void Connection::prefetchReads(const std::deque<CommandTokens> &to_process_cmds) {
+  // The commands may fail to authenticate, they're executed in the namespace of the connection
+  if (GetNamespace().empty()) return;
+
+  std::vector<PrefetchKey> keys;
+  for (const auto &cmd_tokens : to_process_cmds) {
+    const auto attributes = LookupCommand(cmd_tokens.front());
+    if (!attributes) continue;
+    auto iter = kPrefetchSpecs.find(attributes->name);
+    if (iter == kPrefetchSpecs.end() || cmd_tokens.size() < 2) continue;
+
+    const auto &spec = iter->second;
+    auto &key = keys.emplace_back();
+    key.user_key = cmd_tokens[1];
+    key.type = spec.type;
+    if (spec.first_sub_key == 0) continue;
+    size_t last = spec.multi_sub_keys ? cmd_tokens.size() : std::min(cmd_tokens.size(), spec.first_sub_key + 1);
+    for (size_t i = spec.first_sub_key; i < last; i++) {
+      key.sub_keys.emplace_back(cmd_tokens[i]);
+    }
+  }
+  // A single read doesn't benefit from the batching
+  if (keys.size() < 2) return;
+
+  Redis::Database db(svr_->storage_, GetNamespace());
+  db.Prefetch(keys);
+}
+
+// The read commands of a single key whose replies are coalesced, the replies of the commands
+// are only decided by the key, e.g. not random like SRANDMEMBER
+static const std::set<std::string, std::less<>> kCoalescedCommands = {
+    "get",    "getrange", "strlen", "hget",      "hmget",  "hgetall", "hkeys",         "hvals",
+    "hlen",   "smembers", "scard",  "sismember", "zrange", "zscore",  "zrangebyscore", "zrevrange",
+    "zcard",  "lrange",   "lindex", "llen",
+};
+
+void Connection::executeCommands(std::deque<CommandTokens> *to_process_cmds) {
   Config *config = svr_->GetConfig();
   std::string reply, password = config->requirepass;
+  // Only the pipeline of the connection is scheduled with the QoS of its namespace, not the
+  // commands of the transactions or the imported batches
+  bool qos_scheduled = to_process_cmds == req_.GetCommands();
+  size_t executed_cmds = 0;
 
   while (!to_process_cmds->empty()) {
-    auto cmd_tokens = to_process_cmds->front();
+    auto cmd_tokens = std::move(to_process_cmds->front());
     to_process_cmds->pop_front();
 
+    trace_.reset();
+    if (read_us_ > 0) {
+      // Count the requests per thread, so the sampling needn't be synchronized between the workers
+      thread_local uint64_t requests_since_trace = 0;
+      int interval = config->request_trace_sample_interval;
+      if (interval > 0 && ++requests_since_trace >= static_cast<uint64_t>(interval)) {
+        requests_since_trace = 0;
+        trace_ = std::make_unique<RequestTrace>(read_us_);
+        trace_->Record(TRACE_STAGE_QUEUE, read_us_, Util::GetTimeStampUS());
+      }
+    }
+
     if (IsFlagEnabled(Redis::Connection::kCloseAfterReply) && !IsFlagEnabled(Connection::kMultiExec)) break;
 
     auto s = svr_->LookupAndCreateCommand(cmd_tokens.front(), &current_cmd_);
@@ -303,8 +926,8 @@ void Connection::ExecuteCommands(std::deque<CommandTokens> *to_process_cmds) {
     }
 
     if (GetNamespace().empty()) {
-      if (!password.empty() && Util::ToLower(cmd_tokens.front()) != "auth" &&
-          Util::ToLower(cmd_tokens.front()) != "hello") {
+      const auto &name = current_cmd_->GetAttributes()->name;
+      if (!password.empty() && name != "auth" && name != "hello") {
         Reply(Redis::Error("NOAUTH Authentication required."));
         continue;
       }
@@ -316,17 +939,24 @@ void Connection::ExecuteCommands(std::deque<CommandTokens> *to_process_cmds) {
 
     const auto attributes = current_cmd_->GetAttributes();
     auto cmd_name = attributes->name;
+    // The scripts declaring their keys and the transactions may run under the locks of their
+    // keys rather than exclusively
+    bool script_key_locking =
+        (cmd_name == "eval" || cmd_name == "evalsha") && Lua::RunsUnderKeyLocks(config, cmd_tokens);
+    bool exec_key_locking = cmd_name == "exec" && IsFlagEnabled(Connection::kMultiExec) && !in_exec_ &&
+                            !multi_error_ && GetMultiExecKeys(nullptr);
 
-    std::unique_ptr<RWLock::ReadLock> concurrency;   // Allow concurrency
-    std::unique_ptr<RWLock::WriteLock> exclusivity;  // Need exclusivity
+    std::unique_ptr<RWLock::ShardedReadLock> concurrency;   // Allow concurrency
+    std::unique_ptr<RWLock::ShardedWriteLock> exclusivity;  // Need exclusivity
     // If the command need to process exclusively, we need to get 'ExclusivityGuard'
     // that can guarantee other threads can't come into critical zone, such as DEBUG,
     // CLUSTER subcommand, CONFIG SET, MULTI, LUA (in the immediate future).
     // Otherwise, we just use 'ConcurrencyGuard' to allow all workers to execute
     // commands at the same time.
     if (IsFlagEnabled(Connection::kMultiExec) && attributes->name != "exec") {
-      // No lock guard, because 'exec' command has acquired 'WorkExclusivityGuard'
-    } else if (attributes->is_exclusive() ||
+      // No lock guard, because 'exec' command has acquired 'WorkExclusivityGuard',
+      // or 'ConcurrencyGuard' and the locks of the keys of the queued commands
+    } else if ((attributes->is_exclusive() && !script_key_locking && !exec_key_locking) ||
                (cmd_name == "config" && cmd_tokens.size() == 2 && !strcasecmp(cmd_tokens[1].c_str(), "set")) ||
                (config->cluster_enabled && (cmd_name == "clusterx" || cmd_name == "cluster") &&
                 cmd_tokens.size() >= 2 && Cluster::SubCommandIsExecExclusive(cmd_tokens[1]))) {
@@ -341,9 +971,34 @@ void Connection::ExecuteCommands(std::deque<CommandTokens> *to_process_cmds) {
       concurrency = svr_->WorkConcurrencyGuard();
     }
 
-    if (cmd_name == "eval_ro" || cmd_name == "evalsha_ro") {
-      // if executing read only lua script commands, set current
-      // connection.
+    // The config is read under the guard since the namespace QoS may be changed by CONFIG SET.
+    // The pipeline yields to the other connections of the worker once it ran out of the quantum
+    // of its namespace, which is weighted, and the commands over the rate limits of the namespace
+    // are delayed. The command is put back to be executed when the connection is resumed.
+    if (qos_scheduled && !GetNamespace().empty()) {
+      auto qos = config->GetNamespaceQoS(GetNamespace());
+      auto quantum = static_cast<size_t>(config->namespace_pipeline_quantum) * qos.weight;
+      if (quantum > 0 && ++executed_cmds > quantum) {
+        to_process_cmds->push_front(std::move(cmd_tokens));
+        bufferevent_trigger(bev_, EV_READ, BEV_TRIG_IGNORE_WATERMARKS | BEV_TRIG_DEFER_CALLBACKS);
+        break;
+      }
+      if (qos.max_ops_per_sec != 0 || qos.max_bytes_per_sec != 0) {
+        uint64_t request_bytes = 0;
+        for (const auto &token : cmd_tokens) request_bytes += token.size();
+        uint64_t wait_us = svr_->GetNamespaceQoS()->Acquire(
+            GetNamespace(), {qos.max_ops_per_sec, qos.max_bytes_per_sec}, request_bytes, Util::GetTimeStampUS());
+        if (wait_us > 0) {
+          to_process_cmds->push_front(std::move(cmd_tokens));
+          throttle(wait_us);
+          break;
+        }
+      }
+    }
+
+    if (cmd_name == "eval_ro" || cmd_name == "evalsha_ro" || script_key_locking) {
+      // if executing read only lua script commands or the scripts under
+      // the key locks, set current connection.
       svr_->SetCurrentConnection(this);
     }
 
@@ -359,8 +1014,13 @@ void Connection::ExecuteCommands(std::deque<CommandTokens> *to_process_cmds) {
       Reply(Redis::Error("ERR wrong number of arguments"));
       continue;
     }
-    current_cmd_->SetArgs(cmd_tokens);
-    s = current_cmd_->Parse();
+    // The tokens are moved into the commander, use its args from now on
+    auto cmd = current_cmd_.get();
+    cmd->SetArgs(std::move(cmd_tokens));
+    const auto &cmd_args = cmd->Args();
+    uint64_t parse_begin_us = trace_ ? Util::GetTimeStampUS() : 0;
+    s = cmd->Parse();
+    if (trace_) trace_->Record(TRACE_STAGE_PARSE, parse_begin_us, Util::GetTimeStampUS());
     if (!s.IsOK()) {
       if (IsFlagEnabled(Connection::kMultiExec)) multi_error_ = true;
       Reply(Redis::Error("ERR " + s.Msg()));
@@ -375,7 +1035,7 @@ void Connection::ExecuteCommands(std::deque<CommandTokens> *to_process_cmds) {
     }
 
     if (config->cluster_enabled) {
-      s = svr_->cluster_->CanExecByMySelf(attributes, cmd_tokens, this);
+      s = svr_->cluster_->CanExecByMySelf(attributes, cmd_args, this);
       if (!s.IsOK()) {
         if (IsFlagEnabled(Connection::kMultiExec)) multi_error_ = true;
         Reply(Redis::Error(s.Msg()));
@@ -385,7 +1045,8 @@ void Connection::ExecuteCommands(std::deque<CommandTokens> *to_process_cmds) {
 
     // We don't execute commands, but queue them, ant then execute in EXEC command
     if (IsFlagEnabled(Connection::kMultiExec) && !in_exec_ && !attributes->is_multi()) {
-      multi_cmds_.emplace_back(cmd_tokens);
+      multi_cmds_.emplace_back(cmd_args);
+      multi_mem_.fetch_add(GetTokensMemory(multi_cmds_.back()), std::memory_order_relaxed);
       Reply(Redis::SimpleString("QUEUED"));
       continue;
     }
@@ -394,45 +1055,350 @@ void Connection::ExecuteCommands(std::deque<CommandTokens> *to_process_cmds) {
       Reply(Redis::Error("READONLY You can't write against a read only slave."));
       continue;
     }
+    // The write would block the worker inside RocksDB until the write stall ends, so are
+    // the reads of the other connections on this worker, wait for a bounded time instead
+    if (attributes->is_write() && !svr_->storage_->WaitForWriteStallEnd(config->write_stall_timeout_ms)) {
+      svr_->stats_.write_stall_rejected_cmds++;
+      Reply(Redis::Error("BUSYWRITE the writes are stopped by the write stall of the storage, try again later"));
+      continue;
+    }
+    // The namespace over its disk quota can only delete its keys to free the space
+    if (attributes->is_write() && cmd_name != "del" && cmd_name != "unlink" && cmd_name != "flushdb" &&
+        svr_->storage_->GetNamespaceSizes()->IsOverQuota(GetNamespace())) {
+      Reply(Redis::Error("ERR the disk quota of the namespace is exceeded, only deletions are allowed"));
+      continue;
+    }
+    // The replicas of this replica can still synchronize with it while its link with the master is down
     if (!config->slave_serve_stale_data && svr_->IsSlave() && cmd_name != "info" && cmd_name != "slaveof" &&
-        svr_->GetReplicationState() != kReplConnected) {
+        cmd_name != "auth" && !attributes->is_replication() && svr_->GetReplicationState() != kReplConnected) {
       Reply(
           Redis::Error("MASTERDOWN Link with MASTER is down "
                        "and slave-serve-stale-data is set to 'no'."));
       continue;
     }
 
+    // Reject the reads of the keys if the replica is staler than the client accepts
+    if (max_read_lag_ms_ >= 0 && svr_->IsSlave() && attributes->first_key != 0) {
+      auto lag = svr_->GetReplicationLagMS();
+      if (lag < 0 || lag > max_read_lag_ms_) {
+        Reply(Redis::Error("STALE the replica lags " + (lag < 0 ? "unknown" : std::to_string(lag)) +
+                           " ms behind the master, which exceeds MAXLAG " + std::to_string(max_read_lag_ms_)));
+        continue;
+      }
+    }
+
     SetLastCmd(cmd_name);
-    svr_->stats_.IncrCalls(cmd_name);
+    svr_->stats_.IncrCalls(attributes->id);
+    int traffic_slot = trafficSlot(*attributes, cmd_args);
+    if (traffic_slot >= 0) {
+      uint64_t write_bytes = 0;
+      if (attributes->is_write()) {
+        for (const auto &arg : cmd_args) write_bytes += arg.size();
+      }
+      svr_->stats_.IncrSlotCall(traffic_slot, write_bytes);
+    }
+    if (attributes->first_key != 0 && owner_->GetHotKeys()->ShouldSample(config->hotkeys_sample_interval)) {
+      recordHotKeys(*attributes, cmd_args);
+    }
+    // The keys are remembered before they're read, so a concurrent write wouldn't be missed
+    if (IsFlagEnabled(kTracking) && !attributes->is_write() && attributes->first_key != 0) {
+      svr_->TrackKeysFromArgs(this, cmd_args, *attributes, &pending_invalidations_);
+    }
+    // The same reads of the hot key in the window share the reply of the first one
+    std::string coalesce_request;
+    uint64_t coalesce_epoch = 0;
+    if (config->read_coalesce_window_ms > 0 && !in_exec_ && cmd_args.size() > 1 &&
+        kCoalescedCommands.count(cmd_name) > 0) {
+      std::string ns_key;
+      ComposeNamespaceKey(ns_, cmd_args[1], &ns_key, svr_->storage_->IsSlotIdEncoded());
+      // The epoch is taken before the key is read, so a concurrent write would drop the reply
+      coalesce_epoch = svr_->GetKeyWriteEpochs()->Get(ns_key);
+      coalesce_request = ReplyCoalescer::EncodeRequest(ns_, cmd_args);
+      std::string coalesced_reply;
+      if (owner_->GetReplyCoalescer()->Lookup(coalesce_request, coalesce_epoch, Util::GetTimeStampMS(),
+                                              &coalesced_reply)) {
+        svr_->stats_.coalesced_cmds++;
+        if (traffic_slot >= 0) svr_->stats_.IncrSlotReadBytes(traffic_slot, coalesced_reply.size());
+        svr_->FeedMonitorConns(this, cmd_args);
+        Reply(coalesced_reply);
+        continue;
+      }
+    }
+    // The slow command would be executed in the offload threads, and the rest of
+    // the pipeline would be processed after its reply was sent back to the worker.
+    // The read-only scripts are executed in the read-only script threads likewise.
+    TaskRunner *script_runner =
+        cmd_name == "eval_ro" || cmd_name == "evalsha_ro" ? svr_->GetReadOnlyScriptRunner() : nullptr;
+    if (((attributes->is_slow() && !attributes->is_write() && owner_->IsOffloadEnabled()) || script_runner) &&
+        concurrency && to_process_cmds == req_.GetCommands()) {
+      concurrency.reset();  // it would be acquired by the offload thread
+      if (offloadCommand(cmd_args, script_runner)) {
+        offloaded_->coalesce_request = std::move(coalesce_request);
+        offloaded_->coalesce_epoch = coalesce_epoch;
+        break;
+      }
+      concurrency = svr_->WorkConcurrencyGuard();
+    }
+    // The other reads are tried in the worker without the disk I/O first, and offloaded only if
+    // they missed the cache, so the reads hitting the cache don't pay for the offloading
+    bool cache_only = config->worker_offload_cache_missed_reads && !attributes->is_write() &&
+                      attributes->first_key != 0 && owner_->IsOffloadEnabled() && concurrency &&
+                      to_process_cmds == req_.GetCommands() && !script_runner;
+    bool cache_missed = false;
+    // EXEC would replace the current commander with the queued commands, but its
+    // args are still used after the execution, so hold it until the end of the loop
+    std::unique_ptr<Commander> exec_cmd;
+    if (cmd_name == "exec") exec_cmd = std::move(current_cmd_);
+    if (attributes->is_write()) svr_->UpdateWatchedKeysFromArgs(cmd_args, *attributes, ns_);
     auto start = std::chrono::high_resolution_clock::now();
     bool is_profiling = isProfilingEnabled(cmd_name);
-    s = current_cmd_->Execute(svr_, this, &reply);
+    bool is_perf_sampling = isPerfStatsSampling(is_profiling);
+    bool trace_enabled_perf = beginTracedExecution();
+    uint64_t execute_begin_us = trace_ ? Util::GetTimeStampUS() : 0;
+    size_t output_len = evbuffer_get_length(Output());
+    // Most of the coalesced reads write their replies directly, so they're captured to be coalesced
+    UniqueEvbuf captured_reply;
+    evbuffer *reply_output = coalesce_request.empty() ? Output() : captured_reply.get();
+    {
+      RequestTrace::Scope trace_scope(trace_.get());
+      s = cache_only ? executeCacheOnly(cmd, &reply, reply_output, &cache_missed)
+                     : executeCaptured(cmd, &reply, reply_output);
+    }
     auto end = std::chrono::high_resolution_clock::now();
+    if (exec_cmd && !current_cmd_) current_cmd_ = std::move(exec_cmd);
     uint64_t duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    if (trace_) endTracedExecution(execute_begin_us, trace_enabled_perf);
+    if (cache_missed) {
+      // Execute it again in the offload thread, where waiting for the disk doesn't stall the worker
+      svr_->stats_.cache_missed_offloaded_cmds++;
+      concurrency.reset();
+      if (offloadCommand(cmd_args, nullptr)) {
+        offloaded_->coalesce_request = std::move(coalesce_request);
+        offloaded_->coalesce_epoch = coalesce_epoch;
+        break;
+      }
+      concurrency = svr_->WorkConcurrencyGuard();
+      start = std::chrono::high_resolution_clock::now();
+      s = executeCaptured(cmd, &reply, reply_output);
+      end = std::chrono::high_resolution_clock::now();
+      duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    }
+    if (s.IsOK() && !coalesce_request.empty()) {
+      coalesceReply(coalesce_request, coalesce_epoch, captured_reply.get(), reply);
+    }
+    appendCapturedReply(captured_reply.get());
+    if (is_perf_sampling) recordPerfStatsSample(*attributes, is_profiling);
     if (is_profiling) recordProfilingSampleIfNeed(cmd_name, duration);
-    svr_->SlowlogPushEntryIfNeeded(&cmd_tokens, duration);
-    svr_->stats_.IncrLatency(static_cast<uint64_t>(duration), cmd_name);
-    svr_->FeedMonitorConns(this, cmd_tokens);
+    svr_->stats_.IncrLatency(static_cast<uint64_t>(duration), attributes->id);
+    svr_->storage_->GetLatencyMonitor()->Record("command", duration / 1000);
+    svr_->FeedMonitorConns(this, cmd_args);
+    // The coalesced replies of the written keys are dropped, even if the write failed halfway
+    if (attributes->is_write() && config->read_coalesce_window_ms > 0) {
+      svr_->BumpKeyWriteEpochsFromArgs(cmd_args, *attributes, ns_);
+    }
 
     // Break the execution loop when occurring the blocking command like BLPOP or BRPOP,
     // it will suspend the connection and wait for the wakeup signal.
     if (s.Is<Status::BlockingCmd>()) {
+      svr_->SlowlogPushEntryIfNeeded(&cmd_args, duration, trace_.get());
       break;
     }
-    // Reply for MULTI
+    // The slow log entry is pushed after replying, so the trace includes the reply stage
+    uint64_t reply_begin_us = trace_ ? Util::GetTimeStampUS() : 0;
     if (!s.IsOK()) {
+      // Reply for MULTI
       Reply(Redis::Error("ERR " + s.Msg()));
+    } else {
+      if (attributes->is_write()) {
+        has_unacked_writes_ = true;
+        svr_->InvalidateTrackedKeysFromArgs(this, cmd_args, *attributes, &pending_invalidations_);
+      }
+      if (!reply.empty()) Reply(std::move(reply));
+      reply.clear();
+    }
+    if (size_t len = evbuffer_get_length(Output()); traffic_slot >= 0 && len > output_len) {
+      svr_->stats_.IncrSlotReadBytes(traffic_slot, len - output_len);
+    }
+    if (trace_) trace_->Record(TRACE_STAGE_REPLY, reply_begin_us, Util::GetTimeStampUS());
+    svr_->SlowlogPushEntryIfNeeded(&cmd_args, duration, trace_.get());
+  }
+}
+
+Status Connection::executeCacheOnly(Commander *cmd, std::string *reply, evbuffer *output, bool *cache_missed) {
+  // The replies are held until the command turned out to hit the cache
+  UniqueEvbuf held_reply;
+  Redis::EvbufferReplySink reply_sink(held_reply.get());
+  SetReplySink(&reply_sink);
+  Engine::Storage::BeginCacheOnlyReads();
+  auto s = cmd->Execute(svr_, this, reply);
+  *cache_missed = Engine::Storage::EndCacheOnlyReads();
+  SetReplySink(nullptr);
+  if (*cache_missed) {
+    reply->clear();
+    return s;
+  }
+
+  if (output != Output()) {
+    evbuffer_add_buffer(output, held_reply.get());
+    return s;
+  }
+  appendCapturedReply(held_reply.get());
+  return s;
+}
+
+Status Connection::executeCaptured(Commander *cmd, std::string *reply, evbuffer *output) {
+  if (output == Output()) return cmd->Execute(svr_, this, reply);
+
+  Redis::EvbufferReplySink reply_sink(output);
+  SetReplySink(&reply_sink);
+  auto s = cmd->Execute(svr_, this, reply);
+  SetReplySink(nullptr);
+  return s;
+}
+
+void Connection::coalesceReply(const std::string &request, uint64_t epoch, evbuffer *captured,
+                               const std::string &reply) {
+  size_t captured_len = evbuffer_get_length(captured);
+  size_t len = captured_len + reply.size();
+  if (len == 0 || len > ReplyCoalescer::kMaxReplySize) return;
+
+  std::string whole_reply(captured_len, '\0');
+  evbuffer_copyout(captured, whole_reply.data(), captured_len);
+  whole_reply.append(reply);
+  owner_->GetReplyCoalescer()->Insert(request, whole_reply, epoch, Util::GetTimeStampMS(),
+                                      svr_->GetConfig()->read_coalesce_window_ms);
+}
+
+void Connection::appendCapturedReply(evbuffer *captured) {
+  if (evbuffer_get_length(captured) == 0) return;
+  svr_->stats_.IncrOutbondBytes(evbuffer_get_length(captured));
+  evbuffer_add_buffer(Output(), captured);
+  checkOutputBufferLimit(outputBufferLimit());
+}
+
+bool Connection::offloadCommand(const CommandTokens &cmd_tokens, TaskRunner *runner) {
+  offloaded_ = std::make_unique<OffloadedCommand>();
+  offloaded_->cmd_tokens = cmd_tokens;
+  // Stop processing the connection until the command was done, and the connection
+  // mustn't be freed in the event callback since it's used by the offload thread.
+  bufferevent_disable(bev_, EV_READ);
+  bufferevent_setcb(bev_, nullptr, nullptr, onOffloadEvent, this);
+  auto s = owner_->Offload([this]() { executeOffloadedCommand(); }, [this]() { onOffloadDone(); }, runner);
+  if (!s.IsOK()) {
+    offloaded_.reset();
+    bufferevent_setcb(bev_, OnRead, OnWrite, OnEvent, this);
+    bufferevent_enable(bev_, EV_READ);
+    return false;
+  }
+  return true;
+}
+
+void Connection::executeOffloadedCommand() {
+  auto concurrency = svr_->WorkConcurrencyGuard();
+  const auto &cmd_name = current_cmd_->GetAttributes()->name;
+  // The output buffer belongs to the worker thread, so capture the replies here
+  Redis::EvbufferReplySink reply_sink(offloaded_->reply.get());
+  SetReplySink(&reply_sink);
+  // The current connection is thread local, it's used by the scripts
+  svr_->SetCurrentConnection(this);
+  auto start = std::chrono::high_resolution_clock::now();
+  bool is_profiling = isProfilingEnabled(cmd_name);
+  bool is_perf_sampling = isPerfStatsSampling(is_profiling);
+  bool trace_enabled_perf = beginTracedExecution();
+  uint64_t execute_begin_us = trace_ ? Util::GetTimeStampUS() : 0;
+  {
+    RequestTrace::Scope trace_scope(trace_.get());
+    offloaded_->status = current_cmd_->Execute(svr_, this, &offloaded_->output);
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  offloaded_->duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+  if (trace_) endTracedExecution(execute_begin_us, trace_enabled_perf);
+  if (is_perf_sampling) recordPerfStatsSample(*current_cmd_->GetAttributes(), is_profiling);
+  if (is_profiling) recordProfilingSampleIfNeed(cmd_name, offloaded_->duration);
+  SetReplySink(nullptr);
+}
+
+void Connection::onOffloadDone() {
+  auto offloaded = std::move(offloaded_);
+  svr_->stats_.IncrLatency(offloaded->duration, current_cmd_->GetAttributes()->id);
+  // The offloaded commands don't stall the event loop, so they're recorded apart from the commands
+  svr_->storage_->GetLatencyMonitor()->Record("offloaded-command", offloaded->duration / 1000);
+  svr_->FeedMonitorConns(this, offloaded->cmd_tokens);
+  if (offloaded->closed) {
+    svr_->SlowlogPushEntryIfNeeded(&offloaded->cmd_tokens, offloaded->duration, trace_.get());
+    Close();
+    return;
+  }
+
+  bufferevent_setcb(bev_, OnRead, OnWrite, OnEvent, this);
+  uint64_t reply_begin_us = trace_ ? Util::GetTimeStampUS() : 0;
+  size_t output_len = evbuffer_get_length(Output());
+  if (offloaded->status.IsOK() && !offloaded->coalesce_request.empty()) {
+    coalesceReply(offloaded->coalesce_request, offloaded->coalesce_epoch, offloaded->reply.get(), offloaded->output);
+  }
+  appendCapturedReply(offloaded->reply.get());
+  if (!offloaded->status.IsOK()) {
+    Reply(Redis::Error("ERR " + offloaded->status.Msg()));
+  } else if (!offloaded->output.empty()) {
+    Reply(offloaded->output);
+  }
+  int traffic_slot = trafficSlot(*current_cmd_->GetAttributes(), offloaded->cmd_tokens);
+  if (size_t len = evbuffer_get_length(Output()); traffic_slot >= 0 && len > output_len) {
+    svr_->stats_.IncrSlotReadBytes(traffic_slot, len - output_len);
+  }
+  if (trace_) trace_->Record(TRACE_STAGE_REPLY, reply_begin_us, Util::GetTimeStampUS());
+  svr_->SlowlogPushEntryIfNeeded(&offloaded->cmd_tokens, offloaded->duration, trace_.get());
+  if (IsFlagEnabled(kCloseAsync)) {
+    Close();
+    return;
+  }
+  bufferevent_enable(bev_, EV_READ);
+  // Process the rest of the pipeline and the requests which arrived in the meantime
+  bufferevent_trigger(bev_, EV_READ, BEV_TRIG_IGNORE_WATERMARKS);
+}
+
+void Connection::onOffloadEvent(bufferevent *bev, int16_t events, void *ctx) {
+  auto conn = static_cast<Connection *>(ctx);
+  if (events & (BEV_EVENT_EOF | BEV_EVENT_ERROR)) {
+    // Free the connection after the offloaded command was done
+    conn->offloaded_->closed = true;
+    bufferevent_disable(bev, EV_READ | EV_WRITE);
+  }
+}
+
+bool Connection::GetMultiExecKeys(std::vector<std::string> *ns_keys) {
+  for (const auto &cmd_tokens : multi_cmds_) {
+    const auto attributes = Redis::LookupCommand(cmd_tokens.front());
+    if (!attributes) return false;
+    // The commands requiring the exclusivity, and the ones which may store into the keys
+    // not in their arguments
+    if (attributes->is_exclusive() || attributes->name == "config" || attributes->name == "cluster" ||
+        attributes->name == "clusterx" || attributes->name == "georadius" ||
+        attributes->name == "georadiusbymember") {
+      return false;
+    }
+    std::vector<int> keys_indexes;
+    auto s = Redis::GetKeysFromCommand(attributes->name, static_cast<int>(cmd_tokens.size()), &keys_indexes);
+    if (!s.IsOK()) {
+      if (attributes->is_write()) return false;
       continue;
     }
-    if (!reply.empty()) Reply(reply);
-    reply.clear();
+    for (auto i : keys_indexes) {
+      if (!ns_keys || i >= static_cast<int>(cmd_tokens.size())) break;
+      std::string ns_key;
+      ComposeNamespaceKey(ns_, cmd_tokens[i], &ns_key, svr_->storage_->IsSlotIdEncoded());
+      ns_keys->emplace_back(std::move(ns_key));
+    }
   }
+  return true;
 }
 
 void Connection::ResetMultiExec() {
   in_exec_ = false;
   multi_error_ = false;
-  multi_cmds_.clear();
+  // Release the queue, it'd be allocated again by the next transaction
+  std::deque<Redis::CommandTokens>().swap(multi_cmds_);
+  multi_mem_.store(0, std::memory_order_relaxed);
   DisableFlag(Connection::kMultiExec);
 }
 
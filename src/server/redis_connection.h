@@ -22,18 +22,28 @@
 
 #include <event2/buffer.h>
 
+#include <atomic>
 #include <deque>
 #include <memory>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "client_tracking.h"
 #include "commands/redis_cmd.h"
+#include "config/config.h"
+#include "event_util.h"
+#include "redis_reply.h"
 #include "redis_request.h"
+#include "stats/request_trace.h"
+#include "task_runner.h"
 
 class Worker;
 
 namespace Redis {
+struct RestoreBatch;
+
 class Connection {
  public:
   enum Flag {
@@ -42,6 +52,7 @@ class Connection {
     kCloseAfterReply = 1 << 6,
     kCloseAsync = 1 << 7,
     kMultiExec = 1 << 8,
+    kTracking = 1 << 9,
   };
 
   explicit Connection(bufferevent *bev, Worker *owner);
@@ -53,8 +64,31 @@ class Connection {
   static void OnWrite(struct bufferevent *bev, void *ctx);
   static void OnEvent(bufferevent *bev, int16_t events, void *ctx);
   void Reply(const std::string &msg);
+  void Reply(std::string &&msg);
+  // Reply the message published to the subscriber, it's invoked by the worker of publisher
+  void ReplyMessage(const std::string &msg);
+  // Serialize the reply into the reply buffer directly, commands replying
+  // in this way should leave the output of Execute empty.
+  void ReplyInteger(int64_t data);
+  // The bulk string is copied once from the slice, e.g. the value pinned in the block cache
+  void ReplyBulkString(const rocksdb::Slice &data);
+  void ReplyNilString();
+  void ReplyMultiLen(int64_t len);
+  void ReplyMultiBulkString(const std::vector<std::string> &values, bool output_nil_for_empty_string = true);
+  void ReplyMultiBulkString(const std::vector<std::string> &values, const std::vector<rocksdb::Status> &statuses);
+  // The Reply* methods above feed the sink instead of the output buffer once it was set,
+  // e.g. redis.call in Lua scripts converts the replies to the Lua values.
+  void SetReplySink(Redis::ReplySink *sink) { reply_sink_ = sink; }
+  Redis::ReplySink *GetReplySink() { return reply_sink_; }
+  // Write the pending replies into the socket without blocking once the output buffer
+  // grows beyond the threshold, so that huge streaming replies needn't be fully buffered.
+  // The replies are kept while they may be dropped, i.e. in a transaction or after the
+  // writes waiting for the replicas to acknowledge.
+  void FlushReply(size_t threshold);
   void SendFile(int fd);
   std::string ToString();
+  // Release the memory held by the buffers of the idle connection
+  void ShrinkBuffers();
 
   using unsubscribe_callback = std::function<void(std::string, int)>;
   void SubscribeChannel(const std::string &channel);
@@ -65,6 +99,10 @@ class Connection {
   void PUnSubscribeChannel(const std::string &pattern);
   void PUnSubscribeAll(const unsubscribe_callback &reply = nullptr);
   int PSubscriptionsCount();
+  void SSubscribeChannel(const std::string &channel);
+  void SUnSubscribeChannel(const std::string &channel);
+  void SUnSubscribeAll(const unsubscribe_callback &reply = nullptr);
+  int SSubscriptionsCount();
 
   uint64_t GetAge();
   uint64_t GetIdleTime();
@@ -85,6 +123,18 @@ class Connection {
   int GetPort() { return port_; }
   void SetListeningPort(int port) { listening_port_ = port; }
   int GetListeningPort() { return listening_port_; }
+  // The compression of the replication stream negotiated by the replica, see ReplCompression
+  void SetReplCompression(int compression) { repl_compression_ = compression; }
+  int GetReplCompression() { return repl_compression_; }
+  // Whether the replica acknowledges the applied sequence number by "replconf ack"
+  void SetReplAckEnabled(bool enabled) { repl_ack_enabled_ = enabled; }
+  bool IsReplAckEnabled() { return repl_ack_enabled_; }
+  // Whether the replica tracks its lag by the heartbeats "heartbeat <seq>" in the stream
+  void SetReplHeartbeatEnabled(bool enabled) { repl_heartbeat_enabled_ = enabled; }
+  bool IsReplHeartbeatEnabled() { return repl_heartbeat_enabled_; }
+  // The reads are rejected if the replica lags behind the master more than the milliseconds,
+  // it's set by READONLY MAXLAG and -1 means no limit
+  void SetMaxReadLag(int64_t max_lag_ms) { max_read_lag_ms_ = max_lag_ms; }
   uint64_t GetClientType();
   Server *GetServer() { return svr_; }
 
@@ -103,11 +153,34 @@ class Connection {
   evbuffer *Input() { return bufferevent_get_input(bev_); }
   evbuffer *Output() { return bufferevent_get_output(bev_); }
   bufferevent *GetBufferEvent() { return bev_; }
+  // The connection can be moved to another worker if it's idle and only tracked by its worker,
+  // i.e. it isn't blocked, offloaded, paused, subscribing or using TLS
+  bool IsMigratable();
+  // Replace the bufferevent with the one on the event base of the new owner, the pending
+  // input and output are moved along, then the events are enabled by ResumeAfterMove
+  void MoveTo(Worker *owner, bufferevent *bev);
+  void ResumeAfterMove();
   void ExecuteCommands(std::deque<CommandTokens> *to_process_cmds);
   bool isProfilingEnabled(const std::string &cmd);
   void recordProfilingSampleIfNeed(const std::string &cmd, uint64_t duration);
+  // Enable the perf context for one of every perf-stats-sample-interval commands,
+  // it's a no-op if the command was being profiled
+  bool isPerfStatsSampling(bool is_profiling);
+  void recordPerfStatsSample(const CommandAttributes &attributes, bool is_profiling);
+  // Trace one of every request-trace-sample-interval requests, the storage stages are
+  // read from the perf context which is enabled by the trace if it wasn't yet
+  bool beginTracedExecution();
+  void endTracedExecution(uint64_t begin_us, bool enabled_perf);
+  // Count the keys of the sampled command in the hot keys of the worker
+  void recordHotKeys(const CommandAttributes &attributes, const std::vector<std::string> &cmd_args);
+  // The slot of the first key whose traffic is recorded in the cluster mode, or -1 if it's not recorded
+  int trafficSlot(const CommandAttributes &attributes, const std::vector<std::string> &cmd_args) const;
   void SetImporting() { importing_ = true; }
   bool IsImporting() { return importing_; }
+  // The RESTOREs of the importing connection put their keys into the batch if it's not null
+  RestoreBatch *GetRestoreBatch() { return restore_batch_; }
+  // The slow command is running in the offload threads of the worker
+  bool IsOffloading() { return offloaded_ != nullptr; }
 
   // Multi exec
   void SetInExec() { in_exec_ = true; }
@@ -115,6 +188,18 @@ class Connection {
   bool IsMultiError() { return multi_error_; }
   void ResetMultiExec();
   std::deque<Redis::CommandTokens> *GetMultiExecCommands() { return &multi_cmds_; }
+  // Collect the keys of the queued commands if ns_keys isn't null, return false if the transaction
+  // can't run under the locks of the keys, e.g. it has the commands writing the keys not in their arguments
+  bool GetMultiExecKeys(std::vector<std::string> *ns_keys);
+
+  // WATCH, the watched keys are only changed by the connection under Server::watched_keys_mu_
+  std::set<std::string> *GetWatchedKeys() { return &watched_keys_; }
+  bool IsWatchedKeysModified() { return watched_keys_modified_; }
+  void SetWatchedKeysModified(bool modified) { watched_keys_modified_ = modified; }
+
+  // The invalidations of the keys written or evicted by the commands, they're sent once the
+  // commands of the request (or the transaction) were executed
+  InvalidationBatches *GetPendingInvalidations() { return &pending_invalidations_; }
 
   std::unique_ptr<Commander> current_cmd_;
   std::function<void(int)> close_cb_ = nullptr;
@@ -128,23 +213,101 @@ class Connection {
   int port_ = 0;
   std::string addr_;
   int listening_port_ = 0;
+  int repl_compression_ = 0;
+  bool repl_ack_enabled_ = false;
+  bool repl_heartbeat_enabled_ = false;
+  int64_t max_read_lag_ms_ = -1;
   bool is_admin_ = false;
   bool need_close_ = true;
   std::string last_cmd_;
   time_t create_time_;
   time_t last_interaction_;
+  time_t shrunk_interaction_ = 0;  // the last interaction before its buffers were shrunk
 
   bufferevent *bev_;
+  Redis::ReplySink *reply_sink_ = nullptr;
   Request req_;
   Worker *owner_;
   std::vector<std::string> subscribe_channels_;
   std::vector<std::string> subcribe_patterns_;
+  std::vector<std::string> subscribe_shard_channels_;
 
   Server *svr_;
   bool in_exec_ = false;
   bool multi_error_ = false;
   std::deque<Redis::CommandTokens> multi_cmds_;
+  // The memory of the requests and the queued commands reported by CLIENT LIST
+  std::atomic<size_t> argv_mem_ = 0;
+  std::atomic<size_t> multi_mem_ = 0;
+  std::set<std::string> watched_keys_;
+  std::atomic<bool> watched_keys_modified_ = false;
+  InvalidationBatches pending_invalidations_;
 
   bool importing_ = false;
+  RestoreBatch *restore_batch_ = nullptr;
+
+  // The client would be closed once its output buffer exceeded the limit
+  std::atomic<bool> obuf_limit_reached_ = false;
+  std::atomic<int64_t> obuf_soft_limit_reached_time_ = 0;
+  bool read_paused_ = false;
+  // The write event is disabled while executing the pipeline, so that its replies are sent by one writev
+  bool corked_ = false;
+  uint64_t read_us_ = 0;  // the time the requests were read, it's only set if the requests are traced
+  std::unique_ptr<RequestTrace> trace_;
+
+  // The writes are acknowledged by the replicas before replying if min-replicas-to-ack is set
+  bool has_unacked_writes_ = false;
+  // The replies of the pipeline which were written into the socket by FlushReply while executing it
+  size_t flushed_reply_bytes_ = 0;
+  rocksdb::SequenceNumber repl_ack_seq_ = 0;
+  size_t repl_ack_output_len_ = 0;
+  event *repl_ack_timer_ = nullptr;
+  // The reads are paused until the namespace has the tokens for the next command, see NamespaceQoS
+  event *throttle_timer_ = nullptr;
+  bool throttled_ = false;
+
+  struct OffloadedCommand {
+    CommandTokens cmd_tokens;
+    Status status;
+    std::string output;
+    UniqueEvbuf reply;
+    uint64_t duration = 0;
+    bool closed = false;  // the client was gone while executing the command
+    // The reply would be coalesced if the request isn't empty, see ReplyCoalescer
+    std::string coalesce_request;
+    uint64_t coalesce_epoch = 0;
+  };
+  std::unique_ptr<OffloadedCommand> offloaded_;
+
+  void executeCommands(std::deque<CommandTokens> *to_process_cmds);
+  // Execute the commands of the importing connection, the consecutive RESTOREs are written in one batch
+  void executeImportCommands(std::deque<CommandTokens> *to_process_cmds);
+  void prefetchReads(const std::deque<CommandTokens> &to_process_cmds);
+  // Execute the read command with the reads only from the memtables and the block cache,
+  // its replies are dropped if it missed the cache, and then it should be executed again
+  Status executeCacheOnly(Commander *cmd, std::string *reply, evbuffer *output, bool *cache_missed);
+  // Execute the command with its direct replies written to the output instead of the output buffer
+  Status executeCaptured(Commander *cmd, std::string *reply, evbuffer *output);
+  // The reply of the coalesced read is made up of its direct replies followed by the returned one
+  void coalesceReply(const std::string &request, uint64_t epoch, evbuffer *captured, const std::string &reply);
+  void appendCapturedReply(evbuffer *captured);
+  void reply(const std::string &msg, const OutputBufferLimit &limit);
+  const OutputBufferLimit &outputBufferLimit();
+  void checkOutputBufferLimit(const OutputBufferLimit &limit);
+  void pauseReadIfNeeded();
+  void corkReplies();
+  void uncorkReplies();
+  void resumeRead();
+  bool waitForReplicaAcks(size_t output_len);
+  void finishReplicaAcks();
+  static void onReplicaAckWrite(bufferevent *bev, void *ctx);
+  static void onReplicaAckTimeout(int, int16_t, void *ctx);
+  static void onReplicaAckEvent(bufferevent *bev, int16_t events, void *ctx);
+  void throttle(uint64_t wait_us);
+  static void onThrottleTimeout(int, int16_t, void *ctx);
+  bool offloadCommand(const CommandTokens &cmd_tokens, TaskRunner *runner = nullptr);
+  void executeOffloadedCommand();
+  void onOffloadDone();
+  static void onOffloadEvent(bufferevent *bev, int16_t events, void *ctx);
 };
 }  // namespace Redis
@@ -20,12 +20,29 @@
 
 #include "redis_reply.h"
 
+#include <charconv>
+#include <cstring>
 #include <numeric>
 
 namespace Redis {
 
 void Reply(evbuffer *output, const std::string &data) { evbuffer_add(output, data.c_str(), data.length()); }
 
+void Reply(evbuffer *output, std::string &&data) {
+  // Copying the small replies is cheaper than allocating the holder and the chain of the reference
+  static constexpr size_t kReferenceThreshold = 16 * 1024;
+  if (data.size() < kReferenceThreshold) {
+    Reply(output, data);
+    return;
+  }
+  auto holder = new std::string(std::move(data));
+  auto cleanup = [](const void *, size_t, void *arg) { delete static_cast<std::string *>(arg); };
+  if (evbuffer_add_reference(output, holder->data(), holder->size(), cleanup, holder) != 0) {
+    evbuffer_add(output, holder->data(), holder->size());
+    delete holder;
+  }
+}
+
 std::string SimpleString(const std::string &data) { return "+" + data + CRLF; }
 
 std::string Error(const std::string &err) { return "-" + err + CRLF; }
@@ -73,4 +90,105 @@ std::string Array(const std::vector<std::string> &list) {
 
 std::string Command2RESP(const std::vector<std::string> &cmd_args) { return MultiBulkString(cmd_args, false); }
 
+// Encode the `<prefix><len>\r\n` header into buf, the buf should be large enough
+// to hold the prefix, an int64 and the CRLF.
+template <typename T>
+static size_t encodeHeader(char *buf, size_t buf_size, char prefix, T len) {
+  buf[0] = prefix;
+  auto res = std::to_chars(buf + 1, buf + buf_size - 2, len);
+  *res.ptr++ = '\r';
+  *res.ptr++ = '\n';
+  return res.ptr - buf;
+}
+
+size_t BulkString(evbuffer *output, const rocksdb::Slice &data) {
+  char header[32];
+  size_t header_len = encodeHeader(header, sizeof(header), '$', data.size());
+  size_t total_len = header_len + data.size() + 2;
+
+  // Reserve one contiguous region to write the header, data and CRLF at once,
+  // fallback to appending them one by one if the space can't be reserved.
+  evbuffer_iovec vec;
+  if (evbuffer_reserve_space(output, static_cast<ev_ssize_t>(total_len), &vec, 1) != 1) {
+    evbuffer_add(output, header, header_len);
+    evbuffer_add(output, data.data(), data.size());
+    evbuffer_add(output, CRLF, 2);
+    return total_len;
+  }
+
+  auto *p = static_cast<char *>(vec.iov_base);
+  memcpy(p, header, header_len);
+  memcpy(p + header_len, data.data(), data.size());
+  memcpy(p + header_len + data.size(), CRLF, 2);
+  vec.iov_len = total_len;
+  evbuffer_commit_space(output, &vec, 1);
+  return total_len;
+}
+
+size_t Integer(evbuffer *output, int64_t data) {
+  char buf[32];
+  size_t len = encodeHeader(buf, sizeof(buf), ':', data);
+  evbuffer_add(output, buf, len);
+  return len;
+}
+
+size_t NilString(evbuffer *output) {
+  evbuffer_add(output, "$-1" CRLF, 5);
+  return 5;
+}
+
+size_t MultiLen(evbuffer *output, int64_t len) {
+  char header[32];
+  size_t header_len = encodeHeader(header, sizeof(header), '*', len);
+  evbuffer_add(output, header, header_len);
+  return header_len;
+}
+
+size_t MultiBulkString(evbuffer *output, const std::vector<std::string> &values, bool output_nil_for_empty_string) {
+  size_t written = MultiLen(output, static_cast<int64_t>(values.size()));
+  for (const auto &value : values) {
+    if (value.empty() && output_nil_for_empty_string) {
+      written += NilString(output);
+    } else {
+      written += BulkString(output, value);
+    }
+  }
+  return written;
+}
+
+size_t MultiBulkString(evbuffer *output, const std::vector<std::string> &values,
+                       const std::vector<rocksdb::Status> &statuses) {
+  size_t written = MultiLen(output, static_cast<int64_t>(values.size()));
+  for (size_t i = 0; i < values.size(); i++) {
+    if (i < statuses.size() && !statuses[i].ok()) {
+      written += NilString(output);
+    } else {
+      written += BulkString(output, values[i]);
+    }
+  }
+  return written;
+}
+
+void ReplySink::MultiBulkString(const std::vector<std::string> &values, bool output_nil_for_empty_string) {
+  MultiLen(static_cast<int64_t>(values.size()));
+  for (const auto &value : values) {
+    if (value.empty() && output_nil_for_empty_string) {
+      NilString();
+    } else {
+      BulkString(value);
+    }
+  }
+}
+
+void ReplySink::MultiBulkString(const std::vector<std::string> &values, const std::vector<rocksdb::Status> &statuses) {
+  MultiLen(static_cast<int64_t>(values.size()));
+  for (size_t i = 0; i < values.size(); i++) {
+    if (i < statuses.size() && !statuses[i].ok()) {
+      NilString();
+    } else {
+      BulkString(values[i]);
+    }
+  }
+}
+
 }  // namespace Redis
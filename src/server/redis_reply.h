@@ -21,6 +21,7 @@
 #pragma once
 
 #include <event2/buffer.h>
+#include <rocksdb/slice.h>
 #include <rocksdb/status.h>
 
 #include <string>
@@ -30,6 +31,8 @@
 
 namespace Redis {
 void Reply(evbuffer *output, const std::string &data);
+// The large reply is moved into the output buffer as a reference instead of being copied
+void Reply(evbuffer *output, std::string &&data);
 std::string SimpleString(const std::string &data);
 std::string Error(const std::string &err);
 std::string Integer(int64_t data);
@@ -40,4 +43,47 @@ std::string Array(const std::vector<std::string> &list);
 std::string MultiBulkString(const std::vector<std::string> &values, bool output_nil_for_empty_string = true);
 std::string MultiBulkString(const std::vector<std::string> &values, const std::vector<rocksdb::Status> &statuses);
 std::string Command2RESP(const std::vector<std::string> &cmd_args);
+
+// Serialize the replies straight into the evbuffer rather than building a string
+// which would be copied into the output buffer again, return the written bytes.
+size_t BulkString(evbuffer *output, const rocksdb::Slice &data);
+size_t Integer(evbuffer *output, int64_t data);
+size_t NilString(evbuffer *output);
+size_t MultiLen(evbuffer *output, int64_t len);
+size_t MultiBulkString(evbuffer *output, const std::vector<std::string> &values,
+                       bool output_nil_for_empty_string = true);
+size_t MultiBulkString(evbuffer *output, const std::vector<std::string> &values,
+                       const std::vector<rocksdb::Status> &statuses);
+
+// ReplySink receives the typed replies of the commands which reply through the Connection::Reply*
+// methods, so the caller can consume the replies without serializing them into RESP and parsing
+// them back, e.g. redis.call in Lua scripts pushes them onto the Lua stack directly.
+class ReplySink {
+ public:
+  virtual ~ReplySink() = default;
+  virtual void Integer(int64_t data) = 0;
+  virtual void BulkString(const rocksdb::Slice &data) = 0;
+  virtual void NilString() = 0;
+  // The elements of the array are fed after its length, the negative length means the nil array
+  virtual void MultiLen(int64_t len) = 0;
+  // The fallback for the replies which were serialized into RESP already
+  virtual void Raw(const std::string &resp) = 0;
+
+  void MultiBulkString(const std::vector<std::string> &values, bool output_nil_for_empty_string = true);
+  void MultiBulkString(const std::vector<std::string> &values, const std::vector<rocksdb::Status> &statuses);
+};
+
+// EvbufferReplySink serializes the replies into the evbuffer
+class EvbufferReplySink : public ReplySink {
+ public:
+  explicit EvbufferReplySink(evbuffer *output) : output_(output) {}
+  void Integer(int64_t data) override { Redis::Integer(output_, data); }
+  void BulkString(const rocksdb::Slice &data) override { Redis::BulkString(output_, data); }
+  void NilString() override { Redis::NilString(output_); }
+  void MultiLen(int64_t len) override { Redis::MultiLen(output_, len); }
+  void Raw(const std::string &resp) override { Reply(output_, resp); }
+
+ private:
+  evbuffer *output_;
+};
 }  // namespace Redis
@@ -23,8 +23,10 @@
 #include <glog/logging.h>
 #include <rocksdb/perf_context.h>
 
+#include <algorithm>
 #include <chrono>
 #include <memory>
+#include <string_view>
 #include <utility>
 
 #include "cluster/redis_slot.h"
@@ -32,42 +34,77 @@
 #include "parse_util.h"
 #include "redis_connection.h"
 #include "redis_reply.h"
+#include "scope_exit.h"
 #include "server.h"
 
 namespace Redis {
 const size_t PROTO_INLINE_MAX_SIZE = 16 * 1024L;
 const size_t PROTO_BULK_MAX_SIZE = 512 * 1024L * 1024L;
 const size_t PROTO_MULTI_MAX_SIZE = 1024 * 1024L;
+const size_t PROTO_RESERVED_TOKENS = 1024;
+
+bool Request::peekLine(evbuffer *input, evbuffer_eol_style eol_style, Line *line) {
+  size_t eol_len = 0;
+  evbuffer_ptr eol = evbuffer_search_eol(input, nullptr, &eol_len, eol_style);
+  if (eol.pos < 0) return false;
+
+  line->length = eol.pos;
+  line->drain_length = eol.pos + eol_len;
+  if (line->length == 0) {
+    line->data = nullptr;
+    return true;
+  }
+
+  // The line is almost always located in the first chain, only linearize
+  // the header when it was split across chains by the network read.
+  evbuffer_iovec iov;
+  if (evbuffer_peek(input, static_cast<ev_ssize_t>(line->length), nullptr, &iov, 1) >= 1 &&
+      iov.iov_len >= line->length) {
+    line->data = static_cast<const char *>(iov.iov_base);
+  } else {
+    line->data = reinterpret_cast<const char *>(evbuffer_pullup(input, static_cast<ev_ssize_t>(line->length)));
+  }
+  return true;
+}
 
 Status Request::Tokenize(evbuffer *input) {
   size_t pipeline_size = 0;
+  // The inbound bytes are added to the stats once for all parsed requests, the server
+  // is null if the requests are parsed without it, e.g. in the benchmarks
+  size_t inbound_bytes = 0;
+  auto exit = MakeScopeExit([this, &inbound_bytes] {
+    if (svr_ && inbound_bytes > 0) svr_->stats_.IncrInbondBytes(inbound_bytes);
+  });
+  Line line;
   while (true) {
     switch (state_) {
       case ArrayLen: {
-        bool isOnlyLF = true;
         // We don't use the `EVBUFFER_EOL_CRLF_STRICT` here since only LF is allowed in INLINE protocol.
         // So we need to search LF EOL and figure out current line has CR or not.
-        UniqueEvbufReadln line(input, EVBUFFER_EOL_LF);
-        if (line && line.length > 0 && line[line.length - 1] == '\r') {
-          // remove `\r` if exists
-          --line.length;
-          isOnlyLF = false;
-        }
-
-        if (!line || line.length <= 0) {
+        if (!peekLine(input, EVBUFFER_EOL_LF, &line)) {
           if (pipeline_size > 128) {
             LOG(INFO) << "Large pipeline detected: " << pipeline_size;
           }
-          if (line) {
-            continue;
-          }
           return Status::OK();
         }
 
+        bool isOnlyLF = true;
+        size_t length = line.length;
+        if (length > 0 && line.data[length - 1] == '\r') {
+          // remove `\r` if exists
+          --length;
+          isOnlyLF = false;
+        }
+        if (length == 0) {
+          evbuffer_drain(input, line.drain_length);
+          continue;
+        }
+
         pipeline_size++;
-        svr_->stats_.IncrInbondBytes(line.length);
-        if (line[0] == '*') {
-          auto parse_result = ParseInt<int64_t>(std::string(line.get() + 1, line.length - 1), 10);
+        inbound_bytes += length;
+        if (line.data[0] == '*') {
+          auto parse_result = ParseInt<int64_t>(std::string_view(line.data + 1, length - 1), 10);
+          evbuffer_drain(input, line.drain_length);
           if (!parse_result) {
             return Status(Status::NotOK, "Protocol error: invalid multibulk length");
           }
@@ -79,26 +116,36 @@ Status Request::Tokenize(evbuffer *input) {
             multi_bulk_len_ = 0;
             continue;
           }
+          // Don't trust the client-provided length too much, the vector
+          // would grow as usual once the reserved slots were exhausted.
+          tokens_.reserve(std::min<size_t>(multi_bulk_len_, PROTO_RESERVED_TOKENS));
           state_ = BulkLen;
         } else {
-          if (line.length > PROTO_INLINE_MAX_SIZE) {
+          if (length > PROTO_INLINE_MAX_SIZE) {
+            evbuffer_drain(input, line.drain_length);
             return Status(Status::NotOK, "Protocol error: invalid bulk length");
           }
-          tokens_ = Util::Split(std::string(line.get(), line.length), " \t");
+          tokens_ = Util::Split(std::string(line.data, length), " \t");
+          evbuffer_drain(input, line.drain_length);
           commands_.emplace_back(std::move(tokens_));
           state_ = ArrayLen;
         }
         break;
       }
       case BulkLen: {
-        UniqueEvbufReadln line(input, EVBUFFER_EOL_CRLF_STRICT);
-        if (!line || line.length <= 0) return Status::OK();
-        svr_->stats_.IncrInbondBytes(line.length);
-        if (line[0] != '$') {
+        if (!peekLine(input, EVBUFFER_EOL_CRLF_STRICT, &line)) return Status::OK();
+        if (line.length == 0) {
+          evbuffer_drain(input, line.drain_length);
+          return Status::OK();
+        }
+        inbound_bytes += line.length;
+        if (line.data[0] != '$') {
+          evbuffer_drain(input, line.drain_length);
           return Status(Status::NotOK, "Protocol error: expected '$'");
         }
-        auto parse_result = ParseInt<uint64_t>(std::string(line.get() + 1, line.length - 1), 10);
-        if (!parse_result) {
+        auto parse_result = ParseInt<int64_t>(std::string_view(line.data + 1, line.length - 1), 10);
+        evbuffer_drain(input, line.drain_length);
+        if (!parse_result || *parse_result < 0) {
           return Status(Status::NotOK, "Protocol error: invalid bulk length");
         }
         bulk_len_ = *parse_result;
@@ -108,12 +155,15 @@ Status Request::Tokenize(evbuffer *input) {
         state_ = BulkData;
         break;
       }
-      case BulkData:
+      case BulkData: {
         if (evbuffer_get_length(input) < bulk_len_ + 2) return Status::OK();
-        char *data = reinterpret_cast<char *>(evbuffer_pullup(input, bulk_len_ + 2));
-        tokens_.emplace_back(data, bulk_len_);
-        evbuffer_drain(input, bulk_len_ + 2);
-        svr_->stats_.IncrInbondBytes(bulk_len_ + 2);
+        // Copy the bulk string into its token directly instead of linearizing
+        // the evbuffer with pullup first, which would memmove every chain the
+        // bulk spans and then copy it once more into the token.
+        auto &token = tokens_.emplace_back(bulk_len_, '\0');
+        if (bulk_len_ > 0) evbuffer_remove(input, token.data(), bulk_len_);
+        evbuffer_drain(input, 2);
+        inbound_bytes += bulk_len_ + 2;
         --multi_bulk_len_;
         if (multi_bulk_len_ == 0) {
           state_ = ArrayLen;
@@ -123,8 +173,27 @@ Status Request::Tokenize(evbuffer *input) {
           state_ = BulkLen;
         }
         break;
+      }
     }
   }
 }
 
+void Request::ShrinkBuffers() {
+  // The deque keeps its map at the size of the longest pipeline after the commands were popped
+  if (commands_.empty()) std::deque<CommandTokens>().swap(commands_);
+  if (tokens_.empty()) CommandTokens().swap(tokens_);
+}
+
+size_t Request::GetMemoryUsage() const {
+  size_t usage = GetTokensMemory(tokens_);
+  for (const auto &tokens : commands_) usage += GetTokensMemory(tokens);
+  return usage;
+}
+
+size_t GetTokensMemory(const CommandTokens &tokens) {
+  size_t usage = tokens.capacity() * sizeof(std::string);
+  for (const auto &token : tokens) usage += token.capacity();
+  return usage;
+}
+
 }  // namespace Redis
@@ -34,6 +34,9 @@ namespace Redis {
 
 using CommandTokens = std::vector<std::string>;
 
+// The memory allocated by the tokens of the command
+size_t GetTokensMemory(const CommandTokens &tokens);
+
 class Connection;
 
 class Request {
@@ -47,8 +50,22 @@ class Request {
   Status Tokenize(evbuffer *input);
 
   std::deque<CommandTokens> *GetCommands() { return &commands_; }
+  // Release the capacity left by the large requests, the tokens of the incomplete command are kept
+  void ShrinkBuffers();
+  // The memory held by the tokens of the pending and the incomplete commands
+  size_t GetMemoryUsage() const;
 
  private:
+  // A line located in the input evbuffer without being copied out,
+  // the `data` is only valid until the buffer was drained.
+  struct Line {
+    const char *data = nullptr;
+    size_t length = 0;        // without the EOL
+    size_t drain_length = 0;  // with the EOL
+  };
+
+  static bool peekLine(evbuffer *input, evbuffer_eol_style eol_style, Line *line);
+
   // internal states related to parsing
 
   enum ParserState { ArrayLen, BulkLen, BulkData };
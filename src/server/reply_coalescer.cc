@@ -0,0 +1,90 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "reply_coalescer.h"
+
+#include <cctype>
+#include <utility>
+
+std::string ReplyCoalescer::EncodeRequest(const std::string &ns, const std::vector<std::string> &args) {
+  size_t size = ns.size() + 1;
+  for (const auto &arg : args) size += arg.size() + 1;
+  std::string request;
+  request.reserve(size);
+  request.append(std::to_string(ns.size())).push_back(':');
+  request.append(ns);
+  // The command names are case-insensitive
+  for (size_t i = 0; i < args.size(); i++) {
+    request.append(std::to_string(args[i].size())).push_back(':');
+    if (i == 0) {
+      for (char c : args[i]) request.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+    } else {
+      request.append(args[i]);
+    }
+  }
+  return request;
+}
+
+bool ReplyCoalescer::Lookup(const std::string &request, uint64_t epoch, uint64_t now_ms, std::string *reply) {
+  auto iter = entries_.find(request);
+  if (iter == entries_.end()) return false;
+  if (iter->second.epoch != epoch || iter->second.expire_ms <= now_ms) {
+    usage_ -= charge(iter->first, iter->second);
+    entries_.erase(iter);
+    return false;
+  }
+  *reply = iter->second.reply;
+  return true;
+}
+
+void ReplyCoalescer::Insert(const std::string &request, const std::string &reply, uint64_t epoch, uint64_t now_ms,
+                            uint64_t window_ms) {
+  if (reply.size() > kMaxReplySize) return;
+
+  auto iter = entries_.find(request);
+  if (iter != entries_.end()) {
+    usage_ -= charge(iter->first, iter->second);
+    entries_.erase(iter);
+  }
+
+  Entry entry{reply, epoch, now_ms + window_ms};
+  size_t entry_charge = charge(request, entry);
+  if (entry_charge > capacity_) return;
+  if (usage_ + entry_charge > capacity_) evict(now_ms, entry_charge);
+  usage_ += entry_charge;
+  entries_.emplace(request, std::move(entry));
+}
+
+void ReplyCoalescer::evict(uint64_t now_ms, size_t needed) {
+  // The window is short, so the expired entries are only dropped once it's full,
+  // and all entries are dropped if there is still no room for the new one
+  for (auto iter = entries_.begin(); iter != entries_.end();) {
+    if (iter->second.expire_ms <= now_ms) {
+      usage_ -= charge(iter->first, iter->second);
+      iter = entries_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  if (usage_ + needed > capacity_) {
+    entries_.clear();
+    usage_ = 0;
+  }
+}
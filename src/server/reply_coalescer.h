@@ -0,0 +1,93 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// KeyWriteEpochs counts the writes of the keys in the hashed buckets, it's shared by all workers.
+// The epoch of a key is taken before the key is read, and it changes once the key (or another
+// key in the same bucket) was written since then, so the result of the read could be stale.
+// The writes whose keys are unknown (e.g. FLUSHDB) change the epochs of all keys.
+class KeyWriteEpochs {
+ public:
+  static constexpr size_t kBuckets = 4096;
+
+  uint64_t Get(const std::string &ns_key) const {
+    return global_.load(std::memory_order_acquire) + buckets_[bucketOf(ns_key)].load(std::memory_order_acquire);
+  }
+  // Bump after the write was applied, so the reads before it are all stale
+  void Bump(const std::string &ns_key) { buckets_[bucketOf(ns_key)].fetch_add(1, std::memory_order_acq_rel); }
+  void BumpAll() { global_.fetch_add(1, std::memory_order_acq_rel); }
+
+ private:
+  static size_t bucketOf(const std::string &ns_key) { return std::hash<std::string>{}(ns_key) % kBuckets; }
+
+  std::atomic<uint64_t> global_ = 0;
+  std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+};
+
+// ReplyCoalescer keeps the replies of the read commands of the worker for a short window, the same
+// requests of the hot key in the window share the reply of the first one instead of reading and
+// serializing it again. The reply is dropped once the key was written, see KeyWriteEpochs, so the
+// staleness is only bounded by the window for the changes not made by the commands, e.g. the keys
+// which expired or were replicated from the master. It's only used in the worker thread.
+class ReplyCoalescer {
+ public:
+  // The replies larger than it aren't kept, the size of the whole coalescer is bounded by capacity
+  static constexpr size_t kMaxReplySize = 1024 * 1024;
+
+  explicit ReplyCoalescer(size_t capacity = 16 * 1024 * 1024) : capacity_(capacity) {}
+  ReplyCoalescer(const ReplyCoalescer &) = delete;
+  ReplyCoalescer &operator=(const ReplyCoalescer &) = delete;
+
+  // The request is the namespace and the arguments of the command
+  static std::string EncodeRequest(const std::string &ns, const std::vector<std::string> &args);
+  // Return true if the request was replied in the window and its key wasn't written since then
+  bool Lookup(const std::string &request, uint64_t epoch, uint64_t now_ms, std::string *reply);
+  void Insert(const std::string &request, const std::string &reply, uint64_t epoch, uint64_t now_ms,
+              uint64_t window_ms);
+  size_t GetUsage() const { return usage_; }
+
+ private:
+  struct Entry {
+    std::string reply;
+    uint64_t epoch;
+    uint64_t expire_ms;
+  };
+
+  static size_t charge(const std::string &request, const Entry &entry) {
+    return request.size() + entry.reply.size() + kEntryOverhead;
+  }
+  void evict(uint64_t now_ms, size_t needed);
+
+  // the approximate memory overhead of an entry in the map
+  static constexpr size_t kEntryOverhead = 64;
+
+  size_t capacity_;
+  size_t usage_ = 0;
+  std::unordered_map<std::string, Entry> entries_;
+};
@@ -27,32 +27,58 @@
 #include <sys/statvfs.h>
 #include <sys/utsname.h>
 
+#ifdef ENABLE_JEMALLOC
+#include <jemalloc/jemalloc.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <tuple>
 #include <utility>
 
 #include "config.h"
 #include "fmt/format.h"
 #include "redis_connection.h"
 #include "redis_request.h"
+#include "stats/prometheus.h"
+#include "storage/cache_warmer.h"
 #include "storage/compaction_checker.h"
+#include "storage/huge_page_allocator.h"
+#include "storage/key_reclaimer.h"
+#include "storage/lazy_expirer.h"
 #include "storage/redis_db.h"
 #include "storage/scripting.h"
+#include "storage/workload_tuner.h"
 #include "thread_util.h"
 #include "time_util.h"
 #include "tls_util.h"
 #include "version.h"
 #include "worker.h"
 
+// The Lua state of the current read-only script thread, see Server::ReadOnlyScriptState
+static thread_local lua_State *readonly_script_state = nullptr;
+// The memory of the Lua state of the current read-only script thread, see Server::SampleReadOnlyScriptMemory
+static thread_local std::atomic<int64_t> *readonly_script_memory = nullptr;
+
 std::atomic<int> Server::unix_time_ = {0};
 constexpr const char *REDIS_VERSION = "4.0.0";
 
-Server::Server(Engine::Storage *storage, Config *config) : storage_(storage), config_(config) {
+Server::Server(Engine::Storage *storage, Config *config)
+    : storage_(storage),
+      config_(config),
+      expire_reaper_(storage),
+      compaction_scheduler_(storage),
+      big_key_scanner_(storage, storage->GetBigKeys()) {
   // init commands stats here to prevent concurrent insert, and cause core
-  auto commands = Redis::GetOriginalCommands();
-  for (const auto &iter : *commands) {
-    stats_.commands_stats[iter.first].calls = 0;
-    stats_.commands_stats[iter.first].latency = 0;
-  }
+  stats_.InitCommandsStats(Redis::GetCommandNum());
 
 #ifdef ENABLE_OPENSSL
   // init ssl context
@@ -61,6 +87,7 @@ Server::Server(Engine::Storage *storage, Config *config) : storage_(storage), co
     if (!ssl_ctx_) {
       exit(1);
     }
+    if (config->tls_handshake_threads > 0) tls_handshaker_ = std::make_unique<TLSHandshaker>();
   }
 #endif
 
@@ -69,6 +96,10 @@ Server::Server(Engine::Storage *storage, Config *config) : storage_(storage), co
 
   for (int i = 0; i < config->workers; i++) {
     auto worker = std::make_unique<Worker>(this, config);
+    if (auto s = worker->Listen(config); !s.IsOK()) {
+      LOG(ERROR) << "[server] The worker " << s.Msg();
+      exit(1);
+    }
     // multiple workers can't listen to the same unix socket, so
     // listen unix socket only from a single worker - the first one
     if (!config->unixsocket.empty() && i == 0) {
@@ -86,6 +117,28 @@ Server::Server(Engine::Storage *storage, Config *config) : storage_(storage), co
   slow_log_.SetMaxEntries(config->slowlog_max_len);
   perf_log_.SetMaxEntries(config->profiling_sample_record_max_len);
   lua_ = Lua::CreateState();
+  if (config->lua_readonly_script_threads > 0) {
+    for (int i = 0; i < config->lua_readonly_script_threads; i++) {
+      readonly_script_states_.emplace_back(Lua::CreateState(true));
+    }
+    readonly_script_memory_ = std::make_unique<std::atomic<int64_t>[]>(readonly_script_states_.size());
+    for (size_t i = 0; i < readonly_script_states_.size(); i++) {
+      readonly_script_memory_[i] = static_cast<int64_t>(lua_gc(readonly_script_states_[i], LUA_GCCOUNT, 0)) * 1024;
+    }
+    readonly_script_runner_ = std::make_unique<TaskRunner>(config->lua_readonly_script_threads);
+    readonly_script_runner_->SetCPUAffinity(config->worker_cpus);
+    readonly_script_runner_->SetThreadInitializer([this]() {
+      Util::ThreadSetName("lua-readonly");
+      size_t index = taken_readonly_script_states_++;
+      readonly_script_state = readonly_script_states_[index];
+      readonly_script_memory = &readonly_script_memory_[index];
+    });
+  }
+  if (config->scan_parallel_threads > 0) {
+    scan_runner_ = std::make_unique<TaskRunner>(config->scan_parallel_threads);
+    scan_runner_->SetCPUAffinity(config->worker_cpus);
+    scan_runner_->SetThreadInitializer([]() { Util::ThreadSetName("parallel-scan"); });
+  }
   fetch_file_threads_num_ = 0;
   time(&start_time_);
   stop_ = false;
@@ -93,10 +146,6 @@ Server::Server(Engine::Storage *storage, Config *config) : storage_(storage), co
 }
 
 Server::~Server() {
-  for (const auto &iter : conn_ctxs_) {
-    delete iter.first;
-  }
-
   // Wait for all fetch file threads stop and exit and force destroy
   // the server after 60s.
   int counter = 0;
@@ -109,6 +158,9 @@ Server::~Server() {
     }
   }
   Lua::DestroyState(lua_);
+  for (auto lua : readonly_script_states_) {
+    Lua::DestroyState(lua);
+  }
 }
 
 // Kvrocks threads list:
@@ -145,20 +197,42 @@ Status Server::Start() {
     }
   }
 
-  for (const auto &worker : worker_threads_) {
-    worker->Start();
+  ScriptPreload();
+  storage_->GetCacheWarmer()->Start();
+#ifdef ENABLE_OPENSSL
+  if (tls_handshaker_) {
+    auto s = tls_handshaker_->Start(config_->tls_handshake_threads);
+    if (!s.IsOK()) return s;
+  }
+#endif
+  if (readonly_script_runner_) readonly_script_runner_->Start();
+  if (scan_runner_) scan_runner_->Start();
+  {
+    std::shared_lock<std::shared_mutex> guard(worker_threads_mu_);
+    for (const auto &worker : worker_threads_) {
+      worker->Start();
+    }
   }
+  task_runner_.SetCPUAffinity(config_->background_cpus);
   task_runner_.Start();
   // setup server cron thread
   cron_thread_ = std::thread([this]() {
     Util::ThreadSetName("server-cron");
+    if (auto s = Util::ThreadSetAffinity(config_->background_cpus); !s.IsOK()) {
+      LOG(WARNING) << "[server] Failed to set the cpu affinity of cron thread, err: " << s.Msg();
+    }
     this->cron();
   });
 
   compaction_checker_thread_ = std::thread([this]() {
     uint64_t counter = 0;
-    int32_t last_compact_date = 0;
+    // The daily compaction isn't triggered right after the restart, it rewrites the whole
+    // propagate and pubsub column families
+    auto last_compact_date = static_cast<int32_t>(Util::GetTimeStamp() / 86400);
     Util::ThreadSetName("compact-check");
+    if (auto s = Util::ThreadSetAffinity(config_->background_cpus); !s.IsOK()) {
+      LOG(WARNING) << "[server] Failed to set the cpu affinity of compaction checker thread, err: " << s.Msg();
+    }
     CompactionChecker compaction_checker(this->storage_);
     while (!stop_) {
       // Sleep first
@@ -187,8 +261,86 @@ Status Server::Start() {
           compaction_checker.CompactPropagateAndPubSubFiles();
         }
       }
+      // The ranges with many skipped tombstones are compacted at any hour, the compactions are targeted
+      if (!is_loading_ && counter % 100 == 0 && config_->compaction_checker_tombstone_threshold > 0) {
+        compaction_checker.CompactTombstoneRanges(config_->compaction_checker_tombstone_threshold);
+      }
+    }
+  });
+  // Sync the WAL periodically if rocksdb.wal_sync_interval_ms, so the writes don't wait for the syncs
+  wal_sync_thread_ = std::thread([this]() {
+    Util::ThreadSetName("wal-sync");
+    if (auto s = Util::ThreadSetAffinity(config_->background_cpus); !s.IsOK()) {
+      LOG(WARNING) << "[server] Failed to set the cpu affinity of wal sync thread, err: " << s.Msg();
+    }
+    auto last_sync = std::chrono::steady_clock::now();
+    while (!stop_) {
+      int interval_ms = config_->RocksDB.wal_sync_interval_ms;
+      // Sleep at most 100ms to check stop_, the interval may be changed meanwhile
+      std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms > 0 ? std::min(interval_ms, 100) : 100));
+      if (interval_ms <= 0 || std::chrono::steady_clock::now() - last_sync < std::chrono::milliseconds(interval_ms)) {
+        continue;
+      }
+      last_sync = std::chrono::steady_clock::now();
+
+      auto guard = storage_->ReadLockGuard();
+      if (storage_->IsClosing()) continue;
+      auto s = storage_->SyncWAL();
+      if (!s.ok()) LOG(WARNING) << "[server] Failed to sync the WAL, err: " << s.ToString();
+    }
+  });
+  monitor_feeder_thread_ = std::thread([this]() {
+    Util::ThreadSetName("monitor-feeder");
+    while (!stop_) {
+      // Poll the queues frequently only if there're monitors
+      std::this_thread::sleep_for(std::chrono::milliseconds(monitor_clients_ > 0 ? 1 : 100));
+      feedMonitorEntries();
     }
   });
+  key_counter_thread_ = std::thread([this]() {
+    Util::ThreadSetName("key-counter");
+    auto key_counter = storage_->GetKeyCounter();
+    while (!stop_) {
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+      if (!config_->key_count_tracking || key_counter->Ready() || is_loading_) continue;
+
+      // To guarantee accessing DB safely, the rebuild would be aborted when closing the DB
+      auto guard = storage_->ReadLockGuard();
+      if (storage_->IsClosing()) continue;
+      LOG(INFO) << "[server] Start to rebuild the key counter";
+      auto s = key_counter->Rebuild(storage_->GetDB(), storage_->GetAllCFHandles(Engine::kMetadataColumnFamilyName));
+      LOG(INFO) << "[server] Rebuild the key counter, result: " << s.ToString();
+    }
+  });
+  big_keys_thread_ = std::thread([this]() {
+    Util::ThreadSetName("big-keys");
+    while (!stop_) {
+      // Scan a tenth of the keys of the rate every 100ms
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      int rate = config_->bigkeys_scan_rate;
+      if (rate <= 0 || is_loading_) {
+        big_key_scanner_.Reset();
+        continue;
+      }
+
+      auto guard = storage_->ReadLockGuard();
+      if (storage_->IsClosing()) continue;
+      auto s = big_key_scanner_.Step(static_cast<size_t>(std::max(rate / 10, 1)));
+      if (!s.ok()) {
+        LOG(WARNING) << "[server] Failed to scan the big keys, err: " << s.ToString();
+        big_key_scanner_.Reset();
+      }
+    }
+  });
+  if (config_->metrics_port > 0) {
+    metrics_server_ = std::make_unique<MetricsServer>(this);
+    auto s = metrics_server_->Listen(config_->binds, config_->metrics_port);
+    if (s.IsOK()) s = metrics_server_->Start();
+    if (!s.IsOK()) {
+      LOG(ERROR) << "[server] Failed to start the metrics server, err: " << s.Msg();
+      return s;
+    }
+  }
   memory_startup_use_ = Stats::GetMemoryRSS();
   LOG(INFO) << "Ready to accept connections";
 
@@ -197,29 +349,59 @@ Status Server::Start() {
 
 void Server::Stop() {
   stop_ = true;
+  // Abort the running rebuild of the key counter
+  storage_->GetKeyCounter()->Clear();
   if (replication_thread_) replication_thread_->Stop();
-  for (const auto &worker : worker_threads_) {
-    worker->Stop();
+  {
+    std::shared_lock<std::shared_mutex> guard(worker_threads_mu_);
+    for (const auto &worker : worker_threads_) {
+      worker->Stop();
+    }
   }
+  if (readonly_script_runner_) readonly_script_runner_->Stop();
+  if (scan_runner_) scan_runner_->Stop();
+#ifdef ENABLE_OPENSSL
+  if (tls_handshaker_) tls_handshaker_->Stop();
+#endif
+  if (metrics_server_) metrics_server_->Stop();
   DisconnectSlaves();
+  {
+    std::lock_guard<std::mutex> lg(slave_threads_mu_);
+    if (repl_feeder_) repl_feeder_->Stop();
+  }
+  compaction_scheduler_.Stop();
   rocksdb::CancelAllBackgroundWork(storage_->GetDB(), true);
   task_runner_.Stop();
 }
 
 void Server::Join() {
-  for (const auto &worker : worker_threads_) {
-    worker->Join();
+  {
+    std::shared_lock<std::shared_mutex> guard(worker_threads_mu_);
+    for (const auto &worker : worker_threads_) {
+      worker->Join();
+    }
   }
+  if (readonly_script_runner_) readonly_script_runner_->Join();
+  if (scan_runner_) scan_runner_->Join();
+#ifdef ENABLE_OPENSSL
+  if (tls_handshaker_) tls_handshaker_->Join();
+#endif
   task_runner_.Join();
   if (cron_thread_.joinable()) cron_thread_.join();
   if (compaction_checker_thread_.joinable()) compaction_checker_thread_.join();
+  if (key_counter_thread_.joinable()) key_counter_thread_.join();
+  if (big_keys_thread_.joinable()) big_keys_thread_.join();
+  if (wal_sync_thread_.joinable()) wal_sync_thread_.join();
+  if (monitor_feeder_thread_.joinable()) monitor_feeder_thread_.join();
+  if (metrics_server_) metrics_server_->Join();
 }
 
-Status Server::AddMaster(const std::string &host, uint32_t port, bool force_reconnect) {
+Status Server::AddMaster(const std::string &host, uint32_t port, bool force_reconnect, const std::string &backup_dir) {
   std::lock_guard<std::mutex> guard(slaveof_mu_);
 
-  // Don't check host and port if 'force_reconnect' argument is set to true
-  if (!force_reconnect && !master_host_.empty() && master_host_ == host && master_port_ == port) {
+  // Don't check host and port if 'force_reconnect' argument is set to true, or the backup is restored
+  if (!force_reconnect && backup_dir.empty() && !master_host_.empty() && master_host_ == host &&
+      master_port_ == port) {
     return Status::OK();
   }
 
@@ -233,7 +415,10 @@ Status Server::AddMaster(const std::string &host, uint32_t port, bool force_reco
   // replication, and uses 'listen-port + 1' as thread listening port.
   uint32_t master_listen_port = port;
   if (GetConfig()->master_use_repl_port) master_listen_port += 1;
-  replication_thread_ = std::make_unique<ReplicationThread>(host, master_listen_port, this);
+  // Replicas must not write the DB by themselves, the master would replicate its reclamation
+  storage_->GetKeyReclaimer()->SetPaused(true);
+  storage_->GetLazyExpirer()->SetPaused(true);
+  replication_thread_ = std::make_unique<ReplicationThread>(host, master_listen_port, this, backup_dir);
   auto s = replication_thread_->Start([this]() { PrepareRestoreDB(); },
                                       [this]() {
                                         this->is_loading_ = false;
@@ -245,6 +430,10 @@ Status Server::AddMaster(const std::string &host, uint32_t port, bool force_reco
     config_->SetMaster(host, port);
   } else {
     replication_thread_ = nullptr;
+    if (master_host_.empty()) {
+      storage_->GetKeyReclaimer()->SetPaused(false);
+      storage_->GetLazyExpirer()->SetPaused(false);
+    }
   }
   return s;
 }
@@ -257,12 +446,44 @@ Status Server::RemoveMaster() {
     config_->ClearMaster();
     if (replication_thread_) replication_thread_->Stop();
     replication_thread_ = nullptr;
+    // The batches applied without the WAL are persisted before the writes of the new master
+    if (auto s = storage_->FlushReplicaWrites(); !s.IsOK()) {
+      LOG(WARNING) << "Failed to flush the replicated writes, err: " << s.Msg();
+    }
     storage_->ShiftReplId();
+    storage_->GetKeyReclaimer()->SetPaused(false);
+    storage_->GetLazyExpirer()->SetPaused(false);
   }
   return Status::OK();
 }
 
+void Server::startReplBacklogIfNeed() {
+  if (!repl_backlog_ && config_->repl_backlog_mb > 0) {
+    repl_backlog_ = std::make_unique<ReplBacklog>(storage_, config_->repl_backlog_mb * MiB);
+    if (auto s = repl_backlog_->Start(); !s.IsOK()) {
+      LOG(WARNING) << "Failed to start the replication backlog, err: " << s.Msg();
+      repl_backlog_ = nullptr;
+    }
+  }
+}
+
+Status Server::startReplFeederIfNeed() {
+  if (repl_feeder_) return Status::OK();
+  auto repl_feeder = std::make_unique<ReplFeeder>(this);
+  auto s = repl_feeder->Start();
+  if (!s.IsOK()) return {Status::NotOK, "failed to start the replication feeder: " + s.Msg()};
+  repl_feeder_ = std::move(repl_feeder);
+  return Status::OK();
+}
+
 Status Server::AddSlave(Redis::Connection *conn, rocksdb::SequenceNumber next_repl_seq) {
+  {
+    std::lock_guard<std::mutex> lg(slave_threads_mu_);
+    startReplBacklogIfNeed();
+    auto s = startReplFeederIfNeed();
+    if (!s.IsOK()) return s;
+  }
+
   auto t = new FeedSlaveThread(this, conn, next_repl_seq);
   auto s = t->Start();
   if (!s.IsOK()) {
@@ -275,6 +496,11 @@ Status Server::AddSlave(Redis::Connection *conn, rocksdb::SequenceNumber next_re
   return Status::OK();
 }
 
+bool Server::HasSlaves() {
+  std::lock_guard<std::mutex> lg(slave_threads_mu_);
+  return !slave_threads_.empty();
+}
+
 void Server::DisconnectSlaves() {
   std::lock_guard<std::mutex> guard(slaveof_mu_);
   for (const auto &slave_thread : slave_threads_) {
@@ -286,6 +512,87 @@ void Server::DisconnectSlaves() {
     slave_thread->Join();
     delete slave_thread;
   }
+  // The CDC subscribers also read the backlog, and the sequence numbers may change after the restore
+  DisconnectCDCSubscribers();
+  {
+    std::lock_guard<std::mutex> lg(wal_consumers_mu_);
+    wal_consumers_.clear();
+  }
+
+  std::lock_guard<std::mutex> lg(slave_threads_mu_);
+  if (repl_backlog_) {
+    repl_backlog_->Stop();
+    repl_backlog_ = nullptr;
+  }
+}
+
+namespace {
+
+std::string replicaWALConsumerID(FeedSlaveThread *slave) {
+  return "replica:" + slave->GetConn()->GetIP() + ":" + std::to_string(slave->GetConn()->GetListeningPort());
+}
+
+std::string cdcWALConsumerID(CDCFeedThread *cdc) {
+  auto name = cdc->GetConn()->GetName();
+  return "cdc:" + (name.empty() ? cdc->GetConn()->GetAddr() : name);
+}
+
+// The replica resumes from the batch after the last applied one, which may be before the sent ones
+rocksdb::SequenceNumber replicaNextSeq(FeedSlaveThread *slave) {
+  rocksdb::SequenceNumber next_seq = slave->GetCurrentReplSeq() + 1;
+  if (slave->GetAckSeq() > 0) next_seq = std::min(next_seq, slave->GetAckSeq() + 1);
+  return next_seq;
+}
+
+}  // namespace
+
+void Server::recordWALConsumer(const std::string &id, rocksdb::SequenceNumber next_seq, time_t now) {
+  std::lock_guard<std::mutex> lg(wal_consumers_mu_);
+  wal_consumers_[id] = {next_seq, now};
+}
+
+void Server::retainWALForReplicas() {
+  auto now = static_cast<time_t>(Util::GetTimeStamp());
+  {
+    std::lock_guard<std::mutex> lg(slave_threads_mu_);
+    for (const auto &slave : slave_threads_) {
+      if (!slave->IsStopped()) recordWALConsumer(replicaWALConsumerID(slave), replicaNextSeq(slave), now);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lg(cdc_threads_mu_);
+    for (const auto &cdc : cdc_threads_) {
+      if (!cdc->IsStopped()) recordWALConsumer(cdcWALConsumerID(cdc), cdc->GetCurrentSeq() + 1, now);
+    }
+  }
+
+  rocksdb::SequenceNumber min_retained_seq = storage_->LatestSeq() + 1;
+  {
+    std::lock_guard<std::mutex> lg(wal_consumers_mu_);
+    for (auto iter = wal_consumers_.begin(); iter != wal_consumers_.end();) {
+      if (now - iter->second.second > config_->wal_retention_replica_timeout) {
+        iter = wal_consumers_.erase(iter);
+        continue;
+      }
+      min_retained_seq = std::min(min_retained_seq, iter->second.first);
+      ++iter;
+    }
+  }
+  // The replicas which were connected before the restart may not have reconnected yet, and those
+  // in the full synchronization resume from the sequence of the checkpoint which isn't tracked
+  if (now - start_time_ <= config_->wal_retention_replica_timeout || storage_->ExistCheckpoint() ||
+      storage_->ExistPinnedReplFiles()) {
+    min_retained_seq = 0;
+  }
+  wal_retained_seq_ = min_retained_seq;
+
+  auto max_bytes = static_cast<uint64_t>(config_->RocksDB.WAL_size_limit_MB) * MiB;
+  auto purged = storage_->PurgeArchivedWALs(min_retained_seq, max_bytes);
+  if (!purged) {
+    LOG(WARNING) << "[server] Failed to purge the archived WAL files, err: " << purged.Msg();
+  } else if (*purged > 0) {
+    LOG(INFO) << "[server] Purged " << *purged << " archived WAL files before the sequence " << min_retained_seq;
+  }
 }
 
 void Server::cleanupExitedSlaves() {
@@ -294,124 +601,325 @@ void Server::cleanupExitedSlaves() {
   for (const auto &slave_thread : slave_threads_) {
     if (slave_thread->IsStopped()) exited_slave_threads.emplace_back(slave_thread);
   }
+  auto now = static_cast<time_t>(Util::GetTimeStamp());
   while (!exited_slave_threads.empty()) {
     auto t = exited_slave_threads.front();
     exited_slave_threads.pop_front();
+    if (config_->wal_retention_by_replicas) recordWALConsumer(replicaWALConsumerID(t), replicaNextSeq(t), now);
     slave_threads_.remove(t);
     t->Join();
     delete t;
   }
 }
 
+Status Server::AddCDCSubscriber(Redis::Connection *conn, CDCOptions options) {
+  {
+    std::lock_guard<std::mutex> lg(slave_threads_mu_);
+    startReplBacklogIfNeed();
+  }
+
+  auto t = new CDCFeedThread(this, conn, std::move(options));
+  auto s = t->Start();
+  if (!s.IsOK()) {
+    delete t;
+    return s;
+  }
+
+  std::lock_guard<std::mutex> lg(cdc_threads_mu_);
+  cdc_threads_.emplace_back(t);
+  return Status::OK();
+}
+
+void Server::DisconnectCDCSubscribers() {
+  std::list<CDCFeedThread *> cdc_threads;
+  {
+    std::lock_guard<std::mutex> lg(cdc_threads_mu_);
+    cdc_threads.swap(cdc_threads_);
+  }
+  for (const auto &cdc_thread : cdc_threads) {
+    cdc_thread->Stop();
+  }
+  for (const auto &cdc_thread : cdc_threads) {
+    cdc_thread->Join();
+    delete cdc_thread;
+  }
+}
+
+void Server::cleanupExitedCDCSubscribers() {
+  std::list<CDCFeedThread *> exited_cdc_threads;
+  {
+    std::lock_guard<std::mutex> lg(cdc_threads_mu_);
+    for (auto iter = cdc_threads_.begin(); iter != cdc_threads_.end();) {
+      if ((*iter)->IsStopped()) {
+        exited_cdc_threads.emplace_back(*iter);
+        iter = cdc_threads_.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+  }
+  auto now = static_cast<time_t>(Util::GetTimeStamp());
+  for (const auto &t : exited_cdc_threads) {
+    if (config_->wal_retention_by_replicas) recordWALConsumer(cdcWALConsumerID(t), t->GetCurrentSeq() + 1, now);
+    t->Join();
+    delete t;
+  }
+}
+
+// It's called in the thread of the connection's worker, which is the only producer of the worker's queue,
+// the entries are fed to the monitors by the monitor feeder thread, so the executing threads never wait for them
 void Server::FeedMonitorConns(Redis::Connection *conn, const std::vector<std::string> &tokens) {
-  if (monitor_clients_ <= 0) return;
+  if (monitor_clients_ <= 0 || tokens.empty()) return;
+  double sample_ratio = monitor_sample_ratio_.load(std::memory_order_relaxed);
+  if (sample_ratio < 1) {
+    thread_local std::mt19937 gen(std::random_device{}());
+    if (std::uniform_real_distribution<double>(0, 1)(gen) >= sample_ratio) return;
+  }
+
+  MonitorEntry entry;
+  auto now = Util::GetTimeStampUS();
+  entry.line = std::to_string(now / 1000000) + "." + std::to_string(now % 1000000);
+  entry.line += " [" + conn->GetNamespace() + " " + conn->GetAddr() + "]";
+  for (const auto &token : tokens) {
+    entry.line += " \"" + token + "\"";
+  }
+  entry.ns = conn->GetNamespace();
+  entry.conn_id = conn->GetID();
+  entry.cmd = Util::ToLower(tokens[0]);
+  if (tokens.size() > 1) entry.key = tokens[1];
+  entry.sample_ratio = sample_ratio;
+  if (!conn->Owner()->PushMonitorEntry(std::move(entry))) {
+    monitor_dropped_entries_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void Server::RaiseMonitorSampleRatio(double ratio) {
+  double current = monitor_sample_ratio_.load(std::memory_order_relaxed);
+  while (current < ratio && !monitor_sample_ratio_.compare_exchange_weak(current, ratio)) {
+  }
+}
+
+Status Server::ResizeWorkers(int workers) {
+  std::unique_lock<std::shared_mutex> guard(worker_threads_mu_);
+  std::vector<Worker *> active_workers;
+  for (const auto &worker_thread : worker_threads_) {
+    if (!worker_thread->GetWorker()->IsRetiring()) active_workers.emplace_back(worker_thread->GetWorker());
+  }
+  for (auto n = static_cast<int>(active_workers.size()); n < workers; n++) {
+    auto worker = std::make_unique<Worker>(this, config_);
+    if (auto s = worker->Listen(config_); !s.IsOK()) return s;
+    auto worker_thread = std::make_unique<WorkerThread>(std::move(worker));
+    worker_thread->Start();
+    worker_threads_.emplace_back(std::move(worker_thread));
+    LOG(INFO) << "[server] Started a new worker, active workers: " << n + 1;
+  }
+  // Retire the newest workers, whose connections are moved to the older ones
+  for (auto n = active_workers.size(); n > static_cast<size_t>(std::max(workers, 1)); n--) {
+    active_workers[n - 1]->Retire();
+    LOG(INFO) << "[server] Retiring a worker, active workers: " << n - 1;
+  }
+  return Status::OK();
+}
+
+void Server::MigrateConnections(Worker *worker) {
+  std::shared_lock<std::shared_mutex> guard(worker_threads_mu_);
+  std::vector<Worker *> targets;
+  for (const auto &worker_thread : worker_threads_) {
+    if (!worker_thread->GetWorker()->IsRetiring()) targets.emplace_back(worker_thread->GetWorker());
+  }
+  size_t moved = worker->MigrateConnections(targets);
+  if (moved > 0) LOG(INFO) << "[server] Moved " << moved << " connections from the retiring worker";
+}
+
+void Server::removeRetiredWorkers() {
+  std::vector<std::unique_ptr<WorkerThread>> retired;
+  {
+    std::unique_lock<std::shared_mutex> guard(worker_threads_mu_);
+    for (auto iter = worker_threads_.begin(); iter != worker_threads_.end();) {
+      if ((*iter)->GetWorker()->IsRetired()) {
+        retired.emplace_back(std::move(*iter));
+        iter = worker_threads_.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+  }
+  // Join out of the lock, since the retiring worker may be waiting for it to move the connections
+  for (const auto &worker_thread : retired) {
+    worker_thread->Stop();
+    worker_thread->Join();
+  }
+  if (!retired.empty()) LOG(INFO) << "[server] Removed " << retired.size() << " retired workers";
+}
+
+// Drain the monitor queues of all workers, then feed the entries to the monitors of each worker in batch
+void Server::feedMonitorEntries() {
+  std::vector<MonitorEntry> entries;
+  std::shared_lock<std::shared_mutex> guard(worker_threads_mu_);
   for (const auto &worker_thread : worker_threads_) {
     auto worker = worker_thread->GetWorker();
-    worker->FeedMonitorConns(conn, tokens);
+    // Drain at most one queue size every round, so that a busy worker can't starve the others
+    for (size_t i = 0; i < kMonitorQueueSize; i++) {
+      auto entry = worker->PopMonitorEntry();
+      if (!entry) break;
+      entries.emplace_back(std::move(*entry));
+    }
+  }
+  if (entries.empty()) return;
+
+  double max_sample_ratio = 0;
+  for (const auto &worker_thread : worker_threads_) {
+    max_sample_ratio = std::max(max_sample_ratio, worker_thread->GetWorker()->FeedMonitorConns(entries));
   }
+  // Lower the ratio if the monitors with the higher ratio are gone
+  if (max_sample_ratio > 0) monitor_sample_ratio_.store(max_sample_ratio, std::memory_order_relaxed);
 }
 
-int Server::PublishMessage(const std::string &channel, const std::string &msg) {
+Server::PubSubChannelShard &Server::pubsubChannelShard(const std::string &channel) {
+  return pubsub_channel_shards_[std::hash<std::string>{}(channel) % kPubSubChannelShards];
+}
+
+// The subscribers are grouped by their workers, so each worker is locked once to reply
+// to all its subscribers, and the reply of the channel or a pattern is encoded only once
+using SubscriberGroups = std::map<Worker *, std::vector<int>>;
+
+static void GroupSubscribers(const std::list<ConnContext> &conn_ctxs, SubscriberGroups *groups) {
+  for (const auto &conn_ctx : conn_ctxs) {
+    (*groups)[conn_ctx.owner].emplace_back(conn_ctx.fd);
+  }
+}
+
+static int ReplySubscribers(const SubscriberGroups &groups, const std::string &reply) {
   int cnt = 0;
-  int index = 0;
+  for (const auto &[owner, fds] : groups) {
+    cnt += owner->Reply(fds, reply);
+  }
+  return cnt;
+}
 
-  pubsub_channels_mu_.lock();
-  std::vector<ConnContext> to_publish_conn_ctxs;
-  auto iter = pubsub_channels_.find(channel);
-  if (iter != pubsub_channels_.end()) {
-    for (const auto &conn_ctx : iter->second) {
-      to_publish_conn_ctxs.emplace_back(*conn_ctx);
-    }
+int Server::PublishMessage(const std::string &channel, const std::string &msg) {
+  SubscriberGroups channel_subscribers;
+  {
+    auto &shard = pubsubChannelShard(channel);
+    std::lock_guard<std::mutex> guard(shard.mu);
+    auto iter = shard.channels.find(channel);
+    if (iter != shard.channels.end()) GroupSubscribers(iter->second, &channel_subscribers);
   }
 
-  // The patterns variable records the pattern of connections
-  std::vector<std::string> patterns;
-  std::vector<ConnContext> to_publish_patterns_conn_ctxs;
-  for (const auto &iter : pubsub_patterns_) {
-    if (Util::StringMatch(iter.first, channel, 0)) {
-      for (const auto &conn_ctx : iter.second) {
-        to_publish_patterns_conn_ctxs.emplace_back(*conn_ctx);
-        patterns.emplace_back(iter.first);
+  std::vector<std::pair<std::string, SubscriberGroups>> pattern_subscribers;
+  {
+    std::lock_guard<std::mutex> guard(pubsub_patterns_mu_);
+    std::string_view channel_view = channel;
+    for (size_t len = 0; len <= channel.size() && !pubsub_pattern_index_.empty(); len++) {
+      auto iter = pubsub_pattern_index_.find(channel_view.substr(0, len));
+      if (iter == pubsub_pattern_index_.end()) continue;
+      for (const auto &[pattern, glob] : iter->second) {
+        if (!glob.MatchesAllWithPrefix() && !glob.Match(channel)) continue;
+        auto &subscribers = pattern_subscribers.emplace_back(pattern, SubscriberGroups()).second;
+        GroupSubscribers(pubsub_patterns_.at(pattern), &subscribers);
       }
     }
   }
-  pubsub_channels_mu_.unlock();
 
-  std::string channel_reply;
-  channel_reply.append(Redis::MultiLen(3));
-  channel_reply.append(Redis::BulkString("message"));
-  channel_reply.append(Redis::BulkString(channel));
-  channel_reply.append(Redis::BulkString(msg));
-  for (const auto &conn_ctx : to_publish_conn_ctxs) {
-    auto s = conn_ctx.owner->Reply(conn_ctx.fd, channel_reply);
-    if (s.IsOK()) {
-      cnt++;
-    }
+  int cnt = 0;
+  if (!channel_subscribers.empty()) {
+    std::string channel_reply;
+    channel_reply.append(Redis::MultiLen(3));
+    channel_reply.append(Redis::BulkString("message"));
+    channel_reply.append(Redis::BulkString(channel));
+    channel_reply.append(Redis::BulkString(msg));
+    cnt += ReplySubscribers(channel_subscribers, channel_reply);
   }
 
   // We should publish corresponding pattern and message for connections
-  for (const auto &conn_ctx : to_publish_patterns_conn_ctxs) {
+  for (const auto &[pattern, subscribers] : pattern_subscribers) {
     std::string pattern_reply;
     pattern_reply.append(Redis::MultiLen(4));
     pattern_reply.append(Redis::BulkString("pmessage"));
-    pattern_reply.append(Redis::BulkString(patterns[index++]));
+    pattern_reply.append(Redis::BulkString(pattern));
     pattern_reply.append(Redis::BulkString(channel));
     pattern_reply.append(Redis::BulkString(msg));
-    auto s = conn_ctx.owner->Reply(conn_ctx.fd, pattern_reply);
-    if (s.IsOK()) {
-      cnt++;
-    }
+    cnt += ReplySubscribers(subscribers, pattern_reply);
   }
   return cnt;
 }
 
-void Server::SubscribeChannel(const std::string &channel, Redis::Connection *conn) {
-  std::lock_guard<std::mutex> guard(pubsub_channels_mu_);
-  auto conn_ctx = new ConnContext(conn->Owner(), conn->GetFD());
-  conn_ctxs_[conn_ctx] = true;
-  auto iter = pubsub_channels_.find(channel);
-  if (iter == pubsub_channels_.end()) {
-    std::list<ConnContext *> conn_ctxs;
-    conn_ctxs.emplace_back(conn_ctx);
-    pubsub_channels_.insert(std::pair<std::string, std::list<ConnContext *>>(channel, conn_ctxs));
-  } else {
-    iter->second.emplace_back(conn_ctx);
+int Server::PublishShardMessage(const std::string &channel, const std::string &msg) {
+  SubscriberGroups subscribers;
+  {
+    auto &shard = pubsubChannelShard(channel);
+    std::lock_guard<std::mutex> guard(shard.mu);
+    auto iter = shard.shard_channels.find(channel);
+    if (iter == shard.shard_channels.end()) return 0;
+    GroupSubscribers(iter->second, &subscribers);
+  }
+
+  std::string reply;
+  reply.append(Redis::MultiLen(3));
+  reply.append(Redis::BulkString("smessage"));
+  reply.append(Redis::BulkString(channel));
+  reply.append(Redis::BulkString(msg));
+  return ReplySubscribers(subscribers, reply);
+}
+
+// Remove the context of the connection from the subscribers, return whether it's found
+static bool RemoveSubscriber(std::list<ConnContext> *conn_ctxs, Redis::Connection *conn) {
+  for (auto iter = conn_ctxs->begin(); iter != conn_ctxs->end(); ++iter) {
+    if (conn->GetFD() == iter->fd && conn->Owner() == iter->owner) {
+      conn_ctxs->erase(iter);
+      return true;
+    }
   }
+  return false;
+}
+
+void Server::SubscribeChannel(const std::string &channel, Redis::Connection *conn, bool sharded) {
+  auto &shard = pubsubChannelShard(channel);
+  std::lock_guard<std::mutex> guard(shard.mu);
+  shard.Channels(sharded)[channel].emplace_back(conn->Owner(), conn->GetFD());
 }
 
-void Server::UnSubscribeChannel(const std::string &channel, Redis::Connection *conn) {
-  std::lock_guard<std::mutex> guard(pubsub_channels_mu_);
-  auto iter = pubsub_channels_.find(channel);
-  if (iter == pubsub_channels_.end()) {
+void Server::UnSubscribeChannel(const std::string &channel, Redis::Connection *conn, bool sharded) {
+  auto &shard = pubsubChannelShard(channel);
+  std::lock_guard<std::mutex> guard(shard.mu);
+  auto &shard_channels = shard.Channels(sharded);
+  auto iter = shard_channels.find(channel);
+  if (iter == shard_channels.end()) {
     return;
   }
-  for (const auto &conn_ctx : iter->second) {
-    if (conn->GetFD() == conn_ctx->fd && conn->Owner() == conn_ctx->owner) {
-      delConnContext(conn_ctx);
-      iter->second.remove(conn_ctx);
-      if (iter->second.empty()) {
-        pubsub_channels_.erase(iter);
-      }
-      break;
-    }
+  if (RemoveSubscriber(&iter->second, conn) && iter->second.empty()) {
+    shard_channels.erase(iter);
   }
 }
 
-void Server::GetChannelsByPattern(const std::string &pattern, std::vector<std::string> *channels) {
-  std::lock_guard<std::mutex> guard(pubsub_channels_mu_);
-  for (const auto &iter : pubsub_channels_) {
-    if (pattern.empty() || Util::StringMatch(pattern, iter.first, 0)) {
-      channels->emplace_back(iter.first);
+void Server::GetChannelsByPattern(const std::string &pattern, std::vector<std::string> *channels, bool sharded) {
+  std::optional<Util::GlobPattern> glob;
+  if (!pattern.empty()) glob.emplace(pattern);
+  for (auto &shard : pubsub_channel_shards_) {
+    std::lock_guard<std::mutex> guard(shard.mu);
+    const auto &shard_channels = shard.Channels(sharded);
+    if (!glob) {
+      for (const auto &iter : shard_channels) channels->emplace_back(iter.first);
+      continue;
+    }
+    // The channels are ordered, so only the ones with the literal prefix are visited
+    const auto &prefix = glob->LiteralPrefix();
+    for (auto iter = shard_channels.lower_bound(prefix);
+         iter != shard_channels.end() && iter->first.compare(0, prefix.size(), prefix) == 0; ++iter) {
+      if (glob->MatchesAllWithPrefix() || glob->Match(iter->first)) channels->emplace_back(iter->first);
     }
   }
+  std::sort(channels->begin(), channels->end());
 }
 
 void Server::ListChannelSubscribeNum(const std::vector<std::string> &channels,
-                                     std::vector<ChannelSubscribeNum> *channel_subscribe_nums) {
-  std::lock_guard<std::mutex> guard(pubsub_channels_mu_);
+                                     std::vector<ChannelSubscribeNum> *channel_subscribe_nums, bool sharded) {
   for (const auto &chan : channels) {
-    auto iter = pubsub_channels_.find(chan);
-    if (iter != pubsub_channels_.end()) {
+    auto &shard = pubsubChannelShard(chan);
+    std::lock_guard<std::mutex> guard(shard.mu);
+    const auto &shard_channels = shard.Channels(sharded);
+    auto iter = shard_channels.find(chan);
+    if (iter != shard_channels.end()) {
       channel_subscribe_nums->emplace_back(ChannelSubscribeNum{iter->first, iter->second.size()});
     } else {
       channel_subscribe_nums->emplace_back(ChannelSubscribeNum{chan, 0});
@@ -420,66 +928,79 @@ void Server::ListChannelSubscribeNum(const std::vector<std::string> &channels,
 }
 
 void Server::PSubscribeChannel(const std::string &pattern, Redis::Connection *conn) {
-  std::lock_guard<std::mutex> guard(pubsub_channels_mu_);
-  auto conn_ctx = new ConnContext(conn->Owner(), conn->GetFD());
-  conn_ctxs_[conn_ctx] = true;
-  auto iter = pubsub_patterns_.find(pattern);
-  if (iter == pubsub_patterns_.end()) {
-    std::list<ConnContext *> conn_ctxs;
-    conn_ctxs.emplace_back(conn_ctx);
-    pubsub_patterns_.insert(std::pair<std::string, std::list<ConnContext *>>(pattern, conn_ctxs));
-  } else {
-    iter->second.emplace_back(conn_ctx);
+  std::lock_guard<std::mutex> guard(pubsub_patterns_mu_);
+  auto &conn_ctxs = pubsub_patterns_[pattern];
+  if (conn_ctxs.empty()) {
+    Util::GlobPattern glob(pattern);
+    auto prefix = glob.LiteralPrefix();
+    pubsub_pattern_index_[prefix].emplace(pattern, std::move(glob));
   }
+  conn_ctxs.emplace_back(conn->Owner(), conn->GetFD());
 }
 
 void Server::PUnSubscribeChannel(const std::string &pattern, Redis::Connection *conn) {
-  std::lock_guard<std::mutex> guard(pubsub_channels_mu_);
+  std::lock_guard<std::mutex> guard(pubsub_patterns_mu_);
   auto iter = pubsub_patterns_.find(pattern);
   if (iter == pubsub_patterns_.end()) {
     return;
   }
-  for (const auto &conn_ctx : iter->second) {
-    if (conn->GetFD() == conn_ctx->fd && conn->Owner() == conn_ctx->owner) {
-      delConnContext(conn_ctx);
-      iter->second.remove(conn_ctx);
-      if (iter->second.empty()) {
-        pubsub_patterns_.erase(iter);
-      }
-      break;
+  if (RemoveSubscriber(&iter->second, conn) && iter->second.empty()) {
+    pubsub_patterns_.erase(iter);
+    auto index_iter = pubsub_pattern_index_.find(Util::GlobPattern(pattern).LiteralPrefix());
+    if (index_iter != pubsub_pattern_index_.end()) {
+      index_iter->second.erase(pattern);
+      if (index_iter->second.empty()) pubsub_pattern_index_.erase(index_iter);
     }
   }
 }
 
+int Server::GetPubSubPatternSize() {
+  std::lock_guard<std::mutex> guard(pubsub_patterns_mu_);
+  return static_cast<int>(pubsub_patterns_.size());
+}
+
+Server::BlockingKeyShard &Server::blockingKeyShard(const std::string &key) {
+  return blocking_key_shards_[std::hash<std::string>{}(key) % kBlockingKeyShards];
+}
+
+// Enable the write events of the woken connections, each worker is locked once for all its connections
+static void WakeupConns(const std::vector<ConnContext> &conn_ctxs) {
+  std::map<Worker *, std::vector<int>> groups;
+  for (const auto &conn_ctx : conn_ctxs) {
+    groups[conn_ctx.owner].emplace_back(conn_ctx.fd);
+  }
+  for (const auto &[owner, fds] : groups) {
+    owner->EnableWriteEvents(fds);
+  }
+}
+
 void Server::AddBlockingKey(const std::string &key, Redis::Connection *conn) {
-  std::lock_guard<std::mutex> guard(blocking_keys_mu_);
-  auto iter = blocking_keys_.find(key);
-  auto conn_ctx = new ConnContext(conn->Owner(), conn->GetFD());
-  conn_ctxs_[conn_ctx] = true;
-  if (iter == blocking_keys_.end()) {
-    std::list<ConnContext *> conn_ctxs;
-    conn_ctxs.emplace_back(conn_ctx);
-    blocking_keys_.insert(std::pair<std::string, std::list<ConnContext *>>(key, conn_ctxs));
-  } else {
-    iter->second.emplace_back(conn_ctx);
+  auto &shard = blockingKeyShard(key);
+  {
+    std::lock_guard<std::mutex> guard(shard.mu);
+    shard.keys[key].emplace_back(conn->Owner(), conn->GetFD());
+    shard.waiters++;
   }
   IncrBlockedClientNum();
 }
 
 void Server::UnBlockingKey(const std::string &key, Redis::Connection *conn) {
-  std::lock_guard<std::mutex> guard(blocking_keys_mu_);
-  auto iter = blocking_keys_.find(key);
-  if (iter == blocking_keys_.end()) {
-    return;
-  }
-  for (const auto &conn_ctx : iter->second) {
-    if (conn->GetFD() == conn_ctx->fd && conn->Owner() == conn_ctx->owner) {
-      delConnContext(conn_ctx);
-      iter->second.remove(conn_ctx);
-      if (iter->second.empty()) {
-        blocking_keys_.erase(iter);
+  auto &shard = blockingKeyShard(key);
+  {
+    std::lock_guard<std::mutex> guard(shard.mu);
+    // The key is already removed if all its connections were woken up
+    auto iter = shard.keys.find(key);
+    if (iter != shard.keys.end()) {
+      for (auto it = iter->second.begin(); it != iter->second.end(); ++it) {
+        if (conn->GetFD() == it->fd && conn->Owner() == it->owner) {
+          iter->second.erase(it);
+          shard.waiters--;
+          if (iter->second.empty()) {
+            shard.keys.erase(iter);
+          }
+          break;
+        }
       }
-      break;
     }
   }
   DecrBlockedClientNum();
@@ -487,27 +1008,22 @@ void Server::UnBlockingKey(const std::string &key, Redis::Connection *conn) {
 
 void Server::BlockOnStreams(const std::vector<std::string> &keys, const std::vector<Redis::StreamEntryID> &entry_ids,
                             Redis::Connection *conn) {
-  std::lock_guard<std::mutex> guard(blocking_keys_mu_);
   IncrBlockedClientNum();
   for (size_t i = 0; i < keys.size(); ++i) {
     auto consumer = std::make_shared<StreamConsumer>(conn->Owner(), conn->GetFD(), conn->GetNamespace(), entry_ids[i]);
-    auto iter = blocked_stream_consumers_.find(keys[i]);
-    if (iter == blocked_stream_consumers_.end()) {
-      std::set<std::shared_ptr<StreamConsumer>> consumers;
-      consumers.insert(consumer);
-      blocked_stream_consumers_.insert(std::make_pair(keys[i], consumers));
-    } else {
-      iter->second.insert(consumer);
-    }
+    auto &shard = blockingKeyShard(keys[i]);
+    std::lock_guard<std::mutex> guard(shard.mu);
+    if (shard.stream_consumers[keys[i]].insert(consumer).second) shard.waiters++;
   }
 }
 
 void Server::UnblockOnStreams(const std::vector<std::string> &keys, Redis::Connection *conn) {
-  std::lock_guard<std::mutex> guard(blocking_keys_mu_);
   DecrBlockedClientNum();
   for (const auto &key : keys) {
-    auto iter = blocked_stream_consumers_.find(key);
-    if (iter == blocked_stream_consumers_.end()) {
+    auto &shard = blockingKeyShard(key);
+    std::lock_guard<std::mutex> guard(shard.mu);
+    auto iter = shard.stream_consumers.find(key);
+    if (iter == shard.stream_consumers.end()) {
       continue;
     }
 
@@ -515,56 +1031,257 @@ void Server::UnblockOnStreams(const std::vector<std::string> &keys, Redis::Conne
       const auto &consumer = *it;
       if (conn->GetFD() == consumer->fd && conn->Owner() == consumer->owner) {
         iter->second.erase(it);
+        shard.waiters--;
         if (iter->second.empty()) {
-          blocked_stream_consumers_.erase(iter);
+          shard.stream_consumers.erase(iter);
         }
         break;
       }
+      ++it;
     }
   }
 }
 
 Status Server::WakeupBlockingConns(const std::string &key, size_t n_conns) {
-  std::lock_guard<std::mutex> guard(blocking_keys_mu_);
-  auto iter = blocking_keys_.find(key);
-  if (iter == blocking_keys_.end() || iter->second.empty()) {
-    return Status(Status::NotOK);
-  }
-  while (n_conns-- && !iter->second.empty()) {
-    auto conn_ctx = iter->second.front();
-    conn_ctx->owner->EnableWriteEvent(conn_ctx->fd);
-    delConnContext(conn_ctx);
-    iter->second.pop_front();
+  auto &shard = blockingKeyShard(key);
+  if (shard.waiters == 0) return Status(Status::NotOK);
+
+  std::vector<ConnContext> woken_conns;
+  {
+    std::lock_guard<std::mutex> guard(shard.mu);
+    auto iter = shard.keys.find(key);
+    if (iter == shard.keys.end() || iter->second.empty()) {
+      return Status(Status::NotOK);
+    }
+    while (n_conns-- && !iter->second.empty()) {
+      woken_conns.emplace_back(iter->second.front());
+      iter->second.pop_front();
+      shard.waiters--;
+    }
+    if (iter->second.empty()) shard.keys.erase(iter);
   }
+  WakeupConns(woken_conns);
   return Status::OK();
 }
 
+void Server::AddReplAckWaiter(Redis::Connection *conn, rocksdb::SequenceNumber seq, int num_replicas) {
+  {
+    std::lock_guard<std::mutex> guard(repl_ack_waiters_mu_);
+    repl_ack_waiters_.emplace(seq, ReplAckWaiter{ConnContext(conn->Owner(), conn->GetFD()), num_replicas});
+    repl_ack_waiters_size_ = repl_ack_waiters_.size();
+  }
+  IncrBlockedClientNum();
+  // The replicas may acknowledge the sequence number before the waiter was added
+  WakeupReplAckWaiters();
+}
+
+void Server::RemoveReplAckWaiter(Redis::Connection *conn) {
+  std::lock_guard<std::mutex> guard(repl_ack_waiters_mu_);
+  for (auto iter = repl_ack_waiters_.begin(); iter != repl_ack_waiters_.end(); ++iter) {
+    if (iter->second.ctx.fd == conn->GetFD() && iter->second.ctx.owner == conn->Owner()) {
+      repl_ack_waiters_.erase(iter);
+      repl_ack_waiters_size_ = repl_ack_waiters_.size();
+      DecrBlockedClientNum();
+      break;
+    }
+  }
+}
+
+int Server::CountReplicasAcked(rocksdb::SequenceNumber seq) {
+  std::lock_guard<std::mutex> guard(slave_threads_mu_);
+  return static_cast<int>(std::count_if(slave_threads_.begin(), slave_threads_.end(), [seq](FeedSlaveThread *slave) {
+    return !slave->IsStopped() && slave->GetAckSeq() >= seq;
+  }));
+}
+
+void Server::WakeupReplAckWaiters() {
+  if (repl_ack_waiters_size_ == 0) return;
+
+  // The acknowledged sequence numbers in descending order
+  std::vector<rocksdb::SequenceNumber> acks;
+  {
+    std::lock_guard<std::mutex> guard(slave_threads_mu_);
+    for (const auto &slave : slave_threads_) {
+      if (!slave->IsStopped()) acks.emplace_back(slave->GetAckSeq());
+    }
+  }
+  if (acks.empty()) return;
+  std::sort(acks.begin(), acks.end(), std::greater<>());
+
+  std::lock_guard<std::mutex> guard(repl_ack_waiters_mu_);
+  for (auto iter = repl_ack_waiters_.begin(); iter != repl_ack_waiters_.end() && iter->first <= acks[0];) {
+    auto num_replicas = static_cast<size_t>(iter->second.num_replicas);
+    if (num_replicas <= acks.size() && acks[num_replicas - 1] >= iter->first) {
+      iter->second.ctx.owner->EnableWriteEvent(iter->second.ctx.fd);
+      iter = repl_ack_waiters_.erase(iter);
+      DecrBlockedClientNum();
+    } else {
+      ++iter;
+    }
+  }
+  repl_ack_waiters_size_ = repl_ack_waiters_.size();
+}
+
 Status Server::OnEntryAddedToStream(const std::string &ns, const std::string &key,
                                     const Redis::StreamEntryID &entry_id) {
-  std::lock_guard<std::mutex> guard(blocking_keys_mu_);
-  auto iter = blocked_stream_consumers_.find(key);
-  if (iter == blocked_stream_consumers_.end() || iter->second.empty()) {
-    return Status(Status::NotOK);
+  auto &shard = blockingKeyShard(key);
+  if (shard.waiters == 0) return Status(Status::NotOK);
+
+  std::vector<ConnContext> woken_conns;
+  {
+    std::lock_guard<std::mutex> guard(shard.mu);
+    auto iter = shard.stream_consumers.find(key);
+    if (iter == shard.stream_consumers.end() || iter->second.empty()) {
+      return Status(Status::NotOK);
+    }
+
+    for (auto it = iter->second.begin(); it != iter->second.end();) {
+      auto consumer = *it;
+      if (consumer->ns == ns && entry_id > consumer->last_consumed_id) {
+        woken_conns.emplace_back(consumer->owner, consumer->fd);
+        it = iter->second.erase(it);
+        shard.waiters--;
+      } else {
+        ++it;
+      }
+    }
+    if (iter->second.empty()) shard.stream_consumers.erase(iter);
+  }
+  WakeupConns(woken_conns);
+  return Status::OK();
+}
+
+void Server::WatchKeys(Redis::Connection *conn, const std::vector<std::string> &ns_keys) {
+  std::lock_guard<std::mutex> guard(watched_keys_mu_);
+  for (const auto &ns_key : ns_keys) {
+    watched_keys_[ns_key].emplace(conn);
+    conn->GetWatchedKeys()->emplace(ns_key);
   }
+  watched_keys_size_ = watched_keys_.size();
+}
 
-  for (auto it = iter->second.begin(); it != iter->second.end();) {
-    auto consumer = *it;
-    if (consumer->ns == ns && entry_id > consumer->last_consumed_id) {
-      consumer->owner->EnableWriteEvent(consumer->fd);
-      it = iter->second.erase(it);
-    } else {
-      ++it;
+void Server::ResetWatchedKeys(Redis::Connection *conn) {
+  std::lock_guard<std::mutex> guard(watched_keys_mu_);
+  for (const auto &ns_key : *conn->GetWatchedKeys()) {
+    auto iter = watched_keys_.find(ns_key);
+    if (iter == watched_keys_.end()) continue;
+    iter->second.erase(conn);
+    if (iter->second.empty()) watched_keys_.erase(iter);
+  }
+  conn->GetWatchedKeys()->clear();
+  conn->SetWatchedKeysModified(false);
+  watched_keys_size_ = watched_keys_.size();
+}
+
+void Server::UpdateWatchedKeysFromArgs(const std::vector<std::string> &args,
+                                       const Redis::CommandAttributes &attributes, const std::string &ns) {
+  if (watched_keys_size_ == 0) return;
+
+  std::vector<int> keys_indexes;
+  auto s = Redis::GetKeysFromCommand(attributes.name, static_cast<int>(args.size()), &keys_indexes);
+  std::lock_guard<std::mutex> guard(watched_keys_mu_);
+  if (!s.IsOK()) {
+    // The keys written by the command are unknown, e.g. FLUSHDB
+    for (const auto &[ns_key, conns] : watched_keys_) {
+      for (const auto &conn : conns) conn->SetWatchedKeysModified(true);
     }
+    return;
+  }
+  for (auto i : keys_indexes) {
+    if (i >= static_cast<int>(args.size())) break;
+    std::string ns_key;
+    ComposeNamespaceKey(ns, args[i], &ns_key, storage_->IsSlotIdEncoded());
+    auto iter = watched_keys_.find(ns_key);
+    if (iter == watched_keys_.end()) continue;
+    for (const auto &conn : iter->second) conn->SetWatchedKeysModified(true);
+  }
+}
+
+void Server::BumpKeyWriteEpochsFromArgs(const std::vector<std::string> &args,
+                                        const Redis::CommandAttributes &attributes, const std::string &ns) {
+  // The exclusive commands and the ones which may store into the keys not in their arguments
+  if (attributes.is_exclusive() || attributes.name == "georadius" || attributes.name == "georadiusbymember") {
+    key_write_epochs_.BumpAll();
+    return;
+  }
+  std::vector<int> keys_indexes;
+  auto s = Redis::GetKeysFromCommand(attributes.name, static_cast<int>(args.size()), &keys_indexes);
+  if (!s.IsOK() || keys_indexes.empty()) {
+    // The keys written by the command are unknown, e.g. FLUSHDB
+    key_write_epochs_.BumpAll();
+    return;
+  }
+  for (auto i : keys_indexes) {
+    if (i >= static_cast<int>(args.size())) break;
+    std::string ns_key;
+    ComposeNamespaceKey(ns, args[i], &ns_key, storage_->IsSlotIdEncoded());
+    key_write_epochs_.Bump(ns_key);
   }
+}
 
+Status Server::EnableClientTracking(Redis::Connection *conn, const TrackingOptions &options) {
+  TrackingTarget target;
+  target.id = options.redirect;
+  {
+    std::shared_lock<std::shared_mutex> guard(worker_threads_mu_);
+    for (const auto &t : worker_threads_) {
+      int fd = t->GetWorker()->FindConnectionFD(options.redirect);
+      if (fd < 0) continue;
+      target.owner = t->GetWorker();
+      target.fd = fd;
+      break;
+    }
+  }
+  if (!target.owner) return {Status::NotOK, "The client ID you want redirect to does not exist"};
+
+  client_tracking_.Enable(conn->GetID(), conn->GetNamespace(), target, options);
   return Status::OK();
 }
 
-void Server::delConnContext(ConnContext *c) {
-  auto conn_ctx_iter = conn_ctxs_.find(c);
-  if (conn_ctx_iter != conn_ctxs_.end()) {
-    delete conn_ctx_iter->first;
-    conn_ctxs_.erase(conn_ctx_iter);
+void Server::TrackKeysFromArgs(Redis::Connection *conn, const std::vector<std::string> &args,
+                               const Redis::CommandAttributes &attributes, InvalidationBatches *batches) {
+  std::vector<int> keys_indexes;
+  auto s = Redis::GetKeysFromCommand(attributes.name, static_cast<int>(args.size()), &keys_indexes);
+  if (!s.IsOK()) return;
+
+  std::vector<std::string> keys;
+  for (auto i : keys_indexes) {
+    if (i >= static_cast<int>(args.size())) break;
+    keys.emplace_back(args[i]);
+  }
+  client_tracking_.RememberKeys(conn->GetID(), conn->GetNamespace(), keys,
+                                static_cast<size_t>(config_->tracking_table_max_keys), batches);
+}
+
+void Server::InvalidateTrackedKeysFromArgs(Redis::Connection *conn, const std::vector<std::string> &args,
+                                           const Redis::CommandAttributes &attributes, InvalidationBatches *batches) {
+  if (!client_tracking_.HasClients()) return;
+
+  if (attributes.name == "flushall") {
+    client_tracking_.InvalidateAll("", batches);
+    return;
+  }
+  std::vector<int> keys_indexes;
+  auto s = Redis::GetKeysFromCommand(attributes.name, static_cast<int>(args.size()), &keys_indexes);
+  if (!s.IsOK()) {
+    // The keys written by the command are unknown, e.g. FLUSHDB
+    client_tracking_.InvalidateAll(conn->GetNamespace(), batches);
+    return;
+  }
+  std::vector<std::string> keys;
+  for (auto i : keys_indexes) {
+    if (i >= static_cast<int>(args.size())) break;
+    keys.emplace_back(args[i]);
+  }
+  client_tracking_.InvalidateKeys(conn->GetID(), conn->GetNamespace(), keys, batches);
+}
+
+void Server::SendInvalidations(const InvalidationBatches &batches) {
+  std::shared_lock<std::shared_mutex> guard(worker_threads_mu_);
+  for (const auto &t : worker_threads_) {
+    // The workers of the targets may be retired and freed since the targets were resolved
+    auto iter = batches.find(t->GetWorker());
+    if (iter != batches.end()) t->GetWorker()->SendInvalidations(iter->second);
   }
 }
 
@@ -589,19 +1306,19 @@ int Server::IncrBlockedClientNum() { return blocked_clients_.fetch_add(1, std::m
 
 int Server::DecrBlockedClientNum() { return blocked_clients_.fetch_sub(1, std::memory_order_relaxed); }
 
-std::unique_ptr<RWLock::ReadLock> Server::WorkConcurrencyGuard() {
-  return std::make_unique<RWLock::ReadLock>(works_concurrency_rw_lock_);
+std::unique_ptr<RWLock::ShardedReadLock> Server::WorkConcurrencyGuard() {
+  return std::make_unique<RWLock::ShardedReadLock>(works_concurrency_rw_lock_);
 }
 
-std::unique_ptr<RWLock::WriteLock> Server::WorkExclusivityGuard() {
-  return std::make_unique<RWLock::WriteLock>(works_concurrency_rw_lock_);
+std::unique_ptr<RWLock::ShardedWriteLock> Server::WorkExclusivityGuard() {
+  return std::make_unique<RWLock::ShardedWriteLock>(works_concurrency_rw_lock_);
 }
 
 std::atomic<uint64_t> *Server::GetClientID() { return &client_id_; }
 
 void Server::recordInstantaneousMetrics() {
   auto rocksdb_stats = storage_->GetDB()->GetDBOptions().statistics;
-  stats_.TrackInstantaneousMetric(STATS_METRIC_COMMAND, stats_.total_calls);
+  stats_.TrackInstantaneousMetric(STATS_METRIC_COMMAND, stats_.GetTotalCalls());
   stats_.TrackInstantaneousMetric(STATS_METRIC_NET_INPUT, stats_.in_bytes);
   stats_.TrackInstantaneousMetric(STATS_METRIC_NET_OUTPUT, stats_.out_bytes);
   stats_.TrackInstantaneousMetric(STATS_METRIC_ROCKSDB_PUT,
@@ -618,11 +1335,24 @@ void Server::recordInstantaneousMetrics() {
                                   rocksdb_stats->getTickerCount(rocksdb::Tickers::NUMBER_DB_PREV));
 }
 
+void Server::ReconcileNamespaceSizes() {
+  auto namespace_sizes = storage_->GetNamespaceSizes();
+  std::set<std::string> namespaces;
+  for (const auto &iter : config_->tokens) {
+    uint64_t quota = config_->GetNamespaceDiskQuota(iter.second);
+    if (quota == 0) continue;
+    namespace_sizes->Reconcile(iter.second, storage_->GetTotalSize(iter.second), quota);
+    namespaces.emplace(iter.second);
+  }
+  namespace_sizes->Retain(namespaces);
+}
+
 void Server::cron() {
   uint64_t counter = 0;
   while (!stop_) {
     // Sleep first
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    removeRetiredWorkers();
 
     // To guarantee accessing DB safely
     auto guard = storage_->ReadLockGuard();
@@ -636,6 +1366,17 @@ void Server::cron() {
       // before the new db was reopened.
       continue;
     }
+    if (config_->info_rocksdb_refresh_ms > 0) refreshRocksDBInfo();
+    // Sample the number of the L0 files every second, to know how they pile up over time, and release
+    // the idle iterators of the scans, which pin the memtables and the SST files
+    if (counter % 10 == 0) {
+      storage_->GetScanIteratorCache()->EvictIdle(static_cast<uint64_t>(config_->scan_iterator_idle_timeout) * 1000);
+      for (const auto &cf_handle : storage_->GetAllCFHandles()) {
+        uint64_t files = 0;
+        if (!storage_->GetDB()->GetIntProperty(cf_handle, "rocksdb.num-files-at-level0", &files)) continue;
+        storage_->GetJobStats()->Get(cf_handle->GetName())->RecordLevel0Files(files);
+      }
+    }
     // check every 20s (use 20s instead of 60s so that cron will execute in critical condition)
     if (counter != 0 && counter % 200 == 0) {
       auto t = static_cast<time_t>(Util::GetTimeStamp());
@@ -644,7 +1385,11 @@ void Server::cron() {
       // disable compaction cron when the compaction checker was enabled
       if (!config_->compaction_checker_range.Enabled() && config_->compact_cron.IsEnabled() &&
           config_->compact_cron.IsTimeMatch(&now)) {
-        Status s = AsyncCompactDB();
+        CompactionScheduler::Options options;
+        options.parallelism = config_->compact_cron_parallelism;
+        options.max_io_bytes_per_sec = static_cast<uint64_t>(config_->compact_cron_max_io_mb) * MiB;
+        options.window_seconds = static_cast<int64_t>(config_->compact_cron_window_minutes) * 60;
+        Status s = is_loading_ ? Status(Status::NotOK, "loading in-progress") : compaction_scheduler_.Run(options);
         LOG(INFO) << "[server] Schedule to compact the db, result: " << s.Msg();
       }
       if (config_->bgsave_cron.IsEnabled() && config_->bgsave_cron.IsTimeMatch(&now)) {
@@ -663,23 +1408,41 @@ void Server::cron() {
       }
     }
 
+    if (counter != 0 && counter % 100 == 0) {
+      ReconcileNamespaceSizes();
+    }
+
+    if (counter != 0 && counter % 100 == 0 && config_->wal_retention_by_replicas) {
+      retainWALForReplicas();
+    }
+
+    // The replicas keep the markers of the master until it deletes them
+    if (counter != 0 && counter % 100 == 0 && !IsSlave()) {
+      auto s = storage_->PurgeStaleWritingVersions();
+      if (!s.IsOK()) LOG(WARNING) << "[server] " << s.Msg();
+    }
+
     // No replica uses this checkpoint, we can remove it.
     if (counter != 0 && counter % 100 == 0) {
       time_t create_time = storage_->GetCheckpointCreateTime();
       time_t access_time = storage_->GetCheckpointAccessTime();
 
-      if (storage_->ExistCheckpoint()) {
-        // TODO(shooterit): support to config the alive time of checkpoint
-        auto now = static_cast<time_t>(Util::GetTimeStamp());
-        if ((GetFetchFileThreadNum() == 0 && now - access_time > 30) || (now - create_time > 24 * 60 * 60)) {
-          auto s = rocksdb::DestroyDB(config_->checkpoint_dir, rocksdb::Options());
-          if (!s.ok()) {
-            LOG(WARNING) << "[server] Fail to clean checkpoint, error: " << s.ToString();
-          } else {
-            LOG(INFO) << "[server] Clean checkpoint successfully";
-          }
+      // TODO(shooterit): support to config the alive time of checkpoint
+      auto now = static_cast<time_t>(Util::GetTimeStamp());
+      bool expired = (GetFetchFileThreadNum() == 0 && now - access_time > 30) || (now - create_time > 24 * 60 * 60);
+      if (storage_->ExistCheckpoint() && expired) {
+        auto s = rocksdb::DestroyDB(config_->checkpoint_dir, rocksdb::Options());
+        if (!s.ok()) {
+          LOG(WARNING) << "[server] Fail to clean checkpoint, error: " << s.ToString();
+        } else {
+          LOG(INFO) << "[server] Clean checkpoint successfully";
         }
       }
+      // Release the live files pinned for the diskless full synchronization likewise
+      if (storage_->ExistPinnedReplFiles() && expired) {
+        storage_->ReleasePinnedReplFiles();
+        LOG(INFO) << "[server] Release the pinned files successfully";
+      }
     }
     // check if DB need to be resumed every minute
     // Rocksdb has auto resume feature after retryable io error, earlier version(before v6.22.1) had
@@ -693,12 +1456,64 @@ void Server::cron() {
       storage_->SetDBInRetryableIOError(false);
     }
 
+    // tune the IO rate limit every second
+    if (counter % 10 == 0 && config_->max_io_mb_auto_tune && config_->max_io_mb > 0) {
+      bool compacting = db_compacting_ || compaction_scheduler_.GetState() == CompactionScheduler::State::kRunning;
+      storage_->AutoTuneIORateLimit(static_cast<uint64_t>(config_->max_io_mb),
+                                    static_cast<uint64_t>(config_->max_io_mb_auto_tune_read_latency_us), compacting);
+    }
+
+    if (config_->workload_auto_tune && counter != 0 && counter % (config_->workload_auto_tune_interval * 10) == 0) {
+      Engine::WorkloadTuner::Bounds bounds;
+      bounds.min_cache_ratio = config_->workload_auto_tune_min_cache_ratio;
+      bounds.min_background_compactions = config_->RocksDB.max_background_compactions;
+      bounds.max_background_compactions = config_->workload_auto_tune_max_background_compactions;
+      bounds.min_write_buffer_size = static_cast<uint64_t>(std::max(config_->RocksDB.write_buffer_size, 1)) * MiB;
+      bounds.max_write_buffer_size = static_cast<uint64_t>(config_->workload_auto_tune_max_write_buffer_size) * MiB;
+      auto s = storage_->GetWorkloadTuner()->Tune(bounds);
+      if (!s.IsOK()) LOG(WARNING) << "[server] Failed to tune the options to the workload, err: " << s.Msg();
+    }
+
+    // The replicas delete the expired keys by replicating the master's deletions
+    if (config_->active_expire_enabled && !IsSlave()) {
+      auto s = expire_reaper_.ReapOnce(config_->active_expire_keys_per_cycle);
+      if (!s.IsOK()) LOG(WARNING) << "[server] Failed to delete the expired keys actively, err: " << s.Msg();
+    }
+
     cleanupExitedSlaves();
+    cleanupExitedCDCSubscribers();
     recordInstantaneousMetrics();
   }
 }
 
 void Server::GetRocksDBInfo(std::string *info) {
+  auto refresh_ms = static_cast<uint64_t>(config_->info_rocksdb_refresh_ms);
+  if (refresh_ms > 0) {
+    // The snapshot which wasn't refreshed in time, e.g. right after the refresh was enabled,
+    // is collected again instead
+    auto snapshot = std::atomic_load(&rocksdb_info_snapshot_);
+    auto now = Util::GetTimeStampMS();
+    if (snapshot && now < snapshot->collected_ms + 2 * refresh_ms + 1000) {
+      *info = snapshot->info;
+      *info += "info_rocksdb_age_ms:" + std::to_string(now - std::min(now, snapshot->collected_ms)) + "\r\n";
+      return;
+    }
+  }
+  collectRocksDBInfo(info);
+}
+
+void Server::refreshRocksDBInfo() {
+  auto snapshot = std::atomic_load(&rocksdb_info_snapshot_);
+  auto now = Util::GetTimeStampMS();
+  if (snapshot && now < snapshot->collected_ms + static_cast<uint64_t>(config_->info_rocksdb_refresh_ms)) return;
+
+  auto new_snapshot = std::make_shared<RocksDBInfoSnapshot>();
+  collectRocksDBInfo(&new_snapshot->info);
+  new_snapshot->collected_ms = now;
+  std::atomic_store(&rocksdb_info_snapshot_, std::shared_ptr<const RocksDBInfoSnapshot>(std::move(new_snapshot)));
+}
+
+void Server::collectRocksDBInfo(std::string *info) {
   std::ostringstream string_stream;
   rocksdb::DB *db = storage_->GetDB();
 
@@ -719,7 +1534,7 @@ void Server::GetRocksDBInfo(std::string *info) {
   db->GetAggregatedIntProperty("rocksdb.num-live-versions", &num_live_versions);
 
   string_stream << "# RocksDB\r\n";
-  for (const auto &cf_handle : *storage_->GetCFHandles()) {
+  for (const auto &cf_handle : storage_->GetAllCFHandles()) {
     uint64_t estimate_keys = 0, block_cache_usage = 0, block_cache_pinned_usage = 0, index_and_filter_cache_usage = 0;
     std::map<std::string, std::string> cf_stats_map;
     db->GetIntProperty(cf_handle, "rocksdb.estimate-num-keys", &estimate_keys);
@@ -744,9 +1559,75 @@ void Server::GetRocksDBInfo(std::string *info) {
                   << "]:" << cf_stats_map["io_stalls.memtable_slowdown"] << "\r\n";
     string_stream << "memtable_count_limit_stop[" << cf_handle->GetName()
                   << "]:" << cf_stats_map["io_stalls.memtable_compaction"] << "\r\n";
-  }
+    auto cf_options = db->GetOptions(cf_handle);
+    string_stream << "compression_per_level[" << cf_handle->GetName() << "]:";
+    for (size_t i = 0; i < cf_options.compression_per_level.size(); i++) {
+      const char *name = configEnumGetName(compression_type_enum, cf_options.compression_per_level[i]);
+      string_stream << (i > 0 ? "," : "") << (name ? name : "unknown");
+    }
+    string_stream << "\r\n";
+    string_stream << "compression_max_dict_bytes[" << cf_handle->GetName()
+                  << "]:" << cf_options.compression_opts.max_dict_bytes << "\r\n";
+    if (cf_options.enable_blob_files) {
+      uint64_t blob_files = 0, blob_size = 0, live_blob_size = 0, blob_garbage_size = 0;
+      db->GetIntProperty(cf_handle, "rocksdb.num-blob-files", &blob_files);
+      db->GetIntProperty(cf_handle, "rocksdb.total-blob-file-size", &blob_size);
+      db->GetIntProperty(cf_handle, "rocksdb.live-blob-file-size", &live_blob_size);
+      db->GetIntProperty(cf_handle, "rocksdb.live-blob-file-garbage-size", &blob_garbage_size);
+      string_stream << "blob_stats[" << cf_handle->GetName() << "]:min_blob_size=" << cf_options.min_blob_size
+                    << ",files=" << blob_files << ",size=" << blob_size << ",live_size=" << live_blob_size
+                    << ",garbage_size=" << blob_garbage_size << "\r\n";
+    }
+    auto job_stats = storage_->GetJobStats()->Get(cf_handle->GetName());
+    string_stream << "flush_stats[" << cf_handle->GetName() << "]:count=" << job_stats->flushes
+                  << ",bytes=" << job_stats->flushed_bytes << ",usec=" << job_stats->flush_duration_sum
+                  << ",p50_usec=" << job_stats->flush_duration.Percentile(50)
+                  << ",p99_usec=" << job_stats->flush_duration.Percentile(99) << "\r\n";
+    string_stream << "compaction_stats[" << cf_handle->GetName() << "]:count=" << job_stats->compactions
+                  << ",input_bytes=" << job_stats->compaction_input_bytes
+                  << ",output_bytes=" << job_stats->compaction_output_bytes
+                  << ",usec=" << job_stats->compaction_duration_sum
+                  << ",p50_usec=" << job_stats->compaction_duration.Percentile(50)
+                  << ",p99_usec=" << job_stats->compaction_duration.Percentile(99)
+                  << ",p50_input_bytes=" << job_stats->compaction_input_size.Percentile(50)
+                  << ",p99_input_bytes=" << job_stats->compaction_input_size.Percentile(99)
+                  << ",p50_output_bytes=" << job_stats->compaction_output_size.Percentile(50)
+                  << ",p99_output_bytes=" << job_stats->compaction_output_size.Percentile(99) << "\r\n";
+    string_stream << "write_amplification[" << cf_handle->GetName() << "]:" << job_stats->WriteAmplification()
+                  << "\r\n";
+    string_stream << "level0_files[" << cf_handle->GetName() << "]:current=" << job_stats->level0_files
+                  << ",p50=" << job_stats->level0_files_samples.Percentile(50)
+                  << ",p99=" << job_stats->level0_files_samples.Percentile(99)
+                  << ",max=" << job_stats->level0_files_samples.Percentile(100) << "\r\n";
+    string_stream << "write_stall_stats[" << cf_handle->GetName() << "]:delayed=" << job_stats->delayed_stalls
+                  << ",stopped=" << job_stats->stopped_stalls << ",usec=" << job_stats->stall_duration_sum
+                  << ",p50_usec=" << job_stats->stall_duration.Percentile(50)
+                  << ",p99_usec=" << job_stats->stall_duration.Percentile(99) << "\r\n";
+  }
+  string_stream << "tombstone_tracked_ranges:" << storage_->GetTombstoneTracker()->Size() << "\r\n";
+  string_stream << "tombstone_compacted_ranges:" << storage_->GetTombstoneTracker()->GetPickedRanges() << "\r\n";
   string_stream << "all_mem_tables:" << memtable_sizes << "\r\n";
   string_stream << "cur_mem_tables:" << cur_memtable_sizes << "\r\n";
+  if (auto write_buffer_manager = storage_->GetWriteBufferManager()) {
+    string_stream << "memtable_total_budget:" << write_buffer_manager->buffer_size() << "\r\n";
+    string_stream << "memtable_budget_usage:" << write_buffer_manager->memory_usage() << "\r\n";
+  }
+  if (config_->RocksDB.enable_blob_files) {
+    auto rocksdb_stats = storage_->GetDB()->GetDBOptions().statistics;
+    if (auto blob_cache = storage_->GetBlobCache()) {
+      string_stream << "blob_cache_capacity:" << blob_cache->GetCapacity() << "\r\n";
+      string_stream << "blob_cache_usage:" << blob_cache->GetUsage() << "\r\n";
+    }
+    string_stream << "blob_cache_hits:" << rocksdb_stats->getTickerCount(rocksdb::Tickers::BLOB_DB_CACHE_HIT) << "\r\n";
+    string_stream << "blob_cache_misses:" << rocksdb_stats->getTickerCount(rocksdb::Tickers::BLOB_DB_CACHE_MISS)
+                  << "\r\n";
+    string_stream << "blob_gc_relocated_keys:"
+                  << rocksdb_stats->getTickerCount(rocksdb::Tickers::BLOB_DB_GC_NUM_KEYS_RELOCATED) << "\r\n";
+    string_stream << "blob_gc_relocated_bytes:"
+                  << rocksdb_stats->getTickerCount(rocksdb::Tickers::BLOB_DB_GC_BYTES_RELOCATED) << "\r\n";
+  }
+  string_stream << "write_stall_condition:"
+                << (storage_->IsWriteStopped() ? "stop" : (storage_->IsWriteDelayed() ? "delay" : "normal")) << "\r\n";
   string_stream << "snapshots:" << num_snapshots << "\r\n";
   string_stream << "num_immutable_tables:" << num_immutable_tables << "\r\n";
   string_stream << "num_running_flushes:" << num_running_flushes << "\r\n";
@@ -756,6 +1637,7 @@ void Server::GetRocksDBInfo(std::string *info) {
   string_stream << "num_live_versions:" << num_live_versions << "\r\n";
   string_stream << "num_superversion:" << num_superversion << "\r\n";
   string_stream << "num_background_errors:" << num_backgroud_errors << "\r\n";
+  string_stream << "io_rate_limit_bytes_per_sec:" << storage_->GetIORateLimit() << "\r\n";
   string_stream << "flush_count:" << storage_->GetFlushCount() << "\r\n";
   string_stream << "compaction_count:" << storage_->GetCompactionCount() << "\r\n";
   string_stream << "put_per_sec:" << stats_.GetInstantaneousMetric(STATS_METRIC_ROCKSDB_PUT) << "\r\n";
@@ -766,8 +1648,30 @@ void Server::GetRocksDBInfo(std::string *info) {
   string_stream << "seek_per_sec:" << stats_.GetInstantaneousMetric(STATS_METRIC_ROCKSDB_SEEK) << "\r\n";
   string_stream << "next_per_sec:" << stats_.GetInstantaneousMetric(STATS_METRIC_ROCKSDB_NEXT) << "\r\n";
   string_stream << "prev_per_sec:" << stats_.GetInstantaneousMetric(STATS_METRIC_ROCKSDB_PREV) << "\r\n";
+  if (std::array<Engine::Storage::StorageTierStats, Engine::kNumStorageTiers> tier_stats;
+      storage_->GetStorageTierStats(&tier_stats)) {
+    for (const auto &[tier, name] : {std::pair{Engine::kStorageTierHot, "hot"}, {Engine::kStorageTierCold, "cold"}}) {
+      const auto &stats = tier_stats[tier];
+      string_stream << name << "_tier_size:" << stats.size << "\r\n";
+      string_stream << name << "_tier_reads:" << stats.reads << "\r\n";
+      string_stream << name << "_tier_read_avg_micros:" << (stats.reads > 0 ? stats.read_micros / stats.reads : 0)
+                    << "\r\n";
+    }
+  }
   string_stream << "is_bgsaving:" << (is_bgsave_in_progress_ ? "yes" : "no") << "\r\n";
   string_stream << "is_compacting:" << (db_compacting_ ? "yes" : "no") << "\r\n";
+  string_stream << "scheduled_compaction:" << CompactionScheduler::StateName(compaction_scheduler_.GetState())
+                << "\r\n";
+  string_stream << "scheduled_compaction_progress:" << compaction_scheduler_.GetDoneJobs() << "/"
+                << compaction_scheduler_.GetTotalJobs() << "\r\n";
+  string_stream << "scheduled_compaction_bytes:" << compaction_scheduler_.GetDoneBytes() << "/"
+                << compaction_scheduler_.GetTotalBytes() << "\r\n";
+  string_stream << "is_flush_reclaiming:" << (flush_reclaiming_ ? "yes" : "no") << "\r\n";
+  string_stream << "flush_reclaim_progress:" << flush_reclaimed_cfs_ << "/" << flush_reclaim_total_cfs_ << "\r\n";
+  auto cache_warmer = storage_->GetCacheWarmer();
+  string_stream << "is_cache_warming:" << (cache_warmer->IsWarming() ? "yes" : "no") << "\r\n";
+  string_stream << "cache_warmup_progress:" << cache_warmer->GetWarmedKeys() << "/" << cache_warmer->GetTotalKeys()
+                << "\r\n";
   *info = string_stream.str();
 }
 
@@ -806,10 +1710,35 @@ void Server::GetClientsInfo(std::string *info) {
   string_stream << "maxclients:" << config_->maxclients << "\r\n";
   string_stream << "connected_clients:" << connected_clients_ << "\r\n";
   string_stream << "monitor_clients:" << monitor_clients_ << "\r\n";
+  string_stream << "monitor_dropped_entries:" << monitor_dropped_entries_ << "\r\n";
   string_stream << "blocked_clients:" << blocked_clients_ << "\r\n";
+  string_stream << "tracking_clients:" << client_tracking_.ClientsNum() << "\r\n";
+  string_stream << "tracking_total_keys:" << client_tracking_.KeysNum() << "\r\n";
+  string_stream << "tracking_evicted_keys:" << client_tracking_.EvictedKeys() << "\r\n";
+  std::shared_lock<std::shared_mutex> guard(worker_threads_mu_);
+  for (size_t i = 0; i < worker_threads_.size(); i++) {
+    string_stream << "worker" << i << ":" << worker_threads_[i]->GetWorker()->GetConnectionsStats() << "\r\n";
+  }
   *info = string_stream.str();
 }
 
+// The counters of the huge pages of the system in /proc/meminfo, e.g. "HugePages_Free:  512",
+// the AnonHugePages is in kB
+static std::map<std::string, uint64_t> getHugePagesInfo() {
+  std::map<std::string, uint64_t> counters;
+  std::ifstream meminfo("/proc/meminfo");
+  std::string name;
+  uint64_t value = 0;
+  while (meminfo >> name >> value) {
+    if (name.rfind("HugePages_", 0) == 0 || name == "AnonHugePages:") {
+      name.pop_back();
+      counters[name] = value;
+    }
+    meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return counters;
+}
+
 void Server::GetMemoryInfo(std::string *info) {
   std::ostringstream string_stream;
   char used_memory_rss_human[16], used_memory_lua_human[16];
@@ -823,9 +1752,163 @@ void Server::GetMemoryInfo(std::string *info) {
   string_stream << "used_memory_lua:" << memory_lua << "\r\n";
   string_stream << "used_memory_lua_human:" << used_memory_lua_human << "\r\n";
   string_stream << "used_memory_startup:" << memory_startup_use_ << "\r\n";
+  auto allocator = storage_->GetBlockCacheAllocator();
+  string_stream << "block_cache_huge_pages_enabled:" << (allocator ? 1 : 0) << "\r\n";
+  string_stream << "block_cache_huge_page_bytes:" << (allocator ? allocator->GetHugePageBytes() : 0) << "\r\n";
+  string_stream << "block_cache_fallback_page_bytes:" << (allocator ? allocator->GetFallbackBytes() : 0) << "\r\n";
+  auto huge_pages = getHugePagesInfo();
+  string_stream << "huge_pages_total:" << huge_pages["HugePages_Total"] << "\r\n";
+  string_stream << "huge_pages_free:" << huge_pages["HugePages_Free"] << "\r\n";
+  string_stream << "huge_pages_reserved:" << huge_pages["HugePages_Rsvd"] << "\r\n";
+  string_stream << "anon_huge_pages_bytes:" << huge_pages["AnonHugePages"] * 1024 << "\r\n";
   *info = string_stream.str();
 }
 
+// The approximate memory of the registry of the keys to the containers of the subscribers or waiters,
+// including the nodes of the tree and the containers, it's counted for MEMORY STATS.
+template <typename Registry>
+static uint64_t registryMemory(const Registry &registry) {
+  constexpr size_t kNodeOverhead = 4 * sizeof(void *);  // the links of the node of a tree or a list
+  uint64_t bytes = 0;
+  for (const auto &[key, container] : registry) {
+    bytes += kNodeOverhead + sizeof(typename Registry::value_type);
+    if (key.capacity() >= sizeof(std::string)) bytes += key.capacity() + 1;
+    bytes += container.size() * (kNodeOverhead + sizeof(typename Registry::mapped_type::value_type));
+  }
+  return bytes;
+}
+
+void Server::GetMemoryStats(std::vector<MemoryStat> *stats) {
+  auto add = [stats](std::string name, std::variant<uint64_t, double> value) {
+    stats->emplace_back(MemoryStat{std::move(name), value});
+  };
+  add("rss", static_cast<uint64_t>(Stats::GetMemoryRSS()));
+  add("startup", static_cast<uint64_t>(memory_startup_use_));
+
+  // The block caches may be shared by the column families, so the totals only count every cache once
+  rocksdb::DB *db = storage_->GetDB();
+  std::set<rocksdb::Cache *> block_caches;
+  uint64_t block_cache_usage = 0, block_cache_pinned_usage = 0, memtables = 0, table_readers = 0;
+  for (const auto &cf_handle : storage_->GetAllCFHandles()) {
+    uint64_t usage = 0, pinned_usage = 0, memtable = 0, table_reader = 0;
+    db->GetIntProperty(cf_handle, "rocksdb.block-cache-usage", &usage);
+    db->GetIntProperty(cf_handle, "rocksdb.block-cache-pinned-usage", &pinned_usage);
+    db->GetIntProperty(cf_handle, "rocksdb.cur-size-all-mem-tables", &memtable);
+    db->GetIntProperty(cf_handle, "rocksdb.estimate-table-readers-mem", &table_reader);
+    const auto &name = cf_handle->GetName();
+    add("rocksdb.block-cache.usage[" + name + "]", usage);
+    add("rocksdb.block-cache.pinned-usage[" + name + "]", pinned_usage);
+    add("rocksdb.memtables[" + name + "]", memtable);
+    add("rocksdb.table-readers[" + name + "]", table_reader);
+    memtables += memtable;
+    table_readers += table_reader;
+
+    auto table_factory = db->GetOptions(cf_handle).table_factory;
+    auto table_options = table_factory ? table_factory->GetOptions<rocksdb::BlockBasedTableOptions>() : nullptr;
+    if (table_options && table_options->block_cache && block_caches.insert(table_options->block_cache.get()).second) {
+      block_cache_usage += usage;
+      block_cache_pinned_usage += pinned_usage;
+    }
+  }
+  add("rocksdb.block-cache.usage", block_cache_usage);
+  add("rocksdb.block-cache.pinned-usage", block_cache_pinned_usage);
+  add("rocksdb.memtables", memtables);
+  add("rocksdb.table-readers", table_readers);
+  add("metadata-cache", static_cast<uint64_t>(storage_->GetMetadataCache()->GetUsage()));
+
+  size_t total_connections = 0, total_input_bytes = 0, total_output_bytes = 0;
+  {
+    std::shared_lock<std::shared_mutex> guard(worker_threads_mu_);
+    for (size_t i = 0; i < worker_threads_.size(); i++) {
+      auto worker = worker_threads_[i]->GetWorker();
+      size_t connections = 0, input_bytes = 0, output_bytes = 0;
+      worker->GetConnectionsMemory(&connections, &input_bytes, &output_bytes);
+      auto prefix = "worker." + std::to_string(i) + ".";
+      add(prefix + "clients", static_cast<uint64_t>(connections));
+      add(prefix + "input-buffers", static_cast<uint64_t>(input_bytes));
+      add(prefix + "output-buffers", static_cast<uint64_t>(output_bytes));
+      add(prefix + "lua", static_cast<uint64_t>(worker->GetLuaMemory()));
+      total_connections += connections;
+      total_input_bytes += input_bytes;
+      total_output_bytes += output_bytes;
+    }
+  }
+  add("clients", static_cast<uint64_t>(total_connections));
+  add("clients.input-buffers", static_cast<uint64_t>(total_input_bytes));
+  add("clients.output-buffers", static_cast<uint64_t>(total_output_bytes));
+
+  // The Lua state of the server is only used exclusively, so it's safe to read it here
+  add("lua.server", static_cast<uint64_t>(lua_gc(lua_, LUA_GCCOUNT, 0)) * 1024);
+  for (size_t i = 0; i < readonly_script_states_.size(); i++) {
+    add("lua.readonly." + std::to_string(i), static_cast<uint64_t>(readonly_script_memory_[i].load()));
+  }
+
+  uint64_t pubsub_channels = 0, pubsub_bytes = 0;
+  for (auto &shard : pubsub_channel_shards_) {
+    std::lock_guard<std::mutex> guard(shard.mu);
+    pubsub_channels += shard.channels.size() + shard.shard_channels.size();
+    pubsub_bytes += registryMemory(shard.channels) + registryMemory(shard.shard_channels);
+  }
+  {
+    std::lock_guard<std::mutex> guard(pubsub_patterns_mu_);
+    add("pubsub.patterns", static_cast<uint64_t>(pubsub_patterns_.size()));
+    pubsub_bytes += registryMemory(pubsub_patterns_);
+  }
+  add("pubsub.channels", pubsub_channels);
+  add("pubsub.bytes", pubsub_bytes);
+
+  uint64_t blocking_keys = 0, blocking_bytes = 0;
+  for (auto &shard : blocking_key_shards_) {
+    std::lock_guard<std::mutex> guard(shard.mu);
+    blocking_keys += shard.keys.size() + shard.stream_consumers.size();
+    blocking_bytes += registryMemory(shard.keys) + registryMemory(shard.stream_consumers);
+  }
+  add("blocking.keys", blocking_keys);
+  add("blocking.bytes", blocking_bytes);
+  {
+    std::lock_guard<std::mutex> guard(watched_keys_mu_);
+    add("watched-keys.bytes", registryMemory(watched_keys_));
+  }
+
+  uint64_t replica_output_bytes = 0, backlog_bytes = 0;
+  {
+    std::lock_guard<std::mutex> guard(slave_threads_mu_);
+    for (const auto &slave : slave_threads_) {
+      if (slave->IsStopped()) continue;
+      replica_output_bytes += slave->GetOutputBytes();
+    }
+    if (repl_backlog_) backlog_bytes = repl_backlog_->Bytes();
+  }
+  add("replication.backlog", backlog_bytes);
+  add("replication.replica-output-buffers", replica_output_bytes);
+  uint64_t pending_apply_bytes = 0;
+  if (IsSlave() && replication_thread_) pending_apply_bytes = replication_thread_->PendingApplyBytes();
+  add("replication.pending-apply", pending_apply_bytes);
+
+#ifdef ENABLE_JEMALLOC
+  // Refresh the cached stats of jemalloc first
+  uint64_t epoch = 1;
+  size_t epoch_size = sizeof(epoch);
+  mallctl("epoch", &epoch, &epoch_size, &epoch, epoch_size);
+  size_t allocated = 0, active = 0, resident = 0, mapped = 0, retained = 0, metadata = 0;
+  std::pair<const char *, size_t *> allocator_stats[] = {
+      {"stats.allocated", &allocated}, {"stats.active", &active},     {"stats.resident", &resident},
+      {"stats.mapped", &mapped},       {"stats.retained", &retained}, {"stats.metadata", &metadata},
+  };
+  for (const auto &[name, value] : allocator_stats) {
+    size_t value_size = sizeof(size_t);
+    mallctl(name, value, &value_size, nullptr, 0);
+    add(std::string("allocator.") + (name + strlen("stats.")), static_cast<uint64_t>(*value));
+  }
+  // The fragmentation is the unused memory in the active pages, and the RSS overhead is the
+  // memory which is resident but neither active nor allocated, e.g. the dirty pages not purged yet
+  add("allocator.fragmentation.ratio", allocated ? static_cast<double>(active) / static_cast<double>(allocated) : 0);
+  add("allocator.fragmentation.bytes", static_cast<uint64_t>(active > allocated ? active - allocated : 0));
+  add("allocator.rss.ratio", active ? static_cast<double>(resident) / static_cast<double>(active) : 0);
+  add("allocator.rss.bytes", static_cast<uint64_t>(resident > active ? resident - active : 0));
+#endif
+}
+
 void Server::GetReplicationInfo(std::string *info) {
   time_t now = 0;
   std::ostringstream string_stream;
@@ -841,6 +1924,12 @@ void Server::GetReplicationInfo(std::string *info) {
     string_stream << "master_sync_in_progress:" << (state == kReplFetchMeta || state == kReplFetchSST) << "\r\n";
     string_stream << "master_last_io_seconds_ago:" << now - replication_thread_->LastIOTime() << "\r\n";
     string_stream << "slave_repl_offset:" << storage_->LatestSeq() << "\r\n";
+    auto received_seq = replication_thread_->ReceivedSeq();
+    auto applied_seq = storage_->LatestSeq() + 1;
+    string_stream << "slave_apply_pending_batches:" << replication_thread_->PendingApplyBatches() << "\r\n";
+    string_stream << "slave_apply_pending_bytes:" << replication_thread_->PendingApplyBytes() << "\r\n";
+    string_stream << "slave_apply_lag:" << (received_seq > applied_seq ? received_seq - applied_seq : 0) << "\r\n";
+    string_stream << "slave_lag_ms:" << replication_thread_->LagMS() << "\r\n";
     string_stream << "slave_priority:" << config_->slave_priority << "\r\n";
   }
 
@@ -853,10 +1942,33 @@ void Server::GetReplicationInfo(std::string *info) {
     string_stream << "slave" << std::to_string(idx) << ":";
     string_stream << "ip=" << slave->GetConn()->GetIP() << ",port=" << slave->GetConn()->GetListeningPort()
                   << ",offset=" << slave->GetCurrentReplSeq() << ",lag=" << latest_seq - slave->GetCurrentReplSeq()
-                  << "\r\n";
+                  << ",compression=" << (slave->IsCompressed() ? "zstd" : "no") << ",raw_bytes=" << slave->GetRawBytes()
+                  << ",sent_bytes=" << slave->GetSentBytes() << ",ack_offset=" << slave->GetAckSeq() << "\r\n";
     ++idx;
   }
+  string_stream << "repl_backlog_active:" << (repl_backlog_ ? 1 : 0) << "\r\n";
+  if (repl_backlog_) {
+    string_stream << "repl_backlog_first_seq:" << repl_backlog_->FirstSeq() << "\r\n";
+    string_stream << "repl_backlog_batches:" << repl_backlog_->Batches() << "\r\n";
+    string_stream << "repl_backlog_bytes:" << repl_backlog_->Bytes() << "\r\n";
+  }
   slave_threads_mu_.unlock();
+  {
+    std::lock_guard<std::mutex> lg(cdc_threads_mu_);
+    string_stream << "cdc_subscribers:" << cdc_threads_.size() << "\r\n";
+    idx = 0;
+    for (const auto &cdc : cdc_threads_) {
+      if (cdc->IsStopped()) continue;
+      string_stream << "cdc_subscriber" << idx << ":addr=" << cdc->GetConn()->GetAddr()
+                    << ",offset=" << cdc->GetCurrentSeq() << ",lag=" << latest_seq - cdc->GetCurrentSeq()
+                    << ",sent_bytes=" << cdc->GetSentBytes() << "\r\n";
+      ++idx;
+    }
+  }
+  if (config_->wal_retention_by_replicas) {
+    string_stream << "wal_retained_seq:" << wal_retained_seq_ << "\r\n";
+  }
+  string_stream << "master_replid:" << storage_->GetReplId() << "\r\n";
   string_stream << "master_repl_offset:" << latest_seq << "\r\n";
 
   *info = string_stream.str();
@@ -926,7 +2038,7 @@ void Server::GetStatsInfo(std::string *info) {
   std::ostringstream string_stream;
   string_stream << "# Stats\r\n";
   string_stream << "total_connections_received:" << total_clients_ << "\r\n";
-  string_stream << "total_commands_processed:" << stats_.total_calls << "\r\n";
+  string_stream << "total_commands_processed:" << stats_.GetTotalCalls() << "\r\n";
   string_stream << "instantaneous_ops_per_sec:" << stats_.GetInstantaneousMetric(STATS_METRIC_COMMAND) << "\r\n";
   string_stream << "total_net_input_bytes:" << stats_.in_bytes << "\r\n";
   string_stream << "total_net_output_bytes:" << stats_.out_bytes << "\r\n";
@@ -937,10 +2049,51 @@ void Server::GetStatsInfo(std::string *info) {
   string_stream << "sync_full:" << stats_.fullsync_counter << "\r\n";
   string_stream << "sync_partial_ok:" << stats_.psync_ok_counter << "\r\n";
   string_stream << "sync_partial_err:" << stats_.psync_err_counter << "\r\n";
-  {
-    std::lock_guard<std::mutex> lg(pubsub_channels_mu_);
-    string_stream << "pubsub_channels:" << pubsub_channels_.size() << "\r\n";
-    string_stream << "pubsub_patterns:" << pubsub_patterns_.size() << "\r\n";
+  auto metadata_cache = storage_->GetMetadataCache();
+  string_stream << "metadata_cache_hits:" << metadata_cache->GetHits() << "\r\n";
+  string_stream << "metadata_cache_misses:" << metadata_cache->GetMisses() << "\r\n";
+  string_stream << "metadata_cache_used_bytes:" << metadata_cache->GetUsage() << "\r\n";
+  auto scan_iterator_cache = storage_->GetScanIteratorCache();
+  string_stream << "scan_iterator_cache_hits:" << scan_iterator_cache->GetHits() << "\r\n";
+  string_stream << "scan_iterator_cache_misses:" << scan_iterator_cache->GetMisses() << "\r\n";
+  string_stream << "scan_iterator_cache_size:" << scan_iterator_cache->Size() << "\r\n";
+  auto lock_mgr = storage_->GetLockManager();
+  string_stream << "lock_table_size:" << lock_mgr->Size() << "\r\n";
+  string_stream << "lock_waits:" << lock_mgr->GetWaits() << "\r\n";
+  string_stream << "lock_wait_usec:" << lock_mgr->GetWaitUS() << "\r\n";
+  string_stream << "workload_tunings:" << storage_->GetWorkloadTuner()->GetTunings() << "\r\n";
+  string_stream << "script_cache_hits:" << stats_.script_cache_hits << "\r\n";
+  string_stream << "script_cache_misses:" << stats_.script_cache_misses << "\r\n";
+  string_stream << "script_compiles:" << stats_.script_compiles << "\r\n";
+  string_stream << "script_compile_time_usec:" << stats_.script_compile_time << "\r\n";
+  string_stream << "migrate_forbidden_slots:" << stats_.migrate_forbidden_slots << "\r\n";
+  string_stream << "migrate_forbidden_time_usec:" << stats_.migrate_forbidden_time << "\r\n";
+  string_stream << "migrate_last_forbidden_time_usec:" << stats_.migrate_last_forbidden_time << "\r\n";
+  string_stream << "write_stall_rejected_cmds:" << stats_.write_stall_rejected_cmds << "\r\n";
+  string_stream << "cache_missed_offloaded_cmds:" << stats_.cache_missed_offloaded_cmds << "\r\n";
+  string_stream << "coalesced_cmds:" << stats_.coalesced_cmds << "\r\n";
+  string_stream << "import_batched_restores:" << stats_.import_batched_restores << "\r\n";
+  auto key_reclaimer = storage_->GetKeyReclaimer();
+  string_stream << "lazy_reclaimed_keys:" << key_reclaimer->GetReclaimedKeys() << "\r\n";
+  string_stream << "lazy_reclaim_pending_keys:" << key_reclaimer->GetPendingKeys() << "\r\n";
+  auto lazy_expirer = storage_->GetLazyExpirer();
+  string_stream << "lazy_expired_keys:" << lazy_expirer->GetExpiredKeys() << "\r\n";
+  string_stream << "lazy_expire_pending_keys:" << lazy_expirer->GetPendingKeys() << "\r\n";
+  string_stream << "active_expired_keys:" << expire_reaper_.GetExpiredKeys() << "\r\n";
+  string_stream << "active_expire_scanned_entries:" << expire_reaper_.GetScannedEntries() << "\r\n";
+  string_stream << "active_expire_last_timestamp:" << expire_reaper_.GetLastExpireTimestamp() << "\r\n";
+  size_t pubsub_channels = 0, pubsub_shard_channels = 0;
+  for (auto &shard : pubsub_channel_shards_) {
+    std::lock_guard<std::mutex> lg(shard.mu);
+    pubsub_channels += shard.channels.size();
+    pubsub_shard_channels += shard.shard_channels.size();
+  }
+  string_stream << "pubsub_channels:" << pubsub_channels << "\r\n";
+  string_stream << "pubsub_patterns:" << GetPubSubPatternSize() << "\r\n";
+  string_stream << "pubsub_shardchannels:" << pubsub_shard_channels << "\r\n";
+  for (const auto &[ns, qos_stats] : namespace_qos_.GetStats()) {
+    string_stream << "namespace_qos." << ns << ":allowed_cmds=" << qos_stats.allowed_cmds
+                  << ",throttled_cmds=" << qos_stats.throttled_cmds << "\r\n";
   }
   *info = string_stream.str();
 }
@@ -949,16 +2102,88 @@ void Server::GetCommandsStatsInfo(std::string *info) {
   std::ostringstream string_stream;
   string_stream << "# Commandstats\r\n";
 
-  for (const auto &cmd_stat : stats_.commands_stats) {
-    auto calls = cmd_stat.second.calls.load();
-    auto latency = cmd_stat.second.latency.load();
+  for (const auto &iter : *Redis::GetOriginalCommands()) {
+    command_stat cmd_stat;
+    stats_.GetCommandStat(iter.second->id, &cmd_stat);
+    auto calls = cmd_stat.calls.load();
+    auto latency = cmd_stat.latency.load();
     if (calls == 0) continue;
-    string_stream << "cmdstat_" << cmd_stat.first << ":calls=" << calls << ",usec=" << latency
-                  << ",usec_per_call=" << ((calls == 0) ? 0 : static_cast<float>(latency / calls)) << "\r\n";
+    string_stream << "cmdstat_" << iter.first << ":calls=" << calls << ",usec=" << latency
+                  << ",usec_per_call=" << ((calls == 0) ? 0 : static_cast<float>(latency / calls))
+                  << ",p50=" << cmd_stat.histogram.Percentile(50) << ",p99=" << cmd_stat.histogram.Percentile(99)
+                  << ",p999=" << cmd_stat.histogram.Percentile(99.9) << "\r\n";
+  }
+  *info = string_stream.str();
+}
+
+void Server::GetPerfStatsInfo(std::string *info) {
+  std::ostringstream string_stream;
+  string_stream << "# Perfstats\r\n";
+
+  for (const auto &iter : *Redis::GetOriginalCommands()) {
+    PerfSample sums;
+    auto samples = stats_.GetPerfStat(iter.second->id, &sums);
+    if (samples == 0) continue;
+    string_stream << "perfstat_" << iter.first << ":samples=" << samples;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+      auto value = static_cast<double>(sums[i]) / static_cast<double>(samples);
+      // The timers of the perf context are in nanoseconds
+      if (i == PERF_GET_FROM_MEMTABLE_NANOS || i == PERF_WRITE_WAL_NANOS) value /= 1000;
+      string_stream << "," << PerfCounterName(i) << "_per_call=" << value;
+    }
+    string_stream << "\r\n";
+  }
+  *info = string_stream.str();
+}
+
+void Server::GetTaskStatsInfo(std::string *info) {
+  std::ostringstream string_stream;
+  string_stream << "# Taskstats\r\n";
+  string_stream << "pending_tasks:" << task_runner_.QueueSize() << "\r\n";
+  for (const auto &iter : task_runner_.GetStats()) {
+    const auto &stats = iter.second;
+    string_stream << "taskstat_" << iter.first << ":calls=" << stats.calls << ",cancelled=" << stats.cancelled
+                  << ",wait_usec=" << stats.wait_us << ",wait_usec_per_call="
+                  << (stats.calls == 0 ? 0 : stats.wait_us / stats.calls) << ",max_wait_usec=" << stats.max_wait_us
+                  << ",run_usec=" << stats.run_us << ",run_usec_per_call="
+                  << (stats.calls == 0 ? 0 : stats.run_us / stats.calls) << ",max_run_usec=" << stats.max_run_us
+                  << "\r\n";
   }
   *info = string_stream.str();
 }
 
+void Server::GetHotKeys(const std::string &ns, size_t count, std::vector<HotKey> *hot_keys) {
+  uint64_t now_ms = Util::GetTimeStampMS();
+  // The same key may be accessed from the connections of all workers
+  std::unordered_map<std::string, HotKey> merged;
+  std::shared_lock<std::shared_mutex> guard(worker_threads_mu_);
+  for (const auto &worker_thread : worker_threads_) {
+    for (auto &hot_key : worker_thread->GetWorker()->GetHotKeys()->GetKeys(ns, now_ms)) {
+      auto &merged_key = merged[hot_key.key];
+      if (merged_key.key.empty()) {
+        merged_key.ns = std::move(hot_key.ns);
+        merged_key.key = std::move(hot_key.key);
+      }
+      merged_key.reads += hot_key.reads;
+      merged_key.writes += hot_key.writes;
+    }
+  }
+
+  hot_keys->clear();
+  hot_keys->reserve(merged.size());
+  // The counts are of the sampled commands, scale them to estimate the accesses
+  uint64_t interval = std::max(config_->hotkeys_sample_interval, 1);
+  for (auto &iter : merged) {
+    iter.second.reads *= interval;
+    iter.second.writes *= interval;
+    hot_keys->emplace_back(std::move(iter.second));
+  }
+  std::sort(hot_keys->begin(), hot_keys->end(), [](const HotKey &a, const HotKey &b) {
+    return a.reads + a.writes > b.reads + b.writes || (a.reads + a.writes == b.reads + b.writes && a.key < b.key);
+  });
+  if (hot_keys->size() > count) hot_keys->resize(count);
+}
+
 // WARNING: we must not access DB(i.e.RocksDB) when server is loading since
 // DB is closed and the pointer is invalid. Server may crash if we access DB
 // during loading.
@@ -993,6 +2218,12 @@ void Server::GetInfo(const std::string &ns, const std::string &section, std::str
     string_stream << "last_bgsave_time:" << last_bgsave_time_ << "\r\n";
     string_stream << "last_bgsave_status:" << last_bgsave_status_ << "\r\n";
     string_stream << "last_bgsave_time_sec:" << last_bgsave_time_sec_ << "\r\n";
+    int64_t copied_bytes = storage_->GetLastBackupCopiedBytes();
+    string_stream << "last_bgsave_size:" << storage_->GetLastBackupSize() << "\r\n";
+    string_stream << "last_bgsave_copied_bytes:" << copied_bytes << "\r\n";
+    string_stream << "last_bgsave_copy_bytes_per_sec:"
+                  << (copied_bytes >= 0 && last_bgsave_time_sec_ > 0 ? copied_bytes / last_bgsave_time_sec_ : -1)
+                  << "\r\n";
   }
   if (all || section == "stats") {
     std::string stats_info;
@@ -1024,11 +2255,23 @@ void Server::GetInfo(const std::string &ns, const std::string &section, std::str
     GetCommandsStatsInfo(&commands_stats_info);
     string_stream << commands_stats_info;
   }
+  if (all || section == "taskstats") {
+    std::string task_stats_info;
+    GetTaskStatsInfo(&task_stats_info);
+    string_stream << task_stats_info;
+  }
+  if (all || section == "perfstats") {
+    std::string perf_stats_info;
+    GetPerfStatsInfo(&perf_stats_info);
+    string_stream << perf_stats_info;
+  }
 
   // In keyspace section, we access DB, so we can't do that when loading
   if (!is_loading_ && (all || section == "keyspace")) {
     KeyNumStats stats;
     GetLastestKeyNumStats(ns, &stats);
+    auto key_counter = storage_->GetKeyCounter();
+    if (config_->key_count_tracking && key_counter->Ready()) stats.n_key = key_counter->GetKeys(ns);
     time_t last_scan_time = GetLastScanTime(ns);
     string_stream << "# Keyspace\r\n";
     string_stream << "# Last scan db time: " << std::asctime(std::localtime(&last_scan_time));
@@ -1037,6 +2280,12 @@ void Server::GetInfo(const std::string &ns, const std::string &section, std::str
     string_stream << "sequence:" << storage_->GetDB()->GetLatestSequenceNumber() << "\r\n";
     string_stream << "used_db_size:" << storage_->GetTotalSize(ns) << "\r\n";
     string_stream << "max_db_size:" << config_->max_db_size * GiB << "\r\n";
+    if (uint64_t quota = config_->GetNamespaceDiskQuota(ns); quota > 0) {
+      auto namespace_sizes = storage_->GetNamespaceSizes();
+      string_stream << "namespace_disk_quota:" << quota << "\r\n";
+      string_stream << "namespace_estimated_size:" << namespace_sizes->GetSize(ns) << "\r\n";
+      string_stream << "namespace_over_quota:" << (namespace_sizes->IsOverQuota(ns) ? 1 : 0) << "\r\n";
+    }
     double used_percent = config_->max_db_size ? storage_->GetTotalSize() * 100 / (config_->max_db_size * GiB) : 0;
     string_stream << "used_percent: " << used_percent << "%\r\n";
     struct statvfs stat;
@@ -1081,6 +2330,201 @@ std::string Server::GetRocksDBStatsJson() {
   return output;
 }
 
+std::string Server::GetPrometheusMetrics() {
+  PrometheusWriter writer;
+
+  writer.Family("kvrocks_uptime_seconds", "gauge", "The seconds since the server was started");
+  writer.Sample("kvrocks_uptime_seconds", static_cast<uint64_t>(GetUnixTime() - start_time_));
+  writer.Family("kvrocks_connected_clients", "gauge", "The number of the connected clients");
+  writer.Sample("kvrocks_connected_clients", static_cast<uint64_t>(connected_clients_.load()));
+  writer.Family("kvrocks_connections_received_total", "counter", "The number of the accepted connections");
+  writer.Sample("kvrocks_connections_received_total", total_clients_.load());
+  writer.Family("kvrocks_net_input_bytes_total", "counter", "The bytes read from the network");
+  writer.Sample("kvrocks_net_input_bytes_total", stats_.in_bytes.load());
+  writer.Family("kvrocks_net_output_bytes_total", "counter", "The bytes written to the network");
+  writer.Sample("kvrocks_net_output_bytes_total", stats_.out_bytes.load());
+  writer.Family("kvrocks_commands_total", "counter", "The number of the executed commands");
+  writer.Sample("kvrocks_commands_total", stats_.GetTotalCalls());
+  writer.Family("kvrocks_write_stall_rejected_commands_total", "counter",
+                "The write commands rejected since the writes were stopped by RocksDB");
+  writer.Sample("kvrocks_write_stall_rejected_commands_total", stats_.write_stall_rejected_cmds.load());
+  writer.Family("kvrocks_cache_missed_offloaded_commands_total", "counter",
+                "The read commands offloaded since they would read the disk");
+  writer.Sample("kvrocks_cache_missed_offloaded_commands_total", stats_.cache_missed_offloaded_cmds.load());
+  writer.Family("kvrocks_coalesced_commands_total", "counter", "The read commands replied by the coalesced replies");
+  writer.Sample("kvrocks_coalesced_commands_total", stats_.coalesced_cmds.load());
+  writer.Family("kvrocks_import_batched_restores_total", "counter",
+                "The RESTOREs of the importing connections written in batches");
+  writer.Sample("kvrocks_import_batched_restores_total", stats_.import_batched_restores.load());
+
+  // The samples of a family must be together, so the stats of the commands are collected first
+  std::vector<std::pair<std::string, std::unique_ptr<command_stat>>> cmd_stats;
+  for (const auto &iter : *Redis::GetOriginalCommands()) {
+    auto cmd_stat = std::make_unique<command_stat>();
+    stats_.GetCommandStat(iter.second->id, cmd_stat.get());
+    if (cmd_stat->calls.load() == 0) continue;
+    cmd_stats.emplace_back(iter.first, std::move(cmd_stat));
+  }
+  writer.Family("kvrocks_command_calls_total", "counter", "The calls of the command");
+  for (const auto &[name, cmd_stat] : cmd_stats) {
+    writer.Sample("kvrocks_command_calls_total", {{"cmd", name}}, cmd_stat->calls.load());
+  }
+  writer.Family("kvrocks_command_duration_seconds", "histogram", "The latencies of the command");
+  for (const auto &[name, cmd_stat] : cmd_stats) {
+    writer.Histogram("kvrocks_command_duration_seconds", {{"cmd", name}}, cmd_stat->histogram,
+                     cmd_stat->latency.load());
+  }
+
+  // The replication state is skipped rather than waited for while the master is being changed
+  {
+    std::unique_lock<std::mutex> guard(slaveof_mu_, std::try_to_lock);
+    if (guard.owns_lock()) {
+      writer.Family("kvrocks_is_slave", "gauge", "Whether the server is a replica");
+      writer.Sample("kvrocks_is_slave", static_cast<uint64_t>(IsSlave()));
+      if (IsSlave() && replication_thread_) {
+        writer.Family("kvrocks_master_link_up", "gauge", "Whether the replica is connected to its master");
+        writer.Sample("kvrocks_master_link_up", static_cast<uint64_t>(GetReplicationState() == kReplConnected));
+        writer.Family("kvrocks_slave_lag_seconds", "gauge", "The replication lag of the replica, -1 if unknown");
+        auto lag_ms = replication_thread_->LagMS();
+        writer.Sample("kvrocks_slave_lag_seconds", lag_ms < 0 ? -1.0 : static_cast<double>(lag_ms) / 1000);
+        writer.Family("kvrocks_slave_apply_pending_bytes", "gauge", "The received bytes not applied yet");
+        writer.Sample("kvrocks_slave_apply_pending_bytes",
+                      static_cast<uint64_t>(replication_thread_->PendingApplyBytes()));
+      }
+    }
+  }
+  {
+    std::unique_lock<std::mutex> guard(slave_threads_mu_, std::try_to_lock);
+    if (guard.owns_lock()) {
+      writer.Family("kvrocks_connected_slaves", "gauge", "The number of the connected replicas");
+      writer.Sample("kvrocks_connected_slaves", static_cast<uint64_t>(slave_threads_.size()));
+    }
+  }
+
+  // The DB properties are skipped rather than waited for while the DB is being closed or restored
+  auto db_guard = storage_->TryReadLockGuard();
+  if (!db_guard || storage_->IsClosing()) return writer.Output();
+
+  rocksdb::SequenceNumber latest_seq = storage_->LatestSeq();
+  writer.Family("kvrocks_repl_offset", "gauge", "The latest sequence number of the DB");
+  writer.Sample("kvrocks_repl_offset", static_cast<uint64_t>(latest_seq));
+  {
+    std::unique_lock<std::mutex> guard(slave_threads_mu_, std::try_to_lock);
+    if (guard.owns_lock()) {
+      writer.Family("kvrocks_slave_lag_sequences", "gauge", "The sequence numbers not replicated to the replica yet");
+      for (const auto &slave : slave_threads_) {
+        if (slave->IsStopped()) continue;
+        auto seq = slave->GetCurrentReplSeq();
+        auto addr = slave->GetConn()->GetIP() + ":" + std::to_string(slave->GetConn()->GetListeningPort());
+        writer.Sample("kvrocks_slave_lag_sequences", {{"slave", addr}},
+                      static_cast<uint64_t>(latest_seq > seq ? latest_seq - seq : 0));
+      }
+    }
+  }
+
+  rocksdb::DB *db = storage_->GetDB();
+  auto cf_handles = storage_->GetAllCFHandles();
+  std::pair<const char *, const char *> cf_properties[] = {
+      {"rocksdb.cur-size-all-mem-tables", "kvrocks_rocksdb_memtable_bytes"},
+      {"rocksdb.size-all-mem-tables", "kvrocks_rocksdb_all_memtables_bytes"},
+      {"rocksdb.block-cache-usage", "kvrocks_rocksdb_block_cache_usage_bytes"},
+      {"rocksdb.block-cache-pinned-usage", "kvrocks_rocksdb_block_cache_pinned_usage_bytes"},
+      {"rocksdb.estimate-table-readers-mem", "kvrocks_rocksdb_table_readers_mem_bytes"},
+      {"rocksdb.estimate-num-keys", "kvrocks_rocksdb_estimate_num_keys"},
+  };
+  for (const auto &[property, name] : cf_properties) {
+    writer.Family(name, "gauge", std::string("The property ") + property + " of the column family");
+    for (const auto &cf_handle : cf_handles) {
+      uint64_t value = 0;
+      if (!db->GetIntProperty(cf_handle, property, &value)) continue;
+      writer.Sample(name, {{"cf", cf_handle->GetName()}}, value);
+    }
+  }
+
+  auto job_stats = storage_->GetJobStats();
+  using JobHistogram = LatencyHistogram ColumnFamilyJobStats::*;
+  using JobDurationSum = std::atomic<uint64_t> ColumnFamilyJobStats::*;
+  std::tuple<const char *, const char *, JobHistogram, JobDurationSum> job_histograms[] = {
+      {"kvrocks_flush_duration_seconds", "The durations of the flushes", &ColumnFamilyJobStats::flush_duration,
+       &ColumnFamilyJobStats::flush_duration_sum},
+      {"kvrocks_compaction_duration_seconds", "The durations of the compactions",
+       &ColumnFamilyJobStats::compaction_duration, &ColumnFamilyJobStats::compaction_duration_sum},
+      {"kvrocks_write_stall_duration_seconds", "The durations of the write stalls",
+       &ColumnFamilyJobStats::stall_duration, &ColumnFamilyJobStats::stall_duration_sum},
+  };
+  for (const auto &[name, help, histogram, sum] : job_histograms) {
+    writer.Family(name, "histogram", help);
+    for (const auto &cf_name : job_stats->GetColumnFamilies()) {
+      auto cf_job_stats = job_stats->Get(cf_name);
+      writer.Histogram(name, {{"cf", cf_name}}, cf_job_stats->*histogram, (cf_job_stats->*sum).load());
+    }
+  }
+  std::pair<const char *, const char *> job_counters[] = {
+      {"kvrocks_flushed_bytes_total", "The bytes of the SST files written by the flushes"},
+      {"kvrocks_compaction_input_bytes_total", "The bytes read by the compactions"},
+      {"kvrocks_compaction_output_bytes_total", "The bytes written by the compactions"},
+      {"kvrocks_write_stalls_total", "The number of the write stalls by whether the writes were stopped"},
+  };
+  for (const auto &[name, help] : job_counters) writer.Family(name, "counter", help);
+  writer.Family("kvrocks_write_amplification", "gauge", "The bytes written to the SST files per flushed byte");
+  writer.Family("kvrocks_level0_files", "gauge", "The number of the L0 files sampled every second");
+  for (const auto &cf_name : job_stats->GetColumnFamilies()) {
+    auto cf_job_stats = job_stats->Get(cf_name);
+    writer.Sample("kvrocks_flushed_bytes_total", {{"cf", cf_name}}, cf_job_stats->flushed_bytes.load());
+    writer.Sample("kvrocks_compaction_input_bytes_total", {{"cf", cf_name}},
+                  cf_job_stats->compaction_input_bytes.load());
+    writer.Sample("kvrocks_compaction_output_bytes_total", {{"cf", cf_name}},
+                  cf_job_stats->compaction_output_bytes.load());
+    writer.Sample("kvrocks_write_stalls_total", {{"cf", cf_name}, {"condition", "delayed"}},
+                  cf_job_stats->delayed_stalls.load());
+    writer.Sample("kvrocks_write_stalls_total", {{"cf", cf_name}, {"condition", "stopped"}},
+                  cf_job_stats->stopped_stalls.load());
+    writer.Sample("kvrocks_write_amplification", {{"cf", cf_name}}, cf_job_stats->WriteAmplification());
+    writer.Sample("kvrocks_level0_files", {{"cf", cf_name}}, cf_job_stats->level0_files.load());
+  }
+  // The causes of the write stalls are counted by RocksDB
+  std::pair<const char *, const char *> stall_causes[] = {
+      {"io_stalls.level0_slowdown", "level0_slowdown"},
+      {"io_stalls.level0_numfiles", "level0_stop"},
+      {"io_stalls.slowdown_for_pending_compaction_bytes", "pending_compaction_bytes_slowdown"},
+      {"io_stalls.stop_for_pending_compaction_bytes", "pending_compaction_bytes_stop"},
+      {"io_stalls.memtable_slowdown", "memtable_slowdown"},
+      {"io_stalls.memtable_compaction", "memtable_stop"},
+  };
+  writer.Family("kvrocks_write_stall_causes_total", "counter", "The number of the write stalls by the causes");
+  for (const auto &cf_handle : cf_handles) {
+    std::map<std::string, std::string> cf_stats_map;
+    if (!db->GetMapProperty(cf_handle, rocksdb::DB::Properties::kCFStats, &cf_stats_map)) continue;
+    for (const auto &[key, cause] : stall_causes) {
+      auto iter = cf_stats_map.find(key);
+      if (iter == cf_stats_map.end()) continue;
+      writer.Sample("kvrocks_write_stall_causes_total", {{"cf", cf_handle->GetName()}, {"cause", cause}},
+                    std::strtod(iter->second.c_str(), nullptr));
+    }
+  }
+
+  auto stats = db->GetDBOptions().statistics;
+  if (!stats) return writer.Output();
+  for (const auto &iter : rocksdb::TickersNameMap) {
+    auto name = "kvrocks_" + PrometheusWriter::SanitizeName(iter.second) + "_total";
+    writer.Family(name, "counter", "The RocksDB ticker " + iter.second);
+    writer.Sample(name, stats->getTickerCount(iter.first));
+  }
+  for (const auto &iter : rocksdb::HistogramsNameMap) {
+    auto name = "kvrocks_" + PrometheusWriter::SanitizeName(iter.second);
+    rocksdb::HistogramData hist_data;
+    stats->histogramData(iter.first, &hist_data);
+    writer.Family(name, "summary", "The RocksDB histogram " + iter.second);
+    writer.Sample(name, {{"quantile", "0.5"}}, hist_data.median);
+    writer.Sample(name, {{"quantile", "0.95"}}, hist_data.percentile95);
+    writer.Sample(name, {{"quantile", "0.99"}}, hist_data.percentile99);
+    writer.Sample(name, {{"quantile", "1"}}, hist_data.max);
+    writer.Sample(name + "_sum", hist_data.sum);
+    writer.Sample(name + "_count", hist_data.count);
+  }
+  return writer.Output();
+}
+
 // This function is called by replication thread when finished fetching
 // all files from its master.
 // Before restoring the db from backup or checkpoint, we should
@@ -1091,6 +2535,9 @@ void Server::PrepareRestoreDB() {
   LOG(INFO) << "Disconnecting slaves...";
   DisconnectSlaves();
 
+  // The sub-jobs of the scheduled compaction are planned by the files of the old DB
+  compaction_scheduler_.Stop();
+
   // Stop task runner
   LOG(INFO) << "Stopping the task runner and clear task queue...";
   task_runner_.Stop();
@@ -1148,7 +2595,65 @@ Status Server::AsyncCompactDB(const std::string &begin_key, const std::string &e
     delete begin;
     delete end;
   };
-  return task_runner_.Publish(task);
+  return task_runner_.Publish(task, TaskPriority::kBackground, "compact");
+}
+
+Status Server::AsyncReclaimFlushedRange(const std::string &begin_key, const std::string &end_key) {
+  // The TTL index isn't prefixed by the namespace, so it's compacted only for the whole key space
+  static const std::vector<std::string> cf_names = {
+      Engine::kMetadataColumnFamilyName, Engine::kSubkeyColumnFamilyName, Engine::kZSetScoreColumnFamilyName,
+      Engine::kZSetRankColumnFamilyName, Engine::kStreamColumnFamilyName, Engine::kTTLIndexColumnFamilyName};
+  auto num_cfs = [](const std::pair<std::string, std::string> &range) {
+    return range.first.empty() ? cf_names.size() : cf_names.size() - 1;
+  };
+
+  std::lock_guard<std::mutex> lg(db_job_mu_);
+  flushed_ranges_.emplace_back(begin_key, end_key);
+  flush_reclaim_total_cfs_ += num_cfs(flushed_ranges_.back());
+  if (flush_reclaiming_) return Status::OK();
+  flush_reclaiming_ = true;
+
+  Task task = [this, num_cfs] {
+    while (true) {
+      std::pair<std::string, std::string> range;
+      {
+        std::lock_guard<std::mutex> lg(db_job_mu_);
+        if (flushed_ranges_.empty()) {
+          flush_reclaiming_ = false;
+          return;
+        }
+        range = std::move(flushed_ranges_.front());
+        flushed_ranges_.pop_front();
+      }
+
+      Slice begin(range.first), end(range.second);
+      for (size_t i = 0; i < num_cfs(range); i++) {
+        // To guarantee accessing DB safely, the compaction is skipped when closing the DB
+        auto guard = storage_->ReadLockGuard();
+        if (!stop_ && !storage_->IsClosing()) {
+          rocksdb::CompactRangeOptions compact_opts;
+          // Don't block the automatic compactions, and the IO is limited by the rate limiter of the DB
+          compact_opts.exclusive_manual_compaction = false;
+          auto s = storage_->GetDB()->CompactRange(compact_opts, storage_->GetCFHandle(cf_names[i]),
+                                                   range.first.empty() ? nullptr : &begin,
+                                                   range.second.empty() ? nullptr : &end);
+          if (!s.ok()) {
+            LOG(WARNING) << "[server] Failed to reclaim the flushed keys in " << cf_names[i]
+                         << ", err: " << s.ToString();
+          }
+        }
+        flush_reclaimed_cfs_++;
+      }
+      LOG(INFO) << "[server] Reclaimed the flushed keys, progress: " << flush_reclaimed_cfs_ << "/"
+                << flush_reclaim_total_cfs_ << " column families";
+    }
+  };
+  auto s = task_runner_.Publish(task, TaskPriority::kBackground, "reclaim_flushed_range");
+  if (!s.IsOK()) {
+    flush_reclaiming_ = false;
+    flushed_ranges_.clear();
+  }
+  return s;
 }
 
 Status Server::AsyncBgsaveDB() {
@@ -1169,14 +2674,15 @@ Status Server::AsyncBgsaveDB() {
     last_bgsave_status_ = s.IsOK() ? "ok" : "err";
     last_bgsave_time_sec_ = static_cast<int>(stop_bgsave_time - start_bgsave_time);
   };
-  return task_runner_.Publish(task);
+  return task_runner_.Publish(task, TaskPriority::kNormal, "bgsave");
 }
 
 Status Server::AsyncPurgeOldBackups(uint32_t num_backups_to_keep, uint32_t backup_max_keep_hours) {
   Task task = [num_backups_to_keep, backup_max_keep_hours, this] {
     storage_->PurgeOldBackups(num_backups_to_keep, backup_max_keep_hours);
   };
-  return task_runner_.Publish(task);
+  // Purging the backups is quick but frees the disk, so it shouldn't wait for the long jobs
+  return task_runner_.Publish(task, TaskPriority::kUrgent, "purge_backups");
 }
 
 Status Server::AsyncScanDBSize(const std::string &ns) {
@@ -1200,7 +2706,7 @@ Status Server::AsyncScanDBSize(const std::string &ns) {
     time(&db_scan_infos_[ns].last_scan_time);
     db_scan_infos_[ns].is_scanning = false;
   };
-  return task_runner_.Publish(task);
+  return task_runner_.Publish(task, TaskPriority::kBackground, "scan_dbsize");
 }
 
 Status Server::autoResizeBlockAndSST() {
@@ -1289,31 +2795,41 @@ time_t Server::GetLastScanTime(const std::string &ns) {
   return 0;
 }
 
-void Server::SlowlogPushEntryIfNeeded(const std::vector<std::string> *args, uint64_t duration) {
+void Server::SlowlogPushEntryIfNeeded(const std::vector<std::string> *args, uint64_t duration,
+                                      const RequestTrace *trace) {
   int64_t threshold = config_->slowlog_log_slower_than;
   if (threshold < 0 || static_cast<int64_t>(duration) < threshold) return;
   auto entry = new SlowEntry();
   size_t argc = args->size() > kSlowLogMaxArgc ? kSlowLogMaxArgc : args->size();
+  entry->args.reserve(argc);
   for (size_t i = 0; i < argc; i++) {
     if (argc != args->size() && i == argc - 1) {
       entry->args.emplace_back(fmt::format("... ({} more arguments)", args->size() - argc + 1));
       break;
     }
-    if (args->data()[i].length() <= kSlowLogMaxString) {
-      entry->args.emplace_back(args->data()[i]);
+    const auto &arg = args->data()[i];
+    if (arg.length() <= kSlowLogMaxString) {
+      entry->args.emplace_back(arg);
     } else {
-      entry->args.emplace_back(fmt::format("{}... ({} more bytes)", args->data()[i].substr(0, kSlowLogMaxString),
-                                           args->data()[i].length() - kSlowLogMaxString));
+      // Truncate the argument in place, rather than copying the prefix into a temporary string
+      auto &truncated = entry->args.emplace_back();
+      truncated.reserve(kSlowLogMaxString + 32);
+      truncated.append(arg, 0, kSlowLogMaxString);
+      fmt::format_to(std::back_inserter(truncated), "... ({} more bytes)", arg.length() - kSlowLogMaxString);
     }
   }
   entry->duration = duration;
+  if (trace) entry->trace = std::make_unique<RequestTrace>(*trace);
   slow_log_.PushEntry(entry);
 }
 
 std::string Server::GetClientsStr() {
   std::string clients;
-  for (const auto &t : worker_threads_) {
-    clients.append(t->GetWorker()->GetClientsStr());
+  {
+    std::shared_lock<std::shared_mutex> guard(worker_threads_mu_);
+    for (const auto &t : worker_threads_) {
+      clients.append(t->GetWorker()->GetClientsStr());
+    }
   }
   std::lock_guard<std::mutex> guard(slave_threads_mu_);
   for (const auto &st : slave_threads_) {
@@ -1327,10 +2843,13 @@ void Server::KillClient(int64_t *killed, const std::string &addr, uint64_t id, u
   *killed = 0;
 
   // Normal clients and pubsub clients
-  for (const auto &t : worker_threads_) {
-    int64_t killed_in_worker = 0;
-    t->GetWorker()->KillClient(conn, id, addr, type, skipme, &killed_in_worker);
-    *killed += killed_in_worker;
+  {
+    std::shared_lock<std::shared_mutex> guard(worker_threads_mu_);
+    for (const auto &t : worker_threads_) {
+      int64_t killed_in_worker = 0;
+      t->GetWorker()->KillClient(conn, id, addr, type, skipme, &killed_in_worker);
+      *killed += killed_in_worker;
+    }
   }
 
   // Slave clients
@@ -1360,14 +2879,19 @@ ReplState Server::GetReplicationState() {
   return kReplConnecting;
 }
 
+int64_t Server::GetReplicationLagMS() {
+  if (IsSlave() && replication_thread_) {
+    return replication_thread_->LagMS();
+  }
+  return -1;
+}
+
 Status Server::LookupAndCreateCommand(const std::string &cmd_name, std::unique_ptr<Redis::Commander> *cmd) {
-  auto commands = Redis::GetCommands();
   if (cmd_name.empty()) return Status(Status::RedisUnknownCmd);
-  auto cmd_iter = commands->find(Util::ToLower(cmd_name));
-  if (cmd_iter == commands->end()) {
+  auto redisCmd = Redis::LookupCommand(cmd_name);
+  if (!redisCmd) {
     return Status(Status::RedisUnknownCmd);
   }
-  auto redisCmd = cmd_iter->second;
   *cmd = redisCmd->factory();
   (*cmd)->SetAttributes(redisCmd);
   return Status::OK();
@@ -1394,9 +2918,69 @@ void Server::ScriptSet(const std::string &sha, const std::string &body) {
   storage_->WriteToPropagateCF(funcname, body);
 }
 
+static thread_local Redis::Connection *curr_connection = nullptr;
+
+lua_State *Server::ReadOnlyScriptState() { return readonly_script_state; }
+
+void Server::SampleReadOnlyScriptMemory() {
+  if (!readonly_script_state) return;
+  readonly_script_memory->store(static_cast<int64_t>(lua_gc(readonly_script_state, LUA_GCCOUNT, 0)) * 1024,
+                                std::memory_order_relaxed);
+}
+
+void Server::SetCurrentConnection(Redis::Connection *conn) { curr_connection = conn; }
+
+Redis::Connection *Server::GetCurrentConnection() { return curr_connection; }
+
+Status Server::ScriptLoad(const std::string &body, std::string *sha, bool need_to_store) {
+  auto s = Lua::createFunction(this, body, sha, lua_, need_to_store);
+  if (!s.IsOK()) return s;
+  {
+    std::shared_lock<std::shared_mutex> guard(worker_threads_mu_);
+    for (const auto &worker_thread : worker_threads_) {
+      s = Lua::createFunction(this, body, sha, worker_thread->GetWorker()->Lua(), false);
+      if (!s.IsOK()) return s;
+    }
+  }
+  for (auto lua : readonly_script_states_) {
+    s = Lua::createFunction(this, body, sha, lua, false);
+    if (!s.IsOK()) return s;
+  }
+  return Status::OK();
+}
+
+void Server::ScriptPreload() {
+  auto cf = storage_->GetCFHandle(Engine::kPropagateColumnFamilyName);
+  rocksdb::ReadOptions read_options;
+  read_options.fill_cache = false;
+  std::unique_ptr<rocksdb::Iterator> iter(storage_->GetDB()->NewIterator(read_options, cf));
+  size_t limit = static_cast<size_t>(config_->lua_script_cache_size), loaded = 0;
+  rocksdb::Slice prefix(Engine::kLuaFunctionPrefix);
+  for (iter->Seek(prefix); iter->Valid() && iter->key().starts_with(prefix); iter->Next()) {
+    if (limit > 0 && loaded >= limit) break;
+    std::string sha;
+    auto s = ScriptLoad(iter->value().ToString(), &sha, false);
+    if (!s.IsOK()) {
+      LOG(WARNING) << "[server] Failed to load the script " << iter->key().ToString() << ", err: " << s.Msg();
+      continue;
+    }
+    loaded++;
+  }
+  if (loaded > 0) LOG(INFO) << "[server] Loaded " << loaded << " scripts into the Lua states";
+}
+
 void Server::ScriptReset() {
   Lua::DestroyState(lua_);
   lua_ = Lua::CreateState();
+  {
+    std::shared_lock<std::shared_mutex> guard(worker_threads_mu_);
+    for (const auto &worker_thread : worker_threads_) {
+      Lua::ClearFunctions(worker_thread->GetWorker()->Lua());
+    }
+  }
+  for (auto lua : readonly_script_states_) {
+    Lua::ClearFunctions(lua);
+  }
 }
 
 void Server::ScriptFlush() {
@@ -1421,6 +3005,8 @@ Status Server::Propagate(const std::string &channel, const std::vector<std::stri
 Status Server::ExecPropagateScriptCommand(const std::vector<std::string> &tokens) {
   auto subcommand = Util::ToLower(tokens[1]);
   if (subcommand == "flush") {
+    // The Lua states of the workers are only accessed by the commands
+    auto exclusivity = WorkExclusivityGuard();
     ScriptReset();
   }
   return Status::OK();
@@ -1492,6 +3078,8 @@ void Server::AdjustOpenFilesLimit() {
 std::string ServerLogData::Encode() {
   if (type_ == kReplIdLog) {
     return std::string(1, kReplIdTag) + " " + content_;
+  } else if (type_ == kShardPubSubLog) {
+    return std::string(1, kShardPubSubTag);
   } else {
     return content_;
   }
@@ -1503,11 +3091,14 @@ Status ServerLogData::Decode(const rocksdb::Slice &blob) {
   }
 
   const char *header = blob.data();
-  // Only support `kReplIdTag` now
   if (*header == kReplIdTag && blob.size() == 2 + kReplIdLength) {
     type_ = kReplIdLog;
     content_ = std::string(blob.data() + 2, blob.size() - 2);
     return Status::OK();
   }
+  if (*header == kShardPubSubTag && blob.size() == 1) {
+    type_ = kShardPubSubLog;
+    return Status::OK();
+  }
   return Status(Status::NotOK);
 }
@@ -23,26 +23,37 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
+#include <array>
+#include <deque>
 #include <list>
 #include <map>
 #include <memory>
 #include <set>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <variant>
 #include <vector>
 
+#include "cluster/cdc.h"
 #include "cluster/cluster.h"
 #include "cluster/replication.h"
 #include "cluster/slot_import.h"
 #include "cluster/slot_migrate.h"
 #include "lua.hpp"
+#include "metrics_server.h"
+#include "namespace_qos.h"
 #include "rw_lock.h"
 #include "stats/log_collector.h"
 #include "stats/stats.h"
+#include "storage/compaction_scheduler.h"
+#include "storage/expire_reaper.h"
 #include "storage/redis_metadata.h"
 #include "storage/storage.h"
+#include "string_util.h"
 #include "task_runner.h"
+#include "tls_handshaker.h"
 #include "tls_util.h"
 #include "worker.h"
 
@@ -72,6 +83,12 @@ struct ChannelSubscribeNum {
   size_t subscribe_num;
 };
 
+// An entry of MEMORY STATS, the value is the bytes or the size of a component, or a ratio
+struct MemoryStat {
+  std::string name;
+  std::variant<uint64_t, double> value;
+};
+
 enum SlowLog {
   kSlowLogMaxArgc = 32,
   kSlowLogMaxString = 128,
@@ -84,15 +101,17 @@ enum ClientType {
   kTypeSlave = (1ULL << 3),   // slave client
 };
 
-enum ServerLogType { kServerLogNone, kReplIdLog };
+enum ServerLogType { kServerLogNone, kReplIdLog, kShardPubSubLog };
 
 class ServerLogData {
  public:
   // Redis::WriteBatchLogData always starts with digist ascii, we use alphabetic to
   // distinguish ServerLogData with Redis::WriteBatchLogData.
   static const char kReplIdTag = 'r';
+  // The tag of the message published to the shard channel, it's put before the message
+  static const char kShardPubSubTag = 's';
   static bool IsServerLogData(const char *header) {
-    if (header != NULL) return *header == kReplIdTag;
+    if (header != NULL) return *header == kReplIdTag || *header == kShardPubSubTag;
     return false;
   }
 
@@ -122,27 +141,43 @@ class Server {
   Config *GetConfig() { return config_; }
   Status LookupAndCreateCommand(const std::string &cmd_name, std::unique_ptr<Redis::Commander> *cmd);
   void AdjustOpenFilesLimit();
-
-  Status AddMaster(const std::string &host, uint32_t port, bool force_reconnect);
+  // Start the new workers or retire the newest ones until there're the number of the active workers,
+  // the first worker is never retired since it listens on the unix socket
+  Status ResizeWorkers(int workers);
+  // Move the connections of the retiring worker to the active ones, it's called in the retiring worker
+  void MigrateConnections(Worker *worker);
+
+  // The replica restores the local backup before PSYNC if the backup dir is set, see ReplicationThread
+  Status AddMaster(const std::string &host, uint32_t port, bool force_reconnect, const std::string &backup_dir = "");
   Status RemoveMaster();
   Status AddSlave(Redis::Connection *conn, rocksdb::SequenceNumber next_repl_seq);
   void DisconnectSlaves();
   void cleanupExitedSlaves();
+  // Stream the changes in the WAL to the connection which is taken over by the feed thread
+  Status AddCDCSubscriber(Redis::Connection *conn, CDCOptions options);
+  void DisconnectCDCSubscribers();
+  void cleanupExitedCDCSubscribers();
   bool IsSlave() { return !master_host_.empty(); }
+  bool HasSlaves();
   void FeedMonitorConns(Redis::Connection *conn, const std::vector<std::string> &tokens);
   void IncrFetchFileThread() { fetch_file_threads_num_++; }
   void DecrFetchFileThread() { fetch_file_threads_num_--; }
   int GetFetchFileThreadNum() { return fetch_file_threads_num_; }
+  ReplBacklog *GetReplBacklog() { return repl_backlog_.get(); }
+  ReplFeeder *GetReplFeeder() { return repl_feeder_.get(); }
 
   int PublishMessage(const std::string &channel, const std::string &msg);
-  void SubscribeChannel(const std::string &channel, Redis::Connection *conn);
-  void UnSubscribeChannel(const std::string &channel, Redis::Connection *conn);
-  void GetChannelsByPattern(const std::string &pattern, std::vector<std::string> *channels);
+  // Publish the message to the subscribers of the shard channel, the patterns are not matched
+  int PublishShardMessage(const std::string &channel, const std::string &msg);
+  // The shard channels of SSUBSCRIBE are registered apart from the channels if sharded is true
+  void SubscribeChannel(const std::string &channel, Redis::Connection *conn, bool sharded = false);
+  void UnSubscribeChannel(const std::string &channel, Redis::Connection *conn, bool sharded = false);
+  void GetChannelsByPattern(const std::string &pattern, std::vector<std::string> *channels, bool sharded = false);
   void ListChannelSubscribeNum(const std::vector<std::string> &channels,
-                               std::vector<ChannelSubscribeNum> *channel_subscribe_nums);
+                               std::vector<ChannelSubscribeNum> *channel_subscribe_nums, bool sharded = false);
   void PSubscribeChannel(const std::string &pattern, Redis::Connection *conn);
   void PUnSubscribeChannel(const std::string &pattern, Redis::Connection *conn);
-  int GetPubSubPatternSize() { return pubsub_patterns_.size(); }
+  int GetPubSubPatternSize();
 
   void AddBlockingKey(const std::string &key, Redis::Connection *conn);
   void UnBlockingKey(const std::string &key, Redis::Connection *conn);
@@ -151,6 +186,43 @@ class Server {
   void UnblockOnStreams(const std::vector<std::string> &keys, Redis::Connection *conn);
   Status WakeupBlockingConns(const std::string &key, size_t n_conns);
   Status OnEntryAddedToStream(const std::string &ns, const std::string &key, const Redis::StreamEntryID &entry_id);
+  // The connection waits until the number of the replicas acknowledged the sequence number
+  void AddReplAckWaiter(Redis::Connection *conn, rocksdb::SequenceNumber seq, int num_replicas);
+  void RemoveReplAckWaiter(Redis::Connection *conn);
+  int CountReplicasAcked(rocksdb::SequenceNumber seq);
+  // Wake up the waiters whose sequence numbers were acknowledged by enough replicas, they're
+  // checked in the order of their sequence numbers, so the waiters are released in groups
+  void WakeupReplAckWaiters();
+
+  // The watching connections are marked as modified before the write commands of the watched
+  // keys are executed, so that their transactions checking the mark under the locks of the keys
+  // (or the exclusivity) would be aborted
+  void WatchKeys(Redis::Connection *conn, const std::vector<std::string> &ns_keys);
+  void ResetWatchedKeys(Redis::Connection *conn);
+  void UpdateWatchedKeysFromArgs(const std::vector<std::string> &args, const Redis::CommandAttributes &attributes,
+                                 const std::string &ns);
+
+  // CLIENT TRACKING, the keys read by the tracking clients are remembered before the commands are
+  // executed, and the keys written by the commands are invalidated after the writes were committed.
+  // The invalidations are collected in the batches of the connections and sent by SendInvalidations
+  // after their commands were executed, see ClientTracking.
+  ClientTracking *GetClientTracking() { return &client_tracking_; }
+  Status EnableClientTracking(Redis::Connection *conn, const TrackingOptions &options);
+  void TrackKeysFromArgs(Redis::Connection *conn, const std::vector<std::string> &args,
+                         const Redis::CommandAttributes &attributes, InvalidationBatches *batches);
+  void InvalidateTrackedKeysFromArgs(Redis::Connection *conn, const std::vector<std::string> &args,
+                                     const Redis::CommandAttributes &attributes, InvalidationBatches *batches);
+  void SendInvalidations(const InvalidationBatches &batches);
+
+  // The epochs of the keys are bumped after the write commands were executed, the coalesced
+  // replies of the reads are dropped once the epochs of their keys changed, see ReplyCoalescer
+  KeyWriteEpochs *GetKeyWriteEpochs() { return &key_write_epochs_; }
+  void BumpKeyWriteEpochsFromArgs(const std::vector<std::string> &args, const Redis::CommandAttributes &attributes,
+                                  const std::string &ns);
+  // The rate limits of the namespaces are shared by the connections of all workers
+  NamespaceQoS *GetNamespaceQoS() { return &namespace_qos_; }
+  // Reconcile the estimated sizes of the namespaces with the disk quotas against their approximate sizes
+  void ReconcileNamespaceSizes();
 
   std::string GetLastRandomKeyCursor();
   void SetLastRandomKeyCursor(const std::string &cursor);
@@ -159,18 +231,36 @@ class Server {
   void GetStatsInfo(std::string *info);
   void GetServerInfo(std::string *info);
   void GetMemoryInfo(std::string *info);
+  // The breakdown of the memory by the components, the registries are estimated by their sizes
+  void GetMemoryStats(std::vector<MemoryStat> *stats);
+  // The section is replied from the snapshot collected by the cron if info-rocksdb-refresh-ms is set
   void GetRocksDBInfo(std::string *info);
   void GetClientsInfo(std::string *info);
   void GetReplicationInfo(std::string *info);
   void GetRoleInfo(std::string *info);
   void GetCommandsStatsInfo(std::string *info);
+  void GetTaskStatsInfo(std::string *info);
+  void GetPerfStatsInfo(std::string *info);
+  // Return at most count hot keys of the namespace merged from all workers, ordered by the accesses
+  void GetHotKeys(const std::string &ns, size_t count, std::vector<HotKey> *hot_keys);
+  // The number of the full scans of all keys done to find the big keys, see BigKeyScanner
+  uint64_t GetBigKeysFullScans() { return big_key_scanner_.GetFullPasses(); }
   void GetInfo(const std::string &ns, const std::string &section, std::string *info);
   std::string GetRocksDBStatsJson();
+  // Render the metrics in the Prometheus format without taking the locks of the workers, it's
+  // called by the metrics thread, see MetricsServer
+  std::string GetPrometheusMetrics();
   ReplState GetReplicationState();
+  // The replication lag in milliseconds of the replica, -1 if unknown, see ReplicationThread::LagMS
+  int64_t GetReplicationLagMS();
 
   void PrepareRestoreDB();
   void WaitNoMigrateProcessing();
   Status AsyncCompactDB(const std::string &begin_key = "", const std::string &end_key = "");
+  // Compact the key range dropped by FLUSHDB/FLUSHALL ASYNC in the column families of the keys, or
+  // the whole key space if the range is empty, so the dropped data is reclaimed at once rather than
+  // by the later compactions. The ranges are queued and compacted one by one in background.
+  Status AsyncReclaimFlushedRange(const std::string &begin_key, const std::string &end_key);
   Status AsyncBgsaveDB();
   Status AsyncPurgeOldBackups(uint32_t num_backups_to_keep, uint32_t backup_max_keep_hours);
   Status AsyncScanDBSize(const std::string &ns);
@@ -181,6 +271,8 @@ class Server {
   int IncrClientNum();
   int IncrMonitorClientNum();
   int DecrMonitorClientNum();
+  // Raise the ratio which the monitor entries are sampled with, the feeder lowers it after the monitors are gone
+  void RaiseMonitorSampleRatio(double ratio);
   int IncrBlockedClientNum();
   int DecrBlockedClientNum();
   std::string GetClientsStr();
@@ -189,9 +281,23 @@ class Server {
                   Redis::Connection *conn);
 
   lua_State *Lua() { return lua_; }
+  // The threads running the read-only scripts, it's nullptr if lua-readonly-script-threads is 0
+  TaskRunner *GetReadOnlyScriptRunner() { return readonly_script_runner_.get(); }
+  // The runner scanning the partitions of KEYS, it's null if scan-parallel-threads is 0
+  TaskRunner *GetScanRunner() { return scan_runner_.get(); }
+  // The Lua state of the current read-only script thread, or nullptr on the other threads
+  static lua_State *ReadOnlyScriptState();
+  // Sample the memory of the Lua state if it's called by a read-only script thread, the states
+  // are only accessed by their threads, so MEMORY STATS reports the sampled memory
+  static void SampleReadOnlyScriptMemory();
   Status ScriptExists(const std::string &sha);
   Status ScriptGet(const std::string &sha, std::string *body);
   void ScriptSet(const std::string &sha, const std::string &body);
+  // Compile the script into the Lua states of the server and all workers, so that the workers
+  // needn't compile it on the first call. It must be called exclusively or before workers start.
+  Status ScriptLoad(const std::string &body, std::string *sha, bool need_to_store = true);
+  // Load the stored scripts into the Lua states, the number is limited by lua-script-cache-size
+  void ScriptPreload();
   void ScriptReset();
   void ScriptFlush();
 
@@ -199,15 +305,18 @@ class Server {
   Status ExecPropagatedCommand(const std::vector<std::string> &tokens);
   Status ExecPropagateScriptCommand(const std::vector<std::string> &tokens);
 
-  void SetCurrentConnection(Redis::Connection *conn) { curr_connection_ = conn; }
-  Redis::Connection *GetCurrentConnection() { return curr_connection_; }
+  // The connection running the script on the current thread, the scripts running under
+  // the locks of their keys are executed by the workers concurrently
+  void SetCurrentConnection(Redis::Connection *conn);
+  Redis::Connection *GetCurrentConnection();
 
   LogCollector<PerfEntry> *GetPerfLog() { return &perf_log_; }
   LogCollector<SlowEntry> *GetSlowLog() { return &slow_log_; }
-  void SlowlogPushEntryIfNeeded(const std::vector<std::string> *args, uint64_t duration);
+  void SlowlogPushEntryIfNeeded(const std::vector<std::string> *args, uint64_t duration,
+                                const RequestTrace *trace = nullptr);
 
-  std::unique_ptr<RWLock::ReadLock> WorkConcurrencyGuard();
-  std::unique_ptr<RWLock::WriteLock> WorkExclusivityGuard();
+  std::unique_ptr<RWLock::ShardedReadLock> WorkConcurrencyGuard();
+  std::unique_ptr<RWLock::ShardedWriteLock> WorkExclusivityGuard();
 
   Stats stats_;
   Engine::Storage *storage_;
@@ -218,14 +327,45 @@ class Server {
 
 #ifdef ENABLE_OPENSSL
   UniqueSSLContext ssl_ctx_;
+  // The handshakes are done by the workers themselves if tls-handshake-threads is 0
+  TLSHandshaker *GetTLSHandshaker() { return tls_handshaker_.get(); }
 #endif
 
  private:
+#ifdef ENABLE_OPENSSL
+  std::unique_ptr<TLSHandshaker> tls_handshaker_;
+#endif
+
   void cron();
+  // Start the shared backlog of the WAL for the replicas and the CDC subscribers, it's called
+  // with slave_threads_mu_ held
+  void startReplBacklogIfNeed();
+  Status startReplFeederIfNeed();
+  // Remember the next sequence number that the replica or CDC subscriber needs after reconnecting
+  void recordWALConsumer(const std::string &id, rocksdb::SequenceNumber next_seq, time_t now);
+  // Purge the archived WAL files which no replica or CDC subscriber needs, see wal-retention-by-replicas
+  void retainWALForReplicas();
   void recordInstantaneousMetrics();
-  void delConnContext(ConnContext *c);
+  void feedMonitorEntries();
+  // Stop and free the retiring workers which have no connection
+  void removeRetiredWorkers();
+  struct PubSubChannelShard;
+  PubSubChannelShard &pubsubChannelShard(const std::string &channel);
+  struct BlockingKeyShard;
+  BlockingKeyShard &blockingKeyShard(const std::string &key);
   void updateCachedTime();
   Status autoResizeBlockAndSST();
+  void collectRocksDBInfo(std::string *info);
+  // Collect the rocksdb section of INFO again if the snapshot is older than info-rocksdb-refresh-ms
+  void refreshRocksDBInfo();
+
+  // The rocksdb section of INFO collected in background, it's swapped atomically so INFO reads it
+  // without any lock
+  struct RocksDBInfoSnapshot {
+    std::string info;
+    uint64_t collected_ms = 0;
+  };
+  std::shared_ptr<const RocksDBInfoSnapshot> rocksdb_info_snapshot_;
 
   std::atomic<bool> stop_;
   std::atomic<bool> is_loading_;
@@ -238,25 +378,48 @@ class Server {
   std::mutex last_random_key_cursor_mu_;
 
   lua_State *lua_;
-
-  Redis::Connection *curr_connection_ = nullptr;
+  // Every read-only script thread takes one of the states when it's started
+  std::vector<lua_State *> readonly_script_states_;
+  std::atomic<size_t> taken_readonly_script_states_ = 0;
+  std::unique_ptr<std::atomic<int64_t>[]> readonly_script_memory_;
+  std::unique_ptr<TaskRunner> readonly_script_runner_;
+  std::unique_ptr<TaskRunner> scan_runner_;
 
   // client counters
   std::atomic<uint64_t> client_id_{1};
   std::atomic<int> connected_clients_{0};
   std::atomic<int> monitor_clients_{0};
+  // The max sample ratio of all monitors, the commands are sampled with it before being queued
+  std::atomic<double> monitor_sample_ratio_{1.0};
+  std::atomic<uint64_t> monitor_dropped_entries_{0};
   std::atomic<uint64_t> total_clients_{0};
   std::atomic<int> excuting_command_num_{0};
 
   // slave
   std::mutex slave_threads_mu_;
   std::list<FeedSlaveThread *> slave_threads_;
+  // The backlog is created when the first replica or CDC subscriber connects, and removed with them
+  std::unique_ptr<ReplBacklog> repl_backlog_;
+  // The event loop of the feeders of all replicas, it's created when the first replica connects. It's
+  // kept until the server is destroyed, since the writers may still write its wakeup fd after it stopped.
+  std::unique_ptr<ReplFeeder> repl_feeder_;
+  std::mutex cdc_threads_mu_;
+  std::list<CDCFeedThread *> cdc_threads_;
+  // The next sequence numbers needed by the replicas and CDC subscribers, and when they were last seen
+  std::mutex wal_consumers_mu_;
+  std::map<std::string, std::pair<rocksdb::SequenceNumber, time_t>> wal_consumers_;
+  std::atomic<rocksdb::SequenceNumber> wal_retained_seq_ = 0;
   std::atomic<int> fetch_file_threads_num_;
 
   // Some jobs to operate DB should be unique
   std::mutex db_job_mu_;
   bool db_compacting_ = false;
   bool is_bgsave_in_progress_ = false;
+  // The key ranges to be reclaimed after the async flushes, and the progress in column families
+  std::deque<std::pair<std::string, std::string>> flushed_ranges_;
+  bool flush_reclaiming_ = false;
+  std::atomic<uint64_t> flush_reclaimed_cfs_{0};
+  std::atomic<uint64_t> flush_reclaim_total_cfs_{0};
   int last_bgsave_time_ = -1;
   std::string last_bgsave_status_ = "ok";
   int last_bgsave_time_sec_ = -1;
@@ -266,20 +429,69 @@ class Server {
   LogCollector<SlowEntry> slow_log_;
   LogCollector<PerfEntry> perf_log_;
 
-  std::map<ConnContext *, bool> conn_ctxs_;
-  std::map<std::string, std::list<ConnContext *>> pubsub_channels_;
-  std::map<std::string, std::list<ConnContext *>> pubsub_patterns_;
-  std::mutex pubsub_channels_mu_;
-  std::map<std::string, std::list<ConnContext *>> blocking_keys_;
-  std::mutex blocking_keys_mu_;
+  Engine::ExpireReaper expire_reaper_;
+  CompactionScheduler compaction_scheduler_;
+
+  // The pubsub channels are sharded by their hashes, so the publishes and subscribes
+  // of the different channels don't contend on the same lock
+  struct PubSubChannelShard {
+    std::mutex mu;
+    std::map<std::string, std::list<ConnContext>> channels;
+    std::map<std::string, std::list<ConnContext>> shard_channels;
+
+    std::map<std::string, std::list<ConnContext>> &Channels(bool sharded) {
+      return sharded ? shard_channels : channels;
+    }
+  };
+  static constexpr size_t kPubSubChannelShards = 16;
+  std::array<PubSubChannelShard, kPubSubChannelShards> pubsub_channel_shards_;
+  std::map<std::string, std::list<ConnContext>> pubsub_patterns_;
+  // The compiled pubsub patterns grouped by their literal prefixes, a published message
+  // is only matched against the patterns whose literal prefix is a prefix of its channel
+  std::map<std::string, std::map<std::string, Util::GlobPattern>, std::less<>> pubsub_pattern_index_;
+  std::mutex pubsub_patterns_mu_;
+  // The connections blocked on the lists and streams are sharded by the keys. The number of
+  // the blocked ones in each shard is also kept in the atomic counter, so the writes of the
+  // keys which nobody is blocked on don't take the lock of the shard.
+  struct BlockingKeyShard {
+    std::mutex mu;
+    std::atomic<size_t> waiters{0};
+    std::map<std::string, std::list<ConnContext>> keys;
+    std::map<std::string, std::set<std::shared_ptr<StreamConsumer>>> stream_consumers;
+  };
+  static constexpr size_t kBlockingKeyShards = 16;
+  std::array<BlockingKeyShard, kBlockingKeyShards> blocking_key_shards_;
   std::atomic<int> blocked_clients_{0};
-  std::map<std::string, std::set<std::shared_ptr<StreamConsumer>>> blocked_stream_consumers_;
+  struct ReplAckWaiter {
+    ConnContext ctx;
+    int num_replicas;
+  };
+  std::multimap<rocksdb::SequenceNumber, ReplAckWaiter> repl_ack_waiters_;
+  std::mutex repl_ack_waiters_mu_;
+  std::atomic<size_t> repl_ack_waiters_size_{0};
+  std::map<std::string, std::set<Redis::Connection *>> watched_keys_;
+  std::mutex watched_keys_mu_;
+  std::atomic<size_t> watched_keys_size_{0};
+  ClientTracking client_tracking_;
+  KeyWriteEpochs key_write_epochs_;
+  NamespaceQoS namespace_qos_;
+
+  BigKeyScanner big_key_scanner_;
 
   // threads
-  RWLock::ReadWriteLock works_concurrency_rw_lock_;
+  RWLock::ShardedReadWriteLock works_concurrency_rw_lock_;
   std::thread cron_thread_;
   std::thread compaction_checker_thread_;
-  TaskRunner task_runner_;
+  std::thread key_counter_thread_;
+  std::thread big_keys_thread_;
+  // The HTTP listener of metrics-port, it's nullptr if metrics-port is 0
+  std::unique_ptr<MetricsServer> metrics_server_;
+  std::thread wal_sync_thread_;
+  std::thread monitor_feeder_thread_;
+  // Two threads so that a long job, e.g. scanning the dbsize, doesn't block the others
+  TaskRunner task_runner_{2};
+  // The workers are resized online, so the accesses to the list are guarded by the lock
+  std::shared_mutex worker_threads_mu_;
   std::vector<std::unique_ptr<WorkerThread>> worker_threads_;
   std::unique_ptr<ReplicationThread> replication_thread_;
 
@@ -0,0 +1,150 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifdef ENABLE_OPENSSL
+
+#include "tls_handshaker.h"
+
+#include <glog/logging.h>
+#include <openssl/err.h>
+
+#include "thread_util.h"
+#include "time_util.h"
+#include "tls_util.h"
+
+TLSHandshaker::~TLSHandshaker() {
+  for (auto &thread : threads_) {
+    for (auto hs : thread->handshakes) {
+      if (hs->ev) event_free(hs->ev);
+      SSL_free(hs->ssl);
+      evutil_closesocket(hs->fd);
+      delete hs;
+    }
+    if (thread->base) event_base_free(thread->base);
+  }
+}
+
+Status TLSHandshaker::Start(int threads) {
+  for (int i = 0; i < threads; i++) {
+    auto thread = std::make_unique<Thread>();
+    thread->base = event_base_new();
+    if (!thread->base) return {Status::NotOK, "failed to create the event base of the TLS handshaker"};
+    threads_.emplace_back(std::move(thread));
+  }
+  for (auto &thread : threads_) {
+    auto base = thread->base;
+    thread->t = std::thread([base] {
+      Util::ThreadSetName("tls-handshake");
+      event_base_loop(base, EVLOOP_NO_EXIT_ON_EMPTY);
+    });
+  }
+  return Status::OK();
+}
+
+void TLSHandshaker::Stop() {
+  for (auto &thread : threads_) {
+    event_base_loopexit(thread->base, nullptr);
+  }
+}
+
+void TLSHandshaker::Join() {
+  for (auto &thread : threads_) {
+    if (thread->t.joinable()) thread->t.join();
+  }
+}
+
+void TLSHandshaker::Accept(evutil_socket_t fd, SSL *ssl, int timeout_sec, Callback done) {
+  auto thread = threads_[next_.fetch_add(1, std::memory_order_relaxed) % threads_.size()].get();
+  SSL_set_fd(ssl, static_cast<int>(fd));
+  SSL_set_accept_state(ssl);
+  auto hs = new Handshake{thread, fd, ssl, nullptr, Util::GetTimeStampUS() + timeout_sec * 1000000ULL, std::move(done)};
+  {
+    std::lock_guard<std::mutex> guard(thread->mu);
+    thread->handshakes.emplace(hs);
+  }
+  if (event_base_once(thread->base, -1, EV_TIMEOUT, startCB, hs, nullptr) != 0) {
+    LOG(ERROR) << "[tls] Failed to schedule the TLS handshake of the connection, fd: " << fd;
+    finish(hs, false);
+  }
+}
+
+void TLSHandshaker::startCB(evutil_socket_t, int16_t, void *ctx) { step(static_cast<Handshake *>(ctx)); }
+
+void TLSHandshaker::eventCB(evutil_socket_t, int16_t events, void *ctx) {
+  auto hs = static_cast<Handshake *>(ctx);
+  if (events & EV_TIMEOUT) {
+    DLOG(INFO) << "[tls] The TLS handshake timed out, fd: " << hs->fd;
+    finish(hs, false);
+    return;
+  }
+  step(hs);
+}
+
+void TLSHandshaker::step(Handshake *hs) {
+  ERR_clear_error();
+  int ret = SSL_do_handshake(hs->ssl);
+  if (ret == 1) {
+    finish(hs, true);
+    return;
+  }
+
+  int16_t what = 0;
+  int err = SSL_get_error(hs->ssl, ret);
+  if (err == SSL_ERROR_WANT_READ) {
+    what = EV_READ;
+  } else if (err == SSL_ERROR_WANT_WRITE) {
+    what = EV_WRITE;
+  } else {
+    DLOG(INFO) << "[tls] Failed to accept the TLS connection, fd: " << hs->fd << ", err: " << SSLErrors{};
+    finish(hs, false);
+    return;
+  }
+  uint64_t now = Util::GetTimeStampUS();
+  if (now >= hs->deadline_us) {
+    finish(hs, false);
+    return;
+  }
+  uint64_t remaining_us = hs->deadline_us - now;
+  timeval tv = {static_cast<time_t>(remaining_us / 1000000), static_cast<suseconds_t>(remaining_us % 1000000)};
+  if (hs->ev) event_free(hs->ev);
+  hs->ev = event_new(hs->thread->base, hs->fd, what, eventCB, hs);
+  if (!hs->ev || event_add(hs->ev, &tv) != 0) {
+    LOG(ERROR) << "[tls] Failed to wait for the TLS handshake of the connection, fd: " << hs->fd;
+    finish(hs, false);
+  }
+}
+
+void TLSHandshaker::finish(Handshake *hs, bool ok) {
+  if (hs->ev) event_free(hs->ev);
+  {
+    std::lock_guard<std::mutex> guard(hs->thread->mu);
+    hs->thread->handshakes.erase(hs);
+  }
+  if (ok) {
+    hs->done(hs->ssl);
+  } else {
+    SSL_free(hs->ssl);
+    evutil_closesocket(hs->fd);
+    hs->done(nullptr);
+  }
+  delete hs;
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#ifdef ENABLE_OPENSSL
+
+#include <event2/event.h>
+#include <openssl/ssl.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "status.h"
+
+// TLSHandshaker runs the TLS handshakes of the accepted connections in its own threads, so that
+// the RSA and ECDHE work of the reconnecting clients, e.g. after a failover, doesn't stall the
+// event loops of the workers. Each thread has an event loop to drive the non-blocking handshakes,
+// and the connections are handed to the workers once they're established.
+class TLSHandshaker {
+ public:
+  // Called in the thread of the handshaker with the established SSL, or nullptr if the handshake
+  // failed or timed out, and then the socket was closed and the SSL was freed
+  using Callback = std::function<void(SSL *ssl)>;
+
+  TLSHandshaker() = default;
+  ~TLSHandshaker();
+
+  TLSHandshaker(const TLSHandshaker &) = delete;
+  TLSHandshaker &operator=(const TLSHandshaker &) = delete;
+
+  Status Start(int threads);
+  void Stop();
+  void Join();
+
+  // Take over the socket and the SSL to accept the TLS connection within the timeout
+  void Accept(evutil_socket_t fd, SSL *ssl, int timeout_sec, Callback done);
+
+ private:
+  struct Thread;
+  struct Handshake {
+    Thread *thread;
+    evutil_socket_t fd;
+    SSL *ssl;
+    event *ev = nullptr;
+    uint64_t deadline_us;
+    Callback done;
+  };
+  struct Thread {
+    event_base *base = nullptr;
+    std::thread t;
+    std::mutex mu;
+    // The handshakes in progress, which are freed if the handshaker is stopped
+    std::set<Handshake *> handshakes;
+  };
+
+  static void startCB(evutil_socket_t, int16_t, void *ctx);
+  static void eventCB(evutil_socket_t, int16_t events, void *ctx);
+  static void step(Handshake *hs);
+  static void finish(Handshake *hs, bool ok);
+
+  std::vector<std::unique_ptr<Thread>> threads_;
+  std::atomic<size_t> next_ = 0;
+};
+
+#endif
@@ -23,16 +23,25 @@
 #include "tls_util.h"
 
 #include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
 #include <openssl/opensslv.h>
 #include <openssl/rand.h>
 #include <openssl/ssl.h>
 #include <pthread.h>
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
+
+#include <atomic>
 #include <bitset>
+#include <cstring>
 #include <mutex>
 #include <string>
 
 #include "config.h"
+#include "time_util.h"
 
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
 std::unique_ptr<std::mutex[]> ssl_mutexes;
@@ -115,6 +124,104 @@ StatusOr<unsigned long> ParseSSLProtocols(const std::string &protocols) {  // NO
   return ctx_options;
 }
 
+namespace {
+
+// The keys of the stateless session tickets, they're shared by the SSL contexts so that the tickets
+// stay valid after the context was recreated by CONFIG SET. The key is rotated every rotation seconds,
+// and the tickets encrypted by the previous key are still accepted but renewed by the current key.
+class SessionTicketKeys {
+ public:
+  struct Key {
+    unsigned char name[16];
+    unsigned char aes_key[32];
+    unsigned char hmac_key[32];
+  };
+
+  void SetRotation(int seconds) { rotation_secs_ = seconds; }
+
+  // Copy the current key to encrypt the new ticket, which is rotated if it's expired
+  bool GetEncryptionKey(Key *key) {
+    std::lock_guard<std::mutex> guard(mu_);
+    auto now = static_cast<int64_t>(Util::GetTimeStamp());
+    int rotation = rotation_secs_;
+    if (!has_current_ || (rotation > 0 && now - created_at_ >= rotation)) {
+      Key new_key;
+      if (RAND_bytes(reinterpret_cast<unsigned char *>(&new_key), sizeof(new_key)) != 1) return false;
+      previous_ = current_;
+      has_previous_ = has_current_;
+      current_ = new_key;
+      has_current_ = true;
+      created_at_ = now;
+    }
+    *key = current_;
+    return true;
+  }
+
+  // Find the key of the ticket by its name, and whether the ticket should be renewed
+  bool GetDecryptionKey(const unsigned char *name, Key *key, bool *renew) {
+    std::lock_guard<std::mutex> guard(mu_);
+    if (has_current_ && memcmp(current_.name, name, sizeof(current_.name)) == 0) {
+      *key = current_;
+      *renew = false;
+      return true;
+    }
+    if (has_previous_ && memcmp(previous_.name, name, sizeof(previous_.name)) == 0) {
+      *key = previous_;
+      *renew = true;
+      return true;
+    }
+    return false;
+  }
+
+ private:
+  std::mutex mu_;
+  std::atomic<int> rotation_secs_ = 3600;
+  Key current_{}, previous_{};
+  bool has_current_ = false, has_previous_ = false;
+  int64_t created_at_ = 0;
+};
+
+SessionTicketKeys session_ticket_keys;
+
+// Return 1 if the ticket was encrypted or decrypted by the current key, 2 if it's decrypted by the
+// previous key and should be renewed, 0 if the key of the ticket wasn't found, and -1 if failed
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+int SessionTicketKeyCallback(SSL *, unsigned char *key_name, unsigned char *iv, EVP_CIPHER_CTX *ctx,
+                             EVP_MAC_CTX *hctx, int enc) {
+#else
+int SessionTicketKeyCallback(SSL *, unsigned char *key_name, unsigned char *iv, EVP_CIPHER_CTX *ctx, HMAC_CTX *hctx,
+                             int enc) {
+#endif
+  SessionTicketKeys::Key key;
+  int ret = 1;
+  if (enc) {
+    if (!session_ticket_keys.GetEncryptionKey(&key)) return -1;
+    if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1) return -1;
+    memcpy(key_name, key.name, sizeof(key.name));
+    if (EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.aes_key, iv) != 1) return -1;
+  } else {
+    bool renew = false;
+    if (!session_ticket_keys.GetDecryptionKey(key_name, &key, &renew)) return 0;
+    if (EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.aes_key, iv) != 1) return -1;
+    if (renew) ret = 2;
+  }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  char digest[] = "SHA256";
+  OSSL_PARAM params[] = {
+      OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac_key, sizeof(key.hmac_key)),
+      OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+      OSSL_PARAM_construct_end(),
+  };
+  if (EVP_MAC_CTX_set_params(hctx, params) != 1) return -1;
+#else
+  if (HMAC_Init_ex(hctx, key.hmac_key, sizeof(key.hmac_key), EVP_sha256(), nullptr) != 1) return -1;
+#endif
+  return ret;
+}
+
+}  // namespace
+
 UniqueSSLContext CreateSSLContext(const Config *config, const SSL_METHOD *method) {
   if (config->tls_cert_file.empty() || config->tls_key_file.empty()) {
     LOG(ERROR) << "Both tls-cert-file and tls-key-file must be specified while TLS is enabled";
@@ -144,6 +251,16 @@ UniqueSSLContext CreateSSLContext(const Config *config, const SSL_METHOD *method
 #ifdef SSL_OP_NO_CLIENT_RENEGOTIATION
   ctx_options |= SSL_OP_NO_CLIENT_RENEGOTIATION;
 #endif
+  if (!config->tls_session_tickets) {
+    ctx_options |= SSL_OP_NO_TICKET;
+  }
+  if (config->tls_ktls) {
+#ifdef SSL_OP_ENABLE_KTLS
+    ctx_options |= SSL_OP_ENABLE_KTLS;
+#else
+    LOG(WARNING) << "Kernel TLS isn't supported by the OpenSSL, tls-ktls is ignored";
+#endif
+  }
 
   if (config->tls_prefer_server_ciphers) {
     ctx_options |= SSL_OP_CIPHER_SERVER_PREFERENCE;
@@ -164,6 +281,18 @@ UniqueSSLContext CreateSSLContext(const Config *config, const SSL_METHOD *method
     SSL_CTX_set_session_cache_mode(ssl_ctx.get(), SSL_SESS_CACHE_OFF);
   }
 
+  if (config->tls_session_tickets) {
+    session_ticket_keys.SetRotation(config->tls_session_ticket_key_rotation);
+    // The sessions of the authenticated clients can be resumed only with the session id context
+    const char *session_id = "kvrocks";
+    SSL_CTX_set_session_id_context(ssl_ctx.get(), (const unsigned char *)session_id, strlen(session_id));
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ssl_ctx.get(), SessionTicketKeyCallback);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(ssl_ctx.get(), SessionTicketKeyCallback);
+#endif
+  }
+
   if (config->tls_auth_clients == TLS_AUTH_CLIENTS_NO) {
     SSL_CTX_set_verify(ssl_ctx.get(), SSL_VERIFY_NONE, nullptr);
   } else if (config->tls_auth_clients == TLS_AUTH_CLIENTS_OPTIONAL) {
@@ -25,7 +25,9 @@
 
 #include <string>
 
+#include "fmt/format.h"
 #include "io_util.h"
+#include "jemalloc_util.h"
 #include "thread_util.h"
 #include "time_util.h"
 
@@ -44,41 +46,48 @@
 #include <cctype>
 #include <cstring>
 #include <list>
+#include <random>
 #include <utility>
 
 #include "redis_connection.h"
 #include "redis_request.h"
 #include "server.h"
 #include "storage/scripting.h"
+#include "string_util.h"
 
-Worker::Worker(Server *svr, Config *config, bool repl) : svr_(svr) {
+Worker::Worker(Server *svr, Config *config, bool repl) : svr_(svr), idle_timers_(Util::GetTimeStamp()) {
   base_ = event_base_new();
   if (!base_) throw std::exception();
 
   timer_ = event_new(base_, -1, EV_PERSIST, TimerCB, this);
-  timeval tm = {10, 0};
+  timeval tm = {kTimerIntervalUS / 1000000, kTimerIntervalUS % 1000000};
   evtimer_add(timer_, &tm);
+  last_timer_us_ = Util::GetTimeStampUS();
 
-  int ports[3] = {config->port, config->tls_port, 0};
-  auto binds = config->binds;
+  lua_ = Lua::CreateState();
+  lua_memory_ = static_cast<int64_t>(lua_gc(lua_, LUA_GCCOUNT, 0)) * 1024;
 
-  for (int *port = ports; *port; ++port) {
-    for (const auto &bind : binds) {
-      Status s = listenTCP(bind, *port, config->backlog);
-      if (!s.IsOK()) {
-        LOG(ERROR) << "[worker] Failed to listen on: " << bind << ":" << *port << ", encounter error: " << s.Msg();
-        exit(1);
-      }
-      LOG(INFO) << "[worker] Listening on: " << bind << ":" << *port;
-    }
+  if (!repl && config->worker_offload_threads > 0) {
+    offload_runner_ = std::make_unique<TaskRunner>(config->worker_offload_threads);
+    offload_runner_->SetCPUAffinity(config->worker_cpus);
+    offload_runner_->Start();
   }
-  lua_ = Lua::CreateState(true);
 }
 
 Worker::~Worker() {
+  // The offloaded commands are still using the connections
+  if (offload_runner_) {
+    offload_runner_->Stop();
+    offload_runner_->Join();
+  }
+  {
+    std::lock_guard<std::mutex> guard(offload_callbacks_mu_);
+    for (auto done : offload_callbacks_) delete done;
+    offload_callbacks_.clear();
+  }
   std::list<Redis::Connection *> conns;
-  for (const auto &iter : conns_) {
-    conns.emplace_back(iter.second);
+  for (auto conn : conns_) {
+    if (conn) conns.emplace_back(conn);
   }
   for (const auto &iter : monitor_conns_) {
     conns.emplace_back(iter.second);
@@ -87,6 +96,7 @@ Worker::~Worker() {
     iter->Close();
   }
   event_free(timer_);
+  if (retire_timer_) event_free(retire_timer_);
   if (rate_limit_group_ != nullptr) {
     bufferevent_rate_limit_group_free(rate_limit_group_);
   }
@@ -100,8 +110,62 @@ Worker::~Worker() {
 void Worker::TimerCB(int, int16_t events, void *ctx) {
   auto worker = static_cast<Worker *>(ctx);
   auto config = worker->svr_->GetConfig();
-  if (config->timeout == 0) return;
+  auto now_us = Util::GetTimeStampUS();
+  if (now_us > worker->last_timer_us_ + kTimerIntervalUS) {
+    auto lag_us = now_us - worker->last_timer_us_ - kTimerIntervalUS;
+    worker->svr_->storage_->GetLatencyMonitor()->Record("eventloop", lag_us / 1000);
+  }
+  worker->last_timer_us_ = now_us;
+  worker->lua_memory_.store(static_cast<int64_t>(lua_gc(worker->lua_, LUA_GCCOUNT, 0)) * 1024,
+                            std::memory_order_relaxed);
   worker->KickoutIdleClients(config->timeout);
+  worker->ShrinkIdleClientsBuffers(config->client_buffer_shrink_idle);
+}
+
+void Worker::offloadDoneCB(int, int16_t events, void *ctx) {
+  auto done = static_cast<OffloadCallback *>(ctx);
+  {
+    std::lock_guard<std::mutex> guard(done->worker->offload_callbacks_mu_);
+    done->worker->offload_callbacks_.erase(done);
+  }
+  done->callback();
+  delete done;
+}
+
+void Worker::retireCB(int, int16_t events, void *ctx) {
+  auto worker = static_cast<Worker *>(ctx);
+  worker->stopListening();
+  worker->svr_->MigrateConnections(worker);
+  if (worker->ConnectionsCount() == 0 && worker->pending_handshakes_ == 0) {
+    evtimer_del(worker->retire_timer_);
+    worker->retired_.store(true, std::memory_order_release);
+  }
+}
+
+void Worker::Retire() {
+  if (retiring_.exchange(true)) return;
+  // The listeners and the connections are only touched in the thread of the worker
+  retire_timer_ = event_new(base_, -1, EV_PERSIST, retireCB, this);
+  timeval tm = {0, kRetireIntervalUS};
+  evtimer_add(retire_timer_, &tm);
+}
+
+Status Worker::Offload(const Task &task, const Task &callback, TaskRunner *runner) {
+  if (!runner) runner = offload_runner_.get();
+  if (!runner) {
+    return {Status::NotOK, "the offload threads are disabled"};
+  }
+  return runner->Publish([this, task, callback]() {
+    task();
+    auto done = new OffloadCallback{this, callback};
+    std::lock_guard<std::mutex> guard(offload_callbacks_mu_);
+    if (event_base_once(base_, -1, EV_TIMEOUT, offloadDoneCB, done, nullptr) != 0) {
+      LOG(ERROR) << "[worker] Failed to notify the worker that the offloaded task was done";
+      delete done;
+      return;
+    }
+    offload_callbacks_.emplace(done);
+  });
 }
 
 void Worker::newTCPConnection(evconnlistener *listener, evutil_socket_t fd, sockaddr *address, int socklen, void *ctx) {
@@ -133,6 +197,13 @@ void Worker::newTCPConnection(evconnlistener *listener, evutil_socket_t fd, sock
       evutil_closesocket(fd);
       return;
     }
+    // The handshake is offloaded, and the established connection comes back to this worker
+    if (auto handshaker = worker->svr_->GetTLSHandshaker()) {
+      worker->pending_handshakes_++;
+      handshaker->Accept(fd, ssl, worker->svr_->GetConfig()->tls_handshake_timeout,
+                         [worker, fd](SSL *ssl) { worker->tlsHandshakeDone(fd, ssl); });
+      return;
+    }
     bev = bufferevent_openssl_socket_new(base, fd, ssl, BUFFEREVENT_SSL_ACCEPTING, evThreadSafeFlags);
   } else {
     bev = bufferevent_socket_new(base, fd, evThreadSafeFlags);
@@ -156,10 +227,14 @@ void Worker::newTCPConnection(evconnlistener *listener, evutil_socket_t fd, sock
     bufferevent_openssl_set_allow_dirty_shutdown(bev, 1);
   }
 #endif
-  auto conn = new Redis::Connection(bev, worker);
+  worker->serveTCPConnection(bev, fd);
+}
+
+void Worker::serveTCPConnection(bufferevent *bev, evutil_socket_t fd) {
+  auto conn = new Redis::Connection(bev, this);
   bufferevent_setcb(bev, Redis::Connection::OnRead, Redis::Connection::OnWrite, Redis::Connection::OnEvent, conn);
   bufferevent_enable(bev, EV_READ);
-  Status status = worker->AddConnection(conn);
+  Status status = AddConnection(conn);
   if (!status.IsOK()) {
     std::string err_msg = Redis::Error("ERR " + status.Msg());
     Util::SockSend(fd, err_msg);
@@ -171,10 +246,52 @@ void Worker::newTCPConnection(evconnlistener *listener, evutil_socket_t fd, sock
   if (Util::GetPeerAddr(fd, &ip, &port) == 0) {
     conn->SetAddr(ip, port);
   }
-  if (worker->rate_limit_group_ != nullptr) {
-    bufferevent_add_to_rate_limit_group(bev, worker->rate_limit_group_);
+  if (rate_limit_group_ != nullptr) {
+    bufferevent_add_to_rate_limit_group(bev, rate_limit_group_);
+  }
+}
+
+#ifdef ENABLE_OPENSSL
+// The connection whose TLS handshake was done by the handshaker, it's served by the worker which accepted it
+struct TLSEstablishedConnection {
+  Worker *worker;
+  evutil_socket_t fd;
+  SSL *ssl;
+};
+
+void Worker::tlsHandshakeDone(evutil_socket_t fd, SSL *ssl) {
+  if (!ssl) {
+    pending_handshakes_--;
+    return;
+  }
+  auto established = new TLSEstablishedConnection{this, fd, ssl};
+  if (event_base_once(base_, -1, EV_TIMEOUT, tlsEstablishedCB, established, nullptr) != 0) {
+    LOG(ERROR) << "[worker] Failed to hand the established TLS connection to the worker";
+    SSL_free(ssl);
+    evutil_closesocket(fd);
+    pending_handshakes_--;
+    delete established;
+  }
+}
+
+void Worker::tlsEstablishedCB(int, int16_t events, void *ctx) {
+  auto established = static_cast<TLSEstablishedConnection *>(ctx);
+  auto worker = established->worker;
+  auto evThreadSafeFlags = BEV_OPT_THREADSAFE | BEV_OPT_DEFER_CALLBACKS | BEV_OPT_UNLOCK_CALLBACKS;
+  bufferevent *bev = bufferevent_openssl_socket_new(worker->base_, established->fd, established->ssl,
+                                                    BUFFEREVENT_SSL_OPEN, evThreadSafeFlags);
+  if (!bev) {
+    LOG(ERROR) << "Failed to construct socket for new connection, SSL error: " << SSLErrors{};
+    SSL_free(established->ssl);
+    evutil_closesocket(established->fd);
+  } else {
+    bufferevent_openssl_set_allow_dirty_shutdown(bev, 1);
+    worker->serveTCPConnection(bev, established->fd);
   }
+  worker->pending_handshakes_--;
+  delete established;
 }
+#endif
 
 void Worker::newUnixSocketConnection(evconnlistener *listener, evutil_socket_t fd, sockaddr *address, int socklen,
                                      void *ctx) {
@@ -200,6 +317,20 @@ void Worker::newUnixSocketConnection(evconnlistener *listener, evutil_socket_t f
   }
 }
 
+Status Worker::Listen(Config *config) {
+  int ports[3] = {config->port, config->tls_port, 0};
+  for (int *port = ports; *port; ++port) {
+    for (const auto &bind : config->binds) {
+      Status s = listenTCP(bind, *port, config->backlog);
+      if (!s.IsOK()) {
+        return {Status::NotOK, fmt::format("failed to listen on {}:{}, err: {}", bind, *port, s.Msg())};
+      }
+      LOG(INFO) << "[worker] Listening on: " << bind << ":" << *port;
+    }
+  }
+  return Status::OK();
+}
+
 Status Worker::listenTCP(const std::string &host, int port, int backlog) {
   int af = 0, rv = 0, fd = 0, sock_opt = 1;
 
@@ -226,7 +357,8 @@ Status Worker::listenTCP(const std::string &host, int port, int backlog) {
     if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &sock_opt, sizeof(sock_opt)) < 0) {
       goto error;
     }
-    // to support multi-thread binding on macOS
+    // every worker binds its own socket to the same address, so that the
+    // kernel balances the accepts among workers (also required on macOS)
     if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &sock_opt, sizeof(sock_opt)) < 0) {
       goto error;
     }
@@ -235,6 +367,7 @@ Status Worker::listenTCP(const std::string &host, int port, int backlog) {
     }
     evutil_make_socket_nonblocking(fd);
     auto lev = evconnlistener_new(base_, newTCPConnection, this, LEV_OPT_CLOSE_ON_FREE, backlog, fd);
+    std::lock_guard<std::mutex> guard(listen_mu_);
     listen_events_.emplace_back(lev);
   }
 
@@ -263,7 +396,10 @@ Status Worker::ListenUnixSocket(const std::string &path, int perm, int backlog)
   }
   evutil_make_socket_nonblocking(fd);
   auto lev = evconnlistener_new(base_, newUnixSocketConnection, this, LEV_OPT_CLOSE_ON_FREE, backlog, fd);
-  listen_events_.emplace_back(lev);
+  {
+    std::lock_guard<std::mutex> guard(listen_mu_);
+    listen_events_.emplace_back(lev);
+  }
   if (perm != 0) {
     chmod(sa.sun_path, (mode_t)perm);
   }
@@ -279,43 +415,55 @@ void Worker::Run(std::thread::id tid) {
 
 void Worker::Stop() {
   event_base_loopbreak(base_);
+  stopListening();
+}
+
+void Worker::stopListening() {
+  std::lock_guard<std::mutex> guard(listen_mu_);
   for (const auto &lev : listen_events_) {
     evutil_socket_t fd = evconnlistener_get_fd(lev);
     if (fd > 0) close(fd);
     evconnlistener_free(lev);
   }
+  listen_events_.clear();
 }
 
 Status Worker::AddConnection(Redis::Connection *c) {
   std::unique_lock<std::mutex> lock(conns_mu_);
-  auto iter = conns_.find(c->GetFD());
-  if (iter != conns_.end()) {
+  int fd = c->GetFD();
+  if (lookupConnection(fd)) {
     return Status(Status::NotOK, "connection was exists");
   }
   int max_clients = svr_->GetConfig()->maxclients;
   if (svr_->IncrClientNum() >= max_clients) {
     svr_->DecrClientNum();
+    rejected_conns_++;
     return Status(Status::NotOK, "max number of clients reached");
   }
-  conns_.insert(std::pair<int, Redis::Connection *>(c->GetFD(), c));
+  accepted_conns_++;
+  if (static_cast<size_t>(fd) >= conns_.size()) conns_.resize(fd + 1, nullptr);
+  conns_[fd] = c;
+  conns_num_++;
   uint64_t id = svr_->GetClientID()->fetch_add(1, std::memory_order_relaxed);
   c->SetID(id);
+  if (idle_timeout_ > 0) addIdleTimer(c, Util::GetTimeStamp() + idle_timeout_);
   return Status::OK();
 }
 
 Redis::Connection *Worker::removeConnection(int fd) {
   Redis::Connection *conn = nullptr;
   std::unique_lock<std::mutex> lock(conns_mu_);
-  auto iter = conns_.find(fd);
-  if (iter != conns_.end()) {
-    conn = iter->second;
-    conns_.erase(iter);
+  if (auto c = lookupConnection(fd)) {
+    conn = c;
+    conns_[fd] = nullptr;
+    conns_num_--;
     svr_->DecrClientNum();
   }
-  iter = monitor_conns_.find(fd);
+  auto iter = monitor_conns_.find(fd);
   if (iter != monitor_conns_.end()) {
     conn = iter->second;
     monitor_conns_.erase(iter);
+    monitor_filters_.erase(fd);
     svr_->DecrClientNum();
     svr_->DecrMonitorClientNum();
   }
@@ -349,19 +497,21 @@ void Worker::FreeConnection(Redis::Connection *conn) {
 
 void Worker::FreeConnectionByID(int fd, uint64_t id) {
   std::unique_lock<std::mutex> lock(conns_mu_);
-  auto conn_iter = conns_.find(fd);
-  if (conn_iter != conns_.end() && conn_iter->second->GetID() == id) {
+  auto conn = lookupConnection(fd);
+  if (conn && conn->GetID() == id) {
     if (rate_limit_group_ != nullptr) {
-      bufferevent_remove_from_rate_limit_group(conn_iter->second->GetBufferEvent());
+      bufferevent_remove_from_rate_limit_group(conn->GetBufferEvent());
     }
-    delete conn_iter->second;
-    conns_.erase(conn_iter);
+    delete conn;
+    conns_[fd] = nullptr;
+    conns_num_--;
     svr_->DecrClientNum();
   }
   auto monitor_conn_iter = monitor_conns_.find(fd);
   if (monitor_conn_iter != monitor_conns_.end() && monitor_conn_iter->second->GetID() == id) {
     delete monitor_conn_iter->second;
     monitor_conns_.erase(monitor_conn_iter);
+    monitor_filters_.erase(fd);
     svr_->DecrClientNum();
     svr_->DecrMonitorClientNum();
   }
@@ -369,68 +519,221 @@ void Worker::FreeConnectionByID(int fd, uint64_t id) {
 
 Status Worker::EnableWriteEvent(int fd) {
   std::unique_lock<std::mutex> lock(conns_mu_);
-  auto iter = conns_.find(fd);
-  if (iter != conns_.end()) {
-    auto bev = iter->second->GetBufferEvent();
-    bufferevent_enable(bev, EV_WRITE);
+  if (auto conn = lookupConnection(fd)) {
+    bufferevent_enable(conn->GetBufferEvent(), EV_WRITE);
     return Status::OK();
   }
   return Status(Status::NotOK);
 }
 
+void Worker::EnableWriteEvents(const std::vector<int> &fds) {
+  std::unique_lock<std::mutex> lock(conns_mu_);
+  for (int fd : fds) {
+    if (auto conn = lookupConnection(fd)) bufferevent_enable(conn->GetBufferEvent(), EV_WRITE);
+  }
+}
+
 Status Worker::Reply(int fd, const std::string &reply) {
   std::unique_lock<std::mutex> lock(conns_mu_);
-  auto iter = conns_.find(fd);
-  if (iter != conns_.end()) {
-    iter->second->SetLastInteraction();
-    Redis::Reply(iter->second->Output(), reply);
+  if (auto conn = lookupConnection(fd)) {
+    conn->SetLastInteraction();
+    conn->ReplyMessage(reply);
     return Status::OK();
   }
   return Status(Status::NotOK, "connection doesn't exist");
 }
 
-void Worker::BecomeMonitorConn(Redis::Connection *conn) {
+int Worker::Reply(const std::vector<int> &fds, const std::string &reply) {
+  int cnt = 0;
+  std::unique_lock<std::mutex> lock(conns_mu_);
+  for (int fd : fds) {
+    auto conn = lookupConnection(fd);
+    if (!conn) continue;
+    conn->SetLastInteraction();
+    conn->ReplyMessage(reply);
+    cnt++;
+  }
+  return cnt;
+}
+
+int Worker::SendInvalidations(const std::map<uint64_t, Invalidation> &invalidations) {
+  int cnt = 0;
+  std::unique_lock<std::mutex> lock(conns_mu_);
+  for (const auto &[id, invalidation] : invalidations) {
+    auto conn = lookupConnection(invalidation.fd);
+    if (!conn || conn->GetID() != id) continue;
+    std::string reply = Redis::MultiLen(3) + Redis::BulkString("message") + Redis::BulkString(kTrackingChannel);
+    if (invalidation.flush) {
+      reply.append(Redis::MultiLen(-1));
+    } else {
+      reply.append(Redis::MultiBulkString(
+          std::vector<std::string>(invalidation.keys.begin(), invalidation.keys.end()), false));
+    }
+    conn->ReplyMessage(reply);
+    cnt++;
+  }
+  return cnt;
+}
+
+int Worker::FindConnectionFD(uint64_t id) {
+  std::unique_lock<std::mutex> lock(conns_mu_);
+  for (const auto conn : conns_) {
+    if (conn && conn->GetID() == id) return conn->GetFD();
+  }
+  return -1;
+}
+
+bool MonitorFilter::Match(const MonitorEntry &entry) const {
+  if (!commands.empty() && commands.count(entry.cmd) == 0) return false;
+  if (prefixes.empty()) return true;
+  return std::any_of(prefixes.begin(), prefixes.end(),
+                     [&entry](const std::string &prefix) { return Util::HasPrefix(entry.key, prefix); });
+}
+
+void Worker::BecomeMonitorConn(Redis::Connection *conn, const MonitorFilter &filter) {
   {
     std::lock_guard<std::mutex> guard(conns_mu_);
-    conns_.erase(conn->GetFD());
+    if (lookupConnection(conn->GetFD()) == conn) {
+      conns_[conn->GetFD()] = nullptr;
+      conns_num_--;
+    }
     monitor_conns_[conn->GetFD()] = conn;
+    monitor_filters_[conn->GetFD()] = filter;
   }
   svr_->IncrMonitorClientNum();
+  svr_->RaiseMonitorSampleRatio(filter.sample_ratio);
   conn->EnableFlag(Redis::Connection::kMonitor);
 }
 
-void Worker::FeedMonitorConns(Redis::Connection *conn, const std::vector<std::string> &tokens) {
-  auto now = Util::GetTimeStampUS();
-  std::string output;
-  output += std::to_string(now / 1000000) + "." + std::to_string(now % 1000000);
-  output += " [" + conn->GetNamespace() + " " + conn->GetAddr() + "]";
-  for (const auto &token : tokens) {
-    output += " \"" + token + "\"";
-  }
+double Worker::FeedMonitorConns(const std::vector<MonitorEntry> &entries) {
+  // Only the monitor feeder calls this, so the generator is never shared
+  static std::mt19937 gen(std::random_device{}());
+  std::uniform_real_distribution<double> dist(0, 1);
+
+  double max_sample_ratio = 0;
   std::unique_lock<std::mutex> lock(conns_mu_);
   for (const auto &iter : monitor_conns_) {
-    if (conn == iter.second) continue;  // skip the monitor command
-    if (conn->GetNamespace() == iter.second->GetNamespace() || iter.second->GetNamespace() == kDefaultNamespace) {
-      iter.second->Reply(Redis::SimpleString(output));
+    auto monitor = iter.second;
+    const auto &filter = monitor_filters_[iter.first];
+    max_sample_ratio = std::max(max_sample_ratio, filter.sample_ratio);
+
+    std::string output;
+    for (const auto &entry : entries) {
+      if (entry.conn_id == monitor->GetID()) continue;  // skip the monitor command
+      if (entry.ns != monitor->GetNamespace() && monitor->GetNamespace() != kDefaultNamespace) continue;
+      if (!filter.Match(entry)) continue;
+      // The entries were sampled with the max ratio of all monitors, sample them again for this monitor
+      if (filter.sample_ratio < entry.sample_ratio && dist(gen) * entry.sample_ratio >= filter.sample_ratio) continue;
+      output += Redis::SimpleString(entry.line);
     }
+    if (!output.empty()) monitor->Reply(output);
   }
+  return max_sample_ratio;
 }
 
 std::string Worker::GetClientsStr() {
   std::unique_lock<std::mutex> lock(conns_mu_);
   std::string output;
-  for (const auto &iter : conns_) {
-    Redis::Connection *conn = iter.second;
-    output.append(conn->ToString());
+  for (auto conn : conns_) {
+    if (conn) output.append(conn->ToString());
   }
   return output;
 }
 
+void Worker::GetConnectionsMemory(size_t *connections, size_t *input_bytes, size_t *output_bytes) {
+  *connections = *input_bytes = *output_bytes = 0;
+  std::lock_guard<std::mutex> guard(conns_mu_);
+  auto add_connection = [&](Redis::Connection *conn) {
+    ++*connections;
+    *input_bytes += evbuffer_get_length(conn->Input());
+    *output_bytes += evbuffer_get_length(conn->Output());
+  };
+  for (auto conn : conns_) {
+    if (conn) add_connection(conn);
+  }
+  for (const auto &iter : monitor_conns_) add_connection(iter.second);
+}
+
+// The accepts were balanced among workers by the kernel since every worker
+// listens on its own SO_REUSEPORT socket, the stats help to verify that.
+std::string Worker::GetConnectionsStats() {
+  size_t connected = 0;
+  {
+    std::lock_guard<std::mutex> guard(conns_mu_);
+    connected = conns_num_ + monitor_conns_.size();
+  }
+  return fmt::format("accepted={},rejected={},connected={}", accepted_conns_.load(), rejected_conns_.load(),
+                     connected);
+}
+
+size_t Worker::ConnectionsCount() {
+  std::lock_guard<std::mutex> guard(conns_mu_);
+  return conns_num_ + monitor_conns_.size();
+}
+
+size_t Worker::MigrateConnections(const std::vector<Worker *> &targets) {
+  if (targets.empty()) return 0;
+  // The connections are identified by the fd and the id, since they may be freed by the other threads
+  std::vector<std::pair<int, uint64_t>> conns;
+  {
+    std::lock_guard<std::mutex> guard(conns_mu_);
+    for (auto conn : conns_) {
+      if (conn && conn->IsMigratable()) conns.emplace_back(conn->GetFD(), conn->GetID());
+    }
+  }
+  std::vector<size_t> target_conns;
+  for (auto target : targets) target_conns.emplace_back(target->ConnectionsCount());
+
+  size_t moved = 0;
+  for (const auto &[fd, id] : conns) {
+    auto i = std::min_element(target_conns.begin(), target_conns.end()) - target_conns.begin();
+    auto bev = bufferevent_socket_new(targets[i]->base_, fd,
+                                      BEV_OPT_THREADSAFE | BEV_OPT_DEFER_CALLBACKS | BEV_OPT_UNLOCK_CALLBACKS);
+    if (!bev) break;
+    Redis::Connection *conn = nullptr;
+    {
+      std::lock_guard<std::mutex> guard(conns_mu_);
+      conn = lookupConnection(fd);
+      // The connection was closed, or it became busy since it was collected
+      if (!conn || conn->GetID() != id || !conn->IsMigratable()) {
+        bufferevent_free(bev);
+        continue;
+      }
+      conns_[fd] = nullptr;
+      conns_num_--;
+    }
+    if (rate_limit_group_ != nullptr) {
+      bufferevent_remove_from_rate_limit_group(conn->GetBufferEvent());
+    }
+    conn->MoveTo(targets[i], bev);
+    targets[i]->adoptConnection(conn);
+    target_conns[i]++;
+    moved++;
+  }
+  return moved;
+}
+
+void Worker::adoptConnection(Redis::Connection *conn) {
+  std::lock_guard<std::mutex> guard(conns_mu_);
+  int fd = conn->GetFD();
+  if (static_cast<size_t>(fd) >= conns_.size()) conns_.resize(fd + 1, nullptr);
+  conns_[fd] = conn;
+  conns_num_++;
+  if (idle_timeout_ > 0) {
+    addIdleTimer(conn, Util::GetTimeStamp() + std::max(0, idle_timeout_ - static_cast<int>(conn->GetIdleTime())));
+  }
+  if (rate_limit_group_ != nullptr) {
+    bufferevent_add_to_rate_limit_group(conn->GetBufferEvent(), rate_limit_group_);
+  }
+  // The events are enabled after the connection was added, so that its callbacks could find it
+  conn->ResumeAfterMove();
+}
+
 void Worker::KillClient(Redis::Connection *self, uint64_t id, const std::string &addr, uint64_t type, bool skipme,
                         int64_t *killed) {
   std::lock_guard<std::mutex> guard(conns_mu_);
-  for (const auto &iter : conns_) {
-    Redis::Connection *conn = iter.second;
+  for (auto conn : conns_) {
+    if (!conn) continue;
     if (skipme && self == conn) continue;
     // no need to kill the client again if flags as kCloseAfterReply
     if (conn->IsFlagEnabled(Redis::Connection::kCloseAfterReply)) {
@@ -453,30 +756,58 @@ void Worker::KickoutIdleClients(int timeout) {
   std::list<std::pair<int, uint64_t>> to_be_killed_conns;
   {
     std::lock_guard<std::mutex> guard(conns_mu_);
-    if (conns_.empty()) {
-      return;
-    }
-    int iterations = std::min(static_cast<int>(conns_.size()), 50);
-    auto iter = conns_.upper_bound(last_iter_conn_fd);
-    while (iterations--) {
-      if (iter == conns_.end()) iter = conns_.begin();
-      if (static_cast<int>(iter->second->GetIdleTime()) >= timeout) {
-        to_be_killed_conns.emplace_back(iter->first, iter->second->GetID());
+    uint64_t now = Util::GetTimeStamp();
+    if (timeout != idle_timeout_) {
+      // Reschedule all connections since the timeout was changed, the stale timers are ignored when fired
+      idle_timeout_ = timeout;
+      idle_timers_ = TimerWheel<std::pair<int, uint64_t>>(now);
+      if (timeout > 0) {
+        for (auto conn : conns_) {
+          if (conn) addIdleTimer(conn, now + std::max(0, timeout - static_cast<int>(conn->GetIdleTime())));
+        }
       }
-      iter++;
     }
-    iter--;
-    last_iter_conn_fd = iter->first;
+    if (timeout <= 0) return;
+
+    // Only the connections whose timers are due are checked, the active ones are rescheduled
+    idle_timers_.Advance(now, [&](std::pair<int, uint64_t> &&timer) {
+      auto conn = lookupConnection(timer.first);
+      if (!conn || conn->GetID() != timer.second) return;  // the connection was freed
+      int idle = static_cast<int>(conn->GetIdleTime());
+      // The connection was owned by the offload threads until the command was done
+      if (conn->IsOffloading() || idle < timeout) {
+        addIdleTimer(conn, now + std::max(1, timeout - idle));
+        return;
+      }
+      to_be_killed_conns.emplace_back(timer);
+    });
   }
   for (const auto &conn : to_be_killed_conns) {
     FreeConnectionByID(conn.first, conn.second);
   }
 }
 
+void Worker::ShrinkIdleClientsBuffers(int idle) {
+  if (idle <= 0) return;
+  std::lock_guard<std::mutex> guard(conns_mu_);
+  for (auto conn : conns_) {
+    if (conn && static_cast<int>(conn->GetIdleTime()) >= idle) conn->ShrinkBuffers();
+  }
+}
+
 void WorkerThread::Start() {
   try {
     t_ = std::thread([this]() {
       Util::ThreadSetName("worker");
+      if (auto s = Util::ThreadSetAffinity(worker_->svr_->GetConfig()->worker_cpus); !s.IsOK()) {
+        LOG(WARNING) << "[worker] Failed to set the cpu affinity of worker thread, err: " << s.Msg();
+      }
+      // The worker keeps the thread cache, its allocations are mostly the small and short-lived buffers
+      if (worker_->svr_->GetConfig()->jemalloc_dedicated_arenas) {
+        if (auto s = Util::ThreadSetDedicatedArena(); !s.IsOK()) {
+          LOG(WARNING) << "[worker] Failed to set the jemalloc arena of worker thread, err: " << s.Msg();
+        }
+      }
       this->worker_->Run(std::this_thread::get_id());
     });
   } catch (const std::system_error &e) {
@@ -24,23 +24,56 @@
 #include <event2/bufferevent.h>
 #include <event2/listener.h>
 #include <event2/util.h>
+#ifdef ENABLE_OPENSSL
+#include <openssl/ssl.h>
+#endif
 
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <lua.hpp>
 #include <map>
 #include <memory>
+#include <optional>
+#include <set>
 #include <string>
 #include <thread>
 #include <utility>
 #include <vector>
 
+#include "client_tracking.h"
 #include "redis_connection.h"
+#include "reply_coalescer.h"
+#include "spsc_queue.h"
+#include "stats/hot_keys.h"
 #include "storage/storage.h"
+#include "task_runner.h"
+#include "timer_wheel.h"
 
 class Server;
 
+// The executed command which is queued by the worker of the client, then fed to the monitors asynchronously
+struct MonitorEntry {
+  std::string ns;
+  uint64_t conn_id = 0;
+  std::string cmd;  // the lowercase command name
+  std::string key;  // the first argument, or empty if the command has no argument
+  std::string line;
+  double sample_ratio = 1.0;  // the ratio which the entry was sampled with
+};
+
+// The options of MONITOR [SAMPLE ratio] [COMMAND name]... [PREFIX prefix]...
+struct MonitorFilter {
+  double sample_ratio = 1.0;
+  std::set<std::string> commands;
+  std::vector<std::string> prefixes;
+
+  bool Match(const MonitorEntry &entry) const;
+};
+
+constexpr size_t kMonitorQueueSize = 4096;
+
 class Worker {
  public:
   Worker(Server *svr, Config *config, bool repl = false);
@@ -55,18 +88,62 @@ class Worker {
   void FreeConnectionByID(int fd, uint64_t id);
   Status AddConnection(Redis::Connection *c);
   Status EnableWriteEvent(int fd);
+  bool IsRateLimited() const { return rate_limit_group_ != nullptr; }
+  // Enable the write events of the connections under one lock
+  void EnableWriteEvents(const std::vector<int> &fds);
   Status Reply(int fd, const std::string &reply);
-  void BecomeMonitorConn(Redis::Connection *conn);
-  void FeedMonitorConns(Redis::Connection *conn, const std::vector<std::string> &tokens);
+  // Reply to the connections under one lock, return the number of the connections which exist
+  int Reply(const std::vector<int> &fds, const std::string &reply);
+  // Deliver the invalidations to their targets in this worker under one lock, they're sent as
+  // the messages of the channel __redis__:invalidate. Return the number of the targets which exist
+  int SendInvalidations(const std::map<uint64_t, Invalidation> &invalidations);
+  // Return the fd of the connection of the id, or -1 if it isn't in this worker
+  int FindConnectionFD(uint64_t id);
+  void BecomeMonitorConn(Redis::Connection *conn, const MonitorFilter &filter = {});
+  // Queue the monitor entry without locks, it's only called in the thread of the worker,
+  // and returns false if the queue is full
+  bool PushMonitorEntry(MonitorEntry &&entry) { return monitor_queue_.TryPush(std::move(entry)); }
+  // Only called by the monitor feeder of the server, which is the single consumer of the queues
+  std::optional<MonitorEntry> PopMonitorEntry() { return monitor_queue_.TryPop(); }
+  // Feed the entries to the monitors of this worker, return the max sample ratio of the monitors
+  double FeedMonitorConns(const std::vector<MonitorEntry> &entries);
 
   std::string GetClientsStr();
+  std::string GetConnectionsStats();
+  // The number of the connections and the bytes in their input and output buffers
+  void GetConnectionsMemory(size_t *connections, size_t *input_bytes, size_t *output_bytes);
   void KillClient(Redis::Connection *self, uint64_t id, const std::string &addr, uint64_t type, bool skipme,
                   int64_t *killed);
   void KickoutIdleClients(int timeout);
+  // Release the buffers of the connections which were idle for the seconds
+  void ShrinkIdleClientsBuffers(int idle);
 
+  // Run the task in the offload threads, or the threads of the runner if it's specified,
+  // then the callback would be invoked in the event loop of the worker after the task was done.
+  bool IsOffloadEnabled() { return offload_runner_ != nullptr; }
+  Status Offload(const Task &task, const Task &callback, TaskRunner *runner = nullptr);
+
+  // Listen on the port and the tls-port of the binds, the sockets share the addresses
+  // with the other workers by SO_REUSEPORT
+  Status Listen(Config *config);
   Status ListenUnixSocket(const std::string &path, int perm, int backlog);
 
+  // Stop accepting the new connections and move the idle connections to the active workers,
+  // the others, e.g. the subscribers and the blocked clients, stay until they're closed.
+  // It's retired once it has no connection, then it can be stopped and freed.
+  void Retire();
+  bool IsRetiring() { return retiring_.load(std::memory_order_relaxed); }
+  bool IsRetired() { return retired_.load(std::memory_order_acquire); }
+  size_t ConnectionsCount();
+  // Move the migratable connections to the workers in turn of their connections, it's only
+  // called in the thread of this worker, return the number of the connections which were moved
+  size_t MigrateConnections(const std::vector<Worker *> &targets);
+
   lua_State *Lua() { return lua_; }
+  // The memory of the Lua state in bytes, it's sampled by the timer since the state is only accessed by the worker
+  int64_t GetLuaMemory() { return lua_memory_.load(std::memory_order_relaxed); }
+  HotKeys *GetHotKeys() { return &hot_keys_; }
+  ReplyCoalescer *GetReplyCoalescer() { return &reply_coalescer_; }
   Server *svr_;
 
  private:
@@ -74,21 +151,70 @@ class Worker {
   static void newTCPConnection(evconnlistener *listener, evutil_socket_t fd, sockaddr *address, int socklen, void *ctx);
   static void newUnixSocketConnection(evconnlistener *listener, evutil_socket_t fd, sockaddr *address, int socklen,
                                       void *ctx);
+  void serveTCPConnection(bufferevent *bev, evutil_socket_t fd);
+#ifdef ENABLE_OPENSSL
+  // Called in the thread of the TLS handshaker, the established connection is served in the event loop
+  void tlsHandshakeDone(evutil_socket_t fd, SSL *ssl);
+  static void tlsEstablishedCB(int, int16_t events, void *ctx);
+#endif
   static void TimerCB(int, int16_t events, void *ctx);
+  static void offloadDoneCB(int, int16_t events, void *ctx);
+  static void retireCB(int, int16_t events, void *ctx);
+  void stopListening();
+  // Take over the connection which was moved from the other worker, the id is kept
+  void adoptConnection(Redis::Connection *conn);
   Redis::Connection *removeConnection(int fd);
+  Redis::Connection *lookupConnection(int fd) const {
+    return fd >= 0 && static_cast<size_t>(fd) < conns_.size() ? conns_[fd] : nullptr;
+  }
+  void addIdleTimer(Redis::Connection *conn, uint64_t deadline) {
+    idle_timers_.Add({conn->GetFD(), conn->GetID()}, deadline);
+  }
 
   event_base *base_;
   event *timer_;
+  // The timer fires every kTimerIntervalUS, the delay of its callback measures the stall of the event loop
+  static constexpr uint64_t kTimerIntervalUS = 1000000;
+  uint64_t last_timer_us_ = 0;
   std::thread::id tid_;
+  std::mutex listen_mu_;
   std::vector<evconnlistener *> listen_events_;
+  // The timer retries to move the connections of the retiring worker every kRetireIntervalUS
+  static constexpr uint64_t kRetireIntervalUS = 100000;
+  event *retire_timer_ = nullptr;
+  std::atomic<bool> retiring_ = false;
+  std::atomic<bool> retired_ = false;
+  // The TLS connections accepted by this worker whose handshakes are offloaded, it can't retire until they're done
+  std::atomic<int> pending_handshakes_ = 0;
   std::mutex conns_mu_;
-  std::map<int, Redis::Connection *> conns_;
+  // The connections are indexed by the fds, which are small integers reused by the kernel
+  std::vector<Redis::Connection *> conns_;
+  size_t conns_num_ = 0;
   std::map<int, Redis::Connection *> monitor_conns_;
-  int last_iter_conn_fd = 0;  // fd of last processed connection in previous cron
+  std::map<int, MonitorFilter> monitor_filters_;
+  SPSCQueue<MonitorEntry> monitor_queue_{kMonitorQueueSize};
+  // The idle timers of the connections which are identified by the fd and the id, they're checked
+  // lazily, so the interactions don't need to reschedule them
+  TimerWheel<std::pair<int, uint64_t>> idle_timers_;
+  int idle_timeout_ = 0;  // the timeout which the idle timers were scheduled with
+  std::atomic<uint64_t> accepted_conns_ = 0;
+  std::atomic<uint64_t> rejected_conns_ = 0;
 
   struct bufferevent_rate_limit_group *rate_limit_group_ = nullptr;
   struct ev_token_bucket_cfg *rate_limit_group_cfg_ = nullptr;
   lua_State *lua_;
+  std::atomic<int64_t> lua_memory_ = 0;
+  std::unique_ptr<TaskRunner> offload_runner_;
+  struct OffloadCallback {
+    Worker *worker;
+    Task callback;
+  };
+  // The callbacks of the offloaded tasks which are done but not run by the event loop yet,
+  // they're freed without being run if the worker is destroyed
+  std::mutex offload_callbacks_mu_;
+  std::set<OffloadCallback *> offload_callbacks_;
+  HotKeys hot_keys_;
+  ReplyCoalescer reply_coalescer_;
 };
 
 class WorkerThread {
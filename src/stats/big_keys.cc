@@ -0,0 +1,184 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "big_keys.h"
+
+#include <rocksdb/db.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "disk_stats.h"
+#include "storage/storage.h"
+#include "types/redis_string.h"
+
+void BigKeys::SetEnabled(bool enabled) {
+  enabled_ = enabled;
+  if (!enabled) Clear();
+}
+
+bool BigKeys::DecodeSize(const rocksdb::Slice &value, RedisType *type, uint64_t *size) {
+  // Only the common fields are decoded, which are in the first bytes in both encodings
+  constexpr size_t kMaxCommonFieldsSize = 1 + 8 + 10 + 5;
+  Metadata metadata(kRedisNone, false);
+  if (!metadata.Decode(std::string(value.data(), std::min(value.size(), kMaxCommonFieldsSize))).ok()) return false;
+  if (metadata.Expired()) return false;
+  *type = metadata.Type();
+  // The value of the string follows its header unless it's chunked
+  *size = *type == kRedisString && !metadata.IsChunkedString() ? value.size() - Redis::STRING_HDR_SIZE : metadata.size;
+  return true;
+}
+
+bool BigKeys::Admits(const std::string &ns, RedisType type, uint64_t size) {
+  std::lock_guard<std::mutex> guard(mu_);
+  auto iter = tops_.find({ns, type});
+  return iter == tops_.end() || iter->second.keys.size() < capacity_ || iter->second.order.begin()->first < size;
+}
+
+void BigKeys::Update(const std::string &ns, const std::string &key, RedisType type, uint64_t size,
+                     std::optional<uint64_t> disk_bytes) {
+  std::lock_guard<std::mutex> guard(mu_);
+  auto tracked = tracked_.find({ns, key});
+  if (tracked != tracked_.end() && tracked->second != type) {
+    removeLocked(ns, key);
+    tracked = tracked_.end();
+  }
+
+  auto &top = tops_[{ns, type}];
+  if (tracked != tracked_.end()) {
+    auto &entry = top.keys[key];
+    top.order.erase({entry.first, key});
+    // The key shrank by the write may be no longer the largest, but it's kept until a larger key comes
+    entry.first = size;
+    if (disk_bytes) entry.second = *disk_bytes;
+    top.order.emplace(size, key);
+    return;
+  }
+  if (top.keys.size() >= capacity_) {
+    auto smallest = top.order.begin();
+    if (smallest->first >= size) return;
+    tracked_.erase({ns, smallest->second});
+    top.keys.erase(smallest->second);
+    top.order.erase(smallest);
+  }
+  top.keys.emplace(key, std::make_pair(size, disk_bytes.value_or(0)));
+  top.order.emplace(size, key);
+  tracked_.emplace(std::make_pair(ns, key), type);
+}
+
+void BigKeys::UpdateByMetadata(const std::string &ns, const std::string &key, const rocksdb::Slice &value) {
+  RedisType type = kRedisNone;
+  uint64_t size = 0;
+  if (!DecodeSize(value, &type, &size) || size == 0) {
+    Remove(ns, key);
+    return;
+  }
+  Update(ns, key, type, size);
+}
+
+void BigKeys::Remove(const std::string &ns, const std::string &key) {
+  std::lock_guard<std::mutex> guard(mu_);
+  removeLocked(ns, key);
+}
+
+void BigKeys::removeLocked(const std::string &ns, const std::string &key) {
+  auto tracked = tracked_.find({ns, key});
+  if (tracked == tracked_.end()) return;
+  auto top = tops_.find({ns, tracked->second});
+  if (top != tops_.end()) {
+    auto iter = top->second.keys.find(key);
+    if (iter != top->second.keys.end()) {
+      top->second.order.erase({iter->second.first, key});
+      top->second.keys.erase(iter);
+    }
+    if (top->second.keys.empty()) tops_.erase(top);
+  }
+  tracked_.erase(tracked);
+}
+
+std::vector<BigKey> BigKeys::GetKeys(const std::string &ns, RedisType type, size_t count) {
+  std::vector<BigKey> keys;
+  std::lock_guard<std::mutex> guard(mu_);
+  for (auto top = tops_.lower_bound({ns, type}); top != tops_.end() && top->first.first == ns; ++top) {
+    if (type != kRedisNone && top->first.second != type) break;
+    size_t n = 0;
+    for (auto iter = top->second.order.rbegin(); iter != top->second.order.rend() && n < count; ++iter, n++) {
+      keys.emplace_back(BigKey{iter->second, top->first.second, iter->first, top->second.keys[iter->second].second});
+    }
+  }
+  return keys;
+}
+
+void BigKeys::Clear() {
+  std::lock_guard<std::mutex> guard(mu_);
+  tops_.clear();
+  tracked_.clear();
+}
+
+rocksdb::Status BigKeyScanner::Step(size_t max_keys) {
+  auto cf_handles = storage_->GetAllCFHandles(Engine::kMetadataColumnFamilyName);
+  if (cf_index_ >= cf_handles.size()) Reset();
+
+  rocksdb::ReadOptions read_options;
+  read_options.fill_cache = false;
+  bool slot_id_encoded = storage_->IsSlotIdEncoded();
+  size_t scanned = 0;
+  while (scanned < max_keys && cf_index_ < cf_handles.size()) {
+    std::unique_ptr<rocksdb::Iterator> iter(storage_->GetDB()->NewIterator(read_options, cf_handles[cf_index_]));
+    if (cursor_.empty()) {
+      iter->SeekToFirst();
+    } else {
+      iter->Seek(cursor_);
+    }
+    for (; iter->Valid() && scanned < max_keys; iter->Next(), scanned++) {
+      std::string ns, key;
+      ExtractNamespaceKey(iter->key(), &ns, &key, slot_id_encoded);
+      RedisType type = kRedisNone;
+      uint64_t size = 0;
+      if (!BigKeys::DecodeSize(iter->value(), &type, &size) || size == 0) {
+        big_keys_->Remove(ns, key);
+      } else if (big_keys_->Admits(ns, type, size)) {
+        uint64_t disk_bytes = 0;
+        auto s = Redis::Disk(storage_, ns).GetKeySize(key, type, &disk_bytes);
+        if (!s.ok()) return s;
+        big_keys_->Update(ns, key, type, size, disk_bytes);
+      }
+    }
+    if (!iter->status().ok()) return iter->status();
+    if (iter->Valid()) {
+      // Resume from the first key not scanned yet
+      cursor_ = iter->key().ToString();
+      break;
+    }
+    // Move to the next column family, and restart after all of them were scanned
+    cursor_.clear();
+    if (++cf_index_ == cf_handles.size()) {
+      cf_index_ = 0;
+      full_passes_++;
+      break;
+    }
+  }
+  return rocksdb::Status::OK();
+}
+
+void BigKeyScanner::Reset() {
+  cf_index_ = 0;
+  cursor_.clear();
+}
@@ -0,0 +1,119 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <rocksdb/slice.h>
+#include <rocksdb/status.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "storage/redis_metadata.h"
+
+namespace Engine {
+class Storage;
+}  // namespace Engine
+
+struct BigKey {
+  std::string key;
+  RedisType type = kRedisNone;
+  // The length of the string or the number of the elements of the other types
+  uint64_t size = 0;
+  // The approximate size on the disk measured by the last scan of the key, 0 if not scanned yet
+  uint64_t disk_bytes = 0;
+};
+
+// BigKeys keeps the largest keys of every type per namespace ordered by Metadata::size. They're
+// updated incrementally by the metadata written to the DB, and the disk sizes of the keys are
+// measured by the BigKeyScanner, which rescans all keys in background to find those written
+// before the tracking was enabled.
+class BigKeys {
+ public:
+  explicit BigKeys(size_t capacity = 64) : capacity_(capacity) {}
+  BigKeys(const BigKeys &) = delete;
+  BigKeys &operator=(const BigKeys &) = delete;
+
+  bool Enabled() const { return enabled_.load(std::memory_order_relaxed); }
+  // Disabling the tracking clears the tracked keys, which would be stale since then
+  void SetEnabled(bool enabled);
+
+  // Return whether the key of the size would be tracked, so the disk sizes of the small keys needn't be measured
+  bool Admits(const std::string &ns, RedisType type, uint64_t size);
+  // Update the size of the key, and its disk size if measured, the keys smaller than all tracked keys
+  // of the type are ignored if the list of the type is full
+  void Update(const std::string &ns, const std::string &key, RedisType type, uint64_t size,
+              std::optional<uint64_t> disk_bytes = std::nullopt);
+  // Update the key by the metadata value written to the DB
+  void UpdateByMetadata(const std::string &ns, const std::string &key, const rocksdb::Slice &value);
+  void Remove(const std::string &ns, const std::string &key);
+  // Return at most count largest keys of the type in the namespace, or those of every type if the type is none
+  std::vector<BigKey> GetKeys(const std::string &ns, RedisType type, size_t count);
+  void Clear();
+
+  // Decode the type and the size from the metadata value without decoding the string value
+  static bool DecodeSize(const rocksdb::Slice &value, RedisType *type, uint64_t *size);
+
+ private:
+  struct TopKeys {
+    // The key to its size and disk size
+    std::unordered_map<std::string, std::pair<uint64_t, uint64_t>> keys;
+    std::set<std::pair<uint64_t, std::string>> order;
+  };
+
+  void removeLocked(const std::string &ns, const std::string &key);
+
+  size_t capacity_;
+  std::atomic<bool> enabled_{false};
+  std::mutex mu_;
+  std::map<std::pair<std::string, RedisType>, TopKeys> tops_;
+  // The namespace and the key of the tracked keys to their types, so the overwritten keys of the other types
+  // and the deleted keys could be found
+  std::map<std::pair<std::string, std::string>, RedisType> tracked_;
+};
+
+// BigKeyScanner scans the metadata of all keys step by step, and measures the disk sizes of the keys
+// big enough to be tracked by the BigKeys. The scan is resumed from the last scanned key by the next
+// step, so the DB isn't locked for a long time, and restarted from the beginning after a full pass.
+class BigKeyScanner {
+ public:
+  BigKeyScanner(Engine::Storage *storage, BigKeys *big_keys) : storage_(storage), big_keys_(big_keys) {}
+
+  // Scan at most max_keys keys, the caller should hold the read lock of the DB
+  rocksdb::Status Step(size_t max_keys);
+  void Reset();
+  uint64_t GetFullPasses() const { return full_passes_; }
+
+ private:
+  Engine::Storage *storage_;
+  BigKeys *big_keys_;
+  // The index of the metadata column family and the next key to be scanned in it
+  size_t cf_index_ = 0;
+  std::string cursor_;
+  std::atomic<uint64_t> full_passes_{0};
+};
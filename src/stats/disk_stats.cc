@@ -44,7 +44,8 @@ rocksdb::Status Disk::GetApproximateSizes(const Metadata &metadata, const Slice
   InternalKey(ns_key, subkeyright, metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix_key);
   auto key_range = rocksdb::Range(prefix_key, next_version_prefix_key);
   uint64_t tmp_size = 0;
-  rocksdb::Status s = db_->GetApproximateSizes(option_, column_family, &key_range, 1, &tmp_size);
+  rocksdb::Status s =
+      db_->GetApproximateSizes(option_, storage_->RouteCFHandle(column_family, ns_key), &key_range, 1, &tmp_size);
   if (!s.ok()) return s;
   *key_size += tmp_size;
   return rocksdb::Status::OK();
@@ -71,20 +72,68 @@ rocksdb::Status Disk::GetKeySize(const Slice &user_key, RedisType type, uint64_t
       return GetZsetSize(ns_key, key_size);
     case RedisType::kRedisStream:
       return GetStreamSize(ns_key, key_size);
+    case RedisType::kRedisHyperLogLog:
+      return GetHyperLogLogSize(ns_key, key_size);
+    case RedisType::kRedisBloomFilter:
+      return GetBloomFilterSize(ns_key, key_size);
     default:
       return rocksdb::Status::NotFound("Not found ", user_key);
   }
 }
 
+rocksdb::Status Disk::GetSlotSizes(int start_slot, int end_slot, std::vector<uint64_t> *slot_sizes) {
+  if (!storage_->IsSlotIdEncoded()) return rocksdb::Status::NotSupported("the slot id is not encoded");
+  if (start_slot < 0 || end_slot < start_slot) return rocksdb::Status::InvalidArgument("invalid slot range");
+
+  // Both the metadata keys and the subkeys of a slot begin with the slot prefix
+  auto n = static_cast<size_t>(end_slot - start_slot + 1);
+  std::vector<std::string> prefixes(n + 1);
+  for (size_t i = 0; i <= n; i++) {
+    ComposeSlotKeyPrefix(namespace_, start_slot + static_cast<int>(i), &prefixes[i]);
+  }
+  std::vector<rocksdb::Range> ranges;
+  ranges.reserve(n);
+  for (size_t i = 0; i < n; i++) {
+    ranges.emplace_back(prefixes[i], prefixes[i + 1]);
+  }
+
+  slot_sizes->assign(n, 0);
+  std::vector<uint64_t> sizes(n);
+  for (const auto &cf_name : {Engine::kMetadataColumnFamilyName, Engine::kSubkeyColumnFamilyName,
+                              Engine::kZSetScoreColumnFamilyName, Engine::kZSetRankColumnFamilyName,
+                              Engine::kStreamColumnFamilyName}) {
+    auto s = db_->GetApproximateSizes(option_, storage_->GetCFHandle(cf_name), ranges.data(), static_cast<int>(n),
+                                      sizes.data());
+    if (!s.ok()) return s;
+    for (size_t i = 0; i < n; i++) {
+      (*slot_sizes)[i] += sizes[i];
+    }
+  }
+  return rocksdb::Status::OK();
+}
+
 rocksdb::Status Disk::GetStringSize(const Slice &ns_key, uint64_t *key_size) {
   auto key_range = rocksdb::Range(Slice(ns_key), Slice(ns_key.ToString() + static_cast<char>(0)));
-  return db_->GetApproximateSizes(option_, metadata_cf_handle_, &key_range, 1, key_size);
+  auto s = db_->GetApproximateSizes(option_, storage_->RouteCFHandle(metadata_cf_handle_, ns_key), &key_range, 1,
+                                    key_size);
+  if (!s.ok()) return s;
+
+  // The chunks of the chunked string are stored as the subkeys
+  std::string bytes;
+  s = GetRawMetadata(ns_key, &bytes);
+  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+  Metadata metadata(kRedisNone, false);
+  metadata.Decode(bytes);
+  if (!metadata.IsChunkedString()) return rocksdb::Status::OK();
+  return GetApproximateSizes(metadata, ns_key, storage_->GetCFHandle(Engine::kSubkeyColumnFamilyName), key_size);
 }
 
 rocksdb::Status Disk::GetHashSize(const Slice &ns_key, uint64_t *key_size) {
   HashMetadata metadata(false);
   rocksdb::Status s = Database::GetMetadata(kRedisHash, ns_key, &metadata);
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+  // The fields of the inline hash are stored in its metadata value
+  if (metadata.inlined) return GetStringSize(ns_key, key_size);
   return GetApproximateSizes(metadata, ns_key, storage_->GetCFHandle(Engine::kSubkeyColumnFamilyName), key_size);
 }
 
@@ -92,6 +141,7 @@ rocksdb::Status Disk::GetSetSize(const Slice &ns_key, uint64_t *key_size) {
   SetMetadata metadata(false);
   rocksdb::Status s = Database::GetMetadata(kRedisSet, ns_key, &metadata);
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+  if (metadata.inlined) return GetStringSize(ns_key, key_size);
   return GetApproximateSizes(metadata, ns_key, storage_->GetCFHandle(Engine::kSubkeyColumnFamilyName), key_size);
 }
 
@@ -108,6 +158,7 @@ rocksdb::Status Disk::GetZsetSize(const Slice &ns_key, uint64_t *key_size) {
   ZSetMetadata metadata(false);
   rocksdb::Status s = Database::GetMetadata(kRedisZSet, ns_key, &metadata);
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+  if (metadata.inlined) return GetStringSize(ns_key, key_size);
   std::string score_bytes;
   PutDouble(&score_bytes, kMinScore);
   s = GetApproximateSizes(metadata, ns_key, storage_->GetCFHandle(Engine::kZSetScoreColumnFamilyName), key_size,
@@ -141,4 +192,18 @@ rocksdb::Status Disk::GetStreamSize(const Slice &ns_key, uint64_t *key_size) {
   return GetApproximateSizes(metadata, ns_key, storage_->GetCFHandle(Engine::kStreamColumnFamilyName), key_size);
 }
 
+rocksdb::Status Disk::GetHyperLogLogSize(const Slice &ns_key, uint64_t *key_size) {
+  HyperLogLogMetadata metadata(false);
+  rocksdb::Status s = Database::GetMetadata(kRedisHyperLogLog, ns_key, &metadata);
+  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+  return GetApproximateSizes(metadata, ns_key, storage_->GetCFHandle(Engine::kSubkeyColumnFamilyName), key_size);
+}
+
+rocksdb::Status Disk::GetBloomFilterSize(const Slice &ns_key, uint64_t *key_size) {
+  BloomFilterMetadata metadata(false);
+  rocksdb::Status s = Database::GetMetadata(kRedisBloomFilter, ns_key, &metadata);
+  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+  return GetApproximateSizes(metadata, ns_key, storage_->GetCFHandle(Engine::kSubkeyColumnFamilyName), key_size);
+}
+
 }  // namespace Redis
@@ -21,6 +21,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "storage/redis_db.h"
 #include "storage/redis_metadata.h"
@@ -44,7 +45,11 @@ class Disk : public Database {
   rocksdb::Status GetBitmapSize(const Slice &ns_key, uint64_t *key_size);
   rocksdb::Status GetSortedintSize(const Slice &ns_key, uint64_t *key_size);
   rocksdb::Status GetStreamSize(const Slice &ns_key, uint64_t *key_size);
+  rocksdb::Status GetHyperLogLogSize(const Slice &ns_key, uint64_t *key_size);
+  rocksdb::Status GetBloomFilterSize(const Slice &ns_key, uint64_t *key_size);
   rocksdb::Status GetKeySize(const Slice &user_key, RedisType type, uint64_t *key_size);
+  // Get the approximate sizes of the slots in [start_slot, end_slot], only available in cluster mode
+  rocksdb::Status GetSlotSizes(int start_slot, int end_slot, std::vector<uint64_t> *slot_sizes);
 
  private:
   rocksdb::SizeApproximationOptions option_;
@@ -0,0 +1,131 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "hot_keys.h"
+
+#include <algorithm>
+#include <functional>
+
+std::string HotKeys::encodeID(const std::string &ns, const std::string &key) {
+  std::string id;
+  id.reserve(1 + ns.size() + key.size());
+  id.push_back(static_cast<char>(ns.size()));
+  id.append(ns);
+  id.append(key);
+  return id;
+}
+
+// The slots of the rows are derived from the two halves of a single hash
+std::array<size_t, HotKeys::kSketchDepth> HotKeys::slotsOf(const std::string &id) {
+  uint64_t hash = std::hash<std::string>{}(id);
+  uint64_t h1 = hash & 0xffffffff, h2 = (hash >> 32) | 1;
+  std::array<size_t, kSketchDepth> slots{};
+  for (size_t i = 0; i < kSketchDepth; i++) {
+    slots[i] = (h1 + i * h2) % kSketchWidth;
+  }
+  return slots;
+}
+
+uint64_t HotKeys::estimate(const Sketch &sketch, const std::array<size_t, kSketchDepth> &slots) {
+  uint64_t count = UINT64_MAX;
+  for (size_t i = 0; i < kSketchDepth; i++) {
+    count = std::min<uint64_t>(count, sketch[i][slots[i]]);
+  }
+  return count;
+}
+
+void HotKeys::decayIfNeeded(uint64_t now_ms) {
+  if (last_decay_ms_ == 0) last_decay_ms_ = now_ms;
+  if (now_ms - last_decay_ms_ < decay_period_ms_) return;
+  // Halve the counts once for every elapsed period
+  uint64_t periods = (now_ms - last_decay_ms_) / decay_period_ms_;
+  last_decay_ms_ += periods * decay_period_ms_;
+  int shift = static_cast<int>(std::min<uint64_t>(periods, 32));
+  for (auto sketch : {&reads_, &writes_}) {
+    for (auto &row : *sketch) {
+      for (auto &counter : row) counter = shift >= 32 ? 0 : counter >> shift;
+    }
+  }
+  std::set<std::pair<uint64_t, std::string>> heap;
+  for (auto iter = counts_.begin(); iter != counts_.end();) {
+    iter->second >>= shift;
+    if (iter->second == 0) {
+      iter = counts_.erase(iter);
+      continue;
+    }
+    heap.emplace(iter->second, iter->first);
+    ++iter;
+  }
+  heap_.swap(heap);
+}
+
+void HotKeys::Record(const std::string &ns, const std::string &key, bool is_write, uint64_t now_ms) {
+  auto id = encodeID(ns, key);
+  auto slots = slotsOf(id);
+
+  std::lock_guard<std::mutex> guard(mu_);
+  decayIfNeeded(now_ms);
+  auto &sketch = is_write ? writes_ : reads_;
+  for (size_t i = 0; i < kSketchDepth; i++) {
+    if (sketch[i][slots[i]] != UINT32_MAX) sketch[i][slots[i]]++;
+  }
+  uint64_t count = estimate(reads_, slots) + estimate(writes_, slots);
+
+  auto iter = counts_.find(id);
+  if (iter != counts_.end()) {
+    heap_.erase({iter->second, id});
+    iter->second = count;
+    heap_.emplace(count, std::move(id));
+    return;
+  }
+  if (counts_.size() >= capacity_) {
+    // Replace the coldest heavy hitter only if the key is hotter than it
+    auto coldest = heap_.begin();
+    if (coldest->first >= count) return;
+    counts_.erase(coldest->second);
+    heap_.erase(coldest);
+  }
+  counts_.emplace(id, count);
+  heap_.emplace(count, std::move(id));
+}
+
+std::vector<HotKey> HotKeys::GetKeys(const std::string &ns, uint64_t now_ms) {
+  std::vector<HotKey> keys;
+  std::lock_guard<std::mutex> guard(mu_);
+  decayIfNeeded(now_ms);
+  for (auto iter = heap_.rbegin(); iter != heap_.rend(); ++iter) {
+    const auto &id = iter->second;
+    size_t ns_size = static_cast<uint8_t>(id[0]);
+    if (ns_size != ns.size() || id.compare(1, ns_size, ns) != 0) continue;
+    auto slots = slotsOf(id);
+    keys.emplace_back(HotKey{ns, id.substr(1 + ns_size), estimate(reads_, slots), estimate(writes_, slots)});
+  }
+  return keys;
+}
+
+void HotKeys::Reset() {
+  std::lock_guard<std::mutex> guard(mu_);
+  for (auto sketch : {&reads_, &writes_}) {
+    for (auto &row : *sketch) row.fill(0);
+  }
+  counts_.clear();
+  heap_.clear();
+  last_decay_ms_ = 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct HotKey {
+  std::string ns;
+  std::string key;
+  uint64_t reads = 0;
+  uint64_t writes = 0;
+};
+
+// HotKeys tracks the most frequently accessed keys of the sampled commands. The reads and the writes
+// are counted in two count-min sketches, and the keys of the largest estimated counts are kept in the
+// heavy hitters ordered by the counts. All counts are halved every decay period, so the keys which
+// were hot long ago fade out.
+class HotKeys {
+ public:
+  static constexpr size_t kSketchDepth = 4;
+  static constexpr size_t kSketchWidth = 4096;
+
+  explicit HotKeys(size_t capacity = 128, uint64_t decay_period_ms = 60000)
+      : capacity_(capacity), decay_period_ms_(decay_period_ms) {}
+  HotKeys(const HotKeys &) = delete;
+  HotKeys &operator=(const HotKeys &) = delete;
+
+  // Return true for one of every interval calls, the interval 0 disables the sampling
+  bool ShouldSample(uint64_t interval) {
+    return interval != 0 && sample_counter_.fetch_add(1, std::memory_order_relaxed) % interval == 0;
+  }
+  void Record(const std::string &ns, const std::string &key, bool is_write, uint64_t now_ms);
+  // Return the heavy hitters of the namespace with their estimated counts of the samples
+  std::vector<HotKey> GetKeys(const std::string &ns, uint64_t now_ms);
+  void Reset();
+
+ private:
+  using Sketch = std::array<std::array<uint32_t, kSketchWidth>, kSketchDepth>;
+
+  static std::string encodeID(const std::string &ns, const std::string &key);
+  static uint64_t estimate(const Sketch &sketch, const std::array<size_t, kSketchDepth> &slots);
+  static std::array<size_t, kSketchDepth> slotsOf(const std::string &id);
+  void decayIfNeeded(uint64_t now_ms);
+
+  size_t capacity_;
+  uint64_t decay_period_ms_;
+  std::atomic<uint64_t> sample_counter_ = 0;
+
+  std::mutex mu_;
+  uint64_t last_decay_ms_ = 0;
+  Sketch reads_{};
+  Sketch writes_{};
+  // The id (the namespace and the key) of the heavy hitters to their counts, which are ordered in the heap
+  std::unordered_map<std::string, uint64_t> counts_;
+  std::set<std::pair<uint64_t, std::string>> heap_;
+};
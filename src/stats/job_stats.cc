@@ -0,0 +1,68 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "job_stats.h"
+
+void ColumnFamilyJobStats::RecordFlush(uint64_t duration_us) {
+  flushes.fetch_add(1, std::memory_order_relaxed);
+  flush_duration_sum.fetch_add(duration_us, std::memory_order_relaxed);
+  flush_duration.Record(duration_us);
+}
+
+void ColumnFamilyJobStats::RecordCompaction(uint64_t duration_us, uint64_t input_bytes, uint64_t output_bytes) {
+  compactions.fetch_add(1, std::memory_order_relaxed);
+  compaction_duration_sum.fetch_add(duration_us, std::memory_order_relaxed);
+  compaction_input_bytes.fetch_add(input_bytes, std::memory_order_relaxed);
+  compaction_output_bytes.fetch_add(output_bytes, std::memory_order_relaxed);
+  compaction_duration.Record(duration_us);
+  compaction_input_size.Record(input_bytes);
+  compaction_output_size.Record(output_bytes);
+}
+
+void ColumnFamilyJobStats::RecordLevel0Files(uint64_t files) {
+  level0_files.store(files, std::memory_order_relaxed);
+  level0_files_samples.Record(files);
+}
+
+void ColumnFamilyJobStats::RecordStall(bool stopped, uint64_t duration_us) {
+  (stopped ? stopped_stalls : delayed_stalls).fetch_add(1, std::memory_order_relaxed);
+  stall_duration_sum.fetch_add(duration_us, std::memory_order_relaxed);
+  stall_duration.Record(duration_us);
+}
+
+double ColumnFamilyJobStats::WriteAmplification() const {
+  uint64_t flushed = flushed_bytes.load(std::memory_order_relaxed);
+  if (flushed == 0) return 0;
+  return static_cast<double>(flushed + compaction_output_bytes.load(std::memory_order_relaxed)) /
+         static_cast<double>(flushed);
+}
+
+ColumnFamilyJobStats *JobStats::Get(const std::string &cf_name) {
+  std::lock_guard<std::mutex> guard(mu_);
+  auto &stats = cf_stats_[cf_name];
+  if (!stats) stats = std::make_unique<ColumnFamilyJobStats>();
+  return stats.get();
+}
+
+std::vector<std::string> JobStats::GetColumnFamilies() {
+  std::vector<std::string> cf_names;
+  std::lock_guard<std::mutex> guard(mu_);
+  for (const auto &iter : cf_stats_) cf_names.emplace_back(iter.first);
+  return cf_names;
+}
@@ -0,0 +1,74 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "stats.h"
+
+// The stats of the flushes, the compactions and the write stalls of a column family,
+// the durations are in microseconds and the sizes are in bytes
+struct ColumnFamilyJobStats {
+  std::atomic<uint64_t> flushes = 0;
+  std::atomic<uint64_t> flush_duration_sum = 0;
+  std::atomic<uint64_t> flushed_bytes = 0;
+  LatencyHistogram flush_duration;
+
+  std::atomic<uint64_t> compactions = 0;
+  std::atomic<uint64_t> compaction_duration_sum = 0;
+  std::atomic<uint64_t> compaction_input_bytes = 0;
+  std::atomic<uint64_t> compaction_output_bytes = 0;
+  LatencyHistogram compaction_duration;
+  LatencyHistogram compaction_input_size;
+  LatencyHistogram compaction_output_size;
+
+  // The number of the L0 files is sampled periodically, so it's weighted by the time
+  std::atomic<uint64_t> level0_files = 0;
+  LatencyHistogram level0_files_samples;
+
+  std::atomic<uint64_t> delayed_stalls = 0;
+  std::atomic<uint64_t> stopped_stalls = 0;
+  std::atomic<uint64_t> stall_duration_sum = 0;
+  LatencyHistogram stall_duration;
+
+  void RecordFlush(uint64_t duration_us);
+  void RecordCompaction(uint64_t duration_us, uint64_t input_bytes, uint64_t output_bytes);
+  void RecordLevel0Files(uint64_t files);
+  void RecordStall(bool stopped, uint64_t duration_us);
+  // The bytes written to the SST files by the flushes and the compactions per flushed byte
+  double WriteAmplification() const;
+};
+
+class JobStats {
+ public:
+  // The stats are created on the first use and never removed, so the pointer is always valid
+  ColumnFamilyJobStats *Get(const std::string &cf_name);
+  std::vector<std::string> GetColumnFamilies();
+
+ private:
+  std::mutex mu_;
+  std::map<std::string, std::unique_ptr<ColumnFamilyJobStats>> cf_stats_;
+};
@@ -0,0 +1,78 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "latency_monitor.h"
+
+#include <algorithm>
+
+#include "time_util.h"
+
+void LatencyMonitor::addSample(const std::string &event, uint64_t latency_ms, int64_t now) {
+  if (now == 0) now = Util::GetTimeStamp();
+
+  std::lock_guard<std::mutex> guard(mu_);
+  auto &series = events_[event];
+  series.max_latency_ms = std::max(series.max_latency_ms, latency_ms);
+  if (series.size > 0) {
+    auto &last = series.samples[(series.next + kSamplesPerEvent - 1) % kSamplesPerEvent];
+    if (last.time == now) {
+      last.latency_ms = std::max(last.latency_ms, latency_ms);
+      return;
+    }
+  }
+  series.samples[series.next] = LatencySample{now, latency_ms};
+  series.next = (series.next + 1) % kSamplesPerEvent;
+  series.size = std::min(series.size + 1, kSamplesPerEvent);
+}
+
+std::vector<LatencyEventStats> LatencyMonitor::Latest() {
+  std::vector<LatencyEventStats> latest;
+  std::lock_guard<std::mutex> guard(mu_);
+  for (const auto &[event, series] : events_) {
+    auto &last = series.samples[(series.next + kSamplesPerEvent - 1) % kSamplesPerEvent];
+    latest.emplace_back(LatencyEventStats{event, last, series.max_latency_ms});
+  }
+  return latest;
+}
+
+std::vector<LatencySample> LatencyMonitor::History(const std::string &event) {
+  std::vector<LatencySample> samples;
+  std::lock_guard<std::mutex> guard(mu_);
+  auto iter = events_.find(event);
+  if (iter == events_.end()) return samples;
+
+  const auto &series = iter->second;
+  samples.reserve(series.size);
+  for (size_t i = 0; i < series.size; i++) {
+    samples.emplace_back(series.samples[(series.next + kSamplesPerEvent - series.size + i) % kSamplesPerEvent]);
+  }
+  return samples;
+}
+
+size_t LatencyMonitor::Reset(const std::vector<std::string> &events) {
+  std::lock_guard<std::mutex> guard(mu_);
+  if (events.empty()) {
+    size_t num_events = events_.size();
+    events_.clear();
+    return num_events;
+  }
+  size_t num_events = 0;
+  for (const auto &event : events) num_events += events_.erase(event);
+  return num_events;
+}
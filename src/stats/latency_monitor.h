@@ -0,0 +1,83 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct LatencySample {
+  int64_t time = 0;  // in seconds
+  uint64_t latency_ms = 0;
+};
+
+struct LatencyEventStats {
+  std::string event;
+  LatencySample latest;
+  uint64_t max_latency_ms = 0;
+};
+
+// LatencyMonitor keeps the recent latency spikes of every event type like the latency monitor of Redis,
+// e.g. the lag of the timers of the event loops, the slow commands, the flushes, the compactions and the
+// write stalls of RocksDB. Only the latencies which reached latency-monitor-threshold are recorded, every
+// event has a ring buffer of the latest kSamplesPerEvent samples, the spikes of the same second are merged
+// into one sample with the largest latency.
+class LatencyMonitor {
+ public:
+  static constexpr size_t kSamplesPerEvent = 160;
+
+  LatencyMonitor() = default;
+  LatencyMonitor(const LatencyMonitor &) = delete;
+  LatencyMonitor &operator=(const LatencyMonitor &) = delete;
+
+  // The threshold in milliseconds, 0 disables the monitor
+  void SetThreshold(uint64_t threshold_ms) { threshold_ms_.store(threshold_ms, std::memory_order_relaxed); }
+  uint64_t GetThreshold() const { return threshold_ms_.load(std::memory_order_relaxed); }
+  // Record the latency of the event if it reached the threshold, now is the time in seconds or 0 for the current time
+  void Record(const std::string &event, uint64_t latency_ms, int64_t now = 0) {
+    uint64_t threshold_ms = GetThreshold();
+    if (threshold_ms == 0 || latency_ms < threshold_ms) return;
+    addSample(event, latency_ms, now);
+  }
+  // The latest sample and the max latency of all events, ordered by the event names
+  std::vector<LatencyEventStats> Latest();
+  // The samples of the event from the oldest to the latest
+  std::vector<LatencySample> History(const std::string &event);
+  // Reset the events, or all events if it's empty, and return the number of the events which were reset
+  size_t Reset(const std::vector<std::string> &events);
+
+ private:
+  struct EventSeries {
+    std::array<LatencySample, kSamplesPerEvent> samples;
+    size_t next = 0;  // the index of the next sample to be written
+    size_t size = 0;
+    uint64_t max_latency_ms = 0;
+  };
+
+  void addSample(const std::string &event, uint64_t latency_ms, int64_t now);
+
+  std::atomic<uint64_t> threshold_ms_ = 0;
+  std::mutex mu_;
+  std::map<std::string, EventSeries> events_;
+};
@@ -21,6 +21,7 @@
 #include "log_collector.h"
 
 #include <algorithm>
+#include <limits>
 
 #include "server/redis_reply.h"
 
@@ -34,6 +35,37 @@ std::string SlowEntry::ToRedisString() {
   return output;
 }
 
+std::string SlowEntry::ToRedisStringWithTrace() {
+  std::string output;
+  output.append(Redis::MultiLen(5));
+  output.append(Redis::Integer(id));
+  output.append(Redis::Integer(time));
+  output.append(Redis::Integer(duration));
+  output.append(Redis::MultiBulkString(args));
+  if (!trace) {
+    output.append(Redis::MultiLen(0));
+    return output;
+  }
+  // The trace is the start time of the request and its spans of the stages,
+  // every span is an array of the stage name, its offset and its duration
+  std::string spans;
+  int num_spans = 0;
+  for (int i = 0; i < TRACE_STAGE_COUNT; i++) {
+    const auto &span = trace->GetSpan(i);
+    if (!span.recorded) continue;
+    spans.append(Redis::MultiLen(3));
+    spans.append(Redis::BulkString(RequestTraceStageName(i)));
+    spans.append(Redis::Integer(span.offset_us));
+    spans.append(Redis::Integer(span.duration_us));
+    num_spans++;
+  }
+  output.append(Redis::MultiLen(2));
+  output.append(Redis::Integer(trace->GetStartTime()));
+  output.append(Redis::MultiLen(num_spans));
+  output.append(spans);
+  return output;
+}
+
 std::string PerfEntry::ToRedisString() {
   std::string output;
   output.append(Redis::MultiLen(6));
@@ -46,65 +78,112 @@ std::string PerfEntry::ToRedisString() {
   return output;
 }
 
+static size_t currentShardIndex() {
+  static std::atomic<size_t> next_shard = 0;
+  thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed);
+  return shard;
+}
+
 template <class T>
 LogCollector<T>::~LogCollector() {
   Reset();
 }
 
+template <class T>
+std::vector<T *> LogCollector<T>::latestEntries(size_t cnt) {
+  // Every shard is in descending order of id, so just merge them
+  std::array<size_t, kShards> pos{};
+  std::vector<T *> entries;
+  while (entries.size() < cnt) {
+    T *latest = nullptr;
+    size_t latest_shard = 0;
+    for (size_t i = 0; i < kShards; i++) {
+      if (pos[i] >= shards_[i].entries.size()) continue;
+      auto entry = shards_[i].entries[pos[i]];
+      if (!latest || entry->id > latest->id) {
+        latest = entry;
+        latest_shard = i;
+      }
+    }
+    if (!latest) break;
+    entries.emplace_back(latest);
+    pos[latest_shard]++;
+  }
+  return entries;
+}
+
 template <class T>
 ssize_t LogCollector<T>::Size() {
   size_t n = 0;
-  std::lock_guard<std::mutex> guard(mu_);
-  n = entries_.size();
-  return n;
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard.mu);
+    n += shard.entries.size();
+  }
+  // Every shard keeps at most max entries, but only the latest max entries are visible
+  int64_t max_entries = max_entries_;
+  if (max_entries > 0) n = std::min(n, static_cast<size_t>(max_entries));
+  return static_cast<ssize_t>(n);
 }
 
 template <class T>
 void LogCollector<T>::Reset() {
-  std::lock_guard<std::mutex> guard(mu_);
-  while (!entries_.empty()) {
-    delete entries_.front();
-    entries_.pop_front();
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard.mu);
+    while (!shard.entries.empty()) {
+      delete shard.entries.front();
+      shard.entries.pop_front();
+    }
   }
 }
 
 template <class T>
 void LogCollector<T>::SetMaxEntries(int64_t max_entries) {
-  std::lock_guard<std::mutex> guard(mu_);
-  while (max_entries > 0 && static_cast<int64_t>(entries_.size()) > max_entries) {
-    delete entries_.back();
-    entries_.pop_back();
-  }
   max_entries_ = max_entries;
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard.mu);
+    while (max_entries > 0 && static_cast<int64_t>(shard.entries.size()) > max_entries) {
+      delete shard.entries.back();
+      shard.entries.pop_back();
+    }
+  }
 }
 
 template <class T>
 void LogCollector<T>::PushEntry(T *entry) {
-  std::lock_guard<std::mutex> guard(mu_);
-  entry->id = ++id_;
   entry->time = time(nullptr);
-  if (max_entries_ > 0 && !entries_.empty() && entries_.size() >= static_cast<size_t>(max_entries_)) {
-    delete entries_.back();
-    entries_.pop_back();
+  int64_t max_entries = max_entries_.load(std::memory_order_relaxed);
+
+  auto &shard = shards_[currentShardIndex() % kShards];
+  std::lock_guard<std::mutex> guard(shard.mu);
+  // Assign the id inside the lock to keep the entries of the shard in order
+  entry->id = id_.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (max_entries > 0 && !shard.entries.empty() && shard.entries.size() >= static_cast<size_t>(max_entries)) {
+    delete shard.entries.back();
+    shard.entries.pop_back();
   }
-  entries_.push_front(entry);
+  shard.entries.push_front(entry);
 }
 
 template <class T>
 std::string LogCollector<T>::GetLatestEntries(int64_t cnt) {
-  size_t n = 0;
-  std::string output;
+  return GetLatestEntries(cnt, [](T *entry) { return entry->ToRedisString(); });
+}
 
-  std::lock_guard<std::mutex> guard(mu_);
-  if (cnt > 0) {
-    n = std::min(entries_.size(), static_cast<size_t>(cnt));
-  } else {
-    n = entries_.size();
-  }
-  output.append(Redis::MultiLen(n));
-  for (const auto &entry : entries_) {
-    output.append(entry->ToRedisString());
-    if (--n == 0) break;
+template <class T>
+std::string LogCollector<T>::GetLatestEntries(int64_t cnt, const std::function<std::string(T *)> &format) {
+  size_t n = std::numeric_limits<size_t>::max();
+  int64_t max_entries = max_entries_;
+  if (max_entries > 0) n = static_cast<size_t>(max_entries);
+  if (cnt > 0) n = std::min(n, static_cast<size_t>(cnt));
+
+  std::array<std::unique_lock<std::mutex>, kShards> guards;
+  for (size_t i = 0; i < kShards; i++) guards[i] = std::unique_lock<std::mutex>(shards_[i].mu);
+
+  auto entries = latestEntries(n);
+  std::string output;
+  output.append(Redis::MultiLen(entries.size()));
+  for (const auto &entry : entries) {
+    output.append(format(entry));
   }
   return output;
 }
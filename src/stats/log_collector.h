@@ -22,22 +22,30 @@
 
 #include <time.h>
 
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <deque>
 #include <functional>
-#include <list>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
 
+#include "request_trace.h"
+
 class SlowEntry {
  public:
   uint64_t id;
   time_t time;
   uint64_t duration;
   std::vector<std::string> args;
+  std::unique_ptr<RequestTrace> trace;  // only the sampled requests are traced
 
  public:
   std::string ToRedisString();
+  // Append the trace as the fifth element, it's an empty array if the request wasn't traced
+  std::string ToRedisStringWithTrace();
 };
 
 class PerfEntry {
@@ -53,9 +61,14 @@ class PerfEntry {
   std::string ToRedisString();
 };
 
+// The entries are collected into the shards, every thread pushes entries into its own
+// shard, so that workers wouldn't contend on a single lock when many commands are slow
+// at the same time. The shards are merged by the id of entries when reading.
 template <class T>
 class LogCollector {
  public:
+  static constexpr size_t kShards = 16;
+
   LogCollector() = default;
   LogCollector(const LogCollector &) = delete;
   LogCollector &operator=(const LogCollector &) = delete;
@@ -65,10 +78,18 @@ class LogCollector {
   void SetMaxEntries(int64_t max_entries);
   void PushEntry(T *entry);
   std::string GetLatestEntries(int64_t cnt);
+  std::string GetLatestEntries(int64_t cnt, const std::function<std::string(T *)> &format);
 
  private:
-  std::mutex mu_;
-  uint64_t id_ = 0;
-  int64_t max_entries_ = 128;
-  std::list<T *> entries_;
+  struct alignas(64) Shard {
+    std::mutex mu;
+    std::deque<T *> entries;  // the newest entry is at the front
+  };
+
+  // The latest entries of all shards in descending order of id, the shards must be locked
+  std::vector<T *> latestEntries(size_t cnt);
+
+  std::atomic<uint64_t> id_ = 0;
+  std::atomic<int64_t> max_entries_ = 128;
+  std::array<Shard, kShards> shards_;
 };
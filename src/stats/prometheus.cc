@@ -0,0 +1,112 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "prometheus.h"
+
+#include <cctype>
+#include <cmath>
+
+#include "fmt/format.h"
+
+void PrometheusWriter::Family(const std::string &name, const char *type, const std::string &help) {
+  if (!families_.insert(name).second) return;
+  output_.append(fmt::format("# HELP {} {}\n# TYPE {} {}\n", name, help, name, type));
+}
+
+void PrometheusWriter::appendName(const std::string &name, const Labels &labels,
+                                  const std::pair<std::string, std::string> *extra) {
+  output_.append(name);
+  if (labels.empty() && !extra) return;
+
+  output_.push_back('{');
+  bool first = true;
+  auto append_label = [this, &first](const std::pair<std::string, std::string> &label) {
+    if (!first) output_.push_back(',');
+    first = false;
+    output_.append(label.first).append("=\"").append(EscapeLabelValue(label.second)).push_back('"');
+  };
+  for (const auto &label : labels) append_label(label);
+  if (extra) append_label(*extra);
+  output_.push_back('}');
+}
+
+void PrometheusWriter::Sample(const std::string &name, const Labels &labels, double value) {
+  appendName(name, labels, nullptr);
+  if (std::isnan(value)) {
+    output_.append(" NaN\n");
+  } else if (std::isinf(value)) {
+    output_.append(value > 0 ? " +Inf\n" : " -Inf\n");
+  } else {
+    output_.append(fmt::format(" {}\n", value));
+  }
+}
+
+void PrometheusWriter::Sample(const std::string &name, const Labels &labels, uint64_t value) {
+  appendName(name, labels, nullptr);
+  output_.append(fmt::format(" {}\n", value));
+}
+
+void PrometheusWriter::Histogram(const std::string &name, const Labels &labels, const LatencyHistogram &histogram,
+                                 uint64_t sum) {
+  uint64_t cumulative = 0;
+  for (int group = 0; group < LatencyHistogram::kBuckets / LatencyHistogram::kSubBuckets; group++) {
+    int last_index = (group + 1) * LatencyHistogram::kSubBuckets - 1;
+    for (int i = group * LatencyHistogram::kSubBuckets; i <= last_index; i++) {
+      cumulative += histogram.BucketCount(i);
+    }
+    // The latencies in the bucket are at most its upper bound in microseconds
+    auto le = static_cast<double>(LatencyHistogram::BucketUpperBound(last_index)) / 1e6;
+    std::pair<std::string, std::string> le_label{"le", fmt::format("{}", le)};
+    appendName(name + "_bucket", labels, &le_label);
+    output_.append(fmt::format(" {}\n", cumulative));
+  }
+  std::pair<std::string, std::string> inf_label{"le", "+Inf"};
+  appendName(name + "_bucket", labels, &inf_label);
+  output_.append(fmt::format(" {}\n", cumulative));
+  Sample(name + "_sum", labels, static_cast<double>(sum) / 1e6);
+  Sample(name + "_count", labels, cumulative);
+}
+
+std::string PrometheusWriter::SanitizeName(const std::string &name) {
+  std::string sanitized;
+  sanitized.reserve(name.size());
+  for (size_t i = 0; i < name.size(); i++) {
+    char c = name[i];
+    bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':' || (i > 0 && isdigit(c));
+    sanitized.push_back(valid ? c : '_');
+  }
+  return sanitized;
+}
+
+std::string PrometheusWriter::EscapeLabelValue(const std::string &value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (char c : value) {
+    if (c == '\\') {
+      escaped.append("\\\\");
+    } else if (c == '"') {
+      escaped.append("\\\"");
+    } else if (c == '\n') {
+      escaped.append("\\n");
+    } else {
+      escaped.push_back(c);
+    }
+  }
+  return escaped;
+}
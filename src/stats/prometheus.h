@@ -0,0 +1,60 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "stats/stats.h"
+
+// PrometheusWriter renders the metrics in the Prometheus text exposition format (version 0.0.4).
+// The samples of a metric family must be written together after declaring the family, the HELP
+// and TYPE lines of a family are written only once even if it's declared again.
+class PrometheusWriter {
+ public:
+  using Labels = std::vector<std::pair<std::string, std::string>>;
+
+  static constexpr const char *kContentType = "text/plain; version=0.0.4; charset=utf-8";
+
+  void Family(const std::string &name, const char *type, const std::string &help);
+  void Sample(const std::string &name, const Labels &labels, double value);
+  void Sample(const std::string &name, const Labels &labels, uint64_t value);
+  void Sample(const std::string &name, double value) { Sample(name, {}, value); }
+  void Sample(const std::string &name, uint64_t value) { Sample(name, {}, value); }
+  // Write the histogram of the latencies in microseconds as a histogram in seconds, the cumulative
+  // buckets are the power-of-two groups of the LatencyHistogram, sum is in microseconds as well
+  void Histogram(const std::string &name, const Labels &labels, const LatencyHistogram &histogram, uint64_t sum);
+
+  const std::string &Output() const { return output_; }
+
+  // Replace the characters which are invalid in the metric names, e.g. rocksdb.block.cache.miss
+  // becomes rocksdb_block_cache_miss
+  static std::string SanitizeName(const std::string &name);
+  static std::string EscapeLabelValue(const std::string &value);
+
+ private:
+  void appendName(const std::string &name, const Labels &labels, const std::pair<std::string, std::string> *extra);
+
+  std::string output_;
+  std::set<std::string> families_;
+};
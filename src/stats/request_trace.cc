@@ -0,0 +1,44 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "request_trace.h"
+
+static thread_local RequestTrace *current_trace = nullptr;
+
+const char *RequestTraceStageName(int stage) {
+  static const char *names[TRACE_STAGE_COUNT] = {
+      "queue", "parse", "execute", "lock_wait", "storage_read", "wal_write", "reply",
+  };
+  return stage >= 0 && stage < TRACE_STAGE_COUNT ? names[stage] : "unknown";
+}
+
+void RequestTrace::Record(RequestTraceStage stage, uint64_t begin_us, uint64_t end_us) {
+  auto &span = spans_[stage];
+  if (!span.recorded) {
+    span.recorded = true;
+    span.offset_us = begin_us > start_us_ ? begin_us - start_us_ : 0;
+  }
+  if (end_us > begin_us) span.duration_us += end_us - begin_us;
+}
+
+RequestTrace *RequestTrace::Current() { return current_trace; }
+
+RequestTrace::Scope::Scope(RequestTrace *trace) : prev_(current_trace) { current_trace = trace; }
+
+RequestTrace::Scope::~Scope() { current_trace = prev_; }
@@ -0,0 +1,75 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// The stages of a request which are timed by the request tracing
+enum RequestTraceStage {
+  TRACE_STAGE_QUEUE = 0,     // From reading the request off the socket until its processing starts
+  TRACE_STAGE_PARSE,         // Parsing the arguments of the command
+  TRACE_STAGE_EXECUTE,       // Executing the command
+  TRACE_STAGE_LOCK_WAIT,     // Waiting for the locks of the keys during the execution
+  TRACE_STAGE_STORAGE_READ,  // Reading the memtables and the SST files during the execution
+  TRACE_STAGE_WAL_WRITE,     // Writing the WAL during the execution
+  TRACE_STAGE_REPLY,         // Appending the reply to the output buffer
+  TRACE_STAGE_COUNT
+};
+
+const char *RequestTraceStageName(int stage);
+
+// The timings of the stages of a sampled request. Every stage is a span starting at an offset
+// from the time the request was read, so that it could be exported as a child span of the request.
+// The stages happening many times, like the lock waits, are summed up into one span which starts
+// at the first occurrence.
+class RequestTrace {
+ public:
+  struct Span {
+    bool recorded = false;
+    uint64_t offset_us = 0;
+    uint64_t duration_us = 0;
+  };
+
+  explicit RequestTrace(uint64_t start_us) : start_us_(start_us) {}
+
+  void Record(RequestTraceStage stage, uint64_t begin_us, uint64_t end_us);
+  uint64_t GetStartTime() const { return start_us_; }
+  const Span &GetSpan(int stage) const { return spans_[stage]; }
+
+  // The trace of the request running on the current thread, it's used to time the stages
+  // deep in the execution like the lock waits
+  static RequestTrace *Current();
+
+  class Scope {
+   public:
+    explicit Scope(RequestTrace *trace);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+   private:
+    RequestTrace *prev_;
+  };
+
+ private:
+  uint64_t start_us_;  // the unix time in microseconds
+  std::array<Span, TRACE_STAGE_COUNT> spans_;
+};
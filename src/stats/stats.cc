@@ -20,6 +20,7 @@
 
 #include "stats.h"
 
+#include <algorithm>
 #include <chrono>
 
 #include "fmt/format.h"
@@ -38,6 +39,62 @@ Stats::Stats() {
   }
 }
 
+Stats::~Stats() {
+  for (auto &shard : commands_stats_shards_) {
+    delete[] shard.slots.load();
+    if (!shard.commands) continue;
+    for (size_t i = 0; i < num_commands_; i++) delete shard.commands[i].load();
+  }
+}
+
+LatencyHistogram::LatencyHistogram() {
+  for (auto &count : counts_) count.store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::BucketIndex(uint64_t latency) {
+  latency = std::min(latency, (uint64_t(1) << kMaxBits) - 1);
+  if (latency < kSubBuckets) return static_cast<int>(latency);
+  int shift = 63 - __builtin_clzll(latency) - kSubBucketBits;
+  return (shift + 1) * kSubBuckets + static_cast<int>((latency >> shift) - kSubBuckets);
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(int index) {
+  if (index < kSubBuckets) return index;
+  int shift = index / kSubBuckets - 1;
+  return ((uint64_t(kSubBuckets + index % kSubBuckets + 1)) << shift) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t latency) {
+  counts_[BucketIndex(latency)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other) {
+  for (int i = 0; i < kBuckets; i++) {
+    counts_[i].fetch_add(other.counts_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+}
+
+uint64_t LatencyHistogram::Percentile(double percentile) const {
+  uint64_t total = 0;
+  for (const auto &count : counts_) total += count.load(std::memory_order_relaxed);
+  if (total == 0) return 0;
+
+  // the rank of the percentile is at least 1, so that the lowest recorded bucket could be reached
+  auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(static_cast<double>(total) * percentile / 100 + 0.5));
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; i++) {
+    seen += counts_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) return BucketUpperBound(i);
+  }
+  return BucketUpperBound(kBuckets - 1);
+}
+
+void command_stat::Merge(const command_stat &other) {
+  calls.fetch_add(other.calls.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  latency.fetch_add(other.latency.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  histogram.Merge(other.histogram);
+}
+
 #if defined(__APPLE__)
 #include <mach/mach_init.h>
 #include <mach/task.h>
@@ -83,13 +140,111 @@ int64_t Stats::GetMemoryRSS() {
 }
 #endif
 
-void Stats::IncrCalls(const std::string &command_name) {
-  total_calls.fetch_add(1, std::memory_order_relaxed);
-  commands_stats[command_name].calls.fetch_add(1, std::memory_order_relaxed);
+const char *PerfCounterName(int counter) {
+  static const char *names[PERF_COUNTER_COUNT] = {
+      "block_cache_hits", "block_reads",           "block_read_bytes", "bytes_read",
+      "seeks",            "get_from_memtable_usec", "write_wal_usec",
+  };
+  return counter >= 0 && counter < PERF_COUNTER_COUNT ? names[counter] : "unknown";
+}
+
+void Stats::InitCommandsStats(size_t num_commands) {
+  num_commands_ = num_commands;
+  commands_perf_stats_.reset(new command_perf_stat[num_commands]);
+  for (auto &shard : commands_stats_shards_) {
+    // value-initialized, so all pointers are null
+    shard.commands.reset(new std::atomic<command_stat *>[num_commands]());
+  }
+}
+
+Stats::CommandsStatsShard &Stats::currentShard() {
+  static std::atomic<size_t> next_shard = 0;
+  thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % kCommandsStatsShards;
+  return commands_stats_shards_[shard];
+}
+
+command_stat *Stats::getShardCommandStat(CommandsStatsShard *shard, size_t command_id) {
+  auto &slot = shard->commands[command_id];
+  auto stat = slot.load(std::memory_order_acquire);
+  if (stat) return stat;
+
+  // the shard may be shared by threads, so only one of them could install the stat
+  auto new_stat = new command_stat();
+  if (slot.compare_exchange_strong(stat, new_stat, std::memory_order_acq_rel)) return new_stat;
+  delete new_stat;
+  return stat;
+}
+
+void Stats::IncrCalls(size_t command_id) {
+  auto &shard = currentShard();
+  shard.total_calls.fetch_add(1, std::memory_order_relaxed);
+  getShardCommandStat(&shard, command_id)->calls.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Stats::IncrLatency(uint64_t latency, size_t command_id) {
+  auto stat = getShardCommandStat(&currentShard(), command_id);
+  stat->latency.fetch_add(latency, std::memory_order_relaxed);
+  stat->histogram.Record(latency);
+}
+
+void Stats::GetCommandStat(size_t command_id, command_stat *stat) {
+  for (auto &shard : commands_stats_shards_) {
+    auto shard_stat = shard.commands[command_id].load(std::memory_order_acquire);
+    if (shard_stat) stat->Merge(*shard_stat);
+  }
+}
+
+Stats::SlotCounters *Stats::getShardSlotCounters(CommandsStatsShard *shard) {
+  auto counters = shard->slots.load(std::memory_order_acquire);
+  if (counters) return counters;
+
+  auto new_counters = new SlotCounters[HASH_SLOTS_SIZE];
+  if (shard->slots.compare_exchange_strong(counters, new_counters, std::memory_order_acq_rel)) return new_counters;
+  delete[] new_counters;
+  return counters;
+}
+
+void Stats::IncrSlotCall(int slot, uint64_t write_bytes) {
+  auto &counters = getShardSlotCounters(&currentShard())[slot];
+  counters.calls.fetch_add(1, std::memory_order_relaxed);
+  if (write_bytes > 0) counters.write_bytes.fetch_add(write_bytes, std::memory_order_relaxed);
+}
+
+void Stats::IncrSlotReadBytes(int slot, uint64_t bytes) {
+  if (bytes == 0) return;
+  getShardSlotCounters(&currentShard())[slot].read_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void Stats::GetSlotStats(int start_slot, int end_slot, std::vector<SlotStat> *stats) {
+  stats->assign(end_slot - start_slot + 1, SlotStat{});
+  for (auto &shard : commands_stats_shards_) {
+    auto counters = shard.slots.load(std::memory_order_acquire);
+    if (!counters) continue;
+    for (int slot = start_slot; slot <= end_slot; slot++) {
+      auto &stat = (*stats)[slot - start_slot];
+      stat.calls += counters[slot].calls.load(std::memory_order_relaxed);
+      stat.read_bytes += counters[slot].read_bytes.load(std::memory_order_relaxed);
+      stat.write_bytes += counters[slot].write_bytes.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void Stats::RecordPerfSample(size_t command_id, const PerfSample &sample) {
+  auto &stat = commands_perf_stats_[command_id];
+  stat.samples.fetch_add(1, std::memory_order_relaxed);
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) stat.counters[i].fetch_add(sample[i], std::memory_order_relaxed);
+}
+
+uint64_t Stats::GetPerfStat(size_t command_id, PerfSample *sums) {
+  auto &stat = commands_perf_stats_[command_id];
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) (*sums)[i] = stat.counters[i].load(std::memory_order_relaxed);
+  return stat.samples.load(std::memory_order_relaxed);
 }
 
-void Stats::IncrLatency(uint64_t latency, const std::string &command_name) {
-  commands_stats[command_name].latency.fetch_add(latency, std::memory_order_relaxed);
+uint64_t Stats::GetTotalCalls() {
+  uint64_t total_calls = 0;
+  for (const auto &shard : commands_stats_shards_) total_calls += shard.total_calls.load(std::memory_order_relaxed);
+  return total_calls;
 }
 
 void Stats::TrackInstantaneousMetric(int metric, uint64_t current_reading) {
@@ -22,11 +22,14 @@
 
 #include <unistd.h>
 
+#include <array>
 #include <atomic>
-#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "cluster/redis_slot.h"
+
 enum StatsMetricFlags {
   STATS_METRIC_COMMAND = 0,       // Number of commands executed
   STATS_METRIC_NET_INPUT,         // Bytes read to network
@@ -42,9 +45,64 @@ enum StatsMetricFlags {
 
 const int STATS_METRIC_SAMPLES = 16;  // Number of samples per metric
 
-struct command_stat {
-  std::atomic<uint64_t> calls;
-  std::atomic<uint64_t> latency;
+// The counters of the RocksDB perf context and IO stats context sampled from the commands
+enum PerfCounter {
+  PERF_BLOCK_CACHE_HITS = 0,      // Number of blocks hit in the block cache
+  PERF_BLOCK_READS,               // Number of blocks missed in the block cache and read from the files
+  PERF_BLOCK_READ_BYTES,          // Bytes of the blocks read from the files
+  PERF_BYTES_READ,                // Bytes read from the files by the thread
+  PERF_SEEKS,                     // Number of the seeks of the iterators
+  PERF_GET_FROM_MEMTABLE_NANOS,   // Time spent on looking up the memtables
+  PERF_WRITE_WAL_NANOS,           // Time spent on writing the WAL
+  PERF_COUNTER_COUNT
+};
+
+const char *PerfCounterName(int counter);
+
+// A HDR-style histogram of latencies in microseconds, the latencies are grouped by
+// their highest bit, and every group is divided into kSubBuckets linear buckets,
+// so the relative error of the reported percentiles is within 1/kSubBuckets.
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr int kSubBuckets = 1 << kSubBucketBits;
+  static constexpr int kMaxBits = 36;  // about 19 hours, larger latencies fall into the last bucket
+  static constexpr int kBuckets = (kMaxBits - kSubBucketBits + 1) * kSubBuckets;
+
+  LatencyHistogram();
+  void Record(uint64_t latency);
+  void Merge(const LatencyHistogram &other);
+  // Return the highest latency which is equivalent to the percentile (0~100) of the recorded latencies
+  uint64_t Percentile(double percentile) const;
+  uint64_t BucketCount(int index) const { return counts_[index].load(std::memory_order_relaxed); }
+
+  static int BucketIndex(uint64_t latency);
+  static uint64_t BucketUpperBound(int index);
+
+ private:
+  std::array<std::atomic<uint64_t>, kBuckets> counts_;
+};
+
+struct alignas(64) command_stat {
+  std::atomic<uint64_t> calls = 0;
+  std::atomic<uint64_t> latency = 0;
+  LatencyHistogram histogram;
+
+  void Merge(const command_stat &other);
+};
+
+using PerfSample = std::array<uint64_t, PERF_COUNTER_COUNT>;
+
+struct alignas(64) command_perf_stat {
+  std::atomic<uint64_t> samples = 0;
+  std::array<std::atomic<uint64_t>, PERF_COUNTER_COUNT> counters = {};
+};
+
+// The traffic of the commands on the keys of a slot
+struct SlotStat {
+  uint64_t calls = 0;
+  uint64_t read_bytes = 0;   // Bytes of the replies
+  uint64_t write_bytes = 0;  // Bytes of the arguments of the write commands
 };
 
 struct inst_metric {
@@ -56,7 +114,10 @@ struct inst_metric {
 
 class Stats {
  public:
-  std::atomic<uint64_t> total_calls = {0};
+  // The command stats are sharded by threads to avoid sharing cache lines between
+  // workers, threads would share a shard only if there are more than kCommandsStatsShards.
+  static constexpr size_t kCommandsStatsShards = 64;
+
   std::atomic<uint64_t> in_bytes = {0};
   std::atomic<uint64_t> out_bytes = {0};
   std::vector<struct inst_metric> inst_metrics;
@@ -64,18 +125,92 @@ class Stats {
   std::atomic<uint64_t> fullsync_counter = {0};
   std::atomic<uint64_t> psync_err_counter = {0};
   std::atomic<uint64_t> psync_ok_counter = {0};
-  std::map<std::string, command_stat> commands_stats;
+
+  std::atomic<uint64_t> script_cache_hits = {0};
+  std::atomic<uint64_t> script_cache_misses = {0};
+  std::atomic<uint64_t> script_compiles = {0};
+  std::atomic<uint64_t> script_compile_time = {0};  // in microseconds
+
+  // The slots whose writes have been forbidden while migrating and the time of forbidding them
+  std::atomic<uint64_t> migrate_forbidden_slots = {0};
+  std::atomic<uint64_t> migrate_forbidden_time = {0};       // in microseconds
+  std::atomic<uint64_t> migrate_last_forbidden_time = {0};  // in microseconds
+
+  // The write commands rejected since the writes were stopped by the write stall of RocksDB
+  std::atomic<uint64_t> write_stall_rejected_cmds = {0};
+
+  // The read commands offloaded since they'd read the disk, see worker-offload-cache-missed-reads
+  std::atomic<uint64_t> cache_missed_offloaded_cmds = {0};
+
+  // The read commands replied by the coalesced replies, see read-coalesce-window-ms
+  std::atomic<uint64_t> coalesced_cmds = {0};
+
+  // The RESTOREs of the importing connections which were written in batches
+  std::atomic<uint64_t> import_batched_restores = {0};
 
  public:
   Stats();
-  void IncrCalls(const std::string &command_name);
-  void IncrLatency(uint64_t latency, const std::string &command_name);
+  ~Stats();
+  Stats(const Stats &) = delete;
+  Stats &operator=(const Stats &) = delete;
+
+  // Must be called before recording any command, the command id is the index
+  // which was assigned at the registration of the command.
+  void InitCommandsStats(size_t num_commands);
+  void IncrCalls(size_t command_id);
+  void IncrLatency(uint64_t latency, size_t command_id);
+  // Aggregate the stats of the command from all shards
+  void GetCommandStat(size_t command_id, command_stat *stat);
+  uint64_t GetTotalCalls();
+  // The perf samples are taken from one of every perf-stats-sample-interval commands, so they're
+  // aggregated without sharding
+  void RecordPerfSample(size_t command_id, const PerfSample &sample);
+  // Return the number of the samples of the command and the sums of their counters
+  uint64_t GetPerfStat(size_t command_id, PerfSample *sums);
+  // The slot stats are sharded like the command stats, and merged from all shards on demand
+  void IncrSlotCall(int slot, uint64_t write_bytes);
+  void IncrSlotReadBytes(int slot, uint64_t bytes);
+  void GetSlotStats(int start_slot, int end_slot, std::vector<SlotStat> *stats);
   void IncrInbondBytes(uint64_t bytes) { in_bytes.fetch_add(bytes, std::memory_order_relaxed); }
   void IncrOutbondBytes(uint64_t bytes) { out_bytes.fetch_add(bytes, std::memory_order_relaxed); }
   void IncrFullSyncCounter() { fullsync_counter.fetch_add(1, std::memory_order_relaxed); }
   void IncrPSyncErrCounter() { psync_err_counter.fetch_add(1, std::memory_order_relaxed); }
   void IncrPSyncOKCounter() { psync_ok_counter.fetch_add(1, std::memory_order_relaxed); }
+  void IncrScriptCacheHits() { script_cache_hits.fetch_add(1, std::memory_order_relaxed); }
+  void IncrScriptCacheMisses() { script_cache_misses.fetch_add(1, std::memory_order_relaxed); }
+  void IncrScriptCompiles(uint64_t compile_time) {
+    script_compiles.fetch_add(1, std::memory_order_relaxed);
+    script_compile_time.fetch_add(compile_time, std::memory_order_relaxed);
+  }
+  void IncrMigrateForbiddenTime(uint64_t slots, uint64_t forbidden_time) {
+    migrate_forbidden_slots.fetch_add(slots, std::memory_order_relaxed);
+    migrate_forbidden_time.fetch_add(forbidden_time, std::memory_order_relaxed);
+    migrate_last_forbidden_time.store(forbidden_time, std::memory_order_relaxed);
+  }
   static int64_t GetMemoryRSS();
   void TrackInstantaneousMetric(int metric, uint64_t current_reading);
   uint64_t GetInstantaneousMetric(int metric);
+
+ private:
+  struct SlotCounters {
+    std::atomic<uint64_t> calls = 0;
+    std::atomic<uint64_t> read_bytes = 0;
+    std::atomic<uint64_t> write_bytes = 0;
+  };
+
+  struct alignas(64) CommandsStatsShard {
+    std::atomic<uint64_t> total_calls = 0;
+    // lazily allocated since most commands are never called by most threads
+    std::unique_ptr<std::atomic<command_stat *>[]> commands;
+    // lazily allocated since only the workers of the cluster mode record them
+    std::atomic<SlotCounters *> slots = nullptr;
+  };
+
+  CommandsStatsShard &currentShard();
+  command_stat *getShardCommandStat(CommandsStatsShard *shard, size_t command_id);
+  SlotCounters *getShardSlotCounters(CommandsStatsShard *shard);
+
+  size_t num_commands_ = 0;
+  std::array<CommandsStatsShard, kCommandsStatsShards> commands_stats_shards_;
+  std::unique_ptr<command_perf_stat[]> commands_perf_stats_;
 };
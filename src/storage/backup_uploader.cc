@@ -0,0 +1,255 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "backup_uploader.h"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "scope_exit.h"
+#include "time_util.h"
+
+extern char **environ;
+
+namespace Engine {
+
+namespace {
+
+constexpr size_t kUploadChunkSize = 1024 * 1024;
+
+Status writeFully(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, data, len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return {Status::NotOK, std::string("write to the upload command: ") + strerror(errno)};
+    }
+    data += n;
+    len -= n;
+  }
+  return Status::OK();
+}
+
+// The object key is made of the digits, letters and the ._/ characters, so it's safe in the shell
+std::string expandCommand(const std::string &command, const std::string &key) {
+  std::string expanded;
+  size_t pos = 0;
+  for (size_t found = 0; (found = command.find("{}", pos)) != std::string::npos; pos = found + 2) {
+    expanded.append(command, pos, found - pos).append(key);
+  }
+  return expanded.append(command, pos, std::string::npos);
+}
+
+}  // namespace
+
+Status BackupUploader::Upload(rocksdb::DB *db, Result *result) {
+  auto s = db->DisableFileDeletions();
+  if (!s.ok()) return {Status::NotOK, "Fail to disable the file deletions: " + s.ToString()};
+  auto enable_deletions = MakeScopeExit([db] { db->EnableFileDeletions(false); });
+
+  rocksdb::LiveFilesStorageInfoOptions live_options;
+  live_options.wal_size_for_flush = options_.wal_size_for_flush;
+  std::vector<rocksdb::LiveFileStorageInfo> live_files;
+  if (!(s = db->GetLiveFilesStorageInfo(live_options, &live_files)).ok()) {
+    return {Status::NotOK, "Fail to get the live files: " + s.ToString()};
+  }
+
+  result->backup_id = std::to_string(Util::GetTimeStampMS());
+  auto uploaded = loadState();
+  std::set<std::string> shared_keys;
+  std::vector<File> files;
+  std::vector<const File *> to_upload;
+  files.reserve(live_files.size());
+  for (const auto &info : live_files) {
+    File file;
+    file.path = info.directory + "/" + info.relative_filename;
+    file.relative_filename = info.relative_filename;
+    file.size = info.size;
+    if (!info.replacement_contents.empty()) {
+      file.contents = info.replacement_contents;
+      file.size = file.contents.size();
+    }
+    if (info.file_type == rocksdb::kTableFile || info.file_type == rocksdb::kBlobFile) {
+      // The size tells the files of the same number apart, e.g. after the DB was restored from the master
+      auto dot = info.relative_filename.rfind('.');
+      file.key = "shared/" + info.relative_filename.substr(0, dot) + "_" + std::to_string(file.size) +
+                 (dot == std::string::npos ? "" : info.relative_filename.substr(dot));
+      shared_keys.insert(file.key);
+    } else {
+      file.key = result->backup_id + "/" + info.relative_filename;
+    }
+    result->size += file.size;
+    files.emplace_back(std::move(file));
+  }
+  for (const auto &file : files) {
+    if (uploaded.count(file.key) > 0) continue;
+    to_upload.emplace_back(&file);
+    result->uploaded_bytes += file.size;
+  }
+
+  std::unique_ptr<rocksdb::RateLimiter> limiter;
+  if (options_.max_io_bytes_per_sec > 0) {
+    limiter.reset(rocksdb::NewGenericRateLimiter(options_.max_io_bytes_per_sec));
+  }
+  std::atomic<size_t> next = 0;
+  std::atomic<bool> failed = false;
+  std::mutex error_mu;
+  Status error;
+  auto upload_files = [&] {
+    for (size_t i = next++; i < to_upload.size() && !failed; i = next++) {
+      auto upload_status = uploadFile(*to_upload[i], limiter.get());
+      if (upload_status.IsOK()) continue;
+      std::lock_guard<std::mutex> guard(error_mu);
+      if (!failed.exchange(true)) error = upload_status;
+    }
+  };
+  std::vector<std::thread> threads;
+  try {
+    for (int i = 1; i < std::min<int>(options_.threads, static_cast<int>(to_upload.size())); i++) {
+      threads.emplace_back(upload_files);
+    }
+  } catch (const std::system_error &e) {
+    LOG(WARNING) << "[backup] Fail to start the upload thread, err: " << e.what();
+  }
+  upload_files();
+  for (auto &t : threads) t.join();
+  if (failed) return error;
+
+  // The backup is complete once the list of its files was uploaded
+  std::string listing;
+  for (const auto &file : files) {
+    listing.append(file.relative_filename).append(" ").append(file.key).append(" ");
+    listing.append(std::to_string(file.size)).append("\n");
+  }
+  auto listing_status = runCommand(result->backup_id + "/FILES",
+                                   [&listing](int fd) { return writeFully(fd, listing.data(), listing.size()); });
+  if (!listing_status.IsOK()) return listing_status;
+  return saveState(shared_keys);
+}
+
+Status BackupUploader::uploadFile(const File &file, rocksdb::RateLimiter *limiter) {
+  auto s = runCommand(file.key, [&](int fd) -> Status {
+    if (!file.contents.empty()) return writeFully(fd, file.contents.data(), file.contents.size());
+
+    std::unique_ptr<rocksdb::SequentialFile> reader;
+    auto read_status = env_->NewSequentialFile(file.path, &reader, rocksdb::EnvOptions());
+    if (!read_status.ok()) return {Status::NotOK, read_status.ToString()};
+    size_t chunk_size = kUploadChunkSize;
+    if (limiter) chunk_size = std::min<size_t>(chunk_size, limiter->GetSingleBurstBytes());
+    std::string scratch(chunk_size, '\0');
+    // Only the synced part of the MANIFEST and the WALs belongs to the backup
+    for (uint64_t remaining = file.size; remaining > 0;) {
+      rocksdb::Slice data;
+      read_status = reader->Read(std::min<uint64_t>(remaining, chunk_size), &data, scratch.data());
+      if (!read_status.ok()) return {Status::NotOK, read_status.ToString()};
+      if (data.empty()) return {Status::NotOK, "the file is shorter than " + std::to_string(file.size) + " bytes"};
+      if (limiter) {
+        limiter->Request(static_cast<int64_t>(data.size()), rocksdb::Env::IO_LOW, nullptr,
+                         rocksdb::RateLimiter::OpType::kWrite);
+      }
+      if (auto write_status = writeFully(fd, data.data(), data.size()); !write_status.IsOK()) return write_status;
+      remaining -= data.size();
+    }
+    return Status::OK();
+  });
+  if (!s.IsOK()) return {Status::NotOK, "Fail to upload " + file.relative_filename + ": " + s.Msg()};
+  return Status::OK();
+}
+
+Status BackupUploader::runCommand(const std::string &key, const StreamWriter &writer) {
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) != 0) return {Status::NotOK, std::string("pipe: ") + strerror(errno)};
+  auto close_write = MakeScopeExit([&fds] {
+    if (fds[1] >= 0) close(fds[1]);
+  });
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  auto destroy_actions = MakeScopeExit([&actions] { posix_spawn_file_actions_destroy(&actions); });
+  posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 34)
+  // The command mustn't inherit the sockets and the files of the server
+  posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+#endif
+  std::string command = expandCommand(options_.command, key);
+  const char *argv[] = {"/bin/sh", "-c", command.c_str(), nullptr};
+  pid_t pid = 0;
+  int err = posix_spawn(&pid, "/bin/sh", &actions, nullptr, const_cast<char **>(argv), environ);
+  close(fds[0]);
+  if (err != 0) return {Status::NotOK, std::string("spawn the upload command: ") + strerror(err)};
+
+  auto s = writer(fds[1]);
+  // The EOF of the stdin completes the upload, so the command is killed before it if the file
+  // couldn't be written entirely
+  if (!s.IsOK()) kill(pid, SIGKILL);
+  close(fds[1]);
+  fds[1] = -1;
+  int wstatus = 0;
+  while (waitpid(pid, &wstatus, 0) < 0 && errno == EINTR) {
+  }
+  if (!s.IsOK()) return s;
+  if (!WIFEXITED(wstatus)) {
+    return {Status::NotOK, "the upload command of " + key + " was killed by the signal " +
+                               std::to_string(WTERMSIG(wstatus))};
+  }
+  if (WEXITSTATUS(wstatus) != 0) {
+    return {Status::NotOK, "the upload command of " + key + " exited with " + std::to_string(WEXITSTATUS(wstatus))};
+  }
+  return Status::OK();
+}
+
+std::set<std::string> BackupUploader::loadState() {
+  std::set<std::string> keys;
+  std::ifstream input(options_.state_file);
+  for (std::string key; std::getline(input, key);) {
+    if (!key.empty()) keys.insert(key);
+  }
+  return keys;
+}
+
+Status BackupUploader::saveState(const std::set<std::string> &keys) {
+  std::string tmp_file = options_.state_file + ".tmp";
+  {
+    std::ofstream output(tmp_file, std::ios::out | std::ios::trunc);
+    for (const auto &key : keys) output << key << "\n";
+    output.flush();
+    if (!output) return {Status::NotOK, "Fail to write " + tmp_file};
+  }
+  if (rename(tmp_file.c_str(), options_.state_file.c_str()) != 0) {
+    return {Status::NotOK, "Fail to rename " + tmp_file + ": " + strerror(errno)};
+  }
+  return Status::OK();
+}
+
+}  // namespace Engine
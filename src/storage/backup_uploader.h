@@ -0,0 +1,88 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <rocksdb/db.h>
+#include <rocksdb/env.h>
+#include <rocksdb/rate_limiter.h>
+
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <string>
+
+#include "status.h"
+
+namespace Engine {
+
+// BackupUploader streams the live files of the DB to the object storage, so the backups needn't
+// be copied into the local disk before being uploaded. Every file is piped into the upload command,
+// e.g. `aws s3 cp - s3://bucket/kvrocks/{}`, whose `{}` is replaced with the object key, and the
+// command is expected to upload its stdin, typically in a multipart upload.
+//
+// The SST and the blob files are immutable, so they're uploaded into shared/ once and referenced
+// by all following backups. The other files are uploaded into the dir of each backup. The FILES
+// object of the backup lists the object keys of its files and is uploaded last, so the backup
+// is complete only if it exists.
+class BackupUploader {
+ public:
+  struct Options {
+    std::string command;
+    // The keys of the shared objects uploaded by the last backup, they aren't uploaded again
+    std::string state_file;
+    int threads = 1;
+    int64_t max_io_bytes_per_sec = 0;  // 0 means no limit
+    // Flush the memtables before the backup if the WALs exceed the size, like the checkpoint
+    uint64_t wal_size_for_flush = 0;
+  };
+
+  struct Result {
+    std::string backup_id;
+    uint64_t size = 0;
+    uint64_t uploaded_bytes = 0;
+  };
+
+  BackupUploader(rocksdb::Env *env, Options options) : env_(env), options_(std::move(options)) {}
+
+  // The files are pinned by disabling the deletions until they are all uploaded
+  Status Upload(rocksdb::DB *db, Result *result);
+
+ private:
+  struct File {
+    std::string path;
+    std::string relative_filename;
+    std::string key;
+    uint64_t size = 0;
+    std::string contents;  // the contents instead of the file, e.g. of CURRENT
+  };
+
+  using StreamWriter = std::function<Status(int fd)>;
+
+  Status uploadFile(const File &file, rocksdb::RateLimiter *limiter);
+  Status runCommand(const std::string &key, const StreamWriter &writer);
+  std::set<std::string> loadState();
+  Status saveState(const std::set<std::string> &keys);
+
+  rocksdb::Env *env_;
+  Options options_;
+};
+
+}  // namespace Engine
@@ -51,12 +51,41 @@ rocksdb::Status WriteBatchExtractor::PutCF(uint32_t column_family_id, const Slic
   std::vector<std::string> command_args;
   if (column_family_id == kColumnFamilyIDMetadata) {
     ExtractNamespaceKey(key, &ns, &user_key, is_slotid_encoded_);
-    if (slot_ >= 0) {
-      if (static_cast<uint16_t>(slot_) != GetSlotNumFromKey(user_key)) return rocksdb::Status::OK();
-    }
+    if (isFilteredOut(user_key)) return rocksdb::Status::OK();
     Metadata metadata(kRedisNone);
     metadata.Decode(value.ToString());
-    if (metadata.Type() == kRedisString) {
+    // The inline key has no subkeys, so it's rewritten as a whole on every change
+    std::vector<std::string> elements;
+    if (DecodeInlineElements(value.ToString(), &elements)) {
+      resp_commands_[ns].emplace_back(Redis::Command2RESP({"DEL", user_key}));
+      if (elements.empty()) return rocksdb::Status::OK();
+      static const std::map<RedisType, std::string> inline_cmds = {
+          {kRedisHash, "HSET"}, {kRedisSet, "SADD"}, {kRedisZSet, "ZADD"}};
+      command_args = {inline_cmds.at(metadata.Type()), user_key};
+      command_args.insert(command_args.end(), elements.begin(), elements.end());
+      resp_commands_[ns].emplace_back(Redis::Command2RESP(command_args));
+      if (metadata.expire > 0) {
+        command_args = {"EXPIREAT", user_key, std::to_string(metadata.expire)};
+        resp_commands_[ns].emplace_back(Redis::Command2RESP(command_args));
+      }
+      return rocksdb::Status::OK();
+    }
+    // The reserved bloom filter has no segments, so it's created by its metadata
+    if (log_data_.GetRedisType() == kRedisBloomFilter) {
+      auto args = log_data_.GetArguments();
+      if (args->size() == 3 && (*args)[0] == std::to_string(kRedisCmdBFReserve)) {
+        command_args = {"BF.RESERVE", user_key, (*args)[1], (*args)[2]};
+        resp_commands_[ns].emplace_back(Redis::Command2RESP(command_args));
+      }
+      return rocksdb::Status::OK();
+    }
+    if (metadata.IsChunkedString()) {
+      // The chunks are written by SETRANGE, and the metadata only changes their length and TTL
+      if (metadata.expire > 0) {
+        command_args = {"EXPIREAT", user_key, std::to_string(metadata.expire)};
+        resp_commands_[ns].emplace_back(Redis::Command2RESP(command_args));
+      }
+    } else if (metadata.Type() == kRedisString) {
       command_args = {"SET", user_key, value.ToString().substr(5, value.size() - 5)};
       resp_commands_[ns].emplace_back(Redis::Command2RESP(command_args));
       if (metadata.expire > 0) {
@@ -84,12 +113,14 @@ rocksdb::Status WriteBatchExtractor::PutCF(uint32_t column_family_id, const Slic
   if (column_family_id == kColumnFamilyIDDefault) {
     InternalKey ikey(key, is_slotid_encoded_);
     user_key = ikey.GetKey().ToString();
-    if (slot_ >= 0) {
-      if (static_cast<uint16_t>(slot_) != GetSlotNumFromKey(user_key)) return rocksdb::Status::OK();
-    }
+    if (isFilteredOut(user_key)) return rocksdb::Status::OK();
     sub_key = ikey.GetSubKey().ToString();
     ns = ikey.GetNamespace().ToString();
     switch (log_data_.GetRedisType()) {
+      case kRedisString:
+        // The chunk of the chunked string is named by its offset
+        command_args = {"SETRANGE", user_key, sub_key, value.ToString()};
+        break;
       case kRedisHash:
         command_args = {"HSET", user_key, sub_key, value.ToString()};
         break;
@@ -160,7 +191,14 @@ rocksdb::Status WriteBatchExtractor::PutCF(uint32_t column_family_id, const Slic
             if (!parse_result) {
               return rocksdb::Status::InvalidArgument(parse_result.Msg());
             }
-            bool bit_value = Redis::Bitmap::GetBitFromValueAndOffset(value.ToString(), *parse_result);
+            // The new bit is logged since the segment might be stored as a container,
+            // and the older versions only log the offset of the raw segment
+            bool bit_value = false;
+            if (args->size() > 2) {
+              bit_value = (*args)[2] == "1";
+            } else {
+              bit_value = Redis::Bitmap::GetBitFromValueAndOffset(value.ToString(), *parse_result);
+            }
             command_args = {"SETBIT", user_key, (*args)[1], bit_value ? "1" : "0"};
             break;
           }
@@ -176,14 +214,49 @@ rocksdb::Status WriteBatchExtractor::PutCF(uint32_t column_family_id, const Slic
               first_seen_ = false;
             }
             break;
+          case kRedisCmdBitfield:
+            // The applied writes are logged as the SET operations, which are replayed once for all segments
+            if (first_seen_) {
+              command_args = {"BITFIELD", user_key};
+              command_args.insert(command_args.end(), args->begin() + 1, args->end());
+              first_seen_ = false;
+            }
+            break;
           default:
             LOG(ERROR) << "Fail to parse write_batch in putcf type bitmap : cmd error";
             return rocksdb::Status::OK();
         }
         break;
       }
+      case kRedisHyperLogLog: {
+        // The registers have no equivalent commands, so the logged command is emitted once for all segments
+        auto args = log_data_.GetArguments();
+        if (args->size() < 1 || !first_seen_) break;
+        auto parse_result = ParseInt<int>((*args)[0], 10);
+        if (!parse_result) {
+          return rocksdb::Status::InvalidArgument(parse_result.Msg());
+        }
+        auto cmd = static_cast<RedisCommand>(*parse_result);
+        if (cmd != kRedisCmdPFAdd && cmd != kRedisCmdPFMerge) {
+          LOG(ERROR) << "Fail to parse write_batch in putcf type hyperloglog : cmd error";
+          return rocksdb::Status::OK();
+        }
+        command_args = {cmd == kRedisCmdPFAdd ? "PFADD" : "PFMERGE", user_key};
+        command_args.insert(command_args.end(), args->begin() + 1, args->end());
+        first_seen_ = false;
+        break;
+      }
+      case kRedisBloomFilter: {
+        // The segments are written once for all added items
+        auto args = log_data_.GetArguments();
+        if (args->size() < 2 || !first_seen_ || (*args)[0] != std::to_string(kRedisCmdBFAdd)) break;
+        command_args = {"BF.MADD", user_key};
+        command_args.insert(command_args.end(), args->begin() + 1, args->end());
+        first_seen_ = false;
+        break;
+      }
       case kRedisSortedint: {
-        if (!to_redis_) {
+        if (!to_redis_ && !sortedintBlockCommand(user_key, &command_args)) {
           command_args = {"SIADD", user_key, std::to_string(DecodeFixed64(sub_key.data()))};
         }
         break;
@@ -199,6 +272,17 @@ rocksdb::Status WriteBatchExtractor::PutCF(uint32_t column_family_id, const Slic
   return rocksdb::Status::OK();
 }
 
+rocksdb::Status WriteBatchExtractor::MergeCF(uint32_t column_family_id, const Slice &key, const Slice &value) {
+  // Only the string counters are merged, see StringCounterMergeOperator
+  if (column_family_id != kColumnFamilyIDMetadata) return rocksdb::Status::OK();
+
+  std::string ns, user_key;
+  ExtractNamespaceKey(key, &ns, &user_key, is_slotid_encoded_);
+  if (isFilteredOut(user_key)) return rocksdb::Status::OK();
+  resp_commands_[ns].emplace_back(Redis::Command2RESP({"INCRBY", user_key, value.ToString()}));
+  return rocksdb::Status::OK();
+}
+
 rocksdb::Status WriteBatchExtractor::DeleteCF(uint32_t column_family_id, const Slice &key) {
   if (column_family_id == kColumnFamilyIDZSetScore) {
     return rocksdb::Status::OK();
@@ -208,16 +292,12 @@ rocksdb::Status WriteBatchExtractor::DeleteCF(uint32_t column_family_id, const S
   std::vector<std::string> command_args;
   if (column_family_id == kColumnFamilyIDMetadata) {
     ExtractNamespaceKey(key, &ns, &user_key, is_slotid_encoded_);
-    if (slot_ >= 0) {
-      if (static_cast<uint16_t>(slot_) != GetSlotNumFromKey(user_key)) return rocksdb::Status::OK();
-    }
+    if (isFilteredOut(user_key)) return rocksdb::Status::OK();
     command_args = {"DEL", user_key};
   } else if (column_family_id == kColumnFamilyIDDefault) {
     InternalKey ikey(key, is_slotid_encoded_);
     user_key = ikey.GetKey().ToString();
-    if (slot_ >= 0) {
-      if (static_cast<uint16_t>(slot_) != GetSlotNumFromKey(user_key)) return rocksdb::Status::OK();
-    }
+    if (isFilteredOut(user_key)) return rocksdb::Status::OK();
     sub_key = ikey.GetSubKey().ToString();
     ns = ikey.GetNamespace().ToString();
     switch (log_data_.GetRedisType()) {
@@ -252,6 +332,9 @@ rocksdb::Status WriteBatchExtractor::DeleteCF(uint32_t column_family_id, const S
               first_seen_ = false;
             }
             break;
+          case kRedisCmdLInsert:
+            // linsert into the chunked list may delete the moved elements, it's parsed in putcf
+            break;
           case kRedisCmdLRem:
             if (first_seen_) {
               if (args->size() < 3) {
@@ -268,7 +351,7 @@ rocksdb::Status WriteBatchExtractor::DeleteCF(uint32_t column_family_id, const S
         break;
       }
       case kRedisSortedint: {
-        if (!to_redis_) {
+        if (!to_redis_ && !sortedintBlockCommand(user_key, &command_args)) {
           command_args = {"SIREM", user_key, std::to_string(DecodeFixed64(sub_key.data()))};
         }
         break;
@@ -284,6 +367,23 @@ rocksdb::Status WriteBatchExtractor::DeleteCF(uint32_t column_family_id, const S
   return rocksdb::Status::OK();
 }
 
+// The sortedint with the block encoding logs the added or removed ids, since its subkeys are
+// the blocks rather than the ids, and the command is emitted once for all the touched blocks.
+// Return false if the ids aren't logged, which means a subkey per id.
+bool WriteBatchExtractor::sortedintBlockCommand(const std::string &user_key, std::vector<std::string> *command_args) {
+  auto args = log_data_.GetArguments();
+  if (args->size() < 2) return false;
+  auto parse_result = ParseInt<int>((*args)[0], 10);
+  if (!parse_result) return false;
+
+  if (first_seen_) {
+    *command_args = {*parse_result == kRedisCmdSIRem ? "SIREM" : "SIADD", user_key};
+    command_args->insert(command_args->end(), args->begin() + 1, args->end());
+    first_seen_ = false;
+  }
+  return true;
+}
+
 rocksdb::Status WriteBatchExtractor::DeleteRangeCF(uint32_t column_family_id, const Slice &begin_key,
                                                    const Slice &end_key) {
   // Do nothing about DeleteRange operations
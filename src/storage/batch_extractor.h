@@ -23,6 +23,7 @@
 #include <string>
 #include <vector>
 
+#include "cluster/redis_slot.h"
 #include "redis_db.h"
 #include "redis_metadata.h"
 #include "status.h"
@@ -32,19 +33,30 @@
 class WriteBatchExtractor : public rocksdb::WriteBatch::Handler {
  public:
   explicit WriteBatchExtractor(bool is_slotid_encoded, int16_t slot = -1, bool to_redis = false)
-      : is_slotid_encoded_(is_slotid_encoded), slot_(slot), to_redis_(to_redis) {}
+      : WriteBatchExtractor(is_slotid_encoded, slot >= 0 ? SlotRange(slot) : SlotRange(), to_redis) {}
+  // Only extract the updates of the keys in the slots if the slot range is valid
+  WriteBatchExtractor(bool is_slotid_encoded, const SlotRange &slots, bool to_redis)
+      : is_slotid_encoded_(is_slotid_encoded), slots_(slots), to_redis_(to_redis) {}
   void LogData(const rocksdb::Slice &blob) override;
   rocksdb::Status PutCF(uint32_t column_family_id, const Slice &key, const Slice &value) override;
 
   rocksdb::Status DeleteCF(uint32_t column_family_id, const Slice &key) override;
+  rocksdb::Status MergeCF(uint32_t column_family_id, const Slice &key, const Slice &value) override;
   rocksdb::Status DeleteRangeCF(uint32_t column_family_id, const Slice &begin_key, const Slice &end_key) override;
   std::map<std::string, std::vector<std::string>> *GetRESPCommands() { return &resp_commands_; }
+  // The type of the key written by the batch, it's none if the batch has no redis type log data
+  RedisType GetRedisType() { return log_data_.GetRedisType(); }
 
  private:
+  bool sortedintBlockCommand(const std::string &user_key, std::vector<std::string> *command_args);
+  bool isFilteredOut(const std::string &user_key) const {
+    return slots_.IsValid() && !slots_.Contains(GetSlotNumFromKey(user_key));
+  }
+
   std::map<std::string, std::vector<std::string>> resp_commands_;
   Redis::WriteBatchLogData log_data_;
   bool first_seen_ = true;
   bool is_slotid_encoded_ = false;
-  int slot_;
+  SlotRange slots_;
   bool to_redis_;
 };
@@ -0,0 +1,182 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "cache_warmer.h"
+
+#include <glog/logging.h>
+#include <rocksdb/env.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "db_util.h"
+#include "encoding.h"
+#include "redis_metadata.h"
+#include "storage.h"
+#include "thread_util.h"
+
+namespace Engine {
+
+CacheWarmer::CacheWarmer(Storage *storage)
+    : storage_(storage), max_keys_(static_cast<size_t>(storage->GetConfig()->cache_warmup_keys)) {}
+
+CacheWarmer::~CacheWarmer() { Stop(); }
+
+void CacheWarmer::Sample(const rocksdb::Slice &ns_key) {
+  if (!Enabled() || reads_.fetch_add(1, std::memory_order_relaxed) % kSampleInterval != 0) return;
+
+  std::lock_guard<std::mutex> guard(mu_);
+  if (samples_.size() < max_keys_ * kSamplesPerKey) {
+    samples_.emplace_back(ns_key.ToString());
+  } else {
+    samples_[next_sample_].assign(ns_key.data(), ns_key.size());
+    next_sample_ = (next_sample_ + 1) % samples_.size();
+  }
+}
+
+Status CacheWarmer::Dump() {
+  std::string data;
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    std::unordered_map<std::string_view, size_t> counts;
+    for (const auto &key : samples_) counts[key]++;
+    std::vector<std::pair<std::string_view, size_t>> keys(counts.begin(), counts.end());
+    std::sort(keys.begin(), keys.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+    if (keys.size() > max_keys_) keys.resize(max_keys_);
+    for (const auto &[key, _] : keys) {
+      PutFixed32(&data, static_cast<uint32_t>(key.size()));
+      data.append(key.data(), key.size());
+    }
+  }
+  if (data.empty()) return Status::OK();
+
+  auto env = rocksdb::Env::Default();
+  std::string path = dumpPath(), tmp_path = path + ".tmp";
+  auto s = rocksdb::WriteStringToFile(env, data, tmp_path, true);
+  if (s.ok()) s = env->RenameFile(tmp_path, path);
+  if (!s.ok()) return {Status::NotOK, s.ToString()};
+  return Status::OK();
+}
+
+void CacheWarmer::Start() {
+  if (!Enabled() || thread_.joinable()) return;
+
+  auto env = rocksdb::Env::Default();
+  std::string path = dumpPath(), data;
+  if (!env->FileExists(path).ok()) return;
+  auto s = rocksdb::ReadFileToString(env, path, &data);
+  env->DeleteFile(path);
+  if (!s.ok()) {
+    LOG(WARNING) << "[cache_warmer] Failed to read the dumped keys, err: " << s.ToString();
+    return;
+  }
+
+  std::vector<std::string> keys;
+  rocksdb::Slice input(data);
+  uint32_t size = 0;
+  while (GetFixed32(&input, &size) && size <= input.size()) {
+    keys.emplace_back(input.data(), size);
+    input.remove_prefix(size);
+  }
+  if (keys.empty()) return;
+
+  total_keys_ = keys.size();
+  warming_ = true;
+  thread_ = std::thread([this, keys = std::move(keys)]() mutable {
+    Util::ThreadSetName("cache-warmer");
+    loop(std::move(keys));
+  });
+}
+
+void CacheWarmer::Stop() {
+  stop_ = true;
+  if (thread_.joinable()) thread_.join();
+}
+
+std::string CacheWarmer::dumpPath() const { return storage_->GetConfig()->dir + "/cache_warmup_keys"; }
+
+void CacheWarmer::loop(std::vector<std::string> keys) {
+  auto start = std::chrono::steady_clock::now();
+  for (const auto &ns_key : keys) {
+    if (stop_) break;
+    auto s = warmup(ns_key);
+    if (!s.ok()) {
+      LOG(WARNING) << "[cache_warmer] Failed to prefetch the key, err: " << s.ToString();
+      break;
+    }
+    warmed_keys_.fetch_add(1, std::memory_order_relaxed);
+    int rate = std::max(storage_->GetConfig()->cache_warmup_keys_per_sec, 1);
+    std::this_thread::sleep_for(std::chrono::microseconds(1000000 / rate));
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  LOG(INFO) << "[cache_warmer] Prefetched " << warmed_keys_ << "/" << total_keys_ << " keys in " << elapsed.count()
+            << " ms";
+  warming_ = false;
+}
+
+rocksdb::Status CacheWarmer::warmup(const std::string &ns_key) {
+  auto guard = storage_->ReadLockGuard();
+  // The DB may be closed or reopened for the full synchronization
+  if (storage_->IsClosing() || storage_->GetDB() == nullptr) return rocksdb::Status::OK();
+
+  rocksdb::ReadOptions read_options;
+  std::string bytes;
+  auto s = storage_->Get(read_options, storage_->GetCFHandle(kMetadataColumnFamilyName), ns_key, &bytes);
+  if (s.IsNotFound()) return rocksdb::Status::OK();
+  if (!s.ok()) return s;
+
+  Metadata metadata(kRedisNone, false);
+  if (!metadata.Decode(bytes).ok() || metadata.Expired()) return rocksdb::Status::OK();
+  const char *cf_name = nullptr;
+  switch (metadata.Type()) {
+    case kRedisHash:
+    case kRedisSet:
+    case kRedisZSet:
+    case kRedisList:
+    case kRedisBitmap:
+    case kRedisSortedint:
+    case kRedisHyperLogLog:
+    case kRedisBloomFilter:
+      cf_name = kSubkeyColumnFamilyName;
+      break;
+    case kRedisStream:
+      cf_name = kStreamColumnFamilyName;
+      break;
+    default:
+      return rocksdb::Status::OK();
+  }
+
+  bool slot_id_encoded = storage_->IsSlotIdEncoded();
+  std::string begin_key, end_key;
+  InternalKey(ns_key, "", metadata.version, slot_id_encoded).Encode(&begin_key);
+  InternalKey(ns_key, "", metadata.version + 1, slot_id_encoded).Encode(&end_key);
+  rocksdb::Slice lower_bound(begin_key), upper_bound(end_key);
+  read_options.iterate_lower_bound = &lower_bound;
+  read_options.iterate_upper_bound = &upper_bound;
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, storage_->GetCFHandle(cf_name)));
+  int subkeys = 0;
+  for (iter->Seek(begin_key); iter->Valid() && subkeys < kMaxWarmupSubkeys; iter->Next()) subkeys++;
+  return iter->status();
+}
+
+}  // namespace Engine
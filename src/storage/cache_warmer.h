@@ -0,0 +1,86 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <rocksdb/slice.h>
+#include <rocksdb/status.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "status.h"
+
+namespace Engine {
+
+class Storage;
+
+// CacheWarmer samples the keys whose metadata are read, and dumps the hottest of them into
+// a file on shutdown. After the restart, it prefetches the metadata and the first subkeys
+// of the dumped keys in background, so the block cache doesn't have to be refilled by
+// the requests for a long time. The prefetching is rate limited by cache-warmup-keys-per-sec.
+class CacheWarmer {
+ public:
+  explicit CacheWarmer(Storage *storage);
+  ~CacheWarmer();
+
+  CacheWarmer(const CacheWarmer &) = delete;
+  CacheWarmer &operator=(const CacheWarmer &) = delete;
+
+  bool Enabled() const { return max_keys_ > 0; }
+  void Sample(const rocksdb::Slice &ns_key);
+  Status Dump();
+  // Prefetch the keys dumped before the restart, the dump file is removed once loaded
+  void Start();
+  void Stop();
+
+  bool IsWarming() const { return warming_; }
+  size_t GetWarmedKeys() const { return warmed_keys_; }
+  size_t GetTotalKeys() const { return total_keys_; }
+
+  // Only one of the reads is sampled, and the samples are kept for several times of
+  // the dumped keys to find the hottest ones
+  static const uint64_t kSampleInterval = 16;
+  static const size_t kSamplesPerKey = 4;
+  // The subkeys of the large collections are only partially prefetched
+  static const int kMaxWarmupSubkeys = 128;
+
+ private:
+  std::string dumpPath() const;
+  void loop(std::vector<std::string> keys);
+  rocksdb::Status warmup(const std::string &ns_key);
+
+  Storage *storage_;
+  size_t max_keys_;
+  std::mutex mu_;
+  std::vector<std::string> samples_;
+  size_t next_sample_ = 0;
+  std::atomic<uint64_t> reads_{0};
+  std::atomic<bool> stop_{false};
+  std::atomic<bool> warming_{false};
+  std::atomic<size_t> warmed_keys_{0};
+  std::atomic<size_t> total_keys_{0};
+  std::thread thread_;
+};
+
+}  // namespace Engine
@@ -25,6 +25,8 @@
 #include <string>
 #include <utility>
 
+#include "key_reclaimer.h"
+#include "time_util.h"
 #include "types/redis_bitmap.h"
 
 namespace Engine {
@@ -44,34 +46,36 @@ bool MetadataFilter::Filter(int level, const Slice &key, const Slice &value, std
   DLOG(INFO) << "[compact_filter/metadata] "
              << "namespace: " << ns << ", key: " << user_key
              << ", result: " << (metadata.Expired() ? "deleted" : "reserved");
-  return metadata.Expired();
+  if (!metadata.Expired()) return false;
+  // Reclaim the subkeys of large keys in background rather than filtering them one by one
+  stor_->GetKeyReclaimer()->Reclaim(key, metadata);
+  if (stor_->GetConfig()->key_count_tracking) {
+    auto metadata_cf_handle = stor_->RouteCFHandle(stor_->GetCFHandle(kMetadataColumnFamilyName), key);
+    stor_->GetKeyCounter()->DropExpired(stor_->GetDB(), metadata_cf_handle, key, value);
+  }
+  return true;
 }
 
+SubKeyFilter::SubKeyFilter(Storage *storage)
+    : cached_key_(""),
+      cached_metadata_(""),
+      stor_(storage),
+      writing_version_epoch_(storage->RegisterCompactionFilter()) {}
+
+SubKeyFilter::~SubKeyFilter() { stor_->UnregisterCompactionFilter(writing_version_epoch_); }
+
 Status SubKeyFilter::GetMetadata(const InternalKey &ikey, Metadata *metadata) const {
   std::string metadata_key;
 
-  auto db = stor_->GetDB();
-  const auto cf_handles = stor_->GetCFHandles();
-  // storage close the would delete the column family handler and DB
-  if (!db || cf_handles->size() < 2) return Status(Status::NotOK, "storage is closed");
   ComposeNamespaceKey(ikey.GetNamespace(), ikey.GetKey(), &metadata_key, stor_->IsSlotIdEncoded());
-
   if (cached_key_.empty() || metadata_key != cached_key_) {
-    std::string bytes;
-    rocksdb::Status s = db->Get(rocksdb::ReadOptions(), (*cf_handles)[1], metadata_key, &bytes);
-    cached_key_ = std::move(metadata_key);
-    if (s.ok()) {
-      cached_metadata_ = std::move(bytes);
-    } else if (s.IsNotFound()) {
-      // metadata was deleted(perhaps compaction or manual)
-      // clear the metadata
-      cached_metadata_.clear();
-      return Status(Status::NotFound, "metadata is not found");
-    } else {
+    Status s = fetchMetadata(metadata_key, &cached_metadata_);
+    if (!s.IsOK()) {
       cached_key_.clear();
       cached_metadata_.clear();
-      return Status(Status::NotOK, "fetch error: " + s.ToString());
+      return s;
     }
+    cached_key_ = std::move(metadata_key);
   }
   // the metadata was not found
   if (cached_metadata_.empty()) return Status(Status::NotFound, "metadata is not found");
@@ -80,26 +84,87 @@ Status SubKeyFilter::GetMetadata(const InternalKey &ikey, Metadata *metadata) co
   if (!s.ok()) {
     cached_key_.clear();
     return Status(Status::NotOK, "decode error: " + s.ToString());
-    ;
+  }
+  return Status::OK();
+}
+
+Status SubKeyFilter::fetchMetadata(const std::string &metadata_key, std::string *bytes) const {
+  auto iter = recent_metadata_index_.find(metadata_key);
+  if (iter != recent_metadata_index_.end()) {
+    recent_metadata_.splice(recent_metadata_.begin(), recent_metadata_, iter->second);
+    *bytes = iter->second->second;
+    return Status::OK();
+  }
+
+  auto db = stor_->GetDB();
+  const auto cf_handles = stor_->GetCFHandles();
+  // storage close the would delete the column family handler and DB
+  if (!db || cf_handles->size() < 2) return Status(Status::NotOK, "storage is closed");
+
+  bytes->clear();
+  bool value_found = false;
+  rocksdb::ReadOptions read_options;
+  read_options.fill_cache = false;
+  // The metadata of the deleted keys could be excluded by the bloom filter without any I/O,
+  // and the value may be found in the memtable or the block cache.
+  auto metadata_cf_handle = stor_->RouteCFHandle((*cf_handles)[1], metadata_key);
+  if (db->KeyMayExist(read_options, metadata_cf_handle, metadata_key, bytes, &value_found) && !value_found) {
+    rocksdb::Status s = db->Get(read_options, metadata_cf_handle, metadata_key, bytes);
+    if (s.IsNotFound()) {
+      // metadata was deleted(perhaps compaction or manual)
+      bytes->clear();
+    } else if (!s.ok()) {
+      return Status(Status::NotOK, "fetch error: " + s.ToString());
+    }
+  } else if (!value_found) {
+    bytes->clear();
+  }
+
+  recent_metadata_.emplace_front(metadata_key, *bytes);
+  recent_metadata_index_[metadata_key] = recent_metadata_.begin();
+  if (recent_metadata_.size() > kMaxRecentMetadata) {
+    recent_metadata_index_.erase(recent_metadata_.back().first);
+    recent_metadata_.pop_back();
   }
   return Status::OK();
 }
 
 bool SubKeyFilter::IsMetadataExpired(const InternalKey &ikey, const Metadata &metadata) const {
-  if (metadata.Type() == kRedisString  // metadata key was overwrite by set command
-      || metadata.Expired() || ikey.GetVersion() != metadata.version) {
+  // metadata key was overwrite by set command, only the chunked strings have the subkeys
+  if ((metadata.Type() == kRedisString && !metadata.IsChunkedString()) || metadata.Expired() ||
+      ikey.GetVersion() != metadata.version) {
     return true;
   }
   return false;
 }
 
+bool SubKeyFilter::IsStreamEntryTrimmed(const InternalKey &ikey) const {
+  // the groups and consumers are sorted after the entries with the longer subkeys
+  Slice sub_key = ikey.GetSubKey();
+  if (sub_key.size() != 2 * sizeof(uint64_t)) return false;
+
+  if (watermark_key_ != cached_key_) {
+    StreamMetadata metadata(false);
+    if (!metadata.Decode(cached_metadata_).ok()) return false;
+    watermark_key_ = cached_key_;
+    watermark_ = metadata.retention_watermark;
+  }
+  Redis::StreamEntryID id;
+  GetFixed64(&sub_key, &id.ms);
+  GetFixed64(&sub_key, &id.seq);
+  return id < watermark_;
+}
+
 rocksdb::CompactionFilter::Decision SubKeyFilter::FilterBlobByKey(int level, const Slice &key, std::string *new_value,
                                                                   std::string *skip_until) const {
   InternalKey ikey(key, stor_->IsSlotIdEncoded());
   Metadata metadata(kRedisNone, false);
   Status s = GetMetadata(ikey, &metadata);
   if (s.Is<Status::NotFound>()) {
-    return rocksdb::CompactionFilter::Decision::kRemove;
+    // the metadata of the version which is written in chunks may not be there yet
+    return stor_->IsWritingVersion(ikey.GetVersion(), writing_version_epoch_)
+               ? rocksdb::CompactionFilter::Decision::kKeep
+               : rocksdb::CompactionFilter::Decision::kRemove;
   }
   if (!s.IsOK()) {
     LOG(ERROR) << "[compact_filter/subkey] Failed to get metadata"
@@ -112,7 +177,10 @@ rocksdb::CompactionFilter::Decision SubKeyFilter::FilterBlobByKey(int level, con
     return rocksdb::CompactionFilter::Decision::kUndetermined;
   }
 
-  bool result = IsMetadataExpired(ikey, metadata);
+  if (ikey.GetVersion() != metadata.version && stor_->IsWritingVersion(ikey.GetVersion(), writing_version_epoch_)) {
+    return rocksdb::CompactionFilter::Decision::kKeep;
+  }
+  bool result = IsMetadataExpired(ikey, metadata) || (metadata.Type() == kRedisStream && IsStreamEntryTrimmed(ikey));
   return result ? rocksdb::CompactionFilter::Decision::kRemove : rocksdb::CompactionFilter::Decision::kKeep;
 }
 
@@ -122,7 +190,8 @@ bool SubKeyFilter::Filter(int level, const Slice &key, const Slice &value, std::
   Metadata metadata(kRedisNone, false);
   Status s = GetMetadata(ikey, &metadata);
   if (s.Is<Status::NotFound>()) {
-    return true;
+    // the metadata of the version which is written in chunks may not be there yet
+    return !stor_->IsWritingVersion(ikey.GetVersion(), writing_version_epoch_);
   }
   if (!s.IsOK()) {
     LOG(ERROR) << "[compact_filter/subkey] Failed to get metadata"
@@ -131,7 +200,20 @@ bool SubKeyFilter::Filter(int level, const Slice &key, const Slice &value, std::
     return false;
   }
 
-  return IsMetadataExpired(ikey, metadata) || (metadata.Type() == kRedisBitmap && Redis::Bitmap::IsEmptySegment(value));
+  if (ikey.GetVersion() != metadata.version && stor_->IsWritingVersion(ikey.GetVersion(), writing_version_epoch_)) {
+    return false;
+  }
+  if (IsMetadataExpired(ikey, metadata)) return true;
+  return (metadata.Type() == kRedisBitmap && Redis::Bitmap::IsEmptySegment(value)) ||
+         (metadata.Type() == kRedisStream && IsStreamEntryTrimmed(ikey));
+}
+
+bool TTLIndexFilter::Filter(int level, const Slice &key, const Slice &value, std::string *new_value,
+                            bool *modified) const {
+  // The due entries would be dropped by the reaper, but they would be left forever
+  // if the reaper was disabled, drop them here in this case.
+  if (stor_->GetConfig()->active_expire_enabled || key.size() < 4) return false;
+  return DecodeFixed32(key.data()) < static_cast<uint32_t>(Util::GetTimeStamp());
 }
 
 }  // namespace Engine
@@ -23,8 +23,11 @@
 #include <rocksdb/compaction_filter.h>
 #include <rocksdb/db.h>
 
+#include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "redis_metadata.h"
@@ -36,6 +39,8 @@ class MetadataFilter : public rocksdb::CompactionFilter {
   explicit MetadataFilter(Storage *storage) : stor_(storage) {}
   const char *Name() const override { return "MetadataFilter"; }
   bool Filter(int level, const Slice &key, const Slice &value, std::string *new_value, bool *modified) const override;
+  // The counter increments are kept, the merge operator starts from zero if the base value was expired and dropped
+  bool FilterMergeOperand(int level, const Slice &key, const Slice &operand) const override { return false; }
 
  private:
   Engine::Storage *stor_;
@@ -56,19 +61,37 @@ class MetadataFilterFactory : public rocksdb::CompactionFilterFactory {
 
 class SubKeyFilter : public rocksdb::CompactionFilter {
  public:
-  explicit SubKeyFilter(Storage *storage) : cached_key_(""), cached_metadata_(""), stor_(storage) {}
+  explicit SubKeyFilter(Storage *storage);
+  ~SubKeyFilter() override;
+  SubKeyFilter(const SubKeyFilter &) = delete;
+  SubKeyFilter &operator=(const SubKeyFilter &) = delete;
 
   const char *Name() const override { return "SubkeyFilter"; }
   Status GetMetadata(const InternalKey &ikey, Metadata *metadata) const;
   bool IsMetadataExpired(const InternalKey &ikey, const Metadata &metadata) const;
+  bool IsStreamEntryTrimmed(const InternalKey &ikey) const;
   rocksdb::CompactionFilter::Decision FilterBlobByKey(int level, const Slice &key, std::string *new_value,
                                                       std::string *skip_until) const override;
   bool Filter(int level, const Slice &key, const Slice &value, std::string *new_value, bool *modified) const override;
 
+  // The number of the recently looked up metadata kept in each compaction
+  static const size_t kMaxRecentMetadata = 1024;
+
  protected:
+  Status fetchMetadata(const std::string &metadata_key, std::string *bytes) const;
+
   mutable std::string cached_key_;
   mutable std::string cached_metadata_;
+  // The retention watermark of the stream of cached_key_
+  mutable std::string watermark_key_;
+  mutable Redis::StreamEntryID watermark_;
+  // LRU of the recently looked up metadata, and the empty value means not found
+  mutable std::list<std::pair<std::string, std::string>> recent_metadata_;
+  mutable std::unordered_map<std::string, std::list<std::pair<std::string, std::string>>::iterator>
+      recent_metadata_index_;
   Engine::Storage *stor_;
+  // The writing versions finished after this epoch are still kept, see Storage::IsWritingVersion
+  uint64_t writing_version_epoch_;
 };
 
 class SubKeyFilterFactory : public rocksdb::CompactionFilterFactory {
@@ -122,4 +145,27 @@ class PubSubFilterFactory : public rocksdb::CompactionFilterFactory {
     return std::unique_ptr<rocksdb::CompactionFilter>(new PubSubFilter());
   }
 };
+
+class TTLIndexFilter : public rocksdb::CompactionFilter {
+ public:
+  explicit TTLIndexFilter(Storage *storage) : stor_(storage) {}
+  const char *Name() const override { return "TTLIndexFilter"; }
+  bool Filter(int level, const Slice &key, const Slice &value, std::string *new_value, bool *modified) const override;
+
+ private:
+  Engine::Storage *stor_;
+};
+
+class TTLIndexFilterFactory : public rocksdb::CompactionFilterFactory {
+ public:
+  explicit TTLIndexFilterFactory(Engine::Storage *storage) { stor_ = storage; }
+  const char *Name() const override { return "TTLIndexFilterFactory"; }
+  std::unique_ptr<rocksdb::CompactionFilter> CreateCompactionFilter(
+      const rocksdb::CompactionFilter::Context &context) override {
+    return std::unique_ptr<rocksdb::CompactionFilter>(new TTLIndexFilter(stor_));
+  }
+
+ private:
+  Engine::Storage *stor_ = nullptr;
+};
 }  // namespace Engine
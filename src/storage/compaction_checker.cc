@@ -22,8 +22,11 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
+
 #include "parse_util.h"
 #include "storage.h"
+#include "table_properties_collector.h"
 #include "time_util.h"
 
 void CompactionChecker::CompactPropagateAndPubSubFiles() {
@@ -38,6 +41,28 @@ void CompactionChecker::CompactPropagateAndPubSubFiles() {
   }
 }
 
+void CompactionChecker::CompactTombstoneRanges(uint64_t threshold) {
+  // Bound the compactions of every check, the remaining ranges are picked by the next checks
+  constexpr size_t kMaxRangesPerCheck = 4;
+  auto ranges = storage_->GetTombstoneTracker()->PickRanges(threshold, kMaxRangesPerCheck);
+  if (ranges.empty()) return;
+
+  auto cf_handles = storage_->GetAllCFHandles();
+  rocksdb::CompactRangeOptions compact_opts;
+  compact_opts.exclusive_manual_compaction = false;
+  for (const auto &range : ranges) {
+    auto iter = std::find_if(cf_handles.begin(), cf_handles.end(),
+                             [&range](rocksdb::ColumnFamilyHandle *cf) { return cf->GetID() == range.cf_id; });
+    if (iter == cf_handles.end()) continue;
+    rocksdb::Slice begin(range.begin), end(range.end);
+    LOG(INFO) << "[compaction checker] Going to compact the range with " << range.skipped
+              << " skipped tombstones, density: " << range.Density() << ", column family: " << (*iter)->GetName();
+    auto s = storage_->GetDB()->CompactRange(compact_opts, *iter, &begin, &end);
+    LOG(INFO) << "[compaction checker] Compact the range with tombstones in column family: " << (*iter)->GetName()
+              << " finished, result: " << s.ToString();
+  }
+}
+
 void CompactionChecker::PickCompactionFiles(const std::string &cf_name) {
   rocksdb::TablePropertiesCollection props;
   rocksdb::ColumnFamilyHandle *cf = storage_->GetCFHandle(cf_name);
@@ -76,8 +101,9 @@ void CompactionChecker::PickCompactionFiles(const std::string &cf_name) {
       }
     }
 
-    // don't compact the SST created in 1 hour
-    if (file_creation_time > static_cast<uint64_t>(now - 3600)) continue;
+    // The properties are missing in the files written by the old versions
+    total_keys = deleted_keys = 0;
+    start_key = stop_key = rocksdb::Slice();
     for (const auto &property_iter : iter.second->user_collected_properties) {
       if (property_iter.first == "total_keys") {
         auto parse_result = ParseInt<int>(property_iter.second, 10);
@@ -104,6 +130,13 @@ void CompactionChecker::PickCompactionFiles(const std::string &cf_name) {
     }
 
     if (start_key.empty() || stop_key.empty()) continue;
+    // The keys expired since the file was written are estimated by the range of the expire timestamps
+    deleted_keys = std::max(deleted_keys, EstimateDeletedKeys(iter.second->user_collected_properties, now));
+    double delete_ratio = total_keys > 0 ? static_cast<double>(deleted_keys) / static_cast<double>(total_keys) : 0;
+    // don't compact the SST created in 1 hour, unless most of its keys were expired, e.g. the short TTL keys
+    if (file_creation_time > static_cast<uint64_t>(now - 3600) && delete_ratio < 0.5) {
+      continue;
+    }
     // pick the file which was created more than 2 days
     if (file_creation_time < static_cast<uint64_t>(now - forceCompactSeconds)) {
       LOG(INFO) << "[compaction checker] Going to compact the key in file(created more than 2 days): " << iter.first;
@@ -113,7 +146,6 @@ void CompactionChecker::PickCompactionFiles(const std::string &cf_name) {
       maxFilesToCompact--;
     }
     // pick the file which has highest delete ratio
-    double delete_ratio = static_cast<double>(deleted_keys) / static_cast<double>(total_keys);
     if (total_keys != 0 && delete_ratio > best_delete_ratio) {
       best_delete_ratio = delete_ratio;
       best_filename = iter.first;
@@ -32,6 +32,8 @@ class CompactionChecker {
   ~CompactionChecker() {}
   void PickCompactionFiles(const std::string &cf_name);
   void CompactPropagateAndPubSubFiles();
+  // Compact the key ranges where the iterators skipped at least threshold tombstones
+  void CompactTombstoneRanges(uint64_t threshold);
 
  private:
   Engine::Storage *storage_ = nullptr;
@@ -0,0 +1,215 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "compaction_scheduler.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+#include "thread_util.h"
+#include "time_util.h"
+
+Status CompactionScheduler::Run(const Options &options) {
+  joinThreads();
+
+  std::lock_guard<std::mutex> guard(mu_);
+  if (running_threads_ > 0) return {Status::NotOK, "scheduled compaction in-progress"};
+  if (pending_jobs_.empty()) {
+    std::vector<rocksdb::LiveFileMetaData> all_files;
+    storage_->GetDB()->GetLiveFilesMetaData(&all_files);
+    std::map<std::string, std::vector<rocksdb::LiveFileMetaData>> cf_files;
+    for (auto &file : all_files) {
+      cf_files[file.column_family_name].emplace_back(std::move(file));
+    }
+    uint64_t total_bytes = 0;
+    for (const auto &cf_handle : storage_->GetAllCFHandles()) {
+      auto iter = cf_files.find(cf_handle->GetName());
+      if (iter == cf_files.end()) continue;
+      for (auto &job : PlanSubJobs(iter->first, std::move(iter->second), kSubJobTargetBytes)) {
+        total_bytes += job.bytes;
+        pending_jobs_.emplace_back(std::move(job));
+      }
+    }
+    total_jobs_ = pending_jobs_.size();
+    total_bytes_ = total_bytes;
+    done_jobs_ = 0;
+    done_bytes_ = 0;
+    LOG(INFO) << "[compaction scheduler] Planned " << total_jobs_ << " sub-jobs to compact " << total_bytes_
+              << " bytes";
+  } else {
+    LOG(INFO) << "[compaction scheduler] Resume the remaining " << pending_jobs_.size() << " sub-jobs";
+  }
+  if (pending_jobs_.empty()) return Status::OK();
+
+  options_ = options;
+  stop_ = false;
+  run_start_us_ = static_cast<int64_t>(Util::GetTimeStampUS());
+  run_bytes_ = 0;
+  int threads = std::min(std::max(options_.parallelism, 1), static_cast<int>(pending_jobs_.size()));
+  for (int i = 0; i < threads; i++) {
+    try {
+      threads_.emplace_back([this]() {
+        Util::ThreadSetName("compact-sched");
+        loop();
+      });
+      running_threads_++;
+    } catch (const std::system_error &e) {
+      LOG(WARNING) << "[compaction scheduler] Failed to start the compaction thread: " << e.what();
+      break;
+    }
+  }
+  if (running_threads_ == 0) return {Status::NotOK, "failed to start the compaction threads"};
+  return Status::OK();
+}
+
+void CompactionScheduler::Stop() {
+  stop_ = true;
+  joinThreads();
+  std::lock_guard<std::mutex> guard(mu_);
+  pending_jobs_.clear();
+}
+
+void CompactionScheduler::joinThreads() {
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    // The threads are still running, they're joined after they exit
+    if (running_threads_ > 0 && !stop_) return;
+    threads.swap(threads_);
+  }
+  for (auto &t : threads) {
+    if (t.joinable()) t.join();
+  }
+}
+
+CompactionScheduler::State CompactionScheduler::GetState() {
+  std::lock_guard<std::mutex> guard(mu_);
+  if (running_threads_ > 0) return State::kRunning;
+  return pending_jobs_.empty() ? State::kIdle : State::kPaused;
+}
+
+const char *CompactionScheduler::StateName(State state) {
+  switch (state) {
+    case State::kRunning:
+      return "running";
+    case State::kPaused:
+      return "paused";
+    default:
+      return "idle";
+  }
+}
+
+std::vector<CompactionScheduler::SubJob> CompactionScheduler::PlanSubJobs(
+    const std::string &cf_name, std::vector<rocksdb::LiveFileMetaData> files, uint64_t target_bytes) {
+  std::sort(files.begin(), files.end(), [](const rocksdb::LiveFileMetaData &a, const rocksdb::LiveFileMetaData &b) {
+    return a.smallestkey < b.smallestkey;
+  });
+
+  std::vector<SubJob> jobs;
+  SubJob job{cf_name, "", "", 0};
+  for (const auto &file : files) {
+    // The sub-jobs never split the files, since the end key of CompactRange is inclusive, the boundary
+    // key may be compacted by both sub-jobs around it
+    if (job.bytes >= target_bytes) {
+      job.end = file.smallestkey;
+      jobs.emplace_back(std::move(job));
+      job = SubJob{cf_name, file.smallestkey, "", 0};
+    }
+    job.bytes += file.size;
+  }
+  if (job.bytes > 0) jobs.emplace_back(std::move(job));
+  return jobs;
+}
+
+bool CompactionScheduler::pace() {
+  uint64_t max_io_bytes_per_sec = 0;
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    max_io_bytes_per_sec = options_.max_io_bytes_per_sec;
+  }
+  if (max_io_bytes_per_sec == 0) return !stop_;
+
+  while (!stop_) {
+    int64_t expected_us = 0;
+    {
+      std::lock_guard<std::mutex> guard(mu_);
+      expected_us = run_start_us_ + static_cast<int64_t>(static_cast<double>(run_bytes_) * 1000 * 1000 /
+                                                         static_cast<double>(max_io_bytes_per_sec));
+    }
+    auto now = static_cast<int64_t>(Util::GetTimeStampUS());
+    if (now >= expected_us) return true;
+    std::this_thread::sleep_for(std::chrono::microseconds(std::min<int64_t>(expected_us - now, 100 * 1000)));
+  }
+  return false;
+}
+
+void CompactionScheduler::loop() {
+  while (true) {
+    SubJob job;
+    {
+      std::lock_guard<std::mutex> guard(mu_);
+      auto now = static_cast<int64_t>(Util::GetTimeStampUS());
+      bool window_over = options_.window_seconds > 0 && now - run_start_us_ >= options_.window_seconds * 1000 * 1000;
+      if (stop_ || window_over || pending_jobs_.empty()) {
+        if (window_over && !stop_ && !pending_jobs_.empty() && running_threads_ == 1) {
+          LOG(INFO) << "[compaction scheduler] The time window is over, pause the remaining " << pending_jobs_.size()
+                    << " sub-jobs until the next schedule";
+        }
+        running_threads_--;
+        return;
+      }
+      job = std::move(pending_jobs_.front());
+      pending_jobs_.pop_front();
+    }
+
+    rocksdb::Status s;
+    {
+      // To guarantee accessing DB safely, the sub-job is put back when closing the DB
+      auto guard = storage_->ReadLockGuard();
+      if (storage_->IsClosing()) {
+        std::lock_guard<std::mutex> lg(mu_);
+        pending_jobs_.emplace_front(std::move(job));
+        running_threads_--;
+        return;
+      }
+      rocksdb::CompactRangeOptions compact_opts;
+      // Don't block the automatic compactions, and the IO is paced by the sub-jobs
+      compact_opts.exclusive_manual_compaction = false;
+      compact_opts.canceled = &stop_;
+      rocksdb::Slice begin(job.begin), end(job.end);
+      s = storage_->GetDB()->CompactRange(compact_opts, storage_->GetCFHandle(job.cf_name),
+                                          job.begin.empty() ? nullptr : &begin, job.end.empty() ? nullptr : &end);
+    }
+    if (!s.ok() && !stop_) {
+      LOG(WARNING) << "[compaction scheduler] Failed to compact the sub-job in " << job.cf_name
+                   << ", err: " << s.ToString();
+    }
+    done_jobs_++;
+    done_bytes_ += job.bytes;
+    {
+      std::lock_guard<std::mutex> guard(mu_);
+      run_bytes_ += job.bytes;
+    }
+    pace();
+  }
+}
@@ -0,0 +1,106 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "status.h"
+#include "storage.h"
+
+// Run the scheduled compaction (compact-cron) of the whole DB as the sub-jobs of the key ranges in every
+// column family, which are compacted by the parallel threads at a target average IO rate. The remaining
+// sub-jobs are paused once the time window of the run is over, and resumed by the next run, so the
+// compaction of a large DB could spread over the low traffic hours of several days.
+class CompactionScheduler {
+ public:
+  struct SubJob {
+    std::string cf_name;
+    // The empty keys mean unbounded
+    std::string begin;
+    std::string end;
+    uint64_t bytes = 0;
+  };
+
+  struct Options {
+    int parallelism = 1;
+    // The target average IO rate of the compactions, 0 means unlimited
+    uint64_t max_io_bytes_per_sec = 0;
+    // The sub-jobs are paused after running that long, 0 means no limit
+    int64_t window_seconds = 0;
+  };
+
+  enum class State {
+    kIdle,
+    kRunning,
+    kPaused,
+  };
+
+  // The sub-jobs are split at the file boundaries once their files are larger than this
+  static constexpr uint64_t kSubJobTargetBytes = 1ULL << 30;
+
+  explicit CompactionScheduler(Engine::Storage *storage) : storage_(storage) {}
+  ~CompactionScheduler() { Stop(); }
+  CompactionScheduler(const CompactionScheduler &) = delete;
+  CompactionScheduler &operator=(const CompactionScheduler &) = delete;
+
+  // Resume the paused sub-jobs if any, otherwise plan the sub-jobs of the whole DB and run them
+  Status Run(const Options &options);
+  // Cancel the running sub-jobs and drop the remaining ones, it returns after the threads exited
+  void Stop();
+  State GetState();
+  static const char *StateName(State state);
+  uint64_t GetDoneJobs() const { return done_jobs_; }
+  uint64_t GetTotalJobs() const { return total_jobs_; }
+  uint64_t GetDoneBytes() const { return done_bytes_; }
+  uint64_t GetTotalBytes() const { return total_bytes_; }
+
+  // Split the files of the column family into the sub-jobs at their boundaries
+  static std::vector<SubJob> PlanSubJobs(const std::string &cf_name, std::vector<rocksdb::LiveFileMetaData> files,
+                                         uint64_t target_bytes);
+
+ private:
+  Engine::Storage *storage_;
+  std::mutex mu_;
+  std::deque<SubJob> pending_jobs_;
+  std::vector<std::thread> threads_;
+  int running_threads_ = 0;
+  Options options_;
+  // It cancels the running manual compactions as well
+  std::atomic<bool> stop_ = false;
+  // The start of the current run, and the bytes compacted in it, to pace the IO rate
+  int64_t run_start_us_ = 0;
+  uint64_t run_bytes_ = 0;
+  std::atomic<uint64_t> done_jobs_ = 0;
+  std::atomic<uint64_t> total_jobs_ = 0;
+  std::atomic<uint64_t> done_bytes_ = 0;
+  std::atomic<uint64_t> total_bytes_ = 0;
+
+  void loop();
+  void joinThreads();
+  // Sleep until the average IO rate of the run falls to the target, return false if stopped
+  bool pace();
+};
@@ -24,6 +24,10 @@
 #include <string>
 #include <vector>
 
+#include "jemalloc_util.h"
+#include "thread_util.h"
+#include "time_util.h"
+
 const std::string fileCreatedReason2String(const rocksdb::TableFileCreationReason reason) {
   std::vector<std::string> file_created_reason = {"flush", "compaction", "recovery", "misc"};
   if (static_cast<size_t>(reason) < file_created_reason.size()) {
@@ -76,16 +80,66 @@ void EventListener::OnCompactionCompleted(rocksdb::DB *db, const rocksdb::Compac
             << ", input bytes: " << ci.stats.total_input_bytes << ", output bytes:" << ci.stats.total_output_bytes
             << ", is_manual_compaction:" << (ci.stats.is_manual_compaction ? "yes" : "no")
             << ", elapsed(micro): " << ci.stats.elapsed_micros;
+  storage_->GetLatencyMonitor()->Record("compaction", ci.stats.elapsed_micros / 1000);
+  storage_->GetJobStats()->Get(ci.cf_name)->RecordCompaction(ci.stats.elapsed_micros, ci.stats.total_input_bytes,
+                                                             ci.stats.total_output_bytes);
   storage_->IncrCompactionCount(1);
   storage_->CheckDBSizeLimit();
 }
 
+// RocksDB doesn't expose the threads of its thread pools, so bind them to the
+// background CPUs once they start the first job, the sub-compaction threads
+// would inherit the affinity from the compaction thread.
+void EventListener::setBackgroundThreadAffinity() {
+  thread_local bool affinity_set = false;
+  if (affinity_set) return;
+  affinity_set = true;
+  auto s = Util::ThreadSetAffinity(storage_->GetConfig()->background_cpus);
+  if (!s.IsOK()) {
+    LOG(WARNING) << "[event_listener] Failed to set the cpu affinity of background thread, err: " << s.Msg();
+  }
+}
+
+// Bind the threads of the flushes and the compactions to their own arenas likewise, without the
+// thread caches, since they allocate in bursts and would keep the cached memory between the jobs
+void EventListener::setBackgroundThreadArena(const char *name) {
+  if (!storage_->GetConfig()->jemalloc_dedicated_arenas) return;
+  thread_local bool arena_set = false;
+  if (arena_set) return;
+  arena_set = true;
+  auto s = Util::ThreadSetSharedArena(name, false);
+  if (!s.IsOK()) {
+    LOG(WARNING) << "[event_listener] Failed to set the jemalloc arena of background thread, err: " << s.Msg();
+  }
+}
+
+void EventListener::OnCompactionBegin(rocksdb::DB *db, const rocksdb::CompactionJobInfo &ci) {
+  setBackgroundThreadAffinity();
+  setBackgroundThreadArena("compaction");
+}
+
 void EventListener::OnFlushBegin(rocksdb::DB *db, const rocksdb::FlushJobInfo &fi) {
+  setBackgroundThreadAffinity();
+  setBackgroundThreadArena("flush");
+  {
+    std::lock_guard<std::mutex> guard(latency_mu_);
+    flush_start_times_[fi.job_id] = Util::GetTimeStampUS();
+  }
   LOG(INFO) << "[event_listener/flush_begin] column family: " << fi.cf_name << ", thread_id: " << fi.thread_id
             << ", job_id: " << fi.job_id << ", reason: " << static_cast<int>(fi.flush_reason);
 }
 
 void EventListener::OnFlushCompleted(rocksdb::DB *db, const rocksdb::FlushJobInfo &fi) {
+  {
+    std::lock_guard<std::mutex> guard(latency_mu_);
+    auto iter = flush_start_times_.find(fi.job_id);
+    if (iter != flush_start_times_.end()) {
+      auto duration = Util::GetTimeStampUS() - iter->second;
+      storage_->GetLatencyMonitor()->Record("flush", duration / 1000);
+      storage_->GetJobStats()->Get(fi.cf_name)->RecordFlush(duration);
+      flush_start_times_.erase(iter);
+    }
+  }
   storage_->IncrFlushCount(1);
   storage_->CheckDBSizeLimit();
   LOG(INFO) << "[event_listener/flush_completed] column family: " << fi.cf_name << ", thread_id: " << fi.thread_id
@@ -132,9 +186,30 @@ void EventListener::OnStallConditionsChanged(const rocksdb::WriteStallInfo &info
   LOG(WARNING) << "[event_listener/stall_cond_changed] column family: " << info.cf_name
                << " write stall condition was changed, from " << stallConditionType2String(info.condition.prev)
                << " to " << stallConditionType2String(info.condition.cur);
+  storage_->UpdateWriteStallCondition(info.condition.prev, info.condition.cur);
+
+  // The stall lasts from leaving the normal condition until returning to it
+  std::lock_guard<std::mutex> guard(latency_mu_);
+  bool stopped = info.condition.cur == rocksdb::WriteStallCondition::kStopped;
+  if (info.condition.cur == rocksdb::WriteStallCondition::kNormal) {
+    auto iter = write_stalls_.find(info.cf_name);
+    if (iter != write_stalls_.end()) {
+      auto duration = Util::GetTimeStampUS() - iter->second.start_time;
+      storage_->GetLatencyMonitor()->Record("write-stall", duration / 1000);
+      storage_->GetJobStats()->Get(info.cf_name)->RecordStall(iter->second.stopped, duration);
+      write_stalls_.erase(iter);
+    }
+  } else if (info.condition.prev == rocksdb::WriteStallCondition::kNormal) {
+    write_stalls_[info.cf_name] = WriteStall{Util::GetTimeStampUS(), stopped};
+  } else if (auto iter = write_stalls_.find(info.cf_name); iter != write_stalls_.end() && stopped) {
+    iter->second.stopped = true;
+  }
 }
 
 void EventListener::OnTableFileCreated(const rocksdb::TableFileCreationInfo &info) {
+  if (info.status.ok() && info.reason == rocksdb::TableFileCreationReason::kFlush) {
+    storage_->GetJobStats()->Get(info.cf_name)->flushed_bytes.fetch_add(info.file_size, std::memory_order_relaxed);
+  }
   LOG(INFO) << "[event_listener/table_file_created] column family: " << info.cf_name
             << ", file path: " << info.file_path << ", file size: " << info.file_size << ", job id: " << info.job_id
             << ", reason: " << fileCreatedReason2String(info.reason) << ", status: " << info.status.ToString();
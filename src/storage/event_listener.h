@@ -23,6 +23,11 @@
 #include <glog/logging.h>
 #include <rocksdb/listener.h>
 
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
 #include "storage.h"
 
 class EventListener : public rocksdb::EventListener {
@@ -30,6 +35,7 @@ class EventListener : public rocksdb::EventListener {
   explicit EventListener(Engine::Storage *storage) : storage_(storage) {}
   ~EventListener() override = default;
   void OnFlushBegin(rocksdb::DB *db, const rocksdb::FlushJobInfo &fi) override;
+  void OnCompactionBegin(rocksdb::DB *db, const rocksdb::CompactionJobInfo &ci) override;
   void OnFlushCompleted(rocksdb::DB *db, const rocksdb::FlushJobInfo &fi) override;
   void OnCompactionCompleted(rocksdb::DB *db, const rocksdb::CompactionJobInfo &ci) override;
   void OnBackgroundError(rocksdb::BackgroundErrorReason reason, rocksdb::Status *status) override;
@@ -39,4 +45,17 @@ class EventListener : public rocksdb::EventListener {
 
  private:
   Engine::Storage *storage_ = nullptr;
+  struct WriteStall {
+    uint64_t start_time;
+    bool stopped;  // whether the writes were stopped rather than delayed during the stall
+  };
+
+  // The start times in microseconds of the running flushes by the job ids and the write stalls
+  // by the column families, to record their durations into the latency monitor and the job stats
+  std::mutex latency_mu_;
+  std::map<int, uint64_t> flush_start_times_;
+  std::map<std::string, WriteStall> write_stalls_;
+
+  void setBackgroundThreadAffinity();
+  void setBackgroundThreadArena(const char *name);
 };
@@ -0,0 +1,98 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "expire_reaper.h"
+
+#include <rocksdb/write_batch.h>
+
+#include <memory>
+#include <vector>
+
+#include "encoding.h"
+#include "key_reclaimer.h"
+#include "lock_manager.h"
+#include "redis_metadata.h"
+#include "storage.h"
+#include "time_util.h"
+
+namespace Engine {
+
+Status ExpireReaper::ReapOnce(int max_keys) {
+  auto db = storage_->GetDB();
+  if (db == nullptr || max_keys <= 0) return Status::OK();
+
+  // Metadata::Expired() treats the keys with expire timestamp before now as expired
+  std::string upper_bound;
+  PutFixed32(&upper_bound, static_cast<uint32_t>(Util::GetTimeStamp()));
+  rocksdb::Slice upper_bound_slice(upper_bound);
+  rocksdb::ReadOptions read_options;
+  read_options.iterate_upper_bound = &upper_bound_slice;
+  read_options.fill_cache = false;
+
+  std::vector<std::string> index_keys;
+  {
+    std::unique_ptr<rocksdb::Iterator> iter(
+        db->NewIterator(read_options, storage_->GetCFHandle(kTTLIndexColumnFamilyName)));
+    for (iter->SeekToFirst(); iter->Valid() && static_cast<int>(index_keys.size()) < max_keys; iter->Next()) {
+      index_keys.emplace_back(iter->key().ToString());
+    }
+    if (!iter->status().ok()) return Status(Status::NotOK, iter->status().ToString());
+  }
+
+  for (const auto &index_key : index_keys) {
+    auto s = reapKey(index_key);
+    if (!s.IsOK()) return s;
+  }
+  return Status::OK();
+}
+
+Status ExpireReaper::reapKey(const std::string &index_key) {
+  if (index_key.size() < 4) return Status::OK();
+  uint32_t expire = DecodeFixed32(index_key.data());
+  rocksdb::Slice ns_key(index_key.data() + 4, index_key.size() - 4);
+  auto metadata_cf_handle = storage_->RouteCFHandle(storage_->GetCFHandle(kMetadataColumnFamilyName), ns_key);
+
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  std::string value;
+  auto s = storage_->GetDB()->Get(rocksdb::ReadOptions(), metadata_cf_handle, ns_key, &value);
+  if (!s.ok() && !s.IsNotFound()) return Status(Status::NotOK, s.ToString());
+
+  rocksdb::WriteBatch batch;
+  Metadata metadata(kRedisNone, false);
+  bool expired = false;
+  if (s.ok() && metadata.Decode(value).ok() && static_cast<uint32_t>(metadata.expire) == expire &&
+      metadata.Expired()) {
+    batch.Delete(metadata_cf_handle, ns_key);
+    expired = true;
+  }
+  batch.Delete(storage_->GetCFHandle(kTTLIndexColumnFamilyName), index_key);
+  s = storage_->Write(storage_->DefaultWriteOptions(), &batch);
+  if (!s.ok()) return Status(Status::NotOK, s.ToString());
+
+  scanned_entries_.fetch_add(1, std::memory_order_relaxed);
+  last_expire_timestamp_ = expire;
+  if (expired) {
+    expired_keys_.fetch_add(1, std::memory_order_relaxed);
+    storage_->GetKeyReclaimer()->Reclaim(ns_key, metadata);
+  }
+  return Status::OK();
+}
+
+}  // namespace Engine
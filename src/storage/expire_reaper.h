@@ -0,0 +1,59 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "status.h"
+
+namespace Engine {
+
+class Storage;
+
+// ExpireReaper deletes the expired keys actively by the TTL index, which is maintained
+// by Storage::Write when active-expire-enabled is set. The index entries are encoded
+// as [expire timestamp][ns_key], so the due keys are always at the front of the index.
+//
+// An index entry is stale if the key was persisted, re-expired or deleted, the reaper
+// would drop the entry only when the key's expire timestamp mismatches.
+class ExpireReaper {
+ public:
+  explicit ExpireReaper(Storage *storage) : storage_(storage) {}
+
+  // Reap at most max_keys due index entries, the caller must hold the DB read lock
+  Status ReapOnce(int max_keys);
+
+  uint64_t GetExpiredKeys() const { return expired_keys_; }
+  uint64_t GetScannedEntries() const { return scanned_entries_; }
+  uint32_t GetLastExpireTimestamp() const { return last_expire_timestamp_; }
+
+ private:
+  Status reapKey(const std::string &index_key);
+
+  Storage *storage_ = nullptr;
+  std::atomic<uint64_t> expired_keys_{0};
+  std::atomic<uint64_t> scanned_entries_{0};
+  std::atomic<uint32_t> last_expire_timestamp_{0};
+};
+
+}  // namespace Engine
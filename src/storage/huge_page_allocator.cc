@@ -0,0 +1,143 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "huge_page_allocator.h"
+
+#include <glog/logging.h>
+#include <sys/mman.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace Engine {
+
+#ifdef ENABLE_JEMALLOC
+
+StatusOr<std::shared_ptr<HugePageAllocator>> HugePageAllocator::Create() {
+  std::shared_ptr<HugePageAllocator> allocator(new HugePageAllocator());
+  auto &hooks = allocator->hooks_.hooks;
+  hooks.alloc = extentAlloc;
+  // Opt out of the deallocation, decommit and purge, so the extents are retained by the arena,
+  // and merging the extents from the different mappings isn't allowed
+  hooks.destroy = extentDestroy;
+  hooks.split = extentSplit;
+  allocator->hooks_.allocator = allocator.get();
+
+  extent_hooks_t *new_hooks = &allocator->hooks_.hooks;
+  size_t size = sizeof(allocator->arena_);
+  if (int err = mallctl("arenas.create", &allocator->arena_, &size, &new_hooks, sizeof(new_hooks)); err != 0) {
+    return {Status::NotOK, "failed to create the jemalloc arena, err: " + std::string(strerror(err))};
+  }
+  allocator->flags_ = MALLOCX_ARENA(allocator->arena_) | MALLOCX_TCACHE_NONE;
+  return allocator;
+}
+
+HugePageAllocator::~HugePageAllocator() {
+  // The arena wasn't created
+  if (flags_ == 0) return;
+  // All blocks were freed since the caches were destroyed, the extents are destroyed with the arena
+  std::string name = "arena." + std::to_string(arena_) + ".destroy";
+  if (int err = mallctl(name.c_str(), nullptr, nullptr, nullptr, 0); err != 0) {
+    LOG(WARNING) << "[huge page] Failed to destroy the jemalloc arena, err: " << strerror(err);
+    return;
+  }
+  for (const auto &[addr, size] : mappings_) {
+    munmap(addr, size);
+  }
+}
+
+void *HugePageAllocator::Allocate(size_t size) { return mallocx(size, flags_); }
+
+void HugePageAllocator::Deallocate(void *p) { dallocx(p, flags_); }
+
+size_t HugePageAllocator::UsableSize(void *p, size_t /*allocation_size*/) const { return sallocx(p, flags_); }
+
+void *HugePageAllocator::extentAlloc(extent_hooks_t *hooks, void *new_addr, size_t size, size_t alignment,
+                                     bool *zero, bool *commit, unsigned /*arena_ind*/) {
+  // The extent couldn't be placed at the address
+  if (new_addr != nullptr) return nullptr;
+  auto allocator = reinterpret_cast<Hooks *>(hooks)->allocator;
+  void *addr = allocator->mapExtent(size, alignment);
+  if (addr == nullptr) return nullptr;
+  *zero = true;
+  *commit = true;
+  return addr;
+}
+
+// The mappings are unmapped by the allocator after the arena was destroyed, since the extents
+// may have been split from them
+void HugePageAllocator::extentDestroy(extent_hooks_t * /*hooks*/, void * /*addr*/, size_t /*size*/,
+                                      bool /*committed*/, unsigned /*arena_ind*/) {}
+
+bool HugePageAllocator::extentSplit(extent_hooks_t * /*hooks*/, void * /*addr*/, size_t /*size*/,
+                                    size_t /*size_a*/, size_t /*size_b*/, bool /*committed*/,
+                                    unsigned /*arena_ind*/) {
+  return false;
+}
+
+void *HugePageAllocator::mapExtent(size_t size, size_t alignment) {
+  // The huge pages are naturally aligned to their size
+  if (size % kHugePageSize == 0 && alignment <= kHugePageSize) {
+    void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (addr != MAP_FAILED) {
+      std::lock_guard<std::mutex> guard(mappings_mu_);
+      mappings_.emplace_back(addr, size);
+      huge_page_bytes_ += size;
+      return addr;
+    }
+  }
+
+  // Map more than the size to align the extent, and unmap the excess of both ends
+  size_t map_size = size + alignment;
+  void *map_addr = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map_addr == MAP_FAILED) return nullptr;
+  auto begin = reinterpret_cast<uintptr_t>(map_addr);
+  auto aligned = (begin + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+  if (aligned > begin) munmap(map_addr, aligned - begin);
+  if (auto end = begin + map_size, aligned_end = aligned + size; end > aligned_end) {
+    munmap(reinterpret_cast<void *>(aligned_end), end - aligned_end);
+  }
+  auto addr = reinterpret_cast<void *>(aligned);
+  if (size >= kHugePageSize) madvise(addr, size, MADV_HUGEPAGE);
+
+  std::lock_guard<std::mutex> guard(mappings_mu_);
+  mappings_.emplace_back(addr, size);
+  fallback_bytes_ += size;
+  return addr;
+}
+
+#else
+
+StatusOr<std::shared_ptr<HugePageAllocator>> HugePageAllocator::Create() {
+  return {Status::NotOK, "the huge page allocator requires kvrocks to be built with jemalloc"};
+}
+
+HugePageAllocator::~HugePageAllocator() = default;
+
+void *HugePageAllocator::Allocate(size_t size) { return malloc(size); }
+
+void HugePageAllocator::Deallocate(void *p) { free(p); }
+
+size_t HugePageAllocator::UsableSize(void * /*p*/, size_t allocation_size) const { return allocation_size; }
+
+#endif
+
+}  // namespace Engine
@@ -0,0 +1,93 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#pragma once
+
+#include <rocksdb/memory_allocator.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "status.h"
+
+#ifdef ENABLE_JEMALLOC
+#include <jemalloc/jemalloc.h>
+#endif
+
+namespace Engine {
+
+// HugePageAllocator allocates the blocks of the block caches from a dedicated jemalloc arena, whose
+// extents are mapped from the explicit huge pages (MAP_HUGETLB), so the hot working set in the caches
+// is covered by much fewer TLB entries. If the huge pages are exhausted or not reserved, the extents
+// are mapped from the normal pages with the transparent huge pages advised instead.
+//
+// The extents are retained by the arena once mapped, since the huge pages couldn't be returned partially,
+// and they're unmapped only after all caches using the allocator were destroyed.
+class HugePageAllocator : public rocksdb::MemoryAllocator {
+ public:
+  static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+  // It fails if kvrocks isn't built with jemalloc
+  static StatusOr<std::shared_ptr<HugePageAllocator>> Create();
+
+  ~HugePageAllocator() override;
+  HugePageAllocator(const HugePageAllocator &) = delete;
+  HugePageAllocator &operator=(const HugePageAllocator &) = delete;
+
+  const char *Name() const override { return "HugePageAllocator"; }
+  void *Allocate(size_t size) override;
+  void Deallocate(void *p) override;
+  size_t UsableSize(void *p, size_t allocation_size) const override;
+
+  // The bytes mapped from the explicit huge pages, and from the normal pages after failing to
+  uint64_t GetHugePageBytes() const { return huge_page_bytes_; }
+  uint64_t GetFallbackBytes() const { return fallback_bytes_; }
+
+ private:
+  HugePageAllocator() = default;
+
+#ifdef ENABLE_JEMALLOC
+  // The hooks are passed back to the callbacks, so the allocator is found from them
+  struct Hooks {
+    extent_hooks_t hooks;
+    HugePageAllocator *allocator;
+  };
+
+  static void *extentAlloc(extent_hooks_t *hooks, void *new_addr, size_t size, size_t alignment, bool *zero,
+                           bool *commit, unsigned arena_ind);
+  static void extentDestroy(extent_hooks_t *hooks, void *addr, size_t size, bool committed, unsigned arena_ind);
+  static bool extentSplit(extent_hooks_t *hooks, void *addr, size_t size, size_t size_a, size_t size_b,
+                          bool committed, unsigned arena_ind);
+  void *mapExtent(size_t size, size_t alignment);
+
+  Hooks hooks_{};
+  unsigned arena_ = 0;
+  int flags_ = 0;
+#endif
+
+  std::mutex mappings_mu_;
+  std::vector<std::pair<void *, size_t>> mappings_;
+  std::atomic<uint64_t> huge_page_bytes_ = 0;
+  std::atomic<uint64_t> fallback_bytes_ = 0;
+};
+
+}  // namespace Engine
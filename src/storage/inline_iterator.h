@@ -0,0 +1,68 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <rocksdb/iterator.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The iterator over the key-value pairs in memory, so that the elements inlined in the metadata
+// value could be read by the same loops as the elements which were stored in the subkeys.
+class InlineIterator : public rocksdb::Iterator {
+ public:
+  using Entry = std::pair<std::string, std::string>;
+
+  explicit InlineIterator(std::vector<Entry> entries) : entries_(std::move(entries)), pos_(entries_.size()) {
+    std::sort(entries_.begin(), entries_.end(),
+              [](const Entry &a, const Entry &b) { return rocksdb::Slice(a.first).compare(b.first) < 0; });
+  }
+
+  bool Valid() const override { return pos_ < entries_.size(); }
+  void SeekToFirst() override { pos_ = 0; }
+  void SeekToLast() override { pos_ = entries_.empty() ? 0 : entries_.size() - 1; }
+  void Seek(const rocksdb::Slice &target) override { pos_ = lowerBound(target, false); }
+  void SeekForPrev(const rocksdb::Slice &target) override {
+    size_t pos = lowerBound(target, true);
+    pos_ = pos == 0 ? entries_.size() : pos - 1;
+  }
+  void Next() override { pos_++; }
+  void Prev() override { pos_ = pos_ == 0 ? entries_.size() : pos_ - 1; }
+  rocksdb::Slice key() const override { return entries_[pos_].first; }
+  rocksdb::Slice value() const override { return entries_[pos_].second; }
+  rocksdb::Status status() const override { return rocksdb::Status::OK(); }
+
+ private:
+  // Return the position of the first entry which is greater than or equal to the target,
+  // or greater than the target if the equal one should be skipped
+  size_t lowerBound(const rocksdb::Slice &target, bool skip_equal) const {
+    auto iter = std::partition_point(entries_.begin(), entries_.end(), [&](const Entry &entry) {
+      int cmp = rocksdb::Slice(entry.first).compare(target);
+      return skip_equal ? cmp <= 0 : cmp < 0;
+    });
+    return iter - entries_.begin();
+  }
+
+  std::vector<Entry> entries_;
+  size_t pos_;
+};
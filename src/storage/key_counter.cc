@@ -0,0 +1,303 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "key_counter.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include "cluster/redis_slot.h"
+#include "encoding.h"
+#include "redis_metadata.h"
+#include "storage.h"
+
+namespace Engine {
+
+namespace {
+
+// The emptied collections are left in the metadata column family, but they don't exist for the users
+bool IsCountedMetadata(const rocksdb::Slice &value) {
+  if (value.empty()) return false;
+  auto type = static_cast<RedisType>(value[0] & 0x0f);
+  if (type == kRedisString || IsEmptyAllowed(type)) return true;
+  if ((value[0] & kMetadataCompactEncoded) != 0) {
+    Metadata metadata(kRedisNone, false);
+    return metadata.Decode(value.ToString()).ok() && metadata.size != 0;
+  }
+  // flags(1byte) + expire(4byte) + version(8byte) + size(4byte)
+  return value.size() >= 17 && DecodeFixed32(value.data() + 13) != 0;
+}
+
+class MetadataOpCollector : public rocksdb::WriteBatch::Handler {
+ public:
+  rocksdb::Status PutCF(uint32_t column_family_id, const rocksdb::Slice &key, const rocksdb::Slice &value) override {
+    if (column_family_id == kColumnFamilyIDMetadata) ops.emplace_back(key.ToString(), IsCountedMetadata(value));
+    return rocksdb::Status::OK();
+  }
+  rocksdb::Status DeleteCF(uint32_t column_family_id, const rocksdb::Slice &key) override {
+    if (column_family_id == kColumnFamilyIDMetadata) ops.emplace_back(key.ToString(), false);
+    return rocksdb::Status::OK();
+  }
+  rocksdb::Status SingleDeleteCF(uint32_t column_family_id, const rocksdb::Slice &key) override {
+    return DeleteCF(column_family_id, key);
+  }
+  rocksdb::Status MergeCF(uint32_t column_family_id, const rocksdb::Slice &key, const rocksdb::Slice &value) override {
+    // The counter increment always leaves a live key, see StringCounterMergeOperator
+    if (column_family_id == kColumnFamilyIDMetadata) ops.emplace_back(key.ToString(), true);
+    return rocksdb::Status::OK();
+  }
+  rocksdb::Status DeleteRangeCF(uint32_t column_family_id, const rocksdb::Slice &begin_key,
+                                const rocksdb::Slice &end_key) override {
+    if (column_family_id == kColumnFamilyIDMetadata) ranges.emplace_back(begin_key.ToString(), end_key.ToString());
+    return rocksdb::Status::OK();
+  }
+
+  // [key, is counted after the operation]
+  std::vector<std::pair<std::string, bool>> ops;
+  std::vector<std::pair<std::string, std::string>> ranges;
+};
+
+rocksdb::Status MetadataCounted(rocksdb::DB *db, rocksdb::ColumnFamilyHandle *cf_handle, const std::string &key,
+                               bool *counted) {
+  std::string value;
+  bool value_found = false;
+  rocksdb::ReadOptions read_options;
+  // The bloom filter excludes the new keys mostly, and the rewritten keys were read
+  // by the writer just now, so they're likely in the memtable or the block cache.
+  if (!db->KeyMayExist(read_options, cf_handle, key, &value, &value_found)) {
+    *counted = false;
+    return rocksdb::Status::OK();
+  }
+  if (value_found) {
+    *counted = IsCountedMetadata(value);
+    return rocksdb::Status::OK();
+  }
+  auto s = db->Get(read_options, cf_handle, key, &value);
+  if (!s.ok() && !s.IsNotFound()) return s;
+  *counted = s.ok() && IsCountedMetadata(value);
+  return rocksdb::Status::OK();
+}
+
+}  // namespace
+
+rocksdb::Status KeyCounter::Collect(rocksdb::DB *db, const MetadataCFRouter &metadata_cf_handle,
+                                    rocksdb::WriteBatch *batch, Changes *changes) {
+  MetadataOpCollector collector;
+  auto s = batch->Iterate(&collector);
+  if (!s.ok()) return s;
+
+  // [key, [counted before the batch, counted after the batch]]
+  std::unordered_map<std::string, std::pair<bool, bool>> states;
+  for (auto &[key, counted] : collector.ops) {
+    auto iter = states.find(key);
+    if (iter == states.end()) {
+      bool counted_before = false;
+      s = MetadataCounted(db, metadata_cf_handle(key), key, &counted_before);
+      if (!s.ok()) return s;
+      iter = states.emplace(std::move(key), std::make_pair(counted_before, counted_before)).first;
+    }
+    iter->second.second = counted;
+  }
+  for (const auto &[key, state] : states) {
+    if (state.first != state.second) changes->deltas.emplace_back(key, state.second ? 1 : -1);
+  }
+
+  for (const auto &[begin_key, end_key] : collector.ranges) {
+    std::string begin_ns, end_ns;
+    int begin_slot = -1, end_slot = -1;
+    if (!parseNamespaceKey(begin_key, &begin_ns, &begin_slot) || !parseNamespaceKey(end_key, &end_ns, &end_slot) ||
+        begin_ns != end_ns) {
+      changes->clear_all = true;
+      continue;
+    }
+    // Clear the keys of a slot, see Database::ClearKeysOfSlot
+    bool is_slot_range = slot_id_encoded_ && begin_key.size() == 1 + begin_ns.size() + 2 &&
+                         end_key.size() == begin_key.size() && end_slot == begin_slot + 1;
+    changes->cleared.emplace_back(begin_ns, is_slot_range ? begin_slot : -1);
+  }
+  return rocksdb::Status::OK();
+}
+
+void KeyCounter::Apply(const Changes &changes) {
+  for (const auto &[key, delta] : changes.deltas) {
+    Add(key, delta);
+  }
+  for (const auto &[ns, slot] : changes.cleared) {
+    clearNamespace(ns, slot);
+  }
+  if (changes.clear_all) {
+    std::shared_lock<std::shared_mutex> guard(mu_);
+    resetAll();
+  }
+}
+
+void KeyCounter::Add(const rocksdb::Slice &ns_key, int64_t delta) {
+  std::string ns;
+  int slot = -1;
+  if (!parseNamespaceKey(ns_key, &ns, &slot)) return;
+  auto counter = getOrCreate(ns);
+  counter->keys.fetch_add(delta, std::memory_order_relaxed);
+  if (counter->slots && slot >= 0 && slot < HASH_SLOTS_SIZE) {
+    counter->slots[slot].fetch_add(delta, std::memory_order_relaxed);
+  }
+}
+
+void KeyCounter::DropExpired(rocksdb::DB *db, rocksdb::ColumnFamilyHandle *metadata_cf_handle,
+                             const rocksdb::Slice &ns_key, const rocksdb::Slice &value) {
+  // The older versions of the key may be dropped in the compaction of the lower levels,
+  // while the latest value is still alive in the upper levels.
+  std::string latest_value;
+  auto s = db->Get(rocksdb::ReadOptions(), metadata_cf_handle, ns_key, &latest_value);
+  if (s.ok() && latest_value == value && IsCountedMetadata(value)) Add(ns_key, -1);
+}
+
+rocksdb::Status KeyCounter::Rebuild(rocksdb::DB *db, rocksdb::ColumnFamilyHandle *metadata_cf_handle) {
+  return Rebuild(db, std::vector<rocksdb::ColumnFamilyHandle *>{metadata_cf_handle});
+}
+
+rocksdb::Status KeyCounter::Rebuild(rocksdb::DB *db,
+                                    const std::vector<rocksdb::ColumnFamilyHandle *> &metadata_cf_handles) {
+  uint64_t generation = 0;
+  {
+    std::unique_lock<std::shared_mutex> guard(mu_);
+    generation = generation_;
+    resetAll();
+  }
+
+  const rocksdb::Snapshot *snapshot = db->GetSnapshot();
+  rocksdb::ReadOptions read_options;
+  read_options.snapshot = snapshot;
+  read_options.fill_cache = false;
+  // The keys of the same namespace are adjacent, so count them locally before adding
+  std::string current_ns;
+  int64_t current_keys = 0;
+  std::vector<int64_t> current_slots(slot_id_encoded_ ? HASH_SLOTS_SIZE : 0, 0);
+  auto flush = [&] {
+    if (current_keys == 0) return;
+    auto counter = getOrCreate(current_ns);
+    counter->keys.fetch_add(current_keys);
+    for (size_t i = 0; i < current_slots.size() && counter->slots; i++) {
+      if (current_slots[i] != 0) counter->slots[i].fetch_add(current_slots[i]);
+      current_slots[i] = 0;
+    }
+    current_keys = 0;
+  };
+
+  rocksdb::Status s;
+  uint64_t scanned = 0;
+  for (auto metadata_cf_handle : metadata_cf_handles) {
+    std::unique_ptr<rocksdb::Iterator> iter(db->NewIterator(read_options, metadata_cf_handle));
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      // Give up if the DB is being closed or the counter was cleared
+      if (++scanned % 10000 == 0 && generation_ != generation) {
+        s = rocksdb::Status::Aborted("the key counter was cleared");
+        break;
+      }
+      std::string ns;
+      int slot = -1;
+      if (!IsCountedMetadata(iter->value()) || !parseNamespaceKey(iter->key(), &ns, &slot)) continue;
+      if (ns != current_ns) {
+        flush();
+        current_ns = std::move(ns);
+      }
+      current_keys++;
+      if (slot >= 0 && slot < static_cast<int>(current_slots.size())) current_slots[slot]++;
+    }
+    if (s.ok()) flush();
+    if (s.ok()) s = iter->status();
+    if (!s.ok()) break;
+  }
+  db->ReleaseSnapshot(snapshot);
+  if (!s.ok()) return s;
+
+  std::unique_lock<std::shared_mutex> guard(mu_);
+  if (generation_ != generation) return rocksdb::Status::Aborted("the key counter was cleared");
+  ready_ = true;
+  return rocksdb::Status::OK();
+}
+
+void KeyCounter::Clear() {
+  std::unique_lock<std::shared_mutex> guard(mu_);
+  generation_++;
+  ready_ = false;
+  // Don't erase the counters, the writers may be adding to them without the lock
+  resetAll();
+}
+
+uint64_t KeyCounter::GetKeys(const std::string &ns) {
+  std::shared_lock<std::shared_mutex> guard(mu_);
+  auto iter = counters_.find(ns);
+  if (iter == counters_.end()) return 0;
+  return static_cast<uint64_t>(std::max<int64_t>(iter->second->keys, 0));
+}
+
+uint64_t KeyCounter::GetSlotKeys(const std::string &ns, int slot) {
+  std::shared_lock<std::shared_mutex> guard(mu_);
+  auto iter = counters_.find(ns);
+  if (iter == counters_.end() || !iter->second->slots || slot < 0 || slot >= HASH_SLOTS_SIZE) return 0;
+  return static_cast<uint64_t>(std::max<int64_t>(iter->second->slots[slot], 0));
+}
+
+KeyCounter::NamespaceCounter *KeyCounter::getOrCreate(const std::string &ns) {
+  {
+    std::shared_lock<std::shared_mutex> guard(mu_);
+    auto iter = counters_.find(ns);
+    if (iter != counters_.end()) return iter->second.get();
+  }
+  std::unique_lock<std::shared_mutex> guard(mu_);
+  auto &counter = counters_[ns];
+  if (!counter) {
+    counter = std::make_unique<NamespaceCounter>();
+    if (slot_id_encoded_) counter->slots = std::make_unique<std::atomic<int64_t>[]>(HASH_SLOTS_SIZE);
+  }
+  return counter.get();
+}
+
+bool KeyCounter::parseNamespaceKey(const rocksdb::Slice &ns_key, std::string *ns, int *slot) const {
+  if (ns_key.empty()) return false;
+  auto ns_size = static_cast<uint8_t>(ns_key[0]);
+  size_t prefix_size = 1 + ns_size + (slot_id_encoded_ ? 2 : 0);
+  if (ns_key.size() < prefix_size) return false;
+  ns->assign(ns_key.data() + 1, ns_size);
+  *slot = slot_id_encoded_ ? DecodeFixed16(ns_key.data() + 1 + ns_size) : -1;
+  return true;
+}
+
+void KeyCounter::resetAll() {
+  for (const auto &iter : counters_) {
+    iter.second->keys = 0;
+    if (iter.second->slots) std::fill_n(iter.second->slots.get(), HASH_SLOTS_SIZE, 0);
+  }
+}
+
+void KeyCounter::clearNamespace(const std::string &ns, int slot) {
+  std::shared_lock<std::shared_mutex> guard(mu_);
+  auto iter = counters_.find(ns);
+  if (iter == counters_.end()) return;
+  auto counter = iter->second.get();
+  if (slot < 0) {
+    counter->keys = 0;
+    if (counter->slots) std::fill_n(counter->slots.get(), HASH_SLOTS_SIZE, 0);
+  } else if (counter->slots && slot < HASH_SLOTS_SIZE) {
+    counter->keys.fetch_sub(counter->slots[slot].exchange(0));
+  }
+}
+
+}  // namespace Engine
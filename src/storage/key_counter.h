@@ -0,0 +1,106 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <rocksdb/db.h>
+#include <rocksdb/write_batch.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Engine {
+
+// KeyCounter tracks the number of keys per namespace (and per slot if the slot id is encoded)
+// incrementally, so that DBSIZE needn't scan the metadata column family. The counted keys
+// are the metadata entries in the DB except the emptied collections, and the expired keys
+// are counted until they're deleted by the compaction or the active expiration like Redis.
+//
+// The writers collect the changes of the batch before it's written, which checks whether
+// the written metadata exist already, and then apply the changes after the batch was written.
+// The writes of the same key are serialized by the lock manager, but the counter is still
+// approximate: the compaction drops the expired keys without the lock, so DropExpired may
+// race with a writer of the same key, and the writes during the rebuild after the DB was
+// opened may be counted twice or missed. The drift is only fixed by the next rebuild.
+class KeyCounter {
+ public:
+  struct Changes {
+    std::vector<std::pair<std::string, int64_t>> deltas;
+    // The namespaces or the slots whose keys were deleted by DeleteRange
+    std::vector<std::pair<std::string, int>> cleared;
+    bool clear_all = false;
+
+    bool Empty() const { return deltas.empty() && cleared.empty() && !clear_all; }
+  };
+
+  explicit KeyCounter(bool slot_id_encoded) : slot_id_encoded_(slot_id_encoded) {}
+
+  KeyCounter(const KeyCounter &) = delete;
+  KeyCounter &operator=(const KeyCounter &) = delete;
+
+  // The metadata column family of the key, see Storage::RouteCFHandle
+  using MetadataCFRouter = std::function<rocksdb::ColumnFamilyHandle *(const rocksdb::Slice &ns_key)>;
+
+  rocksdb::Status Collect(rocksdb::DB *db, const MetadataCFRouter &metadata_cf_handle, rocksdb::WriteBatch *batch,
+                          Changes *changes);
+  void Apply(const Changes &changes);
+  // Add the delta to the key count of the ns_key's namespace and slot
+  void Add(const rocksdb::Slice &ns_key, int64_t delta);
+  // The expired metadata was dropped by the compaction filter, which was counted if it's the latest value
+  void DropExpired(rocksdb::DB *db, rocksdb::ColumnFamilyHandle *metadata_cf_handle, const rocksdb::Slice &ns_key,
+                   const rocksdb::Slice &value);
+  // Rebuild the counter by scanning the metadata column family, the counter is ready after rebuilt
+  rocksdb::Status Rebuild(rocksdb::DB *db, rocksdb::ColumnFamilyHandle *metadata_cf_handle);
+  // Rebuild by scanning all metadata column families, including those of the namespaces
+  rocksdb::Status Rebuild(rocksdb::DB *db, const std::vector<rocksdb::ColumnFamilyHandle *> &metadata_cf_handles);
+  // Reset the counter to be not ready, which must be called when the counted data was changed outside
+  void Clear();
+
+  bool Ready() const { return ready_; }
+  uint64_t GetKeys(const std::string &ns);
+  uint64_t GetSlotKeys(const std::string &ns, int slot);
+
+ private:
+  struct NamespaceCounter {
+    std::atomic<int64_t> keys{0};
+    std::unique_ptr<std::atomic<int64_t>[]> slots;
+  };
+
+  NamespaceCounter *getOrCreate(const std::string &ns);
+  bool parseNamespaceKey(const rocksdb::Slice &ns_key, std::string *ns, int *slot) const;
+  void clearNamespace(const std::string &ns, int slot);
+  void resetAll();
+
+  bool slot_id_encoded_;
+  std::atomic<bool> ready_{false};
+  // Bumped by Clear() to abort the running rebuild
+  std::atomic<uint64_t> generation_{0};
+  std::shared_mutex mu_;
+  std::unordered_map<std::string, std::unique_ptr<NamespaceCounter>> counters_;
+};
+
+}  // namespace Engine
@@ -0,0 +1,131 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "key_reclaimer.h"
+
+#include <glog/logging.h>
+#include <rocksdb/write_batch.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "storage.h"
+#include "thread_util.h"
+
+namespace Engine {
+
+KeyReclaimer::KeyReclaimer(Storage *storage) : storage_(storage) {
+  paused_ = !storage_->GetConfig()->master_host.empty();
+  thread_ = std::thread([this] {
+    Util::ThreadSetName("key-reclaimer");
+    loop();
+  });
+}
+
+KeyReclaimer::~KeyReclaimer() {
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  if (thread_.joinable()) thread_.join();
+}
+
+bool KeyReclaimer::Reclaim(const rocksdb::Slice &ns_key, const Metadata &metadata) {
+  // Strings have no subkeys, and the chunks of the chunked strings are left to the compaction
+  if (metadata.Type() == kRedisString || metadata.Type() == kRedisNone) return false;
+  auto min_elements = static_cast<uint64_t>(storage_->GetConfig()->lazy_reclaim_min_elements);
+  if (min_elements == 0 || metadata.size < min_elements) return false;
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    if (paused_ || stop_ || tasks_.size() >= kMaxPendingKeys) return false;
+    tasks_.push_back(Task{metadata.Type(), ns_key.ToString(), metadata.version});
+  }
+  cond_.notify_one();
+  return true;
+}
+
+void KeyReclaimer::SetPaused(bool paused) {
+  std::lock_guard<std::mutex> guard(mu_);
+  paused_ = paused;
+  if (paused_) tasks_.clear();
+}
+
+void KeyReclaimer::Clear() {
+  std::lock_guard<std::mutex> guard(mu_);
+  tasks_.clear();
+}
+
+size_t KeyReclaimer::GetPendingKeys() {
+  std::lock_guard<std::mutex> guard(mu_);
+  return tasks_.size();
+}
+
+void KeyReclaimer::loop() {
+  auto next_time = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(mu_);
+  while (true) {
+    cond_.wait(lock, [this] { return stop_ || (!paused_ && !tasks_.empty()); });
+    if (stop_) return;
+
+    // Wait for the next slot of the rate limit, the tasks may be cleared during waiting
+    if (cond_.wait_until(lock, next_time, [this] { return stop_; })) return;
+    if (paused_ || tasks_.empty()) continue;
+    Task task = std::move(tasks_.front());
+    tasks_.pop_front();
+    lock.unlock();
+
+    auto s = reclaim(task);
+    if (s.ok()) {
+      reclaimed_keys_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      LOG(WARNING) << "[key_reclaimer] Failed to reclaim the subkeys, err: " << s.ToString();
+    }
+    int rate = std::max(storage_->GetConfig()->lazy_reclaim_max_keys_per_sec, 1);
+    next_time = std::chrono::steady_clock::now() + std::chrono::microseconds(1000000 / rate);
+
+    lock.lock();
+  }
+}
+
+rocksdb::Status KeyReclaimer::reclaim(const Task &task) {
+  auto guard = storage_->ReadLockGuard();
+  // The DB may be closed or reopened for the full synchronization
+  if (storage_->IsClosing() || storage_->GetDB() == nullptr) return rocksdb::Status::OK();
+
+  bool slot_id_encoded = storage_->IsSlotIdEncoded();
+  std::string begin_key, end_key;
+  InternalKey(task.ns_key, "", task.version, slot_id_encoded).Encode(&begin_key);
+  InternalKey(task.ns_key, "", task.version + 1, slot_id_encoded).Encode(&end_key);
+
+  rocksdb::WriteBatch batch;
+  auto s = batch.DeleteRange(storage_->GetCFHandle(kSubkeyColumnFamilyName), begin_key, end_key);
+  if (s.ok() && task.type == kRedisZSet) {
+    s = batch.DeleteRange(storage_->GetCFHandle(kZSetScoreColumnFamilyName), begin_key, end_key);
+    if (s.ok()) s = batch.DeleteRange(storage_->GetCFHandle(kZSetRankColumnFamilyName), begin_key, end_key);
+  }
+  if (s.ok() && task.type == kRedisStream) {
+    s = batch.DeleteRange(storage_->GetCFHandle(kStreamColumnFamilyName), begin_key, end_key);
+  }
+  if (!s.ok()) return s;
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+}  // namespace Engine
@@ -0,0 +1,86 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <rocksdb/status.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "redis_metadata.h"
+
+namespace Engine {
+
+class Storage;
+
+// KeyReclaimer deletes the subkeys of the deleted or expired large keys in background.
+// Deleting a key only removes its metadata, and the subkeys of the dead version would be
+// dropped by SubKeyFilter lazily, then every compaction pays a metadata lookup for each
+// of them. The reclaimer issues DeleteRange over the subkey ranges of the dead version
+// instead, which is rate limited to avoid accumulating too many range tombstones.
+//
+// The reclaimer is paused on replicas, since they must never write the DB except applying
+// the batches from the master, and the master's range deletions would be replicated.
+class KeyReclaimer {
+ public:
+  explicit KeyReclaimer(Storage *storage);
+  ~KeyReclaimer();
+
+  KeyReclaimer(const KeyReclaimer &) = delete;
+  KeyReclaimer &operator=(const KeyReclaimer &) = delete;
+
+  // Reclaim the subkeys of the dead key if it's large enough. Return false if not reclaimed,
+  // e.g. the reclaimer is paused or too busy, then the subkeys would be dropped in compactions.
+  bool Reclaim(const rocksdb::Slice &ns_key, const Metadata &metadata);
+  void SetPaused(bool paused);
+  void Clear();
+
+  uint64_t GetReclaimedKeys() const { return reclaimed_keys_; }
+  size_t GetPendingKeys();
+
+  static const size_t kMaxPendingKeys = 16384;
+
+ private:
+  struct Task {
+    RedisType type;
+    std::string ns_key;
+    uint64_t version;
+  };
+
+  void loop();
+  rocksdb::Status reclaim(const Task &task);
+
+  Storage *storage_;
+  std::mutex mu_;
+  std::condition_variable cond_;
+  std::deque<Task> tasks_;
+  bool paused_ = false;
+  bool stop_ = false;
+  std::atomic<uint64_t> reclaimed_keys_{0};
+  std::thread thread_;
+};
+
+}  // namespace Engine
@@ -0,0 +1,149 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "lazy_expirer.h"
+
+#include <glog/logging.h>
+#include <rocksdb/write_batch.h>
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "key_reclaimer.h"
+#include "lock_manager.h"
+#include "redis_metadata.h"
+#include "storage.h"
+#include "thread_util.h"
+
+namespace Engine {
+
+LazyExpirer::LazyExpirer(Storage *storage) : storage_(storage) {
+  paused_ = !storage_->GetConfig()->master_host.empty();
+  thread_ = std::thread([this] {
+    Util::ThreadSetName("lazy-expirer");
+    loop();
+  });
+}
+
+LazyExpirer::~LazyExpirer() {
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  if (thread_.joinable()) thread_.join();
+}
+
+bool LazyExpirer::Add(const rocksdb::Slice &ns_key) {
+  if (storage_->GetConfig()->lazy_expire_max_keys_per_sec == 0) return false;
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    if (paused_ || stop_ || keys_.size() >= kMaxPendingKeys) return false;
+    // The hot expired key would be read many times before it's deleted
+    if (!pending_.emplace(ns_key.ToString()).second) return true;
+    keys_.emplace_back(ns_key.ToString());
+  }
+  cond_.notify_one();
+  return true;
+}
+
+void LazyExpirer::SetPaused(bool paused) {
+  std::lock_guard<std::mutex> guard(mu_);
+  paused_ = paused;
+  if (paused_) {
+    keys_.clear();
+    pending_.clear();
+  }
+}
+
+void LazyExpirer::Clear() {
+  std::lock_guard<std::mutex> guard(mu_);
+  keys_.clear();
+  pending_.clear();
+}
+
+size_t LazyExpirer::GetPendingKeys() {
+  std::lock_guard<std::mutex> guard(mu_);
+  return keys_.size();
+}
+
+void LazyExpirer::loop() {
+  auto next_time = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(mu_);
+  while (true) {
+    cond_.wait(lock, [this] { return stop_ || (!paused_ && !keys_.empty()); });
+    if (stop_) return;
+
+    // Wait for the next slot of the rate limit, the keys may be cleared during waiting
+    if (cond_.wait_until(lock, next_time, [this] { return stop_; })) return;
+    if (paused_ || keys_.empty()) continue;
+    int rate = std::max(storage_->GetConfig()->lazy_expire_max_keys_per_sec, 1);
+    size_t batch_size = std::min({keys_.size(), kMaxBatchKeys, static_cast<size_t>(rate)});
+    std::vector<std::string> ns_keys;
+    for (size_t i = 0; i < batch_size; i++) {
+      pending_.erase(keys_.front());
+      ns_keys.emplace_back(std::move(keys_.front()));
+      keys_.pop_front();
+    }
+    lock.unlock();
+
+    auto s = expire(ns_keys);
+    if (!s.ok()) LOG(WARNING) << "[lazy_expirer] Failed to delete the expired keys, err: " << s.ToString();
+    next_time = std::chrono::steady_clock::now() + std::chrono::microseconds(1000000 * batch_size / rate);
+
+    lock.lock();
+  }
+}
+
+rocksdb::Status LazyExpirer::expire(const std::vector<std::string> &ns_keys) {
+  auto guard = storage_->ReadLockGuard();
+  // The DB may be closed or reopened for the full synchronization
+  if (storage_->IsClosing() || storage_->GetDB() == nullptr) return rocksdb::Status::OK();
+
+  // The keys may be rewritten since they were found expired, so check them again under the locks
+  MultiLockGuard lock_guard(storage_->GetLockManager(), ns_keys);
+  rocksdb::WriteBatch batch;
+  std::vector<std::pair<std::string, Metadata>> expired_keys;
+  auto metadata_cf_handle = storage_->GetCFHandle(kMetadataColumnFamilyName);
+  for (const auto &ns_key : ns_keys) {
+    auto cf_handle = storage_->RouteCFHandle(metadata_cf_handle, ns_key);
+    std::string value;
+    auto s = storage_->GetDB()->Get(rocksdb::ReadOptions(), cf_handle, ns_key, &value);
+    if (s.IsNotFound()) continue;
+    if (!s.ok()) return s;
+
+    Metadata metadata(kRedisNone, false);
+    if (!metadata.Decode(value).ok() || !metadata.Expired()) continue;
+    batch.Delete(cf_handle, ns_key);
+    expired_keys.emplace_back(ns_key, metadata);
+  }
+  if (expired_keys.empty()) return rocksdb::Status::OK();
+
+  auto s = storage_->Write(storage_->DefaultWriteOptions(), &batch);
+  if (!s.ok()) return s;
+  expired_keys_.fetch_add(expired_keys.size(), std::memory_order_relaxed);
+  for (const auto &[ns_key, metadata] : expired_keys) {
+    storage_->GetKeyReclaimer()->Reclaim(ns_key, metadata);
+  }
+  return rocksdb::Status::OK();
+}
+
+}  // namespace Engine
@@ -0,0 +1,82 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <rocksdb/slice.h>
+#include <rocksdb/status.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace Engine {
+
+class Storage;
+
+// LazyExpirer deletes the expired keys found by the reads in background. The reads treat
+// an expired key as not found, but its metadata stays until the compaction drops it, so
+// every access of the key pays the metadata lookup until then. The expired keys are queued
+// once (deduplicated) and deleted in batches under their locks, after their metadata are
+// checked to be still expired. The subkeys of the large ones are reclaimed by KeyReclaimer.
+//
+// The expirer is paused on replicas like the reclaimer, the master's deletions are replicated.
+class LazyExpirer {
+ public:
+  explicit LazyExpirer(Storage *storage);
+  ~LazyExpirer();
+
+  LazyExpirer(const LazyExpirer &) = delete;
+  LazyExpirer &operator=(const LazyExpirer &) = delete;
+
+  // Queue the expired key, return false if it's dropped, e.g. the expirer is disabled,
+  // paused or too busy, then the key would be dropped in compactions
+  bool Add(const rocksdb::Slice &ns_key);
+  void SetPaused(bool paused);
+  void Clear();
+
+  uint64_t GetExpiredKeys() const { return expired_keys_; }
+  size_t GetPendingKeys();
+
+  static const size_t kMaxPendingKeys = 65536;
+  static const size_t kMaxBatchKeys = 128;
+
+ private:
+  void loop();
+  rocksdb::Status expire(const std::vector<std::string> &ns_keys);
+
+  Storage *storage_;
+  std::mutex mu_;
+  std::condition_variable cond_;
+  std::deque<std::string> keys_;
+  std::unordered_set<std::string> pending_;
+  bool paused_ = false;
+  bool stop_ = false;
+  std::atomic<uint64_t> expired_keys_{0};
+  std::thread thread_;
+};
+
+}  // namespace Engine
@@ -20,50 +20,158 @@
 
 #include "lock_manager.h"
 
-#include <set>
+#include <algorithm>
+#include <map>
 #include <string>
 #include <thread>
 
-LockManager::LockManager(int hash_power) : hash_power_(hash_power) {
-  hash_mask_ = (1U << hash_power) - 1;
-  for (unsigned i = 0; i < Size(); i++) {
-    mutex_pool_.emplace_back(new std::mutex());
+#include "hash_util.h"
+#include "stats/request_trace.h"
+#include "time_util.h"
+
+void KeyLock::Lock() const { lock_mgr->lockSlot(index, exclusive, key); }
+
+LockManager::LockManager(int hash_power)
+    : hash_power_(hash_power), hash_mask_((1U << hash_power) - 1), slots_(1U << hash_power) {}
+
+unsigned LockManager::hash(const rocksdb::Slice &key) {
+  return static_cast<unsigned>(Util::MurmurHash64A(key, 0)) & hash_mask_;
+}
+
+unsigned LockManager::Size() { return (1U << hash_power_); }
+
+// The lock is tried first so that the uncontended locks don't count as the waits, and
+// only the waits are timed for the stats of the slot and the traced request
+void LockManager::lockSlot(unsigned index, bool exclusive, const rocksdb::Slice &key) {
+  auto mu = &slots_[index].mu;
+  if (exclusive ? mu->try_lock() : mu->try_lock_shared()) return;
+  auto begin = Util::GetTimeStampUS();
+  exclusive ? mu->lock() : mu->lock_shared();
+  auto end = Util::GetTimeStampUS();
+  if (auto trace = RequestTrace::Current()) trace->Record(TRACE_STAGE_LOCK_WAIT, begin, end);
+  recordWait(index, end - begin, key);
+}
+
+void LockManager::recordWait(unsigned index, uint64_t wait_us, const rocksdb::Slice &key) {
+  auto &slot = slots_[index];
+  slot.waits.fetch_add(1, std::memory_order_relaxed);
+  slot.wait_us.fetch_add(wait_us, std::memory_order_relaxed);
+  waits_.fetch_add(1, std::memory_order_relaxed);
+  wait_us_.fetch_add(wait_us, std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> guard(sampled_keys_mu_);
+  auto iter = sampled_keys_.find(index);
+  if (iter == sampled_keys_.end()) {
+    if (sampled_keys_.size() >= kMaxSampledSlots) return;
+    iter = sampled_keys_.emplace(index, std::vector<std::string>{}).first;
   }
+  auto &keys = iter->second;
+  if (std::find(keys.begin(), keys.end(), key.ToString()) != keys.end()) return;
+  // Keep the latest keys of the slot
+  if (keys.size() >= kMaxSampledKeysPerSlot) keys.erase(keys.begin());
+  keys.emplace_back(key.ToString());
 }
 
-LockManager::~LockManager() {
-  for (const auto &mu : mutex_pool_) {
-    delete mu;
+std::vector<LockSlotStats> LockManager::GetContendedSlots(size_t count) {
+  std::vector<LockSlotStats> stats;
+  for (unsigned i = 0; i < slots_.size(); i++) {
+    auto waits = slots_[i].waits.load(std::memory_order_relaxed);
+    if (waits == 0) continue;
+    stats.push_back({i, waits, slots_[i].wait_us.load(std::memory_order_relaxed), {}});
+  }
+  count = std::min(count, stats.size());
+  std::partial_sort(stats.begin(), stats.begin() + static_cast<ptrdiff_t>(count), stats.end(),
+                    [](const LockSlotStats &a, const LockSlotStats &b) { return a.wait_us > b.wait_us; });
+  stats.resize(count);
+
+  std::lock_guard<std::mutex> guard(sampled_keys_mu_);
+  for (auto &slot_stats : stats) {
+    auto iter = sampled_keys_.find(slot_stats.index);
+    if (iter != sampled_keys_.end()) slot_stats.keys = iter->second;
   }
+  return stats;
 }
 
-unsigned LockManager::hash(const rocksdb::Slice &key) {
-  return static_cast<unsigned>(std::hash<std::string>{}(key.ToString()) & hash_mask_);
+void LockManager::ResetStats() {
+  for (auto &slot : slots_) {
+    slot.waits.store(0, std::memory_order_relaxed);
+    slot.wait_us.store(0, std::memory_order_relaxed);
+  }
+  waits_.store(0, std::memory_order_relaxed);
+  wait_us_.store(0, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> guard(sampled_keys_mu_);
+  sampled_keys_.clear();
 }
 
-unsigned LockManager::Size() { return (1U << hash_power_); }
+// The locks held by the current thread through the ReentrantMultiLockGuard
+static thread_local std::vector<std::shared_mutex *> held_locks;
 
-void LockManager::Lock(const rocksdb::Slice &key) { mutex_pool_[hash(key)]->lock(); }
+static bool isHeldByCurrentThread(std::shared_mutex *mu) {
+  return !held_locks.empty() && std::find(held_locks.begin(), held_locks.end(), mu) != held_locks.end();
+}
+
+void LockManager::Lock(const rocksdb::Slice &key) {
+  auto index = hash(key);
+  if (!isHeldByCurrentThread(&slots_[index].mu)) lockSlot(index, true, key);
+}
+
+void LockManager::UnLock(const rocksdb::Slice &key) {
+  auto mu = &slots_[hash(key)].mu;
+  if (!isHeldByCurrentThread(mu)) mu->unlock();
+}
+
+void LockManager::LockShared(const rocksdb::Slice &key) {
+  auto index = hash(key);
+  if (!isHeldByCurrentThread(&slots_[index].mu)) lockSlot(index, false, key);
+}
 
-void LockManager::UnLock(const rocksdb::Slice &key) { mutex_pool_[hash(key)]->unlock(); }
+void LockManager::UnLockShared(const rocksdb::Slice &key) {
+  auto mu = &slots_[hash(key)].mu;
+  if (!isHeldByCurrentThread(mu)) mu->unlock_shared();
+}
 
-std::vector<std::mutex *> LockManager::MultiGet(const std::vector<std::string> &keys) {
-  std::vector<std::mutex *> locks;
-  std::set<unsigned, std::greater<unsigned>> to_acquire_indexes;
-  // We are using the `set` to avoid retrieving the mutex, as well as guarantee to retrieve
-  // the order of locks.
+std::vector<KeyLock> LockManager::MultiGet(const std::vector<std::string> &exclusive_keys,
+                                           const std::vector<std::string> &shared_keys) {
+  // We are using the ordered map to avoid retrieving the mutex twice, as well as guarantee
+  // the order of locks, the value is whether the lock is exclusive and one of its keys.
   //
   // For example, we need lock the key `A` and `B` and they have the same lock hash
   // index, it will be deadlock if lock the same mutex twice. Besides, we also need
   // to order the mutex before acquiring locks since different threads may acquire
   // same keys with different order.
-  for (const auto &key : keys) {
-    to_acquire_indexes.insert(hash(key));
+  std::map<unsigned, std::pair<bool, rocksdb::Slice>, std::greater<unsigned>> to_acquire_indexes;
+  for (const auto &key : shared_keys) {
+    to_acquire_indexes.emplace(hash(key), std::make_pair(false, rocksdb::Slice(key)));
+  }
+  for (const auto &key : exclusive_keys) {
+    auto [iter, inserted] = to_acquire_indexes.emplace(hash(key), std::make_pair(true, rocksdb::Slice(key)));
+    if (!inserted) iter->second.first = true;
   }
 
+  std::vector<KeyLock> locks;
   locks.reserve(to_acquire_indexes.size());
-  for (const auto &index : to_acquire_indexes) {
-    locks.emplace_back(mutex_pool_[index]);
+  for (const auto &[index, lock] : to_acquire_indexes) {
+    auto mu = &slots_[index].mu;
+    if (!isHeldByCurrentThread(mu)) locks.push_back({mu, lock.first, this, index, lock.second});
   }
   return locks;
 }
+
+ReentrantMultiLockGuard::ReentrantMultiLockGuard(LockManager *lock_mgr, const std::vector<std::string> &keys,
+                                                 const std::vector<std::string> &shared_keys) {
+  // The locks held by the outer guard are excluded, so the guards could be nested
+  locks_ = lock_mgr->MultiGet(keys, shared_keys);
+  for (const auto &lock : locks_) {
+    lock.Lock();
+  }
+  for (const auto &lock : locks_) {
+    held_locks.push_back(lock.mu);
+  }
+}
+
+ReentrantMultiLockGuard::~ReentrantMultiLockGuard() {
+  held_locks.resize(held_locks.size() - locks_.size());
+  for (auto iter = locks_.rbegin(); iter != locks_.rend(); ++iter) {
+    iter->UnLock();
+  }
+}
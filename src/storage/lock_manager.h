@@ -22,26 +22,87 @@
 
 #include <rocksdb/db.h>
 
+#include <atomic>
 #include <functional>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+class LockManager;
+
+// The lock of the keys which hash to the slot, it's locked in the shared mode by the readers
+// which want the keys unchanged until they're done, or in the exclusive mode by the writers.
+struct KeyLock {
+  std::shared_mutex *mu;
+  bool exclusive;
+  // The slot of the lock and one of its keys to sample the contention, the key is only
+  // referenced until the lock is acquired
+  LockManager *lock_mgr;
+  unsigned index;
+  rocksdb::Slice key;
+
+  void Lock() const;
+  void UnLock() const { exclusive ? mu->unlock() : mu->unlock_shared(); }
+};
+
+// The contention of a lock slot, only the locking which had to wait for the others is counted
+struct LockSlotStats {
+  unsigned index = 0;
+  uint64_t waits = 0;
+  uint64_t wait_us = 0;
+  // The distinct keys sampled from the waits, the slot is shared by the different hot keys
+  // rather than contended by a single hot key if there're more than one
+  std::vector<std::string> keys;
+};
+
 class LockManager {
  public:
   explicit LockManager(int hash_power);
-  ~LockManager();
+  ~LockManager() = default;
 
   unsigned Size();
   void Lock(const rocksdb::Slice &key);
   void UnLock(const rocksdb::Slice &key);
-  std::vector<std::mutex *> MultiGet(const std::vector<std::string> &keys);
+  void LockShared(const rocksdb::Slice &key);
+  void UnLockShared(const rocksdb::Slice &key);
+  // Return the locks of the keys in the locking order, except the ones held by the current
+  // thread through the ReentrantMultiLockGuard. The lock is exclusive if any of its keys is
+  // in the exclusive keys, and shared if all of its keys are in the shared keys.
+  std::vector<KeyLock> MultiGet(const std::vector<std::string> &exclusive_keys,
+                                const std::vector<std::string> &shared_keys = {});
+  // Return at most count slots which were waited for the longest in the descending order
+  std::vector<LockSlotStats> GetContendedSlots(size_t count);
+  uint64_t GetWaits() const { return waits_.load(std::memory_order_relaxed); }
+  uint64_t GetWaitUS() const { return wait_us_.load(std::memory_order_relaxed); }
+  void ResetStats();
 
  private:
+  friend struct KeyLock;
+
+  // The slots are padded to the cache line, so the neighbouring locks don't share it
+  struct alignas(64) LockSlot {
+    std::shared_mutex mu;
+    std::atomic<uint64_t> waits = 0;
+    std::atomic<uint64_t> wait_us = 0;
+  };
+
+  // Bound the memory of the sampled keys, the slots waited for after the limit aren't sampled
+  static constexpr size_t kMaxSampledSlots = 4096;
+  static constexpr size_t kMaxSampledKeysPerSlot = 4;
+
   int hash_power_;
-  int hash_mask_;
-  std::vector<std::mutex *> mutex_pool_;
+  unsigned hash_mask_;
+  std::vector<LockSlot> slots_;
+  std::atomic<uint64_t> waits_ = 0;
+  std::atomic<uint64_t> wait_us_ = 0;
+  std::mutex sampled_keys_mu_;
+  std::unordered_map<unsigned, std::vector<std::string>> sampled_keys_;
+
   unsigned hash(const rocksdb::Slice &key);
+  void lockSlot(unsigned index, bool exclusive, const rocksdb::Slice &key);
+  void recordWait(unsigned index, uint64_t wait_us, const rocksdb::Slice &key);
 };
 
 class LockGuard {
@@ -58,21 +119,37 @@ class LockGuard {
 
 class MultiLockGuard {
  public:
-  explicit MultiLockGuard(LockManager *lock_mgr, const std::vector<std::string> &keys) : lock_mgr_(lock_mgr) {
-    locks_ = lock_mgr_->MultiGet(keys);
+  explicit MultiLockGuard(LockManager *lock_mgr, const std::vector<std::string> &keys,
+                          const std::vector<std::string> &shared_keys = {})
+      : lock_mgr_(lock_mgr) {
+    locks_ = lock_mgr_->MultiGet(keys, shared_keys);
     for (const auto &iter : locks_) {
-      iter->lock();
+      iter.Lock();
     }
   }
 
   ~MultiLockGuard() {
     // Lock with order `A B C` and unlock should be `C B A`
     for (auto iter = locks_.rbegin(); iter != locks_.rend(); ++iter) {
-      (*iter)->unlock();
+      iter->UnLock();
     }
   }
 
  private:
   LockManager *lock_mgr_ = nullptr;
-  std::vector<std::mutex *> locks_;
+  std::vector<KeyLock> locks_;
+};
+
+// Lock the keys like the MultiLockGuard, and the locking of these keys on the current thread
+// is skipped until the guard is released, so that the commands of a script could run under
+// the locks of the keys declared by the script. The keys written under the guard must be
+// locked in the exclusive mode by it.
+class ReentrantMultiLockGuard {
+ public:
+  explicit ReentrantMultiLockGuard(LockManager *lock_mgr, const std::vector<std::string> &keys,
+                                   const std::vector<std::string> &shared_keys = {});
+  ~ReentrantMultiLockGuard();
+
+ private:
+  std::vector<KeyLock> locks_;
 };
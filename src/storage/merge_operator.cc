@@ -0,0 +1,73 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "merge_operator.h"
+
+#include <cctype>
+#include <climits>
+
+#include "parse_util.h"
+#include "redis_metadata.h"
+#include "types/redis_string.h"
+
+namespace Engine {
+
+bool StringCounterMergeOperator::FullMergeV2(const MergeOperationInput &merge_in,
+                                             MergeOperationOutput *merge_out) const {
+  std::string header;
+  int64_t n = 0;
+  Metadata metadata(kRedisNone, false);
+  if (merge_in.existing_value && metadata.Decode(merge_in.existing_value->ToString()).ok() && !metadata.Expired()) {
+    // The live key of other types, the chunked string or with the non-integer value is left as it was
+    if (metadata.Type() != kRedisString || metadata.IsChunkedString()) {
+      merge_out->existing_operand = *merge_in.existing_value;
+      return true;
+    }
+    std::string value(merge_in.existing_value->data() + Redis::STRING_HDR_SIZE,
+                      merge_in.existing_value->size() - Redis::STRING_HDR_SIZE);
+    if (!value.empty()) {
+      auto parse_result = ParseInt<int64_t>(value, 10);
+      if (!parse_result || isspace(value[0])) {
+        merge_out->existing_operand = *merge_in.existing_value;
+        return true;
+      }
+      n = *parse_result;
+    }
+    header.assign(merge_in.existing_value->data(), Redis::STRING_HDR_SIZE);
+  } else {
+    Metadata string_metadata(kRedisString, false);
+    string_metadata.Encode(&header);
+  }
+
+  for (const auto &operand : merge_in.operand_list) {
+    auto parse_result = ParseInt<int64_t>(operand.ToStringView(), 10);
+    if (!parse_result) continue;
+    int64_t increment = *parse_result;
+    if ((increment < 0 && n <= 0 && increment < (LLONG_MIN - n)) ||
+        (increment > 0 && n >= 0 && increment > (LLONG_MAX - n))) {
+      continue;
+    }
+    n += increment;
+  }
+  merge_out->new_value = std::move(header);
+  merge_out->new_value.append(std::to_string(n));
+  return true;
+}
+
+}  // namespace Engine
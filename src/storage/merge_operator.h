@@ -0,0 +1,44 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#pragma once
+
+#include <rocksdb/merge_operator.h>
+
+#include <cstdint>
+#include <string>
+
+namespace Engine {
+
+// StringCounterMergeOperator applies the blind increments of the string counters in the metadata
+// column family, so INCRBY/DECRBY with NOREPLY could be written without reading the old value.
+//
+// The operand is the decimal increment. The missing or expired key starts from zero as a new string
+// without expire, and the operand which is applied to a live non-integer value or would overflow is
+// dropped like the failed INCRBY. Since dropping the operands isn't associative, there's no partial
+// merge, and the operands are only folded into the base value by reads, flushes and compactions.
+class StringCounterMergeOperator : public rocksdb::MergeOperator {
+ public:
+  const char *Name() const override { return "StringCounterMergeOperator"; }
+  bool FullMergeV2(const MergeOperationInput &merge_in, MergeOperationOutput *merge_out) const override;
+
+  static std::string EncodeOperand(int64_t increment) { return std::to_string(increment); }
+};
+
+}  // namespace Engine
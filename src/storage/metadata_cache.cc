@@ -0,0 +1,119 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "metadata_cache.h"
+
+MetadataCache::MetadataCache(size_t capacity, int hash_power)
+    : capacity_(capacity), hash_mask_((1 << hash_power) - 1) {
+  for (int i = 0; i <= hash_mask_; i++) {
+    shards_.emplace_back(std::make_unique<Shard>());
+  }
+}
+
+MetadataCache::Shard &MetadataCache::getShard(const rocksdb::Slice &key) {
+  auto hash = std::hash<std::string_view>{}(std::string_view(key.data(), key.size()));
+  return *shards_[hash & hash_mask_];
+}
+
+bool MetadataCache::Lookup(const rocksdb::Slice &key, std::string *value, uint64_t *ticket) {
+  auto &shard = getShard(key);
+  std::lock_guard<std::mutex> guard(shard.mu);
+  auto iter = shard.entries.find(std::string_view(key.data(), key.size()));
+  if (iter == shard.entries.end()) {
+    *ticket = shard.generation;
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  shard.lru.splice(shard.lru.begin(), shard.lru, iter->second);
+  value->assign(iter->second->value);
+  hits_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void MetadataCache::Insert(const rocksdb::Slice &key, const rocksdb::Slice &value, uint64_t ticket) {
+  size_t capacity = capacity_;
+  // Every shard has the same part of the capacity
+  size_t shard_capacity = capacity / shards_.size();
+  auto &shard = getShard(key);
+  std::lock_guard<std::mutex> guard(shard.mu);
+  // The key may be written after the ticket was taken
+  if (ticket != shard.generation) return;
+
+  auto iter = shard.entries.find(std::string_view(key.data(), key.size()));
+  if (iter != shard.entries.end()) {
+    shard.usage -= charge(*iter->second);
+    iter->second->value.assign(value.data(), value.size());
+    shard.usage += charge(*iter->second);
+    shard.lru.splice(shard.lru.begin(), shard.lru, iter->second);
+  } else {
+    shard.lru.push_front(Entry{key.ToString(), value.ToString()});
+    auto &entry = shard.lru.front();
+    shard.usage += charge(entry);
+    shard.entries.emplace(std::string_view(entry.key), shard.lru.begin());
+  }
+  evict(&shard, shard_capacity);
+}
+
+void MetadataCache::Erase(const rocksdb::Slice &key) {
+  auto &shard = getShard(key);
+  std::lock_guard<std::mutex> guard(shard.mu);
+  shard.generation++;
+  auto iter = shard.entries.find(std::string_view(key.data(), key.size()));
+  if (iter == shard.entries.end()) return;
+  shard.usage -= charge(*iter->second);
+  auto entry = iter->second;
+  shard.entries.erase(iter);
+  shard.lru.erase(entry);
+}
+
+void MetadataCache::Clear() {
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard->mu);
+    shard->generation++;
+    evict(shard.get(), 0);
+  }
+}
+
+void MetadataCache::SetCapacity(size_t capacity) {
+  capacity_ = capacity;
+  size_t shard_capacity = capacity / shards_.size();
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard->mu);
+    evict(shard.get(), shard_capacity);
+  }
+}
+
+size_t MetadataCache::GetUsage() {
+  size_t usage = 0;
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard->mu);
+    usage += shard->usage;
+  }
+  return usage;
+}
+
+void MetadataCache::evict(Shard *shard, size_t capacity) {
+  while (shard->usage > capacity && !shard->lru.empty()) {
+    auto &entry = shard->lru.back();
+    shard->usage -= charge(entry);
+    shard->entries.erase(std::string_view(entry.key));
+    shard->lru.pop_back();
+  }
+}
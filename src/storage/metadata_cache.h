@@ -0,0 +1,87 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <rocksdb/slice.h>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// MetadataCache caches the metadata values of hot keys in front of the metadata column family,
+// it's a sharded LRU cache which is bounded by the memory usage of the entries.
+//
+// To keep coherent with writes, the writer must erase the written keys after the write
+// was applied, and the reader must take a ticket while missing the cache. The ticket is
+// invalidated by the erasure in the same shard, so a reader who read the value before
+// the write couldn't fill the cache with the stale value.
+class MetadataCache {
+ public:
+  explicit MetadataCache(size_t capacity, int hash_power = 4);
+
+  MetadataCache(const MetadataCache &) = delete;
+  MetadataCache &operator=(const MetadataCache &) = delete;
+
+  bool Enabled() const { return capacity_.load() > 0; }
+  // Return false if the key is missed, and then the ticket is assigned to fill the key later
+  bool Lookup(const rocksdb::Slice &key, std::string *value, uint64_t *ticket);
+  void Insert(const rocksdb::Slice &key, const rocksdb::Slice &value, uint64_t ticket);
+  void Erase(const rocksdb::Slice &key);
+  void Clear();
+  void SetCapacity(size_t capacity);
+
+  uint64_t GetHits() const { return hits_; }
+  uint64_t GetMisses() const { return misses_; }
+  size_t GetUsage();
+
+ private:
+  struct Entry {
+    std::string key;
+    std::string value;
+  };
+
+  struct Shard {
+    std::mutex mu;
+    uint64_t generation = 0;
+    size_t usage = 0;
+    std::list<Entry> lru;  // the most recently used entry is at the front
+    // the keys are referred to the entries in the lru list
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> entries;
+  };
+
+  static size_t charge(const Entry &entry) { return entry.key.size() + entry.value.size() + kEntryOverhead; }
+  Shard &getShard(const rocksdb::Slice &key);
+  void evict(Shard *shard, size_t capacity);
+
+  // the approximate memory overhead of an entry in the list and the map
+  static constexpr size_t kEntryOverhead = 128;
+
+  std::atomic<size_t> capacity_;
+  int hash_mask_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::atomic<uint64_t> hits_ = 0;
+  std::atomic<uint64_t> misses_ = 0;
+};
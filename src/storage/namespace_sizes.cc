@@ -0,0 +1,74 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "namespace_sizes.h"
+
+#include <mutex>
+
+namespace Engine {
+
+void NamespaceSizes::Add(const std::string &ns, uint64_t bytes) {
+  std::shared_lock<std::shared_mutex> guard(mu_);
+  auto iter = entries_.find(ns);
+  if (iter == entries_.end()) return;
+  auto &entry = *iter->second;
+  uint64_t size = entry.size.fetch_add(bytes) + bytes;
+  if (!entry.over_quota && size >= entry.quota) entry.over_quota = true;
+}
+
+void NamespaceSizes::Reconcile(const std::string &ns, uint64_t size, uint64_t quota) {
+  std::unique_lock<std::shared_mutex> guard(mu_);
+  auto &entry = entries_[ns];
+  if (!entry) entry = std::make_unique<Entry>();
+  // The bytes written while computing the approximate size may be dropped, which is
+  // included in the approximate size by the memtables mostly
+  entry->size = size;
+  entry->quota = quota;
+  entry->over_quota = size >= quota;
+  enabled_ = true;
+}
+
+void NamespaceSizes::Retain(const std::set<std::string> &namespaces) {
+  std::unique_lock<std::shared_mutex> guard(mu_);
+  for (auto iter = entries_.begin(); iter != entries_.end();) {
+    if (namespaces.count(iter->first) == 0) {
+      iter = entries_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  enabled_ = !entries_.empty();
+}
+
+bool NamespaceSizes::IsOverQuota(const std::string &ns) {
+  if (!enabled_) return false;
+  std::shared_lock<std::shared_mutex> guard(mu_);
+  auto iter = entries_.find(ns);
+  return iter != entries_.end() && iter->second->over_quota;
+}
+
+uint64_t NamespaceSizes::GetSize(const std::string &ns) {
+  std::shared_lock<std::shared_mutex> guard(mu_);
+  auto iter = entries_.find(ns);
+  if (iter == entries_.end()) return 0;
+  return iter->second->size;
+}
+
+}  // namespace Engine
@@ -0,0 +1,69 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Engine {
+
+// NamespaceSizes estimates the disk usage of the namespaces with the disk quotas incrementally,
+// so the writes of a namespace over its quota can be rejected without computing its size.
+// The estimate is the approximate size of the namespace by the last reconciliation plus the
+// bytes written since then, which is conservative since the overwritten and the deleted data
+// take the space until they're compacted. It's reconciled periodically by the server cron.
+class NamespaceSizes {
+ public:
+  NamespaceSizes() = default;
+
+  NamespaceSizes(const NamespaceSizes &) = delete;
+  NamespaceSizes &operator=(const NamespaceSizes &) = delete;
+
+  // Whether any namespace is tracked, the writes needn't be counted otherwise
+  bool Enabled() const { return enabled_; }
+  // Add the written bytes to the estimated size of the namespace if it's tracked
+  void Add(const std::string &ns, uint64_t bytes);
+  // Replace the estimated size of the namespace with its approximate size, and track it with the quota
+  void Reconcile(const std::string &ns, uint64_t size, uint64_t quota);
+  // Stop tracking the namespaces which aren't in the given ones, e.g. their quotas were removed
+  void Retain(const std::set<std::string> &namespaces);
+  bool IsOverQuota(const std::string &ns);
+  // The estimated size of the namespace, or 0 if it isn't tracked
+  uint64_t GetSize(const std::string &ns);
+
+ private:
+  struct Entry {
+    std::atomic<uint64_t> size{0};
+    std::atomic<uint64_t> quota{0};
+    std::atomic<bool> over_quota{false};
+  };
+
+  std::atomic<bool> enabled_{false};
+  std::shared_mutex mu_;
+  std::unordered_map<std::string, std::unique_ptr<Entry>> entries_;
+};
+
+}  // namespace Engine
@@ -0,0 +1,45 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "prefix_extractor.h"
+
+#include "encoding.h"
+
+const char *InternalKeyPrefixExtractor::Name() const {
+  // The name is persisted in the SST files, the filters would be ignored if it's changed
+  return slot_id_encoded_ ? "Kvrocks.InternalKeyPrefixWithSlotID" : "Kvrocks.InternalKeyPrefix";
+}
+
+size_t InternalKeyPrefixExtractor::prefixLength(const rocksdb::Slice &key) const {
+  if (key.empty()) return 0;
+  size_t pos = 1 + static_cast<uint8_t>(key[0]);
+  if (slot_id_encoded_) pos += 2;
+  if (key.size() < pos + 4) return 0;
+  size_t key_size = DecodeFixed32(key.data() + pos);
+  pos += 4 + key_size + 8;
+  if (key.size() < pos) return 0;
+  return pos;
+}
+
+rocksdb::Slice InternalKeyPrefixExtractor::Transform(const rocksdb::Slice &key) const {
+  return {key.data(), prefixLength(key)};
+}
+
+bool InternalKeyPrefixExtractor::InDomain(const rocksdb::Slice &key) const { return prefixLength(key) != 0; }
@@ -0,0 +1,43 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <rocksdb/slice.h>
+#include <rocksdb/slice_transform.h>
+
+// InternalKeyPrefixExtractor extracts the prefix of the subkey, which is the encoded InternalKey
+// without the sub key, i.e. [ns size][ns][slot id][key size][key][version]. All subkeys of the
+// same collection share the prefix, so that the prefix bloom filters can skip the SST files
+// which don't contain the collection while seeking into it.
+class InternalKeyPrefixExtractor : public rocksdb::SliceTransform {
+ public:
+  explicit InternalKeyPrefixExtractor(bool slot_id_encoded) : slot_id_encoded_(slot_id_encoded) {}
+
+  const char *Name() const override;
+  rocksdb::Slice Transform(const rocksdb::Slice &key) const override;
+  bool InDomain(const rocksdb::Slice &key) const override;
+
+ private:
+  // Return 0 if the key isn't an encoded InternalKey
+  size_t prefixLength(const rocksdb::Slice &key) const;
+
+  bool slot_id_encoded_;
+};
@@ -20,17 +20,36 @@
 
 #include "redis_db.h"
 
+#include <algorithm>
+#include <condition_variable>
 #include <ctime>
 #include <map>
-
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <set>
+
+#include "cache_warmer.h"
+#include "rocksdb_crc32c.h"
 #include "cluster/redis_slot.h"
 #include "db_util.h"
+#include "key_reclaimer.h"
+#include "lazy_expirer.h"
 #include "parse_util.h"
 #include "rocksdb/iterator.h"
 #include "server/server.h"
+#include "task_runner.h"
 
 namespace Redis {
 
+// The smallest key which is greater than all the keys with the prefix, or empty if there isn't
+static std::string prefixUpperBound(std::string prefix) {
+  while (!prefix.empty() && static_cast<uint8_t>(prefix.back()) == 0xff) prefix.pop_back();
+  if (!prefix.empty()) prefix.back() = static_cast<char>(static_cast<uint8_t>(prefix.back()) + 1);
+  return prefix;
+}
+
 Database::Database(Engine::Storage *storage, const std::string &ns) {
   storage_ = storage;
   metadata_cf_handle_ = storage->GetCFHandle("metadata");
@@ -38,35 +57,98 @@ Database::Database(Engine::Storage *storage, const std::string &ns) {
   namespace_ = ns;
 }
 
-rocksdb::Status Database::GetMetadata(RedisType type, const Slice &ns_key, Metadata *metadata) {
+rocksdb::Status Database::GetMetadata(RedisType type, const Slice &ns_key, Metadata *metadata,
+                                      const rocksdb::Snapshot *snapshot) {
   std::string old_metadata;
   metadata->Encode(&old_metadata);
   std::string bytes;
-  auto s = GetRawMetadata(ns_key, &bytes);
+  auto s = GetRawMetadata(ns_key, &bytes, snapshot);
   if (!s.ok()) return s;
   metadata->Decode(bytes);
 
   if (metadata->Expired()) {
+    // Delete the expired key in background, so the following reads needn't go through its metadata
+    storage_->GetLazyExpirer()->Add(ns_key);
     metadata->Decode(old_metadata);
     return rocksdb::Status::NotFound(kErrMsgKeyExpired);
   }
   if (metadata->Type() != type &&
-      (metadata->size > 0 || metadata->Type() == kRedisString || metadata->Type() == kRedisStream)) {
+      (metadata->size > 0 || metadata->Type() == kRedisString || IsEmptyAllowed(metadata->Type()))) {
     metadata->Decode(old_metadata);
     return rocksdb::Status::InvalidArgument(kErrMsgWrongType);
   }
-  if (metadata->size == 0 && type != kRedisStream) {  // stream is allowed to be empty
+  if (metadata->size == 0 && !IsEmptyAllowed(type)) {
     metadata->Decode(old_metadata);
     return rocksdb::Status::NotFound("no elements");
   }
   return s;
 }
 
-rocksdb::Status Database::GetRawMetadata(const Slice &ns_key, std::string *bytes) {
-  LatestSnapShot ss(db_);
+rocksdb::Status Database::GetRawMetadata(const Slice &ns_key, std::string *bytes, const rocksdb::Snapshot *snapshot) {
   rocksdb::ReadOptions read_options;
-  read_options.snapshot = ss.GetSnapShot();
-  return db_->Get(read_options, metadata_cf_handle_, ns_key, bytes);
+  if (snapshot) {
+    read_options.snapshot = snapshot;
+    return storage_->Get(read_options, metadata_cf_handle_, ns_key, bytes);
+  }
+
+  storage_->GetCacheWarmer()->Sample(ns_key);
+  // The cache only serves the latest metadata, the ticket must be taken before reading the DB.
+  // It doesn't know the writes buffered by the transaction or the pinned snapshot.
+  auto cache = storage_->GetMetadataCache();
+  uint64_t ticket = 0;
+  bool use_cache = cache->Enabled() && !storage_->InTxn() && !Engine::Storage::GetPinnedSnapshot();
+  if (use_cache && cache->Lookup(ns_key, bytes, &ticket)) return rocksdb::Status::OK();
+
+  auto s = storage_->Get(read_options, metadata_cf_handle_, ns_key, bytes);
+  if (use_cache && s.ok()) cache->Insert(ns_key, *bytes, ticket);
+  return s;
+}
+
+std::unique_ptr<ReentrantMultiLockGuard> Database::lockStoreKeys(const Slice &dst,
+                                                                 const std::vector<Slice> &sources) {
+  std::vector<std::string> dst_keys(1), source_keys(sources.size());
+  AppendNamespacePrefix(dst, &dst_keys[0]);
+  for (size_t i = 0; i < sources.size(); i++) {
+    AppendNamespacePrefix(sources[i], &source_keys[i]);
+  }
+  return std::make_unique<ReentrantMultiLockGuard>(storage_->GetLockManager(), dst_keys, source_keys);
+}
+
+void Database::multiGetSubKeys(const Slice &ns_key, uint64_t version, const std::vector<Slice> &sub_keys,
+                               std::vector<rocksdb::PinnableSlice> *values, std::vector<rocksdb::Status> *statuses,
+                               const rocksdb::Snapshot *snapshot) {
+  SubKeyEncoder encoder(ns_key, version, storage_->IsSlotIdEncoded());
+  std::vector<Slice> keys;
+  encoder.EncodeAll(sub_keys, &keys);
+
+  // A single MultiGet reads a consistent view without the snapshot
+  rocksdb::ReadOptions read_options;
+  read_options.snapshot = snapshot;
+  read_options.async_io = true;
+  values->clear();
+  values->resize(keys.size());
+  statuses->assign(keys.size(), rocksdb::Status::OK());
+  storage_->MultiGet(read_options, db_->DefaultColumnFamily(), keys.size(), keys.data(), values->data(),
+                     statuses->data());
+}
+
+void Database::multiGetMetadata(const std::vector<std::string> &ns_keys, std::vector<rocksdb::PinnableSlice> *values,
+                                std::vector<rocksdb::Status> *statuses) {
+  std::vector<Slice> keys(ns_keys.begin(), ns_keys.end());
+  values->clear();
+  values->resize(keys.size());
+  statuses->assign(keys.size(), rocksdb::Status::OK());
+  storage_->MultiGet(rocksdb::ReadOptions(), metadata_cf_handle_, keys.size(), keys.data(), values->data(),
+                     statuses->data());
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (!(*statuses)[i].ok()) continue;
+    Metadata metadata(kRedisNone, false);
+    metadata.Decode((*values)[i].ToString());
+    if (metadata.Expired()) {
+      storage_->GetLazyExpirer()->Add(keys[i]);
+      (*statuses)[i] = rocksdb::Status::NotFound(kErrMsgKeyExpired);
+    }
+  }
 }
 
 rocksdb::Status Database::GetRawMetadataByUserKey(const Slice &user_key, std::string *bytes) {
@@ -82,28 +164,27 @@ rocksdb::Status Database::Expire(const Slice &user_key, int timestamp) {
   std::string value;
   Metadata metadata(kRedisNone, false);
   LockGuard guard(storage_->GetLockManager(), ns_key);
-  rocksdb::Status s = db_->Get(rocksdb::ReadOptions(), metadata_cf_handle_, ns_key, &value);
+  rocksdb::Status s = storage_->Get(rocksdb::ReadOptions(), metadata_cf_handle_, ns_key, &value);
   if (!s.ok()) return s;
   metadata.Decode(value);
   if (metadata.Expired()) {
+    storage_->GetLazyExpirer()->Add(ns_key);
     return rocksdb::Status::NotFound(kErrMsgKeyExpired);
   }
-  if (metadata.Type() != kRedisString && metadata.size == 0) {
+  if (metadata.Type() != kRedisString && !IsEmptyAllowed(metadata.Type()) && metadata.size == 0) {
     return rocksdb::Status::NotFound("no elements");
   }
   if (metadata.expire == timestamp) return rocksdb::Status::OK();
 
-  char *buf = new char[value.size()];
-  memcpy(buf, value.data(), value.size());
-  // +1 to skip the flags
-  EncodeFixed32(buf + 1, (uint32_t)timestamp);
+  // The expire isn't at a fixed offset in the compact encoding, so the common fields are re-encoded
+  std::string bytes;
+  s = Metadata::Rewrite(value, metadata.version, timestamp, &bytes);
+  if (!s.ok()) return s;
   rocksdb::WriteBatch batch;
   WriteBatchLogData log_data(kRedisNone, {std::to_string(kRedisCmdExpire)});
   batch.PutLogData(log_data.Encode());
-  batch.Put(metadata_cf_handle_, ns_key, Slice(buf, value.size()));
-  s = storage_->Write(storage_->DefaultWriteOptions(), &batch);
-  delete[] buf;
-  return s;
+  batch.Put(metadata_cf_handle_, ns_key, bytes);
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
 }
 
 rocksdb::Status Database::Del(const Slice &user_key) {
@@ -112,34 +193,142 @@ rocksdb::Status Database::Del(const Slice &user_key) {
 
   std::string value;
   LockGuard guard(storage_->GetLockManager(), ns_key);
-  rocksdb::Status s = db_->Get(rocksdb::ReadOptions(), metadata_cf_handle_, ns_key, &value);
+  rocksdb::Status s = storage_->Get(rocksdb::ReadOptions(), metadata_cf_handle_, ns_key, &value);
   if (!s.ok()) return s;
   Metadata metadata(kRedisNone, false);
   metadata.Decode(value);
   if (metadata.Expired()) {
+    storage_->GetLazyExpirer()->Add(ns_key);
     return rocksdb::Status::NotFound(kErrMsgKeyExpired);
   }
-  return storage_->Delete(storage_->DefaultWriteOptions(), metadata_cf_handle_, ns_key);
+  s = storage_->Delete(storage_->DefaultWriteOptions(), metadata_cf_handle_, ns_key);
+  // Only the metadata was deleted, reclaim the subkeys of large keys in background
+  if (s.ok()) storage_->GetKeyReclaimer()->Reclaim(ns_key, metadata);
+  return s;
+}
+
+rocksdb::Status Database::MDel(const std::vector<Slice> &keys, uint64_t *deleted_cnt) {
+  *deleted_cnt = 0;
+  std::set<std::string> unique_keys;
+  for (const auto &key : keys) {
+    std::string ns_key;
+    AppendNamespacePrefix(key, &ns_key);
+    unique_keys.emplace(std::move(ns_key));
+  }
+  std::vector<std::string> ns_keys(unique_keys.begin(), unique_keys.end());
+
+  MultiLockGuard guard(storage_->GetLockManager(), ns_keys);
+  std::vector<rocksdb::PinnableSlice> values;
+  std::vector<rocksdb::Status> statuses;
+  multiGetMetadata(ns_keys, &values, &statuses);
+
+  rocksdb::WriteBatch batch;
+  std::vector<std::pair<size_t, Metadata>> deleted;
+  for (size_t i = 0; i < ns_keys.size(); i++) {
+    if (statuses[i].IsNotFound()) continue;
+    if (!statuses[i].ok()) return statuses[i];
+    Metadata metadata(kRedisNone, false);
+    metadata.Decode(values[i].ToString());
+    batch.Delete(metadata_cf_handle_, ns_keys[i]);
+    deleted.emplace_back(i, metadata);
+  }
+  if (deleted.empty()) return rocksdb::Status::OK();
+
+  auto s = storage_->Write(storage_->DefaultWriteOptions(), &batch);
+  if (!s.ok()) return s;
+  // Only the metadata was deleted, reclaim the subkeys of large keys in background
+  for (const auto &[i, metadata] : deleted) {
+    storage_->GetKeyReclaimer()->Reclaim(ns_keys[i], metadata);
+  }
+  *deleted_cnt = deleted.size();
+  return rocksdb::Status::OK();
 }
 
 rocksdb::Status Database::Exists(const std::vector<Slice> &keys, int *ret) {
   *ret = 0;
-  LatestSnapShot ss(db_);
+  std::vector<std::string> ns_keys(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    AppendNamespacePrefix(keys[i], &ns_keys[i]);
+  }
+
+  // A single MultiGet reads a consistent view of the keys without the snapshot
+  std::vector<rocksdb::PinnableSlice> values;
+  std::vector<rocksdb::Status> statuses;
+  multiGetMetadata(ns_keys, &values, &statuses);
+  for (const auto &s : statuses) {
+    if (s.ok()) *ret += 1;
+  }
+  return rocksdb::Status::OK();
+}
+
+void Database::Prefetch(const std::vector<PrefetchKey> &keys) {
+  std::vector<std::string> ns_keys(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    AppendNamespacePrefix(keys[i].user_key, &ns_keys[i]);
+  }
+
+  // The cached metadata needn't be read again, the missed ones are filled with their tickets
+  auto cache = storage_->GetMetadataCache();
+  bool use_cache = cache->Enabled() && !storage_->InTxn() && !Engine::Storage::GetPinnedSnapshot();
+  std::vector<std::string> raw_metadata(keys.size());
+  std::vector<uint64_t> tickets(keys.size());
+  std::vector<size_t> missed;
+  std::vector<Slice> missed_keys;
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (use_cache && cache->Lookup(ns_keys[i], &raw_metadata[i], &tickets[i])) continue;
+    missed.emplace_back(i);
+    missed_keys.emplace_back(ns_keys[i]);
+  }
+
+  std::vector<rocksdb::PinnableSlice> values(missed.size());
+  std::vector<rocksdb::Status> statuses(missed.size());
   rocksdb::ReadOptions read_options;
-  read_options.snapshot = ss.GetSnapShot();
+  read_options.async_io = true;
+  if (!missed.empty()) {
+    storage_->MultiGet(read_options, metadata_cf_handle_, missed_keys.size(), missed_keys.data(), values.data(),
+                       statuses.data());
+  }
+  std::vector<bool> found(keys.size(), true);
+  for (size_t j = 0; j < missed.size(); j++) {
+    size_t i = missed[j];
+    found[i] = statuses[j].ok();
+    if (!found[i]) continue;
+    raw_metadata[i] = values[j].ToString();
+    if (use_cache) cache->Insert(ns_keys[i], raw_metadata[i], tickets[i]);
+  }
 
-  rocksdb::Status s;
-  std::string ns_key, value;
-  for (const auto &key : keys) {
-    AppendNamespacePrefix(key, &ns_key);
-    s = db_->Get(read_options, metadata_cf_handle_, ns_key, &value);
-    if (s.ok()) {
-      Metadata metadata(kRedisNone, false);
-      metadata.Decode(value);
-      if (!metadata.Expired()) *ret += 1;
+  // The sub keys of the live collections whose elements aren't inlined in the metadata
+  std::vector<std::string> sub_keys;
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (!found[i] || keys[i].sub_keys.empty()) continue;
+    Metadata metadata(kRedisNone, false);
+    if (!metadata.Decode(raw_metadata[i]).ok() || metadata.Type() != keys[i].type || metadata.Expired()) continue;
+
+    bool inlined = false;
+    if (metadata.Type() == kRedisHash) {
+      HashMetadata hash_metadata(false);
+      inlined = !hash_metadata.Decode(raw_metadata[i]).ok() || hash_metadata.inlined;
+    } else if (metadata.Type() == kRedisSet) {
+      SetMetadata set_metadata(false);
+      inlined = !set_metadata.Decode(raw_metadata[i]).ok() || set_metadata.inlined;
+    } else if (metadata.Type() == kRedisZSet) {
+      ZSetMetadata zset_metadata(false);
+      inlined = !zset_metadata.Decode(raw_metadata[i]).ok() || zset_metadata.inlined;
+    }
+    if (inlined) continue;
+
+    for (const auto &sub_key : keys[i].sub_keys) {
+      InternalKey(ns_keys[i], sub_key, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_keys.emplace_back());
     }
   }
-  return rocksdb::Status::OK();
+  if (sub_keys.empty()) return;
+
+  std::vector<Slice> sub_key_slices(sub_keys.begin(), sub_keys.end());
+  values.clear();
+  values.resize(sub_keys.size());
+  statuses.assign(sub_keys.size(), rocksdb::Status::OK());
+  storage_->MultiGet(read_options, db_->DefaultColumnFamily(), sub_key_slices.size(), sub_key_slices.data(),
+                     values.data(), statuses.data());
 }
 
 rocksdb::Status Database::TTL(const Slice &user_key, int *ttl) {
@@ -147,22 +336,22 @@ rocksdb::Status Database::TTL(const Slice &user_key, int *ttl) {
   AppendNamespacePrefix(user_key, &ns_key);
 
   *ttl = -2;  // ttl is -2 when the key does not exist or expired
-  LatestSnapShot ss(db_);
   rocksdb::ReadOptions read_options;
-  read_options.snapshot = ss.GetSnapShot();
   std::string value;
-  rocksdb::Status s = db_->Get(read_options, metadata_cf_handle_, ns_key, &value);
+  rocksdb::Status s = storage_->Get(read_options, metadata_cf_handle_, ns_key, &value);
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
 
   Metadata metadata(kRedisNone, false);
   metadata.Decode(value);
   *ttl = metadata.TTL();
+  if (metadata.Expired()) storage_->GetLazyExpirer()->Add(ns_key);
   return rocksdb::Status::OK();
 }
 
 void Database::GetKeyNumStats(const std::string &prefix, KeyNumStats *stats) { Keys(prefix, nullptr, stats); }
 
-void Database::Keys(const std::string &prefix, std::vector<std::string> *keys, KeyNumStats *stats) {
+void Database::Keys(const std::string &prefix, std::vector<std::string> *keys, KeyNumStats *stats,
+                    const Util::GlobPattern *pattern) {
   uint16_t slot_id = 0;
   std::string ns_prefix, ns, user_key, value;
   if (namespace_ != kDefaultNamespace || keys != nullptr) {
@@ -178,11 +367,14 @@ void Database::Keys(const std::string &prefix, std::vector<std::string> *keys, K
   }
 
   uint64_t ttl_sum = 0;
-  LatestSnapShot ss(db_);
   rocksdb::ReadOptions read_options;
-  read_options.snapshot = ss.GetSnapShot();
+  storage_->SetLongScanReadOptions(&read_options);
   read_options.fill_cache = false;
-  auto iter = DBUtil::UniqueIterator(db_, read_options, metadata_cf_handle_);
+  // The prefix is changed for every slot if the slot id is encoded, so the bound only works without it
+  std::string upper_bound_key = storage_->IsSlotIdEncoded() ? std::string() : prefixUpperBound(ns_prefix);
+  rocksdb::Slice upper_bound(upper_bound_key);
+  if (!upper_bound_key.empty()) read_options.iterate_upper_bound = &upper_bound;
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, metadata_cf_handle_));
 
   while (true) {
     ns_prefix.empty() ? iter->SeekToFirst() : iter->Seek(ns_prefix);
@@ -197,6 +389,10 @@ void Database::Keys(const std::string &prefix, std::vector<std::string> *keys, K
         if (stats) stats->n_expired++;
         continue;
       }
+      if (keys || pattern) {
+        ExtractNamespaceKey(iter->key(), &ns, &user_key, storage_->IsSlotIdEncoded());
+        if (pattern && !pattern->Match(user_key)) continue;
+      }
       if (stats) {
         int32_t ttl = metadata.TTL();
         stats->n_key++;
@@ -205,10 +401,7 @@ void Database::Keys(const std::string &prefix, std::vector<std::string> *keys, K
           if (ttl > 0) ttl_sum += ttl;
         }
       }
-      if (keys) {
-        ExtractNamespaceKey(iter->key(), &ns, &user_key, storage_->IsSlotIdEncoded());
-        keys->emplace_back(user_key);
-      }
+      if (keys) keys->emplace_back(user_key);
     }
 
     if (!storage_->IsSlotIdEncoded()) break;
@@ -225,19 +418,152 @@ void Database::Keys(const std::string &prefix, std::vector<std::string> *keys, K
   }
 }
 
+void Database::ParallelKeys(const std::string &prefix, std::vector<std::string> *keys,
+                            const Util::GlobPattern *pattern, TaskRunner *runner, size_t parallelism) {
+  // The transaction and the pinned snapshot are thread local, so they're only seen by the caller
+  bool thread_bound = storage_->InTxn() || Engine::Storage::GetPinnedSnapshot() != nullptr;
+  if ((storage_->IsSlotIdEncoded() && !prefix.empty()) || thread_bound) {
+    Keys(prefix, keys, nullptr, pattern);
+    return;
+  }
+
+  std::string begin, end;
+  KeyRange(prefix, &begin, &end);
+  auto boundaries = PartitionKeyRange(begin, end, parallelism);
+  boundaries.insert(boundaries.begin(), begin);
+  boundaries.emplace_back(end);
+  size_t partitions = boundaries.size() - 1;
+  std::vector<std::vector<std::string>> partition_keys(partitions);
+
+  std::mutex mu;
+  std::condition_variable cond;
+  size_t done = 0;
+  auto scan = [&](size_t i) {
+    ScanKeyRange(boundaries[i], boundaries[i + 1], 0, prefix, pattern, kRedisNone, &partition_keys[i]);
+    std::lock_guard<std::mutex> guard(mu);
+    done++;
+    cond.notify_one();
+  };
+  std::vector<TaskHandle> handles(partitions);
+  for (size_t i = 0; i + 1 < partitions; i++) {
+    if (!runner->Publish([&scan, i] { scan(i); }, TaskPriority::kNormal, "parallel-keys", &handles[i]).IsOK()) {
+      handles[i] = TaskHandle();
+      scan(i);
+    }
+  }
+  // The last partition is scanned by the caller, and then the partitions which haven't been started,
+  // so the runner being busy or stopped doesn't block the caller
+  scan(partitions - 1);
+  for (size_t i = 0; i + 1 < partitions; i++) {
+    if (handles[i].Cancel()) scan(i);
+  }
+  std::unique_lock<std::mutex> lock(mu);
+  cond.wait(lock, [&] { return done == partitions; });
+
+  // The partitions are in the order of the keys, so the keys are merged by concatenating them
+  for (auto &partition : partition_keys) {
+    keys->insert(keys->end(), std::make_move_iterator(partition.begin()), std::make_move_iterator(partition.end()));
+  }
+}
+
+void Database::KeyRange(const std::string &prefix, std::string *begin, std::string *end) {
+  if (storage_->IsSlotIdEncoded()) {
+    ComposeNamespaceKey(namespace_, "", begin, false);
+  } else {
+    AppendNamespacePrefix(prefix, begin);
+  }
+  *end = prefixUpperBound(*begin);
+}
+
+std::vector<std::string> Database::PartitionKeyRange(const std::string &begin, const std::string &end, size_t n) {
+  std::vector<rocksdb::LiveFileMetaData> files;
+  db_->GetLiveFilesMetaData(&files);
+  auto cf_name = storage_->RouteCFHandle(metadata_cf_handle_, begin)->GetName();
+
+  // The files in the range are weighed by their sizes, those across the boundaries of the range are skipped
+  std::vector<std::pair<std::string, uint64_t>> starts;
+  uint64_t total_size = 0;
+  for (const auto &file : files) {
+    if (file.column_family_name != cf_name || file.smallestkey <= begin) continue;
+    if (!end.empty() && file.smallestkey >= end) continue;
+    starts.emplace_back(file.smallestkey, file.size);
+    total_size += file.size;
+  }
+  std::sort(starts.begin(), starts.end());
+
+  std::vector<std::string> boundaries;
+  if (n <= 1 || total_size == 0) return boundaries;
+  uint64_t accumulated = 0;
+  for (const auto &[start, size] : starts) {
+    // The files of the levels overlap, so the boundary is cut before the file which makes the partition full
+    uint64_t target = total_size * (boundaries.size() + 1) / n;
+    if (accumulated >= target && (boundaries.empty() || boundaries.back() != start)) {
+      boundaries.emplace_back(start);
+      if (boundaries.size() + 1 >= n) break;
+    }
+    accumulated += size;
+  }
+  return boundaries;
+}
+
+rocksdb::Status Database::ScanKeyRange(const std::string &begin, const std::string &end, uint64_t limit,
+                                       const std::string &prefix, const Util::GlobPattern *pattern, RedisType type,
+                                       std::vector<std::string> *keys, std::string *next) {
+  if (next) next->clear();
+  rocksdb::ReadOptions read_options;
+  storage_->SetLongScanReadOptions(&read_options);
+  read_options.fill_cache = false;
+  rocksdb::Slice upper_bound(end);
+  if (!end.empty()) read_options.iterate_upper_bound = &upper_bound;
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, metadata_cf_handle_));
+
+  // The scanned keys are counted like Scan, so the range with rarely matched keys doesn't stall the server
+  uint64_t cnt = 0;
+  std::string ns, user_key;
+  for (iter->Seek(begin); iter->Valid(); iter->Next()) {
+    if (limit > 0 && cnt >= limit) {
+      if (next) *next = iter->key().ToString();
+      break;
+    }
+    if (type != kRedisNone && !iter->value().empty() && static_cast<RedisType>(iter->value()[0] & 0x0f) != type) {
+      cnt++;
+      continue;
+    }
+    Metadata metadata(kRedisNone, false);
+    if (!metadata.Decode(iter->value().ToString()).ok() || metadata.Expired()) continue;
+    cnt++;
+    ExtractNamespaceKey(iter->key(), &ns, &user_key, storage_->IsSlotIdEncoded());
+    if (user_key.compare(0, prefix.size(), prefix) != 0) continue;
+    if (pattern && !pattern->Match(user_key)) continue;
+    keys->emplace_back(user_key);
+  }
+  return iter->status();
+}
+
+// The iterators of the scans aren't cached in the transactions and the pinned snapshots, which see other views
+static size_t scanIteratorCacheSize(Engine::Storage *storage) {
+  if (storage->InTxn() || Engine::Storage::GetPinnedSnapshot()) return 0;
+  return static_cast<size_t>(storage->GetConfig()->scan_iterator_cache_size);
+}
+
+// The key of the iterator of the scan in the range with the prefix, which stopped at the cursor
+static std::string scanIteratorKey(char scan_type, const std::string &range_prefix, const std::string &cursor) {
+  std::string key(1, scan_type);
+  PutFixed32(&key, static_cast<uint32_t>(range_prefix.size()));
+  key.append(range_prefix).append(cursor);
+  return key;
+}
+
 rocksdb::Status Database::Scan(const std::string &cursor, uint64_t limit, const std::string &prefix,
-                               std::vector<std::string> *keys, std::string *end_cursor) {
+                               std::vector<std::string> *keys, std::string *end_cursor,
+                               const Util::GlobPattern *pattern, RedisType type) {
   end_cursor->clear();
+  // The number of the scanned keys, which may be more than the returned keys if they're filtered,
+  // and the cursor is the last scanned key, so the scan with a rarely matched pattern wouldn't stall the server
   uint64_t cnt = 0;
   uint16_t slot_id = 0, slot_start = 0;
   std::string ns_prefix, ns_cursor, ns, user_key, value, index_key;
 
-  LatestSnapShot ss(db_);
-  rocksdb::ReadOptions read_options;
-  read_options.snapshot = ss.GetSnapShot();
-  read_options.fill_cache = false;
-  auto iter = DBUtil::UniqueIterator(db_, read_options, metadata_cf_handle_);
-
   AppendNamespacePrefix(cursor, &ns_cursor);
   if (storage_->IsSlotIdEncoded()) {
     slot_start = cursor.empty() ? 0 : GetSlotNumFromKey(cursor);
@@ -250,7 +576,28 @@ rocksdb::Status Database::Scan(const std::string &cursor, uint64_t limit, const
     AppendNamespacePrefix(prefix, &ns_prefix);
   }
 
-  if (!cursor.empty()) {
+  // The scan seeks to the prefix in every slot if the slot id is encoded, only the scans of one range are resumed
+  size_t cache_size = !storage_->IsSlotIdEncoded() || prefix.empty() ? scanIteratorCacheSize(storage_) : 0;
+  auto cache = storage_->GetScanIteratorCache();
+  std::unique_ptr<PinnedIterator> pinned;
+  if (cache_size > 0 && !cursor.empty()) pinned = cache->Take(scanIteratorKey('k', ns_prefix, cursor));
+  bool resumed = pinned != nullptr;
+  if (!resumed) {
+    rocksdb::ReadOptions read_options;
+    storage_->SetLongScanReadOptions(&read_options);
+    read_options.fill_cache = false;
+    pinned = std::make_unique<PinnedIterator>();
+    // The prefix is changed for every slot if the slot id is encoded, so the bound only works without it
+    pinned->upper_bound_key = storage_->IsSlotIdEncoded() ? std::string() : prefixUpperBound(ns_prefix);
+    pinned->upper_bound = pinned->upper_bound_key;
+    if (!pinned->upper_bound_key.empty()) read_options.iterate_upper_bound = &pinned->upper_bound;
+    pinned->iter.reset(storage_->NewIterator(read_options, metadata_cf_handle_));
+  }
+  rocksdb::Iterator *iter = pinned->iter.get();
+
+  if (resumed) {
+    // the iterator was left after the cursor
+  } else if (!cursor.empty()) {
     iter->Seek(ns_cursor);
     if (iter->Valid()) {
       iter->Next();
@@ -267,19 +614,29 @@ rocksdb::Status Database::Scan(const std::string &cursor, uint64_t limit, const
       if (!ns_prefix.empty() && !iter->key().starts_with(ns_prefix)) {
         break;
       }
+      // The type is in the flags, so the keys of other types are skipped without decoding the metadata
+      if (type != kRedisNone && !iter->value().empty() && static_cast<RedisType>(iter->value()[0] & 0x0f) != type) {
+        ExtractNamespaceKey(iter->key(), &ns, &user_key, storage_->IsSlotIdEncoded());
+        cnt++;
+        continue;
+      }
       Metadata metadata(kRedisNone, false);
       value = iter->value().ToString();
       metadata.Decode(value);
       if (metadata.Expired()) continue;
       ExtractNamespaceKey(iter->key(), &ns, &user_key, storage_->IsSlotIdEncoded());
-      keys->emplace_back(user_key);
       cnt++;
+      if (pattern && !pattern->Match(user_key)) continue;
+      keys->emplace_back(user_key);
     }
 
     if (!storage_->IsSlotIdEncoded() || prefix.empty()) {
-      if (!keys->empty()) {
+      if (cnt > 0) {
         end_cursor->append(user_key);
       }
+      if (cache_size > 0 && cnt >= limit) {
+        cache->Put(scanIteratorKey('k', ns_prefix, user_key), std::move(pinned), cache_size);
+      }
       break;
     }
 
@@ -293,11 +650,13 @@ rocksdb::Status Database::Scan(const std::string &cursor, uint64_t limit, const
     }
 
     if (slot_id > slot_start + HASH_SLOTS_MAX_ITERATIONS) {
-      if (keys->empty()) {
+      if (cnt == 0) {
         if (iter->Valid()) {
           ExtractNamespaceKey(iter->key(), &ns, &user_key, storage_->IsSlotIdEncoded());
           auto res = std::mismatch(prefix.begin(), prefix.end(), user_key.begin());
-          if (res.first == prefix.end()) {
+          bool type_matched =
+              type == kRedisNone || (!iter->value().empty() && static_cast<RedisType>(iter->value()[0] & 0x0f) == type);
+          if (res.first == prefix.end() && type_matched && (!pattern || pattern->Match(user_key))) {
             keys->emplace_back(user_key);
           }
 
@@ -317,12 +676,91 @@ rocksdb::Status Database::Scan(const std::string &cursor, uint64_t limit, const
   return rocksdb::Status::OK();
 }
 
+// Return a random key in [lo, hi], the bytes after their common prefix are random
+static std::string randomKeyBetween(const std::string &lo, const std::string &hi, std::mt19937_64 *rng) {
+  size_t common = 0;
+  while (common < lo.size() && common < hi.size() && lo[common] == hi[common]) common++;
+  if (common >= hi.size()) return lo;
+
+  std::string key = hi.substr(0, common);
+  auto lo_byte = common < lo.size() ? static_cast<uint8_t>(lo[common]) : 0;
+  auto hi_byte = static_cast<uint8_t>(hi[common]);
+  key.push_back(static_cast<char>(std::uniform_int_distribution<int>(lo_byte, hi_byte)(*rng)));
+  std::uniform_int_distribution<int> byte_dist(0, 255);
+  for (int i = 0; i < 8; i++) key.push_back(static_cast<char>(byte_dist(*rng)));
+  // The key may be out of the range if its first random byte equals the bound's
+  if (key < lo) return lo;
+  if (key > hi) return hi;
+  return key;
+}
+
+rocksdb::Status Database::sampleRandomKey(std::string *key) {
+  static constexpr int kMaxScannedKeys = 128;
+
+  std::string ns_prefix;
+  ComposeNamespaceKey(namespace_, "", &ns_prefix, false);
+  std::string upper_bound_key = prefixUpperBound(ns_prefix);
+
+  // The keys are rarely uniform in the key space, so the point is picked in the SST files weighted by
+  // their sizes, the files are only listed from the version of the column family without I/O
+  rocksdb::ColumnFamilyMetaData cf_meta;
+  db_->GetColumnFamilyMetaData(storage_->RouteCFHandle(metadata_cf_handle_, ns_prefix), &cf_meta);
+  std::vector<std::pair<std::string, std::string>> ranges;
+  std::vector<double> weights;
+  for (const auto &level : cf_meta.levels) {
+    for (const auto &file : level.files) {
+      const auto &lo = std::max(file.smallestkey, ns_prefix);
+      const auto &hi = upper_bound_key.empty() ? file.largestkey : std::min(file.largestkey, upper_bound_key);
+      if (lo > hi) continue;
+      ranges.emplace_back(lo, hi);
+      weights.emplace_back(static_cast<double>(std::max<uint64_t>(file.size, 1)));
+    }
+  }
+  if (ranges.empty()) return rocksdb::Status::OK();
+
+  thread_local std::mt19937_64 rng(std::random_device{}());
+  std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+  const auto &[lo, hi] = ranges[pick(rng)];
+  std::string target = randomKeyBetween(lo, hi, &rng);
+
+  rocksdb::ReadOptions read_options;
+  rocksdb::Slice upper_bound(upper_bound_key);
+  if (!upper_bound_key.empty()) read_options.iterate_upper_bound = &upper_bound;
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, metadata_cf_handle_));
+  // Skip the expired keys in a bounded scan, which wraps around to the first key of the namespace
+  bool wrapped = false;
+  iter->Seek(target);
+  for (int scanned = 0; scanned < kMaxScannedKeys;) {
+    if (!iter->Valid()) {
+      if (!iter->status().ok()) return iter->status();
+      if (wrapped) break;
+      wrapped = true;
+      iter->Seek(ns_prefix);
+      continue;
+    }
+    scanned++;
+    Metadata metadata(kRedisNone, false);
+    metadata.Decode(iter->value().ToString());
+    if (!metadata.Expired() &&
+        (metadata.Type() == kRedisString || IsEmptyAllowed(metadata.Type()) || metadata.size > 0)) {
+      std::string ns;
+      ExtractNamespaceKey(iter->key(), &ns, key, storage_->IsSlotIdEncoded());
+      return rocksdb::Status::OK();
+    }
+    iter->Next();
+  }
+  return rocksdb::Status::OK();
+}
+
 rocksdb::Status Database::RandomKey(const std::string &cursor, std::string *key) {
   key->clear();
 
+  auto s = sampleRandomKey(key);
+  if (!s.ok() || !key->empty()) return s;
+
   std::string end_cursor;
   std::vector<std::string> keys;
-  auto s = Scan(cursor, 60, "", &keys, &end_cursor);
+  s = Scan(cursor, 60, "", &keys, &end_cursor);
   if (!s.ok()) {
     return s;
   }
@@ -341,6 +779,9 @@ rocksdb::Status Database::RandomKey(const std::string &cursor, std::string *key)
 }
 
 rocksdb::Status Database::FlushDB() {
+  // Drop the column families of the namespace rather than deleting the keys
+  if (storage_->HasNamespaceCFs(namespace_)) return storage_->ResetNamespaceCFs(namespace_);
+
   std::string prefix, begin_key, end_key;
   ComposeNamespaceKey(namespace_, "", &prefix, false);
   auto s = FindKeyRangeWithPrefix(prefix, std::string(), &begin_key, &end_key);
@@ -356,11 +797,14 @@ rocksdb::Status Database::FlushDB() {
 }
 
 rocksdb::Status Database::FlushAll() {
-  LatestSnapShot ss(db_);
+  for (const auto &ns : storage_->GetNamespacesWithCFs()) {
+    auto s = storage_->ResetNamespaceCFs(ns);
+    if (!s.ok()) return s;
+  }
+
   rocksdb::ReadOptions read_options;
-  read_options.snapshot = ss.GetSnapShot();
   read_options.fill_cache = false;
-  auto iter = DBUtil::UniqueIterator(db_, read_options, metadata_cf_handle_);
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, metadata_cf_handle_));
   iter->SeekToFirst();
   if (!iter->Valid()) {
     return rocksdb::Status::OK();
@@ -378,17 +822,194 @@ rocksdb::Status Database::FlushAll() {
   return rocksdb::Status::OK();
 }
 
+// The column families holding the subkeys of the type, they're all keyed by the InternalKey
+static std::vector<ColumnFamilyID> subKeyColumnFamilies(RedisType type) {
+  switch (type) {
+    case kRedisZSet:
+      return {kColumnFamilyIDDefault, kColumnFamilyIDZSetScore, kColumnFamilyIDZSetRank};
+    case kRedisStream:
+      return {kColumnFamilyIDStream};
+    default:
+      return {kColumnFamilyIDDefault};
+  }
+}
+
+rocksdb::Status Database::DumpKey(const Slice &user_key, std::string *payload, const rocksdb::Snapshot *snapshot) {
+  payload->clear();
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+
+  // The metadata and the subkeys must be read from the same snapshot
+  std::optional<LatestSnapShot> ss;
+  if (!snapshot) {
+    ss.emplace(db_);
+    snapshot = ss->GetSnapShot();
+  }
+  rocksdb::ReadOptions read_options;
+  read_options.snapshot = snapshot;
+  std::string bytes;
+  auto s = storage_->Get(read_options, metadata_cf_handle_, ns_key, &bytes);
+  if (!s.ok()) return s;
+  Metadata metadata(kRedisNone, false);
+  s = metadata.Decode(bytes);
+  if (!s.ok()) return s;
+  if (metadata.Expired()) return rocksdb::Status::NotFound(kErrMsgKeyExpired);
+
+  payload->append(kDumpMagic);
+  PutFixed8(payload, kDumpFormatVersion);
+  PutVarint32(payload, static_cast<uint32_t>(bytes.size()));
+  payload->append(bytes);
+
+  // The non-chunked strings have no subkeys
+  if (metadata.Type() != kRedisString || metadata.IsChunkedString()) {
+    std::string prefix, next_version_prefix;
+    InternalKey(ns_key, "", metadata.version, storage_->IsSlotIdEncoded()).Encode(&prefix);
+    InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix);
+    rocksdb::Slice upper_bound(next_version_prefix);
+    read_options.iterate_upper_bound = &upper_bound;
+    storage_->SetLongScanReadOptions(&read_options);
+    read_options.fill_cache = false;
+    for (auto cf_id : subKeyColumnFamilies(metadata.Type())) {
+      auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, (*storage_->GetCFHandles())[cf_id]));
+      for (iter->Seek(prefix); iter->Valid() && iter->key().starts_with(prefix); iter->Next()) {
+        PutFixed8(payload, static_cast<uint8_t>(cf_id));
+        PutVarint32(payload, static_cast<uint32_t>(iter->key().size() - prefix.size()));
+        payload->append(iter->key().data() + prefix.size(), iter->key().size() - prefix.size());
+        PutVarint32(payload, static_cast<uint32_t>(iter->value().size()));
+        payload->append(iter->value().data(), iter->value().size());
+      }
+      if (!iter->status().ok()) return iter->status();
+    }
+  }
+  PutFixed32(payload, rocksdb::crc32c::Mask(rocksdb::crc32c::Value(payload->data(), payload->size())));
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status Database::RestoreKey(const Slice &user_key, const std::string &payload, int expire, bool replace) {
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  rocksdb::WriteBatch batch;
+  Metadata old_metadata(kRedisNone, false);
+  bool exists = false;
+  auto s = restoreKey(ns_key, payload, expire, replace, &batch, &old_metadata, &exists);
+  if (!s.ok()) return s;
+  s = storage_->Write(storage_->DefaultWriteOptions(), &batch);
+  if (s.ok() && exists) storage_->GetKeyReclaimer()->Reclaim(ns_key, old_metadata);
+  return s;
+}
+
+rocksdb::Status Database::RestoreKey(const Slice &user_key, const std::string &payload, int expire, bool replace,
+                                     RestoreBatch *restore_batch) {
+  // Bound the memory of the batch and the time of writing it
+  constexpr size_t kMaxRestoreBatchBytes = 16 * MiB;
+
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+  // The key restored again should see the metadata written by the previous restore
+  if (restore_batch->ns_keys.count(ns_key) > 0) {
+    auto s = WriteRestoreBatch(restore_batch);
+    if (!s.ok()) return s;
+  }
+
+  // The writes of the invalid payload are rolled back, the batch keeps the other keys
+  restore_batch->batch.SetSavePoint();
+  Metadata old_metadata(kRedisNone, false);
+  bool exists = false;
+  auto s = restoreKey(ns_key, payload, expire, replace, &restore_batch->batch, &old_metadata, &exists);
+  if (!s.ok()) {
+    restore_batch->batch.RollbackToSavePoint();
+    return s;
+  }
+  restore_batch->batch.PopSavePoint();
+  if (exists) restore_batch->replaced.emplace_back(ns_key, old_metadata);
+  restore_batch->ns_keys.emplace(std::move(ns_key));
+  if (restore_batch->batch.GetDataSize() >= kMaxRestoreBatchBytes) return WriteRestoreBatch(restore_batch);
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status Database::WriteRestoreBatch(RestoreBatch *restore_batch) {
+  if (restore_batch->ns_keys.empty()) return rocksdb::Status::OK();
+  auto s = storage_->Write(storage_->DefaultWriteOptions(), &restore_batch->batch);
+  if (s.ok()) {
+    for (const auto &[ns_key, metadata] : restore_batch->replaced) {
+      storage_->GetKeyReclaimer()->Reclaim(ns_key, metadata);
+    }
+  } else if (restore_batch->write_status.ok()) {
+    restore_batch->write_status = s;
+  }
+  restore_batch->batch.Clear();
+  restore_batch->ns_keys.clear();
+  restore_batch->replaced.clear();
+  return s;
+}
+
+rocksdb::Status Database::restoreKey(const std::string &ns_key, const std::string &payload, int expire, bool replace,
+                                     rocksdb::WriteBatch *batch, Metadata *old_metadata, bool *exists) {
+  static const size_t kMagicSize = strlen(kDumpMagic);
+  if (payload.size() < kMagicSize + 1 + 4 || payload.compare(0, kMagicSize, kDumpMagic) != 0 ||
+      static_cast<uint8_t>(payload[kMagicSize]) != kDumpFormatVersion) {
+    return rocksdb::Status::Corruption("DUMP payload version or checksum are wrong");
+  }
+  uint32_t crc = DecodeFixed32(payload.data() + payload.size() - 4);
+  if (rocksdb::crc32c::Unmask(crc) != rocksdb::crc32c::Value(payload.data(), payload.size() - 4)) {
+    return rocksdb::Status::Corruption("DUMP payload version or checksum are wrong");
+  }
+
+  Slice input(payload.data() + kMagicSize + 1, payload.size() - kMagicSize - 1 - 4);
+  uint32_t len = 0;
+  if (!GetVarint32(&input, &len) || input.size() < len) return rocksdb::Status::Corruption("invalid DUMP payload");
+  std::string bytes(input.data(), len);
+  input.remove_prefix(len);
+  Metadata metadata(kRedisNone, false);
+  auto s = metadata.Decode(bytes);
+  if (!s.ok()) return s;
+
+  std::string old_bytes;
+  s = storage_->Get(rocksdb::ReadOptions(), metadata_cf_handle_, ns_key, &old_bytes);
+  if (!s.ok() && !s.IsNotFound()) return s;
+  *exists = s.ok() && old_metadata->Decode(old_bytes).ok() && !old_metadata->Expired();
+  if (*exists && !replace) return rocksdb::Status::Busy("Target key name already exists");
+
+  // The subkeys are written under a new version, so those of the replaced key are dead
+  Metadata new_version(kRedisNone, true);
+  std::string new_bytes;
+  s = Metadata::Rewrite(bytes, new_version.version, expire, &new_bytes);
+  if (!s.ok()) return s;
+
+  WriteBatchLogData log_data(metadata.Type());
+  batch->PutLogData(log_data.Encode());
+  SubKeyEncoder encoder(ns_key, new_version.version, storage_->IsSlotIdEncoded());
+  auto cf_ids = subKeyColumnFamilies(metadata.Type());
+  while (!input.empty()) {
+    uint8_t cf_id = 0;
+    uint32_t sub_key_len = 0, value_len = 0;
+    // The subkeys can only be restored into the column families of the type
+    if (!GetFixed8(&input, &cf_id) || std::find(cf_ids.begin(), cf_ids.end(), cf_id) == cf_ids.end() ||
+        !GetVarint32(&input, &sub_key_len) || input.size() < sub_key_len) {
+      return rocksdb::Status::Corruption("invalid DUMP payload");
+    }
+    Slice sub_key(input.data(), sub_key_len);
+    input.remove_prefix(sub_key_len);
+    if (!GetVarint32(&input, &value_len) || input.size() < value_len) {
+      return rocksdb::Status::Corruption("invalid DUMP payload");
+    }
+    batch->Put((*storage_->GetCFHandles())[cf_id], encoder.Encode(sub_key), Slice(input.data(), value_len));
+    input.remove_prefix(value_len);
+  }
+  batch->Put(metadata_cf_handle_, ns_key, new_bytes);
+  return rocksdb::Status::OK();
+}
+
 rocksdb::Status Database::Dump(const Slice &user_key, std::vector<std::string> *infos) {
   infos->clear();
 
   std::string ns_key;
   AppendNamespacePrefix(user_key, &ns_key);
 
-  LatestSnapShot ss(db_);
   rocksdb::ReadOptions read_options;
-  read_options.snapshot = ss.GetSnapShot();
   std::string value;
-  rocksdb::Status s = db_->Get(read_options, metadata_cf_handle_, ns_key, &value);
+  rocksdb::Status s = storage_->Get(read_options, metadata_cf_handle_, ns_key, &value);
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
 
   Metadata metadata(kRedisNone, false);
@@ -433,11 +1054,9 @@ rocksdb::Status Database::Type(const Slice &user_key, RedisType *type) {
   AppendNamespacePrefix(user_key, &ns_key);
 
   *type = kRedisNone;
-  LatestSnapShot ss(db_);
   rocksdb::ReadOptions read_options;
-  read_options.snapshot = ss.GetSnapShot();
   std::string value;
-  rocksdb::Status s = db_->Get(read_options, metadata_cf_handle_, ns_key, &value);
+  rocksdb::Status s = storage_->Get(read_options, metadata_cf_handle_, ns_key, &value);
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
 
   Metadata metadata(kRedisNone, false);
@@ -462,11 +1081,9 @@ rocksdb::Status Database::FindKeyRangeWithPrefix(const std::string &prefix, cons
   begin->clear();
   end->clear();
 
-  LatestSnapShot ss(storage_->GetDB());
   rocksdb::ReadOptions read_options;
-  read_options.snapshot = ss.GetSnapShot();
   read_options.fill_cache = false;
-  auto iter = DBUtil::UniqueIterator(storage_->GetDB(), read_options, cf_handle);
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, cf_handle));
   iter->Seek(prefix);
   if (!iter->Valid() || !iter->key().starts_with(prefix)) {
     return rocksdb::Status::NotFound();
@@ -511,6 +1128,22 @@ rocksdb::Status Database::ClearKeysOfSlot(const rocksdb::Slice &ns, int slot) {
   if (!s.ok()) {
     return s;
   }
+  // The files of the slot are cut off from the others, so most of its space is reclaimed at once
+  if (storage_->GetConfig()->RocksDB.partition_sst_by_slot) {
+    s = storage_->DeleteFilesInRange(prefix, prefix_end);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  return rocksdb::Status::OK();
+}
+
+// The range is deleted slot by slot, then the key counter can clear the keys of each slot
+rocksdb::Status Database::ClearKeysOfSlot(const rocksdb::Slice &ns, const SlotRange &slots) {
+  for (int slot = slots.start; slots.Contains(slot); slot++) {
+    auto s = ClearKeysOfSlot(ns, slot);
+    if (!s.ok()) return s;
+  }
   return rocksdb::Status::OK();
 }
 
@@ -521,7 +1154,7 @@ rocksdb::Status Database::GetSlotKeysInfo(int slot, std::map<int, uint64_t> *slo
   rocksdb::ReadOptions read_options;
   read_options.snapshot = snapshot;
   read_options.fill_cache = false;
-  auto iter = db_->NewIterator(read_options, metadata_cf_handle_);
+  auto iter = storage_->NewIterator(read_options, metadata_cf_handle_);
   bool end = false;
   for (int i = 0; i < HASH_SLOTS_SIZE; i++) {
     std::string prefix;
@@ -564,11 +1197,6 @@ rocksdb::Status SubKeyScanner::Scan(RedisType type, const Slice &user_key, const
   rocksdb::Status s = GetMetadata(type, ns_key, &metadata);
   if (!s.ok()) return s;
 
-  LatestSnapShot ss(db_);
-  rocksdb::ReadOptions read_options;
-  read_options.snapshot = ss.GetSnapShot();
-  read_options.fill_cache = false;
-  auto iter = DBUtil::UniqueIterator(db_, read_options);
   std::string match_prefix_key;
   if (!subkey_prefix.empty()) {
     InternalKey(ns_key, subkey_prefix, metadata.version, storage_->IsSlotIdEncoded()).Encode(&match_prefix_key);
@@ -576,13 +1204,29 @@ rocksdb::Status SubKeyScanner::Scan(RedisType type, const Slice &user_key, const
     InternalKey(ns_key, "", metadata.version, storage_->IsSlotIdEncoded()).Encode(&match_prefix_key);
   }
 
+  // The version is in the prefix, so the iterators of the deleted or recreated keys are never resumed
+  size_t cache_size = scanIteratorCacheSize(storage_);
+  auto cache = storage_->GetScanIteratorCache();
+  std::unique_ptr<PinnedIterator> pinned;
+  if (cache_size > 0 && !cursor.empty()) pinned = cache->Take(scanIteratorKey('s', match_prefix_key, cursor));
+  bool resumed = pinned != nullptr;
+  if (!resumed) {
+    rocksdb::ReadOptions read_options;
+    read_options.fill_cache = false;
+    pinned = std::make_unique<PinnedIterator>();
+    pinned->iter.reset(storage_->NewIterator(read_options));
+  }
+  rocksdb::Iterator *iter = pinned->iter.get();
+
   std::string start_key;
   if (!cursor.empty()) {
     InternalKey(ns_key, cursor, metadata.version, storage_->IsSlotIdEncoded()).Encode(&start_key);
   } else {
     start_key = match_prefix_key;
   }
-  for (iter->Seek(start_key); iter->Valid(); iter->Next()) {
+  // the resumed iterator was left at the cursor
+  resumed ? iter->Next() : iter->Seek(start_key);
+  for (; iter->Valid(); iter->Next()) {
     if (!cursor.empty() && iter->key() == start_key) {
       // if cursor is not empty, then we need to skip start_key
       // because we already return that key in the last scan
@@ -598,12 +1242,111 @@ rocksdb::Status SubKeyScanner::Scan(RedisType type, const Slice &user_key, const
     }
     cnt++;
     if (limit > 0 && cnt >= limit) {
+      if (cache_size > 0) {
+        cache->Put(scanIteratorKey('s', match_prefix_key, keys->back()), std::move(pinned), cache_size);
+      }
       break;
     }
   }
   return rocksdb::Status::OK();
 }
 
+rocksdb::Status SubKeyScanner::Sample(const Slice &ns_key, const Metadata &metadata, uint64_t count,
+                                      bool allow_duplicates, std::vector<std::string> *sub_keys,
+                                      std::vector<std::string> *values) {
+  // The retries of the random seeks which hit the picked sub keys, since the sub keys are rarely uniform
+  static constexpr uint64_t kMaxSeekRetries = 16;
+
+  sub_keys->clear();
+  if (values) values->clear();
+  if (metadata.size == 0 || count == 0) return rocksdb::Status::OK();
+
+  std::string prefix, next_version_prefix;
+  InternalKey(ns_key, "", metadata.version, storage_->IsSlotIdEncoded()).Encode(&prefix);
+  InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix);
+  rocksdb::ReadOptions read_options;
+  rocksdb::Slice upper_bound(next_version_prefix);
+  read_options.iterate_upper_bound = &upper_bound;
+  // All seeks of the same iterator read a consistent view of the collection
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options));
+  auto emplace = [&](size_t i) {
+    InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
+    if (i < sub_keys->size()) {
+      (*sub_keys)[i] = ikey.GetSubKey().ToString();
+      if (values) (*values)[i] = iter->value().ToString();
+      return;
+    }
+    sub_keys->emplace_back(ikey.GetSubKey().ToString());
+    if (values) values->emplace_back(iter->value().ToString());
+  };
+
+  std::mt19937_64 rng(std::random_device{}());
+  if (!allow_duplicates && count * 4 >= metadata.size) {
+    // Most of the collection would be picked, so it's sampled by one scan with the reservoir
+    uint64_t n = 0;
+    for (iter->Seek(prefix); iter->Valid(); iter->Next(), n++) {
+      if (n < count) {
+        emplace(n);
+        continue;
+      }
+      auto i = std::uniform_int_distribution<uint64_t>(0, n)(rng);
+      if (i < count) emplace(i);
+    }
+    return iter->status();
+  }
+
+  iter->Seek(prefix);
+  if (!iter->Valid()) return iter->status();
+  std::string first = iter->key().ToString();
+  iter->SeekToLast();
+  if (!iter->Valid()) return iter->status();
+  std::string last = iter->key().ToString();
+
+  std::set<std::string> picked;
+  uint64_t max_seeks = count + kMaxSeekRetries + (allow_duplicates ? 0 : count);
+  for (uint64_t seeks = 0; sub_keys->size() < count && seeks < max_seeks; seeks++) {
+    iter->Seek(randomKeyBetween(first, last, &rng));
+    if (!iter->Valid()) {
+      if (!iter->status().ok()) return iter->status();
+      continue;
+    }
+    if (!allow_duplicates && !picked.emplace(iter->key().ToString()).second) continue;
+    emplace(sub_keys->size());
+  }
+
+  // The rest of the distinct samples are taken by the scan from a random point, which wraps around once
+  bool wrapped = false;
+  iter->Seek(randomKeyBetween(first, last, &rng));
+  while (sub_keys->size() < count) {
+    if (!iter->Valid()) {
+      if (!iter->status().ok()) return iter->status();
+      if (wrapped) break;
+      wrapped = true;
+      iter->Seek(prefix);
+      continue;
+    }
+    if (allow_duplicates || picked.emplace(iter->key().ToString()).second) emplace(sub_keys->size());
+    iter->Next();
+  }
+  return rocksdb::Status::OK();
+}
+
+std::vector<size_t> SampleInlinedPositions(size_t size, uint64_t count, bool allow_duplicates) {
+  std::vector<size_t> positions;
+  if (size == 0) return positions;
+  std::mt19937_64 rng(std::random_device{}());
+  if (allow_duplicates) {
+    std::uniform_int_distribution<size_t> dist(0, size - 1);
+    for (uint64_t i = 0; i < count; i++) positions.emplace_back(dist(rng));
+    return positions;
+  }
+  positions.resize(size);
+  std::iota(positions.begin(), positions.end(), 0);
+  std::shuffle(positions.begin(), positions.end(), rng);
+  if (count < size) positions.resize(count);
+  return positions;
+}
+
 RedisType WriteBatchLogData::GetRedisType() { return type_; }
 
 std::vector<std::string> *WriteBatchLogData::GetArguments() { return &args_; }
@@ -628,4 +1371,42 @@ Status WriteBatchLogData::Decode(const rocksdb::Slice &blob) {
 
   return Status::OK();
 }
+
+ChunkedBatchWriter::ChunkedBatchWriter(Engine::Storage *storage, rocksdb::WriteBatch *batch,
+                                       WriteBatchLogData *log_data, uint64_t version)
+    : storage_(storage), batch_(batch), log_data_(log_data), version_(version) {
+  int chunk_mb = storage_->GetConfig()->write_batch_chunk_mb;
+  if (chunk_mb > 0 && !storage_->InTxn()) chunk_bytes_ = static_cast<size_t>(chunk_mb) * MiB;
+}
+
+ChunkedBatchWriter::~ChunkedBatchWriter() {
+  if (!registered_ || finished_) return;
+  // The written chunks become garbage without the metadata, so only the marker is deleted
+  rocksdb::WriteBatch batch;
+  storage_->RemoveWritingVersion(version_, &batch);
+  auto s = storage_->Write(storage_->DefaultWriteOptions(), &batch);
+  storage_->ReleaseWritingVersion(version_, s.ok());
+}
+
+rocksdb::Status ChunkedBatchWriter::WriteIfFull() {
+  if (chunk_bytes_ == 0 || batch_->GetDataSize() < chunk_bytes_) return rocksdb::Status::OK();
+  if (!registered_) {
+    storage_->AddWritingVersion(version_, batch_);
+    registered_ = true;
+  }
+  auto s = storage_->Write(storage_->DefaultWriteOptions(), batch_);
+  if (!s.ok()) return s;
+  batch_->Clear();
+  batch_->PutLogData(log_data_->Encode());
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status ChunkedBatchWriter::Write() {
+  if (registered_) storage_->RemoveWritingVersion(version_, batch_);
+  auto s = storage_->Write(storage_->DefaultWriteOptions(), batch_);
+  if (!s.ok() || !registered_) return s;
+  finished_ = true;
+  storage_->ReleaseWritingVersion(version_, true);
+  return s;
+}
 }  // namespace Redis
@@ -20,56 +20,163 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "cluster/redis_slot.h"
 #include "redis_metadata.h"
 #include "storage.h"
+#include "string_util.h"
+
+class TaskRunner;
 
 namespace Redis {
+
+// The payload of DUMP: the magic, the format version, the metadata value, the subkeys as the
+// column family ids, the subkeys without the prefix of the key and version, and their values,
+// then the masked crc32c of all above
+constexpr const char *kDumpMagic = "KVRD";
+constexpr uint8_t kDumpFormatVersion = 1;
+
+// Callback to consume the elements of a collection in bounded chunks, the `total` is
+// the number of elements which would be fed in all chunks, it's the same in every call.
+template <typename T>
+using ChunkCallback = std::function<void(uint64_t total, std::vector<T> *chunk)>;
+
+// The key which is going to be read, its sub keys are only prefetched if it's of the type
+struct PrefetchKey {
+  Slice user_key;
+  RedisType type = kRedisNone;
+  std::vector<Slice> sub_keys;
+};
+
+// The keys restored by the importing connection are written together, they aren't locked since
+// the importing slots aren't served yet, see Database::WriteRestoreBatch
+struct RestoreBatch {
+  rocksdb::WriteBatch batch;
+  std::set<std::string> ns_keys;
+  // The replaced keys are reclaimed after the batch is written
+  std::vector<std::pair<std::string, Metadata>> replaced;
+  // The first error of the writes, the keys restored before it are lost
+  rocksdb::Status write_status;
+};
+
 class Database {
  public:
   explicit Database(Engine::Storage *storage, const std::string &ns = "");
-  rocksdb::Status GetMetadata(RedisType type, const Slice &ns_key, Metadata *metadata);
-  rocksdb::Status GetRawMetadata(const Slice &ns_key, std::string *bytes);
+  rocksdb::Status GetMetadata(RedisType type, const Slice &ns_key, Metadata *metadata,
+                              const rocksdb::Snapshot *snapshot = nullptr);
+  rocksdb::Status GetRawMetadata(const Slice &ns_key, std::string *bytes, const rocksdb::Snapshot *snapshot = nullptr);
   rocksdb::Status GetRawMetadataByUserKey(const Slice &user_key, std::string *bytes);
   rocksdb::Status Expire(const Slice &user_key, int timestamp);
   rocksdb::Status Del(const Slice &user_key);
+  // Delete the keys in one batch under the same locks, the duplicated keys are deleted only once
+  rocksdb::Status MDel(const std::vector<Slice> &keys, uint64_t *deleted_cnt);
   rocksdb::Status Exists(const std::vector<Slice> &keys, int *ret);
+  // Warm up the reads of the keys ahead of the commands, e.g. a pipeline of GET and HGET:
+  // the metadata is read by one MultiGet and filled into the metadata cache, then the sub keys
+  // of the collections in the subkeys are read by another one, which brings their blocks into
+  // the block cache. The values aren't returned, the commands still read them by themselves.
+  void Prefetch(const std::vector<PrefetchKey> &keys);
   rocksdb::Status TTL(const Slice &user_key, int *ttl);
   rocksdb::Status Type(const Slice &user_key, RedisType *type);
   rocksdb::Status Dump(const Slice &user_key, std::vector<std::string> *infos);
   rocksdb::Status FlushDB();
   rocksdb::Status FlushAll();
   void GetKeyNumStats(const std::string &prefix, KeyNumStats *stats);
-  void Keys(const std::string &prefix, std::vector<std::string> *keys = nullptr, KeyNumStats *stats = nullptr);
+  // The keys are filtered by the pattern if it's not null, then the prefix should be its literal prefix
+  void Keys(const std::string &prefix, std::vector<std::string> *keys = nullptr, KeyNumStats *stats = nullptr,
+            const Util::GlobPattern *pattern = nullptr);
+  // KEYS by scanning the partitions of the namespace in parallel on the runner, the keys are returned in the
+  // same order as Keys. It falls back to Keys if the slot id is encoded and the prefix isn't empty, since
+  // Keys seeks to the prefix in every slot rather than scanning the whole namespace, or if the caller is in a
+  // transaction or has pinned a snapshot, which the runner threads don't see.
+  void ParallelKeys(const std::string &prefix, std::vector<std::string> *keys, const Util::GlobPattern *pattern,
+                    TaskRunner *runner, size_t parallelism);
+  // The range of the metadata keys of the namespace, or of its keys with the prefix if the slot id isn't encoded
+  void KeyRange(const std::string &prefix, std::string *begin, std::string *end);
+  // Split [begin, end) of the metadata keys at the smallest keys of the SST files into at most n partitions
+  // of about the same size, the boundaries between the partitions are returned in order
+  std::vector<std::string> PartitionKeyRange(const std::string &begin, const std::string &end, size_t n);
+  // Scan the live keys in [begin, end) of the metadata keys, the user keys with the prefix and matching the
+  // pattern are returned. At most limit keys are scanned if it's not 0, then next is the key to resume from,
+  // or empty if the range was used up.
+  rocksdb::Status ScanKeyRange(const std::string &begin, const std::string &end, uint64_t limit,
+                               const std::string &prefix, const Util::GlobPattern *pattern, RedisType type,
+                               std::vector<std::string> *keys, std::string *next = nullptr);
+  // Only the keys of the type are returned unless the type is kRedisNone
   rocksdb::Status Scan(const std::string &cursor, uint64_t limit, const std::string &prefix,
-                       std::vector<std::string> *keys, std::string *end_cursor = nullptr);
+                       std::vector<std::string> *keys, std::string *end_cursor = nullptr,
+                       const Util::GlobPattern *pattern = nullptr, RedisType type = kRedisNone);
+  // Sample a live key at a random point of the namespace, the scan from the cursor is the fallback
+  // if no live key was found near the point, e.g. all keys are still in the memtables
   rocksdb::Status RandomKey(const std::string &cursor, std::string *key);
+  // DUMP, serialize the metadata and the subkeys of the key with a checksum, it reads from the
+  // snapshot if it's given. The payload is only understood by RestoreKey, see kDumpMagic.
+  rocksdb::Status DumpKey(const Slice &user_key, std::string *payload, const rocksdb::Snapshot *snapshot = nullptr);
+  // RESTORE, write the dumped key in one batch with a new version and the expire (0 means no expire).
+  // Return Busy if the key exists and replace isn't set, or Corruption if the payload is invalid.
+  rocksdb::Status RestoreKey(const Slice &user_key, const std::string &payload, int expire, bool replace);
+  // Put the restored key into the batch without locking it, the batch is written once it's large
+  // enough or the key was already put into it, or by WriteRestoreBatch at the end
+  rocksdb::Status RestoreKey(const Slice &user_key, const std::string &payload, int expire, bool replace,
+                             RestoreBatch *restore_batch);
+  rocksdb::Status WriteRestoreBatch(RestoreBatch *restore_batch);
   void AppendNamespacePrefix(const Slice &user_key, std::string *output);
   rocksdb::Status FindKeyRangeWithPrefix(const std::string &prefix, const std::string &prefix_end, std::string *begin,
                                          std::string *end, rocksdb::ColumnFamilyHandle *cf_handle = nullptr);
   rocksdb::Status ClearKeysOfSlot(const rocksdb::Slice &ns, int slot);
+  rocksdb::Status ClearKeysOfSlot(const rocksdb::Slice &ns, const SlotRange &slots);
   rocksdb::Status GetSlotKeysInfo(int slot, std::map<int, uint64_t> *slotskeys, std::vector<std::string> *keys,
                                   int count);
 
  protected:
+  // Read the sub keys of the collection by a batched MultiGet, which lets RocksDB coalesce
+  // the lookups and I/O, the values and statuses are in the same order as the sub keys.
+  // It reads from the given snapshot, or from the latest one if it's null.
+  void multiGetSubKeys(const Slice &ns_key, uint64_t version, const std::vector<Slice> &sub_keys,
+                       std::vector<rocksdb::PinnableSlice> *values, std::vector<rocksdb::Status> *statuses,
+                       const rocksdb::Snapshot *snapshot = nullptr);
+  // Lock the destination exclusively and the sources in the shared mode, so that the sources are
+  // unchanged until the result was stored, while the stores from the same sources don't serialize.
+  std::unique_ptr<ReentrantMultiLockGuard> lockStoreKeys(const Slice &dst, const std::vector<Slice> &sources);
+  // Read the metadata of the keys by a batched MultiGet, the expired keys are NotFound
+  void multiGetMetadata(const std::vector<std::string> &ns_keys, std::vector<rocksdb::PinnableSlice> *values,
+                        std::vector<rocksdb::Status> *statuses);
+  rocksdb::Status sampleRandomKey(std::string *key);
+  // Put the writes restoring the key into the batch, the key should have been locked if needed
+  rocksdb::Status restoreKey(const std::string &ns_key, const std::string &payload, int expire, bool replace,
+                             rocksdb::WriteBatch *batch, Metadata *old_metadata, bool *exists);
+
   Engine::Storage *storage_;
   rocksdb::DB *db_;
   rocksdb::ColumnFamilyHandle *metadata_cf_handle_;
   std::string namespace_;
 
+  // Taking the snapshot locks the DB mutex, so it's only used across the reads which should see
+  // the same version. A single Get, MultiGet or iterator reads a consistent view by itself.
   class LatestSnapShot {
    public:
-    explicit LatestSnapShot(rocksdb::DB *db) : db_(db) { snapshot_ = db_->GetSnapshot(); }
-    ~LatestSnapShot() { db_->ReleaseSnapshot(snapshot_); }
+    // Share the snapshot pinned by the current thread if any, see Storage::PinSnapshot
+    explicit LatestSnapShot(rocksdb::DB *db) : db_(db), snapshot_(Engine::Storage::GetPinnedSnapshot()) {
+      if (!snapshot_) {
+        snapshot_ = db_->GetSnapshot();
+        owned_ = true;
+      }
+    }
+    ~LatestSnapShot() {
+      if (owned_) db_->ReleaseSnapshot(snapshot_);
+    }
     const rocksdb::Snapshot *GetSnapShot() { return snapshot_; }
 
    private:
     rocksdb::DB *db_ = nullptr;
     const rocksdb::Snapshot *snapshot_ = nullptr;
+    bool owned_ = false;
   };
 };
 
@@ -79,8 +186,17 @@ class SubKeyScanner : public Redis::Database {
   rocksdb::Status Scan(RedisType type, const Slice &user_key, const std::string &cursor, uint64_t limit,
                        const std::string &subkey_prefix, std::vector<std::string> *keys,
                        std::vector<std::string> *values = nullptr);
+  // Sample count sub keys of the collection with the metadata, they're distinct unless allow_duplicates.
+  // The sub keys are found by seeking to the random points between the first and the last ones, so the
+  // cost is proportional to the count rather than the size, except that at most the whole collection
+  // is returned if the distinct count is close to its size. The order of the samples is arbitrary.
+  rocksdb::Status Sample(const Slice &ns_key, const Metadata &metadata, uint64_t count, bool allow_duplicates,
+                         std::vector<std::string> *sub_keys, std::vector<std::string> *values = nullptr);
 };
 
+// Pick count positions in the inlined collection of the size in the random order like SubKeyScanner::Sample
+std::vector<size_t> SampleInlinedPositions(size_t size, uint64_t count, bool allow_duplicates);
+
 class WriteBatchLogData {
  public:
   WriteBatchLogData() = default;
@@ -97,4 +213,31 @@ class WriteBatchLogData {
   std::vector<std::string> args_;
 };
 
+// Write the batch ahead once it's larger than write-batch-chunk-mb and restart it with the log data, so
+// that a huge key doesn't build a batch of GBs. It should only be used for the subkeys of a fresh version,
+// which are invisible until the metadata is written by the last batch, and it never writes in a transaction.
+// The version is registered in the storage with a marker written by the first chunk and deleted by the
+// last batch, so that the compaction filter of this server and the replicas doesn't drop the written
+// subkeys while their metadata isn't there. The last batch must be written by Write.
+class ChunkedBatchWriter {
+ public:
+  ChunkedBatchWriter(Engine::Storage *storage, rocksdb::WriteBatch *batch, WriteBatchLogData *log_data,
+                     uint64_t version);
+  ~ChunkedBatchWriter();
+  ChunkedBatchWriter(const ChunkedBatchWriter &) = delete;
+  ChunkedBatchWriter &operator=(const ChunkedBatchWriter &) = delete;
+
+  rocksdb::Status WriteIfFull();
+  rocksdb::Status Write();
+
+ private:
+  Engine::Storage *storage_;
+  rocksdb::WriteBatch *batch_;
+  WriteBatchLogData *log_data_;
+  uint64_t version_;
+  size_t chunk_bytes_ = 0;
+  bool registered_ = false;
+  bool finished_ = false;
+};
+
 }  // namespace Redis
@@ -23,18 +23,22 @@
 #include <rocksdb/env.h>
 #include <sys/time.h>
 
+#include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <cstdlib>
 #include <ctime>
 #include <vector>
 
 #include "cluster/redis_slot.h"
+#include "string_util.h"
 #include "time_util.h"
 
 // 52 bit for microseconds and 11 bit for counter
 const int VersionCounterBits = 11;
 
 static std::atomic<uint64_t> version_counter_ = {0};
+static std::atomic<bool> compact_encoding_ = {false};
 
 const char *kErrMsgWrongType = "WRONGTYPE Operation against a key holding the wrong kind of value";
 const char *kErrMsgKeyExpired = "the key was expired";
@@ -55,8 +59,6 @@ InternalKey::InternalKey(Slice input, bool slot_id_encoded) {
   input.remove_prefix(key_size);
   GetFixed64(&input, &version_);
   sub_key_ = Slice(input.data(), input.size());
-  buf_ = nullptr;
-  memset(prealloc_, '\0', sizeof(prealloc_));
 }
 
 InternalKey::InternalKey(Slice ns_key, Slice sub_key, uint64_t version, bool slot_id_encoded) {
@@ -71,12 +73,6 @@ InternalKey::InternalKey(Slice ns_key, Slice sub_key, uint64_t version, bool slo
   key_ = ns_key;
   sub_key_ = sub_key;
   version_ = version;
-  buf_ = nullptr;
-  memset(prealloc_, '\0', sizeof(prealloc_));
-}
-
-InternalKey::~InternalKey() {
-  if (buf_ != nullptr && buf_ != prealloc_) delete[] buf_;
 }
 
 Slice InternalKey::GetNamespace() const { return namespace_; }
@@ -87,35 +83,49 @@ Slice InternalKey::GetSubKey() const { return sub_key_; }
 
 uint64_t InternalKey::GetVersion() const { return version_; }
 
-void InternalKey::Encode(std::string *out) {
+void InternalKey::Encode(std::string *out) const {
   out->clear();
-  size_t pos = 0;
   size_t total = 1 + namespace_.size() + 4 + key_.size() + 8 + sub_key_.size();
   if (slot_id_encoded_) {
     total += 2;
   }
-  if (total < sizeof(prealloc_)) {
-    buf_ = prealloc_;
-  } else {
-    buf_ = new char[total];
-  }
-  EncodeFixed8(buf_ + pos, static_cast<uint8_t>(namespace_.size()));
-  pos += 1;
-  memcpy(buf_ + pos, namespace_.data(), namespace_.size());
-  pos += namespace_.size();
+  out->reserve(total);
+  PutFixed8(out, static_cast<uint8_t>(namespace_.size()));
+  out->append(namespace_.data(), namespace_.size());
   if (slot_id_encoded_) {
-    EncodeFixed16(buf_ + pos, slotid_);
-    pos += 2;
+    PutFixed16(out, slotid_);
+  }
+  PutFixed32(out, static_cast<uint32_t>(key_.size()));
+  out->append(key_.data(), key_.size());
+  PutFixed64(out, version_);
+  out->append(sub_key_.data(), sub_key_.size());
+}
+
+SubKeyEncoder::SubKeyEncoder(Slice ns_key, uint64_t version, bool slot_id_encoded) {
+  InternalKey(ns_key, "", version, slot_id_encoded).Encode(&buf_);
+  prefix_size_ = buf_.size();
+}
+
+Slice SubKeyEncoder::Encode(Slice sub_key) {
+  buf_.resize(prefix_size_);
+  buf_.append(sub_key.data(), sub_key.size());
+  return buf_;
+}
+
+void SubKeyEncoder::EncodeAll(const std::vector<Slice> &sub_keys, std::vector<Slice> *keys) {
+  size_t total = prefix_size_;
+  for (const auto &sub_key : sub_keys) total += prefix_size_ + sub_key.size();
+  buf_.resize(prefix_size_);
+  // Reserve the whole arena first, so the slices into it aren't invalidated by the appends
+  buf_.reserve(total);
+  keys->clear();
+  keys->reserve(sub_keys.size());
+  for (const auto &sub_key : sub_keys) {
+    size_t offset = buf_.size();
+    buf_.append(buf_.data(), prefix_size_);
+    buf_.append(sub_key.data(), sub_key.size());
+    keys->emplace_back(buf_.data() + offset, buf_.size() - offset);
   }
-  EncodeFixed32(buf_ + pos, static_cast<uint32_t>(key_.size()));
-  pos += 4;
-  memcpy(buf_ + pos, key_.data(), key_.size());
-  pos += key_.size();
-  EncodeFixed64(buf_ + pos, version_);
-  pos += 8;
-  memcpy(buf_ + pos, sub_key_.data(), sub_key_.size());
-  pos += sub_key_.size();
-  out->assign(buf_, pos);
 }
 
 bool InternalKey::operator==(const InternalKey &that) const {
@@ -140,6 +150,7 @@ void ExtractNamespaceKey(Slice ns_key, std::string *ns, std::string *key, bool s
 
 void ComposeNamespaceKey(const Slice &ns, const Slice &key, std::string *ns_key, bool slot_id_encoded) {
   ns_key->clear();
+  ns_key->reserve(1 + ns.size() + (slot_id_encoded ? 2 : 0) + key.size());
 
   PutFixed8(ns_key, static_cast<uint8_t>(ns.size()));
   ns_key->append(ns.data(), ns.size());
@@ -169,31 +180,89 @@ Metadata::Metadata(RedisType type, bool generate_version) {
   if (generate_version) version = generateVersion();
 }
 
-rocksdb::Status Metadata::Decode(const std::string &bytes) {
-  // flags(1byte) + expire (4byte)
-  if (bytes.size() < 5) {
-    return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+// The expire is zigzag encoded relative to the creation time in the compact encoding,
+// and 0 is kept for the keys without the expire
+static uint64_t EncodeRelativeExpire(int expire, uint64_t created_at) {
+  if (expire == 0) return 0;
+  int64_t delta = static_cast<int64_t>(expire) - static_cast<int64_t>(created_at);
+  return ((static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63)) + 1;
+}
+
+static int DecodeRelativeExpire(uint64_t encoded, uint64_t created_at) {
+  if (encoded == 0) return 0;
+  encoded--;
+  auto delta = static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+  return static_cast<int>(static_cast<int64_t>(created_at) + delta);
+}
+
+rocksdb::Status Metadata::decodeCommon(Slice *input) {
+  if (!GetFixed8(input, &flags)) return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+  if ((flags & kMetadataCompactEncoded) != 0) {
+    flags &= static_cast<uint8_t>(~kMetadataCompactEncoded);
+    uint64_t relative_expire = 0;
+    if (!GetFixed64(input, &version) || !GetVarint64(input, &relative_expire) || !GetVarint32(input, &size)) {
+      return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+    }
+    expire = DecodeRelativeExpire(relative_expire, static_cast<uint64_t>(Time().tv_sec));
+    return rocksdb::Status::OK();
   }
-  Slice input(bytes);
-  GetFixed8(&input, &flags);
-  GetFixed32(&input, reinterpret_cast<uint32_t *>(&expire));
-  if (Type() != kRedisString) {
-    if (input.size() < 12) return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
-    GetFixed64(&input, &version);
-    GetFixed32(&input, &size);
+  // flags(1byte) + expire (4byte)
+  if (input->size() < 4) return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+  GetFixed32(input, reinterpret_cast<uint32_t *>(&expire));
+  if (Type() != kRedisString || IsChunkedString()) {
+    if (input->size() < 12) return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+    GetFixed64(input, &version);
+    GetFixed32(input, &size);
   }
   return rocksdb::Status::OK();
 }
 
-void Metadata::Encode(std::string *dst) {
+rocksdb::Status Metadata::Decode(const std::string &bytes) {
+  Slice input(bytes);
+  return decodeCommon(&input);
+}
+
+void Metadata::Encode(std::string *dst) { encodeCommon(dst, useCompactEncoding()); }
+
+bool Metadata::useCompactEncoding() const {
+  return Type() != kRedisString && compact_encoding_.load(std::memory_order_relaxed);
+}
+
+bool Metadata::IsCompactEncoded(const Slice &bytes) {
+  return !bytes.empty() && (static_cast<uint8_t>(bytes[0]) & kMetadataCompactEncoded) != 0;
+}
+
+void Metadata::encodeCommon(std::string *dst, bool compact) {
+  if (compact) {
+    PutFixed8(dst, static_cast<uint8_t>(flags | kMetadataCompactEncoded));
+    PutFixed64(dst, version);
+    PutVarint64(dst, EncodeRelativeExpire(expire, static_cast<uint64_t>(Time().tv_sec)));
+    PutVarint32(dst, size);
+    return;
+  }
   PutFixed8(dst, flags);
   PutFixed32(dst, (uint32_t)expire);
-  if (Type() != kRedisString) {
+  if (Type() != kRedisString || IsChunkedString()) {
     PutFixed64(dst, version);
     PutFixed32(dst, size);
   }
 }
 
+rocksdb::Status Metadata::Rewrite(const std::string &bytes, uint64_t version, int expire, std::string *output) {
+  Metadata metadata(kRedisNone, false);
+  Slice input(bytes);
+  auto s = metadata.decodeCommon(&input);
+  if (!s.ok()) return s;
+  metadata.version = version;
+  metadata.expire = expire;
+  output->clear();
+  // The relative expire of the compact encoding is encoded against the creation time in the new version.
+  // The encoding of the header is kept, since the type specific fields may be encoded after it.
+  metadata.encodeCommon(output, IsCompactEncoded(bytes));
+  output->append(input.data(), input.size());
+  return rocksdb::Status::OK();
+}
+
 void Metadata::InitVersionCounter() {
   // use random position for initial counter to avoid conflicts,
   // when the slave was promoted as master and the system clock may backoff
@@ -201,6 +270,8 @@ void Metadata::InitVersionCounter() {
   version_counter_ = static_cast<uint64_t>(std::rand());
 }
 
+void Metadata::SetCompactEncoding(bool enabled) { compact_encoding_.store(enabled, std::memory_order_relaxed); }
+
 uint64_t Metadata::generateVersion() {
   uint64_t version = Util::GetTimeStampUS();
   uint64_t counter = version_counter_.fetch_add(1);
@@ -210,7 +281,7 @@ uint64_t Metadata::generateVersion() {
 bool Metadata::operator==(const Metadata &that) const {
   if (flags != that.flags) return false;
   if (expire != that.expire) return false;
-  if (Type() != kRedisString) {
+  if (Type() != kRedisString || IsChunkedString()) {
     if (size != that.size) return false;
     if (version != that.version) return false;
   }
@@ -239,7 +310,7 @@ timeval Metadata::Time() const {
 }
 
 bool Metadata::Expired() const {
-  if (Type() != kRedisString && Type() != kRedisStream && size == 0) {
+  if (Type() != kRedisString && !IsEmptyAllowed(Type()) && size == 0) {
     return true;
   }
 
@@ -251,92 +322,508 @@ bool Metadata::Expired() const {
   return expire < now;
 }
 
-ListMetadata::ListMetadata(bool generate_version) : Metadata(kRedisList, generate_version) {
-  head = UINT64_MAX / 2;
-  tail = head;
+static void PutSizedString(std::string *dst, const std::string &value) {
+  PutVarint32(dst, static_cast<uint32_t>(value.size()));
+  dst->append(value);
 }
 
-void ListMetadata::Encode(std::string *dst) {
+static bool GetSizedString(Slice *input, std::string *value) {
+  uint32_t len = 0;
+  if (!GetVarint32(input, &len) || input->size() < len) return false;
+  value->assign(input->data(), len);
+  input->remove_prefix(len);
+  return true;
+}
+
+size_t HashMetadata::InlineBytes() const {
+  size_t bytes = 0;
+  for (const auto &iter : fields) {
+    bytes += iter.first.size() + iter.second.size();
+  }
+  return bytes;
+}
+
+void HashMetadata::Encode(std::string *dst) {
   Metadata::Encode(dst);
-  PutFixed64(dst, head);
-  PutFixed64(dst, tail);
+  if (inlined) {
+    PutFixed8(dst, kHashEncodingInline);
+    PutVarint32(dst, static_cast<uint32_t>(fields.size()));
+    for (const auto &iter : fields) {
+      PutSizedString(dst, iter.first);
+      PutSizedString(dst, iter.second);
+    }
+  }
 }
 
-rocksdb::Status ListMetadata::Decode(const std::string &bytes) {
+// Consume the inline encoding tag and the number of the inlined elements which follow the common metadata
+static rocksdb::Status GetInlineInput(Slice *input, uint8_t expected_encoding, uint32_t *num_elements) {
+  uint8_t encoding = 0;
+  GetFixed8(input, &encoding);
+  if (encoding != expected_encoding) return rocksdb::Status::InvalidArgument("unknown metadata encoding");
+  if (!GetVarint32(input, num_elements)) return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status HashMetadata::Decode(const std::string &bytes) {
+  inlined = false;
+  fields.clear();
   Slice input(bytes);
-  GetFixed8(&input, &flags);
-  GetFixed32(&input, reinterpret_cast<uint32_t *>(&expire));
-  if (Type() != kRedisString) {
-    if (input.size() < 12) return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
-    GetFixed64(&input, &version);
-    GetFixed32(&input, &size);
+  auto s = decodeCommon(&input);
+  if (!s.ok() || Type() != kRedisHash || input.empty()) return s;
+
+  uint32_t num_fields = 0;
+  s = GetInlineInput(&input, kHashEncodingInline, &num_fields);
+  if (!s.ok()) return s;
+  for (uint32_t i = 0; i < num_fields; i++) {
+    std::string field, value;
+    if (!GetSizedString(&input, &field) || !GetSizedString(&input, &value)) {
+      return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+    }
+    fields.emplace(std::move(field), std::move(value));
   }
-  if (Type() == kRedisList) {
-    if (input.size() < 16) return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
-    GetFixed64(&input, &head);
-    GetFixed64(&input, &tail);
+  inlined = true;
+  return rocksdb::Status::OK();
+}
+
+size_t SetMetadata::InlineBytes() const {
+  size_t bytes = 0;
+  for (const auto &member : members) {
+    bytes += member.size();
+  }
+  return bytes;
+}
+
+void SetMetadata::Encode(std::string *dst) {
+  Metadata::Encode(dst);
+  if (inlined) {
+    PutFixed8(dst, kSetEncodingInline);
+    PutVarint32(dst, static_cast<uint32_t>(members.size()));
+    for (const auto &member : members) {
+      PutSizedString(dst, member);
+    }
   }
+}
+
+rocksdb::Status SetMetadata::Decode(const std::string &bytes) {
+  inlined = false;
+  members.clear();
+  Slice input(bytes);
+  auto s = decodeCommon(&input);
+  if (!s.ok() || Type() != kRedisSet || input.empty()) return s;
+
+  uint32_t num_members = 0;
+  s = GetInlineInput(&input, kSetEncodingInline, &num_members);
+  if (!s.ok()) return s;
+  for (uint32_t i = 0; i < num_members; i++) {
+    std::string member;
+    if (!GetSizedString(&input, &member)) return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+    members.emplace(std::move(member));
+  }
+  inlined = true;
   return rocksdb::Status::OK();
 }
 
-void StreamMetadata::Encode(std::string *dst) {
+size_t ZSetMetadata::InlineBytes() const {
+  size_t bytes = 0;
+  for (const auto &iter : members) {
+    bytes += iter.first.size() + sizeof(double);
+  }
+  return bytes;
+}
+
+void ZSetMetadata::Encode(std::string *dst) {
   Metadata::Encode(dst);
+  if (inlined) {
+    PutFixed8(dst, kZSetEncodingInline);
+    PutVarint32(dst, static_cast<uint32_t>(members.size()));
+    for (const auto &iter : members) {
+      PutSizedString(dst, iter.first);
+      PutDouble(dst, iter.second);
+    }
+  }
+}
+
+rocksdb::Status ZSetMetadata::Decode(const std::string &bytes) {
+  inlined = false;
+  members.clear();
+  Slice input(bytes);
+  auto s = decodeCommon(&input);
+  if (!s.ok() || Type() != kRedisZSet || input.empty()) return s;
+
+  uint32_t num_members = 0;
+  s = GetInlineInput(&input, kZSetEncodingInline, &num_members);
+  if (!s.ok()) return s;
+  for (uint32_t i = 0; i < num_members; i++) {
+    std::string member;
+    double score = 0;
+    if (!GetSizedString(&input, &member) || !GetDouble(&input, &score)) {
+      return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+    }
+    members.emplace(std::move(member), score);
+  }
+  inlined = true;
+  return rocksdb::Status::OK();
+}
 
-  PutFixed64(dst, last_generated_id.ms);
-  PutFixed64(dst, last_generated_id.seq);
+bool DecodeInlineElements(const std::string &bytes, std::vector<std::string> *elements) {
+  elements->clear();
+  Metadata metadata(kRedisNone, false);
+  metadata.Decode(bytes);
+  switch (metadata.Type()) {
+    case kRedisHash: {
+      HashMetadata hash_metadata(false);
+      hash_metadata.Decode(bytes);
+      if (!hash_metadata.inlined) return false;
+      for (const auto &iter : hash_metadata.fields) {
+        elements->emplace_back(iter.first);
+        elements->emplace_back(iter.second);
+      }
+      return true;
+    }
+    case kRedisSet: {
+      SetMetadata set_metadata(false);
+      set_metadata.Decode(bytes);
+      if (!set_metadata.inlined) return false;
+      elements->assign(set_metadata.members.begin(), set_metadata.members.end());
+      return true;
+    }
+    case kRedisZSet: {
+      ZSetMetadata zset_metadata(false);
+      zset_metadata.Decode(bytes);
+      if (!zset_metadata.inlined) return false;
+      for (const auto &iter : zset_metadata.members) {
+        elements->emplace_back(Util::Float2String(iter.second));
+        elements->emplace_back(iter.first);
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
 
-  PutFixed64(dst, recorded_first_entry_id.ms);
-  PutFixed64(dst, recorded_first_entry_id.seq);
+void BitmapMetadata::Encode(std::string *dst) {
+  Metadata::Encode(dst);
+  uint8_t encoding = 0;
+  if (containers) encoding |= kBitmapEncodingContainers;
+  if (has_bit_count) encoding |= kBitmapEncodingBitCount;
+  if (encoding == 0) return;
+  PutFixed8(dst, encoding);
+  if (has_bit_count) PutFixed64(dst, bit_count);
+}
 
-  PutFixed64(dst, max_deleted_entry_id.ms);
-  PutFixed64(dst, max_deleted_entry_id.seq);
+rocksdb::Status BitmapMetadata::Decode(const std::string &bytes) {
+  containers = false;
+  has_bit_count = false;
+  bit_count = 0;
+  Slice input(bytes);
+  auto s = decodeCommon(&input);
+  if (!s.ok() || Type() != kRedisBitmap || input.empty()) return s;
 
-  PutFixed64(dst, first_entry_id.ms);
-  PutFixed64(dst, first_entry_id.seq);
+  uint8_t encoding = 0;
+  GetFixed8(&input, &encoding);
+  if (encoding == 0 || (encoding & ~(kBitmapEncodingContainers | kBitmapEncodingBitCount)) != 0) {
+    return rocksdb::Status::InvalidArgument("unknown metadata encoding");
+  }
+  containers = (encoding & kBitmapEncodingContainers) != 0;
+  if (encoding & kBitmapEncodingBitCount) {
+    if (!GetFixed64(&input, &bit_count)) return rocksdb::Status::InvalidArgument("invalid bitmap bit count");
+    has_bit_count = true;
+  }
+  return rocksdb::Status::OK();
+}
 
-  PutFixed64(dst, last_entry_id.ms);
-  PutFixed64(dst, last_entry_id.seq);
+void HyperLogLogMetadata::OnWrite() {
+  writes++;
+  cached_card = kHyperLogLogNoCachedCard;
+  union_signature = 0;
+  union_card = kHyperLogLogNoCachedCard;
+}
 
-  PutFixed64(dst, entries_added);
+void HyperLogLogMetadata::Encode(std::string *dst) {
+  Metadata::Encode(dst);
+  PutFixed64(dst, writes);
+  PutFixed64(dst, cached_card);
+  PutFixed64(dst, union_signature);
+  PutFixed64(dst, union_card);
 }
 
-rocksdb::Status StreamMetadata::Decode(const std::string &bytes) {
-  // flags(1byte) + expire (4byte)
-  if (bytes.size() < 5) {
+rocksdb::Status HyperLogLogMetadata::Decode(const std::string &bytes) {
+  writes = 0;
+  cached_card = kHyperLogLogNoCachedCard;
+  union_signature = 0;
+  union_card = kHyperLogLogNoCachedCard;
+  Slice input(bytes);
+  auto s = decodeCommon(&input);
+  if (!s.ok() || Type() != kRedisHyperLogLog) return s;
+
+  if (!GetFixed64(&input, &writes) || !GetFixed64(&input, &cached_card) || !GetFixed64(&input, &union_signature) ||
+      !GetFixed64(&input, &union_card)) {
     return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
   }
+  return rocksdb::Status::OK();
+}
+
+void BloomFilterMetadata::Reserve(uint64_t capacity, double error_rate) {
+  this->capacity = capacity;
+  this->error_rate = error_rate;
+  // The optimal bits per item is -ln(p) / ln(2)^2, and the optimal number of hashes is ln(2) times of it
+  double bits_per_item = -std::log(error_rate) / (M_LN2 * M_LN2);
+  uint64_t segment_bits = kBloomFilterSegmentBytes * 8;
+  bits = static_cast<uint64_t>(std::ceil(bits_per_item * static_cast<double>(capacity)));
+  bits = (bits + segment_bits - 1) / segment_bits * segment_bits;
+  hashes = static_cast<uint32_t>(std::max(1.0, std::ceil(M_LN2 * bits_per_item)));
+}
+
+void BloomFilterMetadata::Encode(std::string *dst) {
+  Metadata::Encode(dst);
+  PutFixed64(dst, capacity);
+  PutDouble(dst, error_rate);
+  PutFixed64(dst, bits);
+  PutFixed32(dst, hashes);
+}
 
+rocksdb::Status BloomFilterMetadata::Decode(const std::string &bytes) {
   Slice input(bytes);
-  GetFixed8(&input, &flags);
-  GetFixed32(&input, reinterpret_cast<uint32_t *>(&expire));
+  auto s = decodeCommon(&input);
+  if (!s.ok() || Type() != kRedisBloomFilter) return s;
 
-  if (input.size() < 12) {
+  if (!GetFixed64(&input, &capacity) || !GetDouble(&input, &error_rate) || !GetFixed64(&input, &bits) ||
+      !GetFixed32(&input, &hashes)) {
     return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
   }
+  return rocksdb::Status::OK();
+}
+
+void SortedintMetadata::Encode(std::string *dst) {
+  Metadata::Encode(dst);
+  if (blocks) PutFixed8(dst, kSortedintEncodingBlocks);
+}
 
-  GetFixed64(&input, &version);
-  GetFixed32(&input, &size);
+rocksdb::Status SortedintMetadata::Decode(const std::string &bytes) {
+  blocks = false;
+  Slice input(bytes);
+  auto s = decodeCommon(&input);
+  if (!s.ok() || Type() != kRedisSortedint || input.empty()) return s;
 
-  if (input.size() < 88) {
-    return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+  uint8_t encoding = 0;
+  GetFixed8(&input, &encoding);
+  if (encoding != kSortedintEncodingBlocks) return rocksdb::Status::InvalidArgument("unknown metadata encoding");
+  blocks = true;
+  return rocksdb::Status::OK();
+}
+
+ListMetadata::ListMetadata(bool generate_version) : Metadata(kRedisList, generate_version) {
+  head = UINT64_MAX / 2;
+  tail = head;
+}
+
+uint64_t ListMetadata::IndexOf(uint64_t pos) const {
+  if (!chunked) return head + pos;
+  for (const auto &chunk : chunks) {
+    if (pos < chunk.count) return chunk.base + pos;
+    pos -= chunk.count;
   }
+  return tail;
+}
 
-  GetFixed64(&input, &last_generated_id.ms);
-  GetFixed64(&input, &last_generated_id.seq);
+size_t ListMetadata::ChunkOf(uint64_t index) const {
+  auto iter = std::upper_bound(chunks.begin(), chunks.end(), index,
+                               [](uint64_t index, const ListChunk &chunk) { return index < chunk.base; });
+  return iter == chunks.begin() ? 0 : iter - chunks.begin() - 1;
+}
 
-  GetFixed64(&input, &recorded_first_entry_id.ms);
-  GetFixed64(&input, &recorded_first_entry_id.seq);
+uint64_t ListMetadata::PushIndex(bool left) {
+  size++;
+  if (!chunked) return left ? --head : tail++;
+
+  if (chunks.empty()) chunks.push_back(ListChunk{head, 0});
+  uint64_t index = 0;
+  if (left) {
+    if (chunks.front().count >= kListMaxChunkSize) {
+      chunks.insert(chunks.begin(), ListChunk{chunks.front().base - kListChunkGap, 0});
+    }
+    index = --chunks.front().base;
+    chunks.front().count++;
+  } else {
+    if (chunks.back().count >= kListMaxChunkSize) chunks.push_back(ListChunk{chunks.back().base + kListChunkGap, 0});
+    index = chunks.back().base + chunks.back().count++;
+  }
+  UpdateHeadTail();
+  return index;
+}
 
-  GetFixed64(&input, &max_deleted_entry_id.ms);
-  GetFixed64(&input, &max_deleted_entry_id.seq);
+uint64_t ListMetadata::PopIndex(bool left) {
+  size--;
+  if (!chunked) return left ? head++ : --tail;
 
-  GetFixed64(&input, &first_entry_id.ms);
-  GetFixed64(&input, &first_entry_id.seq);
+  uint64_t index = 0;
+  if (left) {
+    index = chunks.front().base++;
+    if (--chunks.front().count == 0) chunks.erase(chunks.begin());
+  } else {
+    index = chunks.back().base + --chunks.back().count;
+    if (chunks.back().count == 0) chunks.pop_back();
+  }
+  UpdateHeadTail();
+  return index;
+}
 
-  GetFixed64(&input, &last_entry_id.ms);
-  GetFixed64(&input, &last_entry_id.seq);
+void ListMetadata::UpdateHeadTail() {
+  if (!chunked || chunks.empty()) return;
+  head = chunks.front().base;
+  tail = chunks.back().base + chunks.back().count;
+}
 
-  GetFixed64(&input, &entries_added);
+void ListMetadata::Encode(std::string *dst) {
+  Metadata::Encode(dst);
+  PutFixed64(dst, head);
+  PutFixed64(dst, tail);
+  if (chunked) {
+    PutFixed32(dst, static_cast<uint32_t>(chunks.size()));
+    for (const auto &chunk : chunks) {
+      PutFixed64(dst, chunk.base);
+      PutFixed32(dst, chunk.count);
+    }
+  }
+}
 
+rocksdb::Status ListMetadata::Decode(const std::string &bytes) {
+  Slice input(bytes);
+  auto s = decodeCommon(&input);
+  if (!s.ok()) return s;
+  chunked = false;
+  chunks.clear();
+  if (Type() == kRedisList) {
+    if (input.size() < 16) return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+    GetFixed64(&input, &head);
+    GetFixed64(&input, &tail);
+    // The chunk directory follows if the list is in the chunked encoding
+    uint32_t num_chunks = 0;
+    if (GetFixed32(&input, &num_chunks)) {
+      if (input.size() < static_cast<size_t>(num_chunks) * 12) {
+        return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+      }
+      chunked = true;
+      chunks.resize(num_chunks);
+      for (auto &chunk : chunks) {
+        GetFixed64(&input, &chunk.base);
+        GetFixed32(&input, &chunk.count);
+      }
+    }
+  }
   return rocksdb::Status::OK();
 }
+
+void StreamMetadata::Encode(std::string *dst) {
+  // The entry ids and the counter are varints as well in the compact encoding
+  bool compact = useCompactEncoding();
+  encodeCommon(dst, compact);
+  auto put = [dst, compact](uint64_t value) { compact ? PutVarint64(dst, value) : PutFixed64(dst, value); };
+
+  put(last_generated_id.ms);
+  put(last_generated_id.seq);
+
+  put(recorded_first_entry_id.ms);
+  put(recorded_first_entry_id.seq);
+
+  put(max_deleted_entry_id.ms);
+  put(max_deleted_entry_id.seq);
+
+  put(first_entry_id.ms);
+  put(first_entry_id.seq);
+
+  put(last_entry_id.ms);
+  put(last_entry_id.seq);
+
+  put(entries_added);
+
+  if (schema_encoded) {
+    PutFixed8(dst, kStreamEncodingSchemas);
+    PutFixed64(dst, entry_schemas_since.ms);
+    PutFixed64(dst, entry_schemas_since.seq);
+    PutVarint32(dst, static_cast<uint32_t>(entry_schemas.size()));
+    for (const auto &schema : entry_schemas) {
+      PutVarint32(dst, static_cast<uint32_t>(schema.size()));
+      for (const auto &field : schema) {
+        PutSizedString(dst, field);
+      }
+    }
+  }
+  if (retention_ms > 0 || !retention_watermark.IsMinimum()) {
+    PutFixed8(dst, kStreamEncodingRetention);
+    PutFixed64(dst, retention_ms);
+    PutFixed64(dst, retention_watermark.ms);
+    PutFixed64(dst, retention_watermark.seq);
+  }
+}
+
+rocksdb::Status StreamMetadata::Decode(const std::string &bytes) {
+  schema_encoded = false;
+  entry_schemas.clear();
+  retention_ms = 0;
+  retention_watermark.Clear();
+  Slice input(bytes);
+  bool compact = IsCompactEncoded(input);
+  auto s = decodeCommon(&input);
+  if (!s.ok()) return s;
+
+  auto get = [&input, compact](uint64_t *value) {
+    return compact ? GetVarint64(&input, value) : GetFixed64(&input, value);
+  };
+  if (!get(&last_generated_id.ms) || !get(&last_generated_id.seq) || !get(&recorded_first_entry_id.ms) ||
+      !get(&recorded_first_entry_id.seq) || !get(&max_deleted_entry_id.ms) || !get(&max_deleted_entry_id.seq) ||
+      !get(&first_entry_id.ms) || !get(&first_entry_id.seq) || !get(&last_entry_id.ms) ||
+      !get(&last_entry_id.seq) || !get(&entries_added)) {
+    return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+  }
+
+  // the optional parts follow in the order of their encoding tags
+  uint8_t encoding = 0;
+  if (!GetFixed8(&input, &encoding)) return rocksdb::Status::OK();
+  if (encoding == kStreamEncodingSchemas) {
+    uint32_t num_schemas = 0;
+    if (!GetFixed64(&input, &entry_schemas_since.ms) || !GetFixed64(&input, &entry_schemas_since.seq) ||
+        !GetVarint32(&input, &num_schemas)) {
+      return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+    }
+    entry_schemas.resize(num_schemas);
+    for (auto &schema : entry_schemas) {
+      uint32_t num_fields = 0;
+      if (!GetVarint32(&input, &num_fields)) return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+      schema.resize(num_fields);
+      for (auto &field : schema) {
+        if (!GetSizedString(&input, &field)) return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+      }
+    }
+    schema_encoded = true;
+    if (!GetFixed8(&input, &encoding)) return rocksdb::Status::OK();
+  }
+  if (encoding == kStreamEncodingRetention) {
+    if (!GetFixed64(&input, &retention_ms) || !GetFixed64(&input, &retention_watermark.ms) ||
+        !GetFixed64(&input, &retention_watermark.seq)) {
+      return rocksdb::Status::InvalidArgument(kErrMetadataTooShort);
+    }
+    if (input.empty()) return rocksdb::Status::OK();
+  }
+  return rocksdb::Status::InvalidArgument("unknown metadata encoding");
+}
+
+uint32_t StreamMetadata::FindOrAddEntrySchema(const std::vector<std::string> &args, size_t max_schemas) {
+  if (args.empty() || args.size() % 2 != 0) return 0;
+
+  size_t bytes = 0;
+  std::vector<std::string> fields;
+  fields.reserve(args.size() / 2);
+  for (size_t i = 0; i < args.size(); i += 2) {
+    bytes += args[i].size();
+    fields.emplace_back(args[i]);
+  }
+  for (size_t i = 0; i < entry_schemas.size(); i++) {
+    if (entry_schemas[i] == fields) return static_cast<uint32_t>(i + 1);
+  }
+  // the schemas are rewritten with the metadata by every XADD, so the long field names are inlined
+  if (entry_schemas.size() >= max_schemas || bytes > kStreamSchemaMaxBytes) return 0;
+  entry_schemas.emplace_back(std::move(fields));
+  return static_cast<uint32_t>(entry_schemas.size());
+}
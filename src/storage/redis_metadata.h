@@ -23,6 +23,9 @@
 #include <rocksdb/status.h>
 
 #include <atomic>
+#include <cstdint>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -39,6 +42,8 @@ enum RedisType {
   kRedisBitmap,
   kRedisSortedint,
   kRedisStream,
+  kRedisHyperLogLog,
+  kRedisBloomFilter,
 };
 
 enum RedisCommand {
@@ -54,10 +59,23 @@ enum RedisCommand {
   kRedisCmdSetBit,
   kRedisCmdBitOp,
   kRedisCmdLMove,
+  kRedisCmdBitfield,
+  kRedisCmdSIAdd,
+  kRedisCmdSIRem,
+  kRedisCmdPFAdd,
+  kRedisCmdPFMerge,
+  kRedisCmdBFReserve,
+  kRedisCmdBFAdd,
 };
 
-const std::vector<std::string> RedisTypeNames = {"none", "string", "hash",      "list",  "set",
-                                                 "zset", "bitmap", "sortedint", "stream"};
+const std::vector<std::string> RedisTypeNames = {"none",   "string",      "hash",     "list",
+                                                 "set",    "zset",        "bitmap",   "sortedint",
+                                                 "stream", "hyperloglog", "MBbloom--"};
+
+// The stream, the HyperLogLog and the bloom filter still exist when they have no elements
+inline bool IsEmptyAllowed(RedisType type) {
+  return type == kRedisStream || type == kRedisHyperLogLog || type == kRedisBloomFilter;
+}
 
 extern const char *kErrMsgWrongType;
 extern const char *kErrMsgKeyExpired;
@@ -79,13 +97,13 @@ class InternalKey {
  public:
   explicit InternalKey(Slice ns_key, Slice sub_key, uint64_t version, bool slot_id_encoded);
   explicit InternalKey(Slice input, bool slot_id_encoded);
-  ~InternalKey();
 
   Slice GetNamespace() const;
   Slice GetKey() const;
   Slice GetSubKey() const;
   uint64_t GetVersion() const;
-  void Encode(std::string *out);
+  // Encode into the output directly, so the output which is reused doesn't allocate again
+  void Encode(std::string *out) const;
   bool operator==(const InternalKey &that) const;
 
  private:
@@ -93,12 +111,38 @@ class InternalKey {
   Slice key_;
   Slice sub_key_;
   uint64_t version_;
-  char *buf_;
-  char prealloc_[256];
-  uint16_t slotid_;
+  uint16_t slotid_ = 0;
   bool slot_id_encoded_;
 };
 
+// SubKeyEncoder encodes the prefix (the namespace, the key and the version) of the subkeys once,
+// then every subkey is encoded by appending it to the prefix in the reusable buffer of the encoder,
+// so encoding the subkeys in a loop doesn't allocate for each of them.
+class SubKeyEncoder {
+ public:
+  explicit SubKeyEncoder(Slice ns_key, uint64_t version, bool slot_id_encoded);
+
+  // The returned slice is valid until the next call of the encoder
+  Slice Encode(Slice sub_key);
+  // Encode all subkeys into the buffer like an arena, the slices are valid until the next call
+  void EncodeAll(const std::vector<Slice> &sub_keys, std::vector<Slice> *keys);
+  Slice Prefix() const { return {buf_.data(), prefix_size_}; }
+
+ private:
+  std::string buf_;
+  size_t prefix_size_;
+};
+
+// The flag of the string whose value is split into the chunks under the subkeys, the
+// metadata of the chunked string has the version and the size (its length) like other types
+constexpr uint8_t kMetadataStringChunked = 0x10;
+// The flag of the metadata in the compact encoding: the version (8byte) follows the flags, then
+// the expire relative to the creation time and the size as the varints, instead of the fixed
+// expire (4byte), version (8byte) and size (4byte). The strings always use the fixed encoding.
+constexpr uint8_t kMetadataCompactEncoded = 0x80;
+// The max size of the common fields in either encoding: flags, version, expire and size varints
+constexpr size_t kMetadataHeaderMaxSize = 1 + 8 + 10 + 5;
+
 class Metadata {
  public:
   uint8_t flags;
@@ -109,55 +153,229 @@ class Metadata {
  public:
   explicit Metadata(RedisType type, bool generate_version = true);
   static void InitVersionCounter();
+  // Encode the metadata of the non-string types in the compact encoding from now on,
+  // the metadata in both encodings can always be decoded
+  static void SetCompactEncoding(bool enabled);
 
   RedisType Type() const;
+  bool IsChunkedString() const { return Type() == kRedisString && (flags & kMetadataStringChunked) != 0; }
   virtual int32_t TTL() const;
   virtual timeval Time() const;
   virtual bool Expired() const;
   virtual void Encode(std::string *dst);
   virtual rocksdb::Status Decode(const std::string &bytes);
   bool operator==(const Metadata &that) const;
+  // Re-encode the metadata value with the version and the expire, the type specific fields
+  // are kept as they are. It's used by RESTORE to give the restored key a version of its own,
+  // and by EXPIRE to change the expire without decoding the type specific fields.
+  static rocksdb::Status Rewrite(const std::string &bytes, uint64_t version, int expire, std::string *output);
+  static bool IsCompactEncoded(const Slice &bytes);
+
+ protected:
+  // Decode the common fields and leave the input at the type specific fields
+  rocksdb::Status decodeCommon(Slice *input);
+  void encodeCommon(std::string *dst, bool compact);
+  bool useCompactEncoding() const;
 
  private:
   uint64_t generateVersion();
 };
 
+// The encoding tag of the small hash whose fields are stored in the metadata value
+constexpr uint8_t kHashEncodingInline = 1;
+
 class HashMetadata : public Metadata {
  public:
+  // The fields of the small hash are kept in the metadata value instead of the subkeys,
+  // so the point reads and writes of the hash only touch the metadata key.
+  bool inlined = false;
+  std::map<std::string, std::string> fields;
+
   explicit HashMetadata(bool generate_version = true) : Metadata(kRedisHash, generate_version) {}
+
+  // Return the total length of the inlined fields and values
+  size_t InlineBytes() const;
+
+ public:
+  void Encode(std::string *dst) override;
+  rocksdb::Status Decode(const std::string &bytes) override;
 };
 
+// The encoding tag of the small set whose members are stored in the metadata value
+constexpr uint8_t kSetEncodingInline = 1;
+
 class SetMetadata : public Metadata {
  public:
+  // The members of the small set are kept in the metadata value instead of the subkeys
+  bool inlined = false;
+  std::set<std::string> members;
+
   explicit SetMetadata(bool generate_version = true) : Metadata(kRedisSet, generate_version) {}
+
+  // Return the total length of the inlined members
+  size_t InlineBytes() const;
+
+ public:
+  void Encode(std::string *dst) override;
+  rocksdb::Status Decode(const std::string &bytes) override;
 };
 
+// The encoding tag of the small sorted set whose members are stored in the metadata value
+constexpr uint8_t kZSetEncodingInline = 1;
+
 class ZSetMetadata : public Metadata {
  public:
+  // The members and scores of the small sorted set are kept in the metadata value,
+  // instead of the subkeys and the score column family
+  bool inlined = false;
+  std::map<std::string, double> members;
+
   explicit ZSetMetadata(bool generate_version = true) : Metadata(kRedisZSet, generate_version) {}
+
+  // Return the total length of the inlined members and scores
+  size_t InlineBytes() const;
+
+ public:
+  void Encode(std::string *dst) override;
+  rocksdb::Status Decode(const std::string &bytes) override;
 };
 
+// Decode the elements of the inline hash, set or sorted set from its metadata value, as the
+// arguments of HSET, SADD or ZADD after the key. Return false if the key isn't inlined.
+bool DecodeInlineElements(const std::string &bytes, std::vector<std::string> *elements);
+
+// The encoding flags of the bitmap whose segments are stored as the containers, and whose
+// total number of the set bits is maintained in the metadata
+constexpr uint8_t kBitmapEncodingContainers = 1;
+constexpr uint8_t kBitmapEncodingBitCount = 2;
+
 class BitmapMetadata : public Metadata {
  public:
+  // Each segment of the bitmap is stored in the smallest of the bitset, array and run
+  // containers, instead of the raw bytes. It's decided when the bitmap is created.
+  bool containers = false;
+  // The number of the set bits is maintained by the writes of the bitmaps created since it's
+  // introduced, so the full range BITCOUNT needn't read the segments.
+  bool has_bit_count = false;
+  uint64_t bit_count = 0;
+
   explicit BitmapMetadata(bool generate_version = true) : Metadata(kRedisBitmap, generate_version) {}
+
+ public:
+  void Encode(std::string *dst) override;
+  rocksdb::Status Decode(const std::string &bytes) override;
 };
 
+// The encoding tag of the sortedint whose ids are packed into the blocks, and the maximum
+// number of ids in a block
+constexpr uint8_t kSortedintEncodingBlocks = 1;
+constexpr uint32_t kSortedintMaxBlockSize = 256;
+
 class SortedintMetadata : public Metadata {
  public:
+  // The sorted ids are packed into the blocks instead of a subkey per id, the subkey of a block
+  // is its smallest id. It's decided when the sortedint is created.
+  bool blocks = false;
+
   explicit SortedintMetadata(bool generate_version = true) : Metadata(kRedisSortedint, generate_version) {}
+
+ public:
+  void Encode(std::string *dst) override;
+  rocksdb::Status Decode(const std::string &bytes) override;
+};
+
+// The maximum number of elements in a chunk of the chunked list, and the distance
+// of the indexes between the adjacent chunks when they're created
+constexpr uint32_t kListMaxChunkSize = 1024;
+constexpr uint64_t kListChunkGap = 1ULL << 40;
+
+struct ListChunk {
+  uint64_t base;
+  uint32_t count;
 };
 
 class ListMetadata : public Metadata {
  public:
   uint64_t head;
   uint64_t tail;
+  // The elements of a chunked list are stored in the chunks, a chunk holds the elements at
+  // the contiguous indexes from its base, and there are gaps between the chunks, so inserting
+  // or removing in the middle of the list only rewrites the elements of one chunk.
+  bool chunked = false;
+  std::vector<ListChunk> chunks;
   explicit ListMetadata(bool generate_version = true);
 
+  // Return the index of the subkey which stores the element at the position of the list
+  uint64_t IndexOf(uint64_t pos) const;
+  // Return the chunk which contains the index
+  size_t ChunkOf(uint64_t index) const;
+  // Allocate the index for the element pushed into the head or tail
+  uint64_t PushIndex(bool left);
+  // Release the index of the element popped from the head or tail
+  uint64_t PopIndex(bool left);
+  void UpdateHeadTail();
+
  public:
   void Encode(std::string *dst) override;
   rocksdb::Status Decode(const std::string &bytes) override;
 };
 
+// The cached cardinality of the HyperLogLog is invalid
+constexpr uint64_t kHyperLogLogNoCachedCard = UINT64_MAX;
+
+class HyperLogLogMetadata : public Metadata {
+ public:
+  // The number of the writes which changed the registers, it tells whether the
+  // cached union cardinality of PFCOUNT with multiple keys is still valid
+  uint64_t writes = 0;
+  // The cardinality of this HyperLogLog, it's cleared on the next write
+  uint64_t cached_card = kHyperLogLogNoCachedCard;
+  // The cardinality of the union with the other keys whose versions and writes
+  // have the signature, it's cleared on the next write of this HyperLogLog
+  uint64_t union_signature = 0;
+  uint64_t union_card = kHyperLogLogNoCachedCard;
+
+  explicit HyperLogLogMetadata(bool generate_version = true) : Metadata(kRedisHyperLogLog, generate_version) {}
+
+  // Clear the cached cardinalities after the registers are changed
+  void OnWrite();
+
+ public:
+  void Encode(std::string *dst) override;
+  rocksdb::Status Decode(const std::string &bytes) override;
+};
+
+// The bits of the bloom filter are split into the segments of this size like the bitmap,
+// and the default error rate and capacity of the filter which is created by BF.ADD
+constexpr uint32_t kBloomFilterSegmentBytes = 1024;
+constexpr double kBloomFilterDefaultErrorRate = 0.01;
+constexpr uint64_t kBloomFilterDefaultCapacity = 100;
+
+class BloomFilterMetadata : public Metadata {
+ public:
+  // The size of the metadata is the number of the added items
+  uint64_t capacity = 0;
+  double error_rate = 0;
+  uint64_t bits = 0;
+  uint32_t hashes = 0;
+
+  explicit BloomFilterMetadata(bool generate_version = true) : Metadata(kRedisBloomFilter, generate_version) {}
+
+  // Decide the number of the bits and hashes by the capacity and the error rate
+  void Reserve(uint64_t capacity, double error_rate);
+
+ public:
+  void Encode(std::string *dst) override;
+  rocksdb::Status Decode(const std::string &bytes) override;
+};
+
+// The encoding tag of the stream whose entries refer to the field names in its schemas
+constexpr uint8_t kStreamEncodingSchemas = 1;
+// The encoding tag of the retention policy of the stream
+constexpr uint8_t kStreamEncodingRetention = 2;
+// The max total length of the field names of a schema
+constexpr size_t kStreamSchemaMaxBytes = 1024;
+
 class StreamMetadata : public Metadata {
  public:
   Redis::StreamEntryID last_generated_id;
@@ -167,8 +385,27 @@ class StreamMetadata : public Metadata {
   Redis::StreamEntryID last_entry_id;
   uint64_t entries_added = 0;
 
+  // The entries added since entry_schemas_since store only their values and the id of the schema
+  // which holds their field names, that is the index in entry_schemas plus one, or 0 if the field
+  // names are inlined. The older entries keep the raw field-value lists.
+  bool schema_encoded = false;
+  Redis::StreamEntryID entry_schemas_since;
+  std::vector<std::vector<std::string>> entry_schemas;
+
+  // The entries older than retention_ms are trimmed by XADD and XTRIM, which only advance the
+  // retention watermark and leave the entries below it to the compaction filter. The watermark
+  // is kept after the retention is turned off, since the trimmed entries may be still there.
+  uint64_t retention_ms = 0;
+  Redis::StreamEntryID retention_watermark;
+
   explicit StreamMetadata(bool generate_version = true) : Metadata(kRedisStream, generate_version) {}
 
+  bool IsSchemaEncoded(const Redis::StreamEntryID &id) const { return schema_encoded && entry_schemas_since <= id; }
+  bool IsRetentionTrimmed(const Redis::StreamEntryID &id) const { return id < retention_watermark; }
+  // Return the id of the schema of the field names of the entry, a new schema is added if there
+  // are less than max_schemas, or 0 if the field names should be inlined
+  uint32_t FindOrAddEntrySchema(const std::vector<std::string> &args, size_t max_schemas);
+
  public:
   void Encode(std::string *dst) override;
   rocksdb::Status Decode(const std::string &bytes) override;
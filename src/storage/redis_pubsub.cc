@@ -20,10 +20,19 @@
 
 #include "redis_pubsub.h"
 
+#include "server/server.h"
+
 namespace Redis {
 rocksdb::Status PubSub::Publish(const Slice &channel, const Slice &value) {
   rocksdb::WriteBatch batch;
   batch.Put(pubsub_cf_handle_, channel, value);
   return storage_->Write(storage_->DefaultWriteOptions(), &batch);
 }
+
+rocksdb::Status PubSub::PublishShard(const Slice &channel, const Slice &value) {
+  rocksdb::WriteBatch batch;
+  batch.PutLogData(ServerLogData(kShardPubSubLog, "").Encode());
+  batch.Put(pubsub_cf_handle_, channel, value);
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
 }  // namespace Redis
@@ -31,6 +31,8 @@ class PubSub : public Database {
  public:
   explicit PubSub(Engine::Storage *storage) : Database(storage), pubsub_cf_handle_(storage->GetCFHandle("pubsub")) {}
   rocksdb::Status Publish(const Slice &channel, const Slice &value);
+  // The message of the shard channel is tagged, so the replicas deliver it to the shard channel
+  rocksdb::Status PublishShard(const Slice &channel, const Slice &value);
 
  private:
   rocksdb::ColumnFamilyHandle *pubsub_cf_handle_;
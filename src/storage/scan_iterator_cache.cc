@@ -0,0 +1,86 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "scan_iterator_cache.h"
+
+#include <utility>
+#include <vector>
+
+#include "time_util.h"
+
+std::unique_ptr<PinnedIterator> ScanIteratorCache::Take(const std::string &scan_key) {
+  std::lock_guard<std::mutex> guard(mu_);
+  auto iter = entries_.find(scan_key);
+  if (iter == entries_.end()) {
+    misses_++;
+    return nullptr;
+  }
+  hits_++;
+  auto pinned = std::move(iter->second->iter);
+  lru_.erase(iter->second);
+  entries_.erase(iter);
+  return pinned;
+}
+
+void ScanIteratorCache::Put(const std::string &scan_key, std::unique_ptr<PinnedIterator> iter, size_t capacity) {
+  if (capacity == 0) return;
+  // the evicted iterators are destroyed out of the lock
+  std::vector<std::unique_ptr<PinnedIterator>> evicted;
+
+  std::lock_guard<std::mutex> guard(mu_);
+  if (auto found = entries_.find(scan_key); found != entries_.end()) {
+    // the scans which stopped at the same cursor read the same range, the latest one is kept
+    evicted.emplace_back(std::move(found->second->iter));
+    lru_.erase(found->second);
+    entries_.erase(found);
+  }
+  lru_.push_front(Entry{scan_key, Util::GetTimeStampMS(), std::move(iter)});
+  entries_[scan_key] = lru_.begin();
+  while (lru_.size() > capacity) {
+    evicted.emplace_back(std::move(lru_.back().iter));
+    entries_.erase(lru_.back().key);
+    lru_.pop_back();
+  }
+}
+
+void ScanIteratorCache::EvictIdle(uint64_t idle_ms) {
+  std::vector<std::unique_ptr<PinnedIterator>> evicted;
+  uint64_t now = Util::GetTimeStampMS();
+
+  std::lock_guard<std::mutex> guard(mu_);
+  while (!lru_.empty() && lru_.back().last_used_ms + idle_ms <= now) {
+    evicted.emplace_back(std::move(lru_.back().iter));
+    entries_.erase(lru_.back().key);
+    lru_.pop_back();
+  }
+}
+
+void ScanIteratorCache::Clear() {
+  std::list<Entry> evicted;
+
+  std::lock_guard<std::mutex> guard(mu_);
+  entries_.clear();
+  evicted.swap(lru_);
+}
+
+size_t ScanIteratorCache::Size() {
+  std::lock_guard<std::mutex> guard(mu_);
+  return lru_.size();
+}
@@ -0,0 +1,79 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <rocksdb/iterator.h>
+#include <rocksdb/slice.h>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// The iterator left at the cursor returned by a scan, and the upper bound which is referred
+// by the read options of the iterator, so it's never moved.
+struct PinnedIterator {
+  std::string upper_bound_key;
+  rocksdb::Slice upper_bound;
+  std::unique_ptr<rocksdb::Iterator> iter;
+};
+
+// ScanIteratorCache keeps the iterators of the unfinished scans by the scanned range and the cursor
+// they stopped at, so a scan continued from the returned cursor goes on with Next() instead of
+// seeking again, which rebuilds the merging iterator across all levels. The cursors stay stateless
+// and the scan seeks from the cursor as before if its iterator was evicted.
+//
+// A cached iterator keeps reading the view since the scan started, and it pins the memtables and
+// the SST files of the view, so the idle ones are released by the server cron.
+class ScanIteratorCache {
+ public:
+  ScanIteratorCache() = default;
+
+  ScanIteratorCache(const ScanIteratorCache &) = delete;
+  ScanIteratorCache &operator=(const ScanIteratorCache &) = delete;
+
+  // Take the iterator out of the cache, it's put back by the caller if the scan isn't finished,
+  // so an iterator is never used by two scans at the same time
+  std::unique_ptr<PinnedIterator> Take(const std::string &scan_key);
+  // Cache the iterator and evict the least recently used ones beyond the capacity
+  void Put(const std::string &scan_key, std::unique_ptr<PinnedIterator> iter, size_t capacity);
+  void EvictIdle(uint64_t idle_ms);
+  void Clear();
+
+  size_t Size();
+  uint64_t GetHits() const { return hits_; }
+  uint64_t GetMisses() const { return misses_; }
+
+ private:
+  struct Entry {
+    std::string key;
+    uint64_t last_used_ms = 0;
+    std::unique_ptr<PinnedIterator> iter;
+  };
+
+  std::mutex mu_;
+  std::list<Entry> lru_;  // the most recently used entry is at the front
+  std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+  std::atomic<uint64_t> hits_ = 0;
+  std::atomic<uint64_t> misses_ = 0;
+};
@@ -54,14 +54,23 @@
 
 #include <math.h>
 
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <memory>
 #include <string>
+#include <unordered_map>
 
 #include "commands/redis_cmd.h"
 #include "fmt/format.h"
 #include "rand.h"
 #include "server/redis_connection.h"
 #include "server/server.h"
+#include "scope_exit.h"
 #include "sha1.h"
+#include "storage/lock_manager.h"
+#include "storage/redis_metadata.h"
+#include "types/redis_string.h"
 
 /* The maximum number of characters needed to represent a long double
  * as a string (long double has a huge range).
@@ -76,20 +85,84 @@ enum {
 };
 
 namespace Lua {
+
+// The declared keys of the script running under the key locks on the current thread,
+// the commands of the script can only access these keys
+static thread_local const std::vector<std::string> *script_declared_keys = nullptr;
+
+// FunctionCache tracks the compiled scripts (the f_<sha> functions) of a Lua state in the LRU order,
+// the least recently used ones are removed from the state once the number exceeds the capacity.
+// It's kept in the registry of the state, so it's only accessed by the thread using the state.
+class FunctionCache {
+ public:
+  // Return false if the function wasn't compiled by createFunction
+  bool Touch(const std::string &funcname) {
+    auto iter = functions_.find(funcname);
+    if (iter == functions_.end()) return false;
+    lru_.splice(lru_.begin(), lru_, iter->second);
+    return true;
+  }
+
+  void Add(lua_State *lua, const std::string &funcname, size_t capacity) {
+    if (!Touch(funcname)) {
+      lru_.push_front(funcname);
+      functions_[funcname] = lru_.begin();
+    }
+    while (capacity > 0 && lru_.size() > capacity) {
+      removeFunction(lua, lru_.back());
+      functions_.erase(lru_.back());
+      lru_.pop_back();
+    }
+  }
+
+  void Clear(lua_State *lua) {
+    for (const auto &funcname : lru_) removeFunction(lua, funcname);
+    functions_.clear();
+    lru_.clear();
+  }
+
+  size_t Size() const { return lru_.size(); }
+
+ private:
+  static void removeFunction(lua_State *lua, const std::string &funcname) {
+    lua_pushnil(lua);
+    lua_setglobal(lua, funcname.c_str());
+  }
+
+  std::list<std::string> lru_;
+  std::unordered_map<std::string, std::list<std::string>::iterator> functions_;
+};
+
+static const char *kFunctionCacheRegistryKey = "__kvrocks_function_cache__";
+
+static FunctionCache *getFunctionCache(lua_State *lua) {
+  lua_getfield(lua, LUA_REGISTRYINDEX, kFunctionCacheRegistryKey);
+  auto cache = static_cast<FunctionCache *>(lua_touserdata(lua, -1));
+  lua_pop(lua, 1);
+  return cache;
+}
+
 lua_State *CreateState(bool read_only) {
   lua_State *lua = lua_open();
   loadLibraries(lua);
   removeUnsupportedFunctions(lua);
   loadFuncs(lua, read_only);
   enableGlobalsProtection(lua);
+  lua_pushlightuserdata(lua, new FunctionCache());
+  lua_setfield(lua, LUA_REGISTRYINDEX, kFunctionCacheRegistryKey);
   return lua;
 }
 
 void DestroyState(lua_State *lua) {
+  delete getFunctionCache(lua);
   lua_gc(lua, LUA_GCCOLLECT, 0);
   lua_close(lua);
 }
 
+void ClearFunctions(lua_State *lua) { getFunctionCache(lua)->Clear(lua); }
+
+size_t CachedFunctions(lua_State *lua) { return getFunctionCache(lua)->Size(); }
+
 void loadFuncs(lua_State *lua, bool read_only) {
   lua_newtable(lua);
 
@@ -103,6 +176,14 @@ void loadFuncs(lua_State *lua, bool read_only) {
   lua_pushcfunction(lua, redisPCallCommand);
   lua_settable(lua, -3);
 
+  /* redis.pipeline and its alias redis.batch */
+  lua_pushstring(lua, "pipeline");
+  lua_pushcfunction(lua, redisPipelineCommand);
+  lua_settable(lua, -3);
+  lua_pushstring(lua, "batch");
+  lua_pushcfunction(lua, redisPipelineCommand);
+  lua_settable(lua, -3);
+
   /* redis.log and log levels. */
   lua_pushstring(lua, "log");
   lua_pushcfunction(lua, redisLogCommand);
@@ -239,15 +320,29 @@ int redisLogCommand(lua_State *lua) {
   return 0;
 }
 
+bool RunsUnderKeyLocks(const Config *config, const std::vector<std::string> &args) {
+  if (!config->lua_strict_key_accessing || args.size() < 3) return false;
+  int64_t numkeys = 0;
+  auto s = Util::DecimalStringToNum(args[2], &numkeys);
+  return s.IsOK() && numkeys > 0 && numkeys <= int64_t(args.size() - 3);
+}
+
 Status evalGenericCommand(Redis::Connection *conn, const std::vector<std::string> &args, bool evalsha,
                           std::string *output, bool read_only) {
   int64_t numkeys = 0;
   char funcname[43];
   Server *srv = conn->GetServer();
   lua_State *lua = srv->Lua();
-  if (read_only) {
-    // Use the worker's private Lua VM when entering the read-only mode
-    lua = conn->Owner()->Lua();
+  bool key_locking = !read_only && RunsUnderKeyLocks(srv->GetConfig(), args);
+  if (read_only || key_locking) {
+    // Use the worker's private Lua VM when entering the read-only mode or running
+    // under the key locks, since the scripts are executed by the workers concurrently,
+    // or the VM of the thread if it's a read-only script thread
+    lua = read_only && Server::ReadOnlyScriptState() ? Server::ReadOnlyScriptState() : conn->Owner()->Lua();
+    lua_getglobal(lua, "redis");
+    lua_pushboolean(lua, read_only);
+    lua_setfield(lua, -2, "read_only");
+    lua_pop(lua, 1);
   }
 
   auto s = Util::DecimalStringToNum(args[2], &numkeys);
@@ -279,8 +374,12 @@ Status evalGenericCommand(Redis::Connection *conn, const std::vector<std::string
 
   /* Try to lookup the Lua function */
   lua_getglobal(lua, funcname);
-  if (lua_isnil(lua, -1)) {
+  if (!lua_isnil(lua, -1)) {
+    srv->stats_.IncrScriptCacheHits();
+    getFunctionCache(lua)->Touch(funcname);
+  } else {
     lua_pop(lua, 1); /* remove the nil from the stack */
+    srv->stats_.IncrScriptCacheMisses();
     std::string body;
     if (evalsha) {
       auto s = srv->ScriptGet(funcname + 2, &body);
@@ -292,7 +391,8 @@ Status evalGenericCommand(Redis::Connection *conn, const std::vector<std::string
       body = args[1];
     }
     std::string sha;
-    s = createFunction(srv, body, &sha, lua);
+    // The script of EVALSHA was stored already, it's only evicted from or not loaded into this state
+    s = createFunction(srv, body, &sha, lua, !evalsha);
     if (!s.IsOK()) {
       lua_pop(lua, 1); /* remove the error handler from the stack. */
       return s;
@@ -303,8 +403,33 @@ Status evalGenericCommand(Redis::Connection *conn, const std::vector<std::string
 
   /* Populate the argv and keys table accordingly to the arguments that
    * EVAL received. */
-  setGlobalArray(lua, "KEYS", std::vector<std::string>(args.begin() + 3, args.begin() + 3 + numkeys));
+  std::vector<std::string> keys(args.begin() + 3, args.begin() + 3 + numkeys);
+  setGlobalArray(lua, "KEYS", keys);
   setGlobalArray(lua, "ARGV", std::vector<std::string>(args.begin() + 3 + numkeys, args.end()));
+
+  // Lock the declared keys and buffer the writes of the script to apply them at once,
+  // the locks are held until the writes are applied
+  std::unique_ptr<ReentrantMultiLockGuard> key_guard;
+  bool in_txn = false;
+  if (key_locking) {
+    std::vector<std::string> lock_keys;
+    lock_keys.reserve(keys.size());
+    for (const auto &key : keys) {
+      std::string ns_key;
+      ComposeNamespaceKey(conn->GetNamespace(), key, &ns_key, srv->storage_->IsSlotIdEncoded());
+      lock_keys.emplace_back(std::move(ns_key));
+    }
+    key_guard = std::make_unique<ReentrantMultiLockGuard>(srv->storage_->GetLockManager(), lock_keys);
+    in_txn = srv->storage_->BeginTxn();
+    script_declared_keys = &keys;
+  }
+  auto reset_declared_keys = MakeScopeExit([] { script_declared_keys = nullptr; });
+  // All calls of the read-only script read the same snapshot
+  bool snapshot_pinned = read_only && srv->storage_->PinSnapshot();
+  auto unpin_snapshot = MakeScopeExit([srv, snapshot_pinned] {
+    if (snapshot_pinned) srv->storage_->UnpinSnapshot();
+  });
+
   int err = lua_pcall(lua, 0, 1, -2);
   if (err) {
     std::string msg = std::string("ERR running script (call to ") + funcname + "): " + lua_tostring(lua, -1);
@@ -314,6 +439,11 @@ Status evalGenericCommand(Redis::Connection *conn, const std::vector<std::string
     *output = replyToRedisReply(lua);
     lua_pop(lua, 1);
   }
+  // Like Redis, the writes before the error of the script aren't rolled back
+  if (in_txn) {
+    auto commit_status = srv->storage_->CommitTxn();
+    if (!commit_status.ok()) return {Status::NotOK, commit_status.ToString()};
+  }
 
   /* Call the Lua garbage collector from time to time to avoid a
    * full cycle performed by Lua, which adds too latency.
@@ -323,7 +453,7 @@ Status evalGenericCommand(Redis::Connection *conn, const std::vector<std::string
    * for every command uses too much CPU. */
   constexpr int64_t LUA_GC_CYCLE_PERIOD = 50;
   {
-    static int64_t gc_count = 0;
+    static thread_local int64_t gc_count = 0;
 
     gc_count++;
     if (gc_count == LUA_GC_CYCLE_PERIOD) {
@@ -331,110 +461,384 @@ Status evalGenericCommand(Redis::Connection *conn, const std::vector<std::string
       gc_count = 0;
     }
   }
+  Server::SampleReadOnlyScriptMemory();
   return Status::OK();
 }
 
+// LuaReplySink pushes the replies of redis.call onto the Lua stack as the Lua values directly,
+// the elements of an array are set into its table once they were pushed.
+class LuaReplySink : public Redis::ReplySink {
+ public:
+  explicit LuaReplySink(lua_State *lua) : lua_(lua), base_(lua_gettop(lua)) {}
+
+  void Integer(int64_t data) override {
+    lua_pushnumber(lua_, static_cast<lua_Number>(data));
+    onValuePushed();
+  }
+
+  void BulkString(const rocksdb::Slice &data) override {
+    lua_pushlstring(lua_, data.data(), data.size());
+    onValuePushed();
+  }
+
+  void NilString() override {
+    lua_pushboolean(lua_, 0);
+    onValuePushed();
+  }
+
+  void MultiLen(int64_t len) override {
+    if (len < 0) {
+      lua_pushboolean(lua_, 0);
+      onValuePushed();
+      return;
+    }
+    luaL_checkstack(lua_, 2, "too many nested arrays in the reply");
+    lua_createtable(lua_, static_cast<int>(std::min<int64_t>(len, kMaxPreallocatedElements)), 0);
+    if (len == 0) {
+      onValuePushed();
+      return;
+    }
+    arrays_.push_back({len, 1});
+  }
+
+  void Raw(const std::string &resp) override {
+    const char *p = resp.c_str(), *end = p + resp.size();
+    while (p < end) {
+      const char *next = redisProtocolToLuaType(lua_, p);
+      if (next == p) break;  // unknown reply type
+      p = next;
+      onValuePushed();
+    }
+  }
+
+  // The number of the complete values pushed onto the stack
+  int Pushed() const { return lua_gettop(lua_) - base_ - static_cast<int>(arrays_.size()); }
+
+ private:
+  void onValuePushed() {
+    while (!arrays_.empty()) {
+      auto &array = arrays_.back();
+      lua_rawseti(lua_, -2, array.next_index++);
+      if (--array.remaining > 0) return;
+      // The array was completed, it's the element of the outer array if any
+      arrays_.pop_back();
+    }
+  }
+
+  // Don't trust the announced length too much when preallocating the table
+  static constexpr int64_t kMaxPreallocatedElements = 1024;
+
+  struct PendingArray {
+    int64_t remaining;
+    int next_index;
+  };
+
+  lua_State *lua_;
+  int base_;
+  std::vector<PendingArray> arrays_;
+};
+
 int redisCallCommand(lua_State *lua) { return redisGenericCommand(lua, 1); }
 
 int redisPCallCommand(lua_State *lua) { return redisGenericCommand(lua, 0); }
-int redisGenericCommand(lua_State *lua, int raise_error) {
-  int j = 0, argc = lua_gettop(lua);
-  std::vector<std::string> args;
+
+static bool isReadOnlyScript(lua_State *lua) {
   lua_getglobal(lua, "redis");
   lua_getfield(lua, -1, "read_only");
   int read_only = lua_toboolean(lua, -1);
   lua_pop(lua, 2);
+  return read_only;
+}
 
-  if (argc == 0) {
-    pushError(lua, "Please specify at least one argument for redis.call()");
-    return raise_error ? raiseError(lua) : 1;
-  }
-  for (j = 0; j < argc; j++) {
-    if (lua_type(lua, j + 1) == LUA_TNUMBER) {
-      lua_Number num = lua_tonumber(lua, j + 1);
-      args.emplace_back(fmt::format("{:.17g}", static_cast<double>(num)));
-    } else {
-      size_t obj_len = 0;
-      const char *obj_s = lua_tolstring(lua, j + 1, &obj_len);
-      if (obj_s == nullptr) break; /* no a string */
-      args.emplace_back(obj_s, obj_len);
-    }
-  }
-  if (j != argc) {
-    pushError(lua, "Lua redis() command arguments must be strings or integers");
-    return raise_error ? raiseError(lua) : 1;
+// Append the Lua value at the index to the arguments of the command, only the strings and
+// the numbers are accepted
+static bool appendCommandArg(lua_State *lua, int index, std::vector<std::string> *args) {
+  if (lua_type(lua, index) == LUA_TNUMBER) {
+    lua_Number num = lua_tonumber(lua, index);
+    args->emplace_back(fmt::format("{:.17g}", static_cast<double>(num)));
+    return true;
   }
+  size_t obj_len = 0;
+  const char *obj_s = lua_tolstring(lua, index, &obj_len);
+  if (obj_s == nullptr) return false; /* no a string */
+  args->emplace_back(obj_s, obj_len);
+  return true;
+}
 
-  auto commands = Redis::GetCommands();
-  auto cmd_iter = commands->find(Util::ToLower(args[0]));
-  if (cmd_iter == commands->end()) {
-    pushError(lua, "Unknown Redis command called from Lua script");
-    return raise_error ? raiseError(lua) : 1;
+// Look up and parse the command called from the script, the error is set if the command
+// isn't allowed to run from the script
+static std::unique_ptr<Redis::Commander> prepareCommand(const std::vector<std::string> &args, bool read_only,
+                                                        std::string *err) {
+  int argc = static_cast<int>(args.size());
+  auto redisCmd = Redis::LookupCommand(args[0]);
+  if (!redisCmd) {
+    *err = "Unknown Redis command called from Lua script";
+    return nullptr;
   }
-  auto redisCmd = cmd_iter->second;
   if (read_only && redisCmd->is_write()) {
-    pushError(lua, "Write commands are not allowed from read-only scripts");
-    return raise_error ? raiseError(lua) : 1;
+    *err = "Write commands are not allowed from read-only scripts";
+    return nullptr;
   }
   auto cmd = redisCmd->factory();
   cmd->SetAttributes(redisCmd);
   cmd->SetArgs(args);
   int arity = cmd->GetAttributes()->arity;
   if (((arity > 0 && argc != arity) || (arity < 0 && argc < -arity))) {
-    pushError(lua, "Wrong number of args calling Redis command From Lua script");
-    return raise_error ? raiseError(lua) : 1;
+    *err = "Wrong number of args calling Redis command From Lua script";
+    return nullptr;
   }
   auto attributes = cmd->GetAttributes();
   if (attributes->flags & Redis::kCmdNoScript) {
-    pushError(lua, "This Redis command is not allowed from scripts");
-    return raise_error ? raiseError(lua) : 1;
+    *err = "This Redis command is not allowed from scripts";
+    return nullptr;
+  }
+  if (script_declared_keys) {
+    // The script runs under the locks of the declared keys only, the commands requiring
+    // the exclusivity or writing the keys not in their arguments can't be checked
+    std::vector<int> keys_indexes;
+    auto s = Redis::GetKeysFromCommand(attributes->name, argc, &keys_indexes);
+    if (!s.IsOK() && (attributes->is_write() || attributes->is_exclusive() || attributes->name == "config")) {
+      *err = "This Redis command is not allowed from scripts with strict key accessing";
+      return nullptr;
+    }
+    for (auto i : keys_indexes) {
+      if (i >= argc) break;
+      if (std::find(script_declared_keys->begin(), script_declared_keys->end(), args[i]) ==
+          script_declared_keys->end()) {
+        *err = "Script attempted to access a key that wasn't declared in KEYS";
+        return nullptr;
+      }
+    }
   }
 
-  std::string output, cmd_name = Util::ToLower(args[0]);
   Server *srv = GetServer();
   Config *config = srv->GetConfig();
   Redis::Connection *conn = srv->GetCurrentConnection();
   if (config->cluster_enabled) {
     auto s = srv->cluster_->CanExecByMySelf(attributes, args, conn);
     if (!s.IsOK()) {
-      pushError(lua, s.Msg().c_str());
-      return raise_error ? raiseError(lua) : 1;
+      *err = s.Msg();
+      return nullptr;
     }
   }
   if (config->slave_readonly && srv->IsSlave() && attributes->is_write()) {
-    pushError(lua, "READONLY You can't write against a read only slave.");
-    return raise_error ? raiseError(lua) : 1;
+    *err = "READONLY You can't write against a read only slave.";
+    return nullptr;
   }
+  std::string cmd_name = Util::ToLower(args[0]);
   if (!config->slave_serve_stale_data && srv->IsSlave() && cmd_name != "info" && cmd_name != "slaveof" &&
       srv->GetReplicationState() != kReplConnected) {
-    pushError(lua,
-              "MASTERDOWN Link with MASTER is down "
-              "and slave-serve-stale-data is set to 'no'.");
-    return raise_error ? raiseError(lua) : 1;
+    *err =
+        "MASTERDOWN Link with MASTER is down "
+        "and slave-serve-stale-data is set to 'no'.";
+    return nullptr;
   }
   auto s = cmd->Parse(args);
   if (!s.IsOK()) {
-    pushError(lua, s.Msg().data());
-    return raise_error ? raiseError(lua) : 1;
+    *err = s.Msg();
+    return nullptr;
   }
-  srv->stats_.IncrCalls(cmd_name);
+  return cmd;
+}
+
+// Execute the prepared command and push its reply onto the stack, or push the error and
+// return false if it failed
+static bool executeCommand(lua_State *lua, Redis::Commander *cmd, const std::vector<std::string> &args) {
+  std::string output, cmd_name = Util::ToLower(args[0]);
+  Server *srv = GetServer();
+  Redis::Connection *conn = srv->GetCurrentConnection();
+  auto attributes = cmd->GetAttributes();
+  srv->stats_.IncrCalls(attributes->id);
   auto start = std::chrono::high_resolution_clock::now();
   bool is_profiling = conn->isProfilingEnabled(cmd_name);
   auto end = std::chrono::high_resolution_clock::now();
-  s = cmd->Execute(GetServer(), srv->GetCurrentConnection(), &output);
+  if (attributes->is_write()) srv->UpdateWatchedKeysFromArgs(args, *attributes, conn->GetNamespace());
+  // The commands replying through the Reply* methods of the connection would push their replies
+  // onto the stack directly, the replies in RESP are parsed into the Lua values as the fallback.
+  int stack_base = lua_gettop(lua);
+  LuaReplySink reply_sink(lua);
+  auto prev_reply_sink = conn->GetReplySink();
+  conn->SetReplySink(&reply_sink);
+  auto s = cmd->Execute(srv, conn, &output);
+  conn->SetReplySink(prev_reply_sink);
   uint64_t duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
   if (is_profiling) conn->recordProfilingSampleIfNeed(cmd_name, duration);
   srv->SlowlogPushEntryIfNeeded(&args, duration);
-  srv->stats_.IncrLatency(static_cast<uint64_t>(duration), cmd_name);
+  srv->stats_.IncrLatency(static_cast<uint64_t>(duration), attributes->id);
   srv->FeedMonitorConns(conn, args);
   if (!s.IsOK()) {
+    lua_settop(lua, stack_base);
     pushError(lua, s.Msg().data());
+    return false;
+  }
+  if (attributes->is_write()) {
+    srv->InvalidateTrackedKeysFromArgs(conn, args, *attributes, conn->GetPendingInvalidations());
+  }
+  if (reply_sink.Pushed() == 0) reply_sink.Raw(output);
+  // Only the first reply would be returned if the command replied more than once
+  if (lua_gettop(lua) > stack_base + 1) lua_settop(lua, stack_base + 1);
+  if (lua_gettop(lua) == stack_base) lua_pushboolean(lua, 0);
+  return true;
+}
+
+int redisGenericCommand(lua_State *lua, int raise_error) {
+  int argc = lua_gettop(lua);
+  bool read_only = isReadOnlyScript(lua);
+
+  if (argc == 0) {
+    pushError(lua, "Please specify at least one argument for redis.call()");
     return raise_error ? raiseError(lua) : 1;
   }
-  redisProtocolToLuaType(lua, output.data());
+  std::vector<std::string> args;
+  for (int j = 1; j <= argc; j++) {
+    if (!appendCommandArg(lua, j, &args)) {
+      pushError(lua, "Lua redis() command arguments must be strings or integers");
+      return raise_error ? raiseError(lua) : 1;
+    }
+  }
+
+  std::string err;
+  auto cmd = prepareCommand(args, read_only, &err);
+  if (!cmd) {
+    pushError(lua, err.c_str());
+    return raise_error ? raiseError(lua) : 1;
+  }
+  if (!executeCommand(lua, cmd.get(), args)) return raise_error ? raiseError(lua) : 1;
   return 1;
 }
 
+// Read the values of the consecutive GETs from first to last by one MultiGet and set them into the
+// results table on the top of the stack, the ones which aren't strings are executed as GET alone,
+// e.g. the bitmaps are converted by GET
+static void executeGets(lua_State *lua, const std::vector<std::unique_ptr<Redis::Commander>> &cmds,
+                        const std::vector<std::vector<std::string>> &cmds_args, int first, int last) {
+  Server *srv = GetServer();
+  Redis::Connection *conn = srv->GetCurrentConnection();
+  std::vector<Slice> keys;
+  keys.reserve(last - first);
+  for (int i = first; i < last; i++) {
+    keys.emplace_back(cmds_args[i][1]);
+  }
+  std::vector<std::string> values;
+  Redis::String string_db(srv->storage_, conn->GetNamespace());
+  auto statuses = string_db.MGet(keys, &values);
+  for (int i = first; i < last; i++) {
+    const auto &s = statuses[i - first];
+    if (s.ok() || s.IsNotFound()) {
+      srv->stats_.IncrCalls(cmds[i]->GetAttributes()->id);
+      srv->FeedMonitorConns(conn, cmds_args[i]);
+      if (s.ok()) {
+        lua_pushlstring(lua, values[i - first].data(), values[i - first].size());
+      } else {
+        lua_pushboolean(lua, 0);
+      }
+    } else {
+      executeCommand(lua, cmds[i].get(), cmds_args[i]);
+    }
+    lua_rawseti(lua, -2, i + 1);
+  }
+}
+
+// Execute the commands of redis.pipeline and push the table of their results, the error is set
+// if the commands can't be executed
+static bool executePipeline(lua_State *lua, std::string *err) {
+  if (lua_gettop(lua) != 1 || !lua_istable(lua, 1)) {
+    *err = "Please specify a table of commands for redis.pipeline()";
+    return false;
+  }
+  bool read_only = isReadOnlyScript(lua);
+
+  int num_cmds = static_cast<int>(lua_objlen(lua, 1));
+  std::vector<std::vector<std::string>> cmds_args(num_cmds);
+  for (int i = 0; i < num_cmds; i++) {
+    lua_rawgeti(lua, 1, i + 1);
+    bool valid = lua_istable(lua, -1) && lua_objlen(lua, -1) > 0;
+    int argc = valid ? static_cast<int>(lua_objlen(lua, -1)) : 0;
+    for (int j = 1; valid && j <= argc; j++) {
+      lua_rawgeti(lua, -1, j);
+      valid = appendCommandArg(lua, -1, &cmds_args[i]);
+      lua_pop(lua, 1);
+    }
+    lua_pop(lua, 1);
+    if (!valid) {
+      *err = "Each command of redis.pipeline() must be a table of strings or integers";
+      return false;
+    }
+  }
+
+  // The writes of all commands are buffered into one batch under the locks of their keys,
+  // so the keys written by each command must be known from its arguments
+  Server *srv = GetServer();
+  Redis::Connection *conn = srv->GetCurrentConnection();
+  std::vector<std::unique_ptr<Redis::Commander>> cmds(num_cmds);
+  std::vector<std::string> errs(num_cmds);
+  std::vector<std::string> lock_keys;
+  for (int i = 0; i < num_cmds; i++) {
+    cmds[i] = prepareCommand(cmds_args[i], read_only, &errs[i]);
+    if (!cmds[i] || !cmds[i]->GetAttributes()->is_write()) continue;
+    auto attributes = cmds[i]->GetAttributes();
+    int argc = static_cast<int>(cmds_args[i].size());
+    std::vector<int> keys_indexes;
+    auto s = Redis::GetKeysFromCommand(attributes->name, argc, &keys_indexes);
+    if (!s.IsOK() || attributes->is_exclusive()) {
+      cmds[i] = nullptr;
+      errs[i] = "This Redis command is not allowed in redis.pipeline()";
+      continue;
+    }
+    for (auto index : keys_indexes) {
+      if (index >= argc) break;
+      std::string ns_key;
+      ComposeNamespaceKey(conn->GetNamespace(), cmds_args[i][index], &ns_key, srv->storage_->IsSlotIdEncoded());
+      lock_keys.emplace_back(std::move(ns_key));
+    }
+  }
+  std::unique_ptr<ReentrantMultiLockGuard> key_guard;
+  bool in_txn = false;
+  if (!lock_keys.empty()) {
+    key_guard = std::make_unique<ReentrantMultiLockGuard>(srv->storage_->GetLockManager(), lock_keys);
+    in_txn = srv->storage_->BeginTxn();
+  }
+
+  // Like the pipeline of the clients, the error of a command is its result and the
+  // following commands are still executed
+  lua_createtable(lua, num_cmds, 0);
+  for (int i = 0; i < num_cmds;) {
+    int last = i;
+    while (last < num_cmds && cmds[last] && cmds[last]->GetAttributes()->name == "get") last++;
+    if (last - i > 1) {
+      executeGets(lua, cmds, cmds_args, i, last);
+      i = last;
+      continue;
+    }
+    if (cmds[i]) {
+      executeCommand(lua, cmds[i].get(), cmds_args[i]);
+    } else {
+      pushError(lua, errs[i].c_str());
+    }
+    lua_rawseti(lua, -2, ++i);
+  }
+  if (in_txn) {
+    auto s = srv->storage_->CommitTxn();
+    if (!s.ok()) {
+      lua_pop(lua, 1);
+      *err = s.ToString();
+      return false;
+    }
+  }
+  return true;
+}
+
+int redisPipelineCommand(lua_State *lua) {
+  // Raise the error after the locks and the buffers of the pipeline were released,
+  // since the destructors are skipped by the error
+  {
+    std::string err;
+    if (executePipeline(lua, &err)) return 1;
+    pushError(lua, err.c_str());
+  }
+  return raiseError(lua);
+}
+
 void removeUnsupportedFunctions(lua_State *lua) {
   lua_pushnil(lua);
   lua_setglobal(lua, "loadfile");
@@ -906,7 +1310,7 @@ int redisMathRandomSeed(lua_State *L) {
  *
  * If 'c' is not NULL, on error the client is informed with an appropriate
  * error describing the nature of the problem and the Lua interpreter error. */
-Status createFunction(Server *srv, const std::string &body, std::string *sha, lua_State *lua) {
+Status createFunction(Server *srv, const std::string &body, std::string *sha, lua_State *lua, bool need_to_store) {
   char funcname[43];
 
   funcname[0] = 'f';
@@ -921,6 +1325,7 @@ Status createFunction(Server *srv, const std::string &body, std::string *sha, lu
   funcdef += body;
   funcdef += "\nend";
 
+  auto start = std::chrono::high_resolution_clock::now();
   if (luaL_loadbuffer(lua, funcdef.c_str(), funcdef.size(), "@user_script")) {
     std::string errMsg = lua_tostring(lua, -1);
     lua_pop(lua, 1);
@@ -931,8 +1336,11 @@ Status createFunction(Server *srv, const std::string &body, std::string *sha, lu
     lua_pop(lua, 1);
     return Status(Status::NotOK, "Error running script (new function): " + errMsg + "\n");
   }
+  auto end = std::chrono::high_resolution_clock::now();
+  srv->stats_.IncrScriptCompiles(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+  getFunctionCache(lua)->Add(lua, funcname, srv->GetConfig()->lua_script_cache_size);
   // would store lua function into propagate column family and propagate those scripts to slaves
-  srv->ScriptSet(*sha, body);
+  if (need_to_store) srv->ScriptSet(*sha, body);
   return Status::OK();
 }
 
@@ -31,6 +31,9 @@ namespace Lua {
 
 lua_State *CreateState(bool read_only = false);
 void DestroyState(lua_State *lua);
+// Remove all compiled scripts from the state, e.g. after SCRIPT FLUSH
+void ClearFunctions(lua_State *lua);
+size_t CachedFunctions(lua_State *lua);
 
 void loadFuncs(lua_State *lua, bool read_only = false);
 void loadLibraries(lua_State *lua);
@@ -39,14 +42,24 @@ void enableGlobalsProtection(lua_State *lua);
 int redisCallCommand(lua_State *lua);
 int redisPCallCommand(lua_State *lua);
 int redisGenericCommand(lua_State *lua, int raise_error);
+// Execute a table of commands like redis.pcall and return the table of their results, the
+// writes are applied at once under the locks of their keys, and the consecutive GETs are
+// read by one MultiGet
+int redisPipelineCommand(lua_State *lua);
 int redisSha1hexCommand(lua_State *lua);
 int redisStatusReplyCommand(lua_State *lua);
 int redisErrorReplyCommand(lua_State *lua);
-Status createFunction(Server *srv, const std::string &body, std::string *sha, lua_State *lua);
+// Compile the script into the function f_<sha> of the state, and store the script
+// into the propagate column family if need_to_store is true
+Status createFunction(Server *srv, const std::string &body, std::string *sha, lua_State *lua,
+                      bool need_to_store = true);
 
 int redisLogCommand(lua_State *lua);
 Status evalGenericCommand(Redis::Connection *conn, const std::vector<std::string> &args, bool evalsha,
                           std::string *output, bool read_only = false);
+// Whether the script of EVAL or EVALSHA runs under the locks of its declared keys rather than
+// exclusively, see lua-strict-key-accessing
+bool RunsUnderKeyLocks(const Config *config, const std::vector<std::string> &args);
 
 const char *redisProtocolToLuaType(lua_State *lua, const char *reply);
 const char *redisProtocolToLuaType_Int(lua_State *lua, const char *reply);
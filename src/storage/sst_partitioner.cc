@@ -0,0 +1,57 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "sst_partitioner.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// The length of [ns size][ns] of the key, the whole key if it's truncated
+size_t namespacePrefixLength(const rocksdb::Slice &key) {
+  if (key.empty()) return 0;
+  return std::min(key.size(), 1 + static_cast<size_t>(static_cast<uint8_t>(key[0])));
+}
+
+}  // namespace
+
+rocksdb::PartitionerResult SlotSstPartitioner::ShouldPartition(const rocksdb::PartitionerRequest &request) {
+  const rocksdb::Slice &prev = *request.prev_user_key;
+  const rocksdb::Slice &current = *request.current_user_key;
+  size_t ns_len = namespacePrefixLength(prev);
+  if (ns_len != namespacePrefixLength(current) || memcmp(prev.data(), current.data(), ns_len) != 0) {
+    return rocksdb::kRequired;
+  }
+  if (!slot_id_encoded_ || request.current_output_file_size < min_file_size_) return rocksdb::kNotRequired;
+
+  size_t slot_len = std::min(ns_len + 2, std::min(prev.size(), current.size()));
+  if (rocksdb::Slice(prev.data(), slot_len) != rocksdb::Slice(current.data(), slot_len)) {
+    return rocksdb::kRequired;
+  }
+  return rocksdb::kNotRequired;
+}
+
+bool SlotSstPartitioner::CanDoTrivialMove(const rocksdb::Slice &smallest_user_key,
+                                          const rocksdb::Slice &largest_user_key) {
+  // A file crossing the slots is kept as it is, only those crossing the namespaces are rewritten
+  return ShouldPartition(rocksdb::PartitionerRequest(smallest_user_key, largest_user_key, 0)) ==
+         rocksdb::kNotRequired;
+}
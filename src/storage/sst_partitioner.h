@@ -0,0 +1,61 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <rocksdb/slice.h>
+#include <rocksdb/sst_partitioner.h>
+
+#include <memory>
+
+// SlotSstPartitioner cuts the output SST files between the namespaces and, if the slot id is
+// encoded, between the slots, since both the metadata and subkeys start with [ns size][ns][slot id].
+// The keys of a slot are then mostly in their own files, which could be dropped by DeleteFilesInRange
+// after the slot is migrated away instead of waiting for the compactions. The slots smaller than
+// min_file_size aren't cut off, so the many small slots don't produce the same number of tiny files.
+class SlotSstPartitioner : public rocksdb::SstPartitioner {
+ public:
+  SlotSstPartitioner(bool slot_id_encoded, uint64_t min_file_size)
+      : slot_id_encoded_(slot_id_encoded), min_file_size_(min_file_size) {}
+
+  const char *Name() const override { return "Kvrocks.SlotSstPartitioner"; }
+  rocksdb::PartitionerResult ShouldPartition(const rocksdb::PartitionerRequest &request) override;
+  bool CanDoTrivialMove(const rocksdb::Slice &smallest_user_key, const rocksdb::Slice &largest_user_key) override;
+
+ private:
+  bool slot_id_encoded_;
+  uint64_t min_file_size_;
+};
+
+class SlotSstPartitionerFactory : public rocksdb::SstPartitionerFactory {
+ public:
+  SlotSstPartitionerFactory(bool slot_id_encoded, uint64_t min_file_size)
+      : slot_id_encoded_(slot_id_encoded), min_file_size_(min_file_size) {}
+
+  const char *Name() const override { return "Kvrocks.SlotSstPartitionerFactory"; }
+  std::unique_ptr<rocksdb::SstPartitioner> CreatePartitioner(
+      const rocksdb::SstPartitioner::Context &context) const override {
+    return std::make_unique<SlotSstPartitioner>(slot_id_encoded_, min_file_size_);
+  }
+
+ private:
+  bool slot_id_encoded_;
+  uint64_t min_file_size_;
+};
@@ -23,31 +23,51 @@
 #include <event2/buffer.h>
 #include <fcntl.h>
 #include <glog/logging.h>
+#include <rocksdb/cache.h>
 #include <rocksdb/convenience.h>
 #include <rocksdb/env.h>
+#include <rocksdb/file_system.h>
 #include <rocksdb/filter_policy.h>
+#include <rocksdb/memtablerep.h>
 #include <rocksdb/rate_limiter.h>
 #include <rocksdb/sst_file_manager.h>
+#include <rocksdb/sst_file_reader.h>
 #include <rocksdb/utilities/checkpoint.h>
 #include <rocksdb/utilities/table_properties_collectors.h>
+#include <rocksdb/write_buffer_manager.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <random>
+#include <set>
 
+#include "backup_uploader.h"
+#include "cache_warmer.h"
 #include "compact_filter.h"
 #include "config.h"
+#include "db_util.h"
 #include "event_listener.h"
 #include "event_util.h"
 #include "fd_util.h"
+#include "huge_page_allocator.h"
+#include "key_reclaimer.h"
+#include "lazy_expirer.h"
+#include "merge_operator.h"
+#include "parse_util.h"
+#include "prefix_extractor.h"
 #include "redis_db.h"
 #include "redis_metadata.h"
 #include "rocksdb_crc32c.h"
+#include "scope_exit.h"
 #include "server/server.h"
+#include "sst_partitioner.h"
 #include "table_properties_collector.h"
 #include "time_util.h"
+#include "workload_tuner.h"
 
 namespace Engine {
 
@@ -57,26 +77,137 @@ const char *kMetadataColumnFamilyName = "metadata";
 const char *kSubkeyColumnFamilyName = "default";
 const char *kPropagateColumnFamilyName = "propagate";
 const char *kStreamColumnFamilyName = "stream";
+const char *kTTLIndexColumnFamilyName = "ttl_index";
+const char *kZSetRankColumnFamilyName = "zset_rank";
 
 const char *kPropagateScriptCommand = "script";
+const char *kPropagateBulkLoad = "bulkload";
+const char *kPropagateNamespaceColumnFamilies = "namespace_column_families";
+const char *kPropagateWritingVersion = "writing_version_";
 
 const char *kLuaFunctionPrefix = "lua_f_";
 
 const char *kReplicationIdKey = "replication_id_";
 
 const uint64_t kIORateLimitMaxMb = 1024000;
+const size_t kSubkeyMemtableHashBuckets = 100000;
+// The subkey files with 32K deletions in any 128K consecutive entries, or half of the entries deleted,
+// are marked to be compacted
+const size_t kSubkeyDeletionWindow = 128 * 1024;
+const size_t kSubkeyDeletionTrigger = 32 * 1024;
+const double kSubkeyDeletionRatio = 0.5;
+// The output files are cut at the slot boundaries only after they reach the size
+const uint64_t kSlotPartitionMinFileSize = 1 * MiB;
 
 using rocksdb::Slice;
 
-Storage::Storage(Config *config) : env_(rocksdb::Env::Default()), config_(config), lock_mgr_(16) {
+static std::string writingVersionKey(uint64_t version) {
+  std::string key = kPropagateWritingVersion;
+  PutFixed64(&key, version);
+  return key;
+}
+
+static bool parseWritingVersionKey(const rocksdb::Slice &key, uint64_t *version) {
+  size_t prefix_size = strlen(kPropagateWritingVersion);
+  if (key.size() != prefix_size + 8 || !key.starts_with(kPropagateWritingVersion)) return false;
+  *version = DecodeFixed64(key.data() + prefix_size);
+  return true;
+}
+
+// Collect the writing version markers put and deleted by the batch applied on the replica
+class WritingVersionCollector : public rocksdb::WriteBatch::Handler {
+ public:
+  rocksdb::Status PutCF(uint32_t column_family_id, const rocksdb::Slice &key, const rocksdb::Slice &value) override {
+    uint64_t version = 0;
+    if (column_family_id == kColumnFamilyIDPropagate && parseWritingVersionKey(key, &version)) {
+      added.emplace_back(version);
+    }
+    return rocksdb::Status::OK();
+  }
+  rocksdb::Status DeleteCF(uint32_t column_family_id, const rocksdb::Slice &key) override {
+    uint64_t version = 0;
+    if (column_family_id == kColumnFamilyIDPropagate && parseWritingVersionKey(key, &version)) {
+      removed.emplace_back(version);
+    }
+    return rocksdb::Status::OK();
+  }
+
+  std::vector<uint64_t> added;
+  std::vector<uint64_t> removed;
+};
+
+static const char *sharedCFName(uint32_t id) {
+  switch (id) {
+    case kColumnFamilyIDMetadata:
+      return kMetadataColumnFamilyName;
+    case kColumnFamilyIDZSetScore:
+      return kZSetScoreColumnFamilyName;
+    case kColumnFamilyIDPubSub:
+      return kPubSubColumnFamilyName;
+    case kColumnFamilyIDPropagate:
+      return kPropagateColumnFamilyName;
+    case kColumnFamilyIDStream:
+      return kStreamColumnFamilyName;
+    case kColumnFamilyIDTTLIndex:
+      return kTTLIndexColumnFamilyName;
+    case kColumnFamilyIDZSetRank:
+      return kZSetRankColumnFamilyName;
+    default:
+      return kSubkeyColumnFamilyName;
+  }
+}
+
+static std::string namespaceCFName(uint32_t id, const std::string &ns, uint64_t generation) {
+  return std::string(sharedCFName(id)) + "@" + ns + "@" + std::to_string(generation);
+}
+
+// Parse <column family>@<namespace>@<generation>, the namespace may contain '@'
+static bool parseNamespaceCFName(const std::string &name, uint32_t *id, std::string *ns, uint64_t *generation) {
+  auto first = name.find('@'), last = name.rfind('@');
+  if (first == std::string::npos || first == last) return false;
+  auto parsed = ParseInt<uint64_t>(name.substr(last + 1), 10);
+  if (!parsed) return false;
+  for (auto cf_id : kNamespaceColumnFamilyIDs) {
+    if (name.compare(0, first, sharedCFName(cf_id)) == 0) {
+      *id = cf_id;
+      *ns = name.substr(first + 1, last - first - 1);
+      *generation = *parsed;
+      return true;
+    }
+  }
+  return false;
+}
+
+Storage::Storage(Config *config)
+    : env_(rocksdb::Env::Default()),
+      config_(config),
+      lock_mgr_(config->lock_table_hash_power),
+      metadata_cache_(static_cast<size_t>(config->metadata_cache_size) * MiB),
+      key_counter_(config->slot_id_encoded) {
   Metadata::InitVersionCounter();
+  Metadata::SetCompactEncoding(config->metadata_compact_encoding);
   SetCheckpointCreateTime(0);
   SetCheckpointAccessTime(0);
   backup_creating_time_ = Util::GetTimeStamp();
   SetWriteOptions(config->RocksDB.write_options);
+  big_keys_.SetEnabled(config->bigkeys_scan_rate > 0);
+  latency_monitor_.SetThreshold(config->latency_monitor_threshold);
+  key_reclaimer_ = std::make_unique<KeyReclaimer>(this);
+  lazy_expirer_ = std::make_unique<LazyExpirer>(this);
+  cache_warmer_ = std::make_unique<CacheWarmer>(this);
+  workload_tuner_ = std::make_unique<WorkloadTuner>(this);
 }
 
 Storage::~Storage() {
+  // Stop the expirer and the reclaimer before closing the DB, they may be writing the DB.
+  // The expirer queues the subkeys to the reclaimer, so it's stopped first.
+  lazy_expirer_.reset();
+  key_reclaimer_.reset();
+  cache_warmer_->Stop();
+  if (auto s = cache_warmer_->Dump(); !s.IsOK()) {
+    LOG(WARNING) << "[storage] Failed to dump the hot keys to warm the block cache, err: " << s.Msg();
+  }
+  cache_warmer_.reset();
   if (backup_ != nullptr) {
     DestroyBackup();
   }
@@ -84,13 +215,33 @@ Storage::~Storage() {
 }
 
 void Storage::CloseDB() {
+  // Abort the rebuild of the key counter which is holding the read lock
+  key_counter_.Clear();
   auto guard = WriteLockGuard();
   if (db_ == nullptr) return;
 
+  metadata_cache_.Clear();
+  // The iterators must be destroyed before the DB
+  scan_iterator_cache_.Clear();
+  big_keys_.Clear();
   db_closing_ = true;
-  db_->SyncWAL();
+  {
+    // The file deletions are disabled only in the DB object
+    std::lock_guard<std::mutex> lg(checkpoint_mu_);
+    pinned_repl_files_.clear();
+  }
+  if (auto s = FlushReplicaWrites(); !s.IsOK()) LOG(WARNING) << "[storage] " << s.Msg();
+  db_->FlushWAL(true);
   rocksdb::CancelAllBackgroundWork(db_, true);
   for (auto handle : cf_handles_) db_->DestroyColumnFamilyHandle(handle);
+  for (const auto &iter : namespace_cfs_) {
+    for (auto &handle : iter.second->handles) {
+      if (auto cf_handle = handle.load()) db_->DestroyColumnFamilyHandle(cf_handle);
+    }
+  }
+  for (auto handle : dropped_cf_handles_) db_->DestroyColumnFamilyHandle(handle);
+  namespace_cfs_.clear();
+  dropped_cf_handles_.clear();
   delete db_;
   db_ = nullptr;
 }
@@ -103,11 +254,17 @@ void Storage::SetWriteOptions(const Config::RocksDB::WriteOptions &config) {
   write_opts_.memtable_insert_hint_per_batch = config.memtable_insert_hint_per_batch;
 }
 
-rocksdb::BlockBasedTableOptions Storage::InitTableOptions() {
+rocksdb::BlockBasedTableOptions Storage::InitTableOptions(int filter_bits_per_key) {
   rocksdb::BlockBasedTableOptions table_options;
   table_options.format_version = 5;
   table_options.index_type = rocksdb::BlockBasedTableOptions::IndexType::kTwoLevelIndexSearch;
-  table_options.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10, false));
+  if (config_->RocksDB.filter_type == kFilterTypeRibbon) {
+    // The ribbon filter saves about 30% memory of the bloom filter at the same FPR but is slower
+    // to build, so the flushed files in L0 still use the bloom filter
+    table_options.filter_policy.reset(rocksdb::NewRibbonFilterPolicy(filter_bits_per_key, 1));
+  } else {
+    table_options.filter_policy.reset(rocksdb::NewBloomFilterPolicy(filter_bits_per_key, false));
+  }
   table_options.partition_filters = true;
   table_options.optimize_filters_for_memory = true;
   table_options.metadata_block_size = 4096;
@@ -125,6 +282,20 @@ void Storage::SetBlobDB(rocksdb::ColumnFamilyOptions *cf_options) {
   cf_options->enable_blob_garbage_collection = config_->RocksDB.enable_blob_garbage_collection;
   // Use 100.0 to force converting blob_garbage_collection_age_cutoff to double
   cf_options->blob_garbage_collection_age_cutoff = config_->RocksDB.blob_garbage_collection_age_cutoff / 100.0;
+  // The blobs are cached apart from the blocks, so the large values don't evict the hot blocks
+  if (config_->RocksDB.enable_blob_files) cf_options->blob_cache = blob_cache_;
+}
+
+void Storage::SetCompression(rocksdb::ColumnFamilyOptions *cf_options, int start_level) {
+  cf_options->compression_per_level.resize(cf_options->num_levels);
+  // only compress levels >= start_level, the upper levels are short-lived and read more often
+  for (int i = 0; i < cf_options->num_levels; ++i) {
+    if (i < start_level) {
+      cf_options->compression_per_level[i] = rocksdb::CompressionType::kNoCompression;
+    } else {
+      cf_options->compression_per_level[i] = static_cast<rocksdb::CompressionType>(config_->RocksDB.compression);
+    }
+  }
 }
 
 rocksdb::Options Storage::InitOptions() {
@@ -144,31 +315,46 @@ rocksdb::Options Storage::InitOptions() {
   options.max_write_buffer_number = config_->RocksDB.max_write_buffer_number;
   options.min_write_buffer_number_to_merge = 2;
   options.write_buffer_size = config_->RocksDB.write_buffer_size * MiB;
+  // The arenas of the memtables fall back to the normal pages if the huge pages couldn't be mapped
+  if (config_->RocksDB.memtable_huge_pages) options.memtable_huge_page_size = HugePageAllocator::kHugePageSize;
   options.num_levels = 7;
-  options.compression_per_level.resize(options.num_levels);
-  // only compress levels >= 2
-  for (int i = 0; i < options.num_levels; ++i) {
-    if (i < 2) {
-      options.compression_per_level[i] = rocksdb::CompressionType::kNoCompression;
-    } else {
-      options.compression_per_level[i] = static_cast<rocksdb::CompressionType>(config_->RocksDB.compression);
-    }
-  }
+  SetCompression(&options, config_->RocksDB.compression_start_level);
   if (config_->RocksDB.row_cache_size) {
     options.row_cache = rocksdb::NewLRUCache(config_->RocksDB.row_cache_size * MiB);
   }
   options.enable_pipelined_write = config_->RocksDB.enable_pipelined_write;
+  // Only the skiplist memtables support the concurrent writes
+  options.allow_concurrent_memtable_write = config_->RocksDB.subkey_memtable_type == kMemtableTypeSkipList;
   options.target_file_size_base = config_->RocksDB.target_file_size_base * MiB;
   options.max_manifest_file_size = 64 * MiB;
   options.max_log_file_size = 256 * MiB;
   options.keep_log_file_num = 12;
-  options.WAL_ttl_seconds = static_cast<uint64_t>(config_->RocksDB.WAL_ttl_seconds);
+  // The archived WAL files are purged by the server once the replicas don't need them, so only
+  // their total size is limited by RocksDB
+  options.WAL_ttl_seconds =
+      config_->wal_retention_by_replicas ? 0 : static_cast<uint64_t>(config_->RocksDB.WAL_ttl_seconds);
   options.WAL_size_limit_MB = static_cast<uint64_t>(config_->RocksDB.WAL_size_limit_MB);
   options.max_total_wal_size = static_cast<uint64_t>(config_->RocksDB.max_total_wal_size * MiB);
   options.listeners.emplace_back(new EventListener(this));
   options.dump_malloc_stats = true;
+  // Make the startup of the large DB faster: the table files are opened by multiple threads
+  // if they're all kept open (max_open_files is -1), otherwise lazily by the reads. The stats
+  // of the files are computed for the new files only, instead of reading the properties of
+  // the existing files, and the recovered memtables are flushed later as usual.
+  options.max_file_opening_threads = config_->RocksDB.max_file_opening_threads;
+  options.manual_wal_flush = config_->RocksDB.manual_wal_flush;
+  options.skip_stats_update_on_db_open = true;
+  options.skip_checking_sst_file_sizes_on_db_open = true;
+  options.avoid_flush_during_recovery = true;
   sst_file_manager_ = std::shared_ptr<rocksdb::SstFileManager>(rocksdb::NewSstFileManager(rocksdb::Env::Default()));
   options.sst_file_manager = sst_file_manager_;
+  if (!config_->RocksDB.subkey_cold_dir.empty()) {
+    if (!tiered_env_) {
+      tiered_fs_ = std::make_shared<TieredFileSystem>(rocksdb::FileSystem::Default(), config_->RocksDB.subkey_cold_dir);
+      tiered_env_ = rocksdb::NewCompositeEnv(tiered_fs_);
+    }
+    options.env = tiered_env_.get();
+  }
   uint64_t max_io_mb = kIORateLimitMaxMb;
   if (config_->max_io_mb > 0) max_io_mb = static_cast<uint64_t>(config_->max_io_mb);
   rate_limiter_ = std::shared_ptr<rocksdb::RateLimiter>(rocksdb::NewGenericRateLimiter(max_io_mb * MiB));
@@ -185,8 +371,8 @@ rocksdb::Options Storage::InitOptions() {
   return options;
 }
 
-Status Storage::SetColumnFamilyOption(const std::string &key, const std::string &value) {
-  for (auto &cf_handle : cf_handles_) {
+Status Storage::SetColumnFamilyOption(const std::string &key, const std::string &value, const std::string &cf_name) {
+  for (auto &cf_handle : GetAllCFHandles(cf_name)) {
     auto s = db_->SetOptions(cf_handle, {{key, value}});
     if (!s.ok()) return Status(Status::NotOK, s.ToString());
   }
@@ -211,7 +397,8 @@ Status Storage::CreateColumnFamilies(const rocksdb::Options &options) {
   rocksdb::Status s = rocksdb::DB::Open(options, config_->db_dir, &tmp_db);
   if (s.ok()) {
     std::vector<std::string> cf_names = {kMetadataColumnFamilyName, kZSetScoreColumnFamilyName, kPubSubColumnFamilyName,
-                                         kPropagateColumnFamilyName, kStreamColumnFamilyName};
+                                         kPropagateColumnFamilyName, kStreamColumnFamilyName,
+                                         kTTLIndexColumnFamilyName, kZSetRankColumnFamilyName};
     std::vector<rocksdb::ColumnFamilyHandle *> cf_handles;
     s = tmp_db->CreateColumnFamilies(cf_options, cf_names, &cf_handles);
     if (!s.ok()) {
@@ -241,23 +428,76 @@ Status Storage::CreateColumnFamilies(const rocksdb::Options &options) {
 Status Storage::Open(bool read_only) {
   auto guard = WriteLockGuard();
   db_closing_ = false;
+  // The stall conditions of the closed DB would never be changed back
+  write_stopped_cfs_ = 0;
+  write_delayed_cfs_ = 0;
 
   bool cache_index_and_filter_blocks = config_->RocksDB.cache_index_and_filter_blocks;
   size_t metadata_block_cache_size = config_->RocksDB.metadata_block_cache_size * MiB;
   size_t subkey_block_cache_size = config_->RocksDB.subkey_block_cache_size * MiB;
 
   rocksdb::Options options = InitOptions();
-  CreateColumnFamilies(options);
+  auto open_start = std::chrono::high_resolution_clock::now();
+  auto elapsed_ms = [](std::chrono::high_resolution_clock::time_point since) {
+    auto now = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now - since).count();
+  };
+  // Opening the DB without the column families would recover the whole MANIFEST only to fail,
+  // so the column families are created only if they're missing
+  std::vector<std::string> old_column_families;
+  auto s = rocksdb::DB::ListColumnFamilies(options, config_->db_dir, &old_column_families);
+  if (!s.ok() || std::find(old_column_families.begin(), old_column_families.end(), kMetadataColumnFamilyName) ==
+                     old_column_families.end()) {
+    CreateColumnFamilies(options);
+    old_column_families.clear();
+    s = rocksdb::DB::ListColumnFamilies(options, config_->db_dir, &old_column_families);
+    if (!s.ok()) return Status(Status::NotOK, s.ToString());
+  }
+  int64_t list_cf_duration = elapsed_ms(open_start);
+
+  // All block caches share the compressed secondary cache, which keeps the evicted blocks
+  std::shared_ptr<rocksdb::SecondaryCache> secondary_cache;
+  if (config_->RocksDB.compressed_secondary_cache_size > 0) {
+    rocksdb::CompressedSecondaryCacheOptions secondary_cache_opts;
+    secondary_cache_opts.capacity = static_cast<size_t>(config_->RocksDB.compressed_secondary_cache_size) * MiB;
+    secondary_cache_opts.compression_type = rocksdb::kLZ4Compression;
+    secondary_cache = rocksdb::NewCompressedSecondaryCache(secondary_cache_opts);
+  }
+  if (config_->RocksDB.block_cache_huge_pages && !block_cache_allocator_) {
+    auto allocator = HugePageAllocator::Create();
+    if (allocator) {
+      block_cache_allocator_ = std::move(*allocator);
+    } else {
+      LOG(WARNING) << "[storage] Failed to create the huge page allocator of the block caches, fallback to "
+                   << "the default allocator, err: " << allocator.Msg();
+    }
+  }
+  auto new_block_cache = [&](size_t capacity) -> std::shared_ptr<rocksdb::Cache> {
+    if (config_->RocksDB.block_cache_type == kBlockCacheTypeHCC) {
+      rocksdb::HyperClockCacheOptions cache_opts(capacity, static_cast<size_t>(config_->RocksDB.block_size));
+      cache_opts.memory_allocator = block_cache_allocator_;
+      return cache_opts.MakeSharedCache();
+    }
+    rocksdb::LRUCacheOptions cache_opts(capacity, -1, false, 0.75);
+    cache_opts.secondary_cache = secondary_cache;
+    cache_opts.memory_allocator = block_cache_allocator_;
+    return rocksdb::NewLRUCache(cache_opts);
+  };
+
+  blob_cache_.reset();
+  if (config_->RocksDB.blob_cache_size > 0) {
+    blob_cache_ = rocksdb::NewLRUCache(static_cast<size_t>(config_->RocksDB.blob_cache_size) * MiB);
+  }
 
   std::shared_ptr<rocksdb::Cache> shared_block_cache;
   if (config_->RocksDB.share_metadata_and_subkey_block_cache) {
     size_t shared_block_cache_size = metadata_block_cache_size + subkey_block_cache_size;
-    shared_block_cache = rocksdb::NewLRUCache(shared_block_cache_size, -1, false, 0.75);
+    shared_block_cache = new_block_cache(shared_block_cache_size);
   }
 
-  rocksdb::BlockBasedTableOptions metadata_table_opts = InitTableOptions();
-  metadata_table_opts.block_cache =
-      shared_block_cache ? shared_block_cache : rocksdb::NewLRUCache(metadata_block_cache_size, -1, false, 0.75);
+  rocksdb::BlockBasedTableOptions metadata_table_opts = InitTableOptions(config_->RocksDB.metadata_filter_bits_per_key);
+  metadata_block_cache_ = shared_block_cache ? shared_block_cache : new_block_cache(metadata_block_cache_size);
+  metadata_table_opts.block_cache = metadata_block_cache_;
   metadata_table_opts.pin_l0_filter_and_index_blocks_in_cache = true;
   metadata_table_opts.cache_index_and_filter_blocks = cache_index_and_filter_blocks;
   metadata_table_opts.cache_index_and_filter_blocks_with_high_priority = true;
@@ -265,27 +505,81 @@ Status Storage::Open(bool read_only) {
   rocksdb::ColumnFamilyOptions metadata_opts(options);
   metadata_opts.table_factory.reset(rocksdb::NewBlockBasedTableFactory(metadata_table_opts));
   metadata_opts.compaction_filter_factory = std::make_shared<MetadataFilterFactory>(this);
+  metadata_opts.merge_operator = std::make_shared<StringCounterMergeOperator>();
+  if (config_->RocksDB.partition_sst_by_slot) {
+    metadata_opts.sst_partitioner_factory =
+        std::make_shared<SlotSstPartitionerFactory>(config_->slot_id_encoded, kSlotPartitionMinFileSize);
+  }
+  // Fold the increments of the hot counters in the memtable, so the reads wouldn't apply too many operands
+  metadata_opts.max_successive_merges = 64;
   metadata_opts.disable_auto_compactions = config_->RocksDB.disable_auto_compactions;
+  SetCompression(&metadata_opts, config_->RocksDB.metadata_compression_start_level);
   // Enable whole key bloom filter in memtable
   metadata_opts.memtable_whole_key_filtering = true;
-  metadata_opts.memtable_prefix_bloom_size_ratio = 0.1;
+  metadata_opts.memtable_prefix_bloom_size_ratio = config_->RocksDB.memtable_bloom_size_ratio / 100.0;
   metadata_opts.table_properties_collector_factories.emplace_back(
       NewCompactOnExpiredTableCollectorFactory(kMetadataColumnFamilyName, 0.3));
   SetBlobDB(&metadata_opts);
+  // The values of the strings are in the metadata, so their blob threshold is apart from the subkeys'
+  metadata_opts.min_blob_size = config_->RocksDB.MetadataMinBlobSize();
 
-  rocksdb::BlockBasedTableOptions subkey_table_opts = InitTableOptions();
-  subkey_table_opts.block_cache =
-      shared_block_cache ? shared_block_cache : rocksdb::NewLRUCache(subkey_block_cache_size, -1, false, 0.75);
+  rocksdb::BlockBasedTableOptions subkey_table_opts = InitTableOptions(config_->RocksDB.subkey_filter_bits_per_key);
+  subkey_block_cache_ = shared_block_cache ? shared_block_cache : new_block_cache(subkey_block_cache_size);
+  subkey_table_opts.block_cache = subkey_block_cache_;
   subkey_table_opts.pin_l0_filter_and_index_blocks_in_cache = true;
   subkey_table_opts.cache_index_and_filter_blocks = cache_index_and_filter_blocks;
   subkey_table_opts.cache_index_and_filter_blocks_with_high_priority = true;
+  // All memtables share the budget instead of each column family holding up to its own limit,
+  // the memory used by the memtables takes the place of the cached subkey blocks if cost_to_cache
+  if (config_->RocksDB.memtable_total_budget > 0) {
+    std::shared_ptr<rocksdb::Cache> charged_cache;
+    if (config_->RocksDB.memtable_budget_cost_to_cache) charged_cache = subkey_table_opts.block_cache;
+    write_buffer_manager_ = std::make_shared<rocksdb::WriteBufferManager>(
+        static_cast<size_t>(config_->RocksDB.memtable_total_budget) * MiB, charged_cache,
+        config_->RocksDB.memtable_budget_allow_stall);
+    options.write_buffer_manager = write_buffer_manager_;
+  }
+  // Keep the whole key filters for point lookups like HGET, as well as the prefix filters
+  subkey_table_opts.whole_key_filtering = true;
   rocksdb::ColumnFamilyOptions subkey_opts(options);
   subkey_opts.table_factory.reset(rocksdb::NewBlockBasedTableFactory(subkey_table_opts));
+  // Enable prefix bloom filters for the subkeys of the same collection, then the seeks
+  // into small or missing collections could skip the SST files and memtables.
+  subkey_opts.prefix_extractor = std::make_shared<InternalKeyPrefixExtractor>(config_->slot_id_encoded);
+  subkey_opts.memtable_prefix_bloom_size_ratio = config_->RocksDB.memtable_bloom_size_ratio / 100.0;
   subkey_opts.compaction_filter_factory = std::make_shared<SubKeyFilterFactory>(this);
   subkey_opts.disable_auto_compactions = config_->RocksDB.disable_auto_compactions;
+  // The subkeys share the [ns size][ns][slot id] prefix of their metadata, so they're cut at the same boundaries
+  subkey_opts.sst_partitioner_factory = metadata_opts.sst_partitioner_factory;
   subkey_opts.table_properties_collector_factories.emplace_back(
       NewCompactOnExpiredTableCollectorFactory(kSubkeyColumnFamilyName, 0.3));
+  // Mark the files for compaction once they have dense deletions, e.g. the subkeys deleted by HDEL or
+  // ZREMRANGEBYSCORE, which the collector above doesn't see since the keys' metadata is still alive
+  subkey_opts.table_properties_collector_factories.emplace_back(rocksdb::NewCompactOnDeletionCollectorFactory(
+      kSubkeyDeletionWindow, kSubkeyDeletionTrigger, kSubkeyDeletionRatio));
+  // Skip the filters of the last level, the lookups of the existing subkeys mostly end there
+  subkey_opts.optimize_filters_for_hits = config_->RocksDB.subkey_optimize_filters_for_hits;
+  // The values of the same collection usually look alike, so a dictionary sampled (or trained by zstd)
+  // from the data of each compaction compresses the small blocks much better
+  subkey_opts.compression_opts.max_dict_bytes = config_->RocksDB.subkey_compression_max_dict_bytes;
+  subkey_opts.compression_opts.zstd_max_train_bytes = config_->RocksDB.subkey_zstd_max_train_bytes;
   SetBlobDB(&subkey_opts);
+  subkey_opts.min_blob_size = config_->RocksDB.SubkeyMinBlobSize();
+  rocksdb::ColumnFamilyOptions stream_opts(subkey_opts);
+  stream_opts.min_blob_size = config_->RocksDB.StreamMinBlobSize();
+  // The last levels of the subkey column family are placed on the cold tier if configured, the
+  // others sharing subkey_opts are kept on the hot tier, since they're usually read by the scans
+  rocksdb::ColumnFamilyOptions tiered_subkey_opts(subkey_opts);
+  if (config_->RocksDB.subkey_memtable_type == kMemtableTypeHashSkipList) {
+    // Bucketed by the prefix extractor, i.e. the collection of the subkeys
+    tiered_subkey_opts.memtable_factory.reset(rocksdb::NewHashSkipListRepFactory(kSubkeyMemtableHashBuckets));
+  }
+  if (!config_->RocksDB.subkey_cold_dir.empty()) {
+    tiered_subkey_opts.cf_paths = {
+        {config_->db_dir, static_cast<uint64_t>(config_->RocksDB.subkey_hot_target_size) * MiB},
+        {config_->RocksDB.subkey_cold_dir, UINT64_MAX},
+    };
+  }
 
   rocksdb::BlockBasedTableOptions pubsub_table_opts = InitTableOptions();
   rocksdb::ColumnFamilyOptions pubsub_opts(options);
@@ -301,30 +595,149 @@ Status Storage::Open(bool read_only) {
   propagate_opts.disable_auto_compactions = config_->RocksDB.disable_auto_compactions;
   SetBlobDB(&propagate_opts);
 
+  rocksdb::BlockBasedTableOptions ttl_index_table_opts = InitTableOptions();
+  rocksdb::ColumnFamilyOptions ttl_index_opts(options);
+  ttl_index_opts.table_factory.reset(rocksdb::NewBlockBasedTableFactory(ttl_index_table_opts));
+  ttl_index_opts.compaction_filter_factory = std::make_shared<TTLIndexFilterFactory>(this);
+  ttl_index_opts.disable_auto_compactions = config_->RocksDB.disable_auto_compactions;
+
   std::vector<rocksdb::ColumnFamilyDescriptor> column_families;
   // Caution: don't change the order of column family, or the handle will be mismatched
-  column_families.emplace_back(rocksdb::kDefaultColumnFamilyName, subkey_opts);
+  column_families.emplace_back(rocksdb::kDefaultColumnFamilyName, tiered_subkey_opts);
   column_families.emplace_back(kMetadataColumnFamilyName, metadata_opts);
   column_families.emplace_back(kZSetScoreColumnFamilyName, subkey_opts);
   column_families.emplace_back(kPubSubColumnFamilyName, pubsub_opts);
   column_families.emplace_back(kPropagateColumnFamilyName, propagate_opts);
-  column_families.emplace_back(kStreamColumnFamilyName, subkey_opts);
-  std::vector<std::string> old_column_families;
-  auto s = rocksdb::DB::ListColumnFamilies(options, config_->db_dir, &old_column_families);
-  if (!s.ok()) return Status(Status::NotOK, s.ToString());
+  column_families.emplace_back(kStreamColumnFamilyName, stream_opts);
+  column_families.emplace_back(kTTLIndexColumnFamilyName, ttl_index_opts);
+  column_families.emplace_back(kZSetRankColumnFamilyName, subkey_opts);
+
+  // The column families of the namespaces have their own block cache and write buffer size if configured
+  std::map<std::string, std::shared_ptr<rocksdb::Cache>> namespace_block_caches;
+  auto namespace_cf_options = [&](uint32_t id, const std::string &ns) {
+    bool is_metadata = id == kColumnFamilyIDMetadata;
+    rocksdb::ColumnFamilyOptions cf_options = is_metadata ? metadata_opts : subkey_opts;
+    if (id == kColumnFamilyIDDefault) cf_options = tiered_subkey_opts;
+    if (id == kColumnFamilyIDStream) cf_options = stream_opts;
+    if (config_->RocksDB.namespace_write_buffer_size > 0) {
+      cf_options.write_buffer_size = static_cast<size_t>(config_->RocksDB.namespace_write_buffer_size) * MiB;
+    }
+    if (config_->RocksDB.namespace_block_cache_size > 0) {
+      auto &block_cache = namespace_block_caches[ns];
+      if (!block_cache) {
+        block_cache = new_block_cache(static_cast<size_t>(config_->RocksDB.namespace_block_cache_size) * MiB);
+      }
+      auto table_opts = is_metadata ? metadata_table_opts : subkey_table_opts;
+      table_opts.block_cache = block_cache;
+      cf_options.table_factory.reset(rocksdb::NewBlockBasedTableFactory(table_opts));
+    }
+    return cf_options;
+  };
+  // Open all existing column families of the namespaces, only the latest complete generation
+  // is used and the others were left by the interrupted resets
+  std::map<std::string, std::map<uint64_t, size_t>> namespace_generations;
+  for (const auto &name : old_column_families) {
+    uint32_t id = 0;
+    uint64_t generation = 0;
+    std::string ns;
+    if (!parseNamespaceCFName(name, &id, &ns, &generation)) continue;
+    namespace_generations[ns][generation]++;
+    column_families.emplace_back(name, namespace_cf_options(id, ns));
+  }
+  std::map<std::string, uint64_t> current_generations;
+  for (const auto &[ns, generations] : namespace_generations) {
+    for (const auto &[generation, num_cfs] : generations) {
+      if (num_cfs == kNamespaceColumnFamilyIDs.size()) current_generations[ns] = generation;
+    }
+  }
+  // The replicas get the column families of the master by the full synchronization, since the IDs
+  // of the column families in the replicated batches must be the same
+  bool namespace_cfs_created = false;
+  if (!read_only && config_->master_host.empty()) {
+    for (const auto &ns : config_->namespace_column_families) {
+      if (current_generations.count(ns) > 0) continue;
+      uint64_t generation = namespace_generations.count(ns) > 0 ? namespace_generations[ns].rbegin()->first + 1 : 1;
+      for (auto id : kNamespaceColumnFamilyIDs) {
+        column_families.emplace_back(namespaceCFName(id, ns, generation), namespace_cf_options(id, ns));
+      }
+      current_generations[ns] = generation;
+      namespace_cfs_created = true;
+      LOG(INFO) << "[storage] Create the column families of the namespace " << ns;
+    }
+  }
+  // The cached metadata and the pending dead keys may be stale if the DB was restored from the master
+  metadata_cache_.Clear();
+  key_reclaimer_->Clear();
+  lazy_expirer_->Clear();
+  key_counter_.Clear();
+  tombstone_tracker_.Clear();
   auto start = std::chrono::high_resolution_clock::now();
+  std::vector<rocksdb::ColumnFamilyHandle *> cf_handles;
   if (read_only) {
-    s = rocksdb::DB::OpenForReadOnly(options, config_->db_dir, column_families, &cf_handles_, &db_);
+    s = rocksdb::DB::OpenForReadOnly(options, config_->db_dir, column_families, &cf_handles, &db_);
   } else {
-    s = rocksdb::DB::Open(options, config_->db_dir, column_families, &cf_handles_, &db_);
+    s = rocksdb::DB::Open(options, config_->db_dir, column_families, &cf_handles, &db_);
   }
-  auto end = std::chrono::high_resolution_clock::now();
-  int64_t duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+  int64_t duration = elapsed_ms(start);
   if (!s.ok()) {
     LOG(INFO) << "[storage] Failed to load the data from disk: " << duration << " ms";
     return Status(Status::DBOpenErr, s.ToString());
   }
   LOG(INFO) << "[storage] Success to load the data from disk: " << duration << " ms";
+  auto setup_start = std::chrono::high_resolution_clock::now();
+
+  cf_handles_.assign(cf_handles.begin(), cf_handles.begin() + kNumColumnFamilies);
+  for (size_t i = kNumColumnFamilies; i < cf_handles.size(); i++) {
+    uint32_t id = 0;
+    uint64_t generation = 0;
+    std::string ns;
+    parseNamespaceCFName(cf_handles[i]->GetName(), &id, &ns, &generation);
+    if (auto iter = current_generations.find(ns); iter != current_generations.end() && iter->second == generation) {
+      auto &namespace_cfs = namespace_cfs_[ns];
+      if (!namespace_cfs) namespace_cfs = std::make_unique<NamespaceCFs>();
+      namespace_cfs->generation = generation;
+      namespace_cfs->handles[id] = cf_handles[i];
+    } else if (read_only) {
+      dropped_cf_handles_.emplace_back(cf_handles[i]);
+    } else {
+      LOG(INFO) << "[storage] Drop the stale column family " << cf_handles[i]->GetName();
+      s = db_->DropColumnFamily(cf_handles[i]);
+      if (!s.ok()) LOG(WARNING) << "[storage] Failed to drop the column family: " << s.ToString();
+      db_->DestroyColumnFamilyHandle(cf_handles[i]);
+    }
+  }
+
+  // The batches applied without the WAL after the recorded sequence were lost by the crash, the data
+  // is still consistent if nothing after the sequence was persisted, i.e. it's the latest sequence
+  replica_unflushed_ = false;
+  replica_writes_lost_ = false;
+  if (!read_only && env_->FileExists(replicaUnflushedPath()).ok()) {
+    std::string unflushed_seq;
+    s = rocksdb::ReadFileToString(env_, replicaUnflushedPath(), &unflushed_seq);
+    auto seq = ParseInt<uint64_t>(unflushed_seq, 10);
+    if (s.ok() && seq && *seq == LatestSeq()) {
+      env_->DeleteFile(replicaUnflushedPath());
+    } else {
+      replica_writes_lost_ = true;
+      LOG(WARNING) << "[storage] The batches applied without the WAL were partially lost, the latest sequence: "
+                   << LatestSeq() << ", the unflushed sequence: " << unflushed_seq;
+    }
+  }
+
+  resync_seq_ = 0;
+  for (const auto marker : {kPropagateBulkLoad, kPropagateNamespaceColumnFamilies}) {
+    std::string resync_seq;
+    s = db_->Get(rocksdb::ReadOptions(), cf_handles_[kColumnFamilyIDPropagate], marker, &resync_seq);
+    if (!s.ok()) continue;
+    if (auto seq = ParseInt<uint64_t>(resync_seq, 10)) resync_seq_ = std::max<uint64_t>(resync_seq_, *seq);
+  }
+  s = loadWritingVersions();
+  if (!s.ok()) return Status(Status::NotOK, "failed to load the writing version markers: " + s.ToString());
+  LOG(INFO) << "[storage] Opened the DB in " << elapsed_ms(open_start) << " ms, listing the column families took "
+            << list_cf_duration << " ms, loading the data took " << duration << " ms, setting up the column "
+            << "families took " << elapsed_ms(setup_start) << " ms";
+  // The batches written into the new column families can't be applied by the connected replicas
+  if (namespace_cfs_created) return requireResync(kPropagateNamespaceColumnFamilies);
   return Status::OK();
 }
 
@@ -332,6 +745,12 @@ Status Storage::CreateBackup() {
   LOG(INFO) << "[storage] Start to create new backup";
   std::lock_guard<std::mutex> lg(config_->backup_mu_);
   std::string task_backup_dir = config_->backup_dir;
+  if (!config_->backup_upload_command.empty()) return uploadBackup(task_backup_dir);
+  if (config_->backup_incremental) return createIncrementalBackup(task_backup_dir);
+  // The backup dir may be left by the incremental backups
+  if (isIncrementalBackup(task_backup_dir)) {
+    if (auto s = destroyIncrementalBackup(task_backup_dir); !s.IsOK()) return s;
+  }
 
   std::string tmpdir = task_backup_dir + ".tmp";
   // Maybe there is a dirty tmp checkpoint, try to clean it
@@ -366,11 +785,126 @@ Status Storage::CreateBackup() {
   }
   // 'backup_mu_' can guarantee 'backup_creating_time_' is thread-safe
   backup_creating_time_ = static_cast<time_t>(Util::GetTimeStamp());
+  // The files of the checkpoint are hard linked if possible, so the copied bytes are unknown
+  uint64_t backup_size = 0;
+  std::vector<std::string> files;
+  env_->GetChildren(task_backup_dir, &files);
+  for (const auto &file : files) {
+    uint64_t size = 0;
+    if (env_->GetFileSize(task_backup_dir + "/" + file, &size).ok()) backup_size += size;
+  }
+  last_backup_size_ = static_cast<int64_t>(backup_size);
+  last_backup_copied_bytes_ = -1;
 
   LOG(INFO) << "[storage] Success to create new backup";
   return Status::OK();
 }
 
+bool Storage::isIncrementalBackup(const std::string &backup_dir) {
+  return env_->FileExists(backup_dir + "/meta").ok();
+}
+
+rocksdb::BackupEngineOptions Storage::incrementalBackupOptions(const std::string &backup_dir) {
+  rocksdb::BackupEngineOptions bk_option(backup_dir);
+  // The SST files are shared by the backups, and named by their checksums to be deduplicated
+  // even if the DB was restored from the master
+  bk_option.share_table_files = true;
+  bk_option.share_files_with_checksum = true;
+  bk_option.max_background_operations = config_->backup_threads;
+  if (config_->backup_max_io_mb > 0) {
+    bk_option.backup_rate_limit = static_cast<uint64_t>(config_->backup_max_io_mb) * MiB;
+  }
+  return bk_option;
+}
+
+Status Storage::createIncrementalBackup(const std::string &backup_dir) {
+  // The backup dir may be left by the checkpoint backups
+  if (env_->FileExists(backup_dir).ok() && !isIncrementalBackup(backup_dir)) {
+    if (auto s = rocksdb::DestroyDB(backup_dir, rocksdb::Options()); !s.ok()) {
+      LOG(WARNING) << "[storage] Fail to clean old backup, error:" << s.ToString();
+      return {Status::NotOK, s.ToString()};
+    }
+  }
+
+  rocksdb::BackupEngine *engine = nullptr;
+  auto s = rocksdb::BackupEngine::Open(env_, incrementalBackupOptions(backup_dir), &engine);
+  if (!s.ok()) return {Status::DBBackupErr, s.ToString()};
+  std::unique_ptr<rocksdb::BackupEngine> engine_guard(engine);
+
+  std::vector<rocksdb::BackupInfo> backup_infos;
+  engine->GetBackupInfo(&backup_infos, true);
+  std::set<std::string> existing_files;
+  for (const auto &info : backup_infos) {
+    for (const auto &file : info.file_details) existing_files.insert(file.relative_filename);
+  }
+
+  rocksdb::BackupID backup_id = 0;
+  s = engine->CreateNewBackup(rocksdb::CreateBackupOptions(), db_, &backup_id);
+  if (!s.ok()) {
+    LOG(WARNING) << "[storage] Fail to create incremental backup, error:" << s.ToString();
+    return {Status::DBBackupErr, s.ToString()};
+  }
+  backup_creating_time_ = static_cast<time_t>(Util::GetTimeStamp());
+
+  uint64_t backup_size = 0, copied_bytes = 0;
+  backup_infos.clear();
+  engine->GetBackupInfo(&backup_infos, true);
+  for (const auto &info : backup_infos) {
+    if (info.backup_id != backup_id) continue;
+    backup_size = info.size;
+    for (const auto &file : info.file_details) {
+      if (existing_files.count(file.relative_filename) == 0) copied_bytes += file.size;
+    }
+  }
+  last_backup_size_ = static_cast<int64_t>(backup_size);
+  last_backup_copied_bytes_ = static_cast<int64_t>(copied_bytes);
+  LOG(INFO) << "[storage] Success to create new incremental backup " << backup_id << ", copied " << copied_bytes
+            << " of " << backup_size << " bytes";
+  return Status::OK();
+}
+
+Status Storage::uploadBackup(const std::string &backup_dir) {
+  // Only the state of the uploader is kept in the backup dir, the local backups are useless then
+  if (isIncrementalBackup(backup_dir)) {
+    if (auto s = destroyIncrementalBackup(backup_dir); !s.IsOK()) return s;
+  } else if (env_->FileExists(backup_dir + "/CURRENT").ok()) {
+    rocksdb::DestroyDB(backup_dir, rocksdb::Options());
+  }
+  if (auto s = env_->CreateDirIfMissing(backup_dir); !s.ok()) return {Status::NotOK, s.ToString()};
+
+  BackupUploader::Options options;
+  options.command = config_->backup_upload_command;
+  options.state_file = backup_dir + "/uploaded_files";
+  options.threads = config_->backup_threads;
+  options.max_io_bytes_per_sec = static_cast<int64_t>(config_->backup_max_io_mb) * MiB;
+  options.wal_size_for_flush = config_->RocksDB.write_buffer_size * MiB;
+  BackupUploader uploader(env_, std::move(options));
+  BackupUploader::Result result;
+  if (auto s = uploader.Upload(db_, &result); !s.IsOK()) {
+    LOG(WARNING) << "[storage] Fail to upload the backup, error: " << s.Msg();
+    return {Status::DBBackupErr, s.Msg()};
+  }
+  backup_creating_time_ = static_cast<time_t>(Util::GetTimeStamp());
+  last_backup_size_ = static_cast<int64_t>(result.size);
+  last_backup_copied_bytes_ = static_cast<int64_t>(result.uploaded_bytes);
+  LOG(INFO) << "[storage] Success to upload the backup " << result.backup_id << ", uploaded " << result.uploaded_bytes
+            << " of " << result.size << " bytes";
+  return Status::OK();
+}
+
+Status Storage::destroyIncrementalBackup(const std::string &backup_dir) {
+  rocksdb::BackupEngine *engine = nullptr;
+  auto s = rocksdb::BackupEngine::Open(env_, incrementalBackupOptions(backup_dir), &engine);
+  if (!s.ok()) return {Status::DBBackupErr, s.ToString()};
+  std::unique_ptr<rocksdb::BackupEngine> engine_guard(engine);
+  if (!(s = engine->PurgeOldBackups(0)).ok()) return {Status::DBBackupErr, s.ToString()};
+  engine_guard.reset();
+  // Only the empty directories of the backup engine are left
+  for (const auto &dir : {"/meta", "/private", "/shared", "/shared_checksum"}) env_->DeleteDir(backup_dir + dir);
+  env_->DeleteDir(backup_dir);
+  return Status::OK();
+}
+
 Status Storage::DestroyBackup() {
   backup_->StopBackup();
   delete backup_;
@@ -384,11 +918,16 @@ Status Storage::RestoreFromBackup() {
   auto s = rocksdb::BackupEngine::Open(db_->GetEnv(), bk_option, &backup_);
   if (!s.ok()) return Status(Status::DBBackupErr, s.ToString());
 
+  // The files on the cold tier belong to the origin db which is replaced by the backup
+  if (auto s1 = clearColdTier(config_->RocksDB.subkey_cold_dir); !s1.IsOK()) {
+    LOG(ERROR) << "[storage] Failed to clear the cold tier: " << s1.Msg();
+  }
   s = backup_->RestoreDBFromLatestBackup(config_->db_dir, config_->db_dir);
   if (!s.ok()) {
     LOG(ERROR) << "[storage] Failed to restore: " << s.ToString();
   } else {
     LOG(INFO) << "[storage] Restore from backup";
+    if (auto s1 = linkColdTierFiles(); !s1.IsOK()) s = rocksdb::Status::IOError(s1.Msg());
   }
   // Reopen DB （should always try to reopen db even if restore failed , replication sst file crc check may use it）
   auto s2 = Open();
@@ -397,113 +936,998 @@ Status Storage::RestoreFromBackup() {
     return Status(Status::DBOpenErr, s2.Msg());
   }
 
-  // Clean up backup engine
-  backup_->PurgeOldBackups(0);
-  DestroyBackup();
-  backup_ = nullptr;
+  // Clean up backup engine
+  backup_->PurgeOldBackups(0);
+  DestroyBackup();
+  backup_ = nullptr;
+
+  return s.ok() ? Status::OK() : Status(Status::DBBackupErr, s.ToString());
+}
+
+Status Storage::RestoreFromCheckpoint() {
+  std::string dir = config_->sync_checkpoint_dir;
+  std::string tmp_dir = config_->db_dir + ".tmp";
+
+  // Clean old backups and checkpoints because server will work on the new db
+  PurgeOldBackups(0, 0);
+  rocksdb::DestroyDB(config_->checkpoint_dir, rocksdb::Options());
+
+  // Maybe there is no db dir
+  auto s = env_->CreateDirIfMissing(config_->db_dir);
+  if (!s.ok()) {
+    return Status(Status::NotOK, "Fail to create db dir, error: " + s.ToString());
+  }
+
+  // The files on the cold tier belong to the origin db as well, so they're moved aside together
+  const std::string &cold_dir = config_->RocksDB.subkey_cold_dir;
+  std::string tmp_cold_dir = cold_dir + ".tmp";
+  bool cold_dir_moved = false;
+  if (!cold_dir.empty() && env_->FileExists(cold_dir).ok()) {
+    clearColdTier(tmp_cold_dir);
+    if (!(s = env_->RenameFile(cold_dir, tmp_cold_dir)).ok()) {
+      if (!Open().IsOK()) LOG(ERROR) << "[storage] Fail to reopen db";
+      return Status(Status::NotOK, "Fail to rename cold dir, error: " + s.ToString());
+    }
+    cold_dir_moved = true;
+  }
+  auto restore_cold_dir = [&] {
+    clearColdTier(cold_dir);
+    if (cold_dir_moved) env_->RenameFile(tmp_cold_dir, cold_dir);
+  };
+
+  // Rename db dir to tmp, so we can restore if replica fails to load
+  // the checkpoint from master.
+  // But only try best effort to make data safe
+  s = env_->RenameFile(config_->db_dir, tmp_dir);
+  if (!s.ok()) {
+    restore_cold_dir();
+    if (!Open().IsOK()) LOG(ERROR) << "[storage] Fail to reopen db";
+    return Status(Status::NotOK, "Fail to rename db dir, error: " + s.ToString());
+  }
+
+  // Rename checkpoint dir to db dir
+  if (!(s = env_->RenameFile(dir, config_->db_dir)).ok()) {
+    env_->RenameFile(tmp_dir, config_->db_dir);
+    restore_cold_dir();
+    if (!Open().IsOK()) LOG(ERROR) << "[storage] Fail to reopen db";
+    return Status(Status::NotOK, "Fail to rename checkpoint dir, error: " + s.ToString());
+  }
+
+  // Open the new db, restore if replica fails to open db
+  auto s2 = linkColdTierFiles();
+  if (s2.IsOK()) s2 = Open();
+  if (!s2.IsOK()) {
+    LOG(WARNING) << "[storage] Fail to open master checkpoint, error: " << s2.Msg();
+    rocksdb::DestroyDB(config_->db_dir, rocksdb::Options());
+    env_->RenameFile(tmp_dir, config_->db_dir);
+    restore_cold_dir();
+    if (!Open().IsOK()) LOG(ERROR) << "[storage] Fail to reopen db";
+    return Status(Status::DBOpenErr, "Fail to open master checkpoint, error: " + s2.Msg());
+  }
+
+  // Destory origin db
+  if (!(s = rocksdb::DestroyDB(tmp_dir, rocksdb::Options())).ok()) {
+    LOG(WARNING) << "[storage] Fail to destroy " << tmp_dir << ", error:" << s.ToString();
+  }
+  if (cold_dir_moved) {
+    if (auto s3 = clearColdTier(tmp_cold_dir); !s3.IsOK()) {
+      LOG(WARNING) << "[storage] Fail to destroy " << tmp_cold_dir << ", error:" << s3.Msg();
+    }
+  }
+  return Status::OK();
+}
+
+Status Storage::RestoreFromLocalBackup(const std::string &backup_dir) {
+  // The backup is prepared in the sync checkpoint dir like the one fetched from the master
+  const std::string &dir = config_->sync_checkpoint_dir;
+  rocksdb::DestroyDB(dir, rocksdb::Options());
+  if (isIncrementalBackup(backup_dir)) {
+    rocksdb::BackupEngineReadOnly *engine = nullptr;
+    auto s = rocksdb::BackupEngineReadOnly::Open(env_, rocksdb::BackupEngineOptions(backup_dir), &engine);
+    if (!s.ok()) return {Status::DBBackupErr, "Fail to open the backups, error: " + s.ToString()};
+    std::unique_ptr<rocksdb::BackupEngineReadOnly> engine_guard(engine);
+    if (!(s = engine->RestoreDBFromLatestBackup(dir, dir)).ok()) {
+      return {Status::DBBackupErr, "Fail to restore the latest backup, error: " + s.ToString()};
+    }
+  } else if (auto s = copyCheckpoint(backup_dir, dir); !s.IsOK()) {
+    rocksdb::DestroyDB(dir, rocksdb::Options());
+    return s;
+  }
+  return RestoreFromCheckpoint();
+}
+
+Status Storage::copyCheckpoint(const std::string &from, const std::string &to) {
+  std::vector<std::string> files;
+  auto s = env_->GetChildren(from, &files);
+  if (!s.ok()) return {Status::NotOK, "Fail to list the backup, error: " + s.ToString()};
+  if (!(s = env_->CreateDirIfMissing(to)).ok()) return {Status::NotOK, s.ToString()};
+
+  auto has_suffix = [](const std::string &file, const std::string &suffix) {
+    return file.size() >= suffix.size() && file.compare(file.size() - suffix.size(), suffix.size(), suffix) == 0;
+  };
+  std::string scratch(MiB, '\0');
+  for (const auto &file : files) {
+    if (file == "." || file == "..") continue;
+    std::string src = from + "/" + file, dst = to + "/" + file;
+    if ((has_suffix(file, ".sst") || has_suffix(file, ".blob")) && env_->LinkFile(src, dst).ok()) continue;
+
+    // The MANIFEST and the WALs may be rewritten by the restored DB, so they aren't linked
+    std::unique_ptr<rocksdb::SequentialFile> reader;
+    std::unique_ptr<rocksdb::WritableFile> writer;
+    if (!(s = env_->NewSequentialFile(src, &reader, rocksdb::EnvOptions())).ok() ||
+        !(s = env_->NewWritableFile(dst, &writer, rocksdb::EnvOptions())).ok()) {
+      return {Status::NotOK, "Fail to copy " + file + ", error: " + s.ToString()};
+    }
+    rocksdb::Slice data;
+    while ((s = reader->Read(scratch.size(), &data, scratch.data())).ok() && !data.empty()) {
+      if (!(s = writer->Append(data)).ok()) break;
+    }
+    if (s.ok()) s = writer->Sync();
+    if (s.ok()) s = writer->Close();
+    if (!s.ok()) return {Status::NotOK, "Fail to copy " + file + ", error: " + s.ToString()};
+  }
+  return Status::OK();
+}
+
+Status Storage::linkColdTierFiles() {
+  const std::string &cold_dir = config_->RocksDB.subkey_cold_dir;
+  if (cold_dir.empty()) return Status::OK();
+
+  auto s = env_->CreateDirIfMissing(cold_dir);
+  if (!s.ok()) return {Status::NotOK, s.ToString()};
+  std::string db_dir;
+  if (!(s = env_->GetAbsolutePath(config_->db_dir, &db_dir)).ok()) return {Status::NotOK, s.ToString()};
+  std::vector<std::string> files;
+  if (!(s = env_->GetChildren(db_dir, &files)).ok()) return {Status::NotOK, s.ToString()};
+  // RocksDB only matches the number of the SST files while purging the obsolete files, so
+  // the file in the db dir and its link are both kept until the file is compacted
+  for (const auto &file : files) {
+    if (file.size() < 4 || file.compare(file.size() - 4, 4, ".sst") != 0) continue;
+    std::string link = cold_dir + "/" + file;
+    if (env_->FileExists(link).ok()) continue;
+    if (symlink((db_dir + "/" + file).c_str(), link.c_str()) != 0) {
+      return {Status::NotOK, "Fail to link " + file + " into the cold dir: " + strerror(errno)};
+    }
+  }
+  return Status::OK();
+}
+
+Status Storage::clearColdTier(const std::string &cold_dir) {
+  if (cold_dir.empty() || !env_->FileExists(cold_dir).ok()) return Status::OK();
+
+  std::vector<std::string> files;
+  auto s = env_->GetChildren(cold_dir, &files);
+  if (!s.ok()) return {Status::NotOK, s.ToString()};
+  for (const auto &file : files) {
+    if (file == "." || file == "..") continue;
+    if (!(s = env_->DeleteFile(cold_dir + "/" + file)).ok()) return {Status::NotOK, s.ToString()};
+  }
+  s = env_->DeleteDir(cold_dir);
+  if (!s.ok()) return {Status::NotOK, s.ToString()};
+  return Status::OK();
+}
+
+std::string Storage::liveFilePath(const std::string &file) {
+  std::string path = config_->db_dir + "/" + file;
+  if (!config_->RocksDB.subkey_cold_dir.empty() && !env_->FileExists(path).ok()) {
+    path = config_->RocksDB.subkey_cold_dir + "/" + file;
+  }
+  return path;
+}
+
+bool Storage::GetStorageTierStats(std::array<StorageTierStats, kNumStorageTiers> *stats) {
+  if (!tiered_fs_) return false;
+
+  std::vector<rocksdb::LiveFileMetaData> files;
+  db_->GetLiveFilesMetaData(&files);
+  for (const auto &file : files) {
+    (*stats)[tiered_fs_->TierOf(file.db_path)].size += file.size;
+  }
+  for (size_t tier = 0; tier < kNumStorageTiers; tier++) {
+    const auto &read_stats = tiered_fs_->GetReadStats(static_cast<StorageTier>(tier));
+    (*stats)[tier].reads = read_stats.reads;
+    (*stats)[tier].read_micros = read_stats.read_micros;
+  }
+  return true;
+}
+
+void Storage::EmptyDB() {
+  // Clean old backups and checkpoints
+  PurgeOldBackups(0, 0);
+  rocksdb::DestroyDB(config_->checkpoint_dir, rocksdb::Options());
+
+  auto s = rocksdb::DestroyDB(config_->db_dir, rocksdb::Options());
+  if (!s.ok()) {
+    LOG(ERROR) << "[storage] Failed to destroy db, error: " << s.ToString();
+  }
+}
+
+void Storage::PurgeOldBackups(uint32_t num_backups_to_keep, uint32_t backup_max_keep_hours) {
+  time_t now = time(nullptr);
+  std::lock_guard<std::mutex> lg(config_->backup_mu_);
+  std::string task_backup_dir = config_->backup_dir;
+
+  // Return if there is no backup
+  auto s = env_->FileExists(task_backup_dir);
+  if (!s.ok()) return;
+
+  if (isIncrementalBackup(task_backup_dir)) {
+    bool expired = backup_max_keep_hours != 0 && backup_creating_time_ + backup_max_keep_hours * 3600 < now;
+    if (num_backups_to_keep == 0 || expired) {
+      auto s1 = destroyIncrementalBackup(task_backup_dir);
+      LOG(INFO) << "[storage] Clean the incremental backups that were born at " << backup_creating_time_
+                << ", result: " << s1.Msg();
+      return;
+    }
+    rocksdb::BackupEngine *engine = nullptr;
+    s = rocksdb::BackupEngine::Open(env_, incrementalBackupOptions(task_backup_dir), &engine);
+    if (s.ok()) {
+      s = engine->PurgeOldBackups(num_backups_to_keep);
+      delete engine;
+    }
+    if (!s.ok()) LOG(WARNING) << "[storage] Failed to purge the old incremental backups: " << s.ToString();
+    return;
+  }
+
+  // No backup is needed to keep or the backup is expired, we will clean it.
+  if (num_backups_to_keep == 0 ||
+      (backup_max_keep_hours != 0 && backup_creating_time_ + backup_max_keep_hours * 3600 < now)) {
+    s = rocksdb::DestroyDB(task_backup_dir, rocksdb::Options());
+    if (s.ok()) {
+      LOG(INFO) << "[storage] Succeeded cleaning old backup that was born at " << backup_creating_time_;
+    } else {
+      LOG(INFO) << "[storage] Failed cleaning old backup that was born at " << backup_creating_time_;
+    }
+  }
+}
+
+Status Storage::GetWALIter(rocksdb::SequenceNumber seq, std::unique_ptr<rocksdb::TransactionLogIterator> *iter) {
+  auto s = db_->GetUpdatesSince(seq, iter);
+  if (!s.ok()) return Status(Status::DBGetWALErr, s.ToString());
+  if (!(*iter)->Valid()) return Status(Status::DBGetWALErr, "iterator not valid");
+  return Status::OK();
+}
+
+rocksdb::SequenceNumber Storage::LatestSeq() { return db_->GetLatestSequenceNumber(); }
+
+StatusOr<size_t> Storage::PurgeArchivedWALs(rocksdb::SequenceNumber min_retained_seq, uint64_t max_bytes) {
+  rocksdb::VectorLogPtr files;
+  auto s = db_->GetSortedWalFiles(files);
+  if (!s.ok()) return {Status::NotOK, s.ToString()};
+
+  uint64_t archived_bytes = 0;
+  for (const auto &file : files) {
+    if (file->Type() == rocksdb::kArchivedLogFile) archived_bytes += file->SizeFileBytes();
+  }
+  // The files are sorted by the log number, so the archived ones are older than the alive ones
+  size_t purged = 0;
+  for (size_t i = 0; i < files.size() && files[i]->Type() == rocksdb::kArchivedLogFile; i++) {
+    // The batches of the file are all before the start of the next one, the empty files aren't listed
+    rocksdb::SequenceNumber next_seq = i + 1 < files.size() ? files[i + 1]->StartSequence() : LatestSeq() + 1;
+    bool unneeded = next_seq <= min_retained_seq;
+    if (!unneeded && archived_bytes <= max_bytes) break;
+    s = db_->DeleteFile(files[i]->PathName());
+    if (!s.ok()) return {Status::NotOK, s.ToString()};
+    archived_bytes -= files[i]->SizeFileBytes();
+    purged++;
+  }
+  return purged;
+}
+
+bool Storage::WaitForWALData(rocksdb::SequenceNumber seq, int64_t timeout_us) {
+  if (WALHasNewData(seq)) return true;
+
+  // The writer checks the waiters after the write, so either the writer sees the waiter
+  // or the waiter sees the written data while holding the lock
+  wal_waiters_++;
+  std::unique_lock<std::mutex> lock(wal_wait_mu_);
+  bool has_new_data = wal_wait_cv_.wait_for(lock, std::chrono::microseconds(timeout_us),
+                                            [this, seq] { return WALHasNewData(seq); });
+  wal_waiters_--;
+  return has_new_data;
+}
+
+bool Storage::ArmWALWakeup(int fd, rocksdb::SequenceNumber seq) {
+  // Just like WaitForWALData, either the writer sees the armed fd or it sees the written data
+  wal_wakeup_fd_ = fd;
+  if (!WALHasNewData(seq)) return true;
+  wal_wakeup_fd_.compare_exchange_strong(fd, -1);
+  return false;
+}
+
+void Storage::UpdateWriteStallCondition(rocksdb::WriteStallCondition prev, rocksdb::WriteStallCondition cur) {
+  if (prev == rocksdb::WriteStallCondition::kDelayed) write_delayed_cfs_--;
+  if (cur == rocksdb::WriteStallCondition::kDelayed) write_delayed_cfs_++;
+  if (prev == rocksdb::WriteStallCondition::kStopped) {
+    std::lock_guard<std::mutex> guard(write_stall_mu_);
+    if (--write_stopped_cfs_ == 0) write_stall_cv_.notify_all();
+  }
+  if (cur == rocksdb::WriteStallCondition::kStopped) write_stopped_cfs_++;
+}
+
+bool Storage::WaitForWriteStallEnd(int64_t timeout_ms) {
+  if (!IsWriteStopped()) return true;
+  if (timeout_ms <= 0) return false;
+
+  std::unique_lock<std::mutex> lock(write_stall_mu_);
+  return write_stall_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return !IsWriteStopped(); });
+}
+
+void Storage::notifyWALWaiters() {
+  // Order the written sequence number before checking the waiters
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (int fd = wal_wakeup_fd_ == -1 ? -1 : wal_wakeup_fd_.exchange(-1); fd != -1) {
+    // The event loop drains the fd, it also wakes up by its timer if the write failed
+    [[maybe_unused]] ssize_t n = write(fd, "", 1);
+  }
+  if (wal_waiters_ == 0) return;
+  std::lock_guard<std::mutex> guard(wal_wait_mu_);
+  wal_wait_cv_.notify_all();
+}
+
+// The deferred sync state of the current thread, see Storage::BeginDeferredSync
+struct DeferredSyncState {
+  bool deferring = false;
+  bool has_unsynced_writes = false;
+};
+static thread_local DeferredSyncState deferred_sync;
+
+// The writes buffered by the transaction of the current thread, see Storage::BeginTxn
+static thread_local std::unique_ptr<rocksdb::WriteBatchWithIndex> txn_batch;
+
+rocksdb::Status Storage::Write(const rocksdb::WriteOptions &options, rocksdb::WriteBatch *updates) {
+  if (reach_db_size_limit_) {
+    return rocksdb::Status::SpaceLimit();
+  }
+
+  if (txn_batch) {
+    class TxnBatchAppender : public rocksdb::WriteBatch::Handler {
+     public:
+      TxnBatchAppender(rocksdb::WriteBatchWithIndex *batch, Storage *storage) : batch_(batch), storage_(storage) {}
+      // The reads in the transaction see the buffered writes by the routed column families
+      rocksdb::Status PutCF(uint32_t column_family_id, const Slice &key, const Slice &value) override {
+        return batch_->Put(handleOf(column_family_id, key), key, value);
+      }
+      rocksdb::Status DeleteCF(uint32_t column_family_id, const Slice &key) override {
+        return batch_->Delete(handleOf(column_family_id, key), key);
+      }
+      rocksdb::Status SingleDeleteCF(uint32_t column_family_id, const Slice &key) override {
+        return batch_->SingleDelete(handleOf(column_family_id, key), key);
+      }
+      rocksdb::Status MergeCF(uint32_t column_family_id, const Slice &key, const Slice &value) override {
+        return batch_->Merge(handleOf(column_family_id, key), key, value);
+      }
+      // The indexed batch can't serve the reads of the deleted range, so the keys in the range seen
+      // by the transaction are deleted one by one instead. They're collected before being deleted,
+      // since the batch mustn't be written while it's iterated.
+      rocksdb::Status DeleteRangeCF(uint32_t column_family_id, const Slice &begin_key,
+                                    const Slice &end_key) override {
+        rocksdb::ReadOptions read_options;
+        read_options.iterate_lower_bound = &begin_key;
+        read_options.iterate_upper_bound = &end_key;
+        std::vector<std::string> keys;
+        {
+          std::unique_ptr<rocksdb::Iterator> iter(
+              storage_->NewIterator(read_options, (*storage_->GetCFHandles())[column_family_id]));
+          for (iter->Seek(begin_key); iter->Valid(); iter->Next()) keys.emplace_back(iter->key().ToString());
+          if (!iter->status().ok()) return iter->status();
+        }
+        auto cf_handle = handleOf(column_family_id, begin_key);
+        for (const auto &key : keys) {
+          auto s = batch_->Delete(cf_handle, key);
+          if (!s.ok()) return s;
+        }
+        return rocksdb::Status::OK();
+      }
+      void LogData(const Slice &blob) override { batch_->PutLogData(blob); }
+
+     private:
+      rocksdb::ColumnFamilyHandle *handleOf(uint32_t column_family_id, const Slice &key) {
+        return storage_->RouteCFHandle((*storage_->GetCFHandles())[column_family_id], key);
+      }
+
+      rocksdb::WriteBatchWithIndex *batch_;
+      Storage *storage_;
+    };
+    // The TTL index, the key counting and the replication id are handled while committing.
+    // The batch is appended entirely or not at all, otherwise the transaction would commit
+    // the part of the command appended before the failure.
+    TxnBatchAppender appender(txn_batch.get(), this);
+    txn_batch->SetSavePoint();
+    auto s = updates->Iterate(&appender);
+    if (!s.ok()) {
+      txn_batch->RollbackToSavePoint();
+      return s;
+    }
+    return txn_batch->PopSavePoint();
+  }
+
+  if (config_->active_expire_enabled) appendTTLIndex(updates);
+
+  KeyCounter::Changes key_count_changes;
+  if (config_->key_count_tracking) {
+    auto s = key_counter_.Collect(db_, metadataCFHandleOf(), updates, &key_count_changes);
+    if (!s.ok()) return s;
+  }
+
+  // Put replication id logdata at the end of write batch
+  if (auto replid = GetReplId(); replid.length() == kReplIdLength) {
+    updates->PutLogData(ServerLogData(kReplIdLog, replid).Encode());
+  }
+
+  // Only the written batch is routed, the others see the shared column families
+  rocksdb::WriteBatch routed_batch;
+  auto write_batch = updates;
+  if (!namespace_cfs_.empty()) {
+    bool changed = false;
+    auto s = rewriteBatchCFs(updates, true, &routed_batch, &changed);
+    if (!s.ok()) return s;
+    if (changed) write_batch = &routed_batch;
+  }
+
+  // The written metadata must be erased from the cache after the write was applied,
+  // see MetadataCache for details. Erase them even if failed to write, just in case.
+  auto exit = MakeScopeExit([this, updates] {
+    if (metadata_cache_.Enabled()) invalidateMetadataCache(updates);
+  });
+
+  rocksdb::Status s;
+  if (options.sync && !options.disableWAL && deferred_sync.deferring) {
+    rocksdb::WriteOptions deferred_options = options;
+    deferred_options.sync = false;
+    s = db_->Write(deferred_options, write_batch);
+    if (s.ok()) deferred_sync.has_unsynced_writes = true;
+  } else {
+    s = db_->Write(options, write_batch);
+  }
+  if (s.ok() && !key_count_changes.Empty()) key_counter_.Apply(key_count_changes);
+  if (s.ok() && big_keys_.Enabled()) updateBigKeys(updates);
+  if (s.ok() && namespace_sizes_.Enabled()) updateNamespaceSizes(updates);
+  if (s.ok()) notifyWALWaiters();
+  return s;
+}
+
+void Storage::invalidateMetadataCache(rocksdb::WriteBatch *batch) {
+  class MetadataCacheInvalidator : public rocksdb::WriteBatch::Handler {
+   public:
+    explicit MetadataCacheInvalidator(MetadataCache *cache) : cache_(cache) {}
+    rocksdb::Status PutCF(uint32_t column_family_id, const Slice &key, const Slice &value) override {
+      if (column_family_id == kColumnFamilyIDMetadata) cache_->Erase(key);
+      return rocksdb::Status::OK();
+    }
+    rocksdb::Status DeleteCF(uint32_t column_family_id, const rocksdb::Slice &key) override {
+      if (column_family_id == kColumnFamilyIDMetadata) cache_->Erase(key);
+      return rocksdb::Status::OK();
+    }
+    rocksdb::Status SingleDeleteCF(uint32_t column_family_id, const rocksdb::Slice &key) override {
+      if (column_family_id == kColumnFamilyIDMetadata) cache_->Erase(key);
+      return rocksdb::Status::OK();
+    }
+    rocksdb::Status MergeCF(uint32_t column_family_id, const Slice &key, const Slice &value) override {
+      if (column_family_id == kColumnFamilyIDMetadata) cache_->Erase(key);
+      return rocksdb::Status::OK();
+    }
+    rocksdb::Status DeleteRangeCF(uint32_t column_family_id, const rocksdb::Slice &begin_key,
+                                  const rocksdb::Slice &end_key) override {
+      if (column_family_id == kColumnFamilyIDMetadata) cache_->Clear();
+      return rocksdb::Status::OK();
+    }
+
+   private:
+    MetadataCache *cache_;
+  };
+
+  MetadataCacheInvalidator invalidator(&metadata_cache_);
+  auto s = batch->Iterate(&invalidator);
+  if (!s.ok()) {
+    // Shouldn't happen, but clear all to keep the cache coherent
+    LOG(WARNING) << "[storage] Failed to iterate the write batch to invalidate the metadata cache: " << s.ToString();
+    metadata_cache_.Clear();
+  }
+}
+
+void Storage::updateBigKeys(rocksdb::WriteBatch *batch) {
+  class BigKeysUpdater : public rocksdb::WriteBatch::Handler {
+   public:
+    BigKeysUpdater(BigKeys *big_keys, bool slot_id_encoded) : big_keys_(big_keys), slot_id_encoded_(slot_id_encoded) {}
+    rocksdb::Status PutCF(uint32_t column_family_id, const Slice &key, const Slice &value) override {
+      if (column_family_id != kColumnFamilyIDMetadata) return rocksdb::Status::OK();
+      std::string ns, user_key;
+      ExtractNamespaceKey(key, &ns, &user_key, slot_id_encoded_);
+      big_keys_->UpdateByMetadata(ns, user_key, value);
+      return rocksdb::Status::OK();
+    }
+    rocksdb::Status DeleteCF(uint32_t column_family_id, const rocksdb::Slice &key) override {
+      if (column_family_id != kColumnFamilyIDMetadata) return rocksdb::Status::OK();
+      std::string ns, user_key;
+      ExtractNamespaceKey(key, &ns, &user_key, slot_id_encoded_);
+      big_keys_->Remove(ns, user_key);
+      return rocksdb::Status::OK();
+    }
+    rocksdb::Status SingleDeleteCF(uint32_t column_family_id, const rocksdb::Slice &key) override {
+      return DeleteCF(column_family_id, key);
+    }
+    rocksdb::Status DeleteRangeCF(uint32_t column_family_id, const rocksdb::Slice &begin_key,
+                                  const rocksdb::Slice &end_key) override {
+      // The deleted keys would be found by the next scan
+      if (column_family_id == kColumnFamilyIDMetadata) big_keys_->Clear();
+      return rocksdb::Status::OK();
+    }
+
+   private:
+    BigKeys *big_keys_;
+    bool slot_id_encoded_;
+  };
+
+  BigKeysUpdater updater(&big_keys_, config_->slot_id_encoded);
+  auto s = batch->Iterate(&updater);
+  if (!s.ok()) LOG(WARNING) << "[storage] Failed to iterate the write batch to update the big keys: " << s.ToString();
+}
+
+void Storage::updateNamespaceSizes(rocksdb::WriteBatch *batch) {
+  // The consecutive writes of the same namespace are added together, which are the most batches
+  class NamespaceSizesUpdater : public rocksdb::WriteBatch::Handler {
+   public:
+    explicit NamespaceSizesUpdater(NamespaceSizes *sizes) : sizes_(sizes) {}
+    rocksdb::Status PutCF(uint32_t column_family_id, const Slice &key, const Slice &value) override {
+      add(column_family_id, key, key.size() + value.size());
+      return rocksdb::Status::OK();
+    }
+    rocksdb::Status MergeCF(uint32_t column_family_id, const Slice &key, const Slice &value) override {
+      add(column_family_id, key, key.size() + value.size());
+      return rocksdb::Status::OK();
+    }
+    // The tombstones take the space too until they're compacted
+    rocksdb::Status DeleteCF(uint32_t column_family_id, const rocksdb::Slice &key) override {
+      add(column_family_id, key, key.size());
+      return rocksdb::Status::OK();
+    }
+    rocksdb::Status SingleDeleteCF(uint32_t column_family_id, const rocksdb::Slice &key) override {
+      return DeleteCF(column_family_id, key);
+    }
+    rocksdb::Status DeleteRangeCF(uint32_t column_family_id, const rocksdb::Slice &begin_key,
+                                  const rocksdb::Slice &end_key) override {
+      return rocksdb::Status::OK();
+    }
+    void Flush() {
+      if (bytes_ > 0) sizes_->Add(ns_, bytes_);
+      bytes_ = 0;
+    }
+
+   private:
+    void add(uint32_t column_family_id, const Slice &key, uint64_t bytes) {
+      // The pubsub and the propagated messages don't belong to any namespace
+      if (column_family_id == kColumnFamilyIDPubSub || column_family_id == kColumnFamilyIDPropagate) return;
+      if (key.empty()) return;
+      auto ns_size = static_cast<uint8_t>(key[0]);
+      if (key.size() < 1 + static_cast<size_t>(ns_size)) return;
+      Slice ns(key.data() + 1, ns_size);
+      if (ns != Slice(ns_)) {
+        Flush();
+        ns_.assign(ns.data(), ns.size());
+      }
+      bytes_ += bytes;
+    }
+
+    NamespaceSizes *sizes_;
+    std::string ns_;
+    uint64_t bytes_ = 0;
+  };
+
+  NamespaceSizesUpdater updater(&namespace_sizes_);
+  auto s = batch->Iterate(&updater);
+  if (!s.ok()) {
+    LOG(WARNING) << "[storage] Failed to iterate the write batch to update the namespace sizes: " << s.ToString();
+  }
+  updater.Flush();
+}
+
+void Storage::appendTTLIndex(rocksdb::WriteBatch *batch) {
+  class TTLIndexCollector : public rocksdb::WriteBatch::Handler {
+   public:
+    rocksdb::Status PutCF(uint32_t column_family_id, const Slice &key, const Slice &value) override {
+      // The metadata value begins with 1 byte flags and 4 bytes expire timestamp
+      if (column_family_id != kColumnFamilyIDMetadata || value.size() < 5) return rocksdb::Status::OK();
+      uint32_t expire = 0;
+      if ((value[0] & kMetadataCompactEncoded) != 0) {
+        // The expire of the compact encoding is relative to the version, decode it as a whole
+        Metadata metadata(kRedisNone, false);
+        if (!metadata.Decode(value.ToString()).ok()) return rocksdb::Status::OK();
+        expire = static_cast<uint32_t>(metadata.expire);
+      } else {
+        expire = DecodeFixed32(value.data() + 1);
+      }
+      if (expire == 0) return rocksdb::Status::OK();
+      std::string index_key;
+      PutFixed32(&index_key, expire);
+      index_key.append(key.data(), key.size());
+      index_keys.emplace_back(std::move(index_key));
+      return rocksdb::Status::OK();
+    }
+    rocksdb::Status DeleteCF(uint32_t column_family_id, const rocksdb::Slice &key) override {
+      return rocksdb::Status::OK();
+    }
+    rocksdb::Status SingleDeleteCF(uint32_t column_family_id, const rocksdb::Slice &key) override {
+      return rocksdb::Status::OK();
+    }
+    rocksdb::Status MergeCF(uint32_t column_family_id, const Slice &key, const Slice &value) override {
+      return rocksdb::Status::OK();
+    }
+    rocksdb::Status DeleteRangeCF(uint32_t column_family_id, const rocksdb::Slice &begin_key,
+                                  const rocksdb::Slice &end_key) override {
+      return rocksdb::Status::OK();
+    }
+
+    std::vector<std::string> index_keys;
+  };
+
+  TTLIndexCollector collector;
+  auto s = batch->Iterate(&collector);
+  if (!s.ok()) {
+    // The keys missing in the TTL index would be expired lazily as before
+    LOG(WARNING) << "[storage] Failed to iterate the write batch to build the TTL index: " << s.ToString();
+    return;
+  }
+  // The stale index entries, e.g. of the persisted keys, would be dropped by the reaper
+  auto cf_handle = GetCFHandle(kTTLIndexColumnFamilyName);
+  for (const auto &index_key : collector.index_keys) {
+    batch->Put(cf_handle, index_key, Slice());
+  }
+}
+
+bool Storage::BeginTxn() {
+  if (txn_batch) return false;
+  // Overwrite the key in the index so that the iterators never see it twice
+  txn_batch = std::make_unique<rocksdb::WriteBatchWithIndex>(rocksdb::BytewiseComparator(), 0, true);
+  return true;
+}
+
+rocksdb::Status Storage::CommitTxn() {
+  auto batch = std::move(txn_batch);
+  if (!batch || batch->GetWriteBatch()->Count() == 0) return rocksdb::Status::OK();
+  if (failing_txn_commits_.load() > 0 && failing_txn_commits_.fetch_sub(1) > 0) {
+    return rocksdb::Status::IOError("the commit was failed by DEBUG FAIL-TXN-COMMIT");
+  }
+  // The buffered writes were routed already, and they're routed again while writing
+  auto updates = batch->GetWriteBatch();
+  rocksdb::WriteBatch shared_batch;
+  if (!namespace_cfs_.empty()) {
+    bool changed = false;
+    auto s = rewriteBatchCFs(updates, false, &shared_batch, &changed);
+    if (!s.ok()) return s;
+    if (changed) updates = &shared_batch;
+  }
+  return Write(write_opts_, updates);
+}
+
+bool Storage::InTxn() { return txn_batch != nullptr; }
+
+void Storage::AddWritingVersion(uint64_t version, rocksdb::WriteBatch *batch) {
+  registerWritingVersion(version, true);
+  batch->Put(cf_handles_[kColumnFamilyIDPropagate], writingVersionKey(version), "");
+}
+
+void Storage::RemoveWritingVersion(uint64_t version, rocksdb::WriteBatch *batch) {
+  batch->Delete(cf_handles_[kColumnFamilyIDPropagate], writingVersionKey(version));
+}
+
+void Storage::ReleaseWritingVersion(uint64_t version, bool removed) {
+  std::lock_guard<std::mutex> guard(writing_versions_mu_);
+  releaseWritingVersion(version, removed);
+}
+
+Status Storage::PurgeStaleWritingVersions() {
+  rocksdb::WriteBatch batch;
+  std::vector<uint64_t> stale_versions;
+  {
+    std::lock_guard<std::mutex> guard(writing_versions_mu_);
+    for (const auto &[version, writing] : writing_versions_) {
+      if (writing.local || writing.removed_epoch != 0) continue;
+      stale_versions.emplace_back(version);
+      RemoveWritingVersion(version, &batch);
+    }
+  }
+  if (stale_versions.empty()) return Status::OK();
+  // The deletion is replicated, so the replicas release the versions as well
+  auto s = Write(write_opts_, &batch);
+  if (!s.ok()) return Status(Status::NotOK, "failed to purge the writing version markers: " + s.ToString());
+  std::lock_guard<std::mutex> guard(writing_versions_mu_);
+  for (auto version : stale_versions) {
+    auto iter = writing_versions_.find(version);
+    // The version may be reused by a local writer in the meantime
+    if (iter != writing_versions_.end() && !iter->second.local) releaseWritingVersion(version, true);
+  }
+  LOG(INFO) << "[storage] Purged " << stale_versions.size() << " stale writing version markers";
+  return Status::OK();
+}
+
+bool Storage::IsWritingVersion(uint64_t version, uint64_t filter_epoch) {
+  if (writing_versions_count_ == 0) return false;
+  std::lock_guard<std::mutex> guard(writing_versions_mu_);
+  auto iter = writing_versions_.find(version);
+  if (iter == writing_versions_.end()) return false;
+  // The filter created after the version was finished sees its metadata
+  return iter->second.removed_epoch == 0 || iter->second.removed_epoch > filter_epoch;
+}
+
+uint64_t Storage::RegisterCompactionFilter() {
+  std::lock_guard<std::mutex> guard(writing_versions_mu_);
+  uint64_t filter_epoch = ++writing_versions_epoch_;
+  compaction_filter_epochs_.emplace(filter_epoch);
+  return filter_epoch;
+}
+
+void Storage::UnregisterCompactionFilter(uint64_t filter_epoch) {
+  std::lock_guard<std::mutex> guard(writing_versions_mu_);
+  auto iter = compaction_filter_epochs_.find(filter_epoch);
+  if (iter != compaction_filter_epochs_.end()) compaction_filter_epochs_.erase(iter);
+  gcWritingVersions();
+}
+
+rocksdb::Status Storage::loadWritingVersions() {
+  {
+    std::lock_guard<std::mutex> guard(writing_versions_mu_);
+    writing_versions_.clear();
+    writing_versions_count_ = 0;
+  }
+  rocksdb::ReadOptions read_opts;
+  read_opts.fill_cache = false;
+  std::unique_ptr<rocksdb::Iterator> iter(db_->NewIterator(read_opts, cf_handles_[kColumnFamilyIDPropagate]));
+  size_t count = 0;
+  for (iter->Seek(kPropagateWritingVersion); iter->Valid() && iter->key().starts_with(kPropagateWritingVersion);
+       iter->Next()) {
+    uint64_t version = 0;
+    if (!parseWritingVersionKey(iter->key(), &version)) continue;
+    // The writers of the markers are gone, they're purged by the master later
+    registerWritingVersion(version, false);
+    count++;
+  }
+  if (count > 0) LOG(INFO) << "[storage] Loaded " << count << " writing version markers";
+  return iter->status();
+}
+
+void Storage::registerWritingVersion(uint64_t version, bool local) {
+  std::lock_guard<std::mutex> guard(writing_versions_mu_);
+  auto &writing = writing_versions_[version];
+  writing.removed_epoch = 0;
+  writing.local = writing.local || local;
+  writing_versions_count_ = writing_versions_.size();
+}
+
+void Storage::releaseWritingVersion(uint64_t version, bool removed) {
+  auto iter = writing_versions_.find(version);
+  if (iter == writing_versions_.end()) return;
+  iter->second.local = false;
+  if (removed) iter->second.removed_epoch = ++writing_versions_epoch_;
+  gcWritingVersions();
+}
+
+void Storage::gcWritingVersions() {
+  // The finished versions are only needed by the filters created before they finished
+  uint64_t oldest_filter = compaction_filter_epochs_.empty() ? UINT64_MAX : *compaction_filter_epochs_.begin();
+  for (auto iter = writing_versions_.begin(); iter != writing_versions_.end();) {
+    if (iter->second.removed_epoch != 0 && iter->second.removed_epoch < oldest_filter) {
+      iter = writing_versions_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  writing_versions_count_ = writing_versions_.size();
+}
+
+static thread_local const rocksdb::Snapshot *pinned_snapshot = nullptr;
 
-  return s.ok() ? Status::OK() : Status(Status::DBBackupErr, s.ToString());
+bool Storage::PinSnapshot() {
+  if (pinned_snapshot) return false;
+  pinned_snapshot = db_->GetSnapshot();
+  return true;
 }
 
-Status Storage::RestoreFromCheckpoint() {
-  std::string dir = config_->sync_checkpoint_dir;
-  std::string tmp_dir = config_->db_dir + ".tmp";
+void Storage::UnpinSnapshot() {
+  if (!pinned_snapshot) return;
+  db_->ReleaseSnapshot(pinned_snapshot);
+  pinned_snapshot = nullptr;
+}
 
-  // Clean old backups and checkpoints because server will work on the new db
-  PurgeOldBackups(0, 0);
-  rocksdb::DestroyDB(config_->checkpoint_dir, rocksdb::Options());
+const rocksdb::Snapshot *Storage::GetPinnedSnapshot() { return pinned_snapshot; }
 
-  // Maybe there is no db dir
-  auto s = env_->CreateDirIfMissing(config_->db_dir);
-  if (!s.ok()) {
-    return Status(Status::NotOK, "Fail to create db dir, error: " + s.ToString());
-  }
+struct CacheOnlyReadsState {
+  bool enabled = false;
+  bool missed = false;
+};
 
-  // Rename db dir to tmp, so we can restore if replica fails to load
-  // the checkpoint from master.
-  // But only try best effort to make data safe
-  s = env_->RenameFile(config_->db_dir, tmp_dir);
-  if (!s.ok()) {
-    if (!Open().IsOK()) LOG(ERROR) << "[storage] Fail to reopen db";
-    return Status(Status::NotOK, "Fail to rename db dir, error: " + s.ToString());
-  }
+static thread_local CacheOnlyReadsState cache_only_reads;
 
-  // Rename checkpoint dir to db dir
-  if (!(s = env_->RenameFile(dir, config_->db_dir)).ok()) {
-    env_->RenameFile(tmp_dir, config_->db_dir);
-    if (!Open().IsOK()) LOG(ERROR) << "[storage] Fail to reopen db";
-    return Status(Status::NotOK, "Fail to rename checkpoint dir, error: " + s.ToString());
-  }
+void Storage::BeginCacheOnlyReads() { cache_only_reads = {true, false}; }
 
-  // Open the new db, restore if replica fails to open db
-  auto s2 = Open();
-  if (!s2.IsOK()) {
-    LOG(WARNING) << "[storage] Fail to open master checkpoint, error: " << s2.Msg();
-    rocksdb::DestroyDB(config_->db_dir, rocksdb::Options());
-    env_->RenameFile(tmp_dir, config_->db_dir);
-    if (!Open().IsOK()) LOG(ERROR) << "[storage] Fail to reopen db";
-    return Status(Status::DBOpenErr, "Fail to open master checkpoint, error: " + s2.Msg());
-  }
+bool Storage::EndCacheOnlyReads() {
+  bool missed = cache_only_reads.missed;
+  cache_only_reads = {};
+  return missed;
+}
 
-  // Destory origin db
-  if (!(s = rocksdb::DestroyDB(tmp_dir, rocksdb::Options())).ok()) {
-    LOG(WARNING) << "[storage] Fail to destroy " << tmp_dir << ", error:" << s.ToString();
+rocksdb::Status Storage::Get(const rocksdb::ReadOptions &options, const rocksdb::Slice &key, std::string *value) {
+  return Get(options, db_->DefaultColumnFamily(), key, value);
+}
+
+rocksdb::Status Storage::Get(const rocksdb::ReadOptions &options, rocksdb::ColumnFamilyHandle *column_family,
+                             const rocksdb::Slice &key, std::string *value) {
+  if (cache_only_reads.enabled && options.read_tier != rocksdb::kBlockCacheTier) {
+    rocksdb::ReadOptions cache_only_options = options;
+    cache_only_options.read_tier = rocksdb::kBlockCacheTier;
+    auto s = Get(cache_only_options, column_family, key, value);
+    if (s.IsIncomplete()) cache_only_reads.missed = true;
+    return s;
   }
-  return Status::OK();
+  column_family = RouteCFHandle(column_family, key);
+  if (pinned_snapshot && options.snapshot != pinned_snapshot) {
+    rocksdb::ReadOptions pinned_options = options;
+    pinned_options.snapshot = pinned_snapshot;
+    return Get(pinned_options, column_family, key, value);
+  }
+  WorkloadTuner::ReadSampler sampler(workload_tuner_.get(), column_family);
+  if (txn_batch) return txn_batch->GetFromBatchAndDB(db_, options, column_family, key, value);
+  return db_->Get(options, column_family, key, value);
 }
 
-void Storage::EmptyDB() {
-  // Clean old backups and checkpoints
-  PurgeOldBackups(0, 0);
-  rocksdb::DestroyDB(config_->checkpoint_dir, rocksdb::Options());
+rocksdb::Status Storage::Get(const rocksdb::ReadOptions &options, const rocksdb::Slice &key,
+                             rocksdb::PinnableSlice *value) {
+  return Get(options, db_->DefaultColumnFamily(), key, value);
+}
 
-  auto s = rocksdb::DestroyDB(config_->db_dir, rocksdb::Options());
-  if (!s.ok()) {
-    LOG(ERROR) << "[storage] Failed to destroy db, error: " << s.ToString();
+rocksdb::Status Storage::Get(const rocksdb::ReadOptions &options, rocksdb::ColumnFamilyHandle *column_family,
+                             const rocksdb::Slice &key, rocksdb::PinnableSlice *value) {
+  if (cache_only_reads.enabled && options.read_tier != rocksdb::kBlockCacheTier) {
+    rocksdb::ReadOptions cache_only_options = options;
+    cache_only_options.read_tier = rocksdb::kBlockCacheTier;
+    auto s = Get(cache_only_options, column_family, key, value);
+    if (s.IsIncomplete()) cache_only_reads.missed = true;
+    return s;
+  }
+  column_family = RouteCFHandle(column_family, key);
+  if (pinned_snapshot && options.snapshot != pinned_snapshot) {
+    rocksdb::ReadOptions pinned_options = options;
+    pinned_options.snapshot = pinned_snapshot;
+    return Get(pinned_options, column_family, key, value);
   }
+  WorkloadTuner::ReadSampler sampler(workload_tuner_.get(), column_family);
+  if (txn_batch) return txn_batch->GetFromBatchAndDB(db_, options, column_family, key, value);
+  return db_->Get(options, column_family, key, value);
 }
 
-void Storage::PurgeOldBackups(uint32_t num_backups_to_keep, uint32_t backup_max_keep_hours) {
-  time_t now = time(nullptr);
-  std::lock_guard<std::mutex> lg(config_->backup_mu_);
-  std::string task_backup_dir = config_->backup_dir;
+void Storage::MultiGet(const rocksdb::ReadOptions &options, rocksdb::ColumnFamilyHandle *column_family,
+                       size_t num_keys, const rocksdb::Slice *keys, rocksdb::PinnableSlice *values,
+                       rocksdb::Status *statuses) {
+  if (cache_only_reads.enabled && options.read_tier != rocksdb::kBlockCacheTier) {
+    rocksdb::ReadOptions cache_only_options = options;
+    cache_only_options.read_tier = rocksdb::kBlockCacheTier;
+    MultiGet(cache_only_options, column_family, num_keys, keys, values, statuses);
+    for (size_t i = 0; i < num_keys; i++) {
+      if (statuses[i].IsIncomplete()) cache_only_reads.missed = true;
+    }
+    return;
+  }
+  // The keys of a batch are always in the same namespace
+  if (num_keys > 0) column_family = RouteCFHandle(column_family, keys[0]);
+  if (pinned_snapshot && options.snapshot != pinned_snapshot) {
+    rocksdb::ReadOptions pinned_options = options;
+    pinned_options.snapshot = pinned_snapshot;
+    MultiGet(pinned_options, column_family, num_keys, keys, values, statuses);
+    return;
+  }
+  WorkloadTuner::ReadSampler sampler(workload_tuner_.get(), column_family);
+  if (txn_batch) {
+    txn_batch->MultiGetFromBatchAndDB(db_, options, column_family, num_keys, keys, values, statuses, false);
+    return;
+  }
+  db_->MultiGet(options, column_family, num_keys, keys, values, statuses, false);
+}
 
-  // Return if there is no backup
-  auto s = env_->FileExists(task_backup_dir);
-  if (!s.ok()) return;
+// The iterator without the lower bound is bound to the column family of the first seek target's namespace,
+// and rebound if the later target is in another namespace. SeekToFirst and SeekToLast use the shared one.
+class NamespaceRoutedIterator : public rocksdb::Iterator {
+ public:
+  using Router = std::function<rocksdb::ColumnFamilyHandle *(rocksdb::ColumnFamilyHandle *, const Slice &)>;
+  using Factory = std::function<rocksdb::Iterator *(rocksdb::ColumnFamilyHandle *)>;
 
-  // No backup is needed to keep or the backup is expired, we will clean it.
-  if (num_backups_to_keep == 0 ||
-      (backup_max_keep_hours != 0 && backup_creating_time_ + backup_max_keep_hours * 3600 < now)) {
-    s = rocksdb::DestroyDB(task_backup_dir, rocksdb::Options());
-    if (s.ok()) {
-      LOG(INFO) << "[storage] Succeeded cleaning old backup that was born at " << backup_creating_time_;
-    } else {
-      LOG(INFO) << "[storage] Failed cleaning old backup that was born at " << backup_creating_time_;
+  NamespaceRoutedIterator(rocksdb::ColumnFamilyHandle *cf_handle, Router router, Factory factory)
+      : shared_cf_handle_(cf_handle), router_(std::move(router)), factory_(std::move(factory)) {}
+
+  bool Valid() const override { return iter_ && iter_->Valid(); }
+  void SeekToFirst() override {
+    bind(shared_cf_handle_);
+    iter_->SeekToFirst();
+  }
+  void SeekToLast() override {
+    bind(shared_cf_handle_);
+    iter_->SeekToLast();
+  }
+  void Seek(const Slice &target) override {
+    bind(router_(shared_cf_handle_, target));
+    iter_->Seek(target);
+  }
+  void SeekForPrev(const Slice &target) override {
+    bind(router_(shared_cf_handle_, target));
+    iter_->SeekForPrev(target);
+  }
+  void Next() override { iter_->Next(); }
+  void Prev() override { iter_->Prev(); }
+  Slice key() const override { return iter_->key(); }
+  Slice value() const override { return iter_->value(); }
+  rocksdb::Status status() const override { return iter_ ? iter_->status() : rocksdb::Status::OK(); }
+
+ private:
+  void bind(rocksdb::ColumnFamilyHandle *cf_handle) {
+    if (iter_ && cf_handle == bound_cf_handle_) return;
+    iter_.reset(factory_(cf_handle));
+    bound_cf_handle_ = cf_handle;
+  }
+
+  rocksdb::ColumnFamilyHandle *shared_cf_handle_;
+  rocksdb::ColumnFamilyHandle *bound_cf_handle_ = nullptr;
+  Router router_;
+  Factory factory_;
+  std::unique_ptr<rocksdb::Iterator> iter_;
+};
+
+void Storage::SetLongScanReadOptions(rocksdb::ReadOptions *options) {
+  // The readahead of the iterators starts once the blocks are read sequentially, it's doubled on
+  // every readahead up to max_auto_readahead_size, and the size is carried to the next file
+  options->adaptive_readahead = true;
+  // Prefetch the next readahead asynchronously while the current one is consumed, it falls back
+  // to the synchronous reads if the file system doesn't support the async reads (e.g. io_uring)
+  options->async_io = config_->RocksDB.scan_async_io;
+}
+
+rocksdb::Iterator *Storage::NewIterator(const rocksdb::ReadOptions &options,
+                                        rocksdb::ColumnFamilyHandle *column_family) {
+  if (!column_family) column_family = db_->DefaultColumnFamily();
+  auto read_options = DBUtil::UniqueIterator::PrefixAwareOptions(options);
+  if (pinned_snapshot) read_options.snapshot = pinned_snapshot;
+  if (!namespace_cfs_.empty()) {
+    // The iterators are routed by the lower bound, or by the first seek target if it's unknown
+    if (!read_options.iterate_lower_bound) {
+      auto router = [this](rocksdb::ColumnFamilyHandle *cf_handle, const Slice &key) {
+        return RouteCFHandle(cf_handle, key);
+      };
+      auto factory = [this, read_options, txn = txn_batch.get()](rocksdb::ColumnFamilyHandle *cf_handle) {
+        auto iter = db_->NewIterator(read_options, cf_handle);
+        return txn ? txn->NewIteratorWithBase(cf_handle, iter, &read_options) : iter;
+      };
+      return new NamespaceRoutedIterator(column_family, router, factory);
     }
+    column_family = RouteCFHandle(column_family, *read_options.iterate_lower_bound);
   }
+  rocksdb::Iterator *iter = db_->NewIterator(read_options, column_family);
+  if (txn_batch) iter = txn_batch->NewIteratorWithBase(column_family, iter, &read_options);
+  if (config_->compaction_checker_tombstone_threshold <= 0) return iter;
+  return new TombstoneTrackingIterator(iter, &tombstone_tracker_, column_family->GetID(),
+                                       read_options.iterate_lower_bound, read_options.iterate_upper_bound);
 }
 
-Status Storage::GetWALIter(rocksdb::SequenceNumber seq, std::unique_ptr<rocksdb::TransactionLogIterator> *iter) {
-  auto s = db_->GetUpdatesSince(seq, iter);
-  if (!s.ok()) return Status(Status::DBGetWALErr, s.ToString());
-  if (!(*iter)->Valid()) return Status(Status::DBGetWALErr, "iterator not valid");
-  return Status::OK();
+bool Storage::BeginDeferredSync() {
+  if (deferred_sync.deferring) return false;
+  deferred_sync.deferring = true;
+  deferred_sync.has_unsynced_writes = false;
+  return true;
 }
 
-rocksdb::SequenceNumber Storage::LatestSeq() { return db_->GetLatestSequenceNumber(); }
+bool Storage::IsDeferringSync() { return deferred_sync.deferring; }
 
-rocksdb::Status Storage::Write(const rocksdb::WriteOptions &options, rocksdb::WriteBatch *updates) {
-  if (reach_db_size_limit_) {
-    return rocksdb::Status::SpaceLimit();
-  }
+rocksdb::Status Storage::EndDeferredSync() {
+  deferred_sync.deferring = false;
+  if (!deferred_sync.has_unsynced_writes) return rocksdb::Status::OK();
+  deferred_sync.has_unsynced_writes = false;
 
-  // Put replication id logdata at the end of write batch
-  if (replid_.length() == kReplIdLength) {
-    updates->PutLogData(ServerLogData(kReplIdLog, replid_).Encode());
-  }
+  auto guard = ReadLockGuard();
+  // The WAL would be synced while closing the DB
+  if (db_closing_ || db_ == nullptr) return rocksdb::Status::OK();
+  return db_->FlushWAL(true);
+}
 
-  return db_->Write(options, updates);
+rocksdb::Status Storage::SyncWAL() {
+  // SyncWAL doesn't write the buffer of manual_wal_flush
+  return db_->FlushWAL(true);
 }
 
 rocksdb::Status Storage::Delete(const rocksdb::WriteOptions &options, rocksdb::ColumnFamilyHandle *cf_handle,
@@ -527,6 +1951,15 @@ rocksdb::Status Storage::DeleteRange(const std::string &first_key, const std::st
   return Write(write_opts_, &batch);
 }
 
+rocksdb::Status Storage::DeleteFilesInRange(const rocksdb::Slice &begin_key, const rocksdb::Slice &end_key) {
+  for (auto id : kNamespaceColumnFamilyIDs) {
+    auto cf_handle = RouteCFHandle(cf_handles_[id], begin_key);
+    auto s = rocksdb::DeleteFilesInRange(db_, cf_handle, &begin_key, &end_key, false);
+    if (!s.ok()) return s;
+  }
+  return rocksdb::Status::OK();
+}
+
 rocksdb::Status Storage::FlushScripts(const rocksdb::WriteOptions &options, rocksdb::ColumnFamilyHandle *cf_handle) {
   std::string begin_key = kLuaFunctionPrefix, end_key = begin_key;
   // we need to increase one here since the DeleteRange api
@@ -546,13 +1979,235 @@ Status Storage::ReplicaApplyWriteBatch(std::string &&raw_batch) {
     return Status(Status::NotOK, "reach space limit");
   }
   auto bat = rocksdb::WriteBatch(std::move(raw_batch));
-  auto s = db_->Write(write_opts_, &bat);
+  // The metadata cache and the key counter know only the shared column families
+  rocksdb::WriteBatch shared_bat;
+  auto tracked_bat = &bat;
+  if (!namespace_cfs_.empty()) {
+    bool changed = false;
+    auto s = rewriteBatchCFs(&bat, false, &shared_bat, &changed);
+    if (!s.ok()) return Status(Status::NotOK, s.ToString());
+    if (changed) tracked_bat = &shared_bat;
+  }
+  KeyCounter::Changes key_count_changes;
+  if (config_->key_count_tracking) {
+    auto s = key_counter_.Collect(db_, metadataCFHandleOf(), tracked_bat, &key_count_changes);
+    if (!s.ok()) return Status(Status::NotOK, s.ToString());
+  }
+  // The chunks of the master are registered before they're applied, so the compaction filter
+  // keeps the subkeys until the metadata arrives
+  WritingVersionCollector writing_versions;
+  auto collect_s = bat.Iterate(&writing_versions);
+  if (!collect_s.ok()) return Status(Status::NotOK, collect_s.ToString());
+  for (auto version : writing_versions.added) registerWritingVersion(version, false);
+  // The batch is written under the lock, so it's never between the flush and the removal of the record
+  std::unique_lock<std::mutex> unflushed_guard(replica_unflushed_mu_, std::defer_lock);
+  rocksdb::WriteOptions write_opts = write_opts_;
+  if (config_->replica_disable_wal) {
+    unflushed_guard.lock();
+    if (!replica_unflushed_) {
+      auto s = rocksdb::WriteStringToFile(env_, std::to_string(LatestSeq()), replicaUnflushedPath(), true);
+      if (!s.ok()) return Status(Status::NotOK, "failed to record the unflushed sequence: " + s.ToString());
+      replica_unflushed_ = true;
+      replica_unflushed_since_ = Util::GetTimeStamp();
+    }
+    write_opts.disableWAL = true;
+    write_opts.sync = false;
+  }
+  auto s = db_->Write(write_opts, &bat);
+  if (metadata_cache_.Enabled()) invalidateMetadataCache(tracked_bat);
   if (!s.ok()) {
     return Status(Status::NotOK, s.ToString());
   }
+  if (!key_count_changes.Empty()) key_counter_.Apply(key_count_changes);
+  for (auto version : writing_versions.removed) ReleaseWritingVersion(version, true);
+  notifyWALWaiters();
+  bool flush_due = false;
+  if (unflushed_guard.owns_lock()) {
+    flush_due = Util::GetTimeStamp() - replica_unflushed_since_ >= config_->replica_flush_interval_sec;
+    unflushed_guard.unlock();
+  }
+  if (flush_due) return FlushReplicaWrites();
+  return Status::OK();
+}
+
+Status Storage::FlushReplicaWrites() {
+  std::lock_guard<std::mutex> guard(replica_unflushed_mu_);
+  if (!replica_unflushed_) return Status::OK();
+
+  rocksdb::FlushOptions flush_opts;
+  flush_opts.allow_write_stall = true;
+  auto s = db_->Flush(flush_opts, GetAllCFHandles());
+  if (!s.ok()) return Status(Status::NotOK, "failed to flush the replicated writes: " + s.ToString());
+  s = env_->DeleteFile(replicaUnflushedPath());
+  if (!s.ok() && !s.IsNotFound()) {
+    return Status(Status::NotOK, "failed to remove the unflushed sequence: " + s.ToString());
+  }
+  replica_unflushed_ = false;
   return Status::OK();
 }
 
+rocksdb::ColumnFamilyHandle *Storage::RouteCFHandle(rocksdb::ColumnFamilyHandle *cf_handle, const rocksdb::Slice &key) {
+  if (namespace_cfs_.empty() || key.empty()) return cf_handle;
+  // The keys of all column families in kNamespaceColumnFamilyIDs begin with the namespace
+  size_t ns_size = static_cast<uint8_t>(key[0]);
+  if (key.size() < 1 + ns_size) return cf_handle;
+  auto iter = namespace_cfs_.find(std::string_view(key.data() + 1, ns_size));
+  if (iter == namespace_cfs_.end()) return cf_handle;
+  auto id = cf_handle->GetID();
+  if (id >= cf_handles_.size() || cf_handles_[id] != cf_handle) return cf_handle;
+  auto routed_cf_handle = iter->second->handles[id].load();
+  return routed_cf_handle ? routed_cf_handle : cf_handle;
+}
+
+bool Storage::sharedCFID(uint32_t id, uint32_t *shared_id) {
+  if (id < cf_handles_.size()) {
+    *shared_id = id;
+    return true;
+  }
+  for (const auto &iter : namespace_cfs_) {
+    for (uint32_t i = 0; i < kNumColumnFamilies; i++) {
+      auto cf_handle = iter.second->handles[i].load();
+      if (cf_handle && cf_handle->GetID() == id) {
+        *shared_id = i;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+rocksdb::Status Storage::rewriteBatchCFs(rocksdb::WriteBatch *batch, bool to_namespace, rocksdb::WriteBatch *rewritten,
+                                         bool *changed) {
+  class ColumnFamilyRewriter : public rocksdb::WriteBatch::Handler {
+   public:
+    ColumnFamilyRewriter(Storage *storage, bool to_namespace, rocksdb::WriteBatch *batch)
+        : storage_(storage), to_namespace_(to_namespace), batch_(batch) {}
+    rocksdb::Status PutCF(uint32_t column_family_id, const Slice &key, const Slice &value) override {
+      auto cf_handle = handleOf(column_family_id, key);
+      return cf_handle ? batch_->Put(cf_handle, key, value) : unknown(column_family_id);
+    }
+    rocksdb::Status DeleteCF(uint32_t column_family_id, const Slice &key) override {
+      auto cf_handle = handleOf(column_family_id, key);
+      return cf_handle ? batch_->Delete(cf_handle, key) : unknown(column_family_id);
+    }
+    rocksdb::Status SingleDeleteCF(uint32_t column_family_id, const Slice &key) override {
+      auto cf_handle = handleOf(column_family_id, key);
+      return cf_handle ? batch_->SingleDelete(cf_handle, key) : unknown(column_family_id);
+    }
+    rocksdb::Status MergeCF(uint32_t column_family_id, const Slice &key, const Slice &value) override {
+      auto cf_handle = handleOf(column_family_id, key);
+      return cf_handle ? batch_->Merge(cf_handle, key, value) : unknown(column_family_id);
+    }
+    // The deleted ranges are always in one namespace except those of FLUSHALL in the shared column families
+    rocksdb::Status DeleteRangeCF(uint32_t column_family_id, const Slice &begin_key, const Slice &end_key) override {
+      auto cf_handle = handleOf(column_family_id, begin_key);
+      return cf_handle ? batch_->DeleteRange(cf_handle, begin_key, end_key) : unknown(column_family_id);
+    }
+    void LogData(const Slice &blob) override { batch_->PutLogData(blob); }
+
+    bool changed = false;
+
+   private:
+    rocksdb::ColumnFamilyHandle *handleOf(uint32_t column_family_id, const Slice &key) {
+      uint32_t shared_id = 0;
+      if (!storage_->sharedCFID(column_family_id, &shared_id)) return nullptr;
+      auto cf_handle = (*storage_->GetCFHandles())[shared_id];
+      if (to_namespace_) cf_handle = storage_->RouteCFHandle(cf_handle, key);
+      if (cf_handle->GetID() != column_family_id) changed = true;
+      return cf_handle;
+    }
+    static rocksdb::Status unknown(uint32_t column_family_id) {
+      return rocksdb::Status::InvalidArgument("unknown column family " + std::to_string(column_family_id));
+    }
+
+    Storage *storage_;
+    bool to_namespace_;
+    rocksdb::WriteBatch *batch_;
+  };
+
+  ColumnFamilyRewriter rewriter(this, to_namespace, rewritten);
+  auto s = batch->Iterate(&rewriter);
+  *changed = rewriter.changed;
+  return s;
+}
+
+std::vector<std::string> Storage::GetNamespacesWithCFs() {
+  std::vector<std::string> namespaces;
+  for (const auto &iter : namespace_cfs_) namespaces.emplace_back(iter.first);
+  return namespaces;
+}
+
+rocksdb::Status Storage::ResetNamespaceCFs(const std::string &ns) {
+  auto iter = namespace_cfs_.find(ns);
+  if (iter == namespace_cfs_.end()) return rocksdb::Status::NotFound("the namespace has no column families");
+  auto namespace_cfs = iter->second.get();
+
+  std::lock_guard<std::mutex> guard(namespace_cfs_mu_);
+  // Create the new generation before dropping the old one, so the writers always have the column
+  // families to write. The incomplete generation would be dropped while opening the DB.
+  auto generation = namespace_cfs->generation + 1;
+  std::vector<std::pair<uint32_t, rocksdb::ColumnFamilyHandle *>> new_cf_handles;
+  for (auto id : kNamespaceColumnFamilyIDs) {
+    rocksdb::ColumnFamilyDescriptor descriptor;
+    rocksdb::ColumnFamilyHandle *cf_handle = nullptr;
+    auto s = namespace_cfs->handles[id].load()->GetDescriptor(&descriptor);
+    if (s.ok()) s = db_->CreateColumnFamily(descriptor.options, namespaceCFName(id, ns, generation), &cf_handle);
+    if (!s.ok()) {
+      for (const auto &[_, new_cf_handle] : new_cf_handles) {
+        db_->DropColumnFamily(new_cf_handle);
+        db_->DestroyColumnFamilyHandle(new_cf_handle);
+      }
+      return s;
+    }
+    new_cf_handles.emplace_back(id, cf_handle);
+  }
+  namespace_cfs->generation = generation;
+  for (const auto &[id, cf_handle] : new_cf_handles) {
+    auto old_cf_handle = namespace_cfs->handles[id].exchange(cf_handle);
+    auto s = db_->DropColumnFamily(old_cf_handle);
+    if (!s.ok()) LOG(WARNING) << "[storage] Failed to drop the column family: " << s.ToString();
+    dropped_cf_handles_.emplace_back(old_cf_handle);
+  }
+  LOG(INFO) << "[storage] Reset the column families of the namespace " << ns << ", generation: " << generation;
+
+  metadata_cache_.Clear();
+  scan_iterator_cache_.Clear();
+  KeyCounter::Changes key_count_changes;
+  key_count_changes.cleared.emplace_back(ns, -1);
+  key_counter_.Apply(key_count_changes);
+  auto s = requireResync(kPropagateNamespaceColumnFamilies);
+  if (!s.IsOK()) return rocksdb::Status::IOError(s.Msg());
+  return rocksdb::Status::OK();
+}
+
+std::vector<rocksdb::ColumnFamilyHandle *> Storage::GetAllCFHandles(const std::string &name) {
+  std::vector<rocksdb::ColumnFamilyHandle *> cf_handles;
+  auto shared_cf_handle = name.empty() ? nullptr : GetCFHandle(name);
+  if (shared_cf_handle) {
+    cf_handles.emplace_back(shared_cf_handle);
+  } else {
+    cf_handles = cf_handles_;
+  }
+  for (const auto &iter : namespace_cfs_) {
+    for (size_t i = 0; i < kNumColumnFamilies; i++) {
+      auto cf_handle = iter.second->handles[i].load();
+      if (cf_handle && (!shared_cf_handle || cf_handles_[i] == shared_cf_handle)) cf_handles.emplace_back(cf_handle);
+    }
+  }
+  return cf_handles;
+}
+
+Status Storage::requireResync(const char *marker) {
+  // The replicas streaming the WAL resynchronize fully once they apply the marker, and those reconnecting
+  // without the marker are refused to continue. The existing checkpoint or pinned files can't be shared
+  // since they don't have the changed data.
+  auto seq = LatestSeq() + 1;
+  auto s = WriteToPropagateCF(marker, std::to_string(seq));
+  resync_seq_ = std::max(seq, LatestSeq());
+  SetCheckpointCreateTime(0);
+  return s;
+}
+
 rocksdb::ColumnFamilyHandle *Storage::GetCFHandle(const std::string &name) {
   if (name == kMetadataColumnFamilyName) {
     return cf_handles_[1];
@@ -564,6 +2219,10 @@ rocksdb::ColumnFamilyHandle *Storage::GetCFHandle(const std::string &name) {
     return cf_handles_[4];
   } else if (name == kStreamColumnFamilyName) {
     return cf_handles_[5];
+  } else if (name == kTTLIndexColumnFamilyName) {
+    return cf_handles_[6];
+  } else if (name == kZSetRankColumnFamilyName) {
+    return cf_handles_[7];
   }
   return cf_handles_[0];
 }
@@ -571,7 +2230,7 @@ rocksdb::ColumnFamilyHandle *Storage::GetCFHandle(const std::string &name) {
 rocksdb::Status Storage::Compact(const Slice *begin, const Slice *end) {
   rocksdb::CompactRangeOptions compact_opts;
   compact_opts.change_level = true;
-  for (const auto &cf_handle : cf_handles_) {
+  for (const auto &cf_handle : GetAllCFHandles()) {
     rocksdb::Status s = db_->CompactRange(compact_opts, cf_handle, begin, end);
     if (!s.ok()) return s;
   }
@@ -593,6 +2252,7 @@ uint64_t Storage::GetTotalSize(const std::string &ns) {
     if (cf_handle == GetCFHandle(kPubSubColumnFamilyName) || cf_handle == GetCFHandle(kPropagateColumnFamilyName)) {
       continue;
     }
+    cf_handle = RouteCFHandle(cf_handle, prefix);
     auto s = db.FindKeyRangeWithPrefix(prefix, std::string(), &begin_key, &end_key, cf_handle);
     if (!s.ok()) continue;
 
@@ -630,6 +2290,38 @@ void Storage::SetIORateLimit(uint64_t max_io_mb) {
   rate_limiter_->SetBytesPerSecond(max_io_mb * MiB);
 }
 
+void Storage::AutoTuneIORateLimit(uint64_t max_io_mb, uint64_t target_latency_us, bool boost) {
+  uint64_t read_count = 0, read_micros = 0;
+  auto stats = db_->GetDBOptions().statistics;
+  for (auto type : {rocksdb::Histograms::DB_GET, rocksdb::Histograms::DB_MULTIGET}) {
+    rocksdb::HistogramData data;
+    stats->histogramData(type, &data);
+    read_count += data.count;
+    read_micros += data.sum;
+  }
+  // The statistics are reset with the DB, so are the counts of the last tuning
+  if (read_count < io_tune_read_count_ || read_micros < io_tune_read_micros_) {
+    io_tune_read_count_ = io_tune_read_micros_ = 0;
+  }
+  uint64_t reads = read_count - io_tune_read_count_;
+  uint64_t avg_latency_us = reads > 0 ? (read_micros - io_tune_read_micros_) / reads : 0;
+  io_tune_read_count_ = read_count;
+  io_tune_read_micros_ = read_micros;
+
+  int64_t max_limit = static_cast<int64_t>(max_io_mb * MiB);
+  int64_t min_limit = std::max(max_limit / 16, static_cast<int64_t>(MiB));
+  int64_t limit = std::min(rate_limiter_->GetBytesPerSecond(), max_limit);
+  if (boost) {
+    limit = max_limit;
+  } else if (avg_latency_us > target_latency_us) {
+    // Back off quickly since the foreground reads are hurt, and recover slowly
+    limit = std::max(limit / 2, min_limit);
+  } else {
+    limit = std::min(limit + std::max(limit / 10, static_cast<int64_t>(MiB)), max_limit);
+  }
+  if (limit != rate_limiter_->GetBytesPerSecond()) rate_limiter_->SetBytesPerSecond(limit);
+}
+
 rocksdb::DB *Storage::GetDB() { return db_; }
 
 Status Storage::WriteToPropagateCF(const std::string &key, const std::string &value) {
@@ -644,6 +2336,58 @@ Status Storage::WriteToPropagateCF(const std::string &key, const std::string &va
   return Status::OK();
 }
 
+Status Storage::IngestSSTFiles(const std::string &dir, bool move_files, uint64_t *num_files) {
+  auto guard = ReadLockGuard();
+  if (db_closing_) return {Status::NotOK, "DB is closing"};
+
+  std::vector<std::string> children;
+  auto s = env_->GetChildren(dir, &children);
+  if (!s.ok()) return {Status::NotOK, s.ToString()};
+  std::sort(children.begin(), children.end());
+
+  // Group the files by the column families in their properties, only the column families of the keys
+  // are accepted. The TTL index is accepted too, since it's built only while writing the metadata.
+  static const std::vector<std::string> cf_names = {
+      kMetadataColumnFamilyName, kSubkeyColumnFamilyName, kZSetScoreColumnFamilyName,
+      kZSetRankColumnFamilyName, kStreamColumnFamilyName, kTTLIndexColumnFamilyName};
+  std::map<std::string, std::vector<std::string>> cf_files;
+  for (const auto &f : children) {
+    if (f.size() <= 4 || f.compare(f.size() - 4, 4, ".sst") != 0) continue;
+    std::string path = dir + "/" + f;
+    rocksdb::SstFileReader reader(db_->GetOptions());
+    s = reader.Open(path);
+    if (!s.ok()) return {Status::NotOK, s.ToString()};
+    const std::string &cf_name = reader.GetTableProperties()->column_family_name;
+    if (std::find(cf_names.begin(), cf_names.end(), cf_name) == cf_names.end()) {
+      return {Status::NotOK, "Invalid column family of SST file " + f + ": " + cf_name};
+    }
+    cf_files[cf_name].emplace_back(std::move(path));
+  }
+  if (cf_files.empty()) return {Status::NotOK, "No SST file in " + dir};
+
+  std::vector<rocksdb::IngestExternalFileArg> args;
+  for (auto &iter : cf_files) {
+    rocksdb::IngestExternalFileArg arg;
+    arg.column_family = GetCFHandle(iter.first);
+    arg.external_files = std::move(iter.second);
+    arg.options.move_files = move_files;
+    arg.options.verify_checksums_before_ingest = true;
+    *num_files += arg.external_files.size();
+    args.emplace_back(std::move(arg));
+  }
+  s = db_->IngestExternalFiles(args);
+  if (!s.ok()) return {Status::NotOK, s.ToString()};
+
+  // The loaded keys may be cached or counted already
+  metadata_cache_.Clear();
+  key_counter_.Clear();
+
+  auto st = requireResync(kPropagateBulkLoad);
+  if (!st.IsOK()) return st;
+  LOG(INFO) << "[storage] Succeed to ingest " << *num_files << " SST files in " << dir;
+  return Status::OK();
+}
+
 bool Storage::ShiftReplId() {
   const char *charset = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
   const int charset_len = strlen(charset);
@@ -658,14 +2402,24 @@ bool Storage::ShiftReplId() {
   for (int i = 0; i < kReplIdLength; i++) {
     rand_str.push_back(charset[distrib(gen)]);
   }
-  replid_ = rand_str;
-  LOG(INFO) << "[replication] New replication id: " << replid_;
+  SetReplId(rand_str);
+  LOG(INFO) << "[replication] New replication id: " << rand_str;
 
   // Write new replication id into db engine
-  WriteToPropagateCF(kReplicationIdKey, replid_);
+  WriteToPropagateCF(kReplicationIdKey, rand_str);
   return true;
 }
 
+void Storage::SetReplId(const std::string &replid) {
+  std::lock_guard<std::mutex> guard(replid_mu_);
+  replid_ = replid;
+}
+
+std::string Storage::GetReplId() {
+  std::lock_guard<std::mutex> guard(replid_mu_);
+  return replid_;
+}
+
 std::string Storage::GetReplIdFromWalBySeq(rocksdb::SequenceNumber seq) {
   std::unique_ptr<rocksdb::TransactionLogIterator> iter = nullptr;
 
@@ -680,6 +2434,9 @@ std::string Storage::GetReplIdFromWalBySeq(rocksdb::SequenceNumber seq) {
     rocksdb::Status DeleteCF(uint32_t column_family_id, const rocksdb::Slice &key) override {
       return rocksdb::Status::OK();
     }
+    rocksdb::Status MergeCF(uint32_t column_family_id, const Slice &key, const Slice &value) override {
+      return rocksdb::Status::OK();
+    }
     rocksdb::Status DeleteRangeCF(uint32_t column_family_id, const rocksdb::Slice &begin_key,
                                   const rocksdb::Slice &end_key) override {
       return rocksdb::Status::OK();
@@ -718,6 +2475,11 @@ std::string Storage::GetReplIdFromDbEngine() {
 
 std::unique_ptr<RWLock::ReadLock> Storage::ReadLockGuard() { return std::make_unique<RWLock::ReadLock>(db_rw_lock_); }
 
+std::unique_ptr<RWLock::ReadLock> Storage::TryReadLockGuard() {
+  if (!db_rw_lock_.TryLockRead()) return nullptr;
+  return std::make_unique<RWLock::ReadLock>(db_rw_lock_, std::adopt_lock);
+}
+
 std::unique_ptr<RWLock::WriteLock> Storage::WriteLockGuard() {
   return std::make_unique<RWLock::WriteLock>(db_rw_lock_);
 }
@@ -729,6 +2491,39 @@ Status Storage::ReplDataManager::GetFullReplDataInfo(Storage *storage, std::stri
   std::string data_files_dir = storage->config_->checkpoint_dir;
   std::unique_lock<std::mutex> ulm(storage->checkpoint_mu_);
 
+  // Replicas can share the checkpoint or the pinned files if their existing time is
+  // less than half of WAL ttl.
+  auto can_share = [storage]() {
+    int64_t can_shared_time = storage->config_->RocksDB.WAL_ttl_seconds / 2;
+    if (can_shared_time > 60 * 60) can_shared_time = 60 * 60;
+    if (can_shared_time < 10 * 60) can_shared_time = 10 * 60;
+    auto now = static_cast<time_t>(Util::GetTimeStamp());
+    return now - storage->GetCheckpointCreateTime() <= can_shared_time;
+  };
+
+  // Send the live files of the DB instead of creating the checkpoint
+  if (storage->config_->repl_diskless_sync) {
+    if (storage->pinned_repl_files_.empty()) {
+      auto s = storage->pinReplFiles();
+      if (!s.IsOK()) {
+        LOG(WARNING) << "[storage] Fail to pin the live files, error: " << s.Msg();
+        return s;
+      }
+      LOG(INFO) << "[storage] Pin the live files successfully";
+    } else if (!can_share()) {
+      LOG(WARNING) << "[storage] Can't use the current pinned files, waiting for next pinning";
+      return {Status::NotOK, "Can't use the current pinned files, waiting for next pinning"};
+    } else {
+      LOG(INFO) << "[storage] Use the current pinned files";
+    }
+    for (const auto &iter : storage->pinned_repl_files_) {
+      files->append(iter.first);
+      files->push_back(',');
+    }
+    files->pop_back();
+    return Status::OK();
+  }
+
   // Create checkpoint if not exist
   if (!storage->env_->FileExists(data_files_dir).ok()) {
     rocksdb::Checkpoint *checkpoint = nullptr;
@@ -750,13 +2545,7 @@ Status Storage::ReplDataManager::GetFullReplDataInfo(Storage *storage, std::stri
     }
     LOG(INFO) << "[storage] Create checkpoint successfully";
   } else {
-    // Replicas can share checkpiont to replication if the checkpoint existing
-    // time is less half of WAL ttl.
-    int64_t can_shared_time = storage->config_->RocksDB.WAL_ttl_seconds / 2;
-    if (can_shared_time > 60 * 60) can_shared_time = 60 * 60;
-    if (can_shared_time < 10 * 60) can_shared_time = 10 * 60;
-    auto now = static_cast<time_t>(Util::GetTimeStamp());
-    if (now - storage->GetCheckpointCreateTime() > can_shared_time) {
+    if (!can_share()) {
       LOG(WARNING) << "[storage] Can't use current checkpoint, waiting next checkpoint";
       return Status(Status::NotOK, "Can't use current checkpoint, waiting for next checkpoint");
     }
@@ -783,6 +2572,61 @@ bool Storage::ExistCheckpoint() {
 
 bool Storage::ExistSyncCheckpoint() { return env_->FileExists(config_->sync_checkpoint_dir).ok(); }
 
+// Pin the live files by disabling the file deletions, the memtables are flushed, so the
+// files contain all data before the latest sequence number like the checkpoint.
+Status Storage::pinReplFiles() {
+  auto s = db_->DisableFileDeletions();
+  if (!s.ok()) return {Status::NotOK, s.ToString()};
+
+  std::vector<std::string> live_files;
+  uint64_t manifest_size = 0;
+  s = db_->GetLiveFiles(live_files, &manifest_size, true);
+  if (!s.ok()) {
+    db_->EnableFileDeletions(false);
+    return {Status::NotOK, s.ToString()};
+  }
+
+  std::map<std::string, uint64_t> pinned_files;
+  std::string current;
+  for (auto file : live_files) {
+    if (!file.empty() && file[0] == '/') file.erase(0, 1);
+    uint64_t size = 0;
+    if (file == "CURRENT") {
+      continue;
+    } else if (file.compare(0, 8, "MANIFEST") == 0) {
+      // The MANIFEST keeps growing, only its pinned part is consistent with the live files
+      size = manifest_size;
+      current = file + "\n";
+    } else if (s = env_->GetFileSize(liveFilePath(file), &size); !s.ok()) {
+      db_->EnableFileDeletions(false);
+      return {Status::NotOK, s.ToString()};
+    }
+    pinned_files.emplace(file, size);
+  }
+  pinned_files.emplace("CURRENT", current.size());
+
+  pinned_repl_files_ = std::move(pinned_files);
+  pinned_current_ = std::move(current);
+  auto now = static_cast<time_t>(Util::GetTimeStamp());
+  SetCheckpointCreateTime(now);
+  SetCheckpointAccessTime(now);
+  return Status::OK();
+}
+
+bool Storage::ExistPinnedReplFiles() {
+  std::lock_guard<std::mutex> lg(checkpoint_mu_);
+  return !pinned_repl_files_.empty();
+}
+
+void Storage::ReleasePinnedReplFiles() {
+  auto guard = ReadLockGuard();
+  std::lock_guard<std::mutex> lg(checkpoint_mu_);
+  if (pinned_repl_files_.empty()) return;
+  pinned_repl_files_.clear();
+  pinned_current_.clear();
+  if (db_) db_->EnableFileDeletions(false);
+}
+
 Status Storage::ReplDataManager::CleanInvalidFiles(Storage *storage, const std::string &dir,
                                                    std::vector<std::string> valid_files) {
   if (!storage->env_->FileExists(dir).ok()) {
@@ -820,12 +2664,30 @@ Status Storage::ReplDataManager::CleanInvalidFiles(Storage *storage, const std::
 
 int Storage::ReplDataManager::OpenDataFile(Storage *storage, const std::string &repl_file, uint64_t *file_size) {
   std::string abs_path = storage->config_->checkpoint_dir + "/" + repl_file;
+  bool pinned = false;
+  {
+    std::lock_guard<std::mutex> lg(storage->checkpoint_mu_);
+    if (auto iter = storage->pinned_repl_files_.find(repl_file); iter != storage->pinned_repl_files_.end()) {
+      abs_path = storage->liveFilePath(repl_file);
+      *file_size = iter->second;
+      pinned = true;
+      // The MANIFEST was rolled over if the CURRENT was changed, then the pinned files
+      // can't be shared any more and would be released
+      std::string current;
+      if (repl_file == "CURRENT" &&
+          (!rocksdb::ReadFileToString(storage->env_, abs_path, &current).ok() || current != storage->pinned_current_)) {
+        LOG(WARNING) << "[storage] The CURRENT file was changed after the live files were pinned";
+        storage->SetCheckpointCreateTime(0);
+        return NullFD;
+      }
+    }
+  }
   auto s = storage->env_->FileExists(abs_path);
   if (!s.ok()) {
     LOG(ERROR) << "[storage] Data file [" << abs_path << "] not found";
     return NullFD;
   }
-  storage->env_->GetFileSize(abs_path, file_size);
+  if (!pinned) storage->env_->GetFileSize(abs_path, file_size);
   auto rv = open(abs_path.c_str(), O_RDONLY);
   if (rv < 0) {
     LOG(ERROR) << "[storage] Failed to open file: " << strerror(errno);
@@ -897,6 +2759,27 @@ Status MkdirRecursively(rocksdb::Env *env, const std::string &dir) {
   return Status(Status::NotOK);
 }
 
+// Calculate the crc32c checksum of the first size bytes of the file
+static Status calculateFileCRC(rocksdb::Env *env, const std::string &path, uint64_t size, uint32_t *crc) {
+  std::unique_ptr<rocksdb::SequentialFile> src_file;
+  auto s = env->NewSequentialFile(path, &src_file, rocksdb::EnvOptions());
+  if (!s.ok()) return {Status::NotOK, s.ToString()};
+
+  std::vector<char> buffer(1024 * 1024);
+  Slice slice;
+  uint32_t tmp_crc = 0;
+  while (size > 0) {
+    size_t bytes_to_read = std::min(buffer.size(), static_cast<size_t>(size));
+    s = src_file->Read(bytes_to_read, &slice, buffer.data());
+    if (!s.ok()) return {Status::NotOK, s.ToString()};
+    if (slice.size() == 0) return {Status::NotOK, "unexpected end of file"};
+    tmp_crc = rocksdb::crc32c::Extend(tmp_crc, slice.data(), slice.size());
+    size -= slice.size();
+  }
+  *crc = tmp_crc;
+  return Status::OK();
+}
+
 std::unique_ptr<rocksdb::WritableFile> Storage::ReplDataManager::NewTmpFile(Storage *storage, const std::string &dir,
                                                                             const std::string &repl_file) {
   std::string tmp_file = dir + "/" + repl_file + ".tmp";
@@ -919,6 +2802,31 @@ std::unique_ptr<rocksdb::WritableFile> Storage::ReplDataManager::NewTmpFile(Stor
   return wf;
 }
 
+std::unique_ptr<rocksdb::WritableFile> Storage::ReplDataManager::ReopenTmpFile(Storage *storage,
+                                                                               const std::string &dir,
+                                                                               const std::string &repl_file) {
+  std::string tmp_file = dir + "/" + repl_file + ".tmp";
+  std::unique_ptr<rocksdb::WritableFile> wf;
+  auto s = storage->env_->ReopenWritableFile(tmp_file, &wf, rocksdb::EnvOptions());
+  if (!s.ok()) {
+    LOG(ERROR) << "[storage] Failed to reopen data file: " << s.ToString();
+    return nullptr;
+  }
+  return wf;
+}
+
+void Storage::ReplDataManager::RemoveTmpFile(Storage *storage, const std::string &dir, const std::string &repl_file) {
+  storage->env_->DeleteFile(dir + "/" + repl_file + ".tmp");
+}
+
+Status Storage::ReplDataManager::GetTmpFileInfo(Storage *storage, const std::string &dir,
+                                                const std::string &repl_file, uint64_t *size, uint32_t *crc) {
+  std::string tmp_file = dir + "/" + repl_file + ".tmp";
+  auto s = storage->env_->GetFileSize(tmp_file, size);
+  if (!s.ok()) return {Status::NotOK, s.ToString()};
+  return calculateFileCRC(storage->env_, tmp_file, *size, crc);
+}
+
 Status Storage::ReplDataManager::SwapTmpFile(Storage *storage, const std::string &dir, const std::string &repl_file) {
   std::string tmp_file = dir + "/" + repl_file + ".tmp";
   std::string orig_file = dir + "/" + repl_file;
@@ -939,27 +2847,12 @@ bool Storage::ReplDataManager::FileExists(Storage *storage, const std::string &d
   // If crc is 0, we needn't verify, return true directly.
   if (crc == 0) return true;
 
-  std::unique_ptr<rocksdb::SequentialFile> src_file;
-  const rocksdb::EnvOptions soptions;
-  s = storage->env_->NewSequentialFile(file_path, &src_file, soptions);
-  if (!s.ok()) return false;
-
   uint64_t size = 0;
   s = storage->env_->GetFileSize(file_path, &size);
   if (!s.ok()) return false;
-  auto src_reader = std::make_unique<rocksdb::SequentialFileWrapper>(src_file.get());
 
-  char buffer[4096];
-  Slice slice;
   uint32_t tmp_crc = 0;
-  while (size > 0) {
-    size_t bytes_to_read = std::min(sizeof(buffer), static_cast<size_t>(size));
-    s = src_reader->Read(bytes_to_read, &slice, buffer);
-    if (!s.ok()) return false;
-    if (slice.size() == 0) return false;
-    tmp_crc = rocksdb::crc32c::Extend(0, slice.ToString().c_str(), slice.size());
-    size -= slice.size();
-  }
+  if (!calculateFileCRC(storage->env_, file_path, size, &tmp_crc).IsOK()) return false;
   return crc == tmp_crc;
 }
 
@@ -25,18 +25,35 @@
 #include <rocksdb/options.h>
 #include <rocksdb/table.h>
 #include <rocksdb/utilities/backup_engine.h>
+#include <rocksdb/utilities/write_batch_with_index.h>
 
+#include <array>
 #include <atomic>
 #include <cinttypes>
+#include <condition_variable>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "config/config.h"
+#include "key_counter.h"
 #include "lock_manager.h"
+#include "metadata_cache.h"
+#include "namespace_sizes.h"
 #include "rw_lock.h"
+#include "scan_iterator_cache.h"
+#include "stats/big_keys.h"
+#include "stats/job_stats.h"
+#include "stats/latency_monitor.h"
 #include "status.h"
+#include "tiered_file_system.h"
+#include "tombstone_tracker.h"
 
 const int kReplIdLength = 16;
 
@@ -47,8 +64,16 @@ enum ColumnFamilyID {
   kColumnFamilyIDPubSub,
   kColumnFamilyIDPropagate,
   kColumnFamilyIDStream,
+  kColumnFamilyIDTTLIndex,
+  kColumnFamilyIDZSetRank,
 };
 
+constexpr size_t kNumColumnFamilies = kColumnFamilyIDZSetRank + 1;
+// The column families of the keys, which are dedicated to the namespaces in namespace-column-families
+constexpr std::array<ColumnFamilyID, 5> kNamespaceColumnFamilyIDs = {
+    kColumnFamilyIDDefault, kColumnFamilyIDMetadata, kColumnFamilyIDZSetScore, kColumnFamilyIDStream,
+    kColumnFamilyIDZSetRank};
+
 namespace Engine {
 extern const char *kPubSubColumnFamilyName;
 extern const char *kZSetScoreColumnFamilyName;
@@ -56,11 +81,25 @@ extern const char *kMetadataColumnFamilyName;
 extern const char *kSubkeyColumnFamilyName;
 extern const char *kPropagateColumnFamilyName;
 extern const char *kStreamColumnFamilyName;
+extern const char *kTTLIndexColumnFamilyName;
+extern const char *kZSetRankColumnFamilyName;
 
 extern const char *kPropagateScriptCommand;
+// The marker written after the SST files were bulk loaded, its value is the sequence number of the marker
+extern const char *kPropagateBulkLoad;
+// The marker written after the column families of the namespaces were created or dropped, like kPropagateBulkLoad
+extern const char *kPropagateNamespaceColumnFamilies;
+// The prefix of the markers of the versions written in chunks, followed by the fixed64 version
+extern const char *kPropagateWritingVersion;
 
 extern const char *kLuaFunctionPrefix;
 
+class CacheWarmer;
+class HugePageAllocator;
+class KeyReclaimer;
+class LazyExpirer;
+class WorkloadTuner;
+
 class Storage {
  public:
   explicit Storage(Config *config);
@@ -70,10 +109,12 @@ class Storage {
   Status Open(bool read_only = false);
   void CloseDB();
   void EmptyDB();
-  rocksdb::BlockBasedTableOptions InitTableOptions();
+  rocksdb::BlockBasedTableOptions InitTableOptions(int filter_bits_per_key = 10);
   void SetBlobDB(rocksdb::ColumnFamilyOptions *cf_options);
+  void SetCompression(rocksdb::ColumnFamilyOptions *cf_options, int start_level);
   rocksdb::Options InitOptions();
-  Status SetColumnFamilyOption(const std::string &key, const std::string &value);
+  // Set the option of all the column families, or only of the named one and its namespace column families
+  Status SetColumnFamilyOption(const std::string &key, const std::string &value, const std::string &cf_name = "");
   Status SetOption(const std::string &key, const std::string &value);
   Status SetDBOption(const std::string &key, const std::string &value);
   Status CreateColumnFamilies(const rocksdb::Options &options);
@@ -81,17 +122,117 @@ class Storage {
   Status DestroyBackup();
   Status RestoreFromBackup();
   Status RestoreFromCheckpoint();
+  // Restore the backup created by CreateBackup, either the checkpoint or the incremental backups,
+  // the backup dir is left untouched since it may be shared by the other servers
+  Status RestoreFromLocalBackup(const std::string &backup_dir);
   Status GetWALIter(rocksdb::SequenceNumber seq, std::unique_ptr<rocksdb::TransactionLogIterator> *iter);
   Status ReplicaApplyWriteBatch(std::string &&raw_batch);
+  // With replica-disable-wal, the replica applies the batches without the WAL and flushes the memtables
+  // periodically. The sequence before the first unflushed batch is recorded in a file of the DB dir until
+  // the flush, so a replica which crashed with the unflushed batches knows that it can't resume by PSYNC
+  // if anything after the sequence was persisted, see ReplicaWritesLost. It's also called on closing and
+  // before the replica is promoted, since the WAL written after the lost batches would be inconsistent.
+  Status FlushReplicaWrites();
+  bool ReplicaWritesLost() { return replica_writes_lost_; }
   rocksdb::SequenceNumber LatestSeq();
+  // Delete the archived WAL files whose batches are all before min_retained_seq, and then the oldest
+  // ones until they take at most max_bytes. The number of the deleted files is returned.
+  StatusOr<size_t> PurgeArchivedWALs(rocksdb::SequenceNumber min_retained_seq, uint64_t max_bytes);
   rocksdb::Status Write(const rocksdb::WriteOptions &options, rocksdb::WriteBatch *updates);
   const rocksdb::WriteOptions &DefaultWriteOptions() { return write_opts_; }
+  // Defer the WAL sync of the sync writes on the current thread until EndDeferredSync,
+  // so that all writes of a pipeline share only one sync. Return false if the
+  // current thread is deferring the sync already.
+  bool BeginDeferredSync();
+  rocksdb::Status EndDeferredSync();
+  // Write the WAL buffered by rocksdb.manual_wal_flush to the file and sync it
+  rocksdb::Status SyncWAL();
+  bool IsDeferringSync();
+  // Buffer the writes of the current thread in an indexed batch until CommitTxn, so that
+  // they're applied atomically. The reads through the storage on the thread see the buffered
+  // writes. Return false if the current thread is in a transaction already.
+  bool BeginTxn();
+  rocksdb::Status CommitTxn();
+  bool InTxn();
+  // Fail the next count commits of the non-empty transactions, see DEBUG FAIL-TXN-COMMIT
+  void FailTxnCommits(int count) { failing_txn_commits_ = count; }
+  // The versions whose subkeys are written in chunks ahead of their metadata, the compaction filter keeps
+  // the subkeys of these versions even if the metadata isn't found or is older. AddWritingVersion puts a
+  // marker into the first chunk and RemoveWritingVersion deletes it in the last batch, so the versions are
+  // restored at Open and registered by the replicas applying the batches. ReleaseWritingVersion is called
+  // once the last batch was written, or with removed=false if its marker is still there, which is deleted
+  // by PurgeStaleWritingVersions later. The finished versions are kept until the compaction filters
+  // created before they finished are destroyed, see RegisterCompactionFilter.
+  void AddWritingVersion(uint64_t version, rocksdb::WriteBatch *batch);
+  void RemoveWritingVersion(uint64_t version, rocksdb::WriteBatch *batch);
+  void ReleaseWritingVersion(uint64_t version, bool removed);
+  // Delete the markers which have no writer on this server, e.g. left by a crash or by the former master
+  Status PurgeStaleWritingVersions();
+  bool IsWritingVersion(uint64_t version, uint64_t filter_epoch);
+  // Return the epoch of the new compaction filter, which is passed to IsWritingVersion
+  uint64_t RegisterCompactionFilter();
+  void UnregisterCompactionFilter(uint64_t filter_epoch);
+  // Pin a snapshot of the DB on the current thread until UnpinSnapshot, all reads through the
+  // storage and LatestSnapShot on the thread see the same version, e.g. the read-only scripts.
+  // Return false if the current thread pinned a snapshot already.
+  bool PinSnapshot();
+  void UnpinSnapshot();
+  static const rocksdb::Snapshot *GetPinnedSnapshot();
+  // Let the point reads (Get and MultiGet) of the current thread only look up the memtables and
+  // the block cache until EndCacheOnlyReads, the ones which need the disk I/O fail with Incomplete.
+  // The iterators aren't affected. EndCacheOnlyReads returns true if any read missed the cache.
+  static void BeginCacheOnlyReads();
+  static bool EndCacheOnlyReads();
+  rocksdb::Status Get(const rocksdb::ReadOptions &options, const rocksdb::Slice &key, std::string *value);
+  rocksdb::Status Get(const rocksdb::ReadOptions &options, rocksdb::ColumnFamilyHandle *column_family,
+                      const rocksdb::Slice &key, std::string *value);
+  // Read the value pinned in the block cache or the memtable without copying it out, it's released
+  // when the pinnable slice is reset or destroyed
+  rocksdb::Status Get(const rocksdb::ReadOptions &options, const rocksdb::Slice &key, rocksdb::PinnableSlice *value);
+  rocksdb::Status Get(const rocksdb::ReadOptions &options, rocksdb::ColumnFamilyHandle *column_family,
+                      const rocksdb::Slice &key, rocksdb::PinnableSlice *value);
+  void MultiGet(const rocksdb::ReadOptions &options, rocksdb::ColumnFamilyHandle *column_family, size_t num_keys,
+                const rocksdb::Slice *keys, rocksdb::PinnableSlice *values, rocksdb::Status *statuses);
+  rocksdb::Iterator *NewIterator(const rocksdb::ReadOptions &options,
+                                 rocksdb::ColumnFamilyHandle *column_family = nullptr);
+  // Set the options of the iterators known to read many keys, e.g. KEYS, SCAN, HGETALL, ZRANGE
+  // and the slot migration, whose readahead grows on the sequential reads across the files
+  void SetLongScanReadOptions(rocksdb::ReadOptions *options);
   rocksdb::Status Delete(const rocksdb::WriteOptions &options, rocksdb::ColumnFamilyHandle *cf_handle,
                          const rocksdb::Slice &key);
   rocksdb::Status DeleteRange(const std::string &first_key, const std::string &last_key);
+  // Drop the SST files (except those in level 0) of the keyed column families which are entirely
+  // in [begin_key, end_key), it only reclaims the space of the keys which were already deleted
+  rocksdb::Status DeleteFilesInRange(const rocksdb::Slice &begin_key, const rocksdb::Slice &end_key);
   rocksdb::Status FlushScripts(const rocksdb::WriteOptions &options, rocksdb::ColumnFamilyHandle *cf_handle);
   bool WALHasNewData(rocksdb::SequenceNumber seq) { return seq <= LatestSeq(); }
+  // Wait at most timeout_us until the WAL has the data of the sequence number, the waiters are
+  // woken up after every write, so they don't need to poll the WAL
+  bool WaitForWALData(rocksdb::SequenceNumber seq, int64_t timeout_us);
+  // Write a byte to the fd once the WAL has the data of the sequence number, it's for the event
+  // loops which can't wait in WaitForWALData. Return false without arming the wakeup if the WAL
+  // already has the data, the wakeup is disarmed after it was written, so rearm it to wait again.
+  bool ArmWALWakeup(int fd, rocksdb::SequenceNumber seq);
+  void DisarmWALWakeup(int fd) { wal_wakeup_fd_.compare_exchange_strong(fd, -1); }
   Status WriteToPropagateCF(const std::string &key, const std::string &value);
+  // Ingest the SST files of the key column families in the directory atomically, e.g. those built
+  // by kvrocks-bulkload offline. The files aren't in the WAL, so the replicas resynchronize fully.
+  Status IngestSSTFiles(const std::string &dir, bool move_files, uint64_t *num_files);
+  // The replicas which don't have the sequence number missed the data changed outside the WAL,
+  // e.g. the bulk loaded data or the column families of the namespaces
+  rocksdb::SequenceNumber GetResyncSeq() { return resync_seq_; }
+
+  // The keys of the namespaces in namespace-column-families are stored in the column families
+  // dedicated to the namespaces, whose names are <column family>@<namespace>@<generation>.
+  // The reads and writes through the storage are routed by the namespace of the keys, so the
+  // callers use the shared column families as before.
+  rocksdb::ColumnFamilyHandle *RouteCFHandle(rocksdb::ColumnFamilyHandle *cf_handle, const rocksdb::Slice &key);
+  bool HasNamespaceCFs(const std::string &ns) { return namespace_cfs_.count(ns) > 0; }
+  std::vector<std::string> GetNamespacesWithCFs();
+  // Drop all keys of the namespace by replacing its column families with the empty ones
+  rocksdb::Status ResetNamespaceCFs(const std::string &ns);
+  // The column families of the name including those of the namespaces, or all if the name is empty
+  std::vector<rocksdb::ColumnFamilyHandle *> GetAllCFHandles(const std::string &name = "");
 
   rocksdb::Status Compact(const rocksdb::Slice *begin, const rocksdb::Slice *end);
   rocksdb::DB *GetDB();
@@ -100,12 +241,48 @@ class Storage {
   rocksdb::ColumnFamilyHandle *GetCFHandle(const std::string &name);
   std::vector<rocksdb::ColumnFamilyHandle *> *GetCFHandles() { return &cf_handles_; }
   LockManager *GetLockManager() { return &lock_mgr_; }
+  MetadataCache *GetMetadataCache() { return &metadata_cache_; }
+  ScanIteratorCache *GetScanIteratorCache() { return &scan_iterator_cache_; }
+  KeyReclaimer *GetKeyReclaimer() { return key_reclaimer_.get(); }
+  LazyExpirer *GetLazyExpirer() { return lazy_expirer_.get(); }
+  CacheWarmer *GetCacheWarmer() { return cache_warmer_.get(); }
+  KeyCounter *GetKeyCounter() { return &key_counter_; }
+  BigKeys *GetBigKeys() { return &big_keys_; }
+  NamespaceSizes *GetNamespaceSizes() { return &namespace_sizes_; }
+  LatencyMonitor *GetLatencyMonitor() { return &latency_monitor_; }
+  JobStats *GetJobStats() { return &job_stats_; }
+  TombstoneTracker *GetTombstoneTracker() { return &tombstone_tracker_; }
   void PurgeOldBackups(uint32_t num_backups_to_keep, uint32_t backup_max_keep_hours);
+  // The size of the last backup and the bytes copied by it, or -1 if unknown
+  int64_t GetLastBackupSize() { return last_backup_size_; }
+  int64_t GetLastBackupCopiedBytes() { return last_backup_copied_bytes_; }
   uint64_t GetTotalSize(const std::string &ns = kDefaultNamespace);
+  struct StorageTierStats {
+    uint64_t size = 0;
+    uint64_t reads = 0;
+    uint64_t read_micros = 0;
+  };
+  // Return false if rocksdb.subkey_cold_dir isn't configured
+  bool GetStorageTierStats(std::array<StorageTierStats, kNumStorageTiers> *stats);
   Status CheckDBSizeLimit();
   void SetIORateLimit(uint64_t max_io_mb);
+  // Tune the IO rate limit of the flushes and compactions in [max_io_mb/16, max_io_mb] by the average
+  // latency of the foreground reads since the last call, it's max_io_mb if boost, e.g. compacting manually
+  void AutoTuneIORateLimit(uint64_t max_io_mb, uint64_t target_latency_us, bool boost);
+  int64_t GetIORateLimit() { return rate_limiter_->GetBytesPerSecond(); }
+  // Null if rocksdb.memtable_total_budget is 0
+  rocksdb::WriteBufferManager *GetWriteBufferManager() { return write_buffer_manager_.get(); }
+  rocksdb::Cache *GetBlobCache() { return blob_cache_.get(); }
+  // Null if rocksdb.block_cache_huge_pages is disabled or the allocator isn't supported
+  HugePageAllocator *GetBlockCacheAllocator() { return block_cache_allocator_.get(); }
+  // They're the same cache if rocksdb.share_metadata_and_subkey_block_cache is enabled
+  rocksdb::Cache *GetMetadataBlockCache() { return metadata_block_cache_.get(); }
+  rocksdb::Cache *GetSubkeyBlockCache() { return subkey_block_cache_.get(); }
+  WorkloadTuner *GetWorkloadTuner() { return workload_tuner_.get(); }
 
   std::unique_ptr<RWLock::ReadLock> ReadLockGuard();
+  // Return nullptr rather than waiting if the DB is being closed or restored
+  std::unique_ptr<RWLock::ReadLock> TryReadLockGuard();
   std::unique_ptr<RWLock::WriteLock> WriteLockGuard();
 
   uint64_t GetFlushCount() { return flush_count_; }
@@ -113,6 +290,7 @@ class Storage {
   uint64_t GetCompactionCount() { return compaction_count_; }
   void IncrCompactionCount(uint64_t n) { compaction_count_.fetch_add(n); }
   bool IsSlotIdEncoded() { return config_->slot_id_encoded; }
+  Config *GetConfig() { return config_; }
 
   Storage(const Storage &) = delete;
   Storage &operator=(const Storage &) = delete;
@@ -142,35 +320,130 @@ class Storage {
     static std::unique_ptr<rocksdb::WritableFile> NewTmpFile(Storage *storage, const std::string &dir,
                                                              const std::string &repl_file);
     static Status SwapTmpFile(Storage *storage, const std::string &dir, const std::string &repl_file);
+    // The tmp file left by the interrupted fetching is kept to be resumed, return its size
+    // and the crc32c checksum of its content
+    static Status GetTmpFileInfo(Storage *storage, const std::string &dir, const std::string &repl_file,
+                                 uint64_t *size, uint32_t *crc);
+    static std::unique_ptr<rocksdb::WritableFile> ReopenTmpFile(Storage *storage, const std::string &dir,
+                                                                const std::string &repl_file);
+    static void RemoveTmpFile(Storage *storage, const std::string &dir, const std::string &repl_file);
     static bool FileExists(Storage *storage, const std::string &dir, const std::string &repl_file, uint32_t crc);
   };
 
   bool ExistCheckpoint();
   bool ExistSyncCheckpoint();
+  bool ExistPinnedReplFiles();
+  void ReleasePinnedReplFiles();
   void SetCheckpointCreateTime(time_t t) { checkpoint_info_.create_time = t; }
   time_t GetCheckpointCreateTime() { return checkpoint_info_.create_time; }
   void SetCheckpointAccessTime(time_t t) { checkpoint_info_.access_time = t; }
   time_t GetCheckpointAccessTime() { return checkpoint_info_.access_time; }
   void SetDBInRetryableIOError(bool yes_or_no) { db_in_retryable_io_error_ = yes_or_no; }
   bool IsDBInRetryableIOError() { return db_in_retryable_io_error_; }
+  // Called by the event listener when the write stall condition of a column family was changed
+  void UpdateWriteStallCondition(rocksdb::WriteStallCondition prev, rocksdb::WriteStallCondition cur);
+  bool IsWriteStopped() { return write_stopped_cfs_ > 0; }
+  bool IsWriteDelayed() { return write_delayed_cfs_ > 0; }
+  // Wait at most timeout_ms until none of the column families stops the writes,
+  // return false if the writes are still stopped
+  bool WaitForWriteStallEnd(int64_t timeout_ms);
 
   bool ShiftReplId();
+  // The replica inherits the replication id of its master from the replicated batches, so the
+  // replication history is carried through the replicas of the replica
+  void SetReplId(const std::string &replid);
+  std::string GetReplId();
   std::string GetReplIdFromWalBySeq(rocksdb::SequenceNumber seq);
   std::string GetReplIdFromDbEngine();
 
  private:
+  void invalidateMetadataCache(rocksdb::WriteBatch *batch);
+  void updateBigKeys(rocksdb::WriteBatch *batch);
+  void updateNamespaceSizes(rocksdb::WriteBatch *batch);
+  void appendTTLIndex(rocksdb::WriteBatch *batch);
+  Status pinReplFiles();
+  rocksdb::Iterator *newIterator(const rocksdb::ReadOptions &options, rocksdb::ColumnFamilyHandle *column_family);
+  // Rewrite the column families of the batch into those of the namespaces or back into the shared ones,
+  // changed is set if any one was rewritten
+  rocksdb::Status rewriteBatchCFs(rocksdb::WriteBatch *batch, bool to_namespace, rocksdb::WriteBatch *rewritten,
+                                  bool *changed);
+  bool sharedCFID(uint32_t id, uint32_t *shared_id);
+  KeyCounter::MetadataCFRouter metadataCFHandleOf() {
+    return [this](const rocksdb::Slice &ns_key) { return RouteCFHandle(cf_handles_[kColumnFamilyIDMetadata], ns_key); };
+  }
+  // Refuse the replicas missing the data changed outside the WAL to continue, and resynchronize
+  // those streaming the WAL once they apply the marker
+  Status requireResync(const char *marker);
+  // The incremental backups in the backup dir are managed by the BackupEngine, whose backups
+  // share the unchanged SST files
+  bool isIncrementalBackup(const std::string &backup_dir);
+  rocksdb::BackupEngineOptions incrementalBackupOptions(const std::string &backup_dir);
+  Status createIncrementalBackup(const std::string &backup_dir);
+  Status destroyIncrementalBackup(const std::string &backup_dir);
+  // Stream the backup to the object storage by backup-upload-command, see BackupUploader
+  Status uploadBackup(const std::string &backup_dir);
+  // The immutable SST and blob files are hard linked if possible, the others are copied
+  Status copyCheckpoint(const std::string &from, const std::string &to);
+  // The live file may be on either storage tier
+  std::string liveFilePath(const std::string &file);
+  // The restored DB has all files in the db dir, so they're linked into the cold dir where
+  // RocksDB looks for those placed on the cold tier by the master
+  Status linkColdTierFiles();
+  Status clearColdTier(const std::string &cold_dir);
+
   rocksdb::DB *db_ = nullptr;
+  std::mutex replid_mu_;
   std::string replid_;
   time_t backup_creating_time_;
+  std::atomic<int64_t> last_backup_size_{-1};
+  std::atomic<int64_t> last_backup_copied_bytes_{-1};
   rocksdb::BackupEngine *backup_ = nullptr;
   rocksdb::Env *env_;
   std::shared_ptr<rocksdb::SstFileManager> sst_file_manager_;
+  // Only set if rocksdb.subkey_cold_dir is configured, they live across the reopening of the DB
+  std::shared_ptr<TieredFileSystem> tiered_fs_;
+  std::unique_ptr<rocksdb::Env> tiered_env_;
   std::shared_ptr<rocksdb::RateLimiter> rate_limiter_;
+  // The total count and micros of the foreground reads at the last tuning of the IO rate limit
+  uint64_t io_tune_read_count_ = 0;
+  uint64_t io_tune_read_micros_ = 0;
+  std::shared_ptr<rocksdb::WriteBufferManager> write_buffer_manager_;
+  std::shared_ptr<rocksdb::Cache> blob_cache_;
+  // It's kept across the reopens of the DB, so the huge pages retained by it are reused
+  std::shared_ptr<HugePageAllocator> block_cache_allocator_;
+  std::shared_ptr<rocksdb::Cache> metadata_block_cache_;
+  std::shared_ptr<rocksdb::Cache> subkey_block_cache_;
   ReplDataManager::CheckpointInfo checkpoint_info_;
   std::mutex checkpoint_mu_;
+  // The live files pinned for the diskless full synchronization and their sizes to be sent,
+  // they're guarded by checkpoint_mu_. The CURRENT file may be rewritten, so its content is kept.
+  std::map<std::string, uint64_t> pinned_repl_files_;
+  std::string pinned_current_;
   Config *config_ = nullptr;
   std::vector<rocksdb::ColumnFamilyHandle *> cf_handles_;
+  struct NamespaceCFs {
+    uint64_t generation = 0;
+    // Indexed by the ColumnFamilyID, those not in kNamespaceColumnFamilyIDs are null
+    std::array<std::atomic<rocksdb::ColumnFamilyHandle *>, kNumColumnFamilies> handles{};
+  };
+  // Only changed while opening or closing the DB, the handles are replaced after the reset
+  std::map<std::string, std::unique_ptr<NamespaceCFs>, std::less<>> namespace_cfs_;
+  std::mutex namespace_cfs_mu_;
+  // The replaced handles may be still used by the readers, so they're destroyed while closing the DB
+  std::vector<rocksdb::ColumnFamilyHandle *> dropped_cf_handles_;
   LockManager lock_mgr_;
+  MetadataCache metadata_cache_;
+  ScanIteratorCache scan_iterator_cache_;
+  std::unique_ptr<KeyReclaimer> key_reclaimer_;
+  std::unique_ptr<LazyExpirer> lazy_expirer_;
+  std::unique_ptr<CacheWarmer> cache_warmer_;
+  std::unique_ptr<WorkloadTuner> workload_tuner_;
+  KeyCounter key_counter_;
+  BigKeys big_keys_;
+  NamespaceSizes namespace_sizes_;
+  LatencyMonitor latency_monitor_;
+  JobStats job_stats_;
+  TombstoneTracker tombstone_tracker_;
   bool reach_db_size_limit_ = false;
   std::atomic<uint64_t> flush_count_{0};
   std::atomic<uint64_t> compaction_count_{0};
@@ -179,8 +452,51 @@ class Storage {
   bool db_closing_ = true;
 
   std::atomic<bool> db_in_retryable_io_error_{false};
+  std::atomic<rocksdb::SequenceNumber> resync_seq_{0};
+
+  // The number of the column families whose writes are stopped or delayed by the write stall
+  std::atomic<int> write_stopped_cfs_{0};
+  std::atomic<int> write_delayed_cfs_{0};
+  std::mutex write_stall_mu_;
+  std::condition_variable write_stall_cv_;
+
+  // The waiters of the new data of the WAL, see WaitForWALData
+  std::mutex wal_wait_mu_;
+  std::condition_variable wal_wait_cv_;
+  std::atomic<int> wal_waiters_{0};
+  // The fd armed by ArmWALWakeup, or -1
+  std::atomic<int> wal_wakeup_fd_{-1};
+
+  struct WritingVersion {
+    // The epoch when the version was finished, or 0 if it's still being written
+    uint64_t removed_epoch = 0;
+    // Whether the version is written by this server, or it's restored from a marker
+    bool local = false;
+  };
+  rocksdb::Status loadWritingVersions();
+  void registerWritingVersion(uint64_t version, bool local);
+  void releaseWritingVersion(uint64_t version, bool removed);
+  void gcWritingVersions();
+  // The epoch is increased when a compaction filter is created or a version is finished, so a finished
+  // version is only needed by the filters created before it
+  std::mutex writing_versions_mu_;
+  std::unordered_map<uint64_t, WritingVersion> writing_versions_;
+  std::multiset<uint64_t> compaction_filter_epochs_;
+  uint64_t writing_versions_epoch_ = 0;
+  std::atomic<size_t> writing_versions_count_{0};
+  std::atomic<int> failing_txn_commits_{0};
+
+  // The batches were applied without the WAL since the last flush, and when the first one was applied
+  std::mutex replica_unflushed_mu_;
+  bool replica_unflushed_ = false;
+  int64_t replica_unflushed_since_ = 0;
+  std::atomic<bool> replica_writes_lost_{false};
+
+  std::string replicaUnflushedPath() { return config_->db_dir + "/REPLICA_UNFLUSHED_SEQ"; }
 
   rocksdb::WriteOptions write_opts_ = rocksdb::WriteOptions();
+
+  void notifyWALWaiters();
 };
 
 }  // namespace Engine
@@ -20,10 +20,12 @@
 
 #include "table_properties_collector.h"
 
+#include <algorithm>
 #include <memory>
 #include <utility>
 
 #include "encoding.h"
+#include "parse_util.h"
 #include "redis_metadata.h"
 #include "server/server.h"
 
@@ -53,18 +55,33 @@ rocksdb::Status CompactOnExpiredCollector::AddUserKey(const rocksdb::Slice &key,
     return rocksdb::Status::OK();
   }
   GetFixed8(&cv, &type);
-  GetFixed32(&cv, &expired);
+  bool compact = (type & kMetadataCompactEncoded) != 0;
   type = type & (uint8_t)0x0f;
-  if (type == kRedisBitmap || type == kRedisSet || type == kRedisList || type == kRedisHash || type == kRedisZSet ||
-      type == kRedisSortedint) {
-    if (cv.size() <= 12) return rocksdb::Status::OK();
-    GetFixed64(&cv, &version);
-    GetFixed32(&cv, &subkeys);
+  bool has_subkeys = type == kRedisBitmap || type == kRedisSet || type == kRedisList || type == kRedisHash ||
+                     type == kRedisZSet || type == kRedisSortedint || type == kRedisHyperLogLog ||
+                     type == kRedisBloomFilter;
+  if (compact) {
+    // The strings are never in the compact encoding, so the value is only the metadata
+    Metadata metadata(kRedisNone, false);
+    if (!metadata.Decode(value.ToString()).ok()) return rocksdb::Status::OK();
+    expired = static_cast<uint32_t>(metadata.expire);
+    if (has_subkeys) subkeys = metadata.size;
+  } else {
+    GetFixed32(&cv, &expired);
+    if (has_subkeys) {
+      if (cv.size() <= 12) return rocksdb::Status::OK();
+      GetFixed64(&cv, &version);
+      GetFixed32(&cv, &subkeys);
+    }
   }
   total_keys_ += subkeys;
   now = Server::GetUnixTime();
   if ((expired > 0 && expired < static_cast<uint32_t>(now)) || (type != kRedisString && subkeys == 0)) {
     deleted_keys_ += subkeys + 1;
+  } else if (expired > 0) {
+    min_expire_ = std::min(min_expire_, expired);
+    max_expire_ = std::max(max_expire_, expired);
+    expiring_keys_ += subkeys + 1;
   }
   return rocksdb::Status::OK();
 }
@@ -72,6 +89,11 @@ rocksdb::Status CompactOnExpiredCollector::AddUserKey(const rocksdb::Slice &key,
 rocksdb::Status CompactOnExpiredCollector::Finish(rocksdb::UserCollectedProperties *properties) {
   properties->insert(std::pair<std::string, std::string>{"total_keys", std::to_string(total_keys_)});
   properties->insert(std::pair<std::string, std::string>{"deleted_keys", std::to_string(deleted_keys_)});
+  if (expiring_keys_ > 0) {
+    properties->insert(std::pair<std::string, std::string>{"min_expire", std::to_string(min_expire_)});
+    properties->insert(std::pair<std::string, std::string>{"max_expire", std::to_string(max_expire_)});
+    properties->insert(std::pair<std::string, std::string>{"expiring_keys", std::to_string(expiring_keys_)});
+  }
   properties->insert(std::pair<std::string, std::string>{"start_key", start_key_});
   properties->insert(std::pair<std::string, std::string>{"stop_key", stop_key_});
   return rocksdb::Status::OK();
@@ -81,6 +103,11 @@ rocksdb::UserCollectedProperties CompactOnExpiredCollector::GetReadablePropertie
   rocksdb::UserCollectedProperties properties;
   properties.insert(std::pair<std::string, std::string>{"total_keys", std::to_string(total_keys_)});
   properties.insert(std::pair<std::string, std::string>{"deleted_keys", std::to_string(deleted_keys_)});
+  if (expiring_keys_ > 0) {
+    properties.insert(std::pair<std::string, std::string>{"min_expire", std::to_string(min_expire_)});
+    properties.insert(std::pair<std::string, std::string>{"max_expire", std::to_string(max_expire_)});
+    properties.insert(std::pair<std::string, std::string>{"expiring_keys", std::to_string(expiring_keys_)});
+  }
   return properties;
 }
 
@@ -98,3 +125,20 @@ std::shared_ptr<CompactOnExpiredTableCollectorFactory> NewCompactOnExpiredTableC
     const std::string &cf_name, float trigger_threshold) {
   return std::make_shared<CompactOnExpiredTableCollectorFactory>(cf_name, trigger_threshold);
 }
+
+int64_t EstimateDeletedKeys(const rocksdb::UserCollectedProperties &properties, int64_t now) {
+  auto get = [&properties](const std::string &name) -> int64_t {
+    auto iter = properties.find(name);
+    if (iter == properties.end()) return 0;
+    auto parse_result = ParseInt<int64_t>(iter->second, 10);
+    return parse_result ? *parse_result : 0;
+  };
+
+  int64_t deleted_keys = get("deleted_keys");
+  int64_t expiring_keys = get("expiring_keys");
+  int64_t min_expire = get("min_expire"), max_expire = get("max_expire");
+  if (expiring_keys <= 0 || now < min_expire) return deleted_keys;
+  if (now >= max_expire) return deleted_keys + expiring_keys;
+  double expired_ratio = static_cast<double>(now - min_expire) / static_cast<double>(max_expire - min_expire);
+  return deleted_keys + static_cast<int64_t>(static_cast<double>(expiring_keys) * expired_ratio);
+}
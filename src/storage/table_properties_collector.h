@@ -22,6 +22,7 @@
 
 #include <rocksdb/table_properties.h>
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <utility>
@@ -42,6 +43,11 @@ class CompactOnExpiredCollector : public rocksdb::TablePropertiesCollector {
   float trigger_threshold_;
   int64_t total_keys_ = 0;
   int64_t deleted_keys_ = 0;
+  // The range of the expire timestamps of the keys which weren't expired yet while collecting, and the
+  // number of the keys and subkeys covered, so the keys expired since then could be estimated
+  uint32_t min_expire_ = UINT32_MAX;
+  uint32_t max_expire_ = 0;
+  int64_t expiring_keys_ = 0;
   std::string start_key_;
   std::string stop_key_;
 };
@@ -64,3 +70,7 @@ class CompactOnExpiredTableCollectorFactory : public rocksdb::TablePropertiesCol
 
 extern std::shared_ptr<CompactOnExpiredTableCollectorFactory> NewCompactOnExpiredTableCollectorFactory(
     const std::string &cf_name, float trigger_threshold);
+
+// Estimate the deleted keys of the file by now, i.e. the deleted keys while collecting and the expiring keys
+// expired since then, the expire timestamps are assumed to be evenly distributed between the min and the max
+int64_t EstimateDeletedKeys(const rocksdb::UserCollectedProperties &properties, int64_t now);
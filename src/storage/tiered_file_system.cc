@@ -0,0 +1,85 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "tiered_file_system.h"
+
+#include <chrono>
+
+namespace Engine {
+
+namespace {
+
+class TieredRandomAccessFile : public rocksdb::FSRandomAccessFileOwnerWrapper {
+ public:
+  TieredRandomAccessFile(std::unique_ptr<rocksdb::FSRandomAccessFile> &&file, StorageTierReadStats *stats)
+      : rocksdb::FSRandomAccessFileOwnerWrapper(std::move(file)), stats_(stats) {}
+
+  rocksdb::IOStatus Read(uint64_t offset, size_t n, const rocksdb::IOOptions &options, rocksdb::Slice *result,
+                         char *scratch, rocksdb::IODebugContext *dbg) const override {
+    auto start = std::chrono::steady_clock::now();
+    auto s = rocksdb::FSRandomAccessFileOwnerWrapper::Read(offset, n, options, result, scratch, dbg);
+    record(start, 1);
+    return s;
+  }
+
+  rocksdb::IOStatus MultiRead(rocksdb::FSReadRequest *reqs, size_t num_reqs, const rocksdb::IOOptions &options,
+                              rocksdb::IODebugContext *dbg) override {
+    auto start = std::chrono::steady_clock::now();
+    auto s = rocksdb::FSRandomAccessFileOwnerWrapper::MultiRead(reqs, num_reqs, options, dbg);
+    record(start, num_reqs);
+    return s;
+  }
+
+ private:
+  StorageTierReadStats *stats_;
+
+  void record(std::chrono::steady_clock::time_point start, size_t reads) const {
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    stats_->reads.fetch_add(reads, std::memory_order_relaxed);
+    stats_->read_micros.fetch_add(micros.count(), std::memory_order_relaxed);
+  }
+};
+
+}  // namespace
+
+TieredFileSystem::TieredFileSystem(const std::shared_ptr<rocksdb::FileSystem> &base, std::string cold_dir)
+    : rocksdb::FileSystemWrapper(base), cold_dir_(std::move(cold_dir)) {
+  while (cold_dir_.size() > 1 && cold_dir_.back() == '/') cold_dir_.pop_back();
+}
+
+rocksdb::IOStatus TieredFileSystem::NewRandomAccessFile(const std::string &fname,
+                                                        const rocksdb::FileOptions &file_opts,
+                                                        std::unique_ptr<rocksdb::FSRandomAccessFile> *result,
+                                                        rocksdb::IODebugContext *dbg) {
+  auto s = rocksdb::FileSystemWrapper::NewRandomAccessFile(fname, file_opts, result, dbg);
+  if (!s.ok()) return s;
+  *result = std::make_unique<TieredRandomAccessFile>(std::move(*result), &read_stats_[TierOf(fname)]);
+  return s;
+}
+
+StorageTier TieredFileSystem::TierOf(const std::string &path) const {
+  if (path.compare(0, cold_dir_.size(), cold_dir_) == 0 &&
+      (path.size() == cold_dir_.size() || path[cold_dir_.size()] == '/')) {
+    return kStorageTierCold;
+  }
+  return kStorageTierHot;
+}
+
+}  // namespace Engine
@@ -0,0 +1,56 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <rocksdb/file_system.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace Engine {
+
+enum StorageTier { kStorageTierHot = 0, kStorageTierCold = 1, kNumStorageTiers };
+
+struct StorageTierReadStats {
+  std::atomic<uint64_t> reads = 0;
+  std::atomic<uint64_t> read_micros = 0;
+};
+
+// Count the reads of the SST files and their latency on each storage tier, the files under
+// the cold dir are on the cold tier and the others are on the hot tier.
+class TieredFileSystem : public rocksdb::FileSystemWrapper {
+ public:
+  TieredFileSystem(const std::shared_ptr<rocksdb::FileSystem> &base, std::string cold_dir);
+  const char *Name() const override { return "TieredFileSystem"; }
+  rocksdb::IOStatus NewRandomAccessFile(const std::string &fname, const rocksdb::FileOptions &file_opts,
+                                        std::unique_ptr<rocksdb::FSRandomAccessFile> *result,
+                                        rocksdb::IODebugContext *dbg) override;
+
+  StorageTier TierOf(const std::string &path) const;
+  const StorageTierReadStats &GetReadStats(StorageTier tier) const { return read_stats_[tier]; }
+
+ private:
+  std::string cold_dir_;
+  StorageTierReadStats read_stats_[kNumStorageTiers];
+};
+
+}  // namespace Engine
@@ -0,0 +1,143 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "tombstone_tracker.h"
+
+#include <rocksdb/perf_context.h>
+
+#include <algorithm>
+
+void TombstoneTracker::Record(uint32_t cf_id, const std::string &begin, const std::string &end, uint64_t skipped,
+                              uint64_t visited) {
+  Range merged{cf_id, begin, std::max(begin, end), skipped, visited};
+  std::lock_guard<std::mutex> guard(mu_);
+  // The ranges are disjoint, so the ones overlapping [begin, end] are contiguous before the end
+  auto iter = ranges_.upper_bound({cf_id, merged.end});
+  while (iter != ranges_.begin()) {
+    auto prev = std::prev(iter);
+    if (prev->first.first != cf_id || prev->second.end < merged.begin) break;
+    merged.begin = std::min(merged.begin, prev->second.begin);
+    merged.end = std::max(merged.end, prev->second.end);
+    merged.skipped += prev->second.skipped;
+    merged.visited += prev->second.visited;
+    iter = ranges_.erase(prev);
+  }
+
+  if (ranges_.size() >= max_ranges_) {
+    // Evict the range with the fewest skipped tombstones, it's unlikely to be compacted soon
+    auto victim = std::min_element(ranges_.begin(), ranges_.end(), [](const auto &a, const auto &b) {
+      return a.second.skipped < b.second.skipped;
+    });
+    if (victim->second.skipped > merged.skipped) return;
+    ranges_.erase(victim);
+  }
+  std::pair<uint32_t, std::string> key{cf_id, merged.begin};
+  ranges_.emplace(std::move(key), std::move(merged));
+}
+
+std::vector<TombstoneTracker::Range> TombstoneTracker::PickRanges(uint64_t threshold, size_t max_ranges) {
+  std::vector<Range> picked;
+  std::lock_guard<std::mutex> guard(mu_);
+  for (const auto &iter : ranges_) {
+    if (iter.second.skipped >= threshold) picked.emplace_back(iter.second);
+  }
+  std::sort(picked.begin(), picked.end(), [](const Range &a, const Range &b) { return a.Density() > b.Density(); });
+  if (picked.size() > max_ranges) picked.resize(max_ranges);
+  for (const auto &range : picked) {
+    ranges_.erase({range.cf_id, range.begin});
+  }
+  picked_ranges_.fetch_add(picked.size(), std::memory_order_relaxed);
+  return picked;
+}
+
+void TombstoneTracker::Clear() {
+  std::lock_guard<std::mutex> guard(mu_);
+  ranges_.clear();
+}
+
+size_t TombstoneTracker::Size() {
+  std::lock_guard<std::mutex> guard(mu_);
+  return ranges_.size();
+}
+
+TombstoneTrackingIterator::TombstoneTrackingIterator(rocksdb::Iterator *iter, TombstoneTracker *tracker,
+                                                     uint32_t cf_id, const rocksdb::Slice *lower_bound,
+                                                     const rocksdb::Slice *upper_bound)
+    : iter_(iter), tracker_(tracker), cf_id_(cf_id) {
+  if (lower_bound) lower_bound_ = lower_bound->ToString();
+  if (upper_bound) upper_bound_ = upper_bound->ToString();
+  // The perf level is thread local, it's only raised if nobody is profiling on the thread
+  if (rocksdb::GetPerfLevel() < rocksdb::PerfLevel::kEnableCount) {
+    rocksdb::SetPerfLevel(rocksdb::PerfLevel::kEnableCount);
+    perf_level_raised_ = true;
+  }
+  skipped_at_start_ = rocksdb::get_perf_context()->internal_delete_skipped_count;
+}
+
+TombstoneTrackingIterator::~TombstoneTrackingIterator() {
+  uint64_t skipped_now = rocksdb::get_perf_context()->internal_delete_skipped_count;
+  if (perf_level_raised_ && rocksdb::GetPerfLevel() == rocksdb::PerfLevel::kEnableCount) {
+    rocksdb::SetPerfLevel(rocksdb::PerfLevel::kDisable);
+  }
+  // The perf context may be reset by the profiling in the meantime
+  if (!positioned_ || skipped_now < skipped_at_start_) return;
+  uint64_t skipped = skipped_now - skipped_at_start_;
+  if (skipped < TombstoneTracker::kMinReportedTombstones) return;
+
+  if (iter_->Valid()) extend(iter_->key());
+  // The empty lower bound is the smallest key anyway
+  std::string begin = lower_bound_.empty() ? smallest_ : std::min(smallest_, lower_bound_);
+  std::string end = upper_bound_.empty() ? largest_ : std::max(largest_, upper_bound_);
+  tracker_->Record(cf_id_, begin, end, skipped, visited_);
+}
+
+void TombstoneTrackingIterator::extend(const rocksdb::Slice &key) {
+  if (!positioned_) {
+    smallest_ = largest_ = key.ToString();
+    positioned_ = true;
+    return;
+  }
+  if (key.compare(smallest_) < 0) smallest_ = key.ToString();
+  if (key.compare(largest_) > 0) largest_ = key.ToString();
+}
+
+void TombstoneTrackingIterator::SeekToFirst() {
+  extend(rocksdb::Slice());
+  visited_++;
+  iter_->SeekToFirst();
+}
+
+void TombstoneTrackingIterator::SeekToLast() {
+  visited_++;
+  iter_->SeekToLast();
+  if (iter_->Valid()) extend(iter_->key());
+}
+
+void TombstoneTrackingIterator::Seek(const rocksdb::Slice &target) {
+  extend(target);
+  visited_++;
+  iter_->Seek(target);
+}
+
+void TombstoneTrackingIterator::SeekForPrev(const rocksdb::Slice &target) {
+  extend(target);
+  visited_++;
+  iter_->SeekForPrev(target);
+}
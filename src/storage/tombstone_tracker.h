@@ -0,0 +1,113 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <rocksdb/iterator.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Track the tombstones skipped by the iterators per key range rather than per file, the overlapping
+// ranges reported by the iterators are merged, so the ranges where the scans keep skipping the deleted
+// or expired keys are compacted by the compaction checker, instead of waiting days for their files
+// to be picked by the delete ratio.
+class TombstoneTracker {
+ public:
+  struct Range {
+    uint32_t cf_id = 0;
+    std::string begin;
+    std::string end;
+    // The tombstones skipped and the entries visited by the iterators in the range
+    uint64_t skipped = 0;
+    uint64_t visited = 0;
+
+    double Density() const { return static_cast<double>(skipped) / static_cast<double>(skipped + visited + 1); }
+  };
+
+  // The iterators skipping fewer tombstones aren't reported, to keep the tracking cheap
+  static constexpr uint64_t kMinReportedTombstones = 64;
+  static constexpr size_t kMaxTrackedRanges = 1024;
+
+  explicit TombstoneTracker(size_t max_ranges = kMaxTrackedRanges) : max_ranges_(max_ranges) {}
+
+  void Record(uint32_t cf_id, const std::string &begin, const std::string &end, uint64_t skipped,
+              uint64_t visited);
+  // Remove and return at most max_ranges ranges with at least threshold skipped tombstones, the densest first
+  std::vector<Range> PickRanges(uint64_t threshold, size_t max_ranges);
+  void Clear();
+  size_t Size();
+  uint64_t GetPickedRanges() const { return picked_ranges_; }
+
+ private:
+  size_t max_ranges_;
+  std::mutex mu_;
+  // The disjoint ranges ordered by the column family and the begin key
+  std::map<std::pair<uint32_t, std::string>, Range> ranges_;
+  std::atomic<uint64_t> picked_ranges_ = 0;
+};
+
+// Report the tombstones skipped during the lifetime of the iterator to the tracker, the count comes from
+// internal_delete_skipped_count of the perf context, so the perf level is raised to count while it's alive.
+// The range covers the bounds of the read options, the seek targets and the largest key it's positioned on.
+class TombstoneTrackingIterator : public rocksdb::Iterator {
+ public:
+  TombstoneTrackingIterator(rocksdb::Iterator *iter, TombstoneTracker *tracker, uint32_t cf_id,
+                            const rocksdb::Slice *lower_bound, const rocksdb::Slice *upper_bound);
+  ~TombstoneTrackingIterator() override;
+
+  bool Valid() const override { return iter_->Valid(); }
+  void SeekToFirst() override;
+  void SeekToLast() override;
+  void Seek(const rocksdb::Slice &target) override;
+  void SeekForPrev(const rocksdb::Slice &target) override;
+  void Next() override {
+    visited_++;
+    iter_->Next();
+  }
+  void Prev() override {
+    visited_++;
+    iter_->Prev();
+  }
+  rocksdb::Slice key() const override { return iter_->key(); }
+  rocksdb::Slice value() const override { return iter_->value(); }
+  rocksdb::Status status() const override { return iter_->status(); }
+
+ private:
+  void extend(const rocksdb::Slice &key);
+
+  std::unique_ptr<rocksdb::Iterator> iter_;
+  TombstoneTracker *tracker_;
+  uint32_t cf_id_;
+  std::string lower_bound_;
+  std::string upper_bound_;
+  bool perf_level_raised_ = false;
+  uint64_t skipped_at_start_ = 0;
+  uint64_t visited_ = 0;
+  bool positioned_ = false;
+  std::string smallest_;
+  std::string largest_;
+};
@@ -0,0 +1,224 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "workload_tuner.h"
+
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <rocksdb/perf_context.h>
+#include <rocksdb/statistics.h>
+
+#include <algorithm>
+
+#include "config.h"
+#include "storage.h"
+
+namespace Engine {
+
+std::string WorkloadTuner::Signals::ToString() const {
+  return fmt::format(
+      "metadata cache hits/misses: {}/{}, subkey cache hits/misses: {}/{}, keys read/written: {}/{}, "
+      "stall micros: {}, L0 files: {}/{}, pending compaction bytes: {}/{}",
+      metadata_cache_hits, metadata_cache_misses, subkey_cache_hits, subkey_cache_misses, keys_read, keys_written,
+      stall_micros, l0_files, l0_slowdown_trigger, pending_compaction_bytes, pending_compaction_limit);
+}
+
+WorkloadTuner::ReadSampler::ReadSampler(WorkloadTuner *tuner, rocksdb::ColumnFamilyHandle *column_family) {
+  thread_local uint64_t reads = 0;
+  if (++reads % kSampleInterval != 0 || !tuner->storage_->GetConfig()->workload_auto_tune) return;
+  // The column families of the namespaces have their own block caches
+  const auto &cf_handles = *tuner->storage_->GetCFHandles();
+  if (std::find(cf_handles.begin(), cf_handles.end(), column_family) == cf_handles.end()) return;
+
+  tuner_ = tuner;
+  metadata_ = column_family == cf_handles[kColumnFamilyIDMetadata];
+  old_level_ = rocksdb::GetPerfLevel();
+  if (old_level_ < rocksdb::PerfLevel::kEnableCount) rocksdb::SetPerfLevel(rocksdb::PerfLevel::kEnableCount);
+  // The perf context may be accumulated by the profiling of the command, so it's not reset
+  auto perf_context = rocksdb::get_perf_context();
+  hits_ = perf_context->block_cache_hit_count;
+  misses_ = perf_context->block_read_count;
+}
+
+WorkloadTuner::ReadSampler::~ReadSampler() {
+  if (!tuner_) return;
+  auto perf_context = rocksdb::get_perf_context();
+  uint64_t hits = perf_context->block_cache_hit_count - hits_;
+  uint64_t misses = perf_context->block_read_count - misses_;
+  if (old_level_ < rocksdb::PerfLevel::kEnableCount) rocksdb::SetPerfLevel(old_level_);
+  if (metadata_) {
+    tuner_->metadata_cache_hits_ += hits;
+    tuner_->metadata_cache_misses_ += misses;
+  } else {
+    tuner_->subkey_cache_hits_ += hits;
+    tuner_->subkey_cache_misses_ += misses;
+  }
+}
+
+WorkloadTuner::Settings WorkloadTuner::Decide(const Signals &signals, const Bounds &bounds, const Settings &current,
+                                              std::vector<std::string> *reasons) {
+  Settings next = current;
+
+  // Move the capacity to the block cache which misses more, where it saves more reads from the disk
+  uint64_t lookups = signals.metadata_cache_hits + signals.metadata_cache_misses + signals.subkey_cache_hits +
+                     signals.subkey_cache_misses;
+  if (current.metadata_cache_capacity > 0 && current.subkey_cache_capacity > 0 && lookups >= kMinSampledLookups) {
+    size_t total = current.metadata_cache_capacity + current.subkey_cache_capacity;
+    size_t step = total / 100 * kCacheStepPercent;
+    size_t min_capacity = total / 100 * bounds.min_cache_ratio;
+    auto movable = [&](size_t capacity) {
+      return capacity > min_capacity ? std::min(step, capacity - min_capacity) : 0;
+    };
+    if (signals.metadata_cache_misses * 2 > signals.subkey_cache_misses * 3) {
+      size_t moved = movable(current.subkey_cache_capacity);
+      if (moved > 0) {
+        next.metadata_cache_capacity += moved;
+        next.subkey_cache_capacity -= moved;
+        reasons->emplace_back(fmt::format("move {} bytes of the block cache from subkey to metadata", moved));
+      }
+    } else if (signals.subkey_cache_misses * 2 > signals.metadata_cache_misses * 3) {
+      size_t moved = movable(current.metadata_cache_capacity);
+      if (moved > 0) {
+        next.subkey_cache_capacity += moved;
+        next.metadata_cache_capacity -= moved;
+        reasons->emplace_back(fmt::format("move {} bytes of the block cache from metadata to subkey", moved));
+      }
+    }
+  }
+
+  // Catch up with the compaction debt before the writes are stalled, and release the threads once it's paid off
+  bool debt_high = signals.stall_micros > 0 ||
+                   (signals.l0_slowdown_trigger > 0 && signals.l0_files * 2 >= signals.l0_slowdown_trigger) ||
+                   (signals.pending_compaction_limit > 0 &&
+                    signals.pending_compaction_bytes * 4 >= signals.pending_compaction_limit);
+  bool debt_low = signals.stall_micros == 0 && signals.l0_files * 4 < signals.l0_slowdown_trigger &&
+                  (signals.pending_compaction_limit == 0 ||
+                   signals.pending_compaction_bytes * 16 < signals.pending_compaction_limit);
+  int max_compactions = std::max(bounds.min_background_compactions, bounds.max_background_compactions);
+  int compactions =
+      std::clamp(current.max_background_compactions, bounds.min_background_compactions, max_compactions);
+  if (debt_high) {
+    compactions = std::min(compactions + 1, max_compactions);
+  } else if (debt_low) {
+    compactions = std::max(compactions - 1, bounds.min_background_compactions);
+  }
+  if (compactions != current.max_background_compactions) {
+    next.max_background_compactions = compactions;
+    reasons->emplace_back(fmt::format("set max_background_compactions from {} to {}",
+                                      current.max_background_compactions, compactions));
+  }
+
+  // The larger memtables flush less often for the write-heavy workloads, while the smaller ones
+  // leave the memory to the block caches for the read-heavy workloads
+  uint64_t max_write_buffer_size = std::max(bounds.min_write_buffer_size, bounds.max_write_buffer_size);
+  uint64_t write_buffer_size =
+      std::clamp(current.write_buffer_size, bounds.min_write_buffer_size, max_write_buffer_size);
+  uint64_t keys = signals.keys_read + signals.keys_written;
+  if (keys >= kMinKeys && signals.keys_written * 2 >= keys) {
+    write_buffer_size = std::min(write_buffer_size * 2, max_write_buffer_size);
+  } else if (keys >= kMinKeys && signals.keys_written * 10 < keys) {
+    write_buffer_size = std::max(write_buffer_size / 2, bounds.min_write_buffer_size);
+  }
+  if (write_buffer_size != current.write_buffer_size) {
+    next.write_buffer_size = write_buffer_size;
+    reasons->emplace_back(
+        fmt::format("set write_buffer_size from {} to {}", current.write_buffer_size, write_buffer_size));
+  }
+  return next;
+}
+
+WorkloadTuner::Signals WorkloadTuner::collect() {
+  Signals signals;
+  signals.metadata_cache_hits = metadata_cache_hits_.exchange(0);
+  signals.metadata_cache_misses = metadata_cache_misses_.exchange(0);
+  signals.subkey_cache_hits = subkey_cache_hits_.exchange(0);
+  signals.subkey_cache_misses = subkey_cache_misses_.exchange(0);
+
+  auto db = storage_->GetDB();
+  auto stats = db->GetDBOptions().statistics;
+  uint64_t keys_read = stats->getTickerCount(rocksdb::Tickers::NUMBER_KEYS_READ) +
+                       stats->getTickerCount(rocksdb::Tickers::NUMBER_MULTIGET_KEYS_READ);
+  uint64_t keys_written = stats->getTickerCount(rocksdb::Tickers::NUMBER_KEYS_WRITTEN);
+  uint64_t stall_micros = stats->getTickerCount(rocksdb::Tickers::STALL_MICROS);
+  if (keys_read < last_keys_read_ || keys_written < last_keys_written_ || stall_micros < last_stall_micros_) {
+    last_keys_read_ = last_keys_written_ = last_stall_micros_ = 0;
+  }
+  signals.keys_read = keys_read - last_keys_read_;
+  signals.keys_written = keys_written - last_keys_written_;
+  signals.stall_micros = stall_micros - last_stall_micros_;
+  last_keys_read_ = keys_read;
+  last_keys_written_ = keys_written;
+  last_stall_micros_ = stall_micros;
+
+  for (const auto &cf_handle : *storage_->GetCFHandles()) {
+    uint64_t l0_files = 0;
+    db->GetIntProperty(cf_handle, "rocksdb.num-files-at-level0", &l0_files);
+    signals.l0_files = std::max(signals.l0_files, l0_files);
+  }
+  db->GetAggregatedIntProperty("rocksdb.estimate-pending-compaction-bytes", &signals.pending_compaction_bytes);
+  auto cf_options = db->GetOptions(storage_->GetCFHandle(kSubkeyColumnFamilyName));
+  signals.l0_slowdown_trigger = static_cast<uint64_t>(std::max(cf_options.level0_slowdown_writes_trigger, 0));
+  signals.pending_compaction_limit = cf_options.soft_pending_compaction_bytes_limit;
+  return signals;
+}
+
+Status WorkloadTuner::Tune(const Bounds &bounds) {
+  auto guard = storage_->TryReadLockGuard();
+  if (!guard) return Status::OK();
+
+  auto signals = collect();
+  auto db = storage_->GetDB();
+  Settings current;
+  auto metadata_cache = storage_->GetMetadataBlockCache();
+  auto subkey_cache = storage_->GetSubkeyBlockCache();
+  if (metadata_cache && subkey_cache && metadata_cache != subkey_cache) {
+    current.metadata_cache_capacity = metadata_cache->GetCapacity();
+    current.subkey_cache_capacity = subkey_cache->GetCapacity();
+  }
+  current.max_background_compactions = db->GetDBOptions().max_background_compactions;
+  current.write_buffer_size = db->GetOptions(storage_->GetCFHandle(kSubkeyColumnFamilyName)).write_buffer_size;
+
+  std::vector<std::string> reasons;
+  auto next = Decide(signals, bounds, current, &reasons);
+  if (reasons.empty()) return Status::OK();
+  for (const auto &reason : reasons) {
+    LOG(INFO) << "[workload tuner] " << reason << ", " << signals.ToString();
+  }
+  tunings_ += reasons.size();
+
+  // Shrink the block cache before growing the other, so their total never exceeds the bound
+  if (next.metadata_cache_capacity < current.metadata_cache_capacity) {
+    metadata_cache->SetCapacity(next.metadata_cache_capacity);
+    subkey_cache->SetCapacity(next.subkey_cache_capacity);
+  } else if (next.subkey_cache_capacity < current.subkey_cache_capacity) {
+    subkey_cache->SetCapacity(next.subkey_cache_capacity);
+    metadata_cache->SetCapacity(next.metadata_cache_capacity);
+  }
+  if (next.max_background_compactions != current.max_background_compactions) {
+    auto s = storage_->SetDBOption("max_background_compactions", std::to_string(next.max_background_compactions));
+    if (!s.IsOK()) return s;
+  }
+  if (next.write_buffer_size != current.write_buffer_size) {
+    auto s = storage_->SetColumnFamilyOption("write_buffer_size", std::to_string(next.write_buffer_size));
+    if (!s.IsOK()) return s;
+  }
+  return Status::OK();
+}
+
+}  // namespace Engine
@@ -0,0 +1,132 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#pragma once
+
+#include <rocksdb/db.h>
+#include <rocksdb/perf_level.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "status.h"
+
+namespace Engine {
+
+class Storage;
+
+// WorkloadTuner adjusts the options of RocksDB to the workload periodically, within the bounds set
+// by the operator. It compares the signals observed since the last tuning:
+// - the block cache hits and misses of the metadata and the subkey column families, they're sampled
+//   from the point reads through the perf context, since the statistics are shared by the column families
+// - the mix of the keys read and written, the micros of the write stalls, the L0 files and the pending
+//   compaction bytes
+// then moves the capacity between the metadata and the subkey block caches, and raises or lowers
+// max_background_compactions and write_buffer_size. Every change is logged with the signals behind it.
+//
+// The changes are applied to the running DB only, so the configured values are the lower bounds,
+// and they're restored when the DB is reopened.
+class WorkloadTuner {
+ public:
+  struct Bounds {
+    int min_cache_ratio = 0;  // the percentage of the total capacity kept by each of the block caches
+    int min_background_compactions = 0;
+    int max_background_compactions = 0;
+    uint64_t min_write_buffer_size = 0;
+    uint64_t max_write_buffer_size = 0;
+  };
+
+  struct Settings {
+    // Both are 0 if the metadata and the subkey column families share the block cache
+    size_t metadata_cache_capacity = 0;
+    size_t subkey_cache_capacity = 0;
+    int max_background_compactions = 0;
+    uint64_t write_buffer_size = 0;
+  };
+
+  struct Signals {
+    uint64_t metadata_cache_hits = 0;
+    uint64_t metadata_cache_misses = 0;
+    uint64_t subkey_cache_hits = 0;
+    uint64_t subkey_cache_misses = 0;
+    uint64_t keys_read = 0;
+    uint64_t keys_written = 0;
+    uint64_t stall_micros = 0;
+    uint64_t l0_files = 0;  // the most of the column families
+    uint64_t l0_slowdown_trigger = 0;
+    uint64_t pending_compaction_bytes = 0;
+    uint64_t pending_compaction_limit = 0;  // the soft limit, 0 if unlimited
+
+    std::string ToString() const;
+  };
+
+  // Sample the block cache hits and misses of one in kSampleInterval point reads, it's put around the read
+  class ReadSampler {
+   public:
+    ReadSampler(WorkloadTuner *tuner, rocksdb::ColumnFamilyHandle *column_family);
+    ~ReadSampler();
+
+    ReadSampler(const ReadSampler &) = delete;
+    ReadSampler &operator=(const ReadSampler &) = delete;
+
+   private:
+    WorkloadTuner *tuner_ = nullptr;  // null if the read isn't sampled
+    bool metadata_ = false;
+    rocksdb::PerfLevel old_level_ = rocksdb::PerfLevel::kDisable;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+  };
+
+  explicit WorkloadTuner(Storage *storage) : storage_(storage) {}
+
+  WorkloadTuner(const WorkloadTuner &) = delete;
+  WorkloadTuner &operator=(const WorkloadTuner &) = delete;
+
+  Status Tune(const Bounds &bounds);
+  // Decide the settings by the signals, and explain the changes of the settings in the reasons
+  static Settings Decide(const Signals &signals, const Bounds &bounds, const Settings &current,
+                         std::vector<std::string> *reasons);
+
+  uint64_t GetTunings() const { return tunings_; }
+
+  static constexpr uint64_t kSampleInterval = 64;
+  // The signals are too few to act on below these, e.g. while the server is almost idle
+  static constexpr uint64_t kMinSampledLookups = 128;
+  static constexpr uint64_t kMinKeys = 1000;
+  // The capacity moved between the block caches in a tuning, in the percentage of their total
+  static constexpr int kCacheStepPercent = 5;
+
+ private:
+  Signals collect();
+
+  Storage *storage_;
+  std::atomic<uint64_t> metadata_cache_hits_ = 0;
+  std::atomic<uint64_t> metadata_cache_misses_ = 0;
+  std::atomic<uint64_t> subkey_cache_hits_ = 0;
+  std::atomic<uint64_t> subkey_cache_misses_ = 0;
+  // The tickers at the last tuning, the statistics are reset with the DB
+  uint64_t last_keys_read_ = 0;
+  uint64_t last_keys_written_ = 0;
+  uint64_t last_stall_micros_ = 0;
+  std::atomic<uint64_t> tunings_ = 0;
+};
+
+}  // namespace Engine
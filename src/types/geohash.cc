@@ -59,6 +59,12 @@
 
 #include <math.h>
 
+#include <algorithm>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#endif
+
 constexpr double D_R = M_PI / 180.0;
 
 // @brief The usual PI/180 constant
@@ -149,6 +155,25 @@ static inline uint64_t deinterleave64(uint64_t interleaved) {
   return x | (y << 32);
 }
 
+/* PDEP/PEXT do the same in one instruction each, but they're microcoded and much slower than the
+ * shifts on AMD before Zen 3, so they're only used on the other CPUs with BMI2. */
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+__attribute__((target("bmi2"))) static uint64_t interleave64BMI2(uint32_t xlo, uint32_t ylo) {
+  return _pdep_u64(xlo, 0x5555555555555555ULL) | _pdep_u64(ylo, 0xAAAAAAAAAAAAAAAAULL);
+}
+
+__attribute__((target("bmi2"))) static uint64_t deinterleave64BMI2(uint64_t interleaved) {
+  return _pext_u64(interleaved, 0x5555555555555555ULL) | (_pext_u64(interleaved, 0xAAAAAAAAAAAAAAAAULL) << 32);
+}
+
+static bool useBMI2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("bmi2") && !__builtin_cpu_is("amd");
+}
+#else
+static bool useBMI2() { return false; }
+#endif
+
 void geohashGetCoordRange(GeoHashRange *long_range, GeoHashRange *lat_range) {
   /* These are constraints from EPSG:900913 / EPSG:3785 / OSGEO:41001 */
   /* We can't geocode at the north/south pole. */
@@ -374,9 +399,39 @@ int GeoHashHelper::BoundingBox(double longitude, double latitude, double radius_
   return 1;
 }
 
+/* The bounding box of the rectangle is wider at the side nearer to the pole,
+ * since the same width takes more longitude degrees there. */
+int GeoHashHelper::BoundingBox(const GeoShape &shape, double *bounds) {
+  if (!bounds) return 0;
+  double longitude = shape.xy[0], latitude = shape.xy[1];
+  if (shape.type == kGeoShapeCircle) return BoundingBox(longitude, latitude, shape.radius, bounds);
+
+  const double lat_delta = rad_deg(shape.height / 2 / EARTH_RADIUS_IN_METERS);
+  const double long_delta_top = rad_deg(shape.width / 2 / EARTH_RADIUS_IN_METERS / cos(deg_rad(latitude + lat_delta)));
+  const double long_delta_bottom =
+      rad_deg(shape.width / 2 / EARTH_RADIUS_IN_METERS / cos(deg_rad(latitude - lat_delta)));
+  bool southern_hemisphere = latitude < 0;
+  bounds[0] = southern_hemisphere ? longitude - long_delta_bottom : longitude - long_delta_top;
+  bounds[2] = southern_hemisphere ? longitude + long_delta_bottom : longitude + long_delta_top;
+  bounds[1] = latitude - lat_delta;
+  bounds[3] = latitude + lat_delta;
+  return 1;
+}
+
 /* Return a set of areas (center + 8) that are able to cover a range query
  * for the specified position and radius. */
 GeoHashRadius GeoHashHelper::GetAreasByRadius(double longitude, double latitude, double radius_meters) {
+  GeoShape shape;
+  shape.type = kGeoShapeCircle;
+  shape.xy[0] = longitude;
+  shape.xy[1] = latitude;
+  shape.radius = radius_meters;
+  return GetAreasByShapeWGS84(shape);
+}
+
+/* Return a set of areas (center + 8) that are able to cover the search shape,
+ * the rectangle is covered as the circle which passes through its corners. */
+GeoHashRadius GeoHashHelper::GetAreasByShapeWGS84(const GeoShape &shape) {
   GeoHashRange long_range, lat_range;
   GeoHashRadius radius;
   GeoHashBits hash;
@@ -385,8 +440,12 @@ GeoHashRadius GeoHashHelper::GetAreasByRadius(double longitude, double latitude,
   double min_lon = NAN, max_lon = NAN, min_lat = NAN, max_lat = NAN;
   double bounds[4];
   int steps = 0;
+  double longitude = shape.xy[0], latitude = shape.xy[1];
+  double radius_meters = shape.type == kGeoShapeCircle
+                             ? shape.radius
+                             : sqrt((shape.width / 2) * (shape.width / 2) + (shape.height / 2) * (shape.height / 2));
 
-  BoundingBox(longitude, latitude, radius_meters, bounds);
+  BoundingBox(shape, bounds);
   min_lon = bounds[0];
   min_lat = bounds[1];
   max_lon = bounds[2];
@@ -487,3 +546,132 @@ int GeoHashHelper::GetDistanceIfInRadiusWGS84(double x1, double y1, double x2, d
                                               double *distance) {
   return GetDistanceIfInRadius(x1, y1, x2, y2, radius, distance);
 }
+
+double GeoHashHelper::GetLatDistance(double lat1d, double lat2d) {
+  return EARTH_RADIUS_IN_METERS * fabs(deg_rad(lat2d) - deg_rad(lat1d));
+}
+
+/* The point (x2, y2) is in the rectangle centered at (x1, y1) if its distances
+ * to the center along the latitude and the longitude are both in range. */
+int GeoHashHelper::GetDistanceIfInRectangle(double width_m, double height_m, double x1, double y1, double x2,
+                                            double y2, double *distance) {
+  double lon_distance = GetDistance(x2, y2, x1, y2);
+  double lat_distance = GetLatDistance(y2, y1);
+  if (lon_distance > width_m / 2 || lat_distance > height_m / 2) return 0;
+  *distance = GetDistance(x1, y1, x2, y2);
+  return 1;
+}
+
+int GeoHashHelper::GetDistanceIfInShape(const GeoShape &shape, double x2, double y2, double *distance) {
+  if (shape.type == kGeoShapeCircle) {
+    return GetDistanceIfInRadiusWGS84(shape.xy[0], shape.xy[1], x2, y2, shape.radius, distance);
+  }
+  return GetDistanceIfInRectangle(shape.width, shape.height, shape.xy[0], shape.xy[1], x2, y2, distance);
+}
+
+/* A lower bound of the distances from the point to all the points in the area.
+ * The distance along the meridian to the latitude range is one, and since any
+ * path to the points beyond a meridian crosses it, the distance to that
+ * meridian, i.e. asin(cos(lat) * sin(delta_lon)), is another one. */
+double GeoHashHelper::GetMinDistanceToArea(double longitude, double latitude, const GeoHashArea &area) {
+  double lat_gap = 0, lon_gap = 0;
+  if (latitude < area.latitude.min) {
+    lat_gap = area.latitude.min - latitude;
+  } else if (latitude > area.latitude.max) {
+    lat_gap = latitude - area.latitude.max;
+  }
+  if (longitude < area.longitude.min || longitude > area.longitude.max) {
+    double to_min = fabs(longitude - area.longitude.min), to_max = fabs(longitude - area.longitude.max);
+    lon_gap = std::min({to_min, 360 - to_min, to_max, 360 - to_max});
+  }
+  double lat_distance = EARTH_RADIUS_IN_METERS * deg_rad(lat_gap);
+  double lon_distance = 0;
+  if (lon_gap < 90) lon_distance = EARTH_RADIUS_IN_METERS * asin(cos(deg_rad(latitude)) * sin(deg_rad(lon_gap)));
+  return std::max(lat_distance, lon_distance);
+}
+
+/* The same as geohashEncodeWGS84 and Align52Bits at GEO_STEP_MAX, the invalid points are 0 */
+template <uint64_t (*Interleave)(uint32_t, uint32_t)>
+static void encodeScoresWGS84(const double *longitudes, const double *latitudes, size_t n, GeoHashFix52Bits *bits) {
+  for (size_t i = 0; i < n; i++) {
+    double longitude = longitudes[i], latitude = latitudes[i];
+    if (longitude > GEO_LONG_MAX || longitude < GEO_LONG_MIN || latitude > GEO_LAT_MAX || latitude < GEO_LAT_MIN) {
+      bits[i] = 0;
+      continue;
+    }
+    double lat_offset = (latitude - GEO_LAT_MIN) / (GEO_LAT_MAX - GEO_LAT_MIN);
+    double long_offset = (longitude - GEO_LONG_MIN) / (GEO_LONG_MAX - GEO_LONG_MIN);
+    lat_offset *= (1ULL << GEO_STEP_MAX);
+    long_offset *= (1ULL << GEO_STEP_MAX);
+    bits[i] = Interleave(lat_offset, long_offset);
+  }
+}
+
+/* The same as geohashDecodeToLongLatWGS84 of the 52 bits at GEO_STEP_MAX */
+template <uint64_t (*Deinterleave)(uint64_t)>
+static void decodeScoresWGS84(const double *scores, size_t n, double *longitudes, double *latitudes) {
+  const double lat_scale = GEO_LAT_MAX - GEO_LAT_MIN;
+  const double long_scale = GEO_LONG_MAX - GEO_LONG_MIN;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t hash_sep = Deinterleave(static_cast<uint64_t>(scores[i]));
+    uint32_t ilato = hash_sep;
+    uint32_t ilono = hash_sep >> 32;
+    double lat_min = GEO_LAT_MIN + (ilato * 1.0 / (1ull << GEO_STEP_MAX)) * lat_scale;
+    double lat_max = GEO_LAT_MIN + ((ilato + 1) * 1.0 / (1ull << GEO_STEP_MAX)) * lat_scale;
+    double long_min = GEO_LONG_MIN + (ilono * 1.0 / (1ull << GEO_STEP_MAX)) * long_scale;
+    double long_max = GEO_LONG_MIN + ((ilono + 1) * 1.0 / (1ull << GEO_STEP_MAX)) * long_scale;
+    longitudes[i] = std::min(std::max((long_min + long_max) / 2, GEO_LONG_MIN), GEO_LONG_MAX);
+    latitudes[i] = std::min(std::max((lat_min + lat_max) / 2, GEO_LAT_MIN), GEO_LAT_MAX);
+  }
+}
+
+void GeoHashHelper::EncodeScoresWGS84(const double *longitudes, const double *latitudes, size_t n,
+                                      GeoHashFix52Bits *bits) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  static const bool use_bmi2 = useBMI2();
+  if (use_bmi2) return encodeScoresWGS84<interleave64BMI2>(longitudes, latitudes, n, bits);
+#endif
+  encodeScoresWGS84<interleave64>(longitudes, latitudes, n, bits);
+}
+
+void GeoHashHelper::DecodeScoresWGS84(const double *scores, size_t n, double *longitudes, double *latitudes) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  static const bool use_bmi2 = useBMI2();
+  if (use_bmi2) return decodeScoresWGS84<deinterleave64BMI2>(scores, n, longitudes, latitudes);
+#endif
+  decodeScoresWGS84<deinterleave64>(scores, n, longitudes, latitudes);
+}
+
+size_t GeoHashHelper::GetDistancesIfInShape(const GeoShape &shape, const double *longitudes, const double *latitudes,
+                                            size_t n, double *distances, uint8_t *within) {
+  /* The distance is at least the one along the meridian, so the point is out of the circle if the
+   * latter exceeds the radius. The margin leaves the points near the boundary to the exact check. */
+  constexpr double kRejectMarginMeters = 1;
+  const double lat1r = deg_rad(shape.xy[1]), lon1r = deg_rad(shape.xy[0]);
+  const double cos_lat1r = cos(lat1r);
+  auto distance_to_center = [&](double lon2r, double lat2r) {
+    double u = sin((lat2r - lat1r) / 2);
+    double v = sin((lon2r - lon1r) / 2);
+    return 2.0 * EARTH_RADIUS_IN_METERS * asin(sqrt(u * u + cos_lat1r * cos(lat2r) * v * v));
+  };
+
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    within[i] = 0;
+    double lat2r = deg_rad(latitudes[i]);
+    double lat_distance = EARTH_RADIUS_IN_METERS * fabs(lat1r - lat2r);
+    if (shape.type == kGeoShapeCircle) {
+      if (lat_distance > shape.radius + kRejectMarginMeters) continue;
+      distances[i] = distance_to_center(deg_rad(longitudes[i]), lat2r);
+      if (distances[i] > shape.radius) continue;
+    } else {
+      /* The same checks as GetDistanceIfInRectangle, the cheaper one goes first */
+      if (lat_distance > shape.height / 2) continue;
+      if (GetDistance(longitudes[i], latitudes[i], shape.xy[0], latitudes[i]) > shape.width / 2) continue;
+      distances[i] = distance_to_center(deg_rad(longitudes[i]), lat2r);
+    }
+    within[i] = 1;
+    count++;
+  }
+  return count;
+}
@@ -114,6 +114,21 @@ struct GeoHashRadius {
   GeoHashNeighbors neighbors;
 };
 
+enum GeoShapeType {
+  kGeoShapeCircle,
+  kGeoShapeRectangle,
+};
+
+/* The search area of GEOSEARCH centered at the longitude and latitude,
+ * the radius, width and height are in meters. */
+struct GeoShape {
+  GeoShapeType type = kGeoShapeCircle;
+  double xy[2] = {0, 0};
+  double radius = 0;
+  double width = 0;
+  double height = 0;
+};
+
 inline constexpr bool HASHISZERO(const GeoHashBits &r) { return !r.bits && !r.step; }
 inline constexpr bool RANGEISZERO(const GeoHashRange &r) { return !r.max && !r.min; }
 inline constexpr bool RANGEPISZERO(const GeoHashRange *r) { return !r || RANGEISZERO(*r); }
@@ -143,10 +158,27 @@ class GeoHashHelper {
  public:
   static uint8_t EstimateStepsByRadius(double range_meters, double lat);
   static int BoundingBox(double longitude, double latitude, double radius_meters, double *bounds);
+  static int BoundingBox(const GeoShape &shape, double *bounds);
   static GeoHashRadius GetAreasByRadius(double longitude, double latitude, double radius_meters);
   static GeoHashRadius GetAreasByRadiusWGS84(double longitude, double latitude, double radius_meters);
+  static GeoHashRadius GetAreasByShapeWGS84(const GeoShape &shape);
   static GeoHashFix52Bits Align52Bits(const GeoHashBits &hash);
   static double GetDistance(double lon1d, double lat1d, double lon2d, double lat2d);
+  static double GetLatDistance(double lat1d, double lat2d);
+  static double GetMinDistanceToArea(double longitude, double latitude, const GeoHashArea &area);
   static int GetDistanceIfInRadius(double x1, double y1, double x2, double y2, double radius, double *distance);
   static int GetDistanceIfInRadiusWGS84(double x1, double y1, double x2, double y2, double radius, double *distance);
+  static int GetDistanceIfInRectangle(double width_m, double height_m, double x1, double y1, double x2, double y2,
+                                      double *distance);
+  static int GetDistanceIfInShape(const GeoShape &shape, double x2, double y2, double *distance);
+
+  /* The batch versions for the members of GEOADD and the candidates of the boxes in GEOSEARCH,
+   * the results are the same as the ones of the points. The bits are interleaved by PDEP/PEXT
+   * if the CPU has BMI2, the terms of the center are computed once, and the points too far
+   * along the meridian are rejected before the haversine. */
+  static void EncodeScoresWGS84(const double *longitudes, const double *latitudes, size_t n, GeoHashFix52Bits *bits);
+  static void DecodeScoresWGS84(const double *scores, size_t n, double *longitudes, double *latitudes);
+  /* Return the number of the points in the shape, whose distances are set and within are 1 */
+  static size_t GetDistancesIfInShape(const GeoShape &shape, const double *longitudes, const double *latitudes,
+                                      size_t n, double *distances, uint8_t *within);
 };
@@ -0,0 +1,111 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "redis_bitfield.h"
+
+#include <limits>
+
+namespace Redis {
+
+static uint64_t fieldMask(uint8_t bits) { return bits == 64 ? UINT64_MAX : (uint64_t(1) << bits) - 1; }
+
+// Return true if the value plus the increment overflows the unsigned field, the limit
+// is the wrapped or saturated result then, the same as Redis.
+static bool checkUnsignedOverflow(uint64_t value, int64_t incr, uint8_t bits, BitfieldOverflow overflow,
+                                  uint64_t *limit) {
+  uint64_t max = fieldMask(bits);
+  auto max_incr = static_cast<int64_t>(max - value);
+  auto min_incr = -static_cast<int64_t>(value);
+  bool overflowed = value > max || (incr > 0 && incr > max_incr);
+  bool underflowed = !overflowed && incr < 0 && incr < min_incr;
+  if (!overflowed && !underflowed) return false;
+
+  if (overflow == BitfieldOverflow::kWrap) {
+    *limit = (value + static_cast<uint64_t>(incr)) & max;
+  } else if (overflow == BitfieldOverflow::kSat) {
+    *limit = overflowed ? max : 0;
+  }
+  return true;
+}
+
+static bool checkSignedOverflow(int64_t value, int64_t incr, uint8_t bits, BitfieldOverflow overflow,
+                                int64_t *limit) {
+  int64_t max = bits == 64 ? std::numeric_limits<int64_t>::max() : (int64_t(1) << (bits - 1)) - 1;
+  int64_t min = -max - 1;
+  // The increments to the limits are only used after the value is checked to be in range,
+  // so they don't overflow then
+  int64_t max_incr = static_cast<int64_t>(static_cast<uint64_t>(max) - static_cast<uint64_t>(value));
+  int64_t min_incr = static_cast<int64_t>(static_cast<uint64_t>(min) - static_cast<uint64_t>(value));
+  bool overflowed = value > max || (bits != 64 && incr > max_incr) || (value >= 0 && incr > 0 && incr > max_incr);
+  bool underflowed = !overflowed && (value < min || (bits != 64 && incr < min_incr) ||
+                                     (value < 0 && incr < 0 && incr < min_incr));
+  if (!overflowed && !underflowed) return false;
+
+  if (overflow == BitfieldOverflow::kWrap) {
+    uint64_t result = static_cast<uint64_t>(value) + static_cast<uint64_t>(incr);
+    if (bits < 64) {
+      // Propagate the sign bit to the higher bits
+      uint64_t mask = UINT64_MAX << bits;
+      result = (result & (uint64_t(1) << (bits - 1))) ? (result | mask) : (result & ~mask);
+    }
+    *limit = static_cast<int64_t>(result);
+  } else if (overflow == BitfieldOverflow::kSat) {
+    *limit = overflowed ? max : min;
+  }
+  return true;
+}
+
+int64_t BitfieldValue(const BitfieldOperation &op, uint64_t bits) {
+  if (op.is_signed && op.bits < 64 && (bits & (uint64_t(1) << (op.bits - 1)))) {
+    bits |= UINT64_MAX << op.bits;
+  }
+  return static_cast<int64_t>(bits);
+}
+
+bool BitfieldApply(const BitfieldOperation &op, uint64_t old_bits, uint64_t *new_bits, int64_t *reply) {
+  *new_bits = old_bits;
+  int64_t old_value = BitfieldValue(op, old_bits);
+  *reply = old_value;
+  if (op.type == BitfieldOpType::kGet) return true;
+
+  // SET checks whether the value fits in the field, and INCRBY checks the sum
+  bool is_set = op.type == BitfieldOpType::kSet;
+  int64_t incr = is_set ? 0 : op.value;
+  uint64_t result = 0;
+  bool overflowed = false;
+  if (op.is_signed) {
+    int64_t value = is_set ? op.value : old_value;
+    int64_t limit = 0;
+    overflowed = checkSignedOverflow(value, incr, op.bits, op.overflow, &limit);
+    result = overflowed ? static_cast<uint64_t>(limit) : static_cast<uint64_t>(value) + static_cast<uint64_t>(incr);
+  } else {
+    uint64_t value = is_set ? static_cast<uint64_t>(op.value) : old_bits;
+    uint64_t limit = 0;
+    overflowed = checkUnsignedOverflow(value, incr, op.bits, op.overflow, &limit);
+    result = overflowed ? limit : value + static_cast<uint64_t>(incr);
+  }
+  if (overflowed && op.overflow == BitfieldOverflow::kFail) return false;
+
+  *new_bits = result & fieldMask(op.bits);
+  if (!is_set) *reply = BitfieldValue(op, *new_bits);
+  return true;
+}
+
+}  // namespace Redis
@@ -0,0 +1,74 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Redis {
+
+enum class BitfieldOverflow {
+  kWrap,
+  kSat,
+  kFail,
+};
+
+enum class BitfieldOpType {
+  kGet,
+  kSet,
+  kIncrBy,
+};
+
+// The sub-operation of the BITFIELD command, the offset is in bits and the bits are numbered
+// in the same order as GETBIT and SETBIT, the field of the lower offset is more significant.
+struct BitfieldOperation {
+  BitfieldOpType type = BitfieldOpType::kGet;
+  BitfieldOverflow overflow = BitfieldOverflow::kWrap;
+  bool is_signed = false;
+  uint8_t bits = 0;
+  uint32_t offset = 0;
+  int64_t value = 0;
+};
+
+// Return the integer of the field bits, the signed field is sign-extended
+int64_t BitfieldValue(const BitfieldOperation &op, uint64_t bits);
+
+// Apply the operation to the old bits of the field, and return false if it overflows with OVERFLOW FAIL.
+// The reply is the old value for GET and SET, and the new value for INCRBY.
+bool BitfieldApply(const BitfieldOperation &op, uint64_t old_bits, uint64_t *new_bits, int64_t *reply);
+
+template <typename GetBitFn>
+uint64_t BitfieldRead(const BitfieldOperation &op, GetBitFn &&get_bit) {
+  uint64_t bits = 0;
+  for (uint32_t i = 0; i < op.bits; i++) {
+    bits = (bits << 1) | (get_bit(op.offset + i) ? 1 : 0);
+  }
+  return bits;
+}
+
+template <typename SetBitFn>
+void BitfieldWrite(const BitfieldOperation &op, uint64_t bits, SetBitFn &&set_bit) {
+  for (uint32_t i = 0; i < op.bits; i++) {
+    set_bit(op.offset + i, ((bits >> (op.bits - 1 - i)) & 1) != 0);
+  }
+}
+
+}  // namespace Redis
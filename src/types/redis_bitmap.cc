@@ -21,32 +21,35 @@
 #include "redis_bitmap.h"
 
 #include <algorithm>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <map>
 #include <memory>
 #include <utility>
 #include <vector>
 
+#include "bit_util.h"
 #include "db_util.h"
 #include "parse_util.h"
 #include "redis_bitmap_string.h"
+#include "redis_string.h"
 
 namespace Redis {
 
 const uint32_t kBitmapSegmentBits = 1024 * 8;
 const uint32_t kBitmapSegmentBytes = 1024;
+// The number of segments fetched by one MultiGet when scanning a range of the bitmap
+const uint32_t kBitmapSegmentsPerBatch = 64;
+// BITOP on the large bitmaps splits the segments into the ranges of this size,
+// and processes them on at most kBitOpMaxThreads threads
+const uint32_t kBitOpSegmentsPerTask = 1024;
+const size_t kBitOpMaxThreads = 4;
 
 const char kErrBitmapStringOutOfRange[] =
     "The size of the bitmap string exceeds the "
     "configuration item max-bitmap-to-string-mb";
 
-extern const uint8_t kNum2Bits[256] = {
-    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 1, 2, 2, 3, 2,
-    3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3,
-    3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5,
-    6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4,
-    3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4,
-    5, 5, 6, 5, 6, 6, 7, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6,
-    6, 7, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8};
-
 rocksdb::Status Bitmap::GetMetadata(const Slice &ns_key, BitmapMetadata *metadata, std::string *raw_value) {
   std::string old_metadata;
   metadata->Encode(&old_metadata);
@@ -58,7 +61,13 @@ rocksdb::Status Bitmap::GetMetadata(const Slice &ns_key, BitmapMetadata *metadat
     metadata->Decode(old_metadata);
     return rocksdb::Status::NotFound(kErrMsgKeyExpired);
   }
-  if (metadata->Type() == kRedisString) return s;
+  if (metadata->Type() == kRedisString) {
+    // The bitmap operations on the chunked string work on its whole value in the inline format
+    if (!metadata->IsChunkedString()) return s;
+    s = String(storage_, namespace_).GetRawValue(ns_key.ToString(), raw_value);
+    if (s.ok()) metadata->Decode(*raw_value);
+    return s;
+  }
   if (metadata->Type() != kRedisBitmap && metadata->size > 0) {
     metadata->Decode(old_metadata);
     return rocksdb::Status::InvalidArgument(kErrMsgWrongType);
@@ -90,10 +99,12 @@ rocksdb::Status Bitmap::GetBit(const Slice &user_key, uint32_t offset, bool *bit
   uint32_t index = (offset / kBitmapSegmentBits) * kBitmapSegmentBytes;
   std::string sub_key, value;
   InternalKey(ns_key, std::to_string(index), metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-  s = db_->Get(read_options, sub_key, &value);
+  s = storage_->Get(read_options, sub_key, &value);
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+  std::string buffer;
+  Slice segment = DecodeSegment(metadata.containers, value, &buffer);
   uint32_t byte_index = (offset / 8) % kBitmapSegmentBytes;
-  if ((byte_index < value.size() && (value[byte_index] & (1 << (offset % 8))))) {
+  if ((byte_index < segment.size() && (segment[byte_index] & (1 << (offset % 8))))) {
     *bit = true;
   }
   return rocksdb::Status::OK();
@@ -114,7 +125,7 @@ rocksdb::Status Bitmap::GetString(const Slice &user_key, const uint32_t max_btos
   }
   value->assign(metadata.size, 0);
 
-  std::string fragment, prefix_key;
+  std::string fragment, buffer, prefix_key;
   fragment.reserve(kBitmapSegmentBytes * 2);
   InternalKey(ns_key, "", metadata.version, storage_->IsSlotIdEncoded()).Encode(&prefix_key);
 
@@ -124,15 +135,15 @@ rocksdb::Status Bitmap::GetString(const Slice &user_key, const uint32_t max_btos
   read_options.fill_cache = false;
   uint32_t frag_index = 0, valid_size = 0;
 
-  auto iter = DBUtil::UniqueIterator(db_, read_options);
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options));
   for (iter->Seek(prefix_key); iter->Valid() && iter->key().starts_with(prefix_key); iter->Next()) {
     InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
-    auto parse_result = ParseInt<uint32_t>(ikey.GetSubKey().ToString(), 10);
+    auto parse_result = ParseInt<uint32_t>(ikey.GetSubKey().ToStringView(), 10);
     if (!parse_result) {
       return rocksdb::Status::InvalidArgument(parse_result.Msg());
     }
     frag_index = *parse_result;
-    fragment = iter->value().ToString();
+    fragment = DecodeSegment(metadata.containers, iter->value(), &buffer).ToString();
     // To be compatible with data written before the commit d603b0e(#338)
     // and avoid returning extra null char after expansion.
     valid_size = std::min(
@@ -187,12 +198,21 @@ rocksdb::Status Bitmap::SetBit(const Slice &user_key, uint32_t offset, bool new_
     return bitmap_string_db.SetBit(ns_key, &raw_value, offset, new_bit, old_bit);
   }
 
+  // The encoding of the segments is decided when the bitmap is created
+  if (s.IsNotFound()) {
+    metadata.containers = storage_->GetConfig()->bitmap_segment_containers;
+    metadata.has_bit_count = true;
+    metadata.bit_count = 0;
+  }
+
   std::string sub_key, value;
   uint32_t index = (offset / kBitmapSegmentBits) * kBitmapSegmentBytes;
   InternalKey(ns_key, std::to_string(index), metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
   if (s.ok()) {
-    s = db_->Get(rocksdb::ReadOptions(), sub_key, &value);
+    std::string stored_value, buffer;
+    s = storage_->Get(rocksdb::ReadOptions(), sub_key, &stored_value);
     if (!s.ok() && !s.IsNotFound()) return s;
+    value = DecodeSegment(metadata.containers, stored_value, &buffer).ToString();
   }
   uint32_t byte_index = (offset / 8) % kBitmapSegmentBytes;
   uint32_t used_size = index + byte_index + 1;
@@ -216,10 +236,141 @@ rocksdb::Status Bitmap::SetBit(const Slice &user_key, uint32_t offset, bool new_
     value[byte_index] &= ~(1 << bit_offset);
   }
   rocksdb::WriteBatch batch;
-  WriteBatchLogData log_data(kRedisBitmap, {std::to_string(kRedisCmdSetBit), std::to_string(offset)});
+  // The new bit is logged as well, since the segment might not be the raw bytes
+  WriteBatchLogData log_data(kRedisBitmap,
+                             {std::to_string(kRedisCmdSetBit), std::to_string(offset), new_bit ? "1" : "0"});
+  batch.PutLogData(log_data.Encode());
+  batch.Put(sub_key, metadata.containers ? EncodeSegment(value) : value);
+  bool count_changed = metadata.has_bit_count && *old_bit != new_bit;
+  if (count_changed) new_bit ? metadata.bit_count++ : metadata.bit_count--;
+  if (metadata.size != bitmap_size || count_changed) {
+    metadata.size = bitmap_size;
+    std::string bytes;
+    metadata.Encode(&bytes);
+    batch.Put(metadata_cf_handle_, ns_key, bytes);
+  }
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+// All the sub-operations are applied to the touched segments in memory under the key lock,
+// which are read by one MultiGet and written back in one batch.
+rocksdb::Status Bitmap::Bitfield(const Slice &user_key, const std::vector<BitfieldOperation> &ops,
+                                 std::vector<std::optional<int64_t>> *rets) {
+  rets->clear();
+  std::string ns_key, raw_value;
+  AppendNamespacePrefix(user_key, &ns_key);
+
+  bool read_only = std::all_of(ops.begin(), ops.end(),
+                               [](const BitfieldOperation &op) { return op.type == BitfieldOpType::kGet; });
+  std::unique_ptr<LockGuard> lock_guard;
+  if (!read_only) lock_guard = std::make_unique<LockGuard>(storage_->GetLockManager(), ns_key);
+  BitmapMetadata metadata;
+  rocksdb::Status s = GetMetadata(ns_key, &metadata, &raw_value);
+  if (!s.ok() && !s.IsNotFound()) return s;
+
+  if (metadata.Type() == kRedisString) {
+    Redis::BitmapString bitmap_string_db(storage_, namespace_);
+    return bitmap_string_db.Bitfield(ns_key, &raw_value, ops, rets);
+  }
+  bool exists = s.ok();
+  if (!exists) {
+    metadata.containers = storage_->GetConfig()->bitmap_segment_containers;
+    metadata.has_bit_count = true;
+    metadata.bit_count = 0;
+  }
+
+  // The field is at most 64 bits, so it spans at most two segments
+  std::map<uint32_t, std::string> segments;
+  for (const auto &op : ops) {
+    segments.emplace(op.offset / kBitmapSegmentBits, "");
+    segments.emplace((op.offset + op.bits - 1) / kBitmapSegmentBits, "");
+  }
+  if (exists) {
+    std::vector<std::string> sub_keys;
+    for (const auto &segment : segments) sub_keys.emplace_back(std::to_string(segment.first * kBitmapSegmentBytes));
+    std::vector<Slice> sub_key_slices(sub_keys.begin(), sub_keys.end());
+    std::vector<rocksdb::PinnableSlice> values;
+    std::vector<rocksdb::Status> statuses;
+    LatestSnapShot ss(db_);
+    multiGetSubKeys(ns_key, metadata.version, sub_key_slices, &values, &statuses, ss.GetSnapShot());
+    std::string buffer;
+    size_t i = 0;
+    for (auto &segment : segments) {
+      if (!statuses[i].ok() && !statuses[i].IsNotFound()) return statuses[i];
+      if (statuses[i].ok()) segment.second = DecodeSegment(metadata.containers, values[i], &buffer).ToString();
+      i++;
+    }
+  }
+  // The bit count is adjusted by the difference of the touched segments before and after the writes
+  auto count_segment = [](const std::string &segment) {
+    return Util::PopCount(reinterpret_cast<const unsigned char *>(segment.data()), segment.size());
+  };
+  std::map<uint32_t, uint64_t> old_counts;
+  uint64_t old_bit_count = metadata.bit_count;
+  if (!read_only && metadata.has_bit_count) {
+    for (const auto &segment : segments) old_counts[segment.first] = count_segment(segment.second);
+  }
+
+  auto get_bit = [&segments](uint32_t offset) {
+    const auto &segment = segments[offset / kBitmapSegmentBits];
+    uint32_t byte_index = (offset / 8) % kBitmapSegmentBytes;
+    return byte_index < segment.size() && (segment[byte_index] & (1 << (offset % 8)));
+  };
+  auto set_bit = [&segments](uint32_t offset, bool bit) {
+    auto &segment = segments[offset / kBitmapSegmentBits];
+    uint32_t byte_index = (offset / 8) % kBitmapSegmentBytes;
+    if (byte_index >= segment.size()) segment.resize(byte_index + 1, 0);
+    if (bit) {
+      segment[byte_index] = static_cast<char>(segment[byte_index] | (1 << (offset % 8)));
+    } else {
+      segment[byte_index] = static_cast<char>(segment[byte_index] & ~(1 << (offset % 8)));
+    }
+  };
+
+  // The applied writes are logged as the SET operations of the new values, which are replayed as they are
+  std::vector<std::string> log_args = {std::to_string(kRedisCmdBitfield)};
+  // The touched segments to write and the bytes they should cover
+  std::map<uint32_t, uint32_t> dirty_segments;
+  uint32_t bitmap_size = metadata.size;
+  for (const auto &op : ops) {
+    uint64_t old_bits = BitfieldRead(op, get_bit), new_bits = 0;
+    int64_t reply = 0;
+    if (op.type != BitfieldOpType::kGet) {
+      // The bitmap grows to cover the field even if it overflows with OVERFLOW FAIL, the same as Redis
+      uint32_t used_size = (op.offset + op.bits - 1) / 8 + 1;
+      bitmap_size = std::max(bitmap_size, used_size);
+      for (uint32_t index : {op.offset / kBitmapSegmentBits, (op.offset + op.bits - 1) / kBitmapSegmentBits}) {
+        uint32_t segment_used = std::min<uint32_t>(used_size - index * kBitmapSegmentBytes, kBitmapSegmentBytes);
+        dirty_segments[index] = std::max(dirty_segments[index], segment_used);
+      }
+    }
+    if (!BitfieldApply(op, old_bits, &new_bits, &reply)) {
+      rets->emplace_back(std::nullopt);
+      continue;
+    }
+    rets->emplace_back(reply);
+    if (op.type == BitfieldOpType::kGet) continue;
+
+    BitfieldWrite(op, new_bits, set_bit);
+    log_args.insert(log_args.end(), {"SET", (op.is_signed ? "i" : "u") + std::to_string(op.bits),
+                                     std::to_string(op.offset), std::to_string(BitfieldValue(op, new_bits))});
+  }
+  if (read_only) return rocksdb::Status::OK();
+
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisBitmap, std::move(log_args));
   batch.PutLogData(log_data.Encode());
-  batch.Put(sub_key, value);
-  if (metadata.size != bitmap_size) {
+  for (const auto &dirty : dirty_segments) {
+    uint32_t index = dirty.first;
+    auto &segment = segments[index];
+    if (segment.size() < dirty.second) segment.resize(dirty.second, 0);
+    if (metadata.has_bit_count) metadata.bit_count += count_segment(segment) - old_counts[index];
+    std::string sub_key;
+    InternalKey(ns_key, std::to_string(index * kBitmapSegmentBytes), metadata.version, storage_->IsSlotIdEncoded())
+        .Encode(&sub_key);
+    batch.Put(sub_key, metadata.containers ? EncodeSegment(segment) : segment);
+  }
+  if (!exists || metadata.size != bitmap_size || metadata.bit_count != old_bit_count) {
     metadata.size = bitmap_size;
     std::string bytes;
     metadata.Encode(&bytes);
@@ -248,26 +399,48 @@ rocksdb::Status Bitmap::BitCount(const Slice &user_key, int64_t start, int64_t s
   if (start < 0 || stop <= 0 || start >= stop) return rocksdb::Status::OK();
 
   auto u_start = static_cast<uint32_t>(start);
-  auto u_stop = static_cast<uint32_t>(stop);
+  auto u_stop = std::min(static_cast<uint32_t>(stop), metadata.size - 1);
 
   LatestSnapShot ss(db_);
-  rocksdb::ReadOptions read_options;
-  read_options.snapshot = ss.GetSnapShot();
-  uint32_t start_index = u_start / kBitmapSegmentBytes;
-  uint32_t stop_index = u_stop / kBitmapSegmentBytes;
-  // Don't use multi get to prevent large range query, and take too much memory
-  std::string sub_key, value;
-  for (uint32_t i = start_index; i <= stop_index; i++) {
-    InternalKey(ns_key, std::to_string(i * kBitmapSegmentBytes), metadata.version, storage_->IsSlotIdEncoded())
-        .Encode(&sub_key);
-    s = db_->Get(read_options, sub_key, &value);
-    if (!s.ok() && !s.IsNotFound()) return s;
-    if (s.IsNotFound()) continue;
-    size_t j = 0;
-    if (i == start_index) j = u_start % kBitmapSegmentBytes;
-    for (; j < value.size(); j++) {
-      if (i == stop_index && j > (u_stop % kBitmapSegmentBytes)) break;
-      *cnt += kNum2Bits[static_cast<uint8_t>(value[j])];
+  uint64_t count = 0;
+  if (!metadata.has_bit_count || u_stop - u_start + 1 <= metadata.size / 2) {
+    s = countBits(ns_key, metadata, ss.GetSnapShot(), u_start, u_stop, &count);
+  } else {
+    // Count the bytes out of the range instead if they're fewer, the full range needn't read anything
+    uint64_t outside = 0;
+    if (u_start > 0) s = countBits(ns_key, metadata, ss.GetSnapShot(), 0, u_start - 1, &outside);
+    if (s.ok() && u_stop + 1 < metadata.size) {
+      s = countBits(ns_key, metadata, ss.GetSnapShot(), u_stop + 1, metadata.size - 1, &outside);
+    }
+    count = metadata.bit_count - outside;
+  }
+  if (!s.ok()) return s;
+  *cnt = static_cast<uint32_t>(count);
+  return rocksdb::Status::OK();
+}
+
+// Count the set bits of the bytes from the first byte to the last byte (inclusive) of the bitmap
+rocksdb::Status Bitmap::countBits(const Slice &ns_key, const BitmapMetadata &metadata,
+                                  const rocksdb::Snapshot *snapshot, uint32_t first_byte, uint32_t last_byte,
+                                  uint64_t *cnt) {
+  uint32_t start_index = first_byte / kBitmapSegmentBytes;
+  uint32_t stop_index = last_byte / kBitmapSegmentBytes;
+  std::vector<rocksdb::PinnableSlice> values;
+  std::vector<rocksdb::Status> statuses;
+  std::string buffer;
+  for (uint32_t batch_index = start_index; batch_index <= stop_index; batch_index += kBitmapSegmentsPerBatch) {
+    uint32_t last_index = std::min(stop_index, batch_index + kBitmapSegmentsPerBatch - 1);
+    multiGetSegments(ns_key, metadata, batch_index, last_index, snapshot, &values, &statuses);
+    for (uint32_t i = batch_index; i <= last_index; i++) {
+      const auto &status = statuses[i - batch_index];
+      if (!status.ok() && !status.IsNotFound()) return status;
+      if (status.IsNotFound()) continue;
+      Slice value = DecodeSegment(metadata.containers, values[i - batch_index], &buffer);
+      size_t begin = i == start_index ? first_byte % kBitmapSegmentBytes : 0;
+      size_t end = value.size();
+      if (i == stop_index) end = std::min<size_t>(end, last_byte % kBitmapSegmentBytes + 1);
+      if (begin >= end) continue;
+      *cnt += Util::PopCount(reinterpret_cast<const unsigned char *>(value.data()) + begin, end - begin);
     }
   }
   return rocksdb::Status::OK();
@@ -300,46 +473,42 @@ rocksdb::Status Bitmap::BitPos(const Slice &user_key, bool bit, int64_t start, i
   auto u_start = static_cast<uint32_t>(start);
   auto u_stop = static_cast<uint32_t>(stop);
 
-  auto bitPosInByte = [](char byte, bool bit) -> int {
-    for (int i = 0; i < 8; i++) {
-      if (bit && (byte & (1 << i)) != 0) return i;
-      if (!bit && (byte & (1 << i)) == 0) return i;
-    }
-    return -1;
-  };
-
   LatestSnapShot ss(db_);
-  rocksdb::ReadOptions read_options;
-  read_options.snapshot = ss.GetSnapShot();
   uint32_t start_index = u_start / kBitmapSegmentBytes;
   uint32_t stop_index = u_stop / kBitmapSegmentBytes;
-  // Don't use multi get to prevent large range query, and take too much memory
-  std::string sub_key, value;
-  for (uint32_t i = start_index; i <= stop_index; i++) {
-    InternalKey(ns_key, std::to_string(i * kBitmapSegmentBytes), metadata.version, storage_->IsSlotIdEncoded())
-        .Encode(&sub_key);
-    s = db_->Get(read_options, sub_key, &value);
-    if (!s.ok() && !s.IsNotFound()) return s;
-    if (s.IsNotFound()) {
-      if (!bit) {
-        *pos = i * kBitmapSegmentBits;
-        return rocksdb::Status::OK();
+  std::vector<rocksdb::PinnableSlice> values;
+  std::vector<rocksdb::Status> statuses;
+  std::string buffer;
+  for (uint32_t batch_index = start_index; batch_index <= stop_index; batch_index += kBitmapSegmentsPerBatch) {
+    uint32_t last_index = std::min(stop_index, batch_index + kBitmapSegmentsPerBatch - 1);
+    multiGetSegments(ns_key, metadata, batch_index, last_index, ss.GetSnapShot(), &values, &statuses);
+    for (uint32_t i = batch_index; i <= last_index; i++) {
+      const auto &status = statuses[i - batch_index];
+      if (!status.ok() && !status.IsNotFound()) return status;
+      if (status.IsNotFound()) {
+        if (!bit) {
+          *pos = i * kBitmapSegmentBits;
+          return rocksdb::Status::OK();
+        }
+        continue;
       }
-      continue;
-    }
-    size_t j = 0;
-    if (i == start_index) j = u_start % kBitmapSegmentBytes;
-    for (; j < value.size(); j++) {
-      if (i == stop_index && j > (u_stop % kBitmapSegmentBytes)) break;
-      if (bitPosInByte(value[j], bit) != -1) {
-        *pos = static_cast<int64_t>(i * kBitmapSegmentBits + j * 8 + bitPosInByte(value[j], bit));
+      Slice value = DecodeSegment(metadata.containers, values[i - batch_index], &buffer);
+      size_t begin = i == start_index ? u_start % kBitmapSegmentBytes : 0;
+      size_t end = value.size();
+      if (i == stop_index) end = std::min<size_t>(end, u_stop % kBitmapSegmentBytes + 1);
+      if (begin < end) {
+        int64_t bit_pos =
+            Util::FindFirstBit(reinterpret_cast<const unsigned char *>(value.data()) + begin, end - begin, bit, false);
+        if (bit_pos != -1) {
+          *pos = static_cast<int64_t>(i * kBitmapSegmentBits + begin * 8) + bit_pos;
+          return rocksdb::Status::OK();
+        }
+      }
+      if (!bit && value.size() < kBitmapSegmentBytes) {
+        *pos = static_cast<int64_t>(i * kBitmapSegmentBits + value.size() * 8);
         return rocksdb::Status::OK();
       }
     }
-    if (!bit && value.size() < kBitmapSegmentBytes) {
-      *pos = static_cast<int64_t>(i * kBitmapSegmentBits + value.size() * 8);
-      return rocksdb::Status::OK();
-    }
   }
   // bit was not found
   *pos = bit ? -1 : static_cast<int64_t>(metadata.size * 8);
@@ -387,148 +556,52 @@ rocksdb::Status Bitmap::BitOp(BitOpFlags op_flag, const std::string &op_name, co
   batch.PutLogData(log_data.Encode());
 
   BitmapMetadata res_metadata;
+  res_metadata.containers = storage_->GetConfig()->bitmap_segment_containers;
+  res_metadata.has_bit_count = true;
+  ChunkedBatchWriter chunk_writer(storage_, &batch, &log_data, res_metadata.version);
   if (num_keys == op_keys.size() || op_flag != kBitOpAnd) {
-    uint64_t i = 0, frag_numkeys = num_keys, stop_index = (max_size - 1) / kBitmapSegmentBytes;
-    std::unique_ptr<unsigned char[]> frag_res(new unsigned char[kBitmapSegmentBytes]);
-    uint16_t frag_maxlen = 0, frag_minlen = 0;
-    std::string sub_key, fragment;
-    unsigned char output = 0, byte = 0;
-    std::vector<std::string> fragments;
-
     LatestSnapShot ss(db_);
-    rocksdb::ReadOptions read_options;
-    read_options.snapshot = ss.GetSnapShot();
-    for (uint64_t frag_index = 0; frag_index <= stop_index; frag_index++) {
-      for (const auto &meta_pair : meta_pairs) {
-        InternalKey(meta_pair.first, std::to_string(frag_index * kBitmapSegmentBytes), meta_pair.second.version,
-                    storage_->IsSlotIdEncoded())
-            .Encode(&sub_key);
-        auto s = db_->Get(read_options, sub_key, &fragment);
-        if (!s.ok() && !s.IsNotFound()) {
-          return s;
-        }
-        if (s.IsNotFound()) {
-          frag_numkeys--;
-          if (op_flag == kBitOpAnd) {
-            frag_maxlen = 0;
-            break;
-          }
-        } else {
-          if (frag_maxlen < fragment.size()) frag_maxlen = fragment.size();
-          if (fragment.size() < frag_minlen || frag_minlen == 0) frag_minlen = fragment.size();
-          fragments.emplace_back(fragment);
-        }
+    uint32_t stop_index = (max_size - 1) / kBitmapSegmentBytes;
+    // The ranges of each round are processed in parallel, then the result segments
+    // are put into the batch in order, so only one round of results is held at a time.
+    // The transaction and the pinned snapshot are thread local, so their reads stay on this thread.
+    bool thread_bound = storage_->InTxn() || Engine::Storage::GetPinnedSnapshot() != nullptr;
+    size_t concurrency = stop_index >= kBitOpSegmentsPerTask && !thread_bound ? kBitOpMaxThreads : 1;
+    auto policy = concurrency > 1 ? std::launch::async : std::launch::deferred;
+    uint64_t round_size = concurrency * kBitOpSegmentsPerTask;
+    for (uint64_t round_index = 0; round_index <= stop_index; round_index += round_size) {
+      std::vector<std::vector<std::pair<uint32_t, std::string>>> segments(concurrency);
+      std::vector<uint64_t> bit_counts(concurrency, 0);
+      std::vector<std::future<rocksdb::Status>> results;
+      for (size_t tid = 0; tid < concurrency; tid++) {
+        uint64_t first_index = round_index + tid * kBitOpSegmentsPerTask;
+        if (first_index > stop_index) break;
+        uint64_t last_index = std::min<uint64_t>(stop_index, first_index + kBitOpSegmentsPerTask - 1);
+        results.emplace_back(std::async(policy, [&, tid, first_index, last_index]() {
+          return bitOpSegments(op_flag, meta_pairs, max_size, first_index, last_index, ss.GetSnapShot(),
+                               res_metadata.containers, &segments[tid], &bit_counts[tid]);
+        }));
       }
-
-      if (frag_maxlen != 0 || op_flag == kBitOpNot) {
-        uint16_t j = 0;
-        if (op_flag == kBitOpNot) {
-          memset(frag_res.get(), UCHAR_MAX, kBitmapSegmentBytes);
-        } else {
-          memset(frag_res.get(), 0, frag_maxlen);
-        }
-
-#ifndef USE_ALIGNED_ACCESS
-        if (frag_minlen >= sizeof(uint64_t) * 4 && frag_numkeys <= 16) {
-          auto *lres = reinterpret_cast<uint64_t *>(frag_res.get());
-          const uint64_t *lp[16];
-          for (i = 0; i < frag_numkeys; i++) {
-            lp[i] = reinterpret_cast<const uint64_t *>(fragments[i].data());
-          }
-          memcpy(frag_res.get(), fragments[0].data(), frag_minlen);
-
-          if (op_flag == kBitOpAnd) {
-            while (frag_minlen >= sizeof(uint64_t) * 4) {
-              for (i = 1; i < frag_numkeys; i++) {
-                lres[0] &= lp[i][0];
-                lres[1] &= lp[i][1];
-                lres[2] &= lp[i][2];
-                lres[3] &= lp[i][3];
-                lp[i] += 4;
-              }
-              lres += 4;
-              j += sizeof(uint64_t) * 4;
-              frag_minlen -= sizeof(uint64_t) * 4;
-            }
-          } else if (op_flag == kBitOpOr) {
-            while (frag_minlen >= sizeof(uint64_t) * 4) {
-              for (i = 1; i < frag_numkeys; i++) {
-                lres[0] |= lp[i][0];
-                lres[1] |= lp[i][1];
-                lres[2] |= lp[i][2];
-                lres[3] |= lp[i][3];
-                lp[i] += 4;
-              }
-              lres += 4;
-              j += sizeof(uint64_t) * 4;
-              frag_minlen -= sizeof(uint64_t) * 4;
-            }
-          } else if (op_flag == kBitOpXor) {
-            while (frag_minlen >= sizeof(uint64_t) * 4) {
-              for (i = 1; i < frag_numkeys; i++) {
-                lres[0] ^= lp[i][0];
-                lres[1] ^= lp[i][1];
-                lres[2] ^= lp[i][2];
-                lres[3] ^= lp[i][3];
-                lp[i] += 4;
-              }
-              lres += 4;
-              j += sizeof(uint64_t) * 4;
-              frag_minlen -= sizeof(uint64_t) * 4;
-            }
-          } else if (op_flag == kBitOpNot) {
-            while (frag_minlen >= sizeof(uint64_t) * 4) {
-              lres[0] = ~lres[0];
-              lres[1] = ~lres[1];
-              lres[2] = ~lres[2];
-              lres[3] = ~lres[3];
-              lres += 4;
-              j += sizeof(uint64_t) * 4;
-              frag_minlen -= sizeof(uint64_t) * 4;
-            }
-          }
-        }
-#endif
-
-        for (; j < frag_maxlen; j++) {
-          output = (fragments[0].size() <= j) ? 0 : fragments[0][j];
-          if (op_flag == kBitOpNot) output = ~output;
-          for (i = 1; i < frag_numkeys; i++) {
-            byte = (fragments[i].size() <= j) ? 0 : fragments[i][j];
-            switch (op_flag) {
-              case kBitOpAnd:
-                output &= byte;
-                break;
-              case kBitOpOr:
-                output |= byte;
-                break;
-              case kBitOpXor:
-                output ^= byte;
-                break;
-              default:
-                break;
-            }
-          }
-          frag_res[j] = output;
-        }
-
-        if (op_flag == kBitOpNot) {
-          if (frag_index == stop_index) {
-            frag_maxlen = max_size % kBitmapSegmentBytes;
-          } else {
-            frag_maxlen = kBitmapSegmentBytes;
-          }
+      rocksdb::Status round_s;
+      for (auto &result : results) {
+        auto task_s = result.get();
+        if (!task_s.ok()) round_s = task_s;
+      }
+      if (!round_s.ok()) return round_s;
+      for (uint64_t bit_count : bit_counts) res_metadata.bit_count += bit_count;
+
+      std::string sub_key;
+      for (const auto &task_segments : segments) {
+        for (const auto &segment : task_segments) {
+          InternalKey(ns_key, std::to_string(segment.first * kBitmapSegmentBytes), res_metadata.version,
+                      storage_->IsSlotIdEncoded())
+              .Encode(&sub_key);
+          batch.Put(sub_key, segment.second);
         }
-        InternalKey(ns_key, std::to_string(frag_index * kBitmapSegmentBytes), res_metadata.version,
-                    storage_->IsSlotIdEncoded())
-            .Encode(&sub_key);
-        batch.Put(sub_key, Slice(reinterpret_cast<char *>(frag_res.get()), frag_maxlen));
       }
-
-      frag_maxlen = 0;
-      frag_minlen = 0;
-      frag_numkeys = num_keys;
-      fragments.clear();
+      // The segments of the new version are invisible until the metadata is written by the last batch
+      s = chunk_writer.WriteIfFull();
+      if (!s.ok()) return s;
     }
   }
 
@@ -537,7 +610,7 @@ rocksdb::Status Bitmap::BitOp(BitOpFlags op_flag, const std::string &op_name, co
   res_metadata.Encode(&bytes);
   batch.Put(metadata_cf_handle_, ns_key, bytes);
   *len = max_size;
-  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+  return chunk_writer.Write();
 }
 
 bool Bitmap::GetBitFromValueAndOffset(const std::string &value, uint32_t offset) {
@@ -553,4 +626,197 @@ bool Bitmap::IsEmptySegment(const Slice &segment) {
   static const char zero_byte_segment[kBitmapSegmentBytes] = {0};
   return !memcmp(zero_byte_segment, segment.data(), segment.size());
 }
+
+// Encode the raw bytes of the segment into the smallest container, the trailing zero bytes are dropped
+// since the missing bytes of the segment are considered as zero.
+std::string Bitmap::EncodeSegment(const Slice &raw) {
+  size_t len = raw.size();
+  while (len > 0 && raw[len - 1] == 0) len--;
+  const auto *bytes = reinterpret_cast<const uint8_t *>(raw.data());
+
+  uint32_t cardinality = 0, runs = 0;
+  uint32_t prev_bit = 0;
+  for (size_t i = 0; i < len; i++) {
+    uint32_t byte = bytes[i];
+    cardinality += __builtin_popcount(byte);
+    // The bits which are set while the previous bits aren't start the runs
+    runs += __builtin_popcount(byte & ~((byte << 1) | prev_bit) & 0xFF);
+    prev_bit = (byte >> 7) & 1;
+  }
+
+  std::string value;
+  if (2 * cardinality < len && 2 * cardinality <= 4 * runs) {
+    value.reserve(1 + 2 * cardinality);
+    PutFixed8(&value, kBitmapContainerArray);
+    for (size_t i = 0; i < len; i++) {
+      for (uint32_t bit = 0; bytes[i] >> bit; bit++) {
+        if (bytes[i] & (1 << bit)) PutFixed16(&value, static_cast<uint16_t>(i * 8 + bit));
+      }
+    }
+  } else if (4 * runs < len) {
+    value.reserve(1 + 4 * runs);
+    PutFixed8(&value, kBitmapContainerRun);
+    int64_t run_start = -1;
+    for (size_t pos = 0; pos <= len * 8; pos++) {
+      bool is_set = pos < len * 8 && (bytes[pos / 8] & (1 << (pos % 8)));
+      if (is_set && run_start < 0) {
+        run_start = static_cast<int64_t>(pos);
+      } else if (!is_set && run_start >= 0) {
+        PutFixed16(&value, static_cast<uint16_t>(run_start));
+        PutFixed16(&value, static_cast<uint16_t>(pos - run_start - 1));
+        run_start = -1;
+      }
+    }
+  } else {
+    value.reserve(1 + len);
+    PutFixed8(&value, kBitmapContainerBitset);
+    value.append(raw.data(), len);
+  }
+  return value;
+}
+
+// Return the raw bytes of the segment, the array and run containers are decoded into the buffer
+Slice Bitmap::DecodeSegment(bool containers, const Slice &value, std::string *buffer) {
+  if (!containers || value.empty()) return value;
+
+  Slice payload(value.data() + 1, value.size() - 1);
+  auto set_bits = [buffer](uint32_t first, uint32_t last) {
+    if (buffer->size() <= last / 8) buffer->resize(last / 8 + 1, 0);
+    for (uint32_t pos = first; pos <= last; pos++) {
+      (*buffer)[pos / 8] = static_cast<char>((*buffer)[pos / 8] | (1 << (pos % 8)));
+    }
+  };
+  switch (static_cast<uint8_t>(value[0])) {
+    case kBitmapContainerArray:
+      buffer->clear();
+      for (size_t i = 0; i + 2 <= payload.size(); i += 2) {
+        uint16_t pos = DecodeFixed16(payload.data() + i);
+        set_bits(pos, pos);
+      }
+      return *buffer;
+    case kBitmapContainerRun:
+      buffer->clear();
+      for (size_t i = 0; i + 4 <= payload.size(); i += 4) {
+        uint32_t start = DecodeFixed16(payload.data() + i);
+        set_bits(start, start + DecodeFixed16(payload.data() + i + 2));
+      }
+      return *buffer;
+    default:
+      return payload;
+  }
+}
+
+// Fetch the segments from the first index to the last index by a batched MultiGet
+void Bitmap::multiGetSegments(const Slice &ns_key, const BitmapMetadata &metadata, uint32_t first_index,
+                              uint32_t last_index, const rocksdb::Snapshot *snapshot,
+                              std::vector<rocksdb::PinnableSlice> *values, std::vector<rocksdb::Status> *statuses) {
+  std::vector<std::string> segment_offsets;
+  segment_offsets.reserve(last_index - first_index + 1);
+  for (uint32_t i = first_index; i <= last_index; i++) {
+    segment_offsets.emplace_back(std::to_string(i * kBitmapSegmentBytes));
+  }
+  std::vector<Slice> sub_keys(segment_offsets.begin(), segment_offsets.end());
+  multiGetSubKeys(ns_key, metadata.version, sub_keys, values, statuses, snapshot);
+}
+
+// Combine the source segment into the destination segment word by word, which lets
+// the compiler vectorize the loop
+template <typename Op>
+static void combineSegment(char *dst, const char *src, size_t len, Op op) {
+  size_t j = 0;
+  for (; j + sizeof(uint64_t) <= len; j += sizeof(uint64_t)) {
+    uint64_t dst_word = 0, src_word = 0;
+    memcpy(&dst_word, dst + j, sizeof(dst_word));
+    memcpy(&src_word, src + j, sizeof(src_word));
+    dst_word = op(dst_word, src_word);
+    memcpy(dst + j, &dst_word, sizeof(dst_word));
+  }
+  for (; j < len; j++) {
+    dst[j] = static_cast<char>(op(static_cast<uint8_t>(dst[j]), static_cast<uint8_t>(src[j])));
+  }
+}
+
+// Compute the result segments from the first index to the last index of BITOP. The segments
+// which are absent in all sources (or any source for AND) are skipped, and the source segment
+// shorter than the others is considered as zero padded. The set bits of the result segments
+// are added to the bit count.
+rocksdb::Status Bitmap::bitOpSegments(BitOpFlags op_flag,
+                                      const std::vector<std::pair<std::string, BitmapMetadata>> &meta_pairs,
+                                      uint64_t max_size, uint32_t first_index, uint32_t last_index,
+                                      const rocksdb::Snapshot *snapshot, bool containers,
+                                      std::vector<std::pair<uint32_t, std::string>> *segments,
+                                      uint64_t *bit_count) {
+  uint32_t stop_index = (max_size - 1) / kBitmapSegmentBytes;
+  std::vector<std::vector<rocksdb::PinnableSlice>> values(meta_pairs.size());
+  std::vector<std::vector<rocksdb::Status>> statuses(meta_pairs.size());
+  std::vector<std::string> buffers(meta_pairs.size());
+  std::vector<Slice> fragments;
+  for (uint32_t batch_index = first_index; batch_index <= last_index; batch_index += kBitmapSegmentsPerBatch) {
+    uint32_t batch_last_index = std::min(last_index, batch_index + kBitmapSegmentsPerBatch - 1);
+    for (size_t k = 0; k < meta_pairs.size(); k++) {
+      // Don't read the segments beyond the size of the source bitmap
+      const auto &metadata = meta_pairs[k].second;
+      uint32_t source_stop_index = (metadata.size - 1) / kBitmapSegmentBytes;
+      values[k].clear();
+      statuses[k].clear();
+      if (batch_index > source_stop_index) continue;
+      multiGetSegments(meta_pairs[k].first, metadata, batch_index, std::min(batch_last_index, source_stop_index),
+                       snapshot, &values[k], &statuses[k]);
+    }
+
+    for (uint32_t i = batch_index; i <= batch_last_index; i++) {
+      fragments.clear();
+      bool missing = false;
+      for (size_t k = 0; k < meta_pairs.size(); k++) {
+        size_t pos = i - batch_index;
+        if (pos >= statuses[k].size() || statuses[k][pos].IsNotFound()) {
+          missing = true;
+          continue;
+        }
+        if (!statuses[k][pos].ok()) return statuses[k][pos];
+        fragments.emplace_back(DecodeSegment(meta_pairs[k].second.containers, values[k][pos], &buffers[k]));
+      }
+      if (op_flag == kBitOpAnd && missing) continue;
+      if (op_flag != kBitOpNot && fragments.empty()) continue;
+
+      std::string result;
+      if (op_flag == kBitOpNot) {
+        size_t len = kBitmapSegmentBytes;
+        if (i == stop_index && max_size % kBitmapSegmentBytes != 0) len = max_size % kBitmapSegmentBytes;
+        result.assign(len, static_cast<char>(UCHAR_MAX));
+        if (!fragments.empty()) {
+          combineSegment(&result[0], fragments[0].data(), std::min(len, fragments[0].size()),
+                         [](uint64_t, uint64_t b) { return ~b; });
+        }
+      } else {
+        size_t len = 0;
+        for (const auto &fragment : fragments) len = std::max(len, fragment.size());
+        result.assign(len, 0);
+        memcpy(&result[0], fragments[0].data(), fragments[0].size());
+        for (size_t k = 1; k < fragments.size(); k++) {
+          const auto &fragment = fragments[k];
+          switch (op_flag) {
+            case kBitOpAnd:
+              combineSegment(&result[0], fragment.data(), fragment.size(), std::bit_and<uint64_t>());
+              // The bytes beyond the shorter segment are zero
+              memset(&result[0] + fragment.size(), 0, len - fragment.size());
+              break;
+            case kBitOpOr:
+              combineSegment(&result[0], fragment.data(), fragment.size(), std::bit_or<uint64_t>());
+              break;
+            case kBitOpXor:
+              combineSegment(&result[0], fragment.data(), fragment.size(), std::bit_xor<uint64_t>());
+              break;
+            default:
+              break;
+          }
+        }
+      }
+      *bit_count += Util::PopCount(reinterpret_cast<const unsigned char *>(result.data()), result.size());
+      segments->emplace_back(i, containers ? EncodeSegment(result) : std::move(result));
+    }
+  }
+  return rocksdb::Status::OK();
+}
+
 }  // namespace Redis
@@ -20,16 +20,15 @@
 
 #pragma once
 
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "redis_bitfield.h"
 #include "storage/redis_db.h"
 #include "storage/redis_metadata.h"
 
-#if defined(__sparc__) || defined(__arm__)
-#define USE_ALIGNED_ACCESS
-#endif
-
 enum BitOpFlags {
   kBitOpAnd,
   kBitOpOr,
@@ -37,6 +36,14 @@ enum BitOpFlags {
   kBitOpNot,
 };
 
+// The container types of the segments in the bitmap with the container encoding,
+// the value of each segment starts with its type.
+enum BitmapContainerType : uint8_t {
+  kBitmapContainerBitset = 1,  // the raw bytes of the segment
+  kBitmapContainerArray = 2,   // the sorted offsets of the set bits, 2 bytes each
+  kBitmapContainerRun = 3,     // the start offset and the length minus one of each run of set bits
+};
+
 namespace Redis {
 
 class Bitmap : public Database {
@@ -45,15 +52,29 @@ class Bitmap : public Database {
   rocksdb::Status GetBit(const Slice &user_key, uint32_t offset, bool *bit);
   rocksdb::Status GetString(const Slice &user_key, const uint32_t max_btos_size, std::string *value);
   rocksdb::Status SetBit(const Slice &user_key, uint32_t offset, bool new_bit, bool *old_bit);
+  rocksdb::Status Bitfield(const Slice &user_key, const std::vector<BitfieldOperation> &ops,
+                           std::vector<std::optional<int64_t>> *rets);
   rocksdb::Status BitCount(const Slice &user_key, int64_t start, int64_t stop, uint32_t *cnt);
   rocksdb::Status BitPos(const Slice &user_key, bool bit, int64_t start, int64_t stop, bool stop_given, int64_t *pos);
   rocksdb::Status BitOp(BitOpFlags op_flag, const std::string &op_name, const Slice &user_key,
                         const std::vector<Slice> &op_keys, int64_t *len);
   static bool GetBitFromValueAndOffset(const std::string &value, const uint32_t offset);
   static bool IsEmptySegment(const Slice &segment);
+  static std::string EncodeSegment(const Slice &raw);
+  static Slice DecodeSegment(bool containers, const Slice &value, std::string *buffer);
 
  private:
   rocksdb::Status GetMetadata(const Slice &ns_key, BitmapMetadata *metadata, std::string *raw_value);
+  void multiGetSegments(const Slice &ns_key, const BitmapMetadata &metadata, uint32_t first_index,
+                        uint32_t last_index, const rocksdb::Snapshot *snapshot,
+                        std::vector<rocksdb::PinnableSlice> *values, std::vector<rocksdb::Status> *statuses);
+  rocksdb::Status bitOpSegments(BitOpFlags op_flag,
+                                const std::vector<std::pair<std::string, BitmapMetadata>> &meta_pairs,
+                                uint64_t max_size, uint32_t first_index, uint32_t last_index,
+                                const rocksdb::Snapshot *snapshot, bool containers,
+                                std::vector<std::pair<uint32_t, std::string>> *segments, uint64_t *bit_count);
+  rocksdb::Status countBits(const Slice &ns_key, const BitmapMetadata &metadata, const rocksdb::Snapshot *snapshot,
+                            uint32_t first_byte, uint32_t last_byte, uint64_t *cnt);
 };
 
 }  // namespace Redis
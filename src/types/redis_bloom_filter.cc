@@ -0,0 +1,202 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "redis_bloom_filter.h"
+
+#include <set>
+#include <utility>
+
+#include "hash_util.h"
+
+namespace Redis {
+
+const uint32_t kBloomFilterSegmentBits = kBloomFilterSegmentBytes * 8;
+const uint32_t kBloomFilterHashSeed1 = 0x9747b28c;
+const uint32_t kBloomFilterHashSeed2 = 0x7a3c6f15;
+
+void BloomFilter::BitsOf(const Slice &item, const BloomFilterMetadata &metadata, std::vector<uint64_t> *positions) {
+  positions->clear();
+  positions->reserve(metadata.hashes);
+  uint64_t h1 = Util::MurmurHash64A(item, kBloomFilterHashSeed1);
+  // The second hash is the step between the positions, it's odd so it's never zero
+  uint64_t h2 = Util::MurmurHash64A(item, kBloomFilterHashSeed2) | 1;
+  for (uint32_t i = 0; i < metadata.hashes; i++) {
+    positions->emplace_back((h1 + i * h2) % metadata.bits);
+  }
+}
+
+rocksdb::Status BloomFilter::getSegments(const Slice &ns_key, const BloomFilterMetadata &metadata,
+                                         const std::vector<std::vector<uint64_t>> &positions,
+                                         const rocksdb::Snapshot *snapshot,
+                                         std::map<uint64_t, std::string> *segments) {
+  std::set<uint64_t> indexes;
+  for (const auto &item_positions : positions) {
+    for (const auto position : item_positions) indexes.insert(position / kBloomFilterSegmentBits);
+  }
+  std::vector<std::string> segment_names;
+  segment_names.reserve(indexes.size());
+  for (const auto index : indexes) segment_names.emplace_back(std::to_string(index));
+  std::vector<Slice> sub_keys(segment_names.begin(), segment_names.end());
+  std::vector<rocksdb::PinnableSlice> values;
+  std::vector<rocksdb::Status> statuses;
+  multiGetSubKeys(ns_key, metadata.version, sub_keys, &values, &statuses, snapshot);
+
+  size_t i = 0;
+  for (const auto index : indexes) {
+    auto &status = statuses[i];
+    if (status.ok()) {
+      (*segments)[index] = values[i].ToString();
+    } else if (!status.IsNotFound()) {
+      return status;
+    }
+    i++;
+  }
+  return rocksdb::Status::OK();
+}
+
+static bool testBit(const std::map<uint64_t, std::string> &segments, uint64_t position) {
+  auto iter = segments.find(position / kBloomFilterSegmentBits);
+  if (iter == segments.end()) return false;
+  uint32_t byte_index = (position % kBloomFilterSegmentBits) / 8;
+  return byte_index < iter->second.size() && (iter->second[byte_index] & (1 << (position % 8))) != 0;
+}
+
+rocksdb::Status BloomFilter::Reserve(const Slice &user_key, double error_rate, uint64_t capacity) {
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  BloomFilterMetadata metadata;
+  rocksdb::Status s = GetMetadata(kRedisBloomFilter, ns_key, &metadata);
+  if (s.ok()) return rocksdb::Status::InvalidArgument("item exists");
+  if (!s.IsNotFound()) return s;
+
+  metadata.Reserve(capacity, error_rate);
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisBloomFilter, {std::to_string(kRedisCmdBFReserve), Util::Float2String(error_rate),
+                                                 std::to_string(capacity)});
+  batch.PutLogData(log_data.Encode());
+  std::string bytes;
+  metadata.Encode(&bytes);
+  batch.Put(metadata_cf_handle_, ns_key, bytes);
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+rocksdb::Status BloomFilter::MAdd(const Slice &user_key, const std::vector<Slice> &items, std::vector<int> *rets) {
+  rets->clear();
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  BloomFilterMetadata metadata;
+  rocksdb::Status s = GetMetadata(kRedisBloomFilter, ns_key, &metadata);
+  if (!s.ok() && !s.IsNotFound()) return s;
+  bool created = s.IsNotFound();
+  if (created) metadata.Reserve(kBloomFilterDefaultCapacity, kBloomFilterDefaultErrorRate);
+
+  std::vector<std::vector<uint64_t>> positions(items.size());
+  for (size_t i = 0; i < items.size(); i++) BitsOf(items[i], metadata, &positions[i]);
+  std::map<uint64_t, std::string> segments;
+  if (!created) {
+    s = getSegments(ns_key, metadata, positions, nullptr, &segments);
+    if (!s.ok()) return s;
+  }
+
+  std::set<uint64_t> changed_segments;
+  for (const auto &item_positions : positions) {
+    bool exists = true;
+    for (const auto position : item_positions) {
+      if (!testBit(segments, position)) {
+        exists = false;
+        break;
+      }
+    }
+    if (exists) {
+      rets->emplace_back(0);
+      continue;
+    }
+    if (metadata.size >= metadata.capacity) {
+      rets->emplace_back(-1);
+      continue;
+    }
+    for (const auto position : item_positions) {
+      uint64_t index = position / kBloomFilterSegmentBits;
+      auto &segment = segments[index];
+      segment.resize(kBloomFilterSegmentBytes, 0);
+      segment[(position % kBloomFilterSegmentBits) / 8] |= static_cast<char>(1 << (position % 8));
+      changed_segments.insert(index);
+    }
+    metadata.size++;
+    rets->emplace_back(1);
+  }
+  if (changed_segments.empty() && !created) return rocksdb::Status::OK();
+
+  rocksdb::WriteBatch batch;
+  std::vector<std::string> log_args = {std::to_string(kRedisCmdBFAdd)};
+  for (const auto &item : items) log_args.emplace_back(item.ToString());
+  WriteBatchLogData log_data(kRedisBloomFilter, std::move(log_args));
+  batch.PutLogData(log_data.Encode());
+  for (const auto index : changed_segments) {
+    std::string sub_key;
+    InternalKey(ns_key, std::to_string(index), metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+    batch.Put(sub_key, segments[index]);
+  }
+  std::string bytes;
+  metadata.Encode(&bytes);
+  batch.Put(metadata_cf_handle_, ns_key, bytes);
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+rocksdb::Status BloomFilter::MExists(const Slice &user_key, const std::vector<Slice> &items, std::vector<int> *rets) {
+  rets->assign(items.size(), 0);
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+
+  LatestSnapShot ss(db_);
+  BloomFilterMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(kRedisBloomFilter, ns_key, &metadata, ss.GetSnapShot());
+  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+
+  std::vector<std::vector<uint64_t>> positions(items.size());
+  for (size_t i = 0; i < items.size(); i++) BitsOf(items[i], metadata, &positions[i]);
+  std::map<uint64_t, std::string> segments;
+  s = getSegments(ns_key, metadata, positions, ss.GetSnapShot(), &segments);
+  if (!s.ok()) return s;
+
+  for (size_t i = 0; i < items.size(); i++) {
+    bool exists = true;
+    for (const auto position : positions[i]) {
+      if (!testBit(segments, position)) {
+        exists = false;
+        break;
+      }
+    }
+    (*rets)[i] = exists ? 1 : 0;
+  }
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status BloomFilter::Info(const Slice &user_key, BloomFilterMetadata *metadata) {
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+  return GetMetadata(kRedisBloomFilter, ns_key, metadata);
+}
+
+}  // namespace Redis
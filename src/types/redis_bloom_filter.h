@@ -0,0 +1,59 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "storage/redis_db.h"
+#include "storage/redis_metadata.h"
+
+// The upper bound of the capacity of the bloom filter, the number of the added items
+// is the size of the metadata which is 32 bits
+constexpr uint64_t kBloomFilterMaxCapacity = 1ULL << 30;
+
+namespace Redis {
+
+// The bloom filter is a fixed size bit array, it's split into the segments which are stored
+// as the subkeys named by their indexes like the bitmap, and the segments of zeros aren't stored.
+class BloomFilter : public Database {
+ public:
+  BloomFilter(Engine::Storage *storage, const std::string &ns) : Database(storage, ns) {}
+  rocksdb::Status Reserve(const Slice &user_key, double error_rate, uint64_t capacity);
+  // The ret of each item is 1 if it's added, 0 if it might exist, or -1 if the filter is full.
+  // The filter is created with the default error rate and capacity if it doesn't exist.
+  rocksdb::Status MAdd(const Slice &user_key, const std::vector<Slice> &items, std::vector<int> *rets);
+  // The ret of each item is 1 if it might exist, or 0 if it doesn't exist
+  rocksdb::Status MExists(const Slice &user_key, const std::vector<Slice> &items, std::vector<int> *rets);
+  rocksdb::Status Info(const Slice &user_key, BloomFilterMetadata *metadata);
+
+  // Return the positions of the bits of the item by the double hashing
+  static void BitsOf(const Slice &item, const BloomFilterMetadata &metadata, std::vector<uint64_t> *positions);
+
+ private:
+  // Read the segments of the positions by one MultiGet, the segments of zeros are absent
+  rocksdb::Status getSegments(const Slice &ns_key, const BloomFilterMetadata &metadata,
+                              const std::vector<std::vector<uint64_t>> &positions, const rocksdb::Snapshot *snapshot,
+                              std::map<uint64_t, std::string> *segments);
+};
+
+}  // namespace Redis
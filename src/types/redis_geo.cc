@@ -25,13 +25,20 @@
 namespace Redis {
 
 rocksdb::Status Geo::Add(const Slice &user_key, std::vector<GeoPoint> *geo_points, int *ret) {
+  /* Turn the coordinates into the scores of the elements in one batch. */
+  size_t n = geo_points->size();
+  std::vector<double> longitudes(n), latitudes(n);
+  for (size_t i = 0; i < n; i++) {
+    longitudes[i] = (*geo_points)[i].longitude;
+    latitudes[i] = (*geo_points)[i].latitude;
+  }
+  std::vector<GeoHashFix52Bits> bits(n);
+  GeoHashHelper::EncodeScoresWGS84(longitudes.data(), latitudes.data(), n, bits.data());
+
   std::vector<MemberScore> member_scores;
-  for (const auto &geo_point : *geo_points) {
-    /* Turn the coordinates into the score of the element. */
-    GeoHashBits hash;
-    geohashEncodeWGS84(geo_point.longitude, geo_point.latitude, GEO_STEP_MAX, &hash);
-    GeoHashFix52Bits bits = GeoHashHelper::Align52Bits(hash);
-    member_scores.emplace_back(MemberScore{geo_point.member, static_cast<double>(bits)});
+  member_scores.reserve(n);
+  for (size_t i = 0; i < n; i++) {
+    member_scores.emplace_back(MemberScore{(*geo_points)[i].member, static_cast<double>(bits[i])});
   }
   return ZSet::Add(user_key, ZAddFlags::Default(), &member_scores, ret);
 }
@@ -79,30 +86,19 @@ rocksdb::Status Geo::Pos(const Slice &user_key, const std::vector<Slice> &member
 rocksdb::Status Geo::Radius(const Slice &user_key, double longitude, double latitude, double radius_meters, int count,
                             DistanceSort sort, const std::string &store_key, bool store_distance,
                             double unit_conversion, std::vector<GeoPoint> *geo_points) {
-  std::string ns_key;
-  AppendNamespacePrefix(user_key, &ns_key);
-  ZSetMetadata metadata(false);
-  rocksdb::Status s = ZSet::GetMetadata(ns_key, &metadata);
-  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
-
-  /* Get all neighbor geohash boxes for our radius search */
-  GeoHashRadius georadius = GeoHashHelper::GetAreasByRadiusWGS84(longitude, latitude, radius_meters);
-
-  /* Search the zset for all matching points */
-  membersOfAllNeighbors(user_key, georadius, longitude, latitude, radius_meters, geo_points);
+  GeoShape shape;
+  shape.type = kGeoShapeCircle;
+  shape.xy[0] = longitude;
+  shape.xy[1] = latitude;
+  shape.radius = radius_meters;
+  auto s = Search(user_key, shape, sort, count, false, geo_points);
+  if (!s.ok()) return s;
 
   /* If no matching results, the user gets an empty reply. */
   if (geo_points->empty() && store_key.empty()) {
     return rocksdb::Status::OK();
   }
 
-  /* Process [optional] requested sorting */
-  if (sort == kSortASC) {
-    std::sort(geo_points->begin(), geo_points->end(), sortGeoPointASC);
-  } else if (sort == kSortDESC) {
-    std::sort(geo_points->begin(), geo_points->end(), sortGeoPointDESC);
-  }
-
   if (!store_key.empty()) {
     int64_t result_length = geo_points->size();
     int64_t returned_items_count = (count == 0 || result_length < count) ? result_length : count;
@@ -136,6 +132,47 @@ rocksdb::Status Geo::RadiusByMember(const Slice &user_key, const Slice &member,
                 store_distance, unit_conversion, geo_points);
 }
 
+rocksdb::Status Geo::Search(const Slice &user_key, const GeoShape &shape, DistanceSort sort, int count, bool any,
+                            std::vector<GeoPoint> *geo_points) {
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+  ZSetMetadata metadata(false);
+  rocksdb::Status s = ZSet::GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+
+  /* Get all neighbor geohash boxes for our search */
+  GeoHashRadius georadius = GeoHashHelper::GetAreasByShapeWGS84(shape);
+
+  /* Search the zset for all matching points */
+  membersOfAllNeighbors(user_key, georadius, shape, sort, count, any, geo_points);
+
+  /* Process [optional] requested sorting */
+  if (sort == kSortASC) {
+    std::sort(geo_points->begin(), geo_points->end(), sortGeoPointASC);
+  } else if (sort == kSortDESC) {
+    std::sort(geo_points->begin(), geo_points->end(), sortGeoPointDESC);
+  }
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status Geo::SearchByMember(const Slice &user_key, const Slice &member, GeoShape shape, DistanceSort sort,
+                                    int count, bool any, std::vector<GeoPoint> *geo_points) {
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+  ZSetMetadata metadata(false);
+  rocksdb::Status s = ZSet::GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+
+  GeoPoint geo_point;
+  s = Get(user_key, member, &geo_point);
+  if (s.IsNotFound()) return rocksdb::Status::InvalidArgument("could not decode requested zset member");
+  if (!s.ok()) return s;
+
+  shape.xy[0] = geo_point.longitude;
+  shape.xy[1] = geo_point.latitude;
+  return Search(user_key, shape, sort, count, any, geo_points);
+}
+
 rocksdb::Status Geo::Get(const Slice &user_key, const Slice &member, GeoPoint *geo_point) {
   std::map<std::string, GeoPoint> geo_points;
   auto s = MGet(user_key, {member}, &geo_points);
@@ -207,11 +244,17 @@ int Geo::decodeGeoHash(double bits, double *xy) {
   return geohashDecodeToLongLatWGS84(hash, xy);
 }
 
-/* Search all eight neighbors + self geohash box */
-int Geo::membersOfAllNeighbors(const Slice &user_key, GeoHashRadius n, double lon, double lat, double radius,
-                               std::vector<GeoPoint> *geo_points) {
+/* Search all eight neighbors + self geohash box.
+ *
+ * With COUNT (but not ANY), only the best count points are kept in a heap whose
+ * top is the worst of them. For the ascending order, the boxes are visited from
+ * the nearest one, and the search stops once the remaining boxes can't contain
+ * a point nearer than the worst kept one. With ANY, it stops as soon as enough
+ * points are found. */
+int Geo::membersOfAllNeighbors(const Slice &user_key, GeoHashRadius n, const GeoShape &shape, DistanceSort sort,
+                               int count, bool any, std::vector<GeoPoint> *geo_points) {
   GeoHashBits neighbors[9];
-  unsigned int i = 0, count = 0, last_processed = 0;
+  unsigned int i = 0, last_processed = 0;
 
   neighbors[0] = n.hash;
   neighbors[1] = n.neighbors.north;
@@ -223,8 +266,8 @@ int Geo::membersOfAllNeighbors(const Slice &user_key, GeoHashRadius n, double lo
   neighbors[7] = n.neighbors.south_east;
   neighbors[8] = n.neighbors.south_west;
 
-  /* For each neighbor (*and* our own hashbox), get all the matching
-   * members and add them to the potential result list. */
+  /* [lower bound of the distances to the box, box] */
+  std::vector<std::pair<double, GeoHashBits>> boxes;
   for (i = 0; i < sizeof(neighbors) / sizeof(*neighbors); i++) {
     if (HASHISZERO(neighbors[i])) {
       continue;
@@ -238,21 +281,54 @@ int Geo::membersOfAllNeighbors(const Slice &user_key, GeoHashRadius n, double lo
         neighbors[i].step == neighbors[last_processed].step) {
       continue;
     }
-    count += membersOfGeoHashBox(user_key, neighbors[i], geo_points, lon, lat, radius);
+    GeoHashArea area;
+    geohashDecodeType(neighbors[i], &area);
+    boxes.emplace_back(GeoHashHelper::GetMinDistanceToArea(shape.xy[0], shape.xy[1], area), neighbors[i]);
     last_processed = i;
   }
-  return count;
+
+  bool keep_best = count > 0 && !any && sort != kSortNone;
+  if (keep_best && sort == kSortASC) {
+    std::stable_sort(boxes.begin(), boxes.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+  }
+  /* The comparator of the heap whose top is the worst kept point */
+  auto better = sort == kSortASC ? sortGeoPointASC : sortGeoPointDESC;
+
+  int added = 0;
+  std::vector<GeoPoint> box_points;
+  for (const auto &[min_distance, box] : boxes) {
+    if (keep_best && sort == kSortASC && geo_points->size() == static_cast<size_t>(count) &&
+        min_distance > geo_points->front().dist) {
+      break;
+    }
+
+    box_points.clear();
+    membersOfGeoHashBox(user_key, box, &box_points, shape);
+    for (auto &geo_point : box_points) {
+      if (any && geo_points->size() == static_cast<size_t>(count)) return added;
+      if (!keep_best || geo_points->size() < static_cast<size_t>(count)) {
+        geo_points->emplace_back(std::move(geo_point));
+        if (keep_best) std::push_heap(geo_points->begin(), geo_points->end(), better);
+        added++;
+      } else if (better(geo_point, geo_points->front())) {
+        std::pop_heap(geo_points->begin(), geo_points->end(), better);
+        geo_points->back() = std::move(geo_point);
+        std::push_heap(geo_points->begin(), geo_points->end(), better);
+      }
+    }
+  }
+  return added;
 }
 
 /* Obtain all members between the min/max of this geohash bounding box.
  * Populate a GeoArray of GeoPoints by calling getPointsInRange().
  * Return the number of points added to the array. */
-int Geo::membersOfGeoHashBox(const Slice &user_key, GeoHashBits hash, std::vector<GeoPoint> *geo_points, double lon,
-                             double lat, double radius) {
+int Geo::membersOfGeoHashBox(const Slice &user_key, GeoHashBits hash, std::vector<GeoPoint> *geo_points,
+                             const GeoShape &shape) {
   GeoHashFix52Bits min = 0, max = 0;
 
   scoresOfGeoHashBox(hash, &min, &max);
-  return getPointsInRange(user_key, min, max, lon, lat, radius, geo_points);
+  return getPointsInRange(user_key, min, max, shape, geo_points);
 }
 
 /* Compute the sorted set scores min (inclusive), max (exclusive) we should
@@ -296,7 +372,7 @@ void Geo::scoresOfGeoHashBox(GeoHashBits hash, GeoHashFix52Bits *min, GeoHashFix
  * using multiple queries to the sorted set, that we later need to sort
  * via qsort. Similarly we need to be able to reject points outside the search
  * radius area ASAP in order to allocate and process more points than needed. */
-int Geo::getPointsInRange(const Slice &user_key, double min, double max, double lon, double lat, double radius,
+int Geo::getPointsInRange(const Slice &user_key, double min, double max, const GeoShape &shape,
                           std::vector<GeoPoint> *geo_points) {
   /* include min in range; exclude max in range */
   /* That's: min <= val < max */
@@ -309,42 +385,37 @@ int Geo::getPointsInRange(const Slice &user_key, double min, double max, double
   rocksdb::Status s = ZSet::RangeByScore(user_key, spec, &member_scores, &size);
   if (!s.ok()) return 0;
 
-  for (const auto &member_score : member_scores) {
-    appendIfWithinRadius(geo_points, lon, lat, radius, member_score.score, member_score.member);
+  /* The candidates are decoded and checked against the shape in batch,
+   * then only the points within the search area are appended. */
+  size_t n = member_scores.size();
+  std::vector<double> scores(n), longitudes(n), latitudes(n), distances(n);
+  std::vector<uint8_t> within(n);
+  for (size_t i = 0; i < n; i++) scores[i] = member_scores[i].score;
+  GeoHashHelper::DecodeScoresWGS84(scores.data(), n, longitudes.data(), latitudes.data());
+  size_t count = GeoHashHelper::GetDistancesIfInShape(shape, longitudes.data(), latitudes.data(), n, distances.data(),
+                                                      within.data());
+
+  geo_points->reserve(geo_points->size() + count);
+  for (size_t i = 0; i < n; i++) {
+    if (!within[i]) continue;
+    GeoPoint geo_point;
+    geo_point.longitude = longitudes[i];
+    geo_point.latitude = latitudes[i];
+    geo_point.dist = distances[i];
+    geo_point.member = std::move(member_scores[i].member);
+    geo_point.score = scores[i];
+    geo_points->emplace_back(std::move(geo_point));
   }
-  return 0;
+  return static_cast<int>(count);
 }
 
-/* Helper function for geoGetPointsInRange(): given a sorted set score
- * representing a point, and another point (the center of our search) and
- * a radius, appends this entry as a geoPoint into the specified geoArray
- * only if the point is within the search area.
- *
- * returns true if the point is included, or false if it is outside. */
-bool Geo::appendIfWithinRadius(std::vector<GeoPoint> *geo_points, double lon, double lat, double radius, double score,
-                               const std::string &member) {
-  double distance = NAN, xy[2];
-
-  if (!decodeGeoHash(score, xy)) return false; /* Can't decode. */
-  /* Note that geohashGetDistanceIfInRadiusWGS84() takes arguments in
-   * reverse order: longitude first, latitude later. */
-  if (!GeoHashHelper::GetDistanceIfInRadiusWGS84(lon, lat, xy[0], xy[1], radius, &distance)) {
-    return false;
-  }
-
-  /* Append the new element. */
-  GeoPoint geo_point;
-  geo_point.longitude = xy[0];
-  geo_point.latitude = xy[1];
-  geo_point.dist = distance;
-  geo_point.member = member;
-  geo_point.score = score;
-  geo_points->emplace_back(geo_point);
-  return true;
+/* The points at the same distance are ordered by the member, so the kept points of COUNT are deterministic */
+bool Geo::sortGeoPointASC(const GeoPoint &gp1, const GeoPoint &gp2) {
+  return gp1.dist < gp2.dist || (gp1.dist == gp2.dist && gp1.member < gp2.member);
 }
 
-bool Geo::sortGeoPointASC(const GeoPoint &gp1, const GeoPoint &gp2) { return gp1.dist < gp2.dist; }
-
-bool Geo::sortGeoPointDESC(const GeoPoint &gp1, const GeoPoint &gp2) { return gp1.dist >= gp2.dist; }
+bool Geo::sortGeoPointDESC(const GeoPoint &gp1, const GeoPoint &gp2) {
+  return gp1.dist > gp2.dist || (gp1.dist == gp2.dist && gp1.member < gp2.member);
+}
 
 }  // namespace Redis
@@ -68,6 +68,12 @@ class Geo : public ZSet {
   rocksdb::Status RadiusByMember(const Slice &user_key, const Slice &member, double radius_meters, int count,
                                  DistanceSort sort, const std::string &store_key, bool store_distance,
                                  double unit_conversion, std::vector<GeoPoint> *geo_points);
+  // Search the points in the shape, only the nearest (or farthest if DESC) count points are kept if count > 0,
+  // or the first found count points if any is true
+  rocksdb::Status Search(const Slice &user_key, const GeoShape &shape, DistanceSort sort, int count, bool any,
+                         std::vector<GeoPoint> *geo_points);
+  rocksdb::Status SearchByMember(const Slice &user_key, const Slice &member, GeoShape shape, DistanceSort sort,
+                                 int count, bool any, std::vector<GeoPoint> *geo_points);
 
   rocksdb::Status Get(const Slice &user_key, const Slice &member, GeoPoint *geo_point);
   rocksdb::Status MGet(const Slice &user_key, const std::vector<Slice> &members,
@@ -76,15 +82,13 @@ class Geo : public ZSet {
 
  private:
   int decodeGeoHash(double bits, double *xy);
-  int membersOfAllNeighbors(const Slice &user_key, GeoHashRadius n, double lon, double lat, double radius,
-                            std::vector<GeoPoint> *geo_points);
-  int membersOfGeoHashBox(const Slice &user_key, GeoHashBits hash, std::vector<GeoPoint> *geo_points, double lon,
-                          double lat, double radius);
+  int membersOfAllNeighbors(const Slice &user_key, GeoHashRadius n, const GeoShape &shape, DistanceSort sort,
+                            int count, bool any, std::vector<GeoPoint> *geo_points);
+  int membersOfGeoHashBox(const Slice &user_key, GeoHashBits hash, std::vector<GeoPoint> *geo_points,
+                          const GeoShape &shape);
   void scoresOfGeoHashBox(GeoHashBits hash, GeoHashFix52Bits *min, GeoHashFix52Bits *max);
-  int getPointsInRange(const Slice &user_key, double min, double max, double lon, double lat, double radius,
+  int getPointsInRange(const Slice &user_key, double min, double max, const GeoShape &shape,
                        std::vector<GeoPoint> *geo_points);
-  bool appendIfWithinRadius(std::vector<GeoPoint> *geo_points, double lon, double lat, double radius, double score,
-                            const std::string &member);
 
   static bool sortGeoPointASC(const GeoPoint &gp1, const GeoPoint &gp2);
   static bool sortGeoPointDESC(const GeoPoint &gp1, const GeoPoint &gp2);
@@ -26,6 +26,8 @@
 #include <cctype>
 #include <cmath>
 #include <limits>
+#include <set>
+#include <string_view>
 #include <utility>
 
 #include "db_util.h"
@@ -54,12 +56,30 @@ rocksdb::Status Hash::Get(const Slice &user_key, const Slice &field, std::string
   HashMetadata metadata(false);
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok()) return s;
-  LatestSnapShot ss(db_);
+  if (metadata.inlined) return getField(ns_key, metadata, field, value);
+  rocksdb::ReadOptions read_options;
+  std::string sub_key;
+  InternalKey(ns_key, field, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+  return storage_->Get(read_options, sub_key, value);
+}
+
+rocksdb::Status Hash::Get(const Slice &user_key, const Slice &field, rocksdb::PinnableSlice *value) {
+  value->Reset();
+
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+  HashMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+  if (metadata.inlined) {
+    s = getField(ns_key, metadata, field, value->GetSelf());
+    if (s.ok()) value->PinSelf();
+    return s;
+  }
   rocksdb::ReadOptions read_options;
-  read_options.snapshot = ss.GetSnapShot();
   std::string sub_key;
   InternalKey(ns_key, field, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-  return db_->Get(read_options, sub_key, value);
+  return storage_->Get(read_options, sub_key, value);
 }
 
 rocksdb::Status Hash::IncrBy(const Slice &user_key, const Slice &field, int64_t increment, int64_t *ret) {
@@ -73,12 +93,11 @@ rocksdb::Status Hash::IncrBy(const Slice &user_key, const Slice &field, int64_t
   HashMetadata metadata;
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok() && !s.IsNotFound()) return s;
+  if (s.IsNotFound()) metadata.inlined = storage_->GetConfig()->hash_inline_max_entries > 0;
 
-  std::string sub_key;
-  InternalKey(ns_key, field, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
   if (s.ok()) {
     std::string value_bytes;
-    s = db_->Get(rocksdb::ReadOptions(), sub_key, &value_bytes);
+    s = getField(ns_key, metadata, field, &value_bytes);
     if (!s.ok() && !s.IsNotFound()) return s;
     if (s.ok()) {
       auto parse_result = ParseInt<int64_t>(value_bytes, 10);
@@ -101,13 +120,9 @@ rocksdb::Status Hash::IncrBy(const Slice &user_key, const Slice &field, int64_t
   rocksdb::WriteBatch batch;
   WriteBatchLogData log_data(kRedisHash);
   batch.PutLogData(log_data.Encode());
-  batch.Put(sub_key, std::to_string(*ret));
-  if (!exists) {
-    metadata.size += 1;
-    std::string bytes;
-    metadata.Encode(&bytes);
-    batch.Put(metadata_cf_handle_, ns_key, bytes);
-  }
+  setField(ns_key, &metadata, field, std::to_string(*ret), &batch);
+  if (!exists) metadata.size += 1;
+  if (!exists || metadata.inlined) putMetadata(ns_key, &metadata, &batch);
   return storage_->Write(storage_->DefaultWriteOptions(), &batch);
 }
 
@@ -122,23 +137,18 @@ rocksdb::Status Hash::IncrByFloat(const Slice &user_key, const Slice &field, dou
   HashMetadata metadata;
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok() && !s.IsNotFound()) return s;
+  if (s.IsNotFound()) metadata.inlined = storage_->GetConfig()->hash_inline_max_entries > 0;
 
-  std::string sub_key;
-  InternalKey(ns_key, field, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
   if (s.ok()) {
     std::string value_bytes;
-    std::size_t idx = 0;
-    s = db_->Get(rocksdb::ReadOptions(), sub_key, &value_bytes);
+    s = getField(ns_key, metadata, field, &value_bytes);
     if (!s.ok() && !s.IsNotFound()) return s;
     if (s.ok()) {
-      try {
-        old_value = std::stod(value_bytes, &idx);
-      } catch (std::exception &e) {
-        return rocksdb::Status::InvalidArgument(e.what());
-      }
-      if (isspace(value_bytes[0]) || idx != value_bytes.size()) {
+      auto parse_result = ParseFloat(value_bytes);
+      if (!parse_result) {
         return rocksdb::Status::InvalidArgument("value is not an float");
       }
+      old_value = *parse_result;
       exists = true;
     }
   }
@@ -151,13 +161,9 @@ rocksdb::Status Hash::IncrByFloat(const Slice &user_key, const Slice &field, dou
   rocksdb::WriteBatch batch;
   WriteBatchLogData log_data(kRedisHash);
   batch.PutLogData(log_data.Encode());
-  batch.Put(sub_key, std::to_string(*ret));
-  if (!exists) {
-    metadata.size += 1;
-    std::string bytes;
-    metadata.Encode(&bytes);
-    batch.Put(metadata_cf_handle_, ns_key, bytes);
-  }
+  setField(ns_key, &metadata, field, std::to_string(*ret), &batch);
+  if (!exists) metadata.size += 1;
+  if (!exists || metadata.inlined) putMetadata(ns_key, &metadata, &batch);
   return storage_->Write(storage_->DefaultWriteOptions(), &batch);
 }
 
@@ -174,17 +180,20 @@ rocksdb::Status Hash::MGet(const Slice &user_key, const std::vector<Slice> &fiel
     return s;
   }
 
-  LatestSnapShot ss(db_);
-  rocksdb::ReadOptions read_options;
-  read_options.snapshot = ss.GetSnapShot();
-  std::string sub_key, value;
-  for (const auto &field : fields) {
-    InternalKey(ns_key, field, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-    value.clear();
-    auto s = db_->Get(read_options, sub_key, &value);
-    if (!s.ok() && !s.IsNotFound()) return s;
-    values->emplace_back(value);
-    statuses->emplace_back(s);
+  if (metadata.inlined) {
+    for (const auto &field : fields) {
+      values->emplace_back();
+      statuses->emplace_back(getField(ns_key, metadata, field, &values->back()));
+    }
+    return rocksdb::Status::OK();
+  }
+
+  std::vector<rocksdb::PinnableSlice> pin_values;
+  multiGetSubKeys(ns_key, metadata.version, fields, &pin_values, statuses);
+  values->reserve(fields.size());
+  for (size_t i = 0; i < fields.size(); i++) {
+    if (!(*statuses)[i].ok() && !(*statuses)[i].IsNotFound()) return (*statuses)[i];
+    values->emplace_back(pin_values[i].data(), pin_values[i].size());
   }
   return rocksdb::Status::OK();
 }
@@ -216,22 +225,19 @@ rocksdb::Status Hash::Delete(const Slice &user_key, const std::vector<Slice> &fi
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
 
-  std::string sub_key, value;
+  std::string value;
   for (const auto &field : fields) {
-    InternalKey(ns_key, field, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-    s = db_->Get(rocksdb::ReadOptions(), sub_key, &value);
+    s = getField(ns_key, metadata, field, &value);
     if (s.ok()) {
       *ret += 1;
-      batch.Delete(sub_key);
+      deleteField(ns_key, &metadata, field, &batch);
     }
   }
   if (*ret == 0) {
     return rocksdb::Status::OK();
   }
   metadata.size -= *ret;
-  std::string bytes;
-  metadata.Encode(&bytes);
-  batch.Put(metadata_cf_handle_, ns_key, bytes);
+  putMetadata(ns_key, &metadata, &batch);
   return storage_->Write(storage_->DefaultWriteOptions(), &batch);
 }
 
@@ -244,19 +250,47 @@ rocksdb::Status Hash::MSet(const Slice &user_key, const std::vector<FieldValue>
   HashMetadata metadata;
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok() && !s.IsNotFound()) return s;
+  bool fresh = s.IsNotFound();
+
+  // The last value of the duplicated fields wins, and the old values of the fields are read by
+  // one batched MultiGet under the lock, rather than a Get per field
+  std::set<std::string_view> unique_fields;
+  std::vector<const FieldValue *> new_field_values;
+  for (auto iter = field_values.rbegin(); iter != field_values.rend(); ++iter) {
+    if (unique_fields.emplace(iter->field).second) new_field_values.emplace_back(&*iter);
+  }
+  std::reverse(new_field_values.begin(), new_field_values.end());
+  if (fresh) {
+    // The new key which would outgrow the inlined fields is written as the subkeys at once
+    int max_entries = storage_->GetConfig()->hash_inline_max_entries;
+    metadata.inlined = max_entries > 0 && new_field_values.size() <= static_cast<size_t>(max_entries);
+  }
+  std::vector<rocksdb::PinnableSlice> old_values;
+  std::vector<rocksdb::Status> statuses;
+  if (metadata.size > 0 && !metadata.inlined) {
+    std::vector<Slice> fields;
+    fields.reserve(new_field_values.size());
+    for (const auto *fv : new_field_values) fields.emplace_back(fv->field);
+    multiGetSubKeys(ns_key, metadata.version, fields, &old_values, &statuses);
+  }
 
   int added = 0;
-  bool exists = false;
+  bool exists = false, updated = false;
   rocksdb::WriteBatch batch;
   WriteBatchLogData log_data(kRedisHash);
   batch.PutLogData(log_data.Encode());
-  for (const auto &fv : field_values) {
+  ChunkedBatchWriter chunk_writer(storage_, &batch, &log_data, metadata.version);
+  for (size_t i = 0; i < new_field_values.size(); i++) {
+    const auto &fv = *new_field_values[i];
     exists = false;
-    std::string sub_key;
-    InternalKey(ns_key, fv.field, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-    if (metadata.size > 0) {
+    if (metadata.size > 0 || metadata.inlined) {
       std::string fieldValue;
-      s = db_->Get(rocksdb::ReadOptions(), sub_key, &fieldValue);
+      if (metadata.inlined) {
+        s = getField(ns_key, metadata, fv.field, &fieldValue);
+      } else {
+        s = statuses[i];
+        if (s.ok()) fieldValue.assign(old_values[i].data(), old_values[i].size());
+      }
       if (!s.ok() && !s.IsNotFound()) return s;
       if (s.ok()) {
         if (((fieldValue == fv.value) || nx)) continue;
@@ -264,16 +298,52 @@ rocksdb::Status Hash::MSet(const Slice &user_key, const std::vector<FieldValue>
       }
     }
     if (!exists) added++;
-    batch.Put(sub_key, fv.value);
+    updated = true;
+    setField(ns_key, &metadata, fv.field, fv.value, &batch);
+    // The fields of the new key are invisible until its metadata is written by the last batch
+    if (fresh && !metadata.inlined) {
+      s = chunk_writer.WriteIfFull();
+      if (!s.ok()) return s;
+    }
   }
   if (added > 0) {
     *ret = added;
     metadata.size += added;
-    std::string bytes;
-    metadata.Encode(&bytes);
-    batch.Put(metadata_cf_handle_, ns_key, bytes);
   }
-  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+  if (added > 0 || (updated && metadata.inlined)) {
+    putMetadata(ns_key, &metadata, &batch);
+  }
+  return chunk_writer.Write();
+}
+
+rocksdb::Status Hash::RandField(const Slice &user_key, int64_t count, std::vector<FieldValue> *field_values) {
+  field_values->clear();
+  if (count == 0) return rocksdb::Status::OK();
+  bool allow_duplicates = count < 0;
+  uint64_t n = allow_duplicates ? -count : count;
+
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+  HashMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+
+  if (metadata.inlined) {
+    std::vector<std::map<std::string, std::string>::const_iterator> elems;
+    for (auto iter = metadata.fields.cbegin(); iter != metadata.fields.cend(); ++iter) elems.emplace_back(iter);
+    for (size_t pos : SampleInlinedPositions(elems.size(), n, allow_duplicates)) {
+      field_values->emplace_back(FieldValue{elems[pos]->first, elems[pos]->second});
+    }
+    return rocksdb::Status::OK();
+  }
+
+  std::vector<std::string> fields, values;
+  s = Sample(ns_key, metadata, n, allow_duplicates, &fields, &values);
+  if (!s.ok()) return s;
+  for (size_t i = 0; i < fields.size(); i++) {
+    field_values->emplace_back(FieldValue{std::move(fields[i]), std::move(values[i])});
+  }
+  return rocksdb::Status::OK();
 }
 
 rocksdb::Status Hash::Range(const Slice &user_key, const Slice &start, const Slice &stop, int64_t limit,
@@ -288,17 +358,25 @@ rocksdb::Status Hash::Range(const Slice &user_key, const Slice &start, const Sli
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
   limit = std::min(static_cast<int64_t>(metadata.size), limit);
+  if (metadata.inlined) {
+    for (auto iter = metadata.fields.lower_bound(start.ToString());
+         iter != metadata.fields.end() && Slice(iter->first).compare(stop) < 0 &&
+         static_cast<int64_t>(field_values->size()) < limit;
+         ++iter) {
+      field_values->emplace_back(FieldValue{iter->first, iter->second});
+    }
+    return rocksdb::Status::OK();
+  }
   std::string start_key, stop_key;
   InternalKey(ns_key, start, metadata.version, storage_->IsSlotIdEncoded()).Encode(&start_key);
   InternalKey(ns_key, stop, metadata.version, storage_->IsSlotIdEncoded()).Encode(&stop_key);
   rocksdb::ReadOptions read_options;
-  LatestSnapShot ss(db_);
-  read_options.snapshot = ss.GetSnapShot();
+  storage_->SetLongScanReadOptions(&read_options);
   rocksdb::Slice upper_bound(stop_key);
   read_options.iterate_upper_bound = &upper_bound;
   read_options.fill_cache = false;
 
-  auto iter = DBUtil::UniqueIterator(db_, read_options);
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options));
   iter->Seek(start_key);
   for (int64_t i = 0; iter->Valid() && i <= limit - 1; ++i) {
     FieldValue tmp_field_value;
@@ -313,25 +391,51 @@ rocksdb::Status Hash::Range(const Slice &user_key, const Slice &start, const Sli
 
 rocksdb::Status Hash::GetAll(const Slice &user_key, std::vector<FieldValue> *field_values, HashFetchType type) {
   field_values->clear();
+  return GetAll(user_key, type, std::numeric_limits<size_t>::max(),
+                [field_values](uint64_t total, std::vector<FieldValue> *chunk) { *field_values = std::move(*chunk); });
+}
 
+rocksdb::Status Hash::GetAll(const Slice &user_key, HashFetchType type, size_t chunk_size,
+                             const ChunkCallback<FieldValue> &cb) {
   std::string ns_key;
   AppendNamespacePrefix(user_key, &ns_key);
+
+  // The metadata and fields should be read from the same snapshot,
+  // or the size might not match the fields which were fed in chunks.
+  LatestSnapShot ss(db_);
   HashMetadata metadata(false);
-  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  rocksdb::Status s = Database::GetMetadata(kRedisHash, ns_key, &metadata, ss.GetSnapShot());
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
 
+  std::vector<FieldValue> chunk;
+  chunk.reserve(std::min<uint64_t>(chunk_size, metadata.size));
+  if (metadata.inlined) {
+    for (const auto &iter : metadata.fields) {
+      FieldValue fv;
+      if (type != HashFetchType::kOnlyValue) fv.field = iter.first;
+      if (type != HashFetchType::kOnlyKey) fv.value = iter.second;
+      chunk.emplace_back(std::move(fv));
+      if (chunk.size() >= chunk_size) {
+        cb(metadata.size, &chunk);
+        chunk.clear();
+      }
+    }
+    if (!chunk.empty()) cb(metadata.size, &chunk);
+    return rocksdb::Status::OK();
+  }
+
   std::string prefix_key, next_version_prefix_key;
   InternalKey(ns_key, "", metadata.version, storage_->IsSlotIdEncoded()).Encode(&prefix_key);
   InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix_key);
 
   rocksdb::ReadOptions read_options;
-  LatestSnapShot ss(db_);
+  storage_->SetLongScanReadOptions(&read_options);
   read_options.snapshot = ss.GetSnapShot();
   rocksdb::Slice upper_bound(next_version_prefix_key);
   read_options.iterate_upper_bound = &upper_bound;
   read_options.fill_cache = false;
 
-  auto iter = DBUtil::UniqueIterator(db_, read_options);
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options));
   for (iter->Seek(prefix_key); iter->Valid() && iter->key().starts_with(prefix_key); iter->Next()) {
     FieldValue fv;
     if (type == HashFetchType::kOnlyKey) {
@@ -344,15 +448,89 @@ rocksdb::Status Hash::GetAll(const Slice &user_key, std::vector<FieldValue> *fie
       fv.field = ikey.GetSubKey().ToString();
       fv.value = iter->value().ToString();
     }
-    field_values->emplace_back(fv);
+    chunk.emplace_back(std::move(fv));
+    if (chunk.size() >= chunk_size) {
+      cb(metadata.size, &chunk);
+      chunk.clear();
+    }
   }
+  if (!chunk.empty()) cb(metadata.size, &chunk);
   return rocksdb::Status::OK();
 }
 
 rocksdb::Status Hash::Scan(const Slice &user_key, const std::string &cursor, uint64_t limit,
                            const std::string &field_prefix, std::vector<std::string> *fields,
                            std::vector<std::string> *values) {
-  return SubKeyScanner::Scan(kRedisHash, user_key, cursor, limit, field_prefix, fields, values);
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+  HashMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+  if (!metadata.inlined) {
+    return SubKeyScanner::Scan(kRedisHash, user_key, cursor, limit, field_prefix, fields, values);
+  }
+
+  // Follow the order and the cursor semantics of scanning the subkeys
+  auto iter = cursor.empty() ? metadata.fields.lower_bound(field_prefix) : metadata.fields.upper_bound(cursor);
+  for (; iter != metadata.fields.end() && Slice(iter->first).starts_with(field_prefix); ++iter) {
+    fields->emplace_back(iter->first);
+    if (values != nullptr) values->emplace_back(iter->second);
+    if (limit > 0 && fields->size() >= limit) break;
+  }
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status Hash::getField(const Slice &ns_key, const HashMetadata &metadata, const Slice &field,
+                               std::string *value) {
+  if (metadata.inlined) {
+    auto iter = metadata.fields.find(field.ToString());
+    if (iter == metadata.fields.end()) return rocksdb::Status::NotFound();
+    *value = iter->second;
+    return rocksdb::Status::OK();
+  }
+  std::string sub_key;
+  InternalKey(ns_key, field, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+  return storage_->Get(rocksdb::ReadOptions(), sub_key, value);
+}
+
+void Hash::setField(const Slice &ns_key, HashMetadata *metadata, const Slice &field, const Slice &value,
+                    rocksdb::WriteBatch *batch) {
+  if (metadata->inlined) {
+    metadata->fields[field.ToString()] = value.ToString();
+    return;
+  }
+  std::string sub_key;
+  InternalKey(ns_key, field, metadata->version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+  batch->Put(sub_key, value);
+}
+
+void Hash::deleteField(const Slice &ns_key, HashMetadata *metadata, const Slice &field,
+                       rocksdb::WriteBatch *batch) {
+  if (metadata->inlined) {
+    metadata->fields.erase(field.ToString());
+    return;
+  }
+  std::string sub_key;
+  InternalKey(ns_key, field, metadata->version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+  batch->Delete(sub_key);
+}
+
+// Put the metadata into the batch, the inline hash which grows beyond the limits
+// is converted to the subkeys with its current version.
+void Hash::putMetadata(const Slice &ns_key, HashMetadata *metadata, rocksdb::WriteBatch *batch) {
+  auto config = storage_->GetConfig();
+  if (metadata->inlined && (metadata->fields.size() > static_cast<size_t>(config->hash_inline_max_entries) ||
+                            metadata->InlineBytes() > static_cast<size_t>(config->hash_inline_max_bytes))) {
+    SubKeyEncoder encoder(ns_key, metadata->version, storage_->IsSlotIdEncoded());
+    for (const auto &iter : metadata->fields) {
+      batch->Put(encoder.Encode(iter.first), iter.second);
+    }
+    metadata->inlined = false;
+    metadata->fields.clear();
+  }
+  std::string bytes;
+  metadata->Encode(&bytes);
+  batch->Put(metadata_cf_handle_, ns_key, bytes);
 }
 
 }  // namespace Redis
@@ -42,6 +42,9 @@ class Hash : public SubKeyScanner {
   Hash(Engine::Storage *storage, const std::string &ns) : SubKeyScanner(storage, ns) {}
   rocksdb::Status Size(const Slice &user_key, uint32_t *ret);
   rocksdb::Status Get(const Slice &user_key, const Slice &field, std::string *value);
+  // Read the field pinned in the block cache without copying it, the field of the inline hash is
+  // copied into the buffer of the pinnable slice
+  rocksdb::Status Get(const Slice &user_key, const Slice &field, rocksdb::PinnableSlice *value);
   rocksdb::Status Set(const Slice &user_key, const Slice &field, const Slice &value, int *ret);
   rocksdb::Status SetNX(const Slice &user_key, const Slice &field, Slice value, int *ret);
   rocksdb::Status Delete(const Slice &user_key, const std::vector<Slice> &fields, int *ret);
@@ -54,11 +57,20 @@ class Hash : public SubKeyScanner {
                        std::vector<rocksdb::Status> *statuses);
   rocksdb::Status GetAll(const Slice &user_key, std::vector<FieldValue> *field_values,
                          HashFetchType type = HashFetchType::kAll);
+  rocksdb::Status GetAll(const Slice &user_key, HashFetchType type, size_t chunk_size,
+                         const ChunkCallback<FieldValue> &cb);
   rocksdb::Status Scan(const Slice &user_key, const std::string &cursor, uint64_t limit,
                        const std::string &field_prefix, std::vector<std::string> *fields,
                        std::vector<std::string> *values = nullptr);
+  // HRANDFIELD, the fields are distinct if the count is positive, or may be duplicated if it's negative
+  rocksdb::Status RandField(const Slice &user_key, int64_t count, std::vector<FieldValue> *field_values);
 
  private:
   rocksdb::Status GetMetadata(const Slice &ns_key, HashMetadata *metadata);
+  rocksdb::Status getField(const Slice &ns_key, const HashMetadata &metadata, const Slice &field, std::string *value);
+  void setField(const Slice &ns_key, HashMetadata *metadata, const Slice &field, const Slice &value,
+                rocksdb::WriteBatch *batch);
+  void deleteField(const Slice &ns_key, HashMetadata *metadata, const Slice &field, rocksdb::WriteBatch *batch);
+  void putMetadata(const Slice &ns_key, HashMetadata *metadata, rocksdb::WriteBatch *batch);
 };
 }  // namespace Redis
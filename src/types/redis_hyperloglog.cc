@@ -0,0 +1,381 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "redis_hyperloglog.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <utility>
+
+#include "hash_util.h"
+
+namespace Redis {
+
+// The number of the bits of the hash used for the leading zeros
+const uint32_t kHyperLogLogQ = 64 - kHyperLogLogRegisterBits;
+const double kHyperLogLogAlphaInf = 0.721347520444481703680;
+const uint32_t kHyperLogLogHashSeed = 0xadc83b19;
+
+uint8_t HyperLogLog::RegisterOf(const Slice &element, uint32_t *index) {
+  uint64_t hash = Util::MurmurHash64A(element, kHyperLogLogHashSeed);
+  *index = static_cast<uint32_t>(hash & (kHyperLogLogRegisters - 1));
+  hash >>= kHyperLogLogRegisterBits;
+  // The sentinel bit makes sure the loop terminates
+  hash |= static_cast<uint64_t>(1) << kHyperLogLogQ;
+  uint8_t count = 1;
+  for (uint64_t bit = 1; (hash & bit) == 0; bit <<= 1) count++;
+  return count;
+}
+
+std::string HyperLogLog::EncodeSegment(const uint8_t *registers) {
+  uint32_t non_zeros = 0;
+  for (uint32_t i = 0; i < kHyperLogLogSegmentRegisters; i++) {
+    if (registers[i] != 0) non_zeros++;
+  }
+  std::string value;
+  if (non_zeros == 0) return value;
+  if (non_zeros <= kHyperLogLogSparseMaxRegisters) {
+    value.reserve(1 + non_zeros * 3);
+    PutFixed8(&value, kHyperLogLogSegmentSparse);
+    for (uint32_t i = 0; i < kHyperLogLogSegmentRegisters; i++) {
+      if (registers[i] == 0) continue;
+      PutFixed16(&value, static_cast<uint16_t>(i));
+      PutFixed8(&value, registers[i]);
+    }
+    return value;
+  }
+  value.reserve(1 + kHyperLogLogSegmentRegisters);
+  PutFixed8(&value, kHyperLogLogSegmentDense);
+  value.append(reinterpret_cast<const char *>(registers), kHyperLogLogSegmentRegisters);
+  return value;
+}
+
+bool HyperLogLog::DecodeSegment(const Slice &value, uint8_t *registers) {
+  Slice input(value);
+  uint8_t encoding = 0;
+  if (!GetFixed8(&input, &encoding)) return false;
+  if (encoding == kHyperLogLogSegmentDense) {
+    if (input.size() != kHyperLogLogSegmentRegisters) return false;
+    memcpy(registers, input.data(), kHyperLogLogSegmentRegisters);
+    return true;
+  }
+  if (encoding != kHyperLogLogSegmentSparse || input.size() % 3 != 0) return false;
+  memset(registers, 0, kHyperLogLogSegmentRegisters);
+  uint16_t offset = 0;
+  uint8_t count = 0;
+  while (GetFixed16(&input, &offset) && GetFixed8(&input, &count)) {
+    if (offset >= kHyperLogLogSegmentRegisters) return false;
+    registers[offset] = count;
+  }
+  return true;
+}
+
+// The plain loop over the bytes is vectorized by the compiler into the packed max instructions
+void HyperLogLog::MergeRegisters(uint8_t *dst, const uint8_t *src, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    dst[i] = std::max(dst[i], src[i]);
+  }
+}
+
+static double hllSigma(double x) {
+  if (x == 1.) return INFINITY;
+  double z_prime = 0;
+  double y = 1;
+  double z = x;
+  do {
+    x *= x;
+    z_prime = z;
+    z += x * y;
+    y += y;
+  } while (z_prime != z);
+  return z;
+}
+
+static double hllTau(double x) {
+  if (x == 0. || x == 1.) return 0.;
+  double z_prime = 0;
+  double y = 1.0;
+  double z = 1 - x;
+  do {
+    x = sqrt(x);
+    z_prime = z;
+    y *= 0.5;
+    z -= pow(1 - x, 2) * y;
+  } while (z_prime != z);
+  return z / 3;
+}
+
+// The improved estimator of Otmar Ertl which is also used by Redis, see "New cardinality
+// estimation algorithms for HyperLogLog sketches"
+uint64_t HyperLogLog::Estimate(const uint8_t *registers) {
+  std::array<uint32_t, 64> histogram{};
+  for (uint32_t i = 0; i < kHyperLogLogRegisters; i++) {
+    histogram[std::min<uint32_t>(registers[i], kHyperLogLogQ + 1)]++;
+  }
+  double m = kHyperLogLogRegisters;
+  double z = m * hllTau((m - histogram[kHyperLogLogQ + 1]) / m);
+  for (uint32_t j = kHyperLogLogQ; j >= 1; j--) {
+    z += histogram[j];
+    z *= 0.5;
+  }
+  z += m * hllSigma(histogram[0] / m);
+  return static_cast<uint64_t>(llroundl(kHyperLogLogAlphaInf * m * m / z));
+}
+
+rocksdb::Status HyperLogLog::getRegisters(const Slice &ns_key, const HyperLogLogMetadata &metadata,
+                                          const rocksdb::Snapshot *snapshot, uint8_t *registers) {
+  if (metadata.size == 0) return rocksdb::Status::OK();
+
+  std::vector<std::string> segment_names;
+  segment_names.reserve(kHyperLogLogSegments);
+  for (uint32_t i = 0; i < kHyperLogLogSegments; i++) segment_names.emplace_back(std::to_string(i));
+  std::vector<Slice> sub_keys(segment_names.begin(), segment_names.end());
+  std::vector<rocksdb::PinnableSlice> values;
+  std::vector<rocksdb::Status> statuses;
+  multiGetSubKeys(ns_key, metadata.version, sub_keys, &values, &statuses, snapshot);
+  for (uint32_t i = 0; i < kHyperLogLogSegments; i++) {
+    if (statuses[i].IsNotFound()) continue;
+    if (!statuses[i].ok()) return statuses[i];
+    if (!DecodeSegment(values[i], registers + i * kHyperLogLogSegmentRegisters)) {
+      return rocksdb::Status::Corruption("invalid hyperloglog segment");
+    }
+  }
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status HyperLogLog::Add(const Slice &user_key, const std::vector<Slice> &elements, int *ret) {
+  *ret = 0;
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  HyperLogLogMetadata metadata;
+  rocksdb::Status s = GetMetadata(kRedisHyperLogLog, ns_key, &metadata);
+  if (!s.ok() && !s.IsNotFound()) return s;
+  bool created = s.IsNotFound();
+
+  // Only the segments of the registers of the elements are read and written
+  std::map<uint32_t, std::vector<std::pair<uint32_t, uint8_t>>> updates;
+  for (const auto &element : elements) {
+    uint32_t index = 0;
+    uint8_t count = RegisterOf(element, &index);
+    updates[index / kHyperLogLogSegmentRegisters].emplace_back(index % kHyperLogLogSegmentRegisters, count);
+  }
+
+  rocksdb::WriteBatch batch;
+  std::vector<std::string> log_args = {std::to_string(kRedisCmdPFAdd)};
+  for (const auto &element : elements) log_args.emplace_back(element.ToString());
+  WriteBatchLogData log_data(kRedisHyperLogLog, std::move(log_args));
+  batch.PutLogData(log_data.Encode());
+
+  std::array<uint8_t, kHyperLogLogSegmentRegisters> registers{};
+  bool changed = false;
+  for (const auto &[segment, segment_updates] : updates) {
+    std::string sub_key, value;
+    InternalKey(ns_key, std::to_string(segment), metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+    registers.fill(0);
+    bool exists = false;
+    if (!created) {
+      s = storage_->Get(rocksdb::ReadOptions(), sub_key, &value);
+      if (!s.ok() && !s.IsNotFound()) return s;
+      exists = s.ok();
+      if (exists && !DecodeSegment(value, registers.data())) {
+        return rocksdb::Status::Corruption("invalid hyperloglog segment");
+      }
+    }
+    bool segment_changed = false;
+    for (const auto &[offset, count] : segment_updates) {
+      if (count <= registers[offset]) continue;
+      registers[offset] = count;
+      segment_changed = true;
+    }
+    if (!segment_changed) continue;
+    batch.Put(sub_key, EncodeSegment(registers.data()));
+    if (!exists) metadata.size++;
+    changed = true;
+  }
+  if (!changed && !created) return rocksdb::Status::OK();
+
+  *ret = 1;
+  metadata.OnWrite();
+  std::string bytes;
+  metadata.Encode(&bytes);
+  batch.Put(metadata_cf_handle_, ns_key, bytes);
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+rocksdb::Status HyperLogLog::Count(const std::vector<Slice> &user_keys, bool cache_result, uint64_t *card) {
+  *card = 0;
+  LatestSnapShot ss(db_);
+  std::vector<std::string> ns_keys(user_keys.size());
+  std::vector<HyperLogLogMetadata> metadatas(user_keys.size(), HyperLogLogMetadata(false));
+  std::vector<bool> exists(user_keys.size(), false);
+  for (size_t i = 0; i < user_keys.size(); i++) {
+    AppendNamespacePrefix(user_keys[i], &ns_keys[i]);
+    auto s = GetMetadata(kRedisHyperLogLog, ns_keys[i], &metadatas[i], ss.GetSnapShot());
+    if (!s.ok() && !s.IsNotFound()) return s;
+    exists[i] = s.ok();
+  }
+
+  // The cached union is valid as long as neither the first key nor the other keys are written,
+  // the signature of the other keys is made of their names, versions and the number of writes
+  uint64_t union_signature = 0;
+  bool is_union = user_keys.size() > 1;
+  if (exists[0]) {
+    if (!is_union && metadatas[0].cached_card != kHyperLogLogNoCachedCard) {
+      *card = metadatas[0].cached_card;
+      return rocksdb::Status::OK();
+    }
+    if (is_union) {
+      std::vector<std::string> stamps;
+      for (size_t i = 1; i < user_keys.size(); i++) {
+        std::string stamp = ns_keys[i];
+        PutFixed64(&stamp, exists[i] ? metadatas[i].version : 0);
+        PutFixed64(&stamp, exists[i] ? metadatas[i].writes : 0);
+        stamps.emplace_back(std::move(stamp));
+      }
+      std::sort(stamps.begin(), stamps.end());
+      std::string signature_input;
+      for (const auto &stamp : stamps) {
+        PutFixed32(&signature_input, static_cast<uint32_t>(stamp.size()));
+        signature_input.append(stamp);
+      }
+      // Zero means there's no cached union
+      union_signature = std::max<uint64_t>(Util::MurmurHash64A(signature_input, kHyperLogLogHashSeed), 1);
+      if (metadatas[0].union_card != kHyperLogLogNoCachedCard && metadatas[0].union_signature == union_signature) {
+        *card = metadatas[0].union_card;
+        return rocksdb::Status::OK();
+      }
+    }
+  }
+
+  std::vector<uint8_t> registers(kHyperLogLogRegisters, 0);
+  std::vector<uint8_t> source_registers;
+  bool first = true;
+  for (size_t i = 0; i < user_keys.size(); i++) {
+    if (!exists[i]) continue;
+    if (first) {
+      auto s = getRegisters(ns_keys[i], metadatas[i], ss.GetSnapShot(), registers.data());
+      if (!s.ok()) return s;
+      first = false;
+      continue;
+    }
+    source_registers.assign(kHyperLogLogRegisters, 0);
+    auto s = getRegisters(ns_keys[i], metadatas[i], ss.GetSnapShot(), source_registers.data());
+    if (!s.ok()) return s;
+    MergeRegisters(registers.data(), source_registers.data(), kHyperLogLogRegisters);
+  }
+  *card = Estimate(registers.data());
+
+  if (!exists[0] || !cache_result) return rocksdb::Status::OK();
+  return cacheCount(ns_keys[0], metadatas[0], is_union, union_signature, *card);
+}
+
+rocksdb::Status HyperLogLog::cacheCount(const Slice &ns_key, const HyperLogLogMetadata &metadata, bool is_union,
+                                        uint64_t union_signature, uint64_t card) {
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  HyperLogLogMetadata latest_metadata(false);
+  auto s = GetMetadata(kRedisHyperLogLog, ns_key, &latest_metadata);
+  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+  // Don't cache the result if the key was written after it's counted
+  if (latest_metadata.version != metadata.version || latest_metadata.writes != metadata.writes) {
+    return rocksdb::Status::OK();
+  }
+  if (is_union) {
+    latest_metadata.union_signature = union_signature;
+    latest_metadata.union_card = card;
+  } else {
+    latest_metadata.cached_card = card;
+  }
+
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisHyperLogLog);
+  batch.PutLogData(log_data.Encode());
+  std::string bytes;
+  latest_metadata.Encode(&bytes);
+  batch.Put(metadata_cf_handle_, ns_key, bytes);
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+rocksdb::Status HyperLogLog::Merge(const Slice &dest_key, const std::vector<Slice> &source_keys) {
+  std::string ns_key;
+  AppendNamespacePrefix(dest_key, &ns_key);
+
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  LatestSnapShot ss(db_);
+  HyperLogLogMetadata metadata;
+  rocksdb::Status s = GetMetadata(kRedisHyperLogLog, ns_key, &metadata, ss.GetSnapShot());
+  if (!s.ok() && !s.IsNotFound()) return s;
+  bool created = s.IsNotFound();
+
+  std::vector<uint8_t> dest_registers(kHyperLogLogRegisters, 0);
+  if (!created) {
+    s = getRegisters(ns_key, metadata, ss.GetSnapShot(), dest_registers.data());
+    if (!s.ok()) return s;
+  }
+  std::vector<uint8_t> registers = dest_registers;
+  std::vector<uint8_t> source_registers;
+  std::string source_ns_key;
+  for (const auto &source_key : source_keys) {
+    AppendNamespacePrefix(source_key, &source_ns_key);
+    if (source_ns_key == ns_key) continue;
+    HyperLogLogMetadata source_metadata(false);
+    s = GetMetadata(kRedisHyperLogLog, source_ns_key, &source_metadata, ss.GetSnapShot());
+    if (s.IsNotFound()) continue;
+    if (!s.ok()) return s;
+    source_registers.assign(kHyperLogLogRegisters, 0);
+    s = getRegisters(source_ns_key, source_metadata, ss.GetSnapShot(), source_registers.data());
+    if (!s.ok()) return s;
+    MergeRegisters(registers.data(), source_registers.data(), kHyperLogLogRegisters);
+  }
+
+  rocksdb::WriteBatch batch;
+  std::vector<std::string> log_args = {std::to_string(kRedisCmdPFMerge)};
+  for (const auto &source_key : source_keys) log_args.emplace_back(source_key.ToString());
+  WriteBatchLogData log_data(kRedisHyperLogLog, std::move(log_args));
+  batch.PutLogData(log_data.Encode());
+
+  // Only the changed segments of the destination are written
+  bool changed = false;
+  for (uint32_t i = 0; i < kHyperLogLogSegments; i++) {
+    const uint8_t *segment = registers.data() + i * kHyperLogLogSegmentRegisters;
+    const uint8_t *dest_segment = dest_registers.data() + i * kHyperLogLogSegmentRegisters;
+    if (memcmp(segment, dest_segment, kHyperLogLogSegmentRegisters) == 0) continue;
+    if (std::all_of(dest_segment, dest_segment + kHyperLogLogSegmentRegisters, [](uint8_t r) { return r == 0; })) {
+      metadata.size++;
+    }
+    std::string sub_key;
+    InternalKey(ns_key, std::to_string(i), metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+    batch.Put(sub_key, EncodeSegment(segment));
+    changed = true;
+  }
+  if (!changed && !created) return rocksdb::Status::OK();
+
+  metadata.OnWrite();
+  std::string bytes;
+  metadata.Encode(&bytes);
+  batch.Put(metadata_cf_handle_, ns_key, bytes);
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+}  // namespace Redis
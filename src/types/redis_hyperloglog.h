@@ -0,0 +1,72 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "storage/redis_db.h"
+#include "storage/redis_metadata.h"
+
+// The HyperLogLog has 2^14 registers of 8 bits like Redis, they're split into the segments
+// of 1024 registers, each segment is a subkey whose name is its index.
+constexpr uint32_t kHyperLogLogRegisterBits = 14;
+constexpr uint32_t kHyperLogLogRegisters = 1 << kHyperLogLogRegisterBits;
+constexpr uint32_t kHyperLogLogSegmentRegisters = 1024;
+constexpr uint32_t kHyperLogLogSegments = kHyperLogLogRegisters / kHyperLogLogSegmentRegisters;
+// The segment is stored as the pairs of the register offset and value if it has at most
+// the number of non-zero registers, otherwise as the raw registers
+constexpr uint32_t kHyperLogLogSparseMaxRegisters = 256;
+
+// The encodings of the segments, the value of each segment starts with its encoding.
+// The segments whose registers are all zero aren't stored.
+enum HyperLogLogSegmentEncoding : uint8_t {
+  kHyperLogLogSegmentSparse = 1,  // the offset (2 bytes) and the value (1 byte) of each non-zero register
+  kHyperLogLogSegmentDense = 2,   // the raw registers
+};
+
+namespace Redis {
+
+class HyperLogLog : public Database {
+ public:
+  HyperLogLog(Engine::Storage *storage, const std::string &ns) : Database(storage, ns) {}
+  rocksdb::Status Add(const Slice &user_key, const std::vector<Slice> &elements, int *ret);
+  // Count the cardinality of the union of the keys, the result is cached in the metadata of
+  // the first key until its next write if cache_result is true
+  rocksdb::Status Count(const std::vector<Slice> &user_keys, bool cache_result, uint64_t *card);
+  rocksdb::Status Merge(const Slice &dest_key, const std::vector<Slice> &source_keys);
+
+  // Return the index of the register and the number of the leading zeros plus one of the element
+  static uint8_t RegisterOf(const Slice &element, uint32_t *index);
+  static std::string EncodeSegment(const uint8_t *registers);
+  static bool DecodeSegment(const Slice &value, uint8_t *registers);
+  static void MergeRegisters(uint8_t *dst, const uint8_t *src, size_t len);
+  static uint64_t Estimate(const uint8_t *registers);
+
+ private:
+  // Read all registers of the HyperLogLog into the registers, which should be zero initialized
+  rocksdb::Status getRegisters(const Slice &ns_key, const HyperLogLogMetadata &metadata,
+                               const rocksdb::Snapshot *snapshot, uint8_t *registers);
+  rocksdb::Status cacheCount(const Slice &ns_key, const HyperLogLogMetadata &metadata, bool is_union,
+                             uint64_t union_signature, uint64_t card);
+};
+
+}  // namespace Redis
@@ -20,7 +20,9 @@
 
 #include "redis_list.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <limits>
 #include <utility>
 
 #include "db_util.h"
@@ -67,21 +69,14 @@ rocksdb::Status List::push(const Slice &user_key, const std::vector<Slice> &elem
   if (!s.ok() && !(create_if_missing && s.IsNotFound())) {
     return s.IsNotFound() ? rocksdb::Status::OK() : s;
   }
-  uint64_t index = left ? metadata.head - 1 : metadata.tail;
+  if (s.IsNotFound()) metadata.chunked = storage_->GetConfig()->list_chunked_encoding;
   for (const auto &elem : elems) {
     std::string index_buf, sub_key;
-    PutFixed64(&index_buf, index);
+    PutFixed64(&index_buf, metadata.PushIndex(left));
     InternalKey(ns_key, index_buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
     batch.Put(sub_key, elem);
-    left ? --index : ++index;
-  }
-  if (left) {
-    metadata.head -= elems.size();
-  } else {
-    metadata.tail += elems.size();
   }
   std::string bytes;
-  metadata.size += elems.size();
   metadata.Encode(&bytes);
   batch.Put(metadata_cf_handle_, ns_key, bytes);
   *ret = metadata.size;
@@ -99,6 +94,30 @@ rocksdb::Status List::Pop(const Slice &user_key, bool left, std::string *elem) {
   return rocksdb::Status::OK();
 }
 
+// Pop the elements from the first non-empty list of the keys, which are all locked while
+// they're checked in order, so the pop is atomic across the keys.
+rocksdb::Status List::MPop(const std::vector<Slice> &user_keys, bool left, uint32_t count, std::string *popped_key,
+                           std::vector<std::string> *elems) {
+  elems->clear();
+
+  std::vector<std::string> ns_keys;
+  for (const auto &user_key : user_keys) {
+    std::string ns_key;
+    AppendNamespacePrefix(user_key, &ns_key);
+    ns_keys.emplace_back(std::move(ns_key));
+  }
+  ReentrantMultiLockGuard guard(storage_->GetLockManager(), ns_keys);
+  for (const auto &user_key : user_keys) {
+    auto s = PopMulti(user_key, left, count, elems);
+    if (s.IsNotFound()) continue;
+    if (!s.ok()) return s;
+
+    *popped_key = user_key.ToString();
+    return rocksdb::Status::OK();
+  }
+  return rocksdb::Status::NotFound();
+}
+
 rocksdb::Status List::PopMulti(const rocksdb::Slice &user_key, bool left, uint32_t count,
                                std::vector<std::string> *elems) {
   elems->clear();
@@ -116,26 +135,52 @@ rocksdb::Status List::PopMulti(const rocksdb::Slice &user_key, bool left, uint32
   WriteBatchLogData log_data(kRedisList, {std::to_string(cmd)});
   batch.PutLogData(log_data.Encode());
 
+  std::vector<uint64_t> indexes;
   while (metadata.size > 0 && count > 0) {
-    uint64_t index = left ? metadata.head : metadata.tail - 1;
-    std::string buf;
-    PutFixed64(&buf, index);
-    std::string sub_key;
-    InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-    std::string elem;
-    s = db_->Get(rocksdb::ReadOptions(), sub_key, &elem);
-    if (!s.ok()) {
-      // FIXME: should be always exists??
-      return s;
-    }
-
-    elems->push_back(elem);
-    batch.Delete(sub_key);
-    metadata.size -= 1;
-    left ? ++metadata.head : --metadata.tail;
+    indexes.emplace_back(metadata.PopIndex(left));
     --count;
   }
 
+  auto min_elements = static_cast<size_t>(storage_->GetConfig()->range_delete_min_elements);
+  if (min_elements > 0 && indexes.size() >= min_elements) {
+    // The popped elements are read by one scan over their indexes, which may cross the gaps of the chunks
+    auto [first, last] = std::minmax(indexes.front(), indexes.back());
+    std::string buf, start_key, end_key;
+    PutFixed64(&buf, first);
+    InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&start_key);
+    buf.clear();
+    PutFixed64(&buf, last);
+    InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&end_key);
+    end_key.push_back('\0');
+
+    rocksdb::ReadOptions read_options;
+    rocksdb::Slice upper_bound(end_key);
+    read_options.iterate_upper_bound = &upper_bound;
+    auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options));
+    for (iter->Seek(start_key); iter->Valid(); iter->Next()) {
+      elems->emplace_back(iter->value().ToString());
+    }
+    if (!iter->status().ok()) return iter->status();
+    if (elems->size() != indexes.size()) return rocksdb::Status::Corruption("the popped elements are missing");
+    if (!left) std::reverse(elems->begin(), elems->end());
+  } else {
+    for (uint64_t index : indexes) {
+      std::string buf;
+      PutFixed64(&buf, index);
+      std::string sub_key;
+      InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+      std::string elem;
+      s = storage_->Get(rocksdb::ReadOptions(), sub_key, &elem);
+      if (!s.ok()) {
+        // FIXME: should be always exists??
+        return s;
+      }
+      elems->push_back(elem);
+    }
+  }
+  s = deletePoppedElements(ns_key, metadata, indexes, &batch);
+  if (!s.ok()) return s;
+
   if (metadata.size == 0) {
     batch.Delete(metadata_cf_handle_, ns_key);
   } else {
@@ -195,7 +240,7 @@ rocksdb::Status List::Rem(const Slice &user_key, int count, const Slice &elem, i
   read_options.iterate_lower_bound = &lower_bound;
   read_options.fill_cache = false;
 
-  auto iter = DBUtil::UniqueIterator(db_, read_options);
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options));
   for (iter->Seek(start_key); iter->Valid() && iter->key().starts_with(prefix);
        !reversed ? iter->Next() : iter->Prev()) {
     if (iter->value() == elem) {
@@ -216,6 +261,12 @@ rocksdb::Status List::Rem(const Slice &user_key, int count, const Slice &elem, i
 
   if (to_delete_indexes.size() == metadata.size) {
     batch.Delete(metadata_cf_handle_, ns_key);
+  } else if (metadata.chunked) {
+    s = removeFromChunks(ns_key, to_delete_indexes, &metadata, &batch);
+    if (!s.ok()) return s;
+    std::string bytes;
+    metadata.Encode(&bytes);
+    batch.Put(metadata_cf_handle_, ns_key, bytes);
   } else {
     std::string to_update_key, to_delete_key;
     uint64_t min_to_delete_index = !reversed ? to_delete_indexes[0] : to_delete_indexes[to_delete_indexes.size() - 1];
@@ -284,7 +335,7 @@ rocksdb::Status List::Insert(const Slice &user_key, const Slice &pivot, const Sl
   read_options.iterate_upper_bound = &upper_bound;
   read_options.fill_cache = false;
 
-  auto iter = DBUtil::UniqueIterator(db_, read_options);
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options));
   for (iter->Seek(start_key); iter->Valid() && iter->key().starts_with(prefix); iter->Next()) {
     if (iter->value() == pivot) {
       InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
@@ -303,31 +354,36 @@ rocksdb::Status List::Insert(const Slice &user_key, const Slice &pivot, const Sl
                              {std::to_string(kRedisCmdLInsert), before ? "1" : "0", pivot.ToString(), elem.ToString()});
   batch.PutLogData(log_data.Encode());
 
-  std::string to_update_key;
-  uint64_t left_part_len = pivot_index - metadata.head + (before ? 0 : 1);
-  uint64_t right_part_len = metadata.tail - 1 - pivot_index + (before ? 1 : 0);
-  bool reversed = left_part_len <= right_part_len;
-  if ((reversed && !before) || (!reversed && before)) {
-    new_elem_index = pivot_index;
+  if (metadata.chunked) {
+    s = insertIntoChunk(ns_key, pivot_index + (before ? 0 : 1), elem, &metadata, &batch);
+    if (!s.ok()) return s;
   } else {
-    new_elem_index = reversed ? --pivot_index : ++pivot_index;
-    !reversed ? iter->Next() : iter->Prev();
-  }
-  for (; iter->Valid() && iter->key().starts_with(prefix); !reversed ? iter->Next() : iter->Prev()) {
+    std::string to_update_key;
+    uint64_t left_part_len = pivot_index - metadata.head + (before ? 0 : 1);
+    uint64_t right_part_len = metadata.tail - 1 - pivot_index + (before ? 1 : 0);
+    bool reversed = left_part_len <= right_part_len;
+    if ((reversed && !before) || (!reversed && before)) {
+      new_elem_index = pivot_index;
+    } else {
+      new_elem_index = reversed ? --pivot_index : ++pivot_index;
+      !reversed ? iter->Next() : iter->Prev();
+    }
+    for (; iter->Valid() && iter->key().starts_with(prefix); !reversed ? iter->Next() : iter->Prev()) {
+      buf.clear();
+      PutFixed64(&buf, reversed ? --pivot_index : ++pivot_index);
+      InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&to_update_key);
+      batch.Put(to_update_key, iter->value());
+    }
     buf.clear();
-    PutFixed64(&buf, reversed ? --pivot_index : ++pivot_index);
+    PutFixed64(&buf, new_elem_index);
     InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&to_update_key);
-    batch.Put(to_update_key, iter->value());
-  }
-  buf.clear();
-  PutFixed64(&buf, new_elem_index);
-  InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&to_update_key);
-  batch.Put(to_update_key, elem);
+    batch.Put(to_update_key, elem);
 
-  if (reversed) {
-    metadata.head--;
-  } else {
-    metadata.tail++;
+    if (reversed) {
+      metadata.head--;
+    } else {
+      metadata.tail++;
+    }
   }
   metadata.size++;
   std::string bytes;
@@ -351,13 +407,11 @@ rocksdb::Status List::Index(const Slice &user_key, int index, std::string *elem)
   if (index < 0 || index >= static_cast<int>(metadata.size)) return rocksdb::Status::NotFound();
 
   rocksdb::ReadOptions read_options;
-  LatestSnapShot ss(db_);
-  read_options.snapshot = ss.GetSnapShot();
   std::string buf;
-  PutFixed64(&buf, metadata.head + index);
+  PutFixed64(&buf, metadata.IndexOf(index));
   std::string sub_key;
   InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-  return db_->Get(read_options, sub_key, elem);
+  return storage_->Get(read_options, sub_key, elem);
 }
 
 // The offset can also be negative, -1 is the last element, -2 the penultimate
@@ -367,42 +421,59 @@ rocksdb::Status List::Index(const Slice &user_key, int index, std::string *elem)
 // Redis will treat it like the last element of the list.
 rocksdb::Status List::Range(const Slice &user_key, int start, int stop, std::vector<std::string> *elems) {
   elems->clear();
+  return Range(user_key, start, stop, std::numeric_limits<size_t>::max(),
+               [elems](uint64_t total, std::vector<std::string> *chunk) { *elems = std::move(*chunk); });
+}
 
+rocksdb::Status List::Range(const Slice &user_key, int start, int stop, size_t chunk_size,
+                            const ChunkCallback<std::string> &cb) {
   std::string ns_key;
   AppendNamespacePrefix(user_key, &ns_key);
+
+  // The metadata and elements should be read from the same snapshot,
+  // or the size might not match the elements which were fed in chunks.
+  LatestSnapShot ss(db_);
   ListMetadata metadata(false);
-  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  rocksdb::Status s = Database::GetMetadata(kRedisList, ns_key, &metadata, ss.GetSnapShot());
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
 
   if (start < 0) start = static_cast<int>(metadata.size) + start;
   if (stop < 0) stop = static_cast<int>(metadata.size) + stop;
   if (start > static_cast<int>(metadata.size) || stop < 0 || start > stop) return rocksdb::Status::OK();
   if (start < 0) start = 0;
+  if (stop >= static_cast<int>(metadata.size)) stop = static_cast<int>(metadata.size) - 1;
+  if (start > stop) return rocksdb::Status::OK();
+  uint64_t total = stop - start + 1;
 
   std::string buf;
-  PutFixed64(&buf, metadata.head + start);
+  PutFixed64(&buf, metadata.IndexOf(start));
   std::string start_key, prefix, next_version_prefix;
   InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&start_key);
   InternalKey(ns_key, "", metadata.version, storage_->IsSlotIdEncoded()).Encode(&prefix);
   InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix);
 
   rocksdb::ReadOptions read_options;
-  LatestSnapShot ss(db_);
+  storage_->SetLongScanReadOptions(&read_options);
   read_options.snapshot = ss.GetSnapShot();
   rocksdb::Slice upper_bound(next_version_prefix);
   read_options.iterate_upper_bound = &upper_bound;
   read_options.fill_cache = false;
 
-  auto iter = DBUtil::UniqueIterator(db_, read_options);
-  for (iter->Seek(start_key); iter->Valid() && iter->key().starts_with(prefix); iter->Next()) {
-    InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
-    Slice sub_key = ikey.GetSubKey();
-    uint64_t index = 0;
-    GetFixed64(&sub_key, &index);
-    // index should be always >= start
-    if (index > metadata.head + stop) break;
-    elems->push_back(iter->value().ToString());
+  std::vector<std::string> chunk;
+  chunk.reserve(std::min<uint64_t>(chunk_size, total));
+  // The elements are stored in the order of their indexes, and the chunked lists
+  // have the gaps between the chunks, so count the elements instead of the indexes
+  uint64_t count = 0;
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options));
+  for (iter->Seek(start_key); iter->Valid() && iter->key().starts_with(prefix) && count < total;
+       iter->Next(), count++) {
+    chunk.push_back(iter->value().ToString());
+    if (chunk.size() >= chunk_size) {
+      cb(total, &chunk);
+      chunk.clear();
+    }
   }
+  if (!chunk.empty()) cb(total, &chunk);
   return rocksdb::Status::OK();
 }
 
@@ -420,9 +491,9 @@ rocksdb::Status List::Set(const Slice &user_key, int index, Slice elem) {
   }
 
   std::string buf, value, sub_key;
-  PutFixed64(&buf, metadata.head + index);
+  PutFixed64(&buf, metadata.IndexOf(index));
   InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-  s = db_->Get(rocksdb::ReadOptions(), sub_key, &value);
+  s = storage_->Get(rocksdb::ReadOptions(), sub_key, &value);
   if (!s.ok()) {
     return s;
   }
@@ -474,12 +545,12 @@ rocksdb::Status List::lmoveOnSingleList(const rocksdb::Slice &src, bool src_left
 
   elem->clear();
 
-  uint64_t curr_index = src_left ? metadata.head : metadata.tail - 1;
+  uint64_t curr_index = metadata.IndexOf(src_left ? 0 : metadata.size - 1);
   std::string curr_index_buf;
   PutFixed64(&curr_index_buf, curr_index);
   std::string curr_sub_key;
   InternalKey(ns_key, curr_index_buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&curr_sub_key);
-  s = db_->Get(rocksdb::ReadOptions(), curr_sub_key, elem);
+  s = storage_->Get(rocksdb::ReadOptions(), curr_sub_key, elem);
   if (!s.ok()) {
     return s;
   }
@@ -500,15 +571,8 @@ rocksdb::Status List::lmoveOnSingleList(const rocksdb::Slice &src, bool src_left
 
   batch.Delete(curr_sub_key);
 
-  if (src_left) {
-    ++metadata.head;
-    ++metadata.tail;
-  } else {
-    --metadata.head;
-    --metadata.tail;
-  }
-
-  uint64_t new_index = src_left ? metadata.tail - 1 : metadata.head;
+  metadata.PopIndex(src_left);
+  uint64_t new_index = metadata.PushIndex(dst_left);
   std::string new_index_buf;
   PutFixed64(&new_index_buf, new_index);
   std::string new_sub_key;
@@ -542,6 +606,7 @@ rocksdb::Status List::lmoveOnTwoLists(const rocksdb::Slice &src, const rocksdb::
   if (!s.ok() && !s.IsNotFound()) {
     return s;
   }
+  if (s.IsNotFound()) dst_metadata.chunked = storage_->GetConfig()->list_chunked_encoding;
 
   elem->clear();
 
@@ -549,37 +614,33 @@ rocksdb::Status List::lmoveOnTwoLists(const rocksdb::Slice &src, const rocksdb::
   WriteBatchLogData log_data(kRedisList, {std::to_string(kRedisCmdLMove)});
   batch.PutLogData(log_data.Encode());
 
-  uint64_t src_index = src_left ? src_metadata.head : src_metadata.tail - 1;
+  uint64_t src_index = src_metadata.PopIndex(src_left);
   std::string src_buf;
   PutFixed64(&src_buf, src_index);
   std::string src_sub_key;
   InternalKey(src_ns_key, src_buf, src_metadata.version, storage_->IsSlotIdEncoded()).Encode(&src_sub_key);
-  s = db_->Get(rocksdb::ReadOptions(), src_sub_key, elem);
+  s = storage_->Get(rocksdb::ReadOptions(), src_sub_key, elem);
   if (!s.ok()) {
     return s;
   }
 
   batch.Delete(src_sub_key);
-  if (src_metadata.size == 1) {
+  if (src_metadata.size == 0) {
     batch.Delete(metadata_cf_handle_, src_ns_key);
   } else {
     std::string bytes;
-    src_metadata.size -= 1;
-    src_left ? ++src_metadata.head : --src_metadata.tail;
     src_metadata.Encode(&bytes);
     batch.Put(metadata_cf_handle_, src_ns_key, bytes);
   }
 
-  uint64_t dst_index = dst_left ? dst_metadata.head - 1 : dst_metadata.tail;
+  uint64_t dst_index = dst_metadata.PushIndex(dst_left);
   std::string dst_buf;
   PutFixed64(&dst_buf, dst_index);
   std::string dst_sub_key;
   InternalKey(dst_ns_key, dst_buf, dst_metadata.version, storage_->IsSlotIdEncoded()).Encode(&dst_sub_key);
   batch.Put(dst_sub_key, *elem);
-  dst_left ? --dst_metadata.head : ++dst_metadata.tail;
 
   std::string bytes;
-  dst_metadata.size += 1;
   dst_metadata.Encode(&bytes);
   batch.Put(metadata_cf_handle_, dst_ns_key, bytes);
 
@@ -610,35 +671,217 @@ rocksdb::Status List::Trim(const Slice &user_key, int start, int stop) {
   WriteBatchLogData log_data(kRedisList, std::vector<std::string>{std::to_string(kRedisCmdLTrim), std::to_string(start),
                                                                   std::to_string(stop)});
   batch.PutLogData(log_data.Encode());
-  uint64_t left_index = metadata.head + start;
-  uint64_t right_index = metadata.head + stop + 1;
-  for (uint64_t i = metadata.head; i < left_index; i++) {
-    std::string buf;
-    PutFixed64(&buf, i);
-    std::string sub_key;
-    InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-    batch.Delete(sub_key);
-    metadata.head++;
-    trim_cnt++;
-  }
-  auto tail = metadata.tail;
-  for (uint64_t i = right_index; i < tail; i++) {
-    std::string buf;
-    PutFixed64(&buf, i);
-    std::string sub_key;
-    InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-    batch.Delete(sub_key);
-    metadata.tail--;
-    trim_cnt++;
-  }
-  if (metadata.size >= trim_cnt) {
-    metadata.size -= trim_cnt;
-  } else {
-    metadata.size = 0;
+  uint32_t left_cnt = std::min(static_cast<uint32_t>(start), metadata.size);
+  uint32_t right_cnt = static_cast<uint32_t>(stop) + 1 < metadata.size ? metadata.size - stop - 1 : 0;
+  std::vector<uint64_t> left_indexes, right_indexes;
+  for (; trim_cnt < left_cnt + right_cnt && metadata.size > 0; trim_cnt++) {
+    bool left = trim_cnt < left_cnt;
+    (left ? left_indexes : right_indexes).emplace_back(metadata.PopIndex(left));
   }
+  s = deletePoppedElements(ns_key, metadata, left_indexes, &batch);
+  if (!s.ok()) return s;
+  s = deletePoppedElements(ns_key, metadata, right_indexes, &batch);
+  if (!s.ok()) return s;
   std::string bytes;
   metadata.Encode(&bytes);
   batch.Put(metadata_cf_handle_, ns_key, bytes);
   return storage_->Write(storage_->DefaultWriteOptions(), &batch);
 }
+
+rocksdb::Status List::readChunk(const Slice &ns_key, const ListMetadata &metadata, const ListChunk &chunk,
+                                std::vector<std::string> *elems) {
+  elems->clear();
+  std::string buf, start_key, end_key;
+  PutFixed64(&buf, chunk.base);
+  InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&start_key);
+  buf.clear();
+  PutFixed64(&buf, chunk.base + chunk.count);
+  InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&end_key);
+
+  rocksdb::ReadOptions read_options;
+  rocksdb::Slice upper_bound(end_key);
+  read_options.iterate_upper_bound = &upper_bound;
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options));
+  for (iter->Seek(start_key); iter->Valid(); iter->Next()) {
+    elems->emplace_back(iter->value().ToString());
+  }
+  if (!iter->status().ok()) return iter->status();
+  if (elems->size() != chunk.count) return rocksdb::Status::Corruption("the elements of the list chunk are missing");
+  return rocksdb::Status::OK();
+}
+
+void List::putElement(const Slice &ns_key, const ListMetadata &metadata, uint64_t index, const Slice &elem,
+                      rocksdb::WriteBatch *batch) {
+  std::string buf, sub_key;
+  PutFixed64(&buf, index);
+  InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+  batch->Put(sub_key, elem);
+}
+
+void List::deleteElement(const Slice &ns_key, const ListMetadata &metadata, uint64_t index,
+                         rocksdb::WriteBatch *batch) {
+  std::string buf, sub_key;
+  PutFixed64(&buf, index);
+  InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+  batch->Delete(sub_key);
+}
+
+rocksdb::Status List::deletePoppedElements(const Slice &ns_key, const ListMetadata &metadata,
+                                           const std::vector<uint64_t> &indexes, rocksdb::WriteBatch *batch) {
+  // The transaction can't serve the reads of the deleted range, so the elements are deleted one by one
+  auto min_elements = static_cast<size_t>(storage_->GetConfig()->range_delete_min_elements);
+  if (min_elements == 0 || indexes.size() < min_elements || storage_->InTxn()) {
+    for (uint64_t index : indexes) deleteElement(ns_key, metadata, index, batch);
+    return rocksdb::Status::OK();
+  }
+
+  // There're no elements in the gaps between the chunks, so the range only covers the popped ones
+  auto [first, last] = std::minmax(indexes.front(), indexes.back());
+  std::string buf, start_key, end_key;
+  PutFixed64(&buf, first);
+  InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&start_key);
+  buf.clear();
+  PutFixed64(&buf, last);
+  InternalKey(ns_key, buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&end_key);
+  return batch->DeleteRange(start_key, end_key + '\0');
+}
+
+// Insert the element at the index of its chunk, only the elements after it in the same chunk are
+// moved. The full chunk is split and its right half is moved into the gap before the next chunk.
+rocksdb::Status List::insertIntoChunk(const Slice &ns_key, uint64_t index, const Slice &elem, ListMetadata *metadata,
+                                      rocksdb::WriteBatch *batch) {
+  size_t i = metadata->ChunkOf(index);
+  ListChunk chunk = metadata->chunks[i];
+  std::vector<std::string> elems;
+  auto s = readChunk(ns_key, *metadata, chunk, &elems);
+  if (!s.ok()) return s;
+
+  uint64_t offset = index - chunk.base;
+  elems.insert(elems.begin() + static_cast<int64_t>(offset), elem.ToString());
+  if (elems.size() <= kListMaxChunkSize) {
+    for (uint64_t j = offset; j < elems.size(); j++) {
+      putElement(ns_key, *metadata, chunk.base + j, elems[j], batch);
+    }
+    metadata->chunks[i].count++;
+    metadata->UpdateHeadTail();
+    return rocksdb::Status::OK();
+  }
+
+  uint64_t limit = UINT64_MAX;
+  if (i + 1 < metadata->chunks.size()) {
+    limit = metadata->chunks[i + 1].base;
+  } else if (chunk.base < UINT64_MAX - 2 * kListChunkGap) {
+    limit = chunk.base + 2 * kListChunkGap;
+  }
+  uint64_t new_base = chunk.base + (limit - chunk.base) / 2;
+  if (new_base - chunk.base < kListMaxChunkSize || limit - new_base < kListMaxChunkSize) {
+    // The gap was used up by the splits, renumber the whole list
+    uint64_t pos = offset;
+    for (size_t j = 0; j < i; j++) pos += metadata->chunks[j].count;
+    return rebuildChunks(ns_key, pos, elem, metadata, batch);
+  }
+
+  auto half = static_cast<uint32_t>(elems.size() / 2);
+  for (uint64_t j = offset; j < half; j++) {
+    putElement(ns_key, *metadata, chunk.base + j, elems[j], batch);
+  }
+  for (uint64_t j = half; j < chunk.count; j++) {
+    deleteElement(ns_key, *metadata, chunk.base + j, batch);
+  }
+  for (uint64_t j = half; j < elems.size(); j++) {
+    putElement(ns_key, *metadata, new_base + j - half, elems[j], batch);
+  }
+  metadata->chunks[i].count = half;
+  metadata->chunks.insert(metadata->chunks.begin() + static_cast<int64_t>(i) + 1,
+                          ListChunk{new_base, static_cast<uint32_t>(elems.size()) - half});
+  metadata->UpdateHeadTail();
+  return rocksdb::Status::OK();
+}
+
+// Remove the elements at the indexes, and compact the remaining elements of the touched chunks
+rocksdb::Status List::removeFromChunks(const Slice &ns_key, const std::vector<uint64_t> &indexes,
+                                       ListMetadata *metadata, rocksdb::WriteBatch *batch) {
+  std::vector<uint64_t> sorted_indexes(indexes);
+  std::sort(sorted_indexes.begin(), sorted_indexes.end());
+
+  size_t k = 0;
+  std::vector<ListChunk> chunks;
+  std::vector<std::string> elems;
+  for (const auto &chunk : metadata->chunks) {
+    if (k >= sorted_indexes.size() || sorted_indexes[k] >= chunk.base + chunk.count) {
+      chunks.emplace_back(chunk);
+      continue;
+    }
+    auto s = readChunk(ns_key, *metadata, chunk, &elems);
+    if (!s.ok()) return s;
+
+    uint32_t kept = sorted_indexes[k] - chunk.base;
+    for (uint32_t j = kept; j < chunk.count; j++) {
+      if (k < sorted_indexes.size() && sorted_indexes[k] == chunk.base + j) {
+        k++;
+        continue;
+      }
+      putElement(ns_key, *metadata, chunk.base + kept++, elems[j], batch);
+    }
+    for (uint32_t j = kept; j < chunk.count; j++) {
+      deleteElement(ns_key, *metadata, chunk.base + j, batch);
+    }
+    if (kept > 0) chunks.emplace_back(ListChunk{chunk.base, kept});
+  }
+  metadata->chunks = std::move(chunks);
+  metadata->size -= sorted_indexes.size();
+  metadata->UpdateHeadTail();
+  return rocksdb::Status::OK();
+}
+
+// Rewrite the whole list with the element inserted at the position, the chunks are half full
+// and spread evenly around the middle of the index space.
+rocksdb::Status List::rebuildChunks(const Slice &ns_key, uint64_t pos, const Slice &elem, ListMetadata *metadata,
+                                    rocksdb::WriteBatch *batch) {
+  std::string prefix, next_version_prefix;
+  InternalKey(ns_key, "", metadata->version, storage_->IsSlotIdEncoded()).Encode(&prefix);
+  InternalKey(ns_key, "", metadata->version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix);
+
+  std::vector<std::string> elems;
+  elems.reserve(metadata->size + 1);
+  rocksdb::ReadOptions read_options;
+  rocksdb::Slice upper_bound(next_version_prefix);
+  read_options.iterate_upper_bound = &upper_bound;
+  read_options.fill_cache = false;
+  // The old elements are deleted one by one in the transaction, see deletePoppedElements
+  bool in_txn = storage_->InTxn();
+  std::vector<std::string> sub_keys;
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options));
+  for (iter->Seek(prefix); iter->Valid(); iter->Next()) {
+    elems.emplace_back(iter->value().ToString());
+    if (in_txn) sub_keys.emplace_back(iter->key().ToString());
+  }
+  if (!iter->status().ok()) return iter->status();
+  if (elems.size() != metadata->size) return rocksdb::Status::Corruption("the elements of the list are missing");
+  elems.insert(elems.begin() + static_cast<int64_t>(pos), elem.ToString());
+
+  // The elements would be put after the old ones were deleted in the same batch
+  for (const auto &sub_key : sub_keys) {
+    auto s = batch->Delete(sub_key);
+    if (!s.ok()) return s;
+  }
+  if (!in_txn) {
+    auto s = batch->DeleteRange(prefix, next_version_prefix);
+    if (!s.ok()) return s;
+  }
+  uint32_t chunk_size = kListMaxChunkSize / 2;
+  uint64_t num_chunks = (elems.size() + chunk_size - 1) / chunk_size;
+  uint64_t base = UINT64_MAX / 2 - num_chunks / 2 * kListChunkGap;
+  metadata->chunks.clear();
+  for (size_t j = 0; j < elems.size(); j++) {
+    if (j % chunk_size == 0) {
+      metadata->chunks.emplace_back(ListChunk{base, 0});
+      base += kListChunkGap;
+    }
+    auto &chunk = metadata->chunks.back();
+    putElement(ns_key, *metadata, chunk.base + chunk.count++, elems[j], batch);
+  }
+  metadata->UpdateHeadTail();
+  return rocksdb::Status::OK();
+}
 }  // namespace Redis
@@ -39,6 +39,8 @@ class List : public Database {
   rocksdb::Status Insert(const Slice &user_key, const Slice &pivot, const Slice &elem, bool before, int *ret);
   rocksdb::Status Pop(const Slice &user_key, bool left, std::string *elem);
   rocksdb::Status PopMulti(const Slice &user_key, bool left, uint32_t count, std::vector<std::string> *elems);
+  rocksdb::Status MPop(const std::vector<Slice> &user_keys, bool left, uint32_t count, std::string *popped_key,
+                       std::vector<std::string> *elems);
   rocksdb::Status Rem(const Slice &user_key, int count, const Slice &elem, int *ret);
   rocksdb::Status Index(const Slice &user_key, int index, std::string *elem);
   rocksdb::Status RPopLPush(const Slice &src, const Slice &dst, std::string *elem);
@@ -46,6 +48,8 @@ class List : public Database {
   rocksdb::Status Push(const Slice &user_key, const std::vector<Slice> &elems, bool left, int *ret);
   rocksdb::Status PushX(const Slice &user_key, const std::vector<Slice> &elems, bool left, int *ret);
   rocksdb::Status Range(const Slice &user_key, int start, int stop, std::vector<std::string> *elems);
+  rocksdb::Status Range(const Slice &user_key, int start, int stop, size_t chunk_size,
+                        const ChunkCallback<std::string> &cb);
 
  private:
   rocksdb::Status GetMetadata(const Slice &ns_key, ListMetadata *metadata);
@@ -53,5 +57,20 @@ class List : public Database {
                        int *ret);
   rocksdb::Status lmoveOnSingleList(const Slice &src, bool src_left, bool dst_left, std::string *elem);
   rocksdb::Status lmoveOnTwoLists(const Slice &src, const Slice &dst, bool src_left, bool dst_left, std::string *elem);
+  rocksdb::Status readChunk(const Slice &ns_key, const ListMetadata &metadata, const ListChunk &chunk,
+                            std::vector<std::string> *elems);
+  void putElement(const Slice &ns_key, const ListMetadata &metadata, uint64_t index, const Slice &elem,
+                  rocksdb::WriteBatch *batch);
+  void deleteElement(const Slice &ns_key, const ListMetadata &metadata, uint64_t index, rocksdb::WriteBatch *batch);
+  // Delete the elements which were popped from one side of the list, they're at the contiguous
+  // indexes, the large ones are deleted by one range deletion instead of the point tombstones
+  rocksdb::Status deletePoppedElements(const Slice &ns_key, const ListMetadata &metadata,
+                                       const std::vector<uint64_t> &indexes, rocksdb::WriteBatch *batch);
+  rocksdb::Status insertIntoChunk(const Slice &ns_key, uint64_t index, const Slice &elem, ListMetadata *metadata,
+                                  rocksdb::WriteBatch *batch);
+  rocksdb::Status removeFromChunks(const Slice &ns_key, const std::vector<uint64_t> &indexes, ListMetadata *metadata,
+                                   rocksdb::WriteBatch *batch);
+  rocksdb::Status rebuildChunks(const Slice &ns_key, uint64_t pos, const Slice &elem, ListMetadata *metadata,
+                                rocksdb::WriteBatch *batch);
 };
 }  // namespace Redis
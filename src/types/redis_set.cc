@@ -20,14 +20,65 @@
 
 #include "redis_set.h"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
+#include <set>
+#include <string_view>
 
 #include "db_util.h"
+#include "storage/inline_iterator.h"
 
 namespace Redis {
 
+// The cursor over the members of a set in the bytewise order. The set operations merge
+// the cursors and seek forward to the next candidate, instead of reading all the members.
+class SetMemberCursor {
+ public:
+  SetMemberCursor() = default;
+  SetMemberCursor(uint32_t size, std::string prefix, std::string upper_bound)
+      : size_(size), prefix_(std::move(prefix)), upper_bound_(std::move(upper_bound)) {}
+  SetMemberCursor(const SetMemberCursor &) = delete;
+  SetMemberCursor &operator=(const SetMemberCursor &) = delete;
+
+  void SetIterator(DBUtil::UniqueIterator iter) { iter_ = std::move(iter); }
+  const rocksdb::Slice *UpperBound() { return &upper_bound_slice_; }
+  uint32_t Size() const { return size_; }
+
+  bool Valid() const { return iter_ && !exhausted_ && iter_->Valid() && iter_->key().starts_with(prefix_); }
+  rocksdb::Slice Member() const {
+    rocksdb::Slice key = iter_->key();
+    key.remove_prefix(prefix_.size());
+    return key;
+  }
+  void SeekToFirst() {
+    if (!iter_) return;
+    iter_->Seek(prefix_);
+    exhausted_ = !Valid();
+  }
+  void Next() {
+    iter_->Next();
+    exhausted_ = !Valid();
+  }
+  // Move to the first member which is greater than or equal to the target, the cursor
+  // only moves forward so the seek is skipped if it's already there.
+  void Seek(const rocksdb::Slice &member) {
+    if (!iter_ || exhausted_ || (Valid() && Member().compare(member) >= 0)) return;
+    iter_->Seek(prefix_ + member.ToString());
+    exhausted_ = !Valid();
+  }
+
+ private:
+  uint32_t size_ = 0;
+  std::string prefix_;
+  std::string upper_bound_;
+  rocksdb::Slice upper_bound_slice_{upper_bound_};
+  DBUtil::UniqueIterator iter_{nullptr};
+  bool exhausted_ = false;
+};
+
 rocksdb::Status Set::GetMetadata(const Slice &ns_key, SetMetadata *metadata) {
   return Database::GetMetadata(kRedisSet, ns_key, metadata);
 }
@@ -39,18 +90,15 @@ rocksdb::Status Set::Overwrite(Slice user_key, const std::vector<std::string> &m
 
   LockGuard guard(storage_->GetLockManager(), ns_key);
   SetMetadata metadata;
+  metadata.inlined = storage_->GetConfig()->set_inline_max_entries > 0;
   rocksdb::WriteBatch batch;
   WriteBatchLogData log_data(kRedisSet);
   batch.PutLogData(log_data.Encode());
-  std::string sub_key;
   for (const auto &member : members) {
-    InternalKey(ns_key, member, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-    batch.Put(sub_key, Slice());
+    addMember(ns_key, &metadata, member, &batch);
   }
   metadata.size = static_cast<uint32_t>(members.size());
-  std::string bytes;
-  metadata.Encode(&bytes);
-  batch.Put(metadata_cf_handle_, ns_key, bytes);
+  putMetadata(ns_key, &metadata, &batch);
   return storage_->Write(storage_->DefaultWriteOptions(), &batch);
 }
 
@@ -64,26 +112,47 @@ rocksdb::Status Set::Add(const Slice &user_key, const std::vector<Slice> &member
   SetMetadata metadata;
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok() && !s.IsNotFound()) return s;
+  bool fresh = s.IsNotFound();
+
+  // The duplicated members are added once, and the existence of the members is checked by
+  // one batched MultiGet under the lock, rather than a Get per member
+  std::set<std::string_view> unique_members;
+  std::vector<Slice> new_members;
+  for (const auto &member : members) {
+    if (unique_members.emplace(member.data(), member.size()).second) new_members.emplace_back(member);
+  }
+  if (fresh) {
+    // The new key which would outgrow the inlined members is written as the subkeys at once
+    int max_entries = storage_->GetConfig()->set_inline_max_entries;
+    metadata.inlined = max_entries > 0 && new_members.size() <= static_cast<size_t>(max_entries);
+  }
+  std::vector<rocksdb::PinnableSlice> values;
+  std::vector<rocksdb::Status> statuses(new_members.size(), rocksdb::Status::NotFound());
+  if (metadata.size > 0 && !metadata.inlined) {
+    multiGetSubKeys(ns_key, metadata.version, new_members, &values, &statuses);
+  }
 
-  std::string value;
   rocksdb::WriteBatch batch;
   WriteBatchLogData log_data(kRedisSet);
   batch.PutLogData(log_data.Encode());
-  std::string sub_key;
-  for (const auto &member : members) {
-    InternalKey(ns_key, member, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-    s = db_->Get(rocksdb::ReadOptions(), sub_key, &value);
+  ChunkedBatchWriter chunk_writer(storage_, &batch, &log_data, metadata.version);
+  for (size_t i = 0; i < new_members.size(); i++) {
+    s = metadata.inlined ? getMember(ns_key, metadata, new_members[i]) : statuses[i];
     if (s.ok()) continue;
-    batch.Put(sub_key, Slice());
+    if (!s.IsNotFound()) return s;
+    addMember(ns_key, &metadata, new_members[i], &batch);
     *ret += 1;
+    // The members of the new key are invisible until its metadata is written by the last batch
+    if (fresh && !metadata.inlined) {
+      s = chunk_writer.WriteIfFull();
+      if (!s.ok()) return s;
+    }
   }
   if (*ret > 0) {
     metadata.size += *ret;
-    std::string bytes;
-    metadata.Encode(&bytes);
-    batch.Put(metadata_cf_handle_, ns_key, bytes);
+    putMetadata(ns_key, &metadata, &batch);
   }
-  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+  return chunk_writer.Write();
 }
 
 rocksdb::Status Set::Remove(const Slice &user_key, const std::vector<Slice> &members, int *ret) {
@@ -97,23 +166,19 @@ rocksdb::Status Set::Remove(const Slice &user_key, const std::vector<Slice> &mem
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
 
-  std::string value, sub_key;
   rocksdb::WriteBatch batch;
   WriteBatchLogData log_data(kRedisSet);
   batch.PutLogData(log_data.Encode());
   for (const auto &member : members) {
-    InternalKey(ns_key, member, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-    s = db_->Get(rocksdb::ReadOptions(), sub_key, &value);
+    s = getMember(ns_key, metadata, member);
     if (!s.ok()) continue;
-    batch.Delete(sub_key);
+    removeMember(ns_key, &metadata, member, &batch);
     *ret += 1;
   }
   if (*ret > 0) {
     if (static_cast<int>(metadata.size) != *ret) {
       metadata.size -= *ret;
-      std::string bytes;
-      metadata.Encode(&bytes);
-      batch.Put(metadata_cf_handle_, ns_key, bytes);
+      putMetadata(ns_key, &metadata, &batch);
     } else {
       batch.Delete(metadata_cf_handle_, ns_key);
     }
@@ -135,30 +200,56 @@ rocksdb::Status Set::Card(const Slice &user_key, int *ret) {
 
 rocksdb::Status Set::Members(const Slice &user_key, std::vector<std::string> *members) {
   members->clear();
+  return Members(user_key, std::numeric_limits<size_t>::max(),
+                 [members](uint64_t total, std::vector<std::string> *chunk) { *members = std::move(*chunk); });
+}
 
+rocksdb::Status Set::Members(const Slice &user_key, size_t chunk_size, const ChunkCallback<std::string> &cb) {
   std::string ns_key;
   AppendNamespacePrefix(user_key, &ns_key);
 
+  // The metadata and members should be read from the same snapshot,
+  // or the size might not match the members which were fed in chunks.
+  LatestSnapShot ss(db_);
   SetMetadata metadata(false);
-  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  rocksdb::Status s = Database::GetMetadata(kRedisSet, ns_key, &metadata, ss.GetSnapShot());
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
 
+  std::vector<std::string> chunk;
+  chunk.reserve(std::min<uint64_t>(chunk_size, metadata.size));
+  if (metadata.inlined) {
+    for (const auto &member : metadata.members) {
+      chunk.emplace_back(member);
+      if (chunk.size() >= chunk_size) {
+        cb(metadata.size, &chunk);
+        chunk.clear();
+      }
+    }
+    if (!chunk.empty()) cb(metadata.size, &chunk);
+    return rocksdb::Status::OK();
+  }
+
   std::string prefix, next_version_prefix;
   InternalKey(ns_key, "", metadata.version, storage_->IsSlotIdEncoded()).Encode(&prefix);
   InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix);
 
   rocksdb::ReadOptions read_options;
-  LatestSnapShot ss(db_);
+  storage_->SetLongScanReadOptions(&read_options);
   read_options.snapshot = ss.GetSnapShot();
   rocksdb::Slice upper_bound(next_version_prefix);
   read_options.iterate_upper_bound = &upper_bound;
   read_options.fill_cache = false;
 
-  auto iter = DBUtil::UniqueIterator(db_, read_options);
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options));
   for (iter->Seek(prefix); iter->Valid() && iter->key().starts_with(prefix); iter->Next()) {
     InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
-    members->emplace_back(ikey.GetSubKey().ToString());
+    chunk.emplace_back(ikey.GetSubKey().ToString());
+    if (chunk.size() >= chunk_size) {
+      cb(metadata.size, &chunk);
+      chunk.clear();
+    }
   }
+  if (!chunk.empty()) cb(metadata.size, &chunk);
   return rocksdb::Status::OK();
 }
 
@@ -179,16 +270,19 @@ rocksdb::Status Set::MIsMember(const Slice &user_key, const std::vector<Slice> &
   SetMetadata metadata(false);
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok()) return s;
+  if (metadata.inlined) {
+    for (const auto &member : members) {
+      exists->emplace_back(metadata.members.count(member.ToString()) > 0 ? 1 : 0);
+    }
+    return rocksdb::Status::OK();
+  }
 
-  rocksdb::ReadOptions read_options;
-  LatestSnapShot ss(db_);
-  read_options.snapshot = ss.GetSnapShot();
-  std::string sub_key, value;
-  for (const auto &member : members) {
-    InternalKey(ns_key, member, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-    s = db_->Get(read_options, sub_key, &value);
-    if (!s.ok() && !s.IsNotFound()) return s;
-    if (s.IsNotFound()) {
+  std::vector<rocksdb::PinnableSlice> values;
+  std::vector<rocksdb::Status> statuses;
+  multiGetSubKeys(ns_key, metadata.version, members, &values, &statuses);
+  for (const auto &status : statuses) {
+    if (!status.ok() && !status.IsNotFound()) return status;
+    if (status.IsNotFound()) {
       exists->emplace_back(0);
     } else {
       exists->emplace_back(1);
@@ -198,9 +292,11 @@ rocksdb::Status Set::MIsMember(const Slice &user_key, const std::vector<Slice> &
 }
 
 rocksdb::Status Set::Take(const Slice &user_key, std::vector<std::string> *members, int count, bool pop) {
-  int n = 0;
   members->clear();
-  if (count <= 0) return rocksdb::Status::OK();
+  // The negative count of SRANDMEMBER allows the same member to be returned multiple times
+  bool allow_duplicates = !pop && count < 0;
+  uint64_t n = allow_duplicates ? -static_cast<int64_t>(count) : count;
+  if (count == 0 || (pop && count < 0)) return rocksdb::Status::OK();
 
   std::string ns_key;
   AppendNamespacePrefix(user_key, &ns_key);
@@ -216,30 +312,30 @@ rocksdb::Status Set::Take(const Slice &user_key, std::vector<std::string> *membe
   WriteBatchLogData log_data(kRedisSet);
   batch.PutLogData(log_data.Encode());
 
-  std::string prefix, next_version_prefix;
-  InternalKey(ns_key, "", metadata.version, storage_->IsSlotIdEncoded()).Encode(&prefix);
-  InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix);
-
-  rocksdb::ReadOptions read_options;
-  LatestSnapShot ss(db_);
-  read_options.snapshot = ss.GetSnapShot();
-  rocksdb::Slice upper_bound(next_version_prefix);
-  read_options.iterate_upper_bound = &upper_bound;
-  read_options.fill_cache = false;
-
-  auto iter = DBUtil::UniqueIterator(db_, read_options);
-  for (iter->Seek(prefix); iter->Valid() && iter->key().starts_with(prefix); iter->Next()) {
-    InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
-    members->emplace_back(ikey.GetSubKey().ToString());
-    if (pop) batch.Delete(iter->key());
-    if (++n >= count) break;
+  if (metadata.inlined) {
+    std::vector<std::set<std::string>::iterator> elems;
+    for (auto iter = metadata.members.begin(); iter != metadata.members.end(); ++iter) elems.emplace_back(iter);
+    for (size_t pos : SampleInlinedPositions(elems.size(), n, allow_duplicates)) {
+      members->emplace_back(*elems[pos]);
+    }
+    if (!pop) return rocksdb::Status::OK();
+    for (const auto &member : *members) metadata.members.erase(member);
+    metadata.size -= members->size();
+    putMetadata(ns_key, &metadata, &batch);
+    return storage_->Write(storage_->DefaultWriteOptions(), &batch);
   }
-  if (pop && n > 0) {
-    metadata.size -= n;
-    std::string bytes;
-    metadata.Encode(&bytes);
-    batch.Put(metadata_cf_handle_, ns_key, bytes);
+
+  s = Sample(ns_key, metadata, n, allow_duplicates, members);
+  if (!s.ok() || !pop || members->empty()) return s;
+  for (const auto &member : *members) {
+    std::string sub_key;
+    InternalKey(ns_key, member, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+    batch.Delete(sub_key);
   }
+  metadata.size -= members->size();
+  std::string bytes;
+  metadata.Encode(&bytes);
+  batch.Put(metadata_cf_handle_, ns_key, bytes);
   return storage_->Write(storage_->DefaultWriteOptions(), &batch);
 }
 
@@ -261,7 +357,22 @@ rocksdb::Status Set::Move(const Slice &src, const Slice &dst, const Slice &membe
 
 rocksdb::Status Set::Scan(const Slice &user_key, const std::string &cursor, uint64_t limit,
                           const std::string &member_prefix, std::vector<std::string> *members) {
-  return SubKeyScanner::Scan(kRedisSet, user_key, cursor, limit, member_prefix, members);
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+  SetMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+  if (!metadata.inlined) {
+    return SubKeyScanner::Scan(kRedisSet, user_key, cursor, limit, member_prefix, members);
+  }
+
+  // Follow the order and the cursor semantics of scanning the subkeys
+  auto iter = cursor.empty() ? metadata.members.lower_bound(member_prefix) : metadata.members.upper_bound(cursor);
+  for (; iter != metadata.members.end() && Slice(*iter).starts_with(member_prefix); ++iter) {
+    members->emplace_back(*iter);
+    if (limit > 0 && members->size() >= limit) break;
+  }
+  return rocksdb::Status::OK();
 }
 
 /*
@@ -274,23 +385,21 @@ rocksdb::Status Set::Scan(const Slice &user_key, const std::string &cursor, uint
  */
 rocksdb::Status Set::Diff(const std::vector<Slice> &keys, std::vector<std::string> *members) {
   members->clear();
-  std::vector<std::string> source_members;
-  auto s = Members(keys[0], &source_members);
+
+  LatestSnapShot ss(db_);
+  std::vector<std::unique_ptr<SetMemberCursor>> cursors;
+  auto s = openCursors(keys, ss.GetSnapShot(), &cursors);
   if (!s.ok()) return s;
 
-  std::map<std::string, bool> exclude_members;
-  std::vector<std::string> target_members;
-  for (size_t i = 1; i < keys.size(); i++) {
-    s = Members(keys[i], &target_members);
-    if (!s.ok()) return s;
-    for (const auto &member : target_members) {
-      exclude_members[member] = true;
-    }
-  }
-  for (const auto &member : source_members) {
-    if (exclude_members.find(member) == exclude_members.end()) {
-      members->push_back(member);
+  auto &source = cursors[0];
+  for (source->SeekToFirst(); source->Valid(); source->Next()) {
+    Slice member = source->Member();
+    bool excluded = false;
+    for (size_t i = 1; i < cursors.size() && !excluded; i++) {
+      cursors[i]->Seek(member);
+      excluded = cursors[i]->Valid() && cursors[i]->Member() == member;
     }
+    if (!excluded) members->emplace_back(member.ToString());
   }
   return rocksdb::Status::OK();
 }
@@ -306,17 +415,28 @@ rocksdb::Status Set::Diff(const std::vector<Slice> &keys, std::vector<std::strin
 rocksdb::Status Set::Union(const std::vector<Slice> &keys, std::vector<std::string> *members) {
   members->clear();
 
-  std::map<std::string, bool> union_members;
-  std::vector<std::string> target_members;
-  for (const auto &key : keys) {
-    auto s = Members(key, &target_members);
-    if (!s.ok()) return s;
-    for (const auto &member : target_members) {
-      union_members[member] = true;
-    }
+  LatestSnapShot ss(db_);
+  std::vector<std::unique_ptr<SetMemberCursor>> cursors;
+  auto s = openCursors(keys, ss.GetSnapShot(), &cursors);
+  if (!s.ok()) return s;
+
+  for (auto &cursor : cursors) {
+    cursor->SeekToFirst();
   }
-  for (const auto &iter : union_members) {
-    members->emplace_back(iter.first);
+  while (true) {
+    SetMemberCursor *min_cursor = nullptr;
+    for (auto &cursor : cursors) {
+      if (cursor->Valid() && (!min_cursor || cursor->Member().compare(min_cursor->Member()) < 0)) {
+        min_cursor = cursor.get();
+      }
+    }
+    if (!min_cursor) break;
+
+    std::string member = min_cursor->Member().ToString();
+    for (auto &cursor : cursors) {
+      if (cursor->Valid() && cursor->Member() == member) cursor->Next();
+    }
+    members->emplace_back(std::move(member));
   }
   return rocksdb::Status::OK();
 }
@@ -331,32 +451,55 @@ rocksdb::Status Set::Union(const std::vector<Slice> &keys, std::vector<std::stri
  */
 rocksdb::Status Set::Inter(const std::vector<Slice> &keys, std::vector<std::string> *members) {
   members->clear();
+  uint64_t count = 0;
+  return inter(keys, 0, members, &count);
+}
 
-  std::map<std::string, size_t> member_counters;
-  std::vector<std::string> target_members;
-  auto s = Members(keys[0], &target_members);
-  if (!s.ok() || target_members.empty()) return s;
-  for (const auto &member : target_members) {
-    member_counters[member] = 1;
-  }
-  for (size_t i = 1; i < keys.size(); i++) {
-    auto s = Members(keys[i], &target_members);
-    if (!s.ok() || target_members.empty()) return s;
-    for (const auto &member : target_members) {
-      if (member_counters.find(member) == member_counters.end()) continue;
-      member_counters[member]++;
-    }
-  }
-  for (const auto &iter : member_counters) {
-    if (iter.second == keys.size()) {  // all the sets contain this member
-      members->emplace_back(iter.first);
+// Returns the cardinality of the intersection, stop counting once it reaches the limit if it's not 0
+rocksdb::Status Set::InterCard(const std::vector<Slice> &keys, uint64_t limit, uint64_t *ret) {
+  *ret = 0;
+  return inter(keys, limit, nullptr, ret);
+}
+
+rocksdb::Status Set::inter(const std::vector<Slice> &keys, uint64_t limit, std::vector<std::string> *members,
+                           uint64_t *count) {
+  LatestSnapShot ss(db_);
+  std::vector<std::unique_ptr<SetMemberCursor>> cursors;
+  auto s = openCursors(keys, ss.GetSnapShot(), &cursors);
+  if (!s.ok()) return s;
+
+  // Drive from the smallest set, so the larger sets are only sought to its members
+  std::sort(cursors.begin(), cursors.end(), [](const auto &a, const auto &b) { return a->Size() < b->Size(); });
+  auto &driver = cursors[0];
+  if (driver->Size() == 0) return rocksdb::Status::OK();
+
+  driver->SeekToFirst();
+  while (driver->Valid()) {
+    std::string candidate = driver->Member().ToString();
+    bool matched = true;
+    for (size_t i = 1; i < cursors.size(); i++) {
+      cursors[i]->Seek(candidate);
+      if (!cursors[i]->Valid()) return rocksdb::Status::OK();
+      if (cursors[i]->Member() != candidate) {
+        // None of the members before the next member of this set could be in the intersection
+        driver->Seek(cursors[i]->Member());
+        matched = false;
+        break;
+      }
     }
+    if (!matched) continue;
+
+    if (members) members->emplace_back(std::move(candidate));
+    (*count)++;
+    if (limit > 0 && *count >= limit) break;
+    driver->Next();
   }
   return rocksdb::Status::OK();
 }
 
 rocksdb::Status Set::DiffStore(const Slice &dst, const std::vector<Slice> &keys, int *ret) {
   *ret = 0;
+  auto guard = lockStoreKeys(dst, keys);
   std::vector<std::string> members;
   auto s = Diff(keys, &members);
   if (!s.ok()) return s;
@@ -366,6 +509,7 @@ rocksdb::Status Set::DiffStore(const Slice &dst, const std::vector<Slice> &keys,
 
 rocksdb::Status Set::UnionStore(const Slice &dst, const std::vector<Slice> &keys, int *ret) {
   *ret = 0;
+  auto guard = lockStoreKeys(dst, keys);
   std::vector<std::string> members;
   auto s = Union(keys, &members);
   if (!s.ok()) return s;
@@ -375,10 +519,103 @@ rocksdb::Status Set::UnionStore(const Slice &dst, const std::vector<Slice> &keys
 
 rocksdb::Status Set::InterStore(const Slice &dst, const std::vector<Slice> &keys, int *ret) {
   *ret = 0;
+  auto guard = lockStoreKeys(dst, keys);
   std::vector<std::string> members;
   auto s = Inter(keys, &members);
   if (!s.ok()) return s;
   *ret = static_cast<int>(members.size());
   return Overwrite(dst, members);
 }
+
+rocksdb::Status Set::getMember(const Slice &ns_key, const SetMetadata &metadata, const Slice &member) {
+  if (metadata.inlined) {
+    return metadata.members.count(member.ToString()) > 0 ? rocksdb::Status::OK() : rocksdb::Status::NotFound();
+  }
+  std::string sub_key, value;
+  InternalKey(ns_key, member, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+  return storage_->Get(rocksdb::ReadOptions(), sub_key, &value);
+}
+
+void Set::addMember(const Slice &ns_key, SetMetadata *metadata, const Slice &member, rocksdb::WriteBatch *batch) {
+  if (metadata->inlined) {
+    metadata->members.emplace(member.ToString());
+    return;
+  }
+  std::string sub_key;
+  InternalKey(ns_key, member, metadata->version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+  batch->Put(sub_key, Slice());
+}
+
+void Set::removeMember(const Slice &ns_key, SetMetadata *metadata, const Slice &member,
+                       rocksdb::WriteBatch *batch) {
+  if (metadata->inlined) {
+    metadata->members.erase(member.ToString());
+    return;
+  }
+  std::string sub_key;
+  InternalKey(ns_key, member, metadata->version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+  batch->Delete(sub_key);
+}
+
+// Put the metadata into the batch, the inline set which grows beyond the limits
+// is converted to the subkeys with its current version.
+void Set::putMetadata(const Slice &ns_key, SetMetadata *metadata, rocksdb::WriteBatch *batch) {
+  auto config = storage_->GetConfig();
+  if (metadata->inlined && (metadata->members.size() > static_cast<size_t>(config->set_inline_max_entries) ||
+                            metadata->InlineBytes() > static_cast<size_t>(config->set_inline_max_bytes))) {
+    SubKeyEncoder encoder(ns_key, metadata->version, storage_->IsSlotIdEncoded());
+    for (const auto &member : metadata->members) {
+      batch->Put(encoder.Encode(member), Slice());
+    }
+    metadata->inlined = false;
+    metadata->members.clear();
+  }
+  std::string bytes;
+  metadata->Encode(&bytes);
+  batch->Put(metadata_cf_handle_, ns_key, bytes);
+}
+
+DBUtil::UniqueIterator Set::newIterator(const Slice &ns_key, const SetMetadata &metadata,
+                                        const rocksdb::ReadOptions &read_options) {
+  if (!metadata.inlined) return DBUtil::UniqueIterator(storage_->NewIterator(read_options));
+
+  std::vector<InlineIterator::Entry> entries;
+  entries.reserve(metadata.members.size());
+  SubKeyEncoder encoder(ns_key, metadata.version, storage_->IsSlotIdEncoded());
+  for (const auto &member : metadata.members) {
+    entries.emplace_back(encoder.Encode(member).ToString(), std::string());
+  }
+  return DBUtil::UniqueIterator(new InlineIterator(std::move(entries)));
+}
+
+// Open the cursors of the given sets from the same snapshot, the cursor of
+// the set which doesn't exist is empty.
+rocksdb::Status Set::openCursors(const std::vector<Slice> &keys, const rocksdb::Snapshot *snapshot,
+                                 std::vector<std::unique_ptr<SetMemberCursor>> *cursors) {
+  cursors->clear();
+  for (const auto &key : keys) {
+    std::string ns_key;
+    AppendNamespacePrefix(key, &ns_key);
+    SetMetadata metadata(false);
+    rocksdb::Status s = Database::GetMetadata(kRedisSet, ns_key, &metadata, snapshot);
+    if (!s.ok() && !s.IsNotFound()) return s;
+    if (s.IsNotFound()) {
+      cursors->emplace_back(std::make_unique<SetMemberCursor>());
+      continue;
+    }
+
+    std::string prefix, next_version_prefix;
+    InternalKey(ns_key, "", metadata.version, storage_->IsSlotIdEncoded()).Encode(&prefix);
+    InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix);
+    auto cursor = std::make_unique<SetMemberCursor>(metadata.size, std::move(prefix), std::move(next_version_prefix));
+
+    rocksdb::ReadOptions read_options;
+    read_options.snapshot = snapshot;
+    read_options.iterate_upper_bound = cursor->UpperBound();
+    read_options.fill_cache = false;
+    cursor->SetIterator(newIterator(ns_key, metadata, read_options));
+    cursors->emplace_back(std::move(cursor));
+  }
+  return rocksdb::Status::OK();
+}
 }  // namespace Redis
@@ -20,14 +20,18 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "db_util.h"
 #include "storage/redis_db.h"
 #include "storage/redis_metadata.h"
 
 namespace Redis {
 
+class SetMemberCursor;
+
 class Set : public SubKeyScanner {
  public:
   explicit Set(Engine::Storage *storage, const std::string &ns) : SubKeyScanner(storage, ns) {}
@@ -38,11 +42,14 @@ class Set : public SubKeyScanner {
   rocksdb::Status Add(const Slice &user_key, const std::vector<Slice> &members, int *ret);
   rocksdb::Status Remove(const Slice &user_key, const std::vector<Slice> &members, int *ret);
   rocksdb::Status Members(const Slice &user_key, std::vector<std::string> *members);
+  rocksdb::Status Members(const Slice &user_key, size_t chunk_size, const ChunkCallback<std::string> &cb);
   rocksdb::Status Move(const Slice &src, const Slice &dst, const Slice &member, int *ret);
+  // Take count random members, the negative count of the non-popping take allows the duplicated members
   rocksdb::Status Take(const Slice &user_key, std::vector<std::string> *members, int count, bool pop);
   rocksdb::Status Diff(const std::vector<Slice> &keys, std::vector<std::string> *members);
   rocksdb::Status Union(const std::vector<Slice> &keys, std::vector<std::string> *members);
   rocksdb::Status Inter(const std::vector<Slice> &keys, std::vector<std::string> *members);
+  rocksdb::Status InterCard(const std::vector<Slice> &keys, uint64_t limit, uint64_t *ret);
   rocksdb::Status Overwrite(Slice user_key, const std::vector<std::string> &members);
   rocksdb::Status DiffStore(const Slice &dst, const std::vector<Slice> &keys, int *ret);
   rocksdb::Status UnionStore(const Slice &dst, const std::vector<Slice> &keys, int *ret);
@@ -52,6 +59,16 @@ class Set : public SubKeyScanner {
 
  private:
   rocksdb::Status GetMetadata(const Slice &ns_key, SetMetadata *metadata);
+  rocksdb::Status getMember(const Slice &ns_key, const SetMetadata &metadata, const Slice &member);
+  void addMember(const Slice &ns_key, SetMetadata *metadata, const Slice &member, rocksdb::WriteBatch *batch);
+  void removeMember(const Slice &ns_key, SetMetadata *metadata, const Slice &member, rocksdb::WriteBatch *batch);
+  void putMetadata(const Slice &ns_key, SetMetadata *metadata, rocksdb::WriteBatch *batch);
+  DBUtil::UniqueIterator newIterator(const Slice &ns_key, const SetMetadata &metadata,
+                                     const rocksdb::ReadOptions &read_options);
+  rocksdb::Status openCursors(const std::vector<Slice> &keys, const rocksdb::Snapshot *snapshot,
+                              std::vector<std::unique_ptr<SetMemberCursor>> *cursors);
+  rocksdb::Status inter(const std::vector<Slice> &keys, uint64_t limit, std::vector<std::string> *members,
+                        uint64_t *count);
 };
 
 }  // namespace Redis
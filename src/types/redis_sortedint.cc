@@ -20,7 +20,9 @@
 
 #include "redis_sortedint.h"
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <limits>
 #include <map>
 
@@ -44,6 +46,19 @@ rocksdb::Status Sortedint::Add(const Slice &user_key, const std::vector<uint64_t
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok() && !s.IsNotFound()) return s;
 
+  // The encoding of the ids is decided when the sortedint is created
+  if (s.IsNotFound()) metadata.blocks = storage_->GetConfig()->sortedint_block_encoding;
+  if (metadata.blocks) {
+    rocksdb::WriteBatch batch;
+    s = updateBlocks(ns_key, metadata, ids, false, &batch, ret);
+    if (!s.ok() || *ret == 0) return s;
+    metadata.size += *ret;
+    std::string bytes;
+    metadata.Encode(&bytes);
+    batch.Put(metadata_cf_handle_, ns_key, bytes);
+    return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+  }
+
   std::string value;
   rocksdb::WriteBatch batch;
   WriteBatchLogData log_data(kRedisSortedint);
@@ -53,7 +68,7 @@ rocksdb::Status Sortedint::Add(const Slice &user_key, const std::vector<uint64_t
     std::string id_buf;
     PutFixed64(&id_buf, id);
     InternalKey(ns_key, id_buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-    s = db_->Get(rocksdb::ReadOptions(), sub_key, &value);
+    s = storage_->Get(rocksdb::ReadOptions(), sub_key, &value);
     if (s.ok()) continue;
     batch.Put(sub_key, Slice());
     *ret += 1;
@@ -78,6 +93,17 @@ rocksdb::Status Sortedint::Remove(const Slice &user_key, const std::vector<uint6
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
 
+  if (metadata.blocks) {
+    rocksdb::WriteBatch batch;
+    s = updateBlocks(ns_key, metadata, ids, true, &batch, ret);
+    if (!s.ok() || *ret == 0) return s;
+    metadata.size -= *ret;
+    std::string bytes;
+    metadata.Encode(&bytes);
+    batch.Put(metadata_cf_handle_, ns_key, bytes);
+    return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+  }
+
   std::string value, sub_key;
   rocksdb::WriteBatch batch;
   WriteBatchLogData log_data(kRedisSortedint);
@@ -86,7 +112,7 @@ rocksdb::Status Sortedint::Remove(const Slice &user_key, const std::vector<uint6
     std::string id_buf;
     PutFixed64(&id_buf, id);
     InternalKey(ns_key, id_buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-    s = db_->Get(rocksdb::ReadOptions(), sub_key, &value);
+    s = storage_->Get(rocksdb::ReadOptions(), sub_key, &value);
     if (!s.ok()) continue;
     batch.Delete(sub_key);
     *ret += 1;
@@ -122,37 +148,16 @@ rocksdb::Status Sortedint::Range(const Slice &user_key, uint64_t cursor_id, uint
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
 
-  std::string prefix, next_version_prefix, start_key, start_buf;
   uint64_t start_id = cursor_id;
   if (reversed && cursor_id == 0) {
     start_id = std::numeric_limits<uint64_t>::max();
   }
-  PutFixed64(&start_buf, start_id);
-  InternalKey(ns_key, start_buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&start_key);
-  InternalKey(ns_key, "", metadata.version, storage_->IsSlotIdEncoded()).Encode(&prefix);
-  InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix);
-
-  rocksdb::ReadOptions read_options;
-  LatestSnapShot ss(db_);
-  read_options.snapshot = ss.GetSnapShot();
-  rocksdb::Slice upper_bound(next_version_prefix);
-  read_options.iterate_upper_bound = &upper_bound;
-  rocksdb::Slice lower_bound(prefix);
-  read_options.iterate_lower_bound = &lower_bound;
-  read_options.fill_cache = false;
-
-  uint64_t id = 0, pos = 0;
-  auto iter = DBUtil::UniqueIterator(db_, read_options);
-  for (!reversed ? iter->Seek(start_key) : iter->SeekForPrev(start_key);
-       iter->Valid() && iter->key().starts_with(prefix); !reversed ? iter->Next() : iter->Prev()) {
-    InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
-    Slice sub_key = ikey.GetSubKey();
-    GetFixed64(&sub_key, &id);
-    if (id == cursor_id || pos++ < offset) continue;
+  uint64_t pos = 0;
+  return walk(ns_key, metadata, start_id, reversed, [&](uint64_t id) {
+    if (id == cursor_id || pos++ < offset) return true;
     ids->emplace_back(id);
-    if (limit > 0 && ids->size() >= limit) break;
-  }
-  return rocksdb::Status::OK();
+    return limit == 0 || ids->size() < limit;
+  });
 }
 
 rocksdb::Status Sortedint::RangeByValue(const Slice &user_key, SortedintRangeSpec spec, std::vector<uint64_t> *ids,
@@ -167,47 +172,20 @@ rocksdb::Status Sortedint::RangeByValue(const Slice &user_key, SortedintRangeSpe
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
 
-  std::string start_buf, start_key, prefix_key, next_version_prefix_key;
-  PutFixed64(&start_buf, spec.reversed ? spec.max : spec.min);
-  InternalKey(ns_key, start_buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&start_key);
-  InternalKey(ns_key, "", metadata.version, storage_->IsSlotIdEncoded()).Encode(&prefix_key);
-  InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix_key);
-
-  rocksdb::ReadOptions read_options;
-  LatestSnapShot ss(db_);
-  read_options.snapshot = ss.GetSnapShot();
-  rocksdb::Slice upper_bound(next_version_prefix_key);
-  read_options.iterate_upper_bound = &upper_bound;
-  rocksdb::Slice lower_bound(prefix_key);
-  read_options.iterate_lower_bound = &lower_bound;
-  read_options.fill_cache = false;
-
   int pos = 0;
-  auto iter = DBUtil::UniqueIterator(db_, read_options);
-  if (!spec.reversed) {
-    iter->Seek(start_key);
-  } else {
-    iter->SeekForPrev(start_key);
-  }
-
-  uint64_t id = 0;
-  for (; iter->Valid() && iter->key().starts_with(prefix_key); !spec.reversed ? iter->Next() : iter->Prev()) {
-    InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
-    Slice sub_key = ikey.GetSubKey();
-    GetFixed64(&sub_key, &id);
+  return walk(ns_key, metadata, spec.reversed ? spec.max : spec.min, spec.reversed, [&](uint64_t id) {
     if (spec.reversed) {
-      if ((spec.minex && id == spec.min) || id < spec.min) break;
-      if ((spec.maxex && id == spec.max) || id > spec.max) continue;
+      if ((spec.minex && id == spec.min) || id < spec.min) return false;
+      if ((spec.maxex && id == spec.max) || id > spec.max) return true;
     } else {
-      if ((spec.minex && id == spec.min) || id < spec.min) continue;
-      if ((spec.maxex && id == spec.max) || id > spec.max) break;
+      if ((spec.minex && id == spec.min) || id < spec.min) return true;
+      if ((spec.maxex && id == spec.max) || id > spec.max) return false;
     }
-    if (spec.offset >= 0 && pos++ < spec.offset) continue;
+    if (spec.offset >= 0 && pos++ < spec.offset) return true;
     if (ids) ids->emplace_back(id);
     if (size) *size += 1;
-    if (spec.count > 0 && ids && ids->size() >= static_cast<unsigned>(spec.count)) break;
-  }
-  return rocksdb::Status::OK();
+    return !(spec.count > 0 && ids && ids->size() >= static_cast<unsigned>(spec.count));
+  });
 }
 
 rocksdb::Status Sortedint::MExist(const Slice &user_key, const std::vector<uint64_t> &ids, std::vector<int> *exists) {
@@ -222,11 +200,48 @@ rocksdb::Status Sortedint::MExist(const Slice &user_key, const std::vector<uint6
   rocksdb::ReadOptions read_options;
   read_options.snapshot = ss.GetSnapShot();
   std::string sub_key, value;
+  if (metadata.blocks) {
+    std::string prefix, next_version_prefix;
+    InternalKey(ns_key, "", metadata.version, storage_->IsSlotIdEncoded()).Encode(&prefix);
+    InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix);
+    rocksdb::Slice upper_bound(next_version_prefix);
+    read_options.iterate_upper_bound = &upper_bound;
+    rocksdb::Slice lower_bound(prefix);
+    read_options.iterate_lower_bound = &lower_bound;
+
+    // The id is in the last block whose first id isn't greater than it, and the block is
+    // decoded once for the adjacent ids in it
+    auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options));
+    std::vector<uint64_t> block_ids;
+    for (const auto id : ids) {
+      std::string id_buf;
+      PutFixed64(&id_buf, id);
+      InternalKey(ns_key, id_buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+      iter->SeekForPrev(sub_key);
+      if (!iter->status().ok()) return iter->status();
+      if (!iter->Valid() || !iter->key().starts_with(prefix)) {
+        exists->emplace_back(0);
+        continue;
+      }
+      InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
+      Slice block_key = ikey.GetSubKey();
+      uint64_t first_id = 0;
+      GetFixed64(&block_key, &first_id);
+      if (block_ids.empty() || block_ids.front() != first_id) {
+        if (!DecodeBlock(first_id, iter->value(), &block_ids)) {
+          return rocksdb::Status::Corruption("invalid sortedint block");
+        }
+      }
+      exists->emplace_back(std::binary_search(block_ids.begin(), block_ids.end(), id) ? 1 : 0);
+    }
+    return rocksdb::Status::OK();
+  }
+
   for (const auto id : ids) {
     std::string id_buf;
     PutFixed64(&id_buf, id);
     InternalKey(ns_key, id_buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-    s = db_->Get(read_options, sub_key, &value);
+    s = storage_->Get(read_options, sub_key, &value);
     if (!s.ok() && !s.IsNotFound()) return s;
     if (s.IsNotFound()) {
       exists->emplace_back(0);
@@ -275,4 +290,222 @@ Status Sortedint::ParseRangeSpec(const std::string &min, const std::string &max,
   }
   return Status::OK();
 }
+
+// The block stores the count of the ids, the distance from the first id to the last one, and
+// the deltas between the adjacent ids bit-packed at the width of the largest delta, the first
+// id is in the subkey of the block.
+std::string Sortedint::EncodeBlock(const std::vector<uint64_t> &ids) {
+  uint64_t max_delta = 0;
+  for (size_t i = 1; i < ids.size(); i++) max_delta = std::max(max_delta, ids[i] - ids[i - 1]);
+  uint32_t width = max_delta == 0 ? 0 : 64 - __builtin_clzll(max_delta);
+
+  std::string value;
+  PutVarint32(&value, static_cast<uint32_t>(ids.size()));
+  PutVarint64(&value, ids.back() - ids.front());
+  PutFixed8(&value, static_cast<uint8_t>(width));
+  size_t header_size = value.size();
+  value.resize(header_size + ((ids.size() - 1) * width + 7) / 8, 0);
+  auto *packed = reinterpret_cast<uint8_t *>(&value[header_size]);
+  size_t bit_pos = 0;
+  for (size_t i = 1; i < ids.size(); i++) {
+    uint64_t delta = ids[i] - ids[i - 1];
+    for (uint32_t done = 0; done < width;) {
+      uint32_t shift = bit_pos % 8, take = std::min(width - done, 8 - shift);
+      packed[bit_pos / 8] |= static_cast<uint8_t>(((delta >> done) & ((1U << take) - 1)) << shift);
+      done += take;
+      bit_pos += take;
+    }
+  }
+  return value;
+}
+
+bool Sortedint::DecodeBlock(uint64_t first_id, Slice value, std::vector<uint64_t> *ids) {
+  ids->clear();
+  uint32_t count = 0;
+  uint64_t span = 0;
+  uint8_t width = 0;
+  if (!GetVarint32(&value, &count) || !GetVarint64(&value, &span) || !GetFixed8(&value, &width)) return false;
+  if (count == 0 || width > 64 || value.size() < ((static_cast<uint64_t>(count) - 1) * width + 7) / 8) return false;
+
+  ids->reserve(count);
+  ids->emplace_back(first_id);
+  const auto *packed = reinterpret_cast<const uint8_t *>(value.data());
+  uint64_t id = first_id;
+  size_t bit_pos = 0;
+  for (uint32_t i = 1; i < count; i++) {
+    uint64_t delta = 0;
+    for (uint32_t done = 0; done < width;) {
+      uint32_t shift = bit_pos % 8, take = std::min<uint32_t>(width - done, 8 - shift);
+      delta |= static_cast<uint64_t>((packed[bit_pos / 8] >> shift) & ((1U << take) - 1)) << done;
+      done += take;
+      bit_pos += take;
+    }
+    id += delta;
+    ids->emplace_back(id);
+  }
+  return id - first_id == span;
+}
+
+// Add or remove the ids in the blocks they belong to, which is the last block whose first id
+// isn't greater than the id, or the first block for the ids less than all of them. The touched
+// blocks are rewritten and split evenly once they exceed kSortedintMaxBlockSize ids.
+rocksdb::Status Sortedint::updateBlocks(const Slice &ns_key, const SortedintMetadata &metadata,
+                                        std::vector<uint64_t> ids, bool remove, rocksdb::WriteBatch *batch,
+                                        int *ret) {
+  *ret = 0;
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  if (ids.empty()) return rocksdb::Status::OK();
+
+  std::string prefix, next_version_prefix;
+  InternalKey(ns_key, "", metadata.version, storage_->IsSlotIdEncoded()).Encode(&prefix);
+  InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix);
+  rocksdb::ReadOptions read_options;
+  rocksdb::Slice upper_bound(next_version_prefix);
+  read_options.iterate_upper_bound = &upper_bound;
+  rocksdb::Slice lower_bound(prefix);
+  read_options.iterate_lower_bound = &lower_bound;
+
+  struct Block {
+    bool exists = false;
+    std::vector<uint64_t> ids;
+    std::vector<uint64_t> changes;
+  };
+  std::map<uint64_t, Block> blocks;
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options));
+  for (const auto id : ids) {
+    std::string id_buf, sub_key;
+    PutFixed64(&id_buf, id);
+    InternalKey(ns_key, id_buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+    iter->SeekForPrev(sub_key);
+    if (!iter->Valid() || !iter->key().starts_with(prefix)) iter->Seek(prefix);
+    if (!iter->status().ok()) return iter->status();
+    if (!iter->Valid() || !iter->key().starts_with(prefix)) {
+      // There's no block yet, so the added ids make up the new blocks
+      if (!remove) blocks[ids.front()].changes.emplace_back(id);
+      continue;
+    }
+
+    InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
+    Slice block_key = ikey.GetSubKey();
+    uint64_t first_id = 0;
+    GetFixed64(&block_key, &first_id);
+    auto &block = blocks[first_id];
+    if (!block.exists) {
+      if (!DecodeBlock(first_id, iter->value(), &block.ids)) {
+        return rocksdb::Status::Corruption("invalid sortedint block");
+      }
+      block.exists = true;
+    }
+    block.changes.emplace_back(id);
+  }
+
+  std::vector<uint64_t> changed_ids, deleted_blocks;
+  std::vector<std::vector<uint64_t>> new_blocks;
+  for (const auto &iter_block : blocks) {
+    const auto &block = iter_block.second;
+    std::vector<uint64_t> result;
+    if (remove) {
+      std::set_difference(block.ids.begin(), block.ids.end(), block.changes.begin(), block.changes.end(),
+                          std::back_inserter(result));
+      std::set_intersection(block.ids.begin(), block.ids.end(), block.changes.begin(), block.changes.end(),
+                            std::back_inserter(changed_ids));
+    } else {
+      std::set_union(block.ids.begin(), block.ids.end(), block.changes.begin(), block.changes.end(),
+                     std::back_inserter(result));
+      std::set_difference(block.changes.begin(), block.changes.end(), block.ids.begin(), block.ids.end(),
+                          std::back_inserter(changed_ids));
+    }
+    if (result.size() == block.ids.size()) continue;
+
+    // The subkey of the block changes with its first id
+    if (block.exists && (result.empty() || result.front() != iter_block.first)) {
+      deleted_blocks.emplace_back(iter_block.first);
+    }
+    size_t num_blocks = (result.size() + kSortedintMaxBlockSize - 1) / kSortedintMaxBlockSize;
+    for (size_t i = 0; i < num_blocks; i++) {
+      new_blocks.emplace_back(result.begin() + static_cast<int64_t>(result.size() * i / num_blocks),
+                              result.begin() + static_cast<int64_t>(result.size() * (i + 1) / num_blocks));
+    }
+  }
+  *ret = static_cast<int>(changed_ids.size());
+  if (changed_ids.empty()) return rocksdb::Status::OK();
+
+  // The changed ids are logged, since the rewritten blocks don't tell which ids are added or removed
+  std::vector<std::string> log_args = {std::to_string(remove ? kRedisCmdSIRem : kRedisCmdSIAdd)};
+  for (const auto id : changed_ids) log_args.emplace_back(std::to_string(id));
+  WriteBatchLogData log_data(kRedisSortedint, std::move(log_args));
+  batch->PutLogData(log_data.Encode());
+  std::string id_buf, sub_key;
+  for (const auto first_id : deleted_blocks) {
+    id_buf.clear();
+    PutFixed64(&id_buf, first_id);
+    InternalKey(ns_key, id_buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+    batch->Delete(sub_key);
+  }
+  for (const auto &block_ids : new_blocks) {
+    id_buf.clear();
+    PutFixed64(&id_buf, block_ids.front());
+    InternalKey(ns_key, id_buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+    batch->Put(sub_key, EncodeBlock(block_ids));
+  }
+  return rocksdb::Status::OK();
+}
+
+// Visit the ids from the start id until the visitor returns false, the ids not less than the start
+// id are visited in the ascending order, or the ids not greater than it in the descending order.
+rocksdb::Status Sortedint::walk(const Slice &ns_key, const SortedintMetadata &metadata, uint64_t start_id,
+                                bool reversed, const std::function<bool(uint64_t)> &visitor) {
+  std::string prefix, next_version_prefix, start_key, start_buf;
+  PutFixed64(&start_buf, start_id);
+  InternalKey(ns_key, start_buf, metadata.version, storage_->IsSlotIdEncoded()).Encode(&start_key);
+  InternalKey(ns_key, "", metadata.version, storage_->IsSlotIdEncoded()).Encode(&prefix);
+  InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix);
+
+  rocksdb::ReadOptions read_options;
+  LatestSnapShot ss(db_);
+  read_options.snapshot = ss.GetSnapShot();
+  rocksdb::Slice upper_bound(next_version_prefix);
+  read_options.iterate_upper_bound = &upper_bound;
+  rocksdb::Slice lower_bound(prefix);
+  read_options.iterate_lower_bound = &lower_bound;
+  read_options.fill_cache = false;
+
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options));
+  if (!metadata.blocks) {
+    uint64_t id = 0;
+    for (!reversed ? iter->Seek(start_key) : iter->SeekForPrev(start_key);
+         iter->Valid() && iter->key().starts_with(prefix); !reversed ? iter->Next() : iter->Prev()) {
+      InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
+      Slice sub_key = ikey.GetSubKey();
+      GetFixed64(&sub_key, &id);
+      if (!visitor(id)) break;
+    }
+    return rocksdb::Status::OK();
+  }
+
+  // Seek the block which contains the start id, the blocks before it are skipped without decoding
+  iter->SeekForPrev(start_key);
+  if (!reversed && !(iter->Valid() && iter->key().starts_with(prefix))) iter->Seek(prefix);
+  std::vector<uint64_t> ids;
+  for (; iter->Valid() && iter->key().starts_with(prefix); !reversed ? iter->Next() : iter->Prev()) {
+    InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
+    Slice sub_key = ikey.GetSubKey();
+    uint64_t first_id = 0;
+    GetFixed64(&sub_key, &first_id);
+    if (!DecodeBlock(first_id, iter->value(), &ids)) return rocksdb::Status::Corruption("invalid sortedint block");
+    if (!reversed) {
+      for (auto it = std::lower_bound(ids.begin(), ids.end(), start_id); it != ids.end(); ++it) {
+        if (!visitor(*it)) return rocksdb::Status::OK();
+      }
+    } else {
+      auto it = std::make_reverse_iterator(std::upper_bound(ids.begin(), ids.end(), start_id));
+      for (; it != ids.rend(); ++it) {
+        if (!visitor(*it)) return rocksdb::Status::OK();
+      }
+    }
+  }
+  return rocksdb::Status::OK();
+}
+
 }  // namespace Redis
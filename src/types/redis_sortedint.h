@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <functional>
 #include <limits>
 #include <string>
 #include <vector>
@@ -48,9 +49,15 @@ class Sortedint : public Database {
                         std::vector<uint64_t> *ids);
   rocksdb::Status RangeByValue(const Slice &user_key, SortedintRangeSpec spec, std::vector<uint64_t> *ids, int *size);
   static Status ParseRangeSpec(const std::string &min, const std::string &max, SortedintRangeSpec *spec);
+  static std::string EncodeBlock(const std::vector<uint64_t> &ids);
+  static bool DecodeBlock(uint64_t first_id, Slice value, std::vector<uint64_t> *ids);
 
  private:
   rocksdb::Status GetMetadata(const Slice &ns_key, SortedintMetadata *metadata);
+  rocksdb::Status updateBlocks(const Slice &ns_key, const SortedintMetadata &metadata, std::vector<uint64_t> ids,
+                               bool remove, rocksdb::WriteBatch *batch, int *ret);
+  rocksdb::Status walk(const Slice &ns_key, const SortedintMetadata &metadata, uint64_t start_id, bool reversed,
+                       const std::function<bool(uint64_t)> &visitor);
 };
 
 }  // namespace Redis
@@ -22,11 +22,14 @@
 
 #include <rocksdb/status.h>
 
+#include <map>
 #include <memory>
+#include <set>
 #include <utility>
 #include <vector>
 
 #include "db_util.h"
+#include "time_util.h"
 
 namespace Redis {
 
@@ -63,6 +66,16 @@ StreamEntryID Stream::entryIDFromInternalKey(const rocksdb::Slice &key) const {
   return id;
 }
 
+rocksdb::Status Stream::decodeEntryValue(const StreamMetadata &metadata, const StreamEntryID &id,
+                                         const std::string &value, std::vector<std::string> *result) {
+  auto rv = metadata.IsSchemaEncoded(id) ? DecodeStreamEntryValue(metadata.entry_schemas, value, result)
+                                         : DecodeRawStreamEntryValue(value, result);
+  if (!rv.IsOK()) {
+    return rocksdb::Status::InvalidArgument(rv.Msg());
+  }
+  return rocksdb::Status::OK();
+}
+
 std::string Stream::internalKeyFromEntryID(const std::string &ns_key, const StreamMetadata &metadata,
                                            const StreamEntryID &id) const {
   std::string sub_key;
@@ -81,8 +94,6 @@ rocksdb::Status Stream::Add(const Slice &stream_name, const StreamAddOptions &op
     }
   }
 
-  std::string entry_value = EncodeStreamEntryValue(args);
-
   std::string ns_key;
   AppendNamespacePrefix(stream_name, &ns_key);
 
@@ -107,6 +118,10 @@ rocksdb::Status Stream::Add(const Slice &stream_name, const StreamAddOptions &op
 
   bool should_add = true;
 
+  if (options.with_retention) metadata.retention_ms = options.retention_ms;
+  applyRetention(ns_key, &metadata, &batch);
+  if (metadata.IsRetentionTrimmed(next_entry_id)) should_add = false;
+
   // trim the stream before adding a new entry to provide atomic XADD + XTRIM
   if (options.trim_options.strategy != StreamTrimStrategy::None) {
     StreamTrimOptions trim_options = options.trim_options;
@@ -129,6 +144,20 @@ rocksdb::Status Stream::Add(const Slice &stream_name, const StreamAddOptions &op
   }
 
   if (should_add) {
+    // the new entries of the existing streams are schema encoded as well, the ids are increasing
+    int max_schemas = storage_->GetConfig()->stream_entry_max_schemas;
+    if (!metadata.schema_encoded && max_schemas > 0) {
+      metadata.schema_encoded = true;
+      metadata.entry_schemas_since = next_entry_id;
+    }
+    std::string entry_value;
+    if (metadata.schema_encoded) {
+      uint32_t schema_id = metadata.FindOrAddEntrySchema(args, max_schemas);
+      entry_value = EncodeStreamEntryValue(schema_id, args);
+    } else {
+      entry_value = EncodeStreamEntryValue(args);
+    }
+
     std::string entry_key = internalKeyFromEntryID(ns_key, metadata, next_entry_id);
     batch.Put(stream_cf_handle_, entry_key, entry_value);
 
@@ -241,12 +270,13 @@ rocksdb::Status Stream::DeleteEntries(const rocksdb::Slice &stream_name, const s
   read_options.iterate_lower_bound = &lower_bound;
   read_options.fill_cache = false;
 
-  auto iter = DBUtil::UniqueIterator(db_, read_options, stream_cf_handle_);
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, stream_cf_handle_));
 
   for (const auto &id : ids) {
+    if (metadata.IsRetentionTrimmed(id)) continue;
     std::string entry_key = internalKeyFromEntryID(ns_key, metadata, id);
     std::string value;
-    s = db_->Get(read_options, stream_cf_handle_, entry_key, &value);
+    s = storage_->Get(read_options, stream_cf_handle_, entry_key, &value);
     if (s.ok()) {
       *ret += 1;
       batch.Delete(stream_cf_handle_, entry_key);
@@ -314,6 +344,19 @@ rocksdb::Status Stream::Len(const rocksdb::Slice &stream_name, uint64_t *ret) {
 
 rocksdb::Status Stream::range(const std::string &ns_key, const StreamMetadata &metadata,
                               const StreamRangeOptions &options, std::vector<StreamEntry> *entries) const {
+  // the entries below the retention watermark were trimmed, but may not be dropped by the compaction yet
+  if (metadata.IsRetentionTrimmed(options.reverse ? options.end : options.start)) {
+    StreamRangeOptions retained = options;
+    if (options.reverse) {
+      retained.end = metadata.retention_watermark;
+      retained.exclude_end = false;
+    } else {
+      retained.start = metadata.retention_watermark;
+      retained.exclude_start = false;
+    }
+    return range(ns_key, metadata, retained, entries);
+  }
+
   std::string start_key = internalKeyFromEntryID(ns_key, metadata, options.start);
   std::string end_key = internalKeyFromEntryID(ns_key, metadata, options.end);
 
@@ -323,16 +366,14 @@ rocksdb::Status Stream::range(const std::string &ns_key, const StreamMetadata &m
     }
 
     std::string entry_value;
-    auto s = db_->Get(rocksdb::ReadOptions(), stream_cf_handle_, start_key, &entry_value);
+    auto s = storage_->Get(rocksdb::ReadOptions(), stream_cf_handle_, start_key, &entry_value);
     if (!s.ok()) {
       return s.IsNotFound() ? rocksdb::Status::OK() : s;
     }
 
     std::vector<std::string> values;
-    auto rv = DecodeRawStreamEntryValue(entry_value, &values);
-    if (!rv.IsOK()) {
-      return rocksdb::Status::InvalidArgument(rv.Msg());
-    }
+    s = decodeEntryValue(metadata, options.start, entry_value, &values);
+    if (!s.ok()) return s;
 
     entries->emplace_back(options.start.ToString(), std::move(values));
     return rocksdb::Status::OK();
@@ -356,7 +397,7 @@ rocksdb::Status Stream::range(const std::string &ns_key, const StreamMetadata &m
   read_options.iterate_lower_bound = &lower_bound;
   read_options.fill_cache = false;
 
-  auto iter = DBUtil::UniqueIterator(db_, read_options, stream_cf_handle_);
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, stream_cf_handle_));
   iter->Seek(start_key);
   if (options.reverse && (!iter->Valid() || iter->key().ToString() != start_key)) {
     iter->SeekForPrev(start_key);
@@ -373,12 +414,11 @@ rocksdb::Status Stream::range(const std::string &ns_key, const StreamMetadata &m
     }
 
     std::vector<std::string> values;
-    auto rv = DecodeRawStreamEntryValue(iter->value().ToString(), &values);
-    if (!rv.IsOK()) {
-      return rocksdb::Status::InvalidArgument(rv.Msg());
-    }
+    StreamEntryID id = entryIDFromInternalKey(iter->key());
+    auto s = decodeEntryValue(metadata, id, iter->value().ToString(), &values);
+    if (!s.ok()) return s;
 
-    entries->emplace_back(entryIDFromInternalKey(iter->key()).ToString(), std::move(values));
+    entries->emplace_back(id.ToString(), std::move(values));
 
     if (options.with_count && entries->size() == options.count) {
       break;
@@ -390,8 +430,9 @@ rocksdb::Status Stream::range(const std::string &ns_key, const StreamMetadata &m
 
 rocksdb::Status Stream::getEntryRawValue(const std::string &ns_key, const StreamMetadata &metadata,
                                          const StreamEntryID &id, std::string *value) const {
+  if (metadata.IsRetentionTrimmed(id)) return rocksdb::Status::NotFound();
   std::string entry_key = internalKeyFromEntryID(ns_key, metadata, id);
-  return db_->Get(rocksdb::ReadOptions(), stream_cf_handle_, entry_key, value);
+  return storage_->Get(rocksdb::ReadOptions(), stream_cf_handle_, entry_key, value);
 }
 
 rocksdb::Status Stream::GetStreamInfo(const rocksdb::Slice &stream_name, bool full, uint64_t count, StreamInfo *info) {
@@ -442,10 +483,8 @@ rocksdb::Status Stream::GetStreamInfo(const rocksdb::Slice &stream_name, bool fu
     }
 
     std::vector<std::string> values;
-    auto rv = DecodeRawStreamEntryValue(first_value, &values);
-    if (!rv.IsOK()) {
-      return rocksdb::Status::InvalidArgument(rv.Msg());
-    }
+    s = decodeEntryValue(metadata, metadata.first_entry_id, first_value, &values);
+    if (!s.ok()) return s;
 
     info->first_entry = std::make_unique<StreamEntry>(metadata.first_entry_id.ToString(), std::move(values));
 
@@ -455,10 +494,8 @@ rocksdb::Status Stream::GetStreamInfo(const rocksdb::Slice &stream_name, bool fu
       return s;
     }
 
-    rv = DecodeRawStreamEntryValue(last_value, &values);
-    if (!rv.IsOK()) {
-      return rocksdb::Status::InvalidArgument(rv.Msg());
-    }
+    s = decodeEntryValue(metadata, metadata.last_entry_id, last_value, &values);
+    if (!s.ok()) return s;
 
     info->last_entry = std::make_unique<StreamEntry>(metadata.last_entry_id.ToString(), std::move(values));
   }
@@ -516,7 +553,8 @@ rocksdb::Status Stream::Trim(const rocksdb::Slice &stream_name, const StreamTrim
   WriteBatchLogData log_data(kRedisStream);
   batch.PutLogData(log_data.Encode());
 
-  *ret = trim(ns_key, options, &metadata, &batch);
+  *ret = applyRetention(ns_key, &metadata, &batch);
+  *ret += trim(ns_key, options, &metadata, &batch);
 
   if (*ret > 0) {
     std::string bytes;
@@ -529,8 +567,25 @@ rocksdb::Status Stream::Trim(const rocksdb::Slice &stream_name, const StreamTrim
   return rocksdb::Status::OK();
 }
 
+// Advance the retention watermark of the stream to the entries older than its retention. The entries
+// below the watermark are counted out of the stream, and left to the compaction filter to be dropped.
+uint64_t Stream::applyRetention(const std::string &ns_key, StreamMetadata *metadata, rocksdb::WriteBatch *batch) {
+  uint64_t now = Util::GetTimeStampMS();
+  if (metadata->retention_ms == 0 || now <= metadata->retention_ms) return 0;
+
+  StreamEntryID watermark{now - metadata->retention_ms, 0};
+  if (watermark <= metadata->retention_watermark) return 0;
+
+  StreamTrimOptions options;
+  options.strategy = StreamTrimStrategy::MinID;
+  options.min_id = watermark;
+  uint64_t ret = trim(ns_key, options, metadata, batch, true);
+  metadata->retention_watermark = watermark;
+  return ret;
+}
+
 uint64_t Stream::trim(const std::string &ns_key, const StreamTrimOptions &options, StreamMetadata *metadata,
-                      rocksdb::WriteBatch *batch) {
+                      rocksdb::WriteBatch *batch, bool drop_by_compaction) {
   if (metadata->size == 0) {
     return 0;
   }
@@ -559,11 +614,18 @@ uint64_t Stream::trim(const std::string &ns_key, const StreamTrimOptions &option
   read_options.iterate_lower_bound = &lower_bound;
   read_options.fill_cache = false;
 
-  auto iter = DBUtil::UniqueIterator(db_, read_options, stream_cf_handle_);
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, stream_cf_handle_));
   std::string start_key = internalKeyFromEntryID(ns_key, *metadata, metadata->first_entry_id);
   iter->Seek(start_key);
 
-  std::string last_deleted;
+  // The trimmed entries are always a contiguous range from the first entry, so a large
+  // trim is written as one range deletion instead of a tombstone per entry. The keys are
+  // still iterated to count the entries and find the new first entry.
+  auto min_elements = static_cast<uint64_t>(storage_->GetConfig()->range_delete_min_elements);
+  // The transaction can't serve the reads of the deleted range, so the entries are deleted one by one
+  if (storage_->InTxn()) min_elements = 0;
+  std::vector<std::string> deleted_keys;
+  std::string first_deleted, last_deleted;
   while (iter->Valid() && metadata->size > 0) {
     if (options.strategy == StreamTrimStrategy::MaxLen && metadata->size <= options.max_len) {
       break;
@@ -573,7 +635,8 @@ uint64_t Stream::trim(const std::string &ns_key, const StreamTrimOptions &option
       break;
     }
 
-    batch->Delete(stream_cf_handle_, iter->key());
+    if (ret == 0) first_deleted = iter->key().ToString();
+    if (min_elements == 0 || ret < min_elements) deleted_keys.emplace_back(iter->key().ToString());
 
     ret += 1;
     metadata->size -= 1;
@@ -596,6 +659,17 @@ uint64_t Stream::trim(const std::string &ns_key, const StreamTrimOptions &option
     metadata->recorded_first_entry_id.Clear();
   }
 
+  if (drop_by_compaction) {
+    // nothing is deleted, the range below the retention watermark is dropped by the compaction filter
+  } else if (min_elements > 0 && ret >= min_elements) {
+    // the end of the range is exclusive, and nothing sorts between the key and itself with a zero byte appended
+    batch->DeleteRange(stream_cf_handle_, first_deleted, last_deleted + '\0');
+  } else {
+    for (const auto &key : deleted_keys) {
+      batch->Delete(stream_cf_handle_, key);
+    }
+  }
+
   if (ret > 0) {
     metadata->max_deleted_entry_id = entryIDFromInternalKey(last_deleted);
   }
@@ -603,4 +677,817 @@ uint64_t Stream::trim(const std::string &ns_key, const StreamTrimOptions &option
   return ret;
 }
 
+std::string Stream::groupSubkeyPrefix(StreamSubkeyType type) {
+  // the maximum entry ID as the prefix to keep the groups out of the entries' ranges
+  std::string sub_key(2 * sizeof(uint64_t), '\xff');
+  PutFixed8(&sub_key, static_cast<uint8_t>(type));
+  return sub_key;
+}
+
+std::string Stream::groupSubkeyPrefix(StreamSubkeyType type, const std::string &group_name) {
+  std::string sub_key = groupSubkeyPrefix(type);
+  PutFixed32(&sub_key, static_cast<uint32_t>(group_name.size()));
+  sub_key.append(group_name);
+  return sub_key;
+}
+
+std::string Stream::internalKeyFromSubkey(const std::string &ns_key, const StreamMetadata &metadata,
+                                          const std::string &sub_key) const {
+  std::string key;
+  InternalKey(ns_key, sub_key, metadata.version, storage_->IsSlotIdEncoded()).Encode(&key);
+  return key;
+}
+
+std::string Stream::internalKeyFromGroupName(const std::string &ns_key, const StreamMetadata &metadata,
+                                             const std::string &group_name) const {
+  return internalKeyFromSubkey(ns_key, metadata, groupSubkeyPrefix(StreamSubkeyType::kGroup, group_name));
+}
+
+std::string Stream::internalKeyFromConsumerName(const std::string &ns_key, const StreamMetadata &metadata,
+                                                const std::string &group_name,
+                                                const std::string &consumer_name) const {
+  return internalKeyFromSubkey(ns_key, metadata,
+                               groupSubkeyPrefix(StreamSubkeyType::kConsumer, group_name) + consumer_name);
+}
+
+static std::string encodePendingID(const StreamEntryID &id) {
+  std::string dst;
+  PutFixed64(&dst, id.ms);
+  PutFixed64(&dst, id.seq);
+  return dst;
+}
+
+static std::string encodePendingTime(uint64_t delivery_time, const StreamEntryID &id) {
+  std::string dst;
+  PutFixed64(&dst, delivery_time);
+  PutFixed64(&dst, id.ms);
+  PutFixed64(&dst, id.seq);
+  return dst;
+}
+
+rocksdb::Status Stream::scanGroupSubkeys(const std::string &ns_key, const StreamMetadata &metadata,
+                                         const std::string &sub_key_prefix, const std::string &start, bool reversed,
+                                         const std::function<bool(const Slice &, const Slice &)> &fn) const {
+  std::string prefix_key = internalKeyFromSubkey(ns_key, metadata, sub_key_prefix);
+  std::string next_version_prefix_key;
+  InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix_key);
+
+  rocksdb::ReadOptions read_options;
+  LatestSnapShot ss(db_);
+  read_options.snapshot = ss.GetSnapShot();
+  rocksdb::Slice upper_bound(next_version_prefix_key);
+  read_options.iterate_upper_bound = &upper_bound;
+  rocksdb::Slice lower_bound(prefix_key);
+  read_options.iterate_lower_bound = &lower_bound;
+  read_options.fill_cache = false;
+
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, stream_cf_handle_));
+  if (reversed) {
+    iter->SeekForPrev(prefix_key + start);
+  } else {
+    iter->Seek(prefix_key + start);
+  }
+  for (; iter->Valid() && iter->key().starts_with(prefix_key); reversed ? iter->Prev() : iter->Next()) {
+    Slice suffix = iter->key();
+    suffix.remove_prefix(prefix_key.size());
+    if (!fn(suffix, iter->value())) break;
+  }
+  return iter->status();
+}
+
+rocksdb::Status Stream::getGroup(const std::string &ns_key, const StreamMetadata &metadata,
+                                 const std::string &group_name, StreamGroupMetadata *group) const {
+  std::string value;
+  auto s = storage_->Get(rocksdb::ReadOptions(), stream_cf_handle_,
+                         internalKeyFromGroupName(ns_key, metadata, group_name), &value);
+  if (!s.ok()) return s;
+  return DecodeStreamGroupValue(value, group);
+}
+
+rocksdb::Status Stream::loadConsumer(const std::string &ns_key, const StreamMetadata &metadata,
+                                     const std::string &group_name, const std::string &consumer_name,
+                                     std::map<std::string, StreamConsumerMetadata> *consumers) const {
+  if (consumers->count(consumer_name) > 0) return rocksdb::Status::OK();
+
+  std::string value;
+  auto s = storage_->Get(rocksdb::ReadOptions(), stream_cf_handle_,
+                         internalKeyFromConsumerName(ns_key, metadata, group_name, consumer_name), &value);
+  if (!s.ok()) return s;
+  return DecodeStreamConsumerValue(value, &(*consumers)[consumer_name]);
+}
+
+rocksdb::Status Stream::getPendingEntry(const std::string &ns_key, const StreamMetadata &metadata,
+                                        const std::string &group_name, const StreamEntryID &id,
+                                        StreamPendingEntry *pending) const {
+  std::string sub_key = groupSubkeyPrefix(StreamSubkeyType::kPending, group_name) + encodePendingID(id);
+  std::string value;
+  auto s = storage_->Get(rocksdb::ReadOptions(), stream_cf_handle_, internalKeyFromSubkey(ns_key, metadata, sub_key),
+                         &value);
+  if (!s.ok()) return s;
+  pending->id = id;
+  return DecodeStreamPendingValue(value, pending);
+}
+
+// The pending entry is indexed by its ID for XACK and XCLAIM, and by the delivery time
+// for XAUTOCLAIM, so the idle entries could be found without scanning the whole PEL.
+void Stream::putPendingEntry(const std::string &ns_key, const StreamMetadata &metadata,
+                             const std::string &group_name, const StreamPendingEntry &pending,
+                             rocksdb::WriteBatch *batch) const {
+  std::string sub_key = groupSubkeyPrefix(StreamSubkeyType::kPending, group_name) + encodePendingID(pending.id);
+  batch->Put(stream_cf_handle_, internalKeyFromSubkey(ns_key, metadata, sub_key), EncodeStreamPendingValue(pending));
+  sub_key = groupSubkeyPrefix(StreamSubkeyType::kPendingTime, group_name) +
+            encodePendingTime(pending.delivery_time, pending.id);
+  batch->Put(stream_cf_handle_, internalKeyFromSubkey(ns_key, metadata, sub_key), Slice());
+}
+
+void Stream::deletePendingEntry(const std::string &ns_key, const StreamMetadata &metadata,
+                                const std::string &group_name, const StreamPendingEntry &pending,
+                                rocksdb::WriteBatch *batch) const {
+  std::string sub_key = groupSubkeyPrefix(StreamSubkeyType::kPending, group_name) + encodePendingID(pending.id);
+  batch->Delete(stream_cf_handle_, internalKeyFromSubkey(ns_key, metadata, sub_key));
+  sub_key = groupSubkeyPrefix(StreamSubkeyType::kPendingTime, group_name) +
+            encodePendingTime(pending.delivery_time, pending.id);
+  batch->Delete(stream_cf_handle_, internalKeyFromSubkey(ns_key, metadata, sub_key));
+}
+
+rocksdb::Status Stream::removePendingEntry(const std::string &ns_key, const StreamMetadata &metadata,
+                                           const std::string &group_name, const StreamPendingEntry &pending,
+                                           StreamGroupMetadata *group,
+                                           std::map<std::string, StreamConsumerMetadata> *consumers,
+                                           rocksdb::WriteBatch *batch) const {
+  deletePendingEntry(ns_key, metadata, group_name, pending, batch);
+  if (group->pending > 0) group->pending--;
+
+  auto s = loadConsumer(ns_key, metadata, group_name, pending.consumer, consumers);
+  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+  auto &owner = (*consumers)[pending.consumer];
+  if (owner.pending > 0) owner.pending--;
+  return rocksdb::Status::OK();
+}
+
+// transferPendingEntry moves the ownership of the pending entry to the consumer, which must
+// have been loaded into the consumers before.
+rocksdb::Status Stream::transferPendingEntry(const std::string &ns_key, const StreamMetadata &metadata,
+                                             const std::string &group_name, const std::string &consumer_name,
+                                             StreamPendingEntry *pending,
+                                             std::map<std::string, StreamConsumerMetadata> *consumers) const {
+  if (pending->consumer == consumer_name) return rocksdb::Status::OK();
+
+  auto s = loadConsumer(ns_key, metadata, group_name, pending->consumer, consumers);
+  if (s.ok()) {
+    auto &owner = (*consumers)[pending->consumer];
+    if (owner.pending > 0) owner.pending--;
+  } else if (!s.IsNotFound()) {
+    return s;
+  }
+  (*consumers)[consumer_name].pending++;
+  pending->consumer = consumer_name;
+  return rocksdb::Status::OK();
+}
+
+void Stream::putGroupState(const std::string &ns_key, const StreamMetadata &metadata, const std::string &group_name,
+                           const StreamGroupMetadata &group,
+                           const std::map<std::string, StreamConsumerMetadata> &consumers,
+                           rocksdb::WriteBatch *batch) const {
+  batch->Put(stream_cf_handle_, internalKeyFromGroupName(ns_key, metadata, group_name), EncodeStreamGroupValue(group));
+  for (const auto &iter : consumers) {
+    batch->Put(stream_cf_handle_, internalKeyFromConsumerName(ns_key, metadata, group_name, iter.first),
+               EncodeStreamConsumerValue(iter.second));
+  }
+}
+
+rocksdb::Status Stream::CreateGroup(const Slice &stream_name, const std::string &group_name,
+                                    const StreamCreateGroupOptions &options) {
+  std::string ns_key;
+  AppendNamespacePrefix(stream_name, &ns_key);
+
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  StreamMetadata metadata;
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok() && !s.IsNotFound()) return s;
+  if (s.IsNotFound() && !options.mkstream) return s;
+
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisStream);
+  batch.PutLogData(log_data.Encode());
+
+  if (s.IsNotFound()) {
+    std::string bytes;
+    metadata.Encode(&bytes);
+    batch.Put(metadata_cf_handle_, ns_key, bytes);
+  } else {
+    StreamGroupMetadata group;
+    s = getGroup(ns_key, metadata, group_name, &group);
+    if (s.ok()) return rocksdb::Status::InvalidArgument("BUSYGROUP Consumer Group name already exists");
+    if (!s.IsNotFound()) return s;
+  }
+
+  StreamGroupMetadata group;
+  group.last_delivered_id = options.latest ? metadata.last_generated_id : options.last_id;
+  batch.Put(stream_cf_handle_, internalKeyFromGroupName(ns_key, metadata, group_name), EncodeStreamGroupValue(group));
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+rocksdb::Status Stream::DestroyGroup(const Slice &stream_name, const std::string &group_name, uint64_t *ret) {
+  *ret = 0;
+  std::string ns_key;
+  AppendNamespacePrefix(stream_name, &ns_key);
+
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  StreamMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+
+  StreamGroupMetadata group;
+  s = getGroup(ns_key, metadata, group_name, &group);
+  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisStream);
+  batch.PutLogData(log_data.Encode());
+
+  batch.Delete(stream_cf_handle_, internalKeyFromGroupName(ns_key, metadata, group_name));
+  for (auto type : {StreamSubkeyType::kConsumer, StreamSubkeyType::kPending, StreamSubkeyType::kPendingTime}) {
+    std::string prefix = groupSubkeyPrefix(type, group_name);
+    s = scanGroupSubkeys(ns_key, metadata, prefix, "", false, [&](const Slice &suffix, const Slice &) {
+      batch.Delete(stream_cf_handle_, internalKeyFromSubkey(ns_key, metadata, prefix + suffix.ToString()));
+      return true;
+    });
+    if (!s.ok()) return s;
+  }
+
+  *ret = 1;
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+rocksdb::Status Stream::SetGroupID(const Slice &stream_name, const std::string &group_name, const StreamEntryID &id,
+                                   bool latest) {
+  std::string ns_key;
+  AppendNamespacePrefix(stream_name, &ns_key);
+
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  StreamMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+
+  StreamGroupMetadata group;
+  s = getGroup(ns_key, metadata, group_name, &group);
+  if (!s.ok()) return s;
+
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisStream);
+  batch.PutLogData(log_data.Encode());
+
+  group.last_delivered_id = latest ? metadata.last_generated_id : id;
+  batch.Put(stream_cf_handle_, internalKeyFromGroupName(ns_key, metadata, group_name), EncodeStreamGroupValue(group));
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+rocksdb::Status Stream::CreateConsumer(const Slice &stream_name, const std::string &group_name,
+                                       const std::string &consumer_name, uint64_t *ret) {
+  *ret = 0;
+  std::string ns_key;
+  AppendNamespacePrefix(stream_name, &ns_key);
+
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  StreamMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+
+  StreamGroupMetadata group;
+  s = getGroup(ns_key, metadata, group_name, &group);
+  if (!s.ok()) return s;
+
+  std::map<std::string, StreamConsumerMetadata> consumers;
+  s = loadConsumer(ns_key, metadata, group_name, consumer_name, &consumers);
+  if (s.ok()) return rocksdb::Status::OK();
+  if (!s.IsNotFound()) return s;
+
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisStream);
+  batch.PutLogData(log_data.Encode());
+
+  consumers[consumer_name].seen_time = Util::GetTimeStampMS();
+  group.consumers++;
+  putGroupState(ns_key, metadata, group_name, group, consumers, &batch);
+  *ret = 1;
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+rocksdb::Status Stream::DeleteConsumer(const Slice &stream_name, const std::string &group_name,
+                                       const std::string &consumer_name, uint64_t *ret) {
+  *ret = 0;
+  std::string ns_key;
+  AppendNamespacePrefix(stream_name, &ns_key);
+
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  StreamMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+
+  StreamGroupMetadata group;
+  s = getGroup(ns_key, metadata, group_name, &group);
+  if (!s.ok()) return s;
+
+  std::map<std::string, StreamConsumerMetadata> consumers;
+  s = loadConsumer(ns_key, metadata, group_name, consumer_name, &consumers);
+  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisStream);
+  batch.PutLogData(log_data.Encode());
+
+  // the pending entries of the consumer are dropped with it, like Redis does
+  if (consumers[consumer_name].pending > 0) {
+    s = scanGroupSubkeys(ns_key, metadata, groupSubkeyPrefix(StreamSubkeyType::kPending, group_name), "", false,
+                         [&](const Slice &suffix, const Slice &value) {
+                           StreamPendingEntry pending;
+                           Slice id_slice = suffix;
+                           if (!GetFixed64(&id_slice, &pending.id.ms) || !GetFixed64(&id_slice, &pending.id.seq) ||
+                               !DecodeStreamPendingValue(value.ToString(), &pending).ok()) {
+                             return true;
+                           }
+                           if (pending.consumer == consumer_name) {
+                             deletePendingEntry(ns_key, metadata, group_name, pending, &batch);
+                             *ret += 1;
+                           }
+                           return true;
+                         });
+    if (!s.ok()) return s;
+  }
+
+  batch.Delete(stream_cf_handle_, internalKeyFromConsumerName(ns_key, metadata, group_name, consumer_name));
+  group.pending = group.pending > *ret ? group.pending - *ret : 0;
+  if (group.consumers > 0) group.consumers--;
+  batch.Put(stream_cf_handle_, internalKeyFromGroupName(ns_key, metadata, group_name), EncodeStreamGroupValue(group));
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+rocksdb::Status Stream::ReadGroup(const Slice &stream_name, const StreamReadGroupOptions &options,
+                                  std::vector<StreamEntry> *entries) {
+  entries->clear();
+  std::string ns_key;
+  AppendNamespacePrefix(stream_name, &ns_key);
+
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  StreamMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+
+  StreamGroupMetadata group;
+  s = getGroup(ns_key, metadata, options.group, &group);
+  if (!s.ok()) return s;
+
+  std::map<std::string, StreamConsumerMetadata> consumers;
+  s = loadConsumer(ns_key, metadata, options.group, options.consumer, &consumers);
+  if (s.IsNotFound()) {
+    consumers[options.consumer] = StreamConsumerMetadata{};
+    group.consumers++;
+  } else if (!s.ok()) {
+    return s;
+  }
+  uint64_t now = Util::GetTimeStampMS();
+  consumers[options.consumer].seen_time = now;
+
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisStream);
+  batch.PutLogData(log_data.Encode());
+
+  if (options.new_entries) {
+    if (!group.last_delivered_id.IsMaximum()) {
+      StreamRangeOptions range_options;
+      range_options.start = group.last_delivered_id;
+      range_options.end = StreamEntryID::Maximum();
+      range_options.with_count = options.with_count;
+      range_options.count = options.count;
+      range_options.exclude_start = true;
+      s = range(ns_key, metadata, range_options, entries);
+      if (!s.ok()) return s;
+    }
+
+    for (const auto &entry : *entries) {
+      StreamEntryID id;
+      auto rv = ParseStreamEntryID(entry.key, &id);
+      if (!rv.IsOK()) return rocksdb::Status::InvalidArgument(rv.Msg());
+      group.last_delivered_id = id;
+      if (options.noack) continue;
+
+      StreamPendingEntry pending;
+      s = getPendingEntry(ns_key, metadata, options.group, id, &pending);
+      if (s.ok()) {
+        // the entry was delivered again after the group's last delivered ID was moved back
+        deletePendingEntry(ns_key, metadata, options.group, pending, &batch);
+        s = transferPendingEntry(ns_key, metadata, options.group, options.consumer, &pending, &consumers);
+        if (!s.ok()) return s;
+      } else if (s.IsNotFound()) {
+        pending.id = id;
+        pending.consumer = options.consumer;
+        group.pending++;
+        consumers[options.consumer].pending++;
+      } else {
+        return s;
+      }
+      pending.delivery_time = now;
+      pending.delivery_count = 1;
+      putPendingEntry(ns_key, metadata, options.group, pending, &batch);
+    }
+  } else {
+    // the history of the consumer, which is the entries delivered to it but not acknowledged yet
+    rocksdb::Status read_s;
+    std::string start = encodePendingID(options.start);
+    s = scanGroupSubkeys(ns_key, metadata, groupSubkeyPrefix(StreamSubkeyType::kPending, options.group), start, false,
+                         [&](const Slice &suffix, const Slice &value) {
+                           StreamPendingEntry pending;
+                           Slice id_slice = suffix;
+                           if (!GetFixed64(&id_slice, &pending.id.ms) || !GetFixed64(&id_slice, &pending.id.seq)) {
+                             return true;
+                           }
+                           if (pending.id == options.start) return true;
+                           read_s = DecodeStreamPendingValue(value.ToString(), &pending);
+                           if (!read_s.ok()) return false;
+                           if (pending.consumer != options.consumer) return true;
+
+                           // the entry which was deleted from the stream is replied with empty values
+                           std::vector<std::string> values;
+                           std::string entry_value;
+                           read_s = getEntryRawValue(ns_key, metadata, pending.id, &entry_value);
+                           if (read_s.ok()) {
+                             read_s = decodeEntryValue(metadata, pending.id, entry_value, &values);
+                             if (!read_s.ok()) return false;
+                           } else if (read_s.IsNotFound()) {
+                             read_s = rocksdb::Status::OK();
+                           } else {
+                             return false;
+                           }
+                           entries->emplace_back(pending.id.ToString(), std::move(values));
+                           return !options.with_count || options.count == 0 || entries->size() < options.count;
+                         });
+    if (!s.ok()) return s;
+    if (!read_s.ok()) return read_s;
+  }
+
+  putGroupState(ns_key, metadata, options.group, group, consumers, &batch);
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+rocksdb::Status Stream::Ack(const Slice &stream_name, const std::string &group_name,
+                            const std::vector<StreamEntryID> &ids, uint64_t *ret) {
+  *ret = 0;
+  std::string ns_key;
+  AppendNamespacePrefix(stream_name, &ns_key);
+
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  StreamMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+
+  StreamGroupMetadata group;
+  s = getGroup(ns_key, metadata, group_name, &group);
+  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisStream);
+  batch.PutLogData(log_data.Encode());
+
+  std::map<std::string, StreamConsumerMetadata> consumers;
+  std::set<StreamEntryID> acked;
+  for (const auto &id : ids) {
+    if (!acked.insert(id).second) continue;
+
+    StreamPendingEntry pending;
+    s = getPendingEntry(ns_key, metadata, group_name, id, &pending);
+    if (s.IsNotFound()) continue;
+    if (!s.ok()) return s;
+
+    s = removePendingEntry(ns_key, metadata, group_name, pending, &group, &consumers, &batch);
+    if (!s.ok()) return s;
+    *ret += 1;
+  }
+  if (*ret == 0) return rocksdb::Status::OK();
+
+  putGroupState(ns_key, metadata, group_name, group, consumers, &batch);
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+rocksdb::Status Stream::Claim(const Slice &stream_name, const std::string &group_name,
+                              const std::string &consumer_name, const StreamClaimOptions &options,
+                              const std::vector<StreamEntryID> &ids, std::vector<StreamEntry> *entries) {
+  entries->clear();
+  std::string ns_key;
+  AppendNamespacePrefix(stream_name, &ns_key);
+
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  StreamMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+
+  StreamGroupMetadata group;
+  s = getGroup(ns_key, metadata, group_name, &group);
+  if (!s.ok()) return s;
+
+  std::map<std::string, StreamConsumerMetadata> consumers;
+  s = loadConsumer(ns_key, metadata, group_name, consumer_name, &consumers);
+  if (s.IsNotFound()) {
+    consumers[consumer_name] = StreamConsumerMetadata{};
+    group.consumers++;
+  } else if (!s.ok()) {
+    return s;
+  }
+  uint64_t now = Util::GetTimeStampMS();
+  consumers[consumer_name].seen_time = now;
+
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisStream);
+  batch.PutLogData(log_data.Encode());
+
+  if (options.with_last_id && group.last_delivered_id < options.last_id) {
+    group.last_delivered_id = options.last_id;
+  }
+
+  std::set<StreamEntryID> claimed;
+  for (const auto &id : ids) {
+    if (!claimed.insert(id).second) continue;
+
+    std::string entry_value;
+    s = getEntryRawValue(ns_key, metadata, id, &entry_value);
+    if (!s.ok() && !s.IsNotFound()) return s;
+    bool entry_exists = s.ok();
+
+    StreamPendingEntry pending;
+    s = getPendingEntry(ns_key, metadata, group_name, id, &pending);
+    if (!s.ok() && !s.IsNotFound()) return s;
+    if (s.IsNotFound()) {
+      if (!options.force || !entry_exists) continue;
+      // create the pending entry like it was delivered once as Redis does for FORCE
+      pending.id = id;
+      pending.consumer = consumer_name;
+      pending.delivery_count = 1;
+      group.pending++;
+      consumers[consumer_name].pending++;
+    } else {
+      if (!entry_exists) {
+        // the entry was deleted from the stream, so it's meaningless to keep it pending
+        s = removePendingEntry(ns_key, metadata, group_name, pending, &group, &consumers, &batch);
+        if (!s.ok()) return s;
+        continue;
+      }
+      if (options.min_idle_time > 0 &&
+          (now < pending.delivery_time || now - pending.delivery_time < options.min_idle_time)) {
+        continue;
+      }
+      deletePendingEntry(ns_key, metadata, group_name, pending, &batch);
+      s = transferPendingEntry(ns_key, metadata, group_name, consumer_name, &pending, &consumers);
+      if (!s.ok()) return s;
+    }
+
+    pending.delivery_time = options.with_delivery_time ? options.delivery_time : now;
+    if (options.with_retry_count) {
+      pending.delivery_count = options.retry_count;
+    } else if (!options.just_id) {
+      pending.delivery_count++;
+    }
+    putPendingEntry(ns_key, metadata, group_name, pending, &batch);
+
+    std::vector<std::string> values;
+    if (!options.just_id) {
+      s = decodeEntryValue(metadata, id, entry_value, &values);
+      if (!s.ok()) return s;
+    }
+    entries->emplace_back(id.ToString(), std::move(values));
+  }
+
+  putGroupState(ns_key, metadata, group_name, group, consumers, &batch);
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+rocksdb::Status Stream::AutoClaim(const Slice &stream_name, const std::string &group_name,
+                                  const std::string &consumer_name, const StreamAutoClaimOptions &options,
+                                  StreamAutoClaimResult *result) {
+  result->next_start.Clear();
+  result->entries.clear();
+  result->deleted_ids.clear();
+  std::string ns_key;
+  AppendNamespacePrefix(stream_name, &ns_key);
+
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  StreamMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+
+  StreamGroupMetadata group;
+  s = getGroup(ns_key, metadata, group_name, &group);
+  if (!s.ok()) return s;
+
+  std::map<std::string, StreamConsumerMetadata> consumers;
+  s = loadConsumer(ns_key, metadata, group_name, consumer_name, &consumers);
+  if (s.IsNotFound()) {
+    consumers[consumer_name] = StreamConsumerMetadata{};
+    group.consumers++;
+  } else if (!s.ok()) {
+    return s;
+  }
+  uint64_t now = Util::GetTimeStampMS();
+  consumers[consumer_name].seen_time = now;
+
+  // Only the entries delivered before the deadline are idle enough, so the delivery time
+  // index is scanned up to it instead of the whole PEL. The smallest IDs after the start
+  // are claimed to keep the cursor semantics, and one more is kept as the next cursor.
+  std::set<StreamEntryID> candidates;
+  if (options.min_idle_time <= now) {
+    uint64_t deadline = now - options.min_idle_time;
+    s = scanGroupSubkeys(ns_key, metadata, groupSubkeyPrefix(StreamSubkeyType::kPendingTime, group_name), "", false,
+                         [&](const Slice &suffix, const Slice &) {
+                           Slice input = suffix;
+                           uint64_t delivery_time = 0;
+                           StreamEntryID id;
+                           if (!GetFixed64(&input, &delivery_time) || !GetFixed64(&input, &id.ms) ||
+                               !GetFixed64(&input, &id.seq)) {
+                             return true;
+                           }
+                           if (delivery_time > deadline) return false;
+                           if (id < options.start) return true;
+                           candidates.insert(id);
+                           if (candidates.size() > options.count + 1) candidates.erase(std::prev(candidates.end()));
+                           return true;
+                         });
+    if (!s.ok()) return s;
+  }
+  if (candidates.size() > options.count) {
+    result->next_start = *std::prev(candidates.end());
+    candidates.erase(std::prev(candidates.end()));
+  }
+
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisStream);
+  batch.PutLogData(log_data.Encode());
+
+  for (const auto &id : candidates) {
+    StreamPendingEntry pending;
+    s = getPendingEntry(ns_key, metadata, group_name, id, &pending);
+    if (s.IsNotFound()) continue;
+    if (!s.ok()) return s;
+
+    std::string entry_value;
+    s = getEntryRawValue(ns_key, metadata, id, &entry_value);
+    if (s.IsNotFound()) {
+      s = removePendingEntry(ns_key, metadata, group_name, pending, &group, &consumers, &batch);
+      if (!s.ok()) return s;
+      result->deleted_ids.emplace_back(id.ToString());
+      continue;
+    }
+    if (!s.ok()) return s;
+
+    deletePendingEntry(ns_key, metadata, group_name, pending, &batch);
+    s = transferPendingEntry(ns_key, metadata, group_name, consumer_name, &pending, &consumers);
+    if (!s.ok()) return s;
+    pending.delivery_time = now;
+    if (!options.just_id) pending.delivery_count++;
+    putPendingEntry(ns_key, metadata, group_name, pending, &batch);
+
+    std::vector<std::string> values;
+    if (!options.just_id) {
+      s = decodeEntryValue(metadata, id, entry_value, &values);
+      if (!s.ok()) return s;
+    }
+    result->entries.emplace_back(id.ToString(), std::move(values));
+  }
+
+  putGroupState(ns_key, metadata, group_name, group, consumers, &batch);
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
+rocksdb::Status Stream::GetPendingSummary(const Slice &stream_name, const std::string &group_name,
+                                          StreamPendingSummary *summary) {
+  std::string ns_key;
+  AppendNamespacePrefix(stream_name, &ns_key);
+
+  StreamMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+
+  StreamGroupMetadata group;
+  s = getGroup(ns_key, metadata, group_name, &group);
+  if (!s.ok()) return s;
+
+  summary->pending = group.pending;
+  summary->consumers.clear();
+  if (group.pending == 0) return rocksdb::Status::OK();
+
+  std::string prefix = groupSubkeyPrefix(StreamSubkeyType::kPending, group_name);
+  auto get_id = [](StreamEntryID *id) {
+    return [id](const Slice &suffix, const Slice &) {
+      Slice input = suffix;
+      GetFixed64(&input, &id->ms);
+      GetFixed64(&input, &id->seq);
+      return false;
+    };
+  };
+  s = scanGroupSubkeys(ns_key, metadata, prefix, "", false, get_id(&summary->first_id));
+  if (!s.ok()) return s;
+  s = scanGroupSubkeys(ns_key, metadata, prefix, encodePendingID(StreamEntryID::Maximum()), true,
+                       get_id(&summary->last_id));
+  if (!s.ok()) return s;
+
+  std::vector<std::pair<std::string, StreamConsumerMetadata>> consumers;
+  s = GetConsumers(stream_name, group_name, &consumers);
+  if (!s.ok()) return s;
+  for (const auto &consumer : consumers) {
+    if (consumer.second.pending > 0) summary->consumers.emplace_back(consumer.first, consumer.second.pending);
+  }
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status Stream::GetPendingEntries(const Slice &stream_name, const std::string &group_name,
+                                          const StreamPendingOptions &options,
+                                          std::vector<StreamPendingEntry> *entries) {
+  entries->clear();
+  std::string ns_key;
+  AppendNamespacePrefix(stream_name, &ns_key);
+
+  StreamMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+
+  StreamGroupMetadata group;
+  s = getGroup(ns_key, metadata, group_name, &group);
+  if (!s.ok()) return s;
+  if (options.count == 0 || options.end < options.start) return rocksdb::Status::OK();
+
+  uint64_t now = Util::GetTimeStampMS();
+  rocksdb::Status read_s;
+  s = scanGroupSubkeys(ns_key, metadata, groupSubkeyPrefix(StreamSubkeyType::kPending, group_name),
+                       encodePendingID(options.start), false, [&](const Slice &suffix, const Slice &value) {
+                         StreamPendingEntry pending;
+                         Slice input = suffix;
+                         if (!GetFixed64(&input, &pending.id.ms) || !GetFixed64(&input, &pending.id.seq)) {
+                           return true;
+                         }
+                         if (options.end < pending.id) return false;
+                         read_s = DecodeStreamPendingValue(value.ToString(), &pending);
+                         if (!read_s.ok()) return false;
+                         if (options.with_consumer && pending.consumer != options.consumer) return true;
+                         if (options.min_idle_time > 0 && (now < pending.delivery_time ||
+                                                           now - pending.delivery_time < options.min_idle_time)) {
+                           return true;
+                         }
+                         entries->emplace_back(std::move(pending));
+                         return entries->size() < options.count;
+                       });
+  if (!s.ok()) return s;
+  return read_s;
+}
+
+rocksdb::Status Stream::GetGroups(const Slice &stream_name,
+                                  std::vector<std::pair<std::string, StreamGroupMetadata>> *groups) {
+  groups->clear();
+  std::string ns_key;
+  AppendNamespacePrefix(stream_name, &ns_key);
+
+  StreamMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+
+  rocksdb::Status read_s;
+  s = scanGroupSubkeys(ns_key, metadata, groupSubkeyPrefix(StreamSubkeyType::kGroup), "", false,
+                       [&](const Slice &suffix, const Slice &value) {
+                         Slice input = suffix;
+                         uint32_t len = 0;
+                         if (!GetFixed32(&input, &len) || input.size() != len) return true;
+                         StreamGroupMetadata group;
+                         read_s = DecodeStreamGroupValue(value.ToString(), &group);
+                         if (!read_s.ok()) return false;
+                         groups->emplace_back(input.ToString(), group);
+                         return true;
+                       });
+  if (!s.ok()) return s;
+  return read_s;
+}
+
+rocksdb::Status Stream::GetConsumers(const Slice &stream_name, const std::string &group_name,
+                                     std::vector<std::pair<std::string, StreamConsumerMetadata>> *consumers) {
+  consumers->clear();
+  std::string ns_key;
+  AppendNamespacePrefix(stream_name, &ns_key);
+
+  StreamMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+
+  StreamGroupMetadata group;
+  s = getGroup(ns_key, metadata, group_name, &group);
+  if (!s.ok()) return s;
+
+  rocksdb::Status read_s;
+  s = scanGroupSubkeys(ns_key, metadata, groupSubkeyPrefix(StreamSubkeyType::kConsumer, group_name), "", false,
+                       [&](const Slice &suffix, const Slice &value) {
+                         StreamConsumerMetadata consumer;
+                         read_s = DecodeStreamConsumerValue(value.ToString(), &consumer);
+                         if (!read_s.ok()) return false;
+                         consumers->emplace_back(suffix.ToString(), consumer);
+                         return true;
+                       });
+  if (!s.ok()) return s;
+  return read_s;
+}
+
 }  // namespace Redis
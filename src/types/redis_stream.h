@@ -22,7 +22,10 @@
 
 #include <rocksdb/status.h>
 
+#include <functional>
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "storage/redis_db.h"
@@ -32,6 +35,15 @@ using rocksdb::Slice;
 
 namespace Redis {
 
+// The consumer groups are stored in the stream column family next to the entries, their subkeys
+// start with the maximum entry ID followed by the type byte, so they sort after all entries.
+enum class StreamSubkeyType : uint8_t {
+  kGroup = 1,
+  kConsumer = 2,
+  kPending = 3,
+  kPendingTime = 4,
+};
+
 class Stream : public SubKeyScanner {
  public:
   explicit Stream(Engine::Storage *storage, const std::string &ns)
@@ -45,6 +57,31 @@ class Stream : public SubKeyScanner {
   rocksdb::Status Trim(const Slice &stream_name, const StreamTrimOptions &options, uint64_t *ret);
   rocksdb::Status GetMetadata(const Slice &stream_name, StreamMetadata *metadata);
   rocksdb::Status GetLastGeneratedID(const Slice &stream_name, StreamEntryID *id);
+  rocksdb::Status CreateGroup(const Slice &stream_name, const std::string &group_name,
+                              const StreamCreateGroupOptions &options);
+  rocksdb::Status DestroyGroup(const Slice &stream_name, const std::string &group_name, uint64_t *ret);
+  rocksdb::Status SetGroupID(const Slice &stream_name, const std::string &group_name, const StreamEntryID &id,
+                             bool latest);
+  rocksdb::Status CreateConsumer(const Slice &stream_name, const std::string &group_name,
+                                 const std::string &consumer_name, uint64_t *ret);
+  rocksdb::Status DeleteConsumer(const Slice &stream_name, const std::string &group_name,
+                                 const std::string &consumer_name, uint64_t *ret);
+  rocksdb::Status ReadGroup(const Slice &stream_name, const StreamReadGroupOptions &options,
+                            std::vector<StreamEntry> *entries);
+  rocksdb::Status Ack(const Slice &stream_name, const std::string &group_name, const std::vector<StreamEntryID> &ids,
+                      uint64_t *ret);
+  rocksdb::Status Claim(const Slice &stream_name, const std::string &group_name, const std::string &consumer_name,
+                        const StreamClaimOptions &options, const std::vector<StreamEntryID> &ids,
+                        std::vector<StreamEntry> *entries);
+  rocksdb::Status AutoClaim(const Slice &stream_name, const std::string &group_name, const std::string &consumer_name,
+                            const StreamAutoClaimOptions &options, StreamAutoClaimResult *result);
+  rocksdb::Status GetPendingSummary(const Slice &stream_name, const std::string &group_name,
+                                    StreamPendingSummary *summary);
+  rocksdb::Status GetPendingEntries(const Slice &stream_name, const std::string &group_name,
+                                    const StreamPendingOptions &options, std::vector<StreamPendingEntry> *entries);
+  rocksdb::Status GetGroups(const Slice &stream_name, std::vector<std::pair<std::string, StreamGroupMetadata>> *groups);
+  rocksdb::Status GetConsumers(const Slice &stream_name, const std::string &group_name,
+                               std::vector<std::pair<std::string, StreamConsumerMetadata>> *consumers);
 
  private:
   rocksdb::ColumnFamilyHandle *stream_cf_handle_;
@@ -54,12 +91,51 @@ class Stream : public SubKeyScanner {
   rocksdb::Status getEntryRawValue(const std::string &ns_key, const StreamMetadata &metadata, const StreamEntryID &id,
                                    std::string *value) const;
   StreamEntryID entryIDFromInternalKey(const rocksdb::Slice &key) const;
+  static rocksdb::Status decodeEntryValue(const StreamMetadata &metadata, const StreamEntryID &id,
+                                          const std::string &value, std::vector<std::string> *result);
   std::string internalKeyFromEntryID(const std::string &ns_key, const StreamMetadata &metadata,
                                      const StreamEntryID &id) const;
   rocksdb::Status getNextEntryID(const StreamMetadata &metadata, const StreamAddOptions &options, bool first_entry,
                                  StreamEntryID *next_entry_id) const;
   uint64_t trim(const std::string &ns_key, const StreamTrimOptions &options, StreamMetadata *metadata,
-                rocksdb::WriteBatch *batch);
+                rocksdb::WriteBatch *batch, bool drop_by_compaction = false);
+  uint64_t applyRetention(const std::string &ns_key, StreamMetadata *metadata, rocksdb::WriteBatch *batch);
+
+  static std::string groupSubkeyPrefix(StreamSubkeyType type);
+  static std::string groupSubkeyPrefix(StreamSubkeyType type, const std::string &group_name);
+  std::string internalKeyFromSubkey(const std::string &ns_key, const StreamMetadata &metadata,
+                                    const std::string &sub_key) const;
+  std::string internalKeyFromGroupName(const std::string &ns_key, const StreamMetadata &metadata,
+                                       const std::string &group_name) const;
+  std::string internalKeyFromConsumerName(const std::string &ns_key, const StreamMetadata &metadata,
+                                          const std::string &group_name, const std::string &consumer_name) const;
+  rocksdb::Status scanGroupSubkeys(const std::string &ns_key, const StreamMetadata &metadata,
+                                   const std::string &sub_key_prefix, const std::string &start, bool reversed,
+                                   const std::function<bool(const Slice &, const Slice &)> &fn) const;
+  rocksdb::Status getGroup(const std::string &ns_key, const StreamMetadata &metadata, const std::string &group_name,
+                           StreamGroupMetadata *group) const;
+  rocksdb::Status loadConsumer(const std::string &ns_key, const StreamMetadata &metadata,
+                               const std::string &group_name, const std::string &consumer_name,
+                               std::map<std::string, StreamConsumerMetadata> *consumers) const;
+  rocksdb::Status getPendingEntry(const std::string &ns_key, const StreamMetadata &metadata,
+                                  const std::string &group_name, const StreamEntryID &id,
+                                  StreamPendingEntry *pending) const;
+  void putPendingEntry(const std::string &ns_key, const StreamMetadata &metadata, const std::string &group_name,
+                       const StreamPendingEntry &pending, rocksdb::WriteBatch *batch) const;
+  void deletePendingEntry(const std::string &ns_key, const StreamMetadata &metadata, const std::string &group_name,
+                          const StreamPendingEntry &pending, rocksdb::WriteBatch *batch) const;
+  rocksdb::Status removePendingEntry(const std::string &ns_key, const StreamMetadata &metadata,
+                                     const std::string &group_name, const StreamPendingEntry &pending,
+                                     StreamGroupMetadata *group,
+                                     std::map<std::string, StreamConsumerMetadata> *consumers,
+                                     rocksdb::WriteBatch *batch) const;
+  rocksdb::Status transferPendingEntry(const std::string &ns_key, const StreamMetadata &metadata,
+                                       const std::string &group_name, const std::string &consumer_name,
+                                       StreamPendingEntry *pending,
+                                       std::map<std::string, StreamConsumerMetadata> *consumers) const;
+  void putGroupState(const std::string &ns_key, const StreamMetadata &metadata, const std::string &group_name,
+                     const StreamGroupMetadata &group, const std::map<std::string, StreamConsumerMetadata> &consumers,
+                     rocksdb::WriteBatch *batch) const;
 };
 
 }  // namespace Redis
@@ -29,6 +29,7 @@ namespace Redis {
 const char *kErrLastEntryIdReached = "last possible entry id reached";
 const char *kErrInvalidEntryIdSpecified = "Invalid stream ID specified as stream command argument";
 const char *kErrDecodingStreamEntryValueFailure = "failed to decode stream entry value";
+const char *kErrDecodingStreamGroupValueFailure = "failed to decode stream consumer group value";
 
 rocksdb::Status IncrementStreamEntryID(StreamEntryID *id) {
   if (id->seq == UINT64_MAX) {
@@ -166,4 +167,101 @@ Status DecodeRawStreamEntryValue(const std::string &value, std::vector<std::stri
   return Status::OK();
 }
 
+std::string EncodeStreamEntryValue(uint32_t schema_id, const std::vector<std::string> &args) {
+  std::string dst;
+  PutVarint32(&dst, schema_id);
+  if (schema_id == 0) {
+    dst.append(EncodeStreamEntryValue(args));
+    return dst;
+  }
+  for (size_t i = 1; i < args.size(); i += 2) {
+    PutVarint32(&dst, args[i].size());
+    dst.append(args[i]);
+  }
+  return dst;
+}
+
+Status DecodeStreamEntryValue(const std::vector<std::vector<std::string>> &schemas, const std::string &value,
+                              std::vector<std::string> *result) {
+  result->clear();
+  rocksdb::Slice s(value);
+
+  uint32_t schema_id = 0;
+  if (!GetVarint32(&s, &schema_id) || schema_id > schemas.size()) {
+    return Status(Status::RedisParseErr, kErrDecodingStreamEntryValueFailure);
+  }
+  if (schema_id == 0) {
+    return DecodeRawStreamEntryValue(s.ToString(), result);
+  }
+
+  const auto &fields = schemas[schema_id - 1];
+  result->reserve(fields.size() * 2);
+  for (const auto &field : fields) {
+    uint32_t len = 0;
+    if (!GetVarint32(&s, &len) || s.size() < len) {
+      return Status(Status::RedisParseErr, kErrDecodingStreamEntryValueFailure);
+    }
+    result->emplace_back(field);
+    result->emplace_back(s.data(), len);
+    s.remove_prefix(len);
+  }
+  if (!s.empty()) {
+    return Status(Status::RedisParseErr, kErrDecodingStreamEntryValueFailure);
+  }
+
+  return Status::OK();
+}
+
+std::string EncodeStreamGroupValue(const StreamGroupMetadata &group) {
+  std::string dst;
+  PutFixed64(&dst, group.last_delivered_id.ms);
+  PutFixed64(&dst, group.last_delivered_id.seq);
+  PutFixed64(&dst, group.pending);
+  PutFixed64(&dst, group.consumers);
+  return dst;
+}
+
+rocksdb::Status DecodeStreamGroupValue(const std::string &value, StreamGroupMetadata *group) {
+  rocksdb::Slice input(value);
+  if (!GetFixed64(&input, &group->last_delivered_id.ms) || !GetFixed64(&input, &group->last_delivered_id.seq) ||
+      !GetFixed64(&input, &group->pending) || !GetFixed64(&input, &group->consumers)) {
+    return rocksdb::Status::Corruption(kErrDecodingStreamGroupValueFailure);
+  }
+  return rocksdb::Status::OK();
+}
+
+std::string EncodeStreamConsumerValue(const StreamConsumerMetadata &consumer) {
+  std::string dst;
+  PutFixed64(&dst, consumer.seen_time);
+  PutFixed64(&dst, consumer.pending);
+  return dst;
+}
+
+rocksdb::Status DecodeStreamConsumerValue(const std::string &value, StreamConsumerMetadata *consumer) {
+  rocksdb::Slice input(value);
+  if (!GetFixed64(&input, &consumer->seen_time) || !GetFixed64(&input, &consumer->pending)) {
+    return rocksdb::Status::Corruption(kErrDecodingStreamGroupValueFailure);
+  }
+  return rocksdb::Status::OK();
+}
+
+// The ID of a pending entry is a part of its key, so only the delivery state
+// and the owner is stored in the value.
+std::string EncodeStreamPendingValue(const StreamPendingEntry &pending) {
+  std::string dst;
+  PutFixed64(&dst, pending.delivery_time);
+  PutFixed64(&dst, pending.delivery_count);
+  dst.append(pending.consumer);
+  return dst;
+}
+
+rocksdb::Status DecodeStreamPendingValue(const std::string &value, StreamPendingEntry *pending) {
+  rocksdb::Slice input(value);
+  if (!GetFixed64(&input, &pending->delivery_time) || !GetFixed64(&input, &pending->delivery_count)) {
+    return rocksdb::Status::Corruption(kErrDecodingStreamGroupValueFailure);
+  }
+  pending->consumer = input.ToString();
+  return rocksdb::Status::OK();
+}
+
 }  // namespace Redis
@@ -101,6 +101,8 @@ struct StreamAddOptions {
   StreamTrimOptions trim_options;
   bool nomkstream = false;
   bool with_entry_id = false;
+  bool with_retention = false;
+  uint64_t retention_ms = 0;
 };
 
 struct StreamRangeOptions {
@@ -132,6 +134,85 @@ struct StreamReadResult {
       : name(std::move(name)), entries(std::move(result)) {}
 };
 
+struct StreamGroupMetadata {
+  StreamEntryID last_delivered_id;
+  uint64_t pending = 0;
+  uint64_t consumers = 0;
+};
+
+struct StreamConsumerMetadata {
+  uint64_t seen_time = 0;
+  uint64_t pending = 0;
+};
+
+// StreamPendingEntry is an entry of the pending entries list (PEL) of a consumer group,
+// which has been delivered to a consumer but not acknowledged yet.
+struct StreamPendingEntry {
+  StreamEntryID id;
+  std::string consumer;
+  uint64_t delivery_time = 0;
+  uint64_t delivery_count = 0;
+};
+
+struct StreamCreateGroupOptions {
+  StreamEntryID last_id;
+  bool latest = false;
+  bool mkstream = false;
+};
+
+struct StreamReadGroupOptions {
+  std::string group;
+  std::string consumer;
+  // read the entries which were never delivered to the group, or the pending entries
+  // of the consumer after the 'start' ID otherwise
+  bool new_entries = true;
+  StreamEntryID start;
+  uint64_t count = 0;
+  bool with_count = false;
+  bool noack = false;
+};
+
+struct StreamClaimOptions {
+  uint64_t min_idle_time = 0;
+  uint64_t delivery_time = 0;
+  bool with_delivery_time = false;
+  uint64_t retry_count = 0;
+  bool with_retry_count = false;
+  bool force = false;
+  bool just_id = false;
+  StreamEntryID last_id;
+  bool with_last_id = false;
+};
+
+struct StreamAutoClaimOptions {
+  uint64_t min_idle_time = 0;
+  StreamEntryID start;
+  uint64_t count = 100;
+  bool just_id = false;
+};
+
+struct StreamAutoClaimResult {
+  StreamEntryID next_start;
+  std::vector<StreamEntry> entries;
+  std::vector<std::string> deleted_ids;
+};
+
+struct StreamPendingOptions {
+  StreamEntryID start;
+  StreamEntryID end;
+  uint64_t count = 0;
+  uint64_t min_idle_time = 0;
+  std::string consumer;
+  bool with_consumer = false;
+};
+
+struct StreamPendingSummary {
+  uint64_t pending = 0;
+  StreamEntryID first_id;
+  StreamEntryID last_id;
+  std::vector<std::pair<std::string, uint64_t>> consumers;
+};
+
 rocksdb::Status IncrementStreamEntryID(StreamEntryID *id);
 rocksdb::Status GetNextStreamEntryID(const StreamEntryID &last_id, StreamEntryID *new_id);
 Status ParseStreamEntryID(const std::string &input, StreamEntryID *id);
@@ -140,5 +221,16 @@ Status ParseRangeStart(const std::string &input, StreamEntryID *id);
 Status ParseRangeEnd(const std::string &input, StreamEntryID *id);
 std::string EncodeStreamEntryValue(const std::vector<std::string> &args);
 Status DecodeRawStreamEntryValue(const std::string &value, std::vector<std::string> *result);
+// The schema encoded entry stores the values only if its field names are those of the schema schema_id,
+// or the raw field-value list after the schema_id 0
+std::string EncodeStreamEntryValue(uint32_t schema_id, const std::vector<std::string> &args);
+Status DecodeStreamEntryValue(const std::vector<std::vector<std::string>> &schemas, const std::string &value,
+                              std::vector<std::string> *result);
+std::string EncodeStreamGroupValue(const StreamGroupMetadata &group);
+rocksdb::Status DecodeStreamGroupValue(const std::string &value, StreamGroupMetadata *group);
+std::string EncodeStreamConsumerValue(const StreamConsumerMetadata &consumer);
+rocksdb::Status DecodeStreamConsumerValue(const std::string &value, StreamConsumerMetadata *consumer);
+std::string EncodeStreamPendingValue(const StreamPendingEntry &pending);
+rocksdb::Status DecodeStreamPendingValue(const std::string &value, StreamPendingEntry *pending);
 
 }  // namespace Redis
@@ -20,11 +20,15 @@
 
 #include "redis_string.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
+#include <map>
 #include <string>
 
 #include "parse_util.h"
+#include "storage/merge_operator.h"
 #include "time_util.h"
 
 namespace Redis {
@@ -34,12 +38,10 @@ std::vector<rocksdb::Status> String::getRawValues(const std::vector<Slice> &keys
   raw_values->clear();
 
   rocksdb::ReadOptions read_options;
-  LatestSnapShot ss(db_);
-  read_options.snapshot = ss.GetSnapShot();
   raw_values->resize(keys.size());
   std::vector<rocksdb::Status> statuses(keys.size());
   std::vector<rocksdb::PinnableSlice> pin_values(keys.size());
-  db_->MultiGet(read_options, metadata_cf_handle_, keys.size(), keys.data(), pin_values.data(), statuses.data(), false);
+  storage_->MultiGet(read_options, metadata_cf_handle_, keys.size(), keys.data(), pin_values.data(), statuses.data());
   for (size_t i = 0; i < keys.size(); i++) {
     if (!statuses[i].ok()) continue;
     (*raw_values)[i].assign(pin_values[i].data(), pin_values[i].size());
@@ -55,36 +57,173 @@ std::vector<rocksdb::Status> String::getRawValues(const std::vector<Slice> &keys
       statuses[i] = rocksdb::Status::InvalidArgument(kErrMsgWrongType);
       continue;
     }
+    if (metadata.IsChunkedString()) {
+      (*raw_values)[i].clear();
+      Metadata string_metadata(kRedisString, false);
+      string_metadata.expire = metadata.expire;
+      string_metadata.Encode(&(*raw_values)[i]);
+      statuses[i] = readChunks(keys[i], metadata, read_options.snapshot, 0, metadata.size, &(*raw_values)[i]);
+    }
   }
   return statuses;
 }
 
-rocksdb::Status String::getRawValue(const std::string &ns_key, std::string *raw_value) {
+rocksdb::Status String::getMetadataValue(const std::string &ns_key, const rocksdb::Snapshot *snapshot,
+                                         Metadata *metadata, std::string *raw_value) {
   raw_value->clear();
 
   rocksdb::ReadOptions read_options;
-  LatestSnapShot ss(db_);
-  read_options.snapshot = ss.GetSnapShot();
-  rocksdb::Status s = db_->Get(read_options, metadata_cf_handle_, ns_key, raw_value);
+  read_options.snapshot = snapshot;
+  rocksdb::Status s = storage_->Get(read_options, metadata_cf_handle_, ns_key, raw_value);
   if (!s.ok()) return s;
 
-  Metadata metadata(kRedisNone, false);
-  metadata.Decode(*raw_value);
-  if (metadata.Expired()) {
+  metadata->Decode(*raw_value);
+  if (metadata->Expired()) {
     raw_value->clear();
     return rocksdb::Status::NotFound(kErrMsgKeyExpired);
   }
-  if (metadata.Type() != kRedisString && metadata.size > 0) {
+  if (metadata->Type() != kRedisString && metadata->size > 0) {
     return rocksdb::Status::InvalidArgument(kErrMsgWrongType);
   }
   return rocksdb::Status::OK();
 }
 
+rocksdb::Status String::getMetadataValue(const std::string &ns_key, Metadata *metadata,
+                                         rocksdb::PinnableSlice *raw_value) {
+  raw_value->Reset();
+
+  rocksdb::ReadOptions read_options;
+  rocksdb::Status s = storage_->Get(read_options, metadata_cf_handle_, ns_key, raw_value);
+  if (!s.ok()) return s;
+
+  // Only the header is copied out to be decoded, the metadata of any type fits in it
+  metadata->Decode(std::string(raw_value->data(), std::min(raw_value->size(), kMetadataHeaderMaxSize)));
+  if (metadata->Expired()) {
+    raw_value->Reset();
+    return rocksdb::Status::NotFound(kErrMsgKeyExpired);
+  }
+  if (metadata->Type() != kRedisString && metadata->size > 0) {
+    return rocksdb::Status::InvalidArgument(kErrMsgWrongType);
+  }
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status String::GetRawValue(const std::string &ns_key, std::string *raw_value) {
+  // Most strings are read by a single Get, only the chunked ones take the snapshot to read the
+  // metadata and the chunks of the same version, so the metadata is read again under it
+  Metadata metadata(kRedisNone, false);
+  auto s = getMetadataValue(ns_key, nullptr, &metadata, raw_value);
+  if (!s.ok() || !metadata.IsChunkedString()) return s;
+
+  LatestSnapShot ss(db_);
+  s = getMetadataValue(ns_key, ss.GetSnapShot(), &metadata, raw_value);
+  if (!s.ok() || !metadata.IsChunkedString()) return s;
+
+  raw_value->clear();
+  Metadata string_metadata(kRedisString, false);
+  string_metadata.expire = metadata.expire;
+  string_metadata.Encode(raw_value);
+  return readChunks(ns_key, metadata, ss.GetSnapShot(), 0, metadata.size, raw_value);
+}
+
+// Append the count bytes of the chunked string from the offset to the value
+rocksdb::Status String::readChunks(const Slice &ns_key, const Metadata &metadata, const rocksdb::Snapshot *snapshot,
+                                   uint64_t offset, uint64_t count, std::string *value) {
+  if (count == 0) return rocksdb::Status::OK();
+
+  uint64_t first = offset / kStringChunkSize * kStringChunkSize;
+  std::vector<std::string> chunk_names;
+  for (uint64_t chunk_offset = first; chunk_offset < offset + count; chunk_offset += kStringChunkSize) {
+    chunk_names.emplace_back(std::to_string(chunk_offset));
+  }
+  std::vector<Slice> sub_keys(chunk_names.begin(), chunk_names.end());
+  std::vector<rocksdb::PinnableSlice> chunks;
+  std::vector<rocksdb::Status> statuses;
+  multiGetSubKeys(ns_key, metadata.version, sub_keys, &chunks, &statuses, snapshot);
+
+  size_t start = value->size();
+  value->append(count, '\0');
+  for (size_t i = 0; i < chunks.size(); i++) {
+    if (statuses[i].IsNotFound()) continue;
+    if (!statuses[i].ok()) return statuses[i];
+    uint64_t chunk_offset = first + i * kStringChunkSize;
+    uint64_t from = std::max(chunk_offset, offset);
+    uint64_t to = std::min(chunk_offset + chunks[i].size(), offset + count);
+    if (from < to) memcpy(&(*value)[start + from - offset], chunks[i].data() + from - chunk_offset, to - from);
+  }
+  return rocksdb::Status::OK();
+}
+
+// The string is written into the chunks if it's chunked already or would grow to the size
+bool String::isChunked(const Metadata &metadata, uint64_t size) const {
+  if (metadata.IsChunkedString()) return true;
+  auto min_bytes = static_cast<uint64_t>(storage_->GetConfig()->string_chunked_min_bytes);
+  return min_bytes > 0 && size >= min_bytes;
+}
+
+// Write the value at the offset of the chunked string and only touch the chunks in the range,
+// the inline string in raw_value is moved into the chunks of a new version at first.
+rocksdb::Status String::setRangeChunked(const std::string &ns_key, Metadata *metadata, const std::string &raw_value,
+                                        uint64_t offset, const std::string &value) {
+  std::map<uint64_t, std::string> chunks;
+  uint64_t size = 0;
+  if (metadata->IsChunkedString()) {
+    size = metadata->size;
+  } else {
+    Slice inline_value(raw_value.data() + STRING_HDR_SIZE, raw_value.size() - STRING_HDR_SIZE);
+    size = inline_value.size();
+    for (uint64_t chunk_offset = 0; chunk_offset < size; chunk_offset += kStringChunkSize) {
+      chunks[chunk_offset].assign(inline_value.data() + chunk_offset, std::min(kStringChunkSize, size - chunk_offset));
+    }
+    Metadata chunked_metadata(kRedisString);
+    chunked_metadata.flags |= kMetadataStringChunked;
+    chunked_metadata.expire = metadata->expire;
+    *metadata = chunked_metadata;
+  }
+  uint64_t end = offset + value.size();
+  if (end > std::numeric_limits<uint32_t>::max()) {
+    return rocksdb::Status::InvalidArgument("string exceeds maximum allowed size");
+  }
+
+  for (uint64_t chunk_offset = offset / kStringChunkSize * kStringChunkSize; chunk_offset < end;
+       chunk_offset += kStringChunkSize) {
+    uint64_t from = std::max(chunk_offset, offset);
+    uint64_t to = std::min(chunk_offset + kStringChunkSize, end);
+    auto iter = chunks.find(chunk_offset);
+    if (iter == chunks.end()) {
+      iter = chunks.emplace(chunk_offset, std::string()).first;
+      // Only the first and the last chunks might be overwritten partially
+      bool partial = from > chunk_offset || (to < chunk_offset + kStringChunkSize && to < size);
+      if (partial && chunk_offset < size) {
+        auto s = readChunks(ns_key, *metadata, nullptr, chunk_offset, std::min(kStringChunkSize, size - chunk_offset),
+                            &iter->second);
+        if (!s.ok()) return s;
+      }
+    }
+    auto &chunk = iter->second;
+    if (chunk.size() < to - chunk_offset) chunk.resize(to - chunk_offset, '\0');
+    memcpy(&chunk[from - chunk_offset], value.data() + from - offset, to - from);
+  }
+  metadata->size = static_cast<uint32_t>(std::max(size, end));
+
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisString);
+  batch.PutLogData(log_data.Encode());
+  std::string sub_key, bytes;
+  for (const auto &[chunk_offset, chunk] : chunks) {
+    InternalKey(ns_key, std::to_string(chunk_offset), metadata->version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
+    batch.Put(sub_key, chunk);
+  }
+  metadata->Encode(&bytes);
+  batch.Put(metadata_cf_handle_, ns_key, bytes);
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
 rocksdb::Status String::getValue(const std::string &ns_key, std::string *value) {
   value->clear();
 
   std::string raw_value;
-  auto s = getRawValue(ns_key, &raw_value);
+  auto s = GetRawValue(ns_key, &raw_value);
   if (!s.ok()) return s;
   *value = raw_value.substr(STRING_HDR_SIZE, raw_value.size() - STRING_HDR_SIZE);
   return rocksdb::Status::OK();
@@ -114,12 +253,20 @@ rocksdb::Status String::Append(const std::string &user_key, const std::string &v
 
   LockGuard guard(storage_->GetLockManager(), ns_key);
   std::string raw_value;
-  rocksdb::Status s = getRawValue(ns_key, &raw_value);
+  Metadata metadata(kRedisString, false);
+  rocksdb::Status s = getMetadataValue(ns_key, nullptr, &metadata, &raw_value);
   if (!s.ok() && !s.IsNotFound()) return s;
   if (s.IsNotFound()) {
-    Metadata metadata(kRedisString, false);
+    metadata = Metadata(kRedisString, false);
     metadata.Encode(&raw_value);
   }
+  uint64_t size = metadata.IsChunkedString() ? metadata.size : raw_value.size() - STRING_HDR_SIZE;
+  if (isChunked(metadata, size + value.size())) {
+    s = setRangeChunked(ns_key, &metadata, raw_value, size, value);
+    if (!s.ok()) return s;
+    *ret = static_cast<int>(metadata.size);
+    return rocksdb::Status::OK();
+  }
   raw_value.append(value);
   *ret = static_cast<int>(raw_value.size() - STRING_HDR_SIZE);
   return updateRawValue(ns_key, raw_value);
@@ -147,6 +294,24 @@ rocksdb::Status String::Get(const std::string &user_key, std::string *value) {
   return getValue(ns_key, value);
 }
 
+rocksdb::Status String::Get(const std::string &user_key, rocksdb::PinnableSlice *value) {
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+
+  Metadata metadata(kRedisNone, false);
+  auto s = getMetadataValue(ns_key, &metadata, value);
+  if (!s.ok()) return s;
+  if (metadata.IsChunkedString()) {
+    value->Reset();
+    s = getValue(ns_key, value->GetSelf());
+    if (!s.ok()) return s;
+    value->PinSelf();
+    return rocksdb::Status::OK();
+  }
+  value->remove_prefix(STRING_HDR_SIZE);
+  return rocksdb::Status::OK();
+}
+
 rocksdb::Status String::GetEx(const std::string &user_key, std::string *value, int ttl) {
   uint32_t expire = 0;
   if (ttl > 0) {
@@ -201,6 +366,32 @@ rocksdb::Status String::GetDel(const std::string &user_key, std::string *value)
   return storage_->Delete(storage_->DefaultWriteOptions(), metadata_cf_handle_, ns_key);
 }
 
+rocksdb::Status String::GetRange(const std::string &user_key, int start, int stop, std::string *value) {
+  value->clear();
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+
+  LatestSnapShot ss(db_);
+  Metadata metadata(kRedisNone, false);
+  std::string raw_value;
+  auto s = getMetadataValue(ns_key, ss.GetSnapShot(), &metadata, &raw_value);
+  if (!s.ok()) return s;
+
+  int64_t size = metadata.IsChunkedString() ? metadata.size : static_cast<int64_t>(raw_value.size()) - STRING_HDR_SIZE;
+  int64_t start_pos = start < 0 ? size + start : start;
+  int64_t stop_pos = stop < 0 ? size + stop : stop;
+  if (start_pos < 0) start_pos = 0;
+  if (stop_pos > size) stop_pos = size;
+  if (start_pos > stop_pos) return rocksdb::Status::NotFound();
+
+  auto count = static_cast<uint64_t>(std::min(stop_pos - start_pos + 1, size - start_pos));
+  if (!metadata.IsChunkedString()) {
+    value->assign(raw_value, STRING_HDR_SIZE + start_pos, count);
+    return rocksdb::Status::OK();
+  }
+  return readChunks(ns_key, metadata, ss.GetSnapShot(), start_pos, count, value);
+}
+
 rocksdb::Status String::Set(const std::string &user_key, const std::string &value) {
   std::vector<StringPair> pairs{StringPair{user_key, value}};
   return MSet(pairs, 0);
@@ -245,13 +436,16 @@ rocksdb::Status String::SetXX(const std::string &user_key, const std::string &va
 }
 
 rocksdb::Status String::SetRange(const std::string &user_key, int offset, const std::string &value, int *ret) {
+  if (offset < 0) return rocksdb::Status::InvalidArgument("offset is out of range");
+
   int size = 0;
   std::string ns_key;
   AppendNamespacePrefix(user_key, &ns_key);
 
   LockGuard guard(storage_->GetLockManager(), ns_key);
   std::string raw_value;
-  rocksdb::Status s = getRawValue(ns_key, &raw_value);
+  Metadata metadata(kRedisString, false);
+  rocksdb::Status s = getMetadataValue(ns_key, nullptr, &metadata, &raw_value);
   if (!s.ok() && !s.IsNotFound()) return s;
 
   if (s.IsNotFound()) {
@@ -261,9 +455,20 @@ rocksdb::Status String::SetRange(const std::string &user_key, int offset, const
       *ret = 0;
       return rocksdb::Status::OK();
     }
-    Metadata metadata(kRedisString, false);
+    metadata = Metadata(kRedisString, false);
     metadata.Encode(&raw_value);
   }
+  if (metadata.IsChunkedString() && value.empty()) {
+    *ret = static_cast<int>(metadata.size);
+    return rocksdb::Status::OK();
+  }
+  uint64_t old_size = metadata.IsChunkedString() ? metadata.size : raw_value.size() - STRING_HDR_SIZE;
+  if (isChunked(metadata, std::max(old_size, static_cast<uint64_t>(offset) + value.size()))) {
+    s = setRangeChunked(ns_key, &metadata, raw_value, offset, value);
+    if (!s.ok()) return s;
+    *ret = static_cast<int>(metadata.size);
+    return rocksdb::Status::OK();
+  }
   size = static_cast<int>(raw_value.size());
   offset += STRING_HDR_SIZE;
   if (offset > size) {
@@ -289,7 +494,7 @@ rocksdb::Status String::IncrBy(const std::string &user_key, int64_t increment, i
 
   LockGuard guard(storage_->GetLockManager(), ns_key);
   std::string raw_value;
-  rocksdb::Status s = getRawValue(ns_key, &raw_value);
+  rocksdb::Status s = GetRawValue(ns_key, &raw_value);
   if (!s.ok() && !s.IsNotFound()) return s;
   if (s.IsNotFound()) {
     Metadata metadata(kRedisString, false);
@@ -320,12 +525,25 @@ rocksdb::Status String::IncrBy(const std::string &user_key, int64_t increment, i
   return updateRawValue(ns_key, raw_value);
 }
 
+rocksdb::Status String::MergeIncrBy(const std::string &user_key, int64_t increment) {
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+
+  // The lock is still required, otherwise the increment may be lost by the concurrent read-modify-write
+  LockGuard guard(storage_->GetLockManager(), ns_key);
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisString);
+  batch.PutLogData(log_data.Encode());
+  batch.Merge(metadata_cf_handle_, ns_key, Engine::StringCounterMergeOperator::EncodeOperand(increment));
+  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+}
+
 rocksdb::Status String::IncrByFloat(const std::string &user_key, double increment, double *ret) {
   std::string ns_key, value;
   AppendNamespacePrefix(user_key, &ns_key);
   LockGuard guard(storage_->GetLockManager(), ns_key);
   std::string raw_value;
-  rocksdb::Status s = getRawValue(ns_key, &raw_value);
+  rocksdb::Status s = GetRawValue(ns_key, &raw_value);
   if (!s.ok() && !s.IsNotFound()) return s;
 
   if (s.IsNotFound()) {
@@ -334,16 +552,12 @@ rocksdb::Status String::IncrByFloat(const std::string &user_key, double incremen
   }
   value = raw_value.substr(STRING_HDR_SIZE, raw_value.size() - STRING_HDR_SIZE);
   double n = 0;
-  std::size_t idx = 0;
   if (!value.empty()) {
-    try {
-      n = std::stod(value, &idx);
-    } catch (std::exception &e) {
-      return rocksdb::Status::InvalidArgument("value is not an float");
-    }
-    if (isspace(value[0]) || idx != value.size()) {
+    auto parse_result = ParseFloat(value);
+    if (!parse_result) {
       return rocksdb::Status::InvalidArgument("value is not an float");
     }
+    n = *parse_result;
   }
 
   n += increment;
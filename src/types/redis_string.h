@@ -34,21 +34,31 @@ struct StringPair {
 namespace Redis {
 
 const int STRING_HDR_SIZE = 5;
+// The chunked string is split into the chunks of this size, each chunk is a subkey named by
+// its offset. The missing chunks and the missing tails of the chunks are zeros up to the length.
+constexpr uint64_t kStringChunkSize = 16 * 1024;
 
 class String : public Database {
  public:
   explicit String(Engine::Storage *storage, const std::string &ns) : Database(storage, ns) {}
   rocksdb::Status Append(const std::string &user_key, const std::string &value, int *ret);
   rocksdb::Status Get(const std::string &user_key, std::string *value);
+  // Read the value pinned in the block cache without copying it, only the chunked string is
+  // assembled into the buffer of the pinnable slice
+  rocksdb::Status Get(const std::string &user_key, rocksdb::PinnableSlice *value);
   rocksdb::Status GetEx(const std::string &user_key, std::string *value, int ttl);
   rocksdb::Status GetSet(const std::string &user_key, const std::string &new_value, std::string *old_value);
   rocksdb::Status GetDel(const std::string &user_key, std::string *value);
+  // Read the range like GETRANGE, NotFound is returned if the key doesn't exist or the range is empty
+  rocksdb::Status GetRange(const std::string &user_key, int start, int stop, std::string *value);
   rocksdb::Status Set(const std::string &user_key, const std::string &value);
   rocksdb::Status SetEX(const std::string &user_key, const std::string &value, int ttl);
   rocksdb::Status SetNX(const std::string &user_key, const std::string &value, int ttl, int *ret);
   rocksdb::Status SetXX(const std::string &user_key, const std::string &value, int ttl, int *ret);
   rocksdb::Status SetRange(const std::string &user_key, int offset, const std::string &value, int *ret);
   rocksdb::Status IncrBy(const std::string &user_key, int64_t increment, int64_t *ret);
+  // Increment the counter blindly with the merge operator, the failed increment is dropped silently
+  rocksdb::Status MergeIncrBy(const std::string &user_key, int64_t increment);
   rocksdb::Status IncrByFloat(const std::string &user_key, double increment, double *ret);
   std::vector<rocksdb::Status> MGet(const std::vector<Slice> &keys, std::vector<std::string> *values);
   rocksdb::Status MSet(const std::vector<StringPair> &pairs, int ttl = 0);
@@ -56,11 +66,21 @@ class String : public Database {
   rocksdb::Status CAS(const std::string &user_key, const std::string &old_value, const std::string &new_value, int ttl,
                       int *ret);
   rocksdb::Status CAD(const std::string &user_key, const std::string &value, int *ret);
+  // Read the header and the value of the string, the chunked string is read in the inline format
+  rocksdb::Status GetRawValue(const std::string &ns_key, std::string *raw_value);
 
  private:
   rocksdb::Status getValue(const std::string &ns_key, std::string *value);
   std::vector<rocksdb::Status> getValues(const std::vector<Slice> &ns_keys, std::vector<std::string> *values);
-  rocksdb::Status getRawValue(const std::string &ns_key, std::string *raw_value);
+  // Read the metadata value of the string, which has no value for the chunked string
+  rocksdb::Status getMetadataValue(const std::string &ns_key, const rocksdb::Snapshot *snapshot, Metadata *metadata,
+                                   std::string *raw_value);
+  rocksdb::Status getMetadataValue(const std::string &ns_key, Metadata *metadata, rocksdb::PinnableSlice *raw_value);
+  rocksdb::Status readChunks(const Slice &ns_key, const Metadata &metadata, const rocksdb::Snapshot *snapshot,
+                             uint64_t offset, uint64_t count, std::string *value);
+  bool isChunked(const Metadata &metadata, uint64_t size) const;
+  rocksdb::Status setRangeChunked(const std::string &ns_key, Metadata *metadata, const std::string &raw_value,
+                                  uint64_t offset, const std::string &value);
   std::vector<rocksdb::Status> getRawValues(const std::vector<Slice> &keys, std::vector<std::string> *raw_values);
   rocksdb::Status updateRawValue(const std::string &ns_key, const std::string &raw_value);
 };
@@ -22,13 +22,19 @@
 
 #include <math.h>
 
+#include <algorithm>
 #include <cmath>
 #include <limits>
 #include <map>
 #include <memory>
+#include <queue>
 #include <set>
+#include <string_view>
 
 #include "db_util.h"
+#include "parse_util.h"
+#include "redis_zset_rank_index.h"
+#include "storage/inline_iterator.h"
 
 namespace Redis {
 
@@ -46,17 +52,19 @@ rocksdb::Status ZSet::Add(const Slice &user_key, ZAddFlags flags, std::vector<Me
   ZSetMetadata metadata;
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok() && !s.IsNotFound()) return s;
+  bool fresh = s.IsNotFound();
 
   int added = 0;
   int changed = 0;
+  ZSetRankIndex rank_index(storage_, ns_key, metadata.version);
   rocksdb::WriteBatch batch;
   WriteBatchLogData log_data(kRedisZSet);
   batch.PutLogData(log_data.Encode());
-  std::string member_key;
-  std::set<std::string> added_member_keys;
+  ChunkedBatchWriter chunk_writer(storage_, &batch, &log_data, metadata.version);
+  // The members are unique under the same key and version, so they're deduplicated without encoding the subkeys
+  std::set<std::string_view> added_members;
+  std::vector<int> indexes;
   for (int i = static_cast<int>(mscores->size() - 1); i >= 0; i--) {
-    InternalKey(ns_key, (*mscores)[i].member, metadata.version, storage_->IsSlotIdEncoded()).Encode(&member_key);
-
     // Fix the corner case that adds the same member which may add the score
     // column family many times and cause problems in the ZRANGE command.
     //
@@ -66,14 +74,33 @@ rocksdb::Status ZSet::Add(const Slice &user_key, ZAddFlags flags, std::vector<Me
     // The root cause of this issue was the score key was composed by member and score,
     // so the last one can't overwrite the previous when the score was different.
     // A simple workaround was add those members with reversed order and skip the member if has added.
-    if (added_member_keys.find(member_key) != added_member_keys.end()) {
-      continue;
-    }
-    added_member_keys.insert(member_key);
+    if (added_members.insert((*mscores)[i].member).second) indexes.emplace_back(i);
+  }
+  if (fresh) {
+    // The new key which would outgrow the inlined members is written as the subkeys at once
+    int max_entries = storage_->GetConfig()->zset_inline_max_entries;
+    metadata.inlined = max_entries > 0 && indexes.size() <= static_cast<size_t>(max_entries);
+  }
 
+  // The old scores are read by one batched MultiGet under the lock, rather than a Get per member
+  std::vector<rocksdb::PinnableSlice> old_score_values;
+  std::vector<rocksdb::Status> statuses;
+  if (metadata.size > 0 && !metadata.inlined) {
+    std::vector<Slice> members;
+    members.reserve(indexes.size());
+    for (int i : indexes) members.emplace_back((*mscores)[i].member);
+    multiGetSubKeys(ns_key, metadata.version, members, &old_score_values, &statuses);
+  }
+  for (size_t j = 0; j < indexes.size(); j++) {
+    int i = indexes[j];
     if (metadata.size > 0) {
       std::string old_score_bytes;
-      s = db_->Get(rocksdb::ReadOptions(), member_key, &old_score_bytes);
+      if (metadata.inlined) {
+        s = getScore(ns_key, metadata, (*mscores)[i].member, &old_score_bytes);
+      } else {
+        s = statuses[j];
+        if (s.ok()) old_score_bytes.assign(old_score_values[j].data(), old_score_values[j].size());
+      }
       if (!s.ok() && !s.IsNotFound()) return s;
       if (s.ok()) {
         if (!s.IsNotFound() && flags.HasNX()) {
@@ -95,15 +122,8 @@ rocksdb::Status ZSet::Add(const Slice &user_key, ZAddFlags flags, std::vector<Me
             continue;
           }
           old_score_bytes.append((*mscores)[i].member);
-          std::string old_score_key;
-          InternalKey(ns_key, old_score_bytes, metadata.version, storage_->IsSlotIdEncoded()).Encode(&old_score_key);
-          batch.Delete(score_cf_handle_, old_score_key);
-          std::string new_score_bytes, new_score_key;
-          PutDouble(&new_score_bytes, (*mscores)[i].score);
-          batch.Put(member_key, new_score_bytes);
-          new_score_bytes.append((*mscores)[i].member);
-          InternalKey(ns_key, new_score_bytes, metadata.version, storage_->IsSlotIdEncoded()).Encode(&new_score_key);
-          batch.Put(score_cf_handle_, new_score_key, Slice());
+          deleteMember(ns_key, &metadata, old_score_bytes, &batch, &rank_index);
+          putMember(ns_key, &metadata, (*mscores)[i].member, (*mscores)[i].score, &batch, &rank_index);
           changed++;
         }
         continue;
@@ -112,25 +132,30 @@ rocksdb::Status ZSet::Add(const Slice &user_key, ZAddFlags flags, std::vector<Me
     if (flags.HasXX()) {
       continue;
     }
-    std::string score_bytes, score_key;
-    PutDouble(&score_bytes, (*mscores)[i].score);
-    batch.Put(member_key, score_bytes);
-    score_bytes.append((*mscores)[i].member);
-    InternalKey(ns_key, score_bytes, metadata.version, storage_->IsSlotIdEncoded()).Encode(&score_key);
-    batch.Put(score_cf_handle_, score_key, Slice());
+    putMember(ns_key, &metadata, (*mscores)[i].member, (*mscores)[i].score, &batch, &rank_index);
     added++;
+    // The members of the new key are invisible until its metadata is written by the last batch,
+    // the rank index merges the written members with the recorded ones when it's built
+    if (fresh && !metadata.inlined) {
+      s = chunk_writer.WriteIfFull();
+      if (!s.ok()) return s;
+    }
   }
   if (added > 0) {
     *ret = added;
     metadata.size += added;
-    std::string bytes;
-    metadata.Encode(&bytes);
-    batch.Put(metadata_cf_handle_, ns_key, bytes);
+  }
+  if (added > 0 || (changed > 0 && metadata.inlined)) {
+    s = putMetadata(ns_key, &metadata, &batch, &rank_index);
+    if (!s.ok()) return s;
+  } else if (changed > 0) {
+    s = rank_index.Update(metadata.size, &batch);
+    if (!s.ok()) return s;
   }
   if (flags.HasCH()) {
     *ret += changed;
   }
-  return storage_->Write(storage_->DefaultWriteOptions(), &batch);
+  return chunk_writer.Write();
 }
 
 rocksdb::Status ZSet::Card(const Slice &user_key, int *ret) {
@@ -185,6 +210,7 @@ rocksdb::Status ZSet::Pop(const Slice &user_key, int count, bool min, std::vecto
   rocksdb::WriteBatch batch;
   WriteBatchLogData log_data(kRedisZSet);
   batch.PutLogData(log_data.Encode());
+  ZSetRankIndex rank_index(storage_, ns_key, metadata.version);
 
   rocksdb::ReadOptions read_options;
   LatestSnapShot ss(db_);
@@ -195,7 +221,7 @@ rocksdb::Status ZSet::Pop(const Slice &user_key, int count, bool min, std::vecto
   read_options.iterate_lower_bound = &lower_bound;
   read_options.fill_cache = false;
 
-  auto iter = DBUtil::UniqueIterator(db_, read_options, score_cf_handle_);
+  auto iter = newIterator(ns_key, metadata, read_options, true);
   iter->Seek(start_key);
   // see comment in rangebyscore()
   if (!min && (!iter->Valid() || !iter->key().starts_with(prefix_key))) {
@@ -204,24 +230,44 @@ rocksdb::Status ZSet::Pop(const Slice &user_key, int count, bool min, std::vecto
   for (; iter->Valid() && iter->key().starts_with(prefix_key); min ? iter->Next() : iter->Prev()) {
     InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
     Slice score_key = ikey.GetSubKey();
+    deleteMember(ns_key, &metadata, score_key, &batch, &rank_index);
     GetDouble(&score_key, &score);
     mscores->emplace_back(MemberScore{score_key.ToString(), score});
-    std::string default_cf_key;
-    InternalKey(ns_key, score_key, metadata.version, storage_->IsSlotIdEncoded()).Encode(&default_cf_key);
-    batch.Delete(default_cf_key);
-    batch.Delete(score_cf_handle_, iter->key());
     if (mscores->size() >= static_cast<unsigned>(count)) break;
   }
 
   if (!mscores->empty()) {
     metadata.size -= mscores->size();
-    std::string bytes;
-    metadata.Encode(&bytes);
-    batch.Put(metadata_cf_handle_, ns_key, bytes);
+    s = putMetadata(ns_key, &metadata, &batch, &rank_index);
+    if (!s.ok()) return s;
   }
   return storage_->Write(storage_->DefaultWriteOptions(), &batch);
 }
 
+// Pop the members from the first non-empty sorted set of the keys, which are all locked while
+// they're checked in order, so the pop is atomic across the keys.
+rocksdb::Status ZSet::MPop(const std::vector<Slice> &user_keys, int count, bool min, std::string *popped_key,
+                           std::vector<MemberScore> *mscores) {
+  mscores->clear();
+
+  std::vector<std::string> ns_keys;
+  for (const auto &user_key : user_keys) {
+    std::string ns_key;
+    AppendNamespacePrefix(user_key, &ns_key);
+    ns_keys.emplace_back(std::move(ns_key));
+  }
+  ReentrantMultiLockGuard guard(storage_->GetLockManager(), ns_keys);
+  for (const auto &user_key : user_keys) {
+    auto s = Pop(user_key, count, min, mscores);
+    if (!s.ok()) return s;
+    if (mscores->empty()) continue;
+
+    *popped_key = user_key.ToString();
+    return rocksdb::Status::OK();
+  }
+  return rocksdb::Status::NotFound();
+}
+
 rocksdb::Status ZSet::Range(const Slice &user_key, int start, int stop, uint8_t flags,
                             std::vector<MemberScore> *mscores) {
   mscores->clear();
@@ -255,6 +301,7 @@ rocksdb::Status ZSet::Range(const Slice &user_key, int start, int stop, uint8_t
   int count = 0;
   int removed_subkey = 0;
   rocksdb::ReadOptions read_options;
+  storage_->SetLongScanReadOptions(&read_options);
   LatestSnapShot ss(db_);
   read_options.snapshot = ss.GetSnapShot();
   rocksdb::Slice upper_bound(next_verison_prefix_key);
@@ -264,11 +311,29 @@ rocksdb::Status ZSet::Range(const Slice &user_key, int start, int stop, uint8_t
   read_options.fill_cache = false;
 
   rocksdb::WriteBatch batch;
-  auto iter = DBUtil::UniqueIterator(db_, read_options, score_cf_handle_);
-  iter->Seek(start_key);
-  // see comment in rangebyscore()
-  if (reversed && (!iter->Valid() || !iter->key().starts_with(prefix_key))) {
-    iter->SeekForPrev(start_key);
+  ZSetRankIndex rank_index(storage_, ns_key, metadata.version);
+  auto iter = newIterator(ns_key, metadata, read_options, true);
+  // Skip the blocks before the start member if the sorted set has the rank index
+  bool located = false;
+  if (!metadata.inlined && start > 0 && start < static_cast<int>(metadata.size)) {
+    uint64_t pos = !reversed ? start : metadata.size - 1 - start;
+    uint64_t block_pos = 0;
+    std::string block_start, block_key;
+    s = rank_index.LocatePosition(ss.GetSnapShot(), pos, &block_pos, &block_start);
+    if (!s.ok() && !s.IsNotFound()) return s;
+    if (s.ok()) {
+      InternalKey(ns_key, block_start, metadata.version, storage_->IsSlotIdEncoded()).Encode(&block_key);
+      for (iter->Seek(block_key); iter->Valid() && block_pos < pos; block_pos++) iter->Next();
+      count = start;
+      located = true;
+    }
+  }
+  if (!located) {
+    iter->Seek(start_key);
+    // see comment in rangebyscore()
+    if (reversed && (!iter->Valid() || !iter->key().starts_with(prefix_key))) {
+      iter->SeekForPrev(start_key);
+    }
   }
 
   for (; iter->Valid() && iter->key().starts_with(prefix_key); !reversed ? iter->Next() : iter->Prev()) {
@@ -277,10 +342,7 @@ rocksdb::Status ZSet::Range(const Slice &user_key, int start, int stop, uint8_t
     GetDouble(&score_key, &score);
     if (count >= start) {
       if (removed) {
-        std::string sub_key;
-        InternalKey(ns_key, score_key, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-        batch.Delete(sub_key);
-        batch.Delete(score_cf_handle_, iter->key());
+        deleteMember(ns_key, &metadata, ikey.GetSubKey(), &batch, &rank_index);
         removed_subkey++;
       }
       mscores->emplace_back(MemberScore{score_key.ToString(), score});
@@ -290,9 +352,8 @@ rocksdb::Status ZSet::Range(const Slice &user_key, int start, int stop, uint8_t
 
   if (removed_subkey) {
     metadata.size -= removed_subkey;
-    std::string bytes;
-    metadata.Encode(&bytes);
-    batch.Put(metadata_cf_handle_, ns_key, bytes);
+    s = putMetadata(ns_key, &metadata, &batch, &rank_index);
+    if (!s.ok()) return s;
     return storage_->Write(storage_->DefaultWriteOptions(), &batch);
   }
   return rocksdb::Status::OK();
@@ -357,6 +418,7 @@ rocksdb::Status ZSet::RangeByScore(const Slice &user_key, ZRangeSpec spec, std::
   InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_verison_prefix_key);
 
   rocksdb::ReadOptions read_options;
+  storage_->SetLongScanReadOptions(&read_options);
   LatestSnapShot ss(db_);
   read_options.snapshot = ss.GetSnapShot();
   rocksdb::Slice upper_bound(next_verison_prefix_key);
@@ -366,10 +428,21 @@ rocksdb::Status ZSet::RangeByScore(const Slice &user_key, ZRangeSpec spec, std::
   read_options.fill_cache = false;
 
   int pos = 0;
-  auto iter = DBUtil::UniqueIterator(db_, read_options, score_cf_handle_);
+  auto iter = newIterator(ns_key, metadata, read_options, true);
   rocksdb::WriteBatch batch;
   WriteBatchLogData log_data(kRedisZSet);
   batch.PutLogData(log_data.Encode());
+  ZSetRankIndex rank_index(storage_, ns_key, metadata.version);
+
+  // The removed score keys are contiguous if there's no limit, so a large removal deletes them
+  // with one range deletion in the score column family. The member keys aren't ordered by
+  // the score, they are still deleted one by one.
+  auto min_elements = static_cast<size_t>(storage_->GetConfig()->range_delete_min_elements);
+  // The transaction deletes the keys of the range one by one anyway, see Storage::Write
+  bool score_range = spec.removed && !metadata.inlined && spec.offset < 0 && spec.count <= 0 && min_elements > 0 &&
+                     !storage_->InTxn();
+  std::vector<std::string> score_keys;
+  std::string first_score_key, last_score_key;
   if (!spec.reversed) {
     iter->Seek(start_key);
   } else {
@@ -393,10 +466,13 @@ rocksdb::Status ZSet::RangeByScore(const Slice &user_key, ZRangeSpec spec, std::
     }
     if (spec.offset >= 0 && pos++ < spec.offset) continue;
     if (spec.removed) {
-      std::string sub_key;
-      InternalKey(ns_key, score_key, metadata.version, storage_->IsSlotIdEncoded()).Encode(&sub_key);
-      batch.Delete(sub_key);
-      batch.Delete(score_cf_handle_, iter->key());
+      deleteMember(ns_key, &metadata, ikey.GetSubKey(), &batch, &rank_index, !score_range);
+      if (score_range) {
+        // keep the keys in the ascending order, though the removal may be iterated in reverse
+        if (first_score_key.empty() || !spec.reversed) last_score_key = iter->key().ToString();
+        if (first_score_key.empty() || spec.reversed) first_score_key = iter->key().ToString();
+        if (score_keys.size() < min_elements) score_keys.emplace_back(iter->key().ToString());
+      }
     } else {
       if (mscores) mscores->emplace_back(MemberScore{score_key.ToString(), score});
     }
@@ -404,11 +480,18 @@ rocksdb::Status ZSet::RangeByScore(const Slice &user_key, ZRangeSpec spec, std::
     if (spec.count > 0 && mscores && mscores->size() >= static_cast<unsigned>(spec.count)) break;
   }
 
+  if (score_range && static_cast<size_t>(*size) >= min_elements) {
+    batch.DeleteRange(score_cf_handle_, first_score_key, last_score_key + '\0');
+  } else {
+    for (const auto &key : score_keys) {
+      batch.Delete(score_cf_handle_, key);
+    }
+  }
+
   if (spec.removed && *size > 0) {
     metadata.size -= *size;
-    std::string bytes;
-    metadata.Encode(&bytes);
-    batch.Put(metadata_cf_handle_, ns_key, bytes);
+    s = putMetadata(ns_key, &metadata, &batch, &rank_index);
+    if (!s.ok()) return s;
     return storage_->Write(storage_->DefaultWriteOptions(), &batch);
   }
   return rocksdb::Status::OK();
@@ -440,6 +523,7 @@ rocksdb::Status ZSet::RangeByLex(const Slice &user_key, const ZRangeLexSpec &spe
   InternalKey(ns_key, "", metadata.version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix_key);
 
   rocksdb::ReadOptions read_options;
+  storage_->SetLongScanReadOptions(&read_options);
   LatestSnapShot ss(db_);
   read_options.snapshot = ss.GetSnapShot();
   rocksdb::Slice upper_bound(next_version_prefix_key);
@@ -449,10 +533,11 @@ rocksdb::Status ZSet::RangeByLex(const Slice &user_key, const ZRangeLexSpec &spe
   read_options.fill_cache = false;
 
   int pos = 0;
-  auto iter = DBUtil::UniqueIterator(db_, read_options);
+  auto iter = newIterator(ns_key, metadata, read_options, false);
   rocksdb::WriteBatch batch;
   WriteBatchLogData log_data(kRedisZSet);
   batch.PutLogData(log_data.Encode());
+  ZSetRankIndex rank_index(storage_, ns_key, metadata.version);
 
   if (!spec.reversed) {
     iter->Seek(start_key);
@@ -482,10 +567,7 @@ rocksdb::Status ZSet::RangeByLex(const Slice &user_key, const ZRangeLexSpec &spe
     if (spec.removed) {
       std::string score_bytes = iter->value().ToString();
       score_bytes.append(member.data(), member.size());
-      std::string score_key;
-      InternalKey(ns_key, score_bytes, metadata.version, storage_->IsSlotIdEncoded()).Encode(&score_key);
-      batch.Delete(score_cf_handle_, score_key);
-      batch.Delete(iter->key());
+      deleteMember(ns_key, &metadata, score_bytes, &batch, &rank_index);
     } else {
       if (members) members->emplace_back(member.ToString());
     }
@@ -495,9 +577,8 @@ rocksdb::Status ZSet::RangeByLex(const Slice &user_key, const ZRangeLexSpec &spe
 
   if (spec.removed && size && *size > 0) {
     metadata.size -= *size;
-    std::string bytes;
-    metadata.Encode(&bytes);
-    batch.Put(metadata_cf_handle_, ns_key, bytes);
+    s = putMetadata(ns_key, &metadata, &batch, &rank_index);
+    if (!s.ok()) return s;
     return storage_->Write(storage_->DefaultWriteOptions(), &batch);
   }
   return rocksdb::Status::OK();
@@ -510,13 +591,8 @@ rocksdb::Status ZSet::Score(const Slice &user_key, const Slice &member, double *
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok()) return s;
 
-  rocksdb::ReadOptions read_options;
-  LatestSnapShot ss(db_);
-  read_options.snapshot = ss.GetSnapShot();
-
-  std::string member_key, score_bytes;
-  InternalKey(ns_key, member, metadata.version, storage_->IsSlotIdEncoded()).Encode(&member_key);
-  s = db_->Get(read_options, member_key, &score_bytes);
+  std::string score_bytes;
+  s = getScore(ns_key, metadata, member, &score_bytes);
   if (!s.ok()) return s;
   *score = DecodeDouble(score_bytes.data());
   return rocksdb::Status::OK();
@@ -536,25 +612,21 @@ rocksdb::Status ZSet::Remove(const Slice &user_key, const std::vector<Slice> &me
   WriteBatchLogData log_data(kRedisZSet);
   batch.PutLogData(log_data.Encode());
   int removed = 0;
-  std::string member_key, score_key;
+  ZSetRankIndex rank_index(storage_, ns_key, metadata.version);
   for (const auto &member : members) {
-    InternalKey(ns_key, member, metadata.version, storage_->IsSlotIdEncoded()).Encode(&member_key);
     std::string score_bytes;
-    s = db_->Get(rocksdb::ReadOptions(), member_key, &score_bytes);
+    s = getScore(ns_key, metadata, member, &score_bytes);
     if (s.ok()) {
       score_bytes.append(member.data(), member.size());
-      InternalKey(ns_key, score_bytes, metadata.version, storage_->IsSlotIdEncoded()).Encode(&score_key);
-      batch.Delete(member_key);
-      batch.Delete(score_cf_handle_, score_key);
+      deleteMember(ns_key, &metadata, score_bytes, &batch, &rank_index);
       removed++;
     }
   }
   if (removed > 0) {
     *ret = removed;
     metadata.size -= removed;
-    std::string bytes;
-    metadata.Encode(&bytes);
-    batch.Put(metadata_cf_handle_, ns_key, bytes);
+    s = putMetadata(ns_key, &metadata, &batch, &rank_index);
+    if (!s.ok()) return s;
   }
   return storage_->Write(storage_->DefaultWriteOptions(), &batch);
 }
@@ -589,9 +661,8 @@ rocksdb::Status ZSet::Rank(const Slice &user_key, const Slice &member, bool reve
   rocksdb::ReadOptions read_options;
   LatestSnapShot ss(db_);
   read_options.snapshot = ss.GetSnapShot();
-  std::string score_bytes, member_key;
-  InternalKey(ns_key, member, metadata.version, storage_->IsSlotIdEncoded()).Encode(&member_key);
-  s = db_->Get(read_options, member_key, &score_bytes);
+  std::string score_bytes;
+  s = getScore(ns_key, metadata, member, &score_bytes);
   if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
 
   double target_score = DecodeDouble(score_bytes.data());
@@ -609,7 +680,28 @@ rocksdb::Status ZSet::Rank(const Slice &user_key, const Slice &member, bool reve
   read_options.iterate_lower_bound = &lower_bound;
   read_options.fill_cache = false;
 
-  auto iter = DBUtil::UniqueIterator(db_, read_options, score_cf_handle_);
+  auto iter = newIterator(ns_key, metadata, read_options, true);
+
+  // Count the members from the start of the block which contains the member if the
+  // sorted set has the rank index, instead of the start of the sorted set
+  uint64_t block_pos = 0;
+  std::string block_start, target_score_member = score_bytes + member.ToString();
+  ZSetRankIndex rank_index(storage_, ns_key, metadata.version);
+  s = metadata.inlined ? rocksdb::Status::NotFound()
+                       : rank_index.LocateMember(ss.GetSnapShot(), target_score_member, &block_pos, &block_start);
+  if (!s.ok() && !s.IsNotFound()) return s;
+  if (s.ok()) {
+    std::string block_key;
+    InternalKey(ns_key, block_start, metadata.version, storage_->IsSlotIdEncoded()).Encode(&block_key);
+    for (iter->Seek(block_key); iter->Valid() && iter->key().starts_with(prefix_key); iter->Next()) {
+      InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
+      if (ikey.GetSubKey() == target_score_member) break;
+      block_pos++;
+    }
+    *ret = !reversed ? static_cast<int>(block_pos) : static_cast<int>(metadata.size - 1 - block_pos);
+    return rocksdb::Status::OK();
+  }
+
   iter->Seek(start_key);
   // see comment in rangebyscore()
   if (reversed && (!iter->Valid() || !iter->key().starts_with(prefix_key))) {
@@ -634,137 +726,294 @@ rocksdb::Status ZSet::Overwrite(const Slice &user_key, const std::vector<MemberS
 
   LockGuard guard(storage_->GetLockManager(), ns_key);
   ZSetMetadata metadata;
+  metadata.inlined = storage_->GetConfig()->zset_inline_max_entries > 0;
   rocksdb::WriteBatch batch;
   WriteBatchLogData log_data(kRedisZSet);
   batch.PutLogData(log_data.Encode());
+  ZSetRankIndex rank_index(storage_, ns_key, metadata.version);
   for (const auto &ms : mscores) {
-    std::string member_key, score_bytes, score_key;
-    InternalKey(ns_key, ms.member, metadata.version, storage_->IsSlotIdEncoded()).Encode(&member_key);
-    PutDouble(&score_bytes, ms.score);
-    batch.Put(member_key, score_bytes);
-    score_bytes.append(ms.member);
-    InternalKey(ns_key, score_bytes, metadata.version, storage_->IsSlotIdEncoded()).Encode(&score_key);
-    batch.Put(score_cf_handle_, score_key, Slice());
+    putMember(ns_key, &metadata, ms.member, ms.score, &batch, &rank_index);
   }
   metadata.size = static_cast<uint32_t>(mscores.size());
-  std::string bytes;
-  metadata.Encode(&bytes);
-  batch.Put(metadata_cf_handle_, ns_key, bytes);
+  auto s = putMetadata(ns_key, &metadata, &batch, &rank_index);
+  if (!s.ok()) return s;
   return storage_->Write(storage_->DefaultWriteOptions(), &batch);
 }
 
 rocksdb::Status ZSet::InterStore(const Slice &dst, const std::vector<KeyWeight> &keys_weights,
                                  AggregateMethod aggregate_method, int *size) {
-  if (size) *size = 0;
+  return mergeStore(dst, keys_weights, aggregate_method, true, size);
+}
 
-  std::map<std::string, double> dst_zset;
-  std::map<std::string, size_t> member_counters;
-  std::vector<MemberScore> target_mscores;
-  int target_size = 0;
-  ZRangeSpec spec;
-  auto s = RangeByScore(keys_weights[0].key, spec, &target_mscores, &target_size);
-  if (!s.ok() || target_mscores.empty()) return s;
-  for (const auto &ms : target_mscores) {
-    double score = ms.score * keys_weights[0].weight;
-    if (std::isnan(score)) score = 0;
-    dst_zset[ms.member] = score;
-    member_counters[ms.member] = 1;
-  }
-  for (size_t i = 1; i < keys_weights.size(); i++) {
-    auto s = RangeByScore(keys_weights[i].key, spec, &target_mscores, &target_size);
-    if (!s.ok() || target_mscores.empty()) return s;
-    for (const auto &ms : target_mscores) {
-      if (dst_zset.find(ms.member) == dst_zset.end()) continue;
-      member_counters[ms.member]++;
-      double score = ms.score * keys_weights[i].weight;
-      if (std::isnan(score)) score = 0;
-      switch (aggregate_method) {
-        case kAggregateSum:
-          dst_zset[ms.member] += score;
-          if (std::isnan(dst_zset[ms.member])) {
-            dst_zset[ms.member] = 0;
-          }
-          break;
-        case kAggregateMin:
-          if (dst_zset[ms.member] > score) {
-            dst_zset[ms.member] = score;
-          }
-          break;
-        case kAggregateMax:
-          if (dst_zset[ms.member] < score) {
-            dst_zset[ms.member] = score;
-          }
-          break;
-      }
+rocksdb::Status ZSet::UnionStore(const Slice &dst, const std::vector<KeyWeight> &keys_weights,
+                                 AggregateMethod aggregate_method, int *size) {
+  return mergeStore(dst, keys_weights, aggregate_method, false, size);
+}
+
+// The members are merged in the member order, but replied in the order of the sorted set
+static void sortByScore(std::vector<MemberScore> *mscores) {
+  std::sort(mscores->begin(), mscores->end(), [](const MemberScore &a, const MemberScore &b) {
+    return a.score != b.score ? a.score < b.score : a.member < b.member;
+  });
+}
+
+rocksdb::Status ZSet::Inter(const std::vector<KeyWeight> &keys_weights, AggregateMethod aggregate_method,
+                            std::vector<MemberScore> *mscores) {
+  mscores->clear();
+  auto s = Merge(keys_weights, aggregate_method, true, [mscores](const Slice &member, double score) {
+    mscores->emplace_back(MemberScore{member.ToString(), score});
+    return true;
+  });
+  if (!s.ok()) return s;
+  sortByScore(mscores);
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status ZSet::Union(const std::vector<KeyWeight> &keys_weights, AggregateMethod aggregate_method,
+                            std::vector<MemberScore> *mscores) {
+  mscores->clear();
+  auto s = Merge(keys_weights, aggregate_method, false, [mscores](const Slice &member, double score) {
+    mscores->emplace_back(MemberScore{member.ToString(), score});
+    return true;
+  });
+  if (!s.ok()) return s;
+  sortByScore(mscores);
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status ZSet::InterCard(const std::vector<std::string> &user_keys, uint64_t limit, uint64_t *card) {
+  *card = 0;
+  std::vector<KeyWeight> keys_weights;
+  keys_weights.reserve(user_keys.size());
+  for (const auto &user_key : user_keys) {
+    keys_weights.emplace_back(KeyWeight{user_key, 1});
+  }
+  return Merge(keys_weights, kAggregateSum, true, [card, limit](const Slice &, double) {
+    *card += 1;
+    return limit == 0 || *card < limit;
+  });
+}
+
+namespace {
+
+// The cursor over the members of one input sorted set, the bounds of the iterator live with it
+struct ZSetMergeCursor {
+  std::string prefix_key;
+  std::string next_version_prefix_key;
+  rocksdb::Slice lower_bound;
+  rocksdb::Slice upper_bound;
+  ZSetMetadata metadata{false};
+  std::unique_ptr<rocksdb::Iterator> iter;
+  double weight = 1;
+  bool is_slot_id_encoded = false;
+
+  bool Valid() const { return iter && iter->Valid(); }
+  Slice Member() const { return InternalKey(iter->key(), is_slot_id_encoded).GetSubKey(); }
+  double Score() const {
+    // An infinite score with the zero weight would be NaN, which is counted as zero
+    double score = DecodeDouble(iter->value().data()) * weight;
+    return std::isnan(score) ? 0 : score;
+  }
+};
+
+double aggregateScore(AggregateMethod aggregate_method, double score, double other) {
+  switch (aggregate_method) {
+    case kAggregateSum:
+      score += other;
+      // +inf plus -inf is NaN, which is counted as zero
+      return std::isnan(score) ? 0 : score;
+    case kAggregateMin:
+      return std::min(score, other);
+    case kAggregateMax:
+      return std::max(score, other);
+  }
+  return score;
+}
+
+}  // namespace
+
+// The union is merged by a min-heap of the cursors ordered by their current members, while the
+// intersection seeks every cursor to the greatest current member until all of them are on it.
+// Only one member per input is held at a time, no matter how large the inputs are.
+rocksdb::Status ZSet::Merge(const std::vector<KeyWeight> &keys_weights, AggregateMethod aggregate_method,
+                            bool intersect, const std::function<bool(const Slice &, double)> &fn) {
+  LatestSnapShot ss(db_);
+  rocksdb::ReadOptions read_options;
+  read_options.snapshot = ss.GetSnapShot();
+  read_options.fill_cache = false;
+
+  // The cursors refer to their own bounds, so they're constructed in place and never moved
+  std::vector<ZSetMergeCursor> cursors(keys_weights.size());
+  std::vector<std::string> ns_keys(keys_weights.size());
+  bool has_empty = false;
+  for (size_t i = 0; i < keys_weights.size(); i++) {
+    auto &cursor = cursors[i];
+    AppendNamespacePrefix(keys_weights[i].key, &ns_keys[i]);
+    // Check the types of all keys even if the intersection is known to be empty
+    auto s = Database::GetMetadata(kRedisZSet, ns_keys[i], &cursor.metadata, read_options.snapshot);
+    if (s.IsNotFound()) {
+      has_empty = true;
+      continue;
     }
+    if (!s.ok()) return s;
+    cursor.weight = keys_weights[i].weight;
+    cursor.is_slot_id_encoded = storage_->IsSlotIdEncoded();
+    InternalKey(ns_keys[i], "", cursor.metadata.version, cursor.is_slot_id_encoded).Encode(&cursor.prefix_key);
+    InternalKey(ns_keys[i], "", cursor.metadata.version + 1, cursor.is_slot_id_encoded)
+        .Encode(&cursor.next_version_prefix_key);
   }
-  if (!dst_zset.empty()) {
-    std::vector<MemberScore> mscores;
-    for (const auto &iter : dst_zset) {
-      if (member_counters[iter.first] != keys_weights.size()) continue;
-      mscores.emplace_back(MemberScore{iter.first, iter.second});
+  if (intersect && has_empty) return rocksdb::Status::OK();
+
+  for (size_t i = 0; i < cursors.size(); i++) {
+    auto &cursor = cursors[i];
+    if (cursor.prefix_key.empty()) continue;
+    cursor.lower_bound = cursor.prefix_key;
+    cursor.upper_bound = cursor.next_version_prefix_key;
+    rocksdb::ReadOptions cursor_read_options = read_options;
+    cursor_read_options.iterate_lower_bound = &cursor.lower_bound;
+    cursor_read_options.iterate_upper_bound = &cursor.upper_bound;
+    cursor.iter = newIterator(ns_keys[i], cursor.metadata, cursor_read_options, false);
+    cursor.iter->Seek(cursor.prefix_key);
+    if (!cursor.Valid()) {
+      if (!cursor.iter->status().ok()) return cursor.iter->status();
+      if (intersect) return rocksdb::Status::OK();
     }
-    if (size) *size = mscores.size();
-    Overwrite(dst, mscores);
   }
 
+  if (intersect) {
+    std::string member, seek_key;
+    while (true) {
+      member = cursors[0].Member().ToString();
+      for (size_t i = 1; i < cursors.size(); i++) {
+        auto other = cursors[i].Member();
+        if (other.compare(member) > 0) member = other.ToString();
+      }
+      bool matched = true;
+      for (size_t i = 0; i < cursors.size(); i++) {
+        auto &cursor = cursors[i];
+        if (cursor.Member() == member) continue;
+        InternalKey(ns_keys[i], member, cursor.metadata.version, cursor.is_slot_id_encoded).Encode(&seek_key);
+        cursor.iter->Seek(seek_key);
+        if (!cursor.Valid()) return cursor.iter->status();
+        if (cursor.Member() != member) matched = false;
+      }
+      if (!matched) continue;
+
+      double score = cursors[0].Score();
+      for (size_t i = 1; i < cursors.size(); i++) {
+        score = aggregateScore(aggregate_method, score, cursors[i].Score());
+      }
+      if (!fn(member, score)) return rocksdb::Status::OK();
+      for (auto &cursor : cursors) {
+        cursor.iter->Next();
+        if (!cursor.Valid()) return cursor.iter->status();
+      }
+    }
+  }
+
+  // The ties are popped in the index order, so the scores are aggregated in the order of the keys
+  auto greater = [&cursors](size_t a, size_t b) {
+    int cmp = cursors[a].Member().compare(cursors[b].Member());
+    return cmp != 0 ? cmp > 0 : a > b;
+  };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+  for (size_t i = 0; i < cursors.size(); i++) {
+    if (cursors[i].Valid()) heap.push(i);
+  }
+  std::string member;
+  std::vector<size_t> popped;
+  while (!heap.empty()) {
+    size_t i = heap.top();
+    heap.pop();
+    member = cursors[i].Member().ToString();
+    double score = cursors[i].Score();
+    popped.assign(1, i);
+    while (!heap.empty() && cursors[heap.top()].Member() == member) {
+      score = aggregateScore(aggregate_method, score, cursors[heap.top()].Score());
+      popped.emplace_back(heap.top());
+      heap.pop();
+    }
+    if (!fn(member, score)) return rocksdb::Status::OK();
+    for (auto j : popped) {
+      cursors[j].iter->Next();
+      if (cursors[j].Valid()) {
+        heap.push(j);
+      } else if (!cursors[j].iter->status().ok()) {
+        return cursors[j].iter->status();
+      }
+    }
+  }
   return rocksdb::Status::OK();
 }
 
-rocksdb::Status ZSet::UnionStore(const Slice &dst, const std::vector<KeyWeight> &keys_weights,
-                                 AggregateMethod aggregate_method, int *size) {
+// Store the union or the intersection as a new version of the destination. The members are
+// written in the bounded batches while the old version is still visible, and the metadata is
+// switched in the last batch, so neither the result nor the batch is ever held in memory at once.
+// The members of an unfinished store are dropped by the compaction as their version is unused.
+rocksdb::Status ZSet::mergeStore(const Slice &dst, const std::vector<KeyWeight> &keys_weights,
+                                 AggregateMethod aggregate_method, bool intersect, int *size) {
   if (size) *size = 0;
 
-  std::map<std::string, double> dst_zset;
-  std::vector<MemberScore> target_mscores;
-  int target_size = 0;
-  ZRangeSpec spec;
-  for (const auto &key_weight : keys_weights) {
-    // get all member
-    auto s = RangeByScore(key_weight.key, spec, &target_mscores, &target_size);
-    if (!s.ok() && !s.IsNotFound()) return s;
-    for (const auto &ms : target_mscores) {
-      double score = ms.score * key_weight.weight;
-      if (std::isnan(score)) score = 0;
-      if (dst_zset.find(ms.member) == dst_zset.end()) {
-        dst_zset[ms.member] = score;
-      } else {
-        switch (aggregate_method) {
-          case kAggregateSum:
-            dst_zset[ms.member] += score;
-            if (std::isnan(dst_zset[ms.member])) dst_zset[ms.member] = 0;
-            break;
-          case kAggregateMin:
-            if (dst_zset[ms.member] > score) {
-              dst_zset[ms.member] = score;
-            }
-            break;
-          case kAggregateMax:
-            if (dst_zset[ms.member] < score) {
-              dst_zset[ms.member] = score;
-            }
-            break;
-        }
+  std::string ns_key;
+  AppendNamespacePrefix(dst, &ns_key);
+
+  std::vector<Slice> sources;
+  sources.reserve(keys_weights.size());
+  for (const auto &key_weight : keys_weights) sources.emplace_back(key_weight.key);
+  auto guard = lockStoreKeys(dst, sources);
+  auto config = storage_->GetConfig();
+  ZSetMetadata metadata;
+  metadata.inlined = config->zset_inline_max_entries > 0;
+  rocksdb::WriteBatch batch;
+  WriteBatchLogData log_data(kRedisZSet);
+  batch.PutLogData(log_data.Encode());
+  // The members written by the previous batches are scanned from the DB if the index is built,
+  // so the index only needs to know the members of the current batch
+  auto rank_index = std::make_unique<ZSetRankIndex>(storage_, ns_key, metadata.version);
+  size_t batch_size = 0;
+  rocksdb::Status write_status;
+  auto s = Merge(keys_weights, aggregate_method, intersect, [&](const Slice &member, double score) {
+    putMember(ns_key, &metadata, member, score, &batch, rank_index.get());
+    metadata.size++;
+    if (metadata.inlined) {
+      if (metadata.members.size() <= static_cast<size_t>(config->zset_inline_max_entries) &&
+          metadata.InlineBytes() <= static_cast<size_t>(config->zset_inline_max_bytes)) {
+        return true;
       }
+      auto members = std::move(metadata.members);
+      metadata.members.clear();
+      metadata.inlined = false;
+      for (const auto &iter : members) {
+        putMember(ns_key, &metadata, iter.first, iter.second, &batch, rank_index.get());
+      }
+      batch_size = members.size();
+    } else {
+      batch_size++;
     }
-  }
-  if (!dst_zset.empty()) {
-    std::vector<MemberScore> mscores;
-    mscores.reserve(dst_zset.size());
-    for (const auto &iter : dst_zset) {
-      mscores.emplace_back(MemberScore{iter.first, iter.second});
-    }
-    if (size) *size = mscores.size();
-    Overwrite(dst, mscores);
-  }
+    if (batch_size < kZSetStoreBatchSize) return true;
+
+    write_status = storage_->Write(storage_->DefaultWriteOptions(), &batch);
+    if (!write_status.ok()) return false;
+    batch.Clear();
+    batch.PutLogData(log_data.Encode());
+    rank_index = std::make_unique<ZSetRankIndex>(storage_, ns_key, metadata.version);
+    batch_size = 0;
+    return true;
+  });
+  if (!s.ok()) return s;
+  if (!write_status.ok()) return write_status;
+  // Leave the destination untouched if the result is empty
+  if (metadata.size == 0) return rocksdb::Status::OK();
 
+  s = putMetadata(ns_key, &metadata, &batch, rank_index.get());
+  if (!s.ok()) return s;
+  s = storage_->Write(storage_->DefaultWriteOptions(), &batch);
+  if (!s.ok()) return s;
+  if (size) *size = static_cast<int>(metadata.size);
   return rocksdb::Status::OK();
 }
 
 Status ZSet::ParseRangeSpec(const std::string &min, const std::string &max, ZRangeSpec *spec) {
-  const char *sptr = nullptr;
-  char *eptr = nullptr;
-
   if (min == "+inf" || max == "-inf") {
     return Status(Status::NotOK, "min > max");
   }
@@ -772,29 +1021,31 @@ Status ZSet::ParseRangeSpec(const std::string &min, const std::string &max, ZRan
   if (min == "-inf") {
     spec->min = kMinScore;
   } else {
-    sptr = min.data();
-    if (!min.empty() && min[0] == '(') {
+    std::string_view min_str = min;
+    if (!min_str.empty() && min_str[0] == '(') {
       spec->minex = true;
-      sptr++;
+      min_str.remove_prefix(1);
     }
-    spec->min = strtod(sptr, &eptr);
-    if ((eptr && eptr[0] != '\0') || isnan(spec->min)) {
+    auto parse_result = ParseFloat(min_str);
+    if (!parse_result || isnan(*parse_result)) {
       return Status(Status::NotOK, "the min isn't double");
     }
+    spec->min = *parse_result;
   }
 
   if (max == "+inf") {
     spec->max = kMaxScore;
   } else {
-    sptr = max.data();
-    if (!max.empty() && max[0] == '(') {
+    std::string_view max_str = max;
+    if (!max_str.empty() && max_str[0] == '(') {
       spec->maxex = true;
-      sptr++;
+      max_str.remove_prefix(1);
     }
-    spec->max = strtod(sptr, &eptr);
-    if ((eptr && eptr[0] != '\0') || isnan(spec->max)) {
+    auto parse_result = ParseFloat(max_str);
+    if (!parse_result || isnan(*parse_result)) {
       return Status(Status::NotOK, "the max isn't double");
     }
+    spec->max = *parse_result;
   }
   return Status::OK();
 }
@@ -835,6 +1086,22 @@ Status ZSet::ParseRangeLexSpec(const std::string &min, const std::string &max, Z
 rocksdb::Status ZSet::Scan(const Slice &user_key, const std::string &cursor, uint64_t limit,
                            const std::string &member_prefix, std::vector<std::string> *members,
                            std::vector<double> *scores) {
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+  ZSetMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s;
+  if (metadata.inlined) {
+    // Follow the order and the cursor semantics of scanning the subkeys
+    auto iter = cursor.empty() ? metadata.members.lower_bound(member_prefix) : metadata.members.upper_bound(cursor);
+    for (; iter != metadata.members.end() && Slice(iter->first).starts_with(member_prefix); ++iter) {
+      members->emplace_back(iter->first);
+      if (scores != nullptr) scores->emplace_back(iter->second);
+      if (limit > 0 && members->size() >= limit) break;
+    }
+    return rocksdb::Status::OK();
+  }
+
   if (scores != nullptr) {
     std::vector<std::string> values;
     auto s = SubKeyScanner::Scan(kRedisZSet, user_key, cursor, limit, member_prefix, members, &values);
@@ -858,23 +1125,149 @@ rocksdb::Status ZSet::MGet(const Slice &user_key, const std::vector<Slice> &memb
   ZSetMetadata metadata(false);
   rocksdb::Status s = GetMetadata(ns_key, &metadata);
   if (!s.ok()) return s;
+  if (metadata.inlined) {
+    for (const auto &member : members) {
+      auto iter = metadata.members.find(member.ToString());
+      if (iter != metadata.members.end()) (*mscores)[iter->first] = iter->second;
+    }
+    return rocksdb::Status::OK();
+  }
 
-  rocksdb::ReadOptions read_options;
-  LatestSnapShot ss(db_);
-  read_options.snapshot = ss.GetSnapShot();
-  std::string score_bytes, member_key;
-  for (const auto &member : members) {
-    InternalKey(ns_key, member, metadata.version, storage_->IsSlotIdEncoded()).Encode(&member_key);
-    score_bytes.clear();
-    s = db_->Get(read_options, member_key, &score_bytes);
-    if (!s.ok() && !s.IsNotFound()) return s;
-    if (s.IsNotFound()) {
+  std::vector<rocksdb::PinnableSlice> score_values;
+  std::vector<rocksdb::Status> statuses;
+  multiGetSubKeys(ns_key, metadata.version, members, &score_values, &statuses);
+  for (size_t i = 0; i < members.size(); i++) {
+    if (!statuses[i].ok() && !statuses[i].IsNotFound()) return statuses[i];
+    if (statuses[i].IsNotFound()) {
       continue;
     }
-    double target_score = DecodeDouble(score_bytes.data());
-    (*mscores)[member.ToString()] = target_score;
+    double target_score = DecodeDouble(score_values[i].data());
+    (*mscores)[members[i].ToString()] = target_score;
+  }
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status ZSet::RandMember(const Slice &user_key, int64_t count, std::vector<MemberScore> *mscores) {
+  mscores->clear();
+  if (count == 0) return rocksdb::Status::OK();
+  bool allow_duplicates = count < 0;
+  uint64_t n = allow_duplicates ? -count : count;
+
+  std::string ns_key;
+  AppendNamespacePrefix(user_key, &ns_key);
+  ZSetMetadata metadata(false);
+  rocksdb::Status s = GetMetadata(ns_key, &metadata);
+  if (!s.ok()) return s.IsNotFound() ? rocksdb::Status::OK() : s;
+
+  if (metadata.inlined) {
+    std::vector<std::map<std::string, double>::const_iterator> elems;
+    for (auto iter = metadata.members.cbegin(); iter != metadata.members.cend(); ++iter) elems.emplace_back(iter);
+    for (size_t pos : SampleInlinedPositions(elems.size(), n, allow_duplicates)) {
+      mscores->emplace_back(MemberScore{elems[pos]->first, elems[pos]->second});
+    }
+    return rocksdb::Status::OK();
+  }
+
+  // The member keys in the default column family are sampled, whose values are the scores
+  std::vector<std::string> members, score_values;
+  s = Sample(ns_key, metadata, n, allow_duplicates, &members, &score_values);
+  if (!s.ok()) return s;
+  for (size_t i = 0; i < members.size(); i++) {
+    mscores->emplace_back(MemberScore{std::move(members[i]), DecodeDouble(score_values[i].data())});
   }
   return rocksdb::Status::OK();
 }
 
+rocksdb::Status ZSet::getScore(const Slice &ns_key, const ZSetMetadata &metadata, const Slice &member,
+                               std::string *score_bytes) {
+  if (metadata.inlined) {
+    auto iter = metadata.members.find(member.ToString());
+    if (iter == metadata.members.end()) return rocksdb::Status::NotFound();
+    score_bytes->clear();
+    PutDouble(score_bytes, iter->second);
+    return rocksdb::Status::OK();
+  }
+  std::string member_key;
+  InternalKey(ns_key, member, metadata.version, storage_->IsSlotIdEncoded()).Encode(&member_key);
+  return storage_->Get(rocksdb::ReadOptions(), member_key, score_bytes);
+}
+
+void ZSet::putMember(const Slice &ns_key, ZSetMetadata *metadata, const Slice &member, double score,
+                     rocksdb::WriteBatch *batch, ZSetRankIndex *rank_index) {
+  if (metadata->inlined) {
+    metadata->members[member.ToString()] = score;
+    return;
+  }
+  std::string member_key, score_bytes, score_key;
+  InternalKey(ns_key, member, metadata->version, storage_->IsSlotIdEncoded()).Encode(&member_key);
+  PutDouble(&score_bytes, score);
+  batch->Put(member_key, score_bytes);
+  score_bytes.append(member.data(), member.size());
+  InternalKey(ns_key, score_bytes, metadata->version, storage_->IsSlotIdEncoded()).Encode(&score_key);
+  batch->Put(score_cf_handle_, score_key, Slice());
+  rank_index->Add(score_bytes);
+}
+
+// Delete the member by its score key, which is the encoded score followed by the member
+// The score key is left to the caller if with_score_key is false, which deletes a range of them at once.
+void ZSet::deleteMember(const Slice &ns_key, ZSetMetadata *metadata, const Slice &score_member,
+                        rocksdb::WriteBatch *batch, ZSetRankIndex *rank_index, bool with_score_key) {
+  Slice member(score_member.data() + sizeof(double), score_member.size() - sizeof(double));
+  if (metadata->inlined) {
+    metadata->members.erase(member.ToString());
+    return;
+  }
+  std::string member_key, score_key;
+  InternalKey(ns_key, member, metadata->version, storage_->IsSlotIdEncoded()).Encode(&member_key);
+  InternalKey(ns_key, score_member, metadata->version, storage_->IsSlotIdEncoded()).Encode(&score_key);
+  batch->Delete(member_key);
+  if (with_score_key) batch->Delete(score_cf_handle_, score_key);
+  rank_index->Remove(score_member);
+}
+
+// Put the metadata into the batch and maintain the rank index, the inline sorted set which
+// grows beyond the limits is converted to the subkeys with its current version.
+rocksdb::Status ZSet::putMetadata(const Slice &ns_key, ZSetMetadata *metadata, rocksdb::WriteBatch *batch,
+                                  ZSetRankIndex *rank_index) {
+  auto config = storage_->GetConfig();
+  if (metadata->inlined && (metadata->members.size() > static_cast<size_t>(config->zset_inline_max_entries) ||
+                            metadata->InlineBytes() > static_cast<size_t>(config->zset_inline_max_bytes))) {
+    auto members = std::move(metadata->members);
+    metadata->members.clear();
+    metadata->inlined = false;
+    for (const auto &iter : members) {
+      putMember(ns_key, metadata, iter.first, iter.second, batch, rank_index);
+    }
+  }
+  std::string bytes;
+  metadata->Encode(&bytes);
+  batch->Put(metadata_cf_handle_, ns_key, bytes);
+  if (metadata->inlined) return rocksdb::Status::OK();
+  return rank_index->Update(metadata->size, batch);
+}
+
+// Return the iterator over the score keys, or over the member keys if by_score is false.
+// The inline sorted set is iterated from its metadata in the same key format.
+DBUtil::UniqueIterator ZSet::newIterator(const Slice &ns_key, const ZSetMetadata &metadata,
+                                         const rocksdb::ReadOptions &read_options, bool by_score) {
+  if (!metadata.inlined) {
+    return by_score ? DBUtil::UniqueIterator(storage_->NewIterator(read_options, score_cf_handle_))
+                    : DBUtil::UniqueIterator(storage_->NewIterator(read_options));
+  }
+  std::vector<InlineIterator::Entry> entries;
+  entries.reserve(metadata.members.size());
+  for (const auto &iter : metadata.members) {
+    std::string score_bytes, key;
+    PutDouble(&score_bytes, iter.second);
+    if (by_score) {
+      InternalKey(ns_key, score_bytes + iter.first, metadata.version, storage_->IsSlotIdEncoded()).Encode(&key);
+      entries.emplace_back(std::move(key), std::string());
+    } else {
+      InternalKey(ns_key, iter.first, metadata.version, storage_->IsSlotIdEncoded()).Encode(&key);
+      entries.emplace_back(std::move(key), std::move(score_bytes));
+    }
+  }
+  return DBUtil::UniqueIterator(new InlineIterator(std::move(entries)));
+}
+
 }  // namespace Redis
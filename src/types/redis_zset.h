@@ -20,11 +20,13 @@
 
 #pragma once
 
+#include <functional>
 #include <limits>
 #include <map>
 #include <string>
 #include <vector>
 
+#include "db_util.h"
 #include "storage/redis_db.h"
 #include "storage/redis_metadata.h"
 
@@ -34,6 +36,8 @@ const double kMinScore = (std::numeric_limits<float>::is_iec559 ? -std::numeric_
                                                                 : std::numeric_limits<double>::lowest());
 const double kMaxScore = (std::numeric_limits<float>::is_iec559 ? std::numeric_limits<double>::infinity()
                                                                 : std::numeric_limits<double>::max());
+// The stored union or intersection is written into the batches of at most this number of members
+constexpr size_t kZSetStoreBatchSize = 1024;
 
 struct ZRangeSpec {
   double min = kMinScore, max = kMaxScore;
@@ -97,6 +101,8 @@ class ZAddFlags {
 
 namespace Redis {
 
+class ZSetRankIndex;
+
 class ZSet : public SubKeyScanner {
  public:
   explicit ZSet(Engine::Storage *storage, const std::string &ns)
@@ -115,6 +121,8 @@ class ZSet : public SubKeyScanner {
   rocksdb::Status RemoveRangeByLex(const Slice &user_key, ZRangeLexSpec spec, int *ret);
   rocksdb::Status RemoveRangeByRank(const Slice &user_key, int start, int stop, int *ret);
   rocksdb::Status Pop(const Slice &user_key, int count, bool min, std::vector<MemberScore> *mscores);
+  rocksdb::Status MPop(const std::vector<Slice> &user_keys, int count, bool min, std::string *popped_key,
+                       std::vector<MemberScore> *mscores);
   rocksdb::Status Score(const Slice &user_key, const Slice &member, double *score);
   static Status ParseRangeSpec(const std::string &min, const std::string &max, ZRangeSpec *spec);
   static Status ParseRangeLexSpec(const std::string &min, const std::string &max, ZRangeLexSpec *spec);
@@ -126,12 +134,36 @@ class ZSet : public SubKeyScanner {
                              AggregateMethod aggregate_method, int *size);
   rocksdb::Status UnionStore(const Slice &dst, const std::vector<KeyWeight> &keys_weights,
                              AggregateMethod aggregate_method, int *size);
+  rocksdb::Status Inter(const std::vector<KeyWeight> &keys_weights, AggregateMethod aggregate_method,
+                        std::vector<MemberScore> *mscores);
+  rocksdb::Status Union(const std::vector<KeyWeight> &keys_weights, AggregateMethod aggregate_method,
+                        std::vector<MemberScore> *mscores);
+  rocksdb::Status InterCard(const std::vector<std::string> &user_keys, uint64_t limit, uint64_t *card);
+  // Merge the sorted sets by their members in one snapshot, fn is called in the member order with
+  // each member of the union (or the intersection) and its aggregated score until it returns false
+  rocksdb::Status Merge(const std::vector<KeyWeight> &keys_weights, AggregateMethod aggregate_method, bool intersect,
+                        const std::function<bool(const Slice &, double)> &fn);
   rocksdb::Status MGet(const Slice &user_key, const std::vector<Slice> &members,
                        std::map<std::string, double> *mscores);
+  // ZRANDMEMBER, the members are distinct if the count is positive, or may be duplicated if it's negative
+  rocksdb::Status RandMember(const Slice &user_key, int64_t count, std::vector<MemberScore> *mscores);
 
   rocksdb::Status GetMetadata(const Slice &ns_key, ZSetMetadata *metadata);
 
  private:
+  rocksdb::Status getScore(const Slice &ns_key, const ZSetMetadata &metadata, const Slice &member,
+                           std::string *score_bytes);
+  void putMember(const Slice &ns_key, ZSetMetadata *metadata, const Slice &member, double score,
+                 rocksdb::WriteBatch *batch, ZSetRankIndex *rank_index);
+  void deleteMember(const Slice &ns_key, ZSetMetadata *metadata, const Slice &score_member,
+                    rocksdb::WriteBatch *batch, ZSetRankIndex *rank_index, bool with_score_key = true);
+  rocksdb::Status putMetadata(const Slice &ns_key, ZSetMetadata *metadata, rocksdb::WriteBatch *batch,
+                              ZSetRankIndex *rank_index);
+  rocksdb::Status mergeStore(const Slice &dst, const std::vector<KeyWeight> &keys_weights,
+                             AggregateMethod aggregate_method, bool intersect, int *size);
+  DBUtil::UniqueIterator newIterator(const Slice &ns_key, const ZSetMetadata &metadata,
+                                     const rocksdb::ReadOptions &read_options, bool by_score);
+
   rocksdb::ColumnFamilyHandle *score_cf_handle_;
 };
 
@@ -0,0 +1,268 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "redis_zset_rank_index.h"
+
+#include <algorithm>
+
+#include "db_util.h"
+#include "encoding.h"
+
+namespace Redis {
+
+ZSetRankIndex::ZSetRankIndex(Engine::Storage *storage, const Slice &ns_key, uint64_t version)
+    : storage_(storage),
+      score_cf_handle_(storage->GetCFHandle(Engine::kZSetScoreColumnFamilyName)),
+      rank_cf_handle_(storage->GetCFHandle(Engine::kZSetRankColumnFamilyName)),
+      ns_key_(ns_key.ToString()),
+      version_(version) {
+  InternalKey(ns_key, "", version, storage_->IsSlotIdEncoded()).Encode(&prefix_key_);
+  InternalKey(ns_key, "", version + 1, storage_->IsSlotIdEncoded()).Encode(&next_version_prefix_key_);
+}
+
+void ZSetRankIndex::Add(const Slice &score_member) {
+  auto iter = changes_.find(score_member.ToString());
+  if (iter != changes_.end() && !iter->second) {
+    changes_.erase(iter);
+  } else {
+    changes_[score_member.ToString()] = true;
+  }
+}
+
+void ZSetRankIndex::Remove(const Slice &score_member) {
+  auto iter = changes_.find(score_member.ToString());
+  if (iter != changes_.end() && iter->second) {
+    changes_.erase(iter);
+  } else {
+    changes_[score_member.ToString()] = false;
+  }
+}
+
+rocksdb::Status ZSetRankIndex::Update(uint32_t size, rocksdb::WriteBatch *batch) {
+  bool has_index = false;
+  auto s = exists(&has_index);
+  if (!s.ok()) return s;
+
+  auto min_size = static_cast<uint32_t>(storage_->GetConfig()->zset_rank_index_min_size);
+  if (!has_index) {
+    if (min_size == 0 || size < min_size) return rocksdb::Status::OK();
+    return build(batch);
+  }
+  if (min_size == 0 || size == 0) return drop(batch);
+  if (changes_.empty()) return rocksdb::Status::OK();
+
+  rocksdb::ReadOptions read_options;
+  rocksdb::Slice upper_bound(next_version_prefix_key_);
+  read_options.iterate_upper_bound = &upper_bound;
+  rocksdb::Slice lower_bound(prefix_key_);
+  read_options.iterate_lower_bound = &lower_bound;
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, rank_cf_handle_));
+
+  // Group the changes by the blocks, the changes are ordered so each block would be read once
+  std::map<std::string, Block> blocks;
+  Block *block = nullptr;
+  for (const auto &change : changes_) {
+    if (!block || (block->has_next && change.first >= block->next)) {
+      iter->SeekForPrev(encodeKey(change.first));
+      if (!iter->Valid()) {
+        return iter->status().ok() ? rocksdb::Status::Corruption("the header of zset rank index is missing")
+                                   : iter->status();
+      }
+      block = &blocks[InternalKey(iter->key(), storage_->IsSlotIdEncoded()).GetSubKey().ToString()];
+      block->count = DecodeFixed32(iter->value().data());
+      iter->Next();
+      block->has_next = iter->Valid();
+      if (block->has_next) block->next = InternalKey(iter->key(), storage_->IsSlotIdEncoded()).GetSubKey().ToString();
+    }
+    block->delta += change.second ? 1 : -1;
+  }
+  if (!iter->status().ok()) return iter->status();
+
+  for (const auto &[start, block] : blocks) {
+    int64_t count = std::max(static_cast<int64_t>(block.count) + block.delta, static_cast<int64_t>(0));
+    if (count == 0 && !start.empty()) {
+      batch->Delete(rank_cf_handle_, encodeKey(start));
+    } else if (count > 2 * kBlockSize) {
+      s = split(start, block, count, batch);
+      if (!s.ok()) return s;
+    } else {
+      putBlock(start, static_cast<uint32_t>(count), batch);
+    }
+  }
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status ZSetRankIndex::LocateMember(const rocksdb::Snapshot *snapshot, const Slice &score_member,
+                                            uint64_t *block_pos, std::string *block_start) {
+  rocksdb::ReadOptions read_options;
+  read_options.snapshot = snapshot;
+  rocksdb::Slice upper_bound(next_version_prefix_key_);
+  read_options.iterate_upper_bound = &upper_bound;
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, rank_cf_handle_));
+  iter->Seek(prefix_key_);
+  if (!iter->Valid() || iter->key() != prefix_key_) {
+    return iter->status().ok() ? rocksdb::Status::NotFound() : iter->status();
+  }
+
+  uint64_t count = 0;
+  *block_pos = 0;
+  for (; iter->Valid(); iter->Next()) {
+    InternalKey ikey(iter->key(), storage_->IsSlotIdEncoded());
+    if (ikey.GetSubKey().compare(score_member) > 0) break;
+    *block_pos += count;
+    *block_start = ikey.GetSubKey().ToString();
+    count = DecodeFixed32(iter->value().data());
+  }
+  return iter->status();
+}
+
+rocksdb::Status ZSetRankIndex::LocatePosition(const rocksdb::Snapshot *snapshot, uint64_t pos, uint64_t *block_pos,
+                                              std::string *block_start) {
+  rocksdb::ReadOptions read_options;
+  read_options.snapshot = snapshot;
+  rocksdb::Slice upper_bound(next_version_prefix_key_);
+  read_options.iterate_upper_bound = &upper_bound;
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, rank_cf_handle_));
+  iter->Seek(prefix_key_);
+  if (!iter->Valid() || iter->key() != prefix_key_) {
+    return iter->status().ok() ? rocksdb::Status::NotFound() : iter->status();
+  }
+
+  *block_pos = 0;
+  for (; iter->Valid(); iter->Next()) {
+    uint32_t count = DecodeFixed32(iter->value().data());
+    if (pos < *block_pos + count) {
+      *block_start = InternalKey(iter->key(), storage_->IsSlotIdEncoded()).GetSubKey().ToString();
+      return rocksdb::Status::OK();
+    }
+    *block_pos += count;
+  }
+  // the position is out of the range
+  return iter->status().ok() ? rocksdb::Status::NotFound() : iter->status();
+}
+
+rocksdb::Status ZSetRankIndex::exists(bool *exists) {
+  std::string value;
+  auto s = storage_->Get(rocksdb::ReadOptions(), rank_cf_handle_, prefix_key_, &value);
+  if (!s.ok() && !s.IsNotFound()) return s;
+  *exists = s.ok();
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status ZSetRankIndex::drop(rocksdb::WriteBatch *batch) {
+  if (!storage_->InTxn()) return batch->DeleteRange(rank_cf_handle_, prefix_key_, next_version_prefix_key_);
+
+  rocksdb::ReadOptions read_options;
+  rocksdb::Slice upper_bound(next_version_prefix_key_);
+  read_options.iterate_upper_bound = &upper_bound;
+  rocksdb::Slice lower_bound(prefix_key_);
+  read_options.iterate_lower_bound = &lower_bound;
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, rank_cf_handle_));
+  for (iter->Seek(prefix_key_); iter->Valid(); iter->Next()) {
+    auto s = batch->Delete(rank_cf_handle_, iter->key());
+    if (!s.ok()) return s;
+  }
+  return iter->status();
+}
+
+rocksdb::Status ZSetRankIndex::build(rocksdb::WriteBatch *batch) {
+  // Drop the stale entries which were left if the index was disabled before
+  auto s = drop(batch);
+  if (!s.ok()) return s;
+
+  std::string block_start;
+  uint32_t count = 0;
+  s = scanMembers("", nullptr, [&](const std::string &score_member) {
+    if (count >= kBlockSize) {
+      putBlock(block_start, count, batch);
+      block_start = score_member;
+      count = 0;
+    }
+    count++;
+  });
+  if (!s.ok()) return s;
+  putBlock(block_start, count, batch);
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status ZSetRankIndex::split(const std::string &start, const Block &block, uint64_t count,
+                                     rocksdb::WriteBatch *batch) {
+  uint64_t pieces = (count + kBlockSize - 1) / kBlockSize;
+  uint64_t piece = 0, pos = 0;
+  std::string piece_start = start;
+  uint32_t piece_count = 0;
+  auto s = scanMembers(start, block.has_next ? &block.next : nullptr, [&](const std::string &score_member) {
+    if (piece + 1 < pieces && pos >= (piece + 1) * count / pieces) {
+      putBlock(piece_start, piece_count, batch);
+      piece++;
+      piece_start = score_member;
+      piece_count = 0;
+    }
+    pos++;
+    piece_count++;
+  });
+  if (!s.ok()) return s;
+  putBlock(piece_start, piece_count, batch);
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status ZSetRankIndex::scanMembers(const std::string &start, const std::string *end,
+                                           const std::function<void(const std::string &)> &fn) {
+  std::string end_key = end ? encodeKey(*end) : next_version_prefix_key_;
+  rocksdb::ReadOptions read_options;
+  rocksdb::Slice upper_bound(end_key);
+  read_options.iterate_upper_bound = &upper_bound;
+  read_options.fill_cache = false;
+  auto iter = DBUtil::UniqueIterator(storage_->NewIterator(read_options, score_cf_handle_));
+
+  // Merge the members in the DB with the changes which are not written yet
+  auto change = changes_.lower_bound(start);
+  for (iter->Seek(encodeKey(start)); iter->Valid(); iter->Next()) {
+    std::string score_member = InternalKey(iter->key(), storage_->IsSlotIdEncoded()).GetSubKey().ToString();
+    for (; change != changes_.end() && change->first < score_member; change++) {
+      if (change->second) fn(change->first);
+    }
+    if (change != changes_.end() && change->first == score_member) {
+      bool removed = !change->second;
+      change++;
+      if (removed) continue;
+    }
+    fn(score_member);
+  }
+  if (!iter->status().ok()) return iter->status();
+  for (; change != changes_.end() && (!end || change->first < *end); change++) {
+    if (change->second) fn(change->first);
+  }
+  return rocksdb::Status::OK();
+}
+
+void ZSetRankIndex::putBlock(const std::string &start, uint32_t count, rocksdb::WriteBatch *batch) {
+  std::string value;
+  PutFixed32(&value, count);
+  batch->Put(rank_cf_handle_, encodeKey(start), value);
+}
+
+std::string ZSetRankIndex::encodeKey(const Slice &sub_key) const {
+  std::string key;
+  InternalKey(ns_key_, sub_key, version_, storage_->IsSlotIdEncoded()).Encode(&key);
+  return key;
+}
+
+}  // namespace Redis
@@ -0,0 +1,95 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <rocksdb/db.h>
+#include <rocksdb/write_batch.h>
+
+#include <functional>
+#include <map>
+#include <string>
+
+#include "storage/redis_metadata.h"
+#include "storage/storage.h"
+
+namespace Redis {
+
+// ZSetRankIndex keeps the member counts of the score blocks of a sorted set in the zset_rank
+// column family, then the rank and offset queries could skip the whole blocks instead of
+// walking the members one by one.
+//
+// Each block is stored as InternalKey(ns_key, first score member, version) => member count,
+// the block starts with the empty subkey is the header, and the index is valid only if the
+// header exists. So the writers of the sorted set must either update the index or drop it.
+// Blocks larger than 2 * kBlockSize are split, the emptied blocks are removed but the small
+// blocks are not merged, so the number of blocks is bounded by the peak size of the set.
+class ZSetRankIndex {
+ public:
+  static constexpr uint32_t kBlockSize = 1024;
+
+  explicit ZSetRankIndex(Engine::Storage *storage, const Slice &ns_key, uint64_t version);
+
+  // Record the score members added or removed in the current write batch,
+  // the score member is the subkey of the zset_score column family
+  void Add(const Slice &score_member);
+  void Remove(const Slice &score_member);
+  // Update the index by the recorded changes, or build/drop the index if needed. It should be
+  // called before the batch is written with the key lock held, the size is the new set size.
+  rocksdb::Status Update(uint32_t size, rocksdb::WriteBatch *batch);
+
+  // Find the block which contains the score member, block_pos is the number of members before the block
+  rocksdb::Status LocateMember(const rocksdb::Snapshot *snapshot, const Slice &score_member, uint64_t *block_pos,
+                               std::string *block_start);
+  // Find the block which contains the member at the position
+  rocksdb::Status LocatePosition(const rocksdb::Snapshot *snapshot, uint64_t pos, uint64_t *block_pos,
+                                 std::string *block_start);
+
+ private:
+  struct Block {
+    uint32_t count = 0;
+    int64_t delta = 0;
+    bool has_next = false;
+    std::string next;
+  };
+
+  rocksdb::Status exists(bool *exists);
+  rocksdb::Status build(rocksdb::WriteBatch *batch);
+  // Drop all blocks of the index by one range deletion, or one by one in the transaction, which
+  // can't serve the reads of the deleted range
+  rocksdb::Status drop(rocksdb::WriteBatch *batch);
+  rocksdb::Status split(const std::string &start, const Block &block, uint64_t count, rocksdb::WriteBatch *batch);
+  rocksdb::Status scanMembers(const std::string &start, const std::string *end,
+                              const std::function<void(const std::string &)> &fn);
+  void putBlock(const std::string &start, uint32_t count, rocksdb::WriteBatch *batch);
+  std::string encodeKey(const Slice &sub_key) const;
+
+  Engine::Storage *storage_;
+  rocksdb::ColumnFamilyHandle *score_cf_handle_;
+  rocksdb::ColumnFamilyHandle *rank_cf_handle_;
+  std::string ns_key_;
+  uint64_t version_;
+  std::string prefix_key_;
+  std::string next_version_prefix_key_;
+  // score member => true if it was added, false if it was removed
+  std::map<std::string, bool> changes_;
+};
+
+}  // namespace Redis
@@ -0,0 +1,68 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <cassert>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "config/config.h"
+#include "storage/redis_db.h"
+#include "storage/storage.h"
+
+// The sizes of the keys the benchmarks run against, from the small keys to the big keys
+#define KVROCKS_BENCH_SIZE_CLASSES RangeMultiplier(16)->Range(16, 16 << 8)
+
+// StorageFixture opens the storage like TestBase of the unit tests, the keys of the namespace
+// are flushed after every benchmark so that the results don't depend on the order
+class StorageFixture : public benchmark::Fixture {
+ public:
+  void SetUp(const benchmark::State &state) override {
+    config_ = std::make_unique<Config>();
+    config_->db_dir = "benchdb";
+    config_->backup_dir = "benchdb/backup";
+    storage_ = std::make_unique<Engine::Storage>(config_.get());
+    Status s = storage_->Open();
+    assert(s.IsOK());
+    (void)s;
+  }
+
+  void TearDown(const benchmark::State &state) override {
+    Redis::Database(storage_.get(), ns_).FlushDB();
+    storage_.reset();
+    config_.reset();
+  }
+
+ protected:
+  static std::vector<std::string> makeStrings(const std::string &prefix, int64_t n) {
+    std::vector<std::string> strings;
+    strings.reserve(n);
+    for (int64_t i = 0; i < n; i++) strings.emplace_back(prefix + std::to_string(i));
+    return strings;
+  }
+
+  std::unique_ptr<Config> config_;
+  std::unique_ptr<Engine::Storage> storage_;
+  std::string ns_ = "bench";
+};
@@ -0,0 +1,115 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <benchmark/benchmark.h>
+#include <event2/buffer.h>
+
+#include <string>
+#include <vector>
+
+#include "server/redis_reply.h"
+#include "server/redis_request.h"
+#include "storage/redis_metadata.h"
+
+static void InternalKeyEncode(benchmark::State &state) {
+  std::string ns_key;
+  ComposeNamespaceKey("namespace", "key", &ns_key, false);
+  std::string sub_key(state.range(0), 'a');
+  std::string encoded;
+  for (auto _ : state) {
+    encoded.clear();
+    InternalKey(ns_key, sub_key, 1, false).Encode(&encoded);
+    benchmark::DoNotOptimize(encoded.data());
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(encoded.size()));
+}
+BENCHMARK(InternalKeyEncode)->Arg(8)->Arg(64)->Arg(512);
+
+static void InternalKeyDecode(benchmark::State &state) {
+  std::string ns_key, encoded;
+  ComposeNamespaceKey("namespace", "key", &ns_key, false);
+  InternalKey(ns_key, std::string(state.range(0), 'a'), 1, false).Encode(&encoded);
+  for (auto _ : state) {
+    InternalKey key(encoded, false);
+    benchmark::DoNotOptimize(key.GetSubKey().data());
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(encoded.size()));
+}
+BENCHMARK(InternalKeyDecode)->Arg(8)->Arg(64)->Arg(512);
+
+static void SubKeyEncoderEncode(benchmark::State &state) {
+  std::string ns_key;
+  ComposeNamespaceKey("namespace", "key", &ns_key, false);
+  SubKeyEncoder encoder(ns_key, 1, false);
+  std::string sub_key(state.range(0), 'a');
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(encoder.Encode(sub_key).data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(SubKeyEncoderEncode)->Arg(8)->Arg(64)->Arg(512);
+
+// Parse a pipeline of state.range(0) SET commands
+static void RequestTokenize(benchmark::State &state) {
+  std::string command = "*3\r\n$3\r\nSET\r\n$10\r\nkey-000000\r\n$64\r\n" + std::string(64, 'v') + "\r\n";
+  std::string pipeline;
+  for (int64_t i = 0; i < state.range(0); i++) pipeline += command;
+  evbuffer *input = evbuffer_new();
+  for (auto _ : state) {
+    evbuffer_add(input, pipeline.data(), pipeline.size());
+    Redis::Request request(nullptr);
+    benchmark::DoNotOptimize(request.Tokenize(input).IsOK());
+    benchmark::DoNotOptimize(request.GetCommands()->size());
+  }
+  evbuffer_free(input);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(pipeline.size()));
+}
+BENCHMARK(RequestTokenize)->Arg(1)->Arg(16)->Arg(256);
+
+static void ReplyMultiBulkString(benchmark::State &state) {
+  std::vector<std::string> values(state.range(0), std::string(32, 'v'));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Redis::MultiBulkString(values).data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(ReplyMultiBulkString)->RangeMultiplier(16)->Range(16, 16 << 8);
+
+static void ReplyMultiBulkStringToBuffer(benchmark::State &state) {
+  std::vector<std::string> values(state.range(0), std::string(32, 'v'));
+  evbuffer *output = evbuffer_new();
+  for (auto _ : state) {
+    Redis::MultiBulkString(output, values);
+    evbuffer_drain(output, evbuffer_get_length(output));
+  }
+  evbuffer_free(output);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(ReplyMultiBulkStringToBuffer)->RangeMultiplier(16)->Range(16, 16 << 8);
+
+static void ReplyInteger(benchmark::State &state) {
+  int64_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Redis::Integer(i++).data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(ReplyInteger);
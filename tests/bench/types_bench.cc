@@ -0,0 +1,211 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <string>
+#include <vector>
+
+#include "bench_base.h"
+#include "types/redis_bitmap.h"
+#include "types/redis_hash.h"
+#include "types/redis_list.h"
+#include "types/redis_set.h"
+#include "types/redis_stream.h"
+#include "types/redis_zset.h"
+
+// Every benchmark fills a key of state.range(0) elements first, then measures the operations on it
+
+BENCHMARK_DEFINE_F(StorageFixture, HashGet)(benchmark::State &state) {
+  Redis::Hash hash(storage_.get(), ns_);
+  auto fields = makeStrings("field-", state.range(0));
+  int ret = 0;
+  for (const auto &field : fields) hash.Set("hash", field, "value", &ret);
+  std::string value;
+  size_t i = 0;
+  for (auto _ : state) {
+    hash.Get("hash", fields[i++ % fields.size()], &value);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(StorageFixture, HashGet)->KVROCKS_BENCH_SIZE_CLASSES;
+
+BENCHMARK_DEFINE_F(StorageFixture, HashSet)(benchmark::State &state) {
+  Redis::Hash hash(storage_.get(), ns_);
+  auto fields = makeStrings("field-", state.range(0));
+  int ret = 0;
+  size_t i = 0;
+  for (auto _ : state) {
+    hash.Set("hash", fields[i++ % fields.size()], "value", &ret);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(StorageFixture, HashSet)->KVROCKS_BENCH_SIZE_CLASSES;
+
+BENCHMARK_DEFINE_F(StorageFixture, HashGetAll)(benchmark::State &state) {
+  Redis::Hash hash(storage_.get(), ns_);
+  int ret = 0;
+  for (const auto &field : makeStrings("field-", state.range(0))) hash.Set("hash", field, "value", &ret);
+  std::vector<FieldValue> field_values;
+  for (auto _ : state) {
+    hash.GetAll("hash", &field_values);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_REGISTER_F(StorageFixture, HashGetAll)->KVROCKS_BENCH_SIZE_CLASSES;
+
+BENCHMARK_DEFINE_F(StorageFixture, ZSetAdd)(benchmark::State &state) {
+  Redis::ZSet zset(storage_.get(), ns_);
+  auto members = makeStrings("member-", state.range(0));
+  int ret = 0;
+  size_t i = 0;
+  for (auto _ : state) {
+    std::vector<MemberScore> mscores{{members[i % members.size()], static_cast<double>(i)}};
+    zset.Add("zset", ZAddFlags::Default(), &mscores, &ret);
+    i++;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(StorageFixture, ZSetAdd)->KVROCKS_BENCH_SIZE_CLASSES;
+
+BENCHMARK_DEFINE_F(StorageFixture, ZSetRange)(benchmark::State &state) {
+  Redis::ZSet zset(storage_.get(), ns_);
+  std::vector<MemberScore> mscores;
+  auto members = makeStrings("member-", state.range(0));
+  for (size_t i = 0; i < members.size(); i++) mscores.emplace_back(MemberScore{members[i], static_cast<double>(i)});
+  int ret = 0;
+  zset.Add("zset", ZAddFlags::Default(), &mscores, &ret);
+  for (auto _ : state) {
+    std::vector<MemberScore> range;
+    zset.Range("zset", 0, 9, 0, &range);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(StorageFixture, ZSetRange)->KVROCKS_BENCH_SIZE_CLASSES;
+
+BENCHMARK_DEFINE_F(StorageFixture, ListPush)(benchmark::State &state) {
+  Redis::List list(storage_.get(), ns_);
+  auto elems = makeStrings("elem-", state.range(0));
+  std::vector<Slice> slices(elems.begin(), elems.end());
+  int ret = 0;
+  list.Push("list", slices, false, &ret);
+  for (auto _ : state) {
+    list.Push("list", {Slice("elem")}, true, &ret);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(StorageFixture, ListPush)->KVROCKS_BENCH_SIZE_CLASSES;
+
+BENCHMARK_DEFINE_F(StorageFixture, ListRange)(benchmark::State &state) {
+  Redis::List list(storage_.get(), ns_);
+  auto elems = makeStrings("elem-", state.range(0));
+  std::vector<Slice> slices(elems.begin(), elems.end());
+  int ret = 0;
+  list.Push("list", slices, false, &ret);
+  for (auto _ : state) {
+    std::vector<std::string> range;
+    list.Range("list", 0, -1, &range);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_REGISTER_F(StorageFixture, ListRange)->KVROCKS_BENCH_SIZE_CLASSES;
+
+BENCHMARK_DEFINE_F(StorageFixture, SetAdd)(benchmark::State &state) {
+  Redis::Set set(storage_.get(), ns_);
+  auto members = makeStrings("member-", state.range(0));
+  int ret = 0;
+  size_t i = 0;
+  for (auto _ : state) {
+    set.Add("set", {members[i++ % members.size()]}, &ret);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(StorageFixture, SetAdd)->KVROCKS_BENCH_SIZE_CLASSES;
+
+BENCHMARK_DEFINE_F(StorageFixture, SetMembers)(benchmark::State &state) {
+  Redis::Set set(storage_.get(), ns_);
+  auto members = makeStrings("member-", state.range(0));
+  int ret = 0;
+  set.Add("set", std::vector<Slice>(members.begin(), members.end()), &ret);
+  for (auto _ : state) {
+    std::vector<std::string> result;
+    set.Members("set", &result);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_REGISTER_F(StorageFixture, SetMembers)->KVROCKS_BENCH_SIZE_CLASSES;
+
+BENCHMARK_DEFINE_F(StorageFixture, BitmapSetBit)(benchmark::State &state) {
+  Redis::Bitmap bitmap(storage_.get(), ns_);
+  // The bitmap has state.range(0) bytes
+  auto bits = static_cast<uint32_t>(state.range(0) * 8);
+  bool old_bit = false;
+  uint32_t offset = 0;
+  for (auto _ : state) {
+    bitmap.SetBit("bitmap", offset, true, &old_bit);
+    offset = (offset + 7919) % bits;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(StorageFixture, BitmapSetBit)->KVROCKS_BENCH_SIZE_CLASSES;
+
+BENCHMARK_DEFINE_F(StorageFixture, BitmapGetBit)(benchmark::State &state) {
+  Redis::Bitmap bitmap(storage_.get(), ns_);
+  auto bits = static_cast<uint32_t>(state.range(0) * 8);
+  bool bit = false;
+  for (uint32_t offset = 0; offset < bits; offset += 3) bitmap.SetBit("bitmap", offset, true, &bit);
+  uint32_t offset = 0;
+  for (auto _ : state) {
+    bitmap.GetBit("bitmap", offset, &bit);
+    offset = (offset + 7919) % bits;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(StorageFixture, BitmapGetBit)->KVROCKS_BENCH_SIZE_CLASSES;
+
+BENCHMARK_DEFINE_F(StorageFixture, StreamAdd)(benchmark::State &state) {
+  Redis::Stream stream(storage_.get(), ns_);
+  Redis::StreamAddOptions options;
+  std::vector<std::string> values = {"field", "value"};
+  Redis::StreamEntryID id;
+  for (int64_t i = 0; i < state.range(0); i++) stream.Add("stream", options, values, &id);
+  for (auto _ : state) {
+    stream.Add("stream", options, values, &id);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(StorageFixture, StreamAdd)->KVROCKS_BENCH_SIZE_CLASSES;
+
+BENCHMARK_DEFINE_F(StorageFixture, StreamRange)(benchmark::State &state) {
+  Redis::Stream stream(storage_.get(), ns_);
+  Redis::StreamAddOptions add_options;
+  std::vector<std::string> values = {"field", "value"};
+  Redis::StreamEntryID id;
+  for (int64_t i = 0; i < state.range(0); i++) stream.Add("stream", add_options, values, &id);
+  Redis::StreamRangeOptions options;
+  options.start = Redis::StreamEntryID::Minimum();
+  options.end = Redis::StreamEntryID::Maximum();
+  options.with_count = true;
+  options.count = 10;
+  for (auto _ : state) {
+    std::vector<Redis::StreamEntry> entries;
+    stream.Range("stream", options, &entries);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(StorageFixture, StreamRange)->KVROCKS_BENCH_SIZE_CLASSES;
@@ -0,0 +1,73 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "storage/backup_uploader.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include "config.h"
+#include "storage/storage.h"
+#include "types/redis_string.h"
+
+TEST(BackupUploader, UploadIncrementally) {
+  const std::string remote_dir = "backupuploaderremote";
+  rocksdb::DestroyDB("backupuploaderdb", rocksdb::Options());
+  std::filesystem::remove_all(remote_dir);
+
+  Config config;
+  config.db_dir = "backupuploaderdb";
+  config.backup_dir = "backupuploaderdb/backup";
+  config.backup_threads = 2;
+  config.backup_upload_command = "mkdir -p \"$(dirname " + remote_dir + "/{})\" && cat > " + remote_dir + "/{}";
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  ASSERT_TRUE(storage->Open().IsOK());
+  auto string = std::make_unique<Redis::String>(storage.get(), "test_backup_uploader");
+  for (int i = 0; i < 100; i++) {
+    string->Set("key" + std::to_string(i), "value");
+  }
+  storage->GetDB()->Flush(rocksdb::FlushOptions(), storage->GetCFHandle(Engine::kMetadataColumnFamilyName));
+
+  auto s = storage->CreateBackup();
+  ASSERT_TRUE(s.IsOK()) << s.Msg();
+  EXPECT_GT(storage->GetLastBackupSize(), 0);
+  EXPECT_EQ(storage->GetLastBackupSize(), storage->GetLastBackupCopiedBytes());
+
+  // The SST files were uploaded by the first backup, so only the other files are uploaded again
+  s = storage->CreateBackup();
+  ASSERT_TRUE(s.IsOK()) << s.Msg();
+  EXPECT_LT(storage->GetLastBackupCopiedBytes(), storage->GetLastBackupSize());
+
+  std::ifstream state("backupuploaderdb/backup/uploaded_files");
+  std::string key;
+  ASSERT_TRUE(std::getline(state, key));
+  EXPECT_EQ(0, key.rfind("shared/", 0));
+  EXPECT_TRUE(std::ifstream(remote_dir + "/" + key).good());
+
+  // The failed command fails the backup
+  config.backup_upload_command = "cat > /dev/null; exit 1";
+  EXPECT_FALSE(storage->CreateBackup().IsOK());
+
+  storage.reset();
+  rocksdb::DestroyDB("backupuploaderdb", rocksdb::Options());
+  std::filesystem::remove_all(remote_dir);
+}
@@ -0,0 +1,122 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "stats/big_keys.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "storage/redis_db.h"
+#include "storage/storage.h"
+#include "types/redis_hash.h"
+#include "types/redis_string.h"
+
+TEST(BigKeys, TopKeys) {
+  BigKeys big_keys(3);
+  for (int i = 1; i <= 5; i++) big_keys.Update("ns", "hash-" + std::to_string(i), kRedisHash, i * 10);
+  big_keys.Update("ns", "set", kRedisSet, 7, 100);
+  big_keys.Update("other", "hash", kRedisHash, 1000);
+
+  auto keys = big_keys.GetKeys("ns", kRedisHash, 10);
+  ASSERT_EQ(keys.size(), 3U);
+  ASSERT_EQ(keys[0].key, "hash-5");
+  ASSERT_EQ(keys[0].size, 50U);
+  ASSERT_EQ(keys[2].key, "hash-3");
+  ASSERT_FALSE(big_keys.Admits("ns", kRedisHash, 30));
+  ASSERT_TRUE(big_keys.Admits("ns", kRedisHash, 31));
+  ASSERT_EQ(big_keys.GetKeys("ns", kRedisHash, 1).size(), 1U);
+
+  // The keys of every type are returned if the type is none
+  keys = big_keys.GetKeys("ns", kRedisNone, 10);
+  ASSERT_EQ(keys.size(), 4U);
+  ASSERT_EQ(keys[3].key, "set");
+  ASSERT_EQ(keys[3].type, kRedisSet);
+  ASSERT_EQ(keys[3].disk_bytes, 100U);
+
+  // The disk size is kept unless measured again
+  big_keys.Update("ns", "set", kRedisSet, 8);
+  ASSERT_EQ(big_keys.GetKeys("ns", kRedisSet, 10)[0].disk_bytes, 100U);
+  // The key overwritten by another type is moved
+  big_keys.Update("ns", "hash-5", kRedisSet, 9);
+  ASSERT_EQ(big_keys.GetKeys("ns", kRedisHash, 10).size(), 2U);
+  ASSERT_EQ(big_keys.GetKeys("ns", kRedisSet, 10)[0].key, "hash-5");
+
+  big_keys.Remove("ns", "set");
+  ASSERT_EQ(big_keys.GetKeys("ns", kRedisSet, 10).size(), 1U);
+  big_keys.Clear();
+  ASSERT_TRUE(big_keys.GetKeys("ns", kRedisNone, 10).empty());
+  ASSERT_TRUE(big_keys.GetKeys("other", kRedisNone, 10).empty());
+}
+
+TEST(BigKeys, TrackWritesAndScan) {
+  Config config;
+  config.db_dir = "bigkeysdb";
+  config.backup_dir = "bigkeysdb/backup";
+
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  Status s = storage->Open();
+  assert(s.IsOK());
+  auto big_keys = storage->GetBigKeys();
+  std::string ns = "test_big_keys";
+  auto db = std::make_unique<Redis::Database>(storage.get(), ns);
+  EXPECT_TRUE(db->FlushDB().ok());
+
+  // The keys written before the tracking was enabled are found by the scan
+  int ret = 0;
+  auto string = std::make_unique<Redis::String>(storage.get(), ns);
+  auto hash = std::make_unique<Redis::Hash>(storage.get(), ns);
+  string->Set("string", std::string(100, 'a'));
+  for (int i = 0; i < 10; i++) hash->Set("hash", "f" + std::to_string(i), "v", &ret);
+  EXPECT_FALSE(big_keys->Enabled());
+  EXPECT_TRUE(big_keys->GetKeys(ns, kRedisNone, 10).empty());
+
+  big_keys->SetEnabled(true);
+  BigKeyScanner scanner(storage.get(), big_keys);
+  // Scan the keys step by step
+  for (int i = 0; i < 10 && scanner.GetFullPasses() == 0; i++) {
+    EXPECT_TRUE(scanner.Step(1).ok());
+  }
+  EXPECT_EQ(scanner.GetFullPasses(), 1U);
+  auto keys = big_keys->GetKeys(ns, kRedisString, 10);
+  ASSERT_EQ(keys.size(), 1U);
+  EXPECT_EQ(keys[0].key, "string");
+  EXPECT_EQ(keys[0].size, 100U);
+  keys = big_keys->GetKeys(ns, kRedisHash, 10);
+  ASSERT_EQ(keys.size(), 1U);
+  EXPECT_EQ(keys[0].size, 10U);
+
+  // The writes update the sizes incrementally
+  hash->Set("hash", "f10", "v", &ret);
+  hash->Set("another_hash", "f", "v", &ret);
+  keys = big_keys->GetKeys(ns, kRedisHash, 10);
+  ASSERT_EQ(keys.size(), 2U);
+  EXPECT_EQ(keys[0].key, "hash");
+  EXPECT_EQ(keys[0].size, 11U);
+  EXPECT_TRUE(db->Del("hash").ok());
+  EXPECT_EQ(big_keys->GetKeys(ns, kRedisHash, 10).size(), 1U);
+
+  big_keys->SetEnabled(false);
+  EXPECT_TRUE(big_keys->GetKeys(ns, kRedisNone, 10).empty());
+  EXPECT_TRUE(db->FlushDB().ok());
+}
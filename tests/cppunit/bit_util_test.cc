@@ -0,0 +1,63 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "bit_util.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+TEST(BitUtil, PopCount) {
+  std::mt19937 rng(0);
+  for (size_t size = 0; size < 200; size++) {
+    std::vector<unsigned char> bytes(size);
+    uint64_t expected = 0;
+    for (auto &byte : bytes) {
+      byte = static_cast<unsigned char>(rng());
+      for (int i = 0; i < 8; i++) expected += (byte >> i) & 1;
+    }
+    ASSERT_EQ(expected, Util::PopCount(bytes.data(), bytes.size()));
+    // Count from the unaligned addresses
+    if (size > 0) {
+      ASSERT_EQ(expected - __builtin_popcount(bytes[0]), Util::PopCount(bytes.data() + 1, bytes.size() - 1));
+    }
+  }
+}
+
+TEST(BitUtil, FindFirstBit) {
+  std::vector<unsigned char> bytes(100, 0);
+  ASSERT_EQ(-1, Util::FindFirstBit(bytes.data(), bytes.size(), true, false));
+  ASSERT_EQ(0, Util::FindFirstBit(bytes.data(), bytes.size(), false, false));
+  bytes[77] = 0x10;
+  ASSERT_EQ(77 * 8 + 4, Util::FindFirstBit(bytes.data(), bytes.size(), true, false));
+  ASSERT_EQ(77 * 8 + 3, Util::FindFirstBit(bytes.data(), bytes.size(), true, true));
+  bytes[3] = 0x01;
+  bytes[4] = 0x80;
+  ASSERT_EQ(3 * 8, Util::FindFirstBit(bytes.data(), bytes.size(), true, false));
+  ASSERT_EQ(3 * 8 + 7, Util::FindFirstBit(bytes.data(), bytes.size(), true, true));
+  ASSERT_EQ(4 * 8 + 7, Util::FindFirstBit(bytes.data() + 4, bytes.size() - 4, true, false) + 4 * 8);
+
+  std::vector<unsigned char> ones(100, 0xff);
+  ASSERT_EQ(-1, Util::FindFirstBit(ones.data(), ones.size(), false, true));
+  ones[90] = 0xfe;
+  ASSERT_EQ(90 * 8, Util::FindFirstBit(ones.data(), ones.size(), false, false));
+  ASSERT_EQ(90 * 8 + 7, Util::FindFirstBit(ones.data(), ones.size(), false, true));
+}
@@ -0,0 +1,61 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include "test_base.h"
+#include "types/redis_string.h"
+
+class CacheOnlyReadsTest : public TestBase {
+ protected:
+  explicit CacheOnlyReadsTest() : TestBase() { string_ = std::make_unique<Redis::String>(storage_, "cache_only_ns"); }
+  ~CacheOnlyReadsTest() override = default;
+
+  std::unique_ptr<Redis::String> string_;
+};
+
+TEST_F(CacheOnlyReadsTest, MissTheBlockCache) {
+  string_->Set("cache_only_key", "value");
+
+  // The memtable is read without the disk I/O
+  std::string value;
+  Engine::Storage::BeginCacheOnlyReads();
+  EXPECT_TRUE(string_->Get("cache_only_key", &value).ok());
+  EXPECT_FALSE(Engine::Storage::EndCacheOnlyReads());
+  EXPECT_EQ("value", value);
+
+  // The data block of the flushed key isn't in the block cache until it was read
+  auto db = storage_->GetDB();
+  for (const auto &name : {Engine::kMetadataColumnFamilyName, Engine::kSubkeyColumnFamilyName}) {
+    ASSERT_TRUE(db->Flush(rocksdb::FlushOptions(), storage_->GetCFHandle(name)).ok());
+  }
+  Engine::Storage::BeginCacheOnlyReads();
+  EXPECT_TRUE(string_->Get("cache_only_key", &value).IsIncomplete());
+  EXPECT_TRUE(Engine::Storage::EndCacheOnlyReads());
+
+  EXPECT_TRUE(string_->Get("cache_only_key", &value).ok());
+  Engine::Storage::BeginCacheOnlyReads();
+  EXPECT_TRUE(string_->Get("cache_only_key", &value).ok());
+  EXPECT_FALSE(Engine::Storage::EndCacheOnlyReads());
+  EXPECT_EQ("value", value);
+}
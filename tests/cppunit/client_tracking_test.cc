@@ -0,0 +1,142 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "server/client_tracking.h"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <string>
+
+namespace {
+// The worker is only used as the key of the batches, so it's never dereferenced
+Worker *const kWorker = reinterpret_cast<Worker *>(0x1);
+
+TrackingTarget Target(uint64_t id) { return TrackingTarget{kWorker, static_cast<int>(id), id}; }
+}  // namespace
+
+TEST(ClientTracking, InvalidateReadKeys) {
+  ClientTracking tracking;
+  tracking.Enable(1, "ns", Target(10), TrackingOptions{10});
+  ASSERT_TRUE(tracking.HasClients());
+  ASSERT_EQ(tracking.GetRedirect(1), 10);
+  ASSERT_EQ(tracking.GetRedirect(2), -1);
+
+  InvalidationBatches batches;
+  tracking.RememberKeys(1, "ns", {"a", "b"}, 0, &batches);
+  ASSERT_TRUE(batches.empty());
+  ASSERT_EQ(tracking.KeysNum(), 2U);
+
+  tracking.InvalidateKeys(2, "other", {"a"}, &batches);
+  ASSERT_TRUE(batches.empty());
+  tracking.InvalidateKeys(2, "ns", {"a", "c"}, &batches);
+  ASSERT_EQ(batches[kWorker][10].keys, std::set<std::string>{"a"});
+  ASSERT_EQ(batches[kWorker][10].fd, 10);
+  ASSERT_EQ(tracking.KeysNum(), 1U);
+
+  // The invalidated key is forgotten until it's read again
+  batches.clear();
+  tracking.InvalidateKeys(2, "ns", {"a"}, &batches);
+  ASSERT_TRUE(batches.empty());
+}
+
+TEST(ClientTracking, Noloop) {
+  ClientTracking tracking;
+  TrackingOptions options{10};
+  options.noloop = true;
+  tracking.Enable(1, "ns", Target(10), options);
+  tracking.Enable(2, "ns", Target(20), TrackingOptions{20});
+
+  InvalidationBatches batches;
+  tracking.RememberKeys(1, "ns", {"a"}, 0, &batches);
+  tracking.RememberKeys(2, "ns", {"a"}, 0, &batches);
+  tracking.InvalidateKeys(1, "ns", {"a"}, &batches);
+  ASSERT_EQ(batches[kWorker].size(), 1U);
+  ASSERT_EQ(batches[kWorker][20].keys, std::set<std::string>{"a"});
+}
+
+TEST(ClientTracking, Broadcast) {
+  ClientTracking tracking;
+  TrackingOptions options{10};
+  options.bcast = true;
+  options.prefixes = {"user:", "order:"};
+  tracking.Enable(1, "ns", Target(10), options);
+
+  InvalidationBatches batches;
+  // The reads of the broadcasting clients needn't be remembered
+  tracking.RememberKeys(1, "ns", {"user:1"}, 0, &batches);
+  ASSERT_EQ(tracking.KeysNum(), 0U);
+  tracking.InvalidateKeys(2, "ns", {"user:1", "order:2", "item:3"}, &batches);
+  ASSERT_EQ(batches[kWorker][10].keys, (std::set<std::string>{"order:2", "user:1"}));
+
+  // All keys are broadcast without the prefixes
+  tracking.Enable(1, "ns", Target(10), TrackingOptions{10, true});
+  batches.clear();
+  tracking.InvalidateKeys(2, "ns", {"item:3"}, &batches);
+  ASSERT_EQ(batches[kWorker][10].keys, std::set<std::string>{"item:3"});
+
+  tracking.Disable(1);
+  ASSERT_FALSE(tracking.HasClients());
+  batches.clear();
+  tracking.InvalidateKeys(2, "ns", {"item:3"}, &batches);
+  ASSERT_TRUE(batches.empty());
+}
+
+TEST(ClientTracking, DisabledClient) {
+  ClientTracking tracking;
+  tracking.Enable(1, "ns", Target(10), TrackingOptions{10});
+  InvalidationBatches batches;
+  tracking.RememberKeys(1, "ns", {"a"}, 0, &batches);
+  tracking.Disable(1);
+  ASSERT_FALSE(tracking.IsEnabled(1));
+  tracking.InvalidateKeys(2, "ns", {"a"}, &batches);
+  ASSERT_TRUE(batches.empty());
+  ASSERT_EQ(tracking.KeysNum(), 0U);
+}
+
+TEST(ClientTracking, EvictKeys) {
+  ClientTracking tracking;
+  tracking.Enable(1, "ns", Target(10), TrackingOptions{10});
+  InvalidationBatches batches;
+  tracking.RememberKeys(1, "ns", {"a", "b", "c"}, 2, &batches);
+  ASSERT_EQ(tracking.KeysNum(), 2U);
+  ASSERT_EQ(tracking.EvictedKeys(), 1U);
+  // The client is notified of the evicted key as if it was written
+  ASSERT_EQ(batches[kWorker][10].keys.size(), 1U);
+}
+
+TEST(ClientTracking, InvalidateAll) {
+  ClientTracking tracking;
+  tracking.Enable(1, "ns1", Target(10), TrackingOptions{10});
+  tracking.Enable(2, "ns2", Target(20), TrackingOptions{20});
+  InvalidationBatches batches;
+  tracking.RememberKeys(1, "ns1", {"a"}, 0, &batches);
+  tracking.RememberKeys(2, "ns2", {"a"}, 0, &batches);
+
+  tracking.InvalidateAll("ns1", &batches);
+  ASSERT_EQ(batches[kWorker].size(), 1U);
+  ASSERT_TRUE(batches[kWorker][10].flush);
+  ASSERT_EQ(tracking.KeysNum(), 1U);
+
+  batches.clear();
+  tracking.InvalidateAll("", &batches);
+  ASSERT_EQ(batches[kWorker].size(), 2U);
+  ASSERT_EQ(tracking.KeysNum(), 0U);
+}
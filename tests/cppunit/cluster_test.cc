@@ -156,3 +156,94 @@ TEST(Cluster, CluseterGetSlotInfo) {
   ASSERT_TRUE(info.nodes[0].port == 30002);
   ASSERT_TRUE(info.nodes[1].id == "07c37dfeb235213a872192d90877d0cd55635b91");
 }
+
+TEST(Cluster, ClusterSetSlot) {
+  const std::string nodes =
+      "07c37dfeb235213a872192d90877d0cd55635b91 127.0.0.1 30004 "
+      "master - 0-5460\n"
+      "67ed2db8d677e59ec4a4cefb06858cf2a1a89fa1 127.0.0.1 30002 "
+      "master - 5461-10922";
+  Cluster cluster(nullptr, {"127.0.0.1"}, 30002);
+  Status s = cluster.SetClusterNodes(nodes, 1, false);
+  ASSERT_TRUE(s.IsOK());
+
+  // The version must be the current version +1
+  s = cluster.SetSlot(SlotRange(0), "67ed2db8d677e59ec4a4cefb06858cf2a1a89fa1", 3);
+  ASSERT_FALSE(s.IsOK());
+  s = cluster.SetSlot(SlotRange(0), "67ed2db8d677e59ec4a4cefb06858cf2a1a89fa1", 2);
+  ASSERT_TRUE(s.IsOK());
+  ASSERT_EQ(2, cluster.GetVersion());
+
+  std::vector<SlotInfo> slots_infos;
+  s = cluster.GetSlotsInfo(&slots_infos);
+  ASSERT_TRUE(s.IsOK());
+  ASSERT_EQ(3U, slots_infos.size());
+  ASSERT_EQ(0, slots_infos[0].start);
+  ASSERT_EQ(0, slots_infos[0].end);
+  ASSERT_EQ(30002, slots_infos[0].nodes[0].port);
+  ASSERT_EQ(1, slots_infos[1].start);
+  ASSERT_EQ(5460, slots_infos[1].end);
+  ASSERT_EQ(30004, slots_infos[1].nodes[0].port);
+  ASSERT_EQ(5461, slots_infos[2].start);
+  ASSERT_EQ(30002, slots_infos[2].nodes[0].port);
+
+  std::string output_nodes;
+  s = cluster.GetClusterNodes(&output_nodes);
+  ASSERT_TRUE(s.IsOK());
+  for (const auto &node : Util::Split(output_nodes, "\n")) {
+    std::vector<std::string> node_fields = Util::Split(node, " ");
+    if (node_fields[0] == "07c37dfeb235213a872192d90877d0cd55635b91") {
+      ASSERT_EQ("1-5460", node_fields[8]);
+    } else {
+      ASSERT_EQ("myself,master", node_fields[2]);
+      ASSERT_EQ("0 5461-10922", node_fields[8]);
+    }
+  }
+}
+
+TEST(Cluster, ClusterSetSlotRange) {
+  const std::string nodes =
+      "07c37dfeb235213a872192d90877d0cd55635b91 127.0.0.1 30004 "
+      "master - 0-5460\n"
+      "67ed2db8d677e59ec4a4cefb06858cf2a1a89fa1 127.0.0.1 30002 "
+      "master - 5461-10922";
+  Cluster cluster(nullptr, {"127.0.0.1"}, 30002);
+  Status s = cluster.SetClusterNodes(nodes, 1, false);
+  ASSERT_TRUE(s.IsOK());
+
+  // The slots of both nodes are moved to the other node in one version
+  s = cluster.SetSlot(SlotRange(5000, 6000), "ffffffffffffffffffffffffffffffffffffffff", 2);
+  ASSERT_FALSE(s.IsOK());
+  s = cluster.SetSlot(SlotRange(5000, 6000), "67ed2db8d677e59ec4a4cefb06858cf2a1a89fa1", 2);
+  ASSERT_TRUE(s.IsOK());
+  ASSERT_EQ(2, cluster.GetVersion());
+
+  std::vector<SlotInfo> slots_infos;
+  s = cluster.GetSlotsInfo(&slots_infos);
+  ASSERT_TRUE(s.IsOK());
+  ASSERT_EQ(2U, slots_infos.size());
+  ASSERT_EQ(0, slots_infos[0].start);
+  ASSERT_EQ(4999, slots_infos[0].end);
+  ASSERT_EQ(30004, slots_infos[0].nodes[0].port);
+  ASSERT_EQ(5000, slots_infos[1].start);
+  ASSERT_EQ(10922, slots_infos[1].end);
+  ASSERT_EQ(30002, slots_infos[1].nodes[0].port);
+}
+
+TEST(Cluster, SlotRangeParse) {
+  SlotRange range;
+  ASSERT_TRUE(SlotRange::Parse("5", &range));
+  ASSERT_EQ(SlotRange(5), range);
+  ASSERT_EQ("5", range.String());
+  ASSERT_TRUE(SlotRange::Parse("0-16383", &range));
+  ASSERT_EQ(SlotRange(0, 16383), range);
+  ASSERT_EQ("0-16383", range.String());
+  ASSERT_EQ(16384, range.Count());
+
+  ASSERT_FALSE(SlotRange::Parse("-1", &range));
+  ASSERT_FALSE(SlotRange::Parse("16384", &range));
+  ASSERT_FALSE(SlotRange::Parse("10-5", &range));
+  ASSERT_FALSE(SlotRange::Parse("1-16384", &range));
+  ASSERT_FALSE(SlotRange::Parse("a-b", &range));
+  ASSERT_FALSE(SlotRange().IsValid());
+}
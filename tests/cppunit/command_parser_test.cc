@@ -116,3 +116,17 @@ TEST(CommandParser, ParseMove) {
   ASSERT_FALSE(parse(CommandParser(std::move(d2))));
   ASSERT_FALSE(parse(CommandParser(std::move(d3))));
 }
+
+TEST(CommandParser, TakeNumbers) {
+  std::vector<std::string> c1{"10", "1.5", "x", "2"};
+
+  CommandParser parser(c1);
+  ASSERT_EQ(*parser.TakeInt(), 10);
+  ASSERT_EQ(*parser.TakeFloat(), 1.5);
+  ASSERT_FALSE(parser.TakeFloat());
+  ASSERT_FALSE(parser.TakeInt());
+  ASSERT_EQ(*parser.TakeStr(), "x");
+  ASSERT_EQ(*parser.TakeFloat(), 2);
+  ASSERT_FALSE(parser.Good());
+  ASSERT_FALSE(parser.TakeFloat());
+}
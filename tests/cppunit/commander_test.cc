@@ -0,0 +1,70 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+#include "commands/redis_cmd.h"
+
+TEST(Commander, ReuseFreedMemory) {
+  auto commands = Redis::GetCommands();
+  auto get_attr = commands->at("get");
+
+  auto cmd = get_attr->factory();
+  auto addr = cmd.get();
+  cmd.reset();
+  cmd = get_attr->factory();
+  ASSERT_EQ(addr, cmd.get());
+
+  // the commander should be constructed freshly
+  cmd->SetAttributes(get_attr);
+  ASSERT_TRUE(cmd->Args().empty());
+  cmd->SetArgs({"get", "key"});
+  ASSERT_EQ(2, cmd->Args().size());
+  ASSERT_TRUE(cmd->Parse().IsOK());
+}
+
+TEST(Commander, LookupCaseInsensitively) {
+  Redis::ResetCommands();
+  for (const auto &[name, attributes] : *Redis::GetCommands()) {
+    ASSERT_EQ(attributes, Redis::LookupCommand(name));
+    std::string upper = name;
+    std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char c) { return std::toupper(c); });
+    ASSERT_EQ(attributes, Redis::LookupCommand(upper));
+  }
+  ASSERT_EQ(Redis::GetCommands()->at("get"), Redis::LookupCommand("gEt"));
+  ASSERT_EQ(nullptr, Redis::LookupCommand("get1"));
+  ASSERT_EQ(nullptr, Redis::LookupCommand("ge"));
+  ASSERT_EQ(nullptr, Redis::LookupCommand(""));
+
+  // The renamed commands are only found by their new names, except the lookups of the original ones
+  auto commands = Redis::GetCommands();
+  (*commands)["get_new"] = commands->at("get");
+  commands->erase("get");
+  Redis::RefreshCommandLookup();
+  ASSERT_EQ(nullptr, Redis::LookupCommand("GET"));
+  ASSERT_EQ(commands->at("get_new"), Redis::LookupCommand("GET_NEW"));
+  ASSERT_EQ(commands->at("get_new"), Redis::LookupOriginalCommand("Get"));
+  Redis::ResetCommands();
+  ASSERT_NE(nullptr, Redis::LookupCommand("GET"));
+}
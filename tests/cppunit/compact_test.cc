@@ -21,9 +21,12 @@
 #include <gtest/gtest.h>
 
 #include "config.h"
+#include "storage/compact_filter.h"
 #include "storage/redis_metadata.h"
 #include "storage/storage.h"
+#include "storage/table_properties_collector.h"
 #include "types/redis_hash.h"
+#include "types/redis_stream.h"
 #include "types/redis_zset.h"
 
 TEST(Compact, Filter) {
@@ -95,3 +98,108 @@ TEST(Compact, Filter) {
 
   db->ReleaseSnapshot(read_options.snapshot);
 }
+
+TEST(Compact, SubKeyFilterGetMetadata) {
+  Config config;
+  config.db_dir = "compactdb";
+  config.backup_dir = "compactdb/backup";
+  config.slot_id_encoded = false;
+
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  Status s = storage->Open();
+  assert(s.IsOK());
+
+  int ret;
+  std::string ns = "test_compact";
+  auto hash = std::make_unique<Redis::Hash>(storage.get(), ns);
+  std::vector<std::string> ns_keys;
+  for (int i = 0; i < 3; i++) {
+    std::string key = "hash_key_" + std::to_string(i);
+    hash->Set(key, "f1", "v1", &ret);
+    std::string ns_key;
+    ComposeNamespaceKey(ns, key, &ns_key, false);
+    ns_keys.emplace_back(std::move(ns_key));
+  }
+  std::string missing_ns_key;
+  ComposeNamespaceKey(ns, "missing_key", &missing_ns_key, false);
+
+  Engine::SubKeyFilter filter(storage.get());
+  // Look up the keys alternately, which would miss the last looked up key every time
+  for (int round = 0; round < 2; round++) {
+    for (const auto &ns_key : ns_keys) {
+      InternalKey ikey(ns_key, "f1", 0, false);
+      Metadata metadata(kRedisNone, false);
+      EXPECT_TRUE(filter.GetMetadata(ikey, &metadata).IsOK());
+      EXPECT_EQ(metadata.Type(), kRedisHash);
+      EXPECT_EQ(metadata.size, 1);
+    }
+    InternalKey ikey(missing_ns_key, "f1", 0, false);
+    Metadata metadata(kRedisNone, false);
+    EXPECT_TRUE(filter.GetMetadata(ikey, &metadata).Is<Status::NotFound>());
+  }
+}
+
+TEST(Compact, StreamRetention) {
+  Config config;
+  config.db_dir = "compactdb";
+  config.backup_dir = "compactdb/backup";
+  config.slot_id_encoded = false;
+
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  Status s = storage->Open();
+  assert(s.IsOK());
+
+  std::string ns = "test_compact", key = "stream_key";
+  auto stream = std::make_unique<Redis::Stream>(storage.get(), ns);
+  stream->Del(key);
+  Redis::StreamAddOptions options;
+  options.with_entry_id = true;
+  Redis::StreamEntryID id;
+  for (uint64_t ms = 1; ms <= 3; ms++) {
+    options.entry_id = Redis::NewStreamEntryID{ms, 0};
+    EXPECT_TRUE(stream->Add(key, options, {"f", "v"}, &id).ok());
+  }
+  // the old entries are trimmed by the retention of the new one, but not deleted
+  Redis::StreamAddOptions retention_options;
+  retention_options.with_retention = true;
+  retention_options.retention_ms = 60 * 1000;
+  EXPECT_TRUE(stream->Add(key, retention_options, {"f", "v"}, &id).ok());
+  uint64_t len = 0;
+  EXPECT_TRUE(stream->Len(key, &len).ok());
+  EXPECT_EQ(len, 1);
+  Redis::StreamRangeOptions range_options;
+  range_options.start = Redis::StreamEntryID::Minimum();
+  range_options.end = Redis::StreamEntryID::Maximum();
+  std::vector<Redis::StreamEntry> entries;
+  EXPECT_TRUE(stream->Range(key, range_options, &entries).ok());
+  ASSERT_EQ(entries.size(), 1);
+  EXPECT_EQ(entries[0].key, id.ToString());
+
+  auto status = storage->Compact(nullptr, nullptr);
+  assert(status.ok());
+
+  auto db = storage->GetDB();
+  rocksdb::ReadOptions read_options;
+  auto iter = std::unique_ptr<rocksdb::Iterator>(
+      db->NewIterator(read_options, storage->GetCFHandle(Engine::kStreamColumnFamilyName)));
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    InternalKey ikey(iter->key(), storage->IsSlotIdEncoded());
+    if (ikey.GetKey() == key) count++;
+  }
+  EXPECT_EQ(count, 1);
+  stream->Del(key);
+}
+
+TEST(Compact, EstimateExpiredKeys) {
+  rocksdb::UserCollectedProperties properties = {{"total_keys", "100"}, {"deleted_keys", "10"}};
+  EXPECT_EQ(EstimateDeletedKeys(properties, 1000), 10);
+
+  properties["min_expire"] = "1000";
+  properties["max_expire"] = "2000";
+  properties["expiring_keys"] = "80";
+  EXPECT_EQ(EstimateDeletedKeys(properties, 500), 10);
+  EXPECT_EQ(EstimateDeletedKeys(properties, 1500), 50);
+  EXPECT_EQ(EstimateDeletedKeys(properties, 2000), 90);
+  EXPECT_EQ(EstimateDeletedKeys(properties, 3000), 90);
+}
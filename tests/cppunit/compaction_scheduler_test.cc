@@ -0,0 +1,85 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "storage/compaction_scheduler.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "config.h"
+#include "types/redis_string.h"
+
+static rocksdb::LiveFileMetaData newFile(const std::string &smallest, const std::string &largest, uint64_t size) {
+  rocksdb::LiveFileMetaData file;
+  file.smallestkey = smallest;
+  file.largestkey = largest;
+  file.size = size;
+  return file;
+}
+
+TEST(CompactionScheduler, PlanSubJobs) {
+  std::vector<rocksdb::LiveFileMetaData> files = {newFile("e", "f", 60), newFile("a", "b", 60), newFile("c", "d", 60),
+                                                  newFile("g", "h", 10)};
+  auto jobs = CompactionScheduler::PlanSubJobs("default", files, 100);
+  ASSERT_EQ(2, jobs.size());
+  EXPECT_EQ("default", jobs[0].cf_name);
+  EXPECT_EQ("", jobs[0].begin);
+  EXPECT_EQ("e", jobs[0].end);
+  EXPECT_EQ(120, jobs[0].bytes);
+  EXPECT_EQ("e", jobs[1].begin);
+  EXPECT_EQ("", jobs[1].end);
+  EXPECT_EQ(70, jobs[1].bytes);
+
+  EXPECT_TRUE(CompactionScheduler::PlanSubJobs("default", {}, 100).empty());
+  jobs = CompactionScheduler::PlanSubJobs("default", files, 1000);
+  ASSERT_EQ(1, jobs.size());
+  EXPECT_EQ("", jobs[0].begin);
+  EXPECT_EQ("", jobs[0].end);
+}
+
+TEST(CompactionScheduler, Run) {
+  Config config;
+  config.db_dir = "compactionschedulerdb";
+  config.backup_dir = "compactionschedulerdb/backup";
+
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  Status s = storage->Open();
+  ASSERT_TRUE(s.IsOK());
+  auto string = std::make_unique<Redis::String>(storage.get(), "test_compaction_scheduler");
+  for (int i = 0; i < 100; i++) {
+    string->Set("key" + std::to_string(i), "value");
+  }
+  storage->GetDB()->Flush(rocksdb::FlushOptions(), storage->GetCFHandle(Engine::kMetadataColumnFamilyName));
+
+  CompactionScheduler scheduler(storage.get());
+  CompactionScheduler::Options options;
+  options.parallelism = 2;
+  ASSERT_TRUE(scheduler.Run(options).IsOK());
+  EXPECT_GT(scheduler.GetTotalJobs(), 0);
+  for (int i = 0; i < 100 && scheduler.GetState() != CompactionScheduler::State::kIdle; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  EXPECT_EQ(CompactionScheduler::State::kIdle, scheduler.GetState());
+  EXPECT_EQ(scheduler.GetTotalJobs(), scheduler.GetDoneJobs());
+  EXPECT_EQ(scheduler.GetTotalBytes(), scheduler.GetDoneBytes());
+  scheduler.Stop();
+}
@@ -0,0 +1,50 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "compression_util.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+TEST(CompressionUtil, ZstdStream) {
+  Util::ZstdStreamCompressor compressor;
+  Util::ZstdStreamDecompressor decompressor;
+
+  std::vector<std::string> pieces = {"ping", "", std::string(100 * 1024, 'a')};
+  for (int i = 0; i < 100; i++) {
+    pieces.emplace_back("*3\r\n$3\r\nset\r\n$6\r\nkey_" + std::to_string(i) + "\r\n$5\r\nvalue\r\n");
+  }
+  size_t raw_bytes = 0, compressed_bytes = 0;
+  for (const auto &piece : pieces) {
+    std::string compressed, decompressed;
+    ASSERT_TRUE(compressor.Compress(piece, &compressed).IsOK());
+    // Every piece is flushed, so it can be decompressed before the following pieces
+    ASSERT_TRUE(decompressor.Decompress(compressed.data(), compressed.size(), &decompressed).IsOK());
+    ASSERT_EQ(piece, decompressed);
+    raw_bytes += piece.size();
+    compressed_bytes += compressed.size();
+  }
+  ASSERT_LT(compressed_bytes, raw_bytes);
+
+  std::string decompressed;
+  ASSERT_FALSE(decompressor.Decompress("invalid", 7, &decompressed).IsOK());
+}
@@ -38,28 +38,103 @@ TEST(Config, GetAndSet) {
   config.Load(CLIOptions(path));
   std::map<std::string, std::string> mutable_cases = {
       {"timeout", "1000"},
+      {"workers", "4"},
       {"maxclients", "2000"},
       {"max-backup-to-keep", "1"},
       {"max-backup-keep-hours", "4000"},
+      {"backup-incremental", "yes"},
+      {"backup-max-io-mb", "100"},
+      {"backup-threads", "4"},
       {"requirepass", "mytest_requirepass"},
       {"masterauth", "mytest_masterauth"},
       {"compact-cron", "1 2 3 4 5"},
+      {"compaction-checker-tombstone-threshold", "5000"},
+      {"compact-cron-parallelism", "4"},
+      {"compact-cron-max-io-mb", "100"},
+      {"compact-cron-window-minutes", "120"},
       {"bgsave-cron", "5 4 3 2 1"},
       {"max-io-mb", "5000"},
+      {"max-io-mb-auto-tune", "yes"},
+      {"max-io-mb-auto-tune-read-latency-us", "1000"},
+      {"workload-auto-tune", "yes"},
+      {"workload-auto-tune-interval", "30"},
+      {"workload-auto-tune-min-cache-ratio", "10"},
+      {"workload-auto-tune-max-background-compactions", "16"},
+      {"workload-auto-tune-max-write-buffer-size", "512"},
       {"max-db-size", "6000"},
+      {"write-stall-timeout-ms", "100"},
+      {"write-batch-chunk-mb", "4"},
+      {"namespace-max-ops-per-sec", "1000"},
+      {"namespace-max-bytes-per-sec", "1048576"},
+      {"namespace-qos", "ns1:100:0:2,ns2:0:4096"},
+      {"namespace-pipeline-quantum", "16"},
+      {"namespace-max-disk-size", "1024"},
+      {"namespace-disk-quota", "ns1:10240,ns2:0"},
+      {"metadata-cache-size", "64"},
+      {"scan-iterator-cache-size", "128"},
+      {"scan-iterator-idle-timeout", "30"},
+      {"lazy-reclaim-min-elements", "500"},
+      {"lazy-reclaim-max-keys-per-sec", "200"},
+      {"lazy-expire-max-keys-per-sec", "500"},
+      {"range-delete-min-elements", "500"},
+      {"active-expire-enabled", "yes"},
+      {"active-expire-keys-per-cycle", "500"},
+      {"key-count-tracking", "yes"},
+      {"zset-rank-index-min-size", "10000"},
+      {"list-chunked-encoding", "yes"},
+      {"hash-inline-max-entries", "16"},
+      {"hash-inline-max-bytes", "2048"},
+      {"set-inline-max-entries", "32"},
+      {"set-inline-max-bytes", "512"},
+      {"zset-inline-max-entries", "128"},
+      {"zset-inline-max-bytes", "4096"},
+      {"stream-entry-max-schemas", "16"},
+      {"bitmap-segment-containers", "yes"},
+      {"sortedint-block-encoding", "yes"},
+      {"string-chunked-min-bytes", "1048576"},
+      {"metadata-compact-encoding", "yes"},
       {"max-replication-mb", "7000"},
+      {"replication-compression", "zstd"},
+      {"repl-diskless-sync", "yes"},
+      {"min-replicas-to-ack", "1"},
+      {"min-replicas-ack-timeout", "500"},
+      {"wal-retention-replica-timeout", "600"},
+      {"replica-disable-wal", "yes"},
+      {"replica-flush-interval-sec", "10"},
       {"slave-serve-stale-data", "no"},
       {"slave-read-only", "no"},
       {"slave-priority", "101"},
       {"slowlog-log-slower-than", "1234"},
       {"slowlog-max-len", "123"},
+      {"hotkeys-sample-interval", "10"},
+      {"tracking-table-max-keys", "1000"},
+      {"latency-monitor-threshold", "100"},
+      {"info-rocksdb-refresh-ms", "1000"},
+      {"bigkeys-scan-rate", "1000"},
       {"profiling-sample-ratio", "50"},
       {"profiling-sample-record-max-len", "1"},
       {"profiling-sample-record-threshold-ms", "50"},
       {"profiling-sample-commands", "get,set"},
+      {"perf-stats-sample-interval", "100"},
+      {"request-trace-sample-interval", "100"},
       {"backup-dir", "test_dir/backup"},
+      {"pipeline-group-commit", "yes"},
+      {"pipeline-read-prefetch", "yes"},
+      {"read-coalesce-window-ms", "100"},
+      {"worker-offload-cache-missed-reads", "yes"},
+      {"lua-strict-key-accessing", "yes"},
+      {"lua-script-cache-size", "100"},
+      {"cluster-allow-local-cross-slot", "yes"},
+      {"migrate-type", "sst"},
+      {"migrate-ack-latency-target", "100"},
+      {"client-output-buffer-limit", "normal 0 0 0 pubsub 64mb 16mb 120"},
+      {"client-output-buffer-pause-mb", "64"},
+      {"pipeline-reply-cork", "no"},
+      {"client-buffer-shrink-idle", "10"},
 
       {"rocksdb.compression", "no"},
+      {"rocksdb.scan_async_io", "yes"},
+      {"rocksdb.wal_sync_interval_ms", "1000"},
       {"rocksdb.max_open_files", "1234"},
       {"rocksdb.write_buffer_size", "1234"},
       {"rocksdb.max_write_buffer_number", "1"},
@@ -76,6 +151,9 @@ TEST(Config, GetAndSet) {
       {"rocksdb.blob_file_size", "268435456"},
       {"rocksdb.enable_blob_garbage_collection", "yes"},
       {"rocksdb.blob_garbage_collection_age_cutoff", "25"},
+      {"rocksdb.metadata_min_blob_size", "65536"},
+      {"rocksdb.subkey_min_blob_size", "-1"},
+      {"rocksdb.stream_min_blob_size", "1024"},
       {"rocksdb.max_bytes_for_level_base", "268435456"},
       {"rocksdb.max_bytes_for_level_multiplier", "10"},
       {"rocksdb.level_compaction_dynamic_level_bytes", "yes"},
@@ -105,9 +183,18 @@ TEST(Config, GetAndSet) {
   std::map<std::string, std::string> immutable_cases = {
       {"daemonize", "yes"},
       {"bind", "0.0.0.0"},
+      {"metrics-port", "9121"},
       {"repl-bind", "0.0.0.0"},
-      {"workers", "8"},
+      {"worker-offload-threads", "2"},
+      {"lua-readonly-script-threads", "2"},
+      {"scan-parallel-threads", "4"},
+      {"worker-cpu-list", "0-3"},
+      {"background-cpu-list", "4-7"},
+      {"jemalloc-dedicated-arenas", "yes"},
+      {"backup-upload-command", "cat > /dev/null"},
+      {"lock-table-hash-power", "18"},
       {"repl-workers", "8"},
+      {"repl-backlog-mb", "32"},
       {"tcp-backlog", "500"},
       {"slaveof", "no one"},
       {"db-name", "test_dbname"},
@@ -122,7 +209,34 @@ TEST(Config, GetAndSet) {
       {"rocksdb.cache_index_and_filter_blocks", "no"},
       {"rocksdb.metadata_block_cache_size", "100"},
       {"rocksdb.subkey_block_cache_size", "100"},
+      {"rocksdb.namespace_block_cache_size", "100"},
+      {"rocksdb.namespace_write_buffer_size", "16"},
+      {"rocksdb.partition_sst_by_slot", "yes"},
+      {"rocksdb.blob_cache_size", "64"},
+      {"wal-retention-by-replicas", "yes"},
+      {"rocksdb.subkey_cold_dir", "/tmp/kvrocks_cold"},
+      {"rocksdb.subkey_hot_target_size", "1024"},
+      {"namespace-column-families", "ns1,ns2"},
       {"rocksdb.row_cache_size", "100"},
+      {"rocksdb.memtable_total_budget", "1024"},
+      {"rocksdb.memtable_budget_cost_to_cache", "yes"},
+      {"rocksdb.memtable_budget_allow_stall", "yes"},
+      {"rocksdb.block_cache_type", "hcc"},
+      {"rocksdb.compressed_secondary_cache_size", "1024"},
+      {"rocksdb.block_cache_huge_pages", "yes"},
+      {"rocksdb.memtable_huge_pages", "yes"},
+      {"rocksdb.filter_type", "ribbon"},
+      {"rocksdb.metadata_filter_bits_per_key", "16"},
+      {"rocksdb.subkey_filter_bits_per_key", "8"},
+      {"rocksdb.subkey_optimize_filters_for_hits", "yes"},
+      {"rocksdb.subkey_memtable_type", "hash_skiplist"},
+      {"rocksdb.memtable_bloom_size_ratio", "20"},
+      {"rocksdb.max_file_opening_threads", "32"},
+      {"rocksdb.manual_wal_flush", "yes"},
+      {"rocksdb.compression_start_level", "1"},
+      {"rocksdb.metadata_compression_start_level", "3"},
+      {"rocksdb.subkey_compression_max_dict_bytes", "16384"},
+      {"rocksdb.subkey_zstd_max_train_bytes", "1638400"},
   };
   for (const auto &iter : immutable_cases) {
     auto s = config.Set(nullptr, iter.first, iter.second);
@@ -0,0 +1,84 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "storage/expire_reaper.h"
+
+#include <gtest/gtest.h>
+
+#include "config.h"
+#include "storage/storage.h"
+#include "time_util.h"
+#include "types/redis_hash.h"
+#include "types/redis_string.h"
+
+TEST(ExpireReaper, ReapExpiredKeys) {
+  Config config;
+  config.db_dir = "reaperdb";
+  config.backup_dir = "reaperdb/backup";
+  config.active_expire_enabled = true;
+
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  Status s = storage->Open();
+  assert(s.IsOK());
+
+  int ret;
+  std::string ns = "test_reaper";
+  auto string = std::make_unique<Redis::String>(storage.get(), ns);
+  auto hash = std::make_unique<Redis::Hash>(storage.get(), ns);
+  int now = static_cast<int>(Util::GetTimeStamp());
+  string->Set("expired_string", "v");
+  string->Expire("expired_string", now - 10);
+  hash->Set("expired_hash", "f1", "v1", &ret);
+  hash->Expire("expired_hash", now - 5);
+  // The stale index entry of the persisted key shouldn't delete the key
+  string->Set("persisted_string", "v");
+  string->Expire("persisted_string", now - 1);
+  string->Set("persisted_string", "v");
+  string->SetEX("live_string", "v", 100);
+
+  auto IndexSize = [&storage] {
+    std::unique_ptr<rocksdb::Iterator> iter(storage->GetDB()->NewIterator(
+        rocksdb::ReadOptions(), storage->GetCFHandle(Engine::kTTLIndexColumnFamilyName)));
+    int n = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) n++;
+    return n;
+  };
+  EXPECT_EQ(IndexSize(), 4);
+
+  Engine::ExpireReaper reaper(storage.get());
+  EXPECT_TRUE(reaper.ReapOnce(2).IsOK());
+  EXPECT_EQ(reaper.GetExpiredKeys(), 2);
+  EXPECT_EQ(reaper.GetLastExpireTimestamp(), now - 5);
+  EXPECT_TRUE(reaper.ReapOnce(100).IsOK());
+  EXPECT_EQ(reaper.GetExpiredKeys(), 2);
+  EXPECT_EQ(reaper.GetScannedEntries(), 3);
+  // Only the live key is left in the index
+  EXPECT_EQ(IndexSize(), 1);
+
+  std::string value;
+  auto metadata_cf_handle = storage->GetCFHandle(Engine::kMetadataColumnFamilyName);
+  std::string ns_key;
+  ComposeNamespaceKey(ns, "expired_string", &ns_key, false);
+  EXPECT_TRUE(storage->GetDB()->Get(rocksdb::ReadOptions(), metadata_cf_handle, ns_key, &value).IsNotFound());
+  ComposeNamespaceKey(ns, "expired_hash", &ns_key, false);
+  EXPECT_TRUE(storage->GetDB()->Get(rocksdb::ReadOptions(), metadata_cf_handle, ns_key, &value).IsNotFound());
+  EXPECT_TRUE(string->Get("persisted_string", &value).ok());
+  EXPECT_TRUE(string->Get("live_string", &value).ok());
+}
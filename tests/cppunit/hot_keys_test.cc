@@ -0,0 +1,86 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "stats/hot_keys.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+TEST(HotKeys, TopK) {
+  HotKeys hot_keys(4);
+  for (int i = 0; i < 10; i++) {
+    // The key-i is accessed i + 1 times
+    for (int j = 0; j <= i; j++) hot_keys.Record("ns", "key-" + std::to_string(i), false, 1);
+  }
+  auto keys = hot_keys.GetKeys("ns", 1);
+  ASSERT_EQ(keys.size(), 4U);
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(keys[i].key, "key-" + std::to_string(9 - i));
+    ASSERT_EQ(keys[i].reads, static_cast<uint64_t>(10 - i));
+  }
+}
+
+TEST(HotKeys, ReadsAndWrites) {
+  HotKeys hot_keys;
+  for (int i = 0; i < 3; i++) hot_keys.Record("ns", "key", false, 1);
+  for (int i = 0; i < 5; i++) hot_keys.Record("ns", "key", true, 1);
+  auto keys = hot_keys.GetKeys("ns", 1);
+  ASSERT_EQ(keys.size(), 1U);
+  ASSERT_EQ(keys[0].reads, 3U);
+  ASSERT_EQ(keys[0].writes, 5U);
+}
+
+TEST(HotKeys, Namespace) {
+  HotKeys hot_keys;
+  hot_keys.Record("ns1", "key", false, 1);
+  hot_keys.Record("ns2", "key", true, 1);
+  hot_keys.Record("ns2", "other", true, 1);
+  auto keys = hot_keys.GetKeys("ns1", 1);
+  ASSERT_EQ(keys.size(), 1U);
+  ASSERT_EQ(keys[0].reads, 1U);
+  ASSERT_EQ(keys[0].writes, 0U);
+  ASSERT_EQ(hot_keys.GetKeys("ns2", 1).size(), 2U);
+  ASSERT_TRUE(hot_keys.GetKeys("ns3", 1).empty());
+
+  hot_keys.Reset();
+  ASSERT_TRUE(hot_keys.GetKeys("ns2", 1).empty());
+}
+
+TEST(HotKeys, Decay) {
+  HotKeys hot_keys(128, 1000);
+  for (int i = 0; i < 8; i++) hot_keys.Record("ns", "key", false, 1);
+  hot_keys.Record("ns", "cold", false, 1);
+  // The counts are halved once after one period, and twice after two
+  auto keys = hot_keys.GetKeys("ns", 1001);
+  ASSERT_EQ(keys.size(), 1U);
+  ASSERT_EQ(keys[0].reads, 4U);
+  keys = hot_keys.GetKeys("ns", 2001);
+  ASSERT_EQ(keys.size(), 1U);
+  ASSERT_EQ(keys[0].reads, 2U);
+}
+
+TEST(HotKeys, Sample) {
+  HotKeys hot_keys;
+  int sampled = 0;
+  for (int i = 0; i < 100; i++) sampled += hot_keys.ShouldSample(10);
+  ASSERT_EQ(sampled, 10);
+  for (int i = 0; i < 100; i++) ASSERT_FALSE(hot_keys.ShouldSample(0));
+}
@@ -0,0 +1,46 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "storage/huge_page_allocator.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+TEST(HugePageAllocator, AllocateAndDeallocate) {
+  auto allocator = Engine::HugePageAllocator::Create();
+#ifdef ENABLE_JEMALLOC
+  ASSERT_TRUE(allocator) << allocator.Msg();
+  auto &huge_page_allocator = *allocator;
+  std::vector<void *> blocks;
+  for (int i = 0; i < 1024; i++) {
+    void *p = huge_page_allocator->Allocate(4096);
+    ASSERT_NE(nullptr, p);
+    ASSERT_GE(huge_page_allocator->UsableSize(p, 4096), 4096);
+    memset(p, i & 0xff, 4096);
+    blocks.emplace_back(p);
+  }
+  // The extents are mapped from the huge pages, or from the normal pages if none is reserved
+  ASSERT_GE(huge_page_allocator->GetHugePageBytes() + huge_page_allocator->GetFallbackBytes(), 1024 * 4096);
+  for (void *p : blocks) huge_page_allocator->Deallocate(p);
+#else
+  ASSERT_FALSE(allocator);
+#endif
+}
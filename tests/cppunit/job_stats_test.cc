@@ -0,0 +1,52 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "stats/job_stats.h"
+
+#include <gtest/gtest.h>
+
+TEST(JobStats, ColumnFamilyJobStats) {
+  JobStats job_stats;
+  auto stats = job_stats.Get("default");
+  ASSERT_EQ(stats, job_stats.Get("default"));
+  ASSERT_EQ(0, stats->WriteAmplification());
+
+  stats->RecordFlush(100);
+  stats->RecordFlush(300);
+  stats->flushed_bytes += 1000;
+  stats->RecordCompaction(1000, 3000, 2000);
+  stats->RecordStall(false, 10);
+  stats->RecordStall(true, 20);
+  stats->RecordLevel0Files(4);
+
+  ASSERT_EQ(2, stats->flushes);
+  ASSERT_EQ(400, stats->flush_duration_sum);
+  ASSERT_NEAR(300, stats->flush_duration.Percentile(100), 300 / LatencyHistogram::kSubBuckets);
+  ASSERT_EQ(1, stats->compactions);
+  ASSERT_EQ(3000, stats->compaction_input_bytes);
+  ASSERT_EQ(2000, stats->compaction_output_bytes);
+  ASSERT_EQ(3, stats->WriteAmplification());
+  ASSERT_EQ(1, stats->delayed_stalls);
+  ASSERT_EQ(1, stats->stopped_stalls);
+  ASSERT_EQ(30, stats->stall_duration_sum);
+  ASSERT_EQ(4, stats->level0_files);
+
+  job_stats.Get("metadata");
+  ASSERT_EQ((std::vector<std::string>{"default", "metadata"}), job_stats.GetColumnFamilies());
+}
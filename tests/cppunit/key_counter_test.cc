@@ -0,0 +1,109 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "storage/key_counter.h"
+
+#include <gtest/gtest.h>
+
+#include "cluster/redis_slot.h"
+#include "config.h"
+#include "storage/redis_db.h"
+#include "storage/storage.h"
+#include "types/redis_hash.h"
+#include "types/redis_string.h"
+
+TEST(KeyCounter, TrackKeys) {
+  Config config;
+  config.db_dir = "keycounterdb";
+  config.backup_dir = "keycounterdb/backup";
+  config.key_count_tracking = true;
+
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  Status s = storage->Open();
+  assert(s.IsOK());
+  auto key_counter = storage->GetKeyCounter();
+  auto metadata_cf_handle = storage->GetCFHandle(Engine::kMetadataColumnFamilyName);
+
+  std::string ns = "test_key_counter";
+  auto db = std::make_unique<Redis::Database>(storage.get(), ns);
+  EXPECT_TRUE(db->FlushDB().ok());
+  EXPECT_FALSE(key_counter->Ready());
+  EXPECT_TRUE(key_counter->Rebuild(storage->GetDB(), metadata_cf_handle).ok());
+  EXPECT_TRUE(key_counter->Ready());
+  EXPECT_EQ(key_counter->GetKeys(ns), 0);
+
+  int ret;
+  auto string = std::make_unique<Redis::String>(storage.get(), ns);
+  auto hash = std::make_unique<Redis::Hash>(storage.get(), ns);
+  string->Set("string", "v1");
+  hash->Set("hash", "f1", "v1", &ret);
+  hash->Set("hash", "f2", "v2", &ret);
+  hash->Set("another_hash", "f1", "v1", &ret);
+  EXPECT_EQ(key_counter->GetKeys(ns), 3);
+  // Overwrite the existing keys
+  string->Set("string", "v2");
+  hash->Set("hash", "f1", "v3", &ret);
+  EXPECT_EQ(key_counter->GetKeys(ns), 3);
+
+  EXPECT_TRUE(db->Del("string").ok());
+  EXPECT_EQ(key_counter->GetKeys(ns), 2);
+  // The emptied collection doesn't exist any more
+  hash->Delete("another_hash", {"f1"}, &ret);
+  EXPECT_EQ(key_counter->GetKeys(ns), 1);
+  EXPECT_EQ(key_counter->GetKeys("other_ns"), 0);
+
+  // The rebuilt counter should be the same
+  key_counter->Clear();
+  EXPECT_FALSE(key_counter->Ready());
+  EXPECT_TRUE(key_counter->Rebuild(storage->GetDB(), metadata_cf_handle).ok());
+  EXPECT_EQ(key_counter->GetKeys(ns), 1);
+
+  EXPECT_TRUE(db->FlushDB().ok());
+  EXPECT_EQ(key_counter->GetKeys(ns), 0);
+}
+
+TEST(KeyCounter, TrackSlotKeys) {
+  Config config;
+  config.db_dir = "keycounterslotdb";
+  config.backup_dir = "keycounterslotdb/backup";
+  config.key_count_tracking = true;
+  config.slot_id_encoded = true;
+
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  Status s = storage->Open();
+  assert(s.IsOK());
+  auto key_counter = storage->GetKeyCounter();
+  EXPECT_TRUE(key_counter->Rebuild(storage->GetDB(), storage->GetCFHandle(Engine::kMetadataColumnFamilyName)).ok());
+
+  std::string ns = "test_key_counter";
+  auto db = std::make_unique<Redis::Database>(storage.get(), ns);
+  auto string = std::make_unique<Redis::String>(storage.get(), ns);
+  string->Set("{tag}a", "v");
+  string->Set("{tag}b", "v");
+  string->Set("other", "v");
+  int slot = GetSlotNumFromKey("{tag}a");
+  EXPECT_EQ(key_counter->GetKeys(ns), 3);
+  EXPECT_EQ(key_counter->GetSlotKeys(ns, slot), 2);
+  EXPECT_EQ(key_counter->GetSlotKeys(ns, GetSlotNumFromKey("other")), 1);
+
+  EXPECT_TRUE(db->ClearKeysOfSlot(ns, slot).ok());
+  EXPECT_EQ(key_counter->GetSlotKeys(ns, slot), 0);
+  EXPECT_EQ(key_counter->GetKeys(ns), 1);
+}
@@ -0,0 +1,107 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "storage/key_reclaimer.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "config.h"
+#include "storage/redis_metadata.h"
+#include "storage/storage.h"
+#include "types/redis_hash.h"
+#include "types/redis_zset.h"
+
+TEST(KeyReclaimer, ReclaimDeletedKeys) {
+  Config config;
+  config.db_dir = "reclaimdb";
+  config.backup_dir = "reclaimdb/backup";
+  config.slot_id_encoded = false;
+  config.lazy_reclaim_min_elements = 3;
+  config.lazy_reclaim_max_keys_per_sec = 1000;
+
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  Status s = storage->Open();
+  assert(s.IsOK());
+
+  int ret;
+  std::string ns = "test_reclaim";
+  auto hash = std::make_unique<Redis::Hash>(storage.get(), ns);
+  hash->Set("small_hash", "f1", "v1", &ret);
+  hash->Set("large_hash", "f1", "v1", &ret);
+  hash->Set("large_hash", "f2", "v2", &ret);
+  hash->Set("large_hash", "f3", "v3", &ret);
+  hash->Set("live_hash", "f1", "v1", &ret);
+  auto zset = std::make_unique<Redis::ZSet>(storage.get(), ns);
+  std::vector<MemberScore> member_scores = {MemberScore{"z1", 1.1}, MemberScore{"z2", 0.4}, MemberScore{"z3", 2}};
+  zset->Add("large_zset", ZAddFlags::Default(), &member_scores, &ret);
+
+  EXPECT_TRUE(hash->Del("small_hash").ok());
+  EXPECT_TRUE(hash->Del("large_hash").ok());
+  EXPECT_TRUE(zset->Del("large_zset").ok());
+
+  auto key_reclaimer = storage->GetKeyReclaimer();
+  for (int i = 0; i < 100 && key_reclaimer->GetReclaimedKeys() < 2; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(key_reclaimer->GetReclaimedKeys(), 2);
+  EXPECT_EQ(key_reclaimer->GetPendingKeys(), 0);
+
+  rocksdb::DB *db = storage->GetDB();
+  rocksdb::ReadOptions read_options;
+  auto iter = std::unique_ptr<rocksdb::Iterator>(db->NewIterator(read_options, storage->GetCFHandle("subkey")));
+  std::vector<std::string> keys;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    InternalKey ikey(iter->key(), storage->IsSlotIdEncoded());
+    keys.emplace_back(ikey.GetKey().ToString());
+  }
+  // The small key is left to the compaction filter
+  EXPECT_EQ(keys, std::vector<std::string>({"live_hash", "small_hash"}));
+
+  iter.reset(db->NewIterator(read_options, storage->GetCFHandle("zset_score")));
+  iter->SeekToFirst();
+  EXPECT_FALSE(iter->Valid());
+}
+
+TEST(KeyReclaimer, Paused) {
+  Config config;
+  config.db_dir = "reclaimdb";
+  config.backup_dir = "reclaimdb/backup";
+  config.lazy_reclaim_min_elements = 1;
+
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  Status s = storage->Open();
+  assert(s.IsOK());
+
+  Metadata metadata(kRedisHash);
+  metadata.size = 10;
+  auto key_reclaimer = storage->GetKeyReclaimer();
+  key_reclaimer->SetPaused(true);
+  EXPECT_FALSE(key_reclaimer->Reclaim("key", metadata));
+  key_reclaimer->SetPaused(false);
+
+  // Strings have no subkeys to reclaim
+  Metadata string_metadata(kRedisString);
+  EXPECT_FALSE(key_reclaimer->Reclaim("key", string_metadata));
+  config.lazy_reclaim_min_elements = 0;
+  EXPECT_FALSE(key_reclaimer->Reclaim("key", metadata));
+}
@@ -0,0 +1,86 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "stats/latency_monitor.h"
+
+#include <gtest/gtest.h>
+
+TEST(LatencyMonitor, Threshold) {
+  LatencyMonitor monitor;
+  monitor.Record("command", 1000, 1);
+  ASSERT_TRUE(monitor.Latest().empty());
+
+  monitor.SetThreshold(100);
+  monitor.Record("command", 99, 1);
+  ASSERT_TRUE(monitor.Latest().empty());
+  monitor.Record("command", 100, 1);
+  auto latest = monitor.Latest();
+  ASSERT_EQ(1, latest.size());
+  ASSERT_EQ("command", latest[0].event);
+  ASSERT_EQ(1, latest[0].latest.time);
+  ASSERT_EQ(100, latest[0].latest.latency_ms);
+  ASSERT_EQ(100, latest[0].max_latency_ms);
+}
+
+TEST(LatencyMonitor, History) {
+  LatencyMonitor monitor;
+  monitor.SetThreshold(1);
+  // The samples of the same second are merged
+  monitor.Record("eventloop", 10, 1);
+  monitor.Record("eventloop", 30, 1);
+  monitor.Record("eventloop", 20, 1);
+  monitor.Record("eventloop", 5, 2);
+  auto history = monitor.History("eventloop");
+  ASSERT_EQ(2, history.size());
+  ASSERT_EQ(1, history[0].time);
+  ASSERT_EQ(30, history[0].latency_ms);
+  ASSERT_EQ(2, history[1].time);
+  ASSERT_EQ(5, history[1].latency_ms);
+  ASSERT_TRUE(monitor.History("flush").empty());
+
+  // Only the latest samples are kept
+  for (int64_t i = 0; i < static_cast<int64_t>(LatencyMonitor::kSamplesPerEvent) * 2; i++) {
+    monitor.Record("command", 100 + i, 100 + i);
+  }
+  history = monitor.History("command");
+  ASSERT_EQ(LatencyMonitor::kSamplesPerEvent, history.size());
+  ASSERT_EQ(100 + LatencyMonitor::kSamplesPerEvent, history.front().time);
+  ASSERT_EQ(100 + LatencyMonitor::kSamplesPerEvent * 2 - 1, history.back().time);
+  for (size_t i = 1; i < history.size(); i++) ASSERT_LT(history[i - 1].time, history[i].time);
+
+  auto latest = monitor.Latest();
+  ASSERT_EQ(2, latest.size());
+  ASSERT_EQ("command", latest[0].event);
+  ASSERT_EQ(100 + LatencyMonitor::kSamplesPerEvent * 2 - 1, latest[0].max_latency_ms);
+  ASSERT_EQ("eventloop", latest[1].event);
+  ASSERT_EQ(2, latest[1].latest.time);
+  ASSERT_EQ(30, latest[1].max_latency_ms);
+}
+
+TEST(LatencyMonitor, Reset) {
+  LatencyMonitor monitor;
+  monitor.SetThreshold(1);
+  monitor.Record("command", 10, 1);
+  monitor.Record("flush", 10, 1);
+  monitor.Record("compaction", 10, 1);
+  ASSERT_EQ(1, monitor.Reset({"flush", "unknown"}));
+  ASSERT_EQ(2, monitor.Latest().size());
+  ASSERT_EQ(2, monitor.Reset({}));
+  ASSERT_TRUE(monitor.Latest().empty());
+}
@@ -0,0 +1,83 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "storage/lazy_expirer.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "config.h"
+#include "storage/storage.h"
+#include "time_util.h"
+#include "types/redis_hash.h"
+
+TEST(LazyExpirer, DeleteExpiredKeysOnRead) {
+  Config config;
+  config.db_dir = "lazyexpiredb";
+  config.backup_dir = "lazyexpiredb/backup";
+  config.lazy_expire_max_keys_per_sec = 1000;
+
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  Status s = storage->Open();
+  assert(s.IsOK());
+
+  int ret;
+  std::string ns = "test_lazy_expire";
+  auto hash = std::make_unique<Redis::Hash>(storage.get(), ns);
+  hash->Set("expired_hash", "f1", "v1", &ret);
+  hash->Set("live_hash", "f1", "v1", &ret);
+  EXPECT_TRUE(hash->Expire("expired_hash", Util::GetTimeStamp() - 1).ok());
+
+  std::string value;
+  // The expired key is queued once however many times it's read
+  for (int i = 0; i < 3; i++) EXPECT_TRUE(hash->Get("expired_hash", "f1", &value).IsNotFound());
+  EXPECT_TRUE(hash->Get("live_hash", "f1", &value).ok());
+
+  auto lazy_expirer = storage->GetLazyExpirer();
+  for (int i = 0; i < 100 && lazy_expirer->GetExpiredKeys() < 1; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(lazy_expirer->GetExpiredKeys(), 1);
+  EXPECT_EQ(lazy_expirer->GetPendingKeys(), 0);
+
+  std::string raw;
+  EXPECT_TRUE(hash->GetRawMetadataByUserKey("expired_hash", &raw).IsNotFound());
+  EXPECT_TRUE(hash->GetRawMetadataByUserKey("live_hash", &raw).ok());
+}
+
+TEST(LazyExpirer, Disabled) {
+  Config config;
+  config.db_dir = "lazyexpiredb";
+  config.backup_dir = "lazyexpiredb/backup";
+
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  Status s = storage->Open();
+  assert(s.IsOK());
+
+  auto lazy_expirer = storage->GetLazyExpirer();
+  lazy_expirer->SetPaused(true);
+  EXPECT_FALSE(lazy_expirer->Add("key"));
+  lazy_expirer->SetPaused(false);
+
+  config.lazy_expire_max_keys_per_sec = 0;
+  EXPECT_FALSE(lazy_expirer->Add("key"));
+}
@@ -22,6 +22,9 @@
 
 #include <gtest/gtest.h>
 
+#include <thread>
+#include <vector>
+
 TEST(LogCollector, PushEntry) {
   LogCollector<PerfEntry> perf_log;
   perf_log.SetMaxEntries(1);
@@ -35,3 +38,24 @@ TEST(LogCollector, PushEntry) {
   perf_log.Reset();
   EXPECT_EQ(perf_log.Size(), 0);
 }
+
+TEST(LogCollector, MergeShards) {
+  LogCollector<SlowEntry> slow_log;
+  slow_log.SetMaxEntries(10);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&slow_log] {
+      for (int j = 0; j < 5; j++) slow_log.PushEntry(new SlowEntry());
+    });
+  }
+  for (auto &t : threads) t.join();
+  // The entries are kept per thread, but only the latest max entries are visible
+  EXPECT_EQ(slow_log.Size(), 10);
+
+  auto output = slow_log.GetLatestEntries(3);
+  EXPECT_EQ(output.substr(0, 4), "*3\r\n");
+  // the latest entry should be the first one
+  EXPECT_EQ(output.substr(4, 9), "*4\r\n:20\r\n");
+  EXPECT_NE(output.find(":19\r\n"), std::string::npos);
+  EXPECT_NE(output.find(":18\r\n"), std::string::npos);
+}
@@ -0,0 +1,70 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "storage/metadata_cache.h"
+
+#include <gtest/gtest.h>
+
+TEST(MetadataCache, LookupAndErase) {
+  MetadataCache cache(1024 * 1024);
+  std::string value;
+  uint64_t ticket = 0;
+  ASSERT_FALSE(cache.Lookup("key", &value, &ticket));
+  cache.Insert("key", "value", ticket);
+  ASSERT_TRUE(cache.Lookup("key", &value, &ticket));
+  ASSERT_EQ("value", value);
+  ASSERT_EQ(1, cache.GetHits());
+  ASSERT_EQ(1, cache.GetMisses());
+
+  cache.Erase("key");
+  ASSERT_FALSE(cache.Lookup("key", &value, &ticket));
+  cache.Clear();
+  ASSERT_EQ(0, cache.GetUsage());
+}
+
+TEST(MetadataCache, StaleTicket) {
+  MetadataCache cache(1024 * 1024, 0);
+  std::string value;
+  uint64_t ticket = 0;
+  ASSERT_FALSE(cache.Lookup("key", &value, &ticket));
+  // the key was written after the reader missed the cache
+  cache.Erase("key");
+  cache.Insert("key", "stale", ticket);
+  ASSERT_FALSE(cache.Lookup("key", &value, &ticket));
+}
+
+TEST(MetadataCache, Capacity) {
+  MetadataCache cache(4096, 0);
+  uint64_t ticket = 0;
+  std::string value;
+  for (int i = 0; i < 100; i++) {
+    auto key = "key" + std::to_string(i);
+    cache.Lookup(key, &value, &ticket);
+    cache.Insert(key, std::string(100, 'v'), ticket);
+  }
+  ASSERT_LE(cache.GetUsage(), 4096);
+  // the least recently used keys were evicted
+  ASSERT_FALSE(cache.Lookup("key0", &value, &ticket));
+  ASSERT_TRUE(cache.Lookup("key99", &value, &ticket));
+
+  cache.SetCapacity(0);
+  ASSERT_FALSE(cache.Enabled());
+  ASSERT_EQ(0, cache.GetUsage());
+}
@@ -0,0 +1,66 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "server/namespace_qos.h"
+
+#include <gtest/gtest.h>
+
+TEST(NamespaceQoS, OpsLimit) {
+  NamespaceQoS qos;
+  NamespaceQoS::Limits limits{10, 0};
+  uint64_t now_us = 1000000;
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(0, qos.Acquire("ns", limits, 100, now_us));
+  }
+  // A token is refilled every 100ms
+  uint64_t wait_us = qos.Acquire("ns", limits, 100, now_us);
+  ASSERT_GT(wait_us, 0);
+  ASSERT_LE(wait_us, 100000);
+  ASSERT_EQ(0, qos.Acquire("ns", limits, 100, now_us + wait_us));
+  ASSERT_GT(qos.Acquire("ns", limits, 100, now_us + wait_us), 0);
+
+  // The namespaces have their own buckets
+  ASSERT_EQ(0, qos.Acquire("other", limits, 100, now_us));
+
+  auto stats = qos.GetStats();
+  ASSERT_EQ(11, stats["ns"].allowed_cmds);
+  ASSERT_EQ(2, stats["ns"].throttled_cmds);
+  ASSERT_EQ(1, stats["other"].allowed_cmds);
+
+  // The bucket holds the tokens of one second at most
+  now_us += 10 * 1000000;
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(0, qos.Acquire("ns", limits, 100, now_us));
+  }
+  ASSERT_GT(qos.Acquire("ns", limits, 100, now_us), 0);
+}
+
+TEST(NamespaceQoS, BytesLimit) {
+  NamespaceQoS qos;
+  NamespaceQoS::Limits limits{0, 1000};
+  uint64_t now_us = 1000000;
+  // The large request is allowed, and its debt delays the following ones
+  ASSERT_EQ(0, qos.Acquire("ns", limits, 3000, now_us));
+  uint64_t wait_us = qos.Acquire("ns", limits, 10, now_us);
+  ASSERT_GE(wait_us, 2000000);
+  ASSERT_LE(wait_us, 2000001);
+  ASSERT_GT(qos.Acquire("ns", limits, 10, now_us + wait_us / 2), 0);
+  ASSERT_EQ(0, qos.Acquire("ns", limits, 10, now_us + wait_us));
+}
@@ -0,0 +1,65 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "storage/namespace_sizes.h"
+
+#include <gtest/gtest.h>
+
+TEST(NamespaceSizes, Quota) {
+  Engine::NamespaceSizes sizes;
+  ASSERT_FALSE(sizes.Enabled());
+  // The untracked namespaces are neither counted nor limited
+  sizes.Add("ns", 100);
+  ASSERT_EQ(0, sizes.GetSize("ns"));
+  ASSERT_FALSE(sizes.IsOverQuota("ns"));
+
+  sizes.Reconcile("ns", 600, 1000);
+  ASSERT_TRUE(sizes.Enabled());
+  ASSERT_EQ(600, sizes.GetSize("ns"));
+  ASSERT_FALSE(sizes.IsOverQuota("ns"));
+  sizes.Add("ns", 300);
+  ASSERT_FALSE(sizes.IsOverQuota("ns"));
+  sizes.Add("ns", 100);
+  ASSERT_EQ(1000, sizes.GetSize("ns"));
+  ASSERT_TRUE(sizes.IsOverQuota("ns"));
+  ASSERT_FALSE(sizes.IsOverQuota("other"));
+
+  // The space was freed by the compaction
+  sizes.Reconcile("ns", 200, 1000);
+  ASSERT_EQ(200, sizes.GetSize("ns"));
+  ASSERT_FALSE(sizes.IsOverQuota("ns"));
+  // The quota was lowered
+  sizes.Reconcile("ns", 200, 100);
+  ASSERT_TRUE(sizes.IsOverQuota("ns"));
+}
+
+TEST(NamespaceSizes, Retain) {
+  Engine::NamespaceSizes sizes;
+  sizes.Reconcile("ns1", 100, 100);
+  sizes.Reconcile("ns2", 100, 100);
+  sizes.Retain({"ns2"});
+  ASSERT_TRUE(sizes.Enabled());
+  ASSERT_FALSE(sizes.IsOverQuota("ns1"));
+  ASSERT_EQ(0, sizes.GetSize("ns1"));
+  ASSERT_TRUE(sizes.IsOverQuota("ns2"));
+  sizes.Retain({});
+  ASSERT_FALSE(sizes.Enabled());
+  ASSERT_FALSE(sizes.IsOverQuota("ns2"));
+}
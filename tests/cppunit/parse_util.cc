@@ -21,6 +21,9 @@
 #include <gtest/gtest.h>
 #include <parse_util.h>
 
+#include <cmath>
+#include <limits>
+
 TEST(ParseUtil, TryParseInt) {
   long long v;
   const char *str = "12345hellooo", *end;
@@ -54,3 +57,31 @@ TEST(ParseUtil, ParseInt) {
   ASSERT_EQ(*ParseInt("123", {0, 123}), 123);
   ASSERT_EQ(ParseInt("124", {0, 123}).Msg(), "out of numeric range");
 }
+
+TEST(ParseUtil, ParseIntView) {
+  std::string_view v = "12345";
+  ASSERT_EQ(*ParseInt<int>(v.substr(0, 3), 10), 123);
+  ASSERT_EQ(*ParseInt("-0x1a"), -26);
+  ASSERT_EQ(*ParseInt("+12", 10), 12);
+  ASSERT_EQ(*ParseInt<short>("-32768"), -32768);
+  ASSERT_EQ(ParseInt<short>("-32769").Msg(), "out of range of integer type");
+  ASSERT_EQ(*ParseInt<int64_t>("-9223372036854775808"), std::numeric_limits<int64_t>::min());
+  ASSERT_FALSE(ParseInt<int64_t>("9223372036854775808"));
+  ASSERT_EQ(*ParseInt<uint64_t>("18446744073709551615"), std::numeric_limits<uint64_t>::max());
+  ASSERT_EQ(ParseInt<int>("-").Msg(), "not started as an integer");
+  ASSERT_EQ(ParseInt<int>(std::string_view("1\0", 2), 10).Msg(), "encounter non-integer characters");
+}
+
+TEST(ParseUtil, ParseFloat) {
+  ASSERT_EQ(*ParseFloat("1.5"), 1.5);
+  ASSERT_EQ(*ParseFloat("-2e3"), -2000);
+  ASSERT_EQ(*ParseFloat(std::string_view("1.25x", 4)), 1.25);
+  ASSERT_TRUE(std::isinf(*ParseFloat("-inf")));
+  ASSERT_TRUE(std::isnan(*ParseFloat("nan")));
+  ASSERT_EQ(*ParseFloat(std::string(99, '0') + "1.5"), 1.5);
+
+  ASSERT_EQ(ParseFloat("").Msg(), "not started as a number");
+  ASSERT_EQ(ParseFloat(" 1").Msg(), "not started as a number");
+  ASSERT_EQ(ParseFloat("1.5x").Msg(), "encounter non-numeric characters");
+  ASSERT_EQ(ParseFloat("1e999").Msg(), "out of range of float type");
+}
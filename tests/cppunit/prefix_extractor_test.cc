@@ -0,0 +1,51 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "storage/prefix_extractor.h"
+
+#include <gtest/gtest.h>
+
+#include "storage/redis_metadata.h"
+
+TEST(InternalKeyPrefixExtractor, Transform) {
+  for (bool slot_id_encoded : {false, true}) {
+    InternalKeyPrefixExtractor extractor(slot_id_encoded);
+    std::string ns_key, prefix, subkey, other_subkey;
+    ComposeNamespaceKey("ns", "key", &ns_key, slot_id_encoded);
+    InternalKey(ns_key, "", 1, slot_id_encoded).Encode(&prefix);
+    InternalKey(ns_key, "field", 1, slot_id_encoded).Encode(&subkey);
+    InternalKey(ns_key, "other-field", 1, slot_id_encoded).Encode(&other_subkey);
+
+    ASSERT_TRUE(extractor.InDomain(prefix));
+    ASSERT_TRUE(extractor.InDomain(subkey));
+    ASSERT_EQ(prefix, extractor.Transform(prefix).ToString());
+    ASSERT_EQ(prefix, extractor.Transform(subkey).ToString());
+    ASSERT_EQ(prefix, extractor.Transform(other_subkey).ToString());
+
+    std::string other_version;
+    InternalKey(ns_key, "field", 2, slot_id_encoded).Encode(&other_version);
+    ASSERT_NE(prefix, extractor.Transform(other_version).ToString());
+
+    // the truncated keys are out of the domain
+    ASSERT_FALSE(extractor.InDomain(""));
+    ASSERT_FALSE(extractor.InDomain(ns_key));
+    ASSERT_FALSE(extractor.InDomain(rocksdb::Slice(prefix.data(), prefix.size() - 1)));
+  }
+}
@@ -0,0 +1,73 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "stats/prometheus.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+TEST(PrometheusWriter, Samples) {
+  PrometheusWriter writer;
+  writer.Family("kvrocks_commands_total", "counter", "The number of the executed commands");
+  writer.Sample("kvrocks_commands_total", uint64_t(42));
+  writer.Family("kvrocks_command_calls_total", "counter", "The calls of the commands");
+  writer.Sample("kvrocks_command_calls_total", {{"cmd", "get"}}, uint64_t(3));
+  // The HELP and TYPE lines shouldn't be repeated
+  writer.Family("kvrocks_command_calls_total", "counter", "The calls of the commands");
+  writer.Sample("kvrocks_command_calls_total", {{"cmd", "set"}, {"ns", "a\"b"}}, uint64_t(4));
+  writer.Family("kvrocks_lag_seconds", "gauge", "The lag");
+  writer.Sample("kvrocks_lag_seconds", 0.5);
+
+  std::string expected =
+      "# HELP kvrocks_commands_total The number of the executed commands\n"
+      "# TYPE kvrocks_commands_total counter\n"
+      "kvrocks_commands_total 42\n"
+      "# HELP kvrocks_command_calls_total The calls of the commands\n"
+      "# TYPE kvrocks_command_calls_total counter\n"
+      "kvrocks_command_calls_total{cmd=\"get\"} 3\n"
+      "kvrocks_command_calls_total{cmd=\"set\",ns=\"a\\\"b\"} 4\n"
+      "# HELP kvrocks_lag_seconds The lag\n"
+      "# TYPE kvrocks_lag_seconds gauge\n"
+      "kvrocks_lag_seconds 0.5\n";
+  ASSERT_EQ(expected, writer.Output());
+}
+
+TEST(PrometheusWriter, Histogram) {
+  LatencyHistogram histogram;
+  histogram.Record(5);
+  histogram.Record(100);
+  histogram.Record(100);
+  PrometheusWriter writer;
+  writer.Histogram("latency_seconds", {{"cmd", "get"}}, histogram, 205);
+
+  const auto &output = writer.Output();
+  ASSERT_NE(std::string::npos, output.find("latency_seconds_bucket{cmd=\"get\",le=\"7e-06\"} 1\n"));
+  ASSERT_NE(std::string::npos, output.find("latency_seconds_bucket{cmd=\"get\",le=\"6.3e-05\"} 1\n"));
+  ASSERT_NE(std::string::npos, output.find("latency_seconds_bucket{cmd=\"get\",le=\"0.000127\"} 3\n"));
+  ASSERT_NE(std::string::npos, output.find("latency_seconds_bucket{cmd=\"get\",le=\"+Inf\"} 3\n"));
+  ASSERT_NE(std::string::npos, output.find("latency_seconds_sum{cmd=\"get\"} 0.000205\n"));
+  ASSERT_NE(std::string::npos, output.find("latency_seconds_count{cmd=\"get\"} 3\n"));
+}
+
+TEST(PrometheusWriter, Escape) {
+  ASSERT_EQ("rocksdb_block_cache_miss", PrometheusWriter::SanitizeName("rocksdb.block.cache.miss"));
+  ASSERT_EQ("_rocksdb_db_get_micros", PrometheusWriter::SanitizeName("9rocksdb.db-get.micros"));
+  ASSERT_EQ("a\\\\b\\nc\\\"", PrometheusWriter::EscapeLabelValue("a\\b\nc\""));
+}
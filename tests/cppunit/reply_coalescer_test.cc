@@ -0,0 +1,76 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "server/reply_coalescer.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+TEST(ReplyCoalescer, LookupInWindow) {
+  ReplyCoalescer coalescer;
+  auto request = ReplyCoalescer::EncodeRequest("ns", {"GET", "key"});
+  ASSERT_EQ(request, ReplyCoalescer::EncodeRequest("ns", {"get", "key"}));
+  ASSERT_NE(request, ReplyCoalescer::EncodeRequest("ns", {"get", "KEY"}));
+  ASSERT_NE(request, ReplyCoalescer::EncodeRequest("other", {"get", "key"}));
+
+  std::string reply;
+  ASSERT_FALSE(coalescer.Lookup(request, 1, 100, &reply));
+  coalescer.Insert(request, "$5\r\nvalue\r\n", 1, 100, 10);
+  ASSERT_TRUE(coalescer.Lookup(request, 1, 109, &reply));
+  ASSERT_EQ(reply, "$5\r\nvalue\r\n");
+
+  // The reply is dropped once the window passed or the key was written
+  ASSERT_FALSE(coalescer.Lookup(request, 1, 110, &reply));
+  coalescer.Insert(request, "$5\r\nvalue\r\n", 1, 100, 10);
+  ASSERT_FALSE(coalescer.Lookup(request, 2, 101, &reply));
+  ASSERT_FALSE(coalescer.Lookup(request, 1, 101, &reply));
+  ASSERT_EQ(coalescer.GetUsage(), 0U);
+}
+
+TEST(ReplyCoalescer, BoundedByCapacity) {
+  ReplyCoalescer coalescer(1024);
+  std::string reply(300, 'x'), out;
+  for (int i = 0; i < 3; i++) {
+    coalescer.Insert(ReplyCoalescer::EncodeRequest("ns", {"get", std::to_string(i)}), reply, 1, 100, 10);
+  }
+  ASSERT_LE(coalescer.GetUsage(), 1024U);
+  ASSERT_TRUE(coalescer.Lookup(ReplyCoalescer::EncodeRequest("ns", {"get", "2"}), 1, 100, &out));
+
+  // The expired entries are dropped to make room for the new one
+  coalescer.Insert(ReplyCoalescer::EncodeRequest("ns", {"get", "3"}), reply, 1, 200, 10);
+  ASSERT_TRUE(coalescer.Lookup(ReplyCoalescer::EncodeRequest("ns", {"get", "3"}), 1, 200, &out));
+  ASSERT_FALSE(coalescer.Lookup(ReplyCoalescer::EncodeRequest("ns", {"get", "2"}), 1, 200, &out));
+
+  coalescer.Insert(ReplyCoalescer::EncodeRequest("ns", {"get", "4"}), std::string(2048, 'x'), 1, 200, 10);
+  ASSERT_FALSE(coalescer.Lookup(ReplyCoalescer::EncodeRequest("ns", {"get", "4"}), 1, 200, &out));
+}
+
+TEST(KeyWriteEpochs, Bump) {
+  KeyWriteEpochs epochs;
+  auto e1 = epochs.Get("key1"), e2 = epochs.Get("key2");
+  epochs.Bump("key1");
+  ASSERT_NE(epochs.Get("key1"), e1);
+  e1 = epochs.Get("key1");
+  epochs.BumpAll();
+  ASSERT_NE(epochs.Get("key1"), e1);
+  ASSERT_NE(epochs.Get("key2"), e2);
+}
@@ -0,0 +1,83 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "stats/request_trace.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include "storage/lock_manager.h"
+
+TEST(RequestTrace, Record) {
+  RequestTrace trace(1000);
+  trace.Record(TRACE_STAGE_QUEUE, 1000, 1010);
+  trace.Record(TRACE_STAGE_LOCK_WAIT, 1020, 1025);
+  trace.Record(TRACE_STAGE_LOCK_WAIT, 1030, 1040);
+
+  ASSERT_TRUE(trace.GetSpan(TRACE_STAGE_QUEUE).recorded);
+  ASSERT_EQ(0, trace.GetSpan(TRACE_STAGE_QUEUE).offset_us);
+  ASSERT_EQ(10, trace.GetSpan(TRACE_STAGE_QUEUE).duration_us);
+  // The lock waits are summed up and start at the first one
+  ASSERT_EQ(20, trace.GetSpan(TRACE_STAGE_LOCK_WAIT).offset_us);
+  ASSERT_EQ(15, trace.GetSpan(TRACE_STAGE_LOCK_WAIT).duration_us);
+  ASSERT_FALSE(trace.GetSpan(TRACE_STAGE_REPLY).recorded);
+  ASSERT_STREQ("lock_wait", RequestTraceStageName(TRACE_STAGE_LOCK_WAIT));
+}
+
+TEST(RequestTrace, Scope) {
+  ASSERT_EQ(nullptr, RequestTrace::Current());
+  RequestTrace outer(0), inner(0);
+  {
+    RequestTrace::Scope outer_scope(&outer);
+    ASSERT_EQ(&outer, RequestTrace::Current());
+    {
+      RequestTrace::Scope inner_scope(&inner);
+      ASSERT_EQ(&inner, RequestTrace::Current());
+    }
+    ASSERT_EQ(&outer, RequestTrace::Current());
+  }
+  ASSERT_EQ(nullptr, RequestTrace::Current());
+}
+
+TEST(RequestTrace, LockWait) {
+  LockManager lock_mgr(4);
+  RequestTrace trace(0);
+  RequestTrace::Scope scope(&trace);
+  {
+    LockGuard guard(&lock_mgr, "key");
+  }
+  // The uncontended lock isn't a wait
+  ASSERT_FALSE(trace.GetSpan(TRACE_STAGE_LOCK_WAIT).recorded);
+
+  std::atomic<bool> locked = false;
+  std::thread locker([&lock_mgr, &locked] {
+    LockGuard guard(&lock_mgr, "key");
+    locked = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  });
+  while (!locked) std::this_thread::yield();
+  {
+    MultiLockGuard guard(&lock_mgr, {"key"});
+  }
+  locker.join();
+  ASSERT_TRUE(trace.GetSpan(TRACE_STAGE_LOCK_WAIT).recorded);
+  ASSERT_GE(trace.GetSpan(TRACE_STAGE_LOCK_WAIT).duration_us, 5000);
+}
@@ -20,6 +20,9 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <thread>
 
@@ -54,6 +57,85 @@ TEST(LockManager, LockMultiKeys) {
   }
 }
 
+TEST(LockManager, SharedLock) {
+  LockManager lock_manager(8);
+  lock_manager.LockShared("key");
+  // The other readers aren't blocked by the shared lock, but the writers are
+  std::thread reader([&lock_manager]() {
+    lock_manager.LockShared("key");
+    lock_manager.UnLockShared("key");
+  });
+  reader.join();
+
+  std::atomic<bool> locked = false;
+  std::thread writer([&lock_manager, &locked]() {
+    lock_manager.Lock("key");
+    locked = true;
+    lock_manager.UnLock("key");
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_FALSE(locked);
+  lock_manager.UnLockShared("key");
+  writer.join();
+  ASSERT_TRUE(locked);
+}
+
+TEST(LockManager, MultiGetSharedAndExclusive) {
+  LockManager lock_manager(16);
+  auto locks = lock_manager.MultiGet({"a"}, {"a", "b"});
+  // The lock of the key in both modes is exclusive
+  ASSERT_EQ(1, std::count_if(locks.begin(), locks.end(), [](const KeyLock &lock) { return lock.exclusive; }));
+  ASSERT_LE(locks.size(), 2U);
+
+  std::vector<std::string> writers = {"a0", "a1"}, readers = {"a2", "a3", "a4", "a5", "a6", "a7"};
+  std::thread ths[10];
+  for (int i = 0; i < 10; i++) {
+    ths[i] = std::thread([&lock_manager, &writers, &readers, i]() {
+      // Lock the same slots in the different orders
+      if (i % 2 == 0) {
+        MultiLockGuard guard(&lock_manager, writers, readers);
+      } else {
+        MultiLockGuard guard(&lock_manager, {writers.rbegin(), writers.rend()}, {readers.rbegin(), readers.rend()});
+      }
+    });
+  }
+  for (auto &th : ths) {
+    th.join();
+  }
+}
+
+TEST(LockManager, ContentionStats) {
+  LockManager lock_manager(10);
+  {
+    LockGuard guard(&lock_manager, "key");
+  }
+  // The uncontended lock isn't a wait
+  ASSERT_EQ(0, lock_manager.GetWaits());
+  ASSERT_TRUE(lock_manager.GetContendedSlots(10).empty());
+
+  std::atomic<bool> locked = false;
+  std::thread locker([&lock_manager, &locked] {
+    LockGuard guard(&lock_manager, "key");
+    locked = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  });
+  while (!locked) std::this_thread::yield();
+  {
+    MultiLockGuard guard(&lock_manager, {"key"});
+  }
+  locker.join();
+  ASSERT_EQ(1, lock_manager.GetWaits());
+  ASSERT_GE(lock_manager.GetWaitUS(), 5000);
+  auto slots = lock_manager.GetContendedSlots(10);
+  ASSERT_EQ(1, slots.size());
+  ASSERT_EQ(1, slots[0].waits);
+  ASSERT_EQ(std::vector<std::string>{"key"}, slots[0].keys);
+
+  lock_manager.ResetStats();
+  ASSERT_EQ(0, lock_manager.GetWaits());
+  ASSERT_TRUE(lock_manager.GetContendedSlots(10).empty());
+}
+
 TEST(ReadWriteLock, ReadLockGurad) {
   RWLock::ReadWriteLock rwlock;
   int val = 1;
@@ -176,3 +258,110 @@ TEST(ReadWriteLock, WriteLockGurad_First) {
     ths[i].join();
   }
 }
+
+TEST(ShardedReadWriteLock, ReadLockGuard_Concurrency) {
+  RWLock::ShardedReadWriteLock rwlock;
+
+  std::time_t start = std::time(nullptr);
+  std::thread ths[5];
+  for (int i = 0; i < 5; i++) {
+    ths[i] = std::thread([&rwlock]() {
+      RWLock::ShardedReadLock rlock(rwlock);
+      sleep(1);
+    });
+  }
+
+  for (int i = 0; i < 5; i++) {
+    ths[i].join();
+  }
+
+  std::time_t end = std::time(nullptr);
+  ASSERT_LE(end - start, 2);
+}
+
+TEST(ShardedReadWriteLock, WriteLockGuard_Exclusive) {
+  RWLock::ShardedReadWriteLock rwlock;
+  int val = 0;
+
+  std::thread ths[10];
+  for (int i = 0; i < 10; i++) {
+    ths[i] = std::thread([&rwlock, &val, i]() {
+      for (int j = 0; j < 10000; j++) {
+        if ((i % 2) == 0) {
+          RWLock::ShardedWriteLock wlock(rwlock);
+          val++;
+        } else {
+          RWLock::ShardedReadLock rlock(rwlock);
+          int read_val = val;
+          ASSERT_EQ(read_val, val);
+        }
+      }
+    });
+  }
+
+  for (int i = 0; i < 10; i++) {
+    ths[i].join();
+  }
+  ASSERT_EQ(50000, val);
+}
+
+TEST(ShardedReadWriteLock, WriteLockGuard_WaitReaders) {
+  RWLock::ShardedReadWriteLock rwlock;
+  std::atomic<int> val{0};
+
+  std::thread reader([&rwlock, &val]() {
+    RWLock::ShardedReadLock rlock(rwlock);
+    usleep(200000);
+    val = 1;
+  });
+  usleep(100000);  // Make sure the reader has acquired the lock
+  {
+    RWLock::ShardedWriteLock wlock(rwlock);
+    ASSERT_EQ(1, val);
+  }
+  reader.join();
+}
+
+TEST(ShardedReadWriteLock, WriteLockGuard_First) {
+  RWLock::ShardedReadWriteLock rwlock;
+  int val = 0;
+
+  std::thread ths[6];
+  for (int i = 0; i < 6; i++) {
+    if ((i % 2) == 0) {
+      ths[i] = std::thread([&rwlock, &val]() {
+        RWLock::ShardedWriteLock wlock(rwlock);
+        sleep(1);  // The second write lock thread will get right to process
+        val++;
+      });
+    } else {
+      ths[i] = std::thread([&rwlock, &val]() {
+        usleep(100000);  // To avoid it is the first to run, just sleep 100ms
+        RWLock::ShardedReadLock rlock(rwlock);
+        ASSERT_EQ(val, 3);
+      });
+    }
+  }
+
+  for (int i = 0; i < 6; i++) {
+    ths[i].join();
+  }
+}
+
+TEST(ReadWriteLock, TryLockRead) {
+  RWLock::ReadWriteLock rwlock;
+  ASSERT_TRUE(rwlock.TryLockRead());
+  { RWLock::ReadLock guard(rwlock, std::adopt_lock); }
+
+  std::atomic<bool> writing = false;
+  std::thread writer([&] {
+    RWLock::WriteLock guard(rwlock);
+    writing = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  });
+  while (!writing) std::this_thread::yield();
+  ASSERT_FALSE(rwlock.TryLockRead());
+  writer.join();
+  ASSERT_TRUE(rwlock.TryLockRead());
+  rwlock.UnLockRead();
+}
@@ -0,0 +1,66 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "storage/scan_iterator_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+TEST(ScanIteratorCache, TakeAndPut) {
+  ScanIteratorCache cache;
+  EXPECT_EQ(nullptr, cache.Take("a"));
+
+  cache.Put("a", std::make_unique<PinnedIterator>(), 2);
+  cache.Put("b", std::make_unique<PinnedIterator>(), 2);
+  EXPECT_EQ(2, cache.Size());
+  // The iterator is taken out, so it's never used by two scans
+  EXPECT_NE(nullptr, cache.Take("a"));
+  EXPECT_EQ(nullptr, cache.Take("a"));
+  EXPECT_EQ(1, cache.GetHits());
+  EXPECT_EQ(2, cache.GetMisses());
+
+  // The least recently used one is evicted beyond the capacity
+  cache.Put("a", std::make_unique<PinnedIterator>(), 2);
+  cache.Put("c", std::make_unique<PinnedIterator>(), 2);
+  EXPECT_EQ(2, cache.Size());
+  EXPECT_EQ(nullptr, cache.Take("b"));
+  EXPECT_NE(nullptr, cache.Take("c"));
+
+  // Nothing is cached without the capacity
+  cache.Put("d", std::make_unique<PinnedIterator>(), 0);
+  EXPECT_EQ(nullptr, cache.Take("d"));
+
+  cache.Clear();
+  EXPECT_EQ(0, cache.Size());
+}
+
+TEST(ScanIteratorCache, EvictIdle) {
+  ScanIteratorCache cache;
+  cache.Put("a", std::make_unique<PinnedIterator>(), 8);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  cache.Put("b", std::make_unique<PinnedIterator>(), 8);
+  cache.EvictIdle(30);
+  EXPECT_EQ(1, cache.Size());
+  EXPECT_EQ(nullptr, cache.Take("a"));
+  EXPECT_NE(nullptr, cache.Take("b"));
+}
@@ -0,0 +1,65 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "spsc_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+TEST(SPSCQueue, PushAndPop) {
+  SPSCQueue<std::string> queue(3);
+  ASSERT_EQ(queue.Capacity(), 4U);
+  ASSERT_FALSE(queue.TryPop());
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(queue.TryPush(std::to_string(i)));
+  }
+  ASSERT_FALSE(queue.TryPush("overflow"));
+  ASSERT_EQ(queue.Size(), 4U);
+  for (int i = 0; i < 4; i++) {
+    auto item = queue.TryPop();
+    ASSERT_TRUE(item);
+    ASSERT_EQ(*item, std::to_string(i));
+  }
+  ASSERT_FALSE(queue.TryPop());
+  ASSERT_TRUE(queue.TryPush("wrapped"));
+  ASSERT_EQ(*queue.TryPop(), "wrapped");
+}
+
+TEST(SPSCQueue, ProducerAndConsumer) {
+  SPSCQueue<int> queue(64);
+  const int n = 100000;
+  std::thread producer([&queue]() {
+    for (int i = 0; i < n; i++) {
+      while (!queue.TryPush(int(i))) std::this_thread::yield();
+    }
+  });
+  for (int expected = 0; expected < n;) {
+    auto item = queue.TryPop();
+    if (!item) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(*item, expected++);
+  }
+  producer.join();
+  ASSERT_EQ(queue.Size(), 0U);
+}
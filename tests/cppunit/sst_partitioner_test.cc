@@ -0,0 +1,67 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "storage/sst_partitioner.h"
+
+#include <gtest/gtest.h>
+
+#include "storage/redis_metadata.h"
+
+namespace {
+
+rocksdb::PartitionerResult ShouldPartition(SlotSstPartitioner *partitioner, const std::string &prev,
+                                           const std::string &current, uint64_t file_size) {
+  return partitioner->ShouldPartition(rocksdb::PartitionerRequest(prev, current, file_size));
+}
+
+}  // namespace
+
+TEST(SlotSstPartitioner, ShouldPartition) {
+  SlotSstPartitioner partitioner(true, 1024);
+  std::string key1, key2, other_slot_key, other_ns_key, subkey;
+  ComposeNamespaceKey("ns", "{a}1", &key1, true);
+  ComposeNamespaceKey("ns", "{a}2", &key2, true);
+  ComposeNamespaceKey("ns", "{b}1", &other_slot_key, true);
+  ComposeNamespaceKey("other", "{a}1", &other_ns_key, true);
+  InternalKey(key1, "field", 1, true).Encode(&subkey);
+
+  ASSERT_EQ(rocksdb::kNotRequired, ShouldPartition(&partitioner, key1, key2, 4096));
+  ASSERT_EQ(rocksdb::kNotRequired, ShouldPartition(&partitioner, key1, subkey, 4096));
+  ASSERT_EQ(rocksdb::kRequired, ShouldPartition(&partitioner, key1, other_slot_key, 4096));
+  // the small files aren't cut at the slot boundaries
+  ASSERT_EQ(rocksdb::kNotRequired, ShouldPartition(&partitioner, key1, other_slot_key, 100));
+  ASSERT_EQ(rocksdb::kRequired, ShouldPartition(&partitioner, key1, other_ns_key, 100));
+
+  ASSERT_TRUE(partitioner.CanDoTrivialMove(key1, other_slot_key));
+  ASSERT_FALSE(partitioner.CanDoTrivialMove(key1, other_ns_key));
+}
+
+TEST(SlotSstPartitioner, WithoutSlotID) {
+  SlotSstPartitioner partitioner(false, 0);
+  std::string key1, key2, other_ns_key;
+  ComposeNamespaceKey("ns", "{a}1", &key1, false);
+  ComposeNamespaceKey("ns", "{b}1", &key2, false);
+  ComposeNamespaceKey("ns1", "{a}1", &other_ns_key, false);
+
+  ASSERT_EQ(rocksdb::kNotRequired, ShouldPartition(&partitioner, key1, key2, 4096));
+  // the namespace "ns" is a prefix of "ns1", but their sizes differ
+  ASSERT_EQ(rocksdb::kRequired, ShouldPartition(&partitioner, key1, other_ns_key, 0));
+  ASSERT_EQ(rocksdb::kRequired, ShouldPartition(&partitioner, "", key1, 0));
+}
@@ -0,0 +1,132 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "stats/stats.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+TEST(LatencyHistogram, BucketIndex) {
+  for (uint64_t i = 0; i < LatencyHistogram::kSubBuckets * 2; i++) {
+    ASSERT_EQ(i, LatencyHistogram::BucketIndex(i));
+    ASSERT_EQ(i, LatencyHistogram::BucketUpperBound(static_cast<int>(i)));
+  }
+  for (uint64_t v : {16, 17, 100, 1000, 12345, 999999}) {
+    int index = LatencyHistogram::BucketIndex(v);
+    ASSERT_LE(v, LatencyHistogram::BucketUpperBound(index));
+    ASSERT_GT(v, LatencyHistogram::BucketUpperBound(index - 1));
+    // the relative error should be within 1/kSubBuckets
+    ASSERT_LE(LatencyHistogram::BucketUpperBound(index) - v, v / LatencyHistogram::kSubBuckets);
+  }
+  ASSERT_EQ(LatencyHistogram::kBuckets - 1, LatencyHistogram::BucketIndex(UINT64_MAX));
+}
+
+TEST(LatencyHistogram, Percentile) {
+  LatencyHistogram histogram;
+  ASSERT_EQ(0, histogram.Percentile(50));
+  for (uint64_t i = 1; i <= 1000; i++) histogram.Record(i);
+  ASSERT_NEAR(500, histogram.Percentile(50), 500 / LatencyHistogram::kSubBuckets);
+  ASSERT_NEAR(990, histogram.Percentile(99), 990 / LatencyHistogram::kSubBuckets);
+  ASSERT_NEAR(999, histogram.Percentile(99.9), 999 / LatencyHistogram::kSubBuckets);
+  ASSERT_EQ(1, histogram.Percentile(0));
+
+  LatencyHistogram merged;
+  merged.Merge(histogram);
+  merged.Merge(histogram);
+  ASSERT_EQ(histogram.Percentile(50), merged.Percentile(50));
+}
+
+TEST(Stats, ShardedCommandsStats) {
+  Stats stats;
+  stats.InitCommandsStats(2);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&stats] {
+      for (int j = 0; j < 100; j++) {
+        stats.IncrCalls(1);
+        stats.IncrLatency(10, 1);
+      }
+    });
+  }
+  for (auto &t : threads) t.join();
+
+  command_stat stat;
+  stats.GetCommandStat(1, &stat);
+  ASSERT_EQ(400, stat.calls);
+  ASSERT_EQ(4000, stat.latency);
+  ASSERT_EQ(10, stat.histogram.Percentile(99));
+  ASSERT_EQ(400, stats.GetTotalCalls());
+
+  command_stat empty_stat;
+  stats.GetCommandStat(0, &empty_stat);
+  ASSERT_EQ(0, empty_stat.calls);
+}
+
+TEST(Stats, ShardedSlotStats) {
+  Stats stats;
+  std::vector<SlotStat> slot_stats;
+  stats.GetSlotStats(0, HASH_SLOTS_SIZE - 1, &slot_stats);
+  ASSERT_EQ(HASH_SLOTS_SIZE, slot_stats.size());
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&stats] {
+      for (int j = 0; j < 100; j++) {
+        stats.IncrSlotCall(1, 0);
+        stats.IncrSlotReadBytes(1, 10);
+        stats.IncrSlotCall(HASH_SLOTS_SIZE - 1, 5);
+      }
+    });
+  }
+  for (auto &t : threads) t.join();
+
+  stats.GetSlotStats(0, 1, &slot_stats);
+  ASSERT_EQ(2, slot_stats.size());
+  ASSERT_EQ(0, slot_stats[0].calls);
+  ASSERT_EQ(400, slot_stats[1].calls);
+  ASSERT_EQ(4000, slot_stats[1].read_bytes);
+  ASSERT_EQ(0, slot_stats[1].write_bytes);
+  stats.GetSlotStats(HASH_SLOTS_SIZE - 1, HASH_SLOTS_SIZE - 1, &slot_stats);
+  ASSERT_EQ(1, slot_stats.size());
+  ASSERT_EQ(400, slot_stats[0].calls);
+  ASSERT_EQ(2000, slot_stats[0].write_bytes);
+}
+
+TEST(Stats, PerfSamples) {
+  Stats stats;
+  stats.InitCommandsStats(2);
+  PerfSample sample = {};
+  sample[PERF_BLOCK_CACHE_HITS] = 3;
+  sample[PERF_WRITE_WAL_NANOS] = 1000;
+  stats.RecordPerfSample(1, sample);
+  stats.RecordPerfSample(1, sample);
+
+  PerfSample sums;
+  ASSERT_EQ(2, stats.GetPerfStat(1, &sums));
+  ASSERT_EQ(6, sums[PERF_BLOCK_CACHE_HITS]);
+  ASSERT_EQ(2000, sums[PERF_WRITE_WAL_NANOS]);
+  ASSERT_EQ(0, sums[PERF_SEEKS]);
+  ASSERT_EQ(0, stats.GetPerfStat(0, &sums));
+  ASSERT_EQ(0, sums[PERF_BLOCK_CACHE_HITS]);
+  ASSERT_STREQ("block_cache_hits", PerfCounterName(PERF_BLOCK_CACHE_HITS));
+  ASSERT_STREQ("write_wal_usec", PerfCounterName(PERF_WRITE_WAL_NANOS));
+}
@@ -0,0 +1,55 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include "config/config.h"
+#include "storage/storage.h"
+
+TEST(StorageBlob, ColumnFamilyThresholds) {
+  Config config;
+  config.db_dir = "blobdb";
+  config.backup_dir = "blobdb/backup";
+  config.RocksDB.enable_blob_files = true;
+  config.RocksDB.min_blob_size = 4096;
+  config.RocksDB.metadata_min_blob_size = 1024;
+  config.RocksDB.stream_min_blob_size = 0;
+  config.RocksDB.blob_cache_size = 8;
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  ASSERT_TRUE(storage->Open().IsOK());
+  auto db = storage->GetDB();
+  auto min_blob_size = [&](const std::string &cf_name) {
+    return db->GetOptions(storage->GetCFHandle(cf_name)).min_blob_size;
+  };
+  EXPECT_EQ(1024, min_blob_size(Engine::kMetadataColumnFamilyName));
+  EXPECT_EQ(4096, min_blob_size(Engine::kSubkeyColumnFamilyName));
+  EXPECT_EQ(4096, min_blob_size(Engine::kZSetScoreColumnFamilyName));
+  EXPECT_EQ(0, min_blob_size(Engine::kStreamColumnFamilyName));
+  ASSERT_NE(nullptr, storage->GetBlobCache());
+  EXPECT_EQ(8 * MiB, storage->GetBlobCache()->GetCapacity());
+
+  // Only the named column family is changed
+  ASSERT_TRUE(storage->SetColumnFamilyOption("min_blob_size", "2048", Engine::kMetadataColumnFamilyName).IsOK());
+  EXPECT_EQ(2048, min_blob_size(Engine::kMetadataColumnFamilyName));
+  EXPECT_EQ(4096, min_blob_size(Engine::kSubkeyColumnFamilyName));
+}
@@ -0,0 +1,121 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <rocksdb/env.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "config/config.h"
+#include "storage/storage.h"
+#include "types/redis_hash.h"
+
+TEST(StorageReplica, ApplyWithoutWAL) {
+  Config config;
+  config.db_dir = "replicadb";
+  config.backup_dir = "replicadb/backup";
+  config.replica_disable_wal = true;
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  ASSERT_TRUE(storage->Open().IsOK());
+  auto env = rocksdb::Env::Default();
+  std::string unflushed_path = config.db_dir + "/REPLICA_UNFLUSHED_SEQ";
+
+  // The sequence before the first unflushed batch is recorded until the flush
+  auto seq = storage->LatestSeq();
+  rocksdb::WriteBatch batch;
+  batch.Put(storage->GetCFHandle(Engine::kPropagateColumnFamilyName), "replica_key", "value");
+  ASSERT_TRUE(storage->ReplicaApplyWriteBatch(std::string(batch.Data())).IsOK());
+  std::string recorded_seq;
+  ASSERT_TRUE(rocksdb::ReadFileToString(env, unflushed_path, &recorded_seq).ok());
+  EXPECT_EQ(std::to_string(seq), recorded_seq);
+  ASSERT_TRUE(storage->FlushReplicaWrites().IsOK());
+  EXPECT_TRUE(env->FileExists(unflushed_path).IsNotFound());
+
+  // The unflushed batches are flushed on closing
+  ASSERT_TRUE(storage->ReplicaApplyWriteBatch(std::string(batch.Data())).IsOK());
+  storage->CloseDB();
+  EXPECT_TRUE(env->FileExists(unflushed_path).IsNotFound());
+  ASSERT_TRUE(storage->Open().IsOK());
+  EXPECT_FALSE(storage->ReplicaWritesLost());
+  std::string value;
+  ASSERT_TRUE(storage->GetDB()
+                  ->Get(rocksdb::ReadOptions(), storage->GetCFHandle(Engine::kPropagateColumnFamilyName),
+                        "replica_key", &value)
+                  .ok());
+  EXPECT_EQ("value", value);
+
+  // Nothing after the recorded sequence was persisted by the crash
+  ASSERT_TRUE(rocksdb::WriteStringToFile(env, std::to_string(storage->LatestSeq()), unflushed_path, true).ok());
+  storage->CloseDB();
+  ASSERT_TRUE(storage->Open().IsOK());
+  EXPECT_FALSE(storage->ReplicaWritesLost());
+  EXPECT_TRUE(env->FileExists(unflushed_path).IsNotFound());
+
+  // Something after the recorded sequence was persisted, so the replica can't resume by PSYNC
+  ASSERT_TRUE(rocksdb::WriteStringToFile(env, std::to_string(storage->LatestSeq() - 1), unflushed_path, true).ok());
+  storage->CloseDB();
+  ASSERT_TRUE(storage->Open().IsOK());
+  EXPECT_TRUE(storage->ReplicaWritesLost());
+}
+
+TEST(StorageReplica, ChunkedWritesSurviveCompaction) {
+  Config master_config;
+  master_config.db_dir = "chunkmasterdb";
+  master_config.backup_dir = "chunkmasterdb/backup";
+  master_config.write_batch_chunk_mb = 1;
+  auto master = std::make_unique<Engine::Storage>(&master_config);
+  ASSERT_TRUE(master->Open().IsOK());
+  Config replica_config;
+  replica_config.db_dir = "chunkreplicadb";
+  replica_config.backup_dir = "chunkreplicadb/backup";
+  auto replica = std::make_unique<Engine::Storage>(&replica_config);
+  ASSERT_TRUE(replica->Open().IsOK());
+
+  // The new key is written in chunks ahead of its metadata
+  auto seq = master->LatestSeq();
+  Redis::Hash master_hash(master.get(), "chunk_ns");
+  std::vector<FieldValue> fvs;
+  for (int i = 0; i < 40; i++) fvs.emplace_back(FieldValue{"field-" + std::to_string(i), std::string(64 * 1024, 'v')});
+  int ret = 0;
+  ASSERT_TRUE(master_hash.MSet("chunk_key", fvs, false, &ret).ok());
+  ASSERT_EQ(40, ret);
+  std::unique_ptr<rocksdb::TransactionLogIterator> iter;
+  ASSERT_TRUE(master->GetWALIter(seq + 1, &iter).IsOK());
+  std::vector<std::string> batches;
+  for (; iter->Valid(); iter->Next()) batches.emplace_back(iter->GetBatch().writeBatchPtr->Data());
+  ASSERT_GT(batches.size(), 1U);
+
+  // The chunks applied by the replica are kept by the compaction until the metadata arrives
+  for (size_t i = 0; i + 1 < batches.size(); i++) {
+    ASSERT_TRUE(replica->ReplicaApplyWriteBatch(std::string(batches[i])).IsOK());
+  }
+  ASSERT_TRUE(replica->Compact(nullptr, nullptr).ok());
+  ASSERT_TRUE(replica->ReplicaApplyWriteBatch(std::string(batches.back())).IsOK());
+  ASSERT_TRUE(replica->Compact(nullptr, nullptr).ok());
+  Redis::Hash replica_hash(replica.get(), "chunk_ns");
+  uint32_t size = 0;
+  EXPECT_TRUE(replica_hash.Size("chunk_key", &size).ok());
+  EXPECT_EQ(40U, size);
+  std::vector<FieldValue> values;
+  EXPECT_TRUE(replica_hash.GetAll("chunk_key", &values).ok());
+  EXPECT_EQ(40U, values.size());
+}
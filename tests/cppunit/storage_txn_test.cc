@@ -0,0 +1,312 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "storage/lock_manager.h"
+#include "test_base.h"
+#include "types/redis_hash.h"
+#include "types/redis_list.h"
+#include "types/redis_stream.h"
+#include "types/redis_string.h"
+#include "types/redis_zset.h"
+
+class StorageTxnTest : public TestBase {
+ protected:
+  explicit StorageTxnTest() : TestBase() {
+    string_ = std::make_unique<Redis::String>(storage_, "txn_ns");
+    hash_ = std::make_unique<Redis::Hash>(storage_, "txn_ns");
+  }
+  ~StorageTxnTest() override = default;
+
+  std::unique_ptr<Redis::String> string_;
+  std::unique_ptr<Redis::Hash> hash_;
+};
+
+TEST_F(StorageTxnTest, ReadOwnWrites) {
+  ASSERT_TRUE(storage_->BeginTxn());
+  ASSERT_FALSE(storage_->BeginTxn());
+  ASSERT_TRUE(storage_->InTxn());
+  string_->Set("txn_key", "value");
+  int ret = 0;
+  hash_->Set("txn_hash", "field1", "value1", &ret);
+  hash_->Set("txn_hash", "field2", "value2", &ret);
+  int64_t incr_ret = 0;
+  string_->IncrBy("txn_counter", 3, &incr_ret);
+  string_->IncrBy("txn_counter", 4, &incr_ret);
+  EXPECT_EQ(7, incr_ret);
+
+  std::string value;
+  ASSERT_TRUE(string_->Get("txn_key", &value).ok());
+  EXPECT_EQ("value", value);
+  std::vector<FieldValue> field_values;
+  hash_->GetAll("txn_hash", &field_values);
+  ASSERT_EQ(2, field_values.size());
+  EXPECT_EQ("field1", field_values[0].field);
+  EXPECT_EQ("value2", field_values[1].value);
+
+  // The other threads don't see the writes until the commit
+  std::thread([this] {
+    std::string other_value;
+    EXPECT_FALSE(storage_->InTxn());
+    EXPECT_TRUE(string_->Get("txn_key", &other_value).IsNotFound());
+  }).join();
+
+  ASSERT_TRUE(storage_->CommitTxn().ok());
+  ASSERT_FALSE(storage_->InTxn());
+  std::thread([this] {
+    std::string other_value;
+    EXPECT_TRUE(string_->Get("txn_key", &other_value).ok());
+    EXPECT_EQ("value", other_value);
+    EXPECT_TRUE(string_->Get("txn_counter", &other_value).ok());
+    EXPECT_EQ("7", other_value);
+  }).join();
+
+  string_->Del("txn_key");
+  string_->Del("txn_counter");
+  hash_->Del("txn_hash");
+}
+
+TEST_F(StorageTxnTest, RangeDeletion) {
+  config_->range_delete_min_elements = 3;
+  Redis::ZSet zset(storage_, "txn_ns");
+  std::vector<MemberScore> mscores;
+  for (int i = 0; i < 10; i++) mscores.emplace_back(MemberScore{"member" + std::to_string(i), i});
+  int ret = 0;
+  ASSERT_TRUE(zset.Add("txn_zset", ZAddFlags::Default(), &mscores, &ret).ok());
+
+  // The members and their scores are removed together, and so is the size in the metadata
+  ASSERT_TRUE(storage_->BeginTxn());
+  ZRangeSpec spec;
+  spec.min = 2;
+  spec.max = 7;
+  ASSERT_TRUE(zset.RemoveRangeByScore("txn_zset", spec, &ret).ok());
+  EXPECT_EQ(6, ret);
+  zset.Card("txn_zset", &ret);
+  EXPECT_EQ(4, ret);
+  ASSERT_TRUE(storage_->CommitTxn().ok());
+  zset.Card("txn_zset", &ret);
+  EXPECT_EQ(4, ret);
+  ASSERT_TRUE(zset.RangeByScore("txn_zset", ZRangeSpec(), &mscores, nullptr).ok());
+  ASSERT_EQ(4, mscores.size());
+  EXPECT_EQ("member1", mscores[1].member);
+  EXPECT_EQ("member8", mscores[2].member);
+  double score = 0;
+  EXPECT_TRUE(zset.Score("txn_zset", "member5", &score).IsNotFound());
+
+  // The range deletion in the transaction deletes the keys in the range which it sees
+  auto cf_handle = storage_->GetCFHandle(Engine::kSubkeyColumnFamilyName);
+  rocksdb::WriteBatch batch;
+  for (int i = 0; i < 5; i++) batch.Put(cf_handle, "txn_range" + std::to_string(i), "value");
+  ASSERT_TRUE(storage_->Write(storage_->DefaultWriteOptions(), &batch).ok());
+  ASSERT_TRUE(storage_->BeginTxn());
+  batch.Clear();
+  batch.Put(cf_handle, "txn_range5", "value");
+  batch.DeleteRange(cf_handle, "txn_range2", "txn_range6");
+  ASSERT_TRUE(storage_->Write(storage_->DefaultWriteOptions(), &batch).ok());
+  std::string value;
+  EXPECT_TRUE(storage_->Get(rocksdb::ReadOptions(), cf_handle, "txn_range3", &value).IsNotFound());
+  ASSERT_TRUE(storage_->CommitTxn().ok());
+  for (int i = 0; i < 6; i++) {
+    auto s = storage_->Get(rocksdb::ReadOptions(), cf_handle, "txn_range" + std::to_string(i), &value);
+    EXPECT_EQ(i < 2, s.ok()) << i;
+  }
+  batch.Clear();
+  batch.DeleteRange(cf_handle, "txn_range0", "txn_range6");
+  ASSERT_TRUE(storage_->Write(storage_->DefaultWriteOptions(), &batch).ok());
+  zset.Del("txn_zset");
+  config_->range_delete_min_elements = 1000;
+}
+
+TEST_F(StorageTxnTest, ListRangeDeletion) {
+  config_->range_delete_min_elements = 3;
+  for (bool chunked : {false, true}) {
+    config_->list_chunked_encoding = chunked;
+    Redis::List list(storage_, "txn_ns");
+    std::vector<std::string> model;
+    for (int i = 0; i < 100; i++) model.emplace_back("elem" + std::to_string(i));
+    std::vector<Slice> elems(model.begin(), model.end());
+    int ret = 0;
+    ASSERT_TRUE(list.Push("txn_list", elems, false, &ret).ok());
+
+    ASSERT_TRUE(storage_->BeginTxn());
+    ASSERT_TRUE(list.Trim("txn_list", 10, -11).ok());
+    std::vector<std::string> popped;
+    ASSERT_TRUE(list.PopMulti("txn_list", true, 20, &popped).ok());
+    EXPECT_EQ(std::vector<std::string>(model.begin() + 10, model.begin() + 30), popped);
+    ASSERT_TRUE(list.PopMulti("txn_list", false, 10, &popped).ok());
+    model = std::vector<std::string>(model.begin() + 30, model.end() - 20);
+    std::vector<std::string> actual;
+    ASSERT_TRUE(list.Range("txn_list", 0, -1, &actual).ok());
+    EXPECT_EQ(model, actual);
+    ASSERT_TRUE(storage_->CommitTxn().ok());
+
+    ASSERT_TRUE(list.Range("txn_list", 0, -1, &actual).ok());
+    EXPECT_EQ(model, actual);
+    list.Del("txn_list");
+  }
+  config_->list_chunked_encoding = false;
+  config_->range_delete_min_elements = 1000;
+}
+
+TEST_F(StorageTxnTest, StreamAndRankIndexRangeDeletion) {
+  config_->range_delete_min_elements = 3;
+  Redis::Stream stream(storage_, "txn_ns");
+  Redis::StreamAddOptions add_options;
+  add_options.with_entry_id = true;
+  for (uint64_t i = 1; i <= 10; i++) {
+    add_options.entry_id = Redis::NewStreamEntryID{i, 0};
+    Redis::StreamEntryID id;
+    ASSERT_TRUE(stream.Add("txn_stream", add_options, {"field", "value"}, &id).ok());
+  }
+  ASSERT_TRUE(storage_->BeginTxn());
+  Redis::StreamTrimOptions trim_options;
+  trim_options.strategy = Redis::StreamTrimStrategy::MaxLen;
+  trim_options.max_len = 4;
+  uint64_t trimmed = 0;
+  ASSERT_TRUE(stream.Trim("txn_stream", trim_options, &trimmed).ok());
+  EXPECT_EQ(6, trimmed);
+  ASSERT_TRUE(storage_->CommitTxn().ok());
+  uint64_t length = 0;
+  ASSERT_TRUE(stream.Len("txn_stream", &length).ok());
+  EXPECT_EQ(4, length);
+  Redis::StreamRangeOptions range_options;
+  range_options.start = Redis::StreamEntryID::Minimum();
+  range_options.end = Redis::StreamEntryID::Maximum();
+  std::vector<Redis::StreamEntry> entries;
+  ASSERT_TRUE(stream.Range("txn_stream", range_options, &entries).ok());
+  ASSERT_EQ(4, entries.size());
+  EXPECT_EQ(Redis::StreamEntryID(7, 0).ToString(), entries[0].key);
+  stream.Del("txn_stream");
+
+  // The rank index of the sorted set is dropped with its last member
+  config_->zset_rank_index_min_size = 4;
+  Redis::ZSet zset(storage_, "txn_ns");
+  std::vector<MemberScore> mscores;
+  for (int i = 0; i < 10; i++) mscores.emplace_back(MemberScore{"member" + std::to_string(i), i});
+  int ret = 0;
+  ASSERT_TRUE(zset.Add("txn_zset", ZAddFlags::Default(), &mscores, &ret).ok());
+  auto rank_cf_handle = storage_->GetCFHandle(Engine::kZSetRankColumnFamilyName);
+  auto count_blocks = [&] {
+    std::unique_ptr<rocksdb::Iterator> iter(storage_->NewIterator(rocksdb::ReadOptions(), rank_cf_handle));
+    int blocks = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) blocks++;
+    return blocks;
+  };
+  ASSERT_GT(count_blocks(), 0);
+  ASSERT_TRUE(storage_->BeginTxn());
+  ASSERT_TRUE(zset.RemoveRangeByScore("txn_zset", ZRangeSpec(), &ret).ok());
+  EXPECT_EQ(10, ret);
+  ASSERT_TRUE(storage_->CommitTxn().ok());
+  EXPECT_EQ(0, count_blocks());
+  config_->zset_rank_index_min_size = 0;
+  config_->range_delete_min_elements = 1000;
+}
+
+TEST(ReentrantMultiLockGuard, Nested) {
+  LockManager lock_mgr(4);
+  {
+    ReentrantMultiLockGuard guard(&lock_mgr, {"a", "b"});
+    // The locks held by the guard are skipped on the current thread
+    { LockGuard inner(&lock_mgr, "a"); }
+    { MultiLockGuard inner(&lock_mgr, {"a", "b", "c"}); }
+    { ReentrantMultiLockGuard inner(&lock_mgr, {"b", "c"}); }
+    LockGuard inner(&lock_mgr, "b");
+
+    bool locked = true;
+    std::thread([&] {
+      auto locks = lock_mgr.MultiGet({"a"});
+      locked = locks[0].mu->try_lock();
+      if (locked) locks[0].mu->unlock();
+    }).join();
+    EXPECT_FALSE(locked);
+  }
+  std::thread([&] { LockGuard guard(&lock_mgr, "a"); }).join();
+}
+
+TEST_F(StorageTxnTest, WritingVersions) {
+  uint64_t old_filter = storage_->RegisterCompactionFilter();
+  EXPECT_FALSE(storage_->IsWritingVersion(1, old_filter));
+  rocksdb::WriteBatch batch;
+  storage_->AddWritingVersion(1, &batch);
+  ASSERT_TRUE(storage_->Write(storage_->DefaultWriteOptions(), &batch).ok());
+  EXPECT_TRUE(storage_->IsWritingVersion(1, old_filter));
+  EXPECT_FALSE(storage_->IsWritingVersion(2, old_filter));
+  // The version of the local writer isn't stale
+  EXPECT_TRUE(storage_->PurgeStaleWritingVersions().IsOK());
+  EXPECT_TRUE(storage_->IsWritingVersion(1, old_filter));
+
+  // The finished version is only kept for the filters created before it finished
+  batch.Clear();
+  storage_->RemoveWritingVersion(1, &batch);
+  ASSERT_TRUE(storage_->Write(storage_->DefaultWriteOptions(), &batch).ok());
+  storage_->ReleaseWritingVersion(1, true);
+  uint64_t new_filter = storage_->RegisterCompactionFilter();
+  EXPECT_TRUE(storage_->IsWritingVersion(1, old_filter));
+  EXPECT_FALSE(storage_->IsWritingVersion(1, new_filter));
+  storage_->UnregisterCompactionFilter(old_filter);
+  storage_->UnregisterCompactionFilter(new_filter);
+
+  // The marker of the writer which didn't finish is restored after reopening, until it's purged
+  batch.Clear();
+  storage_->AddWritingVersion(3, &batch);
+  ASSERT_TRUE(storage_->Write(storage_->DefaultWriteOptions(), &batch).ok());
+  storage_->CloseDB();
+  ASSERT_TRUE(storage_->Open().IsOK());
+  uint64_t filter = storage_->RegisterCompactionFilter();
+  EXPECT_TRUE(storage_->IsWritingVersion(3, filter));
+  EXPECT_FALSE(storage_->IsWritingVersion(1, filter));
+  EXPECT_TRUE(storage_->PurgeStaleWritingVersions().IsOK());
+  storage_->UnregisterCompactionFilter(filter);
+  filter = storage_->RegisterCompactionFilter();
+  EXPECT_FALSE(storage_->IsWritingVersion(3, filter));
+  storage_->UnregisterCompactionFilter(filter);
+  storage_->CloseDB();
+  ASSERT_TRUE(storage_->Open().IsOK());
+  filter = storage_->RegisterCompactionFilter();
+  EXPECT_FALSE(storage_->IsWritingVersion(3, filter));
+  storage_->UnregisterCompactionFilter(filter);
+
+  // The huge new key isn't written in chunks in the transaction
+  config_->write_batch_chunk_mb = 1;
+  std::vector<FieldValue> fvs;
+  for (int i = 0; i < 40; i++) fvs.emplace_back(FieldValue{"field-" + std::to_string(i), std::string(64 * 1024, 'v')});
+  ASSERT_TRUE(storage_->BeginTxn());
+  int ret = 0;
+  EXPECT_TRUE(hash_->MSet("txn_chunk_key", fvs, false, &ret).ok());
+  EXPECT_EQ(40, ret);
+  ASSERT_TRUE(storage_->CommitTxn().ok());
+  uint32_t size = 0;
+  EXPECT_TRUE(hash_->Size("txn_chunk_key", &size).ok());
+  EXPECT_EQ(40U, size);
+
+  // The marker of the key written in chunks is deleted by its last batch
+  EXPECT_TRUE(hash_->MSet("chunk_key", fvs, false, &ret).ok());
+  EXPECT_EQ(40, ret);
+  std::unique_ptr<rocksdb::Iterator> iter(
+      storage_->GetDB()->NewIterator(rocksdb::ReadOptions(), storage_->GetCFHandle(Engine::kPropagateColumnFamilyName)));
+  iter->Seek(Engine::kPropagateWritingVersion);
+  EXPECT_FALSE(iter->Valid() && iter->key().starts_with(Engine::kPropagateWritingVersion));
+  config_->write_batch_chunk_mb = 16;
+}
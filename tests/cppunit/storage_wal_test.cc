@@ -0,0 +1,68 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "test_base.h"
+#include "types/redis_string.h"
+
+class StorageWALTest : public TestBase {
+ protected:
+  explicit StorageWALTest() : TestBase() { string_ = std::make_unique<Redis::String>(storage_, "wal_ns"); }
+  ~StorageWALTest() override = default;
+
+  std::unique_ptr<Redis::String> string_;
+};
+
+TEST_F(StorageWALTest, PurgeArchivedWALs) {
+  auto archived_wal_files = [this]() {
+    rocksdb::VectorLogPtr files;
+    EXPECT_TRUE(storage_->GetDB()->GetSortedWalFiles(files).ok());
+    return std::count_if(files.begin(), files.end(),
+                         [](const auto &file) { return file->Type() == rocksdb::kArchivedLogFile; });
+  };
+
+  // The WAL file is archived after all column families are flushed
+  string_->Set("purge_wal_key", "value");
+  ASSERT_TRUE(storage_->GetDB()->Flush(rocksdb::FlushOptions(), *storage_->GetCFHandles()).ok());
+  ASSERT_GT(archived_wal_files(), 0);
+
+  // The archived files are still needed by the sequence before them
+  auto purged = storage_->PurgeArchivedWALs(0, UINT64_MAX);
+  ASSERT_TRUE(purged.IsOK());
+  EXPECT_EQ(0, *purged);
+
+  auto purged_by_seq = storage_->PurgeArchivedWALs(storage_->LatestSeq() + 1, UINT64_MAX);
+  ASSERT_TRUE(purged_by_seq.IsOK());
+  EXPECT_GT(*purged_by_seq, 0);
+  EXPECT_EQ(0, archived_wal_files());
+
+  // The oldest files are purged once they exceed the size limit
+  string_->Set("purge_wal_key", "new_value");
+  ASSERT_TRUE(storage_->GetDB()->Flush(rocksdb::FlushOptions(), *storage_->GetCFHandles()).ok());
+  ASSERT_GT(archived_wal_files(), 0);
+  auto purged_by_size = storage_->PurgeArchivedWALs(0, 0);
+  ASSERT_TRUE(purged_by_size.IsOK());
+  EXPECT_GT(*purged_by_size, 0);
+  EXPECT_EQ(0, archived_wal_files());
+}
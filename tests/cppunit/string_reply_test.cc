@@ -20,6 +20,7 @@
 
 #include <gtest/gtest.h>
 
+#include "event_util.h"
 #include "server/redis_reply.h"
 
 class StringReplyTest : public testing::Test {
@@ -51,3 +52,26 @@ TEST_F(StringReplyTest, BulkString) {
 
   ASSERT_EQ(result.length(), 13 * 10 + 14 * 90 + 15 * 900 + 17 * 9000 + 18 * 90000 + 9);
 }
+
+TEST_F(StringReplyTest, EvbufferMultiBulkString) {
+  UniqueEvbuf output;
+  size_t written = Redis::MultiBulkString(output.get(), values);
+  ASSERT_EQ(written, evbuffer_get_length(output.get()));
+
+  std::string expected = Redis::MultiBulkString(values);
+  ASSERT_EQ(written, expected.size());
+  ASSERT_EQ(expected, std::string(reinterpret_cast<char *>(evbuffer_pullup(output.get(), -1)), written));
+}
+
+TEST_F(StringReplyTest, EvbufferBulkString) {
+  UniqueEvbuf output;
+  size_t written = Redis::MultiLen(output.get(), 3);
+  written += Redis::BulkString(output.get(), "");
+  written += Redis::NilString(output.get());
+  written += Redis::BulkString(output.get(), std::string(1024 * 1024, 'a'));
+
+  std::string expected = Redis::MultiLen(3) + Redis::BulkString("") + Redis::NilString() +
+                         Redis::BulkString(std::string(1024 * 1024, 'a'));
+  ASSERT_EQ(written, expected.size());
+  ASSERT_EQ(expected, std::string(reinterpret_cast<char *>(evbuffer_pullup(output.get(), -1)), written));
+}
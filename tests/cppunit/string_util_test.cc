@@ -22,6 +22,7 @@
 
 #include <gtest/gtest.h>
 
+#include <cstdlib>
 #include <map>
 
 TEST(StringUtil, ToLower) {
@@ -81,3 +82,44 @@ TEST(StringUtil, HasPrefix) {
   ASSERT_TRUE(Util::HasPrefix("has_prefix", "has_prefix"));
   ASSERT_FALSE(Util::HasPrefix("has", "has_prefix"));
 }
+
+TEST(StringUtil, HexToString) {
+  std::string output;
+  ASSERT_TRUE(Util::HexToString(Util::StringToHex(std::string("\x00\x7f\xffkey", 6)), &output));
+  ASSERT_EQ(std::string("\x00\x7f\xffkey", 6), output);
+  ASSERT_TRUE(Util::HexToString("6B6579", &output));
+  ASSERT_EQ("key", output);
+  ASSERT_FALSE(Util::HexToString("6B657", &output));
+  ASSERT_FALSE(Util::HexToString("6G", &output));
+}
+
+TEST(StringUtil, GlobPattern) {
+  Util::GlobPattern prefix_pattern("user:1234:*");
+  ASSERT_EQ(prefix_pattern.LiteralPrefix(), "user:1234:");
+  ASSERT_TRUE(prefix_pattern.MatchesAllWithPrefix());
+  ASSERT_TRUE(prefix_pattern.Match("user:1234:name"));
+  ASSERT_FALSE(prefix_pattern.Match("user:12345"));
+
+  Util::GlobPattern pattern("user:*:[a-c]?e*");
+  ASSERT_EQ(pattern.LiteralPrefix(), "user:");
+  ASSERT_FALSE(pattern.MatchesAllWithPrefix());
+  ASSERT_TRUE(pattern.Match("user:1:age"));
+  ASSERT_TRUE(pattern.Match("user:1:2:cue:x"));
+  ASSERT_FALSE(pattern.Match("user:1:name"));
+
+  ASSERT_TRUE(Util::GlobPattern("a\\*b").Match("a*b"));
+  ASSERT_FALSE(Util::GlobPattern("a\\*b").Match("aab"));
+  ASSERT_TRUE(Util::GlobPattern("[^a]*").Match("bcd"));
+  ASSERT_FALSE(Util::GlobPattern("[^a]*").Match("abc"));
+  ASSERT_TRUE(Util::GlobPattern("HELLO*", true).Match("hello world"));
+  ASSERT_EQ(Util::GlobPattern("HELLO*", true).LiteralPrefix(), "");
+
+  // The same as StringMatch on the random inputs
+  const std::string pattern_chars = "ab*?[]^-\\", string_chars = "ab-]^\\";
+  for (int i = 0; i < 10000; i++) {
+    std::string p, s;
+    for (int j = std::rand() % 8; j > 0; j--) p.push_back(pattern_chars[std::rand() % pattern_chars.size()]);
+    for (int j = 1 + std::rand() % 8; j > 0; j--) s.push_back(string_chars[std::rand() % string_chars.size()]);
+    ASSERT_EQ(Util::GlobPattern(p).Match(s), Util::StringMatch(p, s, 0) == 1) << "pattern: " << p << ", string: " << s;
+  }
+}
@@ -21,6 +21,9 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include "test_base.h"
 #include "types/redis_bitmap.h"
@@ -89,3 +92,285 @@ TEST_F(RedisBitmapTest, BitPosSetBit) {
   }
   bitmap->Del(key_);
 }
+
+TEST_F(RedisBitmapTest, BitCountAndBitPosAcrossBatches) {
+  // The range covers more segments than a batch of MultiGet, and some segments are missing
+  uint32_t offsets[] = {5, 70 * 1024 * 8 + 3, 150 * 1024 * 8 + 1023 * 8 + 7, 200 * 1024 * 8};
+  for (const auto &offset : offsets) {
+    bool bit = false;
+    bitmap->SetBit(key_, offset, true, &bit);
+  }
+  uint32_t cnt = 0;
+  bitmap->BitCount(key_, 0, -1, &cnt);
+  EXPECT_EQ(cnt, 4);
+  bitmap->BitCount(key_, 1, 150 * 1024 + 1022, &cnt);
+  EXPECT_EQ(cnt, 1);
+  bitmap->BitCount(key_, 1, 150 * 1024 + 1023, &cnt);
+  EXPECT_EQ(cnt, 2);
+
+  int64_t pos = 0;
+  bitmap->BitPos(key_, true, 1, -1, false, &pos);
+  EXPECT_EQ(pos, offsets[1]);
+  bitmap->BitPos(key_, true, 70 * 1024 + 1, -1, false, &pos);
+  EXPECT_EQ(pos, offsets[2]);
+  bitmap->BitPos(key_, false, 0, -1, false, &pos);
+  EXPECT_EQ(pos, 0);
+  bitmap->BitPos(key_, false, 1024, -1, false, &pos);
+  EXPECT_EQ(pos, 1024 * 8);
+  bitmap->Del(key_);
+}
+
+TEST_F(RedisBitmapTest, MaintainedBitCount) {
+  // The bit count is only changed by the bits which are flipped
+  bool bit = false;
+  uint32_t offsets[] = {0, 7, 1024 * 8, 2 * 1024 * 8 + 5, 4 * 1024 * 8 - 1};
+  for (const auto &offset : offsets) bitmap->SetBit(key_, offset, true, &bit);
+  bitmap->SetBit(key_, 7, true, &bit);
+  EXPECT_TRUE(bit);
+  bitmap->SetBit(key_, 100, false, &bit);
+  EXPECT_FALSE(bit);
+  bitmap->SetBit(key_, 1024 * 8, false, &bit);
+  EXPECT_TRUE(bit);
+
+  uint32_t cnt = 0;
+  bitmap->BitCount(key_, 0, -1, &cnt);
+  EXPECT_EQ(cnt, 4);
+  // The large ranges are counted by the bytes out of them, and the small ones directly
+  bitmap->BitCount(key_, 1, -1, &cnt);
+  EXPECT_EQ(cnt, 2);
+  bitmap->BitCount(key_, 0, 4 * 1024 - 2, &cnt);
+  EXPECT_EQ(cnt, 3);
+  bitmap->BitCount(key_, 1, 4 * 1024 - 2, &cnt);
+  EXPECT_EQ(cnt, 1);
+  bitmap->BitCount(key_, 2 * 1024, 2 * 1024 + 1, &cnt);
+  EXPECT_EQ(cnt, 1);
+
+  // The bitfield writes adjust the bit count as well
+  Redis::BitfieldOperation op;
+  op.type = Redis::BitfieldOpType::kSet;
+  op.bits = 16;
+  op.offset = 0;
+  op.value = 0xffff;
+  std::vector<std::optional<int64_t>> rets;
+  EXPECT_TRUE(bitmap->Bitfield(key_, {op}, &rets).ok());
+  bitmap->BitCount(key_, 0, -1, &cnt);
+  EXPECT_EQ(cnt, 18);
+  op.value = 0;
+  EXPECT_TRUE(bitmap->Bitfield(key_, {op}, &rets).ok());
+  bitmap->BitCount(key_, 0, -1, &cnt);
+  EXPECT_EQ(cnt, 2);
+  bitmap->Del(key_);
+}
+
+TEST_F(RedisBitmapTest, BitOpOnLargeSparseBitmaps) {
+  // The bitmaps span more segments than one task of BITOP, so the ranges are processed in parallel
+  std::string k1 = "bitop_key1", k2 = "bitop_key2", dst = "bitop_dst";
+  uint32_t k1_offsets[] = {3, 1500 * 1024 * 8 + 1, 3000 * 1024 * 8 + 7};
+  uint32_t k2_offsets[] = {1500 * 1024 * 8 + 1, 1500 * 1024 * 8 + 2, 2048 * 1024 * 8};
+  bool bit = false;
+  for (const auto &offset : k1_offsets) bitmap->SetBit(k1, offset, true, &bit);
+  for (const auto &offset : k2_offsets) bitmap->SetBit(k2, offset, true, &bit);
+
+  int64_t len = 0;
+  uint32_t cnt = 0;
+  auto s = bitmap->BitOp(kBitOpAnd, "and", dst, {k1, k2}, &len);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(len, 3000 * 1024 + 1);
+  bitmap->BitCount(dst, 0, -1, &cnt);
+  EXPECT_EQ(cnt, 1);
+  bitmap->GetBit(dst, k1_offsets[1], &bit);
+  EXPECT_TRUE(bit);
+
+  s = bitmap->BitOp(kBitOpOr, "or", dst, {k1, k2}, &len);
+  EXPECT_TRUE(s.ok());
+  bitmap->BitCount(dst, 0, -1, &cnt);
+  EXPECT_EQ(cnt, 5);
+  for (const auto &offset : k2_offsets) {
+    bitmap->GetBit(dst, offset, &bit);
+    EXPECT_TRUE(bit);
+  }
+
+  s = bitmap->BitOp(kBitOpXor, "xor", dst, {k1, k2}, &len);
+  EXPECT_TRUE(s.ok());
+  bitmap->BitCount(dst, 0, -1, &cnt);
+  EXPECT_EQ(cnt, 4);
+  bitmap->GetBit(dst, k1_offsets[1], &bit);
+  EXPECT_FALSE(bit);
+
+  s = bitmap->BitOp(kBitOpNot, "not", dst, {k2}, &len);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(len, 2048 * 1024 + 1);
+  bitmap->BitCount(dst, 0, -1, &cnt);
+  EXPECT_EQ(cnt, len * 8 - 3);
+  bitmap->GetBit(dst, k2_offsets[0], &bit);
+  EXPECT_FALSE(bit);
+  bitmap->GetBit(dst, 0, &bit);
+  EXPECT_TRUE(bit);
+
+  bitmap->Del(k1);
+  bitmap->Del(k2);
+  bitmap->Del(dst);
+}
+
+TEST_F(RedisBitmapTest, BitOpInTxn) {
+  // The large bitmaps are processed on the calling thread, which sees the buffered writes
+  std::string k1 = "bitop_txn_key1", k2 = "bitop_txn_key2", dst = "bitop_txn_dst";
+  bool bit = false;
+  bitmap->SetBit(k1, 3, true, &bit);
+  ASSERT_TRUE(storage_->BeginTxn());
+  bitmap->SetBit(k1, 3000 * 1024 * 8 + 7, true, &bit);
+  bitmap->SetBit(k2, 1500 * 1024 * 8 + 1, true, &bit);
+  int64_t len = 0;
+  auto s = bitmap->BitOp(kBitOpOr, "or", dst, {k1, k2}, &len);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(len, 3000 * 1024 + 1);
+  ASSERT_TRUE(storage_->CommitTxn().ok());
+  uint32_t cnt = 0;
+  bitmap->BitCount(dst, 0, -1, &cnt);
+  EXPECT_EQ(cnt, 3);
+  bitmap->GetBit(dst, 3000 * 1024 * 8 + 7, &bit);
+  EXPECT_TRUE(bit);
+
+  bitmap->Del(k1);
+  bitmap->Del(k2);
+  bitmap->Del(dst);
+}
+
+TEST_F(RedisBitmapTest, SegmentContainers) {
+  std::string buffer;
+  // The sparse segment is stored as the offsets of the set bits
+  std::string sparse(1024, 0);
+  sparse[0] = 0x01;
+  sparse[500] = static_cast<char>(0x81);
+  std::string value = Redis::Bitmap::EncodeSegment(sparse);
+  EXPECT_EQ(kBitmapContainerArray, static_cast<uint8_t>(value[0]));
+  EXPECT_EQ(7, value.size());
+  EXPECT_EQ(sparse.substr(0, 501), Redis::Bitmap::DecodeSegment(true, value, &buffer).ToString());
+
+  // The clustered segment is stored as the runs of the set bits
+  std::string clustered(1024, 0);
+  for (int i = 100; i < 300; i++) clustered[i] = static_cast<char>(0xff);
+  clustered[300] = 0x07;
+  value = Redis::Bitmap::EncodeSegment(clustered);
+  EXPECT_EQ(kBitmapContainerRun, static_cast<uint8_t>(value[0]));
+  EXPECT_EQ(5, value.size());
+  EXPECT_EQ(clustered.substr(0, 301), Redis::Bitmap::DecodeSegment(true, value, &buffer).ToString());
+
+  // The dense segment is kept as the bitset without the trailing zero bytes
+  std::string dense(1024, 0x55);
+  dense[1023] = 0;
+  value = Redis::Bitmap::EncodeSegment(dense);
+  EXPECT_EQ(kBitmapContainerBitset, static_cast<uint8_t>(value[0]));
+  EXPECT_EQ(1024, value.size());
+  EXPECT_EQ(dense.substr(0, 1023), Redis::Bitmap::DecodeSegment(true, value, &buffer).ToString());
+
+  value = Redis::Bitmap::EncodeSegment(std::string(1024, 0));
+  EXPECT_EQ(1, value.size());
+  EXPECT_FALSE(Redis::Bitmap::IsEmptySegment(value));
+  EXPECT_TRUE(Redis::Bitmap::DecodeSegment(true, value, &buffer).empty());
+  // The raw segment is returned as it is
+  EXPECT_EQ(sparse, Redis::Bitmap::DecodeSegment(false, sparse, &buffer).ToString());
+}
+
+TEST_F(RedisBitmapTest, OperationsWithContainers) {
+  std::string raw_key = "raw_bitmap_key";
+  bool bit = false;
+  uint32_t raw_offsets[] = {5, 1024 * 8 + 3};
+  for (const auto &offset : raw_offsets) bitmap->SetBit(raw_key, offset, true, &bit);
+
+  config_->bitmap_segment_containers = true;
+  uint32_t offsets[] = {0, 123, 1024 * 8, 1024 * 8 + 1, 3 * 1024 * 8, 3 * 1024 * 8 + 1};
+  for (const auto &offset : offsets) {
+    bitmap->GetBit(key_, offset, &bit);
+    EXPECT_FALSE(bit);
+    bitmap->SetBit(key_, offset, true, &bit);
+    EXPECT_FALSE(bit);
+    bitmap->GetBit(key_, offset, &bit);
+    EXPECT_TRUE(bit);
+  }
+  bitmap->SetBit(key_, 123, false, &bit);
+  EXPECT_TRUE(bit);
+  uint32_t cnt = 0;
+  bitmap->BitCount(key_, 0, -1, &cnt);
+  EXPECT_EQ(cnt, 5);
+  int64_t pos = 0;
+  bitmap->BitPos(key_, true, 1, -1, false, &pos);
+  EXPECT_EQ(pos, 1024 * 8);
+  bitmap->BitPos(key_, false, 0, -1, false, &pos);
+  EXPECT_EQ(pos, 1);
+  std::string str;
+  bitmap->GetString(key_, 1024 * 1024, &str);
+  EXPECT_EQ(3 * 1024 + 1, str.size());
+  EXPECT_EQ(static_cast<char>(0x80), str[0]);
+
+  // The existing raw bitmap keeps working, and it's converted by rewriting it with BITOP
+  bitmap->BitCount(raw_key, 0, -1, &cnt);
+  EXPECT_EQ(cnt, 2);
+  int64_t len = 0;
+  auto s = bitmap->BitOp(kBitOpOr, "or", raw_key, {raw_key}, &len);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(len, 1024 + 1);
+  for (const auto &offset : raw_offsets) {
+    bitmap->GetBit(raw_key, offset, &bit);
+    EXPECT_TRUE(bit);
+  }
+
+  s = bitmap->BitOp(kBitOpAnd, "and", "container_dst", {key_, raw_key}, &len);
+  EXPECT_TRUE(s.ok());
+  bitmap->BitCount("container_dst", 0, -1, &cnt);
+  EXPECT_EQ(cnt, 0);
+  s = bitmap->BitOp(kBitOpXor, "xor", "container_dst", {key_, raw_key}, &len);
+  EXPECT_TRUE(s.ok());
+  bitmap->BitCount("container_dst", 0, -1, &cnt);
+  EXPECT_EQ(cnt, 7);
+
+  config_->bitmap_segment_containers = false;
+  bitmap->Del(key_);
+  bitmap->Del(raw_key);
+  bitmap->Del("container_dst");
+}
+
+TEST_F(RedisBitmapTest, Bitfield) {
+  auto make_op = [](Redis::BitfieldOpType type, bool is_signed, uint8_t bits, uint32_t offset, int64_t value,
+                    Redis::BitfieldOverflow overflow = Redis::BitfieldOverflow::kWrap) {
+    Redis::BitfieldOperation op;
+    op.type = type;
+    op.is_signed = is_signed;
+    op.bits = bits;
+    op.offset = offset;
+    op.value = value;
+    op.overflow = overflow;
+    return op;
+  };
+  using Redis::BitfieldOpType;
+  using Redis::BitfieldOverflow;
+
+  // The field across the segments is written in one batch with the other fields
+  std::vector<std::optional<int64_t>> rets;
+  auto s = bitmap->Bitfield(key_,
+                            {make_op(BitfieldOpType::kSet, false, 16, 8190, 0xabcd),
+                             make_op(BitfieldOpType::kIncrBy, true, 8, 0, 127),
+                             make_op(BitfieldOpType::kIncrBy, true, 8, 0, 1),
+                             make_op(BitfieldOpType::kIncrBy, false, 8, 8, 300, BitfieldOverflow::kSat),
+                             make_op(BitfieldOpType::kIncrBy, false, 8, 8, 1, BitfieldOverflow::kFail),
+                             make_op(BitfieldOpType::kGet, false, 16, 8190, 0)},
+                            &rets);
+  EXPECT_TRUE(s.ok());
+  std::vector<std::optional<int64_t>> expected = {0, 127, -128, 255, std::nullopt, 0xabcd};
+  EXPECT_EQ(expected, rets);
+
+  bool bit = false;
+  for (uint32_t i = 0; i < 16; i++) {
+    bitmap->GetBit(key_, 8190 + i, &bit);
+    EXPECT_EQ((0xabcd >> (15 - i)) & 1, bit ? 1 : 0);
+  }
+  uint32_t cnt = 0;
+  bitmap->BitCount(key_, 0, -1, &cnt);
+  EXPECT_EQ(cnt, static_cast<uint32_t>(__builtin_popcount(0xabcd) + 1 + 8));
+
+  // The read-only operations of the missing key return zero
+  s = bitmap->Bitfield("missing_key", {make_op(BitfieldOpType::kGet, true, 64, 100, 0)}, &rets);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(std::vector<std::optional<int64_t>>({0}), rets);
+  bitmap->Del(key_);
+}
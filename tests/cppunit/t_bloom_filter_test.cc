@@ -0,0 +1,118 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "test_base.h"
+#include "types/redis_bloom_filter.h"
+
+class RedisBloomFilterTest : public TestBase {
+ protected:
+  explicit RedisBloomFilterTest() : TestBase() {
+    bloom = std::make_unique<Redis::BloomFilter>(storage_, "bloom_ns");
+  }
+  ~RedisBloomFilterTest() = default;
+  void SetUp() override { key_ = "test-bloom-key"; }
+
+ protected:
+  std::unique_ptr<Redis::BloomFilter> bloom;
+};
+
+TEST_F(RedisBloomFilterTest, Reserve) {
+  BloomFilterMetadata metadata(false);
+  metadata.Reserve(1000, 0.01);
+  EXPECT_EQ(metadata.bits % (kBloomFilterSegmentBytes * 8), 0U);
+  EXPECT_GE(metadata.bits, 9586U);
+  EXPECT_EQ(metadata.hashes, 7U);
+
+  auto s = bloom->Reserve(key_, 0.001, 1000);
+  EXPECT_TRUE(s.ok());
+  s = bloom->Reserve(key_, 0.001, 1000);
+  EXPECT_TRUE(s.IsInvalidArgument());
+  s = bloom->Info(key_, &metadata);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(metadata.capacity, 1000U);
+  EXPECT_EQ(metadata.size, 0U);
+  EXPECT_EQ(metadata.hashes, 10U);
+  bloom->Del(key_);
+}
+
+TEST_F(RedisBloomFilterTest, AddAndExists) {
+  std::vector<int> rets;
+  auto s = bloom->MExists(key_, {"a"}, &rets);
+  EXPECT_TRUE(s.ok() && rets == std::vector<int>{0});
+
+  s = bloom->Reserve(key_, 0.001, 10000);
+  EXPECT_TRUE(s.ok());
+  std::vector<std::string> items;
+  for (int i = 0; i < 10000; i++) items.emplace_back("item-" + std::to_string(i));
+  std::vector<Slice> slices(items.begin(), items.end());
+  s = bloom->MAdd(key_, slices, &rets);
+  EXPECT_TRUE(s.ok());
+  int added = 0;
+  for (const auto ret : rets) added += ret;
+  EXPECT_GE(added, 9990);
+
+  s = bloom->MExists(key_, slices, &rets);
+  EXPECT_TRUE(s.ok());
+  for (const auto ret : rets) EXPECT_EQ(ret, 1);
+
+  std::vector<std::string> others;
+  for (int i = 0; i < 10000; i++) others.emplace_back("other-" + std::to_string(i));
+  std::vector<Slice> other_slices(others.begin(), others.end());
+  s = bloom->MExists(key_, other_slices, &rets);
+  EXPECT_TRUE(s.ok());
+  int false_positives = 0;
+  for (const auto ret : rets) false_positives += ret;
+  EXPECT_LE(false_positives, 30);
+
+  // The items which might exist are not added again
+  s = bloom->MAdd(key_, {"item-0", "item-1"}, &rets);
+  EXPECT_TRUE(s.ok() && rets == std::vector<int>({0, 0}));
+  bloom->Del(key_);
+}
+
+TEST_F(RedisBloomFilterTest, Full) {
+  std::vector<int> rets;
+  auto s = bloom->Reserve(key_, 0.01, 2);
+  EXPECT_TRUE(s.ok());
+  s = bloom->MAdd(key_, {"a", "b", "c", "a"}, &rets);
+  EXPECT_TRUE(s.ok() && rets == std::vector<int>({1, 1, -1, 0}));
+  BloomFilterMetadata metadata(false);
+  s = bloom->Info(key_, &metadata);
+  EXPECT_TRUE(s.ok() && metadata.size == 2);
+  bloom->Del(key_);
+}
+
+TEST_F(RedisBloomFilterTest, DefaultFilter) {
+  std::vector<int> rets;
+  auto s = bloom->MAdd(key_, {"a"}, &rets);
+  EXPECT_TRUE(s.ok() && rets == std::vector<int>{1});
+  BloomFilterMetadata metadata(false);
+  s = bloom->Info(key_, &metadata);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(metadata.capacity, kBloomFilterDefaultCapacity);
+  EXPECT_EQ(metadata.error_rate, kBloomFilterDefaultErrorRate);
+  bloom->Del(key_);
+}
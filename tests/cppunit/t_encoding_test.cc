@@ -21,7 +21,9 @@
 #include <gtest/gtest.h>
 #include <rocksdb/slice.h>
 
+#include <chrono>
 #include <cstdint>
+#include <iostream>
 #include <limits>
 #include <string>
 #include <vector>
@@ -56,3 +58,77 @@ TEST(Util, EncodeAndDecodeInt32AsVarint32) {
     ASSERT_EQ(result, values[i]);
   }
 }
+
+TEST(Util, EncodeAndDecodeFixed) {
+  std::string bytes;
+  PutFixed16(&bytes, 0x0102);
+  PutFixed32(&bytes, 0x03040506);
+  PutFixed64(&bytes, 0x0708090a0b0c0d0e);
+  // The fixed-width integers are in big endian
+  ASSERT_EQ(bytes, std::string("\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e"));
+  ASSERT_EQ(DecodeFixed16(bytes.data()), 0x0102);
+  ASSERT_EQ(DecodeFixed32(bytes.data() + 2), 0x03040506U);
+  ASSERT_EQ(DecodeFixed64(bytes.data() + 6), 0x0708090a0b0c0d0eU);
+
+  rocksdb::Slice input(bytes);
+  uint16_t v16 = 0;
+  uint32_t v32 = 0;
+  uint64_t v64 = 0;
+  ASSERT_TRUE(GetFixed16(&input, &v16) && GetFixed32(&input, &v32) && GetFixed64(&input, &v64));
+  ASSERT_EQ(v16, 0x0102);
+  ASSERT_EQ(v32, 0x03040506U);
+  ASSERT_EQ(v64, 0x0708090a0b0c0d0eU);
+  ASSERT_FALSE(GetFixed8(&input, nullptr));
+}
+
+TEST(Util, EncodeAndDecodeArray) {
+  std::vector<uint64_t> ids = {0, 1, 255, 256, 0x0102030405060708, std::numeric_limits<uint64_t>::max()};
+  std::string bytes(ids.size() * sizeof(uint64_t), '\0');
+  EncodeFixed64Array(bytes.data(), ids.data(), ids.size());
+  std::string expected;
+  for (auto id : ids) PutFixed64(&expected, id);
+  ASSERT_EQ(bytes, expected);
+  std::vector<uint64_t> decoded_ids(ids.size());
+  DecodeFixed64Array(bytes.data(), ids.size(), decoded_ids.data());
+  ASSERT_EQ(decoded_ids, ids);
+
+  std::vector<double> scores = {-std::numeric_limits<double>::infinity(), -1234.5, -0.5, 0, 0.5, 1234.5,
+                                std::numeric_limits<double>::infinity()};
+  bytes.clear();
+  for (auto score : scores) PutDouble(&bytes, score);
+  std::vector<double> decoded_scores(scores.size());
+  DecodeDoubleArray(bytes.data(), scores.size(), decoded_scores.data());
+  ASSERT_EQ(decoded_scores, scores);
+}
+
+// Run with --gtest_also_run_disabled_tests --gtest_filter=*Benchmark* to measure the codecs
+TEST(Util, DISABLED_BenchmarkFixedCodecs) {
+  constexpr size_t n = 1 << 20;
+  constexpr int rounds = 100;
+  std::vector<uint64_t> values(n);
+  for (size_t i = 0; i < n; i++) values[i] = i * 0x9e3779b97f4a7c15;
+  std::string bytes(n * sizeof(uint64_t), '\0');
+  std::vector<uint64_t> decoded(n);
+  std::vector<double> scores(n);
+
+  auto measure = [](const char *name, const auto &fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) fn();
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << name << ": " << static_cast<double>(elapsed.count()) / (n * rounds) << " ns/value" << std::endl;
+  };
+  measure("EncodeFixed64", [&]() {
+    for (size_t i = 0; i < n; i++) EncodeFixed64(&bytes[i * sizeof(uint64_t)], values[i]);
+  });
+  measure("EncodeFixed64Array", [&]() { EncodeFixed64Array(bytes.data(), values.data(), n); });
+  measure("DecodeFixed64", [&]() {
+    for (size_t i = 0; i < n; i++) decoded[i] = DecodeFixed64(&bytes[i * sizeof(uint64_t)]);
+  });
+  measure("DecodeFixed64Array", [&]() { DecodeFixed64Array(bytes.data(), n, decoded.data()); });
+  measure("GetFixed64", [&]() {
+    rocksdb::Slice input(bytes);
+    for (size_t i = 0; i < n; i++) GetFixed64(&input, &decoded[i]);
+  });
+  measure("DecodeDoubleArray", [&]() { DecodeDoubleArray(bytes.data(), n, scores.data()); });
+  ASSERT_EQ(decoded, values);
+}
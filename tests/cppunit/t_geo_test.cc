@@ -147,4 +147,117 @@ TEST_F(RedisGeoTest, RadiusByMember) {
     EXPECT_EQ(geo->EncodeGeoHash(gps[i].longitude, gps[i].latitude), geoHashes_[i]);
   }
   geo->Del(key_);
-}
\ No newline at end of file
+}
+TEST_F(RedisGeoTest, Search) {
+  int ret;
+  std::vector<GeoPoint> geo_points;
+  for (size_t i = 0; i < fields_.size(); i++) {
+    geo_points.emplace_back(GeoPoint{longitudes_[i], latitudes_[i], fields_[i].ToString()});
+  }
+  geo->Add(key_, &geo_points, &ret);
+  EXPECT_EQ(static_cast<int>(fields_.size()), ret);
+
+  GeoShape circle;
+  circle.type = kGeoShapeCircle;
+  circle.xy[0] = 0;
+  circle.xy[1] = 0;
+  circle.radius = 200000;
+  std::vector<GeoPoint> gps;
+  geo->Search(key_, circle, kSortASC, 0, false, &gps);
+  EXPECT_EQ(gps.size(), 5U);
+  EXPECT_EQ(gps[0].member, fields_[3].ToString());
+  gps.clear();
+  geo->Search(key_, circle, kSortASC, 1, false, &gps);
+  EXPECT_EQ(gps.size(), 1U);
+  EXPECT_EQ(gps[0].member, fields_[3].ToString());
+  gps.clear();
+  geo->Search(key_, circle, kSortDESC, 2, false, &gps);
+  EXPECT_EQ(gps.size(), 2U);
+  EXPECT_NE(gps[0].member, fields_[3].ToString());
+  EXPECT_GE(gps[0].dist, gps[1].dist);
+  gps.clear();
+  geo->Search(key_, circle, kSortNone, 2, true, &gps);
+  EXPECT_EQ(gps.size(), 2U);
+
+  GeoShape box;
+  box.type = kGeoShapeRectangle;
+  box.xy[0] = 0;
+  box.xy[1] = 0;
+  box.width = 300000;
+  box.height = 300000;
+  gps.clear();
+  geo->Search(key_, box, kSortASC, 0, false, &gps);
+  EXPECT_EQ(gps.size(), 5U);
+  box.width = 100000;
+  gps.clear();
+  geo->Search(key_, box, kSortASC, 0, false, &gps);
+  EXPECT_EQ(gps.size(), 1U);
+  EXPECT_EQ(gps[0].member, fields_[3].ToString());
+
+  circle.radius = 1;
+  gps.clear();
+  geo->SearchByMember(key_, fields_[3], circle, kSortASC, 0, false, &gps);
+  EXPECT_EQ(gps.size(), 1U);
+  EXPECT_EQ(gps[0].member, fields_[3].ToString());
+  gps.clear();
+  auto s = geo->SearchByMember(key_, "no-such-member", circle, kSortASC, 0, false, &gps);
+  EXPECT_TRUE(s.IsInvalidArgument());
+  geo->Del(key_);
+}
+
+TEST(GeoHashHelper, BatchKernels) {
+  std::vector<double> longitudes, latitudes;
+  for (int i = 0; i < 2000; i++) {
+    longitudes.emplace_back(-180 + fmod(i * 37.123456789, 360));
+    latitudes.emplace_back(GEO_LAT_MIN + fmod(i * 11.987654321, GEO_LAT_MAX - GEO_LAT_MIN));
+  }
+  longitudes.emplace_back(181);
+  latitudes.emplace_back(0);
+  size_t n = longitudes.size();
+
+  // The batch results are the same as the ones of the points
+  std::vector<GeoHashFix52Bits> bits(n);
+  GeoHashHelper::EncodeScoresWGS84(longitudes.data(), latitudes.data(), n, bits.data());
+  std::vector<double> scores(n);
+  for (size_t i = 0; i < n; i++) {
+    GeoHashBits hash;
+    geohashEncodeWGS84(longitudes[i], latitudes[i], GEO_STEP_MAX, &hash);
+    EXPECT_EQ(GeoHashHelper::Align52Bits(hash), bits[i]);
+    scores[i] = static_cast<double>(bits[i]);
+  }
+  std::vector<double> decoded_longitudes(n), decoded_latitudes(n);
+  GeoHashHelper::DecodeScoresWGS84(scores.data(), n, decoded_longitudes.data(), decoded_latitudes.data());
+  for (size_t i = 0; i < n; i++) {
+    double xy[2];
+    ASSERT_TRUE(geohashDecodeToLongLatWGS84(GeoHashBits{static_cast<uint64_t>(scores[i]), GEO_STEP_MAX}, xy));
+    EXPECT_EQ(xy[0], decoded_longitudes[i]);
+    EXPECT_EQ(xy[1], decoded_latitudes[i]);
+  }
+
+  GeoShape circle;
+  circle.xy[0] = 12.34;
+  circle.xy[1] = 56.78;
+  circle.radius = 3000000;
+  GeoShape box = circle;
+  box.type = kGeoShapeRectangle;
+  box.width = 4000000;
+  box.height = 2000000;
+  for (const auto &shape : {circle, box}) {
+    std::vector<double> distances(n);
+    std::vector<uint8_t> within(n);
+    size_t count = GeoHashHelper::GetDistancesIfInShape(shape, decoded_longitudes.data(), decoded_latitudes.data(), n,
+                                                        distances.data(), within.data());
+    size_t expected_count = 0;
+    for (size_t i = 0; i < n; i++) {
+      double distance = 0;
+      int in_shape = GeoHashHelper::GetDistanceIfInShape(shape, decoded_longitudes[i], decoded_latitudes[i], &distance);
+      EXPECT_EQ(in_shape, within[i]);
+      if (in_shape) {
+        EXPECT_EQ(distance, distances[i]);
+        expected_count++;
+      }
+    }
+    EXPECT_GT(expected_count, 0U);
+    EXPECT_EQ(expected_count, count);
+  }
+}
@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <memory>
 #include <random>
+#include <set>
 #include <string>
 
 #include "parse_util.h"
@@ -59,6 +60,26 @@ TEST_F(RedisHashTest, GetAndSet) {
   hash->Del(key_);
 }
 
+TEST_F(RedisHashTest, GetPinned) {
+  int ret = 0;
+  for (int inline_max_entries : {0, 16}) {
+    config_->hash_inline_max_entries = inline_max_entries;
+    for (size_t i = 0; i < fields_.size(); i++) {
+      hash->Set(key_, fields_[i], values_[i], &ret);
+    }
+    for (size_t i = 0; i < fields_.size(); i++) {
+      rocksdb::PinnableSlice got;
+      rocksdb::Status s = hash->Get(key_, fields_[i], &got);
+      EXPECT_TRUE(s.ok());
+      EXPECT_EQ(values_[i], got.ToString());
+    }
+    rocksdb::PinnableSlice got;
+    EXPECT_TRUE(hash->Get(key_, "no_such_field", &got).IsNotFound());
+    hash->Del(key_);
+  }
+  config_->hash_inline_max_entries = 0;
+}
+
 TEST_F(RedisHashTest, MGetAndMSet) {
   int ret;
   std::vector<FieldValue> fvs;
@@ -196,3 +217,195 @@ TEST_F(RedisHashTest, HRangeNonExistingKey) {
   EXPECT_TRUE(s.ok());
   EXPECT_EQ(result.size(), 0);
 }
+
+TEST_F(RedisHashTest, InlineEncoding) {
+  config_->hash_inline_max_entries = 4;
+  hash->Del(key_);
+
+  int ret = 0;
+  std::vector<FieldValue> fvs = {{"f1", "v1"}, {"f2", "v2"}, {"f3", "3"}};
+  auto s = hash->MSet(key_, fvs, false, &ret);
+  EXPECT_TRUE(s.ok() && ret == 3);
+  std::string ns_key, bytes;
+  hash->AppendNamespacePrefix(key_, &ns_key);
+  s = hash->GetRawMetadata(ns_key, &bytes);
+  EXPECT_TRUE(s.ok());
+  HashMetadata metadata(false);
+  metadata.Decode(bytes);
+  EXPECT_TRUE(metadata.inlined);
+  EXPECT_EQ(3, metadata.fields.size());
+
+  std::string value;
+  s = hash->Get(key_, "f2", &value);
+  EXPECT_TRUE(s.ok() && value == "v2");
+  s = hash->Get(key_, "f4", &value);
+  EXPECT_TRUE(s.IsNotFound());
+  int64_t incr_ret = 0;
+  s = hash->IncrBy(key_, "f3", 2, &incr_ret);
+  EXPECT_TRUE(s.ok() && incr_ret == 5);
+
+  std::vector<std::string> values;
+  std::vector<rocksdb::Status> statuses;
+  s = hash->MGet(key_, {"f1", "f4", "f3"}, &values, &statuses);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(std::vector<std::string>({"v1", "", "5"}), values);
+  EXPECT_TRUE(statuses[1].IsNotFound());
+
+  std::vector<FieldValue> result;
+  s = hash->Range(key_, "f2", "f9", 10, &result);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(2, result.size());
+  EXPECT_EQ("f2", result[0].field);
+  std::vector<std::string> fields;
+  s = hash->Scan(key_, "f1", 10, "f", &fields);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(std::vector<std::string>({"f2", "f3"}), fields);
+
+  s = hash->Delete(key_, {"f1", "f1", "f9"}, &ret);
+  EXPECT_TRUE(s.ok() && ret == 1);
+
+  // Growing beyond the limit converts the hash to the subkeys
+  fvs = {{"f4", "v4"}, {"f5", "v5"}, {"f6", "v6"}};
+  s = hash->MSet(key_, fvs, false, &ret);
+  EXPECT_TRUE(s.ok() && ret == 3);
+  bytes.clear();
+  s = hash->GetRawMetadata(ns_key, &bytes);
+  EXPECT_TRUE(s.ok());
+  metadata.Decode(bytes);
+  EXPECT_FALSE(metadata.inlined);
+  EXPECT_EQ(5, metadata.size);
+  s = hash->GetAll(key_, &result);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(5, result.size());
+  EXPECT_EQ("f2", result[0].field);
+  EXPECT_EQ("5", result[1].value);
+  EXPECT_EQ("f6", result[4].field);
+
+  hash->Del(key_);
+  config_->hash_inline_max_entries = 0;
+}
+
+TEST_F(RedisHashTest, ScanWithCachedIterators) {
+  config_->scan_iterator_cache_size = 16;
+  auto cache = storage_->GetScanIteratorCache();
+  cache->Clear();
+  int ret = 0;
+  std::vector<std::string> expected;
+  for (int i = 0; i < 10; i++) {
+    expected.emplace_back("f" + std::to_string(i));
+    hash->Set(key_, expected.back(), "v", &ret);
+  }
+
+  uint64_t hits = cache->GetHits();
+  std::vector<std::string> scanned;
+  std::string cursor;
+  while (true) {
+    std::vector<std::string> fields, values;
+    auto s = hash->Scan(key_, cursor, 3, "", &fields, &values);
+    EXPECT_TRUE(s.ok());
+    scanned.insert(scanned.end(), fields.begin(), fields.end());
+    if (fields.size() < 3) break;
+    cursor = fields.back();
+  }
+  EXPECT_EQ(expected, scanned);
+  // The pages after the first one are resumed from the iterators, and the finished scan isn't cached
+  EXPECT_EQ(3, cache->GetHits() - hits);
+  EXPECT_EQ(0, cache->Size());
+
+  // The scan from a cursor without the cached iterator seeks as before
+  std::vector<std::string> fields;
+  auto s = hash->Scan(key_, "f7", 10, "", &fields);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(std::vector<std::string>({"f8", "f9"}), fields);
+
+  hash->Del(key_);
+  config_->scan_iterator_cache_size = 0;
+}
+
+TEST_F(RedisHashTest, MSetDuplicatedFields) {
+  int ret = 0;
+  auto s = hash->MSet(key_, {{"f1", "v1"}, {"f2", "v2"}}, false, &ret);
+  EXPECT_TRUE(s.ok() && ret == 2);
+  // The old values of the fields in the subkeys are read in one batch, and the last value wins
+  s = hash->MSet(key_, {{"f2", "v2"}, {"f3", "v3"}, {"f3", "v4"}, {"f1", "v5"}}, false, &ret);
+  EXPECT_TRUE(s.ok() && ret == 1);
+  uint32_t size = 0;
+  hash->Size(key_, &size);
+  EXPECT_EQ(3U, size);
+  std::string value;
+  hash->Get(key_, "f3", &value);
+  EXPECT_EQ("v4", value);
+  hash->Get(key_, "f1", &value);
+  EXPECT_EQ("v5", value);
+  hash->Del(key_);
+}
+
+TEST_F(RedisHashTest, MSetInChunks) {
+  config_->write_batch_chunk_mb = 1;
+  config_->hash_inline_max_entries = 4;
+  std::vector<FieldValue> fvs;
+  for (int i = 0; i < 40; i++) {
+    fvs.emplace_back(FieldValue{"field-" + std::to_string(i), std::string(64 * 1024, static_cast<char>('a' + i % 26))});
+  }
+  // The fields of the new key are written in chunks, then the metadata in the last batch
+  int ret = 0;
+  auto s = hash->MSet(key_, fvs, false, &ret);
+  EXPECT_TRUE(s.ok() && ret == 40);
+  uint32_t size = 0;
+  hash->Size(key_, &size);
+  EXPECT_EQ(40U, size);
+  std::vector<FieldValue> result;
+  hash->GetAll(key_, &result);
+  EXPECT_EQ(40U, result.size());
+  for (const auto &fv : fvs) {
+    std::string value;
+    s = hash->Get(key_, fv.field, &value);
+    EXPECT_TRUE(s.ok());
+    EXPECT_EQ(fv.value, value);
+  }
+  // The fields of the existing key are written in one batch
+  fvs.resize(20);
+  for (auto &fv : fvs) fv.value = "new";
+  s = hash->MSet(key_, fvs, false, &ret);
+  EXPECT_TRUE(s.ok() && ret == 0);
+  std::string value;
+  hash->Get(key_, "field-19", &value);
+  EXPECT_EQ("new", value);
+  hash->Get(key_, "field-20", &value);
+  EXPECT_EQ(64 * 1024, value.size());
+  hash->Del(key_);
+  config_->write_batch_chunk_mb = 16;
+  config_->hash_inline_max_entries = 0;
+}
+
+TEST_F(RedisHashTest, RandField) {
+  std::vector<FieldValue> fvs;
+  for (int i = 0; i < 500; i++) {
+    fvs.emplace_back(FieldValue{"field-" + std::to_string(i), "value-" + std::to_string(i)});
+  }
+  int ret = 0;
+  hash->MSet(key_, fvs, false, &ret);
+  EXPECT_EQ(500, ret);
+
+  std::vector<FieldValue> field_values;
+  auto s = hash->RandField(key_, 20, &field_values);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(20, field_values.size());
+  std::set<std::string> fields;
+  for (const auto &fv : field_values) {
+    fields.emplace(fv.field);
+    EXPECT_EQ("value-" + fv.field.substr(6), fv.value);
+  }
+  EXPECT_EQ(20, fields.size());
+
+  s = hash->RandField(key_, -1000, &field_values);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(1000, field_values.size());
+  s = hash->RandField(key_, 1000, &field_values);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(500, field_values.size());
+  s = hash->RandField("missing-hash-key", 10, &field_values);
+  EXPECT_TRUE(s.ok());
+  EXPECT_TRUE(field_values.empty());
+  hash->Del(key_);
+}
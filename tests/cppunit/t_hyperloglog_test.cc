@@ -0,0 +1,133 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "test_base.h"
+#include "types/redis_hyperloglog.h"
+
+class RedisHyperLogLogTest : public TestBase {
+ protected:
+  explicit RedisHyperLogLogTest() : TestBase() { hll = std::make_unique<Redis::HyperLogLog>(storage_, "hll_ns"); }
+  ~RedisHyperLogLogTest() = default;
+  void SetUp() override { key_ = "test-hll-key"; }
+
+  static std::vector<std::string> makeElements(const std::string &prefix, int n) {
+    std::vector<std::string> elements;
+    for (int i = 0; i < n; i++) elements.emplace_back(prefix + std::to_string(i));
+    return elements;
+  }
+
+ protected:
+  std::unique_ptr<Redis::HyperLogLog> hll;
+};
+
+TEST_F(RedisHyperLogLogTest, Segment) {
+  std::vector<uint8_t> registers(kHyperLogLogSegmentRegisters, 0);
+  EXPECT_TRUE(Redis::HyperLogLog::EncodeSegment(registers.data()).empty());
+
+  registers[0] = 1;
+  registers[1023] = 51;
+  auto value = Redis::HyperLogLog::EncodeSegment(registers.data());
+  EXPECT_EQ(value.size(), 7U);
+  std::vector<uint8_t> decoded(kHyperLogLogSegmentRegisters, 0);
+  EXPECT_TRUE(Redis::HyperLogLog::DecodeSegment(value, decoded.data()));
+  EXPECT_EQ(decoded, registers);
+
+  for (uint32_t i = 0; i < kHyperLogLogSegmentRegisters; i += 2) registers[i] = static_cast<uint8_t>(i % 7 + 1);
+  value = Redis::HyperLogLog::EncodeSegment(registers.data());
+  EXPECT_EQ(value.size(), kHyperLogLogSegmentRegisters + 1);
+  EXPECT_TRUE(Redis::HyperLogLog::DecodeSegment(value, decoded.data()));
+  EXPECT_EQ(decoded, registers);
+
+  EXPECT_FALSE(Redis::HyperLogLog::DecodeSegment(value.substr(0, 100), decoded.data()));
+}
+
+TEST_F(RedisHyperLogLogTest, AddAndCount) {
+  int ret = 0;
+  uint64_t card = 0;
+  auto s = hll->Add(key_, {}, &ret);
+  EXPECT_TRUE(s.ok() && ret == 1);
+  s = hll->Count({key_}, true, &card);
+  EXPECT_TRUE(s.ok() && card == 0);
+
+  auto elements = makeElements("a", 10000);
+  std::vector<Slice> slices(elements.begin(), elements.end());
+  s = hll->Add(key_, slices, &ret);
+  EXPECT_TRUE(s.ok() && ret == 1);
+  s = hll->Add(key_, slices, &ret);
+  EXPECT_TRUE(s.ok() && ret == 0);
+
+  s = hll->Count({key_}, true, &card);
+  EXPECT_TRUE(s.ok());
+  EXPECT_NEAR(static_cast<double>(card), 10000, 10000 * 0.05);
+  // The cached cardinality is the same, and cleared by the next write
+  uint64_t cached_card = 0;
+  s = hll->Count({key_}, true, &cached_card);
+  EXPECT_TRUE(s.ok() && cached_card == card);
+  s = hll->Add(key_, {"new-element-0", "new-element-1", "new-element-2"}, &ret);
+  EXPECT_TRUE(s.ok());
+  s = hll->Count({key_}, true, &cached_card);
+  EXPECT_TRUE(s.ok() && cached_card >= card);
+  hll->Del(key_);
+}
+
+TEST_F(RedisHyperLogLogTest, CountUnionAndMerge) {
+  int ret = 0;
+  std::string other_key = "test-hll-other-key", dest_key = "test-hll-dest-key";
+  auto elements = makeElements("a", 5000);
+  std::vector<Slice> slices(elements.begin(), elements.end());
+  hll->Add(key_, slices, &ret);
+  auto other_elements = makeElements("b", 5000);
+  std::vector<Slice> other_slices(other_elements.begin(), other_elements.end());
+  hll->Add(other_key, other_slices, &ret);
+
+  uint64_t card = 0, cached_card = 0;
+  auto s = hll->Count({key_, other_key, "no-such-key"}, true, &card);
+  EXPECT_TRUE(s.ok());
+  EXPECT_NEAR(static_cast<double>(card), 10000, 10000 * 0.05);
+  s = hll->Count({key_, other_key, "no-such-key"}, true, &cached_card);
+  EXPECT_TRUE(s.ok() && cached_card == card);
+
+  // The write of the other key invalidates the cached union
+  auto more_elements = makeElements("c", 5000);
+  std::vector<Slice> more_slices(more_elements.begin(), more_elements.end());
+  hll->Add(other_key, more_slices, &ret);
+  s = hll->Count({key_, other_key, "no-such-key"}, true, &card);
+  EXPECT_TRUE(s.ok());
+  EXPECT_NEAR(static_cast<double>(card), 15000, 15000 * 0.05);
+
+  s = hll->Merge(dest_key, {key_, other_key});
+  EXPECT_TRUE(s.ok());
+  s = hll->Count({dest_key}, false, &cached_card);
+  EXPECT_TRUE(s.ok() && cached_card == card);
+  s = hll->Merge(dest_key, {"no-such-key"});
+  EXPECT_TRUE(s.ok());
+  s = hll->Count({dest_key}, false, &cached_card);
+  EXPECT_TRUE(s.ok() && cached_card == card);
+
+  hll->Del(key_);
+  hll->Del(other_key);
+  hll->Del(dest_key);
+}
@@ -20,7 +20,10 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "test_base.h"
 #include "types/redis_list.h"
@@ -555,3 +558,122 @@ TEST_F(RedisListTest, RPopMultiCountGreaterThanListSize) {
   }
   list->Del(key_);
 }
+
+TEST_F(RedisListTest, ChunkedEncoding) {
+  config_->list_chunked_encoding = true;
+  list->Del(key_);
+
+  std::vector<std::string> model;
+  std::vector<std::string> values;
+  for (int i = 0; i < 3000; i++) values.emplace_back("elem-" + std::to_string(i));
+  std::vector<Slice> elems(values.begin(), values.end());
+  int ret = 0;
+  auto s = list->Push(key_, elems, false, &ret);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(3000, ret);
+  model = values;
+
+  // hammer one spot so the chunk around it splits repeatedly
+  for (int i = 0; i < 2500; i++) {
+    std::string elem = "ins-" + std::to_string(i);
+    const std::string &pivot = model[1500 + (i % 7)];
+    s = list->Insert(key_, pivot, elem, i % 2 == 0, &ret);
+    EXPECT_TRUE(s.ok());
+    auto it = std::find(model.begin(), model.end(), pivot);
+    model.insert(i % 2 == 0 ? it : it + 1, elem);
+    EXPECT_EQ(static_cast<int>(model.size()), ret);
+  }
+
+  s = list->Rem(key_, 0, "elem-1501", &ret);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(1, ret);
+  model.erase(std::find(model.begin(), model.end(), "elem-1501"));
+
+  s = list->Set(key_, 2000, "set-2000");
+  EXPECT_TRUE(s.ok());
+  model[2000] = "set-2000";
+
+  std::string elem;
+  for (int index : {0, 1499, 2000, 4000, -1}) {
+    s = list->Index(key_, index, &elem);
+    EXPECT_TRUE(s.ok());
+    EXPECT_EQ(model[index < 0 ? model.size() + index : index], elem);
+  }
+
+  s = list->LMove(key_, key_, true, false, &elem);
+  EXPECT_TRUE(s.ok());
+  std::rotate(model.begin(), model.begin() + 1, model.end());
+
+  s = list->Trim(key_, 100, -101);
+  EXPECT_TRUE(s.ok());
+  model = std::vector<std::string>(model.begin() + 100, model.end() - 100);
+
+  std::vector<std::string> popped;
+  s = list->PopMulti(key_, true, 10, &popped);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(std::vector<std::string>(model.begin(), model.begin() + 10), popped);
+  model.erase(model.begin(), model.begin() + 10);
+
+  uint32_t size = 0;
+  s = list->Size(key_, &size);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(model.size(), size);
+
+  std::vector<std::string> actual;
+  s = list->Range(key_, 0, -1, &actual);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(model, actual);
+
+  actual.clear();
+  s = list->Range(key_, 1000, 1099, &actual);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(std::vector<std::string>(model.begin() + 1000, model.begin() + 1100), actual);
+
+  list->Del(key_);
+  config_->list_chunked_encoding = false;
+}
+
+TEST_F(RedisListTest, TrimAndPopByRangeDeletion) {
+  config_->range_delete_min_elements = 3;
+  for (bool chunked : {false, true}) {
+    config_->list_chunked_encoding = chunked;
+    list->Del(key_);
+
+    std::vector<std::string> model;
+    for (int i = 0; i < 3000; i++) model.emplace_back("elem-" + std::to_string(i));
+    std::vector<Slice> elems(model.begin(), model.end());
+    int ret = 0;
+    auto s = list->Push(key_, elems, false, &ret);
+    EXPECT_TRUE(s.ok());
+    if (chunked) {
+      // Split the chunks so the popped ranges cross the gaps between them
+      for (int i = 0; i < 1000; i++) {
+        s = list->Insert(key_, model[1500], "ins-" + std::to_string(i), true, &ret);
+        EXPECT_TRUE(s.ok());
+        model.insert(model.begin() + 1500, "ins-" + std::to_string(i));
+      }
+    }
+
+    s = list->Trim(key_, 300, -301);
+    EXPECT_TRUE(s.ok());
+    model = std::vector<std::string>(model.begin() + 300, model.end() - 300);
+
+    std::vector<std::string> popped;
+    s = list->PopMulti(key_, true, 1000, &popped);
+    EXPECT_TRUE(s.ok());
+    EXPECT_EQ(std::vector<std::string>(model.begin(), model.begin() + 1000), popped);
+    model.erase(model.begin(), model.begin() + 1000);
+    s = list->PopMulti(key_, false, 500, &popped);
+    EXPECT_TRUE(s.ok());
+    EXPECT_EQ(std::vector<std::string>(model.rbegin(), model.rbegin() + 500), popped);
+    model.erase(model.end() - 500, model.end());
+
+    std::vector<std::string> actual;
+    s = list->Range(key_, 0, -1, &actual);
+    EXPECT_TRUE(s.ok());
+    EXPECT_EQ(model, actual);
+    list->Del(key_);
+  }
+  config_->list_chunked_encoding = false;
+  config_->range_delete_min_elements = 1000;
+}
@@ -20,11 +20,18 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <memory>
+#include <set>
+#include <string>
+#include <vector>
 
 #include "storage/redis_metadata.h"
+#include "task_runner.h"
 #include "test_base.h"
+#include "time_util.h"
 #include "types/redis_hash.h"
+#include "types/redis_list.h"
 
 TEST(InternalKey, EncodeAndDecode) {
   Slice key = "test-metadata-key";
@@ -44,6 +51,30 @@ TEST(InternalKey, EncodeAndDecode) {
   EXPECT_EQ(ikey, ikey1);
 }
 
+TEST(InternalKey, SubKeyEncoder) {
+  std::string ns_key;
+  ComposeNamespaceKey("namespace", "test-metadata-key", &ns_key, true);
+  std::vector<Slice> sub_keys = {"a", "", "test-metadata-sub-key", std::string(300, 'x')};
+  std::vector<std::string> expected;
+  for (const auto &sub_key : sub_keys) {
+    expected.emplace_back();
+    InternalKey(ns_key, sub_key, 12, true).Encode(&expected.back());
+  }
+
+  SubKeyEncoder encoder(ns_key, 12, true);
+  ASSERT_EQ(encoder.Prefix(), expected[1]);
+  for (size_t i = 0; i < sub_keys.size(); i++) {
+    ASSERT_EQ(encoder.Encode(sub_keys[i]), expected[i]);
+  }
+  std::vector<Slice> keys;
+  encoder.EncodeAll(sub_keys, &keys);
+  ASSERT_EQ(keys.size(), sub_keys.size());
+  for (size_t i = 0; i < sub_keys.size(); i++) {
+    ASSERT_EQ(keys[i], expected[i]);
+    ASSERT_EQ(InternalKey(keys[i], true).GetSubKey(), sub_keys[i]);
+  }
+}
+
 TEST(Metadata, EncodeAndDeocde) {
   std::string string_bytes;
   Metadata string_md(kRedisString);
@@ -66,6 +97,215 @@ TEST(Metadata, EncodeAndDeocde) {
   ASSERT_EQ(list_md, list_md1);
 }
 
+TEST(Metadata, InlineHashEncodeAndDecode) {
+  HashMetadata hash_md;
+  hash_md.expire = 123;
+  hash_md.inlined = true;
+  hash_md.fields = {{"field-1", "value-1"}, {"field-2", ""}, {std::string("\0field", 6), "value-3"}};
+  hash_md.size = 3;
+  std::string hash_bytes;
+  hash_md.Encode(&hash_bytes);
+
+  HashMetadata hash_md1(false);
+  ASSERT_TRUE(hash_md1.Decode(hash_bytes).ok());
+  ASSERT_EQ(hash_md, hash_md1);
+  ASSERT_TRUE(hash_md1.inlined);
+  ASSERT_EQ(hash_md.fields, hash_md1.fields);
+  ASSERT_EQ(34, hash_md1.InlineBytes());
+
+  // The generic metadata ignores the inlined fields
+  Metadata md(kRedisNone, false);
+  ASSERT_TRUE(md.Decode(hash_bytes).ok());
+  ASSERT_EQ(3, md.size);
+
+  HashMetadata hash_md2(false);
+  hash_bytes.resize(hash_bytes.size() - 1);
+  ASSERT_FALSE(hash_md2.Decode(hash_bytes).ok());
+}
+
+TEST(Metadata, InlineSetAndZSetEncodeAndDecode) {
+  SetMetadata set_md;
+  set_md.inlined = true;
+  set_md.members = {"a", "bb", std::string("\0c", 2)};
+  set_md.size = 3;
+  std::string set_bytes;
+  set_md.Encode(&set_bytes);
+
+  SetMetadata set_md1(false);
+  ASSERT_TRUE(set_md1.Decode(set_bytes).ok());
+  ASSERT_TRUE(set_md1.inlined);
+  ASSERT_EQ(set_md.members, set_md1.members);
+  ASSERT_EQ(5, set_md1.InlineBytes());
+  std::vector<std::string> elements;
+  ASSERT_TRUE(DecodeInlineElements(set_bytes, &elements));
+  ASSERT_EQ(std::vector<std::string>({std::string("\0c", 2), "a", "bb"}), elements);
+
+  ZSetMetadata zset_md;
+  zset_md.inlined = true;
+  zset_md.members = {{"m1", -1.5}, {"m2", 2}};
+  zset_md.size = 2;
+  std::string zset_bytes;
+  zset_md.Encode(&zset_bytes);
+
+  ZSetMetadata zset_md1(false);
+  ASSERT_TRUE(zset_md1.Decode(zset_bytes).ok());
+  ASSERT_TRUE(zset_md1.inlined);
+  ASSERT_EQ(zset_md.members, zset_md1.members);
+  ASSERT_EQ(20, zset_md1.InlineBytes());
+  elements.clear();
+  ASSERT_TRUE(DecodeInlineElements(zset_bytes, &elements));
+  ASSERT_EQ(std::vector<std::string>({"-1.5", "m1", "2", "m2"}), elements);
+
+  // The regular encoding has no inlined elements
+  ZSetMetadata zset_md2;
+  std::string plain_bytes;
+  zset_md2.Encode(&plain_bytes);
+  elements.clear();
+  ASSERT_FALSE(DecodeInlineElements(plain_bytes, &elements));
+
+  zset_bytes.resize(zset_bytes.size() - 1);
+  ASSERT_FALSE(zset_md2.Decode(zset_bytes).ok());
+}
+
+TEST(Metadata, BitmapEncodeAndDecode) {
+  BitmapMetadata bitmap_md;
+  bitmap_md.size = 1024;
+  std::string raw_bytes;
+  bitmap_md.Encode(&raw_bytes);
+  BitmapMetadata bitmap_md1(false);
+  ASSERT_TRUE(bitmap_md1.Decode(raw_bytes).ok());
+  ASSERT_FALSE(bitmap_md1.containers);
+
+  bitmap_md.containers = true;
+  std::string container_bytes;
+  bitmap_md.Encode(&container_bytes);
+  ASSERT_EQ(raw_bytes.size() + 1, container_bytes.size());
+  ASSERT_TRUE(bitmap_md1.Decode(container_bytes).ok());
+  ASSERT_TRUE(bitmap_md1.containers);
+  ASSERT_EQ(1024, bitmap_md1.size);
+
+  container_bytes.back() = 0x7f;
+  ASSERT_FALSE(bitmap_md1.Decode(container_bytes).ok());
+
+  bitmap_md.has_bit_count = true;
+  bitmap_md.bit_count = 12345;
+  std::string count_bytes;
+  bitmap_md.Encode(&count_bytes);
+  ASSERT_EQ(raw_bytes.size() + 1 + 8, count_bytes.size());
+  ASSERT_TRUE(bitmap_md1.Decode(count_bytes).ok());
+  ASSERT_TRUE(bitmap_md1.containers);
+  ASSERT_TRUE(bitmap_md1.has_bit_count);
+  ASSERT_EQ(12345, bitmap_md1.bit_count);
+
+  // The bitmap without the bit count is decoded as before
+  ASSERT_TRUE(bitmap_md1.Decode(raw_bytes).ok());
+  ASSERT_FALSE(bitmap_md1.has_bit_count);
+  count_bytes.resize(count_bytes.size() - 1);
+  ASSERT_FALSE(bitmap_md1.Decode(count_bytes).ok());
+}
+
+TEST(Metadata, SortedintEncodeAndDecode) {
+  SortedintMetadata sortedint_md;
+  sortedint_md.blocks = true;
+  sortedint_md.size = 300;
+  std::string bytes;
+  sortedint_md.Encode(&bytes);
+  SortedintMetadata sortedint_md1(false);
+  ASSERT_TRUE(sortedint_md1.Decode(bytes).ok());
+  ASSERT_TRUE(sortedint_md1.blocks);
+  ASSERT_EQ(300, sortedint_md1.size);
+
+  sortedint_md.blocks = false;
+  bytes.clear();
+  sortedint_md.Encode(&bytes);
+  ASSERT_TRUE(sortedint_md1.Decode(bytes).ok());
+  ASSERT_FALSE(sortedint_md1.blocks);
+}
+
+TEST(Metadata, CompactEncodeAndDecode) {
+  HashMetadata hash_md;
+  hash_md.size = 3;
+  hash_md.expire = static_cast<int>(hash_md.Time().tv_sec) + 50;
+  hash_md.inlined = true;
+  hash_md.fields = {{"field-1", "value-1"}, {"field-2", "value-2"}, {"field-3", ""}};
+  std::string fixed_bytes;
+  hash_md.Encode(&fixed_bytes);
+
+  Metadata::SetCompactEncoding(true);
+  std::string compact_bytes;
+  hash_md.Encode(&compact_bytes);
+  ListMetadata list_md;
+  list_md.size = 2;
+  list_md.head = 123;
+  list_md.tail = 125;
+  std::string list_bytes;
+  list_md.Encode(&list_bytes);
+  Metadata string_md(kRedisString);
+  string_md.expire = 123;
+  std::string string_bytes;
+  string_md.Encode(&string_bytes);
+  Metadata::SetCompactEncoding(false);
+
+  // flags(1byte) + version(8byte) + expire(1byte) + size(1byte), the fixed one has 17 bytes
+  ASSERT_EQ(fixed_bytes.size() - 6, compact_bytes.size());
+  ASSERT_EQ(kMetadataCompactEncoded, compact_bytes[0] & kMetadataCompactEncoded);
+  HashMetadata hash_md1(false);
+  ASSERT_TRUE(hash_md1.Decode(compact_bytes).ok());
+  ASSERT_EQ(hash_md, hash_md1);
+  ASSERT_TRUE(hash_md1.inlined);
+  ASSERT_EQ(hash_md.fields, hash_md1.fields);
+
+  // The metadata in the compact encoding is written in the fixed one after it's disabled
+  std::string bytes;
+  hash_md1.Encode(&bytes);
+  ASSERT_EQ(fixed_bytes, bytes);
+
+  ListMetadata list_md1(false);
+  ASSERT_TRUE(list_md1.Decode(list_bytes).ok());
+  ASSERT_EQ(list_md, list_md1);
+  ASSERT_EQ(123U, list_md1.head);
+  ASSERT_EQ(125U, list_md1.tail);
+
+  Metadata string_md1(kRedisNone, false);
+  ASSERT_EQ(5U, string_bytes.size());
+  ASSERT_TRUE(string_md1.Decode(string_bytes).ok());
+  ASSERT_EQ(string_md, string_md1);
+}
+
+TEST(Metadata, CompactEncodeStream) {
+  StreamMetadata stream_md;
+  stream_md.size = 2;
+  stream_md.last_generated_id = {1700000000000, 3};
+  stream_md.first_entry_id = {1700000000000, 2};
+  stream_md.last_entry_id = stream_md.last_generated_id;
+  stream_md.entries_added = 5;
+  std::string fixed_bytes;
+  stream_md.Encode(&fixed_bytes);
+  Metadata::SetCompactEncoding(true);
+  std::string compact_bytes;
+  stream_md.Encode(&compact_bytes);
+  Metadata::SetCompactEncoding(false);
+
+  // The entry ids and the counter are varints in the compact encoding
+  ASSERT_LT(compact_bytes.size() + 40, fixed_bytes.size());
+  StreamMetadata stream_md1(false);
+  ASSERT_TRUE(stream_md1.Decode(compact_bytes).ok());
+  ASSERT_EQ(stream_md.last_generated_id, stream_md1.last_generated_id);
+  ASSERT_EQ(stream_md.first_entry_id, stream_md1.first_entry_id);
+  ASSERT_EQ(stream_md.last_entry_id, stream_md1.last_entry_id);
+  ASSERT_EQ(5U, stream_md1.entries_added);
+
+  // The rewritten metadata keeps the encoding of the type specific fields
+  std::string rewritten;
+  int expire = static_cast<int>(stream_md.Time().tv_sec) + 100;
+  ASSERT_TRUE(Metadata::Rewrite(compact_bytes, stream_md.version, expire, &rewritten).ok());
+  StreamMetadata stream_md2(false);
+  ASSERT_TRUE(stream_md2.Decode(rewritten).ok());
+  ASSERT_EQ(expire, stream_md2.expire);
+  ASSERT_EQ(stream_md.last_generated_id, stream_md2.last_generated_id);
+  ASSERT_EQ(5U, stream_md2.entries_added);
+}
+
 class RedisTypeTest : public TestBase {
  public:
   RedisTypeTest() : TestBase() {
@@ -114,4 +354,273 @@ TEST_F(RedisTypeTest, Expire) {
   redis->TTL(key_, &ttl);
   ASSERT_TRUE(ttl >= 1 && ttl <= 2);
   sleep(2);
-}
\ No newline at end of file
+}
+TEST_F(RedisTypeTest, RandomKey) {
+  int ret;
+  Redis::Hash random_hash(storage_, "random_key_ns");
+  Redis::Database random_db(storage_, "random_key_ns");
+  int64_t now;
+  rocksdb::Env::Default()->GetCurrentTime(&now);
+  for (int i = 0; i < 50; i++) {
+    random_hash.Set("live-" + std::to_string(i), "field", "value", &ret);
+    random_hash.Set("expired-" + std::to_string(i), "field", "value", &ret);
+    random_db.Expire("expired-" + std::to_string(i), static_cast<int>(now - 1));
+  }
+  // The keys are sampled in the SST files, so flush them out of the memtable
+  storage_->GetDB()->Flush(rocksdb::FlushOptions(), storage_->GetCFHandle("metadata"));
+
+  std::set<std::string> keys;
+  for (int i = 0; i < 100; i++) {
+    std::string key;
+    EXPECT_TRUE(random_db.RandomKey("", &key).ok());
+    ASSERT_EQ(key.rfind("live-", 0), 0) << key;
+    keys.emplace(key);
+  }
+  EXPECT_GT(keys.size(), 1);
+
+  for (int i = 0; i < 50; i++) {
+    random_db.Del("live-" + std::to_string(i));
+    random_db.Del("expired-" + std::to_string(i));
+  }
+}
+
+TEST_F(RedisTypeTest, ParallelKeys) {
+  int ret;
+  Redis::Hash parallel_hash(storage_, "parallel_keys_ns");
+  Redis::Database parallel_db(storage_, "parallel_keys_ns");
+  // Every group of the keys is flushed into its own SST file, so the key range can be partitioned
+  for (const auto &group : {"a", "b", "c", "d"}) {
+    for (int i = 0; i < 20; i++) {
+      parallel_hash.Set(std::string("key-") + group + "-" + std::to_string(i), "field", "value", &ret);
+    }
+    storage_->GetDB()->Flush(rocksdb::FlushOptions(), storage_->GetCFHandle("metadata"));
+  }
+  std::vector<std::string> expected;
+  parallel_db.Keys("", &expected);
+  ASSERT_EQ(80U, expected.size());
+
+  std::string begin, end;
+  parallel_db.KeyRange("", &begin, &end);
+  auto boundaries = parallel_db.PartitionKeyRange(begin, end, 4);
+  ASSERT_FALSE(boundaries.empty());
+  ASSERT_LE(boundaries.size(), 3U);
+  ASSERT_TRUE(std::is_sorted(boundaries.begin(), boundaries.end()));
+
+  // The partitions are scanned page by page from the cursors, and they cover all the keys in order
+  boundaries.insert(boundaries.begin(), begin);
+  boundaries.emplace_back(end);
+  std::vector<std::string> scanned;
+  for (size_t i = 0; i + 1 < boundaries.size(); i++) {
+    std::string next = boundaries[i];
+    do {
+      auto s = parallel_db.ScanKeyRange(next, boundaries[i + 1], 7, "", nullptr, kRedisNone, &scanned, &next);
+      ASSERT_TRUE(s.ok());
+    } while (!next.empty());
+  }
+  ASSERT_EQ(expected, scanned);
+
+  TaskRunner runner(2);
+  runner.Start();
+  std::vector<std::string> keys;
+  parallel_db.ParallelKeys("", &keys, nullptr, &runner, 4);
+  ASSERT_EQ(expected, keys);
+  keys.clear();
+  Util::GlobPattern pattern("key-b-1*");
+  parallel_db.ParallelKeys(pattern.LiteralPrefix(), &keys, &pattern, &runner, 4);
+  ASSERT_EQ(11U, keys.size());
+
+  // The keys written in the transaction are only seen by the calling thread
+  ASSERT_TRUE(storage_->BeginTxn());
+  parallel_hash.Set("key-e-0", "field", "value", &ret);
+  keys.clear();
+  parallel_db.ParallelKeys("", &keys, nullptr, &runner, 4);
+  EXPECT_EQ(81U, keys.size());
+  ASSERT_TRUE(storage_->CommitTxn().ok());
+  parallel_db.Del("key-e-0");
+  runner.Stop();
+  runner.Join();
+
+  for (const auto &key : expected) parallel_db.Del(key);
+}
+
+TEST_F(RedisTypeTest, ExpireCompactEncoding) {
+  Metadata::SetCompactEncoding(true);
+  int ret = 0;
+  std::vector<FieldValue> fvs;
+  for (size_t i = 0; i < fields_.size(); i++) {
+    fvs.emplace_back(FieldValue{fields_[i].ToString(), values_[i].ToString()});
+  }
+  ASSERT_TRUE(hash->MSet(key_, fvs, false, &ret).ok());
+  Redis::List list(storage_, "default_ns");
+  std::string list_key = "test-compact-list";
+  ASSERT_TRUE(list.Push(list_key, {"a", "b", "c"}, false, &ret).ok());
+
+  // The version isn't touched by changing the expire, so the subkeys are still there
+  auto check_data = [&]() {
+    std::vector<FieldValue> field_values;
+    EXPECT_TRUE(hash->GetAll(key_, &field_values).ok());
+    EXPECT_EQ(fvs.size(), field_values.size());
+    std::vector<std::string> elems;
+    EXPECT_TRUE(list.Range(list_key, 0, -1, &elems).ok());
+    EXPECT_EQ(std::vector<std::string>({"a", "b", "c"}), elems);
+  };
+  auto now = static_cast<int>(Util::GetTimeStamp());
+  int ttl = 0;
+  for (const auto &key : {key_, list_key}) {
+    ASSERT_TRUE(redis->Expire(key, now + 100).ok());
+    ASSERT_TRUE(redis->TTL(key, &ttl).ok());
+    EXPECT_GT(ttl, 90);
+    EXPECT_LE(ttl, 100);
+  }
+  check_data();
+  for (const auto &key : {key_, list_key}) {
+    ASSERT_TRUE(redis->Expire(key, 0).ok());
+    ASSERT_TRUE(redis->TTL(key, &ttl).ok());
+    EXPECT_EQ(-1, ttl);
+  }
+  check_data();
+  Metadata::SetCompactEncoding(false);
+
+  redis->Del(key_);
+  redis->Del(list_key);
+}
+
+TEST_F(RedisTypeTest, DumpAndRestore) {
+  int ret;
+  std::vector<FieldValue> fvs;
+  for (size_t i = 0; i < fields_.size(); i++) {
+    fvs.emplace_back(FieldValue{fields_[i].ToString(), values_[i].ToString()});
+  }
+  rocksdb::Status s = hash->MSet(key_, fvs, false, &ret);
+  EXPECT_TRUE(s.ok() && static_cast<int>(fvs.size()) == ret);
+
+  std::string payload;
+  EXPECT_TRUE(redis->DumpKey("missing-dump-key", &payload).IsNotFound());
+  s = redis->DumpKey(key_, &payload);
+  ASSERT_TRUE(s.ok());
+
+  EXPECT_TRUE(redis->RestoreKey(key_, payload, 0, false).IsBusy());
+  std::string copy_key = key_ + "-copy";
+  s = redis->RestoreKey(copy_key, payload, 0, false);
+  ASSERT_TRUE(s.ok());
+  for (size_t i = 0; i < fields_.size(); i++) {
+    std::string value;
+    s = hash->Get(copy_key, fields_[i], &value);
+    EXPECT_TRUE(s.ok());
+    EXPECT_EQ(values_[i], value);
+  }
+  // Replacing the key with its own payload should not leave the fields of the old version
+  s = redis->RestoreKey(copy_key, payload, 0, true);
+  ASSERT_TRUE(s.ok());
+  uint32_t size = 0;
+  hash->Size(copy_key, &size);
+  EXPECT_EQ(fvs.size(), size);
+
+  std::string corrupted = payload;
+  corrupted[corrupted.size() / 2] ^= 0x1;
+  EXPECT_TRUE(redis->RestoreKey(key_ + "-bad", corrupted, 0, false).IsCorruption());
+  EXPECT_TRUE(redis->RestoreKey(key_ + "-bad", "garbage", 0, false).IsCorruption());
+
+  redis->Del(key_);
+  redis->Del(copy_key);
+}
+
+TEST_F(RedisTypeTest, RestoreBatch) {
+  int ret;
+  std::vector<FieldValue> fvs;
+  for (size_t i = 0; i < fields_.size(); i++) {
+    fvs.emplace_back(FieldValue{fields_[i].ToString(), values_[i].ToString()});
+  }
+  rocksdb::Status s = hash->MSet(key_, fvs, false, &ret);
+  ASSERT_TRUE(s.ok());
+  std::string payload;
+  ASSERT_TRUE(redis->DumpKey(key_, &payload).ok());
+
+  // The restored keys aren't visible until the batch is written
+  Redis::RestoreBatch restore_batch;
+  std::vector<std::string> copy_keys = {key_ + "-batch-1", key_ + "-batch-2"};
+  for (const auto &copy_key : copy_keys) {
+    ASSERT_TRUE(redis->RestoreKey(copy_key, payload, 0, false, &restore_batch).ok());
+  }
+  EXPECT_TRUE(redis->RestoreKey(key_ + "-bad", "garbage", 0, false, &restore_batch).IsCorruption());
+  uint32_t size = 0;
+  EXPECT_TRUE(hash->Size(copy_keys[0], &size).IsNotFound());
+  ASSERT_TRUE(redis->WriteRestoreBatch(&restore_batch).ok());
+  for (const auto &copy_key : copy_keys) {
+    EXPECT_TRUE(hash->Size(copy_key, &size).ok());
+    EXPECT_EQ(fvs.size(), size);
+  }
+  EXPECT_TRUE(hash->Size(key_ + "-bad", &size).IsNotFound());
+
+  // The key restored twice sees the first restore, which was written before the second one
+  ASSERT_TRUE(redis->RestoreKey(copy_keys[0], payload, 0, true, &restore_batch).ok());
+  EXPECT_TRUE(redis->RestoreKey(copy_keys[0], payload, 0, false, &restore_batch).IsBusy());
+  ASSERT_TRUE(redis->RestoreKey(copy_keys[0], payload, 0, true, &restore_batch).ok());
+  ASSERT_TRUE(redis->WriteRestoreBatch(&restore_batch).ok());
+  EXPECT_TRUE(hash->Size(copy_keys[0], &size).ok());
+  EXPECT_EQ(fvs.size(), size);
+  EXPECT_TRUE(restore_batch.write_status.ok());
+
+  redis->Del(key_);
+  for (const auto &copy_key : copy_keys) redis->Del(copy_key);
+}
+
+TEST_F(RedisTypeTest, MDelAndExists) {
+  int ret;
+  int64_t now;
+  rocksdb::Env::Default()->GetCurrentTime(&now);
+  std::vector<std::string> keys = {"mdel-key-1", "mdel-key-2", "mdel-key-3", "mdel-expired"};
+  for (const auto &key : keys) {
+    hash->Set(key, "field", "value", &ret);
+  }
+  redis->Expire("mdel-expired", static_cast<int>(now - 1));
+
+  // The duplicated keys are counted by EXISTS as Redis does, but deleted only once
+  std::vector<Slice> args = {"mdel-key-1", "mdel-key-2", "mdel-key-1", "mdel-expired", "mdel-missing"};
+  redis->Exists(args, &ret);
+  EXPECT_EQ(3, ret);
+
+  uint64_t deleted = 0;
+  EXPECT_TRUE(redis->MDel(args, &deleted).ok());
+  EXPECT_EQ(2U, deleted);
+  redis->Exists(args, &ret);
+  EXPECT_EQ(0, ret);
+  redis->Exists({"mdel-key-3"}, &ret);
+  EXPECT_EQ(1, ret);
+
+  EXPECT_TRUE(redis->MDel({"mdel-key-3"}, &deleted).ok());
+  EXPECT_EQ(1U, deleted);
+}
+
+TEST_F(RedisTypeTest, Prefetch) {
+  int ret;
+  hash->Set("prefetch-key-1", "field", "value", &ret);
+  hash->Set("prefetch-key-2", "field", "value", &ret);
+
+  auto cache = storage_->GetMetadataCache();
+  cache->SetCapacity(1 << 20);
+  std::vector<Redis::PrefetchKey> keys(3);
+  keys[0].user_key = "prefetch-key-1";
+  keys[0].type = kRedisHash;
+  keys[0].sub_keys = {"field", "missing-field"};
+  keys[1].user_key = "prefetch-key-2";
+  keys[1].type = kRedisString;
+  keys[1].sub_keys = {"field"};
+  keys[2].user_key = "prefetch-missing";
+  redis->Prefetch(keys);
+  EXPECT_EQ(3U, cache->GetMisses());
+
+  // The prefetched metadata is served by the cache, the missing key isn't cached
+  std::string bytes;
+  EXPECT_TRUE(redis->GetRawMetadataByUserKey("prefetch-key-1", &bytes).ok());
+  EXPECT_TRUE(redis->GetRawMetadataByUserKey("prefetch-key-2", &bytes).ok());
+  EXPECT_TRUE(redis->GetRawMetadataByUserKey("prefetch-missing", &bytes).IsNotFound());
+  EXPECT_EQ(2U, cache->GetHits());
+  EXPECT_EQ(4U, cache->GetMisses());
+
+  std::string value;
+  EXPECT_TRUE(hash->Get("prefetch-key-1", "field", &value).ok());
+  EXPECT_EQ("value", value);
+  cache->SetCapacity(0);
+  cache->Clear();
+}
@@ -21,6 +21,9 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <set>
+#include <string>
+#include <vector>
 
 #include "test_base.h"
 #include "types/redis_set.h"
@@ -188,6 +191,33 @@ TEST_F(RedisSetTest, Inter) {
   set->Del(k3);
 }
 
+TEST_F(RedisSetTest, InterCard) {
+  int ret;
+  std::string k1 = "key1", k2 = "key2", k3 = "key3";
+  set->Add(k1, {"a", "b", "c", "d"}, &ret);
+  set->Add(k2, {"a", "b", "c"}, &ret);
+  set->Add(k3, {"b", "c", "e"}, &ret);
+  uint64_t card = 0;
+  rocksdb::Status s = set->InterCard({k1, k2, k3}, 0, &card);
+  EXPECT_TRUE(s.ok() && card == 2);
+  s = set->InterCard({k1, k2, k3}, 1, &card);
+  EXPECT_TRUE(s.ok() && card == 1);
+  s = set->InterCard({k1, k2}, 10, &card);
+  EXPECT_TRUE(s.ok() && card == 3);
+  s = set->InterCard({k1, "no-exists-key"}, 0, &card);
+  EXPECT_TRUE(s.ok() && card == 0);
+  std::vector<std::string> members;
+  set->Inter({k3, k1}, &members);
+  EXPECT_EQ(std::vector<std::string>({"b", "c"}), members);
+  set->Union({k2, k3}, &members);
+  EXPECT_EQ(std::vector<std::string>({"a", "b", "c", "e"}), members);
+  set->Diff({k1, k3}, &members);
+  EXPECT_EQ(std::vector<std::string>({"a", "d"}), members);
+  set->Del(k1);
+  set->Del(k2);
+  set->Del(k3);
+}
+
 TEST_F(RedisSetTest, Overwrite) {
   int ret;
   rocksdb::Status s = set->Add(key_, fields_, &ret);
@@ -212,3 +242,106 @@ TEST_F(RedisSetTest, TakeWithoutPop) {
   EXPECT_TRUE(s.ok() && static_cast<int>(fields_.size()) == ret);
   set->Del(key_);
 }
+
+TEST_F(RedisSetTest, InlineEncoding) {
+  config_->set_inline_max_entries = 4;
+  set->Del(key_);
+
+  int ret = 0;
+  auto s = set->Add(key_, {"m1", "m2", "m3", "m2"}, &ret);
+  EXPECT_TRUE(s.ok() && ret == 3);
+  std::string ns_key, bytes;
+  set->AppendNamespacePrefix(key_, &ns_key);
+  s = set->GetRawMetadata(ns_key, &bytes);
+  EXPECT_TRUE(s.ok());
+  SetMetadata metadata(false);
+  metadata.Decode(bytes);
+  EXPECT_TRUE(metadata.inlined);
+  EXPECT_EQ(3, metadata.members.size());
+
+  s = set->IsMember(key_, "m2", &ret);
+  EXPECT_TRUE(s.ok() && ret == 1);
+  std::vector<int> exists;
+  s = set->MIsMember(key_, {"m1", "m9", "m3"}, &exists);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(std::vector<int>({1, 0, 1}), exists);
+  std::vector<std::string> members;
+  s = set->Scan(key_, "m1", 10, "m", &members);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(std::vector<std::string>({"m2", "m3"}), members);
+  s = set->Remove(key_, {"m1", "m1", "m9"}, &ret);
+  EXPECT_TRUE(s.ok() && ret == 1);
+  s = set->Take(key_, &members, 1, true);
+  EXPECT_TRUE(s.ok() && members.size() == 1);
+  s = set->Card(key_, &ret);
+  EXPECT_TRUE(s.ok() && ret == 1);
+
+  // Growing beyond the limit converts the set to the subkeys
+  s = set->Add(key_, {"m4", "m5", "m6", "m7"}, &ret);
+  EXPECT_TRUE(s.ok() && ret == 4);
+  bytes.clear();
+  s = set->GetRawMetadata(ns_key, &bytes);
+  EXPECT_TRUE(s.ok());
+  metadata.Decode(bytes);
+  EXPECT_FALSE(metadata.inlined);
+  EXPECT_EQ(5, metadata.size);
+  s = set->Members(key_, &members);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(5, members.size());
+
+  set->Del(key_);
+  config_->set_inline_max_entries = 0;
+}
+
+TEST_F(RedisSetTest, AddDuplicatedMembers) {
+  int ret = 0;
+  auto s = set->Add(key_, {"m1", "m2"}, &ret);
+  EXPECT_TRUE(s.ok() && ret == 2);
+  // The existence of the members in the subkeys is checked in one batch
+  s = set->Add(key_, {"m2", "m3", "m3", "m1", "m4"}, &ret);
+  EXPECT_TRUE(s.ok() && ret == 2);
+  s = set->Card(key_, &ret);
+  EXPECT_TRUE(s.ok() && ret == 4);
+  set->Del(key_);
+}
+
+TEST_F(RedisSetTest, TakeRandomMembers) {
+  std::vector<std::string> values;
+  for (int i = 0; i < 1000; i++) values.emplace_back("member-" + std::to_string(i));
+  int ret = 0;
+  set->Add(key_, std::vector<Slice>(values.begin(), values.end()), &ret);
+  EXPECT_EQ(1000, ret);
+
+  std::vector<std::string> members;
+  std::set<std::string> seen;
+  for (int i = 0; i < 10; i++) {
+    auto s = set->Take(key_, &members, 10, false);
+    EXPECT_TRUE(s.ok());
+    EXPECT_EQ(10, members.size());
+    EXPECT_EQ(10, std::set<std::string>(members.begin(), members.end()).size());
+    seen.insert(members.begin(), members.end());
+  }
+  // The members are sampled at random points instead of always the first ones
+  EXPECT_GT(seen.size(), 10);
+
+  auto s = set->Take(key_, &members, -2000, false);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(2000, members.size());
+  s = set->Take(key_, &members, 900, false);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(900, std::set<std::string>(members.begin(), members.end()).size());
+
+  s = set->Take(key_, &members, 100, true);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(100, members.size());
+  for (const auto &member : members) {
+    set->IsMember(key_, member, &ret);
+    EXPECT_EQ(0, ret);
+  }
+  set->Card(key_, &ret);
+  EXPECT_EQ(900, ret);
+  s = set->Take(key_, &members, 2000, true);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(900, members.size());
+  set->Del(key_);
+}
@@ -21,6 +21,7 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <vector>
 
 #include "test_base.h"
 #include "types/redis_sortedint.h"
@@ -68,3 +69,88 @@ TEST_F(RedisSortedintTest, Range) {
   EXPECT_TRUE(s.ok() && static_cast<int>(ids_.size()) == ret);
   sortedint->Del(key_);
 }
+
+TEST_F(RedisSortedintTest, BlockEncodeAndDecode) {
+  std::vector<std::vector<uint64_t>> cases = {
+      {7}, {1, 2, 3, 4}, {0, 1000, 1001, 70000, 1ULL << 40}, {0, UINT64_MAX}, {5, 5 + 255, 5 + 510}};
+  std::vector<uint64_t> ids;
+  for (const auto &block_ids : cases) {
+    std::string value = Redis::Sortedint::EncodeBlock(block_ids);
+    EXPECT_TRUE(Redis::Sortedint::DecodeBlock(block_ids.front(), value, &ids));
+    EXPECT_EQ(block_ids, ids);
+  }
+  // The contiguous ids take one bit each
+  std::vector<uint64_t> contiguous;
+  for (uint64_t id = 100; id < 356; id++) contiguous.emplace_back(id);
+  EXPECT_LE(Redis::Sortedint::EncodeBlock(contiguous).size(), 5 + 32);
+
+  std::string value = Redis::Sortedint::EncodeBlock(cases[2]);
+  value.pop_back();
+  EXPECT_FALSE(Redis::Sortedint::DecodeBlock(0, value, &ids));
+}
+
+TEST_F(RedisSortedintTest, BlockEncoding) {
+  config_->sortedint_block_encoding = true;
+  int ret = 0;
+  // Add the ids in the random order, so the blocks are split in the middle of the sortedint
+  std::vector<uint64_t> ids;
+  for (uint64_t i = 0; i < 2000; i++) ids.emplace_back((i * 7919) % 2000 * 3 + 10);
+  for (size_t i = 0; i < ids.size(); i += 100) {
+    std::vector<uint64_t> batch(ids.begin() + static_cast<int64_t>(i), ids.begin() + static_cast<int64_t>(i + 100));
+    auto s = sortedint->Add(key_, batch, &ret);
+    EXPECT_TRUE(s.ok());
+    EXPECT_EQ(100, ret);
+  }
+  auto s = sortedint->Add(key_, {10, 13, 1}, &ret);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(1, ret);
+  sortedint->Card(key_, &ret);
+  EXPECT_EQ(2001, ret);
+
+  std::vector<uint64_t> result;
+  sortedint->Range(key_, 0, 0, 0, false, &result);
+  ASSERT_EQ(2001, result.size());
+  EXPECT_EQ(1, result[0]);
+  for (size_t i = 1; i < result.size(); i++) EXPECT_EQ((i - 1) * 3 + 10, result[i]);
+  sortedint->Range(key_, 1000, 2, 3, false, &result);
+  EXPECT_EQ(std::vector<uint64_t>({1009, 1012, 1015}), result);
+  sortedint->Range(key_, 1000, 0, 3, true, &result);
+  EXPECT_EQ(std::vector<uint64_t>({997, 994, 991}), result);
+  sortedint->Range(key_, 0, 0, 2, true, &result);
+  EXPECT_EQ(std::vector<uint64_t>({6007, 6004}), result);
+
+  SortedintRangeSpec spec;
+  spec.min = 100;
+  spec.minex = true;
+  spec.max = 112;
+  int size = 0;
+  sortedint->RangeByValue(key_, spec, &result, &size);
+  EXPECT_EQ(std::vector<uint64_t>({103, 106, 109, 112}), result);
+  spec.reversed = true;
+  spec.count = 2;
+  sortedint->RangeByValue(key_, spec, &result, &size);
+  EXPECT_EQ(std::vector<uint64_t>({112, 109}), result);
+
+  std::vector<int> exists;
+  sortedint->MExist(key_, {0, 1, 10, 11, 6007, 6010}, &exists);
+  EXPECT_EQ(std::vector<int>({0, 1, 1, 0, 1, 0}), exists);
+
+  // Remove the first ids of the blocks and a whole range of them
+  std::vector<uint64_t> removed = {1, 10};
+  for (uint64_t id = 3010; id < 4510; id += 3) removed.emplace_back(id);
+  s = sortedint->Remove(key_, removed, &ret);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(502, ret);
+  sortedint->Card(key_, &ret);
+  EXPECT_EQ(1499, ret);
+  sortedint->Range(key_, 0, 0, 0, false, &result);
+  ASSERT_EQ(1499, result.size());
+  EXPECT_EQ(13, result[0]);
+  EXPECT_EQ(3007, result[998]);
+  EXPECT_EQ(4510, result[999]);
+  sortedint->MExist(key_, {10, 13, 3010, 4510}, &exists);
+  EXPECT_EQ(std::vector<int>({0, 1, 0, 1}), exists);
+
+  config_->sortedint_block_encoding = false;
+  sortedint->Del(key_);
+}
@@ -59,6 +59,61 @@ TEST_F(RedisStreamTest, EncodeDecodeEntryValue) {
   checkStreamEntryValues(decoded, values);
 }
 
+TEST_F(RedisStreamTest, EncodeDecodeSchemaEntryValue) {
+  std::vector<std::vector<std::string>> schemas = {{"day", "month"}};
+  std::vector<std::string> values = {"day", "first", "month", "eleventh"};
+  std::vector<std::string> decoded;
+  auto encoded = Redis::EncodeStreamEntryValue(1, values);
+  EXPECT_EQ(encoded.size(), 1 + 6 + 9);
+  auto s = Redis::DecodeStreamEntryValue(schemas, encoded, &decoded);
+  EXPECT_TRUE(s.IsOK());
+  checkStreamEntryValues(decoded, values);
+
+  encoded = Redis::EncodeStreamEntryValue(0, values);
+  s = Redis::DecodeStreamEntryValue(schemas, encoded, &decoded);
+  EXPECT_TRUE(s.IsOK());
+  checkStreamEntryValues(decoded, values);
+
+  s = Redis::DecodeStreamEntryValue(schemas, Redis::EncodeStreamEntryValue(2, values), &decoded);
+  EXPECT_FALSE(s.IsOK());
+}
+
+TEST_F(RedisStreamTest, AddEntriesWithSchemas) {
+  Redis::StreamAddOptions add_options;
+  std::vector<std::vector<std::string>> values = {
+      {"key1", "val1"}, {"key1", "val2", "key2", "val3"}, {"key1", "val4", "key2", "val5"}, {"key3", "val6"}};
+  std::vector<Redis::StreamEntryID> ids(values.size());
+  // the entry added before the schemas are enabled keeps the raw encoding
+  auto s = stream->Add(name, add_options, values[0], &ids[0]);
+  EXPECT_TRUE(s.ok());
+  config_->stream_entry_max_schemas = 1;
+  for (size_t i = 1; i < values.size(); i++) {
+    s = stream->Add(name, add_options, values[i], &ids[i]);
+    EXPECT_TRUE(s.ok());
+  }
+
+  Redis::StreamRangeOptions range_options;
+  range_options.start = Redis::StreamEntryID::Minimum();
+  range_options.end = Redis::StreamEntryID::Maximum();
+  std::vector<Redis::StreamEntry> entries;
+  s = stream->Range(name, range_options, &entries);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(entries.size(), values.size());
+  for (size_t i = 0; i < entries.size(); i++) {
+    EXPECT_EQ(entries[i].key, ids[i].ToString());
+    checkStreamEntryValues(entries[i].values, values[i]);
+  }
+
+  range_options.start = ids[2];
+  range_options.end = ids[2];
+  entries.clear();
+  s = stream->Range(name, range_options, &entries);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(entries.size(), 1);
+  checkStreamEntryValues(entries[0].values, values[2]);
+  config_->stream_entry_max_schemas = 0;
+}
+
 TEST_F(RedisStreamTest, AddEntryToNonExistingStreamWithNomkstreamOption) {
   Redis::StreamAddOptions options;
   options.nomkstream = true;
@@ -2059,3 +2114,249 @@ TEST_F(RedisStreamTest, StreamInfoCheckAfterTrimAllEntries) {
   EXPECT_FALSE(info.last_entry);
   EXPECT_EQ(info.entries.size(), 0);
 }
+
+TEST_F(RedisStreamTest, TrimWithRangeDeletion) {
+  config_->range_delete_min_elements = 3;
+  Redis::StreamAddOptions add_options;
+  add_options.with_entry_id = true;
+  for (uint64_t i = 1; i <= 6; ++i) {
+    add_options.entry_id = Redis::NewStreamEntryID{i, 0};
+    Redis::StreamEntryID id;
+    auto s = stream->Add(name, add_options, {"key", std::to_string(i)}, &id);
+    EXPECT_TRUE(s.ok());
+  }
+  // the consumer group sorts after the entries and must survive the range deletion
+  auto s = stream->CreateGroup(name, "group", Redis::StreamCreateGroupOptions{});
+  EXPECT_TRUE(s.ok());
+
+  Redis::StreamTrimOptions options;
+  options.strategy = Redis::StreamTrimStrategy::MinID;
+  options.min_id = Redis::StreamEntryID{5, 0};
+  uint64_t trimmed = 0;
+  s = stream->Trim(name, options, &trimmed);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(trimmed, 4);
+
+  Redis::StreamRangeOptions range_options;
+  range_options.start = Redis::StreamEntryID::Minimum();
+  range_options.end = Redis::StreamEntryID::Maximum();
+  std::vector<Redis::StreamEntry> entries;
+  s = stream->Range(name, range_options, &entries);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(entries.size(), 2);
+  EXPECT_EQ(entries[0].key, "5-0");
+
+  options.strategy = Redis::StreamTrimStrategy::MaxLen;
+  options.max_len = 0;
+  s = stream->Trim(name, options, &trimmed);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(trimmed, 2);
+
+  Redis::StreamInfo info;
+  s = stream->GetStreamInfo(name, false, 0, &info);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(info.size, 0);
+  EXPECT_EQ(info.max_deleted_entry_id.ToString(), "6-0");
+  std::vector<std::pair<std::string, Redis::StreamGroupMetadata>> groups;
+  s = stream->GetGroups(name, &groups);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(groups.size(), 1);
+  config_->range_delete_min_elements = 1000;
+}
+
+TEST_F(RedisStreamTest, ConsumerGroupReadAndAck) {
+  Redis::StreamAddOptions add_options;
+  add_options.with_entry_id = true;
+  for (uint64_t i = 1; i <= 3; ++i) {
+    add_options.entry_id = Redis::NewStreamEntryID{i, 0};
+    Redis::StreamEntryID id;
+    auto s = stream->Add(name, add_options, {"key" + std::to_string(i), "val"}, &id);
+    EXPECT_TRUE(s.ok());
+  }
+
+  Redis::StreamCreateGroupOptions group_options;
+  auto s = stream->CreateGroup(name, "group", group_options);
+  EXPECT_TRUE(s.ok());
+  s = stream->CreateGroup(name, "group", group_options);
+  EXPECT_FALSE(s.ok());
+
+  Redis::StreamReadGroupOptions options;
+  options.group = "group";
+  options.consumer = "alice";
+  options.with_count = true;
+  options.count = 2;
+  std::vector<Redis::StreamEntry> entries;
+  s = stream->ReadGroup(name, options, &entries);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(entries.size(), 2);
+  EXPECT_EQ(entries[0].key, "1-0");
+  EXPECT_EQ(entries[1].key, "2-0");
+
+  options.consumer = "bob";
+  s = stream->ReadGroup(name, options, &entries);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(entries.size(), 1);
+  EXPECT_EQ(entries[0].key, "3-0");
+
+  // the consumer groups are invisible to the entry operations
+  uint64_t len = 0;
+  s = stream->Len(name, &len);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(len, 3);
+  Redis::StreamRangeOptions range_options;
+  range_options.start = Redis::StreamEntryID::Minimum();
+  range_options.end = Redis::StreamEntryID::Maximum();
+  s = stream->Range(name, range_options, &entries);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(entries.size(), 3);
+  range_options.reverse = true;
+  range_options.start = Redis::StreamEntryID::Maximum();
+  range_options.end = Redis::StreamEntryID::Minimum();
+  s = stream->Range(name, range_options, &entries);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(entries.size(), 3);
+  EXPECT_EQ(entries[0].key, "3-0");
+
+  Redis::StreamPendingSummary summary;
+  s = stream->GetPendingSummary(name, "group", &summary);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(summary.pending, 3);
+  EXPECT_EQ(summary.first_id.ToString(), "1-0");
+  EXPECT_EQ(summary.last_id.ToString(), "3-0");
+  ASSERT_EQ(summary.consumers.size(), 2);
+  EXPECT_EQ(summary.consumers[0], std::make_pair(std::string("alice"), uint64_t(2)));
+  EXPECT_EQ(summary.consumers[1], std::make_pair(std::string("bob"), uint64_t(1)));
+
+  // the history of the consumer
+  options.consumer = "alice";
+  options.new_entries = false;
+  options.with_count = false;
+  s = stream->ReadGroup(name, options, &entries);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(entries.size(), 2);
+  EXPECT_EQ(entries[1].key, "2-0");
+
+  uint64_t acked = 0;
+  s = stream->Ack(name, "group", {Redis::StreamEntryID{1, 0}, Redis::StreamEntryID{1, 0}, Redis::StreamEntryID{9, 0}},
+                  &acked);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(acked, 1);
+
+  Redis::StreamPendingOptions pending_options;
+  pending_options.start = Redis::StreamEntryID::Minimum();
+  pending_options.end = Redis::StreamEntryID::Maximum();
+  pending_options.count = 10;
+  std::vector<Redis::StreamPendingEntry> pending;
+  s = stream->GetPendingEntries(name, "group", pending_options, &pending);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(pending.size(), 2);
+  EXPECT_EQ(pending[0].id.ToString(), "2-0");
+  EXPECT_EQ(pending[0].consumer, "alice");
+  EXPECT_EQ(pending[0].delivery_count, 1);
+  EXPECT_EQ(pending[1].consumer, "bob");
+
+  std::vector<std::pair<std::string, Redis::StreamGroupMetadata>> groups;
+  s = stream->GetGroups(name, &groups);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(groups.size(), 1);
+  EXPECT_EQ(groups[0].first, "group");
+  EXPECT_EQ(groups[0].second.pending, 2);
+  EXPECT_EQ(groups[0].second.consumers, 2);
+  EXPECT_EQ(groups[0].second.last_delivered_id.ToString(), "3-0");
+}
+
+TEST_F(RedisStreamTest, ConsumerGroupClaim) {
+  Redis::StreamAddOptions add_options;
+  add_options.with_entry_id = true;
+  for (uint64_t i = 1; i <= 4; ++i) {
+    add_options.entry_id = Redis::NewStreamEntryID{i, 0};
+    Redis::StreamEntryID id;
+    auto s = stream->Add(name, add_options, {"key", std::to_string(i)}, &id);
+    EXPECT_TRUE(s.ok());
+  }
+
+  auto s = stream->CreateGroup(name, "group", Redis::StreamCreateGroupOptions{});
+  EXPECT_TRUE(s.ok());
+  Redis::StreamReadGroupOptions options;
+  options.group = "group";
+  options.consumer = "alice";
+  std::vector<Redis::StreamEntry> entries;
+  s = stream->ReadGroup(name, options, &entries);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(entries.size(), 4);
+
+  // nothing is idle for an hour
+  Redis::StreamClaimOptions claim_options;
+  claim_options.min_idle_time = 3600 * 1000;
+  s = stream->Claim(name, "group", "bob", claim_options, {Redis::StreamEntryID{1, 0}}, &entries);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(entries.size(), 0);
+
+  claim_options.min_idle_time = 0;
+  s = stream->Claim(name, "group", "bob", claim_options, {Redis::StreamEntryID{1, 0}, Redis::StreamEntryID{9, 0}},
+                    &entries);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(entries.size(), 1);
+  EXPECT_EQ(entries[0].key, "1-0");
+  checkStreamEntryValues(entries[0].values, {"key", "1"});
+
+  // the deleted entry is dropped from the PEL
+  uint64_t deleted = 0;
+  s = stream->DeleteEntries(name, {Redis::StreamEntryID{3, 0}}, &deleted);
+  EXPECT_TRUE(s.ok());
+
+  Redis::StreamAutoClaimOptions auto_claim_options;
+  auto_claim_options.start = Redis::StreamEntryID::Minimum();
+  auto_claim_options.count = 2;
+  Redis::StreamAutoClaimResult result;
+  s = stream->AutoClaim(name, "group", "carol", auto_claim_options, &result);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(result.entries.size(), 2);
+  EXPECT_EQ(result.entries[0].key, "1-0");
+  EXPECT_EQ(result.entries[1].key, "2-0");
+  EXPECT_EQ(result.next_start.ToString(), "3-0");
+  EXPECT_TRUE(result.deleted_ids.empty());
+
+  auto_claim_options.start = result.next_start;
+  s = stream->AutoClaim(name, "group", "carol", auto_claim_options, &result);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(result.entries.size(), 1);
+  EXPECT_EQ(result.entries[0].key, "4-0");
+  EXPECT_EQ(result.next_start.ToString(), "0-0");
+  ASSERT_EQ(result.deleted_ids.size(), 1);
+  EXPECT_EQ(result.deleted_ids[0], "3-0");
+
+  Redis::StreamPendingOptions pending_options;
+  pending_options.start = Redis::StreamEntryID::Minimum();
+  pending_options.end = Redis::StreamEntryID::Maximum();
+  pending_options.count = 10;
+  std::vector<Redis::StreamPendingEntry> pending;
+  s = stream->GetPendingEntries(name, "group", pending_options, &pending);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(pending.size(), 3);
+  for (const auto &entry : pending) {
+    EXPECT_EQ(entry.consumer, "carol");
+  }
+  EXPECT_EQ(pending[0].delivery_count, 3);
+  EXPECT_EQ(pending[1].delivery_count, 2);
+
+  std::vector<std::pair<std::string, Redis::StreamConsumerMetadata>> consumers;
+  s = stream->GetConsumers(name, "group", &consumers);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(consumers.size(), 3);
+  EXPECT_EQ(consumers[0].first, "alice");
+  EXPECT_EQ(consumers[0].second.pending, 0);
+  EXPECT_EQ(consumers[1].second.pending, 0);
+  EXPECT_EQ(consumers[2].first, "carol");
+  EXPECT_EQ(consumers[2].second.pending, 3);
+
+  uint64_t ret = 0;
+  s = stream->DeleteConsumer(name, "group", "carol", &ret);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(ret, 3);
+  s = stream->DestroyGroup(name, "group", &ret);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(ret, 1);
+  s = stream->GetPendingEntries(name, "group", pending_options, &pending);
+  EXPECT_TRUE(s.IsNotFound());
+}
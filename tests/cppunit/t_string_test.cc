@@ -67,6 +67,33 @@ TEST_F(RedisStringTest, GetAndSet) {
   }
 }
 
+TEST_F(RedisStringTest, GetPinned) {
+  for (size_t i = 0; i < pairs_.size(); i++) {
+    string->Set(pairs_[i].key.ToString(), pairs_[i].value.ToString());
+  }
+  for (size_t i = 0; i < pairs_.size(); i++) {
+    rocksdb::PinnableSlice got_value;
+    auto s = string->Get(pairs_[i].key.ToString(), &got_value);
+    EXPECT_TRUE(s.ok());
+    EXPECT_EQ(pairs_[i].value, got_value);
+  }
+  rocksdb::PinnableSlice got_value;
+  EXPECT_TRUE(string->Get("no_such_key", &got_value).IsNotFound());
+
+  config_->string_chunked_min_bytes = 1;
+  std::string chunked(Redis::kStringChunkSize + 100, 'a');
+  string->Set(key_, chunked);
+  got_value.Reset();
+  EXPECT_TRUE(string->Get(key_, &got_value).ok());
+  EXPECT_EQ(chunked, got_value.ToString());
+  config_->string_chunked_min_bytes = 0;
+
+  string->Del(key_);
+  for (size_t i = 0; i < pairs_.size(); i++) {
+    string->Del(pairs_[i].key);
+  }
+}
+
 TEST_F(RedisStringTest, MGetAndMSet) {
   string->MSet(pairs_);
   std::vector<Slice> keys;
@@ -126,6 +153,38 @@ TEST_F(RedisStringTest, IncrBy) {
   string->Del(key_);
 }
 
+TEST_F(RedisStringTest, MergeIncrBy) {
+  int ttl = 0;
+  int64_t now = 0, ret = 0;
+  std::string value;
+  EXPECT_TRUE(string->MergeIncrBy(key_, 5).ok());
+  EXPECT_TRUE(string->MergeIncrBy(key_, -2).ok());
+  string->Get(key_, &value);
+  EXPECT_EQ("3", value);
+  // The read-modify-write increment sees the merged value
+  string->IncrBy(key_, 1, &ret);
+  EXPECT_EQ(4, ret);
+  // The expire is kept
+  rocksdb::Env::Default()->GetCurrentTime(&now);
+  string->Expire(key_, static_cast<int>(now + 1000));
+  string->MergeIncrBy(key_, 1);
+  string->Get(key_, &value);
+  EXPECT_EQ("5", value);
+  string->TTL(key_, &ttl);
+  EXPECT_GT(ttl, 0);
+  // The overflowed increment is dropped
+  string->MergeIncrBy(key_, INT64_MAX);
+  string->MergeIncrBy(key_, 1);
+  string->Get(key_, &value);
+  EXPECT_EQ("6", value);
+  // The non-integer value is left as it was
+  string->Set(key_, "abc");
+  string->MergeIncrBy(key_, 1);
+  string->Get(key_, &value);
+  EXPECT_EQ("abc", value);
+  string->Del(key_);
+}
+
 TEST_F(RedisStringTest, GetEmptyValue) {
   const std::string key = "empty_value_key";
   auto s = string->Set(key, "");
@@ -304,4 +363,52 @@ TEST_F(RedisStringTest, CAD) {
   ASSERT_TRUE(status.IsNotFound());
 
   string->Del(key);
-}
\ No newline at end of file
+}
+TEST_F(RedisStringTest, ChunkedString) {
+  config_->string_chunked_min_bytes = 1;
+  std::string chunk_key = "chunked_string_key";
+  std::string appended(Redis::kStringChunkSize + 100, 'a');
+  int ret = 0;
+  string->Append(chunk_key, appended.substr(0, 100), &ret);
+  EXPECT_EQ(100, ret);
+  string->Append(chunk_key, appended.substr(100), &ret);
+  EXPECT_EQ(static_cast<int>(appended.size()), ret);
+  std::string value;
+  string->Get(chunk_key, &value);
+  EXPECT_EQ(appended, value);
+
+  // Overwrite across the boundary of the chunks and write far beyond the end
+  string->SetRange(chunk_key, Redis::kStringChunkSize - 2, "bcde", &ret);
+  EXPECT_EQ(static_cast<int>(appended.size()), ret);
+  appended.replace(Redis::kStringChunkSize - 2, 4, "bcde");
+  uint64_t sparse_offset = 3 * Redis::kStringChunkSize + 10;
+  string->SetRange(chunk_key, sparse_offset, "xyz", &ret);
+  EXPECT_EQ(static_cast<int>(sparse_offset + 3), ret);
+  appended.resize(sparse_offset, '\0');
+  appended += "xyz";
+  string->Get(chunk_key, &value);
+  EXPECT_EQ(appended, value);
+
+  string->GetRange(chunk_key, Redis::kStringChunkSize - 3, Redis::kStringChunkSize + 2, &value);
+  EXPECT_EQ("abcdea", value);
+  string->GetRange(chunk_key, -3, -1, &value);
+  EXPECT_EQ("xyz", value);
+  string->GetRange(chunk_key, 2 * Redis::kStringChunkSize, 2 * Redis::kStringChunkSize + 1, &value);
+  EXPECT_EQ(std::string(2, '\0'), value);
+
+  std::vector<std::string> values;
+  string->MGet({chunk_key, "no_such_key"}, &values);
+  ASSERT_EQ(2, values.size());
+  EXPECT_EQ(appended, values[0]);
+
+  // The whole value write turns the chunked string into the inline string
+  string->Set(chunk_key, "10");
+  int64_t incr_ret = 0;
+  string->IncrBy(chunk_key, 5, &incr_ret);
+  EXPECT_EQ(15, incr_ret);
+  string->Get(chunk_key, &value);
+  EXPECT_EQ("15", value);
+
+  string->Del(chunk_key);
+  config_->string_chunked_min_bytes = 0;
+}
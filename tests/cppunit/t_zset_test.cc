@@ -20,8 +20,11 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <memory>
+#include <set>
 
+#include "fmt/format.h"
 #include "test_base.h"
 #include "types/redis_zset.h"
 
@@ -309,6 +312,39 @@ TEST_F(RedisZSetTest, RemRangeByScore) {
   EXPECT_EQ(1, ret);
 }
 
+TEST_F(RedisZSetTest, RemRangeByScoreWithRangeDeletion) {
+  config_->range_delete_min_elements = 3;
+  int ret = 0;
+  std::vector<MemberScore> mscores;
+  for (size_t i = 0; i < fields_.size(); i++) {
+    mscores.emplace_back(MemberScore{fields_[i].ToString(), scores_[i]});
+  }
+  zset->Add(key_, ZAddFlags::Default(), &mscores, &ret);
+  EXPECT_EQ(fields_.size(), ret);
+
+  ZRangeSpec spec;
+  spec.min = scores_[1];
+  spec.max = scores_[5];
+  spec.reversed = true;
+  auto s = zset->RemoveRangeByScore(key_, spec, &ret);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(6, ret);
+
+  spec = ZRangeSpec();
+  s = zset->RangeByScore(key_, spec, &mscores, nullptr);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(1, mscores.size());
+  EXPECT_EQ(fields_[6].ToString(), mscores[0].member);
+  double score = 0;
+  s = zset->Score(key_, fields_[3], &score);
+  EXPECT_TRUE(s.IsNotFound());
+  int card = 0;
+  zset->Card(key_, &card);
+  EXPECT_EQ(1, card);
+  zset->Del(key_);
+  config_->range_delete_min_elements = 1000;
+}
+
 TEST_F(RedisZSetTest, RemoveRangeByRank) {
   int ret;
   std::vector<MemberScore> mscores;
@@ -364,3 +400,293 @@ TEST_F(RedisZSetTest, Rank) {
   }
   zset->Del(key_);
 }
+
+TEST_F(RedisZSetTest, RankIndex) {
+  config_->zset_rank_index_min_size = 1;
+  std::vector<std::string> expected;
+  for (int i = 0; i < 5000; i++) {
+    expected.emplace_back(fmt::format("member-{:05d}", i));
+  }
+  auto check = [this](const std::vector<std::string> &expected) {
+    int size = static_cast<int>(expected.size());
+    for (int i = 0; i < size; i += 97) {
+      int rank = -1;
+      zset->Rank(key_, expected[i], false, &rank);
+      EXPECT_EQ(i, rank);
+      zset->Rank(key_, expected[i], true, &rank);
+      EXPECT_EQ(size - 1 - i, rank);
+    }
+    for (int start : {0, 1, 1023, 2048, size - 2}) {
+      std::vector<MemberScore> mscores;
+      zset->Range(key_, start, start + 2, 0, &mscores);
+      ASSERT_EQ(std::min(3, size - start), static_cast<int>(mscores.size()));
+      for (size_t i = 0; i < mscores.size(); i++) {
+        EXPECT_EQ(expected[start + i], mscores[i].member);
+      }
+      zset->Range(key_, start, start + 2, kZSetReversed, &mscores);
+      ASSERT_EQ(std::min(3, size - start), static_cast<int>(mscores.size()));
+      for (size_t i = 0; i < mscores.size(); i++) {
+        EXPECT_EQ(expected[size - 1 - start - i], mscores[i].member);
+      }
+    }
+  };
+
+  // Add the members in the interleaved batches to split the blocks
+  int ret = 0;
+  for (int batch = 0; batch < 10; batch++) {
+    std::vector<MemberScore> mscores;
+    for (int i = batch; i < 5000; i += 10) {
+      mscores.emplace_back(MemberScore{expected[i], static_cast<double>(i)});
+    }
+    zset->Add(key_, ZAddFlags::Default(), &mscores, &ret);
+    EXPECT_EQ(500, ret);
+  }
+  check(expected);
+
+  zset->RemoveRangeByRank(key_, 1000, 2999, &ret);
+  EXPECT_EQ(2000, ret);
+  expected.erase(expected.begin() + 1000, expected.begin() + 3000);
+  check(expected);
+
+  std::vector<Slice> members;
+  std::vector<std::string> remaining;
+  for (size_t i = 0; i < expected.size(); i++) {
+    if (i % 5 == 0) {
+      members.emplace_back(expected[i]);
+    } else {
+      remaining.emplace_back(expected[i]);
+    }
+  }
+  zset->Remove(key_, members, &ret);
+  EXPECT_EQ(static_cast<int>(members.size()), ret);
+  expected = remaining;
+  check(expected);
+
+  // Move the first members to the tail
+  for (int i = 0; i < 5; i++) {
+    double score = 0;
+    zset->IncrBy(key_, expected[i], 100000, &score);
+  }
+  std::rotate(expected.begin(), expected.begin() + 5, expected.end());
+  check(expected);
+
+  std::vector<MemberScore> popped;
+  zset->Pop(key_, 10, true, &popped);
+  EXPECT_EQ(10, popped.size());
+  expected.erase(expected.begin(), expected.begin() + 10);
+  check(expected);
+
+  // The index is dropped on the next write after it's disabled
+  config_->zset_rank_index_min_size = 0;
+  zset->Remove(key_, {expected.back()}, &ret);
+  EXPECT_EQ(1, ret);
+  expected.pop_back();
+  check(expected);
+  zset->Del(key_);
+}
+
+TEST_F(RedisZSetTest, InlineEncoding) {
+  config_->zset_inline_max_entries = 8;
+  zset->Del(key_);
+
+  int ret = 0;
+  std::vector<MemberScore> mscores;
+  for (size_t i = 0; i < fields_.size(); i++) {
+    mscores.emplace_back(MemberScore{fields_[i].ToString(), scores_[i]});
+  }
+  auto s = zset->Add(key_, ZAddFlags::Default(), &mscores, &ret);
+  EXPECT_TRUE(s.ok() && static_cast<int>(fields_.size()) == ret);
+  std::string ns_key, bytes;
+  zset->AppendNamespacePrefix(key_, &ns_key);
+  s = zset->GetRawMetadata(ns_key, &bytes);
+  EXPECT_TRUE(s.ok());
+  ZSetMetadata metadata(false);
+  metadata.Decode(bytes);
+  EXPECT_TRUE(metadata.inlined);
+  EXPECT_EQ(fields_.size(), metadata.members.size());
+
+  double score = 0;
+  s = zset->Score(key_, fields_[2], &score);
+  EXPECT_TRUE(s.ok() && score == scores_[2]);
+  s = zset->Rank(key_, fields_[4], false, &ret);
+  EXPECT_TRUE(s.ok() && ret == 4);
+  s = zset->Rank(key_, fields_[4], true, &ret);
+  EXPECT_TRUE(s.ok() && ret == 2);
+
+  std::vector<MemberScore> result;
+  s = zset->Range(key_, 1, -2, 0, &result);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(fields_.size() - 2, result.size());
+  for (size_t i = 0; i < result.size(); i++) {
+    EXPECT_EQ(fields_[i + 1], result[i].member);
+    EXPECT_EQ(scores_[i + 1], result[i].score);
+  }
+  ZRangeSpec spec;
+  spec.min = -2;
+  spec.max = 2;
+  result.clear();
+  s = zset->RangeByScore(key_, spec, &result, nullptr);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(4, result.size());
+
+  // Update the score and reorder the members
+  mscores = {{fields_[0].ToString(), 200}};
+  s = zset->Add(key_, ZAddFlags::Default(), &mscores, &ret);
+  EXPECT_TRUE(s.ok() && ret == 0);
+  result.clear();
+  s = zset->Pop(key_, 1, false, &result);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(1, result.size());
+  EXPECT_EQ(fields_[0], result[0].member);
+  s = zset->RemoveRangeByRank(key_, 0, 1, &ret);
+  EXPECT_TRUE(s.ok() && ret == 2);
+  s = zset->Card(key_, &ret);
+  EXPECT_TRUE(s.ok() && ret == static_cast<int>(fields_.size()) - 3);
+
+  // Growing beyond the limit converts the sorted set to the subkeys
+  mscores.clear();
+  for (int i = 0; i < 10; i++) {
+    mscores.emplace_back(MemberScore{fmt::format("extra-{}", i), static_cast<double>(i)});
+  }
+  s = zset->Add(key_, ZAddFlags::Default(), &mscores, &ret);
+  EXPECT_TRUE(s.ok() && ret == 10);
+  bytes.clear();
+  s = zset->GetRawMetadata(ns_key, &bytes);
+  EXPECT_TRUE(s.ok());
+  metadata.Decode(bytes);
+  EXPECT_FALSE(metadata.inlined);
+  result.clear();
+  s = zset->Range(key_, 0, -1, 0, &result);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(fields_.size() + 7, result.size());
+  for (size_t i = 1; i < result.size(); i++) {
+    EXPECT_LE(result[i - 1].score, result[i].score);
+  }
+  s = zset->Rank(key_, "extra-9", false, &ret);
+  EXPECT_TRUE(s.ok() && ret == static_cast<int>(result.size()) - 2);
+
+  zset->Del(key_);
+  config_->zset_inline_max_entries = 0;
+}
+
+TEST_F(RedisZSetTest, UnionAndInterStore) {
+  config_->zset_inline_max_entries = 8;
+  config_->zset_rank_index_min_size = 1;
+  // The large sets are stored in several batches, and the small one is inlined
+  std::string key1 = "zset_merge_key1", key2 = "zset_merge_key2", key3 = "zset_merge_key3";
+  std::string dst = "zset_merge_dst";
+  int ret = 0;
+  std::vector<MemberScore> mscores1, mscores2;
+  for (int i = 0; i < 3000; i++) {
+    mscores1.emplace_back(MemberScore{fmt::format("member-{:05d}", i), static_cast<double>(i)});
+    if (i % 2 == 0) mscores2.emplace_back(MemberScore{fmt::format("member-{:05d}", i), 1});
+  }
+  std::vector<MemberScore> mscores3 = {{"member-00000", 5}, {"member-00001", 5}, {"member-00002", 5}, {"other", 5}};
+  zset->Add(key1, ZAddFlags::Default(), &mscores1, &ret);
+  zset->Add(key2, ZAddFlags::Default(), &mscores2, &ret);
+  zset->Add(key3, ZAddFlags::Default(), &mscores3, &ret);
+
+  auto s = zset->UnionStore(dst, {{key1, 1}, {key2, 2}, {"zset_merge_none", 1}}, kAggregateSum, &ret);
+  EXPECT_TRUE(s.ok() && ret == 3000);
+  for (int i : {0, 1, 1500, 2999}) {
+    int rank = -1;
+    double score = 0;
+    std::string member = fmt::format("member-{:05d}", i);
+    zset->Score(dst, member, &score);
+    EXPECT_EQ(i + (i % 2 == 0 ? 2 : 0), score);
+    zset->Rank(dst, member, false, &rank);
+    EXPECT_EQ(i, rank);
+  }
+  std::vector<MemberScore> result;
+  s = zset->Union({{key1, 1}, {key3, 1}}, kAggregateMax, &result);
+  EXPECT_TRUE(s.ok());
+  // The result is ordered by the scores and then the members
+  ASSERT_EQ(3001, result.size());
+  EXPECT_EQ("member-00003", result[0].member);
+  EXPECT_EQ("member-00000", result[2].member);
+  EXPECT_EQ(5, result[2].score);
+  EXPECT_EQ("other", result[6].member);
+  EXPECT_EQ("member-02999", result.back().member);
+
+  s = zset->InterStore(dst, {{key1, 1}, {key2, 1}, {key3, 1}}, kAggregateMin, &ret);
+  EXPECT_TRUE(s.ok() && ret == 2);
+  s = zset->Range(dst, 0, -1, 0, &result);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(2, result.size());
+  EXPECT_EQ("member-00000", result[0].member);
+  EXPECT_EQ(0, result[0].score);
+  EXPECT_EQ("member-00002", result[1].member);
+  EXPECT_EQ(1, result[1].score);
+  s = zset->Inter({{key1, 1}, {key2, 1}}, kAggregateSum, &result);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(1500, result.size());
+  EXPECT_EQ("member-02998", result.back().member);
+  EXPECT_EQ(2999, result.back().score);
+
+  uint64_t card = 0;
+  s = zset->InterCard({key1, key2}, 0, &card);
+  EXPECT_TRUE(s.ok() && card == 1500);
+  s = zset->InterCard({key1, key2}, 100, &card);
+  EXPECT_TRUE(s.ok() && card == 100);
+  s = zset->InterCard({key1, "zset_merge_none"}, 0, &card);
+  EXPECT_TRUE(s.ok() && card == 0);
+
+  // The empty intersection leaves the destination untouched
+  s = zset->InterStore(dst, {{key1, 1}, {"zset_merge_none", 1}}, kAggregateSum, &ret);
+  EXPECT_TRUE(s.ok() && ret == 0);
+  s = zset->Card(dst, &ret);
+  EXPECT_TRUE(s.ok() && ret == 2);
+  for (const auto &key : {key1, key2, key3, dst}) {
+    zset->Del(key);
+  }
+  config_->zset_inline_max_entries = 0;
+  config_->zset_rank_index_min_size = 0;
+}
+
+TEST_F(RedisZSetTest, AddExistingMembers) {
+  int ret = 0;
+  std::vector<MemberScore> mscores = {{"m1", 1}, {"m2", 2}};
+  zset->Add(key_, ZAddFlags::Default(), &mscores, &ret);
+  EXPECT_EQ(2, ret);
+  // The old scores in the subkeys are read in one batch, and the last score of the member wins
+  mscores = {{"m2", 3}, {"m3", 1}, {"m3", 4}, {"m1", 1}};
+  zset->Add(key_, ZAddFlags(kZSetCH), &mscores, &ret);
+  EXPECT_EQ(2, ret);
+  double score = 0;
+  zset->Score(key_, "m2", &score);
+  EXPECT_EQ(3, score);
+  zset->Score(key_, "m3", &score);
+  EXPECT_EQ(4, score);
+  zset->Card(key_, &ret);
+  EXPECT_EQ(3, ret);
+  zset->Del(key_);
+}
+
+TEST_F(RedisZSetTest, RandMember) {
+  std::vector<MemberScore> mscores;
+  for (int i = 0; i < 500; i++) {
+    mscores.emplace_back(MemberScore{"member-" + std::to_string(i), static_cast<double>(i)});
+  }
+  int ret = 0;
+  zset->Add(key_, ZAddFlags::Default(), &mscores, &ret);
+  EXPECT_EQ(500, ret);
+
+  std::vector<MemberScore> samples;
+  auto s = zset->RandMember(key_, 20, &samples);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(20, samples.size());
+  std::set<std::string> members;
+  for (const auto &ms : samples) {
+    members.emplace(ms.member);
+    EXPECT_EQ(std::stod(ms.member.substr(7)), ms.score);
+  }
+  EXPECT_EQ(20, members.size());
+
+  s = zset->RandMember(key_, -1000, &samples);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(1000, samples.size());
+  s = zset->RandMember(key_, 1000, &samples);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(500, samples.size());
+  zset->Del(key_);
+}
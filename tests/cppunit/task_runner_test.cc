@@ -23,6 +23,7 @@
 #include <gtest/gtest.h>
 
 #include <atomic>
+#include <vector>
 
 TEST(TaskRunner, PublishOverflow) {
   TaskRunner tr(2, 3);
@@ -67,3 +68,57 @@ TEST(TaskRunner, Run) {
   tr.Stop();
   tr.Join();
 }
+
+TEST(TaskRunner, Priority) {
+  std::vector<int> order;
+  TaskRunner tr(1, 1024);
+  ASSERT_TRUE(tr.Publish([&order] { order.emplace_back(2); }, TaskPriority::kBackground).IsOK());
+  ASSERT_TRUE(tr.Publish([&order] { order.emplace_back(1); }, TaskPriority::kNormal).IsOK());
+  ASSERT_TRUE(tr.Publish([&order] { order.emplace_back(0); }, TaskPriority::kUrgent).IsOK());
+  ASSERT_EQ(tr.QueueSize(), 3U);
+  tr.Start();
+  sleep(1);
+  ASSERT_EQ(order, std::vector<int>({0, 1, 2}));
+  tr.Stop();
+  tr.Join();
+}
+
+TEST(TaskRunner, Cancel) {
+  std::atomic<int> counter = {0};
+  TaskRunner tr(1, 1024);
+  TaskHandle handle1, handle2;
+  ASSERT_TRUE(tr.Publish([&counter] { counter.fetch_add(1); }, TaskPriority::kNormal, "cancel", &handle1).IsOK());
+  ASSERT_TRUE(tr.Publish([&counter] { counter.fetch_add(10); }, TaskPriority::kNormal, "cancel", &handle2).IsOK());
+  ASSERT_TRUE(handle1.Cancel());
+  ASSERT_TRUE(handle1.IsCancelled());
+  tr.Start();
+  sleep(1);
+  ASSERT_EQ(10, counter);
+  // The task which has run can't be cancelled
+  ASSERT_FALSE(handle2.Cancel());
+  auto stats = tr.GetStats();
+  ASSERT_EQ(stats["cancel"].calls, 1U);
+  ASSERT_EQ(stats["cancel"].cancelled, 1U);
+  tr.Stop();
+  tr.Join();
+}
+
+TEST(TaskRunner, StealTasks) {
+  std::atomic<bool> blocked = {true};
+  std::atomic<int> counter = {0};
+  TaskRunner tr(2, 1024);
+  tr.Start();
+  ASSERT_TRUE(tr.Publish([&blocked] {
+                  while (blocked) usleep(1000);
+                }).IsOK());
+  // Half of the tasks are queued to the blocked thread, they're stolen by the other one
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(tr.Publish([&counter] { counter.fetch_add(1); }, TaskPriority::kNormal, "steal").IsOK());
+  }
+  sleep(1);
+  ASSERT_EQ(100, counter);
+  ASSERT_EQ(tr.GetStats()["steal"].calls, 100U);
+  blocked = false;
+  tr.Stop();
+  tr.Join();
+}
@@ -0,0 +1,45 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "thread_util.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+TEST(ThreadUtil, ParseCPUList) {
+  std::map<std::string, std::vector<int>> cases{
+      {"", {}},
+      {"3", {3}},
+      {"0-3", {0, 1, 2, 3}},
+      {"0-1,4,6-7", {0, 1, 4, 6, 7}},
+  };
+  for (const auto &iter : cases) {
+    auto cpus = Util::ParseCPUList(iter.first);
+    ASSERT_TRUE(cpus) << iter.first;
+    ASSERT_EQ(*cpus, iter.second);
+  }
+
+  for (const auto &input : {"a", "1-a", "3-1", "1-2-3", "100000"}) {
+    ASSERT_FALSE(Util::ParseCPUList(input)) << input;
+  }
+}
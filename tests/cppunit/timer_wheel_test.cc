@@ -0,0 +1,84 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "timer_wheel.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+TEST(TimerWheel, FireInOrder) {
+  TimerWheel<int> wheel(1000);
+  std::vector<uint64_t> delays = {0, 1, 63, 64, 65, 4095, 4096, 4097, 300000};
+  for (size_t i = 0; i < delays.size(); i++) {
+    wheel.Add(static_cast<int>(i), 1000 + delays[i]);
+  }
+  ASSERT_EQ(wheel.Size(), delays.size());
+
+  std::vector<int> fired;
+  for (uint64_t now = 1000; now <= 1000 + delays.back(); now++) {
+    wheel.Advance(now, [&](int &&i) {
+      ASSERT_EQ(1000 + delays[i], now);
+      fired.emplace_back(i);
+    });
+  }
+  ASSERT_EQ(fired.size(), delays.size());
+  ASSERT_EQ(wheel.Size(), 0U);
+}
+
+TEST(TimerWheel, AdvanceManyTicks) {
+  TimerWheel<int> wheel(0);
+  wheel.Add(1, 10);
+  wheel.Add(2, 100);
+  wheel.Add(3, 10000);
+  std::vector<int> fired;
+  wheel.Advance(5000, [&](int &&i) { fired.emplace_back(i); });
+  ASSERT_EQ(fired, std::vector<int>({1, 2}));
+  // The deadline in the past fires on the next advance
+  wheel.Add(4, 1);
+  wheel.Advance(5000, [&](int &&i) { fired.emplace_back(i); });
+  ASSERT_EQ(fired, std::vector<int>({1, 2, 4}));
+  wheel.Advance(10000, [&](int &&i) { fired.emplace_back(i); });
+  ASSERT_EQ(fired, std::vector<int>({1, 2, 4, 3}));
+}
+
+TEST(TimerWheel, ClampTheMaxDelay) {
+  TimerWheel<int> wheel(0);
+  wheel.Add(1, TimerWheel<int>::kMaxDelay * 2);
+  int fired = 0;
+  wheel.Advance(TimerWheel<int>::kMaxDelay - 1, [&](int &&) { fired++; });
+  ASSERT_EQ(fired, 0);
+  wheel.Advance(TimerWheel<int>::kMaxDelay, [&](int &&) { fired++; });
+  ASSERT_EQ(fired, 1);
+}
+
+TEST(TimerWheel, ReAddInCallback) {
+  TimerWheel<int> wheel(0);
+  wheel.Add(1, 1);
+  int fired = 0;
+  for (uint64_t now = 1; now <= 10; now++) {
+    wheel.Advance(now, [&](int &&i) {
+      fired++;
+      wheel.Add(i, now + 1);
+    });
+  }
+  ASSERT_EQ(fired, 10);
+  ASSERT_EQ(wheel.Size(), 1U);
+}
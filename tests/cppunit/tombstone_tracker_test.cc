@@ -0,0 +1,111 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "storage/tombstone_tracker.h"
+
+#include <gtest/gtest.h>
+
+#include "config.h"
+#include "storage/storage.h"
+#include "types/redis_hash.h"
+
+TEST(TombstoneTracker, MergeOverlappedRanges) {
+  TombstoneTracker tracker;
+  tracker.Record(0, "a", "c", 100, 10);
+  tracker.Record(0, "b", "d", 100, 10);
+  tracker.Record(0, "x", "z", 50, 0);
+  tracker.Record(1, "a", "c", 10, 0);
+  EXPECT_EQ(3, tracker.Size());
+
+  auto ranges = tracker.PickRanges(150, 10);
+  ASSERT_EQ(1, ranges.size());
+  EXPECT_EQ(0, ranges[0].cf_id);
+  EXPECT_EQ("a", ranges[0].begin);
+  EXPECT_EQ("d", ranges[0].end);
+  EXPECT_EQ(200, ranges[0].skipped);
+  EXPECT_EQ(20, ranges[0].visited);
+  EXPECT_EQ(2, tracker.Size());
+  EXPECT_EQ(1, tracker.GetPickedRanges());
+
+  // The new range is merged into the overlapped one
+  tracker.Record(0, "c", "y", 10, 0);
+  EXPECT_EQ(2, tracker.Size());
+  ranges = tracker.PickRanges(60, 10);
+  ASSERT_EQ(1, ranges.size());
+  EXPECT_EQ("c", ranges[0].begin);
+  EXPECT_EQ("z", ranges[0].end);
+}
+
+TEST(TombstoneTracker, PickDensestRanges) {
+  TombstoneTracker tracker(2);
+  tracker.Record(0, "a", "b", 100, 100);
+  tracker.Record(0, "c", "d", 100, 0);
+  // The range with the fewest skipped tombstones is evicted
+  tracker.Record(0, "e", "f", 200, 0);
+  EXPECT_EQ(2, tracker.Size());
+  tracker.Record(0, "g", "h", 1, 0);
+  EXPECT_EQ(2, tracker.Size());
+
+  auto ranges = tracker.PickRanges(100, 1);
+  ASSERT_EQ(1, ranges.size());
+  EXPECT_EQ("e", ranges[0].begin);
+  ranges = tracker.PickRanges(100, 1);
+  ASSERT_EQ(1, ranges.size());
+  EXPECT_EQ("c", ranges[0].begin);
+  EXPECT_TRUE(tracker.PickRanges(0, 1).empty());
+}
+
+TEST(TombstoneTracker, TrackIterators) {
+  Config config;
+  config.db_dir = "tombstonetrackerdb";
+  config.backup_dir = "tombstonetrackerdb/backup";
+  config.compaction_checker_tombstone_threshold = 100;
+
+  auto storage = std::make_unique<Engine::Storage>(&config);
+  Status s = storage->Open();
+  ASSERT_TRUE(s.IsOK());
+  auto tracker = storage->GetTombstoneTracker();
+
+  auto hash = std::make_unique<Redis::Hash>(storage.get(), "test_tombstone");
+  int ret = 0;
+  std::vector<std::string> fields;
+  for (int i = 0; i < 1000; i++) {
+    fields.emplace_back("field" + std::to_string(1000 + i));
+    hash->Set("hash", fields.back(), "value", &ret);
+  }
+  // The live field is after the deleted ones, so the iterator skips all their tombstones
+  hash->Set("hash", "zzz", "value", &ret);
+  std::vector<Slice> deleted_fields(fields.begin(), fields.end());
+  hash->Delete("hash", deleted_fields, &ret);
+  EXPECT_EQ(1000, ret);
+
+  std::vector<FieldValue> field_values;
+  EXPECT_TRUE(hash->GetAll("hash", &field_values).ok());
+  EXPECT_EQ(1, field_values.size());
+  EXPECT_EQ(1, tracker->Size());
+
+  auto ranges = tracker->PickRanges(config.compaction_checker_tombstone_threshold, 1);
+  ASSERT_EQ(1, ranges.size());
+  EXPECT_EQ(storage->GetCFHandle(Engine::kSubkeyColumnFamilyName)->GetID(), ranges[0].cf_id);
+  EXPECT_GE(ranges[0].skipped, 1000);
+  EXPECT_LT(ranges[0].begin, ranges[0].end);
+
+  hash->Del("hash");
+}
@@ -0,0 +1,142 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+#include "storage/workload_tuner.h"
+
+#include <gtest/gtest.h>
+
+using Engine::WorkloadTuner;
+
+static WorkloadTuner::Bounds testBounds() {
+  WorkloadTuner::Bounds bounds;
+  bounds.min_cache_ratio = 20;
+  bounds.min_background_compactions = 2;
+  bounds.max_background_compactions = 4;
+  bounds.min_write_buffer_size = 64;
+  bounds.max_write_buffer_size = 256;
+  return bounds;
+}
+
+static WorkloadTuner::Settings testSettings() {
+  WorkloadTuner::Settings settings;
+  settings.metadata_cache_capacity = 1000;
+  settings.subkey_cache_capacity = 1000;
+  settings.max_background_compactions = 2;
+  settings.write_buffer_size = 64;
+  return settings;
+}
+
+TEST(WorkloadTuner, Unchanged) {
+  WorkloadTuner::Signals signals;
+  signals.l0_files = 6;
+  signals.l0_slowdown_trigger = 20;
+  std::vector<std::string> reasons;
+  auto next = WorkloadTuner::Decide(signals, testBounds(), testSettings(), &reasons);
+  ASSERT_TRUE(reasons.empty());
+  ASSERT_EQ(1000, next.metadata_cache_capacity);
+  ASSERT_EQ(2, next.max_background_compactions);
+  ASSERT_EQ(64, next.write_buffer_size);
+}
+
+TEST(WorkloadTuner, RebalanceBlockCaches) {
+  WorkloadTuner::Signals signals;
+  signals.metadata_cache_hits = 100;
+  signals.metadata_cache_misses = 200;
+  signals.subkey_cache_hits = 100;
+  signals.subkey_cache_misses = 10;
+  auto current = testSettings();
+  for (int i = 0; i < 20; i++) {
+    std::vector<std::string> reasons;
+    current = WorkloadTuner::Decide(signals, testBounds(), current, &reasons);
+  }
+  // The subkey block cache keeps the minimal ratio of the total
+  ASSERT_EQ(1600, current.metadata_cache_capacity);
+  ASSERT_EQ(400, current.subkey_cache_capacity);
+
+  // Too few lookups were sampled, or the block cache is shared
+  signals.metadata_cache_hits = signals.subkey_cache_hits = 0;
+  signals.metadata_cache_misses = 10;
+  signals.subkey_cache_misses = 100;
+  std::vector<std::string> reasons;
+  auto next = WorkloadTuner::Decide(signals, testBounds(), testSettings(), &reasons);
+  ASSERT_EQ(1000, next.metadata_cache_capacity);
+  signals.subkey_cache_hits = 1000;
+  next = WorkloadTuner::Decide(signals, testBounds(), testSettings(), &reasons);
+  ASSERT_EQ(900, next.metadata_cache_capacity);
+  ASSERT_EQ(1100, next.subkey_cache_capacity);
+  auto shared = testSettings();
+  shared.metadata_cache_capacity = shared.subkey_cache_capacity = 0;
+  next = WorkloadTuner::Decide(signals, testBounds(), shared, &reasons);
+  ASSERT_EQ(0, next.metadata_cache_capacity);
+  ASSERT_EQ(0, next.subkey_cache_capacity);
+}
+
+TEST(WorkloadTuner, CompactionDebt) {
+  WorkloadTuner::Signals signals;
+  signals.stall_micros = 1000;
+  signals.l0_slowdown_trigger = 20;
+  auto current = testSettings();
+  for (int i = 0; i < 4; i++) {
+    std::vector<std::string> reasons;
+    current = WorkloadTuner::Decide(signals, testBounds(), current, &reasons);
+  }
+  ASSERT_EQ(4, current.max_background_compactions);
+
+  // Still behind without the stalls
+  signals.stall_micros = 0;
+  signals.pending_compaction_limit = 1024;
+  signals.pending_compaction_bytes = 512;
+  std::vector<std::string> reasons;
+  current = WorkloadTuner::Decide(signals, testBounds(), current, &reasons);
+  ASSERT_EQ(4, current.max_background_compactions);
+  ASSERT_TRUE(reasons.empty());
+
+  signals.pending_compaction_bytes = 0;
+  for (int i = 0; i < 4; i++) {
+    current = WorkloadTuner::Decide(signals, testBounds(), current, &reasons);
+  }
+  ASSERT_EQ(2, current.max_background_compactions);
+}
+
+TEST(WorkloadTuner, WriteBufferSize) {
+  WorkloadTuner::Signals signals;
+  signals.l0_files = 6;
+  signals.l0_slowdown_trigger = 20;
+  signals.keys_read = 1000;
+  signals.keys_written = 3000;
+  auto current = testSettings();
+  std::vector<std::string> reasons;
+  for (int i = 0; i < 4; i++) {
+    current = WorkloadTuner::Decide(signals, testBounds(), current, &reasons);
+  }
+  ASSERT_EQ(256, current.write_buffer_size);
+
+  // The mixed workload keeps the size
+  signals.keys_written = 500;
+  current = WorkloadTuner::Decide(signals, testBounds(), current, &reasons);
+  ASSERT_EQ(256, current.write_buffer_size);
+
+  signals.keys_written = 10;
+  current = WorkloadTuner::Decide(signals, testBounds(), current, &reasons);
+  ASSERT_EQ(128, current.write_buffer_size);
+  for (int i = 0; i < 4; i++) {
+    current = WorkloadTuner::Decide(signals, testBounds(), current, &reasons);
+  }
+  ASSERT_EQ(64, current.write_buffer_size);
+}
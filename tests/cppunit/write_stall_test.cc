@@ -0,0 +1,68 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "test_base.h"
+
+using rocksdb::WriteStallCondition;
+
+class WriteStallTest : public TestBase {
+ protected:
+  explicit WriteStallTest() : TestBase() {}
+  ~WriteStallTest() override = default;
+};
+
+TEST_F(WriteStallTest, StallConditions) {
+  EXPECT_FALSE(storage_->IsWriteStopped());
+  EXPECT_TRUE(storage_->WaitForWriteStallEnd(0));
+
+  storage_->UpdateWriteStallCondition(WriteStallCondition::kNormal, WriteStallCondition::kDelayed);
+  EXPECT_TRUE(storage_->IsWriteDelayed());
+  EXPECT_FALSE(storage_->IsWriteStopped());
+  storage_->UpdateWriteStallCondition(WriteStallCondition::kDelayed, WriteStallCondition::kStopped);
+  EXPECT_FALSE(storage_->IsWriteDelayed());
+  EXPECT_TRUE(storage_->IsWriteStopped());
+  // The writes are stopped until all column families recover
+  storage_->UpdateWriteStallCondition(WriteStallCondition::kNormal, WriteStallCondition::kStopped);
+  storage_->UpdateWriteStallCondition(WriteStallCondition::kStopped, WriteStallCondition::kNormal);
+  EXPECT_TRUE(storage_->IsWriteStopped());
+  EXPECT_FALSE(storage_->WaitForWriteStallEnd(0));
+  EXPECT_FALSE(storage_->WaitForWriteStallEnd(10));
+
+  storage_->UpdateWriteStallCondition(WriteStallCondition::kStopped, WriteStallCondition::kNormal);
+  EXPECT_FALSE(storage_->IsWriteStopped());
+  EXPECT_TRUE(storage_->WaitForWriteStallEnd(0));
+}
+
+TEST_F(WriteStallTest, WaitForStallEnd) {
+  storage_->UpdateWriteStallCondition(WriteStallCondition::kNormal, WriteStallCondition::kStopped);
+  std::thread t([this] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    storage_->UpdateWriteStallCondition(WriteStallCondition::kStopped, WriteStallCondition::kNormal);
+  });
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(storage_->WaitForWriteStallEnd(10000));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  t.join();
+}
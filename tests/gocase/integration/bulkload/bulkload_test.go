@@ -0,0 +1,103 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package bulkload
+
+import (
+	"context"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"testing"
+	"time"
+
+	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/stretchr/testify/require"
+)
+
+func TestBulkLoad(t *testing.T) {
+	tool := util.ToolPath("kvrocks-bulkload")
+	if _, err := os.Stat(tool); err != nil {
+		t.Skip("kvrocks-bulkload isn't built")
+	}
+
+	master := util.StartServer(t, map[string]string{})
+	defer master.Close()
+	masterClient := master.NewClient()
+	defer func() { require.NoError(t, masterClient.Close()) }()
+
+	replica := util.StartServer(t, map[string]string{})
+	defer replica.Close()
+	replicaClient := replica.NewClient()
+	defer func() { require.NoError(t, replicaClient.Close()) }()
+
+	ctx := context.Background()
+	require.NoError(t, masterClient.Set(ctx, "existing", "value", 0).Err())
+	util.SlaveOf(t, replicaClient, master)
+	util.WaitForSync(t, replicaClient)
+
+	dir := t.TempDir()
+	sstDir := filepath.Join(dir, "sst")
+
+	t.Run("Build the SST files by kvrocks-bulkload", func(t *testing.T) {
+		input := "SET str hello\nSET ttl world EX 1000\nHSET hash f1 v1 f2 v2\nSADD set a b c\n" +
+			"ZADD zset 1 a 2 b\nRPUSH list a b c\n" +
+			"*3\r\n$3\r\nSET\r\n$6\r\nbinary\r\n$6\r\na\r\nb c\r\n"
+		inputPath := filepath.Join(dir, "input.txt")
+		require.NoError(t, os.WriteFile(inputPath, []byte(input), 0644))
+		output, err := exec.Command(tool, "-i", inputPath, "-o", sstDir).CombinedOutput()
+		require.NoError(t, err, string(output))
+	})
+
+	t.Run("BULKLOAD INGEST loads the SST files", func(t *testing.T) {
+		n, err := masterClient.Do(ctx, "BULKLOAD", "INGEST", sstDir).Int()
+		require.NoError(t, err)
+		require.Greater(t, n, 0)
+
+		require.Equal(t, "hello", masterClient.Get(ctx, "str").Val())
+		require.Greater(t, masterClient.TTL(ctx, "ttl").Val(), 900*time.Second)
+		require.Equal(t, map[string]string{"f1": "v1", "f2": "v2"}, masterClient.HGetAll(ctx, "hash").Val())
+		require.ElementsMatch(t, []string{"a", "b", "c"}, masterClient.SMembers(ctx, "set").Val())
+		require.Equal(t, []string{"a", "b"}, masterClient.ZRange(ctx, "zset", 0, -1).Val())
+		require.Equal(t, []string{"a", "b", "c"}, masterClient.LRange(ctx, "list", 0, -1).Val())
+		require.Equal(t, "a\r\nb c", masterClient.Get(ctx, "binary").Val())
+		require.Equal(t, "value", masterClient.Get(ctx, "existing").Val())
+	})
+
+	t.Run("The replica resynchronizes fully to get the bulk loaded data", func(t *testing.T) {
+		require.Eventually(t, func() bool {
+			return replicaClient.Get(ctx, "str").Val() == "hello"
+		}, 30*time.Second, 100*time.Millisecond)
+		require.Equal(t, []string{"a", "b", "c"}, replicaClient.LRange(ctx, "list", 0, -1).Val())
+		require.Equal(t, "value", replicaClient.Get(ctx, "existing").Val())
+
+		require.NoError(t, masterClient.Set(ctx, "after", "bulkload", 0).Err())
+		util.WaitForOffsetSync(t, masterClient, replicaClient)
+		require.Equal(t, "bulkload", replicaClient.Get(ctx, "after").Val())
+	})
+
+	t.Run("BULKLOAD INGEST refuses the invalid files", func(t *testing.T) {
+		invalidDir := filepath.Join(dir, "invalid")
+		require.NoError(t, os.MkdirAll(invalidDir, 0755))
+		require.ErrorContains(t, masterClient.Do(ctx, "BULKLOAD", "INGEST", invalidDir).Err(), "No SST file")
+		require.NoError(t, os.WriteFile(filepath.Join(invalidDir, "bad.sst"), []byte("bad"), 0644))
+		require.Error(t, masterClient.Do(ctx, "BULKLOAD", "INGEST", invalidDir).Err())
+		require.ErrorContains(t, replicaClient.Do(ctx, "BULKLOAD", "INGEST", sstDir).Err(), "READONLY")
+	})
+}
@@ -57,6 +57,75 @@ func TestClusterKeySlot(t *testing.T) {
 	}
 }
 
+func TestClusterSlotStats(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"cluster-enabled": "yes"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	nodeID := "07c37dfeb235213a872192d90877d0cd55635b91"
+	require.NoError(t, rdb.Do(ctx, "clusterx", "SETNODEID", nodeID).Err())
+	clusterNodes := fmt.Sprintf("%s %s %d master - 0-16383", nodeID, srv.Host(), srv.Port())
+	require.NoError(t, rdb.Do(ctx, "clusterx", "SETNODES", clusterNodes, "1").Err())
+
+	t.Run("key count of slots", func(t *testing.T) {
+		require.NoError(t, rdb.Set(ctx, util.SlotTable[1], "a", 0).Err())
+		require.NoError(t, rdb.Set(ctx, util.SlotTable[2], "b", 0).Err())
+		require.NoError(t, rdb.HSet(ctx, util.SlotTable[2]+"{"+util.SlotTable[2]+"}", "f", "v").Err())
+
+		r, err := rdb.Do(ctx, "cluster", "slot-stats", "slotsrange", "0", "3").Slice()
+		require.NoError(t, err)
+		require.Len(t, r, 4)
+		for i, expected := range []int64{0, 1, 2, 0} {
+			stats := r[i].([]interface{})
+			require.EqualValues(t, i, stats[0])
+			fields := stats[1].([]interface{})
+			require.Equal(t, "key-count", fields[0])
+			require.EqualValues(t, expected, fields[1])
+			require.Equal(t, "approximate-size", fields[2])
+		}
+	})
+
+	t.Run("traffic of slots", func(t *testing.T) {
+		for i := 0; i < 10; i++ {
+			require.NoError(t, rdb.Get(ctx, util.SlotTable[3]).Err())
+		}
+		value := strings.Repeat("v", 100)
+		require.NoError(t, rdb.Set(ctx, util.SlotTable[4], value, 0).Err())
+
+		r, err := rdb.Do(ctx, "cluster", "slot-stats", "slotsrange", "3", "4").Slice()
+		require.NoError(t, err)
+		require.Len(t, r, 2)
+		fields := r[0].([]interface{})[1].([]interface{})
+		require.Equal(t, []interface{}{"calls", int64(10), "read-bytes", int64(50), "write-bytes", int64(0)}, fields[4:])
+		fields = r[1].([]interface{})[1].([]interface{})
+		require.EqualValues(t, 1, fields[5])
+		require.EqualValues(t, len("set")+len(util.SlotTable[4])+len(value), fields[9])
+
+		// The hottest slots come first
+		r, err = rdb.Do(ctx, "cluster", "slot-stats", "orderby", "calls", "limit", "2").Slice()
+		require.NoError(t, err)
+		require.Len(t, r, 2)
+		require.EqualValues(t, 3, r[0].([]interface{})[0])
+		r, err = rdb.Do(ctx, "cluster", "slot-stats", "orderby", "write-bytes", "limit", "1").Slice()
+		require.NoError(t, err)
+		require.EqualValues(t, 4, r[0].([]interface{})[0])
+		r, err = rdb.Do(ctx, "cluster", "slot-stats", "orderby", "calls", "limit", "1", "asc").Slice()
+		require.NoError(t, err)
+		require.EqualValues(t, 0, r[0].([]interface{})[0])
+	})
+
+	t.Run("errors of slot-stats", func(t *testing.T) {
+		require.ErrorContains(t, rdb.Do(ctx, "cluster", "slot-stats", "slotsrange", "0").Err(), "SLOTSRANGE")
+		require.ErrorContains(t, rdb.Do(ctx, "cluster", "slot-stats", "slotsrange", "3", "2").Err(), "Invalid slot range")
+		require.ErrorContains(t, rdb.Do(ctx, "cluster", "slot-stats", "slotsrange", "0", "16384").Err(), "Invalid slot")
+		require.ErrorContains(t, rdb.Do(ctx, "cluster", "slot-stats", "orderby", "foo").Err(), "Unknown metric")
+		require.ErrorContains(t, rdb.Do(ctx, "cluster", "slot-stats", "orderby", "calls", "limit", "0").Err(), "Limit")
+	})
+}
+
 func TestClusterNodes(t *testing.T) {
 	srv := util.StartServer(t, map[string]string{"cluster-enabled": "yes"})
 	defer srv.Close()
@@ -277,6 +346,18 @@ func TestClusterMultiple(t *testing.T) {
 		require.ErrorContains(t, rdb[1].MSet(ctx, util.SlotTable[0], 0, util.SlotTable[1], 1).Err(), "CROSSSLOT")
 	})
 
+	t.Run("multiple keys(cross slots) command is right if all slots are served locally", func(t *testing.T) {
+		require.NoError(t, rdb[1].ConfigSet(ctx, "cluster-allow-local-cross-slot", "yes").Err())
+		defer func() {
+			require.NoError(t, rdb[1].ConfigSet(ctx, "cluster-allow-local-cross-slot", "no").Err())
+		}()
+		require.NoError(t, rdb[1].MSet(ctx, util.SlotTable[0], "cross-0", util.SlotTable[1], "cross-1").Err())
+		require.EqualValues(t, []interface{}{"cross-0", "cross-1"}, rdb[1].MGet(ctx, util.SlotTable[0], util.SlotTable[1]).Val())
+		// the keys of the slot that isn't served by myself are moved
+		util.ErrorRegexp(t, rdb[1].MGet(ctx, util.SlotTable[0], util.SlotTable[16383]).Err(), fmt.Sprintf(".*MOVED 16383.*%d.*", srv[2].Port()))
+		require.ErrorContains(t, rdb[1].MSet(ctx, util.SlotTable[0], 0, util.SlotTable[2], 2).Err(), "CLUSTERDOWN")
+	})
+
 	t.Run("multiple keys(the same slots) command is right", func(t *testing.T) {
 		require.NoError(t, rdb[1].MSet(ctx, util.SlotTable[0], 0, util.SlotTable[0], 1).Err())
 	})
@@ -0,0 +1,116 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package namespace
+
+import (
+	"context"
+	"testing"
+	"time"
+
+	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/go-redis/redis/v9"
+	"github.com/stretchr/testify/require"
+)
+
+func TestNamespaceColumnFamilies(t *testing.T) {
+	configs := map[string]string{
+		"requirepass":               "foobared",
+		"masterauth":                "foobared",
+		"namespace.tenant":          "tenant_token",
+		"namespace-column-families": "tenant",
+	}
+	master := util.StartServer(t, configs)
+	defer master.Close()
+	masterAdmin := master.NewClientWithOption(&redis.Options{Password: "foobared"})
+	defer func() { require.NoError(t, masterAdmin.Close()) }()
+	masterTenant := master.NewClientWithOption(&redis.Options{Password: "tenant_token"})
+	defer func() { require.NoError(t, masterTenant.Close()) }()
+
+	replica := util.StartServer(t, configs)
+	defer replica.Close()
+	replicaAdmin := replica.NewClientWithOption(&redis.Options{Password: "foobared"})
+	defer func() { require.NoError(t, replicaAdmin.Close()) }()
+	replicaTenant := replica.NewClientWithOption(&redis.Options{Password: "tenant_token"})
+	defer func() { require.NoError(t, replicaTenant.Close()) }()
+
+	ctx := context.Background()
+	t.Run("The keys of the namespace are stored in its column families", func(t *testing.T) {
+		require.NoError(t, masterTenant.Set(ctx, "str", "tenant", 0).Err())
+		require.NoError(t, masterTenant.HSet(ctx, "hash", "f1", "v1", "f2", "v2").Err())
+		require.NoError(t, masterTenant.ZAdd(ctx, "zset", redis.Z{Score: 1, Member: "a"},
+			redis.Z{Score: 2, Member: "b"}).Err())
+		require.NoError(t, masterTenant.RPush(ctx, "list", "a", "b", "c").Err())
+		require.NoError(t, masterAdmin.Set(ctx, "str", "default", 0).Err())
+
+		require.Equal(t, "tenant", masterTenant.Get(ctx, "str").Val())
+		require.Equal(t, map[string]string{"f1": "v1", "f2": "v2"}, masterTenant.HGetAll(ctx, "hash").Val())
+		require.Equal(t, []string{"b", "a"}, masterTenant.ZRevRange(ctx, "zset", 0, -1).Val())
+		require.Equal(t, []string{"a", "b", "c"}, masterTenant.LRange(ctx, "list", 0, -1).Val())
+		require.ElementsMatch(t, []string{"str", "hash", "zset", "list"}, masterTenant.Keys(ctx, "*").Val())
+		require.Equal(t, "default", masterAdmin.Get(ctx, "str").Val())
+		require.NotEmpty(t, util.FindInfoEntry(masterAdmin, `estimate_keys\[metadata@tenant@1\]`, "rocksdb"))
+	})
+
+	t.Run("MULTI-EXEC reads the buffered writes of the namespace", func(t *testing.T) {
+		pipe := masterTenant.TxPipeline()
+		pipe.HSet(ctx, "hash", "f3", "v3")
+		hlen := pipe.HLen(ctx, "hash")
+		_, err := pipe.Exec(ctx)
+		require.NoError(t, err)
+		require.EqualValues(t, 3, hlen.Val())
+	})
+
+	t.Run("The replica gets the column families by the full synchronization", func(t *testing.T) {
+		util.SlaveOf(t, replicaAdmin, master)
+		util.WaitForSync(t, replicaAdmin)
+		require.NoError(t, masterTenant.Set(ctx, "after", "sync", 0).Err())
+		util.WaitForOffsetSync(t, masterAdmin, replicaAdmin)
+		require.Equal(t, "tenant", replicaTenant.Get(ctx, "str").Val())
+		require.Equal(t, "sync", replicaTenant.Get(ctx, "after").Val())
+		require.EqualValues(t, 3, replicaTenant.HLen(ctx, "hash").Val())
+		require.Equal(t, "default", replicaAdmin.Get(ctx, "str").Val())
+	})
+
+	t.Run("FLUSHDB drops the column families of the namespace", func(t *testing.T) {
+		require.NoError(t, masterTenant.FlushDB(ctx).Err())
+		require.Empty(t, masterTenant.Keys(ctx, "*").Val())
+		require.Equal(t, "default", masterAdmin.Get(ctx, "str").Val())
+		require.NotEmpty(t, util.FindInfoEntry(masterAdmin, `estimate_keys\[metadata@tenant@2\]`, "rocksdb"))
+		require.Empty(t, util.FindInfoEntry(masterAdmin, `estimate_keys\[metadata@tenant@1\]`, "rocksdb"))
+
+		require.NoError(t, masterTenant.Set(ctx, "str", "new", 0).Err())
+		require.Equal(t, "new", masterTenant.Get(ctx, "str").Val())
+	})
+
+	t.Run("The replica resynchronizes fully after the column families were dropped", func(t *testing.T) {
+		require.Eventually(t, func() bool {
+			return replicaTenant.Get(ctx, "str").Val() == "new" && replicaTenant.Exists(ctx, "hash").Val() == 0
+		}, 20*time.Second, 100*time.Millisecond)
+		require.Equal(t, "default", replicaAdmin.Get(ctx, "str").Val())
+	})
+
+	t.Run("The column families of the namespace are kept after restarting", func(t *testing.T) {
+		require.NoError(t, replicaAdmin.SlaveOf(ctx, "NO", "ONE").Err())
+		master.Restart()
+		require.Equal(t, "new", masterTenant.Get(ctx, "str").Val())
+		require.Equal(t, "default", masterAdmin.Get(ctx, "str").Val())
+		require.NotEmpty(t, util.FindInfoEntry(masterAdmin, `estimate_keys\[metadata@tenant@2\]`, "rocksdb"))
+	})
+}
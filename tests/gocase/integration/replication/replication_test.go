@@ -21,6 +21,8 @@ package replication
 
 import (
 	"context"
+	"fmt"
+	"hash/crc32"
 	"strconv"
 	"strings"
 	"testing"
@@ -194,6 +196,35 @@ func TestReplicationWithMultiSlaves(t *testing.T) {
 		}, 50*time.Second, 100*time.Millisecond)
 		require.Equal(t, "2", util.FindInfoEntry(rdbC, "sync_full"))
 	})
+
+	t.Run("Multi slaves are fed from the shared backlog", func(t *testing.T) {
+		ctx := context.Background()
+		require.Equal(t, "1", util.FindInfoEntry(rdbC, "repl_backlog_active"))
+		for i := 0; i < 100; i++ {
+			require.NoError(t, rdbC.Set(ctx, "backlog_key_"+strconv.Itoa(i), i, 0).Err())
+		}
+		util.WaitForOffsetSync(t, rdbC, rdbA)
+		util.WaitForOffsetSync(t, rdbC, rdbB)
+		require.Equal(t, "99", rdbA.Get(ctx, "backlog_key_99").Val())
+		require.Equal(t, "99", rdbB.Get(ctx, "backlog_key_99").Val())
+		batches, err := strconv.Atoi(util.FindInfoEntry(rdbC, "repl_backlog_batches"))
+		require.NoError(t, err)
+		require.GreaterOrEqual(t, batches, 100)
+	})
+
+	t.Run("The other slaves are still fed after a slave disconnected", func(t *testing.T) {
+		ctx := context.Background()
+		require.NoError(t, rdbA.SlaveOf(ctx, "NO", "ONE").Err())
+		// The master finds the broken connection while sending the writes
+		require.Eventually(t, func() bool {
+			require.NoError(t, rdbC.Set(ctx, "before_disconnect_key", "v", 0).Err())
+			return util.FindInfoEntry(rdbC, "connected_slaves") == "1"
+		}, 10*time.Second, 100*time.Millisecond)
+		require.NoError(t, rdbC.Set(ctx, "after_disconnect_key", "v", 0).Err())
+		util.WaitForOffsetSync(t, rdbC, rdbB)
+		require.Equal(t, "v", rdbB.Get(ctx, "after_disconnect_key").Val())
+		require.Equal(t, "", rdbA.Get(ctx, "after_disconnect_key").Val())
+	})
 }
 
 func TestReplicationWithLimitSpeed(t *testing.T) {
@@ -308,6 +339,20 @@ func TestReplicationContinueRunning(t *testing.T) {
 		require.Equal(t, "1", slaveClient.HGet(ctx, "myhash", "1").Val())
 		require.Equal(t, "a", slaveClient.HGet(ctx, "myhash", "a").Val())
 	})
+
+	t.Run("The replica applies all received batches", func(t *testing.T) {
+		ctx := context.Background()
+		for i := 0; i < 1000; i++ {
+			require.NoError(t, masterClient.Set(ctx, "applied_key_"+strconv.Itoa(i), i, 0).Err())
+		}
+		util.WaitForOffsetSync(t, masterClient, slaveClient)
+		require.Equal(t, "999", slaveClient.Get(ctx, "applied_key_999").Val())
+		require.Eventually(t, func() bool {
+			return util.FindInfoEntry(slaveClient, "slave_apply_pending_batches") == "0" &&
+				util.FindInfoEntry(slaveClient, "slave_apply_pending_bytes") == "0"
+		}, 5*time.Second, 100*time.Millisecond)
+		require.Equal(t, "0", util.FindInfoEntry(slaveClient, "slave_apply_lag"))
+	})
 }
 
 func TestReplicationChangePassword(t *testing.T) {
@@ -351,3 +396,366 @@ func TestReplicationChangePassword(t *testing.T) {
 		require.Contains(t, masterReplicationInfo, strconv.Itoa(int(slave.Port())))
 	})
 }
+
+func TestReplicationWithCompression(t *testing.T) {
+	master := util.StartServer(t, map[string]string{})
+	defer master.Close()
+	masterClient := master.NewClient()
+	defer func() { require.NoError(t, masterClient.Close()) }()
+
+	slave := util.StartServer(t, map[string]string{"replication-compression": "zstd"})
+	defer slave.Close()
+	slaveClient := slave.NewClient()
+	defer func() { require.NoError(t, slaveClient.Close()) }()
+
+	ctx := context.Background()
+	util.Populate(t, masterClient, "key:", 1000, 100)
+
+	util.SlaveOf(t, slaveClient, master)
+	util.WaitForSync(t, slaveClient)
+
+	t.Run("Full sync with the compressed files", func(t *testing.T) {
+		require.Equal(t, strings.Repeat("A", 100), slaveClient.Get(ctx, "key:0").Val())
+		require.Equal(t, strings.Repeat("A", 100), slaveClient.Get(ctx, "key:999").Val())
+	})
+
+	t.Run("Incremental sync with the compressed stream", func(t *testing.T) {
+		for i := 0; i < 100; i++ {
+			require.NoError(t, masterClient.Set(ctx, "compressed_key_"+strconv.Itoa(i), strings.Repeat("v", 100), 0).Err())
+		}
+		util.WaitForOffsetSync(t, masterClient, slaveClient)
+		require.Equal(t, strings.Repeat("v", 100), slaveClient.Get(ctx, "compressed_key_99").Val())
+
+		info := util.FindInfoEntry(masterClient, "slave0", "replication")
+		require.Contains(t, info, "compression=zstd")
+		fields := map[string]int{}
+		for _, field := range strings.Split(info, ",") {
+			kv := strings.SplitN(field, "=", 2)
+			if len(kv) == 2 {
+				fields[kv[0]], _ = strconv.Atoi(kv[1])
+			}
+		}
+		require.Less(t, fields["sent_bytes"], fields["raw_bytes"])
+	})
+}
+
+func TestReplicationWait(t *testing.T) {
+	master := util.StartServer(t, map[string]string{})
+	defer master.Close()
+	masterClient := master.NewClient()
+	defer func() { require.NoError(t, masterClient.Close()) }()
+
+	slave := util.StartServer(t, map[string]string{})
+	defer slave.Close()
+	slaveClient := slave.NewClient()
+	defer func() { require.NoError(t, slaveClient.Close()) }()
+
+	ctx := context.Background()
+	util.SlaveOf(t, slaveClient, master)
+	util.WaitForSync(t, slaveClient)
+
+	t.Run("WAIT for the replica to apply the writes", func(t *testing.T) {
+		require.NoError(t, masterClient.Set(ctx, "wait_key", "a", 0).Err())
+		require.EqualValues(t, 1, masterClient.Do(ctx, "WAIT", "1", "5000").Val())
+		require.Equal(t, "a", slaveClient.Get(ctx, "wait_key").Val())
+		require.EqualValues(t, 0, masterClient.Do(ctx, "WAIT", "0", "0").Val())
+		require.Contains(t, util.FindInfoEntry(masterClient, "slave0", "replication"), "ack_offset=")
+	})
+
+	t.Run("WAIT returns the acknowledged replicas after timeout", func(t *testing.T) {
+		require.NoError(t, masterClient.Set(ctx, "wait_key", "b", 0).Err())
+		start := time.Now()
+		require.EqualValues(t, 1, masterClient.Do(ctx, "WAIT", "2", "200").Val())
+		require.GreaterOrEqual(t, time.Since(start), 200*time.Millisecond)
+	})
+
+	t.Run("WAIT isn't allowed on the replica", func(t *testing.T) {
+		require.ErrorContains(t, slaveClient.Do(ctx, "WAIT", "1", "100").Err(), "replica")
+	})
+
+	t.Run("The writes are replied after enough replicas acknowledged", func(t *testing.T) {
+		require.NoError(t, masterClient.ConfigSet(ctx, "min-replicas-to-ack", "1").Err())
+		require.NoError(t, masterClient.Set(ctx, "ack_key", "a", 0).Err())
+		// The replica applied the write before it was replied
+		require.Equal(t, "a", slaveClient.Get(ctx, "ack_key").Val())
+
+		require.NoError(t, masterClient.ConfigSet(ctx, "min-replicas-to-ack", "2").Err())
+		require.NoError(t, masterClient.ConfigSet(ctx, "min-replicas-ack-timeout", "200").Err())
+		c := master.NewClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.ErrorContains(t, c.Set(ctx, "ack_key", "b", 0).Err(), "NOREPLICAS")
+		require.NoError(t, masterClient.ConfigSet(ctx, "min-replicas-to-ack", "0").Err())
+	})
+
+	t.Run("The streamed replies after the writes are held until acknowledged", func(t *testing.T) {
+		fields := make(map[string]interface{})
+		for i := 0; i < 5000; i++ {
+			fields[fmt.Sprintf("field-%d", i)] = strings.Repeat("v", 100)
+		}
+		require.NoError(t, masterClient.HSet(ctx, "ack_big_hash", fields).Err())
+		require.NoError(t, masterClient.Set(ctx, "ack_pre_key", "x", 0).Err())
+
+		require.NoError(t, masterClient.ConfigSet(ctx, "min-replicas-to-ack", "2").Err())
+		require.NoError(t, masterClient.ConfigSet(ctx, "min-replicas-ack-timeout", "200").Err())
+		c := master.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		// The large HGETALL after the write isn't flushed while the write waits for the acknowledgement,
+		// so only the reply before the write and the error are received
+		require.NoError(t, c.Write("GET ack_pre_key\r\nSET ack_key c\r\nHGETALL ack_big_hash\r\n"))
+		c.MustRead(t, "$1")
+		c.MustRead(t, "x")
+		c.MustMatch(t, "^-NOREPLICAS")
+		c.MustFail(t)
+		require.NoError(t, masterClient.ConfigSet(ctx, "min-replicas-to-ack", "0").Err())
+	})
+}
+
+func TestReplicationResumeFetchFile(t *testing.T) {
+	master := util.StartServer(t, map[string]string{})
+	defer master.Close()
+	masterClient := master.NewClient()
+	defer func() { require.NoError(t, masterClient.Close()) }()
+	util.Populate(t, masterClient, "key:", 1000, 100)
+
+	c := master.NewTCPClient()
+	defer func() { require.NoError(t, c.Close()) }()
+	require.NoError(t, c.WriteArgs("_fetch_meta"))
+	line, err := c.ReadLine()
+	require.NoError(t, err)
+	var file string
+	for _, f := range strings.Split(line, ",") {
+		if strings.HasSuffix(f, ".sst") {
+			file = f
+		}
+	}
+	require.NotEmpty(t, file)
+
+	fetchFile := func(args ...string) (string, []byte) {
+		c := master.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.NoError(t, c.WriteArgs(append([]string{"_fetch_file", file}, args...)...))
+		line, err := c.ReadLine()
+		require.NoError(t, err)
+		fields := strings.Split(line, " ")
+		size, err := strconv.Atoi(fields[0])
+		require.NoError(t, err)
+		offset := 0
+		if len(fields) > 1 {
+			offset, err = strconv.Atoi(fields[1])
+			require.NoError(t, err)
+		}
+		data, err := c.ReadBytes(size - offset)
+		require.NoError(t, err)
+		return line, data
+	}
+	_, data := fetchFile()
+	half := len(data) / 2
+	table := crc32.MakeTable(crc32.Castagnoli)
+
+	t.Run("Resume the file from the offset whose prefix is matched", func(t *testing.T) {
+		line, rest := fetchFile("offsets", fmt.Sprintf("%d:%d", half, crc32.Checksum(data[:half], table)))
+		require.Equal(t, fmt.Sprintf("%d %d", len(data), half), line)
+		require.Equal(t, data[half:], rest)
+	})
+
+	t.Run("Fetch the file from the beginning if the prefix is mismatched", func(t *testing.T) {
+		line, rest := fetchFile("offsets", fmt.Sprintf("%d:%d", half, crc32.Checksum(data[:half], table)+1))
+		require.Equal(t, fmt.Sprintf("%d 0", len(data)), line)
+		require.Equal(t, data, rest)
+	})
+}
+
+func TestReplicationCascading(t *testing.T) {
+	master := util.StartServer(t, map[string]string{})
+	defer master.Close()
+	masterClient := master.NewClient()
+	defer func() { require.NoError(t, masterClient.Close()) }()
+
+	replica := util.StartServer(t, map[string]string{})
+	defer replica.Close()
+	replicaClient := replica.NewClient()
+	defer func() { require.NoError(t, replicaClient.Close()) }()
+
+	subReplica := util.StartServer(t, map[string]string{})
+	defer subReplica.Close()
+	subReplicaClient := subReplica.NewClient()
+	defer func() { require.NoError(t, subReplicaClient.Close()) }()
+
+	ctx := context.Background()
+	util.Populate(t, masterClient, "key:", 100, 10)
+	util.SlaveOf(t, replicaClient, master)
+	util.WaitForSync(t, replicaClient)
+	util.SlaveOf(t, subReplicaClient, replica)
+	util.WaitForSync(t, subReplicaClient)
+
+	t.Run("Writes of the master are replicated through the replica", func(t *testing.T) {
+		require.Equal(t, strings.Repeat("A", 10), subReplicaClient.Get(ctx, "key:99").Val())
+		require.NoError(t, masterClient.Set(ctx, "cascading", "v1", 0).Err())
+		util.WaitForOffsetSync(t, masterClient, subReplicaClient)
+		require.Equal(t, "v1", subReplicaClient.Get(ctx, "cascading").Val())
+	})
+
+	t.Run("Replicas inherit the replication id of the master", func(t *testing.T) {
+		replid := util.FindInfoEntry(masterClient, "master_replid")
+		require.Len(t, replid, 16)
+		require.Eventually(t, func() bool {
+			return util.FindInfoEntry(replicaClient, "master_replid") == replid &&
+				util.FindInfoEntry(subReplicaClient, "master_replid") == replid
+		}, 5*time.Second, 100*time.Millisecond)
+	})
+
+	t.Run("The sub-replica keeps replicating after the replica is promoted", func(t *testing.T) {
+		require.NoError(t, replicaClient.SlaveOf(ctx, "NO", "ONE").Err())
+		require.NoError(t, replicaClient.Set(ctx, "cascading", "v2", 0).Err())
+		require.Eventually(t, func() bool {
+			return subReplicaClient.Get(ctx, "cascading").Val() == "v2"
+		}, 5*time.Second, 100*time.Millisecond)
+		require.Equal(t, util.FindInfoEntry(replicaClient, "master_replid"),
+			util.FindInfoEntry(subReplicaClient, "master_replid"))
+	})
+}
+
+func TestReplicationDisklessSync(t *testing.T) {
+	master := util.StartServer(t, map[string]string{"repl-diskless-sync": "yes"})
+	defer master.Close()
+	masterClient := master.NewClient()
+	defer func() { require.NoError(t, masterClient.Close()) }()
+
+	slave := util.StartServer(t, map[string]string{})
+	defer slave.Close()
+	slaveClient := slave.NewClient()
+	defer func() { require.NoError(t, slaveClient.Close()) }()
+
+	ctx := context.Background()
+	util.Populate(t, masterClient, "key:", 1000, 100)
+
+	t.Run("Full sync with the pinned live files", func(t *testing.T) {
+		util.SlaveOf(t, slaveClient, master)
+		util.WaitForSync(t, slaveClient)
+		require.Eventually(t, func() bool {
+			return master.LogFileMatches(t, ".*Pin the live files successfully.*")
+		}, 5*time.Second, 100*time.Millisecond)
+		require.Equal(t, strings.Repeat("A", 100), slaveClient.Get(ctx, "key:0").Val())
+		require.Equal(t, strings.Repeat("A", 100), slaveClient.Get(ctx, "key:999").Val())
+	})
+
+	t.Run("Incremental sync after the full sync", func(t *testing.T) {
+		require.NoError(t, masterClient.Set(ctx, "diskless", "v", 0).Err())
+		util.WaitForOffsetSync(t, masterClient, slaveClient)
+		require.Equal(t, "v", slaveClient.Get(ctx, "diskless").Val())
+	})
+}
+
+func TestReplicationLag(t *testing.T) {
+	master := util.StartServer(t, map[string]string{})
+	masterClient := master.NewClient()
+
+	slave := util.StartServer(t, map[string]string{})
+	defer slave.Close()
+	slaveClient := slave.NewClient()
+	defer func() { require.NoError(t, slaveClient.Close()) }()
+
+	ctx := context.Background()
+	util.SlaveOf(t, slaveClient, master)
+	util.WaitForSync(t, slaveClient)
+	require.NoError(t, masterClient.Set(ctx, "lag_key", "v", 0).Err())
+	util.WaitForOffsetSync(t, masterClient, slaveClient)
+
+	t.Run("The replica tracks its lag by the heartbeats of the master", func(t *testing.T) {
+		require.Eventually(t, func() bool {
+			lag, err := strconv.Atoi(util.FindInfoEntry(slaveClient, "slave_lag_ms"))
+			return err == nil && lag >= 0 && lag < 1000
+		}, 5*time.Second, 100*time.Millisecond)
+	})
+
+	t.Run("The replica publishes its applied sequence and lag", func(t *testing.T) {
+		pubsub := slaveClient.Subscribe(ctx, "__kvrocks_replica_lag__")
+		defer func() { require.NoError(t, pubsub.Close()) }()
+		_, err := pubsub.Receive(ctx)
+		require.NoError(t, err)
+		require.NoError(t, masterClient.Set(ctx, "lag_key", "v2", 0).Err())
+		offset := util.FindInfoEntry(masterClient, "master_repl_offset")
+		require.Eventually(t, func() bool {
+			msg, err := pubsub.ReceiveTimeout(ctx, time.Second)
+			if err != nil {
+				return false
+			}
+			fields := strings.Split(msg.(*redis.Message).Payload, " ")
+			return len(fields) == 2 && fields[0] == offset
+		}, 5*time.Second, 10*time.Millisecond)
+	})
+
+	t.Run("READONLY MAXLAG rejects the reads on the stale replica", func(t *testing.T) {
+		c := slave.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.NoError(t, c.WriteArgs("READONLY", "MAXLAG", "60000"))
+		c.MustRead(t, "+OK")
+		require.NoError(t, c.WriteArgs("GET", "lag_key"))
+		c.MustRead(t, "$2")
+		c.MustRead(t, "v2")
+
+		require.NoError(t, masterClient.Close())
+		master.Close()
+		require.Eventually(t, func() bool {
+			lag, err := strconv.Atoi(util.FindInfoEntry(slaveClient, "slave_lag_ms"))
+			return err == nil && lag > 500
+		}, 5*time.Second, 100*time.Millisecond)
+
+		require.NoError(t, c.WriteArgs("READONLY", "MAXLAG", "200"))
+		c.MustRead(t, "+OK")
+		require.NoError(t, c.WriteArgs("GET", "lag_key"))
+		c.MustMatch(t, "STALE.*exceeds MAXLAG 200")
+		require.NoError(t, c.WriteArgs("PING"))
+		c.MustRead(t, "+PONG")
+
+		require.NoError(t, c.WriteArgs("READWRITE"))
+		c.MustRead(t, "+OK")
+		require.NoError(t, c.WriteArgs("GET", "lag_key"))
+		c.MustRead(t, "$2")
+		c.MustRead(t, "v2")
+	})
+}
+
+func TestReplicationFromBackup(t *testing.T) {
+	master := util.StartServer(t, map[string]string{})
+	defer master.Close()
+	masterClient := master.NewClient()
+	defer func() { require.NoError(t, masterClient.Close()) }()
+
+	ctx := context.Background()
+	util.Populate(t, masterClient, "backup_", 100, 10)
+	require.NoError(t, masterClient.Do(ctx, "bgsave").Err())
+	require.Eventually(t, func() bool {
+		return util.FindInfoEntry(masterClient, "bgsave_in_progress", "persistence") == "0" &&
+			util.FindInfoEntry(masterClient, "last_bgsave_time", "persistence") != "-1"
+	}, 10*time.Second, 100*time.Millisecond)
+	backupDir := masterClient.ConfigGet(ctx, "backup-dir").Val()["backup-dir"]
+	// The writes after the backup are sent as the WAL by PSYNC
+	require.NoError(t, masterClient.Set(ctx, "after_backup", "v", 0).Err())
+
+	slave := util.StartServer(t, map[string]string{})
+	defer slave.Close()
+	slaveClient := slave.NewClient()
+	defer func() { require.NoError(t, slaveClient.Close()) }()
+
+	t.Run("SLAVEOF FROM-BACKUP checks the arguments", func(t *testing.T) {
+		require.ErrorContains(t, slaveClient.Do(ctx, "slaveof", "no", "one", "from-backup", backupDir).Err(),
+			"syntax error")
+		require.ErrorContains(t, slaveClient.Do(ctx, "slaveof", master.Host(), master.Port(), "from-backup").Err(),
+			"syntax error")
+		require.ErrorContains(t, slaveClient.Do(ctx, "slaveof", master.Host(), master.Port(), "from-backup",
+			backupDir+"_missing").Err(), "doesn't exist")
+	})
+
+	t.Run("Replica restores the backup and resumes by PSYNC", func(t *testing.T) {
+		require.NoError(t, slaveClient.Do(ctx, "slaveof", master.Host(), master.Port(), "from-backup", backupDir).Err())
+		require.Eventually(t, func() bool {
+			return util.FindInfoEntry(slaveClient, "master_link_status") == "up"
+		}, 10*time.Second, 100*time.Millisecond)
+		util.WaitForOffsetSync(t, masterClient, slaveClient)
+		require.Equal(t, "v", slaveClient.Get(ctx, "after_backup").Val())
+		require.Equal(t, strings.Repeat("A", 10), slaveClient.Get(ctx, "backup_99").Val())
+		require.Equal(t, "0", util.FindInfoEntry(masterClient, "sync_full"))
+		require.Equal(t, "1", util.FindInfoEntry(masterClient, "sync_partial_ok"))
+	})
+}
@@ -695,6 +695,198 @@ func TestSlotMigrateDataType(t *testing.T) {
 	})
 }
 
+func TestSlotMigrateBySst(t *testing.T) {
+	ctx := context.Background()
+
+	srv0 := util.StartServer(t, map[string]string{"cluster-enabled": "yes", "migrate-type": "sst"})
+	defer func() { srv0.Close() }()
+	rdb0 := srv0.NewClient()
+	defer func() { require.NoError(t, rdb0.Close()) }()
+	id0 := "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx00"
+	require.NoError(t, rdb0.Do(ctx, "clusterx", "SETNODEID", id0).Err())
+
+	srv1 := util.StartServer(t, map[string]string{"cluster-enabled": "yes"})
+	defer func() { srv1.Close() }()
+	rdb1 := srv1.NewClient()
+	defer func() { require.NoError(t, rdb1.Close()) }()
+	id1 := "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx01"
+	require.NoError(t, rdb1.Do(ctx, "clusterx", "SETNODEID", id1).Err())
+
+	clusterNodes := fmt.Sprintf("%s %s %d master - 0-10000\n", id0, srv0.Host(), srv0.Port())
+	clusterNodes += fmt.Sprintf("%s %s %d master - 10001-16383", id1, srv1.Host(), srv1.Port())
+	require.NoError(t, rdb0.Do(ctx, "clusterx", "SETNODES", clusterNodes, "1").Err())
+	require.NoError(t, rdb1.Do(ctx, "clusterx", "SETNODES", clusterNodes, "1").Err())
+
+	t.Run("MIGRATE - Migrate the snapshot of slot by SST files", func(t *testing.T) {
+		keys := make(map[string]string, 0)
+		for _, typ := range []string{"string", "list", "hash", "zset"} {
+			keys[typ] = fmt.Sprintf("%s_{%s}", typ, util.SlotTable[0])
+		}
+		require.NoError(t, rdb0.Set(ctx, keys["string"], keys["string"], 10*time.Second).Err())
+		cnt := 2000
+		for i := 0; i < cnt; i++ {
+			require.NoError(t, rdb0.RPush(ctx, keys["list"], i).Err())
+			require.NoError(t, rdb0.HSet(ctx, keys["hash"], i, i).Err())
+			require.NoError(t, rdb0.ZAdd(ctx, keys["zset"], redis.Z{Score: float64(i), Member: i}).Err())
+		}
+		// the key of the other slot isn't migrated
+		require.NoError(t, rdb0.Set(ctx, util.SlotTable[1], "slot1", 0).Err())
+
+		require.Equal(t, "OK", rdb0.Do(ctx, "clusterx", "migrate", "0", id1).Val())
+		waitForMigrateState(t, rdb0, "0", "success")
+
+		require.Equal(t, keys["string"], rdb1.Get(ctx, keys["string"]).Val())
+		util.BetweenValues(t, rdb1.TTL(ctx, keys["string"]).Val(), time.Second, 10*time.Second)
+		require.EqualValues(t, cnt, rdb1.LLen(ctx, keys["list"]).Val())
+		require.Equal(t, "1999", rdb1.LIndex(ctx, keys["list"], -1).Val())
+		require.EqualValues(t, cnt, rdb1.HLen(ctx, keys["hash"]).Val())
+		require.Equal(t, "100", rdb1.HGet(ctx, keys["hash"], "100").Val())
+		require.EqualValues(t, cnt, rdb1.ZCard(ctx, keys["zset"]).Val())
+		require.EqualValues(t, []string{"10", "11"}, rdb1.ZRangeByScore(ctx, keys["zset"],
+			&redis.ZRangeBy{Min: "10", Max: "11"}).Val())
+		require.EqualValues(t, 0, rdb1.Do(ctx, "cluster", "countkeysinslot", "1").Val())
+		require.ErrorContains(t, rdb0.Exists(ctx, keys["string"]).Err(), "MOVED")
+	})
+
+	t.Run("MIGRATE - Only the importing connection can send SST files", func(t *testing.T) {
+		require.ErrorContains(t, rdb1.Do(ctx, "cluster", "importsst", "0", "data").Err(), "isn't importing")
+	})
+}
+
+func TestSlotMigrateByDump(t *testing.T) {
+	ctx := context.Background()
+
+	srv0 := util.StartServer(t, map[string]string{"cluster-enabled": "yes", "migrate-type": "dump"})
+	defer func() { srv0.Close() }()
+	rdb0 := srv0.NewClient()
+	defer func() { require.NoError(t, rdb0.Close()) }()
+	id0 := "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx00"
+	require.NoError(t, rdb0.Do(ctx, "clusterx", "SETNODEID", id0).Err())
+
+	srv1 := util.StartServer(t, map[string]string{"cluster-enabled": "yes"})
+	defer func() { srv1.Close() }()
+	rdb1 := srv1.NewClient()
+	defer func() { require.NoError(t, rdb1.Close()) }()
+	id1 := "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx01"
+	require.NoError(t, rdb1.Do(ctx, "clusterx", "SETNODEID", id1).Err())
+
+	clusterNodes := fmt.Sprintf("%s %s %d master - 0-10000\n", id0, srv0.Host(), srv0.Port())
+	clusterNodes += fmt.Sprintf("%s %s %d master - 10001-16383", id1, srv1.Host(), srv1.Port())
+	require.NoError(t, rdb0.Do(ctx, "clusterx", "SETNODES", clusterNodes, "1").Err())
+	require.NoError(t, rdb1.Do(ctx, "clusterx", "SETNODES", clusterNodes, "1").Err())
+
+	t.Run("MIGRATE - Migrate the snapshot of slot by DUMP payloads", func(t *testing.T) {
+		keys := make(map[string]string, 0)
+		for _, typ := range []string{"string", "list", "hash", "zset", "stream"} {
+			keys[typ] = fmt.Sprintf("%s_{%s}", typ, util.SlotTable[0])
+		}
+		require.NoError(t, rdb0.Set(ctx, keys["string"], keys["string"], 0).Err())
+		cnt := 1000
+		for i := 0; i < cnt; i++ {
+			require.NoError(t, rdb0.RPush(ctx, keys["list"], i).Err())
+			require.NoError(t, rdb0.HSet(ctx, keys["hash"], i, i).Err())
+			require.NoError(t, rdb0.ZAdd(ctx, keys["zset"], redis.Z{Score: float64(i), Member: i}).Err())
+		}
+		require.NoError(t, rdb0.XAdd(ctx, &redis.XAddArgs{Stream: keys["stream"], Values: []string{"k", "v"}}).Err())
+		require.NoError(t, rdb0.Expire(ctx, keys["hash"], 10*time.Second).Err())
+
+		require.Equal(t, "OK", rdb0.Do(ctx, "clusterx", "migrate", "0", id1).Val())
+		waitForMigrateState(t, rdb0, "0", "success")
+
+		require.Equal(t, keys["string"], rdb1.Get(ctx, keys["string"]).Val())
+		require.EqualValues(t, cnt, rdb1.LLen(ctx, keys["list"]).Val())
+		require.Equal(t, "999", rdb1.LIndex(ctx, keys["list"], -1).Val())
+		require.EqualValues(t, cnt, rdb1.HLen(ctx, keys["hash"]).Val())
+		require.Equal(t, "100", rdb1.HGet(ctx, keys["hash"], "100").Val())
+		util.BetweenValues(t, rdb1.TTL(ctx, keys["hash"]).Val(), time.Second, 10*time.Second)
+		require.EqualValues(t, cnt, rdb1.ZCard(ctx, keys["zset"]).Val())
+		require.EqualValues(t, []string{"10", "11"}, rdb1.ZRangeByScore(ctx, keys["zset"],
+			&redis.ZRangeBy{Min: "10", Max: "11"}).Val())
+		require.EqualValues(t, 1, rdb1.XLen(ctx, keys["stream"]).Val())
+		require.ErrorContains(t, rdb0.Exists(ctx, keys["string"]).Err(), "MOVED")
+	})
+}
+
+func TestSlotMigrateSlotRange(t *testing.T) {
+	ctx := context.Background()
+
+	srv0 := util.StartServer(t, map[string]string{"cluster-enabled": "yes"})
+	defer func() { srv0.Close() }()
+	rdb0 := srv0.NewClient()
+	defer func() { require.NoError(t, rdb0.Close()) }()
+	id0 := "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx00"
+	require.NoError(t, rdb0.Do(ctx, "clusterx", "SETNODEID", id0).Err())
+
+	srv1 := util.StartServer(t, map[string]string{"cluster-enabled": "yes"})
+	defer func() { srv1.Close() }()
+	rdb1 := srv1.NewClient()
+	defer func() { require.NoError(t, rdb1.Close()) }()
+	id1 := "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx01"
+	require.NoError(t, rdb1.Do(ctx, "clusterx", "SETNODEID", id1).Err())
+
+	clusterNodes := fmt.Sprintf("%s %s %d master - 0-10000\n", id0, srv0.Host(), srv0.Port())
+	clusterNodes += fmt.Sprintf("%s %s %d master - 10001-16383", id1, srv1.Host(), srv1.Port())
+	require.NoError(t, rdb0.Do(ctx, "clusterx", "SETNODES", clusterNodes, "1").Err())
+	require.NoError(t, rdb1.Do(ctx, "clusterx", "SETNODES", clusterNodes, "1").Err())
+
+	t.Run("MIGRATE - Slot range is invalid", func(t *testing.T) {
+		require.ErrorContains(t, rdb0.Do(ctx, "clusterx", "migrate", "5-3", id1).Err(), "Slot is out of range")
+		require.ErrorContains(t, rdb0.Do(ctx, "clusterx", "migrate", "0-16384", id1).Err(), "Slot is out of range")
+		require.ErrorContains(t, rdb0.Do(ctx, "clusterx", "migrate", "9999-10001", id1).Err(), "doesn't belong to me")
+	})
+
+	t.Run("MIGRATE - Migrate the continuous slots in one job", func(t *testing.T) {
+		cnt := 100
+		for slot := 0; slot < 4; slot++ {
+			for i := 0; i < cnt; i++ {
+				require.NoError(t, rdb0.RPush(ctx, util.SlotTable[slot], i).Err())
+			}
+		}
+		// the key of the slot out of the range isn't migrated
+		require.NoError(t, rdb0.Set(ctx, util.SlotTable[4], "slot4", 0).Err())
+
+		require.Equal(t, "OK", rdb0.Do(ctx, "clusterx", "migrate", "0-3", id1).Val())
+		waitForMigrateState(t, rdb0, "0-3", "success")
+		requireImportState(t, rdb1, "0-3", "success")
+		for slot := 0; slot < 4; slot++ {
+			require.EqualValues(t, cnt, rdb1.LLen(ctx, util.SlotTable[slot]).Val())
+			require.ErrorContains(t, rdb0.LPush(ctx, util.SlotTable[slot], 0).Err(), "MOVED")
+		}
+		require.EqualValues(t, 0, rdb1.Do(ctx, "cluster", "countkeysinslot", "4").Val())
+		require.Equal(t, "slot4", rdb0.Get(ctx, util.SlotTable[4]).Val())
+		// the writes of the slots are forbidden only in the cut-over
+		require.Equal(t, "4", util.FindInfoEntry(rdb0, "migrate_forbidden_slots"))
+		forbiddenTime, err := strconv.Atoi(util.FindInfoEntry(rdb0, "migrate_last_forbidden_time_usec"))
+		require.NoError(t, err)
+		require.Less(t, forbiddenTime, 5000000)
+
+		// the keys of the migrated slots are cleared after setting the slots
+		require.NoError(t, rdb0.Do(ctx, "clusterx", "setslot", "0-3", "node", id1, "2").Err())
+		require.NoError(t, rdb1.Do(ctx, "clusterx", "setslot", "0-3", "node", id1, "2").Err())
+		for slot := 0; slot < 4; slot++ {
+			require.EqualValues(t, 0, rdb0.Do(ctx, "cluster", "countkeysinslot", slot).Val())
+			require.NoError(t, rdb1.LPush(ctx, util.SlotTable[slot], 0).Err())
+		}
+		require.Equal(t, "2", rdb1.Do(ctx, "clusterx", "version").Val())
+	})
+
+	t.Run("MIGRATE - Pipeline size is adapted to the ack latency", func(t *testing.T) {
+		require.NoError(t, rdb0.ConfigSet(ctx, "migrate-pipeline-size", "8").Err())
+		require.NoError(t, rdb0.ConfigSet(ctx, "migrate-ack-latency-target", "1000").Err())
+		cnt := 1000
+		for i := 0; i < cnt; i++ {
+			require.NoError(t, rdb0.LPush(ctx, util.SlotTable[5], i).Err())
+		}
+		require.Equal(t, "OK", rdb0.Do(ctx, "clusterx", "migrate", "5", id1).Val())
+		waitForMigrateState(t, rdb0, "5", "success")
+		require.EqualValues(t, cnt, rdb1.LLen(ctx, util.SlotTable[5]).Val())
+		// the destination acknowledges in the target latency, so the pipeline keeps the max size
+		info := rdb0.ClusterInfo(ctx).Val()
+		require.Contains(t, info, "migrating_pipeline_size: 8")
+		require.Contains(t, info, "migrating_ack_latency_us:")
+	})
+}
+
 func waitForMigrateState(t testing.TB, client *redis.Client, n, state string) {
 	waitForMigrateStateInDuration(t, client, n, state, 5*time.Second)
 }
@@ -0,0 +1,94 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package perf
+
+import (
+	"encoding/json"
+	"errors"
+	"fmt"
+	"os"
+	"sort"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/require"
+)
+
+// Result is the throughput and the tail latency of a workload, the latency is
+// of an iteration of the workload, e.g. a pipeline, rather than a single command
+type Result struct {
+	OpsPerSec float64 `json:"ops_per_sec"`
+	P99Micros float64 `json:"p99_us"`
+}
+
+type Baseline map[string]Result
+
+func loadBaseline(t testing.TB, path string) Baseline {
+	baseline := Baseline{}
+	content, err := os.ReadFile(path)
+	if errors.Is(err, os.ErrNotExist) {
+		return baseline
+	}
+	require.NoError(t, err)
+	require.NoError(t, json.Unmarshal(content, &baseline))
+	return baseline
+}
+
+func saveBaseline(t testing.TB, path string, baseline Baseline) {
+	content, err := json.MarshalIndent(baseline, "", "  ")
+	require.NoError(t, err)
+	require.NoError(t, os.WriteFile(path, append(content, '\n'), 0644))
+}
+
+// measure runs the iteration of the workload for the given times, every iteration executes ops operations
+func measure(t testing.TB, iterations, ops int, iteration func(i int) error) Result {
+	latencies := make([]time.Duration, 0, iterations)
+	start := time.Now()
+	for i := 0; i < iterations; i++ {
+		begin := time.Now()
+		require.NoError(t, iteration(i))
+		latencies = append(latencies, time.Since(begin))
+	}
+	elapsed := time.Since(start)
+	sort.Slice(latencies, func(i, j int) bool { return latencies[i] < latencies[j] })
+	p99 := latencies[(len(latencies)*99)/100]
+	if len(latencies) < 100 {
+		p99 = latencies[len(latencies)-1]
+	}
+	return Result{
+		OpsPerSec: float64(iterations*ops) / elapsed.Seconds(),
+		P99Micros: float64(p99.Microseconds()),
+	}
+}
+
+// compare returns the regressions of the result against the baseline, the throughput
+// mustn't drop and the p99 mustn't rise by more than the tolerance
+func compare(result, baseline Result, tolerance float64) []string {
+	var regressions []string
+	if baseline.OpsPerSec > 0 && result.OpsPerSec < baseline.OpsPerSec*(1-tolerance) {
+		regressions = append(regressions, fmt.Sprintf("throughput %.0f ops/s is below the baseline %.0f ops/s",
+			result.OpsPerSec, baseline.OpsPerSec))
+	}
+	if baseline.P99Micros > 0 && result.P99Micros > baseline.P99Micros*(1+tolerance) {
+		regressions = append(regressions, fmt.Sprintf("p99 %.0f us is above the baseline %.0f us",
+			result.P99Micros, baseline.P99Micros))
+	}
+	return regressions
+}
@@ -0,0 +1,189 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package perf
+
+import (
+	"context"
+	"fmt"
+	"strings"
+	"testing"
+	"time"
+
+	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/go-redis/redis/v9"
+	"github.com/stretchr/testify/require"
+)
+
+const pipelineSize = 100
+
+// The workloads are run against a fresh server with the fixed sizes, so their results are
+// comparable between the runs on the same machine. Run them with -perfEnable, and write the
+// results as the baseline with -perfUpdateBaseline.
+func TestPerf(t *testing.T) {
+	if !util.PerfEnable() {
+		t.Skip("Performance cases run only if perf enabled.")
+	}
+
+	baseline := loadBaseline(t, util.PerfBaseline())
+	results := Baseline{}
+	check := func(t *testing.T, name string, result Result) {
+		t.Logf("%s: %.0f ops/s, p99 %.0f us", name, result.OpsPerSec, result.P99Micros)
+		results[name] = result
+		expected, ok := baseline[name]
+		if !ok || util.PerfUpdateBaseline() {
+			return
+		}
+		for _, regression := range compare(result, expected, util.PerfTolerance()) {
+			t.Errorf("%s: %s", name, regression)
+		}
+	}
+	defer func() {
+		if util.PerfUpdateBaseline() && !t.Failed() {
+			saveBaseline(t, util.PerfBaseline(), results)
+		}
+	}()
+
+	ctx := context.Background()
+	srv := util.StartServer(t, map[string]string{})
+	defer srv.Close()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("pipelined SET and GET", func(t *testing.T) {
+		value := strings.Repeat("v", 64)
+		check(t, "pipeline-set-get", measure(t, 1000, 2*pipelineSize, func(i int) error {
+			pipe := rdb.Pipeline()
+			for j := 0; j < pipelineSize; j++ {
+				key := fmt.Sprintf("key-%d", (i*pipelineSize+j)%10000)
+				pipe.Set(ctx, key, value, 0)
+				pipe.Get(ctx, key)
+			}
+			_, err := pipe.Exec(ctx)
+			return err
+		}))
+	})
+
+	t.Run("HSET on a large hash", func(t *testing.T) {
+		fields := make([]interface{}, 0, 2*pipelineSize)
+		check(t, "hset-large-hash", measure(t, 1000, pipelineSize, func(i int) error {
+			fields = fields[:0]
+			for j := 0; j < pipelineSize; j++ {
+				fields = append(fields, fmt.Sprintf("field-%d", i*pipelineSize+j), "value")
+			}
+			return rdb.HSet(ctx, "large-hash", fields...).Err()
+		}))
+	})
+
+	t.Run("ZADD and ZRANGE", func(t *testing.T) {
+		check(t, "zadd-zrange", measure(t, 1000, pipelineSize+1, func(i int) error {
+			pipe := rdb.Pipeline()
+			for j := 0; j < pipelineSize; j++ {
+				member := fmt.Sprintf("member-%d", i*pipelineSize+j)
+				pipe.ZAdd(ctx, "zset", redis.Z{Score: float64((i*pipelineSize + j) % 1000), Member: member})
+			}
+			pipe.ZRange(ctx, "zset", 0, pipelineSize-1)
+			_, err := pipe.Exec(ctx)
+			return err
+		}))
+	})
+
+	t.Run("XADD and XREAD", func(t *testing.T) {
+		lastID := "0-0"
+		check(t, "xadd-xread", measure(t, 1000, pipelineSize+1, func(i int) error {
+			pipe := rdb.Pipeline()
+			for j := 0; j < pipelineSize; j++ {
+				pipe.XAdd(ctx, &redis.XAddArgs{Stream: "stream", Values: []string{"field", "value"}})
+			}
+			if _, err := pipe.Exec(ctx); err != nil {
+				return err
+			}
+			streams, err := rdb.XRead(ctx, &redis.XReadArgs{Streams: []string{"stream", lastID}, Count: pipelineSize}).Result()
+			if err != nil {
+				return err
+			}
+			messages := streams[0].Messages
+			lastID = messages[len(messages)-1].ID
+			return nil
+		}))
+	})
+
+	t.Run("replication catch-up", func(t *testing.T) {
+		master := util.StartServer(t, map[string]string{})
+		defer master.Close()
+		masterClient := master.NewClient()
+		defer func() { require.NoError(t, masterClient.Close()) }()
+		slave := util.StartServer(t, map[string]string{})
+		defer slave.Close()
+		slaveClient := slave.NewClient()
+		defer func() { require.NoError(t, slaveClient.Close()) }()
+
+		const keys = 100000
+		for i := 0; i < keys/1000; i++ {
+			util.Populate(t, masterClient, fmt.Sprintf("repl-%d-", i), 1000, 64)
+		}
+		// The replica synchronizes the written keys and catches up with the master
+		check(t, "replication-catch-up", measure(t, 1, keys, func(int) error {
+			util.SlaveOf(t, slaveClient, master)
+			waitForOffsetSync(t, masterClient, slaveClient, time.Minute)
+			return nil
+		}))
+	})
+
+	t.Run("slot migration", func(t *testing.T) {
+		srv0 := util.StartServer(t, map[string]string{"cluster-enabled": "yes"})
+		defer srv0.Close()
+		rdb0 := srv0.NewClient()
+		defer func() { require.NoError(t, rdb0.Close()) }()
+		srv1 := util.StartServer(t, map[string]string{"cluster-enabled": "yes"})
+		defer srv1.Close()
+		rdb1 := srv1.NewClient()
+		defer func() { require.NoError(t, rdb1.Close()) }()
+
+		id0 := "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx00"
+		id1 := "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx01"
+		require.NoError(t, rdb0.Do(ctx, "clusterx", "SETNODEID", id0).Err())
+		require.NoError(t, rdb1.Do(ctx, "clusterx", "SETNODEID", id1).Err())
+		clusterNodes := fmt.Sprintf("%s %s %d master - 0-10000\n", id0, srv0.Host(), srv0.Port())
+		clusterNodes += fmt.Sprintf("%s %s %d master - 10001-16383", id1, srv1.Host(), srv1.Port())
+		require.NoError(t, rdb0.Do(ctx, "clusterx", "SETNODES", clusterNodes, "1").Err())
+		require.NoError(t, rdb1.Do(ctx, "clusterx", "SETNODES", clusterNodes, "1").Err())
+
+		const slot, keys = 1, 100000
+		for i := 0; i < keys/1000; i++ {
+			util.Populate(t, rdb0, fmt.Sprintf("{%s}-%d-", util.SlotTable[slot], i), 1000, 64)
+		}
+		check(t, "slot-migration", measure(t, 1, keys, func(int) error {
+			if err := rdb0.Do(ctx, "clusterx", "migrate", slot, id1).Err(); err != nil {
+				return err
+			}
+			require.Eventually(t, func() bool {
+				return strings.Contains(rdb0.ClusterInfo(ctx).Val(), "migrating_state: success")
+			}, time.Minute, 10*time.Millisecond)
+			return nil
+		}))
+	})
+}
+
+func waitForOffsetSync(t testing.TB, master, slave *redis.Client, timeout time.Duration) {
+	require.Eventually(t, func() bool {
+		return util.FindInfoEntry(slave, "master_link_status") == "up" &&
+			util.FindInfoEntry(master, "master_repl_offset") == util.FindInfoEntry(slave, "master_repl_offset")
+	}, timeout, 10*time.Millisecond)
+}
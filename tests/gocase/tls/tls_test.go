@@ -136,3 +136,42 @@ func TestTLS(t *testing.T) {
 		require.NoError(t, rdb.ConfigSet(ctx, "tls-ciphers", "DEFAULT").Err())
 	})
 }
+
+func TestTLSHandshakeThreads(t *testing.T) {
+	if !util.TLSEnable() {
+		t.Skip("TLS tests run only if tls enabled.")
+	}
+
+	ctx := context.Background()
+
+	srv := util.StartTLSServer(t, map[string]string{"tls-handshake-threads": "2", "tls-session-caching": "no"})
+	defer srv.Close()
+
+	t.Run("TLS: The connections are served after the offloaded handshakes", func(t *testing.T) {
+		tlsConfig, err := util.DefaultTLSConfig()
+		require.NoError(t, err)
+		for i := 0; i < 10; i++ {
+			c := srv.NewClientWithOption(&redis.Options{TLSConfig: tlsConfig, Addr: srv.TLSAddr()})
+			require.Equal(t, "PONG", c.Ping(ctx).Val())
+			require.NoError(t, c.Close())
+		}
+	})
+
+	t.Run("TLS: The sessions are resumed by the session tickets", func(t *testing.T) {
+		tlsConfig, err := util.DefaultTLSConfig()
+		require.NoError(t, err)
+		tlsConfig.ClientSessionCache = tls.NewLRUClientSessionCache(8)
+
+		c := srv.NewTCPTLSClient(tlsConfig)
+		require.NoError(t, c.WriteArgs("PING"))
+		c.MustRead(t, "+PONG")
+		require.False(t, c.TLSState().DidResume)
+		require.NoError(t, c.Close())
+
+		c = srv.NewTCPTLSClient(tlsConfig)
+		require.NoError(t, c.WriteArgs("PING"))
+		c.MustRead(t, "+PONG")
+		require.True(t, c.TLSState().DidResume)
+		require.NoError(t, c.Close())
+	})
+}
@@ -0,0 +1,62 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package cachewarmer
+
+import (
+	"context"
+	"fmt"
+	"strings"
+	"testing"
+	"time"
+
+	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/stretchr/testify/require"
+)
+
+func TestCacheWarmer(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"cache-warmup-keys": "100"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("Prefetch the hot keys dumped before the restart", func(t *testing.T) {
+		for i := 0; i < 100; i++ {
+			require.NoError(t, rdb.HSet(ctx, fmt.Sprintf("hash%d", i), "field", "value").Err())
+		}
+		for j := 0; j < 32; j++ {
+			for i := 0; i < 100; i++ {
+				require.Equal(t, "value", rdb.HGet(ctx, fmt.Sprintf("hash%d", i), "field").Val())
+			}
+		}
+		require.Equal(t, "0/0", util.FindInfoEntry(rdb, "cache_warmup_progress", "rocksdb"))
+
+		srv.Restart()
+		require.Eventually(t, func() bool {
+			return util.FindInfoEntry(rdb, "is_cache_warming", "rocksdb") == "no"
+		}, 5*time.Second, 100*time.Millisecond)
+		progress := strings.Split(util.FindInfoEntry(rdb, "cache_warmup_progress", "rocksdb"), "/")
+		require.Len(t, progress, 2)
+		require.Equal(t, progress[1], progress[0])
+		require.NotEqual(t, "0", progress[0])
+		require.Equal(t, "value", rdb.HGet(ctx, "hash0", "field").Val())
+	})
+}
@@ -0,0 +1,152 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package cdc
+
+import (
+	"context"
+	"strconv"
+	"testing"
+
+	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/stretchr/testify/require"
+)
+
+// readValue reads a RESP value, the integers are read as strings and the arrays as []interface{}
+func readValue(t *testing.T, c *util.TCPClient) interface{} {
+	line, err := c.ReadLine()
+	require.NoError(t, err)
+	require.NotEmpty(t, line)
+	switch line[0] {
+	case ':', '+':
+		return line[1:]
+	case '$':
+		n, err := strconv.Atoi(line[1:])
+		require.NoError(t, err)
+		b, err := c.ReadBytes(n + 2)
+		require.NoError(t, err)
+		return string(b[:n])
+	case '*':
+		n, err := strconv.Atoi(line[1:])
+		require.NoError(t, err)
+		values := make([]interface{}, 0, n)
+		for i := 0; i < n; i++ {
+			values = append(values, readValue(t, c))
+		}
+		return values
+	default:
+		require.Failf(t, "unexpected reply", "reply: %s", line)
+	}
+	return nil
+}
+
+func readChange(t *testing.T, c *util.TCPClient) (uint64, string, []interface{}) {
+	change, ok := readValue(t, c).([]interface{})
+	require.True(t, ok)
+	require.Len(t, change, 4)
+	require.Equal(t, "cdc", change[0])
+	seq, err := strconv.ParseUint(change[1].(string), 10, 64)
+	require.NoError(t, err)
+	return seq, change[2].(string), change[3].([]interface{})
+}
+
+func TestCDCSubscribe(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("Stream the changes as the commands", func(t *testing.T) {
+		c := srv.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.NoError(t, c.WriteArgs("CDC", "SUBSCRIBE"))
+		c.MustRead(t, "+OK")
+
+		require.NoError(t, rdb.Set(ctx, "cdc-str", "v1", 0).Err())
+		require.NoError(t, rdb.HSet(ctx, "cdc-hash", "f1", "v1").Err())
+
+		seq, ns, commands := readChange(t, c)
+		require.Equal(t, "__namespace", ns)
+		require.Equal(t, []interface{}{[]interface{}{"SET", "cdc-str", "v1"}}, commands)
+
+		nextSeq, _, commands := readChange(t, c)
+		require.Greater(t, nextSeq, seq)
+		require.Equal(t, []interface{}{[]interface{}{"HSET", "cdc-hash", "f1", "v1"}}, commands)
+	})
+
+	t.Run("Filter the changes by the types", func(t *testing.T) {
+		c := srv.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.NoError(t, c.WriteArgs("CDC", "SUBSCRIBE", "TYPES", "hash", "set"))
+		c.MustRead(t, "+OK")
+
+		require.NoError(t, rdb.Set(ctx, "cdc-str", "v2", 0).Err())
+		require.NoError(t, rdb.SAdd(ctx, "cdc-set", "m1").Err())
+
+		_, _, commands := readChange(t, c)
+		require.Equal(t, []interface{}{[]interface{}{"SADD", "cdc-set", "m1"}}, commands)
+	})
+
+	t.Run("Resume from the sequence of the last change", func(t *testing.T) {
+		c := srv.NewTCPClient()
+		require.NoError(t, c.WriteArgs("CDC", "SUBSCRIBE"))
+		c.MustRead(t, "+OK")
+		require.NoError(t, rdb.Set(ctx, "cdc-resume", "v1", 0).Err())
+		seq, _, _ := readChange(t, c)
+		require.NoError(t, c.Close())
+
+		require.NoError(t, rdb.Set(ctx, "cdc-resume", "v2", 0).Err())
+		c = srv.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.NoError(t, c.WriteArgs("CDC", "SUBSCRIBE", "FROM", strconv.FormatUint(seq+1, 10)))
+		c.MustRead(t, "+OK")
+		_, _, commands := readChange(t, c)
+		require.Equal(t, []interface{}{[]interface{}{"SET", "cdc-resume", "v2"}}, commands)
+	})
+
+	t.Run("Stream the raw write batches", func(t *testing.T) {
+		c := srv.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.NoError(t, c.WriteArgs("CDC", "SUBSCRIBE", "NS", "__namespace", "FORMAT", "binary"))
+		c.MustRead(t, "+OK")
+		require.NoError(t, rdb.Set(ctx, "cdc-binary", "value", 0).Err())
+		change, ok := readValue(t, c).([]interface{})
+		require.True(t, ok)
+		require.Len(t, change, 3)
+		require.Equal(t, "cdc", change[0])
+		require.Contains(t, change[2], "cdc-binary")
+	})
+
+	t.Run("Subscribe with the invalid arguments", func(t *testing.T) {
+		require.ErrorContains(t, rdb.Do(ctx, "CDC", "SUBSCRIBE", "FROM", "100000000").Err(), "sequence out of range")
+		require.ErrorContains(t, rdb.Do(ctx, "CDC", "SUBSCRIBE", "TYPES", "unknown").Err(), "unknown type")
+		require.ErrorContains(t, rdb.Do(ctx, "CDC", "SUBSCRIBE", "FORMAT", "json").Err(), "FORMAT must be")
+		require.ErrorContains(t, rdb.Do(ctx, "CDC", "UNSUBSCRIBE").Err(), "CDC subcommand")
+	})
+
+	t.Run("The subscribers are shown in the replication info", func(t *testing.T) {
+		c := srv.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.NoError(t, c.WriteArgs("CDC", "SUBSCRIBE"))
+		c.MustRead(t, "+OK")
+		require.Regexp(t, "cdc_subscribers:[1-9]", rdb.Info(ctx, "replication").Val())
+	})
+}
@@ -0,0 +1,97 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package coalesce
+
+import (
+	"context"
+	"strconv"
+	"testing"
+
+	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/go-redis/redis/v9"
+	"github.com/stretchr/testify/require"
+)
+
+func TestReadCoalescing(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"workers": "1", "read-coalesce-window-ms": "10000"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	coalesced := func() int {
+		v, err := strconv.Atoi(util.FindInfoEntry(rdb, "coalesced_cmds", "stats"))
+		require.NoError(t, err)
+		return v
+	}
+
+	t.Run("Share the reply of the same reads", func(t *testing.T) {
+		require.NoError(t, rdb.HSet(ctx, "hash", "f1", "v1", "f2", "v2").Err())
+		before := coalesced()
+		for i := 0; i < 10; i++ {
+			require.Equal(t, map[string]string{"f1": "v1", "f2": "v2"}, rdb.HGetAll(ctx, "hash").Val())
+		}
+		require.GreaterOrEqual(t, coalesced()-before, 9)
+	})
+
+	t.Run("Share the reply of the same collection reads", func(t *testing.T) {
+		require.NoError(t, rdb.RPush(ctx, "list", "a", "b").Err())
+		require.NoError(t, rdb.SAdd(ctx, "set", "m1").Err())
+		require.NoError(t, rdb.ZAdd(ctx, "zset", redis.Z{Score: 1, Member: "m1"}).Err())
+		before := coalesced()
+		for i := 0; i < 5; i++ {
+			require.Equal(t, []string{"a", "b"}, rdb.LRange(ctx, "list", 0, -1).Val())
+			require.Equal(t, []string{"m1"}, rdb.SMembers(ctx, "set").Val())
+			require.Equal(t, []string{"m1"}, rdb.ZRange(ctx, "zset", 0, -1).Val())
+			require.Equal(t, []string{"f1", "f2"}, rdb.HKeys(ctx, "hash").Val())
+		}
+		require.GreaterOrEqual(t, coalesced()-before, 16)
+	})
+
+	t.Run("Drop the reply once the key was written", func(t *testing.T) {
+		require.NoError(t, rdb.Set(ctx, "str", "v1", 0).Err())
+		require.Equal(t, "v1", rdb.Get(ctx, "str").Val())
+		require.NoError(t, rdb.Set(ctx, "str", "v2", 0).Err())
+		require.Equal(t, "v2", rdb.Get(ctx, "str").Val())
+		require.NoError(t, rdb.HDel(ctx, "hash", "f1").Err())
+		require.Equal(t, map[string]string{"f2": "v2"}, rdb.HGetAll(ctx, "hash").Val())
+		require.NoError(t, rdb.FlushDB(ctx).Err())
+		require.Equal(t, "", rdb.Get(ctx, "str").Val())
+	})
+
+	t.Run("Drop the reply of the written keys of other clients", func(t *testing.T) {
+		c := srv.NewClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.NoError(t, rdb.Set(ctx, "str", "v1", 0).Err())
+		require.Equal(t, "v1", rdb.Get(ctx, "str").Val())
+		require.NoError(t, c.Append(ctx, "str", "x").Err())
+		require.Equal(t, "v1x", rdb.Get(ctx, "str").Val())
+	})
+
+	t.Run("Disable the coalescing by CONFIG SET", func(t *testing.T) {
+		require.NoError(t, rdb.ConfigSet(ctx, "read-coalesce-window-ms", "0").Err())
+		before := coalesced()
+		for i := 0; i < 3; i++ {
+			require.Equal(t, "v1x", rdb.Get(ctx, "str").Val())
+		}
+		require.Equal(t, before, coalesced())
+	})
+}
@@ -21,15 +21,19 @@ package config
 
 import (
 	"context"
+	"fmt"
 	"log"
 	"os"
 	"sort"
+	"strconv"
+	"strings"
 	"testing"
 	"time"
 
 	"path/filepath"
 
 	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/go-redis/redis/v9"
 	"github.com/stretchr/testify/require"
 )
 
@@ -109,3 +113,110 @@ func TestSetConfigBackupDir(t *testing.T) {
 	require.True(t, hasCompactionFiles(newBackupDir))
 	require.True(t, hasCompactionFiles(originBackupDir))
 }
+
+func TestResizeWorkers(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"workers": "1"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	countWorkers := func() int {
+		n := 0
+		for util.FindInfoEntry(rdb, fmt.Sprintf("worker%d", n), "clients") != "" {
+			n++
+		}
+		return n
+	}
+	clientIDs := func() []string {
+		var ids []string
+		for _, line := range strings.Split(rdb.ClientList(ctx).Val(), "\n") {
+			if fields := strings.Fields(line); len(fields) > 0 {
+				ids = append(ids, fields[0])
+			}
+		}
+		sort.Strings(ids)
+		return ids
+	}
+
+	var clients []*redis.Client
+	defer func() {
+		for _, c := range clients {
+			require.NoError(t, c.Close())
+		}
+	}()
+	openClients := func(n int) {
+		for i := 0; i < n; i++ {
+			c := srv.NewClient()
+			require.NoError(t, c.Ping(ctx).Err())
+			clients = append(clients, c)
+		}
+	}
+	openClients(4)
+
+	t.Run("start the new workers by CONFIG SET", func(t *testing.T) {
+		require.NoError(t, rdb.ConfigSet(ctx, "workers", "4").Err())
+		require.Equal(t, 4, countWorkers())
+		require.Equal(t, map[string]string{"workers": "4"}, rdb.ConfigGet(ctx, "workers").Val())
+		// The new workers accept the connections as well
+		openClients(16)
+		for _, c := range clients {
+			require.NoError(t, c.Set(ctx, "resize-key", "value", 0).Err())
+		}
+	})
+
+	t.Run("retire the workers without closing the clients", func(t *testing.T) {
+		ids := clientIDs()
+		stop := make(chan struct{})
+		done := make(chan error)
+		go func() {
+			c := clients[len(clients)-1]
+			for {
+				select {
+				case <-stop:
+					done <- nil
+					return
+				default:
+				}
+				if err := c.Incr(ctx, "resize-counter").Err(); err != nil {
+					done <- err
+					return
+				}
+			}
+		}()
+
+		require.NoError(t, rdb.ConfigSet(ctx, "workers", "1").Err())
+		require.Eventually(t, func() bool { return countWorkers() == 1 }, 5*time.Second, 100*time.Millisecond)
+		close(stop)
+		require.NoError(t, <-done)
+
+		for _, c := range clients {
+			require.Equal(t, "value", c.Get(ctx, "resize-key").Val())
+		}
+		require.Equal(t, ids, clientIDs())
+		require.Equal(t, strconv.Itoa(len(clients)+1), util.FindInfoEntry(rdb, "connected_clients", "clients"))
+	})
+
+	t.Run("the retiring worker keeps the subscribers until they're closed", func(t *testing.T) {
+		require.NoError(t, rdb.ConfigSet(ctx, "workers", "2").Err())
+		var subscribers []*redis.PubSub
+		for i := 0; i < 8; i++ {
+			c := srv.NewClient()
+			clients = append(clients, c)
+			subscriber := c.Subscribe(ctx, "resize-channel")
+			_, err := subscriber.Receive(ctx)
+			require.NoError(t, err)
+			subscribers = append(subscribers, subscriber)
+		}
+		require.NoError(t, rdb.ConfigSet(ctx, "workers", "1").Err())
+		require.EqualValues(t, len(subscribers), rdb.Publish(ctx, "resize-channel", "hello").Val())
+		for _, subscriber := range subscribers {
+			msg, err := subscriber.ReceiveMessage(ctx)
+			require.NoError(t, err)
+			require.Equal(t, "hello", msg.Payload)
+			require.NoError(t, subscriber.Close())
+		}
+		require.Eventually(t, func() bool { return countWorkers() == 1 }, 5*time.Second, 100*time.Millisecond)
+	})
+}
@@ -22,6 +22,7 @@ package expire
 import (
 	"context"
 	"sort"
+	"strconv"
 	"testing"
 	"time"
 
@@ -217,3 +218,32 @@ func TestExpire(t *testing.T) {
 	})
 
 }
+
+func TestActiveExpire(t *testing.T) {
+	svr := util.StartServer(t, map[string]string{"active-expire-enabled": "yes"})
+	defer svr.Close()
+
+	ctx := context.Background()
+	rdb := svr.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	getStat := func(name string) int {
+		v, err := strconv.Atoi(util.FindInfoEntry(rdb, name, "stats"))
+		require.NoError(t, err)
+		return v
+	}
+
+	t.Run("Expired keys are deleted actively", func(t *testing.T) {
+		expired := getStat("active_expired_keys")
+		require.NoError(t, rdb.Set(ctx, "foo", "bar", time.Second).Err())
+		require.NoError(t, rdb.HSet(ctx, "hash", "f", "v").Err())
+		require.NoError(t, rdb.Expire(ctx, "hash", time.Second).Err())
+		require.NoError(t, rdb.Set(ctx, "persisted", "bar", time.Second).Err())
+		require.True(t, rdb.Persist(ctx, "persisted").Val())
+		require.Eventually(t, func() bool {
+			return getStat("active_expired_keys") == expired+2
+		}, 5*time.Second, 100*time.Millisecond)
+		require.Equal(t, "bar", rdb.Get(ctx, "persisted").Val())
+		require.Greater(t, getStat("active_expire_last_timestamp"), 0)
+	})
+}
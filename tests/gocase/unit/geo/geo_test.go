@@ -134,6 +134,37 @@ func TestGeo(t *testing.T) {
 		require.EqualValues(t, []redis.GeoLocation([]redis.GeoLocation{{Name: "wtc one", Longitude: 0, Latitude: 0, Dist: 0, GeoHash: 0}, {Name: "union square", Longitude: 0, Latitude: 0, Dist: 0, GeoHash: 0}, {Name: "central park n/q/r", Longitude: 0, Latitude: 0, Dist: 0, GeoHash: 0}, {Name: "4545", Longitude: 0, Latitude: 0, Dist: 0, GeoHash: 0}, {Name: "lic market", Longitude: 0, Latitude: 0, Dist: 0, GeoHash: 0}}), rdb.GeoRadiusByMember(ctx, "nyc", "wtc one", &redis.GeoRadiusQuery{Radius: 7, Unit: "km"}).Val())
 	})
 
+	t.Run("GEOSEARCH FROMLONLAT BYRADIUS (sorted)", func(t *testing.T) {
+		require.EqualValues(t, []interface{}{"central park n/q/r", "4545", "union square"},
+			rdb.Do(ctx, "GEOSEARCH", "nyc", "FROMLONLAT", -73.9798091, 40.7598464, "BYRADIUS", 3, "km", "ASC").Val())
+		require.EqualValues(t, []interface{}{"union square", "4545", "central park n/q/r"},
+			rdb.Do(ctx, "GEOSEARCH", "nyc", "FROMLONLAT", -73.9798091, 40.7598464, "BYRADIUS", 3, "km", "DESC").Val())
+	})
+
+	t.Run("GEOSEARCH with COUNT", func(t *testing.T) {
+		require.EqualValues(t, []interface{}{"central park n/q/r", "4545"},
+			rdb.Do(ctx, "GEOSEARCH", "nyc", "FROMLONLAT", -73.9798091, 40.7598464, "BYRADIUS", 10, "km", "COUNT", 2).Val())
+		require.Len(t, rdb.Do(ctx, "GEOSEARCH", "nyc", "FROMLONLAT", -73.9798091, 40.7598464, "BYRADIUS", 10, "km", "COUNT", 2, "ANY").Val(), 2)
+		require.ErrorContains(t, rdb.Do(ctx, "GEOSEARCH", "nyc", "FROMLONLAT", -73.9798091, 40.7598464, "BYRADIUS", 10, "km", "COUNT", 0).Err(), "COUNT must be > 0")
+	})
+
+	t.Run("GEOSEARCH BYBOX", func(t *testing.T) {
+		require.EqualValues(t, []interface{}{"central park n/q/r", "4545", "lic market"},
+			rdb.Do(ctx, "GEOSEARCH", "nyc", "FROMLONLAT", -73.9798091, 40.7598464, "BYBOX", 6, 4, "km", "ASC").Val())
+	})
+
+	t.Run("GEOSEARCH FROMMEMBER", func(t *testing.T) {
+		require.EqualValues(t, []interface{}{"wtc one", "union square"},
+			rdb.Do(ctx, "GEOSEARCH", "nyc", "FROMMEMBER", "wtc one", "BYRADIUS", 7, "km", "ASC", "COUNT", 2).Val())
+		require.Error(t, rdb.Do(ctx, "GEOSEARCH", "nyc", "FROMMEMBER", "no such member", "BYRADIUS", 7, "km").Err())
+		require.EqualValues(t, []interface{}{}, rdb.Do(ctx, "GEOSEARCH", "no_such_key", "FROMMEMBER", "wtc one", "BYRADIUS", 7, "km").Val())
+	})
+
+	t.Run("GEOSEARCH invalid arguments", func(t *testing.T) {
+		require.ErrorContains(t, rdb.Do(ctx, "GEOSEARCH", "nyc", "FROMMEMBER", "wtc one", "FROMLONLAT", -73.9798091, 40.7598464, "BYRADIUS", 7, "km").Err(), "exactly one of FROMMEMBER or FROMLONLAT")
+		require.ErrorContains(t, rdb.Do(ctx, "GEOSEARCH", "nyc", "FROMMEMBER", "wtc one", "BYRADIUS", 7, "km", "BYBOX", 1, 1, "km").Err(), "exactly one of BYRADIUS and BYBOX")
+	})
+
 	t.Run("GEOHASH is able to return geohash strings", func(t *testing.T) {
 		require.NoError(t, rdb.Del(ctx, "points").Err())
 		require.NoError(t, rdb.GeoAdd(ctx, "points", &redis.GeoLocation{Name: "test", Longitude: -5.6, Latitude: 42.6}).Err())
@@ -22,7 +22,10 @@ package info
 import (
 	"context"
 	"fmt"
+	"os"
+	"path/filepath"
 	"strconv"
+	"strings"
 	"testing"
 	"time"
 
@@ -65,6 +68,43 @@ func TestInfo(t *testing.T) {
 		require.Greater(t, MustAtoi(t, r), 0)
 	})
 
+	t.Run("get connections stats of workers by INFO", func(t *testing.T) {
+		c := srv.NewClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.NoError(t, c.Ping(ctx).Err())
+
+		accepted, connected := 0, 0
+		for i := 0; ; i++ {
+			entry := util.FindInfoEntry(rdb, fmt.Sprintf("worker%d", i), "clients")
+			if entry == "" {
+				break
+			}
+			var workerAccepted, workerRejected, workerConnected int
+			_, err := fmt.Sscanf(entry, "accepted=%d,rejected=%d,connected=%d",
+				&workerAccepted, &workerRejected, &workerConnected)
+			require.NoError(t, err)
+			accepted += workerAccepted
+			connected += workerConnected
+		}
+		require.GreaterOrEqual(t, accepted, 2)
+		require.Equal(t, MustAtoi(t, util.FindInfoEntry(rdb, "connected_clients", "clients")), connected)
+	})
+
+	t.Run("get command latency percentiles by INFO commandstats", func(t *testing.T) {
+		for i := 0; i < 10; i++ {
+			require.NoError(t, rdb.Set(ctx, "info-key", "value", 0).Err())
+		}
+		entry := util.FindInfoEntry(rdb, "cmdstat_set", "commandstats")
+		var calls, usec, p50, p99, p999 int
+		var usecPerCall float64
+		_, err := fmt.Sscanf(entry, "calls=%d,usec=%d,usec_per_call=%g,p50=%d,p99=%d,p999=%d",
+			&calls, &usec, &usecPerCall, &p50, &p99, &p999)
+		require.NoError(t, err)
+		require.GreaterOrEqual(t, calls, 10)
+		require.LessOrEqual(t, p50, p99)
+		require.LessOrEqual(t, p99, p999)
+	})
+
 	t.Run("get bgsave information by INFO", func(t *testing.T) {
 		require.Equal(t, "0", util.FindInfoEntry(rdb, "bgsave_in_progress", "persistence"))
 		require.Equal(t, "-1", util.FindInfoEntry(rdb, "last_bgsave_time", "persistence"))
@@ -88,4 +128,213 @@ func TestInfo(t *testing.T) {
 		require.GreaterOrEqual(t, lastBgsaveTimeSec, 0)
 		require.Less(t, lastBgsaveTimeSec, 3)
 	})
+
+	t.Run("get the stats of the background tasks by INFO taskstats", func(t *testing.T) {
+		require.NoError(t, rdb.Do(ctx, "dbsize", "scan").Err())
+		require.Eventually(t, func() bool {
+			return util.FindInfoEntry(rdb, "taskstat_scan_dbsize", "taskstats") != ""
+		}, 5*time.Second, 100*time.Millisecond)
+		require.Equal(t, "0", util.FindInfoEntry(rdb, "pending_tasks", "taskstats"))
+		entry := util.FindInfoEntry(rdb, "taskstat_bgsave", "taskstats")
+		var calls, cancelled, waitUsec, waitUsecPerCall, maxWaitUsec, runUsec, runUsecPerCall, maxRunUsec int
+		_, err := fmt.Sscanf(entry, "calls=%d,cancelled=%d,wait_usec=%d,wait_usec_per_call=%d,max_wait_usec=%d,"+
+			"run_usec=%d,run_usec_per_call=%d,max_run_usec=%d", &calls, &cancelled, &waitUsec, &waitUsecPerCall,
+			&maxWaitUsec, &runUsec, &runUsecPerCall, &maxRunUsec)
+		require.NoError(t, err)
+		require.Equal(t, 1, calls)
+		require.Equal(t, 0, cancelled)
+		require.LessOrEqual(t, runUsecPerCall, maxRunUsec)
+	})
+}
+
+func TestInfoJobStats(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("get the stats of the flushes and the compactions by INFO rocksdb", func(t *testing.T) {
+		for i := 0; i < 100; i++ {
+			require.NoError(t, rdb.Set(ctx, fmt.Sprintf("job-key-%d", i), "value", 0).Err())
+		}
+		require.NoError(t, rdb.Do(ctx, "compact").Err())
+		var flushes, flushedBytes, flushUsec, p50, p99 int
+		require.Eventually(t, func() bool {
+			entry := util.FindInfoEntry(rdb, `flush_stats\[metadata\]`, "rocksdb")
+			_, err := fmt.Sscanf(entry, "count=%d,bytes=%d,usec=%d,p50_usec=%d,p99_usec=%d",
+				&flushes, &flushedBytes, &flushUsec, &p50, &p99)
+			return err == nil && flushes > 0
+		}, 5*time.Second, 100*time.Millisecond)
+		require.Greater(t, flushedBytes, 0)
+		require.LessOrEqual(t, p50, p99)
+
+		require.NotEmpty(t, util.FindInfoEntry(rdb, `compaction_stats\[metadata\]`, "rocksdb"))
+		writeAmp, err := strconv.ParseFloat(util.FindInfoEntry(rdb, `write_amplification\[metadata\]`, "rocksdb"), 64)
+		require.NoError(t, err)
+		require.GreaterOrEqual(t, writeAmp, 1.0)
+		require.Regexp(t, `^current=\d+,p50=\d+,p99=\d+,max=\d+$`, util.FindInfoEntry(rdb, `level0_files\[metadata\]`, "rocksdb"))
+		require.Regexp(t, `^delayed=\d+,stopped=\d+,`, util.FindInfoEntry(rdb, `write_stall_stats\[metadata\]`, "rocksdb"))
+	})
+}
+
+func TestInfoPerfStats(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"perf-stats-sample-interval": "1"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("get the sampled perf context of the commands by INFO perfstats", func(t *testing.T) {
+		for i := 0; i < 10; i++ {
+			require.NoError(t, rdb.Set(ctx, "perf-key", "value", 0).Err())
+			require.NoError(t, rdb.Get(ctx, "perf-key").Err())
+		}
+		entry := util.FindInfoEntry(rdb, "perfstat_set", "perfstats")
+		var samples int
+		var blockCacheHits, blockReads, blockReadBytes, bytesRead, seeks, getFromMemtable, writeWAL float64
+		_, err := fmt.Sscanf(entry, "samples=%d,block_cache_hits_per_call=%g,block_reads_per_call=%g,"+
+			"block_read_bytes_per_call=%g,bytes_read_per_call=%g,seeks_per_call=%g,"+
+			"get_from_memtable_usec_per_call=%g,write_wal_usec_per_call=%g", &samples, &blockCacheHits,
+			&blockReads, &blockReadBytes, &bytesRead, &seeks, &getFromMemtable, &writeWAL)
+		require.NoError(t, err)
+		require.GreaterOrEqual(t, samples, 10)
+		require.NotEmpty(t, util.FindInfoEntry(rdb, "perfstat_get", "perfstats"))
+
+		require.NoError(t, rdb.ConfigSet(ctx, "perf-stats-sample-interval", "0").Err())
+		require.NoError(t, rdb.Do(ctx, "ping").Err())
+		require.Empty(t, util.FindInfoEntry(rdb, "perfstat_ping", "perfstats"))
+	})
+}
+
+func TestInfoMemtableBudget(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"rocksdb.memtable_total_budget": "1"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("flush the memtables once they exceed the budget", func(t *testing.T) {
+		require.Equal(t, strconv.Itoa(1024*1024), util.FindInfoEntry(rdb, "memtable_total_budget", "rocksdb"))
+		value := strings.Repeat("x", 2048)
+		for i := 0; i < 2048; i++ {
+			require.NoError(t, rdb.HSet(ctx, "hash", fmt.Sprintf("field%d", i), value).Err())
+		}
+		require.Eventually(t, func() bool {
+			return util.FindInfoEntry(rdb, "flush_count", "rocksdb") != "0"
+		}, 5*time.Second, 100*time.Millisecond)
+		budgetUsage, err := strconv.Atoi(util.FindInfoEntry(rdb, "memtable_budget_usage", "rocksdb"))
+		require.NoError(t, err)
+		require.Less(t, budgetUsage, 4*1024*1024)
+		require.EqualValues(t, 2048, rdb.HLen(ctx, "hash").Val())
+	})
+}
+
+func TestInfoIncrementalBackup(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"backup-incremental": "yes", "backup-threads": "2"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	bgsave := func() (int, int) {
+		require.NoError(t, rdb.Do(ctx, "bgsave").Err())
+		require.Eventually(t, func() bool {
+			return util.FindInfoEntry(rdb, "bgsave_in_progress", "persistence") == "0"
+		}, 5*time.Second, 100*time.Millisecond)
+		require.Equal(t, "ok", util.FindInfoEntry(rdb, "last_bgsave_status", "persistence"))
+		size, err := strconv.Atoi(util.FindInfoEntry(rdb, "last_bgsave_size", "persistence"))
+		require.NoError(t, err)
+		copied, err := strconv.Atoi(util.FindInfoEntry(rdb, "last_bgsave_copied_bytes", "persistence"))
+		require.NoError(t, err)
+		return size, copied
+	}
+
+	t.Run("the backups share the unchanged SST files", func(t *testing.T) {
+		value := strings.Repeat("x", 1024)
+		for i := 0; i < 1000; i++ {
+			require.NoError(t, rdb.Set(ctx, fmt.Sprintf("key%d", i), value, 0).Err())
+		}
+		require.NoError(t, rdb.Do(ctx, "compact").Err())
+		require.Eventually(t, func() bool {
+			return util.FindInfoEntry(rdb, "is_compacting", "rocksdb") == "no"
+		}, 10*time.Second, 100*time.Millisecond)
+
+		size, copied := bgsave()
+		require.Greater(t, size, 1000*1024)
+		require.Greater(t, copied, 1000*1024)
+		backupDir := rdb.Do(ctx, "CONFIG", "GET", "backup-dir").Val().([]interface{})[1].(string)
+		_, err := os.Stat(filepath.Join(backupDir, "meta"))
+		require.NoError(t, err)
+
+		size, copied = bgsave()
+		require.Greater(t, size, 1000*1024)
+		require.Less(t, copied, 1000*1024)
+	})
+}
+
+func TestInfoCompression(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{
+		"rocksdb.compression":                       "zstd",
+		"rocksdb.metadata_compression_start_level":  "3",
+		"rocksdb.subkey_compression_max_dict_bytes": "16384",
+		"rocksdb.subkey_zstd_max_train_bytes":       "1638400",
+	})
+	defer srv.Close()
+
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("compression settings of the column families", func(t *testing.T) {
+		require.Equal(t, "no,no,no,zstd,zstd,zstd,zstd",
+			util.FindInfoEntry(rdb, `compression_per_level\[metadata\]`, "rocksdb"))
+		require.Equal(t, "no,no,zstd,zstd,zstd,zstd,zstd",
+			util.FindInfoEntry(rdb, `compression_per_level\[default\]`, "rocksdb"))
+		require.Equal(t, "16384", util.FindInfoEntry(rdb, `compression_max_dict_bytes\[default\]`, "rocksdb"))
+		require.Equal(t, "0", util.FindInfoEntry(rdb, `compression_max_dict_bytes\[metadata\]`, "rocksdb"))
+	})
+}
+
+func TestInfoIORateLimit(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"max-io-mb": "100", "max-io-mb-auto-tune": "yes"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("the tuned limit never exceeds max-io-mb", func(t *testing.T) {
+		require.Equal(t, strconv.Itoa(100*1024*1024), util.FindInfoEntry(rdb, "io_rate_limit_bytes_per_sec", "rocksdb"))
+		require.NoError(t, rdb.ConfigSet(ctx, "max-io-mb", "50").Err())
+		require.Equal(t, strconv.Itoa(50*1024*1024), util.FindInfoEntry(rdb, "io_rate_limit_bytes_per_sec", "rocksdb"))
+		time.Sleep(1500 * time.Millisecond)
+		require.Equal(t, strconv.Itoa(50*1024*1024), util.FindInfoEntry(rdb, "io_rate_limit_bytes_per_sec", "rocksdb"))
+	})
+}
+
+func TestInfoRocksDBRefresh(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"info-rocksdb-refresh-ms": "500"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("the rocksdb section is replied from the collection in background", func(t *testing.T) {
+		require.Eventually(t, func() bool {
+			return util.FindInfoEntry(rdb, "info_rocksdb_age_ms", "rocksdb") != ""
+		}, 5*time.Second, 100*time.Millisecond)
+		age, err := strconv.Atoi(util.FindInfoEntry(rdb, "info_rocksdb_age_ms", "rocksdb"))
+		require.NoError(t, err)
+		require.Less(t, age, 2000)
+		require.NotEmpty(t, util.FindInfoEntry(rdb, `estimate_keys\[metadata\]`, "rocksdb"))
+
+		require.NoError(t, rdb.ConfigSet(ctx, "info-rocksdb-refresh-ms", "0").Err())
+		require.Empty(t, util.FindInfoEntry(rdb, "info_rocksdb_age_ms", "rocksdb"))
+		require.NotEmpty(t, util.FindInfoEntry(rdb, `estimate_keys\[metadata\]`, "rocksdb"))
+	})
 }
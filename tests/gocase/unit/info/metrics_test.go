@@ -0,0 +1,80 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package info
+
+import (
+	"context"
+	"fmt"
+	"io"
+	"net"
+	"net/http"
+	"strings"
+	"testing"
+
+	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/stretchr/testify/require"
+)
+
+func TestPrometheusMetrics(t *testing.T) {
+	lis, err := net.Listen("tcp", "127.0.0.1:0")
+	require.NoError(t, err)
+	port := lis.Addr().(*net.TCPAddr).Port
+	require.NoError(t, lis.Close())
+
+	srv := util.StartServer(t, map[string]string{"metrics-port": fmt.Sprintf("%d", port)})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	scrape := func(t *testing.T, path string) (int, string) {
+		resp, err := http.Get(fmt.Sprintf("http://127.0.0.1:%d%s", port, path))
+		require.NoError(t, err)
+		defer func() { require.NoError(t, resp.Body.Close()) }()
+		body, err := io.ReadAll(resp.Body)
+		require.NoError(t, err)
+		return resp.StatusCode, string(body)
+	}
+
+	t.Run("Scrape the metrics", func(t *testing.T) {
+		require.NoError(t, rdb.Set(ctx, "foo", "bar", 0).Err())
+		require.NoError(t, rdb.Get(ctx, "foo").Err())
+
+		code, body := scrape(t, "/metrics")
+		require.Equal(t, http.StatusOK, code)
+		require.Contains(t, body, "# TYPE kvrocks_commands_total counter\n")
+		require.Contains(t, body, "kvrocks_command_calls_total{cmd=\"set\"} 1\n")
+		require.Contains(t, body, "kvrocks_command_duration_seconds_count{cmd=\"get\"} 1\n")
+		require.Contains(t, body, "kvrocks_command_duration_seconds_bucket{cmd=\"get\",le=\"+Inf\"} 1\n")
+		require.Contains(t, body, "kvrocks_rocksdb_memtable_bytes{cf=\"metadata\"}")
+		require.Contains(t, body, "kvrocks_rocksdb_block_cache_miss_total")
+		require.Contains(t, body, "kvrocks_rocksdb_db_get_micros{quantile=\"0.99\"}")
+		require.Contains(t, body, "kvrocks_is_slave 0\n")
+
+		// Every family is declared only once
+		require.Equal(t, 1, strings.Count(body, "# TYPE kvrocks_command_calls_total "))
+	})
+
+	t.Run("Unknown paths are not found", func(t *testing.T) {
+		code, _ := scrape(t, "/unknown")
+		require.Equal(t, http.StatusNotFound, code)
+	})
+}
@@ -24,6 +24,7 @@ import (
 	"fmt"
 	"strconv"
 	"strings"
+	"sync"
 	"testing"
 	"time"
 
@@ -45,6 +46,38 @@ func TestIntrospection(t *testing.T) {
 		require.Regexp(t, "id=.* addr=.*:.* fd=.* name=.* age=.* idle=.* flags=N namespace=.* qbuf=.* .*obuf=.* cmd=client.*", v)
 	})
 
+	t.Run("CLIENT LIST reports the memory of the queued commands", func(t *testing.T) {
+		c := srv.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.NoError(t, c.WriteArgs("CLIENT", "SETNAME", "multi-mem-client"))
+		c.MustRead(t, "+OK")
+		require.NoError(t, c.WriteArgs("MULTI"))
+		c.MustRead(t, "+OK")
+		require.NoError(t, c.WriteArgs("SET", "foo", strings.Repeat("x", 100*1024)))
+		c.MustRead(t, "+QUEUED")
+
+		multiMem := func() int {
+			for _, line := range strings.Split(rdb.ClientList(ctx).Val(), "\n") {
+				if !strings.Contains(line, "name=multi-mem-client ") {
+					continue
+				}
+				for _, field := range strings.Fields(line) {
+					if strings.HasPrefix(field, "multi-mem=") {
+						n, err := strconv.Atoi(strings.TrimPrefix(field, "multi-mem="))
+						require.NoError(t, err)
+						return n
+					}
+				}
+			}
+			require.Fail(t, "the client isn't listed")
+			return 0
+		}
+		require.GreaterOrEqual(t, multiMem(), 100*1024)
+		require.NoError(t, c.WriteArgs("DISCARD"))
+		c.MustRead(t, "+OK")
+		require.Zero(t, multiMem())
+	})
+
 	t.Run("MONITOR can log executed commands", func(t *testing.T) {
 		c := srv.NewTCPClient()
 		defer func() { require.NoError(t, c.Close()) }()
@@ -56,6 +89,30 @@ func TestIntrospection(t *testing.T) {
 		c.MustMatch(t, ".*get.*foo.*")
 	})
 
+	t.Run("MONITOR can filter the commands and the key prefixes", func(t *testing.T) {
+		c := srv.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.NoError(t, c.WriteArgs("MONITOR", "COMMAND", "SET", "PREFIX", "mon:"))
+		c.MustRead(t, "+OK")
+		require.NoError(t, rdb.Set(ctx, "foo", "bar", 0).Err())
+		require.Equal(t, redis.Nil, rdb.Get(ctx, "mon:foo").Err())
+		require.NoError(t, rdb.Set(ctx, "mon:foo", "bar", 0).Err())
+		c.MustMatch(t, ".*set.*mon:foo.*bar.*")
+	})
+
+	t.Run("MONITOR SAMPLE checks the ratio", func(t *testing.T) {
+		c := srv.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		for _, ratio := range []string{"0", "1.5", "-1", "abc"} {
+			require.NoError(t, c.WriteArgs("MONITOR", "SAMPLE", ratio))
+			c.MustMatch(t, ".*sample ratio.*")
+		}
+		require.NoError(t, c.WriteArgs("MONITOR", "SAMPLE", "1"))
+		c.MustRead(t, "+OK")
+		require.NoError(t, rdb.Set(ctx, "foo", "bar", 0).Err())
+		c.MustMatch(t, ".*set.*foo.*bar.*")
+	})
+
 	t.Run("CLIENT GETNAME should return NIL if name is not assigned", func(t *testing.T) {
 		require.EqualError(t, rdb.ClientGetName(ctx).Err(), redis.Nil.Error())
 	})
@@ -162,6 +219,139 @@ func TestIntrospection(t *testing.T) {
 		}, 5*time.Second, 100*time.Millisecond)
 	})
 
+	t.Run("HOTKEYS lists the most accessed keys", func(t *testing.T) {
+		require.NoError(t, rdb.ConfigSet(ctx, "hotkeys-sample-interval", "1").Err())
+		defer func() { require.NoError(t, rdb.ConfigSet(ctx, "hotkeys-sample-interval", "100").Err()) }()
+		for i := 0; i < 20; i++ {
+			require.NoError(t, rdb.Set(ctx, "hotkeys-hot", "v", 0).Err())
+			require.NoError(t, rdb.Get(ctx, "hotkeys-hot").Err())
+		}
+		require.NoError(t, rdb.Get(ctx, "hotkeys-cold").Err())
+
+		r, err := rdb.Do(ctx, "HOTKEYS", "COUNT", "1").Slice()
+		require.NoError(t, err)
+		require.Len(t, r, 1)
+		require.EqualValues(t, []interface{}{"hotkeys-hot", int64(20), int64(20)}, r[0])
+
+		require.ErrorContains(t, rdb.Do(ctx, "HOTKEYS", "COUNT", "0").Err(), "must be positive")
+		require.NoError(t, rdb.ConfigSet(ctx, "hotkeys-sample-interval", "0").Err())
+		require.ErrorContains(t, rdb.Do(ctx, "HOTKEYS").Err(), "disabled")
+	})
+
+	t.Run("BIGKEYS lists the largest keys of every type", func(t *testing.T) {
+		require.ErrorContains(t, rdb.Do(ctx, "BIGKEYS").Err(), "disabled")
+		require.NoError(t, rdb.ConfigSet(ctx, "bigkeys-scan-rate", "1000").Err())
+		defer func() { require.NoError(t, rdb.ConfigSet(ctx, "bigkeys-scan-rate", "0").Err()) }()
+		require.NoError(t, rdb.HSet(ctx, "bigkeys-hash", "f1", "v1", "f2", "v2", "f3", "v3").Err())
+		require.NoError(t, rdb.HSet(ctx, "bigkeys-small-hash", "f1", "v1").Err())
+
+		r, err := rdb.Do(ctx, "BIGKEYS", "TYPE", "hash", "COUNT", "1").Slice()
+		require.NoError(t, err)
+		require.Len(t, r, 1)
+		entry := r[0].([]interface{})
+		require.Len(t, entry, 4)
+		require.EqualValues(t, []interface{}{"bigkeys-hash", "hash", int64(3)}, entry[:3])
+
+		require.ErrorContains(t, rdb.Do(ctx, "BIGKEYS", "TYPE", "unknown").Err(), "unknown type")
+	})
+
+	t.Run("MEMORY STATS reports the memory of the components", func(t *testing.T) {
+		r, err := rdb.Do(ctx, "MEMORY", "STATS").Slice()
+		require.NoError(t, err)
+		require.Equal(t, 0, len(r)%2)
+		stats := make(map[string]interface{})
+		for i := 0; i < len(r); i += 2 {
+			stats[r[i].(string)] = r[i+1]
+		}
+		for _, name := range []string{"rss", "rocksdb.block-cache.usage", "rocksdb.block-cache.usage[metadata]",
+			"rocksdb.memtables", "rocksdb.table-readers", "clients.input-buffers", "clients.output-buffers",
+			"worker.0.lua", "pubsub.bytes", "blocking.bytes", "replication.backlog"} {
+			require.Contains(t, stats, name)
+		}
+		require.GreaterOrEqual(t, stats["clients"].(int64), int64(1))
+		require.Greater(t, stats["lua.server"].(int64), int64(0))
+
+		require.ErrorContains(t, rdb.Do(ctx, "MEMORY", "DOCTOR").Err(), "MEMORY subcommand")
+	})
+
+	t.Run("MEMORY PROFILE requires the heap profiling of jemalloc", func(t *testing.T) {
+		require.ErrorContains(t, rdb.Do(ctx, "MEMORY", "PROFILE").Err(), "MEMORY subcommand")
+		require.ErrorContains(t, rdb.Do(ctx, "MEMORY", "PROFILE", "START").Err(), "syntax")
+		require.ErrorContains(t, rdb.Do(ctx, "MEMORY", "PROFILE", "ON", "1").Err(), "syntax")
+		// The server isn't started with MALLOC_CONF="prof:true"
+		require.ErrorContains(t, rdb.Do(ctx, "MEMORY", "PROFILE", "ON").Err(), "jemalloc")
+		require.ErrorContains(t, rdb.Do(ctx, "MEMORY", "PROFILE", "DUMP").Err(), "jemalloc")
+	})
+
+	t.Run("LATENCY records the slow events", func(t *testing.T) {
+		require.NoError(t, rdb.Do(ctx, "LATENCY", "RESET").Err())
+		require.NoError(t, rdb.Do(ctx, "DEBUG", "SLEEP", "0.2").Err())
+		r, err := rdb.Do(ctx, "LATENCY", "LATEST").Slice()
+		require.NoError(t, err)
+		require.Len(t, r, 0)
+
+		require.NoError(t, rdb.ConfigSet(ctx, "latency-monitor-threshold", "100").Err())
+		defer func() { require.NoError(t, rdb.ConfigSet(ctx, "latency-monitor-threshold", "0").Err()) }()
+		require.NoError(t, rdb.Do(ctx, "DEBUG", "SLEEP", "0.2").Err())
+		require.NoError(t, rdb.Set(ctx, "latency-key", "value", 0).Err())
+
+		r, err = rdb.Do(ctx, "LATENCY", "LATEST").Slice()
+		require.NoError(t, err)
+		var command []interface{}
+		for _, e := range r {
+			if entry := e.([]interface{}); entry[0] == "command" {
+				command = entry
+			}
+		}
+		require.Len(t, command, 4)
+		require.GreaterOrEqual(t, command[2].(int64), int64(200))
+		require.GreaterOrEqual(t, command[3].(int64), command[2].(int64))
+
+		history, err := rdb.Do(ctx, "LATENCY", "HISTORY", "command").Slice()
+		require.NoError(t, err)
+		require.Len(t, history, 1)
+		require.Equal(t, command[1], history[0].([]interface{})[0])
+
+		require.EqualValues(t, 1, rdb.Do(ctx, "LATENCY", "RESET", "command").Val())
+		history, err = rdb.Do(ctx, "LATENCY", "HISTORY", "command").Slice()
+		require.NoError(t, err)
+		require.Len(t, history, 0)
+		require.ErrorContains(t, rdb.Do(ctx, "LATENCY", "DOCTOR").Err(), "LATENCY subcommand")
+	})
+
+	t.Run("DEBUG LOCKSTATS lists the waited locks with their keys", func(t *testing.T) {
+		require.NoError(t, rdb.Do(ctx, "DEBUG", "LOCKSTATS", "RESET").Err())
+		r, err := rdb.Do(ctx, "DEBUG", "LOCKSTATS").Slice()
+		require.NoError(t, err)
+		require.Len(t, r, 0)
+		require.Contains(t, rdb.Info(ctx, "stats").Val(), "lock_waits:0")
+
+		var wg sync.WaitGroup
+		for i := 0; i < 8; i++ {
+			wg.Add(1)
+			go func() {
+				defer wg.Done()
+				c := srv.NewClient()
+				defer func() { require.NoError(t, c.Close()) }()
+				for j := 0; j < 200; j++ {
+					require.NoError(t, c.Incr(ctx, "lockstats-hot-key").Err())
+				}
+			}()
+		}
+		wg.Wait()
+		// The waits depend on the scheduling, the locks are only listed if they were waited for
+		r, err = rdb.Do(ctx, "DEBUG", "LOCKSTATS", "1").Slice()
+		require.NoError(t, err)
+		require.LessOrEqual(t, len(r), 1)
+		if len(r) == 1 {
+			entry := r[0].([]interface{})
+			require.Len(t, entry, 4)
+			require.Greater(t, entry[1].(int64), int64(0))
+			require.Contains(t, entry[3], "lockstats-hot-key")
+		}
+		require.ErrorContains(t, rdb.Do(ctx, "DEBUG", "LOCKSTATS", "0").Err(), "invalid debug lockstats count")
+	})
+
 	t.Run("DEBUG will freeze server", func(t *testing.T) {
 		// use TCPClient to avoid waiting for reply
 		c := srv.NewTCPClient()
@@ -22,10 +22,12 @@ package keyspace
 import (
 	"context"
 	"sort"
+	"strconv"
 	"testing"
 	"time"
 
 	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/go-redis/redis/v9"
 	"github.com/stretchr/testify/require"
 )
 
@@ -46,6 +48,67 @@ func TestKeyspace(t *testing.T) {
 		require.Equal(t, "", rdb.Get(ctx, key).Val())
 	})
 
+	t.Run("UNLINK reclaims the elements of large keys in background", func(t *testing.T) {
+		require.NoError(t, rdb.ConfigSet(ctx, "lazy-reclaim-min-elements", "100").Err())
+		defer func() { require.NoError(t, rdb.ConfigSet(ctx, "lazy-reclaim-min-elements", "1000").Err()) }()
+		reclaimed := func() int {
+			v, err := strconv.Atoi(util.FindInfoEntry(rdb, "lazy_reclaimed_keys", "stats"))
+			require.NoError(t, err)
+			return v
+		}
+		before := reclaimed()
+		for i := 0; i < 100; i++ {
+			require.NoError(t, rdb.HSet(ctx, "large_hash", "f"+strconv.Itoa(i), "v").Err())
+		}
+		require.NoError(t, rdb.HSet(ctx, "small_hash", "f", "v").Err())
+		require.EqualValues(t, 2, rdb.Unlink(ctx, "large_hash", "small_hash").Val())
+		require.EqualValues(t, 0, rdb.HLen(ctx, "large_hash").Val())
+		require.Eventually(t, func() bool {
+			return reclaimed() == before+1
+		}, 5*time.Second, 100*time.Millisecond)
+		require.NoError(t, rdb.HSet(ctx, "large_hash", "f", "v").Err())
+		require.EqualValues(t, 1, rdb.HLen(ctx, "large_hash").Val())
+		require.NoError(t, rdb.Del(ctx, "large_hash").Err())
+	})
+
+	t.Run("DUMP and RESTORE copy the keys of all types", func(t *testing.T) {
+		require.NoError(t, rdb.RPush(ctx, "dump_list", "a", "b", "c").Err())
+		require.NoError(t, rdb.HSet(ctx, "dump_hash", "f1", "v1", "f2", "v2").Err())
+		require.NoError(t, rdb.ZAdd(ctx, "dump_zset", redis.Z{Score: 1, Member: "a"}, redis.Z{Score: 2, Member: "b"}).Err())
+		require.NoError(t, rdb.Set(ctx, "dump_string", "value", 0).Err())
+		for _, key := range []string{"dump_list", "dump_hash", "dump_zset", "dump_string"} {
+			payload, err := rdb.Dump(ctx, key).Result()
+			require.NoError(t, err)
+			require.NoError(t, rdb.Restore(ctx, key+"_copy", 0, payload).Err())
+		}
+		require.Equal(t, []string{"a", "b", "c"}, rdb.LRange(ctx, "dump_list_copy", 0, -1).Val())
+		require.Equal(t, map[string]string{"f1": "v1", "f2": "v2"}, rdb.HGetAll(ctx, "dump_hash_copy").Val())
+		require.Equal(t, []string{"b"}, rdb.ZRangeByScore(ctx, "dump_zset_copy", &redis.ZRangeBy{Min: "2", Max: "2"}).Val())
+		require.Equal(t, "value", rdb.Get(ctx, "dump_string_copy").Val())
+		require.NoError(t, rdb.Del(ctx, "dump_list", "dump_hash", "dump_zset", "dump_string").Err())
+		require.NoError(t, rdb.Del(ctx, "dump_list_copy", "dump_hash_copy", "dump_zset_copy", "dump_string_copy").Err())
+	})
+
+	t.Run("RESTORE with TTL, REPLACE and a wrong payload", func(t *testing.T) {
+		require.ErrorIs(t, rdb.Dump(ctx, "no_such_key").Err(), redis.Nil)
+		require.NoError(t, rdb.HSet(ctx, "dump_hash", "f", "v").Err())
+		payload := rdb.Dump(ctx, "dump_hash").Val()
+		require.ErrorContains(t, rdb.Restore(ctx, "dump_hash", 0, payload).Err(), "BUSYKEY")
+		require.NoError(t, rdb.HSet(ctx, "dump_hash", "f2", "v2").Err())
+		require.NoError(t, rdb.RestoreReplace(ctx, "dump_hash", 10*time.Second, payload).Err())
+		require.Equal(t, map[string]string{"f": "v"}, rdb.HGetAll(ctx, "dump_hash").Val())
+		util.BetweenValues(t, rdb.TTL(ctx, "dump_hash").Val(), time.Second, 10*time.Second)
+
+		past := strconv.FormatInt(time.Now().Add(-time.Second).UnixMilli(), 10)
+		require.NoError(t, rdb.Do(ctx, "restore", "dump_hash", past, payload, "replace", "absttl").Err())
+		require.EqualValues(t, 0, rdb.Exists(ctx, "dump_hash").Val())
+
+		corrupted := []byte(payload)
+		corrupted[len(corrupted)/2] ^= 1
+		require.ErrorContains(t, rdb.Restore(ctx, "dump_hash", 0, string(corrupted)).Err(), "checksum")
+		require.EqualValues(t, 0, rdb.Exists(ctx, "dump_hash").Val())
+	})
+
 	t.Run("Vararg DEL", func(t *testing.T) {
 		require.NoError(t, rdb.Set(ctx, "foo1", "a", 0).Err())
 		require.NoError(t, rdb.Set(ctx, "foo2", "b", 0).Err())
@@ -65,6 +128,16 @@ func TestKeyspace(t *testing.T) {
 		require.Equal(t, []string{"foo_a", "foo_b", "foo_c"}, keys)
 	})
 
+	t.Run("KEYS with glob pattern", func(t *testing.T) {
+		keys := rdb.Keys(ctx, "foo_[ab]").Val()
+		sort.Strings(keys)
+		require.Equal(t, []string{"foo_a", "foo_b"}, keys)
+		keys = rdb.Keys(ctx, "*_[^xy]").Val()
+		sort.Strings(keys)
+		require.Equal(t, []string{"foo_a", "foo_b", "foo_c", "key_z"}, keys)
+		require.Equal(t, []string{"key_x"}, rdb.Keys(ctx, "key_x").Val())
+	})
+
 	t.Run("KEYS to get all keys", func(t *testing.T) {
 		keys := rdb.Keys(ctx, "*").Val()
 		sort.Slice(keys, func(i, j int) bool {
@@ -117,6 +190,28 @@ func TestKeyspace(t *testing.T) {
 		util.ErrorRegexp(t, rdb.Do(ctx, "foobaredcommand").Err(), "ERR.*")
 	})
 
+	t.Run("FLUSHDB and FLUSHALL ASYNC reclaim the dropped keys in background", func(t *testing.T) {
+		for i := 0; i < 100; i++ {
+			require.NoError(t, rdb.HSet(ctx, "hash"+strconv.Itoa(i), "field", "value").Err())
+		}
+		require.NoError(t, rdb.Do(ctx, "FLUSHDB", "ASYNC").Err())
+		require.EqualValues(t, 0, rdb.Exists(ctx, "hash0").Val())
+		require.Eventually(t, func() bool {
+			return util.FindInfoEntry(rdb, "is_flush_reclaiming") == "no"
+		}, 10*time.Second, 100*time.Millisecond)
+		require.Equal(t, "5/5", util.FindInfoEntry(rdb, "flush_reclaim_progress"))
+
+		require.NoError(t, rdb.Set(ctx, "x", "y", 0).Err())
+		require.NoError(t, rdb.Do(ctx, "FLUSHALL", "ASYNC").Err())
+		require.EqualValues(t, 0, rdb.Exists(ctx, "x").Val())
+		require.Eventually(t, func() bool {
+			return util.FindInfoEntry(rdb, "flush_reclaim_progress") == "11/11"
+		}, 10*time.Second, 100*time.Millisecond)
+
+		require.NoError(t, rdb.Do(ctx, "FLUSHDB", "SYNC").Err())
+		require.ErrorContains(t, rdb.Do(ctx, "FLUSHDB", "LAZY").Err(), "syntax error")
+	})
+
 	t.Run("RANDOMKEY", func(t *testing.T) {
 		rdb.FlushDB(ctx)
 		require.NoError(t, rdb.Set(ctx, "foo", "x", 0).Err())
@@ -196,3 +291,31 @@ func TestKeyspace(t *testing.T) {
 		}
 	})
 }
+
+func TestKeyCountTracking(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"key-count-tracking": "yes"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("DBSIZE is tracked incrementally", func(t *testing.T) {
+		require.NoError(t, rdb.Set(ctx, "a", "1", 0).Err())
+		require.NoError(t, rdb.HSet(ctx, "b", "f1", "v1", "f2", "v2").Err())
+		require.NoError(t, rdb.SAdd(ctx, "c", "m1").Err())
+		// Wait for the counter to be rebuilt after started
+		require.Eventually(t, func() bool {
+			return rdb.DBSize(ctx).Val() == 3
+		}, 5*time.Second, 100*time.Millisecond)
+
+		require.NoError(t, rdb.Set(ctx, "a", "2", 0).Err())
+		require.EqualValues(t, 3, rdb.DBSize(ctx).Val())
+		require.EqualValues(t, 1, rdb.Del(ctx, "a").Val())
+		require.EqualValues(t, 2, rdb.DBSize(ctx).Val())
+		require.EqualValues(t, 1, rdb.SRem(ctx, "c", "m1").Val())
+		require.EqualValues(t, 1, rdb.DBSize(ctx).Val())
+		require.NoError(t, rdb.FlushDB(ctx).Err())
+		require.EqualValues(t, 0, rdb.DBSize(ctx).Val())
+	})
+}
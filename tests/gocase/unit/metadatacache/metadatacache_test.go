@@ -0,0 +1,132 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package metadatacache
+
+import (
+	"context"
+	"strconv"
+	"testing"
+
+	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/go-redis/redis/v9"
+	"github.com/stretchr/testify/require"
+)
+
+func TestMetadataCache(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"metadata-cache-size": "16"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	getStat := func(name string) int {
+		v, err := strconv.Atoi(util.FindInfoEntry(rdb, name, "stats"))
+		require.NoError(t, err)
+		return v
+	}
+
+	t.Run("Hit the cache for the hot keys", func(t *testing.T) {
+		require.NoError(t, rdb.HSet(ctx, "hash", "f1", "v1").Err())
+		hits := getStat("metadata_cache_hits")
+		for i := 0; i < 10; i++ {
+			require.Equal(t, "v1", rdb.HGet(ctx, "hash", "f1").Val())
+		}
+		require.GreaterOrEqual(t, getStat("metadata_cache_hits")-hits, 9)
+		require.Greater(t, getStat("metadata_cache_used_bytes"), 0)
+	})
+
+	t.Run("Keep coherent with writes", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "hash").Err())
+		for i := 0; i < 10; i++ {
+			require.EqualValues(t, i, rdb.HLen(ctx, "hash").Val())
+			require.NoError(t, rdb.HSet(ctx, "hash", "f"+strconv.Itoa(i), "v").Err())
+		}
+		require.EqualValues(t, 10, rdb.HLen(ctx, "hash").Val())
+		require.NoError(t, rdb.Del(ctx, "hash").Err())
+		require.EqualValues(t, 0, rdb.HLen(ctx, "hash").Val())
+
+		require.NoError(t, rdb.ZAdd(ctx, "zset", redis.Z{Score: 1, Member: "a"}).Err())
+		require.EqualValues(t, 1, rdb.ZCard(ctx, "zset").Val())
+		require.NoError(t, rdb.FlushDB(ctx).Err())
+		require.EqualValues(t, 0, rdb.ZCard(ctx, "zset").Val())
+	})
+
+	t.Run("Disable the cache by CONFIG SET", func(t *testing.T) {
+		require.NoError(t, rdb.ConfigSet(ctx, "metadata-cache-size", "0").Err())
+		require.Equal(t, 0, getStat("metadata_cache_used_bytes"))
+		require.NoError(t, rdb.HSet(ctx, "hash", "f1", "v1").Err())
+		hits := getStat("metadata_cache_hits")
+		require.Equal(t, "v1", rdb.HGet(ctx, "hash", "f1").Val())
+		require.Equal(t, hits, getStat("metadata_cache_hits"))
+	})
+}
+
+func TestPipelineReadPrefetch(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"metadata-cache-size": "16", "pipeline-read-prefetch": "yes"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("Serve the pipelined reads from the prefetched keys", func(t *testing.T) {
+		for i := 0; i < 10; i++ {
+			require.NoError(t, rdb.Set(ctx, "str"+strconv.Itoa(i), "v"+strconv.Itoa(i), 0).Err())
+			require.NoError(t, rdb.HSet(ctx, "hash"+strconv.Itoa(i), "f", "v"+strconv.Itoa(i)).Err())
+		}
+		hits, err := strconv.Atoi(util.FindInfoEntry(rdb, "metadata_cache_hits", "stats"))
+		require.NoError(t, err)
+
+		cmds, err := rdb.Pipelined(ctx, func(pipe redis.Pipeliner) error {
+			for i := 0; i < 10; i++ {
+				pipe.Get(ctx, "str"+strconv.Itoa(i))
+				pipe.HGet(ctx, "hash"+strconv.Itoa(i), "f")
+			}
+			pipe.Get(ctx, "missing")
+			return nil
+		})
+		require.ErrorIs(t, err, redis.Nil)
+		for i := 0; i < 10; i++ {
+			require.Equal(t, "v"+strconv.Itoa(i), cmds[2*i].(*redis.StringCmd).Val())
+			require.Equal(t, "v"+strconv.Itoa(i), cmds[2*i+1].(*redis.StringCmd).Val())
+		}
+		require.ErrorIs(t, cmds[20].Err(), redis.Nil)
+
+		newHits, err := strconv.Atoi(util.FindInfoEntry(rdb, "metadata_cache_hits", "stats"))
+		require.NoError(t, err)
+		require.GreaterOrEqual(t, newHits-hits, 20)
+	})
+
+	t.Run("Keep coherent with the writes in the same pipeline", func(t *testing.T) {
+		cmds, err := rdb.Pipelined(ctx, func(pipe redis.Pipeliner) error {
+			pipe.Get(ctx, "str0")
+			pipe.Set(ctx, "str0", "new", 0)
+			pipe.Get(ctx, "str0")
+			pipe.HSet(ctx, "hash0", "f", "new")
+			pipe.HGet(ctx, "hash0", "f")
+			return nil
+		})
+		require.NoError(t, err)
+		require.Equal(t, "v0", cmds[0].(*redis.StringCmd).Val())
+		require.Equal(t, "new", cmds[2].(*redis.StringCmd).Val())
+		require.Equal(t, "new", cmds[4].(*redis.StringCmd).Val())
+	})
+}
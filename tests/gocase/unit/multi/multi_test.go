@@ -22,9 +22,12 @@ package multi
 import (
 	"context"
 	"fmt"
+	"strings"
+	"sync"
 	"testing"
 
 	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/go-redis/redis/v9"
 	"github.com/stretchr/testify/require"
 )
 
@@ -123,6 +126,114 @@ func TestMulti(t *testing.T) {
 		require.Equal(t, "PONG", rdb.Ping(ctx).Val())
 	})
 
+	t.Run("EXEC applies the writes at once and reads its own writes", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "txn_key", "txn_hash").Err())
+		require.NoError(t, rdb.Do(ctx, "MULTI").Err())
+		require.NoError(t, rdb.Do(ctx, "SET", "txn_key", "1").Err())
+		require.NoError(t, rdb.Do(ctx, "INCRBY", "txn_key", "2").Err())
+		require.NoError(t, rdb.Do(ctx, "HSET", "txn_hash", "f1", "v1", "f2", "v2").Err())
+		require.NoError(t, rdb.Do(ctx, "HGETALL", "txn_hash").Err())
+		require.NoError(t, rdb.Do(ctx, "GET", "txn_key").Err())
+		v := rdb.Do(ctx, "EXEC").Val()
+		require.Equal(t, "[OK 3 2 [f1 v1 f2 v2] 3]", fmt.Sprintf("%v", v))
+		require.Equal(t, "3", rdb.Get(ctx, "txn_key").Val())
+	})
+
+	t.Run("EXEC with the keyless write commands", func(t *testing.T) {
+		require.NoError(t, rdb.Set(ctx, "txn_key", "1", 0).Err())
+		require.NoError(t, rdb.Do(ctx, "MULTI").Err())
+		require.NoError(t, rdb.Do(ctx, "FLUSHDB").Err())
+		require.NoError(t, rdb.Do(ctx, "SET", "txn_key", "2").Err())
+		v := rdb.Do(ctx, "EXEC").Val()
+		require.Equal(t, "[OK OK]", fmt.Sprintf("%v", v))
+		require.Equal(t, "2", rdb.Get(ctx, "txn_key").Val())
+	})
+
+	t.Run("EXEC fails if the watched keys were modified", func(t *testing.T) {
+		c := srv.NewClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.NoError(t, rdb.Set(ctx, "watched_key", "1", 0).Err())
+		require.NoError(t, rdb.Do(ctx, "WATCH", "watched_key", "other_key").Err())
+		require.NoError(t, c.Set(ctx, "watched_key", "2", 0).Err())
+		require.NoError(t, rdb.Do(ctx, "MULTI").Err())
+		require.NoError(t, rdb.Do(ctx, "SET", "watched_key", "3").Err())
+		require.Equal(t, redis.Nil, rdb.Do(ctx, "EXEC").Err())
+		require.Equal(t, "2", rdb.Get(ctx, "watched_key").Val())
+
+		// The watched keys are reset by EXEC
+		require.NoError(t, rdb.Do(ctx, "MULTI").Err())
+		require.NoError(t, rdb.Do(ctx, "SET", "watched_key", "3").Err())
+		require.Equal(t, "[OK]", fmt.Sprintf("%v", rdb.Do(ctx, "EXEC").Val()))
+		require.Equal(t, "3", rdb.Get(ctx, "watched_key").Val())
+	})
+
+	t.Run("EXEC succeeds if the watched keys weren't modified", func(t *testing.T) {
+		c := srv.NewClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.NoError(t, rdb.Do(ctx, "WATCH", "watched_key").Err())
+		require.NoError(t, c.Set(ctx, "unwatched_key", "1", 0).Err())
+		require.NoError(t, c.Get(ctx, "watched_key").Err())
+		require.NoError(t, rdb.Do(ctx, "MULTI").Err())
+		require.EqualError(t, rdb.Do(ctx, "WATCH", "watched_key").Err(), "ERR WATCH inside MULTI is not allowed")
+		require.NoError(t, rdb.Do(ctx, "SET", "watched_key", "4").Err())
+		require.Equal(t, "[OK]", fmt.Sprintf("%v", rdb.Do(ctx, "EXEC").Val()))
+
+		require.NoError(t, rdb.Do(ctx, "WATCH", "watched_key").Err())
+		require.NoError(t, rdb.Do(ctx, "UNWATCH").Err())
+		require.NoError(t, c.Set(ctx, "watched_key", "5", 0).Err())
+		require.NoError(t, rdb.Do(ctx, "MULTI").Err())
+		require.NoError(t, rdb.Do(ctx, "GET", "watched_key").Err())
+		require.Equal(t, "[5]", fmt.Sprintf("%v", rdb.Do(ctx, "EXEC").Val()))
+
+		require.NoError(t, rdb.Do(ctx, "WATCH", "watched_key").Err())
+		require.NoError(t, c.FlushDB(ctx).Err())
+		require.NoError(t, rdb.Do(ctx, "MULTI").Err())
+		require.NoError(t, rdb.Do(ctx, "GET", "watched_key").Err())
+		require.Equal(t, redis.Nil, rdb.Do(ctx, "EXEC").Err())
+	})
+
+	t.Run("The transactions of the same keys are serialized", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "txn_counter").Err())
+		var wg sync.WaitGroup
+		for i := 0; i < 4; i++ {
+			wg.Add(1)
+			go func() {
+				defer wg.Done()
+				c := srv.NewClient()
+				defer func() { require.NoError(t, c.Close()) }()
+				for j := 0; j < 50; j++ {
+					_, err := c.TxPipelined(ctx, func(pipe redis.Pipeliner) error {
+						pipe.Incr(ctx, "txn_counter")
+						pipe.Incr(ctx, "txn_counter")
+						return nil
+					})
+					require.NoError(t, err)
+				}
+			}()
+		}
+		wg.Wait()
+		require.Equal(t, "400", rdb.Get(ctx, "txn_counter").Val())
+	})
+
+	t.Run("The streamed replies of the failed commit aren't sent", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "txn_big_hash", "txn_written").Err())
+		fields := make(map[string]interface{})
+		for i := 0; i < 5000; i++ {
+			fields[fmt.Sprintf("field-%d", i)] = strings.Repeat("v", 100)
+		}
+		require.NoError(t, rdb.HSet(ctx, "txn_big_hash", fields).Err())
+
+		require.NoError(t, rdb.Do(ctx, "DEBUG", "FAIL-TXN-COMMIT", 1).Err())
+		require.NoError(t, rdb.Do(ctx, "MULTI").Err())
+		require.NoError(t, rdb.Do(ctx, "SET", "txn_written", "v").Err())
+		require.NoError(t, rdb.Do(ctx, "HGETALL", "txn_big_hash").Err())
+		require.ErrorContains(t, rdb.Do(ctx, "EXEC").Err(), "EXECABORT")
+		// Nothing of the discarded replies was sent, so the connection is still in sync
+		require.Equal(t, "PONG", rdb.Ping(ctx).Val())
+		require.ErrorIs(t, rdb.Get(ctx, "txn_written").Err(), redis.Nil)
+		require.EqualValues(t, 5000, rdb.HLen(ctx, "txn_big_hash").Val())
+	})
+
 	func() {
 		newSrv := util.StartServer(t, map[string]string{})
 		defer newSrv.Close()
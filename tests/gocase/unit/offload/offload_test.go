@@ -0,0 +1,142 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package offload
+
+import (
+	"context"
+	"fmt"
+	"sync"
+	"testing"
+	"time"
+
+	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/go-redis/redis/v9"
+	"github.com/stretchr/testify/require"
+)
+
+func TestOffload(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"workers": "1", "worker-offload-threads": "2"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("Keep the order of replies in the pipeline", func(t *testing.T) {
+		require.NoError(t, rdb.FlushDB(ctx).Err())
+		pipe := rdb.Pipeline()
+		pipe.Set(ctx, "a", "1", 0)
+		pipe.HSet(ctx, "h", "f1", "v1", "f2", "v2")
+		keys := pipe.Keys(ctx, "*")
+		hash := pipe.HGetAll(ctx, "h")
+		str := pipe.Get(ctx, "a")
+		pipe.RPush(ctx, "l", "x", "y")
+		list := pipe.LRange(ctx, "l", 0, -1)
+		_, err := pipe.Exec(ctx)
+		require.NoError(t, err)
+		require.ElementsMatch(t, []string{"a", "h"}, keys.Val())
+		require.Equal(t, map[string]string{"f1": "v1", "f2": "v2"}, hash.Val())
+		require.Equal(t, "1", str.Val())
+		require.Equal(t, []string{"x", "y"}, list.Val())
+	})
+
+	t.Run("Serve the other clients while running the slow commands", func(t *testing.T) {
+		require.NoError(t, rdb.FlushDB(ctx).Err())
+		for i := 0; i < 10; i++ {
+			require.NoError(t, rdb.HSet(ctx, "hash", fmt.Sprintf("field%d", i), i).Err())
+		}
+		var wg sync.WaitGroup
+		for i := 0; i < 8; i++ {
+			wg.Add(1)
+			go func() {
+				defer wg.Done()
+				c := srv.NewClient()
+				defer func() { require.NoError(t, c.Close()) }()
+				for j := 0; j < 100; j++ {
+					require.Len(t, c.HGetAll(ctx, "hash").Val(), 10)
+					require.EqualValues(t, 10, c.HLen(ctx, "hash").Val())
+				}
+			}()
+		}
+		wg.Wait()
+	})
+
+	t.Run("Client was gone while running the slow command", func(t *testing.T) {
+		c := srv.NewTCPClient()
+		require.NoError(t, c.WriteArgs("KEYS", "*"))
+		require.NoError(t, c.Close())
+		require.Equal(t, "PONG", rdb.Ping(ctx).Val())
+	})
+
+	t.Run("Slow commands in the transaction", func(t *testing.T) {
+		require.NoError(t, rdb.FlushDB(ctx).Err())
+		pipe := rdb.TxPipeline()
+		pipe.SAdd(ctx, "s", "m1", "m2")
+		members := pipe.SMembers(ctx, "s")
+		_, err := pipe.Exec(ctx)
+		require.NoError(t, err)
+		require.ElementsMatch(t, []string{"m1", "m2"}, members.Val())
+	})
+}
+
+func TestOffloadCacheMissedReads(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{
+		"workers":                           "1",
+		"worker-offload-threads":            "2",
+		"worker-offload-cache-missed-reads": "yes",
+	})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	for i := 0; i < 100; i++ {
+		require.NoError(t, rdb.Set(ctx, fmt.Sprintf("key%d", i), i, 0).Err())
+		require.NoError(t, rdb.HSet(ctx, "hash", fmt.Sprintf("field%d", i), i).Err())
+	}
+
+	t.Run("Offload the reads missing the cache", func(t *testing.T) {
+		require.NoError(t, rdb.Do(ctx, "COMPACT").Err())
+		require.Eventually(t, func() bool {
+			for i := 0; i < 100; i++ {
+				require.Equal(t, fmt.Sprintf("%d", i), rdb.Get(ctx, fmt.Sprintf("key%d", i)).Val())
+			}
+			return util.FindInfoEntry(rdb, "cache_missed_offloaded_cmds", "stats") != "0"
+		}, 5*time.Second, 100*time.Millisecond)
+	})
+
+	t.Run("Keep the order of replies in the pipeline", func(t *testing.T) {
+		require.NoError(t, rdb.Do(ctx, "COMPACT").Err())
+		pipe := rdb.Pipeline()
+		var gets []*redis.StringCmd
+		for i := 0; i < 100; i++ {
+			gets = append(gets, pipe.HGet(ctx, "hash", fmt.Sprintf("field%d", i)))
+			pipe.Set(ctx, fmt.Sprintf("key%d", i), "new", 0)
+			gets = append(gets, pipe.Get(ctx, fmt.Sprintf("key%d", i)))
+		}
+		_, err := pipe.Exec(ctx)
+		require.NoError(t, err)
+		for i := 0; i < 100; i++ {
+			require.Equal(t, fmt.Sprintf("%d", i), gets[2*i].Val())
+			require.Equal(t, "new", gets[2*i+1].Val())
+		}
+	})
+}
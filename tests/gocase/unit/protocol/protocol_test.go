@@ -21,6 +21,9 @@ package protocol
 
 import (
 	"context"
+	"fmt"
+	"strconv"
+	"strings"
 	"testing"
 
 	"github.com/apache/incubator-kvrocks/tests/gocase/util"
@@ -111,6 +114,46 @@ func TestProtocolNetwork(t *testing.T) {
 		}
 	})
 
+	t.Run("bulk and header split across multiple writes", func(t *testing.T) {
+		c := srv.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		value := strings.Repeat("x", 64*1024)
+		req := fmt.Sprintf("*3\r\n$3\r\nset\r\n$3\r\nkey\r\n$%d\r\n%s\r\n*2\r\n$3\r\nget\r\n$3\r\nkey\r\n", len(value), value)
+		for i := 0; i < len(req); i += 4093 {
+			end := i + 4093
+			if end > len(req) {
+				end = len(req)
+			}
+			require.NoError(t, c.Write(req[i:end]))
+		}
+		c.MustRead(t, "+OK")
+		c.MustRead(t, fmt.Sprintf("$%d", len(value)))
+		c.MustRead(t, value)
+	})
+
+	t.Run("replies of the pipeline are sent in order", func(t *testing.T) {
+		c := srv.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		value := strings.Repeat("y", 128*1024)
+		var req strings.Builder
+		req.WriteString(fmt.Sprintf("*3\r\n$3\r\nset\r\n$3\r\nbig\r\n$%d\r\n%s\r\n", len(value), value))
+		for i := 0; i < 100; i++ {
+			req.WriteString(fmt.Sprintf("*2\r\n$4\r\necho\r\n$%d\r\n%d\r\n", len(strconv.Itoa(i)), i))
+			req.WriteString("*2\r\n$3\r\nget\r\n$3\r\nbig\r\n")
+		}
+		req.WriteString("*1\r\n$4\r\nquit\r\n")
+		require.NoError(t, c.Write(req.String()))
+		c.MustRead(t, "+OK")
+		for i := 0; i < 100; i++ {
+			c.MustRead(t, fmt.Sprintf("$%d", len(strconv.Itoa(i))))
+			c.MustRead(t, strconv.Itoa(i))
+			c.MustRead(t, fmt.Sprintf("$%d", len(value)))
+			c.MustRead(t, value)
+		}
+		c.MustRead(t, "+OK")
+		c.MustFail(t)
+	})
+
 	t.Run("invalid LF in multi bulk protocol", func(t *testing.T) {
 		c := srv.NewTCPClient()
 		defer func() { require.NoError(t, c.Close()) }()
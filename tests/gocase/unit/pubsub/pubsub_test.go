@@ -22,7 +22,9 @@ package pubsub
 import (
 	"context"
 	"fmt"
+	"strings"
 	"testing"
+	"time"
 
 	"github.com/apache/incubator-kvrocks/tests/gocase/util"
 	"github.com/go-redis/redis/v9"
@@ -348,6 +350,68 @@ func TestPubSub(t *testing.T) {
 		})
 	})
 
+	t.Run("PUBLISH/PSUBSCRIBE with the patterns of the different literal prefixes", func(t *testing.T) {
+		pubsub := rdb.PSubscribe(ctx, "*", "news.*", "news.?port", "new[st].sport", "weather")
+		for i := 1; i <= 5; i++ {
+			require.EqualValues(t, i, receiveType(t, pubsub, &redis.Subscription{}).Count)
+		}
+		require.EqualValues(t, 5, rdb.PubSubNumPat(ctx).Val())
+
+		require.EqualValues(t, 4, rdb.Publish(ctx, "news.sport", "hello").Val())
+		patterns := make(map[string]bool)
+		for i := 0; i < 4; i++ {
+			msg := receiveType(t, pubsub, &redis.Message{})
+			require.Equal(t, "news.sport", msg.Channel)
+			require.Equal(t, "hello", msg.Payload)
+			patterns[msg.Pattern] = true
+		}
+		require.Equal(t, map[string]bool{"*": true, "news.*": true, "news.?port": true, "new[st].sport": true}, patterns)
+
+		require.EqualValues(t, 2, rdb.Publish(ctx, "weather", "sunny").Val())
+		require.EqualValues(t, 1, rdb.Publish(ctx, "weather.today", "rainy").Val())
+		for _, payload := range []string{"sunny", "sunny", "rainy"} {
+			require.Equal(t, payload, receiveType(t, pubsub, &redis.Message{}).Payload)
+		}
+
+		require.NoError(t, pubsub.PUnsubscribe(ctx, "*", "news.*"))
+		require.EqualValues(t, 4, receiveType(t, pubsub, &redis.Subscription{}).Count)
+		require.EqualValues(t, 3, receiveType(t, pubsub, &redis.Subscription{}).Count)
+		require.EqualValues(t, 2, rdb.Publish(ctx, "news.sport", "hello").Val())
+		require.EqualValues(t, 0, rdb.Publish(ctx, "weather.today", "rainy").Val())
+		require.NoError(t, pubsub.Close())
+	})
+
+	t.Run("SPUBLISH/SSUBSCRIBE basics", func(t *testing.T) {
+		c := srv.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+
+		require.NoError(t, c.WriteArgs("ssubscribe", "{shard}.a", "{shard}.b"))
+		readSub(t, c, redis.Subscription{Kind: "ssubscribe", Channel: "{shard}.a", Count: 1})
+		readSub(t, c, redis.Subscription{Kind: "ssubscribe", Channel: "{shard}.b", Count: 2})
+		require.NoError(t, c.WriteArgs("psubscribe", "{shard}.*"))
+		readSub(t, c, redis.Subscription{Kind: "psubscribe", Channel: "{shard}.*", Count: 1})
+
+		require.Equal(t, []string{"{shard}.a", "{shard}.b"}, rdb.Do(ctx, "PUBSUB", "SHARDCHANNELS").StringSlice())
+		require.Equal(t, []string{"{shard}.b"}, rdb.Do(ctx, "PUBSUB", "SHARDCHANNELS", "*.b").StringSlice())
+		require.Empty(t, rdb.PubSubChannels(ctx, "*").Val())
+		require.Equal(t, []interface{}{"{shard}.a", int64(1), "{shard}.c", int64(0)},
+			rdb.Do(ctx, "PUBSUB", "SHARDNUMSUB", "{shard}.a", "{shard}.c").Val())
+
+		// The shard channels don't receive the messages of PUBLISH, and the patterns don't match SPUBLISH
+		require.EqualValues(t, 1, rdb.Do(ctx, "SPUBLISH", "{shard}.a", "hello").Val())
+		require.EqualValues(t, 0, rdb.Do(ctx, "SPUBLISH", "{shard}.c", "hello").Val())
+		require.EqualValues(t, 1, rdb.Publish(ctx, "{shard}.a", "world").Val())
+		readMsg(t, c, "smessage", redis.Message{Channel: "{shard}.a", Payload: "hello"})
+		readMsg(t, c, "pmessage", redis.Message{Channel: "{shard}.a", Pattern: "{shard}.*", Payload: "world"})
+
+		require.NoError(t, c.WriteArgs("sunsubscribe", "{shard}.a"))
+		readSub(t, c, redis.Subscription{Kind: "sunsubscribe", Channel: "{shard}.a", Count: 1})
+		require.EqualValues(t, 0, rdb.Do(ctx, "SPUBLISH", "{shard}.a", "hello").Val())
+		require.NoError(t, c.WriteArgs("sunsubscribe"))
+		readSub(t, c, redis.Subscription{Kind: "sunsubscribe", Channel: "{shard}.b", Count: 0})
+		require.EqualValues(t, 0, rdb.Do(ctx, "SPUBLISH", "{shard}.b", "hello").Val())
+	})
+
 	t.Run("PUNSUBSCRIBE and UNSUBSCRIBE should always reply", func(t *testing.T) {
 		// make sure we are not subscribed to any channel at all.
 		c := srv.NewClient()
@@ -366,4 +430,22 @@ func TestPubSub(t *testing.T) {
 		require.NoError(t, pubsub.Unsubscribe(ctx))
 		require.EqualValues(t, 0, receiveType(t, pubsub, &redis.Subscription{}).Count)
 	})
+
+	t.Run("Close the slow subscriber once its output buffer reached the hard limit", func(t *testing.T) {
+		require.NoError(t, rdb.ConfigSet(ctx, "client-output-buffer-limit", "pubsub 1mb 0 0").Err())
+		defer func() {
+			require.NoError(t, rdb.ConfigSet(ctx, "client-output-buffer-limit", "pubsub 32mb 8mb 60").Err())
+		}()
+
+		// the subscriber never reads the messages
+		c := srv.NewTCPClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		require.NoError(t, c.WriteArgs("SUBSCRIBE", "slowchan"))
+		c.MustRead(t, "*3")
+
+		payload := strings.Repeat("x", 64*1024)
+		require.Eventually(t, func() bool {
+			return rdb.Publish(ctx, "slowchan", payload).Val() == 0
+		}, 10*time.Second, time.Millisecond)
+	})
 }
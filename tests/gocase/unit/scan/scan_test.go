@@ -25,6 +25,7 @@ import (
 	"strconv"
 	"strings"
 	"testing"
+	"time"
 
 	"github.com/apache/incubator-kvrocks/tests/gocase/util"
 	"github.com/go-redis/redis/v9"
@@ -64,6 +65,68 @@ func TestScan(t *testing.T) {
 		require.Len(t, keys, 1000)
 	})
 
+	t.Run("SCAN MATCH with glob pattern", func(t *testing.T) {
+		require.NoError(t, rdb.FlushDB(ctx).Err())
+		util.Populate(t, rdb, "key:", 1000, 10)
+		keys := scanAll(t, rdb, "match", "key:1?", "count", 5)
+		slices.Sort(keys)
+		require.Equal(t, []string{"key:10", "key:11", "key:12", "key:13", "key:14",
+			"key:15", "key:16", "key:17", "key:18", "key:19"}, keys)
+		keys = scanAll(t, rdb, "match", "*:99[5-9]")
+		slices.Sort(keys)
+		require.Equal(t, []string{"key:995", "key:996", "key:997", "key:998", "key:999"}, keys)
+		require.Empty(t, scanAll(t, rdb, "match", "nokey:*"))
+	})
+
+	t.Run("SCAN TYPE", func(t *testing.T) {
+		require.NoError(t, rdb.FlushDB(ctx).Err())
+		for i := 0; i < 50; i++ {
+			require.NoError(t, rdb.Set(ctx, fmt.Sprintf("string:%d", i), "v", 0).Err())
+			require.NoError(t, rdb.HSet(ctx, fmt.Sprintf("hash:%d", i), "f", "v").Err())
+			require.NoError(t, rdb.SAdd(ctx, fmt.Sprintf("set:%d", i), "m").Err())
+		}
+		require.NoError(t, rdb.Set(ctx, "string:expired", "v", time.Millisecond).Err())
+		time.Sleep(10 * time.Millisecond)
+
+		keys := scanAll(t, rdb, "type", "string", "count", 7)
+		require.Len(t, keys, 50)
+		for _, key := range keys {
+			require.True(t, strings.HasPrefix(key, "string:"))
+		}
+		keys = scanAll(t, rdb, "match", "hash:1*", "type", "HASH")
+		require.Len(t, keys, 11)
+		require.Empty(t, scanAll(t, rdb, "type", "zset"))
+		require.ErrorContains(t, rdb.Do(ctx, "SCAN", "0", "TYPE", "foo").Err(), "unknown type name")
+	})
+
+	t.Run("SCAN PARALLEL", func(t *testing.T) {
+		require.NoError(t, rdb.FlushDB(ctx).Err())
+		util.Populate(t, rdb, "key:", 1000, 10)
+		cursors, err := rdb.Do(ctx, "SCAN", "0", "PARALLEL", "4").StringSlice()
+		require.NoError(t, err)
+		require.NotEmpty(t, cursors)
+		require.LessOrEqual(t, len(cursors), 4)
+
+		// The partitions don't overlap, and they cover all the keys
+		var keys []string
+		for _, cursor := range cursors {
+			for c := cursor; ; {
+				next, keyList := scan(t, rdb, c, "count", 7)
+				keys = append(keys, keyList...)
+				if next == "0" {
+					break
+				}
+				c = next
+			}
+		}
+		require.Len(t, keys, 1000)
+		slices.Sort(keys)
+		require.Len(t, slices.Compact(keys), 1000)
+
+		require.ErrorContains(t, rdb.Do(ctx, "SCAN", "0", "PARALLEL", "0").Err(), "parallel param")
+		require.ErrorContains(t, rdb.Do(ctx, "SCAN", cursors[0], "PARALLEL", "2").Err(), "cursor 0")
+	})
+
 	t.Run("SCAN guarantees check under write load", func(t *testing.T) {
 		require.NoError(t, rdb.FlushDB(ctx).Err())
 		util.Populate(t, rdb, "", 100, 10)
@@ -22,7 +22,10 @@ package scripting
 import (
 	"context"
 	"fmt"
+	"strconv"
+	"sync"
 	"testing"
+	"time"
 
 	"github.com/apache/incubator-kvrocks/tests/gocase/util"
 	"github.com/go-redis/redis/v9"
@@ -190,6 +193,32 @@ return {type(foo),foo == false}
 		require.Equal(t, "[boolean 1]", fmt.Sprintf("%v", r.Val()))
 	})
 
+	t.Run("EVAL - Redis typed replies -> Lua type conversion", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "mykey", "myhash", "emptylist", "counter").Err())
+		require.NoError(t, rdb.Set(ctx, "mykey", "myval", 0).Err())
+		require.NoError(t, rdb.HSet(ctx, "myhash", "f1", "v1", "f2", "v2").Err())
+		r := rdb.Eval(ctx, `
+local mget = redis.call('mget',KEYS[1],'nokey')
+local hmget = redis.call('hmget',KEYS[2],'f2','nofield','f1')
+local hkeys = redis.call('hkeys',KEYS[2])
+local empty = redis.call('lrange',KEYS[3],0,-1)
+return {#mget,mget[1],tostring(mget[2]),#hmget,hmget[1],tostring(hmget[2]),hmget[3],#hkeys,type(empty),#empty}
+`, []string{"mykey", "myhash", "emptylist"})
+		require.NoError(t, r.Err())
+		require.Equal(t, "[2 myval false 3 v2 false v1 2 table 0]", fmt.Sprintf("%v", r.Val()))
+
+		// The replies of many calls shouldn't leave anything on the Lua stack
+		r = rdb.Eval(ctx, `
+local n = 0
+for i = 1, 1000 do
+  n = n + #redis.call('hmget',KEYS[1],'f1','f2') + redis.call('incr',KEYS[2])
+end
+return n
+`, []string{"myhash", "counter"})
+		require.NoError(t, r.Err())
+		require.EqualValues(t, 1000*2+1000*1001/2, r.Val())
+	})
+
 	t.Run("EVAL - Scripts can't run certain commands", func(t *testing.T) {
 		r := rdb.Eval(ctx, `return redis.pcall('blpop','x',0)`, []string{})
 		require.ErrorContains(t, r.Err(), "not allowed")
@@ -393,6 +422,44 @@ assert(bit.bor(1,2,4,8,16,32,64,128) == 255)
 		util.ErrorRegexp(t, r2.Err(), ".*ERR.*attempted to create global.*")
 	})
 
+	t.Run("EVAL - redis.pipeline executes the commands together", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "pipeline_a", "pipeline_b", "pipeline_list").Err())
+		r := rdb.Eval(ctx, `
+			local res = redis.pipeline({
+				{'set', KEYS[1], 'a'},
+				{'set', KEYS[2], 2},
+				{'rpush', KEYS[3], 'x', 'y'},
+				{'get', KEYS[1]},
+				{'get', KEYS[2]},
+				{'get', 'pipeline_nosuchkey'},
+				{'get', KEYS[3]},
+				{'incr', KEYS[2]},
+			})
+			return {res[1].ok, res[2].ok, res[3], res[4], res[5], tostring(res[6]), res[7].err, res[8]}`,
+			[]string{"pipeline_a", "pipeline_b", "pipeline_list"})
+		require.NoError(t, r.Err())
+		require.Len(t, r.Val(), 8)
+		require.Equal(t, []interface{}{"OK", "OK", int64(2), "a", "2", "false"}, r.Val().([]interface{})[:6])
+		require.Contains(t, r.Val().([]interface{})[6], "WRONGTYPE")
+		require.Equal(t, int64(3), r.Val().([]interface{})[7])
+		require.Equal(t, "3", rdb.Get(ctx, "pipeline_b").Val())
+		require.Equal(t, []string{"x", "y"}, rdb.LRange(ctx, "pipeline_list", 0, -1).Val())
+	})
+
+	t.Run("EVAL - redis.batch is the alias of redis.pipeline", func(t *testing.T) {
+		r := rdb.Eval(ctx, `return redis.batch({{'set', KEYS[1], 'b'}, {'nosuchcommand'}, {'get', KEYS[1]}})[3]`,
+			[]string{"pipeline_a"})
+		require.NoError(t, r.Err())
+		require.Equal(t, "b", r.Val())
+		r = rdb.Eval(ctx, `return redis.pipeline({{'flushdb'}})[1].err`, []string{})
+		require.NoError(t, r.Err())
+		require.Contains(t, r.Val(), "not allowed in redis.pipeline()")
+		r = rdb.Eval(ctx, `return redis.pipeline({'get', 'pipeline_a'})`, []string{})
+		require.ErrorContains(t, r.Err(), "must be a table of strings or integers")
+		r = rdb.Eval(ctx, `return redis.pipeline()`, []string{})
+		require.ErrorContains(t, r.Err(), "table of commands")
+	})
+
 	t.Run("Test an example script DECR_IF_GT", func(t *testing.T) {
 		scriptDecrIfGt := `
 local current
@@ -479,6 +546,79 @@ math.randomseed(ARGV[1]); return tostring(math.random())
 	})
 }
 
+func TestScriptingStrictKeyAccessing(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"lua-strict-key-accessing": "yes"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("EVAL - the writes of the declared keys are visible to the script", func(t *testing.T) {
+		r := rdb.Eval(ctx, `
+			redis.call('set', KEYS[1], 'a')
+			redis.call('append', KEYS[1], 'b')
+			redis.call('hset', KEYS[2], 'f', redis.call('get', KEYS[1]))
+			return redis.call('hgetall', KEYS[2])`, []string{"strict_key", "strict_hash"})
+		require.NoError(t, r.Err())
+		require.Equal(t, []interface{}{"f", "ab"}, r.Val())
+		require.Equal(t, "ab", rdb.Get(ctx, "strict_key").Val())
+	})
+
+	t.Run("EVAL - the undeclared keys are rejected", func(t *testing.T) {
+		r := rdb.Eval(ctx, `return redis.call('get', 'undeclared_key')`, []string{"strict_key"})
+		util.ErrorRegexp(t, r.Err(), "ERR .* Script attempted to access a key that wasn't declared in KEYS")
+		r = rdb.Eval(ctx, `return redis.call('flushdb')`, []string{"strict_key"})
+		util.ErrorRegexp(t, r.Err(), "ERR .* not allowed from scripts with strict key accessing")
+	})
+
+	t.Run("EVAL - the writes before the error are kept", func(t *testing.T) {
+		r := rdb.Eval(ctx, `
+			redis.call('set', KEYS[1], 'kept')
+			return redis.call('get', 'undeclared_key')`, []string{"strict_key"})
+		require.Error(t, r.Err())
+		require.Equal(t, "kept", rdb.Get(ctx, "strict_key").Val())
+	})
+
+	t.Run("EVAL - the scripts of the same keys are serialized", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "strict_counter").Err())
+		script := `
+			local n = tonumber(redis.call('get', KEYS[1]) or '0')
+			redis.call('set', KEYS[1], n + 1)
+			return n + 1`
+		var wg sync.WaitGroup
+		for i := 0; i < 4; i++ {
+			wg.Add(1)
+			go func() {
+				defer wg.Done()
+				c := srv.NewClient()
+				defer func() { require.NoError(t, c.Close()) }()
+				for j := 0; j < 100; j++ {
+					require.NoError(t, c.Eval(ctx, script, []string{"strict_counter"}).Err())
+				}
+			}()
+		}
+		wg.Wait()
+		require.Equal(t, "400", rdb.Get(ctx, "strict_counter").Val())
+	})
+
+	t.Run("EVAL - redis.pipeline only accesses the declared keys", func(t *testing.T) {
+		r := rdb.Eval(ctx, `
+			local res = redis.pipeline({{'set', KEYS[1], 'piped'}, {'get', 'undeclared_key'}, {'get', KEYS[1]}})
+			return {res[2].err, res[3]}`, []string{"strict_key"})
+		require.NoError(t, r.Err())
+		require.Contains(t, r.Val().([]interface{})[0], "wasn't declared in KEYS")
+		require.Equal(t, "piped", r.Val().([]interface{})[1])
+		require.Equal(t, "piped", rdb.Get(ctx, "strict_key").Val())
+	})
+
+	t.Run("EVAL - the scripts without declared keys run exclusively", func(t *testing.T) {
+		r := rdb.Eval(ctx, `return redis.call('set', 'undeclared_key', 'value')`, []string{})
+		require.NoError(t, r.Err())
+		require.Equal(t, "value", rdb.Get(ctx, "undeclared_key").Val())
+	})
+}
+
 func TestScriptingMasterSlave(t *testing.T) {
 	master := util.StartServer(t, map[string]string{})
 	defer master.Close()
@@ -508,3 +648,133 @@ func TestScriptingMasterSlave(t *testing.T) {
 		require.Equal(t, []bool{false}, slaveClient.ScriptExists(ctx, sha).Val())
 	})
 }
+
+func TestScriptingFunctionCache(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"workers": "1"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	infoCount := func(key string) int64 {
+		v, err := strconv.ParseInt(util.FindInfoEntry(rdb, key, "stats"), 10, 64)
+		require.NoError(t, err)
+		return v
+	}
+
+	t.Run("SCRIPT LOAD compiles the script into the Lua states of workers", func(t *testing.T) {
+		sha := rdb.ScriptLoad(ctx, `return 'loaded into workers'`).Val()
+		misses := infoCount("script_cache_misses")
+		hits := infoCount("script_cache_hits")
+		require.Equal(t, "loaded into workers", rdb.Do(ctx, "EVALSHA_RO", sha, "0").Val())
+		require.Equal(t, misses, infoCount("script_cache_misses"))
+		require.Equal(t, hits+1, infoCount("script_cache_hits"))
+	})
+
+	t.Run("SCRIPT FLUSH removes the scripts from the Lua states of workers", func(t *testing.T) {
+		sha := rdb.ScriptLoad(ctx, `return 'flushed'`).Val()
+		require.Equal(t, "flushed", rdb.Do(ctx, "EVALSHA_RO", sha, "0").Val())
+		require.NoError(t, rdb.ScriptFlush(ctx).Err())
+		util.ErrorRegexp(t, rdb.Do(ctx, "EVALSHA_RO", sha, "0").Err(), "NOSCRIPT.*")
+	})
+
+	t.Run("The evicted scripts are compiled again from the stored scripts", func(t *testing.T) {
+		require.NoError(t, rdb.ConfigSet(ctx, "lua-script-cache-size", "2").Err())
+		defer func() { require.NoError(t, rdb.ConfigSet(ctx, "lua-script-cache-size", "10000").Err()) }()
+
+		var shas []string
+		for i := 0; i < 3; i++ {
+			r := rdb.Eval(ctx, fmt.Sprintf("return %d", i), []string{})
+			require.NoError(t, r.Err())
+			require.EqualValues(t, i, r.Val())
+			shas = append(shas, rdb.ScriptLoad(ctx, fmt.Sprintf("return %d", i)).Val())
+		}
+		compiles := infoCount("script_compiles")
+		misses := infoCount("script_cache_misses")
+		// The first one was evicted by the later ones
+		for i := len(shas) - 1; i >= 0; i-- {
+			r := rdb.Do(ctx, "EVALSHA_RO", shas[i], "0")
+			require.NoError(t, r.Err())
+			require.EqualValues(t, i, r.Val())
+		}
+		require.Equal(t, misses+1, infoCount("script_cache_misses"))
+		require.Equal(t, compiles+1, infoCount("script_compiles"))
+		require.Greater(t, infoCount("script_compile_time_usec"), int64(0))
+	})
+}
+
+func TestScriptingReadOnlyThreads(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"workers": "1", "lua-readonly-script-threads": "2"})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	// Read the key twice in one second, the key is probably updated between the reads
+	slowScript := `
+local first = redis.call('get', KEYS[1])
+local start = redis.call('time')[1]
+while redis.call('time')[1] - start < 1 do end
+return {first, redis.call('get', KEYS[1])}
+`
+
+	t.Run("EVAL_RO runs in the read-only script threads", func(t *testing.T) {
+		require.NoError(t, rdb.Set(ctx, "ro_key", "value", 0).Err())
+		r := rdb.Do(ctx, "EVAL_RO", `return redis.call('get', KEYS[1])`, "1", "ro_key")
+		require.NoError(t, r.Err())
+		require.Equal(t, "value", r.Val())
+
+		sha := rdb.ScriptLoad(ctx, `return redis.call('mget', KEYS[1], KEYS[2])`).Val()
+		r = rdb.Do(ctx, "EVALSHA_RO", sha, "2", "ro_key", "no_key")
+		require.NoError(t, r.Err())
+		require.Equal(t, []interface{}{"value", nil}, r.Val())
+
+		util.ErrorRegexp(t, rdb.Do(ctx, "EVAL_RO", `return redis.call('set', KEYS[1], 'x')`, "1", "ro_key").Err(),
+			".*Write commands are not allowed from read-only scripts.*")
+	})
+
+	t.Run("The slow read-only script doesn't block the other clients of the worker", func(t *testing.T) {
+		c := srv.NewClient()
+		defer func() { require.NoError(t, c.Close()) }()
+
+		var wg sync.WaitGroup
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			require.NoError(t, c.Do(ctx, "EVAL_RO", slowScript, "1", "ro_key").Err())
+		}()
+		time.Sleep(200 * time.Millisecond)
+		start := time.Now()
+		require.Equal(t, "value", rdb.Get(ctx, "ro_key").Val())
+		require.Less(t, time.Since(start), 500*time.Millisecond)
+		wg.Wait()
+	})
+
+	t.Run("All calls of the read-only script read the same snapshot", func(t *testing.T) {
+		require.NoError(t, rdb.Set(ctx, "ro_key", "before", 0).Err())
+		c := srv.NewClient()
+		defer func() { require.NoError(t, c.Close()) }()
+
+		var wg sync.WaitGroup
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			r := c.Do(ctx, "EVAL_RO", slowScript, "1", "ro_key")
+			require.NoError(t, r.Err())
+			require.Equal(t, []interface{}{"before", "before"}, r.Val())
+		}()
+		time.Sleep(200 * time.Millisecond)
+		require.NoError(t, rdb.Set(ctx, "ro_key", "after", 0).Err())
+		wg.Wait()
+		require.Equal(t, "after", rdb.Get(ctx, "ro_key").Val())
+	})
+
+	t.Run("SCRIPT FLUSH removes the scripts from the read-only script threads", func(t *testing.T) {
+		sha := rdb.ScriptLoad(ctx, `return 'flushed'`).Val()
+		require.Equal(t, "flushed", rdb.Do(ctx, "EVALSHA_RO", sha, "0").Val())
+		require.NoError(t, rdb.ScriptFlush(ctx).Err())
+		util.ErrorRegexp(t, rdb.Do(ctx, "EVALSHA_RO", sha, "0").Err(), "NOSCRIPT.*")
+	})
+}
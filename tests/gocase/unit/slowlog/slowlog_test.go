@@ -148,6 +148,39 @@ func TestSlowlog(t *testing.T) {
 		require.EqualValues(t, 1, len(val))
 	})
 
+	t.Run("SLOWLOG - GET WITHTRACE returns the stages of the traced requests", func(t *testing.T) {
+		require.NoError(t, rdb.ConfigSet(ctx, "slowlog-max-len", "10").Err())
+		require.NoError(t, rdb.ConfigSet(ctx, "slowlog-log-slower-than", "0").Err())
+		require.NoError(t, rdb.Do(ctx, "slowlog", "reset").Err())
+		require.NoError(t, rdb.Set(ctx, "untraced", "value", 0).Err())
+		entries, err := rdb.Do(ctx, "slowlog", "get", "1", "withtrace").Slice()
+		require.NoError(t, err)
+		require.Len(t, entries, 1)
+		require.Len(t, entries[0], 5)
+		require.Empty(t, entries[0].([]interface{})[4])
+
+		require.NoError(t, rdb.ConfigSet(ctx, "request-trace-sample-interval", "1").Err())
+		require.NoError(t, rdb.Set(ctx, "traced", "value", 0).Err())
+		entries, err = rdb.Do(ctx, "slowlog", "get", "1", "withtrace").Slice()
+		require.NoError(t, err)
+		entry := entries[0].([]interface{})
+		require.EqualValues(t, []interface{}{"set", "traced", "value"}, entry[3])
+		trace := entry[4].([]interface{})
+		require.Len(t, trace, 2)
+		require.Greater(t, trace[0].(int64), int64(0))
+		stages := make(map[string]int64)
+		for _, span := range trace[1].([]interface{}) {
+			fields := span.([]interface{})
+			require.Len(t, fields, 3)
+			stages[fields[0].(string)] = fields[2].(int64)
+		}
+		for _, stage := range []string{"queue", "parse", "execute", "wal_write", "reply"} {
+			require.Contains(t, stages, stage)
+		}
+		require.NoError(t, rdb.ConfigSet(ctx, "request-trace-sample-interval", "0").Err())
+		require.Error(t, rdb.Do(ctx, "slowlog", "get", "1", "foo").Err())
+	})
+
 	t.Run("SLOWLOG - can be disabled", func(t *testing.T) {
 		require.NoError(t, rdb.ConfigSet(ctx, "slowlog-max-len", "1").Err())
 		require.NoError(t, rdb.ConfigSet(ctx, "slowlog-log-slower-than", "1").Err())
@@ -0,0 +1,76 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package tiered
+
+import (
+	"context"
+	"fmt"
+	"path/filepath"
+	"strconv"
+	"testing"
+	"time"
+
+	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/stretchr/testify/require"
+)
+
+func TestTieredStorage(t *testing.T) {
+	coldDir := t.TempDir()
+	srv := util.StartServer(t, map[string]string{
+		"rocksdb.subkey_cold_dir":        coldDir,
+		"rocksdb.subkey_hot_target_size": "1",
+	})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	tierStat := func(name string) int64 {
+		v, err := strconv.ParseInt(util.FindInfoEntry(rdb, name, "rocksdb"), 10, 64)
+		require.NoError(t, err)
+		return v
+	}
+
+	t.Run("Place the subkeys on the cold tier", func(t *testing.T) {
+		for i := 0; i < 1000; i++ {
+			require.NoError(t, rdb.HSet(ctx, "hash", fmt.Sprintf("field%d", i), i).Err())
+		}
+		require.NoError(t, rdb.Do(ctx, "compact").Err())
+		require.Eventually(t, func() bool {
+			return util.FindInfoEntry(rdb, "is_compacting") == "no"
+		}, 10*time.Second, 100*time.Millisecond)
+
+		files, err := filepath.Glob(filepath.Join(coldDir, "*.sst"))
+		require.NoError(t, err)
+		require.NotEmpty(t, files)
+		require.Greater(t, tierStat("cold_tier_size"), int64(0))
+		require.Greater(t, tierStat("hot_tier_size"), int64(0))
+	})
+
+	t.Run("Read the subkeys from the cold tier", func(t *testing.T) {
+		srv.Restart()
+		for i := 0; i < 1000; i++ {
+			require.Equal(t, strconv.Itoa(i), rdb.HGet(ctx, "hash", fmt.Sprintf("field%d", i)).Val())
+		}
+		require.EqualValues(t, 1000, rdb.HLen(ctx, "hash").Val())
+		require.Greater(t, tierStat("cold_tier_reads"), int64(0))
+	})
+}
@@ -0,0 +1,141 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package tracking
+
+import (
+	"context"
+	"strconv"
+	"testing"
+
+	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/stretchr/testify/require"
+)
+
+func subscribeInvalidations(t *testing.T, c *util.TCPClient) {
+	require.NoError(t, c.WriteArgs("SUBSCRIBE", "__redis__:invalidate"))
+	for _, line := range []string{"*3", "$9", "subscribe", "$20", "__redis__:invalidate", ":1"} {
+		c.MustRead(t, line)
+	}
+}
+
+func readInvalidation(t *testing.T, c *util.TCPClient, keys []string) {
+	for _, line := range []string{"*3", "$7", "message", "$20", "__redis__:invalidate"} {
+		c.MustRead(t, line)
+	}
+	if keys == nil {
+		c.MustRead(t, "*-1")
+		return
+	}
+	c.MustReadStrings(t, keys)
+}
+
+func TestClientTracking(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{})
+	defer srv.Close()
+
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+	writer := srv.NewClient()
+	defer func() { require.NoError(t, writer.Close()) }()
+
+	redirect := srv.NewTCPClient()
+	defer func() { require.NoError(t, redirect.Close()) }()
+	require.NoError(t, redirect.WriteArgs("CLIENT", "ID"))
+	line, err := redirect.ReadLine()
+	require.NoError(t, err)
+	redirectID := line[1:]
+	subscribeInvalidations(t, redirect)
+
+	t.Run("CLIENT TRACKING requires REDIRECT", func(t *testing.T) {
+		util.ErrorRegexp(t, rdb.Do(ctx, "CLIENT", "TRACKING", "ON").Err(), ".*REDIRECT.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "CLIENT", "TRACKING", "ON", "REDIRECT", "123456789").Err(),
+			".*does not exist.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "CLIENT", "TRACKING", "ON", "REDIRECT", redirectID, "PREFIX", "a").Err(),
+			".*BCAST.*")
+		require.EqualValues(t, -1, rdb.Do(ctx, "CLIENT", "GETREDIR").Val())
+	})
+
+	t.Run("Invalidate the keys read by the tracking client", func(t *testing.T) {
+		conn := rdb.Conn()
+		defer func() { require.NoError(t, conn.Close()) }()
+		require.NoError(t, conn.Do(ctx, "CLIENT", "TRACKING", "ON", "REDIRECT", redirectID).Err())
+		id, err := strconv.ParseInt(redirectID, 10, 64)
+		require.NoError(t, err)
+		require.EqualValues(t, id, conn.Do(ctx, "CLIENT", "GETREDIR").Val())
+
+		require.NoError(t, writer.Set(ctx, "tracked", "v1", 0).Err())
+		require.Equal(t, "v1", conn.Get(ctx, "tracked").Val())
+		require.NoError(t, writer.Set(ctx, "tracked", "v2", 0).Err())
+		readInvalidation(t, redirect, []string{"tracked"})
+
+		// The key is forgotten once it's invalidated, the next write isn't notified
+		require.NoError(t, writer.Set(ctx, "tracked", "v3", 0).Err())
+		require.Equal(t, "v3", conn.Get(ctx, "tracked").Val())
+		require.NoError(t, writer.Del(ctx, "tracked").Err())
+		readInvalidation(t, redirect, []string{"tracked"})
+
+		require.Equal(t, "", conn.Get(ctx, "tracked").Val())
+		require.NoError(t, writer.Do(ctx, "FLUSHDB").Err())
+		readInvalidation(t, redirect, nil)
+
+		require.NoError(t, conn.Do(ctx, "CLIENT", "TRACKING", "OFF").Err())
+		require.EqualValues(t, -1, conn.Do(ctx, "CLIENT", "GETREDIR").Val())
+	})
+
+	t.Run("Broadcast the writes of the prefixes", func(t *testing.T) {
+		conn := rdb.Conn()
+		defer func() { require.NoError(t, conn.Close()) }()
+		require.NoError(t, conn.Do(ctx, "CLIENT", "TRACKING", "ON", "REDIRECT", redirectID,
+			"BCAST", "PREFIX", "user:", "NOLOOP").Err())
+
+		require.NoError(t, writer.Set(ctx, "item:1", "v", 0).Err())
+		require.NoError(t, conn.Set(ctx, "user:2", "v", 0).Err())
+		require.NoError(t, writer.MSet(ctx, "user:1", "v", "item:2", "v").Err())
+		// The write of the tracking client itself isn't notified by NOLOOP
+		readInvalidation(t, redirect, []string{"user:1"})
+
+		require.NoError(t, conn.Do(ctx, "CLIENT", "TRACKING", "OFF").Err())
+	})
+
+	t.Run("Evict the keys from the tracking table", func(t *testing.T) {
+		require.NoError(t, rdb.ConfigSet(ctx, "tracking-table-max-keys", "1").Err())
+		defer func() { require.NoError(t, rdb.ConfigSet(ctx, "tracking-table-max-keys", "1000000").Err()) }()
+
+		require.NoError(t, writer.MSet(ctx, "evicted", "v", "oneshot", "v").Err())
+		conn := rdb.Conn()
+		defer func() { require.NoError(t, conn.Close()) }()
+		require.NoError(t, conn.Do(ctx, "CLIENT", "TRACKING", "ON", "REDIRECT", redirectID).Err())
+		require.NoError(t, conn.Get(ctx, "evicted").Err())
+		require.NoError(t, conn.Get(ctx, "oneshot").Err())
+		// One of the keys is evicted, and the client is notified as if it was written
+		line, err := redirect.ReadLine()
+		require.NoError(t, err)
+		require.Equal(t, "*3", line)
+		for _, line := range []string{"$7", "message", "$20", "__redis__:invalidate", "*1"} {
+			redirect.MustRead(t, line)
+		}
+		_, err = redirect.ReadLine()
+		require.NoError(t, err)
+		_, err = redirect.ReadLine()
+		require.NoError(t, err)
+		require.Contains(t, rdb.Info(ctx, "clients").Val(), "tracking_total_keys:1")
+	})
+}
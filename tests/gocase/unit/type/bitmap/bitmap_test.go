@@ -236,4 +236,71 @@ func TestBitmap(t *testing.T) {
 		Set2SetBit(t, rdb, ctx, "a", []byte("\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"))
 		require.EqualValues(t, 32, rdb.BitOpOr(ctx, "x", "a", "b").Val())
 	})
+
+	t.Run("BITFIELD signed SET and GET basics", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "bits").Err())
+		require.EqualValues(t, []interface{}{int64(0)}, rdb.Do(ctx, "BITFIELD", "bits", "SET", "i8", 0, -100).Val())
+		require.EqualValues(t, []interface{}{int64(-100)}, rdb.Do(ctx, "BITFIELD", "bits", "SET", "i8", 0, 101).Val())
+		require.EqualValues(t, []interface{}{int64(101)}, rdb.Do(ctx, "BITFIELD", "bits", "GET", "i8", 0).Val())
+	})
+
+	t.Run("BITFIELD unsigned SET and GET basics", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "bits").Err())
+		require.EqualValues(t, []interface{}{int64(0)}, rdb.Do(ctx, "BITFIELD", "bits", "SET", "u8", 0, 255).Val())
+		require.EqualValues(t, []interface{}{int64(255)}, rdb.Do(ctx, "BITFIELD", "bits", "SET", "u8", 0, 100).Val())
+		require.EqualValues(t, []interface{}{int64(100)}, rdb.Do(ctx, "BITFIELD", "bits", "GET", "u8", 0).Val())
+	})
+
+	t.Run("BITFIELD #<idx> form", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "bits").Err())
+		require.NoError(t, rdb.Do(ctx, "BITFIELD", "bits", "SET", "u8", "#0", 65, "SET", "u8", "#1", 66,
+			"SET", "u8", "#2", 67).Err())
+		require.Equal(t, "ABC", rdb.Get(ctx, "bits").Val())
+		require.EqualValues(t, []interface{}{int64(66)}, rdb.Do(ctx, "BITFIELD", "bits", "GET", "u8", "#1").Val())
+	})
+
+	t.Run("BITFIELD overflow detection and the OVERFLOW types", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "bits").Err())
+		require.EqualValues(t, []interface{}{int64(0), int64(9)},
+			rdb.Do(ctx, "BITFIELD", "bits", "SET", "u8", 0, 255, "INCRBY", "u8", 0, 10).Val())
+		require.EqualValues(t, []interface{}{int64(9), int64(255)},
+			rdb.Do(ctx, "BITFIELD", "bits", "OVERFLOW", "SAT", "SET", "u8", 0, 100, "INCRBY", "u8", 0, 200).Val())
+		require.EqualValues(t, []interface{}{nil, int64(255)},
+			rdb.Do(ctx, "BITFIELD", "bits", "OVERFLOW", "FAIL", "INCRBY", "u8", 0, 1, "GET", "u8", 0).Val())
+		require.EqualValues(t, []interface{}{int64(0), int64(-128), int64(127)}, rdb.Do(ctx, "BITFIELD", "bits",
+			"SET", "i8", 8, 127, "INCRBY", "i8", 8, 1, "OVERFLOW", "SAT", "INCRBY", "i8", 8, 1000).Val())
+		require.EqualValues(t, []interface{}{int64(-128)},
+			rdb.Do(ctx, "BITFIELD", "bits", "OVERFLOW", "SAT", "INCRBY", "i8", 8, -1000).Val())
+	})
+
+	t.Run("BITFIELD fields across the segments", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "bits").Err())
+		require.EqualValues(t, []interface{}{int64(0), int64(65535)},
+			rdb.Do(ctx, "BITFIELD", "bits", "SET", "u16", 8190, 65535, "GET", "u16", 8190).Val())
+		require.EqualValues(t, 16, rdb.BitCount(ctx, "bits", &redis.BitCount{Start: 0, End: -1}).Val())
+		require.EqualValues(t, 1, rdb.GetBit(ctx, "bits", 8191).Val())
+		require.EqualValues(t, 1, rdb.GetBit(ctx, "bits", 8192).Val())
+		require.EqualValues(t, 0, rdb.GetBit(ctx, "bits", 8206).Val())
+		require.EqualValues(t, []interface{}{int64(65535), int64(-1)},
+			rdb.Do(ctx, "BITFIELD_RO", "bits", "GET", "i64", 8190-48, "GET", "i16", 8190).Val())
+	})
+
+	t.Run("BITFIELD on the string key", func(t *testing.T) {
+		require.NoError(t, rdb.Set(ctx, "str", "A", 0).Err())
+		require.EqualValues(t, []interface{}{int64(65), int64(66)},
+			rdb.Do(ctx, "BITFIELD", "str", "GET", "u8", 0, "INCRBY", "u8", 0, 1).Val())
+		require.Equal(t, "B", rdb.Get(ctx, "str").Val())
+		require.EqualValues(t, []interface{}{int64(0)}, rdb.Do(ctx, "BITFIELD", "str", "SET", "u8", 8, 67).Val())
+		require.Equal(t, "BC", rdb.Get(ctx, "str").Val())
+	})
+
+	t.Run("BITFIELD with the invalid arguments", func(t *testing.T) {
+		util.ErrorRegexp(t, rdb.Do(ctx, "BITFIELD", "bits", "GET", "u64", 0).Err(), ".*Invalid bitfield type.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "BITFIELD", "bits", "GET", "i65", 0).Err(), ".*Invalid bitfield type.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "BITFIELD", "bits", "GET", "u8", -1).Err(), ".*bit offset.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "BITFIELD", "bits", "GET", "u8", math.MaxUint32).Err(), ".*bit offset.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "BITFIELD", "bits", "OVERFLOW", "foo").Err(), ".*Invalid OVERFLOW.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "BITFIELD", "bits", "SET", "u8", 0).Err(), ".*syntax error.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "BITFIELD_RO", "bits", "SET", "u8", 0, 1).Err(), ".*only supports the GET.*")
+	})
 }
@@ -0,0 +1,80 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package bloom
+
+import (
+	"context"
+	"testing"
+
+	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/stretchr/testify/require"
+)
+
+func TestBloomFilter(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{})
+	defer srv.Close()
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("BF.ADD and BF.EXISTS", func(t *testing.T) {
+		require.EqualValues(t, 0, rdb.Do(ctx, "BF.EXISTS", "bf", "a").Val())
+		require.EqualValues(t, 1, rdb.Do(ctx, "BF.ADD", "bf", "a").Val())
+		require.EqualValues(t, 0, rdb.Do(ctx, "BF.ADD", "bf", "a").Val())
+		require.EqualValues(t, 1, rdb.Do(ctx, "BF.EXISTS", "bf", "a").Val())
+		require.EqualValues(t, "MBbloom--", rdb.Type(ctx, "bf").Val())
+	})
+
+	t.Run("BF.MADD and BF.MEXISTS", func(t *testing.T) {
+		require.EqualValues(t, []interface{}{int64(1), int64(1), int64(0)}, rdb.Do(ctx, "BF.MADD", "bf", "b", "c", "a").Val())
+		require.EqualValues(t, []interface{}{int64(1), int64(1), int64(1), int64(0)}, rdb.Do(ctx, "BF.MEXISTS", "bf", "a", "b", "c", "d").Val())
+		require.EqualValues(t, []interface{}{int64(0), int64(0)}, rdb.Do(ctx, "BF.MEXISTS", "no-such-bf", "a", "b").Val())
+	})
+
+	t.Run("BF.RESERVE", func(t *testing.T) {
+		require.NoError(t, rdb.Do(ctx, "BF.RESERVE", "bf-reserved", 0.001, 1000).Err())
+		require.ErrorContains(t, rdb.Do(ctx, "BF.RESERVE", "bf-reserved", 0.001, 1000).Err(), "item exists")
+		require.EqualValues(t, 1, rdb.Exists(ctx, "bf-reserved").Val())
+		require.NoError(t, rdb.Do(ctx, "BF.RESERVE", "bf-nonscaling", 0.01, 10, "NONSCALING").Err())
+		require.ErrorContains(t, rdb.Do(ctx, "BF.RESERVE", "bf-invalid", 1.5, 1000).Err(), "error rate")
+		require.ErrorContains(t, rdb.Do(ctx, "BF.RESERVE", "bf-invalid", 0.01, 0).Err(), "capacity")
+		require.ErrorContains(t, rdb.Do(ctx, "BF.RESERVE", "bf-invalid", 0.01, 10, "EXPANSION", 2).Err(), "syntax")
+
+		info := rdb.Do(ctx, "BF.INFO", "bf-reserved").Val().([]interface{})
+		require.EqualValues(t, "Capacity", info[0])
+		require.EqualValues(t, 1000, info[1])
+		require.EqualValues(t, "Number of items inserted", info[6])
+		require.EqualValues(t, 0, info[7])
+		require.ErrorContains(t, rdb.Do(ctx, "BF.INFO", "no-such-bf").Err(), "not found")
+	})
+
+	t.Run("BF.ADD on the full filter", func(t *testing.T) {
+		require.NoError(t, rdb.Do(ctx, "BF.RESERVE", "bf-full", 0.01, 2).Err())
+		require.EqualValues(t, []interface{}{int64(1), int64(1)}, rdb.Do(ctx, "BF.MADD", "bf-full", "a", "b").Val())
+		require.ErrorContains(t, rdb.Do(ctx, "BF.ADD", "bf-full", "c").Err(), "filter is full")
+		require.EqualValues(t, 0, rdb.Do(ctx, "BF.ADD", "bf-full", "a").Val())
+	})
+
+	t.Run("BF.ADD against the wrong type", func(t *testing.T) {
+		require.NoError(t, rdb.Set(ctx, "foo", "bar", 0).Err())
+		require.ErrorContains(t, rdb.Do(ctx, "BF.ADD", "foo", "a").Err(), "WRONGTYPE")
+		require.ErrorContains(t, rdb.Do(ctx, "BF.EXISTS", "foo", "a").Err(), "WRONGTYPE")
+	})
+}
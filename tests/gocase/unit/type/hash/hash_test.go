@@ -30,6 +30,7 @@ import (
 	"time"
 
 	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/go-redis/redis/v9"
 	"github.com/stretchr/testify/require"
 )
 
@@ -303,6 +304,44 @@ func TestHash(t *testing.T) {
 		require.Equal(t, bighash, mid)
 	})
 
+	t.Run("HRANDFIELD with and without count", func(t *testing.T) {
+		for _, key := range []string{"smallhash", "bighash"} {
+			expected := smallhash
+			if key == "bighash" {
+				expected = bighash
+			}
+			field := rdb.Do(ctx, "hrandfield", key).Val().(string)
+			require.Contains(t, expected, field)
+
+			res := rdb.Do(ctx, "hrandfield", key, 5, "withvalues").Val().([]interface{})
+			require.Len(t, res, 10)
+			fields := make(map[string]string)
+			for i := 0; i < len(res); i += 2 {
+				fields[res[i].(string)] = res[i+1].(string)
+				require.Equal(t, expected[res[i].(string)], res[i+1].(string))
+			}
+			require.Len(t, fields, 5)
+
+			require.Len(t, rdb.Do(ctx, "hrandfield", key, -20).Val(), 20)
+			require.Len(t, rdb.Do(ctx, "hrandfield", key, 5000).Val(), len(expected))
+		}
+		require.Equal(t, redis.Nil, rdb.Do(ctx, "hrandfield", "nonexisting_hash").Err())
+		require.Len(t, rdb.Do(ctx, "hrandfield", "nonexisting_hash", 3).Val(), 0)
+		util.ErrorRegexp(t, rdb.Do(ctx, "hrandfield", "bighash", 3, "withscores").Err(), ".*syntax.*")
+	})
+
+	t.Run("HGETALL/HKEYS/HVALS - hash spans multiple reply chunks", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "hugehash").Err())
+		expect := make(map[string]string)
+		for i := 0; i < 5000; i++ {
+			expect[fmt.Sprintf("field-%d", i)] = fmt.Sprintf("value-%d", i)
+		}
+		require.NoError(t, rdb.HSet(ctx, "hugehash", expect).Err())
+		require.Equal(t, expect, rdb.HGetAll(ctx, "hugehash").Val())
+		require.Len(t, rdb.HKeys(ctx, "hugehash").Val(), len(expect))
+		require.Len(t, rdb.HVals(ctx, "hugehash").Val(), len(expect))
+	})
+
 	t.Run("HDEL and return value", func(t *testing.T) {
 		var rv []string
 		rv = append(rv, fmt.Sprintf("%d", rdb.HDel(ctx, "smallhash", "nokey").Val()))
@@ -665,3 +704,54 @@ func TestHash(t *testing.T) {
 		})
 	}
 }
+
+func TestHashWithInlineEncoding(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"hash-inline-max-entries": "16", "hash-inline-max-bytes": "1024"})
+	defer srv.Close()
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("Read and write the inline hash", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "inlinehash").Err())
+		require.EqualValues(t, 3, rdb.HSet(ctx, "inlinehash", "a", "1", "b", "2", "c", "3").Val())
+		require.Equal(t, "2", rdb.HGet(ctx, "inlinehash", "b").Val())
+		require.Equal(t, []interface{}{"1", nil, "3"}, rdb.HMGet(ctx, "inlinehash", "a", "x", "c").Val())
+		require.EqualValues(t, 12, rdb.HIncrBy(ctx, "inlinehash", "c", 9).Val())
+		require.EqualValues(t, 1, rdb.HSet(ctx, "inlinehash", "d", "2.5").Val())
+		require.False(t, rdb.HSetNX(ctx, "inlinehash", "a", "9").Val())
+		require.EqualValues(t, 1, rdb.HDel(ctx, "inlinehash", "b", "x").Val())
+		require.EqualValues(t, 3, rdb.HLen(ctx, "inlinehash").Val())
+		require.Equal(t, map[string]string{"a": "1", "c": "12", "d": "2.5"}, rdb.HGetAll(ctx, "inlinehash").Val())
+		keys, _ := rdb.HScan(ctx, "inlinehash", 0, "*", 10).Val()
+		require.Equal(t, []string{"a", "1", "c", "12", "d", "2.5"}, keys)
+		require.EqualValues(t, 2, rdb.HDel(ctx, "inlinehash", "a", "c").Val())
+		require.EqualValues(t, 1, rdb.HDel(ctx, "inlinehash", "d").Val())
+		require.EqualValues(t, 0, rdb.Exists(ctx, "inlinehash").Val())
+	})
+
+	t.Run("The inline hash is converted when it grows", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "inlinehash").Err())
+		expected := make(map[string]string)
+		for i := 0; i < 40; i++ {
+			field, value := fmt.Sprintf("field-%d", i), fmt.Sprintf("value-%d", i)
+			require.EqualValues(t, 1, rdb.HSet(ctx, "inlinehash", field, value).Val())
+			expected[field] = value
+		}
+		require.Equal(t, expected, rdb.HGetAll(ctx, "inlinehash").Val())
+		require.EqualValues(t, 40, rdb.HLen(ctx, "inlinehash").Val())
+
+		require.NoError(t, rdb.Del(ctx, "inlinehash").Err())
+		require.EqualValues(t, 1, rdb.HSet(ctx, "inlinehash", "big", strings.Repeat("x", 2048)).Val())
+		require.Equal(t, strings.Repeat("x", 2048), rdb.HGet(ctx, "inlinehash", "big").Val())
+	})
+
+	t.Run("Expire the inline hash", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "inlinehash").Err())
+		require.EqualValues(t, 1, rdb.HSet(ctx, "inlinehash", "a", "1").Val())
+		require.True(t, rdb.Expire(ctx, "inlinehash", 100*time.Second).Val())
+		require.Equal(t, "1", rdb.HGet(ctx, "inlinehash", "a").Val())
+		require.True(t, rdb.Persist(ctx, "inlinehash").Val())
+		require.Equal(t, map[string]string{"a": "1"}, rdb.HGetAll(ctx, "inlinehash").Val())
+	})
+}
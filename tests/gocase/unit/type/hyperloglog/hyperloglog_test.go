@@ -0,0 +1,102 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package hyperloglog
+
+import (
+	"context"
+	"fmt"
+	"testing"
+
+	"github.com/apache/incubator-kvrocks/tests/gocase/util"
+	"github.com/stretchr/testify/require"
+)
+
+func TestHyperLogLog(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{})
+	defer srv.Close()
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("PFADD without elements creates an HLL value", func(t *testing.T) {
+		require.EqualValues(t, 1, rdb.PFAdd(ctx, "hll-empty").Val())
+		require.EqualValues(t, 1, rdb.Exists(ctx, "hll-empty").Val())
+		require.EqualValues(t, "hyperloglog", rdb.Type(ctx, "hll-empty").Val())
+		require.EqualValues(t, 0, rdb.PFCount(ctx, "hll-empty").Val())
+	})
+
+	t.Run("PFADD returns 1 when at least 1 reg was modified", func(t *testing.T) {
+		require.EqualValues(t, 1, rdb.PFAdd(ctx, "hll", "a", "b", "c").Val())
+		require.EqualValues(t, 0, rdb.PFAdd(ctx, "hll", "a", "b", "c").Val())
+		require.EqualValues(t, 1, rdb.PFAdd(ctx, "hll", "d").Val())
+		require.EqualValues(t, 4, rdb.PFCount(ctx, "hll").Val())
+	})
+
+	t.Run("PFCOUNT returns approximated cardinality of set", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "hll").Err())
+		for i := 0; i < 100; i++ {
+			args := make([]interface{}, 0, 100)
+			for j := 0; j < 100; j++ {
+				args = append(args, fmt.Sprintf("ele-%d-%d", i, j))
+			}
+			require.NoError(t, rdb.PFAdd(ctx, "hll", args...).Err())
+		}
+		require.InEpsilon(t, 10000, rdb.PFCount(ctx, "hll").Val(), 0.05)
+		// The cached cardinality is returned until the next write
+		require.InEpsilon(t, 10000, rdb.PFCount(ctx, "hll").Val(), 0.05)
+		require.EqualValues(t, 1, rdb.PFAdd(ctx, "hll", "foo", "bar", "zap").Val())
+		require.InEpsilon(t, 10003, rdb.PFCount(ctx, "hll").Val(), 0.05)
+	})
+
+	t.Run("PFCOUNT multiple-keys merge returns cardinality of union", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "hll1", "hll2", "hll3").Err())
+		require.NoError(t, rdb.PFAdd(ctx, "hll1", "foo", "bar", "zap", "a").Err())
+		require.NoError(t, rdb.PFAdd(ctx, "hll2", "a", "b", "c", "foo").Err())
+		require.NoError(t, rdb.PFAdd(ctx, "hll3", "c", "d", "e", "f", "g").Err())
+		require.EqualValues(t, 10, rdb.PFCount(ctx, "hll1", "hll2", "hll3").Val())
+		require.EqualValues(t, 10, rdb.PFCount(ctx, "hll1", "hll2", "hll3").Val())
+		// The write of any key invalidates the cached union
+		require.NoError(t, rdb.PFAdd(ctx, "hll3", "h").Err())
+		require.EqualValues(t, 11, rdb.PFCount(ctx, "hll1", "hll2", "hll3").Val())
+		require.NoError(t, rdb.Del(ctx, "hll2").Err())
+		require.EqualValues(t, 10, rdb.PFCount(ctx, "hll1", "hll2", "hll3").Val())
+	})
+
+	t.Run("PFMERGE results on the cardinality of union of sets", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "hll", "hll1", "hll2", "hll3").Err())
+		require.NoError(t, rdb.PFAdd(ctx, "hll1", "a", "b", "c").Err())
+		require.NoError(t, rdb.PFAdd(ctx, "hll2", "b", "c", "d").Err())
+		require.NoError(t, rdb.PFAdd(ctx, "hll3", "c", "d", "e").Err())
+		require.NoError(t, rdb.PFMerge(ctx, "hll", "hll1", "hll2", "hll3").Err())
+		require.EqualValues(t, 5, rdb.PFCount(ctx, "hll").Val())
+		require.NoError(t, rdb.PFMerge(ctx, "hll", "hll1", "no-such-key").Err())
+		require.EqualValues(t, 5, rdb.PFCount(ctx, "hll").Val())
+		require.NoError(t, rdb.PFMerge(ctx, "hll-new").Err())
+		require.EqualValues(t, 1, rdb.Exists(ctx, "hll-new").Val())
+	})
+
+	t.Run("PFADD, PFCOUNT, PFMERGE type checking works", func(t *testing.T) {
+		require.NoError(t, rdb.Set(ctx, "foo", "bar", 0).Err())
+		require.ErrorContains(t, rdb.PFAdd(ctx, "foo", "1").Err(), "WRONGTYPE")
+		require.ErrorContains(t, rdb.PFCount(ctx, "foo").Err(), "WRONGTYPE")
+		require.ErrorContains(t, rdb.PFMerge(ctx, "bar", "foo").Err(), "WRONGTYPE")
+		require.ErrorContains(t, rdb.PFMerge(ctx, "foo", "bar").Err(), "WRONGTYPE")
+	})
+}
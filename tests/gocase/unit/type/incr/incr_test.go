@@ -84,6 +84,19 @@ func TestIncr(t *testing.T) {
 		require.EqualValues(t, -1, rdb.DecrBy(ctx, "novar", 17179869185).Val())
 	})
 
+	t.Run("INCRBY and DECRBY with NOREPLY", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "novar").Err())
+		require.Equal(t, "OK", rdb.Do(ctx, "INCRBY", "novar", 10, "NOREPLY").Val())
+		require.Equal(t, "OK", rdb.Do(ctx, "DECRBY", "novar", 3, "noreply").Val())
+		require.EqualValues(t, "7", rdb.Get(ctx, "novar").Val())
+		require.EqualValues(t, 8, rdb.Incr(ctx, "novar").Val())
+
+		require.NoError(t, rdb.Set(ctx, "novar", "abc", 0).Err())
+		require.Equal(t, "OK", rdb.Do(ctx, "INCRBY", "novar", 1, "NOREPLY").Val())
+		require.EqualValues(t, "abc", rdb.Get(ctx, "novar").Val())
+		require.ErrorContains(t, rdb.Do(ctx, "INCRBY", "novar", 1, "REPLY").Err(), "syntax error")
+	})
+
 	t.Run("INCRBYFLOAT against non existing key", func(t *testing.T) {
 		require.NoError(t, rdb.Del(ctx, "novar").Err())
 		require.EqualValues(t, 1, rdb.IncrByFloat(ctx, "novar", 1.0).Val())
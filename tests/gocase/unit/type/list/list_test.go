@@ -400,6 +400,45 @@ func TestList(t *testing.T) {
 		require.Equal(t, "foo", rdb.LRange(ctx, "blist", 0, -1).Val()[0])
 	})
 
+	t.Run("LMPOP pops from the first non-empty list", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "mlist1", "mlist2", "mlist3").Err())
+		require.NoError(t, rdb.RPush(ctx, "mlist2", "a", "b", "c").Err())
+		require.NoError(t, rdb.RPush(ctx, "mlist3", "d").Err())
+		require.Equal(t, []interface{}{"mlist2", []interface{}{"a"}},
+			rdb.Do(ctx, "lmpop", "3", "mlist1", "mlist2", "mlist3", "left").Val())
+		require.Equal(t, []interface{}{"mlist2", []interface{}{"c", "b"}},
+			rdb.Do(ctx, "lmpop", "2", "mlist1", "mlist2", "right", "count", "5").Val())
+		require.EqualValues(t, 0, rdb.Exists(ctx, "mlist2").Val())
+		require.Equal(t, []interface{}{"mlist3", []interface{}{"d"}},
+			rdb.Do(ctx, "lmpop", "3", "mlist1", "mlist2", "mlist3", "left", "count", "2").Val())
+		require.Equal(t, redis.Nil, rdb.Do(ctx, "lmpop", "2", "mlist1", "mlist3", "left").Err())
+
+		util.ErrorRegexp(t, rdb.Do(ctx, "lmpop", "0", "mlist1", "left").Err(), ".*numkeys.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "lmpop", "2", "mlist1", "left").Err(), ".*syntax.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "lmpop", "1", "mlist1", "up").Err(), ".*syntax.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "lmpop", "1", "mlist1", "left", "count", "0").Err(), ".*count.*")
+		require.NoError(t, rdb.Set(ctx, "mlist1", "nolist", 0).Err())
+		util.ErrorRegexp(t, rdb.Do(ctx, "lmpop", "1", "mlist1", "left").Err(), ".*WRONGTYPE.*")
+		require.NoError(t, rdb.Del(ctx, "mlist1").Err())
+	})
+
+	t.Run("BLMPOP blocks until any of the lists is pushed", func(t *testing.T) {
+		rd := srv.NewTCPClient()
+		defer func() { require.NoError(t, rd.Close()) }()
+		require.NoError(t, rdb.Del(ctx, "mlist1", "mlist2").Err())
+		require.NoError(t, rd.WriteArgs("blmpop", "0", "2", "mlist1", "mlist2", "right", "count", "2"))
+		time.Sleep(time.Millisecond * 100)
+		require.NoError(t, rdb.RPush(ctx, "mlist2", "a", "b", "c").Err())
+		rd.MustRead(t, "*2")
+		rd.MustRead(t, "$6")
+		rd.MustRead(t, "mlist2")
+		rd.MustReadStrings(t, []string{"c", "b"})
+		require.Equal(t, []string{"a"}, rdb.LRange(ctx, "mlist2", 0, -1).Val())
+
+		require.NoError(t, rd.WriteArgs("blmpop", "1", "1", "mlist1", "left"))
+		rd.MustRead(t, "*-1")
+	})
+
 	for _, popType := range []string{"blpop", "brpop"} {
 		t.Run(fmt.Sprintf("%s: with single empty list argument", popType), func(t *testing.T) {
 			rd := srv.NewTCPClient()
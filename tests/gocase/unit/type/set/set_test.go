@@ -21,6 +21,7 @@ package set
 
 import (
 	"context"
+	"fmt"
 	"sort"
 	"strconv"
 	"testing"
@@ -407,6 +408,43 @@ func TestSet(t *testing.T) {
 		require.EqualValues(t, []string{"1", "2", "3"}, rdb.SInter(ctx, "set1", "set2").Val())
 	})
 
+	t.Run("SINTERCARD basics", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "set1", "set2", "set3").Err())
+		require.NoError(t, rdb.SAdd(ctx, "set1", "a", "b", "c", "d", "e").Err())
+		require.NoError(t, rdb.SAdd(ctx, "set2", "b", "c", "d", "f").Err())
+		require.NoError(t, rdb.SAdd(ctx, "set3", "c", "d", "g").Err())
+		require.EqualValues(t, 3, rdb.Do(ctx, "SINTERCARD", 2, "set1", "set2").Val())
+		require.EqualValues(t, 2, rdb.Do(ctx, "SINTERCARD", 3, "set1", "set2", "set3").Val())
+		require.EqualValues(t, 1, rdb.Do(ctx, "SINTERCARD", 3, "set1", "set2", "set3", "LIMIT", 1).Val())
+		require.EqualValues(t, 2, rdb.Do(ctx, "SINTERCARD", 3, "set1", "set2", "set3", "LIMIT", 0).Val())
+		require.EqualValues(t, 0, rdb.Do(ctx, "SINTERCARD", 2, "set1", "nokey").Val())
+	})
+
+	t.Run("SINTERCARD with illegal arguments", func(t *testing.T) {
+		util.ErrorRegexp(t, rdb.Do(ctx, "SINTERCARD", 0, "set1").Err(), ".*greater than 0.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "SINTERCARD", 3, "set1", "set2").Err(), ".*greater than number of args.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "SINTERCARD", 1, "set1", "LIMIT", -1).Err(), ".*can't be negative.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "SINTERCARD", 1, "set1", "LIMIT").Err(), ".*syntax.*")
+		require.NoError(t, rdb.Set(ctx, "key1", "x", 0).Err())
+		util.ErrorRegexp(t, rdb.Do(ctx, "SINTERCARD", 2, "set1", "key1").Err(), ".*WRONGTYPE.*")
+	})
+
+	t.Run("SINTER, SUNION and SDIFF between the small and the large sets", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "set1", "set2").Err())
+		var large []interface{}
+		for i := 0; i < 1000; i++ {
+			large = append(large, fmt.Sprintf("m%04d", i))
+		}
+		require.NoError(t, rdb.SAdd(ctx, "set1", large...).Err())
+		require.NoError(t, rdb.SAdd(ctx, "set2", "m0007", "m0500", "m0999", "x").Err())
+		require.Equal(t, []string{"m0007", "m0500", "m0999"}, rdb.SInter(ctx, "set1", "set2").Val())
+		require.Equal(t, []string{"m0007", "m0500", "m0999"}, rdb.SInter(ctx, "set2", "set1").Val())
+		require.Equal(t, []string{"x"}, rdb.SDiff(ctx, "set2", "set1").Val())
+		require.Len(t, rdb.SDiff(ctx, "set1", "set2").Val(), 997)
+		require.Len(t, rdb.SUnion(ctx, "set1", "set2").Val(), 1001)
+		require.EqualValues(t, 2, rdb.Do(ctx, "SINTERCARD", 2, "set1", "set2", "LIMIT", 2).Val())
+	})
+
 	t.Run("SINTERSTORE against non existing keys should delete dstkey", func(t *testing.T) {
 		require.NoError(t, rdb.Set(ctx, "setres", "xxx", 0).Err())
 		require.EqualValues(t, 0, rdb.SInterStore(ctx, "setres", "foo111", "bar222").Val())
@@ -702,3 +740,38 @@ func TestSet(t *testing.T) {
 		}
 	})
 }
+
+func TestSetWithInlineEncoding(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"set-inline-max-entries": "16"})
+	defer srv.Close()
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	t.Run("SADD, SREM, SPOP and SMEMBERS with the inline encoding", func(t *testing.T) {
+		rdb.Del(ctx, "sinline")
+		require.EqualValues(t, 3, rdb.SAdd(ctx, "sinline", "a", "b", "c").Val())
+		require.EqualValues(t, 0, rdb.SAdd(ctx, "sinline", "a").Val())
+		require.Equal(t, []bool{true, false}, rdb.SMIsMember(ctx, "sinline", "b", "x").Val())
+		require.EqualValues(t, 1, rdb.SRem(ctx, "sinline", "a", "x").Val())
+		members := rdb.SMembers(ctx, "sinline").Val()
+		sort.Strings(members)
+		require.Equal(t, []string{"b", "c"}, members)
+		require.NotEmpty(t, rdb.SPop(ctx, "sinline").Val())
+		require.EqualValues(t, 1, rdb.SCard(ctx, "sinline").Val())
+	})
+
+	t.Run("SADD converts from the inline encoding when growing", func(t *testing.T) {
+		rdb.Del(ctx, "sinline")
+		var expected []string
+		for i := 0; i < 40; i++ {
+			member := fmt.Sprintf("m%02d", i)
+			expected = append(expected, member)
+			require.EqualValues(t, 1, rdb.SAdd(ctx, "sinline", member).Val())
+		}
+		members := rdb.SMembers(ctx, "sinline").Val()
+		sort.Strings(members)
+		require.Equal(t, expected, members)
+		require.EqualValues(t, 40, rdb.SCard(ctx, "sinline").Val())
+	})
+}
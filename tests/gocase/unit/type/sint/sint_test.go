@@ -49,4 +49,28 @@ func TestSint(t *testing.T) {
 		require.EqualValues(t, 1, rdb.Do(ctx, "SIREM", "mysi", 2).Val())
 	})
 
+	t.Run("sorted-int with the block encoding", func(t *testing.T) {
+		require.NoError(t, rdb.Do(ctx, "CONFIG", "SET", "sortedint-block-encoding", "yes").Err())
+		defer func() { require.NoError(t, rdb.Do(ctx, "CONFIG", "SET", "sortedint-block-encoding", "no").Err()) }()
+		require.EqualValues(t, 1, rdb.Do(ctx, "SIADD", "mysi-blocks", 1).Val())
+		require.EqualValues(t, 0, rdb.Do(ctx, "SIADD", "mysi-blocks", 1).Val())
+		args := []interface{}{"SIADD", "mysi-blocks"}
+		for i := 1000; i > 1; i-- {
+			args = append(args, i*10)
+		}
+		require.EqualValues(t, 999, rdb.Do(ctx, args...).Val())
+		require.EqualValues(t, 1000, rdb.Do(ctx, "SICARD", "mysi-blocks").Val())
+		require.EqualValues(t, []interface{}{"10000", "9990"}, rdb.Do(ctx, "SIREVRANGE", "mysi-blocks", 0, 2).Val())
+		require.EqualValues(t, []interface{}{"2570", "2580"},
+			rdb.Do(ctx, "SIRANGE", "mysi-blocks", 0, 2, "cursor", 2560).Val())
+		require.EqualValues(t, []interface{}{"1", "20", "30"},
+			rdb.Do(ctx, "SIRANGEBYVALUE", "mysi-blocks", 1, "(40").Val())
+		require.EqualValues(t, []interface{}{int64(1), int64(0), int64(1)},
+			rdb.Do(ctx, "SIEXISTS", "mysi-blocks", 2560, 2565, 10000).Val())
+		require.EqualValues(t, 2, rdb.Do(ctx, "SIREM", "mysi-blocks", 1, 2560, 2565).Val())
+		require.EqualValues(t, 998, rdb.Do(ctx, "SICARD", "mysi-blocks").Val())
+		require.EqualValues(t, []interface{}{"20"}, rdb.Do(ctx, "SIRANGE", "mysi-blocks", 0, 1).Val())
+		require.EqualValues(t, []interface{}{"2550", "2570"},
+			rdb.Do(ctx, "SIRANGEBYVALUE", "mysi-blocks", 2550, 2570).Val())
+	})
 }
@@ -70,6 +70,21 @@ func TestStream(t *testing.T) {
 		require.EqualValues(t, map[string]interface{}{"ItEm": "2", "VaLUe": "B"}, items[1].Values)
 	})
 
+	t.Run("XADD with RETENTION trims the old entries", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "retention-stream").Err())
+		require.NoError(t, rdb.Do(ctx, "XADD", "retention-stream", "1-0", "item", "1").Err())
+		require.NoError(t, rdb.Do(ctx, "XADD", "retention-stream", "2-0", "item", "2").Err())
+		id := rdb.Do(ctx, "XADD", "retention-stream", "RETENTION", "60000", "*", "item", "3").Val()
+		require.EqualValues(t, 1, rdb.XLen(ctx, "retention-stream").Val())
+		items := rdb.XRange(ctx, "retention-stream", "-", "+").Val()
+		require.Len(t, items, 1)
+		require.Equal(t, id, items[0].ID)
+		require.Len(t, rdb.XRevRange(ctx, "retention-stream", "+", "-").Val(), 1)
+		require.EqualValues(t, 0, rdb.XDel(ctx, "retention-stream", "1-0").Val())
+		require.ErrorContains(t, rdb.Do(ctx, "XADD", "retention-stream", "RETENTION", "a", "*", "item", "4").Err(),
+			"not an integer")
+	})
+
 	t.Run("XADD IDs are incremental", func(t *testing.T) {
 		x1 := rdb.XAdd(ctx, &redis.XAddArgs{Stream: "mystream", Values: []string{"item", "1", "value", "a"}}).Val()
 		x2 := rdb.XAdd(ctx, &redis.XAddArgs{Stream: "mystream", Values: []string{"item", "2", "value", "b"}}).Val()
@@ -729,4 +744,124 @@ func TestStreamOffset(t *testing.T) {
 		r = rdb.XInfoStreamFull(ctx, "x", 0).Val()
 		require.Equal(t, "2-0", r.MaxDeletedEntryID)
 	})
+
+	t.Run("XGROUP CREATE requires the key to exist unless MKSTREAM", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "mystream").Err())
+		require.ErrorContains(t, rdb.XGroupCreate(ctx, "mystream", "mygroup", "$").Err(), "requires the key to exist")
+		require.NoError(t, rdb.XGroupCreateMkStream(ctx, "mystream", "mygroup", "$").Err())
+		require.ErrorContains(t, rdb.XGroupCreate(ctx, "mystream", "mygroup", "$").Err(), "BUSYGROUP")
+		require.EqualValues(t, 0, rdb.XLen(ctx, "mystream").Val())
+		require.ErrorContains(t, rdb.XGroupSetID(ctx, "mystream", "nogroup", "0").Err(), "NOGROUP")
+		require.EqualValues(t, 0, rdb.XGroupDestroy(ctx, "mystream", "nogroup").Val())
+		require.EqualValues(t, 1, rdb.XGroupDestroy(ctx, "mystream", "mygroup").Val())
+	})
+
+	t.Run("XREADGROUP delivers the new entries once and tracks them in the PEL", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "mystream").Err())
+		for i := 1; i <= 4; i++ {
+			require.NoError(t, rdb.XAdd(ctx, &redis.XAddArgs{Stream: "mystream", ID: fmt.Sprintf("%d-0", i), Values: []string{"item", strconv.Itoa(i)}}).Err())
+		}
+		require.NoError(t, rdb.XGroupCreate(ctx, "mystream", "mygroup", "0").Err())
+
+		r, err := rdb.XReadGroup(ctx, &redis.XReadGroupArgs{Group: "mygroup", Consumer: "consumer-1", Streams: []string{"mystream", ">"}, Count: 2}).Result()
+		require.NoError(t, err)
+		require.Len(t, r[0].Messages, 2)
+		require.Equal(t, "1-0", r[0].Messages[0].ID)
+		require.Equal(t, map[string]interface{}{"item": "1"}, r[0].Messages[0].Values)
+
+		r, err = rdb.XReadGroup(ctx, &redis.XReadGroupArgs{Group: "mygroup", Consumer: "consumer-2", Streams: []string{"mystream", ">"}}).Result()
+		require.NoError(t, err)
+		require.Len(t, r[0].Messages, 2)
+		require.Equal(t, "3-0", r[0].Messages[0].ID)
+
+		require.ErrorIs(t, rdb.XReadGroup(ctx, &redis.XReadGroupArgs{Group: "mygroup", Consumer: "consumer-2", Streams: []string{"mystream", ">"}}).Err(), redis.Nil)
+		require.ErrorContains(t, rdb.XReadGroup(ctx, &redis.XReadGroupArgs{Group: "nogroup", Consumer: "consumer-2", Streams: []string{"mystream", ">"}}).Err(), "NOGROUP")
+
+		pending := rdb.XPending(ctx, "mystream", "mygroup").Val()
+		require.EqualValues(t, 4, pending.Count)
+		require.Equal(t, "1-0", pending.Lower)
+		require.Equal(t, "4-0", pending.Higher)
+		require.Equal(t, map[string]int64{"consumer-1": 2, "consumer-2": 2}, pending.Consumers)
+
+		// the history of the consumer
+		r, err = rdb.XReadGroup(ctx, &redis.XReadGroupArgs{Group: "mygroup", Consumer: "consumer-1", Streams: []string{"mystream", "0"}}).Result()
+		require.NoError(t, err)
+		require.Len(t, r[0].Messages, 2)
+		require.Equal(t, "2-0", r[0].Messages[1].ID)
+
+		require.EqualValues(t, 2, rdb.XAck(ctx, "mystream", "mygroup", "1-0", "3-0", "9-0").Val())
+		ext := rdb.XPendingExt(ctx, &redis.XPendingExtArgs{Stream: "mystream", Group: "mygroup", Start: "-", End: "+", Count: 10}).Val()
+		require.Len(t, ext, 2)
+		require.Equal(t, "2-0", ext[0].ID)
+		require.Equal(t, "consumer-1", ext[0].Consumer)
+		require.EqualValues(t, 1, ext[0].RetryCount)
+		ext = rdb.XPendingExt(ctx, &redis.XPendingExtArgs{Stream: "mystream", Group: "mygroup", Start: "-", End: "+", Count: 10, Consumer: "consumer-2"}).Val()
+		require.Len(t, ext, 1)
+		require.Equal(t, "4-0", ext[0].ID)
+
+		groups := rdb.XInfoGroups(ctx, "mystream").Val()
+		require.Len(t, groups, 1)
+		require.Equal(t, "mygroup", groups[0].Name)
+		require.EqualValues(t, 2, groups[0].Consumers)
+		require.EqualValues(t, 2, groups[0].Pending)
+		require.Equal(t, "4-0", groups[0].LastDeliveredID)
+	})
+
+	t.Run("XCLAIM and XAUTOCLAIM transfer the idle pending entries", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "mystream").Err())
+		for i := 1; i <= 3; i++ {
+			require.NoError(t, rdb.XAdd(ctx, &redis.XAddArgs{Stream: "mystream", ID: fmt.Sprintf("%d-0", i), Values: []string{"item", strconv.Itoa(i)}}).Err())
+		}
+		require.NoError(t, rdb.XGroupCreate(ctx, "mystream", "mygroup", "0").Err())
+		require.NoError(t, rdb.XReadGroup(ctx, &redis.XReadGroupArgs{Group: "mygroup", Consumer: "consumer-1", Streams: []string{"mystream", ">"}}).Err())
+
+		claimed := rdb.XClaim(ctx, &redis.XClaimArgs{Stream: "mystream", Group: "mygroup", Consumer: "consumer-2", MinIdle: time.Hour, Messages: []string{"1-0"}}).Val()
+		require.Len(t, claimed, 0)
+		time.Sleep(10 * time.Millisecond)
+		claimed = rdb.XClaim(ctx, &redis.XClaimArgs{Stream: "mystream", Group: "mygroup", Consumer: "consumer-2", MinIdle: 5 * time.Millisecond, Messages: []string{"1-0"}}).Val()
+		require.Len(t, claimed, 1)
+		require.Equal(t, "1-0", claimed[0].ID)
+		ids := rdb.XClaimJustID(ctx, &redis.XClaimArgs{Stream: "mystream", Group: "mygroup", Consumer: "consumer-2", Messages: []string{"2-0"}}).Val()
+		require.Equal(t, []string{"2-0"}, ids)
+
+		require.NoError(t, rdb.XDel(ctx, "mystream", "3-0").Err())
+		r, err := rdb.Do(ctx, "XAUTOCLAIM", "mystream", "mygroup", "consumer-3", "0", "0", "COUNT", "1", "JUSTID").Slice()
+		require.NoError(t, err)
+		require.Equal(t, []interface{}{"2-0", []interface{}{"1-0"}, []interface{}{}}, r)
+		r, err = rdb.Do(ctx, "XAUTOCLAIM", "mystream", "mygroup", "consumer-3", "0", "2-0", "JUSTID").Slice()
+		require.NoError(t, err)
+		require.Equal(t, []interface{}{"0-0", []interface{}{"2-0"}, []interface{}{"3-0"}}, r)
+
+		pending := rdb.XPending(ctx, "mystream", "mygroup").Val()
+		require.EqualValues(t, 2, pending.Count)
+		require.Equal(t, map[string]int64{"consumer-3": 2}, pending.Consumers)
+		require.EqualValues(t, 2, rdb.XGroupDelConsumer(ctx, "mystream", "mygroup", "consumer-3").Val())
+		require.EqualValues(t, 0, rdb.XPending(ctx, "mystream", "mygroup").Val().Count)
+	})
+
+	t.Run("Blocking XREADGROUP is woken up by XADD", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "mystream").Err())
+		require.NoError(t, rdb.XGroupCreateMkStream(ctx, "mystream", "mygroup", "$").Err())
+
+		c := srv.NewClient()
+		defer func() { require.NoError(t, c.Close()) }()
+		ch := make(chan []redis.XStream)
+		go func() {
+			r, _ := c.XReadGroup(ctx, &redis.XReadGroupArgs{Group: "mygroup", Consumer: "consumer-1", Streams: []string{"mystream", ">"}, Block: 10 * time.Second}).Result()
+			ch <- r
+		}()
+		require.Eventually(t, func() bool {
+			cnt, _ := strconv.Atoi(util.FindInfoEntry(rdb, "blocked_clients"))
+			return cnt > 0
+		}, 5*time.Second, 100*time.Millisecond)
+		require.NoError(t, rdb.XAdd(ctx, &redis.XAddArgs{Stream: "mystream", ID: "1-0", Values: []string{"item", "1"}}).Err())
+
+		r := <-ch
+		require.Len(t, r, 1)
+		require.Len(t, r[0].Messages, 1)
+		require.Equal(t, "1-0", r[0].Messages[0].ID)
+		require.EqualValues(t, 1, rdb.XPending(ctx, "mystream", "mygroup").Val().Count)
+
+		require.ErrorIs(t, rdb.XReadGroup(ctx, &redis.XReadGroupArgs{Group: "mygroup", Consumer: "consumer-1", Streams: []string{"mystream", ">"}, Block: 100 * time.Millisecond}).Err(), redis.Nil)
+	})
 }
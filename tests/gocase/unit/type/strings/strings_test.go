@@ -697,4 +697,28 @@ func TestString(t *testing.T) {
 		require.ErrorContains(t, rdb.Do(ctx, "CAD", "cad_key").Err(), "ERR wrong number of arguments")
 		require.ErrorContains(t, rdb.Do(ctx, "CAD", "cad_key", "123", "234").Err(), "ERR wrong number of arguments")
 	})
+
+	t.Run("APPEND/SETRANGE/GETRANGE against chunked string", func(t *testing.T) {
+		require.NoError(t, rdb.Do(ctx, "CONFIG", "SET", "string-chunked-min-bytes", "1").Err())
+		defer func() {
+			require.NoError(t, rdb.Do(ctx, "CONFIG", "SET", "string-chunked-min-bytes", "0").Err())
+		}()
+		require.NoError(t, rdb.Del(ctx, "mykey").Err())
+
+		value := strings.Repeat("a", 20000)
+		require.EqualValues(t, 20000, rdb.Append(ctx, "mykey", value).Val())
+		require.EqualValues(t, 20005, rdb.Append(ctx, "mykey", "bbbbb").Val())
+		require.EqualValues(t, 20005, rdb.SetRange(ctx, "mykey", 16382, "cccc").Val())
+		require.EqualValues(t, 50003, rdb.SetRange(ctx, "mykey", 50000, "ddd").Val())
+		value = value[:16382] + "cccc" + value[16386:] + "bbbbb" + strings.Repeat("\x00", 50000-20005) + "ddd"
+		require.Equal(t, value, rdb.Get(ctx, "mykey").Val())
+		require.EqualValues(t, 50003, rdb.StrLen(ctx, "mykey").Val())
+		require.Equal(t, "acccca", rdb.GetRange(ctx, "mykey", 16381, 16386).Val())
+		require.Equal(t, "bbbbb\x00", rdb.GetRange(ctx, "mykey", 20000, 20005).Val())
+		require.Equal(t, "ddd", rdb.GetRange(ctx, "mykey", -3, -1).Val())
+		require.Equal(t, []interface{}{value}, rdb.MGet(ctx, "mykey").Val())
+
+		require.NoError(t, rdb.Set(ctx, "mykey", "10", 0).Err())
+		require.EqualValues(t, 11, rdb.Incr(ctx, "mykey").Val())
+	})
 }
@@ -28,6 +28,7 @@ import (
 	"strconv"
 	"strings"
 	"testing"
+	"time"
 
 	"github.com/apache/incubator-kvrocks/tests/gocase/util"
 	"github.com/go-redis/redis/v9"
@@ -665,6 +666,27 @@ func basicTests(t *testing.T, rdb *redis.Client, ctx context.Context, encoding s
 		require.Equal(t, []redis.Z{{2, "b"}, {3, "c"}}, rdb.ZRangeWithScores(ctx, "zsetc", 0, -1).Val())
 	})
 
+	t.Run(fmt.Sprintf("ZUNION/ZINTER reply without storing - %s", encoding), func(t *testing.T) {
+		rdb.Del(ctx, "zsetc")
+		require.Equal(t, []interface{}{"a", "b", "d", "c"}, rdb.Do(ctx, "ZUNION", 2, "zseta", "zsetb").Val())
+		require.Equal(t, []interface{}{"a", "2", "b", "7", "d", "9", "c", "12"},
+			rdb.Do(ctx, "ZUNION", 2, "zseta", "zsetb", "WEIGHTS", 2, 3, "WITHSCORES").Val())
+		require.Equal(t, []interface{}{"b", "1", "c", "2"},
+			rdb.Do(ctx, "ZINTER", 2, "zseta", "zsetb", "AGGREGATE", "MIN", "WITHSCORES").Val())
+		require.Equal(t, []interface{}{}, rdb.Do(ctx, "ZINTER", 2, "zseta", "zset_none").Val())
+		require.Equal(t, int64(0), rdb.Exists(ctx, "zsetc").Val())
+		util.ErrorRegexp(t, rdb.Do(ctx, "ZUNION", 0, "zseta").Err(), ".*at least 1 input key.*")
+	})
+
+	t.Run(fmt.Sprintf("ZINTERCARD basics - %s", encoding), func(t *testing.T) {
+		require.EqualValues(t, 2, rdb.Do(ctx, "ZINTERCARD", 2, "zseta", "zsetb").Val())
+		require.EqualValues(t, 1, rdb.Do(ctx, "ZINTERCARD", 2, "zseta", "zsetb", "LIMIT", 1).Val())
+		require.EqualValues(t, 2, rdb.Do(ctx, "ZINTERCARD", 2, "zseta", "zsetb", "LIMIT", 0).Val())
+		require.EqualValues(t, 0, rdb.Do(ctx, "ZINTERCARD", 2, "zseta", "zset_none").Val())
+		util.ErrorRegexp(t, rdb.Do(ctx, "ZINTERCARD", 0, "zseta").Err(), ".*numkeys.*greater than 0.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "ZINTERCARD", 1, "zseta", "LIMIT", -1).Err(), ".*LIMIT.*negative.*")
+	})
+
 	for i, cmd := range []func(ctx context.Context, dest string, store *redis.ZStore) *redis.IntCmd{rdb.ZInterStore, rdb.ZUnionStore} {
 		var funcName string
 		switch i {
@@ -708,6 +730,29 @@ func basicTests(t *testing.T, rdb *redis.Client, ctx context.Context, encoding s
 			).Err(), ".*weight.*not.*double.*")
 		})
 	}
+
+	t.Run(fmt.Sprintf("ZRANDMEMBER with and without count - %s", encoding), func(t *testing.T) {
+		rdb.Del(ctx, "zrand")
+		for i := 0; i < 100; i++ {
+			rdb.ZAdd(ctx, "zrand", redis.Z{Score: float64(i), Member: fmt.Sprintf("m%d", i)})
+		}
+		member := rdb.Do(ctx, "zrandmember", "zrand").Val().(string)
+		require.NoError(t, rdb.ZScore(ctx, "zrand", member).Err())
+
+		res := rdb.Do(ctx, "zrandmember", "zrand", 10, "withscores").Val().([]interface{})
+		require.Len(t, res, 20)
+		members := make(map[string]bool)
+		for i := 0; i < len(res); i += 2 {
+			members[res[i].(string)] = true
+			require.Equal(t, res[i].(string), "m"+res[i+1].(string))
+		}
+		require.Len(t, members, 10)
+
+		require.Len(t, rdb.Do(ctx, "zrandmember", "zrand", -200).Val(), 200)
+		require.Len(t, rdb.Do(ctx, "zrandmember", "zrand", 500).Val(), 100)
+		require.Equal(t, redis.Nil, rdb.Do(ctx, "zrandmember", "nonexisting_zset").Err())
+		rdb.Del(ctx, "zrand")
+	})
 }
 
 func stressTests(t *testing.T, rdb *redis.Client, ctx context.Context, encoding string) {
@@ -1016,5 +1061,105 @@ func TestZset(t *testing.T) {
 		util.ErrorRegexp(t, rdb.Do(ctx, "zadd", "myzset", "", "abc").Err(), ".*not.*float.*")
 	})
 
+	t.Run("ZMPOP pops from the first non-empty sorted set", func(t *testing.T) {
+		require.NoError(t, rdb.Del(ctx, "mzset1", "mzset2").Err())
+		rdb.ZAdd(ctx, "mzset2", redis.Z{Score: 1, Member: "a"}, redis.Z{Score: 2, Member: "b"},
+			redis.Z{Score: 3, Member: "c"})
+		require.Equal(t, []interface{}{"mzset2", []interface{}{[]interface{}{"a", "1"}}},
+			rdb.Do(ctx, "zmpop", "2", "mzset1", "mzset2", "min").Val())
+		require.Equal(t, []interface{}{"mzset2", []interface{}{[]interface{}{"c", "3"}, []interface{}{"b", "2"}}},
+			rdb.Do(ctx, "zmpop", "2", "mzset1", "mzset2", "max", "count", "10").Val())
+		require.Equal(t, redis.Nil, rdb.Do(ctx, "zmpop", "2", "mzset1", "mzset2", "min").Err())
+		util.ErrorRegexp(t, rdb.Do(ctx, "zmpop", "1", "mzset1", "left").Err(), ".*syntax.*")
+		util.ErrorRegexp(t, rdb.Do(ctx, "zmpop", "1", "mzset1", "min", "count", "-1").Err(), ".*count.*")
+	})
+
+	t.Run("BZMPOP blocks until any of the sorted sets is added", func(t *testing.T) {
+		rd := srv.NewTCPClient()
+		defer func() { require.NoError(t, rd.Close()) }()
+		require.NoError(t, rdb.Del(ctx, "mzset1", "mzset2").Err())
+		require.NoError(t, rd.WriteArgs("bzmpop", "0", "2", "mzset1", "mzset2", "min"))
+		time.Sleep(time.Millisecond * 100)
+		rdb.ZAdd(ctx, "mzset1", redis.Z{Score: 5, Member: "x"}, redis.Z{Score: 4, Member: "y"})
+		rd.MustRead(t, "*2")
+		rd.MustRead(t, "$6")
+		rd.MustRead(t, "mzset1")
+		rd.MustRead(t, "*1")
+		rd.MustReadStrings(t, []string{"y", "4"})
+		require.EqualValues(t, 1, rdb.ZCard(ctx, "mzset1").Val())
+
+		require.NoError(t, rd.WriteArgs("bzmpop", "1", "1", "mzset2", "max"))
+		rd.MustRead(t, "*-1")
+	})
+
 	stressTests(t, rdb, ctx, "skiplist")
 }
+
+func TestZsetWithInlineEncoding(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"zset-inline-max-entries": "128"})
+	defer srv.Close()
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	basicTests(t, rdb, ctx, "listpack")
+
+	t.Run("ZSET converts from the inline encoding when growing", func(t *testing.T) {
+		rdb.Del(ctx, "zinline")
+		for i := 0; i < 200; i++ {
+			require.NoError(t, rdb.ZAdd(ctx, "zinline", redis.Z{Score: float64(200 - i), Member: fmt.Sprintf("m%03d", i)}).Err())
+			require.EqualValues(t, i+1, rdb.ZCard(ctx, "zinline").Val())
+		}
+		require.EqualValues(t, 0, rdb.ZRank(ctx, "zinline", "m199").Val())
+		require.EqualValues(t, 199, rdb.ZRank(ctx, "zinline", "m000").Val())
+		require.Equal(t, []string{"m199", "m198"}, rdb.ZRange(ctx, "zinline", 0, 1).Val())
+	})
+}
+
+func TestZsetWithRankIndex(t *testing.T) {
+	srv := util.StartServer(t, map[string]string{"zset-rank-index-min-size": "1"})
+	defer srv.Close()
+	ctx := context.Background()
+	rdb := srv.NewClient()
+	defer func() { require.NoError(t, rdb.Close()) }()
+
+	basicTests(t, rdb, ctx, "skiplist")
+
+	t.Run("ZRANK/ZRANGE/ZREMRANGEBYRANK on the large zset with rank index", func(t *testing.T) {
+		rdb.Del(ctx, "zrank-index")
+		var members []string
+		for i := 0; i < 6000; i++ {
+			members = append(members, fmt.Sprintf("m%05d", i))
+		}
+		for _, i := range rand.Perm(len(members)) {
+			require.NoError(t, rdb.ZAdd(ctx, "zrank-index", redis.Z{Score: float64(i), Member: members[i]}).Err())
+		}
+		check := func() {
+			for i := 0; i < len(members); i += 101 {
+				require.EqualValues(t, i, rdb.ZRank(ctx, "zrank-index", members[i]).Val())
+				require.EqualValues(t, len(members)-1-i, rdb.ZRevRank(ctx, "zrank-index", members[i]).Val())
+			}
+			for _, start := range []int{1, 1500, len(members) - 2} {
+				stop := start + 2
+				if stop >= len(members) {
+					stop = len(members) - 1
+				}
+				require.Equal(t, members[start:stop+1], rdb.ZRange(ctx, "zrank-index", int64(start), int64(stop)).Val())
+			}
+		}
+		check()
+
+		require.EqualValues(t, 2000, rdb.ZRemRangeByRank(ctx, "zrank-index", 1000, 2999).Val())
+		members = append(members[:1000], members[3000:]...)
+		check()
+
+		require.EqualValues(t, 2, rdb.ZRem(ctx, "zrank-index", members[0], members[2500]).Val())
+		members = append(members[1:2500], members[2501:]...)
+		check()
+
+		require.NoError(t, rdb.ConfigSet(ctx, "zset-rank-index-min-size", "0").Err())
+		require.EqualValues(t, 1, rdb.ZRem(ctx, "zrank-index", members[0]).Val())
+		members = members[1:]
+		check()
+	})
+}
@@ -19,13 +19,20 @@
 
 package util
 
-import "flag"
+import (
+	"flag"
+	"path/filepath"
+)
 
 var binPath = flag.String("binPath", "", "directory including kvrocks build files")
 var workspace = flag.String("workspace", "", "directory of cases workspace")
 var deleteOnExit = flag.Bool("deleteOnExit", false, "whether to delete workspace on exit")
 var cliPath = flag.String("cliPath", "redis-cli", "path to redis-cli")
 var tlsEnable = flag.Bool("tlsEnable", false, "enable TLS-related test cases")
+var perfEnable = flag.Bool("perfEnable", false, "enable the performance regression cases")
+var perfBaseline = flag.String("perfBaseline", "baseline.json", "path to the baseline of the performance cases")
+var perfUpdateBaseline = flag.Bool("perfUpdateBaseline", false, "write the results of the performance cases as the baseline")
+var perfTolerance = flag.Float64("perfTolerance", 0.2, "the tolerated ratio of the performance regression")
 
 func CLIPath() string {
 	return *cliPath
@@ -34,3 +41,24 @@ func CLIPath() string {
 func TLSEnable() bool {
 	return *tlsEnable
 }
+
+func PerfEnable() bool {
+	return *perfEnable
+}
+
+func PerfBaseline() string {
+	return *perfBaseline
+}
+
+func PerfUpdateBaseline() bool {
+	return *perfUpdateBaseline
+}
+
+func PerfTolerance() float64 {
+	return *perfTolerance
+}
+
+// ToolPath returns the path of the tool built along with kvrocks, e.g. kvrocks-bulkload
+func ToolPath(name string) string {
+	return filepath.Join(filepath.Dir(*binPath), name)
+}
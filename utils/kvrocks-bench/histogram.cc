@@ -0,0 +1,76 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+static constexpr int kSubBucketBits = 7;
+static constexpr uint64_t kSubBuckets = 1 << kSubBucketBits;
+static constexpr uint64_t kHalfSubBuckets = kSubBuckets / 2;
+// The values up to 2^50 are kept in the buckets, the larger ones are counted in the last bucket
+static constexpr int kMaxValueBits = 50;
+static constexpr size_t kNumBuckets = kSubBuckets + (kMaxValueBits - kSubBucketBits) * kHalfSubBuckets;
+
+LatencyHistogram::LatencyHistogram() : buckets_(kNumBuckets, 0) {}
+
+size_t LatencyHistogram::BucketOf(uint64_t value) {
+  if (value < kSubBuckets) return value;
+  // The value shifted right is in [64, 128), i.e. the linear sub-buckets of its power of two
+  int shift = 63 - __builtin_clzll(value) - (kSubBucketBits - 1);
+  size_t bucket = kSubBuckets + (shift - 1) * kHalfSubBuckets + ((value >> shift) - kHalfSubBuckets);
+  return std::min(bucket, kNumBuckets - 1);
+}
+
+uint64_t LatencyHistogram::ValueOf(size_t bucket) {
+  if (bucket < kSubBuckets) return bucket;
+  uint64_t shift = (bucket - kSubBuckets) / kHalfSubBuckets + 1;
+  uint64_t sub_bucket = (bucket - kSubBuckets) % kHalfSubBuckets + kHalfSubBuckets;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::RecordN(uint64_t value, uint64_t n) {
+  buckets_[BucketOf(value)] += n;
+  count_ += n;
+  sum_ += value * n;
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other) {
+  for (size_t i = 0; i < kNumBuckets; i++) buckets_[i] += other.buckets_[i];
+  count_ += other.count_;
+  sum_ += other.sum_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+}
+
+uint64_t LatencyHistogram::Percentile(double percentile) const {
+  if (count_ == 0) return 0;
+  auto target = static_cast<uint64_t>(std::ceil(percentile / 100 * static_cast<double>(count_)));
+  target = std::clamp<uint64_t>(target, 1, count_);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; i++) {
+    seen += buckets_[i];
+    if (seen >= target) return std::min(ValueOf(i), max_);
+  }
+  return max_;
+}
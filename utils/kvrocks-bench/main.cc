@@ -0,0 +1,404 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <fmt/format.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "histogram.h"
+#include "parse_util.h"
+#include "server/redis_reply.h"
+#include "string_util.h"
+#include "version.h"
+#include "workload.h"
+
+// kvrocks-bench sends the workload of the mixed commands to kvrocks from the clients in their own threads,
+// and reports the latency histograms of every command. If the rate is given, the requests are sent by the
+// fixed schedule, and the latencies are measured from the scheduled time instead of the time they were
+// actually sent, so the requests delayed by a stalled server are counted with their full latencies, i.e.
+// the coordinated omission is corrected like wrk2.
+
+class Server;
+
+struct Options {
+  std::string host = "127.0.0.1";
+  uint32_t port = 6666;
+  // The tokens of the namespaces, the clients authenticate with them in turn
+  std::vector<std::string> tokens;
+  uint32_t clients = 50;
+  uint32_t pipeline = 1;
+  uint32_t duration_secs = 10;
+  // The total requests per second of all clients, 0 means sending as fast as possible
+  uint64_t rate = 0;
+  std::string mix = "get:50,set:50";
+  WorkloadOptions workload;
+  bool show_usage = false;
+};
+
+static void usage(const char *program) {
+  std::cout << program << " generates the workload of the mixed commands and reports the latencies\n"
+            << "\t-h server host, default is 127.0.0.1\n"
+            << "\t-p server port, default is 6666\n"
+            << "\t-a comma separated tokens of the namespaces, the clients authenticate with them in turn\n"
+            << "\t-c number of the clients, default is 50\n"
+            << "\t-P number of the pipelined requests, default is 1\n"
+            << "\t-d duration in seconds, default is 10\n"
+            << "\t-r total requests per second of the fixed schedule, the latencies are corrected for the\n"
+            << "\t   coordinated omission, default is 0 which sends as fast as possible without the correction\n"
+            << "\t-m mix of the commands and their weights, default is get:50,set:50\n"
+            << "\t-k number of the keys of every type, default is 100000\n"
+            << "\t-z skew of the zipfian distribution of the keys in [0, 1), 0 is uniform, default is 0.99\n"
+            << "\t-l key size, default is 16\n"
+            << "\t-v value size, default is 64\n"
+            << "\t-e min-max number of the elements of the collections in the log-uniform distribution,\n"
+            << "\t   default is 1-1000\n"
+            << "\t-x key prefix, default is bench\n"
+            << "\t-H help\n"
+            << "Supported commands: " << Workload::SupportedCommands() << "\n";
+  exit(0);
+}
+
+static Options parseCommandLineOptions(int argc, char **argv) {
+  int ch;
+  Options opts;
+  while ((ch = ::getopt(argc, argv, "h:p:a:c:P:d:r:m:k:z:l:v:e:x:H")) != -1) {
+    switch (ch) {
+      case 'h': {
+        opts.host = optarg;
+        break;
+      }
+      case 'p': {
+        auto port = ParseInt<uint32_t>(optarg, {1, 65535}, 10);
+        if (!port) usage(argv[0]);
+        opts.port = *port;
+        break;
+      }
+      case 'a': {
+        opts.tokens = Util::Split(optarg, ",");
+        break;
+      }
+      case 'c': {
+        auto clients = ParseInt<uint32_t>(optarg, {1, 10000}, 10);
+        if (!clients) usage(argv[0]);
+        opts.clients = *clients;
+        break;
+      }
+      case 'P': {
+        auto pipeline = ParseInt<uint32_t>(optarg, {1, 10000}, 10);
+        if (!pipeline) usage(argv[0]);
+        opts.pipeline = *pipeline;
+        break;
+      }
+      case 'd': {
+        auto duration = ParseInt<uint32_t>(optarg, {1, 86400 * 7}, 10);
+        if (!duration) usage(argv[0]);
+        opts.duration_secs = *duration;
+        break;
+      }
+      case 'r': {
+        auto rate = ParseInt<uint64_t>(optarg, {0, 100000000}, 10);
+        if (!rate) usage(argv[0]);
+        opts.rate = *rate;
+        break;
+      }
+      case 'm': {
+        opts.mix = optarg;
+        break;
+      }
+      case 'k': {
+        auto keyspace = ParseInt<uint64_t>(optarg, {1, 1000000000}, 10);
+        if (!keyspace) usage(argv[0]);
+        opts.workload.keyspace = *keyspace;
+        break;
+      }
+      case 'z': {
+        try {
+          opts.workload.zipf_theta = std::stod(optarg);
+        } catch (const std::exception &e) {
+          usage(argv[0]);
+        }
+        if (!(opts.workload.zipf_theta >= 0 && opts.workload.zipf_theta < 1)) usage(argv[0]);
+        break;
+      }
+      case 'l': {
+        auto key_size = ParseInt<size_t>(optarg, {1, 1024 * 1024}, 10);
+        if (!key_size) usage(argv[0]);
+        opts.workload.key_size = *key_size;
+        break;
+      }
+      case 'v': {
+        auto value_size = ParseInt<size_t>(optarg, {0, 512 * 1024 * 1024}, 10);
+        if (!value_size) usage(argv[0]);
+        opts.workload.value_size = *value_size;
+        break;
+      }
+      case 'e': {
+        auto range = Util::Split(optarg, "-");
+        if (range.size() != 2) usage(argv[0]);
+        auto min = ParseInt<uint64_t>(range[0], {1, UINT32_MAX}, 10);
+        auto max = ParseInt<uint64_t>(range[1], {1, UINT32_MAX}, 10);
+        if (!min || !max || *min > *max) usage(argv[0]);
+        opts.workload.min_elements = *min;
+        opts.workload.max_elements = *max;
+        break;
+      }
+      case 'x': {
+        opts.workload.key_prefix = optarg;
+        break;
+      }
+      case 'H': {
+        opts.show_usage = true;
+        break;
+      }
+      default:
+        usage(argv[0]);
+    }
+  }
+  return opts;
+}
+
+// Return the length of the complete RESP reply at the beginning of the data, or 0 if it's incomplete
+static size_t parseReply(const char *data, size_t len, bool *is_error) {
+  if (len == 0) return 0;
+  const char *end = static_cast<const char *>(memchr(data, '\n', len));
+  if (!end) return 0;
+  size_t line_len = end - data + 1;
+  *is_error = data[0] == '-';
+  if (data[0] != '$' && data[0] != '*') return line_len;
+
+  auto num = ParseInt<int64_t>(std::string(data + 1, line_len - 3), 10);
+  if (!num || *num < 0) return line_len;
+  if (data[0] == '$') {
+    size_t total = line_len + *num + 2;
+    return total <= len ? total : 0;
+  }
+  size_t total = line_len;
+  for (int64_t i = 0; i < *num; i++) {
+    bool elem_is_error = false;
+    size_t elem_len = parseReply(data + total, len - total, &elem_is_error);
+    if (elem_len == 0) return 0;
+    total += elem_len;
+  }
+  return total;
+}
+
+class Client {
+ public:
+  ~Client() {
+    if (fd_ >= 0) close(fd_);
+  }
+
+  Status Connect(const std::string &host, uint32_t port) {
+    addrinfo hints = {}, *servinfo = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (int rv = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &servinfo); rv != 0) {
+      return {Status::NotOK, gai_strerror(rv)};
+    }
+    for (auto p = servinfo; p != nullptr; p = p->ai_next) {
+      fd_ = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+      if (fd_ < 0) continue;
+      if (connect(fd_, p->ai_addr, p->ai_addrlen) == 0) break;
+      close(fd_);
+      fd_ = -1;
+    }
+    freeaddrinfo(servinfo);
+    if (fd_ < 0) return {Status::NotOK, fmt::format("failed to connect to {}:{}", host, port)};
+    int value = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+    return Status::OK();
+  }
+
+  Status Send(const std::string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+      auto n = write(fd_, data.data() + sent, data.size() - sent);
+      if (n <= 0) return {Status::NotOK, "failed to send the requests"};
+      sent += n;
+    }
+    return Status::OK();
+  }
+
+  // Read the replies of the requests, the errors are the indexes of the error replies
+  Status Receive(size_t replies, std::vector<bool> *errors) {
+    errors->assign(replies, false);
+    size_t received = 0;
+    while (received < replies) {
+      bool is_error = false;
+      size_t len = parseReply(buf_.data() + pos_, buf_.size() - pos_, &is_error);
+      if (len > 0) {
+        (*errors)[received++] = is_error;
+        pos_ += len;
+        continue;
+      }
+      // Move the incomplete reply to the beginning and read more
+      buf_.erase(0, pos_);
+      pos_ = 0;
+      char chunk[16384];
+      auto n = read(fd_, chunk, sizeof(chunk));
+      if (n <= 0) return {Status::NotOK, "failed to receive the replies"};
+      buf_.append(chunk, n);
+    }
+    return Status::OK();
+  }
+
+ private:
+  int fd_ = -1;
+  std::string buf_;
+  size_t pos_ = 0;
+};
+
+struct ClientStats {
+  std::vector<LatencyHistogram> latencies;
+  std::vector<uint64_t> errors;
+  std::string error;
+};
+
+static void runClient(const Options &opts, Workload workload, size_t client_id,
+                      std::chrono::steady_clock::time_point end_time, ClientStats *stats) {
+  using Clock = std::chrono::steady_clock;
+  size_t num_commands = workload.GetCommands().size();
+  stats->latencies.resize(num_commands);
+  stats->errors.resize(num_commands);
+
+  Client client;
+  auto s = client.Connect(opts.host, opts.port);
+  std::vector<bool> errors;
+  if (s.IsOK() && !opts.tokens.empty()) {
+    s = client.Send(Redis::Command2RESP({"AUTH", opts.tokens[client_id % opts.tokens.size()]}));
+    if (s.IsOK()) s = client.Receive(1, &errors);
+    if (s.IsOK() && errors[0]) s = {Status::NotOK, "failed to authenticate"};
+  }
+  if (!s.IsOK()) {
+    stats->error = s.Msg();
+    return;
+  }
+
+  std::mt19937_64 rng(std::random_device{}() + client_id);
+  // The interval between the pipelines of the client in the fixed schedule, the clients start at the
+  // different offsets of the interval to spread the requests
+  std::chrono::nanoseconds interval(0);
+  if (opts.rate > 0) {
+    interval = std::chrono::nanoseconds(static_cast<int64_t>(1000000000ULL * opts.clients * opts.pipeline / opts.rate));
+  }
+  Clock::time_point scheduled =
+      Clock::now() + interval * static_cast<int64_t>(client_id) / static_cast<int64_t>(opts.clients);
+
+  std::vector<std::string> args;
+  std::vector<size_t> indexes(opts.pipeline);
+  std::string requests;
+  while (true) {
+    if (interval.count() > 0) std::this_thread::sleep_until(scheduled);
+    auto start = interval.count() > 0 ? scheduled : Clock::now();
+    if (start >= end_time) break;
+
+    requests.clear();
+    for (uint32_t i = 0; i < opts.pipeline; i++) {
+      indexes[i] = workload.Next(&rng, &args);
+      requests.append(Redis::Command2RESP(args));
+    }
+    s = client.Send(requests);
+    if (s.IsOK()) s = client.Receive(opts.pipeline, &errors);
+    if (!s.IsOK()) {
+      stats->error = s.Msg();
+      return;
+    }
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    for (uint32_t i = 0; i < opts.pipeline; i++) {
+      stats->latencies[indexes[i]].Record(latency);
+      if (errors[i]) stats->errors[indexes[i]]++;
+    }
+    scheduled += interval;
+  }
+}
+
+static void report(const std::string &name, const LatencyHistogram &latencies, uint64_t errors, double secs) {
+  auto ms = [](uint64_t us) { return static_cast<double>(us) / 1000; };
+  std::cout << fmt::format("{:<10} {:>10} {:>8} {:>12.1f} {:>9.3f} {:>9.3f} {:>9.3f} {:>9.3f} {:>9.3f} {:>9.3f}\n",
+                           name, latencies.Count(), errors, static_cast<double>(latencies.Count()) / secs,
+                           latencies.Mean() / 1000, ms(latencies.Percentile(50)), ms(latencies.Percentile(99)),
+                           ms(latencies.Percentile(99.9)), ms(latencies.Percentile(99.99)), ms(latencies.Max()));
+}
+
+Server *GetServer() { return nullptr; }
+
+int main(int argc, char *argv[]) {
+  std::cout << "Version: " << VERSION << " @" << GIT_COMMIT << std::endl;
+  auto opts = parseCommandLineOptions(argc, argv);
+  if (opts.show_usage) usage(argv[0]);
+
+  Workload workload(opts.workload);
+  auto s = workload.ParseMix(opts.mix);
+  if (!s.IsOK()) {
+    std::cout << "Failed to parse the mix of the commands, err: " << s.Msg() << std::endl;
+    exit(1);
+  }
+
+  std::cout << fmt::format("Running {} clients with {} pipelined requests for {}s, {}\n", opts.clients,
+                           opts.pipeline, opts.duration_secs,
+                           opts.rate > 0 ? fmt::format("at {} requests per second", opts.rate) : "without the rate");
+  auto start_time = std::chrono::steady_clock::now();
+  auto end_time = start_time + std::chrono::seconds(opts.duration_secs);
+  std::vector<ClientStats> stats(opts.clients);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < opts.clients; i++) {
+    threads.emplace_back(runClient, std::cref(opts), workload, i, end_time, &stats[i]);
+  }
+  for (auto &t : threads) t.join();
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+  const auto &commands = workload.GetCommands();
+  std::vector<LatencyHistogram> latencies(commands.size());
+  std::vector<uint64_t> errors(commands.size(), 0);
+  LatencyHistogram total;
+  uint64_t total_errors = 0;
+  for (const auto &client_stats : stats) {
+    if (!client_stats.error.empty()) {
+      std::cout << "Client failed, err: " << client_stats.error << std::endl;
+      continue;
+    }
+    for (size_t i = 0; i < commands.size(); i++) {
+      latencies[i].Merge(client_stats.latencies[i]);
+      errors[i] += client_stats.errors[i];
+      total.Merge(client_stats.latencies[i]);
+      total_errors += client_stats.errors[i];
+    }
+  }
+
+  std::cout << fmt::format("{:<10} {:>10} {:>8} {:>12} {:>9} {:>9} {:>9} {:>9} {:>9} {:>9}\n", "command", "requests",
+                           "errors", "requests/s", "avg(ms)", "p50(ms)", "p99(ms)", "p99.9(ms)", "p99.99(ms)",
+                           "max(ms)");
+  for (size_t i = 0; i < commands.size(); i++) report(commands[i]->name, latencies[i], errors[i], secs);
+  report("total", total, total_errors, secs);
+  return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "workload.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "parse_util.h"
+#include "string_util.h"
+
+ZipfianGenerator::ZipfianGenerator(uint64_t n, double theta) : n_(n), theta_(theta) {
+  if (theta_ <= 0) return;
+  for (uint64_t i = 1; i <= n_; i++) zetan_ += 1 / std::pow(static_cast<double>(i), theta_);
+  double zeta2 = 1 + 1 / std::pow(2.0, theta_);
+  alpha_ = 1 / (1 - theta_);
+  eta_ = (1 - std::pow(2.0 / static_cast<double>(n_), 1 - theta_)) / (1 - zeta2 / zetan_);
+}
+
+uint64_t ZipfianGenerator::Next(std::mt19937_64 *rng) {
+  if (theta_ <= 0) return (*rng)() % n_;
+  double u = uniform_(*rng);
+  double uz = u * zetan_;
+  if (uz < 1) return 0;
+  if (uz < 1 + std::pow(0.5, theta_)) return 1;
+  auto rank = static_cast<uint64_t>(static_cast<double>(n_) * std::pow(eta_ * u - eta_ + 1, alpha_));
+  return std::min(rank, n_ - 1);
+}
+
+// Scatter the ranks, so the hot keys aren't adjacent in the DB
+static uint64_t scramble(uint64_t rank) {
+  rank ^= rank >> 33;
+  rank *= 0xff51afd7ed558ccdULL;
+  rank ^= rank >> 33;
+  return rank;
+}
+
+static std::string elementOf(const char *prefix, uint64_t index) { return prefix + std::to_string(index); }
+
+static uint64_t randomElement(const Workload &workload, uint64_t rank, std::mt19937_64 *rng) {
+  return (*rng)() % workload.ElementsOf(rank);
+}
+
+static const BenchCommand kBenchCommands[] = {
+    {"get", "string", false, [](const Workload &, uint64_t, std::mt19937_64 *, std::vector<std::string> *) {}},
+    {"set", "string", true,
+     [](const Workload &w, uint64_t, std::mt19937_64 *, std::vector<std::string> *args) {
+       args->emplace_back(w.Value());
+     }},
+    {"hget", "hash", false,
+     [](const Workload &w, uint64_t rank, std::mt19937_64 *rng, std::vector<std::string> *args) {
+       args->emplace_back(elementOf("field-", randomElement(w, rank, rng)));
+     }},
+    {"hset", "hash", true,
+     [](const Workload &w, uint64_t rank, std::mt19937_64 *rng, std::vector<std::string> *args) {
+       args->emplace_back(elementOf("field-", randomElement(w, rank, rng)));
+       args->emplace_back(w.Value());
+     }},
+    {"hgetall", "hash", false, [](const Workload &, uint64_t, std::mt19937_64 *, std::vector<std::string> *) {}},
+    {"sismember", "set", false,
+     [](const Workload &w, uint64_t rank, std::mt19937_64 *rng, std::vector<std::string> *args) {
+       args->emplace_back(elementOf("member-", randomElement(w, rank, rng)));
+     }},
+    {"sadd", "set", true,
+     [](const Workload &w, uint64_t rank, std::mt19937_64 *rng, std::vector<std::string> *args) {
+       args->emplace_back(elementOf("member-", randomElement(w, rank, rng)));
+     }},
+    {"smembers", "set", false, [](const Workload &, uint64_t, std::mt19937_64 *, std::vector<std::string> *) {}},
+    {"zscore", "zset", false,
+     [](const Workload &w, uint64_t rank, std::mt19937_64 *rng, std::vector<std::string> *args) {
+       args->emplace_back(elementOf("member-", randomElement(w, rank, rng)));
+     }},
+    {"zadd", "zset", true,
+     [](const Workload &w, uint64_t rank, std::mt19937_64 *rng, std::vector<std::string> *args) {
+       auto index = randomElement(w, rank, rng);
+       args->emplace_back(std::to_string((*rng)() % (index + 1)));
+       args->emplace_back(elementOf("member-", index));
+     }},
+    {"zrange", "zset", false,
+     [](const Workload &, uint64_t, std::mt19937_64 *, std::vector<std::string> *args) {
+       args->emplace_back("0");
+       args->emplace_back("9");
+     }},
+    // The lists are trimmed to their sizes by ltrim
+    {"lpush", "list", true,
+     [](const Workload &w, uint64_t, std::mt19937_64 *, std::vector<std::string> *args) {
+       args->emplace_back(w.Value());
+     }},
+    {"ltrim", "list", true,
+     [](const Workload &w, uint64_t rank, std::mt19937_64 *, std::vector<std::string> *args) {
+       args->emplace_back("0");
+       args->emplace_back(std::to_string(w.ElementsOf(rank) - 1));
+     }},
+    {"lrange", "list", false,
+     [](const Workload &, uint64_t, std::mt19937_64 *, std::vector<std::string> *args) {
+       args->emplace_back("0");
+       args->emplace_back("9");
+     }},
+    // The streams are trimmed to their sizes approximately by every xadd
+    {"xadd", "stream", true,
+     [](const Workload &w, uint64_t rank, std::mt19937_64 *, std::vector<std::string> *args) {
+       args->insert(args->end(), {"MAXLEN", "~", std::to_string(w.ElementsOf(rank)), "*", "field", w.Value()});
+     }},
+    {"xrange", "stream", false,
+     [](const Workload &, uint64_t, std::mt19937_64 *, std::vector<std::string> *args) {
+       args->insert(args->end(), {"-", "+", "COUNT", "10"});
+     }},
+    {"siadd", "sortedint", true,
+     [](const Workload &w, uint64_t rank, std::mt19937_64 *rng, std::vector<std::string> *args) {
+       args->emplace_back(std::to_string(randomElement(w, rank, rng)));
+     }},
+    {"sirange", "sortedint", false,
+     [](const Workload &, uint64_t, std::mt19937_64 *, std::vector<std::string> *args) {
+       args->emplace_back("0");
+       args->emplace_back("10");
+     }},
+};
+
+Workload::Workload(WorkloadOptions options)
+    : options_(std::move(options)),
+      value_(options_.value_size, 'v'),
+      zipfian_(options_.keyspace, options_.zipf_theta) {}
+
+Status Workload::ParseMix(const std::string &mix) {
+  commands_.clear();
+  weights_.clear();
+  for (const auto &item : Util::Split(mix, ",")) {
+    auto name_weight = Util::Split(item, ":");
+    if (name_weight.empty() || name_weight.size() > 2) return {Status::NotOK, "invalid command in the mix: " + item};
+    auto name = Util::ToLower(name_weight[0]);
+    const BenchCommand *command = nullptr;
+    for (const auto &bench_command : kBenchCommands) {
+      if (name == bench_command.name) command = &bench_command;
+    }
+    if (!command) return {Status::NotOK, "unsupported command in the mix: " + name};
+    double weight = 1;
+    if (name_weight.size() == 2) {
+      auto parsed = ParseInt<uint32_t>(name_weight[1], {1, 1000000}, 10);
+      if (!parsed) return {Status::NotOK, "invalid weight of the command: " + item};
+      weight = *parsed;
+    }
+    commands_.emplace_back(command);
+    weights_.emplace_back(weight);
+  }
+  if (commands_.empty()) return {Status::NotOK, "no commands in the mix"};
+  mix_ = std::discrete_distribution<size_t>(weights_.begin(), weights_.end());
+  return Status::OK();
+}
+
+size_t Workload::Next(std::mt19937_64 *rng, std::vector<std::string> *args) {
+  size_t index = mix_(*rng);
+  const auto *command = commands_[index];
+  uint64_t rank = scramble(zipfian_.Next(rng)) % options_.keyspace;
+  args->clear();
+  args->emplace_back(command->name);
+  args->emplace_back(KeyOf(command->key_type, rank));
+  command->append_args(*this, rank, rng, args);
+  return index;
+}
+
+uint64_t Workload::ElementsOf(uint64_t rank) const {
+  if (options_.max_elements <= options_.min_elements) return options_.min_elements;
+  // The log-uniform distribution in [min_elements, max_elements] derived from the rank
+  double u = static_cast<double>(scramble(rank + 1) % 1000000) / 1000000;
+  double log_min = std::log(static_cast<double>(options_.min_elements));
+  double log_max = std::log(static_cast<double>(options_.max_elements) + 1);
+  auto elements = static_cast<uint64_t>(std::exp(log_min + u * (log_max - log_min)));
+  return std::clamp(elements, options_.min_elements, options_.max_elements);
+}
+
+std::string Workload::KeyOf(const char *key_type, uint64_t rank) const {
+  std::string key = options_.key_prefix + ":" + key_type + ":";
+  auto rank_str = std::to_string(rank);
+  // Pad the key with zeros to the key size
+  if (key.size() + rank_str.size() < options_.key_size) {
+    key.append(options_.key_size - key.size() - rank_str.size(), '0');
+  }
+  key.append(rank_str);
+  return key;
+}
+
+std::string Workload::SupportedCommands() {
+  std::string commands;
+  for (const auto &command : kBenchCommands) {
+    if (!commands.empty()) commands += ", ";
+    commands += command.name;
+  }
+  return commands;
+}
@@ -0,0 +1,98 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "status.h"
+
+class Workload;
+
+struct WorkloadOptions {
+  std::string key_prefix = "bench";
+  // The number of keys of every type accessed by the workload
+  uint64_t keyspace = 100000;
+  // The skew of the zipfian distribution of the keys in [0, 1), 0 means the uniform distribution
+  double zipf_theta = 0.99;
+  size_t key_size = 16;
+  size_t value_size = 64;
+  // The sizes of the collections are distributed in [min_elements, max_elements] log-uniformly,
+  // so there're many small collections and a few big ones like the real traffic
+  uint64_t min_elements = 1;
+  uint64_t max_elements = 1000;
+};
+
+// ZipfianGenerator generates the ranks in [0, n) in the zipfian distribution like YCSB,
+// the rank 0 is the most frequent one
+class ZipfianGenerator {
+ public:
+  ZipfianGenerator(uint64_t n, double theta);
+  uint64_t Next(std::mt19937_64 *rng);
+
+ private:
+  uint64_t n_;
+  double theta_;
+  double zetan_ = 0;
+  double alpha_ = 0;
+  double eta_ = 0;
+  std::uniform_real_distribution<double> uniform_{0, 1};
+};
+
+// The commands of the workload, the keys of the same type are shared by the reads and the writes
+struct BenchCommand {
+  const char *name;
+  const char *key_type;
+  bool is_write;
+  // Append the arguments except the command name and the key
+  void (*append_args)(const Workload &workload, uint64_t rank, std::mt19937_64 *rng,
+                      std::vector<std::string> *args);
+};
+
+// Workload generates the commands in the mix of the weights, e.g. "get:50,set:30,hgetall:10,xadd:10",
+// the keys are chosen by the zipfian distribution independently for every command
+class Workload {
+ public:
+  explicit Workload(WorkloadOptions options);
+
+  Status ParseMix(const std::string &mix);
+  // Generate the next command, return the index of the command in GetCommands()
+  size_t Next(std::mt19937_64 *rng, std::vector<std::string> *args);
+
+  const std::vector<const BenchCommand *> &GetCommands() const { return commands_; }
+  const WorkloadOptions &GetOptions() const { return options_; }
+  // The number of the elements of the collection of the rank, it's fixed for every key
+  uint64_t ElementsOf(uint64_t rank) const;
+  std::string KeyOf(const char *key_type, uint64_t rank) const;
+  const std::string &Value() const { return value_; }
+
+  static std::string SupportedCommands();
+
+ private:
+  WorkloadOptions options_;
+  std::string value_;
+  std::vector<const BenchCommand *> commands_;
+  std::vector<double> weights_;
+  std::discrete_distribution<size_t> mix_;
+  ZipfianGenerator zipfian_;
+};
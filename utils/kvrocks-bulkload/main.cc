@@ -0,0 +1,318 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <fmt/format.h>
+#include <getopt.h>
+#include <glog/logging.h>
+#include <rocksdb/env.h>
+#include <rocksdb/sst_file_writer.h>
+
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "config/config.h"
+#include "parse_util.h"
+#include "storage/storage.h"
+#include "string_util.h"
+#include "time_util.h"
+#include "types/redis_hash.h"
+#include "types/redis_list.h"
+#include "types/redis_set.h"
+#include "types/redis_string.h"
+#include "types/redis_zset.h"
+#include "version.h"
+
+// The tool writes the commands into a temporary DB through the data types of kvrocks, so the
+// key-values are encoded just like the server does, then exports the column families of the keys
+// into the sorted SST files, which can be ingested into the server by BULKLOAD INGEST.
+
+struct Options {
+  std::string input = "-";
+  std::string output_dir;
+  std::string ns = kDefaultNamespace;
+  bool cluster_enabled = false;
+  uint64_t sst_file_size_mb = 256;
+  bool show_usage = false;
+};
+
+static void usage(const char *program) {
+  std::cout << program << " build the SST files of kvrocks offline from the commands\n"
+            << "\t-i input file of the commands in RESP or inline format, default is stdin\n"
+            << "\t-o output directory of the SST files\n"
+            << "\t-n namespace of the keys, default is " << kDefaultNamespace << "\n"
+            << "\t-c encode the slot id of the keys for the cluster mode\n"
+            << "\t-s max size of the SST files in MiB, default is 256\n"
+            << "\t-h help\n"
+            << "Supported commands: SET key value [EX seconds], HSET/HMSET key field value [field value ...],\n"
+            << "\tSADD key member [member ...], ZADD key score member [score member ...],\n"
+            << "\tRPUSH/LPUSH key element [element ...], EXPIRE key seconds\n";
+  exit(0);
+}
+
+static Options parseCommandLineOptions(int argc, char **argv) {
+  int ch;
+  Options opts;
+  while ((ch = ::getopt(argc, argv, "i:o:n:cs:h")) != -1) {
+    switch (ch) {
+      case 'i': {
+        opts.input = optarg;
+        break;
+      }
+      case 'o': {
+        opts.output_dir = optarg;
+        break;
+      }
+      case 'n': {
+        opts.ns = optarg;
+        break;
+      }
+      case 'c': {
+        opts.cluster_enabled = true;
+        break;
+      }
+      case 's': {
+        auto size = ParseInt<uint64_t>(optarg, {1, 1024 * 1024}, 10);
+        if (!size) usage(argv[0]);
+        opts.sst_file_size_mb = *size;
+        break;
+      }
+      case 'h': {
+        opts.show_usage = true;
+        break;
+      }
+      default:
+        usage(argv[0]);
+    }
+  }
+  if (opts.output_dir.empty()) opts.show_usage = true;
+  return opts;
+}
+
+static bool readLine(std::istream &in, std::string *line) {
+  if (!std::getline(in, *line)) return false;
+  if (!line->empty() && line->back() == '\r') line->pop_back();
+  return true;
+}
+
+// Read the next command in RESP like the input of `redis-cli --pipe`, or the inline command
+// whose arguments are separated by the spaces, the args are empty at the end of the input
+static Status readCommand(std::istream &in, std::vector<std::string> *args) {
+  args->clear();
+  std::string line;
+  while (readLine(in, &line)) {
+    if (line.empty()) continue;
+    if (line[0] != '*') {
+      *args = Util::Split(line, " \t");
+      if (args->empty()) continue;
+      return Status::OK();
+    }
+
+    auto num_args = ParseInt<int64_t>(line.substr(1), 10);
+    if (!num_args || *num_args <= 0) return {Status::NotOK, "invalid multibulk length: " + line};
+    for (int64_t i = 0; i < *num_args; i++) {
+      if (!readLine(in, &line) || line.empty() || line[0] != '$') {
+        return {Status::NotOK, "invalid bulk length: " + line};
+      }
+      auto len = ParseInt<uint64_t>(line.substr(1), 10);
+      if (!len) return {Status::NotOK, "invalid bulk length: " + line};
+      std::string arg(*len, '\0');
+      if (!in.read(arg.data(), static_cast<std::streamsize>(*len)) || !readLine(in, &line) || !line.empty()) {
+        return {Status::NotOK, "incomplete bulk string"};
+      }
+      args->emplace_back(std::move(arg));
+    }
+    return Status::OK();
+  }
+  return Status::OK();
+}
+
+static Status writeCommand(Engine::Storage *storage, const std::string &ns, const std::vector<std::string> &args) {
+  auto cmd = Util::ToLower(args[0]);
+  if (args.size() < 3) return {Status::NotOK, "wrong number of arguments for '" + cmd + "' command"};
+  rocksdb::Status s;
+  int ret = 0;
+
+  if (cmd == "set") {
+    Redis::String string_db(storage, ns);
+    if (args.size() == 3) {
+      s = string_db.Set(args[1], args[2]);
+    } else if (args.size() == 5 && Util::ToLower(args[3]) == "ex") {
+      auto ttl = ParseInt<int>(args[4], {1, INT_MAX}, 10);
+      if (!ttl) return {Status::NotOK, "invalid expire time in 'set' command"};
+      s = string_db.SetEX(args[1], args[2], *ttl);
+    } else {
+      return {Status::NotOK, "syntax error in 'set' command"};
+    }
+  } else if (cmd == "hset" || cmd == "hmset") {
+    if (args.size() % 2 != 0) return {Status::NotOK, "wrong number of arguments for '" + cmd + "' command"};
+    std::vector<FieldValue> field_values;
+    for (size_t i = 2; i < args.size(); i += 2) {
+      field_values.emplace_back(FieldValue{args[i], args[i + 1]});
+    }
+    Redis::Hash hash_db(storage, ns);
+    s = hash_db.MSet(args[1], field_values, false, &ret);
+  } else if (cmd == "sadd") {
+    std::vector<Slice> members(args.begin() + 2, args.end());
+    Redis::Set set_db(storage, ns);
+    s = set_db.Add(args[1], members, &ret);
+  } else if (cmd == "zadd") {
+    if (args.size() % 2 != 0) return {Status::NotOK, "wrong number of arguments for 'zadd' command"};
+    std::vector<MemberScore> member_scores;
+    for (size_t i = 2; i < args.size(); i += 2) {
+      try {
+        double score = std::stod(args[i]);
+        if (std::isnan(score)) return {Status::NotOK, "invalid score in 'zadd' command"};
+        member_scores.emplace_back(MemberScore{args[i + 1], score});
+      } catch (const std::exception &e) {
+        return {Status::NotOK, "invalid score in 'zadd' command"};
+      }
+    }
+    Redis::ZSet zset_db(storage, ns);
+    s = zset_db.Add(args[1], ZAddFlags::Default(), &member_scores, &ret);
+  } else if (cmd == "rpush" || cmd == "lpush") {
+    std::vector<Slice> elems(args.begin() + 2, args.end());
+    Redis::List list_db(storage, ns);
+    s = list_db.Push(args[1], elems, cmd == "lpush", &ret);
+  } else if (cmd == "expire") {
+    auto ttl = ParseInt<int>(args[2], {1, INT_MAX}, 10);
+    if (!ttl || args.size() != 3) return {Status::NotOK, "invalid expire time in 'expire' command"};
+    Redis::Database db(storage, ns);
+    s = db.Expire(args[1], static_cast<int>(Util::GetTimeStamp() + *ttl));
+  } else {
+    return {Status::NotOK, "unsupported command '" + cmd + "'"};
+  }
+
+  if (!s.ok() && !s.IsNotFound()) return {Status::NotOK, s.ToString()};
+  return Status::OK();
+}
+
+// Export the key-values of the column family into the SST files in order, each of them is at most
+// about the file size, so the files of the column family don't overlap
+static Status exportColumnFamily(Engine::Storage *storage, const std::string &cf_name, const std::string &output_dir,
+                                 uint64_t file_size, int *num_files) {
+  auto db = storage->GetDB();
+  auto cf_handle = storage->GetCFHandle(cf_name);
+  rocksdb::ReadOptions read_options;
+  read_options.fill_cache = false;
+  std::unique_ptr<rocksdb::Iterator> iter(db->NewIterator(read_options, cf_handle));
+
+  std::unique_ptr<rocksdb::SstFileWriter> writer;
+  rocksdb::Status s;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    if (!writer) {
+      writer = std::make_unique<rocksdb::SstFileWriter>(rocksdb::EnvOptions(), db->GetOptions(cf_handle), cf_handle);
+      s = writer->Open(fmt::format("{}/{}-{:06}.sst", output_dir, cf_name, ++*num_files));
+      if (!s.ok()) return {Status::NotOK, s.ToString()};
+    }
+    s = writer->Put(iter->key(), iter->value());
+    if (!s.ok()) return {Status::NotOK, s.ToString()};
+    if (writer->FileSize() >= file_size) {
+      s = writer->Finish();
+      if (!s.ok()) return {Status::NotOK, s.ToString()};
+      writer = nullptr;
+    }
+  }
+  if (!iter->status().ok()) return {Status::NotOK, iter->status().ToString()};
+  if (writer) {
+    s = writer->Finish();
+    if (!s.ok()) return {Status::NotOK, s.ToString()};
+  }
+  return Status::OK();
+}
+
+Server *GetServer() { return nullptr; }
+
+int main(int argc, char *argv[]) {
+  google::InitGoogleLogging("kvrocks-bulkload");
+  FLAGS_logtostderr = true;
+  FLAGS_minloglevel = google::WARNING;
+
+  std::cout << "Version: " << VERSION << " @" << GIT_COMMIT << std::endl;
+  auto opts = parseCommandLineOptions(argc, argv);
+  if (opts.show_usage) usage(argv[0]);
+
+  std::ifstream input_file;
+  if (opts.input != "-") {
+    input_file.open(opts.input, std::ios::binary);
+    if (!input_file.is_open()) {
+      std::cout << "Failed to open the input file: " << opts.input << std::endl;
+      exit(1);
+    }
+  }
+  std::istream &in = opts.input != "-" ? input_file : std::cin;
+
+  auto env = rocksdb::Env::Default();
+  auto s = env->CreateDirIfMissing(opts.output_dir);
+  if (!s.ok()) {
+    std::cout << "Failed to create the output directory, err: " << s.ToString() << std::endl;
+    exit(1);
+  }
+
+  // The TTL index is built while writing the metadata, and the WAL is useless for the temporary DB
+  Config kvrocks_config;
+  kvrocks_config.db_dir = opts.output_dir + "/tmp_db";
+  kvrocks_config.cluster_enabled = opts.cluster_enabled;
+  kvrocks_config.slot_id_encoded = opts.cluster_enabled;
+  kvrocks_config.active_expire_enabled = true;
+  kvrocks_config.RocksDB.write_options.disable_WAL = true;
+  rocksdb::DestroyDB(kvrocks_config.db_dir, rocksdb::Options());
+
+  int num_files = 0;
+  {
+    Engine::Storage storage(&kvrocks_config);
+    auto st = storage.Open();
+    if (!st.IsOK()) {
+      std::cout << "Failed to open the temporary DB, err: " << st.Msg() << std::endl;
+      exit(1);
+    }
+
+    uint64_t num_commands = 0;
+    std::vector<std::string> args;
+    while (true) {
+      st = readCommand(in, &args);
+      if (st.IsOK() && args.empty()) break;
+      if (st.IsOK()) st = writeCommand(&storage, opts.ns, args);
+      if (!st.IsOK()) {
+        std::cout << "Failed to write the command #" << num_commands + 1 << ", err: " << st.Msg() << std::endl;
+        exit(1);
+      }
+      if (++num_commands % 1000000 == 0) std::cout << "Wrote " << num_commands << " commands" << std::endl;
+    }
+    std::cout << "Wrote " << num_commands << " commands, exporting the SST files" << std::endl;
+
+    static const std::vector<std::string> cf_names = {
+        Engine::kMetadataColumnFamilyName, Engine::kSubkeyColumnFamilyName,  Engine::kZSetScoreColumnFamilyName,
+        Engine::kZSetRankColumnFamilyName, Engine::kStreamColumnFamilyName, Engine::kTTLIndexColumnFamilyName};
+    for (const auto &cf_name : cf_names) {
+      st = exportColumnFamily(&storage, cf_name, opts.output_dir, opts.sst_file_size_mb * MiB, &num_files);
+      if (!st.IsOK()) {
+        std::cout << "Failed to export the column family " << cf_name << ", err: " << st.Msg() << std::endl;
+        exit(1);
+      }
+    }
+  }
+  rocksdb::DestroyDB(kvrocks_config.db_dir, rocksdb::Options());
+
+  std::cout << "Exported " << num_files << " SST files into " << opts.output_dir
+            << ", ingest them by BULKLOAD INGEST <dir> on the server" << std::endl;
+  return 0;
+}
@@ -101,6 +101,26 @@ Status Config::parseConfigFromString(std::string input) {
       return Status(Status::NotOK, "argument must be 'yes' or 'no'");
     }
     cluster_enable = (i == 1);
+  } else if (size == 2 && args[0] == "redis-connections") {
+    redis_connections = std::stoi(args[1]);
+    if (redis_connections < 1 || redis_connections > 64) {
+      return Status(Status::NotOK, "redis-connections should be between 1 and 64");
+    }
+  } else if (size == 2 && args[0] == "pipeline-window") {
+    pipeline_window = std::stoi(args[1]);
+    if (pipeline_window < 1 || pipeline_window > 65536) {
+      return Status(Status::NotOK, "pipeline-window should be between 1 and 65536");
+    }
+  } else if (size == 2 && args[0] == "offset-checkpoint-interval-ms") {
+    offset_checkpoint_interval_ms = std::stoi(args[1]);
+    if (offset_checkpoint_interval_ms < 0) {
+      return Status(Status::NotOK, "offset-checkpoint-interval-ms should be non-negative");
+    }
+  } else if (size == 2 && args[0] == "parse-threads") {
+    parse_threads = std::stoi(args[1]);
+    if (parse_threads < 1 || parse_threads > 256) {
+      return Status(Status::NotOK, "parse-threads should be between 1 and 256");
+    }
   } else if (size >= 3 && !strncasecmp(args[0].data(), "namespace.", 10)) {
     std::string ns = args[0].substr(10, args.size() - 10);
     if (ns.size() > INT8_MAX) {
@@ -52,6 +52,13 @@ struct Config {
   int kvrocks_port = 0;
   std::map<std::string, redis_server> tokens;
   bool cluster_enable = false;
+  // The commands of each namespace are sent over the connections partitioned by the key hash,
+  // and at most pipeline_window commands are in flight on each connection
+  int redis_connections = 1;
+  int pipeline_window = 128;
+  int offset_checkpoint_interval_ms = 1000;
+  // The number of the threads which parse the key ranges of the full db in parallel
+  int parse_threads = 4;
 
  public:
   Status Load(std::string path);
@@ -23,24 +23,92 @@
 #include <glog/logging.h>
 #include <rocksdb/write_batch.h>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include "cluster/redis_slot.h"
 #include "db_util.h"
 #include "server/redis_reply.h"
+#include "types/redis_bitmap.h"
+#include "types/redis_sortedint.h"
 
-Status Parser::ParseFullDB() {
+Status Parser::ParseFullDB(int threads) {
+  if (!lastest_snapshot_) lastest_snapshot_ = std::make_shared<LatestSnapShot>(storage_->GetDB());
+  // More ranges than the threads, so that the threads which parsed the small ranges pick the left ones
+  auto boundaries = splitKeyRanges(static_cast<size_t>(std::max(threads, 1)) * 4);
+  std::vector<std::pair<std::string, std::string>> ranges;
+  std::string begin;
+  for (const auto &boundary : boundaries) {
+    ranges.emplace_back(begin, boundary);
+    begin = boundary;
+  }
+  ranges.emplace_back(begin, "");
+  LOG(INFO) << "[kvrocks2redis] Parsing " << ranges.size() << " key ranges by " << threads << " threads";
+
+  std::atomic<size_t> next_range = 0;
+  std::atomic<bool> failed = false;
+  std::mutex status_mu;
+  Status status;
+  auto parse = [&, this]() {
+    Parser parser(storage_, writer_, lastest_snapshot_);
+    while (!failed) {
+      size_t i = next_range++;
+      if (i >= ranges.size()) break;
+      auto s = parser.parseKeyRange(ranges[i].first, ranges[i].second);
+      if (!s.IsOK()) {
+        std::lock_guard<std::mutex> guard(status_mu);
+        failed = true;
+        status = s;
+        return;
+      }
+    }
+  };
+  std::vector<std::thread> parse_threads;
+  for (int i = 1; i < threads; i++) {
+    parse_threads.emplace_back(parse);
+  }
+  parse();
+  for (auto &t : parse_threads) t.join();
+  return status;
+}
+
+std::vector<std::string> Parser::splitKeyRanges(size_t ranges) {
+  std::vector<rocksdb::LiveFileMetaData> files;
+  storage_->GetDB()->GetLiveFilesMetaData(&files);
+  std::vector<std::string> keys;
+  for (const auto &file : files) {
+    if (file.column_family_name == Engine::kMetadataColumnFamilyName) keys.emplace_back(file.smallestkey);
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  // Pick the boundaries evenly from the smallest keys of the files, the files are of similar sizes
+  std::vector<std::string> boundaries;
+  if (keys.empty()) return boundaries;
+  for (size_t i = 1; i < ranges; i++) {
+    const auto &key = keys[i * keys.size() / ranges];
+    if (!key.empty() && (boundaries.empty() || boundaries.back() < key)) boundaries.emplace_back(key);
+  }
+  return boundaries;
+}
+
+Status Parser::parseKeyRange(const std::string &begin, const std::string &end) {
   rocksdb::DB *db_ = storage_->GetDB();
-  if (!lastest_snapshot_) lastest_snapshot_ = std::unique_ptr<LatestSnapShot>(new LatestSnapShot(db_));
   rocksdb::ColumnFamilyHandle *metadata_cf_handle_ = storage_->GetCFHandle("metadata");
 
   rocksdb::ReadOptions read_options;
   read_options.snapshot = lastest_snapshot_->GetSnapShot();
   read_options.fill_cache = false;
+  rocksdb::Slice upper_bound(end);
+  if (!end.empty()) read_options.iterate_upper_bound = &upper_bound;
   std::unique_ptr<rocksdb::Iterator> iter(db_->NewIterator(read_options, metadata_cf_handle_));
   Status s;
 
-  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+  std::vector<std::string> elements;
+  for (iter->Seek(begin); iter->Valid(); iter->Next()) {
     Metadata metadata(kRedisNone);
     metadata.Decode(iter->value().ToString());
     if (metadata.Expired()) {  // ignore the expired key
@@ -48,11 +116,41 @@ Status Parser::ParseFullDB() {
     }
     if (metadata.Type() == kRedisString) {
       s = parseSimpleKV(iter->key(), iter->value(), metadata.expire);
+    } else if (DecodeInlineElements(iter->value().ToString(), &elements)) {
+      s = parseInlineKV(iter->key(), metadata, elements);
+    } else if (metadata.Type() == kRedisBitmap) {
+      BitmapMetadata bitmap_metadata(false);
+      bitmap_metadata.Decode(iter->value().ToString());
+      s = parseComplexKV(iter->key(), bitmap_metadata, bitmap_metadata.containers);
+    } else if (metadata.Type() == kRedisSortedint) {
+      SortedintMetadata sortedint_metadata(false);
+      sortedint_metadata.Decode(iter->value().ToString());
+      s = parseComplexKV(iter->key(), sortedint_metadata, sortedint_metadata.blocks);
     } else {
       s = parseComplexKV(iter->key(), metadata);
     }
     if (!s.IsOK()) return s;
   }
+  if (!iter->status().ok()) return Status(Status::NotOK, iter->status().ToString());
+  return flushCommands();
+}
+
+Status Parser::writeCommand(const std::string &ns, const std::string &command) {
+  auto &pending = pending_commands_[ns];
+  pending.append(command);
+  if (pending.size() < kPendingCommandsFlushSize) return Status::OK();
+  auto s = writer_->Write(ns, {pending});
+  pending.clear();
+  return s;
+}
+
+Status Parser::flushCommands() {
+  for (auto &iter : pending_commands_) {
+    if (iter.second.empty()) continue;
+    auto s = writer_->Write(iter.first, {iter.second});
+    if (!s.IsOK()) return s;
+    iter.second.clear();
+  }
   return Status::OK();
 }
 
@@ -61,23 +159,24 @@ Status Parser::parseSimpleKV(const Slice &ns_key, const Slice &value, int expire
   ExtractNamespaceKey(ns_key, &ns, &user_key, is_slotid_encoded_);
   std::string output;
   output = Redis::Command2RESP({"SET", user_key, value.ToString().substr(5, value.size() - 5)});
-  Status s = writer_->Write(ns, {output});
+  Status s = writeCommand(ns, output);
   if (!s.IsOK()) return s;
 
   if (expire > 0) {
     output = Redis::Command2RESP({"EXPIREAT", user_key, std::to_string(expire)});
-    s = writer_->Write(ns, {output});
+    s = writeCommand(ns, output);
   }
   return s;
 }
 
-Status Parser::parseComplexKV(const Slice &ns_key, const Metadata &metadata) {
+Status Parser::parseComplexKV(const Slice &ns_key, const Metadata &metadata, bool packed) {
   RedisType type = metadata.Type();
   if (type < kRedisHash || type > kRedisSortedint) {
     return Status(Status::NotOK, "unknown metadata type: " + std::to_string(type));
   }
 
-  std::string ns, prefix_key, user_key, sub_key, value, output, next_version_prefix_key;
+  std::string ns, prefix_key, user_key, sub_key, value, output, next_version_prefix_key, buffer;
+  std::vector<uint64_t> block_ids;
   ExtractNamespaceKey(ns_key, &ns, &user_key, is_slotid_encoded_);
   InternalKey(ns_key, "", metadata.version, is_slotid_encoded_).Encode(&prefix_key);
   InternalKey(ns_key, "", metadata.version + 1, is_slotid_encoded_).Encode(&next_version_prefix_key);
@@ -115,29 +214,66 @@ Status Parser::parseComplexKV(const Slice &ns_key, const Metadata &metadata) {
       }
       case kRedisBitmap: {
         int index = std::stoi(sub_key);
-        s = Parser::parseBitmapSegment(ns, user_key, index, value);
+        s = Parser::parseBitmapSegment(ns, user_key, index,
+                                       Redis::Bitmap::DecodeSegment(packed, value, &buffer));
         break;
       }
       case kRedisSortedint: {
-        std::string val = std::to_string(DecodeFixed64(ikey.GetSubKey().data()));
-        output = Redis::Command2RESP({"ZADD", user_key, val, val});
+        uint64_t id = DecodeFixed64(ikey.GetSubKey().data());
+        if (!packed) {
+          std::string val = std::to_string(id);
+          output = Redis::Command2RESP({"ZADD", user_key, val, val});
+          break;
+        }
+        // The ids of the block are written as one ZADD
+        if (!Redis::Sortedint::DecodeBlock(id, value, &block_ids)) {
+          return Status(Status::NotOK, "invalid sortedint block");
+        }
+        std::vector<std::string> args = {"ZADD", user_key};
+        for (const auto block_id : block_ids) {
+          args.emplace_back(std::to_string(block_id));
+          args.emplace_back(std::to_string(block_id));
+        }
+        output = Redis::Command2RESP(args);
         break;
       }
       default:
         break;  // should never get here
     }
     if (type != kRedisBitmap) {
-      s = writer_->Write(ns, {output});
+      s = writeCommand(ns, output);
     }
     if (!s.IsOK()) return s;
   }
 
   if (metadata.expire > 0) {
     output = Redis::Command2RESP({"EXPIREAT", user_key, std::to_string(metadata.expire)});
-    Status s = writer_->Write(ns, {output});
+    Status s = writeCommand(ns, output);
+    if (!s.IsOK()) return s;
+  }
+
+  return Status::OK();
+}
+
+Status Parser::parseInlineKV(const Slice &ns_key, const Metadata &metadata, const std::vector<std::string> &elements) {
+  std::string ns, user_key;
+  ExtractNamespaceKey(ns_key, &ns, &user_key, is_slotid_encoded_);
+  // The elements are the field-value pairs of the hash, the members of the set,
+  // or the score-member pairs of the sorted set
+  std::string cmd = metadata.Type() == kRedisHash ? "HSET" : (metadata.Type() == kRedisSet ? "SADD" : "ZADD");
+  size_t step = metadata.Type() == kRedisSet ? 1 : 2;
+  for (size_t i = 0; i + step <= elements.size(); i += step) {
+    std::vector<std::string> args = {cmd, user_key};
+    args.insert(args.end(), elements.begin() + static_cast<int64_t>(i),
+                elements.begin() + static_cast<int64_t>(i + step));
+    Status s = writeCommand(ns, Redis::Command2RESP(args));
     if (!s.IsOK()) return s;
   }
 
+  if (metadata.expire > 0) {
+    Status s = writeCommand(ns, Redis::Command2RESP({"EXPIREAT", user_key, std::to_string(metadata.expire)}));
+    if (!s.IsOK()) return s;
+  }
   return Status::OK();
 }
 
@@ -147,9 +283,8 @@ Status Parser::parseBitmapSegment(const Slice &ns, const Slice &user_key, int in
     if (bitmap[i] == 0) continue;  // ignore zero byte
     for (int j = 0; j < 8; j++) {
       if (!(bitmap[i] & (1 << j))) continue;  // ignore zero bit
-      s = writer_->Write(
-          ns.ToString(),
-          {Redis::Command2RESP({"SETBIT", user_key.ToString(), std::to_string(index * 8 + i * 8 + j), "1"})});
+      auto offset = std::to_string(index * 8 + i * 8 + j);
+      s = writeCommand(ns.ToString(), Redis::Command2RESP({"SETBIT", user_key.ToString(), offset, "1"}));
       if (!s.IsOK()) return s;
     }
   }
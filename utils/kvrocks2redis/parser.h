@@ -46,22 +46,42 @@ class LatestSnapShot {
 
 class Parser {
  public:
-  explicit Parser(Engine::Storage *storage, Writer *writer) : storage_(storage), writer_(writer) {
-    lastest_snapshot_ = std::unique_ptr<LatestSnapShot>(new LatestSnapShot(storage->GetDB()));
-    is_slotid_encoded_ = storage_->IsSlotIdEncoded();
-  }
+  explicit Parser(Engine::Storage *storage, Writer *writer)
+      : Parser(storage, writer, std::make_shared<LatestSnapShot>(storage->GetDB())) {}
   ~Parser() {}
 
-  Status ParseFullDB();
+  // The metadata is split into the key ranges by the boundaries of the SST files,
+  // which are parsed by the threads in parallel from the same snapshot
+  Status ParseFullDB(int threads = 1);
   rocksdb::Status ParseWriteBatch(const std::string &batch_string);
+  // The sequence number of the snapshot which the full db is parsed from
+  rocksdb::SequenceNumber GetSnapshotSeq() { return lastest_snapshot_->GetSnapShot()->GetSequenceNumber(); }
 
  protected:
+  Parser(Engine::Storage *storage, Writer *writer, std::shared_ptr<LatestSnapShot> snapshot)
+      : storage_(storage), writer_(writer), lastest_snapshot_(std::move(snapshot)) {
+    is_slotid_encoded_ = storage_->IsSlotIdEncoded();
+  }
+
   Engine::Storage *storage_ = nullptr;
   Writer *writer_ = nullptr;
-  std::unique_ptr<LatestSnapShot> lastest_snapshot_ = nullptr;
+  std::shared_ptr<LatestSnapShot> lastest_snapshot_ = nullptr;
   bool is_slotid_encoded_ = false;
+  // The commands of the full db are buffered by namespaces, and written to the writer in batches,
+  // so that the threads don't contend for the writer on every command
+  std::map<std::string, std::string> pending_commands_;
+  static constexpr size_t kPendingCommandsFlushSize = 1024 * 1024;
+
+  // Split the metadata column family into the ranges [boundaries[i-1], boundaries[i]),
+  // the first range has no lower bound and the last one has no upper bound
+  std::vector<std::string> splitKeyRanges(size_t ranges);
+  Status parseKeyRange(const std::string &begin, const std::string &end);
+  Status writeCommand(const std::string &ns, const std::string &command);
+  Status flushCommands();
 
   Status parseSimpleKV(const Slice &ns_key, const Slice &value, int expire);
-  Status parseComplexKV(const Slice &ns_key, const Metadata &metadata);
+  // The packed means the bitmap segments are the containers, or the sortedint ids are in the blocks
+  Status parseComplexKV(const Slice &ns_key, const Metadata &metadata, bool packed = false);
+  Status parseInlineKV(const Slice &ns_key, const Metadata &metadata, const std::vector<std::string> &elements);
   Status parseBitmapSegment(const Slice &ns, const Slice &user_key, int index, const Slice &bitmap);
 };
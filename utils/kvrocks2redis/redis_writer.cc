@@ -20,22 +20,28 @@
 
 #include "redis_writer.h"
 
-#include <assert.h>
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <charconv>
+#include <functional>
 #include <system_error>
+#include <utility>
 
 #include "io_util.h"
 #include "server/redis_reply.h"
 #include "thread_util.h"
 
 RedisWriter::RedisWriter(Kvrocks2redis::Config *config) : Writer(config) {
+  // The entries are created before the thread started, since FlushDB may update them in the other thread
+  for (const auto &iter : config_->tokens) {
+    next_offsets_[iter.first] = 0;
+    checkpoint_times_[iter.first] = {};
+  }
   try {
     t_ = std::thread([this]() {
       Util::ThreadSetName("redis-writer");
       this->sync();
-      assert(stop_flag_);
     });
   } catch (const std::system_error &e) {
     LOG(ERROR) << "[kvrocks2redis] Failed to create thread: " << e.what();
@@ -47,8 +53,8 @@ RedisWriter::~RedisWriter() {
   for (const auto &iter : next_offset_fds_) {
     close(iter.second);
   }
-  for (const auto &iter : redis_fds_) {
-    close(iter.second);
+  for (const auto &iter : redis_conns_) {
+    for (const auto &conn : iter.second) close(conn.fd);
   }
 }
 
@@ -67,7 +73,7 @@ Status RedisWriter::FlushDB(const std::string &ns) {
     return s;
   }
 
-  updateNextOffset(ns, 0);
+  updateNextOffset(ns, 0, true);
 
   s = Write(ns, {Redis::Command2RESP({"FLUSHDB"})});
   if (!s.IsOK()) return s;
@@ -76,7 +82,7 @@ Status RedisWriter::FlushDB(const std::string &ns) {
 }
 
 void RedisWriter::Stop() {
-  if (stop_flag_) return;
+  if (!t_.joinable()) return;
 
   stop_flag_ = true;  // Stopping procedure is asynchronous,
 
@@ -94,9 +100,7 @@ void RedisWriter::sync() {
     }
   }
 
-  std::string line;
-  size_t chunk_size = 4 * 1024 * 1024;
-  char *buffer = new char[chunk_size];
+  std::string buffer(4 * 1024 * 1024, '\0');
   while (!stop_flag_) {
     for (const auto &iter : config_->tokens) {
       Status s = GetAofFd(iter.first);
@@ -104,68 +108,191 @@ void RedisWriter::sync() {
         LOG(ERROR) << s.Msg();
         continue;
       }
-      s = getRedisConn(iter.first, iter.second.host, iter.second.port, iter.second.auth, iter.second.db_number);
+      s = getRedisConns(iter.first, iter.second.host, iter.second.port, iter.second.auth, iter.second.db_number);
       if (!s.IsOK()) {
         LOG(ERROR) << s.Msg();
         continue;
       }
-      while (true) {
-        auto getted_line_leng = pread(aof_fds_[iter.first], buffer, chunk_size, next_offsets_[iter.first]);
+      while (!stop_flag_) {
+        auto getted_line_leng = pread(aof_fds_[iter.first], buffer.data(), buffer.size(), next_offsets_[iter.first]);
         if (getted_line_leng <= 0) {
           if (getted_line_leng < 0) {
             LOG(ERROR) << "ERR read aof file : " << strerror(errno);
           }
           break;
         }
-        std::string con = std::string(buffer, getted_line_leng);
-        s = Util::SockSend(redis_fds_[iter.first], std::string(buffer, getted_line_leng));
-        if (!s.IsOK()) {
-          LOG(ERROR) << "ERR send data to redis err: " + s.Msg();
-          break;
+        size_t synced = 0;
+        s = syncChunk(iter.first, std::string_view(buffer.data(), getted_line_leng), &synced);
+        if (synced > 0) updateNextOffset(iter.first, next_offsets_[iter.first] + static_cast<int64_t>(synced));
+        if (s.Is<Status::RedisExecErr>() || s.Is<Status::RedisParseErr>()) {
+          // Ooops, something went wrong , sync process has been terminated, administrator should be notified
+          // when full sync is needed, please remove last_next_seq config file, and restart kvrocks2redis
+          LOG(ERROR) << "[kvrocks2redis] CRITICAL - redis sync return error , administrator confirm needed : "
+                     << s.Msg();
+          updateNextOffset(iter.first, next_offsets_[iter.first], true);
+          stop_flag_ = true;
+          return;
         }
-        s = Util::SockReadLine(redis_fds_[iter.first], &line);
         if (!s.IsOK()) {
-          LOG(ERROR) << "read redis response err: " + s.Msg();
+          // Reconnect and send the commands which weren't replied again
+          LOG(ERROR) << s.Msg();
+          closeRedisConns(iter.first);
           break;
         }
-        if (line.compare(0, 1, "-") == 0) {
-          // Ooops, something went wrong , sync process has been terminated, administrator should be notified
-          // when full sync is needed, please remove last_next_seq config file, and restart kvrocks2redis
-          LOG(ERROR) << "[kvrocks2redis] CRITICAL - redis sync return error , administrator confirm needed : " << line;
-          delete[] buffer;
-          Stop();
-          return;
+        if (synced == 0) {
+          // The command is larger than the buffer, or it isn't completely written yet
+          if (static_cast<size_t>(getted_line_leng) == buffer.size()) buffer.resize(buffer.size() * 2);
+          break;
         }
-        updateNextOffset(iter.first, next_offsets_[iter.first] + getted_line_leng);
       }
-      std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  for (const auto &iter : config_->tokens) {
+    updateNextOffset(iter.first, next_offsets_[iter.first], true);
+  }
+}
+
+Status RedisWriter::syncChunk(const std::string &ns, std::string_view chunk, size_t *synced) {
+  auto &conns = redis_conns_[ns];
+  std::vector<std::vector<std::string_view>> batches(conns.size());
+  auto flush = [&](size_t end) -> Status {
+    auto s = pipeline(ns, batches);
+    if (!s.IsOK()) return s;
+    for (auto &batch : batches) batch.clear();
+    *synced = end;
+    return Status::OK();
+  };
+
+  *synced = 0;
+  size_t pos = 0;
+  while (pos < chunk.size()) {
+    size_t length = 0;
+    std::optional<std::string_view> key;
+    auto s = parseCommand(chunk.substr(pos), &length, &key);
+    if (!s.IsOK()) return s;
+    if (length == 0) break;
+    auto cmd = chunk.substr(pos, length);
+    if (key) {
+      // The commands of the same key are always sent over the same connection, so they're applied in order
+      batches[std::hash<std::string_view>{}(*key) % batches.size()].emplace_back(cmd);
+      pos += length;
+      continue;
+    }
+    // The command without key, e.g. FLUSHDB, is applied after the commands before it and before the ones after it
+    s = flush(pos);
+    if (!s.IsOK()) return s;
+    batches[0].emplace_back(cmd);
+    pos += length;
+    s = flush(pos);
+    if (!s.IsOK()) return s;
+  }
+  return flush(pos);
+}
+
+Status RedisWriter::pipeline(const std::string &ns, const std::vector<std::vector<std::string_view>> &batches) {
+  auto &conns = redis_conns_[ns];
+  auto window = static_cast<size_t>(config_->pipeline_window);
+  std::vector<size_t> sent(conns.size(), 0);
+  while (true) {
+    // Fill the windows of all connections before reading the replies, so that Redis
+    // processes the commands of one connection while the others are being sent
+    std::vector<size_t> in_flight(conns.size(), 0);
+    bool idle = true;
+    for (size_t i = 0; i < conns.size(); i++) {
+      std::string data;
+      for (; sent[i] < batches[i].size() && in_flight[i] < window; sent[i]++, in_flight[i]++) {
+        data.append(batches[i][sent[i]]);
+      }
+      if (data.empty()) continue;
+      idle = false;
+      auto s = Util::SockSend(conns[i].fd, data);
+      if (!s.IsOK()) {
+        return {Status::NotOK, "ERR send data to redis err: " + s.Msg()};
+      }
+    }
+    if (idle) return Status::OK();
+    for (size_t i = 0; i < conns.size(); i++) {
+      auto s = readReplies(&conns[i], in_flight[i]);
+      if (!s.IsOK()) return s;
+    }
+  }
+}
+
+Status RedisWriter::readReplies(RedisConn *conn, size_t count) {
+  while (count > 0) {
+    UniqueEvbufReadln line(conn->replies.get(), EVBUFFER_EOL_CRLF_STRICT);
+    if (!line) {
+      auto n = evbuffer_read(conn->replies.get(), conn->fd, -1);
+      if (n < 0) return {Status::NotOK, std::string("read redis response err: ") + strerror(errno)};
+      if (n == 0) return {Status::NotOK, "read redis response err: connection closed"};
+      continue;
+    }
+    // The replies of the synced commands are the single lines, i.e. the statuses, the integers or the errors
+    if (line.length > 0 && line[0] == '-') {
+      return {Status::RedisExecErr, std::string(line.get(), line.length)};
+    }
+    count--;
   }
-  delete[] buffer;
+  return Status::OK();
 }
 
-Status RedisWriter::getRedisConn(const std::string &ns, const std::string &host, uint32_t port, const std::string &auth,
-                                 int db_index) {
-  auto iter = redis_fds_.find(ns);
-  if (iter == redis_fds_.end()) {
-    auto s = Util::SockConnect(host, port, &redis_fds_[ns]);
+Status RedisWriter::parseCommand(std::string_view data, size_t *length, std::optional<std::string_view> *key) {
+  *length = 0;
+  key->reset();
+  size_t pos = 0;
+  // Read the <prefix><number>\r\n header, return NotFound if it's incomplete
+  auto read_header = [&data, &pos](char prefix, int64_t *n) -> Status {
+    auto eol = data.find("\r\n", pos);
+    if (eol == std::string_view::npos) return {Status::NotFound};
+    auto res = std::from_chars(data.data() + pos + 1, data.data() + eol, *n);
+    if (data[pos] != prefix || res.ec != std::errc() || res.ptr != data.data() + eol || *n < 0) {
+      return {Status::RedisParseErr, "invalid command in the aof file: " + std::string(data.substr(pos, eol - pos))};
+    }
+    pos = eol + 2;
+    return Status::OK();
+  };
+
+  int64_t argc = 0;
+  auto s = read_header('*', &argc);
+  if (!s.IsOK()) return s.Is<Status::NotFound>() ? Status::OK() : s;
+  for (int64_t i = 0; i < argc; i++) {
+    int64_t len = 0;
+    s = read_header('$', &len);
+    if (!s.IsOK()) return s.Is<Status::NotFound>() ? Status::OK() : s;
+    if (data.size() < pos + len + 2) return Status::OK();
+    if (i == 1) *key = data.substr(pos, len);
+    pos += len + 2;
+  }
+  *length = pos;
+  return Status::OK();
+}
+
+Status RedisWriter::getRedisConns(const std::string &ns, const std::string &host, uint32_t port,
+                                  const std::string &auth, int db_index) {
+  auto &conns = redis_conns_[ns];
+  if (!conns.empty()) return Status::OK();
+
+  for (int i = 0; i < config_->redis_connections; i++) {
+    RedisConn conn;
+    auto s = Util::SockConnect(host, port, &conn.fd);
     if (!s.IsOK()) {
+      closeRedisConns(ns);
       return Status(Status::NotOK, std::string("Failed to connect to redis :") + s.Msg());
     }
+    conns.emplace_back(std::move(conn));
 
     if (!auth.empty()) {
-      auto s = authRedis(ns, auth);
+      s = authRedis(conns.back().fd, auth);
       if (!s.IsOK()) {
-        close(redis_fds_[ns]);
-        redis_fds_.erase(ns);
+        closeRedisConns(ns);
         return Status(Status::NotOK, s.Msg());
       }
     }
     if (db_index != 0) {
-      auto s = selectDB(ns, db_index);
+      s = selectDB(conns.back().fd, db_index);
       if (!s.IsOK()) {
-        close(redis_fds_[ns]);
-        redis_fds_.erase(ns);
+        closeRedisConns(ns);
         return Status(Status::NotOK, s.Msg());
       }
     }
@@ -174,11 +301,18 @@ Status RedisWriter::getRedisConn(const std::string &ns, const std::string &host,
   return Status::OK();
 }
 
-Status RedisWriter::authRedis(const std::string &ns, const std::string &auth) {
+void RedisWriter::closeRedisConns(const std::string &ns) {
+  auto iter = redis_conns_.find(ns);
+  if (iter == redis_conns_.end()) return;
+  for (const auto &conn : iter->second) close(conn.fd);
+  redis_conns_.erase(iter);
+}
+
+Status RedisWriter::authRedis(int fd, const std::string &auth) {
   const auto auth_len_str = std::to_string(auth.length());
-  Util::SockSend(redis_fds_[ns], "*2" CRLF "$4" CRLF "auth" CRLF "$" + auth_len_str + CRLF + auth + CRLF);
+  Util::SockSend(fd, "*2" CRLF "$4" CRLF "auth" CRLF "$" + auth_len_str + CRLF + auth + CRLF);
   std::string line;
-  auto s = Util::SockReadLine(redis_fds_[ns], &line);
+  auto s = Util::SockReadLine(fd, &line);
   if (!s.IsOK()) {
     return Status(Status::NotOK, std::string("read redis auth response err: ") + s.Msg());
   }
@@ -188,14 +322,13 @@ Status RedisWriter::authRedis(const std::string &ns, const std::string &auth) {
   return Status::OK();
 }
 
-Status RedisWriter::selectDB(const std::string &ns, int db_number) {
+Status RedisWriter::selectDB(int fd, int db_number) {
   const auto db_number_str = std::to_string(db_number);
   const auto db_number_str_len = std::to_string(db_number_str.length());
-  Util::SockSend(redis_fds_[ns],
-                 "*2" CRLF "$6" CRLF "select" CRLF "$" + db_number_str_len + CRLF + db_number_str + CRLF);
+  Util::SockSend(fd, "*2" CRLF "$6" CRLF "select" CRLF "$" + db_number_str_len + CRLF + db_number_str + CRLF);
   LOG(INFO) << "[kvrocks2redis] select db request was sent, waiting for response";
   std::string line;
-  auto s = Util::SockReadLine(redis_fds_[ns], &line);
+  auto s = Util::SockReadLine(fd, &line);
   if (!s.IsOK()) {
     return Status(Status::NotOK, std::string("read select db response err: ") + s.Msg());
   }
@@ -205,8 +338,14 @@ Status RedisWriter::selectDB(const std::string &ns, int db_number) {
   return Status::OK();
 }
 
-Status RedisWriter::updateNextOffset(const std::string &ns, std::istream::off_type offset) {
+Status RedisWriter::updateNextOffset(const std::string &ns, std::istream::off_type offset, bool checkpoint) {
   next_offsets_[ns] = offset;
+  auto now = std::chrono::steady_clock::now();
+  auto &checkpoint_time = checkpoint_times_[ns];
+  if (!checkpoint && now - checkpoint_time < std::chrono::milliseconds(config_->offset_checkpoint_interval_ms)) {
+    return Status::OK();
+  }
+  checkpoint_time = now;
   return writeNextOffsetToFile(ns, offset);
 }
 
@@ -22,11 +22,16 @@
 
 #include <glog/logging.h>
 
+#include <atomic>
+#include <chrono>
 #include <map>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
+#include "event_util.h"
 #include "writer.h"
 
 class RedisWriter : public Writer {
@@ -39,19 +44,38 @@ class RedisWriter : public Writer {
   void Stop() override;
 
  private:
+  // The connection to Redis, the replies of the pipelined commands are buffered until they're read
+  struct RedisConn {
+    int fd = -1;
+    UniqueEvbuf replies;
+  };
+
   std::thread t_;
-  bool stop_flag_ = false;
+  std::atomic<bool> stop_flag_ = false;
   std::map<std::string, int> next_offset_fds_;
   std::map<std::string, std::istream::off_type> next_offsets_;
-  std::map<std::string, int> redis_fds_;
+  // The next offsets are saved to the files at most once every offset-checkpoint-interval-ms
+  std::map<std::string, std::chrono::steady_clock::time_point> checkpoint_times_;
+  std::map<std::string, std::vector<RedisConn>> redis_conns_;
 
   void sync();
-  Status getRedisConn(const std::string &ns, const std::string &host, uint32_t port, const std::string &auth,
-                      int db_index);
-  Status authRedis(const std::string &ns, const std::string &auth);
-  Status selectDB(const std::string &ns, int db_number);
+  // Send the complete commands in the chunk, synced is set to the length of the commands which were
+  // replied, and the incomplete command at the end of the chunk is sent with the next chunk
+  Status syncChunk(const std::string &ns, std::string_view chunk, size_t *synced);
+  // Pipeline the batches to the connections of the same indexes, and wait for all replies
+  Status pipeline(const std::string &ns, const std::vector<std::vector<std::string_view>> &batches);
+  static Status readReplies(RedisConn *conn, size_t count);
+  // Parse the RESP command at the beginning of the data, its length is set to 0 if it's incomplete,
+  // and the key is the first argument of the command if it has one
+  static Status parseCommand(std::string_view data, size_t *length, std::optional<std::string_view> *key);
+  Status getRedisConns(const std::string &ns, const std::string &host, uint32_t port, const std::string &auth,
+                       int db_index);
+  void closeRedisConns(const std::string &ns);
+  static Status authRedis(int fd, const std::string &auth);
+  static Status selectDB(int fd, int db_number);
 
-  Status updateNextOffset(const std::string &ns, std::istream::off_type offset);
+  // The offset is saved to the file if the checkpoint interval elapsed or checkpoint is true
+  Status updateNextOffset(const std::string &ns, std::istream::off_type offset, bool checkpoint = false);
   Status readNextOffsetFromFile(const std::string &ns, std::istream::off_type *offset);
   Status writeNextOffsetToFile(const std::string &ns, std::istream::off_type offset);
   std::string getNextOffsetFilePath(const std::string &ns);
@@ -28,11 +28,16 @@
 #include <rocksdb/write_batch.h>
 #include <unistd.h>
 
+#include <sys/socket.h>
+
 #include <fstream>
 #include <string>
+#include <thread>
 
+#include "event_util.h"
 #include "io_util.h"
 #include "server/redis_reply.h"
+#include "thread_util.h"
 
 void send_string_to_event(bufferevent *bev, const std::string &data) {
   auto output = bufferevent_get_output(bev);
@@ -70,7 +75,7 @@ void Sync::Start() {
       usleep(10000);
       continue;
     }
-    s = auth();
+    s = auth(sock_fd_);
     if (!s.IsOK()) {
       LOG(ERROR) << s.Msg();
       usleep(10000);
@@ -100,14 +105,14 @@ void Sync::Stop() {
   LOG(INFO) << "[kvrocks2redis] Stopped";
 }
 
-Status Sync::auth() {
+Status Sync::auth(int fd) {
   // Send auth when needed
   if (!config_->kvrocks_auth.empty()) {
     const auto auth_command = Redis::MultiBulkString({"AUTH", config_->kvrocks_auth});
-    auto s = Util::SockSend(sock_fd_, auth_command);
+    auto s = Util::SockSend(fd, auth_command);
     if (!s.IsOK()) return Status(Status::NotOK, "send auth command err:" + s.Msg());
     std::string line;
-    s = Util::SockReadLine(sock_fd_, &line);
+    s = Util::SockReadLine(fd, &line);
     if (!s.IsOK()) {
       return Status(Status::NotOK, std::string("read auth response err: ") + s.Msg());
     }
@@ -119,18 +124,24 @@ Status Sync::auth() {
   return Status::OK();
 }
 
-Status Sync::tryPSync() {
-  const auto seq_str = std::to_string(next_seq_);
+Status Sync::sendPSync(int fd, rocksdb::SequenceNumber seq, std::string *reply) {
+  const auto seq_str = std::to_string(seq);
   const auto seq_len_str = std::to_string(seq_str.length());
   const auto cmd_str = "*2" CRLF "$5" CRLF "PSYNC" CRLF "$" + seq_len_str + CRLF + seq_str + CRLF;
-  auto s = Util::SockSend(sock_fd_, cmd_str);
-  LOG(INFO) << "[kvrocks2redis] Try to use psync, next seq: " << next_seq_;
+  auto s = Util::SockSend(fd, cmd_str);
+  LOG(INFO) << "[kvrocks2redis] Try to use psync, next seq: " << seq;
   if (!s.IsOK()) return Status(Status::NotOK, "send psync command err:" + s.Msg());
-  std::string line;
-  s = Util::SockReadLine(sock_fd_, &line);
+  s = Util::SockReadLine(fd, reply);
   if (!s.IsOK()) {
     return Status(Status::NotOK, std::string("read psync response err: ") + s.Msg());
   }
+  return Status::OK();
+}
+
+Status Sync::tryPSync() {
+  std::string line;
+  auto s = sendPSync(sock_fd_, next_seq_, &line);
+  if (!s.IsOK()) return s;
 
   if (line.compare(0, 3, "+OK") != 0) {
     if (next_seq_ > 0) {
@@ -155,53 +166,51 @@ Status Sync::tryPSync() {
 
 Status Sync::incrementBatchLoop() {
   std::cout << "Start parse increment batch ..." << std::endl;
-  char *line = nullptr;
-  size_t line_len = 0;
-  char *bulk_data = nullptr;
-  evbuffer *evbuf = evbuffer_new();
-  while (!IsStopped()) {
-    if (evbuffer_read(evbuf, sock_fd_, -1) <= 0) {
-      evbuffer_free(evbuf);
-      return Status(Status::NotOK, std::string("[kvrocks2redis] read increament batch err: ") + strerror(errno));
-    }
-    if (incr_state_ == IncrementBatchLoopState::Incr_batch_size) {
-      // Read bulk length
-      line = evbuffer_readln(evbuf, &line_len, EVBUFFER_EOL_CRLF_STRICT);
-      if (!line) {
-        usleep(10000);
-        continue;
-      }
-      incr_bulk_len_ = line_len > 0 ? std::strtoull(line + 1, nullptr, 10) : 0;
-      free(line);
-      if (incr_bulk_len_ == 0) {
-        return Status(Status::NotOK, "[kvrocks2redis] Invalid increment data size");
-      }
-      incr_state_ = Incr_batch_data;
-    }
+  auto s = readBatches(sock_fd_, [this](const std::string &batch) { applyBatch(batch); });
+  if (!s.IsOK()) return s;
+  if (!IsStopped()) return Status(Status::NotOK, "[kvrocks2redis] read increament batch err: connection closed");
+  return Status::OK();
+}
 
-    if (incr_state_ == IncrementBatchLoopState::Incr_batch_data) {
-      // Read bulk data (batch data)
-      if (incr_bulk_len_ + 2 <= evbuffer_get_length(evbuf)) {  // We got enough data
-        bulk_data = reinterpret_cast<char *>(evbuffer_pullup(evbuf, incr_bulk_len_ + 2));
-        std::string bulk_data_str = std::string(bulk_data, incr_bulk_len_);
-        // Skip the ping packet
-        if (bulk_data_str != "ping") {
-          auto bat = rocksdb::WriteBatch(bulk_data_str);
-          int count = bat.Count();
-          parser_->ParseWriteBatch(bulk_data_str);
-          updateNextSeq(next_seq_ + count);
+Status Sync::readBatches(int fd, const std::function<void(const std::string &)> &cb) {
+  UniqueEvbuf evbuf;
+  size_t bulk_len = 0;  // it's 0 until the bulk length is read
+  while (!IsStopped()) {
+    // Handle all complete batches in the buffer before reading more
+    if (bulk_len == 0) {
+      UniqueEvbufReadln line(evbuf.get(), EVBUFFER_EOL_CRLF_STRICT);
+      if (line) {
+        bulk_len = line.length > 0 ? std::strtoull(line.get() + 1, nullptr, 10) : 0;
+        if (bulk_len == 0) {
+          return Status(Status::NotOK, "[kvrocks2redis] Invalid increment data size");
         }
-        evbuffer_drain(evbuf, incr_bulk_len_ + 2);
-        incr_state_ = Incr_batch_size;
-      } else {
-        usleep(10000);
         continue;
       }
+    } else if (bulk_len + 2 <= evbuffer_get_length(evbuf.get())) {
+      auto bulk_data = reinterpret_cast<char *>(evbuffer_pullup(evbuf.get(), static_cast<ssize_t>(bulk_len + 2)));
+      std::string bulk_data_str = std::string(bulk_data, bulk_len);
+      evbuffer_drain(evbuf.get(), bulk_len + 2);
+      bulk_len = 0;
+      // Skip the ping packet
+      if (bulk_data_str != "ping") cb(bulk_data_str);
+      continue;
     }
+    auto n = evbuffer_read(evbuf.get(), fd, -1);
+    if (n < 0) {
+      return Status(Status::NotOK, std::string("[kvrocks2redis] read increament batch err: ") + strerror(errno));
+    }
+    if (n == 0) break;
   }
   return Status::OK();
 }
 
+void Sync::applyBatch(const std::string &batch) {
+  auto bat = rocksdb::WriteBatch(batch);
+  int count = bat.Count();
+  parser_->ParseWriteBatch(batch);
+  updateNextSeq(next_seq_ + count);
+}
+
 void Sync::parseKVFromLocalStorage() {
   LOG(INFO) << "[kvrocks2redis] Start parsing kv from the local storage";
   for (const auto &iter : config_->tokens) {
@@ -213,12 +222,61 @@ void Sync::parseKVFromLocalStorage() {
     }
   }
 
-  Status s = parser_->ParseFullDB();
+  // Buffer the raw stream of the increments after the snapshot, the incomplete batch at the end
+  // is streamed again by the next psync
+  auto seq = parser_->GetSnapshotSeq();
+  auto buffer_path = getBufferedBatchesFilePath();
+  int buffer_sock = -1, buffer_fd = -1;
+  std::thread buffer_thread;
+  std::string line;
+  auto s = Util::SockConnect(config_->kvrocks_host, config_->kvrocks_port, &buffer_sock);
+  if (s.IsOK()) s = auth(buffer_sock);
+  if (s.IsOK()) s = sendPSync(buffer_sock, seq + 1, &line);
+  if (s.IsOK() && line.compare(0, 3, "+OK") != 0) s = Status(Status::NotOK, "psync was rejected: " + line);
+  if (s.IsOK()) {
+    buffer_fd = open(buffer_path.data(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (buffer_fd < 0) s = Status::FromErrno();
+  }
+  if (s.IsOK()) {
+    buffer_thread = std::thread([buffer_sock, buffer_fd]() {
+      Util::ThreadSetName("batch-buffer");
+      char buf[16 * 1024];
+      ssize_t n = 0;
+      while ((n = read(buffer_sock, buf, sizeof(buf))) > 0) {
+        if (!Util::Write(buffer_fd, std::string(buf, n)).IsOK()) break;
+      }
+    });
+  } else {
+    LOG(WARNING) << "[kvrocks2redis] Failed to buffer the increments while parsing, encounter error: " << s.Msg();
+    if (buffer_fd >= 0) close(buffer_fd);
+    buffer_fd = -1;
+  }
+
+  s = parser_->ParseFullDB(config_->parse_threads);
+  if (buffer_thread.joinable()) {
+    // Stop the blocking read of the buffer thread
+    shutdown(buffer_sock, SHUT_RDWR);
+    buffer_thread.join();
+  }
+  if (buffer_sock >= 0) close(buffer_sock);
   if (!s.IsOK()) {
     LOG(ERROR) << "[kvrocks2redis] Failed to parse full db, encounter error: " << s.Msg();
+    if (buffer_fd >= 0) close(buffer_fd);
     return;
   }
-  updateNextSeq(storage_->LatestSeq() + 1);
+  updateNextSeq(seq + 1);
+
+  if (buffer_fd >= 0) {
+    lseek(buffer_fd, 0, SEEK_SET);
+    s = readBatches(buffer_fd, [this](const std::string &batch) { applyBatch(batch); });
+    close(buffer_fd);
+    unlink(buffer_path.data());
+    if (!s.IsOK()) {
+      LOG(ERROR) << "[kvrocks2redis] Failed to replay the buffered increments, encounter error: " << s.Msg();
+      return;
+    }
+    LOG(INFO) << "[kvrocks2redis] Replayed the buffered increments, next seq: " << next_seq_;
+  }
 }
 
 Status Sync::updateNextSeq(rocksdb::SequenceNumber seq) {
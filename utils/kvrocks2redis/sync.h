@@ -24,6 +24,8 @@
 #include <unistd.h>
 
 #include <fstream>
+#include <functional>
+#include <string>
 
 #include "cluster/replication.h"
 #include "config.h"
@@ -51,19 +53,19 @@ class Sync {
   int next_seq_fd_;
   rocksdb::SequenceNumber next_seq_ = static_cast<rocksdb::SequenceNumber>(0);
 
-  // Internal states managed by IncrementBatchLoop procedure
-  enum IncrementBatchLoopState {
-    Incr_batch_size,
-    Incr_batch_data,
-  } incr_state_ = Incr_batch_size;
-
-  size_t incr_bulk_len_ = 0;
-
-  Status auth();
+  Status auth(int fd);
+  Status sendPSync(int fd, rocksdb::SequenceNumber seq, std::string *reply);
   Status tryPSync();
   Status incrementBatchLoop();
+  // Read the batches which are sent as the bulk strings from the fd until it's closed or the sync is stopped,
+  // the fd is either the replication connection or the file which buffered the stream of it
+  Status readBatches(int fd, const std::function<void(const std::string &)> &cb);
+  void applyBatch(const std::string &batch);
 
+  // The stream of the increments after the snapshot is buffered into the file while the full db
+  // is being parsed, then it's replayed, so the WAL of kvrocks needn't be kept for the whole parse
   void parseKVFromLocalStorage();
+  std::string getBufferedBatchesFilePath() { return config_->output_dir + "buffered_batches.dat"; }
 
   Status updateNextSeq(rocksdb::SequenceNumber seq);
   Status readNextSeqFromFile(rocksdb::SequenceNumber *seq);
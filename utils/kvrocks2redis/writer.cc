@@ -34,6 +34,7 @@ Writer::~Writer() {
 }
 
 Status Writer::Write(const std::string &ns, const std::vector<std::string> &aofs) {
+  std::lock_guard<std::mutex> guard(mu_);
   auto s = GetAofFd(ns);
   if (!s.IsOK()) {
     return Status(Status::NotOK, s.Msg());
@@ -46,6 +47,7 @@ Status Writer::Write(const std::string &ns, const std::vector<std::string> &aofs
 }
 
 Status Writer::FlushDB(const std::string &ns) {
+  std::lock_guard<std::mutex> guard(mu_);
   auto s = GetAofFd(ns, true);
   if (!s.IsOK()) {
     return Status(Status::NotOK, s.Msg());
@@ -22,6 +22,7 @@
 
 #include <fstream>
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -41,5 +42,7 @@ class Writer {
 
  protected:
   Kvrocks2redis::Config *config_ = nullptr;
+  // The full db is written by the parsing threads in parallel
+  std::mutex mu_;
   std::map<std::string, int> aof_fds_;
 };
@@ -94,7 +94,7 @@ def check_version(current: str, required: Tuple[int, int, int], prog_name: Optio
 
 
 def build(dir: str, jobs: Optional[int], ghproxy: bool, ninja: bool, unittest: bool, compiler: str, cmake_path: str, D: List[str],
-          skip_build: bool) -> None:
+          skip_build: bool, benchmark: bool = False) -> None:
     basedir = Path(__file__).parent.absolute()
 
     find_command("autoconf", msg="autoconf is required to build jemalloc")
@@ -113,6 +113,8 @@ def build(dir: str, jobs: Optional[int], ghproxy: bool, ninja: bool, unittest: b
         cmake_options.append("-DDEPS_FETCH_PROXY=https://ghproxy.com/")
     if ninja:
         cmake_options.append("-G Ninja")
+    if benchmark:
+        cmake_options.append("-DENABLE_BENCHMARK=ON")
     if compiler == 'gcc':
         cmake_options += ["-DCMAKE_C_COMPILER=gcc", "-DCMAKE_CXX_COMPILER=g++"]
     elif compiler == 'clang':
@@ -127,6 +129,8 @@ def build(dir: str, jobs: Optional[int], ghproxy: bool, ninja: bool, unittest: b
     target = ["kvrocks", "kvrocks2redis"]
     if unittest:
         target.append("unittest")
+    if benchmark:
+        target.append("kvrocks_bench")
 
     options = ["--build", "."]
     if jobs is not None:
@@ -371,6 +375,8 @@ if __name__ == '__main__':
                               help='use https://ghproxy.com to fetch dependencies')
     parser_build.add_argument('--ninja', default=False, action='store_true', help='use Ninja to build kvrocks')
     parser_build.add_argument('--unittest', default=False, action='store_true', help='build unittest target')
+    parser_build.add_argument('--benchmark', default=False, action='store_true',
+                              help='build kvrocks_bench target, requires Google Benchmark')
     parser_build.add_argument('--compiler', default='auto', choices=('auto', 'gcc', 'clang'),
                               help="compiler used to build kvrocks")
     parser_build.add_argument('--cmake-path', default='cmake', help="path of cmake binary used to build kvrocks")